@@ -0,0 +1,196 @@
+/***********************************************
+ Copyright 2019 Vebjørn Kvisli
+ License: GNU Lesser General Public License v3.0
+***********************************************/
+
+// Builds a single binary pack of all the appliance cluster profiles, the
+// program mappings and the PV category curves in the data folder, so that the
+// simulator can map the pack once and refer to the profiles by name instead of
+// reading consumer files written for each request. Run it with "npm run pack"
+// whenever the data folder changes. The layout is documented in the header of
+// simulator/DOMINOES/ProfilePack.hpp and must be kept in sync with it.
+
+const fs = require('fs');
+const path = require('path');
+
+const MAGIC = "DOMPACK\0";
+const BYTE_ORDER = 0x01020304;
+const VERSION = 1;
+const HEADER_SIZE = 80;
+const PROFILE_RECORD_SIZE = 48;
+const SET_RECORD_SIZE = 24;
+
+const KIND = { wm: 0, dw: 1, pv: 2 };
+
+// The clusters and the programs are collected from the data folder, and each
+// profile gets the name of its cluster followed by its index in the cluster
+function collectData(dataFolder) {
+  let profiles = [];
+  let clusters = [];
+  let programs = [];
+
+  for (let code of ["wm", "dw"]) {
+    let folder = path.join(dataFolder, code + "_clusters");
+    let clusterIndex = {};
+
+    for (let fileName of fs.readdirSync(folder).sort()) {
+      if (!fileName.endsWith(".json") || fileName === "programMapping.json")
+        continue;
+
+      let content = JSON.parse(fs.readFileSync(path.join(folder, fileName)));
+      let clusterName = code + "/" + path.basename(fileName, ".json");
+      let members = [];
+
+      content.data.forEach((values, index) => {
+        members.push(profiles.length);
+        profiles.push({
+          name: clusterName + "/" + index,
+          kind: KIND[code],
+          start: 0,
+          resolution: 60 * content.minuteRes,
+          values: values
+        });
+      });
+
+      clusterIndex[fileName] = clusters.length;
+      clusters.push({ name: clusterName, kind: KIND[code], members: members });
+    }
+
+    let mapping = JSON.parse(fs.readFileSync(path.join(folder, "programMapping.json")));
+    for (let program of Object.keys(mapping)) {
+      programs.push({
+        name: code + "/" + program,
+        kind: KIND[code],
+        members: mapping[program].map(fileName => {
+          if (!(fileName in clusterIndex))
+            throw new Error("Program " + program + " refers to the missing cluster " + fileName);
+          return clusterIndex[fileName];
+        })
+      });
+    }
+  }
+
+  let folder = path.join(dataFolder, "pv_categories");
+  for (let fileName of fs.readdirSync(folder).sort()) {
+    if (!fileName.endsWith(".json"))
+      continue;
+
+    let content = JSON.parse(fs.readFileSync(path.join(folder, fileName)));
+    let categoryName = "pv/" + path.basename(fileName, ".json");
+    let members = [];
+
+    content.data.forEach((curve, index) => {
+      members.push(profiles.length);
+      profiles.push({
+        name: categoryName + "/" + index,
+        kind: KIND.pv,
+        start: curve.unixStartUTC,
+        resolution: 60 * curve.minuteRes,
+        values: curve.profile
+      });
+    });
+
+    clusters.push({ name: categoryName, kind: KIND.pv, members: members });
+  }
+
+  return { profiles: profiles, clusters: clusters, programs: programs };
+}
+
+// Rounds an offset up to the next multiple of eight bytes
+function align(offset) {
+  return Math.ceil(offset / 8) * 8;
+}
+
+// Writes the pack with all integers and doubles in little endian byte order
+function writePack(data, packFileName) {
+  let strings = [];
+  let stringSize = 0;
+  let addString = function(text) {
+    let bytes = Buffer.from(text, "utf8");
+    let offset = stringSize;
+    strings.push(bytes);
+    stringSize += bytes.length;
+    return { offset: offset, length: bytes.length };
+  };
+
+  let memberCount = 0;
+  for (let set of data.clusters.concat(data.programs))
+    memberCount += set.members.length;
+
+  let valueCount = 0;
+  for (let profile of data.profiles)
+    valueCount += profile.values.length;
+
+  let profileTable = HEADER_SIZE;
+  let clusterTable = profileTable + data.profiles.length * PROFILE_RECORD_SIZE;
+  let programTable = clusterTable + data.clusters.length * SET_RECORD_SIZE;
+  let memberTable = programTable + data.programs.length * SET_RECORD_SIZE;
+  let stringTable = memberTable + memberCount * 4;
+
+  let profileNames = data.profiles.map(profile => addString(profile.name));
+  let clusterNames = data.clusters.map(cluster => addString(cluster.name));
+  let programNames = data.programs.map(program => addString(program.name));
+
+  let valueTable = align(stringTable + stringSize);
+  let pack = Buffer.alloc(valueTable + valueCount * 8);
+
+  pack.write(MAGIC, 0, "latin1");
+  pack.writeUInt32LE(BYTE_ORDER, 8);
+  pack.writeUInt32LE(VERSION, 12);
+  pack.writeUInt32LE(data.profiles.length, 16);
+  pack.writeUInt32LE(data.clusters.length, 20);
+  pack.writeUInt32LE(data.programs.length, 24);
+  pack.writeUInt32LE(memberCount, 28);
+  [profileTable, clusterTable, programTable, memberTable, stringTable, valueTable]
+    .forEach((offset, index) => pack.writeBigUInt64LE(BigInt(offset), 32 + 8 * index));
+
+  let firstValue = 0;
+  data.profiles.forEach((profile, index) => {
+    let record = profileTable + index * PROFILE_RECORD_SIZE;
+    pack.writeBigUInt64LE(BigInt(profileNames[index].offset), record);
+    pack.writeUInt32LE(profileNames[index].length, record + 8);
+    pack.writeUInt32LE(profile.kind, record + 12);
+    pack.writeBigInt64LE(BigInt(profile.start), record + 16);
+    pack.writeBigInt64LE(BigInt(profile.resolution), record + 24);
+    pack.writeBigUInt64LE(BigInt(firstValue), record + 32);
+    pack.writeBigUInt64LE(BigInt(profile.values.length), record + 40);
+
+    profile.values.forEach((value, offset) =>
+      pack.writeDoubleLE(value, valueTable + 8 * (firstValue + offset)));
+    firstValue += profile.values.length;
+  });
+
+  let firstMember = 0;
+  let writeSets = function(sets, names, table) {
+    sets.forEach((set, index) => {
+      let record = table + index * SET_RECORD_SIZE;
+      pack.writeBigUInt64LE(BigInt(names[index].offset), record);
+      pack.writeUInt32LE(names[index].length, record + 8);
+      pack.writeUInt32LE(set.kind, record + 12);
+      pack.writeUInt32LE(firstMember, record + 16);
+      pack.writeUInt32LE(set.members.length, record + 20);
+
+      set.members.forEach((member, offset) =>
+        pack.writeUInt32LE(member, memberTable + 4 * (firstMember + offset)));
+      firstMember += set.members.length;
+    });
+  };
+
+  writeSets(data.clusters, clusterNames, clusterTable);
+  writeSets(data.programs, programNames, programTable);
+
+  Buffer.concat(strings).copy(pack, stringTable);
+
+  fs.writeFileSync(packFileName, pack);
+  return pack.length;
+}
+
+let dataFolder = process.argv[2] || path.join(__dirname, "data");
+let packFileName = process.argv[3] || path.join(dataFolder, "profiles.pack");
+
+let data = collectData(dataFolder);
+let size = writePack(data, packFileName);
+
+console.log("Wrote " + data.profiles.length + " profiles in " + data.clusters.length +
+            " clusters and " + data.programs.length + " programs (" + size +
+            " bytes) to " + packFileName);
@@ -282,7 +282,10 @@ function executeSimulator(producerFileName, consumerEventFileName, resultFileNam
   let sunDay = "";
   if (prodStartTime !== null && prodEndTime !== null)
     sunDay = " -s " + prodStartTime + " " + prodEndTime;
-  let command = baseFileLocation + "DOMINOES/Simulator" + dir + prod + cons + ast + sunDay;
+  let metrics = " -M";
+  // Identical scenarios are answered from the result cache shared by all requests
+  let cache = " -R cache";
+  let command = baseFileLocation + "DOMINOES/Simulator" + dir + prod + cons + ast + sunDay + metrics + cache;
 
   // Execute the start command
   console.log("Executing command: " + command);
@@ -293,6 +296,16 @@ function executeSimulator(producerFileName, consumerEventFileName, resultFileNam
     return null;
   }
 
+  // Log the timings and counters reported by the simulator for this request.
+  // The report is stored next to the result file with the extension ".metrics.json"
+  let metricsFileName = resultFileName.replace(/\.[^.]*$/, "") + ".metrics.json";
+  try {
+    console.log("Simulator metrics: " + fs.readFileSync(baseFileLocation + metricsFileName).toString());
+  } catch (error) {
+    console.error(error);
+  }
+  deleteFile(baseFileLocation + metricsFileName);
+
   // Read the result file and return a string with its content
   try {
     return fs.readFileSync(baseFileLocation + resultFileName).toString();
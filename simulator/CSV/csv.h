@@ -47,8 +47,29 @@
 #include <memory>
 #include <cassert>
 #include <cerrno>
+#include <cstdint>
 #include <istream>
 
+// Files given by name are memory mapped on POSIX systems unless CSV_IO_NO_MMAP
+// is defined, and the separator scan uses 16 or 32 byte vector compares when
+// the compiler targets SSE2 or AVX2 unless CSV_IO_NO_SIMD is defined.
+#if !defined(CSV_IO_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define CSV_IO_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if !defined(CSV_IO_NO_SIMD) && (defined(__GNUC__) || defined(__clang__))
+#if defined(__AVX2__)
+#define CSV_IO_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#define CSV_IO_SSE2
+#include <emmintrin.h>
+#endif
+#endif
+
 namespace io{
         ////////////////////////////////////////////////////////////////////////////
         //                                 LineReader                             //
@@ -313,6 +334,70 @@ namespace io{
                         char*buffer;
                         int desired_byte_count;
                 };
+
+                #ifdef CSV_IO_MMAP
+                // A regular file is mapped private and writable so that the
+                // line reader can terminate the lines in place. The pages are
+                // copied on write only, and the file itself is never changed.
+                // The byte following the last byte of the file must be
+                // writable, as the last line is terminated there if the file
+                // does not end with a newline. That byte lies in the zero
+                // filled tail of the last page unless the file size is a
+                // multiple of the page size, and mapping is refused for such
+                // files. The caller then falls back to the buffered reader,
+                // which is also used for empty files, pipes and devices.
+                class MappedFile{
+                public:
+                        MappedFile(const MappedFile&) = delete;
+                        MappedFile&operator=(const MappedFile&) = delete;
+
+                        static std::unique_ptr<MappedFile> open(const char*file_name){
+                                int fd = ::open(file_name, O_RDONLY);
+                                if(fd == -1)
+                                        return nullptr;
+
+                                struct stat status;
+                                if(::fstat(fd, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size <= 0){
+                                        ::close(fd);
+                                        return nullptr;
+                                }
+
+                                std::size_t size = static_cast<std::size_t>(status.st_size);
+                                void*data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+                                ::close(fd);
+                                if(data == MAP_FAILED)
+                                        return nullptr;
+
+                                std::unique_ptr<MappedFile>mapping(new MappedFile(static_cast<char*>(data), size));
+                                long page_size = ::sysconf(_SC_PAGESIZE);
+                                if(page_size > 0 && size % static_cast<std::size_t>(page_size) == 0 && mapping->data[size-1] != '\n')
+                                        return nullptr;
+
+                                #ifdef MADV_SEQUENTIAL
+                                ::madvise(data, size, MADV_SEQUENTIAL);
+                                #endif
+                                return mapping;
+                        }
+
+                        char*begin()const{
+                                return data;
+                        }
+
+                        char*end()const{
+                                return data + size;
+                        }
+
+                        ~MappedFile(){
+                                ::munmap(data, size);
+                        }
+
+                private:
+                        MappedFile(char*data, std::size_t size):data(data), size(size){}
+
+                        char*data;
+                        std::size_t size;
+                };
+                #endif
         }
 
         class LineReader{
@@ -326,6 +411,11 @@ namespace io{
                 #endif
                 int data_begin;
                 int data_end;
+                #ifdef CSV_IO_MMAP
+                std::unique_ptr<detail::MappedFile>mapping;
+                char*mapped_data_begin;
+                char*mapped_data_end;
+                #endif
 
                 char file_name[error::max_file_name_length+1];
                 unsigned file_line;
@@ -361,6 +451,61 @@ namespace io{
                         }
                 }
 
+                // Files given by name are read from a mapping if possible as
+                // this avoids both the copying and the buffer allocation.
+                void init_file(const char*file_name){
+                        #ifdef CSV_IO_MMAP
+                        mapping = detail::MappedFile::open(file_name);
+                        if(mapping != nullptr){
+                                file_line = 0;
+                                data_begin = data_end = 0;
+                                mapped_data_begin = mapping->begin();
+                                mapped_data_end = mapping->end();
+
+                                // Ignore UTF-8 BOM
+                                if(mapped_data_end - mapped_data_begin >= 3 && mapped_data_begin[0] == '\xEF' && mapped_data_begin[1] == '\xBB' && mapped_data_begin[2] == '\xBF')
+                                        mapped_data_begin += 3;
+                                return;
+                        }
+                        #endif
+                        init(open_file(file_name));
+                }
+
+                #ifdef CSV_IO_MMAP
+                char*next_mapped_line(){
+                        if(mapped_data_begin == mapped_data_end)
+                                return 0;
+
+                        ++file_line;
+
+                        char*line_end = static_cast<char*>(std::memchr(mapped_data_begin, '\n', mapped_data_end - mapped_data_begin));
+                        if(line_end == nullptr)
+                                line_end = mapped_data_end;
+
+                        // The limit is not needed for the mapping, but it is kept
+                        // so that a file is accepted or rejected independent of
+                        // the way it is read.
+                        if(line_end - mapped_data_begin + 1 > block_len){
+                                error::line_length_limit_exceeded err;
+                                err.set_file_name(file_name);
+                                err.set_file_line(file_line);
+                                throw err;
+                        }
+
+                        // a missing newline at the end of the last line is
+                        // replaced by the terminator written past the file end
+                        *line_end = '\0';
+
+                        // handle windows \r\n-line breaks
+                        if(line_end != mapped_data_begin && *(line_end-1) == '\r')
+                                *(line_end-1) = '\0';
+
+                        char*ret = mapped_data_begin;
+                        mapped_data_begin = line_end == mapped_data_end ? mapped_data_end : line_end+1;
+                        return ret;
+                }
+                #endif
+
         public:
                 LineReader() = delete;
                 LineReader(const LineReader&) = delete;
@@ -368,12 +513,12 @@ namespace io{
 
                 explicit LineReader(const char*file_name){
                         set_file_name(file_name);
-                        init(open_file(file_name));
+                        init_file(file_name);
                 }
 
                 explicit LineReader(const std::string&file_name){
                         set_file_name(file_name.c_str());
-                        init(open_file(file_name.c_str()));
+                        init_file(file_name.c_str());
                 }
 
                 LineReader(const char*file_name, std::unique_ptr<ByteSourceBase>byte_source){
@@ -442,6 +587,11 @@ namespace io{
                 }
 
                 char*next_line(){
+                        #ifdef CSV_IO_MMAP
+                        if(mapping != nullptr)
+                                return next_mapped_line();
+                        #endif
+
                         if(data_begin == data_end)
                                 return 0;
 
@@ -462,10 +612,9 @@ namespace io{
                                 }
                         }
 
-                        int line_end = data_begin;
-                        while(buffer[line_end] != '\n' && line_end != data_end){
-                                ++line_end;
-                        }
+                        // memchr is vectorised by the C library
+                        const char*newline = static_cast<const char*>(std::memchr(buffer.get() + data_begin, '\n', data_end - data_begin));
+                        int line_end = newline != nullptr ? static_cast<int>(newline - buffer.get()) : data_end;
 
                         if(line_end - data_begin + 1 > block_len){
                                 error::line_length_limit_exceeded err;
@@ -753,12 +902,59 @@ namespace io{
                 }
         };
 
+        namespace detail{
+                // Returns the first character of the null terminated string that
+                // is either '\0' or one of the stop characters. The vector scans
+                // use aligned loads only. An aligned load never crosses a page
+                // boundary, and so it can safely read past the terminator, but
+                // memory checkers may report these bytes as uninitialised.
+                #if defined(CSV_IO_AVX2)
+                typedef __m256i scan_block;
+                inline scan_block load_scan_block(const scan_block*block){ return _mm256_load_si256(block); }
+                inline unsigned scan_mask(scan_block hits){ return static_cast<unsigned>(_mm256_movemask_epi8(hits)); }
+                inline scan_block match_any(scan_block){ return _mm256_setzero_si256(); }
+                template<class ... char_list>
+                inline scan_block match_any(scan_block block, char c, char_list ... rest){
+                        return _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(c)), match_any(block, rest...));
+                }
+                #elif defined(CSV_IO_SSE2)
+                typedef __m128i scan_block;
+                inline scan_block load_scan_block(const scan_block*block){ return _mm_load_si128(block); }
+                inline unsigned scan_mask(scan_block hits){ return static_cast<unsigned>(_mm_movemask_epi8(hits)); }
+                inline scan_block match_any(scan_block){ return _mm_setzero_si128(); }
+                template<class ... char_list>
+                inline scan_block match_any(scan_block block, char c, char_list ... rest){
+                        return _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(c)), match_any(block, rest...));
+                }
+                #endif
+
+                template<char ... stop_char_list>
+                const char*find_first_of_or_end(const char*str){
+                        #if defined(CSV_IO_AVX2) || defined(CSV_IO_SSE2)
+                        const unsigned misalignment = reinterpret_cast<std::uintptr_t>(str) % sizeof(scan_block);
+                        const scan_block*block = reinterpret_cast<const scan_block*>(str - misalignment);
+                        unsigned mask = scan_mask(match_any(load_scan_block(block), '\0', stop_char_list...)) >> misalignment;
+                        if(mask != 0)
+                                return str + __builtin_ctz(mask);
+                        for(;;){
+                                ++block;
+                                mask = scan_mask(match_any(load_scan_block(block), '\0', stop_char_list...));
+                                if(mask != 0)
+                                        return reinterpret_cast<const char*>(block) + __builtin_ctz(mask);
+                        }
+                        #else
+                        const char stop_chars[] = {stop_char_list...};
+                        while(*str != '\0' && std::find(stop_chars, stop_chars + sizeof(stop_chars), *str) == stop_chars + sizeof(stop_chars))
+                                ++str;
+                        return str;
+                        #endif
+                }
+        }
+
         template<char sep>
         struct no_quote_escape{
                 static const char*find_next_column_end(const char*col_begin){
-                        while(*col_begin != sep && *col_begin != '\0')
-                                ++col_begin;
-                        return col_begin;
+                        return detail::find_first_of_or_end<sep>(col_begin);
                 }
 
                 static void unescape(char*&, char*&){
@@ -769,21 +965,17 @@ namespace io{
         template<char sep, char quote>
         struct double_quote_escape{
                 static const char*find_next_column_end(const char*col_begin){
-                        while(*col_begin != sep && *col_begin != '\0')
-                                if(*col_begin != quote)
+                        col_begin = detail::find_first_of_or_end<sep, quote>(col_begin);
+                        while(*col_begin == quote){
+                                do{
+                                        col_begin = detail::find_first_of_or_end<quote>(col_begin+1);
+                                        if(*col_begin == '\0')
+                                                throw error::escaped_string_not_closed();
                                         ++col_begin;
-                                else{
-                                        do{
-                                                ++col_begin;
-                                                while(*col_begin != quote){
-                                                        if(*col_begin == '\0')
-                                                                throw error::escaped_string_not_closed();
-                                                        ++col_begin;
-                                                }
-                                                ++col_begin;
-                                        }while(*col_begin == quote);
-                                }      
-                        return col_begin;      
+                                }while(*col_begin == quote);
+                                col_begin = detail::find_first_of_or_end<sep, quote>(col_begin);
+                        }
+                        return col_begin;
                 }
 
                 static void unescape(char*&col_begin, char*&col_end){
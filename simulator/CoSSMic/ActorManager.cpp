@@ -21,10 +21,13 @@
 #include <thread>
 #include <chrono>
 #include <optional>
+#include <memory_resource>
 
 #include <boost/algorithm/string.hpp> // To convert to upper-case 
 
 #include "SessionLayer.hpp"
+#include "BinaryPayload.hpp"         // Binary message codecs
+#include "MemoryAccounting.hpp"      // The memory account of the producers
 
 #ifdef CoSSMic_DEBUG
   #include "ConsolePrint.hpp"        // Debug messages
@@ -151,6 +154,37 @@ bool ActorManager::AddProducer::Deserialize(
   else return false;
 }
 
+// The binary codec writes the same fields as the text message, and the ID is 
+// written as its string representation.
+
+Theron::SerialMessage::Payload 
+ActorManager::AddProducer::BinarySerialize( void ) const
+{
+  Theron::BinaryWriter Message( "CREATE_PRODUCER" );
+  
+  Message << ProducerType << static_cast< const std::string & >( NewProducerID )
+				  << PredictionFile;
+    
+  return Message.str();
+}
+
+bool ActorManager::AddProducer::BinaryDeserialize( 
+  const Theron::SerialMessage::Payload & Payload )
+{
+  Theron::BinaryReader Message( Payload, "CREATE_PRODUCER" );
+  std::string          ID;
+  
+  Message >> ProducerType >> ID >> PredictionFile;
+  
+  if ( !Message || ID.empty() ) return false;
+  
+  NewProducerID = IDType( ID );
+  
+  if ( (ProducerType == Type::PhotoVoltaic) && PredictionFile.empty() )
+    return false;
+  else return true;
+}
+
 // The constructor from a serialised message simply calls the de-serialise 
 // method, and throws a standard invalid argument exception if the operation 
 // fails as the message is then not a message for creating producers.
@@ -158,7 +192,7 @@ bool ActorManager::AddProducer::Deserialize(
 ActorManager::AddProducer::AddProducer( 
     const Theron::SerialMessage::Payload & Payload)
 {
-  if ( ! Deserialize( Payload ) )
+  if ( ! Decode( Payload ) )
 	{
 		std::ostringstream ErrorMessage;
 		
@@ -179,10 +213,29 @@ ActorManager::AddProducer::AddProducer(
 //
 // There could be a pre-check for the household ID as well, but this is 
 // currently not implemented.
+//
+// The producers are allocated from the memory account of the producers so 
+// that the memory of the producer actors can be reported.
 
 void ActorManager::CreateProducer( const ActorManager::AddProducer & Command, 
 																   const Theron::Address TheTaskManager )
 {
+  // The command from the task manager is first given to the placement service
+  // if there is one, and the address of the task manager must be recorded 
+  // here since the command returns from the placement service.
+  
+  if ( Placement != Theron::Address::Null() )
+  {
+    if ( TheTaskManager != Placement )
+    {
+      HouseholdTaskManager = TheTaskManager;
+      Send( Command, Placement );
+      return;
+    }
+  }
+  else
+    HouseholdTaskManager = TheTaskManager;
+    
   std::string NewProducerName = "producer" + Command.GetID();
   
 	auto CheckProducerName = 
@@ -199,19 +252,44 @@ void ActorManager::CreateProducer( const ActorManager::AddProducer & Command,
         // Not supported yet
         break;
       case AddProducer::Type::PhotoVoltaic :
-        Producers.push_back( 
-	        std::make_shared< PVProducer >( Command.GetID(), 
-									                        Command.GetFileName(), 
-									                        SolutionTolerance, MaxEvaluations ) );
+      {
+        // The producer reports its production to the reward calculator 
+        // for the energy balance of the household.
+        
+        auto NewProducer = std::allocate_shared< PVProducer >( 
+						std::pmr::polymorphic_allocator< PVProducer >( 
+							Theron::MemoryAccounting::Resource( "Producer" ) ),
+						Command.GetID(), Command.GetFileName(), 
+						SolutionTolerance, MaxEvaluations );
+        
+        NewProducer->ReportProductionTo( Evaluator );
+        Producers.push_back( NewProducer );
         break;
+      }
       case AddProducer::Type::Battery :
         // Not supported yet
         break;
     }
-    
-  // The address of the actor performing the task manager role is recorded 
+}
+
+// The load of the endpoint is summed over the active producers. The counters 
+// of the producers are atomic, and reading them does not disturb producers 
+// that are computing schedules.
+
+void ActorManager::ReportLoad( const ActorManager::LoadQuery & TheQuery, 
+															 const Theron::Address ThePlacement )
+{
+  std::size_t 						  Proxies = 0;
+  std::chrono::milliseconds SchedulingTime( 0 );
   
-  HouseholdTaskManager = TheTaskManager;
+  for ( const std::shared_ptr< Producer > & TheProducer : Producers )
+  {
+    Proxies        += TheProducer->NumberOfConsumers();
+    SchedulingTime += TheProducer->SchedulingTime();
+  }
+  
+  Send( EndpointLoad( Producers.size(), Proxies, SchedulingTime ), 
+				ThePlacement );
 }
 
 /*=============================================================================
@@ -355,6 +433,41 @@ bool ActorManager::CreateLoad::Deserialize(
   else return false;
 }
 
+// The binary codec only carries the fields used for the scheduling, and the 
+// same validity tests are applied as for the text message.
+
+Theron::SerialMessage::Payload 
+ActorManager::CreateLoad::BinarySerialize( void ) const
+{
+  Theron::BinaryWriter Message( "LOAD" );
+  
+  Message << static_cast< const std::string & >( LoadID ) 
+				  << EarliestStartTime << LatestStartTime << SequenceNumber << Profile;
+	  
+  return Message.str();
+}
+
+bool ActorManager::CreateLoad::BinaryDeserialize(
+  const Theron::SerialMessage::Payload & Payload)
+{
+  Theron::BinaryReader Message( Payload, "LOAD" );
+  std::string          ID;
+  
+  Message >> ID >> EarliestStartTime >> LatestStartTime >> SequenceNumber 
+				  >> Profile;
+  
+  if ( !Message || ID.empty() ) return false;
+  
+  LoadID = IDType( ID );
+  
+  if ( ValidID(LoadID) && (EarliestStartTime > 0) && (LatestStartTime > 0)
+       && ( EarliestStartTime <= LatestStartTime ) && (Profile.length() > 0) 
+       && ( SequenceNumber > 0) )
+    return true;
+  else
+    return false;
+}
+
 // The command constructors are simple and easy to understand. The most 
 // elaborate is the one that calls the de-serialising method on a given message 
 // as it will throw the standard invalid argument exception if the 
@@ -363,7 +476,7 @@ bool ActorManager::CreateLoad::Deserialize(
 ActorManager::CreateLoad::CreateLoad(
   const Theron::SerialMessage::Payload & Payload )
 {
-  if ( ! Deserialize( Payload ) )
+  if ( ! Decode( Payload ) )
 	{
 		std::ostringstream ErrorMessage;
 		
@@ -398,6 +511,21 @@ ActorManager::CreateLoad::CreateLoad( IDType ID, Time EST, Time LST,
 
 void ActorManager::NewConsumer( const ActorManager::CreateLoad & TheLoad, 
 																const Theron::Address TheTaskManager )
+{
+  Theron::Address TheConsumer( CreateConsumer( TheLoad, TheTaskManager, true ) );
+  
+  // Then the reward calculator is informed about this new consumer
+  
+  if ( TheConsumer != Theron::Address::Null() )
+		Send( RewardCalculator::AddConsumer( TheConsumer ), Evaluator );
+}
+
+// The consumer creation checks the load and creates the consumer agent if 
+// the load can be scheduled.
+
+Theron::Address ActorManager::CreateConsumer( 
+	const ActorManager::CreateLoad & TheLoad, 
+	const Theron::Address & TheTaskManager, bool SubscribePeers )
 {
   // Indicate that the consumer is being created.
   
@@ -441,7 +569,7 @@ void ActorManager::NewConsumer( const ActorManager::CreateLoad & TheLoad,
 											CompareConsumer ) )
 		{
 			Send( TheLoad, GetAddress() );
-			return;
+			return Theron::Address::Null();
 		}
 			
 		// The if a consumer with the given ID does not exist, it will be created.
@@ -451,14 +579,32 @@ void ActorManager::NewConsumer( const ActorManager::CreateLoad & TheLoad,
 		
     if ( std::none_of( Consumers.begin(), Consumers.end(), CompareConsumer  ) )
 	  {
-      Consumers.emplace_back( new ConsumerAgent( NewConsumerID,
+			// An idle consumer is reused if there is one. The consumer that served
+			// the previous load of this ID must be preferred as it still has the 
+			// name of the new consumer, and no other actor can be given that name.
+			
+			auto Idle = std::find_if( IdleConsumers.begin(), IdleConsumers.end(), 
+																CompareConsumer );
+			
+			if ( Idle == IdleConsumers.end() && !IdleConsumers.empty() )
+				Idle = IdleConsumers.begin();
+			
+			if ( Idle != IdleConsumers.end() )
+			{
+				(*Idle)->Reinitialise( NewConsumerID, 
+					      TheLoad.GetEST(), TheLoad.GetLST(), 
+					      TheLoad.GetSequence(), TheLoad.GetFileName(), TheTaskManager,
+					      SubscribePeers );
+				
+				Consumers.splice( Consumers.end(), IdleConsumers, Idle );
+			}
+			else
+        Consumers.emplace_back( new ConsumerAgent( NewConsumerID,
 					      TheLoad.GetEST(), TheLoad.GetLST(), 
-					      TheLoad.GetSequence(), TheLoad.GetFileName(), TheTaskManager ));
+					      TheLoad.GetSequence(), TheLoad.GetFileName(), TheTaskManager,
+					      SubscribePeers ));
 					      
-      // Then the reward calculator is informed about this new consumer
-			
-			Send( RewardCalculator::AddConsumer( Consumers.back()->GetAddress() ), 
-						Evaluator );
+      return Consumers.back()->GetAddress();
 	  }
     #ifdef CoSSMic_DEBUG
       else       
@@ -467,6 +613,139 @@ void ActorManager::NewConsumer( const ActorManager::CreateLoad & TheLoad,
     #endif
   }
   
+  return Theron::Address::Null();
+}
+
+// -----------------------------------------------------------------------------
+// Batches of loads
+// -----------------------------------------------------------------------------
+//
+// The text form of the batch is the command and the number of loads on the 
+// first line followed by one line for each load in the format of the single 
+// load message.
+
+Theron::SerialMessage::Payload ActorManager::CreateLoads::Serialize( void ) const
+{
+  std::ostringstream Message;
+  
+  Message << "LOADS " << Loads.size() << std::endl;
+  
+  for ( const CreateLoad & TheLoad : Loads )
+    Message << TheLoad.Serialize();
+  
+  return Message.str();
+}
+
+bool ActorManager::CreateLoads::Deserialize(
+  const Theron::SerialMessage::Payload & Payload)
+{
+  std::istringstream Message( Payload );
+  std::string        Command;
+  std::size_t        NumberOfLoads = 0;
+  
+  Message >> Command >> NumberOfLoads;
+  
+  if ( !Message || ( Command != "LOADS" ) ) return false;
+  
+  Loads.clear();
+  Message.ignore( std::numeric_limits< std::streamsize >::max(), '\n' );
+  
+  for ( std::size_t i = 0; i < NumberOfLoads; i++ )
+  {
+    std::string LoadLine;
+    CreateLoad  TheLoad;
+    
+    if ( !std::getline( Message, LoadLine ) || 
+         !TheLoad.Deserialize( LoadLine ) )
+      return false;
+    
+    Loads.push_back( TheLoad );
+  }
+  
+  return true;
+}
+
+// The binary form stores the binary payload of each load as a string field.
+
+Theron::SerialMessage::Payload 
+ActorManager::CreateLoads::BinarySerialize( void ) const
+{
+  Theron::BinaryWriter Message( "LOADS" );
+  
+  Message << static_cast< std::uint64_t >( Loads.size() );
+  
+  for ( const CreateLoad & TheLoad : Loads )
+    Message << TheLoad.BinarySerialize();
+  
+  return Message.str();
+}
+
+bool ActorManager::CreateLoads::BinaryDeserialize(
+  const Theron::SerialMessage::Payload & Payload)
+{
+  Theron::BinaryReader Message( Payload, "LOADS" );
+  std::uint64_t        NumberOfLoads = 0;
+  
+  Message >> NumberOfLoads;
+  Loads.clear();
+  
+  for ( std::uint64_t i = 0; ( i < NumberOfLoads ) && Message; i++ )
+  {
+    Theron::SerialMessage::Payload LoadPayload;
+    CreateLoad                     TheLoad;
+    
+    Message >> LoadPayload;
+    
+    if ( !Message || !TheLoad.BinaryDeserialize( LoadPayload ) )
+      return false;
+    
+    Loads.push_back( TheLoad );
+  }
+  
+  return static_cast< bool >( Message );
+}
+
+// The handler creates the consumers for all the loads without letting them 
+// subscribe to the Session Layer. The consumers created are then added to 
+// the reward calculator and subscribed to the Session Layer in one message 
+// each.
+
+void ActorManager::NewConsumers( const ActorManager::CreateLoads & TheLoads, 
+																 const Theron::Address TheTaskManager )
+{
+  std::vector< Theron::Address > NewConsumerAddresses;
+  
+  // Consumers reused from the pool know the peers up to the membership 
+  // version of their previous load, and the consumers are subscribed in one 
+  // request for each version so that the reused consumers only receive the 
+  // changes since their previous subscription.
+  
+  std::map< Theron::SessionLayerMessages::MembershipVersion, 
+					  std::set< Theron::Address > > Subscriptions;
+  
+  NewConsumerAddresses.reserve( TheLoads.GetLoads().size() );
+  
+  for ( const CreateLoad & TheLoad : TheLoads.GetLoads() )
+  {
+    Theron::Address TheConsumer( 
+										CreateConsumer( TheLoad, TheTaskManager, false ) );
+    
+    if ( TheConsumer != Theron::Address::Null() )
+    {
+      NewConsumerAddresses.push_back( TheConsumer );
+      Subscriptions[ Consumers.back()->KnownPeerVersion() ].insert( TheConsumer );
+    }
+  }
+  
+  if ( !NewConsumerAddresses.empty() )
+  {
+    Send( RewardCalculator::AddConsumers( NewConsumerAddresses ), Evaluator );
+    
+    for ( const auto & [ Version, Subscribers ] : Subscriptions )
+      Send( Theron::SessionLayerMessages::NewPeerSubscription( Subscribers, 
+																															 Version ),
+						Theron::Network::GetAddress( Theron::Network::Layer::Session ) );
+  }
 }
 
 /*=============================================================================
@@ -507,6 +786,35 @@ bool ActorManager::DeleteLoad::Deserialize(
   else return false;
 }
 
+// The binary codec writes the IDs as strings with the energy in between
+
+Theron::SerialMessage::Payload 
+ActorManager::DeleteLoad::BinarySerialize( void ) const
+{
+  Theron::BinaryWriter Message( "DELETE_LOAD" );
+  
+  Message << static_cast< const std::string & >( LoadID ) << TotalEnergy 
+				  << static_cast< const std::string & >( ProducerID );
+  
+  return Message.str();
+}
+
+bool ActorManager::DeleteLoad::BinaryDeserialize(
+  const Theron::SerialMessage::Payload & Payload )
+{
+  Theron::BinaryReader Message( Payload, "DELETE_LOAD" );
+  std::string          Load, TheProducer;
+  
+  Message >> Load >> TotalEnergy >> TheProducer;
+  
+  if ( !Message || Load.empty() || TheProducer.empty() ) return false;
+  
+  LoadID     = IDType( Load );
+  ProducerID = IDType( TheProducer );
+  
+  return true;
+}
+
 // The previous de-serialising method is directly invoked by the constructor 
 // accepting the serialised payload
 
@@ -514,7 +822,7 @@ ActorManager::DeleteLoad::DeleteLoad(
   const Theron::SerialMessage::Payload & Payload )
 : LoadID(), ProducerID(), TotalEnergy(0)
 {
-  if ( ! Deserialize( Payload ) )
+  if ( ! Decode( Payload ) )
 	{
 		std::ostringstream ErrorMessage;
 		
@@ -592,6 +900,30 @@ void ActorManager::RewardComputed( const ActorManager::AcknowledgeEnergy & Ack,
 	Send( ShutdownMessage(), Ack.RewardedConsumer );
 }
 
+/*=============================================================================
+
+ Checkpoint
+
+=============================================================================*/
+//
+// The checkpoint is simply forwarded to all the actors of the household that 
+// have state to save. The consumers pending deletion are included since their
+// learned probabilities are only persisted when they are recycled. Producers
+// without state, like the grid, will just ignore the message.
+
+void ActorManager::SaveCheckpoint( const Checkpoint & TheCheckpoint, 
+																   const Theron::Address TheTaskManager )
+{
+	for ( auto & TheProducer : Producers )
+		Send( TheCheckpoint, TheProducer->GetAddress() );
+	
+	for ( auto & ConsumerList : { &Consumers, &DeletedConsumers, &IdleConsumers } )
+		for ( auto & TheConsumer : *ConsumerList )
+			Send( TheCheckpoint, TheConsumer->GetAddress() );
+	
+	Send( TheCheckpoint, Evaluator );
+}
+
 /*=============================================================================
 
  Shut down management
@@ -621,6 +953,20 @@ bool ActorManager::ShutdownMessage::Deserialize(
     return false;
 }
 
+// The binary shut down message is just the tag
+
+Theron::SerialMessage::Payload 
+ActorManager::ShutdownMessage::BinarySerialize( void ) const
+{
+  return Theron::BinaryWriter( "SHUTDOWN" ).str();
+}
+
+bool ActorManager::ShutdownMessage::BinaryDeserialize(
+  const Theron::SerialMessage::Payload & Payload ) 
+{
+  return static_cast< bool >( Theron::BinaryReader( Payload, "SHUTDOWN" ) );
+}
+
 // The message constructor uses the Deserialize function to check if this is 
 // the right type of message, and throw an exception if it is not.
 
@@ -628,7 +974,7 @@ ActorManager::ShutdownMessage::ShutdownMessage(
   const Theron::SerialMessage::Payload & Payload)
 : ShutdownMessage()
 {
-  if ( ! Deserialize( Payload ) )
+  if ( ! Decode( Payload ) )
 	{
 		std::ostringstream ErrorMessage;
 		
@@ -709,6 +1055,10 @@ void ActorManager::ShutDownHandler(
 	
 	HouseholdTaskManager = TheTaskManager;
 	GlobalShutDown 			 = true;
+	
+	// The idle consumers have no loads and they can be deleted directly.
+	
+	IdleConsumers.clear();
 }
 
 // -----------------------------------------------------------------------------
@@ -737,7 +1087,13 @@ void ActorManager::ShutDownComplete( const ConfirmShutDown & Confirmation,
 		
 	  Send( DeleteLoad( ConsumerID, 0.0, ProducerID ), HouseholdTaskManager );
 	 
-		DeletedConsumers.erase( TheConsumer );
+		// The consumer is kept for reuse unless the pool is full or the system 
+		// is shutting down.
+		
+		if ( !GlobalShutDown && ( IdleConsumers.size() < ConsumerPoolSize ) )
+			IdleConsumers.splice( IdleConsumers.end(), DeletedConsumers, TheConsumer );
+		else
+			DeletedConsumers.erase( TheConsumer );
 		
     #ifdef CoSSMic_DEBUG
       Theron::ConsolePrint DebugMessage;
@@ -787,13 +1143,14 @@ void ActorManager::ShutDownComplete( const ConfirmShutDown & Confirmation,
 ******************************************************************************/
 
 ActorManager::ActorManager( const Theron::Address & TheCalculator,
-												    double ToleranceForSolution, int EvaluationLimit  )
+												    double ToleranceForSolution, int EvaluationLimit, 
+														const Theron::Address & ThePlacement )
 : Actor( ActorManagerName ),
   StandardFallbackHandler( ActorManagerName ),
   DeserializingActor( ActorManagerName ),
   Producers(), DeletedProducers(), 
-  Consumers(), DeletedConsumers(), 
-  HouseholdTaskManager(), Evaluator( TheCalculator )
+  Consumers(), DeletedConsumers(), IdleConsumers(),
+  HouseholdTaskManager(), Evaluator( TheCalculator ), Placement( ThePlacement )
 {
 	if ( ToleranceForSolution > FixedSchedulingDelay )
 	  SolutionTolerance = ToleranceForSolution;
@@ -807,9 +1164,12 @@ ActorManager::ActorManager( const Theron::Address & TheCalculator,
   // the actor manager
   
   RegisterHandler(this, &ActorManager::CreateProducer   );
+  RegisterHandler(this, &ActorManager::ReportLoad       );
   RegisterHandler(this, &ActorManager::NewConsumer      );
+  RegisterHandler(this, &ActorManager::NewConsumers     );
   RegisterHandler(this, &ActorManager::RemoveConsumer   );
 	RegisterHandler(this, &ActorManager::RewardComputed   );
+	RegisterHandler(this, &ActorManager::SaveCheckpoint   );
   RegisterHandler(this, &ActorManager::ShutDownHandler  );	
 	RegisterHandler(this, &ActorManager::ShutDownComplete );
 } 
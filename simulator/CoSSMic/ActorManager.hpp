@@ -38,6 +38,7 @@
 #define ACTOR_MANAGER
 
 #include <list>
+#include <vector>
 #include <set>
 #include <memory>
 #include <limits>
@@ -46,6 +47,7 @@
 #include <sstream>
 #include <stdexcept>
 #include <optional>
+#include <chrono>
 
 #include "Actor.hpp"								// The Theron++ actor framework
 #include "SerialMessage.hpp"				// For network messages
@@ -58,6 +60,7 @@
 #include "TimeInterval.hpp"         // For the fixed schedule delay
 #include "IDType.hpp"               // ID format
 #include "Producer.hpp"             // The Producer (PV panels)
+#include "Checkpoint.hpp"           // Snapshots of the household state
 
 // All the code that is specific to the CoSSMic project is isolated in its own
 // name space. 
@@ -119,6 +122,15 @@ private:
   // attaching to a producer that may provide energy. 
   
   std::list< std::shared_ptr< ConsumerAgent > > Consumers, DeletedConsumers;
+  
+  // Consumers that have completed their shut down are kept in a pool for 
+  // reuse by later loads since the creation and deletion of an actor is 
+  // expensive. There is an upper limit to the number of idle consumers kept,
+  // and consumers beyond this limit are deleted.
+  
+  constexpr static std::size_t ConsumerPoolSize = 64;
+  
+  std::list< std::shared_ptr< ConsumerAgent > > IdleConsumers;
 	  
   // When searching for a solution it is useful to limit the accuracy needed 
   // or the number of iterations the solvers should be allowed to compute a 
@@ -190,6 +202,10 @@ public:
 	    Serialize( void ) const override;
     virtual bool 
 	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
     
   public:
     
@@ -241,14 +257,58 @@ public:
     {}
   };
   
-  // The add producer message is handled by the create producer method. The 
-  // sender is insignificant.
+  // The add producer message is handled by the create producer method. If 
+  // there is a producer placement service on this endpoint, see the producer
+  // placement header, the command from the task manager is forwarded to the 
+  // placement service, which either sends it back to create the producer 
+  // locally or hands it to the actor manager on a less loaded endpoint. The 
+  // producer is created directly if the command comes from the placement 
+  // service, or if there is no placement service.
 
 private:
   
+  Theron::Address Placement;
+  
   void CreateProducer( const AddProducer & Command, 
                        const Theron::Address TheTaskManager );
 
+  // The placement service asks for the load of this endpoint with a load 
+  // query, and the actor manager responds with the number of producers, the 
+  // number of consumer proxies they serve, and the total time they have spent
+  // computing schedules. These messages stay on the endpoint and need no 
+  // serialisation.
+  
+public:
+  
+  class LoadQuery
+  {
+  public:
+    
+    LoadQuery( void ) = default;
+    LoadQuery( const LoadQuery & Other ) = default;
+  };
+  
+  class EndpointLoad
+  {
+  public:
+    
+    const std::size_t 							Producers, Proxies;
+    const std::chrono::milliseconds SchedulingTime;
+    
+    EndpointLoad( std::size_t NumberOfProducers, std::size_t NumberOfProxies, 
+								  std::chrono::milliseconds TotalSchedulingTime )
+    : Producers( NumberOfProducers ), Proxies( NumberOfProxies ),
+      SchedulingTime( TotalSchedulingTime )
+    { }
+    
+    EndpointLoad( const EndpointLoad & Other ) = default;
+  };
+  
+private:
+  
+  void ReportLoad( const LoadQuery & TheQuery, 
+								   const Theron::Address ThePlacement );
+
   // ---------------------------------------------------------------------------
   // Load creation
   // ---------------------------------------------------------------------------
@@ -258,6 +318,8 @@ private:
 
 public:
   
+  class CreateLoads;
+  
   class CreateLoad : public Theron::SerialMessage
   {
   private:
@@ -268,6 +330,10 @@ public:
     std::string  Profile;		     		 // CSV file name for the load profile
     unsigned int SequenceNumber;	   // The number of the run for the device
 
+    // The batch of loads below reuses the codecs of the single load message
+    
+    friend class CreateLoads;
+
     // The mandatory functions for messages to be sent over the network must 
     // also be defined.
 
@@ -277,6 +343,10 @@ public:
 	    Serialize( void ) const override;
     virtual bool 
 	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
         
   public:
     
@@ -354,6 +424,64 @@ private:
     
   void NewConsumer( const CreateLoad & TheLoad, 
 										const Theron::Address TheTaskManager );
+  
+  // The actual creation of the consumer agent is shared with the handler for 
+  // batches of loads below. It returns the address of the consumer agent 
+  // created, or the Null address if no consumer was created for the load.
+  
+  Theron::Address CreateConsumer( const CreateLoad & TheLoad, 
+																  const Theron::Address & TheTaskManager,
+																  bool SubscribePeers );
+
+  // When many loads are created at nearly the same time, they can be sent 
+  // as one message containing all the loads. The consumers are then created 
+  // in bulk, added to the reward calculator with one message, and subscribed 
+  // to the Session Layer with one request.
+  
+public:
+  
+  class CreateLoads : public Theron::SerialMessage
+  {
+  private:
+    
+    std::vector< CreateLoad > Loads;
+    
+	protected:
+		
+    virtual Theron::SerialMessage::Payload 
+	    Serialize( void ) const override;
+    virtual bool 
+	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
+    
+  public:
+    
+    inline const std::vector< CreateLoad > & GetLoads( void ) const
+    { return Loads; }
+    
+    CreateLoads( const std::vector< CreateLoad > & TheLoads )
+    : Loads( TheLoads )
+    { }
+    
+    CreateLoads( const CreateLoads & OtherMessage )
+    : Loads( OtherMessage.Loads )
+    { }
+    
+    inline CreateLoads( void )
+    : Loads()
+    { }
+    
+    virtual ~CreateLoads( void )
+    { }
+  };
+  
+private:
+  
+  void NewConsumers( const CreateLoads & TheLoads, 
+										 const Theron::Address TheTaskManager );
 
 	// ---------------------------------------------------------------------------
   // Load deletion
@@ -414,6 +542,10 @@ public:
 	    Serialize( void ) const override;
     virtual bool 
 	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
     
   public:
     
@@ -533,6 +665,20 @@ private:
 	// and the corresponding handler is defined below under the shut down 
 	// management.
 	
+  // ---------------------------------------------------------------------------
+  // Checkpoint
+  // ---------------------------------------------------------------------------
+  // The household's state can be written to a snapshot directory, see the 
+  // checkpoint header. The checkpoint message is sent from the task manager 
+  // when the actors are at rest, and the Actor Manager forwards it to the 
+  // producers, to all consumers including the idle consumers whose learned 
+  // probabilities have not yet been persisted, and to the reward calculator.
+	
+private:
+	
+	void SaveCheckpoint( const Checkpoint & TheCheckpoint, 
+											 const Theron::Address TheTaskManager );
+	
   // ---------------------------------------------------------------------------
   // Shut down
   // ---------------------------------------------------------------------------
@@ -559,6 +705,10 @@ public:
 	    Serialize( void ) const override;
     virtual bool 
 	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
 
     // There are two constructors: one with no arguments and one taking the 
     // serialised message payload and throwing an exception if the payload is 
@@ -637,13 +787,15 @@ private:
   // The constructor is associated with a network end point and takes the 
   // solution tolerance and the maximum number of objective function evaluations 
   // as input parameters. Both have default values, and the number of 
-  // evaluations is by default unlimited.
+  // evaluations is by default unlimited. The address of the producer placement
+  // service is optional, and producers are always created locally without it.
   
 public:
   
     ActorManager ( const Theron::Address & TheCalculator, 
 									 double ToleranceForSolution = 1e-8, 
-									 int EvaluationLimit = std::numeric_limits<int>::max() );
+									 int EvaluationLimit = std::numeric_limits<int>::max(),
+									 const Theron::Address & ThePlacement = Theron::Address::Null() );
 
   // There is a destructor to ensure that all created actors are properly 
   // destroyed when the actor manager terminates. It currently takes care of 
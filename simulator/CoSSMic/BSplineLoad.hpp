@@ -79,11 +79,34 @@
 #include <vector>
 #include <initializer_list>
 #include <type_traits>
+#include <algorithm>				// Binary search for the knot span
+#include <iterator>					// Distance of iterators
+#include <sstream>					// For error reporting
+#include <stdexcept>				// For standard exceptions
+#include <stddef.h>					// For size_t
 
 namespace BSpline {
   
 /******************************************************************************
   Base polynomial
+  
+  The basis function N(i,p) of degree p is only non-zero on the knot interval
+  [u(i), u(i+p+1)), and for a given parameter value t there are therefore only
+  p+1 basis functions that are non-zero, namely the ones N(k-p,p),...,N(k,p) 
+  where k is the knot span such that u(k) <= t < u(k+1). Evaluating the 
+  Cox-de Boor recursion for each of these functions would repeat the lower 
+  degree terms many times, and the number of terms grows exponentially with 
+  the degree. Instead all the p+1 non-zero functions are computed together 
+  by the triangular scheme of de Boor (algorithm A2.2 in Piegl and Tiller's 
+  "The NURBS Book"), which needs O(p²) operations.
+  
+  The knot span is found by binary search, but the last span found is 
+  remembered and tested first since the parameter values will often be 
+  evaluated in increasing order. For the regression over many runs of an 
+  appliance the basis functions at all the sample times can be computed once
+  and stored in a table with the first non-zero index and the p+1 values for
+  each sample time.
+  
 *******************************************************************************/
 
 class Basis
@@ -92,24 +115,170 @@ protected:
   
   std::vector< double > Knots;
   
+  // The cached span is the span of the last evaluation. It is mutable since 
+  // it does not change the basis, but it means that the same basis object 
+  // should not be used concurrently by several threads.
+  
+  mutable size_t SpanCache;
+  
+  // The number of knots must be sufficient for at least one basis function of
+  // the given degree, and it is the index of the last basis function that is 
+  // returned.
+  
+  size_t LastFunction( unsigned int Degree ) const
+  {
+    if ( Knots.size() < Degree + 2 )
+    {
+      std::ostringstream ErrorMessage;
+      
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << Knots.size() << " knots are too few for a B-spline "
+                   << "basis of degree " << Degree;
+      
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+    
+    return Knots.size() - Degree - 2;
+  }
+  
 public:
   
+  // The knot span is the index k in [p,n] of the knot interval containing 
+  // the parameter value. Values before the first interval and after the last
+  // are assigned to the first and last span respectively. The hint is tested 
+  // first and then its successor before the binary search is used.
+  
+  size_t KnotSpan( unsigned int Degree, double t, size_t Hint ) const
+  {
+    const size_t n = LastFunction( Degree );
+    
+    if ( t >= Knots[ n + 1 ] ) return n;
+    if ( t <= Knots[ Degree ] ) return Degree;
+    
+    for ( size_t k = std::max< size_t >( Hint, Degree ); 
+          ( k <= n ) && ( k <= Hint + 1 ); k++ )
+      if ( ( Knots[k] <= t ) && ( t < Knots[ k + 1 ] ) )
+        return k;
+    
+    auto Upper = std::upper_bound( Knots.begin() + Degree, 
+                                   Knots.begin() + n + 1, t );
+    
+    return std::distance( Knots.begin(), Upper ) - 1;
+  }
+  
+  inline size_t KnotSpan( unsigned int Degree, double t ) const
+  {
+    SpanCache = KnotSpan( Degree, t, SpanCache );
+    return SpanCache;
+  }
+  
+  // The non-zero basis functions N(k-p,p),...,N(k,p) for the span k are 
+  // computed into the given vector, which is resized to p+1 elements.
+  
+  void NonZero( unsigned int Degree, double t, size_t Span, 
+                std::vector< double > & Values ) const
+  {
+    std::vector< double > Left( Degree + 1 ), Right( Degree + 1 );
+    
+    Values.assign( Degree + 1, 0.0 );
+    Values[0] = 1.0;
+    
+    for ( unsigned int j = 1; j <= Degree; j++ )
+    {
+      Left[j]  = t - Knots[ Span + 1 - j ];
+      Right[j] = Knots[ Span + j ] - t;
+      
+      double Saved = 0.0;
+      
+      for ( unsigned int r = 0; r < j; r++ )
+      {
+        double Term = Values[r] / ( Right[ r + 1 ] + Left[ j - r ] );
+        
+        Values[r] = Saved + Right[ r + 1 ] * Term;
+        Saved     = Left[ j - r ] * Term;
+      }
+      
+      Values[j] = Saved;
+    }
+  }
+  
   // The operator takes the indices (i,j) and the parameter t for which the 
-  // polynomial is to be evaluated, and produces the recursive solution.
+  // polynomial is to be evaluated, and returns the value of the basis 
+  // function from the non-zero functions at t.
+  
+  double operator() (unsigned int KnotInterval, unsigned int Degree, double t)
+  {
+    const size_t Span = KnotSpan( Degree, t );
+    
+    if ( ( KnotInterval + Degree < Span ) || ( Span < KnotInterval ) )
+      return 0.0;
+    
+    std::vector< double > Values;
+    
+    NonZero( Degree, t, Span, Values );
+    return Values[ KnotInterval + Degree - Span ];
+  }
+  
+  // The table of basis functions for a range of parameter values stores the 
+  // index of the first non-zero function for each parameter value, and the 
+  // p+1 non-zero values of each parameter value one after the other. Sorted 
+  // parameter values will find the span from the hint.
   
-  double operator() (unsigned int KnotInterval, unsigned int Degree, double t);
+  class Table
+  {
+  public:
+    
+    unsigned int          Degree;
+    std::vector< size_t > FirstFunction;
+    std::vector< double > Values;
+    
+    inline double Value( size_t Sample, size_t Function ) const
+    {
+      if ( ( Function < FirstFunction[ Sample ] ) || 
+           ( FirstFunction[ Sample ] + Degree < Function ) )
+        return 0.0;
+      else
+        return Values[ Sample * ( Degree + 1 ) + Function 
+                       - FirstFunction[ Sample ] ];
+    }
+  };
+  
+  template< class IteratorType >
+  Table Evaluate( unsigned int Degree, IteratorType Begin, 
+                  IteratorType End ) const
+  {
+    Table TheTable;
+    std::vector< double > Values;
+    size_t Span = Degree;
+    
+    TheTable.Degree = Degree;
+    TheTable.FirstFunction.reserve( std::distance( Begin, End ) );
+    TheTable.Values.reserve( std::distance( Begin, End ) * ( Degree + 1 ) );
+    
+    for ( IteratorType t = Begin; t != End; ++t )
+    {
+      Span = KnotSpan( Degree, *t, Span );
+      NonZero( Degree, *t, Span, Values );
+      
+      TheTable.FirstFunction.push_back( Span - Degree );
+      TheTable.Values.insert( TheTable.Values.end(), 
+                              Values.begin(), Values.end() );
+    }
+    
+    return TheTable;
+  }
   
   // The constructor basically gets the knots either directly as a vector or 
   // as iterators to some container, or as an initialiser list. In all cases 
   // the actual initialisation will be done by the standard 
   
   Basis( const std::vector< double > GivenKnots )
-  : Knots( GivenKnots )
+  : Knots( GivenKnots ), SpanCache( 0 )
   { }
   
   template< class IteratorType >
   Basis( IteratorType Begin, IteratorType End )
-  : Knots( Begin, End )
+  : Knots( Begin, End ), SpanCache( 0 )
   { 
     static_assert( 
       std::is_floating_point< typename IteratorType::value_type >::value,
@@ -117,19 +286,20 @@ public:
   }
   
   Basis( const std::initializer_list< double > & InitialValues )
-  : Knots( InitialValues )
+  : Knots( InitialValues ), SpanCache( 0 )
   { }
   
   // There is also a default constructor to be used when the knot values will 
   // be assigned later, and therefore an assignment operator is provided.
   
   Basis( void )
-  : Knots()
+  : Knots(), SpanCache( 0 )
   { }
   
   void operator= ( const std::vector< double > & GivenKnots )
   {
-    Knots = GivenKnots;
+    Knots     = GivenKnots;
+    SpanCache = 0;
   }
 };
 
@@ -137,15 +307,59 @@ public:
   The Curve
   
   The curve extends the basis with control point information, and basically 
-  implement De Boor's algorithm for computing the curve points.
+  implement De Boor's algorithm for computing the curve points. The curve 
+  point is the sum of the p+1 control points of the non-zero basis functions 
+  at the parameter value, weighted by the basis function values.
   
 *******************************************************************************/
 
 class Curve : private Basis
 {
+private:
+  
+  unsigned int          Degree;
+  std::vector< double > ControlPoints;
+  
 public:
   
-  using Basis::operator();  
+  using Basis::operator();
+  
+  double operator() ( double t ) const
+  {
+    const size_t Span = KnotSpan( Degree, t, SpanCache );
+    std::vector< double > Values;
+    double Point = 0.0;
+    
+    SpanCache = Span;
+    NonZero( Degree, t, Span, Values );
+    
+    for ( unsigned int j = 0; j <= Degree; j++ )
+      Point += Values[j] * ControlPoints[ Span - Degree + j ];
+    
+    return Point;
+  }
+  
+  // The constructor requires one control point for each basis function
+  
+  Curve( const std::vector< double > & GivenKnots, 
+         const std::vector< double > & GivenControlPoints, 
+         unsigned int TheDegree )
+  : Basis( GivenKnots ), Degree( TheDegree ), 
+    ControlPoints( GivenControlPoints )
+  {
+    if ( ControlPoints.size() != LastFunction( Degree ) + 1 )
+    {
+      std::ostringstream ErrorMessage;
+      
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "A B-spline curve of degree " << Degree << " with "
+                   << Knots.size() << " knots needs " 
+                   << LastFunction( Degree ) + 1 << " control points, and "
+                   << ControlPoints.size() << " were given";
+      
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+  }
 };
 
 }	// Name space BSpline
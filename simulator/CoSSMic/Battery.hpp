@@ -89,6 +89,9 @@
 #define COSSMIC_BATTERY
 
 #include <list>			 							// The standard list
+#include <memory>									// Shared battery banks
+#include <sstream>								// For error reporting
+#include <stdexcept>							// For standard exceptions
 
 #include "Actor.hpp"	 						// The Theron++ actor framework
 #include "StandardFallbackHandler.hpp"
@@ -98,6 +101,7 @@
 #include "Interpolation.hpp"	 		// The interpolated function
 #include "TimeInterval.hpp"	 			// CoSSMic time and intervals
 #include "Producer.hpp"		 				// Generic CoSSMic producer
+#include "BatteryBank.hpp"				// Batch simulated batteries
 
 
 // All the code specific to the CoSSMic project belongs to the CoSSMic name 
@@ -193,6 +197,70 @@ protected:
   // of the load so a requested time stamp can be easily checked against the 
   // domain.
   
+  // ---------------------------------------------------------------------------
+  // Precomputed trajectories
+  // ---------------------------------------------------------------------------
+  //
+  // For neighbourhood studies the state of charge of all batteries can be 
+  // computed in advance by a battery bank given the net current of each 
+  // battery. The battery is then attached to its column in the bank, and the 
+  // state of charge and voltage are looked up in the bank's trajectories. The 
+  // parameters of the battery are provided so that the battery can be added 
+  // to the bank.
+  
+private:
+  
+  std::shared_ptr< const BatteryBank > Trajectories;
+  size_t 															 BankIndex;
+  
+public:
+  
+  inline BatteryBank::Parameters ModelParameters( void ) const
+  {
+		return BatteryBank::Parameters{ BatteryConstantVoltage, 
+			PolarisationConstant, BatteryCapacity, ExponentialZoneAmplitude, 
+			ExpZoneTimeConstantInverse, InternalResistance, MaxChargeCurrent };
+	}
+	
+  inline void AttachTrajectory( std::shared_ptr< const BatteryBank > TheBank, 
+																size_t TheIndex )
+	{
+		Trajectories = TheBank;
+		BankIndex 	 = TheIndex;
+	}
+	
+	inline double StateOfCharge( Time t ) const
+	{
+		if ( Trajectories )
+			return Trajectories->StateOfCharge( BankIndex, t );
+		else
+		{
+			std::ostringstream ErrorMessage;
+			
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "Battery " << GetAddress().AsString() 
+									 << " has no precomputed trajectory";
+			
+			throw std::logic_error( ErrorMessage.str() );
+		}
+	}
+	
+	inline double Voltage( Time t ) const
+	{
+		if ( Trajectories )
+			return Trajectories->Voltage( BankIndex, t );
+		else
+		{
+			std::ostringstream ErrorMessage;
+			
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "Battery " << GetAddress().AsString() 
+									 << " has no precomputed trajectory";
+			
+			throw std::logic_error( ErrorMessage.str() );
+		}
+	}
+
   // ---------------------------------------------------------------------------
   // Constructor
   // ---------------------------------------------------------------------------
@@ -200,6 +268,8 @@ protected:
   // Currently this constructor is only aimed at initialising the model 
   // constants.
   
+protected:
+  
   Battery( const IDType & ProducerID,
 				   double Volts, double Polarisation, double Capacity, 
 					 double Amplitude, double ExpZoneInverse, double Resistance, 
@@ -212,7 +282,8 @@ protected:
 	  BatteryConstantVoltage( Volts ), PolarisationConstant( Polarisation ),
 	  BatteryCapacity( Capacity ), ExponentialZoneAmplitude( Amplitude ),
 	  ExpZoneTimeConstantInverse( ExpZoneInverse ),
-	  InternalResistance( Resistance ), MaxChargeCurrent( MaxCharge )
+	  InternalResistance( Resistance ), MaxChargeCurrent( MaxCharge ),
+	  Trajectories(), BankIndex( 0 )
 	{ }
 };     // End class battery
 
@@ -0,0 +1,206 @@
+/*=============================================================================
+  Battery Bank
+
+  The battery bank steps the state of all batteries in loops over the
+  parameter and state vectors. The loops are written without branches, using
+  minimum and maximum for the limits, so that they can be vectorised, and they
+  are marked as such for the compiler. Please see the header for details.
+
+  Author: Geir Horn, University of Oslo, 2019
+  Contact: Geir.Horn [at] mn.uio.no
+  License: LGPL3.0
+=============================================================================*/
+
+#include <cmath>									// The exponential function
+#include <algorithm>							// Minimum and maximum
+#include <sstream>								// For error reporting
+#include <stdexcept>							// For standard exceptions
+
+#include "BatteryBank.hpp"
+
+namespace CoSSMic
+{
+
+// -----------------------------------------------------------------------------
+// Batteries
+// -----------------------------------------------------------------------------
+//
+// Adding a battery appends its parameters to the parameter vectors and sets
+// its initial state.
+
+size_t BatteryBank::Add( const Parameters & TheBattery,
+												 double InitialStateOfCharge )
+{
+	if ( TheBattery.BatteryCapacity <= 0.0 )
+	{
+		std::ostringstream ErrorMessage;
+
+		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "The battery capacity must be positive";
+
+		throw std::invalid_argument( ErrorMessage.str() );
+	}
+
+	E0.push_back( TheBattery.BatteryConstantVoltage 		);
+	K.push_back ( TheBattery.PolarisationConstant 			);
+	Q.push_back ( TheBattery.BatteryCapacity 						);
+	A.push_back ( TheBattery.ExponentialZoneAmplitude 	);
+	B.push_back ( TheBattery.ExpZoneTimeConstantInverse );
+	R.push_back ( TheBattery.InternalResistance 				);
+	MaxCharge.push_back( TheBattery.MaxChargeCurrent 		);
+
+	ExtractedCharge.push_back( 0.0 );
+	FilteredCurrent.push_back( 0.0 );
+
+	Reset( E0.size() - 1, InitialStateOfCharge );
+
+	Steps = 0;
+	StateOfChargeTrajectory.clear();
+	VoltageTrajectory.clear();
+
+	return E0.size() - 1;
+}
+
+// Resetting a battery sets the extracted charge corresponding to the given
+// state of charge within the allowed range, and the battery is assumed to
+// have been idle.
+
+void BatteryBank::Reset( size_t Battery, double InitialStateOfCharge )
+{
+	const double Capacity = Q.at( Battery );
+
+	ExtractedCharge[ Battery ] = std::min( std::max(
+		( 1.0 - InitialStateOfCharge ) * Capacity, 0.0 ),
+		( 1.0 - ResidualCharge ) * Capacity );
+
+	FilteredCurrent[ Battery ] = 0.0;
+}
+
+// -----------------------------------------------------------------------------
+// Simulation
+// -----------------------------------------------------------------------------
+//
+// The step is done in separate loops for the state and the output so that
+// each loop has only simple arithmetic and can be vectorised. The limits use
+// the floating point minimum and maximum since the standard functions return
+// references that prevent the vectorisation. The charge is counted in Ampere
+// hours, and the filter coefficient is the same for all batteries.
+
+void BatteryBank::Step( const double * NetCurrent, double Seconds,
+												double * StateOfCharge, double * Voltage )
+{
+	const size_t N 		 = E0.size();
+	const double Hours = Seconds / 3600.0,
+							 Alpha = 1.0 - std::exp( -Seconds / FilterTimeConstant );
+
+	const double * Current = NetCurrent;
+	double * Extracted = ExtractedCharge.data(),
+				 * Filtered  = FilteredCurrent.data();
+	const double * Capacity  = Q.data(),
+							 * MaxIn 		 = MaxCharge.data();
+
+	#pragma omp simd
+	for ( size_t i = 0; i < N; i++ )
+	{
+		const double I = std::fmax( Current[i], -MaxIn[i] );
+
+		Extracted[i] = std::fmin( std::fmax( Extracted[i] + I * Hours, 0.0 ),
+														 ( 1.0 - ResidualCharge ) * Capacity[i] );
+		Filtered[i] += Alpha * ( I - Filtered[i] );
+	}
+
+	if ( StateOfCharge != nullptr )
+	{
+		#pragma omp simd
+		for ( size_t i = 0; i < N; i++ )
+			StateOfCharge[i] = 1.0 - Extracted[i] / Capacity[i];
+	}
+
+	if ( Voltage != nullptr )
+	{
+		const double * V0 = E0.data(), * Kp = K.data(), * Ae = A.data(),
+								 * Be = B.data(), * Ri = R.data();
+
+		#pragma omp simd
+		for ( size_t i = 0; i < N; i++ )
+		{
+			const double I = std::fmax( Current[i], -MaxIn[i] );
+
+			Voltage[i] = V0[i]
+			  - Kp[i] * Capacity[i] * ( Extracted[i] + Filtered[i] )
+			          / ( Capacity[i] - Extracted[i] )
+				- Ri[i] * I + Ae[i] * std::exp( -Be[i] * Extracted[i] );
+		}
+	}
+}
+
+// The simulation steps through the rows of the current matrix and stores
+// the values after each step in the trajectories.
+
+void BatteryBank::Simulate( Time Start, Time StepLength,
+														const std::vector< double > & NetCurrents )
+{
+	const size_t N = E0.size();
+
+	if ( ( N == 0 ) || ( StepLength <= 0 ) || ( NetCurrents.size() % N != 0 ) )
+	{
+		std::ostringstream ErrorMessage;
+
+		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "The current matrix of " << NetCurrents.size()
+								 << " values does not have a column for each of the " << N
+								 << " batteries or the time step " << StepLength
+								 << " is not positive";
+
+		throw std::invalid_argument( ErrorMessage.str() );
+	}
+
+	StartTime  = Start;
+	Resolution = StepLength;
+	Steps 		 = NetCurrents.size() / N;
+
+	StateOfChargeTrajectory.resize( NetCurrents.size() );
+	VoltageTrajectory.resize( NetCurrents.size() );
+
+	for ( size_t Row = 0; Row < Steps; Row++ )
+		Step( NetCurrents.data() + Row * N, static_cast< double >( StepLength ),
+					StateOfChargeTrajectory.data() + Row * N,
+					VoltageTrajectory.data() + Row * N );
+}
+
+// The index into the trajectories is the row of the time step containing the
+// time and the column of the battery.
+
+size_t BatteryBank::TrajectoryIndex( size_t Battery, Time t ) const
+{
+	if ( ( Battery < E0.size() ) && ( StartTime <= t ) &&
+			 ( t < StartTime + static_cast< Time >( Steps ) * Resolution ) )
+		return static_cast< size_t >( ( t - StartTime ) / Resolution ) * E0.size()
+					 + Battery;
+	else
+	{
+		std::ostringstream ErrorMessage;
+
+		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "There is no trajectory for battery " << Battery
+								 << " at time " << t;
+
+		throw std::out_of_range( ErrorMessage.str() );
+	}
+}
+
+// The constructor reserves the space for the parameters and the state
+
+BatteryBank::BatteryBank( size_t ExpectedBatteries )
+: E0(), K(), Q(), A(), B(), R(), MaxCharge(),
+  ExtractedCharge(), FilteredCurrent(),
+  StartTime( 0 ), Resolution( 1 ), Steps( 0 ),
+  StateOfChargeTrajectory(), VoltageTrajectory()
+{
+	for ( std::vector< double > * Values :
+				{ &E0, &K, &Q, &A, &B, &R, &MaxCharge, &ExtractedCharge,
+				  &FilteredCurrent } )
+		Values->reserve( ExpectedBatteries );
+}
+
+}      // End name space CoSSMic
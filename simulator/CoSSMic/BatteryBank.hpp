@@ -0,0 +1,177 @@
+/*=============================================================================
+  Battery Bank
+
+  The battery actor evaluates Tremblay's and Dessaint's model [1] for one
+  battery at the time, and the model evaluation is done by virtual functions
+  at each event time of the battery. Neighbourhood studies with a battery in
+  every household will need to step thousands of batteries over a day at a
+  resolution of one minute, and this is better done for all batteries at the
+  same time.
+
+  The battery bank keeps the model parameters and the state of all the
+  batteries in a structure of arrays, i.e. there is one contiguous vector for
+  each parameter and each state variable with one element per battery. A time
+  step is then a sequence of loops over all batteries without branches, and
+  the compiler will vectorise these loops including the exponential function
+  of the exponential zone of the battery. The source file for the bank is
+  therefore compiled with the flags enabling the vectorised mathematical
+  functions of the C library, see the makefile.
+
+  The net current out of each battery at each time step is given as a matrix
+  with one row per time step and one column per battery, and the bank computes
+  the state of charge (SOC) and the terminal voltage of all batteries for all
+  time steps. The battery actors can then serve their queries from these
+  precomputed trajectories. The model is the same as documented for the
+  battery actor: with the extracted charge it = Integral[I(t),0,T]
+
+  V(T) = E0 - K * Q * (it + I'(T)) / (Q - it) - R * I(T) + A * exp( -B * it )
+
+  where I'(T) is the first order low pass filtered current with a time
+  constant C of about 30 seconds. The filter is integrated exactly over the
+  time step assuming that the current is constant over the step. The charging
+  current is limited to the maximum charging current of the battery, and the
+  extracted charge is kept between zero for the full battery and a small
+  residual charge since the polarisation term is singular for the empty
+  battery.
+
+  REFERENCES:
+
+  [1] Olivier Tremblay and Louis-A. Dessaint (2009): "Experimental Validation
+      of a Battery Dynamic Model for EV Applications", Proceedings of the
+      International Battery Hybrid and Fuel Cell Electric Vehicle Symposium
+      (EVS24), 13-16 May in Stavanger, Norway, in the World Electric Vehicle
+      Journal, Vol. 3, pp. 289-298, ISSN 2032-6653
+
+  Author: Geir Horn, University of Oslo, 2019
+  Contact: Geir.Horn [at] mn.uio.no
+  License: LGPL3.0
+=============================================================================*/
+
+#ifndef COSSMIC_BATTERY_BANK
+#define COSSMIC_BATTERY_BANK
+
+#include <vector>									// The structure of arrays
+#include <stddef.h>								// For size_t
+
+#include "TimeInterval.hpp"				// CoSSMic time
+
+namespace CoSSMic
+{
+
+class BatteryBank
+{
+public:
+
+  // ---------------------------------------------------------------------------
+  // Model parameters
+  // ---------------------------------------------------------------------------
+  //
+	// The parameters of one battery are given as a structure with the same
+	// names as the constants of the battery actor.
+
+	class Parameters
+	{
+	public:
+
+		double BatteryConstantVoltage,			// E_0 in Volts
+					 PolarisationConstant,				// K
+					 BatteryCapacity,							// Q in Ampere hours
+					 ExponentialZoneAmplitude, 		// A in Volts
+					 ExpZoneTimeConstantInverse,	// B in 1/Ah
+					 InternalResistance,					// R in Ohm
+					 MaxChargeCurrent;						// in Ampere
+	};
+
+	// The residual charge is the fraction of the capacity that cannot be
+	// extracted from the battery, and the time constant of the current filter
+	// is the value reported by Tremblay and Dessaint.
+
+	static constexpr double ResidualCharge 		 = 0.01,
+													FilterTimeConstant = 30.0;
+
+private:
+
+	// The parameters are stored in one vector each
+
+	std::vector< double > E0, K, Q, A, B, R, MaxCharge;
+
+	// The state of each battery is the extracted charge in Ampere hours and the
+	// filtered current in Ampere.
+
+	std::vector< double > ExtractedCharge, FilteredCurrent;
+
+	// The trajectories are stored in the same layout as the currents, with one
+	// row for each time step, and the time of the first row and the time step
+	// are remembered for the queries.
+
+	Time 									StartTime, Resolution;
+	size_t 								Steps;
+	std::vector< double > StateOfChargeTrajectory, VoltageTrajectory;
+
+	// Finding the row of a given time and battery throws if there is no
+	// trajectory for this time or battery.
+
+	size_t TrajectoryIndex( size_t Battery, Time t ) const;
+
+public:
+
+  // ---------------------------------------------------------------------------
+  // Batteries
+  // ---------------------------------------------------------------------------
+  //
+	// A battery is added with its parameters and the initial state of charge,
+	// and the index of the battery in the bank is returned. Adding batteries
+	// invalidates the stored trajectories.
+
+	size_t Add( const Parameters & TheBattery, double InitialStateOfCharge = 1.0 );
+
+	inline size_t Size( void ) const
+	{ return E0.size(); }
+
+	// The current state of charge of a battery can be read directly from the
+	// extracted charge.
+
+	inline double StateOfCharge( size_t Battery ) const
+	{ return 1.0 - ExtractedCharge.at( Battery ) / Q.at( Battery ); }
+
+	// The state of charge can be reset for a battery so that the bank can be
+	// reused for a new simulation.
+
+	void Reset( size_t Battery, double InitialStateOfCharge = 1.0 );
+
+  // ---------------------------------------------------------------------------
+  // Simulation
+  // ---------------------------------------------------------------------------
+  //
+	// A single time step takes a pointer to the net currents of all batteries
+	// and the length of the step in seconds, and updates the state of all
+	// batteries. If pointers are given for the state of charge and the
+	// terminal voltage, the values after the step are stored there.
+
+	void Step( const double * NetCurrent, double Seconds,
+						 double * StateOfCharge = nullptr, double * Voltage = nullptr );
+
+	// A trajectory is computed from the start time with the given resolution
+	// for as many steps as there are rows in the current matrix. The matrix
+	// must have a column for each battery and is stored row by row. The values
+	// stored for a time step are the values at the end of the step.
+
+	void Simulate( Time Start, Time StepLength,
+								 const std::vector< double > & NetCurrents );
+
+	// The battery actors query the trajectory of their battery at a given time
+	// and will get the values at the end of the time step containing the time.
+
+	inline double StateOfCharge( size_t Battery, Time t ) const
+	{ return StateOfChargeTrajectory[ TrajectoryIndex( Battery, t ) ]; }
+
+	inline double Voltage( size_t Battery, Time t ) const
+	{ return VoltageTrajectory[ TrajectoryIndex( Battery, t ) ]; }
+
+	// The constructor can reserve space for a number of batteries
+
+	BatteryBank( size_t ExpectedBatteries = 0 );
+};
+
+}      // End name space CoSSMic
+#endif // COSSMIC_BATTERY_BANK
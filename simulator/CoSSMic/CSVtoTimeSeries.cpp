@@ -6,8 +6,25 @@ consisting of rows with two columns: One for the time stamp and one for
 the cumulative energy value. The CSV parser is Ben Strasser's fast C++ CSV 
 Reader class [1].
 
+Year long production files with one minute samples are large, and parsing 
+them line by line on one thread dominates the start up of long simulations. 
+Large files are therefore memory mapped and split at line boundaries into 
+chunks that are parsed in parallel into flat time series, which are then 
+concatenated in the order of the chunks. The numbers are converted with 
+std::from_chars [2]. It is correctly rounded, unlike the digit by digit 
+conversion of the CSV parser, and a value may therefore differ in the last 
+binary digit from the value read by the CSV parser. The chunk parser accepts 
+only the well formed lines, and if it finds a line it cannot convert, the 
+file is parsed again by the CSV parser, which then reports the error exactly 
+as before.
+
+The chunks and the preloaded time series are allocated from the memory 
+account of the CSV buffers so that the memory held by the preloaded files can
+be reported, see Theron::MemoryAccounting.
+
 References:
 [1] https://github.com/ben-strasser/fast-cpp-csv-parser
+[2] https://en.cppreference.com/w/cpp/utility/from_chars
 
 Author and Copyright: Geir Horn, 2019
 License: LGPL 3.0
@@ -17,38 +34,292 @@ License: LGPL 3.0
 #include <map>                     // The time series map
 #include <sstream>                 // For error messages
 #include <stdexcept>               // For standard exceptions
+#include <unordered_map>           // Preloaded time series
+#include <mutex>                   // Protecting the preloaded time series
+#include <thread>                  // Parallel parsing of large files
+#include <atomic>                  // The next chunk and the thread count
+#include <exception>               // Passing thread exceptions
+#include <charconv>                // Number conversion
+#include <cstring>                 // Searching for newlines
+#include <vector>                  // The chunks
+#include <algorithm>               // Min and max
 
 #include "CSVtoTimeSeries.hpp"     // Function signature
 #include "csv.h"                   // The CSV parser
+#include "MemoryAccounting.hpp"    // The memory of the CSV buffers
+#include "ProfilerAnnotations.hpp" // Optional profiler zones
 
 
-std::map< CoSSMic::Time, double > 
-CoSSMic::CSVtoTimeSeries( std::string FileName )
+// The preloaded time series are kept by file name, and the map is protected 
+// since the actors reading files run in different threads. They are stored 
+// as flat time series, and converted when a map is requested.
+
+namespace CoSSMic
 {
-  std::map< CoSSMic::Time, double> TimeSeries;	  // The time series to return
-  CoSSMic::Time   	  		  		   TimeStamp;     // To store read time stamp
-  double 		  		  			         Value;	  	    // To store the read value
-  
-  // Parse two columns from the file, using space as separator and ignore only
-  // tabs.
-  
-  io::CSVReader<2, io::trim_chars<'\t'>, io::no_quote_escape<' '> > 
-      CSVParser( FileName ); 
+  static std::mutex PreloadGuard;
+  static std::unordered_map< std::string, TimeSeries > PreloadedTimeSeries;
+
+  // Starting threads costs more than parsing a small file, and files smaller
+  // than the threshold are therefore parsed by the CSV parser. Each thread 
+  // gets a few chunks on average so that a thread being slow to start does 
+  // not delay the others. 
+
+  static std::atomic< unsigned int > ParseThreads( 0 );
+  constexpr std::size_t ParallelParseSize = 1 << 20;
+  constexpr std::size_t MinimumChunkSize  = 1 << 16;
+  constexpr unsigned int ChunksPerThread  = 4;
+
+  // The memory account is looked up the first time it is used
+
+  static std::pmr::memory_resource * CSVMemory( void )
+  {
+    static std::pmr::memory_resource * 
+           CSVAccount( Theron::MemoryAccounting::Resource( "CSV" ) );
+    
+    return CSVAccount;
+  }
+}
+
+void CoSSMic::SetCSVParseThreads( unsigned int Threads )
+{
+  ParseThreads.store( Threads, std::memory_order_relaxed );
+}
+
+// -----------------------------------------------------------------------------
+// Chunk parsing
+// -----------------------------------------------------------------------------
+//
+// A line must hold the time stamp and the value separated by a single space,
+// and tabs are ignored around both fields as done by the CSV parser. A field 
+// is converted only if all its characters are consumed. A failed conversion 
+// or a line with the wrong number of fields is reported by returning false.
+
+namespace CoSSMic
+{
+  static const char * TrimTabs( const char * Begin, const char *& End )
+  {
+    while ( ( Begin != End ) && ( *Begin == '\t' ) ) ++Begin;
+    while ( ( End   != Begin ) && ( *(End - 1) == '\t' ) ) --End;
+    return Begin;
+  }
+
+  template< class NumberType >
+  static bool ConvertField( const char * Begin, const char * End, 
+                            NumberType & Number )
+  {
+    Begin = TrimTabs( Begin, End );
+    
+    auto [ Stop, Error ] = std::from_chars( Begin, End, Number );
+    
+    return ( Begin != End ) && ( Error == std::errc() ) && ( Stop == End );
+  }
+
+  static bool ParseChunk( const char * Begin, const char * End, 
+                          TimeSeries & Chunk )
+  {
+    THERON_PROFILE_ZONE( "CSV::ParseChunk" );
+    
+    Time   TimeStamp;
+    double Value;
+    
+    while ( Begin != End )
+    {
+      const char * LineEnd = static_cast< const char * >( 
+                             std::memchr( Begin, '\n', End - Begin ) );
+      const char * Next    = ( LineEnd == nullptr ? End : LineEnd + 1 );
+      
+      if ( LineEnd == nullptr ) LineEnd = End;
+      if ( ( LineEnd != Begin ) && ( *(LineEnd - 1) == '\r' ) ) --LineEnd;
+      
+      const char * Separator = static_cast< const char * >( 
+                               std::memchr( Begin, ' ', LineEnd - Begin ) );
+      
+      if ( ( Separator == nullptr ) || 
+           ( std::memchr( Separator + 1, ' ', LineEnd - Separator - 1 ) 
+             != nullptr ) ||
+           !ConvertField( Begin, Separator, TimeStamp ) ||
+           !ConvertField( Separator + 1, LineEnd, Value ) )
+        return false;
+      
+      Chunk.Append( TimeStamp, Value );
+      Begin = Next;
+    }
+    
+    return true;
+  }
+
+  // The file is mapped by the CSV parser's mapping, and it is split into 
+  // chunks of about equal size, each extended to the end of its last line. 
+  // The chunks are taken by the threads from a shared counter, and the
+  // function returns false if the file cannot be mapped, if it is too small, 
+  // or if any chunk has a line that could not be converted.
+
+  static bool ParallelParse( const std::string & FileName, 
+                             TimeSeries & TheSeries )
+  {
+  #ifdef CSV_IO_MMAP
+    std::unique_ptr< io::detail::MappedFile > 
+      Mapping( io::detail::MappedFile::open( FileName.c_str() ) );
+    
+    if ( !Mapping ) return false;
+    
+    const char * Begin = Mapping->begin();
+    const char * End   = Mapping->end();
+    std::size_t  Size  = End - Begin;
+    
+    if ( Size < ParallelParseSize ) return false;
+    
+    if ( ( Size >= 3 ) && ( Begin[0] == '\xEF' ) && ( Begin[1] == '\xBB' ) && 
+         ( Begin[2] == '\xBF' ) )
+    {
+      Begin += 3;
+      Size  -= 3;
+    }
+    
+    unsigned int Threads = ParseThreads.load( std::memory_order_relaxed );
+    
+    if ( Threads == 0 )
+      Threads = std::max( 1U, std::thread::hardware_concurrency() );
+    
+    std::size_t NumberOfChunks = std::max< std::size_t >( 1, 
+                std::min< std::size_t >( Threads * ChunksPerThread, 
+                                         Size / MinimumChunkSize ) );
+    
+    std::vector< const char * > Boundaries( 1, Begin );
+    
+    for ( std::size_t Chunk = 1; Chunk < NumberOfChunks; Chunk++ )
+    {
+      const char * Cut = std::max( Boundaries.back(), 
+                                   Begin + Chunk * Size / NumberOfChunks );
+      const char * LineEnd = static_cast< const char * >( 
+                             std::memchr( Cut, '\n', End - Cut ) );
+      
+      if ( ( LineEnd == nullptr ) || ( LineEnd + 1 == End ) ) break;
+      
+      Boundaries.push_back( LineEnd + 1 );
+    }
+    
+    Boundaries.push_back( End );
+    NumberOfChunks = Boundaries.size() - 1;
+    
+    std::vector< TimeSeries > Chunks;
+    std::vector< char >       Converted( NumberOfChunks, 0 );
+    
+    Chunks.reserve( NumberOfChunks );
+    
+    for ( std::size_t Chunk = 0; Chunk < NumberOfChunks; Chunk++ )
+      Chunks.emplace_back( CSVMemory() );
+    
+    Threads = static_cast< unsigned int >( 
+              std::min< std::size_t >( Threads, NumberOfChunks ) );
+    
+    std::atomic< std::size_t >        NextChunk(0);
+    std::vector< std::exception_ptr > Errors( Threads );
+    
+    auto Worker = [&]( unsigned int Thread ){
+      try
+      {
+        for ( std::size_t Chunk = NextChunk++; Chunk < NumberOfChunks;
+              Chunk = NextChunk++ )
+          Converted[ Chunk ] = ParseChunk( Boundaries[ Chunk ], 
+                                           Boundaries[ Chunk + 1 ], 
+                                           Chunks[ Chunk ] );
+      }
+      catch (...)
+      {
+        Errors[ Thread ] = std::current_exception();
+      }
+    };
+    
+    if ( Threads <= 1 )
+      Worker( 0 );
+    else
+    {
+      std::vector< std::thread > Workers;
+      
+      for ( unsigned int Thread = 0; Thread < Threads; Thread++ )
+        Workers.emplace_back( Worker, Thread );
+      
+      for ( std::thread & TheWorker : Workers )
+        TheWorker.join();
+    }
+    
+    for ( std::exception_ptr & Error : Errors )
+      if ( Error ) std::rethrow_exception( Error );
+    
+    if ( std::find( Converted.begin(), Converted.end(), 0 ) 
+         != Converted.end() )
+      return false;
+    
+    std::size_t Samples = 0;
+    
+    for ( const TimeSeries & Chunk : Chunks )
+      Samples += Chunk.size();
+    
+    TheSeries.Clear();
+    TheSeries.Reserve( Samples );
+    
+    for ( const TimeSeries & Chunk : Chunks )
+      TheSeries.Append( Chunk );
+    
+    return true;
+  #else
+    return false;
+  #endif
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Reading time series
+// -----------------------------------------------------------------------------
+
+void CoSSMic::CSVtoTimeSeries( const std::string & FileName, 
+                               TimeSeries & TheSeries )
+{
+  THERON_PROFILE_ZONE_DETAIL( "CSV::CSVtoTimeSeries", FileName );
   
-  // We define the column headers we are looking for provided that the file 
-  // has column headers. Since there are no headers in the file, we simply
-  // define them. However, it is not clear if this is strictly necessary or 
-  // not.
+  {
+    std::lock_guard< std::mutex > Lock( PreloadGuard );
+    auto Preloaded = PreloadedTimeSeries.find( FileName );
+    
+    if ( Preloaded != PreloadedTimeSeries.end() )
+    {
+      TheSeries = Preloaded->second;
+      return;
+    }
+  }
   
-  CSVParser.set_header("Time", "Energy");
+  if ( !ParallelParse( FileName, TheSeries ) )
+  {
+    CoSSMic::Time TimeStamp;     // To store read time stamp
+    double 		  	Value;	  	   // To store the read value
+    
+    // Parse two columns from the file, using space as separator and ignore 
+    // only tabs.
+    
+    io::CSVReader<2, io::trim_chars<'\t'>, io::no_quote_escape<' '> > 
+        CSVParser( FileName ); 
+    
+    // We define the column headers we are looking for provided that the file 
+    // has column headers. Since there are no headers in the file, we simply
+    // define them. However, it is not clear if this is strictly necessary or 
+    // not.
+    
+    CSVParser.set_header("Time", "Energy");
+    
+    TheSeries.Clear();
+    
+    while ( CSVParser.read_row( TimeStamp, Value ) )
+      TheSeries.Append( TimeStamp, Value );
+  }
   
-  while ( CSVParser.read_row( TimeStamp, Value ) )
-    TimeSeries.emplace( TimeStamp, Value );
+  if ( !TheSeries.Sorted() )
+    TheSeries.Normalise();
     
   //  It could be that the CSV file did not contain any valid data and in 
   //  that case the time series will not be valid. 
   
-  if ( TimeSeries.empty() )
+  if ( TheSeries.empty() )
   {
 	  std::ostringstream ErrorMessage;
 	  
@@ -58,8 +329,37 @@ CoSSMic::CSVtoTimeSeries( std::string FileName )
 				   
 	  throw std::invalid_argument( ErrorMessage.str() );
   }
+}
+
+// The map version is kept for the code that needs to modify the time series
+// by time stamp, and it converts the flat time series.
+
+std::map< CoSSMic::Time, double > 
+CoSSMic::CSVtoTimeSeries( std::string FileName )
+{
+  TimeSeries TheSeries;
+  
+  CSVtoTimeSeries( FileName, TheSeries );
+  
+  return TheSeries.ToMap();
+}
+
+// Preloading parses the file and stores the time series unless the file has 
+// already been preloaded.
+
+void CoSSMic::PreloadTimeSeries( const std::string & FileName )
+{
+  {
+    std::lock_guard< std::mutex > Lock( PreloadGuard );
+    
+    if ( PreloadedTimeSeries.count( FileName ) > 0 )
+      return;
+  }
+  
+  TimeSeries TheSeries( CSVMemory() );
   
-  // If the time series contained data, it is just to return the response
+  CSVtoTimeSeries( FileName, TheSeries );
   
-  return TimeSeries;
+  std::lock_guard< std::mutex > Lock( PreloadGuard );
+  PreloadedTimeSeries.emplace( FileName, std::move( TheSeries ) );
 }
@@ -16,11 +16,36 @@ License: LGPL 3.0
 #define CSV_TIME_SERIES_PARSER
 
 #include <map>                    // Time to energy map
+#include <string>                 // File names
 #include "TimeInterval.hpp"       // To have CoSSMic time
+#include "TimeSeries.hpp"         // Flat time series
 
 namespace CoSSMic
 {
   extern std::map< Time, double > CSVtoTimeSeries( std::string FileName );
+  
+  // The flat time series is filled with the samples of the file sorted on 
+  // the time stamps. If the file is not sorted or has duplicated time stamps,
+  // the series is normalised in the same way as the map would be built, i.e.
+  // keeping the first sample of a duplicated time stamp.
+  
+  extern void CSVtoTimeSeries( const std::string & FileName, 
+                               TimeSeries & TheSeries );
+  
+  // Files that will be read many times with the same content, like the load 
+  // profiles and predictions of a simulated neighbourhood read by every 
+  // replication of the simulation, can be preloaded. The time series of a 
+  // preloaded file is then returned without parsing the file again. Files 
+  // that are not preloaded are always parsed since their content may change.
+  
+  extern void PreloadTimeSeries( const std::string & FileName );
+  
+  // Large files are parsed in parallel by the given number of threads, and 
+  // the default value zero uses one thread per hardware core. Setting one 
+  // thread parses large files on the calling thread, but still from the 
+  // memory mapped file.
+  
+  extern void SetCSVParseThreads( unsigned int Threads );
 }      // name space CoSSMic
 #endif // CSV_TIME_SERIES_PARSER
 
@@ -0,0 +1,103 @@
+/*=============================================================================
+  Checkpoint
+
+  A checkpoint is a snapshot of the learned and predicted state of the CoSSMic
+  actors of a household written to a directory so that a simulation can be
+  resumed from the snapshot instead of being replayed from the start. Each
+  actor holding state that cannot be recreated from the event files writes
+  its own part of the snapshot when it receives the checkpoint message:
+
+  Probabilities/ - The learned probabilities of the consumer agents, in the
+                   same format as the probabilities persisted between runs.
+  Predictions/   - The current prediction samples of each predictor as a time
+                   series file that can be given to a new producer.
+  Rewards.dta    - The energy exchange graph of the Shapley value reward
+                   calculator.
+
+  The application owning the simulated clock, i.e. the task manager of the
+  simulator, writes the simulated time of the snapshot and the pending loads,
+  and is responsible for sending the checkpoint message to the Actor Manager
+  when the actor system is at rest, i.e. between two events. The Actor
+  Manager forwards the message to the producers, the consumers and the reward
+  calculator of the household.
+
+  Author: Geir Horn, University of Oslo, 2019
+  Contact: Geir.Horn [at] mn.uio.no
+  License: LGPL3.0
+=============================================================================*/
+
+#ifndef COSSMIC_CHECKPOINT
+#define COSSMIC_CHECKPOINT
+
+#include <string>						// The directory and file names
+#include <sstream>					// For error reporting
+#include <stdexcept>				// For standard exceptions
+#include <cerrno>						// C-style error reporting
+#include <cstring>					// Error strings
+#include <sys/stat.h> 			// makedir
+
+namespace CoSSMic
+{
+
+class Checkpoint
+{
+private:
+
+	std::string Directory;
+
+	// Directories are created if they do not exist. It is not an error if the
+	// directory exists, but it is an error if it cannot be created.
+
+	static void CreateDirectory( const std::string & DirectoryName )
+	{
+		if ( (mkdir( DirectoryName.data(), S_IRWXU | S_IRWXG | S_IRWXO ) != 0) &&
+				 (errno != EEXIST) )
+	  {
+	    std::ostringstream ErrorMessage;
+
+	    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+							     << "Checkpoint directory " << DirectoryName
+									 << " could not be created: " << std::strerror( errno );
+
+	    throw std::runtime_error( ErrorMessage.str() );
+	  }
+	}
+
+public:
+
+	inline std::string GetDirectory( void ) const
+	{ return Directory; }
+
+	// The actors writing their state will obtain the name of a sub-directory
+	// of the snapshot, which is created if needed, or the full name of a file
+	// directly in the snapshot directory.
+
+	inline std::string SubDirectory( const std::string & Name ) const
+	{
+		std::string DirectoryName( Directory + "/" + Name );
+
+		CreateDirectory( DirectoryName );
+		return DirectoryName;
+	}
+
+	inline std::string File( const std::string & Name ) const
+	{ return Directory + "/" + Name; }
+
+	// The constructor creates the snapshot directory so that it exists when
+	// the message is received by the actors.
+
+	Checkpoint( const std::string & TheDirectory )
+	: Directory( TheDirectory )
+	{
+		CreateDirectory( Directory );
+	}
+
+	Checkpoint( const Checkpoint & Other )
+	: Directory( Other.Directory )
+	{ }
+
+	Checkpoint( void ) = delete;
+};
+
+}      // Name space CoSSMic
+#endif // COSSMIC_CHECKPOINT
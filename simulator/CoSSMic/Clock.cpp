@@ -46,15 +46,16 @@ Clock Now;
 // the system clock.
 
 Clock::Clock(void)
-: std::function< Time(void) >()
+: std::function< Time(void) >(), CurrentTime( 0 )
 {
   cURL_data = nullptr;
   
   std::function< Time(void) >::operator= (
     [this](void)->Time{
-      CurrentTime = std::chrono::system_clock::to_time_t( 
-					          std::chrono::system_clock::now()    );
-      return CurrentTime;
+      Time SystemTime = std::chrono::system_clock::to_time_t( 
+					                std::chrono::system_clock::now()    );
+      CurrentTime = SystemTime;
+      return SystemTime;
     }
   );
   
@@ -103,7 +104,7 @@ void Clock::SetURL( const std::string & URL )
       curl_easy_perform( cURL_data );
       #ifdef CoSSMic_DEBUG
         Theron::ConsolePrint DebugMessage;
-        DebugMessage << "Simulator time: " << CurrentTime << std::endl;
+        DebugMessage << "Simulator time: " << CurrentTime.load() << std::endl;
       #endif
       return CurrentTime;
     }
@@ -115,14 +116,16 @@ void Clock::SetURL( const std::string & URL )
 // Fix time
 // -----------------------------------------------------------------------------
 // The fixed time given is set in the clock variable current time,  and the 
-// time function is set just to return this value.
+// time function is set just to return this value. The value may later be 
+// changed by advancing the clock, and the read is therefore an atomic load 
+// matching the store of the advance function.
 
 void Clock::Fix( Time TimeStamp )
 {
   CurrentTime = TimeStamp;
   
   std::function< Time(void) >::operator= (
-    [this](void)->Time{ return CurrentTime; }
+    [this](void)->Time{ return CurrentTime.load( std::memory_order_acquire ); }
     );
 }
 
@@ -142,7 +145,10 @@ size_t Clock::ConvertTime( void * DataReceived, std::size_t DataSize,
   std::istringstream TimeStamp( 
       std::string( static_cast< char * >( DataReceived ), BufferSize ) );
   
-  TimeStamp >> This->CurrentTime;
+  Time               DispatcherTime;
+  
+  TimeStamp >> DispatcherTime;
+  This->CurrentTime = DispatcherTime;
   
   return BufferSize;
 }
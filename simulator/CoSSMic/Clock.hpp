@@ -24,6 +24,13 @@
   dispatcher's clock. The system clock is used by default since it is always 
   available.
   
+  When the simulator's event dispatcher is a Theron++ event manager running in
+  the same process, the REST call is unnecessary. The clock can then follow 
+  the event manager: The event manager pushes every new event time to the 
+  clock before the next event is dispatched, and reading "now" is just an 
+  atomic read of the stored time. The REST call is kept for the deployment 
+  with an external dispatcher.
+  
   ACKNOWLEDGEMENT:
   
   Salvatore Venticinque of Second University of Naples for writing the 
@@ -39,6 +46,7 @@
 #define COSSMIC_CLOCK
 
 #include <functional>   	// to have a generic function
+#include <atomic>					// The current time is read by many threads
 #include <string>		// string manipulation
 #include <curlpp/cURLpp.hpp> 	// to read from the dispatcher
 
@@ -52,8 +60,8 @@ class Clock
 {
 private:
   
-  CURL *  cURL_data;		// To hold the state of the cURL calls
-  Time    CurrentTime;	// To store the current time
+  CURL *  						cURL_data;		// To hold the state of the cURL calls
+  std::atomic< Time > CurrentTime;	// To store the current time
   
 public:
   
@@ -86,6 +94,30 @@ public:
 	// two subsequent readings, the latter must be larger or equal to the former.
 	
 	void SetClockFunction( const std::function< Time(void) > & TheNewClock );
+	
+	// A clock following the event manager in the same process is set up by 
+	// fixing the clock at the event manager's current time and then registering
+	// a Now observer with the event manager to advance the clock when the 
+	// event time advances. The event manager must have been constructed, and 
+	// it must use the CoSSMic time as its event time. This must be done before 
+	// the first event is dispatched.
+	
+	template< class EventManager >
+	void FollowEvents( EventManager & TheEventManager )
+	{
+		Fix( TheEventManager.template Now< Time >() );
+		
+		TheEventManager.AddNowObserver( 
+			[this]( const Time & EventTime ){ Advance( EventTime ); } );
+	}
+	
+	// The time is advanced by storing the new time. This is lock-free and it 
+	// can be called from any thread. It is only meaningful for a fixed clock.
+	
+	inline void Advance( Time TimeStamp )
+	{
+		CurrentTime.store( TimeStamp, std::memory_order_release );
+	}
   
   // In order to read the time, the functor operator of the standard function
   // base class is simply reused.
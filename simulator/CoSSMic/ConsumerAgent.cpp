@@ -22,6 +22,9 @@
   There is correspondingly one file for each consumer agent stored in the 
   directory "Probabilities". The file is read from the actor's constructor and
   written in the actor's destructor.
+  A load without a file starts from the probabilities learned by the other 
+  loads of the same device, which are kept in a binary prior file in the same
+  directory.
   
   REFERENCES:
   
@@ -48,12 +51,16 @@
 #include <cerrno>						   // C-style error reporting
 #include <cmath>						   // For computing the grid's initial probability
 
+#include "BinaryPayload.hpp"   // Binary message codecs
 #include "ConsumerAgent.hpp"   // The description of the agent
 #include "Producer.hpp"        // The generic producer class
 #include "Grid.hpp"            // The infinite Grid producer
 #include "PVProducer.hpp"      // Photo voltaic producers
 #include "Battery.hpp"         // Batteries - not implemented yet
 #include "CSVtoTimeSeries.hpp" // To parse CSV files
+#include "ProducerPriors.hpp"  // Probabilities shared by loads of a device
+#include "Clock.hpp"           // The time producers were last seen
+#include "RollingHorizon.hpp"  // Forgetting producers long gone
 
 #ifdef CoSSMic_DEBUG
   #include <iterator>
@@ -65,23 +72,31 @@ namespace CoSSMic {
 // For the same reason is the Grid discount factor defined
 
 const unsigned int ConsumerAgent::GridDiscountFactor;
+const LA::ActionIndex ConsumerAgent::ProducerSlots;
 
 /******************************************************************************
   Constructor & Destructor
 *******************************************************************************/
+//
+// There is one consumer agent for each load waiting to be started, and most
+// of them are idle. The agents can therefore be executed by the actor pool by
+// setting the execution mode of the class.
 
 ConsumerAgent::ConsumerAgent( const IDType & ID, Time EST, Time LST,
 												      unsigned int TheSequence,
 												      const std::string & ProfileFileName,
-												      const Theron::Address & LocalTaskManager  )
+												      const Theron::Address & LocalTaskManager,
+												      bool SubscribePeers )
 : Actor( ( ValidID( ID ) ?
-			   "consumer" + std::string( ID ) : std::string() ) ),
+			   "consumer" + std::string( ID ) : std::string() ),
+				 ClassExecutionMode< ConsumerAgent >() ),
   StandardFallbackHandler( GetAddress().AsString() ),
   DeserializingActor( GetAddress().AsString() ),
   TaskManager( LocalTaskManager ), 
-  Producers(), ProducerSelector(), 
+  Producers(), ProducerAction(), ProducerPeers(), PeerVersion( 0 ),
+  ReplayPeers( true ), ProducerSelector(), 
   PVProducers(), Batteries(), PriorityProducers(),
-  StoredProbabilities(), TheActorManager()
+  StoredProbabilities(), LastSeen(), TheActorManager()
 {
   // Initialisation of the local variables
   
@@ -108,6 +123,7 @@ ConsumerAgent::ConsumerAgent( const IDType & ID, Time EST, Time LST,
   // the grid address function to be valid and correct.
   
   Producers.push_back( Grid::Address() );
+  ProducerAction[ Grid::Address() ] = 0;
   
   // Then we register the message handlers so that we are able to receive 
   // messages from the other actors.
@@ -118,37 +134,68 @@ ConsumerAgent::ConsumerAgent( const IDType & ID, Time EST, Time LST,
   RegisterHandler(this, &ConsumerAgent::RemoveProducer    );
   RegisterHandler(this, &ConsumerAgent::Feedback2Selector );
 	RegisterHandler(this, &ConsumerAgent::ShutDown 				  );
+	RegisterHandler(this, &ConsumerAgent::SaveCheckpoint 	  );
 	
+  // Then the load can be started
+
+  StartLoad( ProfileFileName, SubscribePeers );
+}
+
+// Starting the load reads the profile and the persisted probabilities before 
+// subscribing to the Session Layer for the producers.
+
+void ConsumerAgent::StartLoad( const std::string & ProfileFileName, 
+															 bool SubscribePeers )
+{
   // Read the profile data file using the CSV parser
   
-  auto Profile( CSVtoTimeSeries( ProfileFileName ) );
+  TimeSeries Profile;
+  
+  CSVtoTimeSeries( ProfileFileName, Profile );
   
   // The duration is simply the abscissa value (time stamp) of the last value
   // in the datafile, and the total energy is the energy value of the same 
   // value since the profile is cumulative.
   
-  Duration    = (Profile.rbegin())->first;
-  TotalEnergy = (Profile.rbegin())->second;
+  Duration    = Profile.LastTime();
+  TotalEnergy = Profile.LastValue();
 
   // Then the producer-probability map is read from the file, provided that
-  // the file exist and can be opened for reading.
+  // the file exist and can be opened for reading. Each line has the producer
+  // and its probability, and optionally the time the producer was last seen.
+  // Files written before the time was recorded have only two columns.
   
   std::ifstream PersistedProbabilities( 
 		std::string("Probabilities/") + GetAddress().AsString()+".dta");
   std:: string  GridName( Grid::Address().AsString() );
+  std::string   Line;
   
   if ( PersistedProbabilities.good() )
-    while ( !PersistedProbabilities.eof() )
+    while ( std::getline( PersistedProbabilities, Line ) )
     {
+      std::istringstream Record( Line );
       std::string ProducerID;
       double 	  Probability = 0.0;
+      Time        SeenTime;
       
-      PersistedProbabilities >> ProducerID >> Probability;
+      Record >> ProducerID >> Probability;
       
       if( !ProducerID.empty() ) 
-             StoredProbabilities.emplace( Theron::Address( ProducerID.data() ), 
-				     Probability   );
+      {
+        Theron::Address Producer( ProducerID.data() );
+        
+        StoredProbabilities.emplace( Producer, Probability );
+        
+        if ( Record >> SeenTime )
+          LastSeen.emplace( Producer, SeenTime );
+      }
     }
+  
+  // A load that has not been run before starts from the prior probabilities 
+  // learned by the other loads of the same device, if any.
+  
+  if ( StoredProbabilities.empty() )
+    ProducerPriors::Store().Prior( LoadID, StoredProbabilities );
     
   // Finally, it requests the list of peer actors supported for the 
   // communication. It should be noted that this will produce a sequence of 
@@ -156,10 +203,13 @@ ConsumerAgent::ConsumerAgent( const IDType & ID, Time EST, Time LST,
   // a producer to ask for energy. For this reason it must be invoked after 
   // the profile has been processed, and the persisted probabilities loaded.
   
-  Theron::Address TheLayer(Theron::Network::GetAddress( Theron::Network::Layer::Session ));
-  
-  Send( Theron::SessionLayerMessages::NewPeerSubscription(), 
-				TheLayer );
+  if ( SubscribePeers )
+  {
+    Theron::Address TheLayer(Theron::Network::GetAddress( Theron::Network::Layer::Session ));
+    
+    Send( Theron::SessionLayerMessages::NewPeerSubscription( PeerVersion ), 
+				  TheLayer );
+  }
 }
 
 
@@ -230,43 +280,17 @@ void ConsumerAgent::ShutDown(
 	TheActorManager = HouseholdActorManager;
 }
 
-// The destructor has the role of disconnecting the Consumer Agent from the 
-// system, and ensure that another consumer agent may be created with the same 
-// name after the termination. One important concern is the remote Consumer 
-// proxy that must be deleted, and the acknowledgement from the remote 
-// producer that the proxy has been removed should not trigger the selection of
-// a new producer as it normally does.
-//
-// A second concern is feedback messages. When the Actor Manager receives a 
-// message to terminate a consumer it will pass the total energy consumed and
-// the provider of that energy (used producer) to the Reward Calculator. This
-// will in turn trigger a feedback to all active consumers, inclusive the one 
-// that is terminating, and then this consumer will be removed from the 
-// Reward Calculator's list of active consumers to prevent future rewards to 
-// be sent to deleted consumers. When the Actor Manager receives the 
-// acknowledgement from the Reward Calculator that the reward has been 
-// dispatched, it can proceed to delete the consumer and implicitly invoke the 
-// destructor. Given that the Reward Calculator only rewards consumers on the 
-// local node (network endpoint), no network transfer will be involved when 
-// sending the feedback message. Still, it is impossible to know when Theron 
-// will schedule the Consumer Agent to handle the feedback message since this 
-// depends on the availability of a thread to run the Consumer Agent actor. 
-//
-// The Consumer Agent's destructor will however run in the same thread as the 
-// Actor Manager, a thread that has been stalled waiting for the Reward 
-// Calculator to complete in a different thread. Hence, it is conceivable that
-// the destructor will execute before the pending feedback message has been 
-// consumed.
-  
-ConsumerAgent::~ConsumerAgent( void )
+// The probabilities are persisted under the current name of the consumer
+
+void ConsumerAgent::PersistProbabilities( const std::string & Directory )
 {
-  // At the end, the probabilities are written to a file for use next time a 
+  // The probabilities are written to a file for use next time a 
   // consumer with the same ID is started. We try to make the directory, and 
   // most likely it will fail because it exists. This is however OK and 
   // sufficient to create or replace the file already there. If there is 
   // any other error, the probabilities will not be stored.
   
-  if ( (mkdir("Probabilities", S_IRWXU | S_IRWXG | S_IRWXO) == 0) ||
+  if ( (mkdir( Directory.data(), S_IRWXU | S_IRWXG | S_IRWXO) == 0) ||
        (errno == EEXIST) )
   {
     // The probabilities are first stored in the internal map of probabilities
@@ -276,7 +300,7 @@ ConsumerAgent::~ConsumerAgent( void )
     // Next the file to persist these probabilities is opened. First the file 
     // name for this consumer must be set up.
 
-    std::string Filename("Probabilities/");
+    std::string Filename( Directory + "/" );
     Filename += GetAddress().AsString();
     Filename += ".dta";
 
@@ -291,19 +315,142 @@ ConsumerAgent::~ConsumerAgent( void )
     PersistentProbabilities.setf( std::ofstream::fixed );
     PersistentProbabilities.precision( std::numeric_limits<double>::digits10 );
     
-    // The probabilities are written out to this file in a simple loop over 
-    // the stored probabilities.
+    // The producers currently known are seen now, and so are the stored 
+    // producers without a recorded time. The probabilities are then written 
+    // out to this file in a simple loop over the stored probabilities, 
+    // skipping and forgetting the producers not seen within the rolling 
+    // horizon.
+    
+    Time CurrentTime = Now();
+    
+    for ( const auto & KnownProducer : ProducerAction )
+      LastSeen[ KnownProducer.first ] = CurrentTime;
     
-    for (auto & ProbabilityRecord : StoredProbabilities )
-      PersistentProbabilities << ProbabilityRecord.first.AsString() << " "
-												      << ProbabilityRecord.second << std::endl;
+    for ( auto ProbabilityRecord  = StoredProbabilities.begin(); 
+							 ProbabilityRecord != StoredProbabilities.end(); )
+    {
+      Time SeenTime = 
+        LastSeen.emplace( ProbabilityRecord->first, CurrentTime ).first->second;
+      
+      if ( RollingHorizon::Expired( SeenTime, CurrentTime ) )
+      {
+        LastSeen.erase( ProbabilityRecord->first );
+        ProbabilityRecord = StoredProbabilities.erase( ProbabilityRecord );
+      }
+      else
+      {
+        PersistentProbabilities << ProbabilityRecord->first.AsString() << " "
+													      << ProbabilityRecord->second << " "
+													      << SeenTime << std::endl;
+        ++ProbabilityRecord;
+      }
+    }
 
     // There is strictly no need to close the file since it will be closed 
     // when the file class goes out of scope and is deleted. However, for 
     // readability it is done explicitly.
 			      
     PersistentProbabilities.close();
+    
+    // The priors of the devices are saved to the same directory so that they 
+    // are also part of a checkpoint.
+    
+    ProducerPriors::Store().Save( Directory );
   }
+}
+
+// The prior is only updated if the consumer has created its automaton, as 
+// the stored probabilities are otherwise unchanged from the file or the prior.
+
+void ConsumerAgent::UpdatePrior( void )
+{
+  if ( ProducerSelector )
+  {
+    LAStoreProbabilities();
+    ProducerPriors::Store().Update( LoadID, StoredProbabilities );
+  }
+}
+
+// A checkpoint simply persists the probabilities in the checkpoint directory.
+
+void ConsumerAgent::SaveCheckpoint( const Checkpoint & TheCheckpoint, 
+																	  const Theron::Address TheActorManager )
+{
+  PersistProbabilities( TheCheckpoint.SubDirectory( "Probabilities" ) );
+}
+
+// Re-initialising a consumer from the pool of the Actor Manager must first 
+// save what has been learned for the previous load before the consumer is 
+// renamed. The state of the previous load is then cleared as if the consumer
+// had been constructed for the new load, and the load is started.
+
+void ConsumerAgent::Reinitialise( const IDType & ID, Time EST, Time LST,
+																  unsigned int TheSequence,
+																  const std::string & ProfileFileName,
+																  const Theron::Address & LocalTaskManager,
+																  bool SubscribePeers )
+{
+  UpdatePrior();
+  PersistProbabilities();
+  
+  Producers.clear();
+  Producers.push_back( Grid::Address() );
+  ProducerAction.clear();
+  ProducerAction[ Grid::Address() ] = 0;
+  ProducerSelector.reset();
+  PVProducers.clear();
+  Batteries.clear();
+  PriorityProducers.clear();
+  StoredProbabilities.clear();
+  LastSeen.clear();
+  SelectedProducer = Theron::Address::Null();
+  TheActorManager  = Theron::Address::Null();
+  ReplayPeers      = true;
+  
+  Rename( "consumer" + std::string( ID ) );
+  
+  TaskManager       = LocalTaskManager;
+  LoadID 	      	  = ID;
+  EarliestStartTime = EST;
+  LatestStartTime   = LST;
+  SequenceNumber    = TheSequence;
+  State             = ExecutionState::Idle;
+  
+  StartLoad( ProfileFileName, SubscribePeers );
+}
+
+// The destructor has the role of disconnecting the Consumer Agent from the 
+// system, and ensure that another consumer agent may be created with the same 
+// name after the termination. One important concern is the remote Consumer 
+// proxy that must be deleted, and the acknowledgement from the remote 
+// producer that the proxy has been removed should not trigger the selection of
+// a new producer as it normally does.
+//
+// A second concern is feedback messages. When the Actor Manager receives a 
+// message to terminate a consumer it will pass the total energy consumed and
+// the provider of that energy (used producer) to the Reward Calculator. This
+// will in turn trigger a feedback to all active consumers, inclusive the one 
+// that is terminating, and then this consumer will be removed from the 
+// Reward Calculator's list of active consumers to prevent future rewards to 
+// be sent to deleted consumers. When the Actor Manager receives the 
+// acknowledgement from the Reward Calculator that the reward has been 
+// dispatched, it can proceed to delete the consumer and implicitly invoke the 
+// destructor. Given that the Reward Calculator only rewards consumers on the 
+// local node (network endpoint), no network transfer will be involved when 
+// sending the feedback message. Still, it is impossible to know when Theron 
+// will schedule the Consumer Agent to handle the feedback message since this 
+// depends on the availability of a thread to run the Consumer Agent actor. 
+//
+// The Consumer Agent's destructor will however run in the same thread as the 
+// Actor Manager, a thread that has been stalled waiting for the Reward 
+// Calculator to complete in a different thread. Hence, it is conceivable that
+// the destructor will execute before the pending feedback message has been 
+// consumed.
+  
+ConsumerAgent::~ConsumerAgent( void )
+{
+  UpdatePrior();
+  PersistProbabilities();
   
   #ifdef CoSSMic_DEBUG
     Theron::ConsolePrint DebugMessage;
@@ -317,22 +464,20 @@ ConsumerAgent::~ConsumerAgent( void )
 *******************************************************************************/
 //
 // First a small utility function to look up the address of a producer in the 
-// set of known producers, and map it to its index in the probability vector
-// (i.e. action index). The standard find function is used as there is no 
-// dedicated find function for vectors. It uses iterator arithmetic to compute 
-// the index, and throws an exception if the given producer address was not 
-// found. The calling method should catch this if it has a reasonable way to 
-// manage the error.
+// map from the known producers to their index in the probability vector
+// (i.e. action index). It throws an exception if the given producer address 
+// was not found. The calling method should catch this if it has a reasonable 
+// way to manage the error.
 
 LA::ActionIndex
-ProducerIndex( const std::vector< Theron::Address > & ProducerSet,
-               const Theron::Address & GivenProducer )
+ProducerIndex( 
+  const std::unordered_map< Theron::Address, LA::ActionIndex > & ProducerSet,
+  const Theron::Address & GivenProducer )
 {
-  auto ProducerPosition = std::find( ProducerSet.cbegin(), ProducerSet.cend(), 
-                                     GivenProducer );
+  auto ProducerPosition = ProducerSet.find( GivenProducer );
     
-  if ( ProducerPosition != ProducerSet.cend() )
-    return ProducerPosition - ProducerSet.cbegin();
+  if ( ProducerPosition != ProducerSet.end() )
+    return ProducerPosition->second;
   else
   {
     std::ostringstream ErrorMessage;
@@ -422,6 +567,18 @@ void ConsumerAgent::CreateAutomaton( void )
     ++ProbabilityPosition;
   }
   
+  // Spare action slots are added so that arriving producers can be given a 
+  // slot without re-creating the automaton. These have zero probability and 
+  // a Null producer address.
+  
+  LA::ActionIndex KnownProducers = Producers.size();
+  
+  if ( KnownProducers < ProducerSlots )
+  {
+    Producers.resize( ProducerSlots, Theron::Address::Null() );
+    InitialProbabilities.resize( ProducerSlots, 0.0 );
+  }
+  
   // Then the probability mass can be created and assigned the probabilities 
   // that were known from the previous run. The constructor will ensure that 
   // the probabilities are properly normalised to unity.
@@ -448,6 +605,9 @@ void ConsumerAgent::CreateAutomaton( void )
 
   ProducerSelector->InitialiseProbabilities( Probabilities );
   
+  for ( LA::ActionIndex Slot = KnownProducers; Slot < Producers.size(); Slot++ )
+    ProducerSelector->WithdrawAction( Slot );
+  
   #ifdef CoSSMic_DEBUG
     Theron::ConsolePrint DebugMessage;
     DebugMessage << GetAddress().AsString() << "'s producer probabilities = ";
@@ -468,35 +628,83 @@ void ConsumerAgent::CreateAutomaton( void )
 // action with zero probability will never be chosen). How to re-distribute 
 // the probability to give a fair probability? This is a real research question!
 //
-// On the other hand, since the stored probabilities from the previous run is 
-// used to update the probabilities after creation of the automata, it is 
-// not clear that it will be any better to use these historical probabilities 
-// instead of the new ones, which may have been updated over the course of 
-// multiple plays of the game before the new producer arrives. 
-// 
-// The idea is that the stored probabilities are updated with the probabilities
-// known for the current producers, and then the selection automata can be
-// re-created. The reason for re-creating them is that the learning 
-// constants and other parameters may be a function of the number of producers,
-// and the automata state should therefore be re-initialised.
-// 
-// The next method stores the current probabilities allowing the list of 
-// producers to change before the selection automata are re-created. It is 
-// based on the assumption that new producers might have been added to the 
-// set of producers, and so only the first producers corresponding to
-// probability values will be stored.
+// Re-creating the automaton for every producer arriving or leaving would copy 
+// the full probability vector through the map of stored probabilities each 
+// time, and it would discard any pending selection. Instead, the automaton has
+// spare action slots, and the variable action set automaton supports 
+// activating and withdrawing actions in place following Thathachar and 
+// Harita: A new producer is given the probability 1/r where r is the number of 
+// producers including the new one, or its stored probability if it has been 
+// known before, and the probabilities of the other producers are scaled down 
+// proportionally to make room for it. 
+
+//
+// The automaton keeps the withdrawn actions in a free list, and it also knows 
+// the number of active actions, so the slot is found without scanning the 
+// producers.
+
+LA::ActionIndex 
+ConsumerAgent::AssignProducerSlot( const Theron::Address & NewProducer )
+{
+  if ( ProducerSelector->FreeActionCount() == 0 )
+    ExtendAutomaton();
+  
+  double InitialProbability = 1.0 / static_cast< double >( 
+    ProducerSelector->ActiveActionCount() + 1 );
+  
+  auto PastProbability = StoredProbabilities.find( NewProducer );
+  
+  if ( ( PastProbability != StoredProbabilities.end() ) &&
+       ( PastProbability->second > 0.0 ) && ( PastProbability->second < 1.0 ) )
+    InitialProbability = PastProbability->second;
+  
+  LA::ActionIndex Slot = ProducerSelector->AddAction( InitialProbability );
+  
+  Producers[ Slot ]             = NewProducer;
+  ProducerAction[ NewProducer ] = Slot;
+  
+  return Slot;
+}
+
+// When all slots are occupied, the automaton must be re-created with more 
+// action slots. The number of slots is doubled so that the cost of copying 
+// the probabilities is amortised over many arriving producers. The current 
+// probabilities are copied directly to the new automaton, and the new slots 
+// are withdrawn.
+
+void ConsumerAgent::ExtendAutomaton( void )
+{
+  LA::ActionIndex CurrentSlots = Producers.size();
+  std::vector< double > Probabilities( 2 * CurrentSlots, 0.0 );
+  
+  for ( LA::ActionIndex Slot = 0; Slot < CurrentSlots; Slot++ )
+    Probabilities[ Slot ] = ProducerSelector->ActionProbability( Slot );
+  
+  Producers.resize( 2 * CurrentSlots, Theron::Address::Null() );
+  
+	NeighbourhoodEnvironment TheEnvironmet( Producers.size() );
+  
+  ProducerSelector = std::make_shared< AutomataType >( TheEnvironmet, 
+                                                       LearningConstant );
+  
+  ProducerSelector->InitialiseProbabilities( 
+    ProbabilityMass< double >( Probabilities.begin(), Probabilities.end() ) );
+  
+  for ( LA::ActionIndex Slot = 0; Slot < Producers.size(); Slot++ )
+    if ( Producers[ Slot ] == Theron::Address::Null() )
+      ProducerSelector->WithdrawAction( Slot );
+}
+
+// The next method stores the current probabilities of the producers known 
+// so that they can be persisted when the consumer closes. Only the producers
+// currently known are mapped to an action, so empty action slots are skipped.
 
 void ConsumerAgent::LAStoreProbabilities(void)
 {
-  auto CurrentProbabilities( ProducerSelector->GetProbabilities() );
-	auto ProducerAddress = Producers.cbegin();
-	
-	for ( auto TheProbability  = CurrentProbabilities.cbegin();
-		         TheProbability != CurrentProbabilities.cend(); ++TheProbability )
-  {
-		StoredProbabilities[ *ProducerAddress ] = *TheProbability;
-		++ProducerAddress;
-	}
+  if ( ProducerSelector )
+    for ( const auto & KnownProducer : ProducerAction )
+      StoredProbabilities[ KnownProducer.first ] = 
+        ProducerSelector->ActionProbability( KnownProducer.second );
 }
 
 /******************************************************************************
@@ -543,7 +751,7 @@ void ConsumerAgent::SelectProducer(
 		else 
 		{
 			PriorityProducers.clear();
-			PriorityProducers.insert( ProducerIndex( Producers, Grid::Address() ) );
+			PriorityProducers.insert( ProducerIndex( ProducerAction, Grid::Address() ) );
 		}
 		
 		// Then try to select a new producer with these priority producers, and 
@@ -590,7 +798,7 @@ void ConsumerAgent::SelectProducer(
 	else //if ( Producer::CheckAddress< Battery >( SelectedProducer ) )
 	{
 		PriorityProducers.clear();
-		PriorityProducers.insert( ProducerIndex( Producers, Grid::Address() ) );
+		PriorityProducers.insert( ProducerIndex( ProducerAction, Grid::Address() ) );
 	}
 
   // If debugging log messages should be produced the selection is reported
@@ -623,6 +831,14 @@ void ConsumerAgent::ForwardAcknowledgement(
      const Producer::AcknowledgeProxyRemoval & Ack,
 		 const Theron::Address Producer )
 {
+	// The normal handlers are restored while it is safe to change the handlers
+	// so that the consumer can be reused for another load by the Actor Manager.
+	
+	DeregisterHandler( this, &ConsumerAgent::SendKillProxyCommand );
+	RegisterHandler  ( this, &ConsumerAgent::SetStartTime );
+	DeregisterHandler( this, &ConsumerAgent::ForwardAcknowledgement );
+	RegisterHandler  ( this, &ConsumerAgent::SelectProducer );
+	
 	Send( ActorManager::ConfirmShutDown(), TheActorManager );
 }
 
@@ -763,39 +979,72 @@ void ConsumerAgent::AddProducer(
   // in our directory already. For further actions we will need to know if 
   // a producer was added or not.
   
-  LA::ActionIndex NumberOfProducers = Producers.size();
+  bool ProducersAdded = false;
+  
+  // The producers reported are remembered for a later subscription, and a 
+  // complete notification replaces the remembered producers. The first 
+  // notification after a subscription may only contain the changes since the
+  // previous subscription, and then all the remembered producers are new to 
+  // the current load.
+  
+  PeerVersion = std::max( PeerVersion, NewAgent.GetVersion() );
+  
+  if ( NewAgent.IsComplete() )
+    ProducerPeers.clear();
+  
+  for ( const Theron::Address & TheAgentAddress : NewAgent )
+    if ( Producer::CheckAddress< PVProducer >( TheAgentAddress ) ||
+			   Producer::CheckAddress< Battery >( TheAgentAddress ) )
+      ProducerPeers.insert( TheAgentAddress );
+  
+  const std::set< Theron::Address > & Arrivals( 
+		ReplayPeers ? ProducerPeers 
+								: static_cast< const std::set< Theron::Address > & >( NewAgent ) );
+  
+  ReplayPeers = false;
   
   // It should be noted that the New Agent given could in fact be a set of 
   // agents added since last notification, and we need to handle all of them.
 	// The agent is added to the list of known producers if it has one of the 
 	// known producer types and it is not known already.
   
-  for ( const Theron::Address & TheAgentAddress : NewAgent )  
-    if ( std::find( Producers.begin(), Producers.end(), TheAgentAddress )
-	       == Producers.end() )  
+  for ( const Theron::Address & TheAgentAddress : Arrivals )  
+    if ( ProducerAction.find( TheAgentAddress ) == ProducerAction.end() )  
     {
 			// The agent address is not stored from before, and it should be stored
 			// if it belongs to one of the known producer categories this consumer
-			// will use to source energy. Note that the index of the added 
-			// producer address will be the number of currently known producers since
-			// the producers are indexed from 0..n-1, i.e. the next producer added
-			// will have index n.
+			// will use to source energy. Before the automaton exists, the index of 
+			// the added producer address will be the number of currently known 
+			// producers since the producers are indexed from 0..n-1, i.e. the next 
+			// producer added will have index n. Afterwards, the producer is given
+			// a free action slot of the automaton.
 			
-			if ( Producer::CheckAddress< PVProducer >( TheAgentAddress ) )
+			if ( Producer::CheckAddress< PVProducer >( TheAgentAddress ) ||
+			     Producer::CheckAddress< Battery >( TheAgentAddress ) )
 			{
-				PVProducers.insert( Producers.size() );	// Index of new producer
-				Producers.push_back( TheAgentAddress );
+				LA::ActionIndex ProducerIndex;
+				
+				if ( ProducerSelector )
+					ProducerIndex = AssignProducerSlot( TheAgentAddress );
+				else
+				{
+					ProducerIndex = Producers.size();
+					Producers.push_back( TheAgentAddress );
+					ProducerAction[ TheAgentAddress ] = ProducerIndex;
+				}
+				
+				if ( Producer::CheckAddress< PVProducer >( TheAgentAddress ) )
+					PVProducers.insert( ProducerIndex );
+				else
+					Batteries.insert( ProducerIndex );
+				
+				ProducersAdded = true;
 			}
-			else if ( Producer::CheckAddress< Battery >( TheAgentAddress ) )
-			{
-				Batteries.insert( Producers.size() );
-				Producers.push_back( TheAgentAddress );
-			}      
 		}
 
   // If any producer IDs were received, the appropriate actions must be taken.
   
-  if ( Producers.size() > NumberOfProducers )
+  if ( ProducersAdded )
   {
 		// A new producer should lead to a new search for a provider of electricity
 		// starting from the set of PV producers. In theory there should be 
@@ -809,12 +1058,12 @@ void ConsumerAgent::AddProducer(
 		else
 		{
 			PriorityProducers.clear();
-			PriorityProducers.insert( ProducerIndex( Producers, Grid::Address() ) );
+			PriorityProducers.insert( ProducerIndex( ProducerAction, Grid::Address() ) );
 		}
 		
-		// Depending on whether this is first time producers are discovered or if 
-		// new producers are added to an already existing set, it is necessary to 
-		// re-initiate the learning automaton.
+		// If this is the first time producers are discovered, the learning 
+		// automaton must be created. Producers added to an already existing set 
+		// have already been given their action slots.
 		
     if ( ! ProducerSelector ) 
     {
@@ -829,13 +1078,6 @@ void ConsumerAgent::AddProducer(
     }
     else 
     {
-      // Producers were added and there is already a producer selector. It 
-      // means that its state should be saved before we recreate the selector
-      // with a probability mass corresponding to the new set of producers. 
-      
-      LAStoreProbabilities();
-      CreateAutomaton();
-			
       // Since one of the already known producers may be involved with an  
       // ongoing scheduling operation, we cannot start a new one before that 
       // operation has finished according to the standard protocol. Hence we 
@@ -854,46 +1096,71 @@ void ConsumerAgent::AddProducer(
 
 // The next handler is the inverse of the previous handler and called when 
 // one of the agents are no longer present and useful as observed by the 
-// Session Layer. Note the invariant that the learning actor must exist and in 
-// this case since we cannot remove a producer that has not been added, so 
-// if the producer is found we can simply rescale the producer selector 
-// automaton
+// Session Layer. A producer can be removed before the learning automaton 
+// exists, and then it is just removed from the producers. Otherwise its 
+// action is withdrawn from the producer selector automaton which rescales 
+// the probabilities of the remaining producers, and its slot is freed.
 
 void ConsumerAgent::RemoveProducer(
   const Theron::SessionLayerMessages::PeerRemoved & LeavingAgent, 
   const Theron::Address SessionLayerServer)
 {
-  // First we must find the producer in the list of existing producers, and 
+  // First we must find the producer in the map of existing producers, and 
   // it is likely that this may fail because this handler is invoked whenever 
   // an agent goes off-line, which includes all types of actors not only the 
   // producers.
   
-  auto Position = std::find( Producers.begin(), Producers.end(), 
-												     LeavingAgent.GetAddress() );
+  PeerVersion = std::max( PeerVersion, LeavingAgent.GetVersion() );
+  ProducerPeers.erase( LeavingAgent.GetAddress() );
+  
+  auto Position = ProducerAction.find( LeavingAgent.GetAddress() );
   
-  if ( Position != Producers.end() )
+  if ( Position != ProducerAction.end() )
   {
     // The leaving agent is a producer and should be removed both from the 
-    // directory of producers and from the producer learning automata. This 
-    // has to be done in three steps: First the current probabilities must be
-    // stored, then the leaving producer will be removed. It must be removed 
-		// from the list of PV producers, batteries, and priority producers if 
-		// it is part of that set.
-    
-    LAStoreProbabilities();
+    // directory of producers and from the producer learning automata. Its 
+    // probability is remembered in case it comes back, and then its action 
+    // is withdrawn. It must be removed from the list of PV producers, 
+    // batteries, and priority producers if it is part of that set. 
 		
-		auto ProducerIndex = Position - Producers.begin();
+		LA::ActionIndex ProducerIndex = Position->second;
 		
-		if ( ! PVProducers.empty()       ) PVProducers.erase( ProducerIndex );
-		if ( ! Batteries.empty()         ) Batteries.erase(   ProducerIndex );
-		if ( ! PriorityProducers.empty() ) PriorityProducers.erase( ProducerIndex );
+		PVProducers.erase( ProducerIndex );
+		Batteries.erase(   ProducerIndex );
+		PriorityProducers.erase( ProducerIndex );
 		
-    Producers.erase( Position );
-
-		// Finally the automata can be recreated for the reduced set of available 
-		// producers.
+		if ( ProducerSelector )
+		{
+			StoredProbabilities[ Position->first ] = 
+				ProducerSelector->ActionProbability( ProducerIndex );
+			LastSeen[ Position->first ] = Now();
+			
+			ProducerSelector->WithdrawAction( ProducerIndex );
+			Producers[ ProducerIndex ] = Theron::Address::Null();
+		}
+		else
+		{
+			// Before the automaton exists the indices are not yet stable, and the 
+			// last producer is moved into the position of the leaving producer so 
+			// that only one index changes. The sets of producer indices must then 
+			// refer to the new index of the moved producer.
+			
+			LA::ActionIndex LastIndex = Producers.size() - 1;
+			
+			if ( ProducerIndex != LastIndex )
+			{
+				Producers[ ProducerIndex ] = Producers.back();
+				ProducerAction[ Producers[ ProducerIndex ] ] = ProducerIndex;
+				
+				for ( auto IndexSet : { &PVProducers, &Batteries, &PriorityProducers } )
+					if ( IndexSet->erase( LastIndex ) > 0 )
+						IndexSet->insert( ProducerIndex );
+			}
+			
+			Producers.pop_back();
+		}
 		
-		CreateAutomaton();
+		ProducerAction.erase( Position );
     
     // Note that a new producer cannot be selected at this point because
     // there are three options: First, the closing producer has this consumer as 
@@ -967,13 +1234,43 @@ bool ConsumerAgent::StartTimeMessage::Deserialize(
   else return false;
 }
 
+// The binary tag is different from the text command since the producer's 
+// assigned start time uses the same command word.
+
+Theron::SerialMessage::Payload 
+ConsumerAgent::StartTimeMessage::BinarySerialize( void ) const
+{
+  Theron::BinaryWriter Message( "START_TIME" );
+  
+  Message << static_cast< const std::string & >( LoadID ) << SequenceNumber 
+          << StartTime << static_cast< const std::string & >( ProducerID );
+	  
+  return Message.str();
+}
+
+bool ConsumerAgent::StartTimeMessage::BinaryDeserialize( 
+     const Theron::SerialMessage::Payload & Payload )
+{
+  Theron::BinaryReader Message( Payload, "START_TIME" );
+  std::string          Load, TheProducer;
+  
+  Message >> Load >> SequenceNumber >> StartTime >> TheProducer;
+  
+  if ( !Message || Load.empty() || TheProducer.empty() ) return false;
+  
+  LoadID     = IDType( Load );
+  ProducerID = IDType( TheProducer );
+  
+  return true;
+}
+
 // The constructor based on a serialised payload simply calls the above method 
 // de-serialise the payload and initialise the message elements.
 
 ConsumerAgent::StartTimeMessage::StartTimeMessage(
 		  const Theron::SerialMessage::Payload & Payload )
 {
-  if ( ! Deserialize( Payload ) )
+  if ( ! Decode( Payload ) )
 	{
 		std::ostringstream ErrorMessage;
 		
@@ -1028,13 +1325,39 @@ bool ConsumerAgent::CancelStartTime::Deserialize(
   else return false;
 }
 
+// The binary codec just carries the load ID
+
+Theron::SerialMessage::Payload 
+ConsumerAgent::CancelStartTime::BinarySerialize( void ) const
+{
+  Theron::BinaryWriter Message( "DELETE_SLA" );
+  
+  Message << static_cast< const std::string & >( LoadID );
+  
+  return Message.str();
+}
+
+bool ConsumerAgent::CancelStartTime::BinaryDeserialize(
+  const Theron::SerialMessage::Payload & Payload)
+{
+  Theron::BinaryReader Message( Payload, "DELETE_SLA" );
+  std::string          Load;
+  
+  Message >> Load;
+  
+  if ( !Message || Load.empty() ) return false;
+  
+  LoadID = IDType( Load );
+  return true;
+}
+
 // The constructor of the message from a serialised string is simply calling 
 // the de-serialising method, and throws if this fails
 
 ConsumerAgent::CancelStartTime::CancelStartTime( 
   Theron::SerialMessage::Payload & Payload)
 {
-  if ( ! Deserialize( Payload ) )
+  if ( ! Decode( Payload ) )
 	{
 		std::ostringstream ErrorMessage;
 		
@@ -33,12 +33,14 @@
 
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <memory>
 #include <sstream>
 #include <stdexcept>
 
 #include "Actor.hpp"
+#include "AddressHash.hpp"
 #include "SerialMessage.hpp"
 #include "StandardFallbackHandler.hpp"
 #include "NetworkEndPoint.hpp"
@@ -174,9 +176,29 @@ private:
   // This set is stored as a vector because the learning method basically only 
   // selects an integer in the set {0,...,N-1}, and this vector serves as the 
   // mapping from the selected action, i.e. vector index, to the corresponding 
-  // producer address.
+  // producer address. Once the learning automaton exists, the index of a 
+  // producer will not change. A producer leaving leaves a Null address in its
+  // slot, and the slot will be reused by the next producer arriving.
   
   std::vector< Theron::Address > Producers;
+  
+  // The reverse mapping from a producer address to its action index is kept 
+  // in a hash map so that an arriving or leaving producer can be found in 
+  // constant time instead of searching the producer vector.
+  
+  std::unordered_map< Theron::Address, LA::ActionIndex > ProducerAction;
+  
+  // A consumer reused from the pool of the Actor Manager subscribes again to
+  // the session layer for its next load. It therefore remembers the producers 
+  // reported by the session layer and the membership version of the last 
+  // notification received, so that the session layer only needs to send the 
+  // changes since the previous subscription. The remembered producers are 
+  // given to the new load when the first notification after the subscription
+  // arrives.
+  
+  std::set< Theron::Address > 									  ProducerPeers;
+  Theron::SessionLayerMessages::MembershipVersion PeerVersion;
+  bool 																						ReplayPeers;
 
   // The consumer constructor will set up a subscription to the session layer
   // to be informed about the known peers and peers arriving or leaving in the 
@@ -212,6 +234,10 @@ private:
 	
 public:
 	
+	inline Theron::SessionLayerMessages::MembershipVersion 
+	KnownPeerVersion( void ) const
+	{ return PeerVersion; }
+	
 	inline Theron::Address GetSelectedProducer( void )
 	{ 
 		if ( State == ExecutionState::AwaitingAcknowledgement )
@@ -252,6 +278,13 @@ private:
   // given by the below parameter, defaulting to 10.
 
   constexpr static unsigned int GridDiscountFactor = 10;
+  
+  // The learning automaton is created with a minimum number of action slots 
+  // so that producers can come and go without re-creating the automaton. If 
+  // all slots are in use when a producer arrives, the number of slots is 
+  // doubled.
+  
+  constexpr static LA::ActionIndex ProducerSlots = 8;
 
   // The consumer actor uses a learning automaton to learn the best producer and
   // select the producer to try if the one selected in last iteration failed.
@@ -315,25 +348,34 @@ private:
 										   LA::PoznyakNajim<  
 										   LA::SubsetEnvironment< NeighbourhoodEnvironment > > >;
 		
-  // The automaton instance must be dynamically allocated as producers may come
-  // and go, and the number of actions supported by the automata must correspond
-  // to the number of possible producers, including the grid producer and the 
-	// batteries.
+  // The automaton instance must be dynamically allocated as it is only 
+  // created when the first producers are known. The number of actions 
+  // supported by the automata must at least correspond to the number of 
+  // possible producers, including the grid producer and the batteries. 
+  // Action slots without a producer are withdrawn from the automaton.
   
   std::shared_ptr< AutomataType >  ProducerSelector;
 
   // There is one function to create create and initialise the automaton with 
-  // as many actions as there are producers in the producers set. The 
+  // at least as many actions as there are producers in the producers set. The 
   // probability vectors of the producers will take historical information 
   // about persisted probabilities into account when initialising the 
   // probability mass of the selectors.
   
   void CreateAutomaton( void );
+  
+  // Producers arriving after the automaton has been created are given a free
+  // action slot that is activated in the automaton. The automaton is only 
+  // re-created with more slots if there is no free slot, and the function 
+  // returns the action index of the new producer.
+  
+  LA::ActionIndex AssignProducerSlot( const Theron::Address & NewProducer );
+  
+  void ExtendAutomaton( void );
 
-  // There is also a need to make sure that the state of the automaton is stored.
-  // In particular if a new producer comes on-line or a producer goes off-line, 
-  // then the selectors must be re-created, but the learned knowledge should be
-  // kept as much as possible.
+  // There is also a need to make sure that the state of the automaton is 
+  // stored when the consumer closes so that the learned knowledge can be 
+  // persisted for the next run.
   
   void LAStoreProbabilities( void );
   
@@ -342,7 +384,8 @@ private:
 	// set of indices referring to the elements of the producer vector. Since 
 	// these indices will not change unless new producers or new batteries become
 	// available, they are maintained by the handlers adding and removing 
-	// producers.
+	// producers. The indices of the remaining producers are stable when a 
+	// producer leaves.
 	//
 	// There is a third set which is the active set of prioritised producers that
 	// will change for each selection, and that will predominantly be maintained
@@ -362,9 +405,20 @@ private:
   // start from the probabilities of the previous run. The stored probabilities
   // is read into a map in the constructor to be available for initialisation 
   // when the currently active producers are known. The map is from the producer
-  // actor addresses and the stored probability value.
+  // actor addresses and the stored probability value. The probability of a 
+  // producer leaving is also recorded so that it can be restored if the 
+  // producer returns.
   
   std::map< Theron::Address, Probability<double> > StoredProbabilities;
+  
+  // A producer that has left the neighbourhood for good would be remembered 
+  // by every consumer forever. The time each producer was last seen is 
+  // therefore recorded with its stored probability, and when a rolling 
+  // horizon is set the producers not seen within the horizon are forgotten 
+  // when the probabilities are persisted. Producers without a recorded time
+  // are considered seen now.
+  
+  std::map< Theron::Address, Time > LastSeen;
 
   // The reward is computed as by a reward calculator and sent to the consumer
   // as a message containing the value for the choice made by the consumer. If
@@ -498,6 +552,10 @@ public:
 	    Serialize( void ) const override;
     virtual bool 
 	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
 
     // There is a constructor taking a serialised payload and then calling the 
     // Deserialize method to initialize the elements based on this string.
@@ -552,6 +610,10 @@ public:
 	    Serialize( void ) const override;
     virtual bool 
 	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
 
     // The constructor simply saves the ID
 
@@ -654,6 +716,51 @@ private:
 	
 	Theron::Address TheActorManager;
 
+  // ---------------------------------------------------------------------------
+  // Starting and recycling
+  // ---------------------------------------------------------------------------
+  //
+  // Starting a load reads the load profile and the persisted probabilities for
+  // the consumer's name before the consumer subscribes to the peers. This is 
+  // used by the constructor and when a consumer is re-initialised for a new 
+  // load.
+  
+  void StartLoad( const std::string & ProfileFileName, bool SubscribePeers );
+  
+  // The learned probabilities are written to file when the consumer closes or
+  // before it is re-initialised for a new load. They are also written to the 
+  // probabilities directory of a checkpoint when the consumer receives the 
+  // checkpoint message forwarded by the Actor Manager.
+  
+  void PersistProbabilities( 
+		   const std::string & Directory = std::string("Probabilities") );
+  
+  // When the load is completed, the learned probabilities are also averaged 
+  // into the prior of the device (see the producer priors) so that consumers 
+  // for other loads of the same device without stored probabilities can 
+  // start from what this consumer has learned.
+  
+  void UpdatePrior( void );
+  
+  void SaveCheckpoint( const Checkpoint & TheCheckpoint, 
+											 const Theron::Address TheActorManager );
+  
+  // The Actor Manager keeps consumers that have completed their shut down for
+  // reuse since creating and deleting an actor for every load is expensive.
+  // A consumer from this pool is re-initialised for a new load by the Actor 
+  // Manager. It persists the probabilities learned for the previous load, 
+  // forgets the producers, takes the name of the new load, and starts the 
+  // load as the constructor does. It must only be called for a consumer that
+  // has confirmed its shut down.
+  
+public:
+  
+  void Reinitialise( const IDType & ID, 
+										 Time EST, Time LST, unsigned int TheSequence, 
+										 const std::string & ProfileFileName,
+										 const Theron::Address & LocalTaskManager,
+										 bool SubscribePeers = true );
+
   // ---------------------------------------------------------------------------
   // Constructor 
   // ---------------------------------------------------------------------------
@@ -661,14 +768,17 @@ private:
   // The constructor takes the parameters of the create load command and 
   // initialises its local parameters and reads the load file. It will then 
   // subscribe to the Session Layer to be notified about other actors with 
-  // external addresses, among them the producers.
+  // external addresses, among them the producers. The subscription can be 
+  // left to the creator if many consumers are created at the same time and 
+  // the creator subscribes them all in one request.
 
 public:
     
   ConsumerAgent( const IDType & ID,
 								 Time EST, Time LST, unsigned int TheSequence, 
 								 const std::string & ProfileFileName,
-								 const Theron::Address & LocalTaskManager   );  
+								 const Theron::Address & LocalTaskManager,
+								 bool SubscribePeers = true );  
 };
   
 };	// End Namespace CoSSMic
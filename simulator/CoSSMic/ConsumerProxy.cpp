@@ -32,21 +32,11 @@ namespace CoSSMic {
 // Message handlers
 // ---------------------------------------------------------------------------
 
-// According to the framework in [1] the total energy that must be considered 
-// for this load is the energy needed for the load, plus the cost of keeping 
-// this load going to the end of the consumption interval. When the interval
-// is given by the load scheduler, the next message handler will compute their
-// cost.
-
-void ConsumerProxy::ComputeTotalEnergy( 
-  const StartTimeProposal & Proposal, const Theron::Address TheScheduler )
-{
-  double EnergyCost = EnergyNeeded * ( Proposal.ConsumptionInterval.upper() 
-    - (Proposal.ProposedStartTime + JobDuration)  );
-  
-  Send( EnergyCost, TheScheduler );
-}
-
+// The energy cost of a proposed start time is computed by the producer from 
+// the load parameters of the proxy, see the consumption intervals of the PV
+// producer, and the only message handled during scheduling is the final 
+// decision.
+//
 // Once the final start time has been decided by the load scheduler it is 
 // returned as a separate message. It should be noted that this start time
 // can very well be undefined, in which no start time could be obtained at
@@ -57,11 +47,16 @@ void ConsumerProxy::SetStartTime(
      const Producer::AssignedStartTime & Time2Start, 
 	   const Theron::Address TheScheduler )
 {
-	if ( StartTime && ( StartTime == Time2Start ) )
-		return;
+	{
+		std::lock_guard< std::mutex > Lock( LoadGuard );
+		
+		if ( TheLoad.StartTime && ( TheLoad.StartTime == Time2Start ) )
+			return;
 
-	StartTime = Time2Start;
-  Send( StartTime, TheProducer, ConsumerAddress );
+		TheLoad.StartTime = Time2Start;
+	}
+	
+  Send( Time2Start, TheProducer, ConsumerAddress );
 }
 
 // ---------------------------------------------------------------------------
@@ -98,34 +93,63 @@ void ConsumerProxy::SetStartTime(
 // the only way to ensure that the proxy is deleted before the new proxy is 
 // created at another producer is to implement an acknowledgement for the kill
 // message (see the consumer agent for details).
+//
+// A producer may have thousands of proxies that are idle most of the time,
+// and the proxies can be executed by the actor pool by setting the execution
+// mode of the class.
   
 ConsumerProxy::ConsumerProxy( 
                const CoSSMic::Producer::ScheduleCommand & TheCommand, 
                const Theron::Address & TheConsumer, 
                const Theron::Address & ProducerReference   )
-: Actor(),
+: Actor( std::string(), ClassExecutionMode< ConsumerProxy >() ),
   StandardFallbackHandler( GetAddress().AsString() ),
   ConsumerAddress( TheConsumer ), 
   TheProducer( ProducerReference ),
-  StartInterval( TheCommand.AllowedStartWindow() ), 
-  StartTime()
+  TheLoad{ TheCommand.TotalEnergy(), TheCommand.Duration(), 
+           TheCommand.AllowedStartWindow(), Producer::AssignedStartTime() },
+  LoadGuard()
+{
+  RegisterHandler(this, &ConsumerProxy::SetStartTime );
+}
+
+// Releasing the proxy acknowledges the removal and clears the load so that a 
+// released proxy is recognised by a Null consumer address.
+
+void ConsumerProxy::Release( void )
+{
+	if ( ConsumerAddress != Theron::Address::Null() )
+		Send( Producer::AcknowledgeProxyRemoval(), TheProducer, ConsumerAddress );
+	
+	ConsumerAddress = Theron::Address::Null();
+	
+	std::lock_guard< std::mutex > Lock( LoadGuard );
+	TheLoad.StartTime = Producer::AssignedStartTime();
+}
+
+// Re-initialising the proxy stores the information of the new load as the 
+// constructor does. The producer is the same since proxies are only recycled 
+// by the producer that created them.
+
+void ConsumerProxy::Reinitialise( 
+               const CoSSMic::Producer::ScheduleCommand & TheCommand, 
+               const Theron::Address & TheConsumer )
 {
-   
-  JobDuration     = TheCommand.Duration();
-  EnergyNeeded    = TheCommand.TotalEnergy();
+  ConsumerAddress = TheConsumer;
   
-  // Then the message handlers are registered.
+  std::lock_guard< std::mutex > Lock( LoadGuard );
   
-  RegisterHandler(this, &ConsumerProxy::ComputeTotalEnergy  );
-  RegisterHandler(this, &ConsumerProxy::SetStartTime  	    );
+  TheLoad = LoadParameters{ TheCommand.TotalEnergy(), TheCommand.Duration(), 
+                            TheCommand.AllowedStartWindow(), 
+                            Producer::AssignedStartTime() };
 }
 
-// The destructor clears the currently assigned start time - if any and then 
-// acknowledge the proxy removal
+// The destructor acknowledges the proxy removal if this has not been done 
+// when the proxy was released.
 
 ConsumerProxy::~ConsumerProxy( void )
 {
-	Send( Producer::AcknowledgeProxyRemoval(), TheProducer, ConsumerAddress );
+	Release();
 }
 
 } // End namespace CoSSMic
@@ -6,11 +6,14 @@
   scheduled. 
   
   The consumer proxy actor will immediately register with the Load Scheduler, 
-  and this will in turn initiate a schedule operation. During the schedule 
-  operation the consumer will compute the weight of the load given the length
-  of the consumption interval and its assigned start time. This weight is 
+  and this will in turn initiate a schedule operation. The weight of the load 
+  given the length of the consumption interval and its assigned start time is
   fundamentally the total energy consumption by the load, plus its extension 
-  to the end of the load interval. For details see [1].
+  to the end of the load interval. For details see [1]. The producer computes
+  this weight directly from the load parameters of the proxy for every 
+  evaluation of its objective function, and the proxy therefore offers its 
+  load parameters through thread safe access functions rather than by 
+  messages.
   
   REFERENCES:
   
@@ -27,8 +30,11 @@
 #ifndef CONSUMER_PROXY
 #define CONSUMER_PROXY
 
+#include <mutex>
+
 #include "Actor.hpp"
 #include "StandardFallbackHandler.hpp"
+#include "MemoryAccounting.hpp"
 
 #include "TimeInterval.hpp"
 #include "ActorManager.hpp"
@@ -41,20 +47,36 @@ namespace CoSSMic {
 
 // The actual consumer proxy class is an actor that represents all information
 // of the load, but on the same network endpoint as the producer in order to 
-// facilitate the scheduling with only node local communication.
+// facilitate the scheduling with only node local communication. There is one
+// proxy for every load scheduled on the endpoint, and the proxies are 
+// allocated from their own memory account.
 
 class ConsumerProxy : public virtual Theron::Actor,
-											public virtual Theron::StandardFallbackHandler
+											public virtual Theron::StandardFallbackHandler,
+											public Theron::MemoryAccounting::AccountedObject< ConsumerProxy >
 {
-private:
+public:
+  
+  static constexpr auto AccountName = "ConsumerProxy";
+  
+  // The consumer proxy stores the job duration, the energy needed for the 
+  // load, the interval for the allowed start, and the start time assigned by
+  // the producer. The parameters are read by the producer's thread when it 
+  // prepares a schedule, while the assigned start time is set by the proxy's 
+  // message handler, and they are therefore kept together and protected by a
+  // lock so that the producer can take a consistent copy of the load.
   
-  // The consumer proxy only needs to store the job duration and the energy 
-  // needed for the load since the interval for the allowed start is passed 
-  // as a constraint to the scheduler, and the proposed start time should 
-  // therefore respect these constraints and should not be tested again.
+  class LoadParameters
+  {
+  public:
+    
+    double 											Energy;
+    Time   											Duration;
+    TimeInterval 								AllowedInterval;
+    Producer::AssignedStartTime StartTime;
+  };
   
-  Time   JobDuration;
-  double EnergyNeeded;
+private:
   
   // It also needs to store the address of the actor for which this proxy should
   // respond when a good start time has been assigned. Since a consumer proxy 
@@ -65,14 +87,10 @@ private:
   Theron::Address ConsumerAddress, 
 									TheProducer;
   
-  // The Earliest Start Time and Latest Start Time of a job defines the 
-  // allowed start interval.
+  // The load parameters are protected by their lock
   
-  TimeInterval StartInterval;
-	
-	// It also remember the assigned start time for the associated consumer
-	
-	Producer::AssignedStartTime StartTime;
+  LoadParameters     TheLoad;
+  mutable std::mutex LoadGuard;
   
 public:
   
@@ -88,18 +106,29 @@ public:
   // Access functions
   // ---------------------------------------------------------------------------
   
+  // The load parameters can be copied in one operation, which should be 
+  // preferred when more than one parameter is needed.
+  
+  inline LoadParameters GetLoad( void ) const
+  {
+    std::lock_guard< std::mutex > Lock( LoadGuard );
+    return TheLoad;
+  }
+  
   // There is also a simple function to get the total energy the job needs
   
   inline double GetEnergy( void ) const
   {
-    return EnergyNeeded;
+    std::lock_guard< std::mutex > Lock( LoadGuard );
+    return TheLoad.Energy;
   }
 
   // It is also a function to check the job's duration
   
   inline Time GetDuration( void ) const
   {
-    return JobDuration;
+    std::lock_guard< std::mutex > Lock( LoadGuard );
+    return TheLoad.Duration;
   }
 
   // There is a small utility function to report the consumer address of this
@@ -112,57 +141,20 @@ public:
   
   inline Producer::AssignedStartTime GetStartTime( void ) const
 	{
-		return StartTime;
+    std::lock_guard< std::mutex > Lock( LoadGuard );
+		return TheLoad.StartTime;
 	}
 	
 	inline TimeInterval AllowedInterval( void ) const
 	{
-	  return StartInterval;  
+    std::lock_guard< std::mutex > Lock( LoadGuard );
+	  return TheLoad.AllowedInterval;  
 	}
 
   // ---------------------------------------------------------------------------
   // Scheduling information
   // ---------------------------------------------------------------------------
-  // When the solver iterates to find a good start time for all tasks, it will
-  // repeatedly propose new start times in given consumption intervals to the 
-  // consumer proxies given by the following class. Since the proxies are on 
-  // the same node as the scheduler, and this interaction is well defined it 
-  // is no need to protect the values of the class, or make it serialiseable.  
-  
-public:
-	
-  class StartTimeProposal
-  {
-  public:
-    
-    Time 	 				ProposedStartTime;
-    TimeInterval  ConsumptionInterval;
-    
-    StartTimeProposal( const Time AssignedStartTime, 
-								       const TimeInterval & ConsumptionPeriod )
-    : ConsumptionInterval( ConsumptionPeriod )
-    {
-      ProposedStartTime = AssignedStartTime;
-    }
-    
-    // There is a copy constructor to ensure that this can be safely passed 
-    // between threads
-    
-    StartTimeProposal( const StartTimeProposal & OtherMessage )
-		: ProposedStartTime( OtherMessage.ProposedStartTime ),
-		  ConsumptionInterval( OtherMessage.ConsumptionInterval )
-		{}
-  };
-
-  // During the computation of the local schedule the solution algorithm will 
-  // propose several possible start times, and the start time belongs to a 
-  // consumption interval. The following handler computes the total energy 
-  // by this assignment and the length of the interval according to the 
-  // objective function derived in [1].
-  
-  void ComputeTotalEnergy( const StartTimeProposal & Proposal,
-												   const Theron::Address TheScheduler );
-
+  //
   // When the scheduler has made the final decision on a start time, it sends 
   // this back to the proxy. Note that this value can be unassigned, and in 
   // this case the load cannot be scheduled on this producer.
@@ -170,8 +162,28 @@ public:
   void SetStartTime( const Producer::AssignedStartTime & Time2Start,
 								     const Theron::Address TheScheduler );
   
+  // ---------------------------------------------------------------------------
+  // Recycling
+  // ---------------------------------------------------------------------------
+  // Creating an actor for every load is expensive, and the producer therefore 
+  // keeps released proxies for reuse. Releasing a proxy acknowledges the 
+  // proxy removal to the consumer, as the destructor would do, and forgets the
+  // load. A released proxy can then be initialised for the next load.
+  
+  void Release( void );
+  
+  // A proxy can only be reused if it has no messages left for the previous 
+  // load.
+  
+  inline bool HasPendingMessages( void ) const
+  { return GetNumQueuedMessages() > 0; }
+  
+  void Reinitialise( const Producer::ScheduleCommand & TheCommand,
+                     const Theron::Address & TheConsumer );
+  
   // There is a destructor to ensure correct behaviour when this 
-  // class is deleted. By itself it does nothing.
+  // class is deleted. It acknowledges the proxy removal unless the proxy has
+  // already been released.
   
   ~ConsumerProxy( void );
 	
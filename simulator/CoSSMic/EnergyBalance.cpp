@@ -0,0 +1,241 @@
+/*=============================================================================
+  Energy Balance
+
+  The balance recorder writes the blocks of the energy balance in the
+  columnar frame format described in the header, and reads them back.
+
+  Author and Copyright: Geir Horn, University of Oslo, 2019
+  License: LGPL 3.0
+=============================================================================*/
+
+#include "EnergyBalance.hpp"
+
+namespace CoSSMic
+{
+// -----------------------------------------------------------------------------
+// Writing
+// -----------------------------------------------------------------------------
+//
+// A frame is appended to the buffer with its length, and the buffer is
+// written to the file when the block has been appended so that a dashboard
+// reading the file sees every block as soon as it is complete.
+
+void BalanceRecorder::AppendFrame( const Theron::SerialMessage::Payload & Frame )
+{
+	std::uint32_t Length = static_cast< std::uint32_t >( Frame.size() );
+
+	for ( int Byte = 0; Byte < 4; Byte++ )
+	{
+		Buffer.push_back( static_cast< char >( Length & 0xFF ) );
+		Length >>= 8;
+	}
+
+	Buffer.append( Frame );
+}
+
+void BalanceRecorder::Flush( void )
+{
+	File.write( Buffer.data(), Buffer.size() );
+	File.flush();
+	Buffer.clear();
+}
+
+// The node names are replaced by their numbers in the block frame, and a
+// name seen for the first time is defined before the block.
+
+void BalanceRecorder::WriteBlock( const EnergyBalance::Block & TheBlock,
+																  const Theron::Address TheProducer )
+{
+	if ( TheBlock.empty() ) return;
+
+	std::vector< NodeNumber > Numbers;
+
+	Numbers.reserve( TheBlock.size() );
+
+	for ( const std::string & Node : TheBlock.Node )
+	{
+		auto Known = Nodes.find( Node );
+
+		if ( Known == Nodes.end() )
+		{
+			NodeNumber 					 NewNumber = static_cast< NodeNumber >( Nodes.size() );
+			Theron::BinaryWriter Definition( NameTag );
+
+			Definition << NewNumber << Node;
+			AppendFrame( Definition.str() );
+			Known = Nodes.emplace( Node, NewNumber ).first;
+		}
+
+		Numbers.push_back( Known->second );
+	}
+
+	Theron::BinaryWriter Frame( BlockTag );
+
+	Frame << static_cast< std::uint64_t >( TheBlock.size() );
+
+	for ( Time Start : TheBlock.Start ) 						Frame << Start;
+	for ( NodeNumber Number : Numbers ) 						Frame << Number;
+	for ( double Value : TheBlock.Consumption ) 		Frame << Value;
+	for ( double Value : TheBlock.PVConsumption ) 	Frame << Value;
+	for ( double Value : TheBlock.Production ) 		Frame << Value;
+	for ( double Value : TheBlock.Shared ) 				Frame << Value;
+
+	AppendFrame( Frame.str() );
+	Flush();
+}
+
+// -----------------------------------------------------------------------------
+// Reading
+// -----------------------------------------------------------------------------
+//
+// A file ending in the middle of a frame, as it will if the recording process
+// was killed, is taken to end at the last complete frame.
+
+EnergyBalance::Block BalanceRecorder::Read( const std::string & FileName,
+																					  Time & WindowWidth )
+{
+	std::ifstream Input( FileName, std::ios::binary );
+
+	if ( !Input )
+	{
+		std::ostringstream ErrorMessage;
+
+		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "The energy balance file " << FileName
+								 << " could not be opened for reading";
+
+		throw std::invalid_argument( ErrorMessage.str() );
+	}
+
+	auto ReadFrame = [&]( Theron::SerialMessage::Payload & Frame )->bool
+	{
+		unsigned char Bytes[4];
+
+		if ( !Input.read( reinterpret_cast< char * >( Bytes ), 4 ) )
+			return false;
+
+		std::uint32_t Length = Bytes[0] | ( Bytes[1] << 8 ) |
+								( Bytes[2] << 16 ) | ( std::uint32_t( Bytes[3] ) << 24 );
+
+		Frame.resize( Length );
+
+		return static_cast< bool >( Input.read( Frame.data(), Length ) );
+	};
+
+	auto Malformed = [&]( const std::string & Reason )
+	{
+		std::ostringstream ErrorMessage;
+
+		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "Malformed energy balance file " << FileName << ": "
+								 << Reason;
+
+		throw std::logic_error( ErrorMessage.str() );
+	};
+
+	Theron::SerialMessage::Payload Frame;
+	std::uint8_t 									 Version = 0;
+
+	if ( !ReadFrame( Frame ) )
+		Malformed( "No header" );
+
+	Theron::BinaryReader Header( Frame, HeaderTag );
+
+	Header >> Version >> WindowWidth;
+
+	if ( !Header || ( Version > FileVersion ) )
+		Malformed( "Not an energy balance file of a known version" );
+
+	EnergyBalance::Block 			 Result;
+	std::vector< std::string > Names;
+
+	while ( ReadFrame( Frame ) )
+		if ( Theron::BinaryReader::Tag( Frame ) == NameTag )
+		{
+			Theron::BinaryReader Definition( Frame, NameTag );
+			NodeNumber 					 Number = 0;
+			std::string 				 Name;
+
+			Definition >> Number >> Name;
+
+			if ( !Definition || ( Number != Names.size() ) )
+				Malformed( "Invalid node definition" );
+
+			Names.push_back( Name );
+		}
+		else
+		{
+			Theron::BinaryReader TheBlock( Frame, BlockTag );
+			std::uint64_t 			 Rows = 0;
+
+			TheBlock >> Rows;
+
+			std::vector< Time > 			Start( Rows );
+			std::vector< NodeNumber > Numbers( Rows );
+			std::vector< double > 		Consumption( Rows ), PVConsumption( Rows ),
+																Production( Rows ), Shared( Rows );
+
+			for ( Time & Value : Start ) 						TheBlock >> Value;
+			for ( NodeNumber & Value : Numbers ) 		TheBlock >> Value;
+			for ( double & Value : Consumption ) 		TheBlock >> Value;
+			for ( double & Value : PVConsumption ) 	TheBlock >> Value;
+			for ( double & Value : Production ) 		TheBlock >> Value;
+			for ( double & Value : Shared ) 				TheBlock >> Value;
+
+			if ( !TheBlock )
+				Malformed( "Invalid block" );
+
+			for ( std::uint64_t Row = 0; Row < Rows; Row++ )
+			{
+				if ( Numbers[ Row ] >= Names.size() )
+					Malformed( "Undefined node" );
+
+				Result.Append( Start[ Row ], Names[ Numbers[ Row ] ],
+					EnergyBalance::Sums( Consumption[ Row ], PVConsumption[ Row ],
+															 Production[ Row ], Shared[ Row ] ) );
+			}
+		}
+
+	return Result;
+}
+
+// -----------------------------------------------------------------------------
+// Constructor and destructor
+// -----------------------------------------------------------------------------
+//
+// The header is written when the file is opened, and the destructor waits
+// for the pending blocks to be written before the buffer is flushed.
+
+BalanceRecorder::BalanceRecorder( const std::string & FileName,
+																  Time WindowWidth, const std::string & Name )
+: Actor( Name ),
+  StandardFallbackHandler( GetAddress().AsString() ),
+  File( FileName, std::ios::binary | std::ios::trunc ), Buffer(), Nodes()
+{
+	if ( !File )
+	{
+		std::ostringstream ErrorMessage;
+
+		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "The energy balance file " << FileName
+								 << " could not be opened for writing";
+
+		throw std::invalid_argument( ErrorMessage.str() );
+	}
+
+	Theron::BinaryWriter Header( HeaderTag );
+
+	Header << FileVersion << WindowWidth;
+	AppendFrame( Header.str() );
+	Flush();
+
+	RegisterHandler( this, &BalanceRecorder::WriteBlock );
+}
+
+BalanceRecorder::~BalanceRecorder( void )
+{
+	DrainMailbox();
+	Flush();
+}
+
+}      // End name space CoSSMic
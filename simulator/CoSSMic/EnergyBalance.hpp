@@ -0,0 +1,330 @@
+/*=============================================================================
+  Energy Balance
+
+  The reward calculators keep the PV energy consumed in the neighbourhood and
+  the PV energy shared by the household only as totals that grow every time a
+  load finishes. A dashboard following a live system, or the analysis of a
+  long simulation, needs the energy balance of each household per interval:
+  how much was consumed, how much of that was PV energy, how much was
+  produced, and how much was shared with the neighbours.
+
+  The energy balance sums the deltas reported for each node over tumbling
+  windows, i.e. consecutive and non-overlapping windows of a fixed width. The
+  windows are aligned to multiples of the width from time zero so that the
+  windows of different nodes cover the same intervals, and the balance of a
+  window reported by a remote node can simply be added to the window of the
+  local balance. A delta for an interval is split over the windows the
+  interval overlaps in proportion to the overlap, which assumes that the
+  energy is evenly distributed over the interval.
+
+  The windows are extracted as a block when they are complete. The block is
+  columnar: the window start times, the nodes and each of the sums are kept
+  in separate vectors with one element per window and node, and the rows are
+  sorted on the window start and then on the node name.
+
+  The blocks are written by the balance recorder, which is an actor so that
+  the file is written by its own thread and the actor producing the balance
+  only pays for sending the block. The file consists of frames in the same
+  way as the message journal: each frame has a 32 bit little-endian length
+  followed by a binary payload as written by the binary writer. The first
+  frame is the header with the width of the windows. The node names are
+  written only once in a definition frame assigning a number to the name,
+  and each block frame holds the number of rows followed by the columns: the
+  window start times, the node numbers, and the consumption, PV consumption,
+  production and shared energy sums. A column of doubles is therefore stored
+  contiguously and can be read without parsing the other columns. The frames
+  of a block are written to the file together as soon as the block has been
+  received, and the recorder offers a function to read a file back as one
+  block.
+
+  Author and Copyright: Geir Horn, University of Oslo, 2019
+  License: LGPL 3.0
+=============================================================================*/
+
+#ifndef COSSMIC_ENERGY_BALANCE
+#define COSSMIC_ENERGY_BALANCE
+
+#include <string>										// Node names
+#include <vector>										// Columns
+#include <map>											// Windows and nodes
+#include <unordered_map>						// The numbers of the recorded names
+#include <fstream>									// The balance file
+#include <sstream>									// For nicely formatted errors
+#include <stdexcept>								// Standard exceptions
+#include <algorithm>								// Min and max
+#include <cstdint>									// Fixed size integers
+
+#include "Actor.hpp"								// The Theron++ actor framework
+#include "StandardFallbackHandler.hpp"
+#include "SerialMessage.hpp"				// The payload type
+#include "BinaryPayload.hpp"				// The frame format
+
+#include "TimeInterval.hpp"					// CoSSMic time
+
+namespace CoSSMic
+{
+
+class EnergyBalance
+{
+public:
+
+	// The default width of the windows is a quarter of an hour, which is the
+	// settlement period of many electricity markets.
+
+	static constexpr Time DefaultWidth = 900;
+
+	// ---------------------------------------------------------------------------
+	// Sums
+	// ---------------------------------------------------------------------------
+	//
+	// The consumption is all energy consumed by the loads of the node, and the
+	// PV consumption is the part of it that came from PV producers. The
+	// production is the PV energy produced by the producers of the node, and
+	// the shared energy is the part of it consumed by loads on other nodes.
+
+	class Sums
+	{
+	public:
+
+		double Consumption, PVConsumption, Production, Shared;
+
+		inline Sums & operator += ( const Sums & Other )
+		{
+			Consumption 	+= Other.Consumption;
+			PVConsumption += Other.PVConsumption;
+			Production 		+= Other.Production;
+			Shared 				+= Other.Shared;
+
+			return *this;
+		}
+
+		inline Sums operator * ( double Fraction ) const
+		{
+			return Sums( Consumption * Fraction, PVConsumption * Fraction,
+									 Production * Fraction, Shared * Fraction );
+		}
+
+		Sums( double TheConsumption = 0.0, double ThePVConsumption = 0.0,
+					double TheProduction = 0.0, double TheShared = 0.0 )
+		: Consumption( TheConsumption ), PVConsumption( ThePVConsumption ),
+		  Production( TheProduction ), Shared( TheShared )
+		{ }
+
+		Sums( const Sums & Other ) = default;
+	};
+
+	// ---------------------------------------------------------------------------
+	// Blocks
+	// ---------------------------------------------------------------------------
+	//
+	// The block has one element in each column per row. It is also the message
+	// sent to the recorder.
+
+	class Block
+	{
+	public:
+
+		std::vector< Time > 				Start;
+		std::vector< std::string > 	Node;
+		std::vector< double > 			Consumption, PVConsumption, Production,
+																Shared;
+
+		inline std::size_t size( void ) const
+		{ return Start.size(); }
+
+		inline bool empty( void ) const
+		{ return Start.empty(); }
+
+		void Append( Time WindowStart, const std::string & TheNode,
+								 const Sums & Values )
+		{
+			Start.push_back( WindowStart );
+			Node.push_back( TheNode );
+			Consumption.push_back( Values.Consumption );
+			PVConsumption.push_back( Values.PVConsumption );
+			Production.push_back( Values.Production );
+			Shared.push_back( Values.Shared );
+		}
+
+		Block( void ) = default;
+		Block( const Block & Other ) = default;
+		Block( Block && Other ) = default;
+	};
+
+	// ---------------------------------------------------------------------------
+	// Windows
+	// ---------------------------------------------------------------------------
+
+private:
+
+	const Time Width;
+	std::map< Time, std::map< std::string, Sums > > Windows;
+
+public:
+
+	inline Time WindowWidth( void ) const
+	{ return Width; }
+
+	// The start of the window containing a time stamp rounds the time stamp
+	// down to a multiple of the width, also for negative time stamps.
+
+	inline Time WindowStart( Time TimeStamp ) const
+	{
+		Time Remainder = TimeStamp % Width;
+
+		return TimeStamp - Remainder - ( Remainder < 0 ? Width : 0 );
+	}
+
+	// A delta at a time stamp is added to the window containing the time
+	// stamp, and a delta for an interval is split over the windows it
+	// overlaps. An empty interval is taken as a time stamp.
+
+	inline void Add( Time TimeStamp, const std::string & Node,
+									 const Sums & Delta )
+	{
+		Windows[ WindowStart( TimeStamp ) ][ Node ] += Delta;
+	}
+
+	void Add( const TimeInterval & Interval, const std::string & Node,
+					  const Sums & Delta )
+	{
+		if ( Interval.upper() <= Interval.lower() )
+		{
+			Add( Interval.lower(), Node, Delta );
+			return;
+		}
+
+		double Length = static_cast< double >( Interval.upper()
+																					 - Interval.lower() );
+
+		for ( Time Start = WindowStart( Interval.lower() );
+				  Start < Interval.upper(); Start += Width )
+		{
+			Time Overlap = std::min( Start + Width, Interval.upper() )
+										 - std::max( Start, Interval.lower() );
+
+			Windows[ Start ][ Node ] += Delta * ( Overlap / Length );
+		}
+	}
+
+	// Another balance of the same width is merged by adding its windows. An
+	// invalid argument exception is thrown if the widths differ.
+
+	void Merge( const EnergyBalance & Other )
+	{
+		if ( Other.Width != Width )
+		{
+			std::ostringstream ErrorMessage;
+
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "Energy balance windows of width " << Other.Width
+									 << " cannot be merged with windows of width " << Width;
+
+			throw std::invalid_argument( ErrorMessage.str() );
+		}
+
+		for ( const auto & Window : Other.Windows )
+			for ( const auto & Node : Window.second )
+				Windows[ Window.first ][ Node.first ] += Node.second;
+	}
+
+	// The windows ending at or before the given time are removed from the
+	// balance and returned as a block. A delta added later to one of these
+	// windows will create the window again, and the window and node will then
+	// have a second row in a later block. The rows of the same window and node
+	// should therefore be added by the reader of the blocks.
+
+	Block Extract( Time Before )
+	{
+		Block Result;
+		auto 	Window = Windows.begin();
+
+		while ( ( Window != Windows.end() ) &&
+						( Window->first + Width <= Before ) )
+		{
+			for ( const auto & Node : Window->second )
+				Result.Append( Window->first, Node.first, Node.second );
+
+			Window = Windows.erase( Window );
+		}
+
+		return Result;
+	}
+
+	// The constructor throws an invalid argument exception if the width is
+	// not positive.
+
+	EnergyBalance( Time TheWidth = DefaultWidth )
+	: Width( TheWidth ), Windows()
+	{
+		if ( Width <= 0 )
+		{
+			std::ostringstream ErrorMessage;
+
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "The width of the energy balance windows must be "
+									 << "positive and " << TheWidth << " is not";
+
+			throw std::invalid_argument( ErrorMessage.str() );
+		}
+	}
+
+	EnergyBalance( const EnergyBalance & Other ) = default;
+};
+
+/*=============================================================================
+
+ Recorder
+
+=============================================================================*/
+//
+// The recorder receives the blocks as messages and writes them to the file
+// given to the constructor, which throws an invalid argument exception if the
+// file cannot be opened.
+
+class BalanceRecorder : virtual public Theron::Actor,
+												virtual public Theron::StandardFallbackHandler
+{
+private:
+
+	static constexpr const char * HeaderTag 	 = "ENERGY_BALANCE";
+	static constexpr const char * NameTag 		 = "N";
+	static constexpr const char * BlockTag 		 = "B";
+	static constexpr std::uint8_t FileVersion  = 1;
+
+	using NodeNumber = std::uint32_t;
+
+	std::ofstream 												 File;
+	std::string 													 Buffer;
+	std::unordered_map< std::string, NodeNumber > Nodes;
+
+	void AppendFrame( const Theron::SerialMessage::Payload & Frame );
+	void Flush( void );
+
+	// The handler writes the definitions of the new nodes of the block before
+	// the block itself.
+
+	void WriteBlock( const EnergyBalance::Block & TheBlock,
+								   const Theron::Address TheProducer );
+
+public:
+
+	// A recorded file is read back as one block with the rows in the order
+	// they were written, and the window width is returned in the second
+	// argument. A logic error exception is thrown if the file is malformed,
+	// and an invalid argument exception if it cannot be opened.
+
+	static EnergyBalance::Block Read( const std::string & FileName,
+																		Time & WindowWidth );
+
+	BalanceRecorder( const std::string & FileName, Time WindowWidth,
+									 const std::string & Name = "BalanceRecorder" );
+
+	BalanceRecorder( void ) = delete;
+	BalanceRecorder( const BalanceRecorder & Other ) = delete;
+
+	virtual ~BalanceRecorder( void );
+};
+
+}      // End name space CoSSMic
+#endif // COSSMIC_ENERGY_BALANCE
@@ -13,7 +13,6 @@
 #include <sstream>
 #include <stdexcept>
 #include "Producer.hpp"
-#include "ConsumerProxy.hpp"
 #include "Grid.hpp"
 
 namespace CoSSMic
@@ -33,41 +32,27 @@ IDType      Grid::GridID;
 // Assigning new loads
 // -----------------------------------------------------------------------------
 //
-// The default handler for the consumer requests first lets the producer's 
-// new load function construct the proxy for the consumer, and then a reference
-// to this consumer proxy is obtained and used to assign the initial start 
-// time equal to the earliest start time.
+// The default handler for the consumer requests accepts the load at its 
+// earliest start time and returns this directly to the consumer. The load is
+// only counted, and no proxy is created for it.
 
 void Grid::NewLoad( const Producer::ScheduleCommand & TheCommand, 
                     const Theron::Address TheConsumer )
 {
-  Producer::NewLoad( TheCommand, TheConsumer );
+  AcceptedLoads.fetch_add( 1, std::memory_order_relaxed );
+  AcceptedEnergy.store( AcceptedEnergy.load( std::memory_order_relaxed ) 
+												+ TheCommand.TotalEnergy(), std::memory_order_relaxed );
   
-  // It is necessary to search for the reference to the consumer proxy since 
-  // it has been constructed by the New Load handler and there is no better way
-  // to get it than to look it up. Something is seriously wrong if it does not 
-  // exist.
-  
-  ConsumerReference Consumer = FindConsumer( TheConsumer );
-  
-  if ( Consumer == EndConsumer() )
-  {
-    std::ostringstream ErrorMessage;
-    
-    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
-						     << GetAddress().AsString() << " could not create a proxy for "
-                 << TheConsumer.AsString();
-		 
-    throw std::runtime_error( ErrorMessage.str() );
-  }
-  
-  // The assigned start time is returned via the consumer's proxy since 
-  // the proxy could potentially use this information, or add extra 
-  // information before returning the result to the consumer (possibly remote)
-  
-  Send( Producer::AssignedStartTime( (*Consumer)->AllowedInterval().lower() ), 
-																		 (*Consumer)->GetAddress()  );
+  Send( Producer::AssignedStartTime( TheCommand.AllowedStartWindow().lower() ), 
+				TheConsumer );
 }
 
+// Since there is no proxy to remove, the removal is acknowledged at once. 
+
+void Grid::KillProxy( const Producer::KillProxyCommand & TheCommand, 
+                      const Theron::Address TheConsumer )
+{
+  Send( Producer::AcknowledgeProxyRemoval(), TheConsumer );
+}
   
 } // Name space CoSSMic
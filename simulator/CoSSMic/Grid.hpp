@@ -43,6 +43,8 @@
 
 #include <string>
 #include <sstream>
+#include <atomic>
+#include <cstddef>
 
 #include "Actor.hpp"
 #include "StandardFallbackHandler.hpp"
@@ -116,14 +118,40 @@ protected:
   
   // When a schedule command is received from a consumer, the new load handler 
   // is invoked. This simply accepts the load in the default implementation,
-  // and returns the earliest start time back to the consumer.
+  // and returns the earliest start time back to the consumer. 
+  //
+  // When the PV production is exhausted nearly every load falls back to the 
+  // grid, and creating a consumer proxy for each load made the grid the 
+  // bottleneck of the whole node. Since the default grid never changes the 
+  // start time it has given, it does not need to remember the loads, and it 
+  // answers the consumer directly without a proxy. The consumer cannot see 
+  // the difference since the proxy sends its messages with the producer as 
+  // the sender. The removal of the proxy is then acknowledged immediately.
+  // Note that the grid is not managed by an actor manager, and the producer's
+  // shut down protocol, which relies on the proxies, is not used for the grid.
   
   virtual void NewLoad( const Producer::ScheduleCommand & TheCommand,
-			const Theron::Address TheConsumer );
+			const Theron::Address TheConsumer ) override;
 
-  // Note that it is not necessary to implement the proxy removal handler, i.e.
-  // the kill proxy since the basic functionality of the producer's handler is
-  // sufficient with nothing to be added for the default grid.
+  virtual void KillProxy( const Producer::KillProxyCommand & TheCommand,
+                          const Theron::Address TheConsumer ) override;
+  
+  // The grid counts the loads it has accepted and their total energy for 
+  // statistics on the use of the grid. The counters are only written by the 
+  // grid's message handler, and they can be read by other threads.
+  
+private:
+  
+  std::atomic< std::size_t > AcceptedLoads;
+  std::atomic< double > 		 AcceptedEnergy;
+  
+public:
+  
+  inline std::size_t LoadsAccepted( void ) const
+  { return AcceptedLoads.load( std::memory_order_relaxed ); }
+  
+  inline double EnergyAccepted( void ) const
+  { return AcceptedEnergy.load( std::memory_order_relaxed ); }
   
 public:
   
@@ -157,7 +185,7 @@ public:
 			       "grid"  + std::string( TheID ) : std::string() ) ),
     StandardFallbackHandler( GetAddress().AsString() ),
     DeserializingActor( GetAddress().AsString() ),
-    Producer( TheID )
+    Producer( TheID ), AcceptedLoads( 0 ), AcceptedEnergy( 0.0 )
   {
     GridActorName = GetAddress().AsString();
     
@@ -33,6 +33,16 @@
   operational modi (think of different programs for a washing machine). The 
   latter form is used for producers. The best type to store these IDs is 
   a simple string. 
+  
+  The IDs are used as keys in maps and in comparisons for every energy 
+  message, and comparing or hashing the strings each time is wasteful. Each 
+  distinct ID string is therefore interned in a global table when an ID is 
+  constructed, and the ID remembers the 32-bit handle of its string in the 
+  table. Equality and hashing are then integer operations on the handles, 
+  and since the handle is copied with the ID it travels with local messages. 
+  Messages to remote actors are serialised as the ID string, and the ID is 
+  interned again by the receiving endpoint. The lexicographical order of IDs 
+  is still given by the numeric fields.
 
   Author: Geir Horn, University of Oslo, 2015-2016
   Contact: Geir.Horn [at] mn.uio.no
@@ -48,6 +58,11 @@
 #include <stdexcept>						// For standard error reporting
 #include <functional>						// For the hash function
 #include <optional>
+#include <cstdint>							// For the interned handle
+#include <vector>								// Strings of the interned handles
+#include <unordered_map>				// Handles of the interned strings
+#include <mutex>								// Exclusive lock for interning
+#include <shared_mutex>					// Shared lock for looking up IDs
 
 namespace CoSSMic
 {
@@ -56,16 +71,110 @@ namespace CoSSMic
 
 class IDType : public std::string
 {
+public:
+  
+  // ---------------------------------------------------------------------------
+  // Interning
+  // ---------------------------------------------------------------------------
+  //
+  // The handle zero is reserved for the invalid, empty ID, and the valid 
+  // handles are the positions of the strings in the table. The table is 
+  // shared by all threads, and interning an already known ID only needs a 
+  // shared lock. 
+  
+  using Handle = std::uint32_t;
+  
 private:
   
+  class InternTable
+  {
+  private:
+    
+    std::shared_mutex 												 Lock;
+    std::unordered_map< std::string, Handle > Handles;
+    std::vector< std::string >								 Strings;
+    
+  public:
+    
+    Handle Intern( const std::string & TheID )
+    {
+      if ( TheID.empty() ) return 0;
+      
+      {
+        std::shared_lock< std::shared_mutex > Reading( Lock );
+        auto Known = Handles.find( TheID );
+        
+        if ( Known != Handles.end() ) return Known->second;
+      }
+      
+      std::unique_lock< std::shared_mutex > Writing( Lock );
+      auto Known = Handles.find( TheID );
+      
+      if ( Known != Handles.end() ) 
+        return Known->second;
+      else
+      {
+        Strings.push_back( TheID );
+        Handles.emplace( TheID, static_cast< Handle >( Strings.size() ) );
+        return static_cast< Handle >( Strings.size() );
+      }
+    }
+    
+    std::string Lookup( Handle TheHandle )
+    {
+      std::shared_lock< std::shared_mutex > Reading( Lock );
+      
+      if ( ( 0 < TheHandle ) && ( TheHandle <= Strings.size() ) )
+        return Strings[ TheHandle - 1 ];
+      else
+      {
+        std::ostringstream ErrorMessage;
+        
+        ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                     << "There is no ID interned with handle " << TheHandle;
+        
+        throw std::out_of_range( ErrorMessage.str() );
+      }
+    }
+    
+    InternTable( void )
+    : Lock(), Handles(), Strings()
+    {}
+  };
+  
+  static InternTable & InternedIDs( void )
+  {
+    static InternTable TheTable;
+    return TheTable;
+  }
+  
   // The numeric fields are stored for quick reference. Note that the mode
   // is an optional field that might not be given.
   
   unsigned long int Household, Device;
   std::optional< unsigned long int > Mode;
   
+  // The handle is set when the ID string has been assigned
+  
+  Handle IDHandle;
+  
 public:
   
+  inline Handle GetHandle( void ) const
+  { return IDHandle; }
+  
+  // An ID can be recreated from its handle, which will throw if the handle 
+  // has not been interned. 
+  
+  static IDType FromHandle( Handle TheHandle )
+  {
+    if ( TheHandle == 0 )
+      return IDType();
+    else
+      return IDType( InternedIDs().Lookup( TheHandle ) );
+  }
+  
+  
   // ---------------------------------------------------------------------------
   // Operators
   // ---------------------------------------------------------------------------
@@ -87,12 +196,7 @@ public:
 
   bool operator== ( const IDType & Other ) const
   {
-    if ( empty() || Other.empty() ) 
-      return false;
-    else 
-      return (Household == Other.Household) &&
-	     (Device == Other.Device) &&
-	     (Mode == Other.Mode);
+    return ( IDHandle != 0 ) && ( IDHandle == Other.IDHandle );
   }
 
   template< class ConvertibleType >
@@ -177,6 +281,7 @@ public:
     Household = 0;
     Device    = 0;
     Mode      = std::optional< unsigned long int >();    
+    IDHandle = 0;
   }
   
   // Read-only access to the various numeric sub-fields is provided through 
@@ -211,8 +316,7 @@ public:
 
   // In order to use the ID in structures with hashed keys, a hash function 
   // will be defined in the standard name space for this type. This will be 
-  // reusing the standard hash function for strings, and in order to get access
-  // to the underlying string type, the hash class must be defined as a friend.
+  // based on the interned handle, and the hash class is defined as a friend.
   
   friend struct std::hash< IDType >;
 
@@ -229,6 +333,8 @@ public:
     Device    = Other.Device;
     Mode      = Other.Mode;
     
+    IDHandle = Other.IDHandle;
+    
     assign( Other );
     
     return *this;
@@ -243,6 +349,8 @@ public:
     Device    = Other.Device;
     Mode      = Other.Mode;
     
+    IDHandle = Other.IDHandle;
+    
     assign( Other );
     
     return *this;
@@ -257,7 +365,7 @@ public:
   // constructor.
   
   inline IDType( void )
-  : std::string(), Mode()
+  : std::string(), Mode(), IDHandle( 0 )
   {
     Household = 0;
     Device    = 0;
@@ -325,6 +433,7 @@ public:
 					IDString << ":[" << ModeID << "]";
 	      case 2:
 				  assign( IDString.str() );	
+					IDHandle = InternedIDs().Intern( *this );
 					break;
 	      default:
 					Clear();
@@ -363,6 +472,7 @@ public:
     }
     
     assign( IDString.str() );
+    IDHandle = InternedIDs().Intern( *this );
   }
   
   // The copy constructor simply assigns all fields based on the values of 
@@ -374,6 +484,7 @@ public:
     Household = Other.Household;
     Device    = Other.Device;
     Mode      = Other.Mode;
+    IDHandle = Other.IDHandle;
   }
   
   // The move constructor is similar for the scalar fields, but should use the 
@@ -385,6 +496,7 @@ public:
     Household = Other.Household;
     Device    = Other.Device;
     Mode      = Other.Mode;    
+    IDHandle = Other.IDHandle;
   }
     
   // ---------------------------------------------------------------------------
@@ -433,8 +545,9 @@ inline bool ValidID( const IDType & TheID )
 }	// End name space CoSSMic
 
 // There is also a hash function to allow unordered maps and other structures 
-// using the hash value of an ID. This is based on the string representation 
-// of the ID, and uses the standard string hash function. It is defined in the 
+// using the hash value of an ID. This is based on the interned handle of the 
+// ID, which is spread over the bits of the hash value by a Fibonacci hash 
+// since the handles are small consecutive integers. It is defined in the 
 // standard name space to allow unqualified used with the STL containers
 
 namespace std {
@@ -446,7 +559,8 @@ namespace std {
     
     size_t operator() (const CoSSMic::IDType & TheID ) const
     {
-      return std::hash< string >()( static_cast< string >( TheID ) );
+      return static_cast< size_t >( TheID.IDHandle ) * 
+             static_cast< size_t >( 0x9E3779B97F4A7C15ULL );
     }
   };
   
@@ -14,53 +14,56 @@
 #include <gsl/gsl_errno.h>
 #include <sstream>
 #include <vector>
-#include <set>
 #include <functional>
 #include <fstream>
 #include <stdexcept>
+#include <algorithm>
 
 // ----------------------------------------------------------------------------
 // Initialisation functions
 //-----------------------------------------------------------------------------
 
-void Interpolation::ComputeCoefficients(void)
+void Interpolation::ComputeCoefficients( KnotVector && NewAbscissa, 
+                                         KnotVector && NewOrdinate )
 {
-  // First the state objects are initialised according to the type of 
-  // interpolation desired
+  // The new knots are created from the data vectors, and they will free the 
+  // GSL object if an exception is thrown before they replace the knots of 
+  // this object.
   
-  std::unique_lock< std::mutex > Lock( AcceleratorLock );
+  auto NewKnots = std::allocate_shared< KnotData >( 
+                  std::pmr::polymorphic_allocator< KnotData >( KnotMemory() ),
+                  std::move( NewAbscissa ), std::move( NewOrdinate ) );
   
-  AcceleratorObject   = gsl_interp_accel_alloc();
+  // First the state objects are initialised according to the type of 
+  // interpolation desired
   
-  Lock.unlock();
-	
 	// Allocate the interpolation object based on the requested interpolation 
 	// type.
 	
 	switch ( InterpolationType )
   {
 		case Type::Linear :
-			InterpolationObject = gsl_interp_alloc( gsl_interp_linear, 
-																							Abscissa.size() );
+			NewKnots->Object = gsl_interp_alloc( gsl_interp_linear, 
+																							NewKnots->Abscissa.size() );
 			break;
 		case Type::Polynomial :
-			InterpolationObject = gsl_interp_alloc( gsl_interp_polynomial, 
-																							Abscissa.size() );
+			NewKnots->Object = gsl_interp_alloc( gsl_interp_polynomial, 
+																							NewKnots->Abscissa.size() );
 			break;
 		case Type::CubicSpline :
-			InterpolationObject = gsl_interp_alloc( gsl_interp_cspline, 
-																							Abscissa.size() );
+			NewKnots->Object = gsl_interp_alloc( gsl_interp_cspline, 
+																							NewKnots->Abscissa.size() );
 			break;
 		case Type::AkimaSpline :
-			InterpolationObject = gsl_interp_alloc( gsl_interp_akima, 
-																							Abscissa.size() );
+			NewKnots->Object = gsl_interp_alloc( gsl_interp_akima, 
+																							NewKnots->Abscissa.size() );
 			break;
 		case Type::SteffenMethod :
-			InterpolationObject = gsl_interp_alloc( gsl_interp_steffen, 
-																							Abscissa.size() );
+			NewKnots->Object = gsl_interp_alloc( gsl_interp_steffen, 
+																							NewKnots->Abscissa.size() );
 			break;
 		case Type::PeriodicCubicSpline :
-			if ( Ordinate.front() != Ordinate.back() )
+			if ( NewKnots->Ordinate.front() != NewKnots->Ordinate.back() )
 			{
 				std::ostringstream ErrorMessage;
 	
@@ -71,11 +74,11 @@ void Interpolation::ComputeCoefficients(void)
 				throw std::length_error( ErrorMessage.str() );
 			}
 			else
-				 InterpolationObject = gsl_interp_alloc( gsl_interp_cspline_periodic, 
-																							   Abscissa.size() );
+				 NewKnots->Object = gsl_interp_alloc( gsl_interp_cspline_periodic, 
+																							   NewKnots->Abscissa.size() );
 		  break;
 		case Type::PeriodicAkimaSpline :
-			if ( Ordinate.front() != Ordinate.back() )
+			if ( NewKnots->Ordinate.front() != NewKnots->Ordinate.back() )
 			{
 				std::ostringstream ErrorMessage;
 	
@@ -86,21 +89,21 @@ void Interpolation::ComputeCoefficients(void)
 				throw std::length_error( ErrorMessage.str() );
 			}
 			else
-				InterpolationObject = gsl_interp_alloc( gsl_interp_akima_periodic, 
-																							  Abscissa.size() );
+				NewKnots->Object = gsl_interp_alloc( gsl_interp_akima_periodic, 
+																							  NewKnots->Abscissa.size() );
 			break;
 	}
   
   // Checking that there are more than the minimum number of samples required 
   // by the interpolation type
   
-  if ( Abscissa.size() < gsl_interp_min_size( InterpolationObject ) )
+  if ( NewKnots->Abscissa.size() < gsl_interp_min_size( NewKnots->Object ) )
 	{
 		std::ostringstream ErrorMessage;
 
 		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
 								 << "Not enough points for the interpolation type "
-								 << gsl_interp_name( InterpolationObject );
+								 << gsl_interp_name( NewKnots->Object );
 								 
 		throw std::length_error( ErrorMessage.str() );
 	}
@@ -108,25 +111,40 @@ void Interpolation::ComputeCoefficients(void)
   // Finally the data vectors are used to solve the coefficients of the 
   // interpolation function and initialise the interpolation object
 
-  gsl_interp_init( InterpolationObject, Abscissa.data(), Ordinate.data(), 
-									 Abscissa.size() );
+  gsl_interp_init( NewKnots->Object, NewKnots->Abscissa.data(), NewKnots->Ordinate.data(), 
+									 NewKnots->Abscissa.size() );
+  
+  Knots = NewKnots;
 }
 
-// The clean up function resets the object to an empty place holder.
+// The memory account is looked up once since the interpolations are created
+// frequently. The memory accounting must therefore be enabled before the 
+// first interpolation is created for the knots to be accounted.
 
-void Interpolation::CleanUp( void )
+std::pmr::memory_resource * Interpolation::KnotMemory( void )
 {
-  Abscissa.clear();
-  Ordinate.clear();
+  static std::pmr::memory_resource * 
+         KnotAccount( Theron::MemoryAccounting::Resource( "Interpolation" ) );
   
-  if ( InterpolationObject != nullptr )
-    gsl_interp_free( InterpolationObject );
+  return KnotAccount;
+}
+
+// The clean up function resets the object to an empty place holder, which 
+// refers to the shared empty knots. The GSL object of the current knots is 
+// freed when no other interpolation uses the knots.
+
+const std::shared_ptr< const Interpolation::KnotData > & 
+Interpolation::EmptyKnots( void )
+{
+  static const std::shared_ptr< const KnotData > 
+         NoKnots( std::make_shared< const KnotData >() );
   
-  if ( AcceleratorObject != nullptr )
-  {
-    std::unique_lock< std::mutex > Lock( AcceleratorLock );
-    gsl_interp_accel_free( AcceleratorObject );
-  }
+  return NoKnots;
+}
+
+void Interpolation::CleanUp( void )
+{
+  Knots = EmptyKnots();
   
   // The offset is off course zero since there are no data.
   
@@ -134,75 +152,27 @@ void Interpolation::CleanUp( void )
   Offset.y = 0.0;
 }
 
-// ----------------------------------------------------------------------------
-// Operators
-//-----------------------------------------------------------------------------
-
-// The first helper function constructs a common abscissa from two abscissae 
-// vectors. It uses temporarily a set to ensure that the abscissa values are 
-// unique and sorted. First the elements of the two abscissae are inserted
-// into the set, and then the resulting values of the set are exported into
-// the returned vector.
+// The default cursor is created the first time a thread evaluates an 
+// interpolation function without giving a cursor, and it is then reused by 
+// all such evaluations of this thread.
 
-inline std::vector<double> Union( const std::vector<double> & First,
-				  double FirstOffset,
-				  const std::vector<double> & Second,
-				  double SecondOffset	)
+Interpolation::Cursor & Interpolation::ThreadCursor( void )
 {
-  std::set<double> Members;
-  
-  // Inserting the vectors' values adding the respective offsets
-  
-  for (double x : First ) 
-    Members.insert( x + FirstOffset );
-  
-  for (double x : Second )
-    Members.insert( x + SecondOffset );
+  static thread_local Cursor DefaultCursor;
   
-  return std::vector<double>( Members.begin(), Members.end() );
+  return DefaultCursor;
 }
 
-// The second helper function computes the a vector of function values based
-// on the combination of two interpolation functions and an abscissa vector. It 
-// basically loops over all the arguments. If the argument is in the domain of
-// only one of the interpolation functions, that function is used to compute 
-// the ordinate value, but if it can be supported by both functions, the 
-// combination function is used.
-//
-// Implementation note: a template is used instead of an inline function because
-// the provided function to combine the values of the interpolation functions
-// is probably a lambda, which can be efficiently passed as a template 
-// (move = &&) argument. For a regular (inline) function, it would have to 
-// encapsulated in a std::function object, which would lead to a virtual 
-// function call at runtime (indirect function call), which is less efficient.
-// See the very good note at:
-// http://stackoverflow.com/questions/16111285/how-to-pass-and-execute-anonymous-function-as-parameter-in-c11
-
-template < typename Function >
-std::vector<double> ComputeOrdinates( 
-  const std::vector<double> & Arguments,
-  Interpolation & f, Interpolation & g,
-  Function && Combination )
-{
-  std::vector<double> Ordinates;
-  
-  for ( double x : Arguments )
-    if ( ! f.DomainQ(x) )
-      Ordinates.push_back( g(x) );
-    else if ( ! g.DomainQ(x) )
-      Ordinates.push_back( f(x) );
-    else
-      Ordinates.push_back( Combination(x) );
-    
-  return Ordinates;
-}
+// ----------------------------------------------------------------------------
+// Operators
+//-----------------------------------------------------------------------------
 
-// The third helper function is used to select the interpolation type to use 
-// when combining two interpolation functions. It will always select the most
-// continuous version, or the periodic version if one of the two types is 
-// periodic. It then tacitly assumes that the combined domain for the the two
-// functions will support the requirement for periodicity, i.e. that the first 
-// and the last ordinate values are identical.
+// The most continuous interpolation type is selected when combining two 
+// interpolation functions. It will always select the most continuous version,
+// or the periodic version if one of the two types is periodic. It then 
+// tacitly assumes that the combined domain for the the two functions will 
+// support the requirement for periodicity, i.e. that the first and the last 
+// ordinate values are identical.
 //
 // Implementation note: Since the use of the [] operator makes the priority 
 // comparison elegant, we cannot use const on the priority map (even though it 
@@ -211,8 +181,7 @@ std::vector<double> ComputeOrdinates(
 // function signature and the map should contain all the enumerated types, 
 // hence it will never be extended by the [] operator.
 
-inline Interpolation::Type SelectInterpolationType (
-  Interpolation::Type First, Interpolation::Type Second )
+Interpolation::Type Interpolation::MostContinuous( Type First, Type Second )
 {
   static std::map< Interpolation::Type, unsigned int > Priority =
   {
@@ -231,65 +200,13 @@ inline Interpolation::Type SelectInterpolationType (
     return Second;
 }
 
-// All the operators will use these three helper functions with slightly 
-// different arguments for the combination function. Thus, they could have been
-// represented as a generic member function, but this would require that the 
-// helper functions had to be defined in the header file, making the interface
-// less readable, and with uncertain performance gains. Hence, we rather use 
-// a parameter and a switch to decide how the ordinate values should be 
-// computed. Note that in this case we only need to consider the offset when 
-// computing the new, joint abscissa since the offset in the ordinate will be 
-// handled when computing the values of the two interpolation functions.
-
-Interpolation Interpolation::GenericOperator( 
-  Interpolation& Other, Interpolation::BinaryType OperatorType) 
+// The knots of an operand of an expression are appended with the offset of 
+// the abscissa since the operand will be evaluated with this offset.
+
+void Interpolation::AppendKnots( std::vector< double > & Grid ) const
 {
-  Interpolation CombinedFunction;
-  
-  // First the final interpolation type for the combined object is found
-  
-  CombinedFunction.InterpolationType = SelectInterpolationType( 
-    InterpolationType, Other.InterpolationType
-  );
-  
-  // Then the combined abscissa is constructed from the two domains involved
-  
-  CombinedFunction.Abscissa = Union( Abscissa, Offset.x,
-				     Other.Abscissa, Other.Offset.x );
-  
-  // The ordinates will depend on which operator type that is implemented. The 
-  // only difference is the combination function passed to the computation 
-  // function.
-  
-  switch ( OperatorType )
-  {
-    case BinaryType::Plus :
-      CombinedFunction.Ordinate = ComputeOrdinates( 
-	  CombinedFunction.Abscissa, *this, Other, 
-	  [this, &Other](double x){ return this->operator()(x) + Other(x); } );
-      break;
-    case BinaryType::Minus :
-      CombinedFunction.Ordinate = ComputeOrdinates( 
-	  CombinedFunction.Abscissa, *this, Other, 
-	  [this, &Other](double x){ return this->operator()(x) - Other(x); } );      
-      break;
-    case BinaryType::Multiply :
-      CombinedFunction.Ordinate = ComputeOrdinates( 
-	  CombinedFunction.Abscissa, *this, Other, 
-	  [this, &Other](double x){ return this->operator()(x) * Other(x); } );
-      break;
-    case BinaryType::Divide :
-      CombinedFunction.Ordinate = ComputeOrdinates( 
-	  CombinedFunction.Abscissa, *this, Other, 
-	  [this, &Other](double x){ return this->operator()(x) / Other(x); } );     
-      break;
-  }
-  
-  // Finally we can compute the actual interpolation over this new domain
-  
-  CombinedFunction.ComputeCoefficients();
-  
-  return CombinedFunction;
+  for ( double x : Knots->Abscissa )
+    Grid.push_back( x + Offset.x );
 }
 
 // The functor operator throws an error message if the provided argument value
@@ -302,9 +219,9 @@ Interpolation Interpolation::GenericOperator(
 // Calling the operator on an uninitialised interpolation, as determined by the 
 // size of the abscissa, will throw an out of range error.
 
-double Interpolation::operator()(double x)
+double Interpolation::operator()(double x, Cursor & Hint) const
 {
-  if ( Abscissa.empty() )
+  if ( Knots->Abscissa.empty() )
 	{
 		std::ostringstream ErrorMessage;
 
@@ -317,14 +234,10 @@ double Interpolation::operator()(double x)
   {   
     double Value;
     
-    std::unique_lock< std::mutex > Lock( AcceleratorLock );
-    
-    int Status = gsl_interp_eval_e( InterpolationObject, Abscissa.data(), 
-			    Ordinate.data(), x - Offset.x, AcceleratorObject, 
+    int Status = gsl_interp_eval_e( Knots->Object, Knots->Abscissa.data(), 
+			    Knots->Ordinate.data(), x - Offset.x, Hint.Hint( Knots->Abscissa ), 
 			    &Value );
     
-    Lock.unlock();
-    
     if ( Status == GSL_EDOM )
     {
       std::stringstream ErrorMessage;
@@ -332,8 +245,8 @@ double Interpolation::operator()(double x)
       ErrorMessage << __FILE__ << " at line " << __LINE__ << ": " 
 									 << "Interpolation: Requested argument " << x 
 							     << " is outside the interpolation range ["
-							     << Abscissa.front() + Offset.x << "," 
-							     << Abscissa.back() + Offset.x << "]";
+							     << Knots->Abscissa.front() + Offset.x << "," 
+							     << Knots->Abscissa.back() + Offset.x << "]";
 		    
       throw std::out_of_range( ErrorMessage.str() );
     }
@@ -342,61 +255,222 @@ double Interpolation::operator()(double x)
   }
 }
 
-// The copy assignment operator copies the data set vectors and interpolation
-// type and then computes its own interpolation. The latter could have been 
-// implemented by a memcopy (in principle), but the objects dealt with are 
-// C structures whose internal structure belongs to the GSL to define and 
-// initialise.
+// ----------------------------------------------------------------------------
+// Batched evaluation
+//-----------------------------------------------------------------------------
+//
+// The batched evaluation functions share the tests on the arguments. The 
+// empty interpolation throws as for the single evaluation, and the domain is 
+// tested for the first and the last value of the sorted arguments only.
 
-void Interpolation::operator=(Interpolation & Other)
+void Interpolation::BatchDomainTest( double First, double Last ) const
 {
-  // First we clean the data currently maintained by this interpolation object
-  
-  CleanUp();
-  
-  // Copy the data set vectors and the interpolation type
-  
-  Abscissa 	    = Other.Abscissa;
-  Ordinate 	    = Other.Ordinate;
-  InterpolationType = Other.InterpolationType;
+  if ( Knots->Abscissa.empty() )
+	{
+		std::ostringstream ErrorMessage;
+
+		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "Evaluation of an empty interpolation object";
+								 
+		throw std::length_error( ErrorMessage.str() );
+	}
   
-  // Copy the offset
+  if ( ( First - Offset.x < Knots->Abscissa.front() ) || 
+       ( Last  - Offset.x > Knots->Abscissa.back()  ) )
+  {
+    std::ostringstream ErrorMessage;
+    
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": " 
+								 << "Interpolation: Requested arguments [" << First << "," 
+								 << Last << "] are outside the interpolation range ["
+								 << Knots->Abscissa.front() + Offset.x << "," 
+								 << Knots->Abscissa.back() + Offset.x << "]";
+		    
+    throw std::out_of_range( ErrorMessage.str() );
+  }
+}
+
+// For sorted arguments the linear interpolation walks the knots and for each 
+// knot interval it computes the values of all the arguments in the interval 
+// by a loop without branches that can be vectorised. The other interpolation
+// types keep their coefficients inside the GSL, and they are evaluated by the
+// GSL under a single lock where the accelerator will find the interval of 
+// the next argument in constant time since the arguments are sorted.
+
+void Interpolation::Evaluate( const double * x, double * y, std::size_t Count,
+														  Cursor & Hint ) const
+{
+  if ( Count == 0 ) return;
   
-  Offset.x = Other.Offset.x;
-  Offset.y = Other.Offset.y;
+  if ( !std::is_sorted( x, x + Count ) )
+  {
+    for ( std::size_t i = 0; i < Count; i++ )
+      y[i] = operator()( x[i], Hint );
+    
+    return;
+  }
   
-  // Reinitialise the interpolation objects
+  BatchDomainTest( x[0], x[ Count - 1 ] );
   
-  ComputeCoefficients();
+  if ( InterpolationType == Type::Linear )
+  {
+    std::size_t Knot = 0, LastInterval = Knots->Abscissa.size() - 2, First = 0;
+    
+    while ( First < Count )
+    {
+      while ( ( Knot < LastInterval ) && 
+							( Knots->Abscissa[ Knot + 1 ] <= x[ First ] - Offset.x ) )
+				Knot++;
+      
+      std::size_t End = First + 1;
+      
+      if ( Knot == LastInterval )
+				End = Count;
+      else
+				while ( ( End < Count ) && 
+								( x[ End ] - Offset.x < Knots->Abscissa[ Knot + 1 ] ) )
+				  End++;
+      
+      const double X0    = Knots->Abscissa[ Knot ] + Offset.x, 
+								   Y0    = Knots->Ordinate[ Knot ] + Offset.y,
+								   Slope = ( Knots->Ordinate[ Knot + 1 ] - Knots->Ordinate[ Knot ] ) / 
+												   ( Knots->Abscissa[ Knot + 1 ] - Knots->Abscissa[ Knot ] );
+      
+      for ( std::size_t i = First; i < End; i++ )
+				y[i] = Y0 + Slope * ( x[i] - X0 );
+      
+      First = End;
+    }
+  }
+  else
+  {
+    gsl_interp_accel * Accelerator = Hint.Hint( Knots->Abscissa );
+    
+    for ( std::size_t i = 0; i < Count; i++ )
+    {
+      int Status = gsl_interp_eval_e( Knots->Object, Knots->Abscissa.data(), 
+								      Knots->Ordinate.data(), x[i] - Offset.x, Accelerator, 
+								      &y[i] );
+      
+      if ( Status != GSL_SUCCESS )
+			{
+				std::ostringstream ErrorMessage;
+
+				ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+										 << gsl_strerror( Status );
+										 
+				throw std::out_of_range( ErrorMessage.str() );
+			}
+      
+      y[i] += Offset.y;
+    }
+  }
 }
 
-// The move operator first ensures that this object is completely emptied 
-// before swapping elements with the other object and resetting its 
-// interpolation objects.
+// The integrals over consecutive intervals are for the linear interpolation 
+// computed as differences of the anti-derivative at the limits. The 
+// anti-derivative at the start of the current knot interval is accumulated 
+// as the knots are passed by the sorted limits, so that the integrals are 
+// computed in one pass over the knots. Unsorted limits are integrated one 
+// interval at the time.
 
-void Interpolation::operator=( Interpolation && Other)
+void Interpolation::Integrals( const double * Limits, double * Values, 
+															 std::size_t Count, Cursor & Hint ) const
 {
-  // Clear this object
+  if ( Count == 0 ) return;
   
-  CleanUp();  
+  if ( !std::is_sorted( Limits, Limits + Count + 1 ) )
+  {
+    for ( std::size_t i = 0; i < Count; i++ )
+      Values[i] = Integral( Limits[i], Limits[ i + 1 ], Hint );
+    
+    return;
+  }
   
-  // Grab the content of the other object
+  BatchDomainTest( Limits[0], Limits[ Count ] );
   
-  Abscissa.swap( Other.Abscissa );
-  Ordinate.swap( Other.Ordinate );
+  if ( InterpolationType == Type::Linear )
+  {
+    std::size_t Knot = 0, LastInterval = Knots->Abscissa.size() - 2;
+    double      KnotIntegral = 0.0, Previous = 0.0;
+    
+    for ( std::size_t i = 0; i <= Count; i++ )
+    {
+      double Position = Limits[i] - Offset.x;
+      
+      while ( ( Knot < LastInterval ) && ( Knots->Abscissa[ Knot + 1 ] <= Position ) )
+      {
+				KnotIntegral += 0.5 * ( Knots->Ordinate[ Knot ] + Knots->Ordinate[ Knot + 1 ] )
+											* ( Knots->Abscissa[ Knot + 1 ] - Knots->Abscissa[ Knot ] );
+				Knot++;
+      }
+      
+      double Width = Position - Knots->Abscissa[ Knot ],
+						 Slope = ( Knots->Ordinate[ Knot + 1 ] - Knots->Ordinate[ Knot ] ) / 
+										 ( Knots->Abscissa[ Knot + 1 ] - Knots->Abscissa[ Knot ] ),
+						 AntiDerivative = KnotIntegral 
+										 + Width * ( Knots->Ordinate[ Knot ] + 0.5 * Slope * Width );
+      
+      if ( i > 0 )
+				Values[ i - 1 ] = AntiDerivative - Previous 
+												+ Offset.y * ( Limits[i] - Limits[ i - 1 ] );
+      
+      Previous = AntiDerivative;
+    }
+  }
+  else
+  {
+    gsl_interp_accel * Accelerator = Hint.Hint( Knots->Abscissa );
+    
+    for ( std::size_t i = 0; i < Count; i++ )
+    {
+      int Status = gsl_interp_eval_integ_e( Knots->Object, 
+								   Knots->Abscissa.data(), Knots->Ordinate.data(), 
+								   Limits[i] - Offset.x, Limits[ i + 1 ] - Offset.x, 
+								   Accelerator, &Values[i] );
+      
+      if ( Status != GSL_SUCCESS )
+			{
+				std::ostringstream ErrorMessage;
+
+				ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+										 << gsl_strerror( Status );
+										 
+				throw std::length_error( ErrorMessage.str() );
+			}
+      
+      Values[i] += Offset.y * ( Limits[ i + 1 ] - Limits[i] );
+    }
+  }
+}
+
+// The copy assignment operator shares the knots of the other object since 
+// they are immutable, and copies the interpolation type and the offset. The 
+// GSL object is therefore not initialised again.
+
+void Interpolation::operator=( const Interpolation & Other)
+{
+  Knots             = Other.Knots;
+  InterpolationType = Other.InterpolationType;
   
-  InterpolationObject = Other.InterpolationObject;
-  AcceleratorObject   = Other.AcceleratorObject;
+  Offset.x = Other.Offset.x;
+  Offset.y = Other.Offset.y;
+}
+
+// The move operator takes over the knots of the other object, and leaves the 
+// other object as an empty place holder.
+
+void Interpolation::operator=( Interpolation && Other)
+{
+  if ( this == &Other ) return;
   
+  Knots               = std::move( Other.Knots );
   InterpolationType   = Other.InterpolationType;
   
   Offset.x            = Other.Offset.x;
   Offset.y            = Other.Offset.y;
   
-  // Clear the other object
-  
-  Other.InterpolationObject = nullptr;
-  Other.AcceleratorObject   = nullptr;
+  Other.CleanUp();
 }
 
 // ----------------------------------------------------------------------------
@@ -429,12 +503,12 @@ void Interpolation::RestrictDomain( double NewLowerLimit, double NewUpperLimit )
     // Then the interior points of the existing abscissa and ordinate values 
     // are inserted taking into account the possible offsets.
     
-    for ( unsigned int i = 0; i < Abscissa.size(); i++ )
+    for ( unsigned int i = 0; i < Knots->Abscissa.size(); i++ )
     {
-      double x = Abscissa[i] + Offset.x;
+      double x = Knots->Abscissa[i] + Offset.x;
       
       if ( (NewLowerLimit < x) && (x < NewUpperLimit) )
-	DataPoints.emplace( x, Ordinate[i] + Offset.y );
+	DataPoints.emplace( x, Knots->Ordinate[i] + Offset.y );
     }
     
     // Computing the interpolation over the new domain is the final step of 
@@ -468,9 +542,7 @@ void Interpolation::RestrictDomain( double NewLowerLimit, double NewUpperLimit )
 
 Interpolation::Interpolation( const std::string Filename, 
 			      Interpolation::Type DesiredInterpolationType )
-: Abscissa(), Ordinate(),
-  InterpolationObject( nullptr ), AcceleratorObject( nullptr ), 
-  AcceleratorLock()
+: Knots( EmptyKnots() )
 {
   std::map< double, double > DataPoints;
   std::ifstream DataFile( Filename );
@@ -502,17 +574,13 @@ Interpolation::Interpolation( const std::string Filename,
 // no effect on derivation, but an ordinate offset will give a constant bias 
 // on the integral value.
 
-double Interpolation::FirstDerivative(double x)
+double Interpolation::FirstDerivative(double x, Cursor & Hint) const
 {
   double Value;
   
-  std::unique_lock< std::mutex > Lock( AcceleratorLock );
-  
-  int Status = gsl_interp_eval_deriv_e( InterpolationObject, 
-		  Abscissa.data(), Ordinate.data(), x - Offset.x, 
-		  AcceleratorObject, &Value               );
-  
-  Lock.unlock();
+  int Status = gsl_interp_eval_deriv_e( Knots->Object, 
+		  Knots->Abscissa.data(), Knots->Ordinate.data(), x - Offset.x, 
+		  Hint.Hint( Knots->Abscissa ), &Value           );
   
   if ( Status != GSL_SUCCESS )
 	{
@@ -527,16 +595,13 @@ double Interpolation::FirstDerivative(double x)
     return Value;
 }
 
-double Interpolation::SecondDerivative(double x)
+double Interpolation::SecondDerivative(double x, Cursor & Hint) const
 {
   double Value;
-  std::unique_lock< std::mutex > Lock( AcceleratorLock );
   
-  int Status = gsl_interp_eval_deriv2_e( InterpolationObject, 
-		  Abscissa.data(), Ordinate.data(), x - Offset.x, 
-		  AcceleratorObject, &Value               );
-
-  Lock.unlock();
+  int Status = gsl_interp_eval_deriv2_e( Knots->Object, 
+		  Knots->Abscissa.data(), Knots->Ordinate.data(), x - Offset.x, 
+		  Hint.Hint( Knots->Abscissa ), &Value           );
   
   if ( Status != GSL_SUCCESS )
 	{
@@ -551,17 +616,14 @@ double Interpolation::SecondDerivative(double x)
     return Value;
 }
 
-double Interpolation::Integral(double From, double To)
+double Interpolation::Integral(double From, double To, Cursor & Hint) const
 {
   double Value;
-  std::unique_lock< std::mutex > Lock( AcceleratorLock );
   
-  int Status = gsl_interp_eval_integ_e( InterpolationObject, 
-		  Abscissa.data(), Ordinate.data(), 
+  int Status = gsl_interp_eval_integ_e( Knots->Object, 
+		  Knots->Abscissa.data(), Knots->Ordinate.data(), 
 		  From -Offset.x, To - Offset.x, 
-		  AcceleratorObject, &Value               );
-  
-  Lock.unlock();
+		  Hint.Hint( Knots->Abscissa ), &Value           );
   
   if ( Status != GSL_SUCCESS )
 	{
@@ -70,8 +70,11 @@
 #include <utility>
 #include <stdexcept>
 #include <sstream>
-
-#include <mutex>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <algorithm>
+#include <functional>
 
 // The GNU Scientific Library (GSL) defines some functions as in-line if that is 
 // supported by the compiler. However, they are not declared in-line by default
@@ -79,6 +82,20 @@
 
 #include <gsl/gsl_interp.h> 
 
+// Flat time series can be interpolated without conversion
+
+#include "TimeSeries.hpp"
+
+// The knots are allocated from the memory account of the interpolations
+
+#include "MemoryAccounting.hpp"
+
+// Combinations of interpolations are represented by expressions defined 
+// after the interpolation class.
+
+template< class Left, class Right, class Operator >
+class InterpolationExpression;
+
 class Interpolation
 {
 public:
@@ -97,6 +114,71 @@ public:
 		SteffenMethod
   };
   
+  // The GSL uses an accelerator object to remember the knot interval of the 
+  // last evaluation, and the interval of the next argument is then found in 
+  // constant time if it is in the same or the neighbouring interval. The 
+  // accelerator is written by every evaluation, and if it was stored with 
+  // the interpolation object, the object could not be shared by threads 
+  // without locking. The accelerator is therefore kept in a cursor owned by 
+  // the caller, and the interpolation object itself is not changed by the 
+  // evaluations. A cursor can be used with many interpolation objects, and it
+  // is reset when it is used with another object than the last one. The 
+  // evaluation functions taking no cursor use a cursor local to the calling 
+  // thread. Hence, an interpolation object can be shared by many threads, 
+  // for instance as a shared pointer to a constant interpolation, as long as 
+  // no thread changes the object.
+  
+  class Cursor
+  {
+  private:
+    
+    gsl_interp_accel * Accelerator;
+    const double *     Knots;
+    std::size_t        NumberOfKnots;
+    
+  public:
+    
+    // The accelerator is reset if the cursor is used with other knots than 
+    // the last time since the remembered interval could then be outside the 
+    // range of the knots.
+    
+    inline gsl_interp_accel * Hint( const std::pmr::vector< double > & Abscissa )
+    {
+      if ( ( Knots != Abscissa.data() ) || ( NumberOfKnots != Abscissa.size() ) )
+      {
+				gsl_interp_accel_reset( Accelerator );
+				Knots         = Abscissa.data();
+				NumberOfKnots = Abscissa.size();
+      }
+      
+      return Accelerator;
+    }
+    
+    // A new cursor, also when copied, starts without a remembered interval.
+    
+    Cursor( void )
+    : Accelerator( gsl_interp_accel_alloc() ), Knots( nullptr ), 
+      NumberOfKnots( 0 )
+    {}
+    
+    Cursor( const Cursor & Other )
+    : Cursor()
+    {}
+    
+    Cursor & operator= ( const Cursor & Other ) = delete;
+    
+    ~Cursor( void )
+    {
+      gsl_interp_accel_free( Accelerator );
+    }
+  };
+  
+private:
+  
+  // The default cursor of the calling thread
+  
+  static Cursor & ThreadCursor( void );
+  
 protected:
   
   // The interpolation object remembers which type of interpolation is used.
@@ -111,35 +193,65 @@ protected:
 private:
   
   // It is necessary for the class to store the abscissa and ordinate values
-  // (data points) of the function to interpolate.
-  
-  std::vector <double> Abscissa, Ordinate;
-  
-  // The GSL needs an accelerator object holding the state of searches and an 
-  // interpolation object holding the static state (coefficients) computed from 
-  // the data. Both are dynamically allocated by the initialiser and deleted 
-  // by the destructor
-  
-  gsl_interp * InterpolationObject;
+  // (data points) of the function to interpolate, and the GSL needs an 
+  // interpolation object holding the static state (coefficients) computed 
+  // from the data. The GSL object is passed as a constant to every GSL 
+  // evaluation function, and concurrent evaluations are safe. The state of 
+  // searches is kept in the cursor given to the evaluations.
+  //
+  // The data points and the GSL object never change once the coefficients 
+  // have been computed, and they are therefore kept in an immutable structure
+  // that is shared by all copies of the interpolation. Copying an 
+  // interpolation is then just copying a shared pointer, and moving it is 
+  // taking over the pointer. Any change of the data points creates a new 
+  // structure, and the GSL object is freed when the last interpolation using 
+  // it is destroyed. An empty interpolation refers to a shared empty 
+  // structure so that the knots are always available.
+  //
+  // The structure and the data vectors are allocated from the memory account
+  // of the interpolations so that the memory of the knots can be reported. 
+  // The GSL object is allocated by the GSL and it is not accounted.
+
+  using KnotVector = std::pmr::vector< double >;
   
-  // The accelerator object contains information about the interpolation 
-  // function that may speed up some computations.
+  static std::pmr::memory_resource * KnotMemory( void );
   
-  gsl_interp_accel * AcceleratorObject;
+  class KnotData
+  {
+  public:
+    
+    KnotVector   Abscissa, Ordinate;
+    gsl_interp * Object;
+    
+    KnotData( void )
+    : Abscissa(), Ordinate(), Object( nullptr )
+    {}
+    
+    KnotData( KnotVector && TheAbscissa, KnotVector && TheOrdinate )
+    : Abscissa( std::move( TheAbscissa ) ), 
+      Ordinate( std::move( TheOrdinate ) ), Object( nullptr )
+    {}
+    
+    KnotData( const KnotData & Other ) = delete;
+    KnotData & operator= ( const KnotData & Other ) = delete;
+    
+    ~KnotData( void )
+    {
+      if ( Object != nullptr )
+        gsl_interp_free( Object );
+    }
+  };
   
-  // Various functions using the accelerator object may actually write to it, 
-  // and therefore it must be protected in order to allow the same 
-  // interpolation object to be used from concurrent threads. The interpolation 
-  // structure is passed as a constant to every function, so parallelism 
-  // should not be a problem for this object.
+  std::shared_ptr< const KnotData > Knots;
   
-  std::mutex AcceleratorLock;
+  static const std::shared_ptr< const KnotData > & EmptyKnots( void );
 
-  // These objects are initialised when the interpolation coefficients are
-  // computed, after the data vectors have been filled, and the interpolation
-  // type set.
+  // The coefficients are computed for the given data vectors with the 
+  // interpolation type set, and the new knots replace the current knots of 
+  // this interpolation.
   
-  void ComputeCoefficients (void);
+  void ComputeCoefficients( KnotVector && NewAbscissa, 
+                            KnotVector && NewOrdinate );
   
   // It is however possible to shift the interpolated function along either of 
   // the two axes without recomputing it since such a shift corresponds to 
@@ -156,7 +268,12 @@ private:
   // current state, and there is a dedicated function for this.
   
   void CleanUp( void );
-  
+
+  // The batched evaluations throw if the interpolation is empty, or if the
+  // first or last of the sorted arguments are outside of the domain.
+
+  void BatchDomainTest( double First, double Last ) const;
+
   // The Initialiser does the common work of all constructors. In order to 
   // ensure that all the abscissae are unique and correctly sorted a map is 
   // used to hold the data points in the constructor. The start and end 
@@ -184,10 +301,12 @@ private:
     
     // Then the data vectors can be populated with the given data points
     
+    KnotVector NewAbscissa( KnotMemory() ), NewOrdinate( KnotMemory() );
+    
     for ( auto DataPoint = Begin; DataPoint != End; ++DataPoint )
     {
-      Abscissa.push_back( static_cast< double >( DataPoint->first  ) );
-      Ordinate.push_back( static_cast< double >( DataPoint->second ) );
+      NewAbscissa.push_back( static_cast< double >( DataPoint->first  ) );
+      NewOrdinate.push_back( static_cast< double >( DataPoint->second ) );
     }
     
     // The interpolation type is stored for future reference
@@ -196,7 +315,7 @@ private:
 
     // Finally, it is possible to compute the interpolation coefficients
     
-    ComputeCoefficients();
+    ComputeCoefficients( std::move( NewAbscissa ), std::move( NewOrdinate ) );
   }
   
   // Binary operators are obvious when it comes to the value of two 
@@ -207,34 +326,51 @@ private:
   // from this operation will cover the total range of the domains of the two
   // interpolated functions involved, thus if the domain of f is [fa,fb] and 
   // the domain of g is [ga,gb] then the new domain will be [min(fa,ga), 
-  // max(fb,gb)]. The the data points on the joint abscissa will be the union
-  // of the data points on the two abscissae, and new ordinate values computed 
-  // by using the binary operation. As an example: if x is a data point on the 
-  // abscissa of f, but outside of the domain of g, then the new ordinate value
-  // is f(x) regardless of binary operator. If x is in the domain of g then 
-  // the value for the plus operator will be f(x) + g(x), even if g(x) in this
-  // case may be the interpolated value of g at x. With all the ordinate values
-  // computed for the union of the abscissae data points of the two functions, 
-  // a new interpolation is made over these points using the most continuous 
-  // interpolation type of the two involved functions. It should be noted that
-  // this procedure is rather computationally intensive, and one could be 
-  // better off simply combining the values of the involved functions. Beware
-  // that this may not always be desirable, in particular for the Akami 
-  // interpolation since the sum of two interpolated values will in general 
-  // not correspond to the value of the interpolated Akami function constructed
-  // according to the outlined procedure, thus in this case one should rather 
-  // use (f+g)(x).
-  
-  enum class BinaryType
-  {
-    Plus,
-    Minus,
-    Multiply,
-    Divide
-  };
-  
-  Interpolation GenericOperator ( Interpolation & Other, 
-																  BinaryType OperatorType      );
+  // max(fb,gb)]. If x is in the domain of f, but outside of the domain of g, 
+  // then the value of the combination is f(x) regardless of binary operator. 
+  // If x is in the domain of g then the value for the plus operator will be 
+  // f(x) + g(x), even if g(x) in this case may be the interpolated value of g 
+  // at x. 
+  //
+  // Originally each operator computed the ordinate values for the union of 
+  // the abscissae data points of the two functions, and made a new 
+  // interpolation over these points. An expression like P - (L1 + L2 + L3) 
+  // would then create and interpolate three intermediate functions. The 
+  // operators now return an interpolation expression, see below, which is 
+  // a tree of the operands evaluated point by point when it is called. The 
+  // expression is only converted into an interpolation when it is assigned 
+  // to an interpolation object, and then the ordinate values are computed 
+  // once for the union of the data points of all the operands, or for a 
+  // given grid of points, and a single interpolation is made over these 
+  // points using the most continuous interpolation type of the operands. 
+  // Beware that the interpolated value of the resulting function will in 
+  // general not be equal to the value of the expression between the data 
+  // points, in particular for the Akima interpolation, and one should rather 
+  // evaluate the expression directly, i.e. use (f+g)(x), if the combination
+  // is only evaluated for a few arguments.
+  //
+  // The materialisation takes the grid of abscissa values, which must be 
+  // sorted and unique, and stores the values of the expression in the 
+  // ordinate before computing the coefficients. 
+
+  template< class Expression >
+  void MaterialiseExpression( const Expression & Combination,
+                              const std::vector< double > & Grid, 
+                              Type DesiredInterpolationType )
+  {
+    KnotVector Abscissa( Grid.begin(), Grid.end(), KnotMemory() ),
+               Values( KnotMemory() );
+    
+    Values.reserve( Grid.size() );
+    
+    for ( double x : Grid )
+      Values.push_back( Combination( x ) );
+    
+    CleanUp();
+    
+    InterpolationType = DesiredInterpolationType;
+    ComputeCoefficients( std::move( Abscissa ), std::move( Values ) );
+  }
       
 protected:
   
@@ -243,9 +379,10 @@ protected:
   // functions defined below. These are straight forward encapsulations of 
   // similar functions in the GSL.
   
-  double FirstDerivative  (double x);
-  double SecondDerivative (double x);
-  double Integral (double From, double To);
+  double FirstDerivative  (double x, Cursor & Hint = ThreadCursor()) const;
+  double SecondDerivative (double x, Cursor & Hint = ThreadCursor()) const;
+  double Integral (double From, double To, 
+									 Cursor & Hint = ThreadCursor()) const;
 
 public:
   
@@ -255,7 +392,7 @@ public:
   
   inline operator bool() const
   {
-    if ( Abscissa.empty() )
+    if ( Knots->Abscissa.empty() )
       return false;
     else
       return true;
@@ -268,7 +405,51 @@ public:
   // points. Note that calling this on an uninitialised object will throw a 
   // standard out of range error.
   
-  double operator() (double x);
+  double operator() (double x, Cursor & Hint) const;
+  
+  inline double operator() (double x) const
+  { return operator()( x, ThreadCursor() ); }
+
+  // Evaluating the function for many abscissa values one by one will lock
+  // the accelerator and search for the interval of each value. The batched
+  // evaluation takes a range of abscissa values and stores the function
+  // values in the given output range of the same length. If the abscissa
+  // values are sorted, the knots are walked monotonically under a single lock,
+  // and for the linear interpolation the values of all points in the same
+  // knot interval are computed directly by a tight loop the compiler can
+  // vectorise. Unsorted values are evaluated one by one. An out of range
+  // exception is thrown if any of the values is outside of the domain, and
+  // then none of the output values should be used.
+
+  void Evaluate( const double * x, double * y, std::size_t Count, 
+								 Cursor & Hint = ThreadCursor() ) const;
+
+  inline std::vector< double > Evaluate( const std::vector< double > & x, 
+												 Cursor & Hint = ThreadCursor() ) const
+  {
+    std::vector< double > y( x.size() );
+    Evaluate( x.data(), y.data(), x.size(), Hint );
+    return y;
+  }
+
+  // In the same way, the integrals over consecutive intervals given by a
+  // sequence of limits can be computed in one call. The number of integrals
+  // is one less than the number of limits, and the integral over the interval
+  // [Limits[i], Limits[i+1]] is stored as Values[i].
+
+  void Integrals( const double * Limits, double * Values, std::size_t Count,
+								  Cursor & Hint = ThreadCursor() ) const;
+
+  inline std::vector< double > Integrals( const std::vector< double > & Limits,
+													Cursor & Hint = ThreadCursor() ) const
+  {
+    std::vector< double > Values( Limits.size() > 1 ? Limits.size() - 1 : 0 );
+
+    if ( !Values.empty() )
+      Integrals( Limits.data(), Values.data(), Values.size(), Hint );
+
+    return Values;
+  }
 
   // There is a public function to translate the interpolation function by 
   // a constant offset in both directions.
@@ -279,57 +460,57 @@ public:
     Offset.y = yOffset;
   }
   
-  // The binary operators are all defined in terms of the generic operator
-    
-  inline Interpolation operator+ (Interpolation & Other)
-  {
-    return GenericOperator( Other, BinaryType::Plus );
-  }
+  // The interpolation type and the data points are needed when operands are 
+  // combined in an expression. The data points are appended with the offset 
+  // of the abscissa to the given grid.
   
-  inline Interpolation operator- (Interpolation & Other)
-  {
-    return GenericOperator( Other, BinaryType::Minus );
-  }
+  inline Type GetType( void ) const
+  { return InterpolationType; }
   
-  inline Interpolation operator* (Interpolation & Other)
-  {
-    return GenericOperator( Other, BinaryType::Multiply );
-  }
+  void AppendKnots( std::vector< double > & Grid ) const;
   
-  inline Interpolation operator/ (Interpolation & Other)
-  {
-    return GenericOperator( Other, BinaryType::Divide );
-  }
+  // The type of a combination of two interpolations is the most continuous 
+  // of the two types as explained for the binary operators.
+  
+  static Type MostContinuous( Type First, Type Second );
   
   // Assignment operators: Care must be taken when setting two interpolation 
-  // functions equal. If the right hand side is an allocated object, a copy 
-  // will be made, but if the right hand side is a temporary object a move
+  // functions equal. If the right hand side is an allocated object, its knots
+  // will be shared, but if the right hand side is a temporary object a move
   // will be made. The latter leaves the moved object in a void state.
 
-  void operator= ( Interpolation &  Other ); // Make a deep copy of Other
+  void operator= ( const Interpolation & Other ); // Share the knots of Other
   void operator= ( Interpolation && Other ); // Move the Other's data
   
   // Then it is possible to define operators that work relative to this 
-  // interpolation function as a combination of the others.
-  
-  inline void operator+= ( Interpolation & Other )
+  // interpolation function as a combination of the others. The other operand
+  // can be an interpolation or an interpolation expression, and the 
+  // combination is materialised directly into this interpolation. Since the 
+  // expression holds a copy of this interpolation sharing the knots, it is 
+  // safe to replace the knots of this interpolation by the result.
+  
+  template< class Operand >
+  inline void operator+= ( const Operand & Other )
   {
-    this->operator=( GenericOperator( Other, BinaryType::Plus ) );
+    this->operator=( Interpolation( *this + Other ) );
   }
   
-  inline void operator-= ( Interpolation & Other )
+  template< class Operand >
+  inline void operator-= ( const Operand & Other )
   {
-    this->operator=( GenericOperator( Other, BinaryType::Minus ) );
+    this->operator=( Interpolation( *this - Other ) );
   }
   
-  inline void operator*= ( Interpolation & Other )
+  template< class Operand >
+  inline void operator*= ( const Operand & Other )
   {
-    this->operator=( GenericOperator( Other, BinaryType::Multiply ) );
+    this->operator=( Interpolation( *this * Other ) );
   }
   
-  inline void operator/= ( Interpolation & Other )
+  template< class Operand >
+  inline void operator/= ( const Operand & Other )
   {
-    this->operator=( GenericOperator( Other, BinaryType::Divide ) );
+    this->operator=( Interpolation( *this / Other ) );
   }
 
   // There are two small functions to let the user check the domain limits. 
@@ -342,7 +523,7 @@ public:
   
   inline double DomainLower (void) const
   {
-    if ( Abscissa.empty() )
+    if ( Knots->Abscissa.empty() )
 		{
 			std::ostringstream ErrorMessage;
 
@@ -352,12 +533,12 @@ public:
 			throw std::range_error( ErrorMessage.str() );
 		}
     else
-      return Abscissa.front() + Offset.x;
+      return Knots->Abscissa.front() + Offset.x;
   }
   
   inline double DomainUpper (void) const
   {
-    if ( Abscissa.empty() )
+    if ( Knots->Abscissa.empty() )
 		{
 			std::ostringstream ErrorMessage;
 
@@ -367,7 +548,7 @@ public:
 			throw std::range_error( ErrorMessage.str() );
 		}
     else
-      return Abscissa.back() + Offset.x;
+      return Knots->Abscissa.back() + Offset.x;
   }
     
   // Then there is a small helper function to check if a given argument is 
@@ -394,19 +575,21 @@ public:
   
   void RestrictDomain( double NewLowerLimit, double NewUpperLimit );
   
-  // CONSTRUCTORS II: The copy constructor copies the data from the other 
-  // object, but computes the interpolation once again. The move constructor 
-  // moves every thing from the other object and leaves it in a void state. The
-  // latter are actually implemented in terms of the assignment operators.
+  // CONSTRUCTORS II: The copy constructor shares the knots of the other 
+  // object. The move constructor takes the knots from the other object and 
+  // leaves it in a void state. They are actually implemented in terms of the 
+  // assignment operators.
   
-  inline Interpolation ( Interpolation & Other )	// Copy constructor
+  inline Interpolation ( const Interpolation & Other )	// Copy constructor
+  : Knots( EmptyKnots() )
   {
     this->operator=( Other );
   }
   
   inline Interpolation ( Interpolation && Other )     	// Move constructor
+  : Knots( EmptyKnots() )
   {
-    this->operator=( Other );
+    this->operator=( std::move( Other ) );
   }
   
   // CONSTRUCTORS III: In order to make sense the interpolation function 
@@ -420,9 +603,7 @@ public:
   Interpolation ( AbscissaIterator xFirst, AbscissaIterator xLast, 
 		  OrdinateIterator yFirst, OrdinateIterator yLast, 
 		  Type DesiredInterpolationType = Type::SteffenMethod  )
-  : Abscissa(), Ordinate(),
-    InterpolationObject( nullptr ), AcceleratorObject( nullptr ), 
-    AcceleratorLock()
+  : Knots( EmptyKnots() )
   {
     // In order to ensure that all the abscissae values are unique and sorted  
     // we first build a map of these values.
@@ -457,9 +638,7 @@ public:
   template < class DataPointIterator >
   Interpolation ( DataPointIterator First, DataPointIterator Last,
 		  Type DesiredInterpolationType = Type::SteffenMethod )
-  : Abscissa(), Ordinate(),
-    InterpolationObject( nullptr ), AcceleratorObject( nullptr ), 
-    AcceleratorLock()
+  : Knots( EmptyKnots() )
   {
     std::map< 
     typename std::iterator_traits< DataPointIterator >::value_type::first_type,
@@ -479,14 +658,68 @@ public:
   Interpolation ( std::map< Key, Value, Comparator, Allocator >  
 		  & DataPoints, 
 		  Type DesiredInterpolationType = Type::SteffenMethod )
-  : Abscissa(), Ordinate(),
-    InterpolationObject( nullptr ), AcceleratorObject( nullptr ), 
-    AcceleratorLock()
+  : Knots( EmptyKnots() )
   {
     InitialiseData( DataPoints.begin(), DataPoints.end(), 
 								    DesiredInterpolationType );
   }
   
+  // A flat time series has its samples in two contiguous arrays that are 
+  // copied directly to the data points. The copy is normalised, which does 
+  // nothing if the series is already sorted, to ensure unique and sorted 
+  // abscissa values.
+  
+  Interpolation ( const CoSSMic::TimeSeries & Series, 
+								  Type DesiredInterpolationType = Type::SteffenMethod )
+  : Knots( EmptyKnots() )
+  {
+    CoSSMic::TimeSeries Normalised( Series );
+    
+    CleanUp();
+    Normalised.Normalise();
+    
+    InterpolationType = DesiredInterpolationType;
+    ComputeCoefficients( 
+      KnotVector( Normalised.Times().begin(), Normalised.Times().end(), 
+                  KnotMemory() ), 
+      KnotVector( Normalised.Values().begin(), Normalised.Values().end(), 
+                  KnotMemory() ) );
+  }
+  
+  // An interpolation expression is materialised on the union of the data 
+  // points of all the interpolations in the expression, or on a given grid 
+  // of abscissa values that will be sorted and made unique. The 
+  // interpolation type is by default the most continuous type of the 
+  // operands.
+  
+  template< class Left, class Right, class Operator >
+  Interpolation ( 
+    const InterpolationExpression< Left, Right, Operator > & Combination )
+  : Knots( EmptyKnots() )
+  {
+    MaterialiseExpression( Combination, Combination.Grid(), 
+                           Combination.GetType() );
+  }
+  
+  template< class Left, class Right, class Operator >
+  Interpolation ( 
+    const InterpolationExpression< Left, Right, Operator > & Combination,
+    std::vector< double > Grid, Type DesiredInterpolationType )
+  : Knots( EmptyKnots() )
+  {
+    std::sort( Grid.begin(), Grid.end() );
+    Grid.erase( std::unique( Grid.begin(), Grid.end() ), Grid.end() );
+    
+    MaterialiseExpression( Combination, Grid, DesiredInterpolationType );
+  }
+  
+  template< class Left, class Right, class Operator >
+  Interpolation ( 
+    const InterpolationExpression< Left, Right, Operator > & Combination,
+    const std::vector< double > & Grid )
+  : Interpolation( Combination, Grid, Combination.GetType() )
+  {}
+  
   // The file constructor takes a string indicating a file containing 
   // the data in multiple lines where each line contains the abscissa and 
   // the ordinate values. The file is read until end of file.
@@ -503,17 +736,15 @@ public:
   // temporary object created based on properly formatted data.
   
   Interpolation( void )
-  : Abscissa(), Ordinate(),
-    InterpolationObject( nullptr ), AcceleratorObject( nullptr ), 
-    AcceleratorLock()
+  : Knots( EmptyKnots() )
   {
     InterpolationType   = Type::Linear;
     Offset.x            = 0.0;
     Offset.y            = 0.0;
   }
   
-  // DESTRUCTOR: frees the interpolation object and the accelerator object 
-  // that were both dynamically allocated by the initialiser.
+  // DESTRUCTOR: frees the interpolation object that was dynamically 
+  // allocated by the initialiser.
   
   virtual ~Interpolation (void)
   {
@@ -523,29 +754,165 @@ public:
   // Friend functions to make the interface to integration and derivation more
   // appealing from a syntax view
   
-  friend double Derivative ( Interpolation & Function, double x );
-  friend double Derivative2( Interpolation & Function, double x );
-  friend double Integral   ( Interpolation & Function, double LowerLimit, 
+  friend double Derivative ( const Interpolation & Function, double x );
+  friend double Derivative2( const Interpolation & Function, double x );
+  friend double Integral   ( const Interpolation & Function, double LowerLimit, 
 			     double UpperLimit );
 };
 
 // The definitions of the derivation and integration functions are trivial
 
-inline double Derivative ( Interpolation & Function, double x )
+inline double Derivative ( const Interpolation & Function, double x )
 {
   return Function.FirstDerivative(x);
 }
 
-inline double Derivative2( Interpolation & Function, double x )
+inline double Derivative2( const Interpolation & Function, double x )
 {
   return Function.SecondDerivative(x);
 }
 
-inline double Integral( Interpolation & Function, double LowerLimit, 
+inline double Integral( const Interpolation & Function, double LowerLimit, 
 			double UpperLimit )
 {
   return Function.Integral( LowerLimit, UpperLimit );
 }
 
 
+/*==============================================================================
+
+ Interpolation expressions
+
+==============================================================================*/
+//
+// An expression is a node combining two operands, which are either 
+// interpolations or other expressions, with an operator on the values of the 
+// operands. The operands are stored by value: Copying an interpolation only 
+// shares its knots, and an expression is only a few pointers, so the 
+// expression remains valid also when the operands are temporary objects. The
+// expression offers the same evaluation and domain test as the 
+// interpolation so that it can be used as an operand of another expression.
+
+template< class Left, class Right, class Operator >
+class InterpolationExpression
+{
+private:
+  
+  const Left     LeftOperand;
+  const Right    RightOperand;
+  const Operator Combine;
+  
+public:
+  
+  // The domain of the expression is the union of the domains of the operands
+  
+  inline bool DomainQ( double x ) const
+  {
+    return LeftOperand.DomainQ( x ) || RightOperand.DomainQ( x );
+  }
+  
+  // The value is the value of the operand that covers the argument, or the 
+  // combination of the two values if the argument is in both domains. An 
+  // argument outside of both domains will make the operands throw.
+  
+  inline double operator() ( double x ) const
+  {
+    if ( !LeftOperand.DomainQ( x ) )
+      return RightOperand( x );
+    else if ( !RightOperand.DomainQ( x ) )
+      return LeftOperand( x );
+    else
+      return Combine( LeftOperand( x ), RightOperand( x ) );
+  }
+  
+  // The type and the data points are collected from all the operands
+  
+  inline Interpolation::Type GetType( void ) const
+  {
+    return Interpolation::MostContinuous( LeftOperand.GetType(), 
+                                          RightOperand.GetType() );
+  }
+  
+  inline void AppendKnots( std::vector< double > & Grid ) const
+  {
+    LeftOperand.AppendKnots( Grid );
+    RightOperand.AppendKnots( Grid );
+  }
+  
+  // The default grid for materialising the expression is the sorted and 
+  // unique data points of all the operands.
+  
+  std::vector< double > Grid( void ) const
+  {
+    std::vector< double > Points;
+    
+    AppendKnots( Points );
+    
+    std::sort( Points.begin(), Points.end() );
+    Points.erase( std::unique( Points.begin(), Points.end() ), Points.end() );
+    
+    return Points;
+  }
+  
+  InterpolationExpression( const Left & f, const Right & g )
+  : LeftOperand( f ), RightOperand( g ), Combine()
+  {}
+};
+
+// The operators are only defined for interpolations and expressions, and 
+// this is tested by a type trait.
+
+template< class Operand >
+struct IsInterpolationOperand : public std::false_type
+{};
+
+template<>
+struct IsInterpolationOperand< Interpolation > : public std::true_type
+{};
+
+template< class Left, class Right, class Operator >
+struct IsInterpolationOperand< InterpolationExpression< Left, Right, Operator > >
+: public std::true_type
+{};
+
+template< class Left, class Right >
+using InterpolationOperands = typename std::enable_if< 
+  IsInterpolationOperand< Left >::value && 
+  IsInterpolationOperand< Right >::value >::type;
+
+// The binary operators just build the expression nodes
+
+template< class Left, class Right, 
+          typename = InterpolationOperands< Left, Right > >
+inline InterpolationExpression< Left, Right, std::plus< double > > 
+operator+ ( const Left & f, const Right & g )
+{
+  return InterpolationExpression< Left, Right, std::plus< double > >( f, g );
+}
+
+template< class Left, class Right, 
+          typename = InterpolationOperands< Left, Right > >
+inline InterpolationExpression< Left, Right, std::minus< double > > 
+operator- ( const Left & f, const Right & g )
+{
+  return InterpolationExpression< Left, Right, std::minus< double > >( f, g );
+}
+
+template< class Left, class Right, 
+          typename = InterpolationOperands< Left, Right > >
+inline InterpolationExpression< Left, Right, std::multiplies< double > > 
+operator* ( const Left & f, const Right & g )
+{
+  return 
+  InterpolationExpression< Left, Right, std::multiplies< double > >( f, g );
+}
+
+template< class Left, class Right, 
+          typename = InterpolationOperands< Left, Right > >
+inline InterpolationExpression< Left, Right, std::divides< double > > 
+operator/ ( const Left & f, const Right & g )
+{
+  return InterpolationExpression< Left, Right, std::divides< double > >( f, g );
+}
+
 #endif // INTERPOLATION
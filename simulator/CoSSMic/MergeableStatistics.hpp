@@ -0,0 +1,337 @@
+/*=============================================================================
+  Mergeable Statistics
+
+  The running statistics class is a thin wrapper around the accumulator of
+  the Gnu Scientific Library, and the accumulator can only be fed one sample
+  at the time. It cannot be shared between threads without a lock, and the
+  GSL offers no way to combine two accumulators, in particular not the P²
+  quantile estimators [1] since their marker positions cannot be merged.
+
+  This class offers the same interface, but the accumulator can be merged
+  with other accumulators of the same type. Each thread, or each process,
+  can therefore keep its own accumulator without any synchronisation, and
+  the accumulators are merged once the threads have completed.
+
+  The first four central moments are combined using the pairwise update
+  formulas of Chan et al. [2] as generalised to higher order moments by
+  Pébay [3]. Adding a single sample is the same as merging with an
+  accumulator holding only this sample, and the update reduces to Welford's
+  classical algorithm [4]. The estimators are the same as the ones used by
+  the GSL so that the values returned are identical to the ones of the
+  running statistics up to round-off.
+
+  The quantiles are estimated by the KLL sketch of Karnin, Lang and Liberty
+  [5]. The sketch is a hierarchy of compactors where the items at level h
+  each represent 2^h of the original samples. When a compactor is full it is
+  sorted, and every second item, starting at a random offset, is promoted to
+  the next level while the others are discarded. Two sketches are merged by
+  concatenating the compactors level by level and then compacting. With the
+  default capacity of 200 items for the top compactor the rank error is
+  about 1.3% with high probability, which is the same order of accuracy as
+  the P² estimates for the moderate sample sizes of the simulator. Contrary
+  to the P² estimator, any quantile can be obtained from the sketch, so it is
+  not necessary to give the probabilities to the constructor.
+
+  References:
+
+  [1] Raj Jain and Imrich Chlamtac (1985): "The P² algorithm for dynamic
+      calculation of quantiles and histograms without storing observations",
+      Communications of the ACM, Vol. 28, No. 10, pp. 1076-1085
+  [2] Tony F. Chan, Gene H. Golub and Randall J. LeVeque (1979): "Updating
+      formulae and a pairwise algorithm for computing sample variances",
+      Technical Report STAN-CS-79-773, Stanford University
+  [3] Philippe Pébay (2008): "Formulas for robust, one-pass parallel
+      computation of covariances and arbitrary-order statistical moments",
+      Technical Report SAND2008-6212, Sandia National Laboratories
+  [4] B. P. Welford (1962): "Note on a method for calculating corrected sums
+      of squares and products", Technometrics, Vol. 4, No. 3, pp. 419-420
+  [5] Zohar Karnin, Kevin Lang and Edo Liberty (2016): "Optimal quantile
+      approximation in streams", Proceedings of the IEEE 57th Annual
+      Symposium on Foundations of Computer Science (FOCS), pp. 71-78
+
+  Author and Copyright: Geir Horn, University of Oslo, 2019
+  License: LGPL 3.0
+=============================================================================*/
+
+#ifndef COSSMIC_MERGEABLE_STATISTICS
+#define COSSMIC_MERGEABLE_STATISTICS
+
+#include <stddef.h>						// For size_t
+#include <cmath>						  // Standard mathematical functions
+#include <limits>             // For the initial minimum and maximum
+#include <vector>             // The compactors of the quantile sketch
+#include <utility>            // Pairs of values and weights
+#include <algorithm>          // Sorting the compactors
+#include <random>             // For the compaction offset
+#include <sstream>						// For reporting errors
+#include <stdexcept>					// For throwing errors
+
+namespace CoSSMic
+{
+
+class MergeableStatistics
+{
+private:
+
+  // ---------------------------------------------------------------------------
+  // Moments
+  // ---------------------------------------------------------------------------
+  //
+  // The moments are kept as the number of samples, the mean, and the sums of
+  // the second, third and fourth powers of the deviations from the mean.
+
+  double Samples, Average, M2, M3, M4, Smallest, Largest;
+
+  // The merge of the moments of another accumulator follows Pébay's formulas
+  // where the combined terms are computed before any of the stored values
+  // are changed since the higher moments depend on the lower ones.
+
+  void MergeMoments( double nB, double MeanB, double M2B, double M3B,
+                     double M4B )
+  {
+    if ( nB == 0.0 ) return;
+
+    const double nA    = Samples,
+                 n     = nA + nB,
+                 Delta = MeanB - Average,
+                 Delta2 = Delta  * Delta,
+                 Delta3 = Delta2 * Delta,
+                 Delta4 = Delta2 * Delta2;
+
+    M4 += M4B + Delta4 * nA * nB * ( nA*nA - nA*nB + nB*nB ) / (n*n*n)
+              + 6.0 * Delta2 * ( nA*nA*M2B + nB*nB*M2 ) / (n*n)
+              + 4.0 * Delta  * ( nA*M3B - nB*M3 ) / n;
+
+    M3 += M3B + Delta3 * nA * nB * ( nA - nB ) / (n*n)
+              + 3.0 * Delta  * ( nA*M2B - nB*M2 ) / n;
+
+    M2 += M2B + Delta2 * nA * nB / n;
+
+    Average += Delta * nB / n;
+    Samples  = n;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Quantile sketch
+  // ---------------------------------------------------------------------------
+  //
+  // The compactors are kept as vectors with the lowest level first. The
+  // capacity of a level decreases geometrically by a factor 2/3 from the top
+  // level, but no level will have less than two items.
+
+  std::vector< std::vector< double > > Compactors;
+  size_t                               Capacity;
+  std::minstd_rand                     CoinFlip;
+
+  inline size_t LevelCapacity( size_t Level ) const
+  {
+    const size_t Depth = Compactors.size() - Level - 1;
+
+    return std::max< size_t >( 2,
+      static_cast< size_t >( std::ceil( Capacity * std::pow( 2.0/3.0, Depth ))));
+  }
+
+  // The compaction goes through the levels from the bottom and compacts the
+  // first level that exceeds its capacity. A new top level is created if the
+  // current top level is compacted. Since the capacities depend on the number
+  // of levels, the loop continues until all levels are within their bounds.
+
+  void Compress( void )
+  {
+    for ( size_t Level = 0; Level < Compactors.size(); Level++ )
+      if ( Compactors[ Level ].size() >= LevelCapacity( Level ) )
+      {
+        if ( Level + 1 == Compactors.size() )
+          Compactors.emplace_back();
+
+        std::vector< double > & Items = Compactors[ Level ];
+        std::sort( Items.begin(), Items.end() );
+
+        // An odd item is left at the level so that the promoted items are
+        // pairs of neighbours
+
+        const size_t Paired = Items.size() - ( Items.size() % 2 ),
+                     Offset = CoinFlip() % 2;
+
+        for ( size_t i = Offset; i < Paired; i += 2 )
+          Compactors[ Level + 1 ].push_back( Items[i] );
+
+        Items.erase( Items.begin(), Items.begin() + Paired );
+      }
+  }
+
+  // Testing a probability is used by the quantile function and it throws
+  // if the probability is not in the open unit interval.
+
+  static void LegalProbability( double Probability )
+  {
+    if ( !( (0.0 < Probability) && ( Probability < 1.0) ) )
+    {
+      std::ostringstream ErrorMessage;
+
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "Quantile probability must be in (0.0, 1.0)";
+
+      throw std::out_of_range( ErrorMessage.str() );
+    }
+  }
+
+public:
+
+  // ---------------------------------------------------------------------------
+  // Interface functions
+  // ---------------------------------------------------------------------------
+  //
+  // The interface mirrors the one of the running statistics so that the two
+  // can be used interchangeably. The estimators are the same as the GSL's.
+
+  inline size_t N( void ) const
+  { return static_cast< size_t >( Samples ); }
+
+  inline double Min( void ) const
+  { return Samples > 0 ? Smallest : 0.0; }
+
+  inline double Max( void ) const
+  { return Samples > 0 ? Largest : 0.0; }
+
+  inline double Mean( void ) const
+  { return Average; }
+
+  inline double Variance( void ) const
+  { return Samples > 1 ? M2 / ( Samples - 1.0 ) : 0.0; }
+
+  inline double StandardDeviation( void ) const
+  { return std::sqrt( Variance() ); }
+
+  inline double StandardDeviationOfMean( void ) const
+  { return Samples > 0 ? StandardDeviation() / std::sqrt( Samples ) : 0.0; }
+
+  inline double Skewness( void ) const
+  {
+    return ( M2 > 0.0 ) ? std::sqrt( Samples ) * M3 / std::pow( M2, 1.5 ) : 0.0;
+  }
+
+  inline double Kurtosis( void ) const
+  { return ( M2 > 0.0 ) ? Samples * M4 / ( M2 * M2 ) - 3.0 : 0.0; }
+
+  // The quantile is found by sorting all retained items with their weights
+  // and returning the first item whose cumulative weight reaches the
+  // requested fraction of the total weight.
+
+  double Quantile( double Probability ) const
+  {
+    LegalProbability( Probability );
+
+    std::vector< std::pair< double, double > > Items;
+    double Weight = 1.0, TotalWeight = 0.0;
+
+    for ( const std::vector< double > & Level : Compactors )
+    {
+      for ( double Value : Level )
+        Items.emplace_back( Value, Weight );
+
+      TotalWeight += Weight * Level.size();
+      Weight      *= 2.0;
+    }
+
+    if ( Items.empty() ) return 0.0;
+
+    std::sort( Items.begin(), Items.end() );
+
+    const double Rank = Probability * TotalWeight;
+    double Cumulative = 0.0;
+
+    for ( const auto & Item : Items )
+    {
+      Cumulative += Item.second;
+      if ( Cumulative >= Rank ) return Item.first;
+    }
+
+    return Items.back().first;
+  }
+
+  inline double Median( void ) const
+  { return Quantile( 0.5 ); }
+
+  // Clearing the accumulator resets the moments and removes all compactors
+  // except the empty bottom level.
+
+  inline void Clear( void )
+  {
+    Samples = Average = M2 = M3 = M4 = 0.0;
+    Smallest =  std::numeric_limits< double >::max();
+    Largest  = -std::numeric_limits< double >::max();
+
+    Compactors.assign( 1, std::vector< double >() );
+  }
+
+  // Adding data is done via the stream input operator as for the running
+  // statistics, and a single sample is merged as an accumulator of one
+  // sample with no spread.
+
+  template< typename DataType >
+  void operator << ( const DataType & Value )
+  {
+    const double Sample = static_cast< double >( Value );
+
+    MergeMoments( 1.0, Sample, 0.0, 0.0, 0.0 );
+
+    Smallest = std::min( Smallest, Sample );
+    Largest  = std::max( Largest,  Sample );
+
+    Compactors.front().push_back( Sample );
+    Compress();
+  }
+
+  // Merging another accumulator combines the moments, and adds the items of
+  // the other compactors to the compactors at the same level before the
+  // combined sketch is compressed. The other accumulator is left unchanged.
+
+  void Merge( const MergeableStatistics & Other )
+  {
+    if ( Other.Samples == 0.0 ) return;
+
+    MergeMoments( Other.Samples, Other.Average, Other.M2, Other.M3, Other.M4 );
+
+    Smallest = std::min( Smallest, Other.Smallest );
+    Largest  = std::max( Largest,  Other.Largest  );
+
+    if ( Compactors.size() < Other.Compactors.size() )
+      Compactors.resize( Other.Compactors.size() );
+
+    for ( size_t Level = 0; Level < Other.Compactors.size(); Level++ )
+      Compactors[ Level ].insert( Compactors[ Level ].end(),
+                                  Other.Compactors[ Level ].begin(),
+                                  Other.Compactors[ Level ].end() );
+
+    Compress();
+  }
+
+  inline MergeableStatistics & operator += ( const MergeableStatistics & Other )
+  {
+    Merge( Other );
+    return *this;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Constructor
+  // ---------------------------------------------------------------------------
+  //
+  // The constructor takes the capacity of the top compactor, which determines
+  // the accuracy of the quantile estimates, and the seed of the coin flips
+  // deciding which items are promoted. The default seed makes the sketch
+  // deterministic for a given sequence of samples and merges.
+
+  MergeableStatistics( size_t SketchCapacity = 200,
+                       std::minstd_rand::result_type Seed = 1 )
+  : Compactors(), Capacity( std::max< size_t >( 2, SketchCapacity ) ),
+    CoinFlip( Seed )
+  {
+    Clear();
+  }
+
+  MergeableStatistics( const MergeableStatistics & Other ) = default;
+};
+
+}      // Name space CoSSMic
+#endif // COSSMIC_MERGEABLE_STATISTICS
@@ -18,19 +18,32 @@
 #include <list>				                  // For lists of objects
 #include <atomic>			                  // For thread safe counters
 #include <chrono>			                  // For system system
+#include <algorithm>		                // For sorting load activities
+#include <optional>		                // For the earliest end time
+#include <cstdint>			                // For serialised sizes
 
-#include <gsl/gsl_roots.h> 		          // For the equality of two functions.
 #include <gsl/gsl_errno.h> 		          // For error messages from GSL
-#include <nlopt.hpp>    		            // Solving the optimisation problem
+#include <nlopt.h>    		              // Solver status codes
 #include <boost/numeric/interval.hpp>   // For intervals
 
 #include "Actor.hpp"		          			// The Theron++ actor framework
+#include "MemoryAccounting.hpp"         // The memory of the scheduling arena
+#include "ProfilerAnnotations.hpp"      // Optional profiler zones
 #include "RandomGenerator.hpp"          // The random number generator
 #include "PresentationLayer.hpp"	      // The message presentation layer
+#include "BinaryPayload.hpp"	          // Binary message codecs
+
+#include "NonLinear/Optimizer.hpp"             // The solver interface
+#include "NonLinear/LocalApproximation.hpp"    // BOBYQA and COBYLA
+#include "NonLinear/Simplex.hpp"               // Subplex
+#include "NonLinear/DIRECT.hpp"                // DIRECT-L
+#include "NonLinear/ControlledRandomSearch.hpp"// CRS
+#include "NonLinear/Portfolio.hpp"             // Racing algorithms
 
 #include "TimeInterval.hpp"		          // For time related functions
 #include "ConsumerProxy.hpp"		        // For the consumer interaction
 #include "PVProducer.hpp"		            // The actual producer class
+#include "RewardCalculator.hpp"         // Reporting the production
 #include "Clock.hpp"			              // To get Now from system or simulator
 
 #ifdef CoSSMic_DEBUG
@@ -39,6 +52,8 @@
 
 namespace CoSSMic 
 {
+
+namespace NL = Optimization::NonLinear;
 /*****************************************************************************
   New prediction command
 ******************************************************************************/
@@ -73,6 +88,196 @@ bool PVProducer::NewPrediction::Deserialize(
     return false;
 }
 
+// The binary codec carries the file name only
+
+Theron::SerialMessage::Payload 
+PVProducer::NewPrediction::BinarySerialize( void ) const
+{
+  Theron::BinaryWriter Message( "PREDICTION_UPDATE" );
+  
+  Message << NewPredictionFile;
+  
+  return Message.str();
+}
+
+bool PVProducer::NewPrediction::BinaryDeserialize( 
+     const Theron::SerialMessage::Payload & Payload )
+{
+  Theron::BinaryReader Message( Payload, "PREDICTION_UPDATE" );
+  
+  Message >> NewPredictionFile;
+  
+  return static_cast< bool >( Message );
+}
+
+/*****************************************************************************
+  Prediction delta
+******************************************************************************/
+//
+// The delta is serialised with the file name, or a single dash if there is no
+// file, followed by the number of samples and the time and energy of each 
+// sample. File names can therefore not contain white space, as for the new 
+// prediction message.
+
+Theron::SerialMessage::Payload 
+PVProducer::PredictionDelta::Serialize( void ) const
+{
+  std::ostringstream Message;
+  
+  Message << "PREDICTION_DELTA " 
+					<< ( RevisionFile.empty() ? std::string("-") : RevisionFile ) 
+					<< " " << Samples.size();
+  
+  for ( auto & Sample : Samples )
+    Message << " " << Sample.first << " " << Sample.second;
+  
+  return Message.str();
+}
+
+bool PVProducer::PredictionDelta::Deserialize( 
+     const Theron::SerialMessage::Payload & Payload )
+{
+  std::istringstream Message( Payload );
+  std::string Command;
+  std::size_t NumberOfSamples = 0;
+  
+  Message >> Command;
+  
+  if ( Command != "PREDICTION_DELTA" ) return false;
+  
+  Message >> RevisionFile >> NumberOfSamples;
+  
+  if ( RevisionFile == "-" ) RevisionFile.clear();
+  
+  Samples.clear();
+  
+  for ( std::size_t i = 0; ( i < NumberOfSamples ) && Message; i++ )
+  {
+    Time   SampleTime;
+    double Energy;
+    
+    Message >> SampleTime >> Energy;
+    Samples.emplace( SampleTime, Energy );
+  }
+  
+  return static_cast< bool >( Message );
+}
+
+// The binary codec has the same fields as the text codec
+
+Theron::SerialMessage::Payload 
+PVProducer::PredictionDelta::BinarySerialize( void ) const
+{
+  Theron::BinaryWriter Message( "PREDICTION_DELTA" );
+  
+  Message << RevisionFile << static_cast< std::uint64_t >( Samples.size() );
+  
+  for ( auto & Sample : Samples )
+    Message << Sample.first << Sample.second;
+  
+  return Message.str();
+}
+
+bool PVProducer::PredictionDelta::BinaryDeserialize( 
+     const Theron::SerialMessage::Payload & Payload )
+{
+  Theron::BinaryReader Message( Payload, "PREDICTION_DELTA" );
+  std::uint64_t        NumberOfSamples = 0;
+  
+  Message >> RevisionFile >> NumberOfSamples;
+  
+  Samples.clear();
+  
+  for ( std::uint64_t i = 0; ( i < NumberOfSamples ) && Message; i++ )
+  {
+    Time   SampleTime;
+    double Energy;
+    
+    Message >> SampleTime >> Energy;
+    Samples.emplace( SampleTime, Energy );
+  }
+  
+  return static_cast< bool >( Message );
+}
+
+// -----------------------------------------------------------------------------
+// Revised prediction
+// -----------------------------------------------------------------------------
+//
+// The prediction domain is always updated to the revised domain. The windows
+// of the loads are then compared over the revised interval, and the loads are
+// rescheduled by sending a zero energy load to this producer if the change 
+// over one of the windows is larger than the tolerance.
+
+void PVProducer::PredictionChanged( const PredictionRevised & TheRevision, 
+																	  const Theron::Address ThePredictor )
+{
+  PredictionDomain = TheRevision.Domain;
+  
+  std::shared_ptr< const PredictionSnapshot > 
+  RevisedSnapshot( Prediction->GetSnapshot() );
+  
+  bool Reschedule = !ProductionSnapshot;
+  
+  for ( auto Consumer = FirstConsumer(); 
+			  ( Consumer != EndConsumer() ) && !Reschedule; ++Consumer )
+  {
+    auto         TheConsumer( *Consumer );
+    TimeInterval Window( TheConsumer->AllowedInterval() );
+    
+    if ( TheConsumer->GetStartTime() )
+      Window.set( std::min( Window.lower(), TheConsumer->GetStartTime().value() ),
+								  TheConsumer->GetStartTime().value() 
+									+ TheConsumer->GetDuration() );
+    else
+      Window.set( Window.lower(), Window.upper() + TheConsumer->GetDuration() );
+    
+    if ( boost::numeric::overlap( Window, TheRevision.Revision ) && 
+				 ( RevisedSnapshot->Deviation( *ProductionSnapshot, Window ) 
+					 > RevisionTolerance ) )
+      Reschedule = true;
+  }
+  
+  #ifdef CoSSMic_DEBUG
+    Theron::ConsolePrint DebugMessage;
+    
+    DebugMessage << GetAddress().AsString() << " prediction revised over " 
+								 << TheRevision.Revision << ( Reschedule ? " rescheduling" : "" )
+								 << std::endl;
+  #endif
+  
+  if ( Reschedule && ( FirstConsumer() != EndConsumer() ) )
+    Send( Producer::ScheduleCommand( TheRevision.Domain.lower(), 
+																     TheRevision.Domain.upper(), 0, 0.0 ), 
+					GetAddress() );
+  
+  // The production since the last report is taken from the revised snapshot,
+  // which is the best estimate of what has been produced.
+  
+  Time CurrentTime = Now();
+  
+  if ( BalanceAccount != Theron::Address::Null() && 
+			 ( CurrentTime > ReportedUntil ) )
+  {
+    TimeInterval Produced( ReportedUntil, CurrentTime );
+    double       Energy = RevisedSnapshot->Production( Produced );
+    
+    if ( Energy > 0.0 )
+      Send( RewardCalculator::EnergyDelta( Produced, 0.0, Energy ), 
+						BalanceAccount );
+    
+    ReportedUntil = CurrentTime;
+  }
+}
+
+// The production is reported from the time the calculator is given.
+
+void PVProducer::ReportProductionTo( const Theron::Address & TheCalculator )
+{
+  BalanceAccount = TheCalculator;
+  ReportedUntil  = Now();
+}
+
 /*****************************************************************************
   Kill proxy
 ******************************************************************************/
@@ -183,95 +388,41 @@ void PVProducer::KillProxy( const Producer::KillProxyCommand & TheCommand,
 // time, and if this is before its earliest start time, it is started at its 
 // earliest start time. 
 //
-// The following receiver sends the total consumption to the predictor, which 
-// computes the equality point and returns the time of this point. Then the 
-// start time of the consumer is computed and returned to the consumer proxy 
-// agent.
+// The time when the cumulative production covers the energy of the load is 
+// found directly from the inverse of the cumulative prediction tabulated in 
+// the prediction snapshot, and there is no need to ask the predictor for it. 
+// The start time of the consumer is computed from this earliest end time by 
+// the following function. No start time is returned if there is no end time
+// or if the start time is outside of the allowed start interval.
 
-class SingleConsumerHeuristic : public Theron::Receiver
+Producer::AssignedStartTime SingleConsumerStartTime( 
+	const TimeInterval & AllowedInterval, const Time JobDuration, 
+	const std::optional< Time > & EarliestEnd )
 {
-private: 
-  
-  TimeInterval	 AllowedInterval;	  			// Consumer constraints
-  Time		       JobDuration;							// The time the job needs 
-  bool		       Done; 	  								// Flag for completion
-  
-  Producer::AssignedStartTime StartTime;	// The start time if any
-  
-public:
-  
-  // The result of this earliest possible finish time is returned as an 
-  // assigned start time message. Based on this, the load's feasible start 
-  // time is computed if a solution could be found, otherwise and empty start
-  // time is returned to the consumer.
-  
-  void ComputeStartTime( const Producer::AssignedStartTime & EarliestEnd, 
-												 const Theron::Address ThePredictor )
-  {
-    if ( EarliestEnd )
-    {
-      // If the end time found is before the time the job would end if it 
-      // is started at the earliest possible start time, there is enough 
-      // production predicted for the load to start at its earliest possibility.
-      
-      if ( EarliestEnd.value() <= AllowedInterval.lower() + JobDuration )
-	      StartTime = Producer::AssignedStartTime( AllowedInterval.lower() );
-      else
-      {
-				// Since the load cannot be started at its earliest start, but has to
-				// be delayed and start so that the job finishes at the earliest end 
-				// time (since this is the earliest start possible). However, this 
-				// requires that the needed start time is in the allowed start time 
-				// interval for the load. If this is not the case, it is not possible 
-				// to schedule this load on this producer and the start time is 
-				// returned unassigned.
-				
-				if ( boost::numeric::in( EarliestEnd.value() - JobDuration, 
-																 AllowedInterval ) )
-				  StartTime = Producer::AssignedStartTime( 
-														     EarliestEnd.value() - JobDuration );
-      }
-    }
-    
-    Done = true;
-  }
-  
-  // There is a small function to wait for the solution to be found and returned
-  // and after this function the object can safely be destroyed.
-  
-  Producer::AssignedStartTime ComputeSolution( void )
-  {
-    while ( !Done ) Wait();
-    
-    return StartTime;
-  }
-  
-  // The constructor sends a start time proposal to the concerned load with 
-  // the consumption interval equal to the load's own duration counted from 
-  // the earliest start of the load.
-  
-  SingleConsumerHeuristic( Theron::Framework & TheFramework,
-			   const TimeInterval & 		StartTimeInterval,
-			   const Time 				  		Duration,
-			   double 									JobEnergy,
-			   const Theron::Address & 	ThePredictor  )
-  : Theron::Receiver(), AllowedInterval( StartTimeInterval ), 
-    JobDuration( Duration ), StartTime()
+  if ( EarliestEnd )
   {
-    Done    = false;
+    // If the end time found is before the time the job would end if it 
+    // is started at the earliest possible start time, there is enough 
+    // production predicted for the load to start at its earliest possibility.
     
-    // Register the handlers for messages
+    if ( EarliestEnd.value() <= AllowedInterval.lower() + JobDuration )
+      return Producer::AssignedStartTime( AllowedInterval.lower() );
     
-    RegisterHandler( this, &SingleConsumerHeuristic::ComputeStartTime );
+    // Since the load cannot be started at its earliest start, but has to
+    // be delayed and start so that the job finishes at the earliest end 
+    // time (since this is the earliest start possible). However, this 
+    // requires that the needed start time is in the allowed start time 
+    // interval for the load. If this is not the case, it is not possible 
+    // to schedule this load on this producer and the start time is 
+    // returned unassigned.
     
-    // Then the total energy of the job is sent to the Predictor in order 
-    // to have it compute the first time when the predicted production equals
-    // this request, i.e. the earliest time the load can finish.
-    
-    Send( JobEnergy, ThePredictor );
+    if ( boost::numeric::in( EarliestEnd.value() - JobDuration, 
+														 AllowedInterval ) )
+      return Producer::AssignedStartTime( EarliestEnd.value() - JobDuration );
   }
   
-};
+  return Producer::AssignedStartTime();
+}
 
 // -----------------------------------------------------------------------------
 // Partitioning the load set
@@ -285,11 +436,40 @@ public:
 
 void PVProducer::PartitionLoads(void)
 {
-  // The partitioning of the previous scheduling operation is cleared first.
+  // The loads to classify are collected first. If the prediction domain is 
+  // unchanged, these are the loads that have not started and the new loads.
+  // Otherwise the partitioning of the previous scheduling operation is 
+  // cleared and all loads are classified.
   
-  ActiveLoads.clear();
-  StartedLoads.clear();
-  FutureLoads.clear();
+  std::vector< Producer::ConsumerReference > Candidates;
+  
+  if ( PartitionedDomain && 
+       ( PartitionedDomain->lower() == PredictionDomain.lower() ) &&
+       ( PartitionedDomain->upper() == PredictionDomain.upper() ) )
+  {
+    std::size_t PartitionedLoads 
+      = StartedLoads.size() + ActiveLoads.size() + FutureLoads.size();
+    
+    Candidates.swap( ActiveLoads );
+    Candidates.insert( Candidates.end(), FutureLoads.begin(), FutureLoads.end() );
+    FutureLoads.clear();
+    
+    for ( auto Consumer = std::prev( EndConsumer(), 
+																     NumberOfConsumers() - PartitionedLoads );
+					     Consumer != EndConsumer(); ++Consumer )
+      Candidates.push_back( Consumer );
+  }
+  else
+  {
+    ActiveLoads.clear();
+    StartedLoads.clear();
+    FutureLoads.clear();
+    
+    for ( auto Consumer = FirstConsumer(); Consumer != EndConsumer(); ++Consumer )
+      Candidates.push_back( Consumer );
+    
+    PartitionedDomain = PredictionDomain;
+  }
   
   // Any start time before a time horizon is considered to be already started
   // and inserted into the set of started loads. First this horizon is computed
@@ -309,7 +489,7 @@ void PVProducer::PartitionLoads(void)
   // interval; or future loads for which the allowed start time window entirely 
   // is to the right (in the future) of the prediction.
   
-  for ( auto Consumer = FirstConsumer(); Consumer != EndConsumer(); ++Consumer )
+  for ( auto Consumer : Candidates )
 	{
 	  auto TheConsumer( *Consumer );
 	  
@@ -357,6 +537,22 @@ void PVProducer::PartitionLoads(void)
   #endif
 }
 
+// A consumer to be deleted is removed from the partition it belongs to
+
+void PVProducer::ForgetConsumer( const Producer::ConsumerReference & TheConsumer )
+{
+  for ( auto Partition : { &StartedLoads, &ActiveLoads, &FutureLoads } )
+  {
+    auto Position = std::find( Partition->begin(), Partition->end(), TheConsumer );
+    
+    if ( Position != Partition->end() )
+    {
+      Partition->erase( Position );
+      return;
+    }
+  }
+}
+
 // -----------------------------------------------------------------------------
 // Consumption intervals
 // -----------------------------------------------------------------------------
@@ -366,11 +562,10 @@ void PVProducer::PartitionLoads(void)
 // that period, and the integral of the predicted energy in the period. 
 //
 // The concept of consumption interval is developed first as a separate 
-// class that takes a proposed start time and a managed consumer proxy object. 
-// It will accept a suggested interval if the provided consumption interval 
-// overlaps with the current interval, or if the current interval is empty.
-// If it accepts the consumption interval, it will also keep a pointer to 
-// the consumer proxies that are allocated to this interval. 
+// class that takes a proposed start time and the duration and energy of a 
+// load. It will accept a suggested interval if the provided consumption 
+// interval overlaps with the current interval, and it will then extend the 
+// current interval and add the load's part of the objective value.
 //
 // There are two salient features to note:
 //
@@ -384,331 +579,469 @@ void PVProducer::PartitionLoads(void)
 //    same consumption interval. Hence these two terms can be computed in 
 //    parallel. 
 // 
-// The architecture is therefore as follows: 
-//
-// A. Each consumer proxy is responsible for the calculations related to that 
-//    consumer, and for that reason the consumer proxies are actors.
-// C. There is a dedicated actor responsible for computing the predicted 
-//    energy production. 
+// Originally the consumer proxies and the predictor computed their parts of 
+// the value as actors, and the producer collected their responses for each 
+// evaluation of the objective function. However, the solver calls the 
+// objective function many times for one schedule, and the message round trips 
+// dominated the time to compute a schedule. The data needed is small: the 
+// energy, the duration and possibly the start time of each load, and the 
+// prediction and its integral. These are therefore copied when the scheduling
+// starts, and the objective function is evaluated directly on the copies.
 //
-// Once the interval has been established, it will be communicated to the 
-// consumer proxies and the predictor, and their responses collected in a 
-// dedicated receiver to be defined below.
+// The consumer's contribution to a consumption interval I = [L,U] is given 
+// as E * ( U - (s + d) ) for a load with total energy E, start time s and 
+// duration d. Since the upper bound of the interval is only known when all 
+// loads have been allocated, the consumption interval keeps the sum of the 
+// energies and the sum of the energies weighted by the completion times of the 
+// loads, and the total consumer contribution is then U * Sum E - Sum E(s+d).
+// The start times are given to the consumers as time, and they are converted 
+// to time here as well in order to give the same values as the consumers 
+// would compute.
 
 class ConsumptionInterval 
 {
 private:
   
-  // For the consumer to be able to compute its contribution to the total energy
-  // it needs the start time proposal and the length of the interval. Hence 
-  // we have to remember both which consumers that are allocated to this 
-  // consumption interval, and the start times proposed for them.
-  
-  class AllocatedConsumer
-  {
-  public: 
-    
-    Producer::ConsumerReference TheConsumer;
-    double 											ProposedStartTime;
-    
-    AllocatedConsumer( const Producer::ConsumerReference & ConsumerToStore,
-							         double ItsStartTime )
-    : TheConsumer( ConsumerToStore )
-    {
-      ProposedStartTime = ItsStartTime;
-    }
-  };
-  
-  // Then we maintain a list of consumers allocated to this consumption 
-  // interval, and note that there will always be at least one consumer in the 
-  // interval where the singularity occurs when the consumption interval is 
-  // identical to the consumer's consumption interval.
-  
-  std::list< AllocatedConsumer > AssociatedConsumers;
-	
-  // The length of the consumption interval for all the associated consumers 
-  // is stored as a simple time interval.
-  
   TimeInterval TheInterval;
+  double       TotalEnergy, WeightedCompletion;
   
-  // The constructor takes a reference to the managed proxy structure and the 
-  // proposed start time for this interval, and constructs the initial 
-  // interval. 
+  // The constructor takes the record of the first load allocated to this 
+  // interval and the proposed start time for this load, and constructs the 
+  // initial interval. 
 
 public:
   
-  ConsumptionInterval( const Producer::ConsumerReference & TheConsumer,
-								       double SuggestedStartTime )
-  : AssociatedConsumers(), 
-    TheInterval( SuggestedStartTime, 
-								 SuggestedStartTime + (*TheConsumer)->GetDuration() )
-  {
-    AssociatedConsumers.emplace_back( TheConsumer, SuggestedStartTime );
-  }
+  ConsumptionInterval( const Time Duration, const double Energy, 
+											 const Time SuggestedStartTime )
+  : TheInterval( SuggestedStartTime, SuggestedStartTime + Duration ),
+    TotalEnergy( Energy ), 
+    WeightedCompletion( Energy * ( SuggestedStartTime + Duration ) )
+  { }
   
-  // The union function accepts the provided consumer if its consumption  
+  // The union function accepts the provided load if its consumption  
   // interval overlaps the current interval, otherwise it is refused and false 
   // is returned.
   
-  bool Union( const Producer::ConsumerReference & TheConsumer, 
-				      double SuggestedStartTime )
+  bool Union( const Time Duration, const double Energy, 
+				      const Time SuggestedStartTime )
   {
-    TimeInterval ConsumerActivity( SuggestedStartTime, SuggestedStartTime 
-																	   + (*TheConsumer)->GetDuration() );
+    TimeInterval ConsumerActivity( SuggestedStartTime, 
+																   SuggestedStartTime + Duration );
     
     if ( boost::numeric::overlap( TheInterval, ConsumerActivity ) )
     {
       TheInterval = boost::numeric::hull( TheInterval, ConsumerActivity );
-      AssociatedConsumers.emplace_back( TheConsumer, SuggestedStartTime );
+      TotalEnergy        += Energy;
+      WeightedCompletion += Energy * ( SuggestedStartTime + Duration );
       return true;
     }
     else
       return false;
   }
   
-  // Once the interval has been completely established, i.e. no more consumers
-  // will be added, we can start to compute the contribution of this consumption
-  // interval to the overall objective function value. This is done by the 
-  // receiver to follow next, and it is more efficient if it is allowed to 
-  // read the consumption interval's data directly.
+  // Once the interval has been completely established, i.e. no more loads 
+  // will be added, the contribution of this consumption interval to the 
+  // overall objective function value is the contribution of the consumers and
+  // the contribution of the prediction over the interval.
   
-  friend class CollectContribution;
+  double Value( const PredictionSnapshot & Production ) const
+  {
+    return TotalEnergy * TheInterval.upper() - WeightedCompletion
+				   + Production.Deficit( TheInterval );
+  }
+};
+
+// -----------------------------------------------------------------------------
+// Load records
+// -----------------------------------------------------------------------------
+//
+// The load record simply copies the information needed from the consumer 
+// proxy, and the load parameters are copied in one operation so that the 
+// start time is consistent with the other parameters even if the proxy sets 
+// it concurrently. The start time is only defined for loads that have a start
+// time, and it is otherwise set to zero as it will not be used.
 
-	// The destructor currently does nothing
+PVProducer::LoadRecord::LoadRecord( 
+						const Producer::ConsumerReference & TheConsumer )
+{ 
+  ConsumerProxy::LoadParameters TheLoad( (*TheConsumer)->GetLoad() );
   
-  ~ConsumptionInterval( void )
-  { }
-};
+  Energy    = TheLoad.Energy;
+  Duration  = TheLoad.Duration;
+  StartTime = TheLoad.StartTime.value_or( 0 );
+}
+
+// -----------------------------------------------------------------------------
+// Objective function
+// -----------------------------------------------------------------------------
+//
+// The consumption intervals are the connected components of the activity 
+// periods of the loads. If the activities are sorted by start time, a load
+// overlaps the current consumption interval if it starts before the current
+// interval ends, and otherwise it starts a new consumption interval that is
+// disjoint from all the previous ones. The intervals can therefore be found 
+// in one sweep over the sorted activities, and since a completed interval
+// will not be extended by later loads, its value can be added to the 
+// objective value as soon as the next interval starts. The activities are 
+// stored in a vector owned by the producer whose capacity is reserved when 
+// the scheduling starts, so the evaluations will not allocate memory.
+
+double PVProducer::ObjectiveFunction(
+		   const std::vector< double > & ProposedStartTimes )
+{
+  return ScheduleValue( ProposedStartTimes, Activities, *ProductionSnapshot );
+}
 
-// The contribution to the objective function is collected from each of the 
-// consumption intervals by a receiver so that the owning thread can wait for 
-// all the contributions to arrive. 
+// The value of a schedule is computed with the given activity vector and 
+// prediction snapshot so that concurrent solvers will not share any data 
+// that is changed by the evaluation.
 
-class CollectContribution : public Theron::Actor
+double PVProducer::ScheduleValue( 
+			 const std::vector< double > & ProposedStartTimes,
+			 ActivityVector & LoadActivities, 
+			 const PredictionSnapshot & Production ) const
 {
-private:
-	
-	// It keeps a copy of the address for the predictor
-	
-	Theron::Address ThePredictor;
+  Evaluations.fetch_add( 1, std::memory_order_relaxed );
+  LoadActivities.clear();
+  
+  // The started loads have their start times set since they are all started, 
+  // and the active loads use the proposed start times. Note that the number of 
+  // proposed start times must equal the number of active loads, and therefore 
+  // there is no need to test the iterator for validity to ensure that it does 
+  // not move past the last element of the start time vector.
+ 
+  for ( const LoadRecord & Load : StartedRecords )
+    LoadActivities.push_back( 
+			LoadActivity{ Load.StartTime, Load.Duration, Load.Energy } );
+  
+  auto SuggestedStartTime = ProposedStartTimes.begin();
+  
+  for ( const LoadRecord & Load : ActiveRecords )
+  {
+    LoadActivities.push_back( LoadActivity{ 
+			static_cast< Time >( *SuggestedStartTime ), Load.Duration, Load.Energy });
+    ++SuggestedStartTime;
+  }
+  
+  std::sort( LoadActivities.begin(), LoadActivities.end(), 
+						 []( const LoadActivity & First, const LoadActivity & Second )
+						 { return First.Start < Second.Start; } );
+  
+  // Then the sweep creates a consumption interval for the first activity not 
+  // yet allocated, and extends it with the following activities as long as 
+  // they overlap. The value of each consumption interval is then added to 
+  // the total objective value.
+  
+  double TotalValue = 0.0;
+  auto   Activity   = LoadActivities.begin();
+  
+  while ( Activity != LoadActivities.end() )
+  {
+    ConsumptionInterval 
+			Consumption( Activity->Duration, Activity->Energy, Activity->Start );
+    
+    while ( ( ++Activity != LoadActivities.end() ) && 
+				    Consumption.Union( Activity->Duration, Activity->Energy, 
+																 Activity->Start ) );
+    
+    TotalValue += Consumption.Value( Production );
+  }
+  
+  return TotalValue;
+}
+
+// -----------------------------------------------------------------------------
+// Solving the scheduling problem
+// -----------------------------------------------------------------------------
+//
+// The schedule is found by one of the non-linear optimizers of the 
+// Optimization library. An optimizer is a class specialised for a given 
+// algorithm, and it requires the objective function and the bounds of the 
+// variables to be defined by a derived class. The schedule solver defines 
+// these by forwarding the objective function to the producer and by returning
+// the bounds of the start times given for the current search. Some 
+// optimizers need arguments for their constructors, like the tolerance on the
+// constraints, and these are forwarded to the optimizer.
+//
+// The solvers are kept by the producer independent of the algorithm, and 
+// they are therefore used through an interface class.
+
+class PVProducer::ScheduleSolverInterface
+{
+public:
 	
-	double 			 TotalValue;
-	volatile unsigned int OutstandingRequests;
+	virtual nlopt_result Solve( std::vector< double > & StartTimeValues, 
+														  const ScratchVector & LowerBounds, 
+														  const ScratchVector & UpperBounds, 
+														  double Tolerance, int EvaluationLimit, 
+														  double & ObjectiveValue ) = 0;
 	
-	// The reception of the values is made to a handler that notifies a 
-	// conditional wait when there are no more outstanding requests.
+	virtual ~ScheduleSolverInterface( void )
+	{ }
+};
+
+template< NL::Algorithm::ID SolverAlgorithm >
+class PVProducer::ScheduleSolver : public ScheduleSolverInterface,
+																	 public NL::Optimizer< SolverAlgorithm >
+{
+private:
 	
-	std::timed_mutex WaitGuard;
-	std::condition_variable_any ResponseReceived;
+	PVProducer & TheProducer;
+	std::vector< NL::Bound::Interval > StartTimeBounds;
+
+protected:
 	
-	// The handler for contributions simply accumulates them. One could think 
-	// that it would be desirable to reduce the number of outstanding requests 
-	// in this handler, but in the receiver methodology it simply means that 
-	// the incoming messages are recorded after being served, and the count of 
-	// outstanding requests will be balanced against this count. This is important
-	// since the handler will be called from the Receiver's Postman thread while
-	// the outstanding request is in the main thread executing this Receiver.
+	virtual Optimization::VariableType 
+	ObjectiveFunction( const Optimization::Variables & StartTimes ) override
+	{
+		return TheProducer.ObjectiveFunction( StartTimes );
+	}
 	
-	void ReceiveContribution( const double & OneContribution, 
-														const Theron::Address TheSender )
+	virtual std::vector< NL::Bound::Interval > BoundConstraints( void ) override
 	{
-		std::unique_lock< std::timed_mutex > Lock( WaitGuard, 
-																							 std::chrono::seconds(10) );
-		
-		TotalValue += OneContribution;
-		OutstandingRequests--;
-		ResponseReceived.notify_one();
+		return StartTimeBounds;
 	}
-
+	
 public:
 	
-	// The constructor takes an address for the predictor and stores this for 
-	// future initialisations. 
+	// The solve function sets the bounds of the start times, prepares the 
+	// solver for the problem reusing the solver of the previous search if 
+	// possible, sets the stopping criteria and then finds the solution 
+	// starting from the given start times. The solution found is stored in the
+	// start time values and the objective value.
 	
-	CollectContribution( const Theron::Address PredictorAddress )
-	: Actor(), ThePredictor( PredictorAddress ),
-	  TotalValue(0.0), OutstandingRequests(0), 
-	  WaitGuard(), ResponseReceived()
+	virtual nlopt_result Solve( std::vector< double > & StartTimeValues, 
+														  const ScratchVector & LowerBounds, 
+														  const ScratchVector & UpperBounds, 
+														  double Tolerance, int EvaluationLimit, 
+														  double & ObjectiveValue ) override
 	{
-		// Register the handler to receive the responses.
+		StartTimeBounds.clear();
 		
-		RegisterHandler( this, &CollectContribution::ReceiveContribution );
-	}
-	
-	void Initialise( 
-								const std::list< ConsumptionInterval > & ConsumptionIntervals )
-	{
-
-		std::unique_lock< std::timed_mutex > Lock( WaitGuard, 
-																							 std::chrono::seconds(10) );
+		for ( std::size_t i = 0; i < LowerBounds.size(); i++ )
+			StartTimeBounds.emplace_back( LowerBounds[i], UpperBounds[i] );
 		
-		TotalValue = 0.0;
-		OutstandingRequests = 0;
+		this->PrepareSolver( StartTimeValues.size(), 
+												 Optimization::Objective::Goal::Minimize );
+		this->AbsoluteObjectiveValueTolerance( Tolerance );
+		this->MaxNumberOfEvaluations( EvaluationLimit );
 		
-		// Loop over all consumption intervals and for each send the size of the 
-		// interval to the predictor, and then send the start time proposal to each
-		// assigned consumer.
+		auto Solution = this->FindSolution( StartTimeValues );
 		
-		for ( const ConsumptionInterval & Consumption : ConsumptionIntervals )
-		{
-		  // The predictor will need the consumption interval to compute the 
-			// integral	of the predicted production over this interval
-			
-			Send( Consumption.TheInterval, ThePredictor );
-			
-			// Then the start time is proposed to each of the associated consumers
-			// to compute their contribution to this interval.
-			
-			for( const ConsumptionInterval::AllocatedConsumer & ConsumerRecord
-				   : Consumption.AssociatedConsumers )
-				Send( ConsumerProxy::StartTimeProposal(ConsumerRecord.ProposedStartTime,
-																					     Consumption.TheInterval ), 
-					  (*ConsumerRecord.TheConsumer)->GetAddress() );
-
-			// The number of outstanding requests is the number of consumers in this 
-			// interval plus one for the request to the predictor for the value of 
-			// the whole interval. It does not matter if some of these requests have 
-			// already received a reply, because the balance will only be done when 
-			// the value function is called.
-			
-			OutstandingRequests += Consumption.AssociatedConsumers.size() + 1;
-		}
+		StartTimeValues = Solution.VariableValues;
+		ObjectiveValue  = Solution.ObjectiveValue;
+		
+		return Solution.Status;
 	}
 	
-	// The actual value is returned from a helper function using the standard 
-	// wait function semantics to ensure that all outstanding requests have 
-	// arrived before retuning to the calling thread. Since it will be called 
-	// from the PV Producer message handler, it will block that handler, but not 
-	// this actor's own postman, and incoming replies should therefore be 
-	// handled as normal.
-	
-	double Value( void )	
+	template< class... OptimizerArguments >
+	ScheduleSolver( PVProducer & Producer, OptimizerArguments... Arguments )
+	: NL::Optimizer< SolverAlgorithm >( Arguments... ),
+	  TheProducer( Producer ), StartTimeBounds()
 	{
-		std::unique_lock< std::timed_mutex > Lock( WaitGuard, 
-																							 std::chrono::seconds(10) );
-		
-		// The value function will block the calling thread as long as there are 
-		// any outstanding requests. It will be notified by the message handler 
-		// as soon as a message arrives, but in case this notification gets lost 
-		// there is an extreme time out of 10 seconds to ensure that the thread 
-		// recovers.
-		
-	  ResponseReceived.wait_for( Lock, std::chrono::seconds(10),
-													 [&](void)->bool{ return OutstandingRequests == 0; });
-
-		return TotalValue;
+		this->WarmStartSteps();
+		this->CancelWith( Producer.StaleSchedule );
 	}
 	
-	// The destructor currently does nothing, but is a place holder for correct 
-	// termination of the receiver.
-	
-	~CollectContribution( void )
+	virtual ~ScheduleSolver( void )
 	{ }
 };
 
-// -----------------------------------------------------------------------------
-// Objective function
-// -----------------------------------------------------------------------------
-//
-// First a small helper function to search through a list of consumption 
-// intervals to find one that fits a given consumer and its proposed start 
-// time. If an interval could be found, it returns true, if it could not be 
-// matched with any existing interval, it returns falls.
-
-bool Allocate2Interval( std::list< ConsumptionInterval > & ConsumptionIntervals,
-			Producer::ConsumerReference TheConsumer,
-			double StartTime )
-{
-  for ( auto & Period : ConsumptionIntervals )  
-    if ( Period.Union( TheConsumer, StartTime ) )
-      return true;
+// The producer's solve function selects the algorithm set for this producer
+// and returns true if the start time values can be used as a schedule, and 
+// false if the solver failed. The solver is invoked on the loads whose records
+// are in the active records and with the loads of the started records kept at
+// their start times. The constraint tolerance needed by the linear 
+// approximation is not used since there are no constraints on the start times
+// other than their bounds.
 
-  // If the search and the function were not terminated because the consumer 
-  // was allocated to one of the existing intervals, it terminates because 
-  // there is no suitable interval and false can safely be returned.
+bool PVProducer::SolveSchedule( std::vector< double > & StartTimeValues, 
+															  const ScratchVector & LowerBounds, 
+															  const ScratchVector & UpperBounds, 
+															  double & ObjectiveValue )
+{
+  nlopt_result SolutionResult = NLOPT_FAILURE;
+	
+  // The solver may throw if it cannot be allocated or if it was given invalid
+  // arguments, and in this case the search is considered as failed.
+  
+  try
+  {
+		if ( RaceBudget > std::chrono::milliseconds::zero() )
+			SolutionResult = RaceSchedule( StartTimeValues, LowerBounds, UpperBounds,
+																		 ObjectiveValue );
+		else
+		{
+			// The solver for this algorithm and number of start times is created
+			// if it does not exist from a previous search. The algorithms are not
+			// enumerators of the algorithm ID and are therefore compared in turn.
+			
+			std::shared_ptr< ScheduleSolverInterface > & Solver = 
+				ScheduleSolvers[ std::make_pair( SolverAlgorithm, 
+																				 StartTimeValues.size() ) ];
+			
+			if ( !Solver )
+			{
+				if ( SolverAlgorithm == NL::Algorithm::Local::Approximation::Rescaling )
+					Solver = std::make_shared< ScheduleSolver< 
+						NL::Algorithm::Local::Approximation::Rescaling > >( *this );
+				else if ( SolverAlgorithm == NL::Algorithm::Local::Approximation::Linear )
+					Solver = std::make_shared< ScheduleSolver< 
+						NL::Algorithm::Local::Approximation::Linear > >( *this, 0.0 );
+				else if ( SolverAlgorithm == NL::Algorithm::Local::Simplex::Subspace )
+					Solver = std::make_shared< ScheduleSolver< 
+						NL::Algorithm::Local::Simplex::Subspace > >( *this );
+				else if ( SolverAlgorithm == 
+									NL::Algorithm::Global::DIRECT::Local::Standard )
+					Solver = std::make_shared< ScheduleSolver< 
+						NL::Algorithm::Global::DIRECT::Local::Standard > >( *this );
+				else if ( SolverAlgorithm == 
+									NL::Algorithm::Global::ControlledRandomSearch )
+					Solver = std::make_shared< ScheduleSolver< 
+						NL::Algorithm::Global::ControlledRandomSearch > >( *this );
+			}
+			
+			if ( Solver )
+				SolutionResult = Solver->Solve( StartTimeValues, LowerBounds, 
+					UpperBounds, ObjectiveFunctionTolerance, EvaluationLimit, 
+					ObjectiveValue );
+		}
+  }
+  catch ( std::exception & SolverError )
+  {
+		SolutionResult = NLOPT_INVALID_ARGS;
+		#ifdef CoSSMic_DEBUG
+			Theron::ConsolePrint DebugMessage;
+			DebugMessage << GetAddress().AsString() << " " << SolverError.what() 
+									 << std::endl;
+		#endif
+  }
+  
+  // If a new solution was found, we will store the solution. It should be 
+  // noted that although the solver terminated, most of the positive results 
+  // may indicate a poor result quality. We are not dealing with this 
+  // situation yet.
+  //
+  // If the producer provides excess energy over all consumption intervals, 
+  // then the solver will not be able to find a best solution as there can 
+  // be many solutions that are equally good. Consider for instance a sunny 
+  // day when the production is running at maximum capacity the full day. Then
+  // the cumulative production is a linear function of constant slope and any 
+  // start time assigned to a load will give the same objective value. With 
+  // several loads the picture is identical if the consumptions of each load is 
+  // unique, i.e. no other load is started within its activity period. In 
+  // these cases the solver will simply fail to provide a good solution, and  
+  // any of the solutions with minimal objective function is as good as any  
+  // other. The solver will fail with the best solution seen, and for this 
+  // reason we treat failure as a success (even though it may seem strange)
  
-  return false;
+  switch ( SolutionResult )
+  {
+    case NLOPT_SUCCESS:
+    case NLOPT_ROUNDOFF_LIMITED:
+    case NLOPT_STOPVAL_REACHED:
+    case NLOPT_FTOL_REACHED:
+    case NLOPT_XTOL_REACHED:
+    case NLOPT_MAXEVAL_REACHED:
+    case NLOPT_MAXTIME_REACHED:
+    case NLOPT_FAILURE:
+      return true;
+    
+    default:
+      // If the solver failed, no action is taken. However, as indicated 
+      // above, this situation should never happen.
+      #ifdef CoSSMic_DEBUG
+        Theron::ConsolePrint DebugMessage;
+        DebugMessage << GetAddress().AsString() << " solver status " 
+										 << SolutionResult << std::endl;
+      #endif
+      return false;
+  }
 }
 
-// The objective function receives a set of proposed start times from the solver
-// and will first construct all the consumption intervals for these start times,
-// and then evaluate the contribution of each consumption interval to the 
-// overall objective value.
+// -----------------------------------------------------------------------------
+// Racing portfolio
+// -----------------------------------------------------------------------------
+//
+// The race is run by the portfolio of the Optimization library where each 
+// algorithm runs in its own thread. The local BOBYQA algorithm starts from 
+// the current start times and will normally converge first for easy producer
+// states, whereas the global DIRECT and controlled random search algorithms 
+// explore the full time windows of the loads and may find a better schedule 
+// when the local search gets trapped. The multi-level single linkage
+// algorithm could also be a candidate, but it does its local searches 
+// sequentially and it would rarely finish within the budget. The objective 
+// tolerance and the evaluation limit set for the producer are used for all 
+// the algorithms.
+//
+// Each algorithm gets its own evaluator with a private vector of activities, 
+// and the evaluators share the prediction snapshot since its tables are only 
+// read. If the budget expires before any algorithm has converged, 
+// the best start times seen so far are used as the schedule, and the status 
+// is reported as having reached the time limit.
 
-double PVProducer::ObjectiveFunction(
-		   const std::vector< double > & ProposedStartTimes )
+nlopt_result PVProducer::RaceSchedule( std::vector< double > & StartTimeValues, 
+															  const ScratchVector & LowerBounds, 
+															  const ScratchVector & UpperBounds, 
+															  double & ObjectiveValue )
 {
-  // There is a list of consumption intervals as there can potentially be 
-  // as many intervals as there are consumers if their individual consumption 
-  // intervals are disjoint.
+  NL::Portfolio Algorithms( ObjectiveFunctionTolerance, EvaluationLimit );
   
-  std::list< ConsumptionInterval > ConsumptionIntervals;
+  Algorithms.Add< NL::Algorithm::Local::Approximation::Rescaling >();
+  Algorithms.Add< NL::Algorithm::Global::DIRECT::Standard >();
+  Algorithms.Add< NL::Algorithm::Global::ControlledRandomSearch >();
   
-  // First the necessary intervals are created to contain all the started loads.
-  // For these the start time must have been set since they are all started, 
-  // and it is therefore possible to pass this directly as the starting point
-  // of the interval if a new interval must be constructed.
- 
-  for ( auto & TheConsumer : StartedLoads )
-    if ( ! Allocate2Interval( ConsumptionIntervals, TheConsumer,
-												      (*TheConsumer)->GetStartTime().value() ) )
-      ConsumptionIntervals.emplace_back( TheConsumer,
-					 (*TheConsumer)->GetStartTime().value() );
-  
-  // For the active loads, it is necessary to allocate them to consumption 
-  // intervals based on the proposed start times.Note that the number of 
-  // proposed start times must equal the number of active loads, and therefore 
-  // there is no need to test the iterator for validity to ensure that it does 
-  // not move past the last element of the start time vector.
+  std::vector< NL::Portfolio::Interval > StartTimeBounds;
   
-  auto SuggestedStartTime = ProposedStartTimes.begin();
+  for ( std::size_t i = 0; i < LowerBounds.size(); i++ )
+    StartTimeBounds.emplace_back( LowerBounds[i], UpperBounds[i] );
   
-  // Each of the active loads are tried against the consumption intervals 
-  // and if the load cannot be allocated to one of the existing intervals,
-  // a new will be created.
+  std::size_t NumberOfLoads = StartedRecords.size() + ActiveRecords.size();
   
-  for ( auto & TheConsumer : ActiveLoads )
-  {
-    // If the consumer cannot be allocated to any of the existing intervals,
-    // a new interval will be created for this consumer
-    
-    if ( ! Allocate2Interval( ConsumptionIntervals, TheConsumer, 
-												      *SuggestedStartTime ) )
-      ConsumptionIntervals.emplace_back( TheConsumer,	 *SuggestedStartTime   );
-    
-    // The consumer is now associated with one and only one consumption 
-    // interval, and we can move on to the next consumer. For this we have to
-    // move to the next proposed start time.
-    
-    ++SuggestedStartTime;
-  }
+  auto Outcome = Algorithms.Solve( StartTimeValues, StartTimeBounds, 
+    [&,this](void)->NL::Portfolio::Evaluator
+    {
+      auto Production     = ProductionSnapshot;
+      auto LoadActivities = std::allocate_shared< ActivityVector >( 
+        std::pmr::polymorphic_allocator< ActivityVector >( &SchedulingArena ) );
+      
+      LoadActivities->reserve( NumberOfLoads );
+      
+      return [this, Production, LoadActivities]( 
+						   const Optimization::Variables & StartTimes )->double
+      {
+				return ScheduleValue( StartTimes, *LoadActivities, *Production );
+			};
+    }, 
+    NL::Portfolio::Clock::now() + RaceBudget );
   
-  // With all the consumption intervals defined, the computation of the 
-  // objective value can be started by the collector, which will terminate when
-  // all the parts of the value have been received from the other actors and 
-  // the prediction.
+  if ( Outcome.VariableValues.empty() )
+    return NLOPT_FAILURE;
   
-  Collector->Initialise( ConsumptionIntervals );
+  StartTimeValues = Outcome.VariableValues;
+  ObjectiveValue  = Outcome.ObjectiveValue;
   
-  return Collector->Value();
-}
-
-// It is necessary to define a C-style objective function that forwards the 
-// objective function call to the objective function in the load scheduler. 
-// The trick is to use the NLopt provided function parameter structure, and 
-// define this to be equal to the 'this' pointer of the load scheduler instance 
-// invoking the solver.
-
-double C_ObjectiveFunction( const std::vector< double > & ProposedStartTimes, 
-												    std::vector< double > & Gradient, 
-												    void * FunctionParameters )
-{
-  PVProducer * This = reinterpret_cast< PVProducer *>( FunctionParameters );
+  #ifdef CoSSMic_DEBUG
+    Theron::ConsolePrint DebugMessage;
+    
+    DebugMessage << GetAddress().AsString() << " race of " 
+								 << Outcome.Evaluations << " evaluations ";
+		
+		if ( Outcome.Winner )
+		  DebugMessage << "won by " << nlopt_algorithm_name( 
+									static_cast< nlopt_algorithm >( Outcome.Winner.value() ) );
+		else
+			DebugMessage << "stopped by the time budget";
+		
+		DebugMessage << std::endl;
+  #endif
   
-  return This->ObjectiveFunction( ProposedStartTimes );
+  if ( Outcome.Status == NLOPT_FORCED_STOP )
+    return NLOPT_MAXTIME_REACHED;
+  else
+    return Outcome.Status;
 }
 
-
 // -----------------------------------------------------------------------------
 // SCHEDULING: The New Load message handler
 // -----------------------------------------------------------------------------
@@ -718,9 +1051,25 @@ double C_ObjectiveFunction( const std::vector< double > & ProposedStartTimes,
 // and if a consumer does not receive a valid start time, it is expected that 
 // it will try a different producer, i.e. kill its proxy with this consumer.
 
+// A schedule command queued for the producer cancels the search currently 
+// running for the previous command, if any. The message is then queued as 
+// normal. Note that this function runs on the thread of the sender.
+
+bool PVProducer::EnqueueMessage( 
+								 const std::shared_ptr< GenericMessage > & TheMessage )
+{
+	if ( std::dynamic_pointer_cast< Message< Producer::ScheduleCommand > >( 
+			 TheMessage ) )
+		StaleSchedule.Cancel();
+	
+	return Actor::EnqueueMessage( TheMessage );
+}
+
 void PVProducer::NewLoad( const Producer::ScheduleCommand & TheCommand, 
 												  const Theron::Address TheConsumer )
 {
+  THERON_PROFILE_ZONE_DETAIL( "PVProducer::NewLoad", GetAddress().AsString() );
+
   // The time to produce a schedule is recorded in order to be able to define 
   // the time window 'now + delta' where a consumer can start consuming 
   // energy before the new schedule is ready, and hence consumers with assigned
@@ -731,6 +1080,11 @@ void PVProducer::NewLoad( const Producer::ScheduleCommand & TheCommand,
   std::chrono::system_clock::time_point StartTime 
 					     = std::chrono::system_clock::now(); 
 
+  // This command is now the newest command, and the schedule computed for it
+  // should only be cancelled by a command arriving after this point.
+
+  StaleSchedule.Reset();
+
   // The standard producer handler is invoked to create a proxy for this load,
   // provided that the energy requested is larger than zero. This is because 
   // a zero energy load is sent to trigger the production of a new schedule when
@@ -762,23 +1116,29 @@ void PVProducer::NewLoad( const Producer::ScheduleCommand & TheCommand,
     
     auto Consumer( *ActiveLoads[0] );
     
-    // The single consumer scheduler can then be started based on the 
-    // information provided in the schedule command. However, this must 
-    // instead be taken from the the assigned consumer because this can be a 
-    // re-scheduling in response to a production prediction update, and in 
-    // this case the command is void.
+    // The start time can then be computed based on the information provided
+    // in the schedule command. However, this must instead be taken from the 
+    // the assigned consumer because this can be a re-scheduling in response 
+    // to a production prediction update, and in this case the command is void.
     
-    SingleConsumerHeuristic SingleScheduler( GetFramework(), 
-    boost::numeric::intersect( Consumer->AllowedInterval(), 
-													     TimeInterval( Now(), PredictionDomain.upper() )),
-		Consumer->GetDuration(), 
-		Consumer->GetEnergy(),
-		Prediction->GetAddress()   
-	  );
+    Time CurrentTime = Now();
+    
+    ProductionSnapshot = Prediction->GetSnapshot();
+    
+    Producer::AssignedStartTime StartTime( SingleConsumerStartTime( 
+    	boost::numeric::intersect( Consumer->AllowedInterval(), 
+													       TimeInterval( CurrentTime, PredictionDomain.upper() )),
+			Consumer->GetDuration(), 
+			ProductionSnapshot->EarliestEnd( Consumer->GetEnergy(), CurrentTime ) ) );
+    
+    if ( Consumer->GetStartTime().has_value() && 
+				 ( !StartTime.has_value() || 
+				   ( StartTime.value() != Consumer->GetStartTime().value() ) ) )
+      StartTimeChanges->Add();
     
     // The computed start time is sent back to the requesting consumer.
     
-    Send( SingleScheduler.ComputeSolution(), Consumer->GetAddress() );
+    Send( StartTime, Consumer->GetAddress() );
     
     // If there are no running loads, this active consumer is by definition 
     // the load first to start.
@@ -788,167 +1148,164 @@ void PVProducer::NewLoad( const Producer::ScheduleCommand & TheCommand,
 	  }
   else if ( ActiveLoads.size() > 1 ) // *** MULTIPLE CONSUMERS ***
   {
-    // Creating the solver object with the algorithm to use for the solution 
-    // and the number of start times to find.
+    // The data needed by the objective function is copied from the predictor 
+    // and the consumer proxies before the solver starts so that the solution 
+    // is computed on a consistent view of the production and the loads.
     
-    nlopt::opt Solver( nlopt::algorithm::LN_BOBYQA, ActiveLoads.size() );
-
-    // There are two soft parameters related to the convergence of the solver:
-    // The tolerance on the objective function  indicates that the 
-    // algorithm should stop whenever two successive evaluations of the objective 
-    // functions gives values that are less than the tolerance; and the 
-    // evaluation limit gives the maximum number of objective function 
-    // evaluations accepted for finding a solution.
+    ProductionSnapshot = Prediction->GetSnapshot();
     
-    Solver.set_ftol_abs( ObjectiveFunctionTolerance );
-    Solver.set_maxeval ( EvaluationLimit );
+    StartedRecords.clear();
+    ActiveRecords.clear();
     
-    // The boundaries are collected for all the start times. We will start
-    // the search for new load start times from the current solution. If there  
-    // is no start time currently set, we will set an initial guess as a random 
-    // number in the allowed interval. Note that the scan will be done with 
-    // iterators since we will remove the jobs that have already started based  
-    // on their absolute time.
-    //
-    // The start time values will after this search hold the initial start times
-    // for all loads to be scheduled, and the upper and lower bound vectors will 
-    // respectively contain the earlies and latest start time for the loads.
-
-    std::vector< double > StartTimeValues, UpperBounds, LowerBounds;
+    for ( auto & TheConsumer : StartedLoads )
+      StartedRecords.emplace_back( TheConsumer );
     
-    for ( auto TheConsumer : ActiveLoads )
-    {
-      LowerBounds.push_back( 
-									std::max( (*TheConsumer)->AllowedInterval().lower(), Now()  ));
-      
-      UpperBounds.push_back( std::min((*TheConsumer)->AllowedInterval().upper(), 
-																			PredictionDomain.upper() ) );
-
-      if ( (*TheConsumer)->GetStartTime() )
-				StartTimeValues.push_back( (*TheConsumer)->GetStartTime().value() );
-      else
-				StartTimeValues.push_back( 
-									 Random::Number( LowerBounds.back(),  UpperBounds.back() ));      
-    }
+    Activities.reserve( StartedLoads.size() + ActiveLoads.size() );
     
-    // The bounds are then registered to guide the solver's search.
+    // The bounds on the start time of a load are given by its allowed start 
+    // interval limited to the part of the interval that is after now and 
+    // within the prediction domain.
     
-    Solver.set_upper_bounds( UpperBounds );
-    Solver.set_lower_bounds( LowerBounds );
+    auto EarliestStart = [&]( const ConsumerReference & TheConsumer )->double{
+      return std::max( (*TheConsumer)->AllowedInterval().lower(), Now() ); };
+      
+    auto LatestStart = [&]( const ConsumerReference & TheConsumer )->double{
+      return std::min( (*TheConsumer)->AllowedInterval().upper(), 
+										   PredictionDomain.upper() ); };
     
-    // Note that with these bounds the problem essentially becomes unconstrained
-    // and we do not need to register any constraints for the problem. The 
-    // objective function to be minimised has to be forwarded as a C-style 
-    // function, i.e. a function that has no "this" pointer. However, it 
-    // supports passing a pointer to a set of parameters needed to compute the 
-    // value of the objective function. By passing 'this' as the pointer to the 
-    // parameter structure, the class internal objective function can be invoked 
-    // on 'this' producer instance. There is a slight overhead by this indirect 
-    // invocation of the object function, but this is probably offset by the 
-    // convenience of having the objective function as a part of the class.
+    // In the incremental mode, a new load is first placed against the current 
+    // schedule of the other active loads. This is only possible if the command 
+    // is a real load and not a trigger from the predictor, since a new 
+    // prediction changes the value of the current schedule, and if all the 
+    // other active loads have been given a start time. The new load is the 
+    // last load assigned to the producer.
     
-    Solver.set_min_objective( C_ObjectiveFunction, this );
+    ConsumerReference NewConsumer = std::prev( EndConsumer() );
     
-    // Then the problem can be solved. Note that the solver will throw an
-    // exception if encounters an error in the solution instead of negative 
-    // result values. We will catch the errors, and note the outcome of the  
-    // run. In addition to the initial start time values as collected above,
-    // the solver will also need a variable to hold the best objective function
-    // it managed to obtain.
+    bool IncrementallyPlaced = false;
     
-    double 	  		ObjectiveValue = 0.0;
-    nlopt::result SolutionResult;
-
-		try
-    {
-      SolutionResult = Solver.optimize( StartTimeValues, ObjectiveValue );
-    }
-    catch ( nlopt::roundoff_limited NLOptError )
+    if ( IncrementalScheduling && ( TheCommand.TotalEnergy() > 0.0 ) &&
+				 std::all_of( ActiveLoads.begin(), ActiveLoads.end(), 
+				 [&]( const ConsumerReference & TheConsumer )->bool{
+					 return ( TheConsumer == NewConsumer ) || 
+									(*TheConsumer)->GetStartTime().has_value(); }) &&
+				 std::find( ActiveLoads.begin(), ActiveLoads.end(), NewConsumer ) 
+				 != ActiveLoads.end() )
     {
-      SolutionResult = nlopt::ROUNDOFF_LIMITED;
-      #ifdef CoSSMic_DEBUG
-        Theron::ConsolePrint DebugMessage;
-        DebugMessage << GetAddress().AsString() << " ROUNDOFF_LIMITED" 
-										 << std::endl;
-      #endif
-    }
-    catch ( std::invalid_argument NLOptError )
-    {
-      SolutionResult = nlopt::INVALID_ARGS;
-      #ifdef CoSSMic_DEBUG
-        Theron::ConsolePrint DebugMessage;
-        DebugMessage << GetAddress().AsString() << " INVALID_ARGS" << std::endl;
-      #endif
-    }
-    catch ( std::bad_alloc NLOptError )
-    {
-      SolutionResult = nlopt::OUT_OF_MEMORY;
-      #ifdef CoSSMic_DEBUG
-        Theron::ConsolePrint DebugMessage;
-        DebugMessage << GetAddress().AsString() << " OUT_OF_MEMORY" 
-										 << std::endl;
-      #endif
-    }
-    catch ( std::runtime_error NLOptError )
-    {
-      SolutionResult = nlopt::FAILURE;
-      #ifdef CoSSMic_DEBUG
-        Theron::ConsolePrint DebugMessage;
-        DebugMessage << GetAddress().AsString() << " FAILURE" << std::endl;
-      #endif
+      // The other active loads are then fixed in the same way as the started 
+      // loads, and the value of the current schedule is the objective value 
+      // when there are no loads to be scheduled.
+      
+      for ( auto & TheConsumer : ActiveLoads )
+				if ( TheConsumer != NewConsumer )
+					StartedRecords.emplace_back( TheConsumer );
+      
+      double CurrentValue = ObjectiveFunction( std::vector< double >() );
+      
+      // The new load is the only load to schedule, and the search starts from 
+      // a random start time within its bounds.
+      
+      ActiveRecords.emplace_back( NewConsumer );
+      
+      ScratchVector 
+        LowerBounds( 1, EarliestStart( NewConsumer ), &SchedulingArena ),
+        UpperBounds( 1, LatestStart( NewConsumer ), &SchedulingArena );
+      std::vector< double > 
+        StartTimeValues( 1, 
+					Random::Number( LowerBounds.front(), UpperBounds.front() ) );
+      
+      double IncrementalValue = 0.0;
+      
+      // The placement is accepted if the increase of the objective value caused
+      // by the new load is within the threshold. Otherwise the placement is 
+      // considered so poor that it is worth to move the other loads too, and  
+      // the full schedule will be computed as if there was no incremental 
+      // mode.
+      
+      if ( SolveSchedule( StartTimeValues, LowerBounds, UpperBounds, 
+												  IncrementalValue ) &&
+				   ( IncrementalValue - CurrentValue <= ReschedulingThreshold ) )
+      {
+				Send( AssignedStartTime( std::lround( StartTimeValues.front() ) ), 
+							(*NewConsumer)->GetAddress() );
+				IncrementallyPlaced = true;
+      }
+      else
+      {
+				StartedRecords.erase( StartedRecords.begin() + StartedLoads.size(), 
+															StartedRecords.end() );
+				ActiveRecords.clear();
+      }
     }
     
-    // If a new solution was found, we will store the solution. It should be 
-    // noted that although the solver terminated, most of the positive results 
-    // may indicate a poor result quality. We are not dealing with this 
-    // situation yet.
-    //
-    // If the producer provides excess energy over all consumption intervals, 
-    // then the solver will not be able to find a best solution as there can 
-    // be many solutions that are equally good. Consider for instance a sunny 
-    // day when the production is running at maximum capacity the full day. Then
-    // the cumulative production is a linear function of constant slope and any 
-    // start time assigned to a load will give the same objective value. With 
-    // several loads the picture is identical if the consumptions of each load is 
-    // unique, i.e. no other load is started within its activity period. In 
-    // these cases the solver will simply fail to provide a good solution, and  
-    // any of the solutions with minimal objective function is as good as any  
-    // other. The solver will fail with the best solution seen, and for this 
-    // reason we treat failure as a success (even though it may seem strange)
- 
-    switch ( SolutionResult )
+    // The full schedule is computed for all active loads unless the new load 
+    // could be placed incrementally.
+    
+    if ( ! IncrementallyPlaced )
     {
-      case nlopt::SUCCESS:
-			case nlopt::ROUNDOFF_LIMITED:
-      case nlopt::STOPVAL_REACHED:
-      case nlopt::FTOL_REACHED:
-      case nlopt::XTOL_REACHED:
-      case nlopt::MAXEVAL_REACHED:
-      case nlopt::MAXTIME_REACHED:
-      case nlopt::FAILURE:
+      // The boundaries are collected for all the start times. We will start
+      // the search for new load start times from the current solution. If there  
+      // is no start time currently set, we will set an initial guess as a random 
+      // number in the allowed interval. Note that the scan will be done with 
+      // iterators since we will remove the jobs that have already started based  
+      // on their absolute time.
+      //
+      // The start time values will after this search hold the initial start times
+      // for all loads to be scheduled, and the upper and lower bound vectors will 
+      // respectively contain the earlies and latest start time for the loads.
+
+      std::vector< double > StartTimeValues;
+      ScratchVector UpperBounds( &SchedulingArena ), 
+                    LowerBounds( &SchedulingArena );
+    
+      StartTimeValues.reserve( ActiveLoads.size() );
+      UpperBounds.reserve( ActiveLoads.size() );
+      LowerBounds.reserve( ActiveLoads.size() );
+    
+      for ( auto TheConsumer : ActiveLoads )
       {
-        // We will set, send, and collect the information needed in one pass 
-        // over the list of waiting consumers trying to obtain energy from this
-        // producer. The start time values do exist since the vector was 
-				// initialised, but if there is a solver failure they may not have 
-				// valid values. TODO: Recover gracefully from solver failures
+        LowerBounds.push_back( EarliestStart( TheConsumer ) );
+        UpperBounds.push_back( LatestStart( TheConsumer ) );
+        ActiveRecords.emplace_back( TheConsumer );
 
+        if ( (*TheConsumer)->GetStartTime() )
+				  StartTimeValues.push_back( (*TheConsumer)->GetStartTime().value() );
+        else
+				  StartTimeValues.push_back( 
+									 Random::Number( LowerBounds.back(),  UpperBounds.back() ));      
+      }
+    
+      // The schedule can then be solved, and if the solver produced a usable 
+      // solution the start times are sent to the consumers. The start time 
+      // values do exist since the vector was initialised, but if there is a 
+      // solver failure they may not have valid values. TODO: Recover 
+      // gracefully from solver failures. In the incremental mode, only the 
+      // consumers whose start time changed will be told.
+    
+      double ObjectiveValue = 0.0;
+    
+      if ( SolveSchedule( StartTimeValues, LowerBounds, UpperBounds, 
+											    ObjectiveValue ) )
+      {
 				auto StartTime = StartTimeValues.begin();
         
         for ( auto & Consumer : ActiveLoads )
         {
-	        Send( AssignedStartTime( std::lround( *StartTime ) ), 
-								(*Consumer)->GetAddress() );
+					Time NewStartTime = std::lround( *StartTime );
+					
+					if ( (*Consumer)->GetStartTime().has_value() && 
+							 (*Consumer)->GetStartTime().value() != NewStartTime )
+						StartTimeChanges->Add();
+					
+	        if ( ! IncrementalScheduling || 
+							 ! (*Consumer)->GetStartTime().has_value() || 
+							 (*Consumer)->GetStartTime().value() != NewStartTime )
+						Send( AssignedStartTime( NewStartTime ), 
+									(*Consumer)->GetAddress() );
+					
 	        ++StartTime;
         }
-        break;
       }
-      
-      default:
-			// If the solver failed, no action is taken. However, as indicated 
-			// above, this situation should never happen.
-			std::cout << "WHAT IS GOING ON?!?" << std::endl;
-			break;
     }
     
     // If there are running consumers, then their start time is by definition 
@@ -984,6 +1341,11 @@ void PVProducer::NewLoad( const Producer::ScheduleCommand & TheCommand,
       EarliestStartingConsumer = 
 				FindConsumer( (*EarliestCandidate)->GetAddress() );
     }
+    
+    // The bounds and the racing activities have been destroyed, and their 
+    // memory is returned to the scheduling pool for the next schedule.
+    
+    SchedulingArena.release();
   }
   else      // *** NO CONSUMERS ***
     return; // Nothing to do, i.e. no active loads detected.
@@ -1028,6 +1390,18 @@ void PVProducer::NewLoad( const Producer::ScheduleCommand & TheCommand,
   TimeOffset = std::chrono::duration_cast< std::chrono::milliseconds >( 
     std::chrono::duration< double >( NewOffset ) );
   
+  TotalSchedulingTime.fetch_add( delta.count(), std::memory_order_relaxed );
+  
+  // The exported metrics are updated with this schedule
+  
+  unsigned long EvaluationsUsed = ObjectiveEvaluations();
+  
+  Reschedules->Add();
+  SolverEvaluations->Add( EvaluationsUsed - ExportedEvaluations );
+  SchedulingLatency->Observe( std::chrono::duration< double >( 
+    std::chrono::system_clock::now() - StartTime ).count() );
+  
+  ExportedEvaluations = EvaluationsUsed;
 }
 
 
@@ -1043,31 +1417,99 @@ void PVProducer::NewLoad( const Producer::ScheduleCommand & TheCommand,
 
 PVProducer::PVProducer( const IDType & ProducerID, 
 												const std::string & PredictionFile, 
-												double SolutionTolerance, int MaxEvaluations)
+												double SolutionTolerance, int MaxEvaluations,
+												NL::Algorithm::ID Algorithm,
+												bool Incremental, double RescheduleThreshold, 
+												std::chrono::milliseconds RacingBudget,
+												double PredictionTolerance,
+												double InstalledCapacity, double KnotTolerance )
 : Actor( ( ValidID( ProducerID ) ? 
 	       std::string( PVProducerNameBase + ProducerID ).data() 
 	       : std::string() )  ), 
 	StandardFallbackHandler( GetAddress().AsString()),
   DeserializingActor( GetAddress().AsString() ),
   Producer( ProducerID ),
-  Prediction(), Collector( ),
+  Prediction(), BalanceAccount(), ReportedUntil( 0 ),
   PredictionDomain(), ActiveLoads(), StartedLoads(), FutureLoads(),
-  TimeOffset(), EarliestStartingConsumer( FirstConsumer() )
+  PartitionedDomain(), TimeOffset(), TotalSchedulingTime( 0 ), StaleSchedule(),
+  EarliestStartingConsumer( FirstConsumer() ), ProductionSnapshot(), StartedRecords(), ActiveRecords(), Activities(),
+  SchedulingPool( Theron::MemoryAccounting::Resource( "Producer" ) ),
+  SchedulingArena( &SchedulingPool ),
+  Evaluations( 0 ), Reschedules(), SolverEvaluations(), StartTimeChanges(),
+  SchedulingLatency(), ExportedEvaluations( 0 ), ScheduleSolvers()
 {
   ObjectiveFunctionTolerance = SolutionTolerance;
   EvaluationLimit 	         = MaxEvaluations;
+  SolverAlgorithm            = Algorithm;
+
+  // Only the algorithms that do not need gradients and that need no other 
+  // parameters than the bounds of the start times can be used by the 
+  // producer, and it is an error to ask for another algorithm. The algorithms
+  // are not enumerators of the algorithm ID, and they are therefore compared
+  // rather than used as case labels.
+  
+  if ( ( SolverAlgorithm != NL::Algorithm::Local::Approximation::Rescaling ) &&
+       ( SolverAlgorithm != NL::Algorithm::Local::Approximation::Linear    ) &&
+       ( SolverAlgorithm != NL::Algorithm::Local::Simplex::Subspace        ) &&
+       ( SolverAlgorithm != NL::Algorithm::Global::DIRECT::Local::Standard ) &&
+       ( SolverAlgorithm != NL::Algorithm::Global::ControlledRandomSearch  ) )
+  {
+		std::ostringstream ErrorMessage;
+		
+		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "The PV producer " << ProducerID << " cannot schedule"
+								 << " with the NLopt algorithm " 
+								 << nlopt_algorithm_name( 
+										static_cast< nlopt_algorithm >( SolverAlgorithm ) );
+								 
+		throw std::invalid_argument( ErrorMessage.str() );
+  }
+  IncrementalScheduling      = Incremental;
+  ReschedulingThreshold      = RescheduleThreshold;
+  RaceBudget                 = RacingBudget;
+  RevisionTolerance          = PredictionTolerance;
 
-	// Initialise Prediction and Collector
+  // The exported metrics are labelled with the name of the producer
+  
+  const Theron::MetricsExporter::Labels 
+		ProducerLabel{ { "producer", GetAddress().AsString() } };
+  
+  Reschedules = Theron::MetricsExporter::NewCounter( 
+    "cossmic_producer_reschedules_total", 
+    "Schedules computed by the producer", ProducerLabel );
+  SolverEvaluations = Theron::MetricsExporter::NewCounter( 
+    "cossmic_producer_solver_evaluations_total", 
+    "Schedule evaluations used by the solvers of the producer", ProducerLabel );
+  StartTimeChanges = Theron::MetricsExporter::NewCounter( 
+    "cossmic_producer_start_time_changes_total", 
+    "Assigned start times changed by a new schedule", ProducerLabel );
+  SchedulingLatency = Theron::MetricsExporter::NewHistogram( 
+    "cossmic_producer_scheduling_seconds", 
+    "Time taken by the producer to compute a schedule", 
+    Theron::MetricsExporter::LatencyBounds(), ProducerLabel );
+
+	// Initialise the prediction
 	
 	Prediction = std::make_shared < Predictor >( PredictionFile, GetAddress(), 
-               std::string( "prediction" + ProducerID ).data() );
-              
-  Collector = std::make_shared< CollectContribution >(Prediction->GetAddress());
+               std::string( "prediction" + ProducerID ).data(), 
+               InstalledCapacity, KnotTolerance );
+
+	// The producer, its predictor and its consumer proxies exchange most of 
+	// their messages and share the interpolation data of the prediction, and 
+	// they are therefore placed in the same affinity group named by the 
+	// producer so that they execute on the same NUMA node. The proxies are 
+	// given the placement of the producer when they are created.
+	
+	SetPlacement( Theron::Actor::Placement{ std::nullopt, std::nullopt, 
+																					GetAddress().AsString() } );
+	Prediction->SetPlacement( GetPlacement() );
 	
   // Register message handlers. Note that new load and kill proxy are 
   // registered by the generic producer.
   
   RegisterHandler(this, &PVProducer::UpdatePrediction );
+  RegisterHandler(this, &PVProducer::RevisePrediction );
+  RegisterHandler(this, &PVProducer::PredictionChanged );
 }
 
 } // End name space CoSSMic
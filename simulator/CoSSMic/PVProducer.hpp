@@ -25,11 +25,21 @@
 #include <limits>										// Numeric limits
 #include <vector>										// For not started loads, and future loads
 #include <chrono>										// For system clock and time offset
+#include <map>											// For prediction samples
+#include <optional>									// Domain of the last load partitioning
+#include <atomic>										// Counting objective evaluations
+#include <memory_resource>							// Scheduling scratch memory
+
+#include <nlopt.h>										// Solver status codes
 
 #include "Actor.hpp"								// The Theron++ actor framework
 #include "SerialMessage.hpp" 				// Support for network messages
 #include "DeserializingActor.hpp" 	// Support for receiving a serial message
 #include "StandardFallbackHandler.hpp"
+#include "MetricsExporter.hpp"				// Exported scheduling metrics
+
+#include "NonLinear/Algorithms.hpp"		// Solver algorithm selection
+#include "NonLinear/Cancellation.hpp"	// Cancelling stale schedules
 
 #include "Producer.hpp"							// The generic producer 
 #include "Predictor.hpp"						// Management of the energy prediction
@@ -37,8 +47,6 @@
 namespace CoSSMic
 {
 
-class CollectContribution;
-	
 // Strictly speaking, only the producer needs to be inherited. However, given 
 // that the producer inherits the actor and the de-serialising actor as virtual 
 // base classes to avoid potential diamond inheritance problems, the constructor
@@ -128,6 +136,10 @@ public:
 	    Serialize( void ) const override;
     virtual bool
 	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
     
     // The destructor is just a place holder
     
@@ -135,6 +147,45 @@ public:
     { }
   };
 
+  // A new prediction may alternatively be given as a delta to the current 
+  // prediction, as explicit samples, or as the name of a file containing the 
+  // samples appended to or replacing the current samples, see the prediction 
+  // revision of the predictor. The delta is serialised with the file name 
+  // followed by the number of samples and the samples.
+  
+  class PredictionDelta : public Theron::SerialMessage,
+												  public PredictionRevision
+  {
+  public:
+    
+    virtual Theron::SerialMessage::Payload 
+	    Serialize( void ) const override;
+    virtual bool
+	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
+    
+    PredictionDelta( const std::string & FileName )
+    : PredictionRevision{ FileName, std::map< Time, double >() }
+    { }
+    
+    PredictionDelta( const std::map< Time, double > & RevisedSamples )
+    : PredictionRevision{ std::string(), RevisedSamples }
+    { }
+    
+    PredictionDelta( const PredictionDelta & Other )
+    : PredictionRevision( Other )
+    { }
+    
+    PredictionDelta( void ) : PredictionRevision()
+    { }
+    
+    virtual ~PredictionDelta( void )
+    { }
+  };
+
   // The result of the prediction update is an interpolated function, and the
   // integrated prediction. However, these computations can happen in parallel 
   // with other processing, and for that reason this information is encapsulated
@@ -145,7 +196,6 @@ public:
 private:
   
   std::shared_ptr< Predictor > Prediction;
-  std::shared_ptr< CollectContribution > Collector;
 	
   // The messages indicating the availability of a new prediction are received 
   // by the Update Prediction handler, which then forwards the request to the 
@@ -188,6 +238,58 @@ private:
     Send( TheCommand.NewPredictionFile, Prediction->GetAddress() );
   }
   
+  // A prediction delta is forwarded to the predictor as a revision of the 
+  // current prediction. 
+  
+  void RevisePrediction( const PredictionDelta & TheDelta, 
+												 const Theron::Address TheForecaster )
+  {
+    Send( PredictionRevision( TheDelta ), Prediction->GetAddress() );
+  }
+  
+  // The state of the PV producer that cannot be recovered by the consumers 
+  // asking for energy again is the prediction, and the checkpoint is forwarded
+  // to the predictor.
+  
+protected:
+  
+  virtual void SaveCheckpoint( const Checkpoint & TheCheckpoint, 
+															 const Theron::Address TheActorManager ) override
+  {
+    Send( TheCheckpoint, Prediction->GetAddress() );
+  }
+  
+private:
+  
+  // When the predictor has revised the prediction it returns the new domain 
+  // and the interval where the prediction changed. The loads are rescheduled
+  // only if the prediction changed by more than a tolerance over the window 
+  // of a load, from its earliest start to its latest possible end, or its 
+  // end if it has started. The change is the largest difference in the energy
+  // produced from the start of the window between the revised snapshot and 
+  // the snapshot used for the current schedule, so that changes that do not 
+  // affect the assigned loads will not cause a new schedule. Note that a 
+  // schedule will always be computed if there is no current schedule.
+  
+  double RevisionTolerance;
+  
+  void PredictionChanged( const PredictionRevised & TheRevision, 
+												  const Theron::Address ThePredictor );
+  
+  // The energy produced since the last revision is estimated by the revised 
+  // prediction when the prediction is revised, and it is reported as an 
+  // energy delta to the reward calculator keeping the energy balance of the 
+  // household if the producer has been given its address.
+  
+  Theron::Address BalanceAccount;
+  Time            ReportedUntil;
+  
+public:
+  
+  void ReportProductionTo( const Theron::Address & TheCalculator );
+  
+private:
+  
   // When the predictor has loaded the new prediction, the schedule of the 
   // allocated loads must be re-computed based on the current prediction. Thus,
   // the predictor will send a schedule command to the producer to trigger a 
@@ -238,9 +340,21 @@ private:
   // lists and move on to the next element in the list. Since the element 
   // references will be different, the elements of the three sets will be 
   // disjoint.
+  //
+  // The partition is maintained incrementally: A started load will stay 
+  // started, so only the active and the future loads are classified again 
+  // together with the loads assigned since the last partitioning, which are 
+  // at the end of the list of consumers. All loads are classified again if 
+  // the prediction domain has changed since the last partitioning. 
   
   void PartitionLoads( void );
   
+  std::optional< TimeInterval > PartitionedDomain;
+  
+  // A consumer about to be deleted must be removed from the partitions
+  
+  virtual void ForgetConsumer( const ConsumerReference & TheConsumer ) override;
+  
   // A time offset will be used to compensate for these inaccuracies. Thus,
   // a job is considered as stared if its start time is less than Now + Time
   // Offset. The latter is to compensate for the time it takes to compute the 
@@ -249,6 +363,22 @@ private:
   // taken.
   
   std::chrono::milliseconds TimeOffset;
+  
+  // The total time spent on the scheduling is accumulated as a measure of the
+  // load this producer puts on the endpoint. It is read by the actor manager 
+  // from another thread and it is therefore atomic.
+  
+  std::atomic< std::chrono::milliseconds::rep > TotalSchedulingTime;
+  
+public:
+  
+  virtual std::chrono::milliseconds SchedulingTime( void ) const override
+  { 
+    return std::chrono::milliseconds( 
+			     TotalSchedulingTime.load( std::memory_order_relaxed ) );
+  }
+  
+private:
 
   // The actual scheduling is done in response to receiving a new load from 
   // a consumer. It will then first check if any of the assigned loads have 
@@ -260,6 +390,23 @@ protected:
   virtual void NewLoad( const Producer::ScheduleCommand & TheCommand, 
 												const Theron::Address TheConsumer  );
 
+  // The schedule computed for a command is stale when the next schedule 
+  // command arrives since that command will compute a new schedule for all 
+  // the loads not started. The search of the stale schedule is then cancelled
+  // so that the best start times found so far are used and the new command 
+  // is handled without waiting for the stale search to converge. The token is
+  // cancelled by the thread of the sender when the command is queued for the
+  // producer, and it is reset when the producer starts handling a command. 
+  // Commands arriving from remote endpoints are only seen as serialised 
+  // messages, and they do not cancel the search. The race of the algorithms
+  // is not cancelled since it is limited by its time budget.
+
+  Optimization::NonLinear::CancellationToken StaleSchedule;
+
+  virtual 
+  bool EnqueueMessage( const std::shared_ptr< GenericMessage > & TheMessage )
+  override;
+
   // A core issue with the scheduling is started jobs since their remaining 
   // energy consumption cannot be rescheduled (moved), and the job has to 
   // run to completion. This implies that its consumption from 'now' until 
@@ -315,6 +462,95 @@ public:
   
   double ObjectiveFunction( const std::vector< double > & ProposedStartTimes );
 
+  // The objective function is evaluated entirely in the producer's thread. 
+  // When the scheduling starts, the current prediction snapshot is obtained 
+  // from the predictor, and the energy, duration, and possibly the start time
+  // of the started and active loads are copied so that neither the predictor 
+  // nor the consumer proxies can change the data while the solver iterates.
+  // The load records are stored in the same order as the loads in the 
+  // corresponding vectors of loads above.
+  
+private:
+  
+  class LoadRecord
+  {
+  public:
+	  
+	  double Energy;
+	  Time   Duration, StartTime;
+	  
+	  LoadRecord( const Producer::ConsumerReference & TheConsumer );
+  };
+  
+  std::shared_ptr< const PredictionSnapshot > ProductionSnapshot;
+  std::vector< LoadRecord > StartedRecords, ActiveRecords;
+  
+  // The objective function sorts the activity periods of all the loads by 
+  // start time in order to find the consumption intervals in a single sweep.
+  // The activities are kept in a vector that is reused for all evaluations.
+  
+  class LoadActivity
+  {
+  public:
+	  
+	  Time   Start, Duration;
+	  double Energy;
+  };
+  
+  using ActivityVector = std::pmr::vector< LoadActivity >;
+  
+  ActivityVector Activities;
+
+  // The objective function is computed by a function that takes the vector 
+  // of activities and the prediction snapshot as arguments so that several 
+  // solvers can evaluate the objective function concurrently, each with its 
+  // own activities. The snapshot and the load records are only read and they
+  // can be shared by the solvers.
+  
+  double ScheduleValue( const std::vector< double > & ProposedStartTimes,
+											  ActivityVector & LoadActivities, 
+											  const PredictionSnapshot & Production ) const;
+
+  // The bounds of the start times and the activities of the racing solvers 
+  // are only needed while one schedule is computed. They are allocated from 
+  // a monotonic arena that only bumps a pointer, and the arena is released 
+  // when the schedule has been computed. The arena takes its buffers from a 
+  // pool that keeps them for the next schedule, so once the pool has grown 
+  // to the largest schedule seen, the scratch data of a schedule does not 
+  // allocate from the heap. The pool draws from the memory account of the 
+  // producers.
+  
+  using ScratchVector = std::pmr::vector< double >;
+  
+  std::pmr::unsynchronized_pool_resource SchedulingPool;
+  std::pmr::monotonic_buffer_resource    SchedulingArena;
+
+  // The evaluations of the schedule value are counted so that the effort of 
+  // the scheduling can be measured. The counter is atomic since the racing 
+  // solvers evaluate schedules concurrently.
+  
+  mutable std::atomic< unsigned long > Evaluations;
+  
+public:
+  
+  inline unsigned long ObjectiveEvaluations( void ) const
+  { return Evaluations.load( std::memory_order_relaxed ); }
+
+  // The scheduling is also exported as metrics labelled by the producer: The 
+  // number of schedules computed, the time taken to compute them, the 
+  // evaluations they used, and the number of start times changed for loads 
+  // that had already been given a start time, which measures how much the 
+  // consumers are disturbed by the rescheduling. The evaluations are added 
+  // to the exported counter after each schedule since the evaluation counter 
+  // above is updated by the solvers.
+  
+private:
+  
+  std::shared_ptr< Theron::MetricsExporter::Counter > 
+    Reschedules, SolverEvaluations, StartTimeChanges;
+  std::shared_ptr< Theron::MetricsExporter::Histogram > SchedulingLatency;
+  unsigned long ExportedEvaluations;
+
   // The search is governed by one accuracy parameter, and a limit on the 
   // number of iterations to do in order to find a good solution. These are 
   // set by the constructor.
@@ -324,16 +560,99 @@ private:
   double ObjectiveFunctionTolerance;
   int    EvaluationLimit;
 
+  // The start times can be found by different algorithms of the NLopt library
+  // through the non-linear optimizers of the Optimization library. The 
+  // algorithm is set per producer so that the algorithms can be compared on 
+  // the same load mix. The supported algorithms are the bound constrained 
+  // quadratic approximation (BOBYQA), which is the default, the linear 
+  // approximation (COBYLA), the subspace simplex (Subplex), the locally biased
+  // DIRECT-L, and the controlled random search (CRS). Note that the global 
+  // algorithms do not terminate on the objective function tolerance, and an 
+  // evaluation limit should be given when they are used.
+  
+  Optimization::NonLinear::Algorithm::ID SolverAlgorithm;
+
+  // The solver is called from a helper function that sets up the problem for 
+  // the given bounds and initial start times, and returns true if the start 
+  // times found can be used as a schedule. The objective value of the 
+  // solution is returned in the last argument.
+  
+  bool SolveSchedule( std::vector< double > & StartTimeValues, 
+										  const ScratchVector & LowerBounds, 
+										  const ScratchVector & UpperBounds, 
+										  double & ObjectiveValue );
+  
+  // The schedule is solved many times for a similar number of loads, and 
+  // creating the solver each time costs the allocation and registration of 
+  // the objective function, the bounds, the tolerance and the evaluation 
+  // limit. The solvers are therefore kept per algorithm and number of start 
+  // times, and a kept solver only updates the bounds and starts from the 
+  // given start times. The solvers also start their search with a step equal
+  // to how much the start times moved in the previous search of the same 
+  // dimension. The solver classes are defined with the solve function.
+  
+  class ScheduleSolverInterface;
+  
+  template< Optimization::NonLinear::Algorithm::ID SolverAlgorithm >
+  class ScheduleSolver;
+  
+  std::map< std::pair< Optimization::NonLinear::Algorithm::ID, std::size_t >,
+					  std::shared_ptr< ScheduleSolverInterface > > ScheduleSolvers;
+  
+  // Computing the full schedule for every new load may move the start times of
+  // all the loads not yet started, and each move must be sent to the 
+  // consumer of the load. In the incremental mode, a new load is first placed 
+  // against the fixed start times of the other loads, and this placement is 
+  // accepted if the objective value does not increase by more than the 
+  // rescheduling threshold. Otherwise, and when the prediction is updated, the
+  // full schedule is computed, but only the consumers whose start times 
+  // changed will receive their new start times.
+  
+  bool   IncrementalScheduling;
+  double ReschedulingThreshold;
+
+  // For difficult producer states with many overlapping loads and a partly 
+  // cloudy prediction no single algorithm will consistently find the best 
+  // schedule first. If a time budget is given for the schedule, the algorithm
+  // set for the producer is not used, and instead a portfolio of the BOBYQA, 
+  // DIRECT and the controlled random search algorithms race to find the 
+  // schedule. The race ends when the first algorithm converges or when the 
+  // time budget is exhausted, and the best schedule seen by any of the 
+  // algorithms is used. A zero time budget, which is the default, disables 
+  // the race.
+  
+  std::chrono::milliseconds RaceBudget;
+  
+  nlopt_result RaceSchedule( std::vector< double > & StartTimeValues, 
+													   const ScratchVector & LowerBounds, 
+													   const ScratchVector & UpperBounds, 
+													   double & ObjectiveValue );
+
   // ---------------------------------------------------------------------------
   // Constructor and destructor
   // ---------------------------------------------------------------------------
+  //
+  // The installed capacity is given if the predictions are normalised to one
+  // unit of capacity, as the PV categories are, and it is passed on to the 
+  // predictor. Producers with the same normalised forecast then share the 
+  // prediction tables, see the prediction registry. The knot tolerance is 
+  // also passed on, and a positive tolerance compresses the predictions.
 
 public:
   
   PVProducer( const IDType & ProducerID, 
 				      const std::string & PredictionFile, 
 				      double SolutionTolerance = 1e-8,
-				      int MaxEvaluations = std::numeric_limits< int >::max()  );
+				      int MaxEvaluations = std::numeric_limits< int >::max(),
+				      Optimization::NonLinear::Algorithm::ID Algorithm = 
+				        Optimization::NonLinear::Algorithm::Local::Approximation::Rescaling,
+				      bool Incremental = false, 
+				      double RescheduleThreshold = 0.0,
+				      std::chrono::milliseconds RacingBudget 
+								= std::chrono::milliseconds::zero(),
+				      double PredictionTolerance = 0.0,
+				      double InstalledCapacity = 1.0,
+				      double KnotTolerance = 0.0 );
   
   // The destructor does nothing since the automatic destruction will handle
   // the destruction of all objects owned by this PV producer. 
@@ -27,8 +27,11 @@
 #include <algorithm>
 #include <limits>
 #include <iterator>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <fstream>
 
-#include <gsl/gsl_roots.h> 				// For finding the equality of two functions.
 #include <gsl/gsl_errno.h> 				// For error messages from GSL
 
 #include "TimeInterval.hpp"       // To have CoSSMic time
@@ -36,6 +39,8 @@
 #include "Predictor.hpp"	      	// The class definition
 #include "ConsumerProxy.hpp"	  	// To interact with consumers
 #include "CSVtoTimeSeries.hpp"    // To parse CSV files
+#include "RollingHorizon.hpp"    // Trimming the prediction history
+#include "ProfilerAnnotations.hpp" // Optional profiler zones
 
 namespace CoSSMic {
 // -----------------------------------------------------------------------------
@@ -44,10 +49,9 @@ namespace CoSSMic {
 
 // The Predictor's contribution to the objective function is easily found in 
 // [2]. However, the prediction function and the integrated prediction are 
-// both interpolation objects and we must ensure that we are calling them with 
-// arguments within their ranges, which in this case is the same for both 
-// objects. In general the consumption interval could consist of three 
-// sub-intervals with respect to the domain for the interpolation functions:
+// only tabulated over the prediction domain and we must ensure that we are 
+// reading them at times within this domain. In general the consumption 
+// interval could consist of three sub-intervals with respect to the domain:
 //
 // 1) The interval preceding the start of the interpolation domain
 // 2) The part within the interpolation domain
@@ -92,145 +96,512 @@ namespace CoSSMic {
 // zero, and we can safely ignore the extended interval. 
 
 
+double PredictionSnapshot::Deficit( 
+			 const TimeInterval & ConsumptionInterval ) const
+{
+  // The predictor's contribution to the objective value is different from zero
+  // only if the prediction domain overlaps with the given consumption interval.
+  // The evaluation interval is then the intersection of the domain and the 
+  // given consumption interval.
+  
+  TimeInterval PredictionDomain( Domain() );
+  
+  if ( boost::numeric::overlap( ConsumptionInterval, PredictionDomain ) )
+  {
+    TimeInterval EvaluationInterval( 
+	    boost::numeric::intersect( ConsumptionInterval, PredictionDomain ) );
+
+    return CumulativeProduction( EvaluationInterval.lower() )
+				   * boost::numeric::width( EvaluationInterval )
+				   - ( IntegratedProduction( EvaluationInterval.upper() )
+					   - IntegratedProduction( EvaluationInterval.lower() ) );
+  }
+  else
+    return 0.0;
+}
+
+// The cumulative prediction is linear over a grid cell, and its value at a 
+// time in the domain is the linear interpolation of the values at the two grid
+// points of the cell. 
+
+double PredictionSnapshot::CumulativeProduction( Time t ) const
+{
+  const std::vector< double > & Cumulative( Grid->Cumulative );
+  
+  t = Clamp( t );
+  
+  std::size_t Index = Grid->Cell( t );
+  double      Slope = ( Cumulative[ Index + 1 ] - Cumulative[ Index ] ) 
+										  / Grid->CellWidth( Index );
+  
+  return Scale * ( Cumulative[ Index ] 
+								   + Slope * ( t - Grid->CellStart( Index ) ) );
+}
+
+// The integral over the part of the cell up to the time is then the area of 
+// the trapezoid under the linear cumulative prediction. Before the domain the
+// integral is zero as it is defined to be zero at the start of the domain, 
+// and after the domain the cumulative prediction keeps its last value.
+
+double PredictionSnapshot::IntegratedProduction( Time t ) const
+{
+  const std::vector< double > & Cumulative( Grid->Cumulative ),
+                              & Integrated( Grid->Integrated );
+  
+  if ( t > Grid->GridEnd )
+    return Scale * ( Integrated.back() 
+								     + Cumulative.back() * ( t - Grid->GridEnd ) );
+  
+  t = Clamp( t );
+  
+  std::size_t Index    = Grid->Cell( t );
+  double      Duration = t - Grid->CellStart( Index ),
+              Value    = CumulativeProduction( t );
+  
+  return Scale * Integrated[ Index ] 
+				 + 0.5 * ( Scale * Cumulative[ Index ] + Value ) * Duration;
+}
+
+// The message handler simply evaluates the current snapshot and returns the 
+// value to the sender.
+
 void Predictor::ComputeObjectiveValue( const TimeInterval & ConsumptionInterval, 
 																       const Theron::Address Sender )
 {
-  // The value to return is initialised, and we temporarily set the evaluation
-  // interval to the full domain to check if it overlaps with the consumption 
-  // interval
+  Send( GetSnapshot()->Deficit( ConsumptionInterval ), Sender );
+}
+
+// -----------------------------------------------------------------------------
+// Constructing the snapshot
+// -----------------------------------------------------------------------------
+//
+// The cumulative prediction is sampled on the grid, and since it is taken to 
+// be linear over each grid cell, the integral over a cell is the area of the 
+// trapezoid under the line, and the integral is accumulated from the start of
+// the domain. The running maximum of the cumulative prediction is kept for 
+// the binary search of the earliest end of a load. The grid has at least two 
+// points so that there is always one grid cell.
+
+void PredictionSnapshot::Tabulate( Tables & TheTables,
+																	 const Interpolation & ThePrediction, 
+																	 std::size_t FirstPoint )
+{
+  std::vector< double > & Cumulative( TheTables.Cumulative ),
+                        & Integrated( TheTables.Integrated ),
+                        & MonotoneCumulative( TheTables.MonotoneCumulative );
   
-  double Value = 0.0;
+  std::size_t GridPoints = 
+    static_cast< std::size_t >( ( TheTables.GridEnd - TheTables.GridOrigin 
+																  + TheTables.GridStep - 1 ) 
+																/ TheTables.GridStep ) + 1;
   
-  TimeInterval  
-    EvaluationInterval( Prediction.DomainLower(), Prediction.DomainUpper() );
+  Cumulative.resize( FirstPoint );
+  Integrated.resize( FirstPoint );
+  MonotoneCumulative.resize( FirstPoint );
   
-  // The predictor's contribution to the objective value is different from zero
-  // only if the prediction domain overlaps with the given consumption interval.
-  // The evaluation interval is then the intersection of the domain and the 
-  // given consumption interval.
+  Cumulative.reserve( GridPoints );
+  Integrated.reserve( GridPoints );
+  MonotoneCumulative.reserve( GridPoints );
+  
+  // The grid times are sorted, and the values are obtained by one batched
+  // evaluation of the prediction.
+
+  std::vector< double > GridTimes;
+
+  GridTimes.reserve( GridPoints - std::min( FirstPoint, GridPoints ) );
+
+  for ( std::size_t Index = FirstPoint; Index < GridPoints; Index++ )
+    GridTimes.push_back( std::max( ThePrediction.DomainLower(),
+			std::min( static_cast< double >( std::min( TheTables.CellStart( Index ), 
+																								 TheTables.GridEnd ) ),
+							  ThePrediction.DomainUpper() ) ) );
+
+  std::vector< double > GridValues = ThePrediction.Evaluate( GridTimes );
+
+  for ( std::size_t Index = FirstPoint; Index < GridPoints; Index++ )
+  {
+    double Value = GridValues[ Index - FirstPoint ];
+
+    if ( Index == 0 )
+    {
+      Integrated.push_back( 0.0 );
+      MonotoneCumulative.push_back( Value );
+    }
+    else
+    {
+      Integrated.push_back( Integrated.back() 
+				+ 0.5 * ( Cumulative.back() + Value ) * TheTables.CellWidth( Index - 1 ) );
+      MonotoneCumulative.push_back( std::max( MonotoneCumulative.back(), Value ) );
+    }
+    
+    Cumulative.push_back( Value );
+  }
+}
+
+PredictionSnapshot::PredictionSnapshot( const Interpolation & ThePrediction, 
+																			  Time Step )
+: Grid(), Scale( 1.0 )
+{
+  if ( Step <= 0 )
+  {
+    std::ostringstream ErrorMessage;
+    
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "The prediction grid step must be positive, and "
+								 << Step << " is not";
+								 
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+  
+  auto TheTables = std::make_shared< Tables >();
+  
+  TheTables->GridOrigin = 
+    static_cast< Time >( std::ceil( ThePrediction.DomainLower() ) );
+  TheTables->GridStep   = Step;
+  TheTables->GridEnd    = 
+    static_cast< Time >( std::floor( ThePrediction.DomainUpper() ) );
+  
+  if ( TheTables->GridEnd <= TheTables->GridOrigin ) 
+    TheTables->GridEnd = TheTables->GridOrigin + 1;
+  
+  Tabulate( *TheTables, ThePrediction, 0 );
+  
+  Grid = TheTables;
+}
+
+// The grid points of the previous snapshot can be reused if the grid has the 
+// same origin, and for the grid points before the start of the revision. The 
+// last grid point of the previous snapshot is not reused since it is the end 
+// of the previous domain, and not necessarily on the grid. Since the 
+// integral and the running maximum are accumulated from the start of the 
+// domain, the reused part of the tables remains valid.
+
+PredictionSnapshot::PredictionSnapshot( const PredictionSnapshot & Previous, 
+																			const Interpolation & ThePrediction, 
+																			  Time RevisionStart )
+: Grid(), Scale( 1.0 )
+{
+  const Tables & PreviousTables( *Previous.Grid );
+  auto TheTables = std::make_shared< Tables >();
+  
+  TheTables->GridOrigin = 
+    static_cast< Time >( std::ceil( ThePrediction.DomainLower() ) );
+  TheTables->GridStep   = PreviousTables.GridStep;
+  TheTables->GridEnd    = 
+    static_cast< Time >( std::floor( ThePrediction.DomainUpper() ) );
+  
+  if ( TheTables->GridEnd <= TheTables->GridOrigin ) 
+    TheTables->GridEnd = TheTables->GridOrigin + 1;
+  
+  std::size_t ValidPoints = 0;
+  
+  if ( TheTables->GridOrigin == PreviousTables.GridOrigin )
+  {
+    std::size_t PreviousPoints = PreviousTables.Cumulative.size() - 1;
+    
+    while ( ( ValidPoints < PreviousPoints ) && 
+					  ( TheTables->CellStart( ValidPoints ) < RevisionStart ) )
+      ValidPoints++;
     
-  if ( boost::numeric::overlap( ConsumptionInterval, EvaluationInterval ) )
+    TheTables->Cumulative.assign( PreviousTables.Cumulative.begin(), 
+										   PreviousTables.Cumulative.begin() + ValidPoints );
+    TheTables->Integrated.assign( PreviousTables.Integrated.begin(), 
+										   PreviousTables.Integrated.begin() + ValidPoints );
+    TheTables->MonotoneCumulative.assign( 
+			PreviousTables.MonotoneCumulative.begin(), 
+			PreviousTables.MonotoneCumulative.begin() + ValidPoints );
+  }
+  
+  Tabulate( *TheTables, ThePrediction, ValidPoints );
+  
+  Grid = TheTables;
+}
+
+// The scaled snapshot only copies the pointer to the tables
+
+PredictionSnapshot::PredictionSnapshot( const PredictionSnapshot & Other, 
+																			  double Factor )
+: Grid( Other.Grid ), Scale( Other.Scale * Factor )
+{
+  if ( !( Factor > 0.0 ) )
   {
-    EvaluationInterval = 
-	  boost::numeric::intersect( ConsumptionInterval, EvaluationInterval );
+    std::ostringstream ErrorMessage;
+    
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "The prediction scale factor must be positive, and "
+								 << Factor << " is not";
+								 
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+}
+
+// The deviation is the largest difference between the energy produced from 
+// the start of the interval by this snapshot and the other snapshot. It is 
+// evaluated at the end of the interval and at the grid points of this 
+// snapshot within the interval.
+
+double PredictionSnapshot::Deviation( const PredictionSnapshot & Other, 
+																		  const TimeInterval & Interval ) const
+{
+  Time   Start = Interval.lower();
+  double Base  = CumulativeProduction( Start ) 
+							   - Other.CumulativeProduction( Start ),
+         Largest = std::abs( CumulativeProduction( Interval.upper() ) 
+									   - Other.CumulativeProduction( Interval.upper() ) - Base );
+  
+  TimeInterval Overlap( Domain() );
+  
+  if ( boost::numeric::overlap( Interval, Overlap ) )
+  {
+    Overlap = boost::numeric::intersect( Interval, Overlap );
+    
+    for ( std::size_t Index = Grid->Cell( Overlap.lower() ); 
+					( Index < Grid->Cumulative.size() ) && 
+					( Grid->CellStart( Index ) <= Overlap.upper() ); Index++ )
+    {
+      Time GridTime = std::min( Grid->CellStart( Index ), Grid->GridEnd );
+      
+      if ( GridTime >= Start )
+        Largest = std::max( Largest, 
+								  std::abs( Scale * Grid->Cumulative[ Index ] 
+									- Other.CumulativeProduction( GridTime ) - Base ) );
+    }
+  }
+  
+  return Largest;
+}
+
+// -----------------------------------------------------------------------------
+// Prediction registry
+// -----------------------------------------------------------------------------
+//
+// The static members of the registry
+
+std::map< std::pair< std::string, std::size_t >, 
+				  std::weak_ptr< const PredictionRegistry::Samples > > 
+PredictionRegistry::Files;
+
+std::unordered_multimap< std::size_t, PredictionRegistry::Entry > 
+PredictionRegistry::Snapshots;
+
+std::mutex PredictionRegistry::Lock;
 
-    Value = Prediction( EvaluationInterval.lower() )
-				      * boost::numeric::width( EvaluationInterval )
-				      - ( IntegratedPrediction( EvaluationInterval.upper() )
-					  - IntegratedPrediction( EvaluationInterval.lower() ) );
+// The hash of the samples combines the hashes of the time stamps and the 
+// energy values in the order of the samples.
+
+std::size_t PredictionRegistry::Hash( const Samples & Series )
+{
+  std::size_t Value = Series.size();
+  
+  for ( const auto & Sample : Series )
+  {
+    Value ^= std::hash< Time >()( Sample.first ) 
+						 + 0x9e3779b97f4a7c15ULL + ( Value << 6 ) + ( Value >> 2 );
+    Value ^= std::hash< double >()( Sample.second ) 
+						 + 0x9e3779b97f4a7c15ULL + ( Value << 6 ) + ( Value >> 2 );
   }
   
-  Send( Value, Sender);
+  return Value;
 }
 
-// Computing the time root is just to find when the Prediction equals the given
-// total load consumption. This is an ideal job for the GNU Scientific Library.
-// The function to evaluate is a problem since the GSL only allows function 
-// pointers, and lambdas that capture cannot be assigned to pure function 
-// pointers. The solution is to use the parameter pointer allowed by the
-// function and a structure containing a pointer and a value.
+// Expired entries are removed with the lock held
 
-struct RootFunctionParameters
-{ 
-  Interpolation * ThePrediction;
-  double          LoadConsumption;
-};
+void PredictionRegistry::RemoveExpired( void )
+{
+  for ( auto Entry = Snapshots.begin(); Entry != Snapshots.end(); )
+    if ( Entry->second.Snapshot.expired() )
+      Entry = Snapshots.erase( Entry );
+    else
+      ++Entry;
+  
+  for ( auto File = Files.begin(); File != Files.end(); )
+    if ( File->second.expired() )
+      File = Files.erase( File );
+    else
+      ++File;
+}
 
-double EnergyDifferenceFunction( double t, void * Parameters )
+// The file is read to compute the hash of its content, and it is parsed only
+// if the same content has not already been parsed under the same name. The 
+// file is parsed without holding the lock, and if another predictor parsed 
+// the same file in the meantime its series is used.
+
+std::shared_ptr< const PredictionRegistry::Samples > 
+PredictionRegistry::Series( const std::string & FileName )
 {
-  RootFunctionParameters * FunctionTerms = 
-							      reinterpret_cast< RootFunctionParameters * >( Parameters );
-		     
-  return ( FunctionTerms->ThePrediction->operator()(t) 
-			     - FunctionTerms->LoadConsumption );
-};
+  std::ifstream File( FileName, std::ios::binary );
+  
+  if ( !File )
+  {
+    std::ostringstream ErrorMessage;
+    
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "The prediction file " << FileName 
+								 << " could not be read";
+								 
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+  
+  std::string Content( ( std::istreambuf_iterator< char >( File ) ), 
+										     std::istreambuf_iterator< char >() );
+  
+  const auto Key = std::make_pair( FileName, 
+																   std::hash< std::string >()( Content ) );
+  
+  {
+    std::lock_guard< std::mutex > Guard( Lock );
+    
+    auto Known = Files.find( Key );
+    
+    if ( Known != Files.end() )
+      if ( auto Parsed = Known->second.lock() )
+        return Parsed;
+  }
+  
+  auto Parsed = std::make_shared< const Samples >( 
+								CSVtoTimeSeries( FileName ) );
+  
+  std::lock_guard< std::mutex > Guard( Lock );
+  
+  std::weak_ptr< const Samples > & Known( Files[ Key ] );
+  
+  if ( auto Other = Known.lock() )
+    return Other;
+  
+  Known = Parsed;
+  
+  return Parsed;
+}
 
+// The snapshot is looked up among the entries with the same hash, and it is
+// tabulated without holding the lock if it is not found. 
+
+std::shared_ptr< const PredictionSnapshot > 
+PredictionRegistry::Snapshot( const Samples & Series, 
+	const std::function< std::shared_ptr< const PredictionSnapshot >( void ) > & 
+	Tabulate )
+{
+  const std::size_t Key = Hash( Series );
+  
+  auto Find = [&](void)->std::shared_ptr< const PredictionSnapshot >{
+    auto Candidates = Snapshots.equal_range( Key );
+    
+    for ( auto Entry = Candidates.first; Entry != Candidates.second; ++Entry )
+      if ( *Entry->second.Series == Series )
+        if ( auto Shared = Entry->second.Snapshot.lock() )
+          return Shared;
+        
+    return std::shared_ptr< const PredictionSnapshot >();
+  };
+  
+  {
+    std::lock_guard< std::mutex > Guard( Lock );
+    
+    if ( auto Shared = Find() )
+      return Shared;
+  }
+  
+  std::shared_ptr< const PredictionSnapshot > Tabulated( Tabulate() );
+  
+  std::lock_guard< std::mutex > Guard( Lock );
+  
+  if ( auto Shared = Find() )
+    return Shared;
+  
+  RemoveExpired();
+  
+  Snapshots.emplace( Key, Entry{ std::make_shared< const Samples >( Series ), 
+																 Tabulated } );
+  
+  return Tabulated;
+}
+
+std::size_t PredictionRegistry::size( void )
+{
+  std::lock_guard< std::mutex > Guard( Lock );
+  
+  return std::count_if( Snapshots.begin(), Snapshots.end(), 
+    []( const auto & Entry ){ return !Entry.second.Snapshot.expired(); } );
+}
+
+// The predictor publishes the shared tables scaled by its capacity
+
+void Predictor::Publish( 
+	const std::shared_ptr< const PredictionSnapshot > & Shared )
+{
+  std::atomic_store( &Snapshot, std::shared_ptr< const PredictionSnapshot >( 
+		std::make_shared< PredictionSnapshot >( *Shared, Capacity ) ));
+}
+
+// -----------------------------------------------------------------------------
+// Earliest end of a single load
+// -----------------------------------------------------------------------------
+//
+// The problem is to find the earliest time T > Start when the energy produced
+// since the start equals the energy of the load. Let the energy produced until 
+// time t be P(t), then this is the time when
+//		P(T) - P(Start) >= Energy
+// and since P(Start) is a constant, it is easier to search for the time when
+//		P(T) >= ( Energy + P(Start) )
+// The first grid point whose running maximum reaches this level is found by a
+// binary search, and the time T is then in the grid cell ending at this grid
+// point. Since P(t) is linear over the cell, T is found by inverting the 
+// line, and it is rounded up to the next whole second and to the start time. 
+
+std::optional< Time > 
+PredictionSnapshot::EarliestEnd( double Energy, Time Start ) const
+{
+  const std::vector< double > & MonotoneCumulative( Grid->MonotoneCumulative );
+  
+  // The search is done in the units of the tables
+  
+  double RequiredEnergy = ( Energy + CumulativeProduction( Start ) ) / Scale;
+  
+  // There is no solution if the prediction does not cover the energy needed, 
+  // which is the case if there will be no further production in the 
+  // prediction horizon.
+  
+  if ( !( MonotoneCumulative.back() > RequiredEnergy ) )
+    return std::optional< Time >();
+  
+  auto GridPoint = std::lower_bound( MonotoneCumulative.begin(), 
+																	   MonotoneCumulative.end(), RequiredEnergy );
+  std::size_t Index = std::distance( MonotoneCumulative.begin(), GridPoint );
+  
+  if ( Index == 0 )
+    return std::max( Grid->GridOrigin, Start );
+  
+  // The cell starts at the previous grid point, where the energy is 
+  // insufficient, and the energy increases over the cell since the running 
+  // maximum increases.
+  
+  Index--;
+  
+  double Fraction = ( RequiredEnergy - MonotoneCumulative[ Index ] ) 
+									  / ( MonotoneCumulative[ Index + 1 ] 
+											  - MonotoneCumulative[ Index ] );
+  
+  Time EndTime = Grid->CellStart( Index ) + 
+    static_cast< Time >( std::ceil( Fraction * Grid->CellWidth( Index ) ) );
+  
+  return std::max( EndTime, Start );
+}
+
+// The message handler returns the earliest end found on the current snapshot 
+// for a load starting now.
 
 void Predictor::FindTimeRoot( const double & TotalLoadConsumption, 
 												      const Theron::Address SingleScheduler   )
 {
-  // The parameters define the function for the solver to use. The prediction
-  // is a continuous function giving the cumulative energy produced. The solver
-  // is searching for the time when the amount of produced energy is at least 
-  // as large as the energy required by the load, starting from the current 
-  // time. Let the energy produced until time t >= now be P(t). Then the solver
-  // will find a time T > now such that 
-  // 		P(T) - P(now) >= total load consumption
-  // as this is the earliest time the load can finish. Since the last term on
-  // the left hand side and the right hand side are both constants, it is easier
-  // to solve 
-  //		P(T) >= ( total load consumption + P(now) )
-  
-  RootFunctionParameters TheFunctionTerms;
-  Time 			 						 now = Now();
-  
-  TheFunctionTerms.LoadConsumption = TotalLoadConsumption + Prediction( now );
-  TheFunctionTerms.ThePrediction   = &Prediction;  
- 
-	// However, it could be that this problem has no solution. The simplest case
-	// occur when there will be no further production of PV power under the 
-	// prediction horizon. In this case, P(t) will equal P(now) for all known 
-	// time stamps. 
-	
-	if ( Prediction( Prediction.DomainUpper() ) 
-																						> TheFunctionTerms.LoadConsumption )
-	{
-		// Problem makes sense and the solver structure and type must be allocated
-	  
-	  gsl_root_fsolver *Solver = gsl_root_fsolver_alloc( gsl_root_fsolver_brent );
-	  
-	  // This is is provided to the GSL solver in its parameter structure together 
-	  // with a pointer to the difference function to invoke to find the zero.
-	  
-	  gsl_function Energy;
-	  Energy.function = &EnergyDifferenceFunction ;
-	  Energy.params   = &TheFunctionTerms;
-	  
-	  // Then we bind the solver and the function, and frame the solution space
-	  // to the limits of the future prediction domain
-	  
-	  gsl_root_fsolver_set( Solver, &Energy, now, Prediction.DomainUpper() );
-	  
-	  // We have to iterate the solver until it has converged or the maximum number
-	  // of iterations are exceeded. 
-	  
-	  int IterationCounter = 0,
-	      Status;
-	  
-	  do
-	  {
-	    IterationCounter++;
-	    gsl_root_fsolver_iterate( Solver );
-	    Status = gsl_root_test_interval( gsl_root_fsolver_x_lower( Solver ),
-					     gsl_root_fsolver_x_upper( Solver ),
-					     0, 0.001 );
-	  }
-	  while ( (Status == GSL_CONTINUE) && (IterationCounter < 1000) );
-	  
-	  // Then the solution is verified and returned. Note that we do not return 
-	  // the root, but the upper limit of the framed root since we are only 
-	  // interested in the time point when there is sufficient energy. Since the 
-	  // solver functions returns double values, and we want the ceiling value 
-	  // as an integer, we have to add 0.5 before the resulting value is truncated
-	  // by the cast operation.
-	  
-	  Time Solution = 
-			   static_cast< Time >( gsl_root_fsolver_x_upper( Solver ) + 0.5 );
-	  
-	  if ( Prediction( Solution ) >= TotalLoadConsumption )
-	    Send( Producer::AssignedStartTime( Solution ), SingleScheduler );
-	  else
-	    Send( Producer::AssignedStartTime(), SingleScheduler );
-	  
-	  // Finally we clean up by removing the solver structure.
-	  
-	  gsl_root_fsolver_free( Solver );
-	}
-	else // Problem did not make sense.
-		Send( Producer::AssignedStartTime(), SingleScheduler );
+  std::optional< Time > 
+  EarliestEnd( GetSnapshot()->EarliestEnd( TotalLoadConsumption, Now() ) );
+  
+  if ( EarliestEnd )
+    Send( Producer::AssignedStartTime( EarliestEnd.value() ), SingleScheduler );
+  else
+    Send( Producer::AssignedStartTime(), SingleScheduler );
 }
 
-
 // -----------------------------------------------------------------------------
 // Updating the prediction origin
 // -----------------------------------------------------------------------------
@@ -252,14 +623,20 @@ void Predictor::SetPredictionOrigin( const Time & MinStartTime,
 // -----------------------------------------------------------------------------
 // Update the prediction profile
 // -----------------------------------------------------------------------------
-// The update handler uses the CSV parser to convert the file into the time series
-// and sets the interpolation objects to new values.
+// The update handler obtains the time series of the file from the registry, 
+// which parses the file only if no other predictor has already parsed it, and
+// sets the interpolation objects to new values. The series is copied since 
+// it is adjusted to the current prediction of this predictor.
 
 void Predictor::UpdatePrediction( 
      const std::string & TheFilename, 
      const Theron::Address TheProducer )
 {
-  std::map< Time, double > TimeSeries( CSVtoTimeSeries( TheFilename ) );
+  THERON_PROFILE_ZONE_DETAIL( "Predictor::UpdatePrediction", 
+                              GetAddress().AsString() + " " + TheFilename );
+  
+  std::map< Time, double > TimeSeries( 
+												   *PredictionRegistry::Series( TheFilename ) );
 
   // The time series provides the predicted energy generated by this producer 
   // from the start of the series. This implies that the first time stamp in 
@@ -396,39 +773,24 @@ void Predictor::UpdatePrediction(
     TimeSeries.insert( std::make_pair( SampleTime, Prediction( SampleTime ) ) );
   }
   
-  // Computing the new interpolation object is trivial using its constructor
-  // for maps.
+  // The padded series is compressed if a tolerance is given, and computing 
+  // the new interpolation object is then trivial using its constructor for 
+  // maps.
   
-  Prediction = Interpolation( TimeSeries );
-  
-  // Integrating this is done in parts producing the integral from one time 
-  // point to the next, and then interpolating over this new time series. It 
-  // should be noted that by definition the integral value at the first time 
-  // stamp is zero. We always integrate from zero to let the integration 
-  // algorithm cope with the interpolation method.
-
-  // For now integration is done successively between two adjacent time stamps
-  // of the time series, this may be less accurate than always integrating from 
-  // the start, but the interpolating polynomial should be smooth and thus 
-  // up to a small numerical error we should have the same result as if we had
-  // integrated from the start of the time series every time.
-  
-  std::map< Time, double > IntegratedValues;
+  if ( CompressionTolerance > 0.0 )
+    CompressSamples( TimeSeries, CompressionTolerance );
   
-  SampleTime 	 	 = TimeSeries.begin()->first;   // Time of first sample
-  double IntegratedValue = 0.0;				// Total until time
-  
-  for ( auto & PredictionPoint : TimeSeries )
-  {
-    IntegratedValue += Integral(Prediction, SampleTime, PredictionPoint.first);
-    IntegratedValues.emplace( PredictionPoint.first, IntegratedValue );
-    SampleTime = PredictionPoint.first;
-  }
+  Prediction = Interpolation( TimeSeries );
   
-  // Finally we can interpolate this integrated series to enable fast access to
-  // the integral values.
+  // The new prediction is published as a snapshot before the schedule is 
+  // recomputed so that the producer will schedule against this prediction.
+  // The snapshot tabulates the prediction and its integral on the grid, and 
+  // the integral is therefore not computed from the interpolation. The 
+  // tables are only tabulated if no other predictor has the same samples.
   
-  IntegratedPrediction = Interpolation( IntegratedValues );
+  Publish( PredictionRegistry::Snapshot( TimeSeries, [this](void){
+    return std::shared_ptr< const PredictionSnapshot >( 
+			std::make_shared< PredictionSnapshot >( Prediction ) ); }) );
   
   // Then the scheduler is called upon to compute the new schedule for the 
   // updated prediction. This is triggered by sending a zero-energy load to 
@@ -441,6 +803,240 @@ void Predictor::UpdatePrediction(
   Send( Producer::ScheduleCommand( 
 			  TimeSeries.begin()->first, std::prev( TimeSeries.end() )->first, 
 				0, 0.0 ), TheProducer );
+  
+  // The samples are kept for merging revisions of this prediction
+  
+  PredictionSamples.swap( TimeSeries );
+}
+
+// -----------------------------------------------------------------------------
+// Revise the prediction
+// -----------------------------------------------------------------------------
+// A revision replaces the samples of the current prediction within the time 
+// range of the revision, or it is appended if it starts after the current 
+// prediction. The revision's energy values are re-based to the energy of the 
+// current prediction at the start of the revision, and the samples after the 
+// revision, if any, are shifted by the change of the energy at the end of the
+// revision so that the prediction remains cumulative. The current prediction
+// keeps its first value before its domain and its last value after its domain.
+//
+// The interpolation over the interval between two samples depends on the 
+// neighbouring samples for the monotone interpolation of Steffen's method. The
+// prediction is therefore changed from the second sample before the revision,
+// and until the second sample after the revision unless the following samples
+// were shifted. Only this part of the grid must be sampled again, and the new
+// snapshot reuses the tables of the current snapshot before the change.
+
+void Predictor::RevisePrediction( const PredictionRevision & TheRevision, 
+																  const Theron::Address TheProducer )
+{
+  std::map< Time, double > Revision;
+  
+  if ( !TheRevision.RevisionFile.empty() )
+    Revision = CSVtoTimeSeries( TheRevision.RevisionFile );
+  
+  for ( auto & Sample : TheRevision.Samples )
+    Revision[ Sample.first ] = Sample.second;
+  
+  if ( Revision.empty() || PredictionSamples.empty() ) return;
+  
+  if ( Revision.begin()->second > 0.0 )
+  {
+		double FirstEnergyValue = Revision.begin()->second;
+		
+		for ( auto & TimeStamp : Revision )
+			TimeStamp.second -= FirstEnergyValue;
+	}
+  
+  auto CurrentEnergy = [this]( Time t )->double{
+    if ( t <= PredictionSamples.begin()->first )
+      return PredictionSamples.begin()->second;
+    else if ( t >= PredictionSamples.rbegin()->first )
+      return PredictionSamples.rbegin()->second;
+    else
+      return Prediction( t );
+  };
+  
+  Time   RevisionStart = Revision.begin()->first,
+         RevisionEnd   = Revision.rbegin()->first;
+  double StartEnergy   = CurrentEnergy( RevisionStart ),
+         EndShift      = Revision.rbegin()->second + StartEnergy 
+										     - CurrentEnergy( RevisionEnd );
+  
+  for ( auto & TimeStamp : Revision )
+    TimeStamp.second += StartEnergy;
+  
+  // The revised samples replace the current samples in the range of the 
+  // revision, and the later samples are shifted. 
+  
+  auto Following = PredictionSamples.upper_bound( RevisionEnd );
+  
+  for ( auto Sample = Following; Sample != PredictionSamples.end(); ++Sample )
+    Sample->second += EndShift;
+  
+  PredictionSamples.erase( PredictionSamples.lower_bound( RevisionStart ), 
+													 Following );
+  PredictionSamples.insert( Revision.begin(), Revision.end() );
+  
+  // The history is trimmed with respect to the earliest of now, the origin
+  // of the prediction and the start of the revision, so that neither the 
+  // running loads nor the revision lose their samples.
+  
+  bool Trimmed = TrimHistory( 
+		std::min( { Now(), PredictionOrigin, RevisionStart } ) );
+  
+  // The changed part of the prediction is then found from the neighbouring 
+  // samples of the revision, and it starts with the first sample if the 
+  // history was trimmed since the domain of the prediction has changed.
+  
+  auto ChangeStart = PredictionSamples.find( RevisionStart ),
+       ChangeEnd   = PredictionSamples.find( RevisionEnd );
+  
+  if ( Trimmed )
+    ChangeStart = PredictionSamples.begin();
+  else
+    for ( int i = 0; 
+				  ( i < 2 ) && ( ChangeStart != PredictionSamples.begin() ); i++ )
+      --ChangeStart;
+  
+  if ( EndShift != 0.0 )
+    ChangeEnd = std::prev( PredictionSamples.end() );
+  else
+    for ( int i = 0; 
+				  ( i < 2 ) && ( std::next( ChangeEnd ) != PredictionSamples.end() ); 
+				  i++ )
+      ++ChangeEnd;
+  
+  // The new interpolation and the new snapshot can then be created and 
+  // published before the producer is informed about the revision. The 
+  // revised tables are also shared through the registry since the other 
+  // predictors of the same forecast are likely to receive the same revision.
+  
+  Prediction = Interpolation( PredictionSamples );
+  
+  const Time RevisedFrom = ChangeStart->first;
+  
+  Publish( PredictionRegistry::Snapshot( PredictionSamples, [&,this](void){
+    if ( Trimmed )
+      return std::shared_ptr< const PredictionSnapshot >( 
+				std::make_shared< PredictionSnapshot >( Prediction ) );
+    else
+      return std::shared_ptr< const PredictionSnapshot >( 
+				std::make_shared< PredictionSnapshot >( *GetSnapshot(), Prediction, 
+																								RevisedFrom ) ); }) );
+  
+  PredictionRevised Revised;
+  
+  Revised.Domain   = TimeInterval( PredictionSamples.begin()->first, 
+													       PredictionSamples.rbegin()->first );
+  Revised.Revision = TimeInterval( ChangeStart->first, ChangeEnd->first );
+  
+  Send( Revised, TheProducer );
+}
+
+// -----------------------------------------------------------------------------
+// Compressing the prediction
+// -----------------------------------------------------------------------------
+// The knots are selected greedily: From the last kept knot, the segment is 
+// extended sample by sample for as long as all the samples it covers are 
+// within the tolerance of the straight line from the kept knot to the end of 
+// the segment. When the next sample would violate the tolerance, the end of 
+// the segment is kept as the next knot. Each extension tests the samples of 
+// the segment again, but the segments are short except for the flat runs 
+// where the test is trivially satisfied, and the compression is done once 
+// per prediction update. Note that the error is measured against the chord 
+// between the knots, and that the monotone interpolation between the knots 
+// stays within the range of the knot values and is exact for flat runs.
+
+void Predictor::CompressSamples( std::map< Time, double > & Samples, 
+																 double Tolerance )
+{
+  if ( Samples.size() < 4 ) return;
+  
+  std::vector< std::pair< Time, double > > 
+    Series( Samples.begin(), Samples.end() ), Knots;
+  
+  auto WithinTolerance = [&]( std::size_t First, std::size_t Last )->bool{
+    const double Slope = ( Series[ Last ].second - Series[ First ].second )
+							/ static_cast< double >( Series[ Last ].first - Series[ First ].first );
+    
+    for ( std::size_t i = First + 1; i < Last; i++ )
+      if ( std::fabs( Series[ First ].second 
+				+ Slope * static_cast< double >( Series[ i ].first - Series[ First ].first ) 
+				- Series[ i ].second ) > Tolerance )
+				return false;
+      
+    return true;
+  };
+  
+  std::size_t Anchor = 0;
+  
+  Knots.push_back( Series.front() );
+  
+  for ( std::size_t End = 2; End < Series.size(); End++ )
+    if ( !WithinTolerance( Anchor, End ) )
+    {
+      Anchor = End - 1;
+      Knots.push_back( Series[ Anchor ] );
+    }
+  
+  Knots.push_back( Series.back() );
+  
+  if ( ( Knots.size() >= 3 ) && ( Knots.size() < Series.size() ) )
+    Samples = std::map< Time, double >( Knots.begin(), Knots.end() );
+}
+
+// -----------------------------------------------------------------------------
+// Rolling horizon
+// -----------------------------------------------------------------------------
+// The last sample at or before the horizon boundary is kept, and all samples 
+// before it are removed. Nothing is removed if the horizon is not set or if 
+// the first sample is the last one before the boundary.
+
+bool Predictor::TrimHistory( Time Boundary )
+{
+  if ( !RollingHorizon::Enabled() || PredictionSamples.empty() ) 
+    return false;
+  
+  auto Kept = PredictionSamples.upper_bound( Boundary - RollingHorizon::Get() );
+  
+  if ( ( Kept == PredictionSamples.begin() ) || 
+       ( --Kept == PredictionSamples.begin() ) )
+    return false;
+  
+  PredictionSamples.erase( PredictionSamples.begin(), Kept );
+  
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// Checkpoint
+// -----------------------------------------------------------------------------
+// The samples are written with the full precision of the energy values in the
+// same two column format as the prediction files. They are written as they 
+// are kept, i.e. normalised if the predictor has a capacity, and the same 
+// capacity must therefore be given when the checkpoint is restored. If the 
+// predictions are given in relative time, the samples are written relative 
+// to the current time since they will be read back as a new prediction at 
+// the time of the checkpoint.
+
+void Predictor::SaveCheckpoint( const Checkpoint & TheCheckpoint, 
+															  const Theron::Address TheActorManager )
+{
+  std::ofstream PredictionFile( TheCheckpoint.SubDirectory( "Predictions" ) + 
+																"/" + TheProducer.AsString() + ".csv" );
+  
+  PredictionFile.precision( std::numeric_limits<double>::digits10 );
+  
+  #ifdef RELATIVE_PREDICTION
+    const Time TimeOrigin = Now();
+  #else
+    const Time TimeOrigin = 0;
+  #endif
+  
+  for ( auto & Sample : PredictionSamples )
+    PredictionFile << Sample.first - TimeOrigin << " " << Sample.second 
+								   << std::endl;
 }
 
 // -----------------------------------------------------------------------------
@@ -451,15 +1047,41 @@ void Predictor::UpdatePrediction(
 
 Predictor::Predictor( const std::string & PredictionFile,
 								      const Theron::Address & ProducerAddress,
-								      const std::string & ActorName )
+								      const std::string & ActorName, 
+								      double InstalledCapacity, double KnotTolerance )
 : Actor( ActorName ),
   StandardFallbackHandler( GetAddress().AsString() ),
-  Prediction(), IntegratedPrediction(), TheProducer( ProducerAddress )
+  Prediction(), PredictionSamples(), Snapshot(), Capacity( InstalledCapacity ),
+  TheProducer( ProducerAddress ), CompressionTolerance( KnotTolerance )
 {
+  if ( !( Capacity > 0.0 ) )
+  {
+    std::ostringstream ErrorMessage;
+    
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "The installed capacity of the producer must be "
+								 << "positive, and " << Capacity << " is not";
+								 
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+  
+  if ( CompressionTolerance < 0.0 )
+  {
+    std::ostringstream ErrorMessage;
+    
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "The compression tolerance of the prediction cannot "
+								 << "be negative, and " << CompressionTolerance << " is";
+								 
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+  
   RegisterHandler(this, &Predictor::ComputeObjectiveValue );
   RegisterHandler(this, &Predictor::FindTimeRoot 	  );
   RegisterHandler(this, &Predictor::UpdatePrediction      );
+  RegisterHandler(this, &Predictor::RevisePrediction      );
   RegisterHandler(this, &Predictor::SetPredictionOrigin   );
+  RegisterHandler(this, &Predictor::SaveCheckpoint        );
 	
   // The prediction origin is initialised to the maximal possible value in 
   // order to prevent the addition of a non-existing history on the first 
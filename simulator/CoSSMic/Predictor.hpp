@@ -39,6 +39,15 @@
 
 #include <memory>
 #include <list>
+#include <atomic>
+#include <map>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <string>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
 
 #include "Actor.hpp"
 #include "StandardFallbackHandler.hpp"
@@ -54,16 +63,324 @@
 
 namespace CoSSMic {
 
+// -----------------------------------------------------------------------------
+// Prediction snapshot
+// -----------------------------------------------------------------------------
+// The scheduling solver evaluates the objective function many times for one 
+// schedule, and the prediction must stay the same for all these evaluations 
+// even if a new prediction arrives at the predictor in the meantime. The 
+// predictor therefore publishes a snapshot of the prediction every time the 
+// prediction is updated. A snapshot is never changed after it has been 
+// published, and the producers can evaluate the prediction's part of the 
+// objective function directly on the snapshot from their own threads without
+// sending a message to the predictor and waiting for the response.
+//
+// The snapshot is a flat table of the cumulative prediction sampled on a 
+// uniform time grid over the prediction domain, and the cumulative 
+// prediction is taken to be linear between two grid points. The integral of 
+// the cumulative prediction is then exactly quadratic between the grid 
+// points, and it is tabulated at the grid points when the snapshot is created.
+// The value at any time is found in constant time from the grid cell 
+// containing the time, without evaluating the interpolation of the 
+// prediction. The tables are only read after construction, and a snapshot can 
+// therefore be shared by any number of threads.
+//
+// Many producers may have the same forecast, for instance the households of
+// one street sharing a PV category normalised to the installed capacity. The
+// tables are therefore held by a shared pointer, and a snapshot is a view of 
+// the tables multiplied by a scale factor. Snapshots of producers with 
+// different capacities can then share the same tables.
+
+class PredictionSnapshot
+{
+public:
+	
+	// The default grid step is one minute, which is much shorter than the 
+	// sampling period of typical predictions.
+	
+	static constexpr Time DefaultGridStep = 60;
+	
+private:
+	
+	class Tables
+	{
+	public:
+		
+		// The grid starts at the lower bound of the prediction domain and the 
+		// last grid point is the upper bound of the domain, so the last grid 
+		// cell may be shorter than the step.
+		
+		Time GridOrigin, GridStep, GridEnd;
+		
+		// The cumulative prediction and its integral are stored for each grid 
+		// point. The cumulative prediction should be non-decreasing, but the 
+		// samples may be slightly decreasing because of numerical noise in the 
+		// prediction, and the running maximum is therefore also stored so that 
+		// the time when a given energy has been produced can be found by a 
+		// binary search.
+		
+		std::vector< double > Cumulative, Integrated, MonotoneCumulative;
+		
+		// The grid cell containing a time is found by a small helper function 
+		// that returns the index of the grid point starting the cell and the 
+		// offset of the time within the cell. The time must be in the domain.
+		
+		inline std::size_t Cell( Time t ) const
+		{
+			return std::min( static_cast< std::size_t >( ( t - GridOrigin ) / GridStep ),
+											 Cumulative.size() - 2 );
+		}
+		
+		inline Time CellStart( std::size_t Index ) const
+		{ return GridOrigin + static_cast< Time >( Index ) * GridStep; }
+		
+		inline Time CellWidth( std::size_t Index ) const
+		{ return std::min( GridEnd, CellStart( Index + 1 ) ) - CellStart( Index ); }
+	};
+	
+	std::shared_ptr< const Tables > Grid;
+	double                          Scale;
+	
+	// The time is clamped to the domain since the cumulative prediction keeps 
+	// its first value before the domain and its last value after the domain.
+	
+	inline Time Clamp( Time t ) const
+	{ return std::max( Grid->GridOrigin, std::min( t, Grid->GridEnd ) ); }
+	
+public:
+	
+	// The domain of the prediction is given as a time interval
+	
+	inline TimeInterval Domain( void ) const
+	{ return TimeInterval( Grid->GridOrigin, Grid->GridEnd ); }
+	
+	// The scale factor applies to all values read from the tables, and two 
+	// snapshots may share the same tables with different scale factors.
+	
+	inline double ScaleFactor( void ) const
+	{ return Scale; }
+	
+	inline bool SharesTables( const PredictionSnapshot & Other ) const
+	{ return Grid == Other.Grid; }
+	
+	// The cumulative prediction and its integral can be read at any time
+	
+	double CumulativeProduction( Time t ) const;
+	double IntegratedProduction( Time t ) const;
+	
+	// The energy produced over an interval is the difference of the cumulative
+	// prediction at the interval limits, and it is zero outside the domain.
+	
+	inline double Production( const TimeInterval & Interval ) const
+	{ 
+		return CumulativeProduction( Interval.upper() ) 
+					 - CumulativeProduction( Interval.lower() );
+	}
+	
+	// The contribution of the prediction to the objective function for a given 
+	// consumption interval is the deficit of the production over the interval
+	// compared with the production being available at the start of the 
+	// interval, see the explanation in the source file.
+	
+	double Deficit( const TimeInterval & ConsumptionInterval ) const;
+	
+	// The earliest time a load of the given energy can finish if it starts at 
+	// the given time is the first whole second when the predicted production 
+	// since the start equals the energy of the load. The grid cell containing
+	// this time is found by a binary search in the running maximum of the 
+	// cumulative prediction, and the time is then found by inverting the 
+	// linear prediction over the cell. No time is returned if the prediction 
+	// does not cover the energy.
+	
+	std::optional< Time > EarliestEnd( double Energy, Time Start ) const;
+	
+	// A revised prediction may change the cumulative prediction only over 
+	// parts of the domain, and the largest change of the energy produced 
+	// since the start of a given interval, compared with another snapshot, is 
+	// found over the grid points of this snapshot within the interval.
+	
+	double Deviation( const PredictionSnapshot & Other, 
+										const TimeInterval & Interval ) const;
+	
+private:
+	
+	// The grid is sampled from the given interpolation by a helper function 
+	// starting from the given grid point, assuming that the tables are valid
+	// for all grid points before this point. The tables are filled before 
+	// they are shared.
+	
+	static void Tabulate( Tables & TheTables, 
+												const Interpolation & ThePrediction, 
+												std::size_t FirstPoint );
+	
+public:
+	
+	// The constructor samples the given interpolation of the cumulative 
+	// prediction on the grid, and it is therefore safe to give the predictor's
+	// current prediction as argument. An invalid argument exception is thrown
+	// if the grid step is not positive. The scale factor is one.
+	
+	PredictionSnapshot( const Interpolation & ThePrediction, 
+											Time Step = DefaultGridStep );
+	
+	// When the prediction has been revised from a given time, the tables of the 
+	// previous snapshot are copied for the grid points before this time, and 
+	// only the remaining grid points are sampled from the revised prediction.
+	// The new tables are not scaled even if the previous snapshot was.
+	
+	PredictionSnapshot( const PredictionSnapshot & Previous, 
+											const Interpolation & ThePrediction, Time RevisionStart );
+	
+	// A scaled snapshot shares the tables of another snapshot, and its scale 
+	// factor is the product of the given factor and the factor of the other
+	// snapshot. An invalid argument exception is thrown if the factor is not
+	// positive.
+	
+	PredictionSnapshot( const PredictionSnapshot & Other, double Factor );
+	
+	PredictionSnapshot( const PredictionSnapshot & Other ) = default;
+	PredictionSnapshot( void ) = delete;
+};
+
+// -----------------------------------------------------------------------------
+// Prediction revisions
+// -----------------------------------------------------------------------------
+// Successive forecasts often change only the tail of the prediction horizon,
+// and instead of sending a complete new prediction file, a revision can be 
+// given as samples appended to the prediction or replacing the samples of the 
+// prediction over the time range of the revision. The samples can be given 
+// explicitly, or in a file of the same format as the prediction files, or 
+// both. Explicit samples replace file samples for the same time stamps. As for
+// a prediction file, the energy values give the energy produced from the 
+// first sample of the revision.
+
+class PredictionRevision
+{
+public:
+	
+	std::string              RevisionFile;
+	std::map< Time, double > Samples;
+};
+
+// -----------------------------------------------------------------------------
+// Prediction registry
+// -----------------------------------------------------------------------------
+// Each predictor used to parse its prediction files and tabulate its own 
+// snapshot, even when many producers receive the same forecast. The registry
+// is process wide and keeps the parsed prediction files by their name and 
+// the hash of their content, and the snapshots by the samples of the 
+// cumulative prediction they tabulate. A file is therefore parsed, and a 
+// prediction tabulated, only once however many predictors use it, and the
+// memory used by the shared tables grows with the number of distinct 
+// forecasts and not with the number of producers. The registry only holds 
+// weak pointers, and an entry is forgotten when the last predictor using it 
+// has moved on to another prediction. All functions can be called 
+// concurrently by the predictors.
+
+class PredictionRegistry
+{
+public:
+	
+	using Samples = std::map< Time, double >;
+	
+private:
+	
+	// A parsed file is found by its name and content hash, and the tabulated 
+	// snapshots by the hash of their samples. Snapshots whose samples have 
+	// the same hash are told apart by comparing the samples, which are kept 
+	// by the entry for as long as the snapshot is used.
+	
+	static std::map< std::pair< std::string, std::size_t >, 
+									 std::weak_ptr< const Samples > > Files;
+	
+	class Entry
+	{
+	public:
+		
+		std::shared_ptr< const Samples >          Series;
+		std::weak_ptr< const PredictionSnapshot > Snapshot;
+	};
+	
+	static std::unordered_multimap< std::size_t, Entry > Snapshots;
+	static std::mutex                                   Lock;
+	
+	// The entries of expired snapshots are removed when a new snapshot is 
+	// added, so the expired entries never outnumber the live ones.
+	
+	static std::size_t Hash( const Samples & Series );
+	static void        RemoveExpired( void );
+	
+public:
+	
+	// The parsed time series of a prediction file is shared by all callers
+	// as long as the file content is the same. An invalid argument exception 
+	// is thrown if the file cannot be read.
+	
+	static std::shared_ptr< const Samples > 
+	Series( const std::string & FileName );
+	
+	// The snapshot for given samples is returned from the registry if it is 
+	// there, and otherwise the given function is called to tabulate it. The
+	// samples should be the ones used to create the interpolation from which 
+	// the snapshot is tabulated.
+	
+	static std::shared_ptr< const PredictionSnapshot > 
+	Snapshot( const Samples & Series, 
+						const std::function< std::shared_ptr< const PredictionSnapshot >
+																 ( void ) > & Tabulate );
+	
+	// The number of distinct snapshots in use can be obtained for monitoring
+	
+	static std::size_t size( void );
+};
+
+// When the predictor has applied a revision, it informs the producer about 
+// the revised prediction domain and the time interval where the prediction 
+// changed, so that the producer can decide if the loads must be rescheduled.
+
+class PredictionRevised
+{
+public:
+	
+	TimeInterval Domain, Revision;
+};
+
 class Predictor : public virtual Theron::Actor,
 									public virtual Theron::StandardFallbackHandler
 {
 private:
   
-  // The prediction is stored as an interpolated function. It also stores the 
-  // integrated prediction to be able to respond quickly during the computation
-  // of the objective function.
+  // The prediction is stored as an interpolated function. The integrated 
+  // prediction needed for the objective function is tabulated in the 
+  // snapshot when the prediction is updated.
   
-  Interpolation Prediction, IntegratedPrediction;
+  Interpolation Prediction;
+  
+  // The samples of the cumulative prediction are kept so that a revision can 
+  // be merged with the current prediction.
+  
+  std::map< Time, double > PredictionSamples;
+  
+  // The current snapshot is replaced when the prediction is updated, and it 
+  // must therefore be stored and loaded atomically since it will be read by 
+  // the producer's thread. The tables of the snapshot are obtained from the
+  // prediction registry and may be shared with other predictors, and the 
+  // snapshot scales them by the installed capacity of the producer.
+  
+  std::shared_ptr< const PredictionSnapshot > Snapshot;
+  
+  // The predictions and revisions are normalised to one unit of installed 
+  // capacity if a capacity is given, and they are then used as they are for 
+  // the samples, the interpolation and the checkpoint. Only the snapshot 
+  // scales them to the production of the producer. The capacity is one by
+  // default, which means that the predictions are the production.
+  
+  const double Capacity;
+  
+  // The snapshot is published from the tables of a given snapshot by a 
+  // small helper function.
+  
+  void Publish( const std::shared_ptr< const PredictionSnapshot > & Shared );
   
   // It is necessary to remember the address of the producer in order to 
   // properly acknowledge the removal of finished loads, and the scheduler in 
@@ -83,12 +400,28 @@ private:
  void ComputeObjectiveValue( const TimeInterval & ConsumptionInterval,
 												     const Theron::Address Sender );
  
+ // The producer will normally not use this handler, but rather obtain the 
+ // current snapshot of the prediction when it starts a scheduling operation,
+ // and evaluate the objective value locally on this snapshot for all proposed
+ // start times.
+ 
+public:
+ 
+ inline std::shared_ptr< const PredictionSnapshot > GetSnapshot( void ) const
+ {
+	 return std::atomic_load( &Snapshot );
+ }
+ 
+private:
+ 
  // If there is only a single consumer associated with this producer, a 
  // different heuristic will be used: We will then solve for the point in time
  // when the cumulative predicted production equals the load's total production
  // and return this time point to the scheduler. It will return the solution 
  // as an assigned start time to the scheduler, and this time may potentially
- // be empty if no solution could be found.
+ // be empty if no solution could be found. The producer will normally find 
+ // this time directly from the snapshot, and the handler also finds it from 
+ // the current snapshot.
  
  void FindTimeRoot( const double & TotalLoadConsumption, 
 								    const Theron::Address TheSchedulerActor   );
@@ -107,6 +440,40 @@ private:
  void UpdatePrediction( const std::string & TheFilename, 
 												const Theron::Address TheProducer );
 
+ // A revision is merged with the samples of the current prediction, and the 
+ // new snapshot is created from the tables of the current snapshot so that 
+ // only the grid points from the start of the revision are sampled. The 
+ // producer is then informed about the revision.
+ 
+ void RevisePrediction( const PredictionRevision & TheRevision, 
+												const Theron::Address TheProducer );
+
+ // An update replaces the samples, but revisions appended to the prediction 
+ // make the samples grow for as long as the prediction is revised. When a 
+ // rolling horizon is set, the samples more than the horizon before the 
+ // given boundary are removed, keeping the last sample at or before the 
+ // boundary so that the prediction is still defined there. The function 
+ // returns true if samples were removed.
+ 
+ bool TrimHistory( Time Boundary );
+
+ // The predictions are given at their native sample rate, but a large part 
+ // of each day is night with no production, and the cumulative prediction is
+ // then constant, or clear sky where it is smooth. The knots of the 
+ // interpolation in these parts do not add information, but they make every
+ // evaluation of the interpolation slower. If a compression tolerance is 
+ // given, a new prediction is compressed by removing the knots that can be 
+ // removed while the samples stay within the tolerance of the straight line 
+ // between the remaining neighbouring knots. A run of samples with zero 
+ // production is then one segment. The first and the last samples are 
+ // always kept, and the samples are not compressed if fewer than three 
+ // knots would remain since the monotone interpolation needs three knots.
+ 
+ const double CompressionTolerance;
+ 
+ static void CompressSamples( std::map< Time, double > & Samples, 
+															double Tolerance );
+
  // ---------------------------------------------------------------------------
  // Update the prediction domain
  // ---------------------------------------------------------------------------
@@ -129,19 +496,36 @@ private:
  
  Time PredictionOrigin;
  
+ // ---------------------------------------------------------------------------
+ // Checkpoint
+ // ---------------------------------------------------------------------------
+ // The prediction samples, including merged revisions, are written to the 
+ // predictions directory of the checkpoint as a time series file named after 
+ // the producer. This file can be given as the initial prediction when the 
+ // producer is created again from the checkpoint. 
+ 
+ void SaveCheckpoint( const Checkpoint & TheCheckpoint, 
+										  const Theron::Address TheActorManager );
+ 
  // ---------------------------------------------------------------------------
  // Constructor and destructor
  // ---------------------------------------------------------------------------
  // The constructor takes the file name of the initial prediction 
  // as arguments since it makes no sense creating a predictor without a 
  // prediction. It also needs the address of the producer for which it provides
- // the prediction, and optionally an identifying actor name.
+ // the prediction, and optionally an identifying actor name, the installed
+ // capacity if the predictions are normalised, and the tolerance for the 
+ // compression of the predictions in the units of the prediction files where
+ // zero means no compression. An invalid argument exception is thrown if the
+ // capacity is not positive or the tolerance is negative.
  
 public:
  
  Predictor( const std::string & PredictionFile,
 				    const Theron::Address & ProducerAddress,
-				    const std::string & ActorName = std::string() );
+				    const std::string & ActorName = std::string(),
+				    double InstalledCapacity = 1.0, 
+				    double KnotTolerance = 0.0 );
  
  // The destructor is simply an entry point for allowing the destructor of the 
  // internal objects to be executed.
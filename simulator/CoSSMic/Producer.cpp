@@ -18,6 +18,7 @@
 #include <boost/optional/optional_io.hpp> // For serializing Assigned start time
 
 #include "SessionLayer.hpp"
+#include "BinaryPayload.hpp"
 #include "Producer.hpp"
 #include "ConsumerProxy.hpp"
 
@@ -110,6 +111,39 @@ bool Producer::ScheduleCommand::Deserialize(
   else return false;
 }
 
+// The binary codec writes the same fields, and the energy is transferred 
+// without loss of precision.
+
+Theron::SerialMessage::Payload 
+Producer::ScheduleCommand::BinarySerialize( void ) const
+{
+  Theron::BinaryWriter Message( "SCHEDULE" );
+  
+  Message << AllowedStart.lower() << AllowedStart.upper() << JobDuration 
+				  << EnergyNeeded;
+	  
+  return Message.str();
+}
+
+bool Producer::ScheduleCommand::BinaryDeserialize(
+  const Theron::SerialMessage::Payload & Payload)
+{
+  Theron::BinaryReader Message( Payload, "SCHEDULE" );
+  Time EarliestStart = 0, 
+			 LatestStart   = 0;
+	 
+  Message >> EarliestStart >> LatestStart >> JobDuration >> EnergyNeeded;
+  
+  if ( !Message ) return false;
+
+  if ( EarliestStart <= LatestStart )
+    AllowedStart.assign( EarliestStart, LatestStart );
+  else
+    AllowedStart.assign( LatestStart, EarliestStart );
+  
+  return true;
+}
+
 // The constructor taking a serialised payload as argument will throw an 
 // exception if the de-serialisation fails
 
@@ -117,7 +151,7 @@ Producer::ScheduleCommand::ScheduleCommand(
   const Theron::SerialMessage::Payload & Payload )
 : AllowedStart()
 {
-  if ( ! Deserialize( Payload ) )
+  if ( ! Decode( Payload ) )
   {
 	  std::ostringstream ErrorMessage;
 	  
@@ -180,13 +214,49 @@ bool Producer::AssignedStartTime::Deserialize(
     return false;
 }
 
+// The binary codec writes a flag telling if there is a start time followed by 
+// the time if there is one.
+
+Theron::SerialMessage::Payload 
+Producer::AssignedStartTime::BinarySerialize( void ) const
+{
+  Theron::BinaryWriter Message( "ASSIGNED_START_TIME" );
+  
+  Message << has_value();
+  
+  if ( has_value() )
+    Message << value();
+  
+  return Message.str();
+}
+
+bool Producer::AssignedStartTime::BinaryDeserialize(
+  const Theron::SerialMessage::Payload & Payload )
+{
+  Theron::BinaryReader Message( Payload, "ASSIGNED_START_TIME" );
+  bool                 HasTime = false;
+  Time                 SetTime = 0;
+  
+  Message >> HasTime;
+  
+  if ( HasTime ) 
+    Message >> SetTime;
+  
+  if ( !Message ) return false;
+  
+  if ( HasTime ) 
+    this->operator=( SetTime );
+  
+  return true;
+}
+
 // The constructor from a serialised message uses the method to de-serialise 
 // the message and throws if that is not possible
 
 Producer::AssignedStartTime::AssignedStartTime(
   const Theron::SerialMessage::Payload & Payload )
 {
-  if ( ! Deserialize( Payload ) )
+  if ( ! Decode( Payload ) )
   {
 	  std::ostringstream ErrorMessage;
 	  
@@ -226,6 +296,19 @@ bool Producer::KillProxyCommand::Deserialize(
     return false;
 }
 
+// The binary command is just the tag
+
+std::string Producer::KillProxyCommand::BinarySerialize(void) const
+{
+  return Theron::BinaryWriter( "KILLPROXY" ).str();
+}
+
+bool Producer::KillProxyCommand::BinaryDeserialize(
+  const Theron::SerialMessage::Payload & Payload )
+{
+  return static_cast< bool >( Theron::BinaryReader( Payload, "KILLPROXY" ) );
+}
+
 // The constructor calling the de-serialising method will throw an invalid 
 // argument exception if the command is not a kill proxy command.
 
@@ -233,7 +316,7 @@ Producer::KillProxyCommand::KillProxyCommand(
   const Theron::SerialMessage::Payload & Payload)
 : KillProxyCommand()
 {
-  if ( ! Deserialize( Payload ) )
+  if ( ! Decode( Payload ) )
   {
 	  std::ostringstream ErrorMessage;
 	  
@@ -269,11 +352,23 @@ bool Producer::AcknowledgeProxyRemoval::Deserialize(
     return false;
 }
 
+std::string Producer::AcknowledgeProxyRemoval::BinarySerialize(void) const
+{
+  return Theron::BinaryWriter( "ACKNOWLEDGE_PROXY_REMOVAL" ).str();
+}
+
+bool Producer::AcknowledgeProxyRemoval::BinaryDeserialize(
+  const Theron::SerialMessage::Payload & Payload)
+{
+  return static_cast< bool >( 
+				 Theron::BinaryReader( Payload, "ACKNOWLEDGE_PROXY_REMOVAL" ) );
+}
+
 Producer::AcknowledgeProxyRemoval::AcknowledgeProxyRemoval(
   const Theron::SerialMessage::Payload & Payload )
 : AcknowledgeProxyRemoval()
 {
-  if( ! Deserialize( Payload ) )
+  if( ! Decode( Payload ) )
   {
 	  std::ostringstream ErrorMessage;
 	  
@@ -288,20 +383,35 @@ Producer::AcknowledgeProxyRemoval::AcknowledgeProxyRemoval(
 // Consumer proxy management
 // ---------------------------------------------------------------------------
 //
-// The find function is basically a loop that breaks if there is a matching 
-// consumer. If the loop runs to the end with no consumer found, the function
-// will return an uninitialised optional
+// The find function looks up the consumer in the index, and if there is no 
+// proxy for the consumer the end of the list of consumers is returned.
 
 CoSSMic::Producer::ConsumerReference
 Producer::FindConsumer( const Theron::Address & TheConsumer )
 {
-	for ( auto TheProxy  = AssignedConsumers.begin(); 
-						 TheProxy != AssignedConsumers.end(); 
-					 ++TheProxy )
-     if ( (*TheProxy)->GetConsumer() == TheConsumer )
-       return TheProxy;
- 
-  return AssignedConsumers.end();
+	auto Indexed = ConsumerIndex.find( TheConsumer );
+	
+	if ( Indexed != ConsumerIndex.end() )
+		return Indexed->second;
+	else
+		return AssignedConsumers.end();
+}
+
+// Deleting a consumer removes it from the index before the proxy is possibly
+// recycled, since a released proxy forgets its consumer. 
+
+void Producer::DeleteConsumer( const ConsumerReference & TheConsumer )
+{
+	ForgetConsumer( TheConsumer );
+	
+	auto Indexed = ConsumerIndex.find( (*TheConsumer)->GetConsumer() );
+	
+	if ( ( Indexed != ConsumerIndex.end() ) && ( Indexed->second == TheConsumer ) )
+		ConsumerIndex.erase( Indexed );
+	
+	RecycleProxy( *TheConsumer );
+	AssignedConsumers.erase( TheConsumer );
+	ProxyCount.fetch_sub( 1, std::memory_order_relaxed );
 }
 
 // ---------------------------------------------------------------------------
@@ -316,13 +426,42 @@ Producer::FindConsumer( const Theron::Address & TheConsumer )
 // pointer created by the make shared function is a temporary pointer, it 
 // will not reduce the use counter when it goes out of scope.
 //
-// The solution is to use a direct allocation instead.
+// The solution is to use a direct allocation instead. An idle proxy is 
+// reused for the load if there is one, and a new proxy is placed with the 
+// producer since they exchange the messages of the load.
 
 void Producer::NewLoad( const Producer::ScheduleCommand & TheCommand, 
                         const Theron::Address TheConsumer )
 {
-  AssignedConsumers.emplace_back( 
+  if ( IdleProxies.empty() )
+  {
+    AssignedConsumers.emplace_back( 
 		  new ConsumerProxy( TheCommand, TheConsumer, GetAddress() ) );  	
+    AssignedConsumers.back()->SetPlacement( GetPlacement() );
+  }
+  else
+  {
+    IdleProxies.back()->Reinitialise( TheCommand, TheConsumer );
+    AssignedConsumers.push_back( IdleProxies.back() );
+    IdleProxies.pop_back();
+  }
+  
+  ConsumerIndex[ TheConsumer ] = std::prev( AssignedConsumers.end() );
+  ProxyCount.fetch_add( 1, std::memory_order_relaxed );
+}
+
+// A proxy about to be removed is released and kept if it can be reused. 
+// Otherwise the destructor will acknowledge the proxy removal when the last
+// reference to the proxy is gone.
+
+void Producer::RecycleProxy( const ManagedConsumerPointer & TheProxy )
+{
+  if ( ( TheProxy.use_count() == 1 ) && !TheProxy->HasPendingMessages() && 
+       ( IdleProxies.size() < ProxyPoolSize ) )
+  {
+    TheProxy->Release();
+    IdleProxies.push_back( TheProxy );
+  }
 }
 
 // Inversely, when there is a request to kill a load, it will simply be removed
@@ -336,7 +475,7 @@ void Producer::KillProxy( const Producer::KillProxyCommand & TheCommand,
   auto TheProxy = FindConsumer( TheConsumer );
   
   if ( TheProxy != AssignedConsumers.end() )
-    AssignedConsumers.erase( TheProxy );
+    DeleteConsumer( TheProxy );
   else
   {
     std::ostringstream ErrorMessage;
@@ -441,11 +580,13 @@ Producer::Producer( const IDType & ProducerID )
          std::string( ProducerNameBase + ProducerID ).data() : std::string() )),
   StandardFallbackHandler( GetAddress().AsString() ),
   DeserializingActor( GetAddress().AsString() ),
+  AssignedConsumers(), ProxyCount( 0 ), IdleProxies(), ConsumerIndex(), 
   TheActorManager()
 {
   RegisterHandler( this, &Producer::NewLoad   			);
   RegisterHandler( this, &Producer::KillProxy 			);
 	RegisterHandler( this, &Producer::ShutDownHandler );
+	RegisterHandler( this, &Producer::SaveCheckpoint  );
 }
 
 } // name space CoSSMic
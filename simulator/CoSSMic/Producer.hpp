@@ -31,12 +31,17 @@
 
 #include <string>									// For text strings
 #include <list>										// For storing assigned loads
+#include <vector>									// For idle consumer proxies
+#include <unordered_map>					// Consumer proxy index
 #include <memory>									// For shared pointers
 #include <iterator>								// For iterator operations
 #include <type_traits>						// For testing base classes
 #include <optional> 		          // Optionally assigned start times
+#include <atomic>                 // Load counters read by the actor manager
+#include <chrono>                 // Scheduling time
 
 #include "Actor.hpp"							// The Theron++ actor framework
+#include "AddressHash.hpp"				// Hashing actor addresses
 #include "SerialMessage.hpp"			// Support for network messages
 #include "StandardFallbackHandler.hpp"
 
@@ -45,6 +50,7 @@
 #include "NetworkEndPoint.hpp"	  // Network endpoint for external communication
 #include "PresentationLayer.hpp"	// Serial network messaging
 #include "DeserializingActor.hpp" // Support for receiving a serial message
+#include "Checkpoint.hpp"					// Snapshots of the household state
 
 namespace CoSSMic 
 {
@@ -165,6 +171,10 @@ public:
 	    Serialize( void ) const override;
     virtual bool 
 	    Deserialize( const Theron::SerialMessage::Payload & Payload ) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
     
     // Since the de-serialise function must be called on an existing object 
     // and it will initialise that object, there must be an default (empty) 
@@ -234,6 +244,10 @@ public:
 	    Serialize( void ) const override;
     virtual bool
 	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
 
     // There is a constructor that basically invokes the method above to de-
     // serialise a string
@@ -294,6 +308,22 @@ private:
   // simple list.
   
   std::list< ManagedConsumerPointer > AssignedConsumers;
+  
+  // The number of assigned consumers is also counted atomically since it is
+  // read by the actor manager when it reports the load of the endpoint.
+  
+  std::atomic< std::size_t > ProxyCount;
+  
+  // Proxies removed from the list are kept for reuse by the next loads since
+  // creating and destroying an actor for every load is expensive. A removed 
+  // proxy is only kept if no other actor, like the predictor, holds it, and 
+  // there is an upper limit on the number of idle proxies kept.
+  
+  constexpr static std::size_t ProxyPoolSize = 32;
+  
+  std::vector< ManagedConsumerPointer > IdleProxies;
+  
+  void RecycleProxy( const ManagedConsumerPointer & TheProxy );
 	
 	// The consumer proxies will use the producer to send messages back to the 
 	// consumer actor that may be on a remote node (network endpoint), and since
@@ -311,6 +341,16 @@ public:
   // deletion. The elements are available through iterators.
 	
 	using ConsumerReference = std::list< ManagedConsumerPointer >::iterator;
+	
+	// A producer like the grid can have many proxies assigned, and the proxy of 
+	// a consumer is therefore found from a hash index of the consumer addresses 
+	// maintained together with the list of proxies.
+	
+private:
+	
+	std::unordered_map< Theron::Address, ConsumerReference > ConsumerIndex;
+	
+public:
   
   // The functions returning the first and the last consumers are basically 
   // identical to the begin and end functions of the list of consumers.
@@ -333,18 +373,34 @@ public:
   // There is also a function to remove a consumer from the list of 
   // assigned consumers that simply calls the erase function.
   
-  inline void DeleteConsumer( const ConsumerReference & TheConsumer )
-  {
-    AssignedConsumers.erase( TheConsumer );
-  }
+  void DeleteConsumer( const ConsumerReference & TheConsumer );
+  
+  // A derived producer keeping its own references to the assigned consumers 
+  // is told when a consumer is about to be deleted so that it can forget the 
+  // reference before it becomes invalid.
   
-  // It is easy to check how many consumers that are currently assigned
+protected:
+  
+  virtual void ForgetConsumer( const ConsumerReference & TheConsumer )
+  { }
+  
+public:
+  
+  // It is easy to check how many consumers that are currently assigned, and
+  // this can be done from any thread.
   
-  inline std::size_t NumberOfConsumers( void )
+  inline std::size_t NumberOfConsumers( void ) const
   {
-    return AssignedConsumers.size();
+    return ProxyCount.load( std::memory_order_relaxed );
   }
   
+  // The total time spent computing schedules is used as a measure of the 
+  // load of the producer. A producer that does not measure it reports zero,
+  // and the function must be safe to call from any thread.
+  
+  virtual std::chrono::milliseconds SchedulingTime( void ) const
+  { return std::chrono::milliseconds::zero(); }
+  
   // It may be necessary to check if a consumer with a given address is 
   // allocated to this producer.
   
@@ -370,6 +426,10 @@ public:
 	    Serialize( void ) const override;
     virtual bool 
 	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
 
     // The class has a constructor that simply calls the method to de-serialise
     // a received message. This will throw an invalid argument exception if the 
@@ -409,6 +469,10 @@ public:
 	    Serialize( void ) const override;
     virtual bool
 	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
 
     AcknowledgeProxyRemoval( 
 		 const Theron::SerialMessage::Payload & Payload );
@@ -505,6 +569,21 @@ private:
 	
 	Theron::Address TheActorManager;
 	
+  // ---------------------------------------------------------------------------
+  // Checkpoint
+  // ---------------------------------------------------------------------------
+  //
+	// The Actor Manager forwards a checkpoint to all its producers. A generic 
+	// producer has no state that cannot be re-established by the consumers 
+	// asking for energy again, and the handler does nothing. Producers with 
+	// state, like the PV producer's prediction, will override the handler.
+	
+protected:
+	
+	virtual void SaveCheckpoint( const Checkpoint & TheCheckpoint, 
+															 const Theron::Address TheActorManager )
+	{ }
+	
   // ---------------------------------------------------------------------------
   // Constructors and destructor
   // ---------------------------------------------------------------------------
@@ -0,0 +1,246 @@
+/*=============================================================================
+  Producer Placement
+
+  The placement service exchanges the loads of the endpoints with its peers
+  and places new producers on the least loaded endpoint. See the header file
+  for details.
+
+  Author: Geir Horn, University of Oslo, 2019
+  Contact: Geir.Horn [at] mn.uio.no
+  License: LGPL3.0
+=============================================================================*/
+
+#include <sstream>									// For nicely formatted errors
+#include <stdexcept>								// Standard exceptions
+#include <algorithm>								// Finding the least loaded peer
+
+#include "ProducerPlacement.hpp"
+
+namespace CoSSMic
+{
+/*=============================================================================
+
+ Peer placement services
+
+=============================================================================*/
+//
+// The peers are recognised by the name root as for the reward calculators.
+// A new peer is not assumed to be idle, and it will only receive producers
+// once it has reported its load.
+
+void ProducerPlacement::AddPeer(
+  const Theron::SessionLayerMessages::NewPeerAdded & NewAgent,
+  const Theron::Address SessionLayerServer )
+{
+  for ( const Theron::Address & TheAgent : NewAgent )
+    if ( (std::string( TheAgent.AsString() ).find( NameRoot ) !=
+          std::string::npos) && ( TheAgent != GetAddress() ) )
+      Send( LoadReport( LocalLoad ), TheAgent );
+}
+
+void ProducerPlacement::RemovePeer(
+  const Theron::SessionLayerMessages::PeerRemoved & LeavingAgent,
+  const Theron::Address SessionLayerServer )
+{
+  PeerLoad.erase( LeavingAgent.GetAddress() );
+}
+
+/*=============================================================================
+
+ Load reports
+
+=============================================================================*/
+//
+// The load report is serialised with the load as a decimal number
+
+Theron::SerialMessage::Payload
+ProducerPlacement::LoadReport::Serialize( void ) const
+{
+  std::ostringstream Message;
+
+  Message << "PLACEMENT_LOAD " << Load;
+
+  return Message.str();
+}
+
+bool ProducerPlacement::LoadReport::Deserialize(
+  const Theron::SerialMessage::Payload & Payload )
+{
+  std::istringstream Message( Payload );
+  std::string 			 Command;
+
+  Message >> Command;
+
+  if ( Command == "PLACEMENT_LOAD" )
+  {
+    Message >> Load;
+    return static_cast< bool >( Message ) && ( Load >= 0.0 );
+  }
+  else
+    return false;
+}
+
+ProducerPlacement::LoadReport::LoadReport(
+  const Theron::SerialMessage::Payload & Payload )
+: LoadReport()
+{
+  if ( ! Decode( Payload ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+						     << "Placement load report != " << Payload;
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+}
+
+// A measurement is started by asking the actor manager for the load, and the
+// next measurement is scheduled immediately so that the reports continue
+// even if the actor manager should not respond.
+
+void ProducerPlacement::QueryLoad( const MeasureLoad & TheTimeOut,
+																   const Theron::Address ThePlacement )
+{
+  Send( ActorManager::LoadQuery(), ActorManager::Address() );
+
+  ReportTimer = Theron::TimerWheel::Service().ScheduleMessage(
+    std::chrono::duration_cast< Theron::TimerWheel::Duration >(
+      ReportingPeriod ), MeasureLoad(), GetAddress(), GetAddress() );
+}
+
+// The utilisation is the scheduling time since the previous measurement
+// relative to the wall clock time since then. The load replaces any
+// provisional increase made by placing producers on this endpoint, and it is
+// reported to all the peers.
+
+void ProducerPlacement::LocalLoadReport(
+  const ActorManager::EndpointLoad & TheLoad,
+  const Theron::Address TheActorManager )
+{
+  auto CurrentTime = std::chrono::steady_clock::now();
+
+  std::chrono::duration< double >
+    Elapsed( CurrentTime - PreviousMeasurement ),
+    Scheduling( TheLoad.SchedulingTime - PreviousSchedulingTime );
+
+  if ( Elapsed.count() > 0.0 )
+  {
+    LocalLoad = std::max( Scheduling.count(), 0.0 ) / Elapsed.count()
+							+ ProxyWeight * TheLoad.Proxies;
+
+    PreviousMeasurement    = CurrentTime;
+    PreviousSchedulingTime = TheLoad.SchedulingTime;
+
+    for ( const auto & Peer : PeerLoad )
+      Send( LoadReport( LocalLoad ), Peer.first );
+  }
+}
+
+// A report from a peer records its load, and a peer that was not known
+// before is added. This covers peers that started after this service, and
+// the report is returned so that the new peer learns about this endpoint.
+
+void ProducerPlacement::PeerLoadReport( const LoadReport & TheReport,
+																			  const Theron::Address ThePeer )
+{
+  auto [ Peer, NewPeer ] = PeerLoad.insert_or_assign( ThePeer,
+																										  TheReport.GetLoad() );
+
+  if ( NewPeer )
+    Send( LoadReport( LocalLoad ), Peer->first );
+}
+
+/*=============================================================================
+
+ Placing producers
+
+=============================================================================*/
+//
+// A command from the local actor manager is placed on the least loaded peer
+// if that is less loaded than this endpoint by more than the margin, and
+// otherwise it is returned to the local actor manager. A command from a peer
+// has already been placed and is given to the local actor manager. The load
+// of the endpoint receiving the producer is provisionally increased by the
+// margin.
+
+void ProducerPlacement::PlaceProducer(
+  const ActorManager::AddProducer & Command, const Theron::Address TheSender )
+{
+  if ( TheSender == ActorManager::Address() )
+  {
+    auto LeastLoaded = std::min_element( PeerLoad.begin(), PeerLoad.end(),
+      []( const auto & First, const auto & Second ){
+				return First.second < Second.second; });
+
+    if ( ( LeastLoaded != PeerLoad.end() ) &&
+				 ( LeastLoaded->second + Margin < LocalLoad ) )
+    {
+      Send( Command, LeastLoaded->first );
+      LeastLoaded->second += Margin;
+      return;
+    }
+  }
+
+  Send( Command, ActorManager::Address() );
+  LocalLoad += Margin;
+}
+
+/*=============================================================================
+
+ Constructor and destructor
+
+=============================================================================*/
+
+ProducerPlacement::ProducerPlacement( const std::string & Domain,
+																		  std::chrono::milliseconds Period,
+																		  double WeightPerProxy,
+																		  double PlacementMargin )
+: Actor( std::string( NameRoot ) + Domain ),
+  StandardFallbackHandler( GetAddress().AsString() ),
+  DeserializingActor( GetAddress().AsString() ),
+  SessionServer( Theron::Network::GetAddress(Theron::Network::Layer::Session) ),
+  PeerLoad(), ReportingPeriod( Period ), ProxyWeight( WeightPerProxy ),
+  Margin( PlacementMargin ), ReportTimer( Theron::TimerWheel::NullTimer ),
+  PreviousSchedulingTime( 0 ),
+  PreviousMeasurement( std::chrono::steady_clock::now() ), LocalLoad( 0.0 )
+{
+  if ( ( Period <= std::chrono::milliseconds::zero() ) ||
+			 ( WeightPerProxy < 0.0 ) || ( PlacementMargin < 0.0 ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+						     << "The producer placement needs a positive reporting "
+						     << "period (" << Period.count() << " ms given) and a "
+						     << "non-negative proxy weight (" << WeightPerProxy
+						     << " given) and margin (" << PlacementMargin << " given)";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  RegisterHandler( this, &ProducerPlacement::AddPeer         );
+  RegisterHandler( this, &ProducerPlacement::RemovePeer      );
+  RegisterHandler( this, &ProducerPlacement::QueryLoad       );
+  RegisterHandler( this, &ProducerPlacement::LocalLoadReport );
+  RegisterHandler( this, &ProducerPlacement::PeerLoadReport  );
+  RegisterHandler( this, &ProducerPlacement::PlaceProducer   );
+
+  Send( Theron::SessionLayerMessages::NewPeerSubscription(), SessionServer );
+
+  ReportTimer = Theron::TimerWheel::Service().ScheduleMessage(
+    std::chrono::duration_cast< Theron::TimerWheel::Duration >(
+      ReportingPeriod ), MeasureLoad(), GetAddress(), GetAddress() );
+}
+
+// The destructor stops the reports and the peer subscription
+
+ProducerPlacement::~ProducerPlacement( void )
+{
+  if ( ReportTimer != Theron::TimerWheel::NullTimer )
+    Theron::TimerWheel::Service().Cancel( ReportTimer );
+
+  Send( Theron::SessionLayerMessages::NewPeerUnsubscription(), SessionServer );
+}
+
+}      // name space CoSSMic
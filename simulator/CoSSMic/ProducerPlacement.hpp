@@ -0,0 +1,203 @@
+/*=============================================================================
+  Producer Placement
+
+  A producer is normally created on the endpoint of the household owning the
+  PV panels, and all the consumer proxies of the loads it serves run on the
+  same endpoint. With many loads per producer, or many producers per
+  household, some endpoints carry most of the scheduling work while others
+  are idle. Since the actors are addressed by name through the session layer,
+  a producer can run on any endpoint of the neighbourhood without the
+  consumers noticing, and the placement service uses this to create new
+  producers on the endpoint with the least load.
+
+  There is one placement service per endpoint, and they find each other
+  through the session layer in the same way as the reward calculators. Each
+  service periodically asks the local actor manager for the load of the
+  endpoint: the number of consumer proxies served by the local producers, and
+  the total time the producers have spent computing schedules. The fraction
+  of the reporting period spent scheduling is the utilisation of the endpoint,
+  and its load is this utilisation plus a small weight for each proxy, so that
+  the number of proxies breaks the tie between endpoints that are both idle.
+  The load is sent to the placement services on the other endpoints.
+
+  When the task manager asks the local actor manager to create a producer,
+  the actor manager forwards the command to the placement service. The
+  producer is created locally unless a remote endpoint has a load that is
+  less than the local load by more than a margin, and then the command is
+  handed to the placement service of the least loaded endpoint, which gives
+  it to its actor manager. The load recorded for the chosen endpoint is
+  increased by the margin until its next report, so that a burst of new
+  producers is not all placed on the same endpoint. The margin also prevents
+  producers from being sent to endpoints that are only marginally less
+  loaded since the reports are always somewhat out of date.
+
+  The producer reads its prediction file when it is created, and the file
+  must therefore be reachable from the endpoint where it is placed, for
+  instance on a shared file system. Producers are only placed when they are
+  created and are not moved later as the loads change.
+
+  Author: Geir Horn, University of Oslo, 2019
+  Contact: Geir.Horn [at] mn.uio.no
+  License: LGPL3.0
+=============================================================================*/
+
+#ifndef COSSMIC_PRODUCER_PLACEMENT
+#define COSSMIC_PRODUCER_PLACEMENT
+
+#include <string>										// Names and messages
+#include <map>											// The loads of the peer endpoints
+#include <chrono>										// The reporting period
+
+#include "Actor.hpp"	 							// The Theron++ actor framework
+#include "StandardFallbackHandler.hpp"
+#include "PresentationLayer.hpp"		// For serialisation of external messages
+#include "DeserializingActor.hpp" 	// Support for receiving a serial message
+#include "SessionLayer.hpp"	 				// For detecting peer placement services
+#include "NetworkEndPoint.hpp"  		// The session layer address
+#include "TimerWheel.hpp"						// The periodic load reports
+
+#include "ActorManager.hpp"					// Producer creation and the endpoint load
+
+namespace CoSSMic
+{
+
+class ProducerPlacement : virtual public Theron::Actor,
+												  virtual public Theron::StandardFallbackHandler,
+												  virtual public Theron::DeserializingActor
+{
+  // ---------------------------------------------------------------------------
+  // Peer placement services
+  // ---------------------------------------------------------------------------
+  //
+  // The placement services are named by a common name root and the domain of
+  // the endpoint so that they can be recognised among the peers reported by
+  // the session layer. The last load reported by each peer is kept, and a
+  // peer is forgotten when the session layer reports that it has left.
+
+public:
+
+  constexpr static auto NameRoot = "ProducerPlacement_";
+
+private:
+
+  Theron::Address SessionServer;
+
+  std::map< Theron::Address, double > PeerLoad;
+
+  void AddPeer( const Theron::SessionLayerMessages::NewPeerAdded & NewAgent,
+							  const Theron::Address SessionLayerServer );
+
+  void RemovePeer( const Theron::SessionLayerMessages::PeerRemoved & LeavingAgent,
+								   const Theron::Address SessionLayerServer );
+
+  // ---------------------------------------------------------------------------
+  // Load reports
+  // ---------------------------------------------------------------------------
+  //
+  // The load is measured over the reporting period. The timer message starts
+  // a measurement by sending a load query to the actor manager, and the load
+  // of the endpoint is computed when the actor manager responds. The
+  // scheduling time is cumulative, and the time reported at the previous
+  // measurement is remembered with the wall clock time of that measurement.
+
+  const std::chrono::milliseconds ReportingPeriod;
+  const double 										ProxyWeight, Margin;
+
+  Theron::TimerWheel::TimerID 					ReportTimer;
+  std::chrono::milliseconds 						PreviousSchedulingTime;
+  std::chrono::steady_clock::time_point PreviousMeasurement;
+  double 																LocalLoad;
+
+  class MeasureLoad
+  { };
+
+  void QueryLoad( const MeasureLoad & TheTimeOut,
+								  const Theron::Address ThePlacement );
+
+  void LocalLoadReport( const ActorManager::EndpointLoad & TheLoad,
+											  const Theron::Address TheActorManager );
+
+  // The load is sent to the peer placement services as a serial message
+  // holding the load of the sending endpoint.
+
+public:
+
+  class LoadReport : public Theron::SerialMessage
+  {
+  private:
+
+    double Load;
+
+	protected:
+
+    virtual Theron::SerialMessage::Payload
+	    Serialize( void ) const override;
+    virtual bool
+	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+
+  public:
+
+    inline double GetLoad( void ) const
+    { return Load; }
+
+    LoadReport( double TheLoad )
+    : Load( TheLoad )
+    { }
+
+    LoadReport( const Theron::SerialMessage::Payload & Payload );
+
+    LoadReport( void )
+    : Load( 0.0 )
+    { }
+
+    LoadReport( const LoadReport & Other )
+    : Load( Other.Load )
+    { }
+
+    virtual ~LoadReport( void )
+    { }
+  };
+
+private:
+
+  void PeerLoadReport( const LoadReport & TheReport,
+										   const Theron::Address ThePeer );
+
+  // ---------------------------------------------------------------------------
+  // Placing producers
+  // ---------------------------------------------------------------------------
+  //
+  // The add producer command is received from the local actor manager when
+  // the task manager asks for a new producer, and from a peer placement
+  // service when the producer should be created on this endpoint. In both
+  // cases the command ends with an actor manager creating the producer.
+
+  void PlaceProducer( const ActorManager::AddProducer & Command,
+										  const Theron::Address TheSender );
+
+  // ---------------------------------------------------------------------------
+  // Constructor and destructor
+  // ---------------------------------------------------------------------------
+  //
+  // The constructor takes the domain of the endpoint, the period between the
+  // load reports, the load of each consumer proxy, and the margin by which a
+  // remote endpoint must be less loaded than this endpoint to receive a new
+  // producer. It throws an invalid argument exception if the period is not
+  // positive or if the weight or the margin is negative. The actor manager
+  // must be given the address of this actor for producers to be placed.
+
+public:
+
+  ProducerPlacement( const std::string & Domain,
+									   std::chrono::milliseconds Period = std::chrono::seconds(10),
+									   double WeightPerProxy = 0.01,
+									   double PlacementMargin = 0.1 );
+
+  ProducerPlacement( void ) = delete;
+  ProducerPlacement( const ProducerPlacement & Other ) = delete;
+
+  virtual ~ProducerPlacement( void );
+};
+
+}      // name space CoSSMic
+#endif // COSSMIC_PRODUCER_PLACEMENT
@@ -0,0 +1,170 @@
+/*=============================================================================
+  Producer Priors
+
+  The implementation of the prior store. Please see the header for details.
+
+  Author: Geir Horn, University of Oslo, 2019
+  Contact: Geir.Horn [at] mn.uio.no
+  License: LGPL3.0
+=============================================================================*/
+
+#include <fstream>								// Reading and writing the file
+#include <iterator>								// Reading the file into a string
+#include <algorithm>							// std::max
+
+#include "BinaryPayload.hpp"			// The binary encoding
+#include "ProducerPriors.hpp"
+
+namespace CoSSMic
+{
+
+// The device ID is written in the same format as the numeric fields of the
+// load ID.
+
+std::string ProducerPriors::DeviceID( const IDType & LoadID )
+{
+	return std::to_string( LoadID.GetHousehold() ) + ":" +
+				 std::to_string( LoadID.GetDevice() );
+}
+
+// The prior is only copied for producers that do not have a probability
+// already.
+
+bool ProducerPriors::Prior( const IDType & LoadID,
+													  ProbabilityMap & Probabilities ) const
+{
+	std::lock_guard< std::mutex > Guard( Lock );
+
+	auto TheDevice = Priors.find( DeviceID( LoadID ) );
+
+	if ( TheDevice == Priors.end() )
+		return false;
+
+	for ( const auto & Record : TheDevice->second.Probabilities )
+		Probabilities.emplace( Theron::Address( Record.first.data() ),
+													 Record.second );
+
+	return true;
+}
+
+// The update is a running average where producers not in the prior count as
+// having zero probability, and producers in the prior not known by the
+// consumer have their probability reduced.
+
+void ProducerPriors::Update( const IDType & LoadID,
+													   const ProbabilityMap & Probabilities )
+{
+	if ( Probabilities.empty() ) return;
+
+	std::lock_guard< std::mutex > Guard( Lock );
+
+	DevicePrior & TheDevice = Priors[ DeviceID( LoadID ) ];
+
+	TheDevice.Loads++;
+
+	double Weight = std::max( 1.0 / TheDevice.Loads, MinimumWeight );
+
+	for ( auto & Record : TheDevice.Probabilities )
+		Record.second *= ( 1.0 - Weight );
+
+	for ( const auto & Record : Probabilities )
+		TheDevice.Probabilities[ Record.first.AsString() ] +=
+			Weight * static_cast< double >( Record.second );
+}
+
+// Loading the file reads it in full into a string and decodes the string as
+// a binary payload. The priors are only taken if the full file could be
+// decoded.
+
+void ProducerPriors::Load( const std::string & Directory )
+{
+	std::lock_guard< std::mutex > Guard( Lock );
+
+	if ( Loaded ) return;
+
+	Loaded = true;
+
+	std::ifstream PriorFile( Directory + "/Priors.bin", std::ios::binary );
+
+	if ( !PriorFile.good() ) return;
+
+	Theron::SerialMessage::Payload
+	Content( ( std::istreambuf_iterator< char >( PriorFile ) ),
+					 std::istreambuf_iterator< char >() );
+
+	Theron::BinaryReader PriorRecords( Content, "PRIORS" );
+	std::unordered_map< std::string, DevicePrior > StoredPriors;
+	std::uint32_t Devices = 0;
+
+	PriorRecords >> Devices;
+
+	for ( std::uint32_t d = 0; ( d < Devices ) && PriorRecords; d++ )
+	{
+		std::string   TheDevice;
+		std::uint32_t Producers = 0;
+		DevicePrior   ThePrior{ 0, {} };
+
+		PriorRecords >> TheDevice >> ThePrior.Loads >> Producers;
+
+		for ( std::uint32_t p = 0; ( p < Producers ) && PriorRecords; p++ )
+		{
+			std::string ProducerAddress;
+			double 			Probability = 0.0;
+
+			PriorRecords >> ProducerAddress >> Probability;
+			ThePrior.Probabilities.emplace( ProducerAddress, Probability );
+		}
+
+		StoredPriors.emplace( TheDevice, ThePrior );
+	}
+
+	if ( PriorRecords && PriorRecords.AtEnd() )
+		Priors.swap( StoredPriors );
+}
+
+// Saving encodes all priors into one payload that is written in one go. The
+// directory is assumed to exist since it is the directory where the consumers
+// persist their probabilities, and the function returns false if the file
+// could not be written.
+
+bool ProducerPriors::Save( const std::string & Directory ) const
+{
+	Theron::BinaryWriter PriorRecords( "PRIORS" );
+
+	{
+		std::lock_guard< std::mutex > Guard( Lock );
+
+		PriorRecords << static_cast< std::uint32_t >( Priors.size() );
+
+		for ( const auto & TheDevice : Priors )
+		{
+			PriorRecords << TheDevice.first << TheDevice.second.Loads
+									 << static_cast< std::uint32_t >(
+											TheDevice.second.Probabilities.size() );
+
+			for ( const auto & Record : TheDevice.second.Probabilities )
+				PriorRecords << Record.first << Record.second;
+		}
+	}
+
+	std::ofstream PriorFile( Directory + "/Priors.bin",
+													 std::ios::binary | std::ios::trunc );
+
+	auto Content = PriorRecords.str();
+
+	return static_cast< bool >( PriorFile.write( Content.data(),
+																							 Content.size() ) );
+}
+
+// The store is created and loaded when it is first used
+
+ProducerPriors & ProducerPriors::Store( void )
+{
+	static ProducerPriors TheStore;
+
+	TheStore.Load( "Probabilities" );
+
+	return TheStore;
+}
+
+}	// name space CoSSMic
@@ -0,0 +1,122 @@
+/*=============================================================================
+  Producer Priors
+
+  A consumer agent is created for a load, i.e. a mode of an appliance, and it
+  reads the producer probabilities persisted by the previous consumer for the
+  same load. A load that has not been run before, or a load whose probability
+  file has been lost, will however start from uniform probabilities and the
+  consumer must learn from scratch which producers are able to accommodate
+  its load. Each failed attempt costs a schedule command to a producer and
+  the subsequent removal of the proxy.
+
+  The loads of the same device tend to prefer the same producers, and the
+  prior store therefore keeps the average of the probabilities learned by
+  the consumers of each device, i.e. for the device ID
+  [HouseholdID]:[DeviceID] of the load ID [HouseholdID]:[DeviceID]:[ModeID].
+  A consumer without its own stored probabilities is initialised with the
+  prior of its device, and it updates the prior with what it has learned when
+  it persists its probabilities. The prior is a running average over the
+  loads where the weight of a new load is 1/n for the n first loads of the
+  device and then kept constant so that the prior can follow changes in the
+  set of producers.
+
+  There is one store shared by all consumer agents of the process, and it is
+  protected by a mutex since the consumers may run on different threads. The
+  store is read from the binary file Priors.bin of the probability directory
+  when it is first used, and written back when the probabilities are
+  persisted. The file uses the binary payload encoding of the messages: A
+  header with the tag "PRIORS", the number of devices, and then for each
+  device the device ID, the number of loads averaged, the number of
+  producers, and the producer address and probability pairs.
+
+  Author: Geir Horn, University of Oslo, 2019
+  Contact: Geir.Horn [at] mn.uio.no
+  License: LGPL3.0
+=============================================================================*/
+
+#ifndef COSSMIC_PRODUCER_PRIORS
+#define COSSMIC_PRODUCER_PRIORS
+
+#include <string>									// Device IDs and file names
+#include <map>										// Probabilities per producer
+#include <unordered_map>					// Priors per device
+#include <mutex>									// Shared between consumer threads
+#include <cstdint>								// Fixed size counters
+
+#include "Actor.hpp"							// Theron++ addresses
+#include "IDType.hpp"							// Load IDs
+#include "ProbabilityMass.hpp"		// Probability values
+
+namespace CoSSMic
+{
+
+class ProducerPriors
+{
+public:
+
+	// The probabilities are given as maps from the producer address to the
+	// probability of that producer, as stored by the consumer agent.
+
+	using ProbabilityMap = std::map< Theron::Address, Probability< double > >;
+
+private:
+
+	struct DevicePrior
+	{
+		std::uint32_t 									Loads = 0;
+		std::map< std::string, double > Probabilities;
+	};
+
+	std::unordered_map< std::string, DevicePrior > Priors;
+	mutable std::mutex 														 Lock;
+
+	// The weight of a new load is limited from below so that the prior keeps
+	// adapting after many loads.
+
+	static constexpr double MinimumWeight = 0.1;
+
+	// The file is only read once, and a flag records that this has been done.
+
+	bool Loaded;
+
+public:
+
+	// The device ID is the load ID without the mode
+
+	static std::string DeviceID( const IDType & LoadID );
+
+	// The prior of a device is copied into the given map if the device has a
+	// prior, and the function returns true if this was the case. Probabilities
+	// already in the map are not overwritten.
+
+	bool Prior( const IDType & LoadID, ProbabilityMap & Probabilities ) const;
+
+	// The probabilities learned by a consumer are averaged into the prior of
+	// its device.
+
+	void Update( const IDType & LoadID, const ProbabilityMap & Probabilities );
+
+	// Reading and writing the binary file in the given directory. Reading a
+	// missing or malformed file leaves the store empty, and it is only read
+	// the first time the function is called. Writing returns false if the
+	// file could not be written.
+
+	void Load( const std::string & Directory );
+	bool Save( const std::string & Directory ) const;
+
+	// There is one store per process, and it is loaded from the standard
+	// probability directory when it is first accessed.
+
+	static ProducerPriors & Store( void );
+
+	// The constructor creates an empty store
+
+	ProducerPriors( void )
+	: Priors(), Lock(), Loaded( false )
+	{}
+
+	ProducerPriors( const ProducerPriors & Other ) = delete;
+};
+
+}      // name space CoSSMic
+#endif // COSSMIC_PRODUCER_PRIORS
@@ -15,9 +15,12 @@
 #include <sstream>		  // Error messages and serialisation
 #include <fstream>		  // File output
 #include <stdexcept>		  // standard exceptions
+#include <cstdint>		  // Binary batch size
+#include <limits>		  // Checkpoint precision
 
 #include "Clock.hpp"		  // Transparent simulation and system clock
 #include "PresentationLayer.hpp"  // For serialised messages
+#include "BinaryPayload.hpp"      // Binary message codecs
 #include "ActorManager.hpp"	  // The orchestrator
 #include "Grid.hpp"		  // The standard Grid producer
 
@@ -90,6 +93,36 @@ bool RewardCalculator::NewPVEnergy::Deserialize(
     return false;
 }
 
+// The binary codec is used for the frequent reward dissemination, and it 
+// keeps the full precision of the energy value.
+
+Theron::SerialMessage::Payload 
+RewardCalculator::NewPVEnergy::BinarySerialize( void ) const
+{
+  Theron::BinaryWriter Message( "NEW_PV_ENERGY" );
+  
+  Message << EnergyValue << static_cast< const std::string & >( Producer );
+  
+  return Message.str();
+}
+
+bool RewardCalculator::NewPVEnergy::BinaryDeserialize( 
+  const Theron::SerialMessage::Payload & Payload )
+{
+  Theron::BinaryReader Message( Payload, "NEW_PV_ENERGY" );
+  std::string          TheProducer;
+  
+  EnergyValue = 0;
+  Message >> EnergyValue >> TheProducer;
+  
+  if ( !Message ) return false;
+  
+  if ( !TheProducer.empty() )
+    Producer = IDType( TheProducer );
+  
+  return true;
+}
+
 // The constructor of the message class simply invokes the above 
 // de-serialisation function, and if it fails it will throw an invalid argument 
 // with a descriptive message.
@@ -97,7 +130,7 @@ bool RewardCalculator::NewPVEnergy::Deserialize(
 RewardCalculator::NewPVEnergy::NewPVEnergy(
   const Theron::SerialMessage::Payload & Payload )
 {
-  if ( ! Deserialize( Payload ) )
+  if ( ! Decode( Payload ) )
   {
     std::ostringstream ErrorMessage;
     
@@ -125,7 +158,113 @@ void RewardCalculator::NewPVEnergyValue(
   // shared with the neighbourhood from a producer on this node. 
   
   if ( LocalProducers.find(EnergyMessage.ProducerID()) != LocalProducers.end() )
+  {
     TotalPVShared += EnergyMessage.Energy();  
+    
+    if ( Balance )
+      AddBalance( TimeInterval( Now() ), 
+                  EnergyBalance::Sums( 0.0, 0.0, 0.0, EnergyMessage.Energy() ) );
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Batches of PV energy values
+// -----------------------------------------------------------------------------
+//
+// The batch is serialised as the number of energy values followed by the 
+// energy and the producer ID of each value.
+
+Theron::SerialMessage::Payload 
+RewardCalculator::PVEnergyBatch::Serialize( void ) const
+{
+  std::ostringstream Message;
+  
+  Message << "PV_ENERGY_BATCH " << EnergyValues.size();
+  
+  for ( const NewPVEnergy & Value : EnergyValues )
+    Message << " " << Value.Energy() << " " << Value.ProducerID();
+  
+  return Message.str();
+}
+
+bool RewardCalculator::PVEnergyBatch::Deserialize( 
+  const Theron::SerialMessage::Payload & Payload )
+{
+  std::istringstream Message( Payload );
+  std::string Command;
+  std::size_t NumberOfValues = 0;
+  
+  Message >> Command;
+  
+  if ( Command != "PV_ENERGY_BATCH" ) return false;
+  
+  Message >> NumberOfValues;
+  EnergyValues.clear();
+  
+  for ( std::size_t i = 0; ( i < NumberOfValues ) && Message; i++ )
+  {
+    double Energy;
+    IDType Producer;
+    
+    Message >> Energy >> Producer;
+    EnergyValues.emplace_back( Energy, Producer );
+  }
+  
+  return static_cast< bool >( Message );
+}
+
+Theron::SerialMessage::Payload 
+RewardCalculator::PVEnergyBatch::BinarySerialize( void ) const
+{
+  Theron::BinaryWriter Message( "PV_ENERGY_BATCH" );
+  
+  Message << static_cast< std::uint64_t >( EnergyValues.size() );
+  
+  for ( const NewPVEnergy & Value : EnergyValues )
+    Message << Value.Energy() 
+						<< static_cast< const std::string & >( Value.ProducerID() );
+  
+  return Message.str();
+}
+
+bool RewardCalculator::PVEnergyBatch::BinaryDeserialize( 
+  const Theron::SerialMessage::Payload & Payload )
+{
+  Theron::BinaryReader Message( Payload, "PV_ENERGY_BATCH" );
+  std::uint64_t        NumberOfValues = 0;
+  
+  Message >> NumberOfValues;
+  EnergyValues.clear();
+  
+  for ( std::uint64_t i = 0; ( i < NumberOfValues ) && Message; i++ )
+  {
+    double      Energy;
+    std::string Producer;
+    
+    Message >> Energy >> Producer;
+    
+    if ( Producer.empty() )
+      EnergyValues.emplace_back( Energy, IDType() );
+    else
+      EnergyValues.emplace_back( Energy, IDType( Producer ) );
+  }
+  
+  return static_cast< bool >( Message );
+}
+
+// The batch handler uses the counter updates of this class for each value 
+// so that the derived handlers for single values do not reward the consumers
+// for each value.
+
+void RewardCalculator::NewPVEnergyBatch( 
+  const RewardCalculator::PVEnergyBatch & TheBatch, 
+  const Theron::Address Sender )
+{
+  for ( const NewPVEnergy & Value : TheBatch.Values() )
+    RewardCalculator::NewPVEnergyValue( Value, Sender );
+  
+  if ( !TheBatch.Values().empty() )
+    RewardConsumers();
 }
 
 // A derived class must call the function to save the node reward file once 
@@ -162,6 +301,16 @@ void RewardCalculator::NewConsumer(
   ActiveConsumers.insert( ConsumerRequest.GetAddress() );
 }
 
+// The bulk request uses the possibly overloaded handler for single consumers.
+
+void RewardCalculator::NewConsumers( 
+  const RewardCalculator::AddConsumers & ConsumerRequests, 
+  const Theron::Address Sender )
+{
+  for ( const Theron::Address & TheConsumer : ConsumerRequests )
+    NewConsumer( AddConsumer( TheConsumer ), Sender );
+}
+
 // -----------------------------------------------------------------------------
 // Load finished - compute the reward
 // -----------------------------------------------------------------------------
@@ -173,12 +322,27 @@ void RewardCalculator::NewEnergy(
   const RewardCalculator::AddEnergy & EnergyMessage, 
   const Theron::Address Sender )
 {
-  // Dispatch to the other reward calculators only if this is PV energy
+  // Dispatch to the other reward calculators only if this is PV energy. The 
+  // energy is sent immediately if there is no dissemination window, otherwise
+  // it is kept for the batch and the window is opened if it is not already.
   
   if ( EnergyMessage.Producer() != Grid::ID() )
-    for ( const Theron::Address & Calculator : RewardCalculators )
-      Send( NewPVEnergy( EnergyMessage.Energy(), EnergyMessage.Producer() ), 
-	    Calculator );
+  {
+    if ( DisseminationWindow == std::chrono::milliseconds::zero() )
+      for ( const Theron::Address & Calculator : RewardCalculators )
+				Send( NewPVEnergy( EnergyMessage.Energy(), EnergyMessage.Producer() ), 
+							Calculator );
+    else
+    {
+      PendingEnergy.emplace_back( EnergyMessage.Energy(), 
+																  EnergyMessage.Producer() );
+      
+      if ( WindowTimer == Theron::TimerWheel::NullTimer )
+				WindowTimer = Theron::TimerWheel::Service().ScheduleMessage(
+					std::chrono::duration_cast< Theron::TimerWheel::Duration >( 
+						DisseminationWindow ), CloseWindow(), GetAddress(), GetAddress() );
+    }
+  }
 
   // The consumer will be removed by the Actor Manager once it has received 
   // its reward, and it should therefore no longer be considered an active 
@@ -186,12 +350,274 @@ void RewardCalculator::NewEnergy(
 
   ActiveConsumers.erase( EnergyMessage.Consumer() );
   
+  // The energy of the load is consumed by this household, and it is PV 
+  // energy unless it came from the grid.
+  
+  if ( Balance )
+  {
+    AddBalance( TimeInterval( Now() ), EnergyBalance::Sums( EnergyMessage.Energy(),
+      EnergyMessage.Producer() != Grid::ID() ? EnergyMessage.Energy() : 0.0 ) );
+    
+    CloseBalanceWindows();
+  }
+  
   // Finally, the message can be acknowledged so that the consumer may be 
   // deleted by the actor manager.
   
   Send( ActorManager::AcknowledgeEnergy( EnergyMessage.Consumer() ), Sender );
 }
 
+// When the window closes, the pending energy values are sent as one batch to 
+// each peer calculator, and the next energy value will open a new window.
+
+void RewardCalculator::SendPendingEnergy( 
+  const RewardCalculator::CloseWindow & TheTimeOut, 
+  const Theron::Address TheCalculator )
+{
+  WindowTimer = Theron::TimerWheel::NullTimer;
+  
+  if ( !PendingEnergy.empty() )
+  {
+    PVEnergyBatch TheBatch( PendingEnergy );
+    
+    for ( const Theron::Address & Calculator : RewardCalculators )
+      Send( TheBatch, Calculator );
+    
+    PendingEnergy.clear();
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Energy balance
+// -----------------------------------------------------------------------------
+//
+// The deltas are added to the balance of this household if the balance is 
+// kept, and otherwise they are ignored.
+
+void RewardCalculator::NewEnergyDelta( 
+  const RewardCalculator::EnergyDelta & TheDelta, 
+  const Theron::Address TheProducer )
+{
+  if ( Balance )
+  {
+    AddBalance( TheDelta.Interval, 
+      EnergyBalance::Sums( TheDelta.Consumption, 0.0, TheDelta.Production ) );
+    
+    CloseBalanceWindows();
+  }
+}
+
+// The deltas of this household are added both to the balance and to the
+// windows not yet sent.
+
+void RewardCalculator::AddBalance( const TimeInterval & Interval, 
+                                   const EnergyBalance::Sums & Delta )
+{
+  Balance->Add( Interval, Household, Delta );
+  UnsentBalance->Add( Interval, Household, Delta );
+}
+
+// The windows to send are taken from a block of the windows of this 
+// household.
+
+RewardCalculator::BalanceWindows::BalanceWindows( 
+  const EnergyBalance::Block & TheWindows )
+: Windows()
+{
+  Windows.reserve( TheWindows.size() );
+  
+  for ( std::size_t i = 0; i < TheWindows.size(); i++ )
+    Windows.emplace_back( TheWindows.Start[i], 
+      EnergyBalance::Sums( TheWindows.Consumption[i], 
+        TheWindows.PVConsumption[i], TheWindows.Production[i], 
+        TheWindows.Shared[i] ) );
+}
+
+// The balance windows are serialised as the number of windows followed by 
+// the start time and the four sums of each window.
+
+Theron::SerialMessage::Payload 
+RewardCalculator::BalanceWindows::Serialize( void ) const
+{
+  std::ostringstream Message;
+  
+  Message.precision( std::numeric_limits<double>::digits10 );
+  Message << "BALANCE_WINDOWS " << Windows.size();
+  
+  for ( const auto & Window : Windows )
+    Message << " " << Window.first 
+            << " " << Window.second.Consumption 
+            << " " << Window.second.PVConsumption
+            << " " << Window.second.Production 
+            << " " << Window.second.Shared;
+  
+  return Message.str();
+}
+
+bool RewardCalculator::BalanceWindows::Deserialize( 
+  const Theron::SerialMessage::Payload & Payload )
+{
+  std::istringstream Message( Payload );
+  std::string Command;
+  std::size_t NumberOfWindows = 0;
+  
+  Message >> Command;
+  
+  if ( Command != "BALANCE_WINDOWS" ) return false;
+  
+  Message >> NumberOfWindows;
+  Windows.clear();
+  
+  for ( std::size_t i = 0; ( i < NumberOfWindows ) && Message; i++ )
+  {
+    Time               Start;
+    EnergyBalance::Sums Values;
+    
+    Message >> Start >> Values.Consumption >> Values.PVConsumption 
+            >> Values.Production >> Values.Shared;
+    Windows.emplace_back( Start, Values );
+  }
+  
+  return static_cast< bool >( Message );
+}
+
+Theron::SerialMessage::Payload 
+RewardCalculator::BalanceWindows::BinarySerialize( void ) const
+{
+  Theron::BinaryWriter Message( "BALANCE_WINDOWS" );
+  
+  Message << static_cast< std::uint64_t >( Windows.size() );
+  
+  for ( const auto & Window : Windows )
+    Message << Window.first << Window.second.Consumption 
+            << Window.second.PVConsumption << Window.second.Production 
+            << Window.second.Shared;
+  
+  return Message.str();
+}
+
+bool RewardCalculator::BalanceWindows::BinaryDeserialize( 
+  const Theron::SerialMessage::Payload & Payload )
+{
+  Theron::BinaryReader Message( Payload, "BALANCE_WINDOWS" );
+  std::uint64_t        NumberOfWindows = 0;
+  
+  Message >> NumberOfWindows;
+  Windows.clear();
+  
+  for ( std::uint64_t i = 0; ( i < NumberOfWindows ) && Message; i++ )
+  {
+    Time               Start;
+    EnergyBalance::Sums Values;
+    
+    Message >> Start >> Values.Consumption >> Values.PVConsumption 
+            >> Values.Production >> Values.Shared;
+    Windows.emplace_back( Start, Values );
+  }
+  
+  return static_cast< bool >( Message );
+}
+
+// The windows of a peer are merged under the household name of the peer. A
+// window of a peer arriving after the window has been recorded is recorded 
+// with the next block.
+
+void RewardCalculator::MergeBalance( 
+  const RewardCalculator::BalanceWindows & TheWindows, 
+  const Theron::Address TheCalculator )
+{
+  if ( Balance )
+  {
+    std::string Peer( HouseholdName( TheCalculator ) );
+    
+    for ( const auto & Window : TheWindows.Values() )
+      Balance->Add( Window.first, Peer, Window.second );
+  }
+}
+
+// Closing the windows sends the windows of this household that have ended 
+// to the peers, and records the windows that ended one window width earlier.
+// When all windows are closed, the current window is taken as ended.
+
+void RewardCalculator::CloseBalanceWindows( bool CloseAll )
+{
+  if ( !Balance ) return;
+  
+  Time Width   = Balance->WindowWidth(),
+       Current = Balance->WindowStart( Now() ) + ( CloseAll ? Width : 0 );
+  
+  if ( Current <= NextBalanceWindow ) return;
+  
+  BalanceWindows Closed( UnsentBalance->Extract( Current ) );
+  
+  if ( !Closed.Values().empty() )
+    for ( const Theron::Address & Calculator : RewardCalculators )
+      Send( Closed, Calculator );
+  
+  NextBalanceWindow = Current;
+  
+  EnergyBalance::Block Completed( 
+    Balance->Extract( CloseAll ? Current : Current - Width ) );
+  
+  if ( BalanceWriter && !Completed.empty() )
+    Send( Completed, BalanceWriter->GetAddress() );
+}
+
+// The timer closes the windows and is restarted for the next window.
+
+void RewardCalculator::BalanceTimeOut( 
+  const RewardCalculator::CloseBalance & TheTimeOut, 
+  const Theron::Address TheCalculator )
+{
+  CloseBalanceWindows();
+  
+  BalanceTimer = Theron::TimerWheel::Service().ScheduleMessage(
+    std::chrono::duration_cast< Theron::TimerWheel::Duration >( 
+      std::chrono::seconds( Balance->WindowWidth() ) ), 
+    CloseBalance(), GetAddress(), GetAddress() );
+}
+
+std::string 
+RewardCalculator::HouseholdName( const Theron::Address & TheCalculator )
+{
+  std::string Name( TheCalculator.AsString() );
+  std::size_t Root = Name.find( NameRoot );
+  
+  if ( Root == std::string::npos )
+    return Name;
+  else
+    return Name.substr( Root + std::string( NameRoot ).size() );
+}
+
+// Enabling the balance creates the recorder if a file is given and starts 
+// the timer. It is not possible to enable the balance twice, and a logic 
+// error exception is thrown if this is attempted.
+
+void RewardCalculator::RecordEnergyBalance( Time WindowWidth, 
+                                            const std::string & FileName )
+{
+  if ( Balance )
+  {
+    std::ostringstream ErrorMessage;
+    
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+						     << "Reward calculator: The energy balance is already kept";
+		 
+    throw std::logic_error( ErrorMessage.str() );
+  }
+  
+  Balance       = std::make_unique< EnergyBalance >( WindowWidth );
+  UnsentBalance = std::make_unique< EnergyBalance >( WindowWidth );
+  
+  if ( !FileName.empty() )
+    BalanceWriter = std::make_unique< BalanceRecorder >( FileName, 
+      WindowWidth, GetAddress().AsString() + "Balance" );
+  
+  NextBalanceWindow = Balance->WindowStart( Now() );
+  
+  BalanceTimeOut( CloseBalance(), GetAddress() );
+}
+
 // -----------------------------------------------------------------------------
 // Detecting peer reward calculators
 // -----------------------------------------------------------------------------
@@ -244,6 +670,21 @@ bool RewardCalculator::Shutdown::Deserialize(
     return false;
 }
 
+// The binary shut down message is just the tag
+
+Theron::SerialMessage::Payload 
+RewardCalculator::Shutdown::BinarySerialize( void ) const
+{
+  return Theron::BinaryWriter( "REWARD_CALCULATOR_SHUTDOWN" ).str();
+}
+
+bool RewardCalculator::Shutdown::BinaryDeserialize(
+  const Theron::SerialMessage::Payload & Payload)
+{
+  return static_cast< bool >( 
+				 Theron::BinaryReader( Payload, "REWARD_CALCULATOR_SHUTDOWN" ) );
+}
+
 // The payload constructor attempt to de-serialise the payload and if it works
 // then the message is of the right type; otherwise the standard exception is 
 // thrown
@@ -252,7 +693,7 @@ RewardCalculator::Shutdown::Shutdown(
   const Theron::SerialMessage::Payload & Payload )
 : Shutdown()
 {
-  if ( ! Deserialize( Payload ) )
+  if ( ! Decode( Payload ) )
   {
     std::ostringstream ErrorMessage;
     
@@ -273,17 +714,60 @@ void RewardCalculator::ForgetCalculator(
   RewardCalculators.erase( ClosingCalculator );
 }
 
+/*****************************************************************************
+  Checkpoint
+******************************************************************************/
+//
+// The counters are written on the first line of the rewards file with full 
+// precision, followed by the state of the derived calculator.
+
+void RewardCalculator::SaveCheckpoint( const Checkpoint & TheCheckpoint, 
+																			 const Theron::Address TheActorManager )
+{
+  std::ofstream CheckpointFile( TheCheckpoint.File( "Rewards.dta" ) );
+  
+  CheckpointFile.precision( std::numeric_limits<double>::digits10 );
+  CheckpointFile << NeighbourhoodPVEnergy << " " << TotalPVShared << std::endl;
+  
+  WriteState( CheckpointFile );
+}
+
+void RewardCalculator::RestoreCheckpoint( const std::string & Directory )
+{
+  std::ifstream CheckpointFile( Directory + "/Rewards.dta" );
+  
+  if ( !CheckpointFile.good() )
+  {
+    std::ostringstream ErrorMessage;
+    
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+						     << "Reward calculator: No rewards file in the checkpoint "
+						     << Directory;
+		 
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+  
+  CheckpointFile >> NeighbourhoodPVEnergy >> TotalPVShared;
+  
+  ReadState( CheckpointFile );
+}
+
 /*****************************************************************************
   Constructor and destructor
 ******************************************************************************/
 
-RewardCalculator::RewardCalculator( const std::string & Location )
+RewardCalculator::RewardCalculator( const std::string & Location, 
+																	  std::chrono::milliseconds BatchWindow )
 : Actor( std::string( NameRoot ) + Location ), 
   StandardFallbackHandler( GetAddress().AsString() ),
   DeserializingActor( GetAddress().AsString() ),
   ActiveConsumers(), RewardCalculators(),
   SessionServer( Theron::Network::GetAddress(Theron::Network::Layer::Session) ),
-  LocalProducers()
+  LocalProducers(), DisseminationWindow( BatchWindow ), PendingEnergy(),
+  WindowTimer( Theron::TimerWheel::NullTimer ), Balance(), UnsentBalance(), 
+  BalanceWriter(),
+  Household( Location ), NextBalanceWindow( 0 ), 
+  BalanceTimer( Theron::TimerWheel::NullTimer )
 {
   NeighbourhoodPVEnergy = 0.0;
   TotalPVShared         = 0.0;
@@ -293,10 +777,17 @@ RewardCalculator::RewardCalculator( const std::string & Location )
   RegisterHandler( this, &RewardCalculator::RegisterProducer );
   RegisterHandler( this, &RewardCalculator::NewPVEnergyValue );
   RegisterHandler( this, &RewardCalculator::NewConsumer      );
+  RegisterHandler( this, &RewardCalculator::NewConsumers     );
   RegisterHandler( this, &RewardCalculator::NewEnergy        );
   RegisterHandler( this, &RewardCalculator::AddCalculator    );
   RegisterHandler( this, &RewardCalculator::RemoveCalculator );
   RegisterHandler( this, &RewardCalculator::ForgetCalculator );
+  RegisterHandler( this, &RewardCalculator::NewPVEnergyBatch );
+  RegisterHandler( this, &RewardCalculator::SendPendingEnergy );
+  RegisterHandler( this, &RewardCalculator::SaveCheckpoint   );
+  RegisterHandler( this, &RewardCalculator::NewEnergyDelta   );
+  RegisterHandler( this, &RewardCalculator::MergeBalance     );
+  RegisterHandler( this, &RewardCalculator::BalanceTimeOut   );
   
   // Finally, the subscription is made to the session layer to be informed 
   // about new peer agents known to the system.
@@ -305,13 +796,27 @@ RewardCalculator::RewardCalculator( const std::string & Location )
 }
 
 // The destructor will first stop the subscription for peer reward calculators,
-// then tell the other peer reward calculators that this calculator is stopping
-// before it de-registers with the session server.
+// then send the energy values of an open dissemination window and the open
+// balance windows, and finally tell the other peer reward calculators that 
+// this calculator is stopping before it de-registers with the session server.
+// The recorder writes the last balances before it is destroyed.
 
 RewardCalculator::~RewardCalculator()
 {
   Send( Theron::SessionLayerMessages::NewPeerUnsubscription(), SessionServer );
   
+  if ( WindowTimer != Theron::TimerWheel::NullTimer )
+  {
+    Theron::TimerWheel::Service().Cancel( WindowTimer );
+    SendPendingEnergy( CloseWindow(), GetAddress() );
+  }
+  
+  if ( Balance )
+  {
+    Theron::TimerWheel::Service().Cancel( BalanceTimer );
+    CloseBalanceWindows( true );
+  }
+  
   for ( const Theron::Address & RemoteCalculator : RewardCalculators )
     Send( Shutdown(), RemoteCalculator );
 }
@@ -23,7 +23,12 @@
   
   3. The reward calculator will then inform all peer reward calculators about 
      this newly closed energy transaction so that they are able to reward the 
-     consumers and producers on the other nodes in the system. 
+     consumers and producers on the other nodes in the system. When many loads
+     finish at the same time, this creates a message from every node to every
+     other node for every load. The calculator can therefore be given a 
+     dissemination window, and the energy transactions closed within the 
+     window are then sent as one batch to each peer, which rewards its 
+     consumers once for the whole batch.
      
   The reward calculator maintains three sets:
   
@@ -38,6 +43,15 @@
   In addition it maintains a counter for the total PV energy produced in the 
   neighbourhood and the total PV energy shared by the producers on this node.
   
+  The calculator can also keep the energy balance of the households per time
+  window, see EnergyBalance. The consumption is taken from the energy of the
+  finished loads and the shared energy from the PV energy values of the 
+  peers, while the production is reported as energy deltas by the producers.
+  When a window has passed, the balance of this household is sent to the 
+  peers, which merge it with their own balances, and the balances of all 
+  households are written by a recorder one window later so that the peers
+  have time to report.
+  
   Author: Geir Horn, University of Oslo, 2016
   Contact: Geir.Horn [at] mn.uio.no
   License: LGPL3.0
@@ -48,6 +62,11 @@
 
 #include <set>			            		// To store consumers and remote SVR agents
 #include <unordered_set>	 					// Keeping the IDs of local producers
+#include <vector>										// Batched energy transactions
+#include <chrono>										// The dissemination window
+#include <iostream>									// Checkpoint streams
+#include <memory>										// The energy balance
+#include <utility>									// Balance windows
 
 #include "Actor.hpp"	 							// The Theron++ actor framework
 #include "StandardFallbackHandler.hpp"
@@ -57,6 +76,9 @@
 #include "NetworkEndPoint.hpp"  		// To allow the calculator to be an agent
 #include "IDType.hpp"		 						// The CoSSMic agent ID
 #include "AddressHash.hpp"	 				// For Theron Addresses in unordered maps
+#include "TimerWheel.hpp"						// Closing the dissemination window
+#include "Checkpoint.hpp"						// Snapshots of the household state
+#include "EnergyBalance.hpp"				// Energy balance per time window
 
 namespace CoSSMic
 {
@@ -219,6 +241,10 @@ public:
 	    Serialize( void ) const override;
     virtual bool
 	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
 
     // The explicit constructor simply sets the energy value
     
@@ -264,6 +290,67 @@ protected:
   virtual void NewPVEnergyValue( const NewPVEnergy & EnergyMessage, 
 												         const Theron::Address Sender       );
 
+  // A derived calculator distributing rewards to the local consumers should 
+  // do so in the following function, which is called once after all the 
+  // energy values of a batch have been accounted for. By default there are 
+  // no rewards to distribute.
+  
+  virtual void RewardConsumers( void )
+  { }
+
+  // ---------------------------------------------------------------------------
+  // MESSAGE: Batch of PV energy values
+  // ---------------------------------------------------------------------------
+  //
+  // When the calculator has a dissemination window, the PV energy values of 
+  // the loads finished within the window are sent together to each peer.
+  
+public:
+  
+  class PVEnergyBatch : public Theron::SerialMessage
+  {
+  private:
+    
+    std::vector< NewPVEnergy > EnergyValues;
+    
+  public:
+    
+    inline const std::vector< NewPVEnergy > & Values( void ) const
+    { return EnergyValues; }
+    
+    virtual Theron::SerialMessage::Payload 
+	    Serialize( void ) const override;
+    virtual bool
+	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
+    
+    PVEnergyBatch( const std::vector< NewPVEnergy > & TheValues )
+    : EnergyValues( TheValues )
+    { }
+    
+    PVEnergyBatch( const PVEnergyBatch & OtherMessage )
+    : EnergyValues( OtherMessage.EnergyValues )
+    { }
+    
+    PVEnergyBatch( void )
+    : EnergyValues()
+    { }
+    
+    virtual ~PVEnergyBatch( void )
+    { }
+  };
+  
+  // The handler accounts for all the energy values of the batch as if they 
+  // were received one by one, and then rewards the local consumers once.
+  
+protected:
+  
+  void NewPVEnergyBatch( const PVEnergyBatch & TheBatch, 
+												 const Theron::Address Sender );
+
   // After the energy has been used by a derived message handler to compute 
   // the reward, this should be saved as a reward file to be used by the other
   // parts of the CoSSMic system. 
@@ -321,6 +408,28 @@ protected:
   
   virtual void NewConsumer( const AddConsumer & ConsumerRequest, 
 			    const Theron::Address Sender );
+  
+  // When the Actor Manager creates many consumers at the same time, they are 
+  // added with one message carrying all their addresses. The handler treats
+  // each address as if it had been received in an add consumer message.
+  
+public:
+  
+  class AddConsumers : public std::vector< Theron::Address >
+  {
+  public:
+    
+    AddConsumers( const std::vector< Theron::Address > & ConsumerAddresses )
+    : std::vector< Theron::Address >( ConsumerAddresses )
+    { }
+    
+    AddConsumers( const AddConsumers & Other ) = default;
+  };
+  
+protected:
+  
+  void NewConsumers( const AddConsumers & ConsumerRequests, 
+								     const Theron::Address Sender );
 
   // Note that there is no need to reverse this process since the New Energy 
   // handler below will automatically delete the consumer from the active set
@@ -376,6 +485,150 @@ protected:
   virtual void NewEnergy( const AddEnergy & EnergyMessage, 
 												  const Theron::Address Sender    );
   
+  // ---------------------------------------------------------------------------
+  // Dissemination window
+  // ---------------------------------------------------------------------------
+  //
+  // With a zero window the PV energy of a finished load is sent to the peers 
+  // immediately. Otherwise, the energy values are kept until the window 
+  // closes, and the window is opened by the first energy value after the 
+  // previous batch was sent. The timer wheel sends the close window message 
+  // to this calculator when the window expires.
+  
+private:
+  
+  std::chrono::milliseconds   DisseminationWindow;
+  std::vector< NewPVEnergy >  PendingEnergy;
+  Theron::TimerWheel::TimerID WindowTimer;
+  
+  class CloseWindow
+  { };
+  
+  void SendPendingEnergy( const CloseWindow & TheTimeOut, 
+												  const Theron::Address TheCalculator );
+  
+  // ---------------------------------------------------------------------------
+  // Energy balance
+  // ---------------------------------------------------------------------------
+  //
+  // The balance is kept only if it has been enabled, and it is then kept for 
+  // this household under the name of the household and for the peers under 
+  // their household names. The deltas of this household are also kept in a 
+  // separate balance until they are sent to the peers, so that a delta 
+  // arriving late for a window already sent will be sent with the next 
+  // windows. The next balance window is the first window that has not yet 
+  // ended when the windows were last closed.
+  
+private:
+  
+  std::unique_ptr< EnergyBalance >   Balance, UnsentBalance;
+  std::unique_ptr< BalanceRecorder > BalanceWriter;
+  std::string                        Household;
+  Time                               NextBalanceWindow;
+  Theron::TimerWheel::TimerID        BalanceTimer;
+  
+  // The producers report the energy they have produced over an interval, and
+  // other actors may report the consumption over an interval in the same way.
+  // This is an internal message of the node.
+  
+public:
+  
+  class EnergyDelta
+  {
+  public:
+    
+    TimeInterval Interval;
+    double       Consumption, Production;
+    
+    EnergyDelta( const TimeInterval & TheInterval, double TheConsumption, 
+                 double TheProduction )
+    : Interval( TheInterval ), Consumption( TheConsumption ), 
+      Production( TheProduction )
+    { }
+    
+    EnergyDelta( const EnergyDelta & Other ) = default;
+  };
+  
+protected:
+  
+  void NewEnergyDelta( const EnergyDelta & TheDelta, 
+                       const Theron::Address TheProducer );
+  
+  // The completed windows of a household are sent to the peers as the start 
+  // time of each window and its sums.
+  
+public:
+  
+  class BalanceWindows : public Theron::SerialMessage
+  {
+  private:
+    
+    std::vector< std::pair< Time, EnergyBalance::Sums > > Windows;
+    
+  public:
+    
+    inline const std::vector< std::pair< Time, EnergyBalance::Sums > > & 
+    Values( void ) const
+    { return Windows; }
+    
+    virtual Theron::SerialMessage::Payload 
+	    Serialize( void ) const override;
+    virtual bool
+	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
+    
+    BalanceWindows( const EnergyBalance::Block & TheWindows );
+    
+    BalanceWindows( const BalanceWindows & Other )
+    : Windows( Other.Windows )
+    { }
+    
+    BalanceWindows( void )
+    : Windows()
+    { }
+    
+    virtual ~BalanceWindows( void )
+    { }
+  };
+  
+private:
+  
+  void MergeBalance( const BalanceWindows & TheWindows, 
+                     const Theron::Address TheCalculator );
+  
+  // The windows are closed when a delta arrives after the end of the next 
+  // balance window, and by a timer every window width so that the windows 
+  // are also closed when there is no activity. The windows are all closed 
+  // when the calculator is destroyed.
+  
+  class CloseBalance
+  { };
+  
+  void AddBalance( const TimeInterval & Interval, 
+                   const EnergyBalance::Sums & Delta );
+  
+  void CloseBalanceWindows( bool CloseAll = false );
+  
+  void BalanceTimeOut( const CloseBalance & TheTimeOut, 
+                       const Theron::Address TheCalculator );
+  
+  // The household name of a calculator is its actor name without the name 
+  // root.
+  
+  static std::string HouseholdName( const Theron::Address & TheCalculator );
+  
+  // The balance is enabled with the width of the windows and optionally the 
+  // name of the file where the balances are recorded. It should be enabled 
+  // just after the calculator has been constructed.
+  
+public:
+  
+  void RecordEnergyBalance( Time WindowWidth = EnergyBalance::DefaultWidth,
+                            const std::string & FileName = std::string() );
+  
   // ---------------------------------------------------------------------------
   // Detecting peer reward calculators
   // ---------------------------------------------------------------------------
@@ -386,6 +639,8 @@ protected:
   // therefore constructed from a fixed name root, extended by the domain name 
   // of the node (typically the symbolic IP address of the endpoint)
   
+protected:
+  
   constexpr static auto NameRoot = "RewardCalculator_";
   
   // As the peers become known to the session layer it will notify the 
@@ -423,6 +678,10 @@ private:
 	    Serialize( void ) const override;
     virtual bool
 	    Deserialize( const Theron::SerialMessage::Payload & Payload) override;
+    virtual Theron::SerialMessage::Payload 
+	    BinarySerialize( void ) const override;
+    virtual bool 
+	    BinaryDeserialize( const Theron::SerialMessage::Payload & Payload) override;
 
     // The default constructor is empty since the class is not storing any 
     // information.
@@ -455,21 +714,55 @@ private:
   void ForgetCalculator( const Shutdown & ShutdownMessage, 
 			 const Theron::Address ClosingCalculator );
   
+  // ---------------------------------------------------------------------------
+  // Checkpoint
+  // ---------------------------------------------------------------------------
+  //
+  // The energy counters are written to the rewards file of a checkpoint when 
+  // the checkpoint is forwarded from the Actor Manager. Derived calculators 
+  // keeping additional state, like the energy exchange graph of the Shapley 
+  // value reward, add their state to the same file by overriding the state 
+  // writer, and read it back in the same order by the state reader.
+	
+protected:
+	
+	virtual void SaveCheckpoint( const Checkpoint & TheCheckpoint, 
+															 const Theron::Address TheActorManager );
+	
+	virtual void WriteState( std::ostream & CheckpointFile )
+	{ }
+	
+	virtual void ReadState( std::istream & CheckpointFile )
+	{ }
+	
+	// The state is restored from a checkpoint directory before the calculator 
+	// starts receiving messages, i.e. just after it has been constructed. It 
+	// will throw an invalid argument exception if the checkpoint does not have
+	// a rewards file.
+	
+public:
+	
+	void RestoreCheckpoint( const std::string & Directory );
+	
   // ---------------------------------------------------------------------------
   // Constructor and destructor
   // ---------------------------------------------------------------------------
   // 
 	// There should be only one reward calculator per household, so the household 
 	// ID is taken as a location parameter and added to the name of the actor.
+	// The dissemination window is by default zero, and the energy values are 
+	// then sent to the peers immediately.
 	
 public:
   
-  RewardCalculator( const std::string & Location );
+  RewardCalculator( const std::string & Location, 
+								    std::chrono::milliseconds BatchWindow 
+										  = std::chrono::milliseconds::zero() );
   
   // The destructor must be virtual to ensure that the classes are destroyed
   // in the right order. At this level it only de-register the subscription 
-  // for new peer reward calculators, and inform the other reward calculators
-  // that this calculator stops.
+  // for new peer reward calculators, sends any pending energy values, and 
+  // inform the other reward calculators that this calculator stops.
   
   virtual ~RewardCalculator();
 
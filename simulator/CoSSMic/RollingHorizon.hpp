@@ -0,0 +1,79 @@
+/*=============================================================================
+  Rolling Horizon
+
+  A deployment of the scheduler may run for months, and some of the state kept
+  by the actors grows with the history rather than with the active loads: The
+  rows of the energy exchange graph of consumers that no longer run, the
+  probabilities the consumer agents remember for producers that have left,
+  and the past part of the production predictions. The rolling horizon is the
+  time in seconds such state is kept after it was last used. State older than
+  the horizon is evicted, or compacted into aggregates where it still
+  contributes to the rewards, so that the footprint and the look-up cost stay
+  flat over time.
+
+  The horizon is process wide and read by the actors when they decide what
+  to evict. It should be much longer than the scheduling window, typically
+  days or weeks. A horizon of zero, the default, keeps all state as before.
+
+  Author: Geir Horn, University of Oslo, 2019
+  Contact: Geir.Horn [at] mn.uio.no
+  License: LGPL3.0
+=============================================================================*/
+
+#ifndef COSSMIC_ROLLING_HORIZON
+#define COSSMIC_ROLLING_HORIZON
+
+#include <atomic>									// The horizon is read by many actors
+#include <sstream>								// For nicely formatted errors
+#include <stdexcept>							// Standard exceptions
+
+#include "TimeInterval.hpp"				// CoSSMic time
+
+namespace CoSSMic
+{
+
+class RollingHorizon
+{
+private:
+
+	static inline std::atomic< Time > Horizon{ 0 };
+
+public:
+
+	// Setting a negative horizon throws an invalid argument exception
+
+	static void Set( Time Seconds )
+	{
+		if ( Seconds < 0 )
+		{
+			std::ostringstream ErrorMessage;
+
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "The rolling horizon cannot be negative, and "
+									 << Seconds << " seconds is";
+
+			throw std::invalid_argument( ErrorMessage.str() );
+		}
+
+		Horizon.store( Seconds, std::memory_order_relaxed );
+	}
+
+	static Time Get( void )
+	{ return Horizon.load( std::memory_order_relaxed ); }
+
+	static bool Enabled( void )
+	{ return Get() > 0; }
+
+	// State last used at a given time has expired if the horizon is enabled
+	// and the time is more than the horizon before now.
+
+	static bool Expired( Time LastUse, Time CurrentTime )
+	{
+		Time Seconds = Get();
+
+		return ( Seconds > 0 ) && ( CurrentTime - LastUse > Seconds );
+	}
+};
+
+}      // name space CoSSMic
+#endif // COSSMIC_ROLLING_HORIZON
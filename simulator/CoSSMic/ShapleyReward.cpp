@@ -11,7 +11,7 @@
 =============================================================================*/
 
 #include <stdexcept>		        // Standard exceptions
-#include <armadillo>		        // For matrix support
+#include <utility>              // Swapping rows
 
 #ifdef CoSSMic_DEBUG
   #include "ConsolePrint.hpp"   // Debug messages
@@ -19,22 +19,8 @@
 
 #include "ConsumerAgent.hpp"	  // The receivers of the reward
 #include "ShapleyReward.hpp"	  // The reward calculator
-
-// When adding up elements in a matrix the sum can be made row wise or 
-// column wise. For some reason Armadillo expects these to be given as numeric 
-// values, whereas they should have been strongly typed enumerations. They 
-// are defined here as normal enumerations because they must be converted to 
-// the numeric values expected by the Armadillo functions, and strongly typed
-// enumerations cannot be implicitly converted, even if the underlying storage
-// type is explicitly specified.
-
-namespace arma {
-  enum Sum : uword
-  {
-    Columns = 0,
-    Rows    = 1
-  };
-}
+#include "Clock.hpp"            // The time of last use
+#include "RollingHorizon.hpp"   // Evicting rows not recently used
 
 namespace CoSSMic 
 {
@@ -46,9 +32,9 @@ namespace CoSSMic
 // New consumer created on the local node
 // -----------------------------------------------------------------------------
 // There are two cases to consider: The consumer is created for the first time, 
-// and the energy exchange matrix should be extended with a row for this 
+// and the energy exchange graph should be extended with a row for this 
 // consumer. On the other hand, if the consumer already has a row in the energy 
-// exchange matrix, it means that the consumer actor is re-created to serve 
+// exchange graph, it means that the consumer actor is re-created to serve 
 // another load. 
 
 void ShapleyValueReward::NewConsumer( 
@@ -60,15 +46,66 @@ void ShapleyValueReward::NewConsumer(
   if (ConsumerIndex.find( ConsumerRequest.GetAddress() ) == ConsumerIndex.end())
   {
     // Store the index that this new consumer will have in the enlarged 
-    // energy exchange matrix since the index is in the interval [0,n-1],
+    // energy exchange graph since the index is in the interval [0,n-1],
     // the number of rows (n) will be the index of the new row.
       
-    ConsumerIndex.emplace(ConsumerRequest.GetAddress(), EnergyExchange.n_rows);
+    ConsumerIndex.emplace(ConsumerRequest.GetAddress(), EnergyExchange.size());
     
-    // Then extend the energy exchange matrix with one row for this consumer
+    // Then extend the energy exchange graph with an empty row and a zero 
+    // Shapley value for this consumer. 
     
-    EnergyExchange.resize( EnergyExchange.n_rows + 1, EnergyExchange.n_cols );
+    EnergyExchange.emplace_back();
+    ShapleyValues.push_back( 0.0 );
+    LastUsed.push_back( Now() );
   }
+  else
+    LastUsed[ ConsumerIndex.at( ConsumerRequest.GetAddress() ) ] = Now();
+}
+
+// -----------------------------------------------------------------------------
+// Evicting expired rows
+// -----------------------------------------------------------------------------
+//
+// A row can only be evicted if its consumer is not currently active and it 
+// has not been used within the rolling horizon. The evicted row is replaced 
+// by the last row of the graph so that the rows remain contiguous, and the 
+// index of the consumer owning the moved row is updated. The consumer of each
+// row is found by inverting the consumer index once, and the inverse is kept
+// consistent as rows are moved. The rows are scanned backwards so that the 
+// row moved into an evicted position has already been tested.
+
+void ShapleyValueReward::EvictExpiredRows( Time CurrentTime )
+{
+  std::vector< Theron::Address > RowConsumer( EnergyExchange.size() );
+  
+  for ( auto & Row : ConsumerIndex )
+    RowConsumer[ Row.second ] = Row.first;
+  
+  for ( Index Row = EnergyExchange.size(); Row-- > 0; )
+    if ( ( GetConsumers().count( RowConsumer[ Row ] ) == 0 ) &&
+				 RollingHorizon::Expired( LastUsed[ Row ], CurrentTime ) )
+    {
+      for ( auto & Edge : EnergyExchange[ Row ] )
+				RetiredExchange[ Edge.first ] += Edge.second;
+      
+      ConsumerIndex.erase( RowConsumer[ Row ] );
+      
+      Index LastRow = EnergyExchange.size() - 1;
+      
+      if ( Row != LastRow )
+      {
+				std::swap( EnergyExchange[ Row ], EnergyExchange[ LastRow ] );
+				ShapleyValues[ Row ] = ShapleyValues[ LastRow ];
+				LastUsed[ Row ]      = LastUsed[ LastRow ];
+				RowConsumer[ Row ]   = RowConsumer[ LastRow ];
+				ConsumerIndex[ RowConsumer[ Row ] ] = Row;
+      }
+      
+      EnergyExchange.pop_back();
+      ShapleyValues.pop_back();
+      LastUsed.pop_back();
+      RowConsumer.pop_back();
+    }
 }
 
 
@@ -80,10 +117,19 @@ void ShapleyValueReward::NewPVEnergyValue(
      const ShapleyValueReward::NewPVEnergy & EnergyMessage, 
      const Theron::Address Sender )
 {
-  // First the global counters are updated by the reward calculator
+  // First the global counters are updated by the reward calculator, and then 
+  // the local consumers are rewarded.
   
   RewardCalculator::NewPVEnergyValue( EnergyMessage, Sender );
-  
+  RewardConsumers();
+}
+
+// The rewards are computed from the current Shapley values and the energy 
+// counters, and the same function is used when a batch of energy values has 
+// been received from a peer calculator.
+
+void ShapleyValueReward::RewardConsumers( void )
+{
   // In order to compute the overall reward to the household the reward for 
   // the local customers must be added up.
   
@@ -116,7 +162,7 @@ void ShapleyValueReward::NewPVEnergyValue(
    
   for ( const Theron::Address & Consumer : GetConsumers() )
   {
-    double Reward = ShapleyValues( ConsumerIndex.at( Consumer ) ) 
+    double Reward = ShapleyValues.at( ConsumerIndex.at( Consumer ) ) 
 		    / NeighbourhoodEnergy;
 		    
     TotalConsumerReward += Reward;
@@ -141,12 +187,9 @@ void ShapleyValueReward::NewPVEnergyValue(
 // When a load is terminated because it has finished execution, a message will 
 // be sent from the Task Manager to the Actor Manager, which will in turn send 
 // a message to the reward calculator containing the total consumed energy of
-// the transaction. The message handler will first do the housekeeping 
-// of the energy exchange matrix. If the producer is unknown, it will be added 
-// to the producer store and one additional column will be added to the energy 
-// exchange matrix. If the producer is known the energy of this consumption 
-// will just be added to the weight of the producer consumer edge in the 
-// consumption graph.
+// the transaction. The energy of this consumption is added to the weight of 
+// the producer consumer edge in the consumption graph, and the edge is created
+// if the consumer has not used this producer before.
 //
 // Special treatment is given to the Grid producer since it should not be 
 // recorded in the energy exchange matrix, and the consumer should not be 
@@ -158,24 +201,7 @@ void ShapleyValueReward::NewEnergy(
 {
   if ( EnergyMessage.Producer() != Grid::ID() )
   {
-    // Matrix housekeeping is to check if the producer is already known. Since 
-    // this is the normal situation, exception handling is used if the column 
-    // index of the producer ID cannot be retrieved.
-    
-    Index ProducerColumn;
-    
-    try
-    {
-      ProducerColumn = ProducerIndex.at( EnergyMessage.Producer() );
-    }
-    catch ( std::out_of_range Exception )
-    {
-      ProducerColumn = EnergyExchange.n_cols;
-      ProducerIndex.emplace( EnergyMessage.Producer(), ProducerColumn );
-      EnergyExchange.resize( EnergyExchange.n_rows, EnergyExchange.n_cols + 1 );
-    }
-    
-    // Then the row associated with the consumer is looked up. Note that the 
+    // The row associated with the consumer is looked up. Note that the 
     // at function will throw an out of range error if the consumer's address 
     // cannot be found. This is not captured, because all consumers should be 
     // registered with the add consumer message when they are created, hence it 
@@ -191,18 +217,33 @@ void ShapleyValueReward::NewEnergy(
     Index ConsumerRow = ConsumerIndex.at( EnergyMessage.Consumer() );
     
     // The energy just consumed is then added to the weight of the edge between
-    // the consumer and the producer in the energy exchange graph.
+    // the consumer and the producer in the energy exchange graph. The edge 
+    // weight is value initialised to zero if the edge does not exist.
     
-    EnergyExchange( ConsumerRow, ProducerColumn ) += EnergyMessage.Energy();
+    EnergyExchange[ ConsumerRow ][ EnergyMessage.Producer() ] 
+      += EnergyMessage.Energy();
 
     // The Shapley value for a given consumer is the sum of all weights on the 
     // edges incident to that consumer's vertex in the PV energy consumption 
-    // graph. Since these weights are stored in a matrix with as many rows as 
-    // there are consumers on this local network endpoint and as many columns 
-    // as there are PV producers used by these consumers, the Shapley value 
-    // for a consumer is the sum of the elements in the corresponding row.
+    // graph. Only the weight of one edge incident to this consumer changed, 
+    // and so the consumer's Shapley value changes by the same energy while 
+    // the values of all other consumers remain the same.
   
-    ShapleyValues = sum( EnergyExchange, arma::Sum::Rows );
+    ShapleyValues[ ConsumerRow ] += EnergyMessage.Energy();
+    
+    // The row is marked as used, and if a rolling horizon is set and it is 
+    // time to check the rows again, the rows that have expired are evicted. 
+    // The row of this consumer will not be evicted since it was just used.
+    
+    Time CurrentTime = Now();
+    
+    LastUsed[ ConsumerRow ] = CurrentTime;
+    
+    if ( RollingHorizon::Enabled() && ( CurrentTime >= NextEviction ) )
+    {
+      EvictExpiredRows( CurrentTime );
+      NextEviction = CurrentTime + RollingHorizon::Get() / 2;
+    }
   
     // The rewards to the local consumers is computed and dispatched by the 
     // message handler for new PV Energy, so it is simply invoked directly.
@@ -220,6 +261,86 @@ void ShapleyValueReward::NewEnergy(
 }
 
 
+// -----------------------------------------------------------------------------
+// Checkpoint
+// -----------------------------------------------------------------------------
+//
+// The rows are written in index order so that the consumer index is the line
+// number when the graph is read back.
+
+void ShapleyValueReward::WriteState( std::ostream & CheckpointFile )
+{
+  std::vector< Theron::Address > RowConsumer( EnergyExchange.size() );
+  
+  for ( auto & Row : ConsumerIndex )
+    RowConsumer[ Row.second ] = Row.first;
+  
+  for ( Index Row = 0; Row < EnergyExchange.size(); Row++ )
+  {
+    CheckpointFile << RowConsumer[ Row ].AsString() << " " 
+								   << EnergyExchange[ Row ].size();
+    
+    for ( auto & Edge : EnergyExchange[ Row ] )
+      CheckpointFile << " " << Edge.first << " " << Edge.second;
+    
+    CheckpointFile << std::endl;
+  }
+  
+  if ( !RetiredExchange.empty() )
+  {
+    CheckpointFile << RetiredRow << " " << RetiredExchange.size();
+    
+    for ( auto & Edge : RetiredExchange )
+      CheckpointFile << " " << Edge.first << " " << Edge.second;
+    
+    CheckpointFile << std::endl;
+  }
+}
+
+// The restored rows replace any rows already created. The stream reading is
+// terminated when there are no more consumer names to read.
+
+void ShapleyValueReward::ReadState( std::istream & CheckpointFile )
+{
+  std::string ConsumerName, ProducerID;
+  std::size_t NumberOfEdges;
+  double      Energy;
+  
+  ConsumerIndex.clear();
+  EnergyExchange.clear();
+  ShapleyValues.clear();
+  LastUsed.clear();
+  RetiredExchange.clear();
+  
+  while ( CheckpointFile >> ConsumerName >> NumberOfEdges )
+  {
+    if ( ConsumerName == RetiredRow )
+    {
+      for ( std::size_t Edge = 0; Edge < NumberOfEdges; Edge++ )
+      {
+				CheckpointFile >> ProducerID >> Energy;
+				RetiredExchange[ IDType( ProducerID ) ] = Energy;
+      }
+      
+      continue;
+    }
+    
+    LastUsed.push_back( Now() );
+    ConsumerIndex.emplace( Theron::Address( ConsumerName.data() ), 
+													 EnergyExchange.size() );
+    EnergyExchange.emplace_back();
+    ShapleyValues.push_back( 0.0 );
+    
+    for ( std::size_t Edge = 0; Edge < NumberOfEdges; Edge++ )
+    {
+      CheckpointFile >> ProducerID >> Energy;
+      
+      EnergyExchange.back()[ IDType( ProducerID ) ] = Energy;
+      ShapleyValues.back() += Energy;
+    }
+  }
+}
+
 /*****************************************************************************
   Constructor and destructor
 ******************************************************************************/
@@ -228,12 +349,14 @@ void ShapleyValueReward::NewEnergy(
 // constructors must be explicitly called by all derived classes, and the 
 // corresponding calls will be ignored for base classes.
 
-ShapleyValueReward::ShapleyValueReward( const std::string & DomainName ) 
+ShapleyValueReward::ShapleyValueReward( const std::string & DomainName,
+																			  std::chrono::milliseconds BatchWindow ) 
 : Actor( RewardCalculator::NameRoot + DomainName ),
   StandardFallbackHandler( GetAddress().AsString() ),
   DeserializingActor( GetAddress().AsString() ),
-  RewardCalculator( DomainName ),
-  ConsumerIndex(), ProducerIndex(), EnergyExchange(),  ShapleyValues()
+  RewardCalculator( DomainName, BatchWindow ),
+  ConsumerIndex(), EnergyExchange(), ShapleyValues(), LastUsed(),
+  RetiredExchange(), NextEviction( 0 )
 { }
 
 
@@ -37,11 +37,13 @@
   exchange for consumers on the local network endpoint since energy consumption 
   by consumers on remote nodes will never affect the energy weight on any edge
   of the energy exchange graph incident to any consumer on the local node. 
-  The local energy exchange weights are stored in a matrix where there is one
-  row for each local consumer, and one column for each known producer.
+  The local energy exchange weights are stored as one row for each local 
+  consumer, and the row holds the weights of the edges to the producers that 
+  have actually supplied this consumer. The graph is sparse since a consumer 
+  will typically only have used a few of the producers in the neighbourhood.
   
   The rows are recorded as the consumers are created by the Actor Manager, and
-  the columns are recorded once a load has finished execution and the Actor 
+  the edges are recorded once a load has finished execution and the Actor 
   Manager is requested by the Task Manager to delete the load, i.e. delete its
   associated Consumer Agent.
   
@@ -51,7 +53,9 @@
   assumed that all players (i.e. consumers) shall be rewarded by the end of an
   epoch, and this layout means that all but one consumer will receive
   the same reward as last time because none of the weights incident to these 
-  nodes of the energy exchange graph have changed. 
+  nodes of the energy exchange graph have changed. The sum of the weights 
+  incident to each consumer is therefore kept, and only the sum of the 
+  consumer of the terminating load is updated by the energy consumed.
   
   When an epoch ends, the reward calculator on the node hosting the consumer 
   agent for the terminating load will disseminate the recorded energy 
@@ -79,9 +83,11 @@
 #define SHAPLEY_VALUE_REWARD
 
 #include <unordered_map>	 // Mapping addresses to indices
-#include <armadillo>		 // For matrix support
+#include <vector>		 // The energy exchange rows
+#include <cstddef>		 // For the index type
 
 #include "RewardCalculator.hpp"  // The generic reward structure
+#include "TimeInterval.hpp"      // CoSSMic time
 
 namespace CoSSMic
 {
@@ -103,46 +109,60 @@ private:
   // Variables
   // ---------------------------------------------------------------------------
   //
-  // The Armadillo matrix library uses uword for indices, and it is defined 
-  // a separate type for clarity. The same goes for the double matrix.
+  typedef std::size_t Index;
   
-  typedef arma::uword 		    Index;
-  typedef arma::Mat< double >	Matrix;
-  
-  // The energy edge weights are stored in a matrix as E(c,p) where c is 
-  // the consumer index and p is the producer index. However, it will receive 
-  // the reference for the consumer actor involved as a Theron address, and 
-  // this address needs to be mapped to a legal index. A standard map is used 
-  // since this should be faster when iterating over all local consumers to 
-  // reward them. Lookup in an unordered map is of constant complexity, and 
-  // it is used for fast lookup of the index.
+  // The energy edge weights are stored as E(c,p) where c is the consumer index
+  // and p is the producer. However, it will receive the reference for the 
+  // consumer actor involved as a Theron address, and this address needs to be
+  // mapped to a legal index. Lookup in an unordered map is of constant 
+  // complexity, and it is used for fast lookup of the index.
   
   std::unordered_map< Theron::Address, Index > ConsumerIndex;
   
-  // The producers are typically only known by their CoSSMic IDs, hence the 
-  // map key is the ID for the producers.  
-  
-  std::unordered_map< IDType, Index > ProducerIndex;
-   
-  // The edge weights are the accumulated energy from a provider to a consumer,
-  // and the size of the matrix will grow when new consumers become known to 
-  // the system. Note that a consumer represents a device or a mode on a device,
-  // and so the consumer agent will only exist as long as the load it represents
-  // is active, but it may come back next time the same device wants to run a 
-  // load. The matrix will therefore grow quite rapidly in the beginning when 
-  // new consumers and producers are being defined in the system, and after some
-  // time it should stabilise and only grow when new devices are added. 
+  // The edge weights are the accumulated energy from a provider to a consumer.
+  // The producers are typically only known by their CoSSMic IDs, and each 
+  // consumer's row maps the IDs of the producers that have supplied the 
+  // consumer to the energy exchanged. A new producer is therefore only a new 
+  // element in the row of the consumer using it, and no other row is touched.
+  // Note that a consumer represents a device or a mode on a device, and so the
+  // consumer agent will only exist as long as the load it represents is 
+  // active, but it may come back next time the same device wants to run a 
+  // load. The rows will therefore be added quite rapidly in the beginning when 
+  // new consumers are being defined in the system, and after some time it 
+  // should stabilise and only grow when new devices are added. 
   
-  Matrix EnergyExchange;
+  std::vector< std::unordered_map< IDType, double > > EnergyExchange;
   
   // The Shapley values will only change when a consumer on this node has 
   // finished its load, but the rewards to the consumers on this node is 
   // produced whenever an epoch ends in the neighbourhood, i.e. when any of 
   // the consumers in the neighbourhood has completed a consumption. The Shapley
-  // values are therefore cached and update only when a consumer on this 
-  // endpoint terminates its consumption
+  // value of a consumer is the sum of its row, and the sums are kept and 
+  // updated with the energy added when a consumer on this endpoint terminates 
+  // its consumption.
+  
+  std::vector< double > ShapleyValues;
+  
+  // A long running deployment will over time see devices replaced and modes 
+  // that are no longer used, and their rows would be kept forever. The time 
+  // each row was last used is therefore recorded, and when a rolling horizon 
+  // is set the rows of inactive consumers not used within the horizon are 
+  // evicted. The energy of the evicted rows is not lost: it is compacted into 
+  // one aggregate row of retired exchanges per producer so that the total 
+  // energy recorded on this node remains correct in the checkpoint. The 
+  // eviction is done at most once every half horizon to avoid scanning all 
+  // rows for every completed load.
+  
+  std::vector< Time >                  LastUsed;
+  std::unordered_map< IDType, double > RetiredExchange;
+  Time                                 NextEviction;
+  
+  // The retired exchanges are stored in the checkpoint as a row whose name 
+  // can never be the name of a consumer actor.
+  
+  static constexpr char RetiredRow[] = "#RetiredExchange";
   
-  arma::colvec ShapleyValues;
+  void EvictExpiredRows( Time CurrentTime );
   
   // ---------------------------------------------------------------------------
   // New PV Energy message
@@ -156,12 +176,17 @@ protected:
   virtual void NewPVEnergyValue( const NewPVEnergy & EnergyMessage, 
 																 const Theron::Address Sender       );
 
+  // The rewards are dispatched by a separate function that is also used when 
+  // a batch of PV energy values has been received.
+  
+  virtual void RewardConsumers( void ) override;
+
   // ---------------------------------------------------------------------------
   // Add consumer message
   // ---------------------------------------------------------------------------
   //
   // The overloaded handler needs to check if this consumer has already a row 
-  // in the energy exchange matrix, and add that row if this is the first time
+  // in the energy exchange graph, and add that row if this is the first time
   // that consumer is seen.
   
   virtual void NewConsumer( const AddConsumer & ConsumerRequest, 
@@ -171,26 +196,43 @@ protected:
   // Computing the reward when the load has finished
   // ---------------------------------------------------------------------------
   //
-  // The handler for the add energy message will add a column to the energy
-  // exchange matrix if the producer ID has not been recorded previously. Then  
-  // it will compute the reward and use the new PV energy value dispatcher 
+  // The handler for the add energy message will add the energy to the edge 
+  // between the consumer and the producer, and to the consumer's Shapley 
+  // value. Then it will compute the reward and use the new PV energy value dispatcher 
   // handler to distribute the reward to all local consumers, before sending  
   // back the acknowledgement to the Actor Manager.
     
   virtual void NewEnergy( const AddEnergy & EnergyMessage, 
 												  const Theron::Address Sender    );
 
+  // ---------------------------------------------------------------------------
+  // Checkpoint
+  // ---------------------------------------------------------------------------
+  //
+  // The energy exchange graph is written with one line per consumer row in 
+  // the order of the rows, giving the consumer's name, the number of edges 
+  // and the producer ID and energy of each edge. The Shapley values are the 
+  // row sums and they are recomputed when the graph is read back. The retired
+  // exchanges are written as a last row with a reserved name if there are any,
+  // and the restored rows are considered used at the time of the restore.
+  
+  virtual void WriteState( std::ostream & CheckpointFile ) override;
+  virtual void ReadState ( std::istream & CheckpointFile ) override;
+  
   // ---------------------------------------------------------------------------
   // Constructor and destructor
   // ---------------------------------------------------------------------------
   //  
   // The constructor initialises the various parts of the reward calculator, 
   // and sets the name of the agent will be "RewardCalculator" with the endpoint 
-	// domain name added.
+	// domain name added. The dissemination window is passed on to the reward
+	// calculator.
   
 public:
   
-  ShapleyValueReward( const std::string & DomainName );
+  ShapleyValueReward( const std::string & DomainName, 
+										  std::chrono::milliseconds BatchWindow 
+											  = std::chrono::milliseconds::zero() );
   
   // The destructor does nothing in this version, but it is a place holder to
   // ensure that the right destructor is called on the base class.
@@ -0,0 +1,439 @@
+/*=============================================================================
+  Solar Production
+
+  This implements the optimal and the simulated production of the PV panels.
+  The functions follow the production tools of the web service step by step
+  so that the simulated production is the same as the production it wrote
+  to the production files.
+
+  Author: Geir Horn, University of Oslo, 2019
+  Contact: Geir.Horn [at] mn.uio.no
+  License: LGPL3.0
+=============================================================================*/
+
+#include <cmath>									// Trigonometric functions
+#include <cstdint>								// Milliseconds
+#include <algorithm>							// Min and max
+#include <sstream>								// Error messages
+#include <stdexcept>							// Standard exceptions
+
+#include "SolarProduction.hpp"
+
+namespace CoSSMic
+{
+
+// -----------------------------------------------------------------------------
+// Calendar
+// -----------------------------------------------------------------------------
+//
+// The day of the year is the number of started days since the first of
+// January of the year of the given time, and the days are converted to the
+// year by the civil calendar algorithms of Howard Hinnant. The Unix time may
+// have fractions of a second, and it is truncated to milliseconds as done
+// by the JavaScript dates.
+
+static int64_t YearOfDay( int64_t Days )
+{
+  Days += 719468;
+
+  const int64_t Era = ( Days >= 0 ? Days : Days - 146096 ) / 146097,
+                DayOfEra  = Days - Era * 146097,
+                YearOfEra = ( DayOfEra - DayOfEra / 1460 + DayOfEra / 36524
+                              - DayOfEra / 146096 ) / 365,
+                DayOfYear = DayOfEra - ( 365 * YearOfEra + YearOfEra / 4
+                                         - YearOfEra / 100 ),
+                MonthIndex = ( 5 * DayOfYear + 2 ) / 153;
+
+  return YearOfEra + Era * 400 + ( MonthIndex >= 10 ? 1 : 0 );
+}
+
+static int64_t FirstDayOfYear( int64_t Year )
+{
+  Year -= 1;
+
+  const int64_t Era = ( Year >= 0 ? Year : Year - 399 ) / 400,
+                YearOfEra = Year - Era * 400,
+                DayOfEra  = YearOfEra * 365 + YearOfEra / 4 - YearOfEra / 100
+                            + 306;
+
+  return Era * 146097 + DayOfEra - 719468;
+}
+
+static int64_t FloorDivision( int64_t Numerator, int64_t Denominator )
+{
+  int64_t Quotient = Numerator / Denominator;
+
+  if ( ( Numerator % Denominator != 0 ) &&
+       ( ( Numerator < 0 ) != ( Denominator < 0 ) ) )
+    --Quotient;
+
+  return Quotient;
+}
+
+static double DayOfYear( int64_t Milliseconds )
+{
+  const int64_t DayLength = 86400000,
+                YearStart = FirstDayOfYear(
+                  YearOfDay( FloorDivision( Milliseconds, DayLength ) ) )
+                  * DayLength;
+
+  return std::ceil( static_cast< double >( Milliseconds - YearStart )
+                    / DayLength );
+}
+
+// The zone time of the hour angle is the UTC time in hours with whole
+// minutes.
+
+static double UTCHours( int64_t Milliseconds )
+{
+  const int64_t Seconds = FloorDivision( Milliseconds, 1000 ),
+                SecondOfDay = Seconds - FloorDivision( Seconds, 86400 ) * 86400;
+
+  return static_cast< double >( SecondOfDay / 3600 )
+         + static_cast< double >( ( SecondOfDay % 3600 ) / 60 ) / 60.0;
+}
+
+// JavaScript rounds the halves upwards
+
+static double RoundHalfUp( double Value )
+{ return std::floor( Value + 0.5 ); }
+
+// -----------------------------------------------------------------------------
+// Optimal production
+// -----------------------------------------------------------------------------
+//
+// The time of each step is accumulated in the same way as by the web service
+// since the steps are fractions of a minute. The geometry of the panel gives
+// the constant coefficients of the cosine of the angle of incidence, and the
+// panel with zero tilt tells whether the sun is up. The transmittance is
+// evaluated for all steps with the angle limited to the interval where the
+// incidence angle modifier is defined, and the modifier is zero outside.
+
+SolarProduction::OptimalProduction
+SolarProduction::Optimal( const PVSystem & System, Time DayStart,
+                          double Interval )
+{
+  constexpr double Radian = M_PI / 180.0, Degree = 180.0 / M_PI;
+
+  // The parameters of the glazing: the refraction index, the extinction
+  // coefficient per meter and the thickness in meters
+
+  constexpr double RefractionIndex = 1.526, Extinction = 4.0,
+                   Thickness = 0.002;
+
+  const size_t Samples
+               = static_cast< size_t >( RoundHalfUp( 1440.0 / Interval ) );
+
+  OptimalProduction Result;
+
+  Result.Interval = Interval;
+  Result.Energy.resize( Samples );
+  Result.AngleOfIncidence.resize( Samples );
+
+  std::vector< double > StepTimes( Samples ), Days( Samples ),
+                        HourAngle( Samples ), SunElevation( Samples );
+
+  double UnixTime = DayStart;
+
+  for ( size_t i = 0; i < Samples; i++ )
+  {
+    const int64_t Milliseconds = static_cast< int64_t >( UnixTime * 1000.0 );
+
+    StepTimes[i] = UnixTime;
+    Days[i]      = DayOfYear( Milliseconds );
+    HourAngle[i] = 15.0 * ( UTCHours( Milliseconds ) - 12.0 )
+                   + ( System.Longitude - 15.0 * System.TimeZoneOffset );
+
+    UnixTime += Interval * 60.0;
+  }
+
+  const double Latitude = System.Latitude * Radian,
+               Tilt     = System.Tilt * Radian,
+               Azimuth  = System.Orientation * Radian,
+               A = std::sin( Latitude ) * std::cos( Tilt ),
+               B = std::cos( Latitude ) * std::sin( Tilt ) * std::cos( Azimuth ),
+               C = std::sin( Tilt ) * std::sin( Azimuth ),
+               D = std::cos( Latitude ) * std::cos( Tilt ),
+               E = std::sin( Latitude ) * std::sin( Tilt ) * std::cos( Azimuth ),
+               SinLatitude = std::sin( Latitude ),
+               CosLatitude = std::cos( Latitude ),
+               NormalTransmittance
+                 = std::exp( -Extinction * Thickness )
+                   * ( 1.0 - std::pow( ( 1.0 - RefractionIndex )
+                                       / ( 1.0 + RefractionIndex ), 2 ) ),
+               StepCapacity = System.Capacity * ( Interval / 60.0 );
+
+  const double * Day   = Days.data(),
+               * Omega = HourAngle.data();
+  double * AOI       = Result.AngleOfIncidence.data(),
+         * Elevation = SunElevation.data(),
+         * Energy    = Result.Energy.data();
+
+  #pragma omp simd
+  for ( size_t i = 0; i < Samples; i++ )
+  {
+    const double Delta = 23.45 * Radian
+                         * std::sin( 2.0 * M_PI * ( 284.0 + Day[i] ) / 365.0 ),
+                 SinDelta = std::sin( Delta ),
+                 CosDelta = std::cos( Delta ),
+                 SinOmega = std::sin( Omega[i] * Radian ),
+                 CosOmega = std::cos( Omega[i] * Radian );
+
+    const double CosAOI = std::fmin( 1.0, std::fmax( -1.0,
+      ( A - B ) * SinDelta + ( C * SinOmega + ( D + E ) * CosOmega ) * CosDelta ) );
+    const double CosZenith = std::fmin( 1.0, std::fmax( -1.0,
+      SinLatitude * SinDelta + CosLatitude * CosOmega * CosDelta ) );
+
+    AOI[i]       = std::acos( CosAOI ) * Degree;
+    Elevation[i] = std::acos( CosZenith ) * Degree;
+
+    const double X  = std::fmin( std::fmax( AOI[i], 1.0e-6 ), 90.0 ) * Radian,
+                 XR = std::asin( std::sin( X ) / RefractionIndex ),
+                 SinMinus = std::sin( XR - X ),
+                 SinPlus  = std::sin( XR + X ),
+                 TanMinus = std::tan( XR - X ),
+                 TanPlus  = std::tan( XR + X ),
+                 Transmittance
+                   = std::exp( -Extinction * Thickness / std::cos( XR ) )
+                     * ( 1.0 - 0.5 * ( ( SinMinus * SinMinus )
+                                       / ( SinPlus * SinPlus )
+                                     + ( TanMinus * TanMinus )
+                                       / ( TanPlus * TanPlus ) ) ),
+                 IAM = ( AOI[i] <= 90.0 )
+                       ? Transmittance / NormalTransmittance : 0.0;
+
+    Energy[i] = ( Elevation[i] < 90.0 ) ? StepCapacity * IAM : 0.0;
+  }
+
+  // The sun events are found from the changes between the steps, and the
+  // cumulative energy is the running sum.
+
+  Result.Cumulative.resize( Samples );
+
+  double Total = 0.0;
+
+  for ( size_t i = 0; i < Samples; i++ )
+  {
+    const bool SunIsOnPanel = AOI[i] < 90.0,
+               SunIsUp      = Elevation[i] < 90.0,
+               WasOnPanel   = ( i == 0 ) ? SunIsOnPanel : AOI[i-1] < 90.0,
+               WasUp        = ( i == 0 ) ? SunIsUp : Elevation[i-1] < 90.0;
+    const Time StepTime = static_cast< Time >( std::floor( StepTimes[i] ) );
+
+    if ( WasOnPanel && !SunIsOnPanel ) Result.SunLeavesPanel = StepTime;
+    if ( !WasOnPanel && SunIsOnPanel ) Result.SunEntersPanel = StepTime;
+    if ( WasUp && !SunIsUp )           Result.SunSet  = StepTime;
+    if ( !WasUp && SunIsUp )           Result.SunRise = StepTime;
+
+    Total += Energy[i];
+    Result.Cumulative[i] = Total;
+  }
+
+  return Result;
+}
+
+// -----------------------------------------------------------------------------
+// Simulated production
+// -----------------------------------------------------------------------------
+//
+// The first production is the first sample differing from its predecessor,
+// or the first sample if it is not zero, and the last production is found
+// in the same way from the end.
+
+size_t SolarProduction::FirstProduction( const std::vector< double > & Profile )
+{
+  if ( !Profile.empty() && ( Profile.front() != 0.0 ) )
+    return 0;
+
+  for ( size_t i = 1; i < Profile.size(); i++ )
+    if ( Profile[i] != Profile[i-1] )
+      return i;
+
+  std::ostringstream ErrorMessage;
+
+  ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+               << "The production profile has no production";
+
+  throw std::invalid_argument( ErrorMessage.str() );
+}
+
+size_t SolarProduction::LastProduction( const std::vector< double > & Profile )
+{
+  if ( !Profile.empty() && ( Profile.back() != 0.0 ) )
+    return Profile.size() - 1;
+
+  for ( size_t i = Profile.size() - 1; i-- > 0; )
+    if ( Profile[i] != Profile[i+1] )
+      return i + 1;
+
+  std::ostringstream ErrorMessage;
+
+  ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+               << "The production profile has no production";
+
+  throw std::invalid_argument( ErrorMessage.str() );
+}
+
+// The solar day of the measured curve is bounded by the sun events in
+// Konstanz on the day after the start of the measurement, and by its own
+// production. A sun event that does not occur does not bound the solar day.
+// The samples of the measured curve beyond its end count as no production.
+
+SolarProduction::SolarProduction( const PVSystem & System, Time TheDayStart,
+                                  const MeasuredCurve & Measured )
+: DayStart( TheDayStart ), Step( 0.0 ), StepEnergy(), CumulativeEnergy(),
+  Reference(), MinuteReference()
+{
+  const PVSystem Konstanz{ Measured.Tilt, Measured.Orientation,
+                           System.Capacity, 47.695, 9.175, 1.0 };
+  const Time MeasurementMidnight = ( Measured.Start / 86400 + 1 ) * 86400;
+  const double SampleSeconds = 60.0 * Measured.Resolution;
+
+  const OptimalProduction KonstanzDay( Optimal( Konstanz, MeasurementMidnight,
+                                                1.0 ) );
+
+  auto MeasuredIndex = [&]( Time EventTime ){
+    return static_cast< long >( RoundHalfUp(
+           ( EventTime - Measured.Start ) / SampleSeconds ) );
+  };
+
+  long MeasuredStart = static_cast< long >( FirstProduction( Measured.Values ) ),
+       MeasuredEnd   = static_cast< long >( LastProduction( Measured.Values ) );
+
+  if ( KonstanzDay.SunRise )
+    MeasuredStart = std::max( MeasuredStart, MeasuredIndex( *KonstanzDay.SunRise ) );
+  if ( KonstanzDay.SunEntersPanel )
+    MeasuredStart = std::max( MeasuredStart,
+                              MeasuredIndex( *KonstanzDay.SunEntersPanel ) );
+  if ( KonstanzDay.SunSet )
+    MeasuredEnd = std::min( MeasuredEnd, MeasuredIndex( *KonstanzDay.SunSet ) );
+  if ( KonstanzDay.SunLeavesPanel )
+    MeasuredEnd = std::min( MeasuredEnd,
+                            MeasuredIndex( *KonstanzDay.SunLeavesPanel ) );
+
+  const long MeasuredSamples = MeasuredEnd - MeasuredStart;
+
+  if ( MeasuredSamples <= 0 )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The measured curve has no solar day";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  // The time step is chosen so that the solar day of the simulated panel has
+  // as many steps as the solar day of the measured curve.
+
+  MinuteReference = Optimal( System, DayStart, 1.0 );
+
+  const double SolarMinutes
+    = static_cast< double >( LastProduction( MinuteReference.Energy ) )
+      - static_cast< double >( FirstProduction( MinuteReference.Energy ) );
+
+  Step      = SolarMinutes / MeasuredSamples;
+  Reference = Optimal( System, DayStart, Step );
+
+  const size_t OptimalStart = FirstProduction( Reference.Energy ),
+               OptimalEnd   = LastProduction( Reference.Energy );
+
+  // The simulated energy is the product of the measured and the optimal
+  // curves over the solar day, and it is padded with steps without
+  // production at both ends to cover the day.
+
+  std::vector< double > SolarDay;
+
+  SolarDay.reserve( OptimalEnd - OptimalStart );
+
+  for ( size_t i = 0; i < OptimalEnd - OptimalStart; i++ )
+  {
+    const long   MeasuredSample = MeasuredStart + static_cast< long >( i );
+    const double Weather = ( MeasuredSample >= 0 ) &&
+      ( MeasuredSample < static_cast< long >( Measured.Values.size() ) )
+      ? Measured.Values[ MeasuredSample ] : 0.0;
+
+    SolarDay.push_back( Weather * Reference.Energy[ OptimalStart + i ] );
+  }
+
+  double FirstTime = OptimalStart * Step;
+  size_t Before    = 0;
+
+  while ( FirstTime - Step >= 0.0 )
+  {
+    FirstTime -= Step;
+    ++Before;
+  }
+
+  double LastTime = OptimalStart * Step
+                    + ( static_cast< double >( SolarDay.size() ) - 1.0 ) * Step;
+  size_t After    = 0;
+
+  if ( SolarDay.empty() )
+    LastTime = FirstTime;
+
+  while ( LastTime + Step <= 1440.0 )
+  {
+    LastTime += Step;
+    ++After;
+  }
+
+  StepEnergy.assign( Before, 0.0 );
+  StepEnergy.insert( StepEnergy.end(), SolarDay.begin(), SolarDay.end() );
+  StepEnergy.resize( StepEnergy.size() + After, 0.0 );
+
+  // Rounding of the time step may give one step more than the optimal
+  // production, and this step is removed. If the optimal production has one
+  // step more, its last step is removed.
+
+  if ( StepEnergy.size() == Reference.Energy.size() + 1 )
+    StepEnergy.pop_back();
+  else if ( Reference.Energy.size() == StepEnergy.size() + 1 )
+  {
+    Reference.Energy.pop_back();
+    Reference.Cumulative.pop_back();
+    Reference.AngleOfIncidence.pop_back();
+  }
+
+  CumulativeEnergy.resize( StepEnergy.size() );
+
+  double Total = 0.0;
+
+  for ( size_t i = 0; i < StepEnergy.size(); i++ )
+  {
+    Total += StepEnergy[i];
+    CumulativeEnergy[i] = Total;
+  }
+}
+
+// The series has the time stamps of the production file
+
+TimeSeries SolarProduction::Series( void ) const
+{
+  TimeSeries Production;
+
+  Production.Reserve( CumulativeEnergy.size() );
+
+  for ( size_t i = 0; i < CumulativeEnergy.size(); i++ )
+    Production.Append( static_cast< Time >(
+      RoundHalfUp( DayStart + i * Step * 60.0 ) ), CumulativeEnergy[i] );
+
+  if ( !Production.Sorted() )
+    Production.Normalise();
+
+  return Production;
+}
+
+Time SolarProduction::ProductionStart( void ) const
+{
+  return static_cast< Time >( std::floor(
+         DayStart + FirstProduction( StepEnergy ) * Step * 60.0 ) );
+}
+
+Time SolarProduction::ProductionEnd( void ) const
+{
+  return static_cast< Time >( std::floor(
+         DayStart + LastProduction( StepEnergy ) * Step * 60.0 ) );
+}
+
+}      // name space CoSSMic
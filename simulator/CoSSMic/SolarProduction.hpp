@@ -0,0 +1,188 @@
+/*=============================================================================
+  Solar Production
+
+  The web service simulates the production of the PV panels of a scenario by
+  first computing the theoretically optimal production of the panels from the
+  angle of incidence of the sun over the day, and then imposing the weather
+  variations of a production curve measured in Konstanz, Germany, on the
+  optimal production. The cumulative production was then written to a CSV
+  file that the solver parsed back. This class implements the same model so
+  that the production can be given directly to the solver, and so that batch
+  studies can generate many production curves without any files.
+
+  The angle of incidence is computed by the equation of Twidell and Weir [1]
+  with the declination of the day of the year and the solar hour angle
+  ignoring the equation of time, and the transmittance of the glazing is
+  modelled by the physical incidence angle modifier of De Soto et al. [2].
+  The production at a time step is the capacity times the duration of the
+  step times the incidence angle modifier when the sun is above the horizon,
+  and zero otherwise.
+
+  The measured curve is from a panel with a different tilt and orientation
+  on a different day, and its solar day is found as the latest of the
+  sunrise, the time the sun enters the panel and the first production, and
+  the earliest of the corresponding end times, all computed for Konstanz on
+  the day of the measurement. The optimal production of the simulated panel
+  is then recomputed with a time step chosen so that its solar day has as
+  many samples as the solar day of the measured curve, and the simulated
+  production is the product of the two curves sample by sample. The time
+  step will therefore in general be a fraction of a minute.
+
+  The time steps of a day are evaluated as a structure of arrays: the
+  calendar dependent day of the year and hour angle are computed first, and
+  then the trigonometric functions are evaluated for all time steps in loops
+  without branches that the compiler vectorises. The source file is compiled
+  with the flags enabling the vectorised mathematical functions of the C
+  library as for the battery bank, see the makefile. The cosine of the angle
+  of incidence is clamped to its domain so that rounding errors do not give
+  undefined angles. The calendar functions use UTC as the web service does
+  when run in its container.
+
+  REFERENCES:
+
+  [1] John Twidell and Tony Weir (2015): Renewable Energy Resources, 3rd
+      edition, Routledge, ISBN 978-0-415-58437-1
+  [2] W. De Soto, S. A. Klein and W. A. Beckman (2006): "Improvement and
+      validation of a model for photovoltaic array performance", Solar
+      Energy, Vol. 80, No. 1, pp. 78-88
+
+  Author: Geir Horn, University of Oslo, 2019
+  Contact: Geir.Horn [at] mn.uio.no
+  License: LGPL3.0
+=============================================================================*/
+
+#ifndef COSSMIC_SOLAR_PRODUCTION
+#define COSSMIC_SOLAR_PRODUCTION
+
+#include <vector>									// The profiles
+#include <optional>								// Sun events that may not occur
+#include <stddef.h>								// For size_t
+
+#include "TimeInterval.hpp"				// CoSSMic time
+#include "TimeSeries.hpp"					// The cumulative production
+
+namespace CoSSMic
+{
+
+class SolarProduction
+{
+public:
+
+  // ---------------------------------------------------------------------------
+  // Parameters
+  // ---------------------------------------------------------------------------
+  //
+  // The PV system is defined by the tilt from the horizontal and the
+  // orientation from south of the panels in degrees, the capacity in kW, and
+  // the location in degrees with the offset in hours of the time zone.
+
+  class PVSystem
+  {
+  public:
+
+    double Tilt, Orientation, Capacity, Latitude, Longitude, TimeZoneOffset;
+  };
+
+  // The measured curve has the tilt and orientation of the panel on which
+  // it was measured, the Unix time of its first sample, the resolution in
+  // minutes, and the values normalised to the capacity of the panel.
+
+  class MeasuredCurve
+  {
+  public:
+
+    double                Tilt, Orientation;
+    Time                  Start;
+    double                Resolution;
+    std::vector< double > Values;
+  };
+
+  // The optimal production of a panel over one day starting at a given time
+  // has the energy in kWh produced in each time step, the cumulative energy,
+  // the angle of incidence in degrees at each step, and the times of the sun
+  // events if they occur during the day.
+
+  class OptimalProduction
+  {
+  public:
+
+    double                Interval;
+    std::vector< double > Energy, Cumulative, AngleOfIncidence;
+    std::optional< Time > SunRise, SunSet, SunEntersPanel, SunLeavesPanel;
+  };
+
+  // The optimal production is computed for a day of 1440 minutes with the
+  // given interval in minutes between the time steps.
+
+  static OptimalProduction Optimal( const PVSystem & System, Time DayStart,
+                                    double Interval );
+
+private:
+
+  // ---------------------------------------------------------------------------
+  // Simulated production
+  // ---------------------------------------------------------------------------
+  //
+  // The simulation keeps the start of the day, the time step in minutes, the
+  // energy produced in each step and its cumulative sum, the optimal
+  // production of the panel for the same time steps, and the optimal
+  // production at a resolution of one minute.
+
+  Time                  DayStart;
+  double                Step;
+  std::vector< double > StepEnergy, CumulativeEnergy;
+  OptimalProduction     Reference, MinuteReference;
+
+  // Utility functions to find the first and the last time step with
+  // production in a profile. They throw if the profile has no production.
+
+  static size_t FirstProduction( const std::vector< double > & Profile );
+  static size_t LastProduction ( const std::vector< double > & Profile );
+
+public:
+
+  // The time step is in minutes, and the energies are in kWh per time step.
+  // The power in kW is the energy divided by the duration of the step in
+  // hours.
+
+  inline double Interval( void ) const
+  { return Step; }
+
+  inline const std::vector< double > & Energy( void ) const
+  { return StepEnergy; }
+
+  inline const std::vector< double > & Cumulative( void ) const
+  { return CumulativeEnergy; }
+
+  inline const OptimalProduction & Optimal( void ) const
+  { return Reference; }
+
+  inline const OptimalProduction & OptimalByMinute( void ) const
+  { return MinuteReference; }
+
+  // The cumulative production as a time series with the time stamps rounded
+  // to whole seconds, which is the content of the production file written
+  // by the web service.
+
+  TimeSeries Series( void ) const;
+
+  // The times of the first and the last time step with production, which is
+  // the solar day given to the solver.
+
+  Time ProductionStart( void ) const;
+  Time ProductionEnd  ( void ) const;
+
+  // The constructor simulates the production of the system for the day
+  // starting at the given time with the weather of the measured curve. It
+  // throws an invalid argument exception if the measured curve has no
+  // production or the simulated panel produces nothing on that day.
+
+  SolarProduction( const PVSystem & System, Time TheDayStart,
+                   const MeasuredCurve & Measured );
+
+  SolarProduction( const SolarProduction & Other ) = default;
+  SolarProduction( SolarProduction && Other ) = default;
+};
+
+}      // name space CoSSMic
+#endif // COSSMIC_SOLAR_PRODUCTION
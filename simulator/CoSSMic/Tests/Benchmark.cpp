@@ -0,0 +1,515 @@
+/*=============================================================================
+  Benchmark
+
+  The schedule test and the interpolation test exercise the scheduling and the
+  interpolation, but they only report their progress on the console. This
+  benchmark uses the same scenarios, a PV producer receiving loads from
+  consumers in the same process and a densely sampled interpolated function,
+  and reports the timing so that the performance can be compared between
+  releases of the scheduler.
+
+  The scheduling scenario is a synthetic prediction for a partly cloudy day
+  and loads whose start windows, durations and energies are drawn from a
+  random generator with a fixed seed. The CoSSMic clock is fixed at the start
+  of the prediction, and the random generator used by the producer is seeded
+  with the same seed, so that the same schedules are computed for every run.
+  The loads are sent one by one from different consumers, and the next load
+  is only sent when the producer has computed the schedule for the previous
+  load. The latency of the new load handler is then measured for the given
+  numbers of concurrent loads, together with the number of evaluations of the
+  objective function used for the schedule. The scenario is repeated with
+  different loads for a given number of repetitions.
+
+  The interpolation benchmark interpolates the power of the same production
+  prediction with all the interpolation types, and measures the evaluations
+  per second for random arguments evaluated one by one, and for sorted
+  arguments evaluated as a batch. Note that the power is zero at the start and
+  the end of the day so that the periodic interpolations can be used.
+
+  The results are written as a JSON document to the standard output or to a
+  given file. Debug messages from the actors are written to the standard
+  error stream. The following options are supported:
+
+  -l [ --Loads <n...> ]         = Concurrent loads. Default: 1 5 20 50
+  -R [ --Repetitions <n> ]      = Scenario repetitions. Default: 5
+  -i [ --Interpolations <n> ]   = Evaluations per type. Default: 1000000
+  -r [ --Seed <n> ]             = Seed for the scenarios. Default: 1
+  -o [ --Output <file> ]        = The JSON result file. Default: standard output
+
+  Author: Geir Horn, University of Oslo, 2019
+  Contact: Geir.Horn [at] mn.uio.no
+  License: LGPL3.0
+=============================================================================*/
+
+#include <string>                            // Standard strings
+#include <vector>                            // Standard vectors
+#include <map>                               // Results per load count
+#include <iostream>                          // Writing the results
+#include <fstream>                           // Writing the prediction file
+#include <filesystem>                        // Temporary directory
+#include <random>                            // Scenario generator
+#include <chrono>                            // Wall clock timing
+#include <algorithm>                         // Min, max and sorting
+#include <cmath>                             // The sine of the day
+#include <mutex>                             // Synchronising with the producer
+#include <condition_variable>                // Waiting for the schedules
+#include <memory>                            // Smart pointers
+#include <cstdlib>                           // Exit status
+
+#include <boost/program_options.hpp>         // Command line parsing
+#include <boost/property_tree/ptree.hpp>     // JSON results
+#include <boost/property_tree/json_parser.hpp>
+
+#include "Actor.hpp"                         // The Theron++ actor framework
+#include "StandardFallbackHandler.hpp"       // Reporting unhandled messages
+
+#ifdef CoSSMic_DEBUG
+  #include "ConsolePrint.hpp"                // Debug output from the actors
+#endif
+
+#include "RandomGenerator.hpp"               // The producer's generator
+#include "TimeInterval.hpp"                  // CoSSMic time
+#include "Clock.hpp"                         // The CoSSMic clock
+#include "Interpolation.hpp"                 // Interpolated functions
+#include "Producer.hpp"                      // The load messages
+#include "PVProducer.hpp"                    // The producer to measure
+
+namespace cmd = boost::program_options;
+namespace pt  = boost::property_tree;
+
+namespace CoSSMic
+{
+/*=============================================================================
+
+ Scenario
+
+=============================================================================*/
+//
+// The production is the power of a clear day, a half sine over the day
+// light hours, multiplied by a random cloud cover factor per sample. The
+// prediction file contains the cumulative energy with samples every 15
+// minutes from the start time, in absolute time as expected by the
+// predictor.
+
+constexpr Time SampleInterval = 900,
+               DayLength      = 86400;
+
+std::vector< double > SolarPower( std::mt19937_64 & Generator,
+                                  double PeakPower )
+{
+  std::uniform_real_distribution< double > Clouds( 0.3, 1.0 );
+  std::vector< double > Power;
+
+  for ( Time t = 0; t <= DayLength; t += SampleInterval )
+    Power.push_back( PeakPower * Clouds( Generator ) *
+      std::max( 0.0, std::sin( M_PI * ( t - 21600.0 ) / 43200.0 ) ) );
+
+  return Power;
+}
+
+void WritePrediction( const std::filesystem::path & FileName, Time Start,
+                      const std::vector< double > & Power )
+{
+  std::ofstream Prediction( FileName );
+  double Energy = 0.0;
+
+  for ( std::size_t i = 0; i < Power.size(); i++ )
+  {
+    if ( i > 0 )
+      Energy += 0.5 * ( Power[ i-1 ] + Power[i] ) * SampleInterval / 3600.0;
+
+    Prediction << Start + static_cast< Time >( i ) * SampleInterval << " "
+               << Energy << std::endl;
+  }
+}
+
+// The loads are typical household appliances running between half an hour
+// and two hours with an earliest start time in the day light hours and a
+// start window of up to four hours.
+
+Producer::ScheduleCommand RandomLoad( std::mt19937_64 & Generator,
+                                      Time Start )
+{
+  std::uniform_int_distribution< Time >
+    EarliestStart( Start + 21600, Start + 57600 ),
+    Window( 0, 14400 ),
+    Duration( 1800, 7200 );
+  std::uniform_real_distribution< double > Energy( 0.5, 2.0 );
+
+  Time Earliest = EarliestStart( Generator );
+
+  return Producer::ScheduleCommand( Earliest, Earliest + Window( Generator ),
+                                    Duration( Generator ),
+                                    Energy( Generator ) );
+}
+
+/*=============================================================================
+
+ Producer and consumers
+
+=============================================================================*/
+//
+// The producer measures its own handler for new loads. The handler is
+// registered by the generic producer as a virtual function, and overriding
+// it here will time the complete handling of the load by the PV producer.
+// The zero energy load sent by the predictor when the prediction is set is
+// not recorded, but it signals that loads can be scheduled.
+
+class BenchmarkProducer : public PVProducer
+{
+public:
+
+  class Record
+  {
+  public:
+
+    std::chrono::nanoseconds Latency;
+    unsigned long            Evaluations;
+  };
+
+private:
+
+  std::mutex              Guard;
+  std::condition_variable Scheduled;
+  bool                    PredictionReady;
+  std::vector< Record >   Records;
+
+protected:
+
+  virtual void NewLoad( const Producer::ScheduleCommand & TheCommand,
+                        const Theron::Address TheConsumer ) override
+  {
+    auto          Start     = std::chrono::steady_clock::now();
+    unsigned long Evaluated = ObjectiveEvaluations();
+
+    PVProducer::NewLoad( TheCommand, TheConsumer );
+
+    Record Measurement{ std::chrono::steady_clock::now() - Start,
+                        ObjectiveEvaluations() - Evaluated };
+
+    std::lock_guard< std::mutex > Lock( Guard );
+
+    if ( TheCommand.TotalEnergy() > 0.0 )
+      Records.push_back( Measurement );
+    else
+      PredictionReady = true;
+
+    Scheduled.notify_all();
+  }
+
+public:
+
+  // The main thread waits for the prediction and then for the schedule of
+  // each load before sending the next load.
+
+  void WaitForPrediction( void )
+  {
+    std::unique_lock< std::mutex > Lock( Guard );
+    Scheduled.wait( Lock, [this](void){ return PredictionReady; } );
+  }
+
+  Record WaitForLoad( std::size_t NumberOfLoads )
+  {
+    std::unique_lock< std::mutex > Lock( Guard );
+    Scheduled.wait( Lock,
+                    [&](void){ return Records.size() >= NumberOfLoads; } );
+
+    return Records[ NumberOfLoads - 1 ];
+  }
+
+  BenchmarkProducer( const IDType & ProducerID,
+                     const std::string & PredictionFile )
+  : Actor( std::string( PVProducerNameBase + ProducerID ).data() ),
+    StandardFallbackHandler( GetAddress().AsString() ),
+    DeserializingActor( GetAddress().AsString() ),
+    Producer( ProducerID ),
+    PVProducer( ProducerID, PredictionFile ),
+    Guard(), Scheduled(), PredictionReady( false ), Records()
+  {}
+};
+
+// The consumers only send their load to the producer, and ignore the start
+// times assigned by the producer.
+
+class BenchmarkConsumer : virtual public Theron::Actor,
+                          virtual public Theron::StandardFallbackHandler
+{
+private:
+
+  void StartTime( const Producer::AssignedStartTime & TheStartTime,
+                  const Theron::Address TheProducer )
+  {}
+
+public:
+
+  inline void Schedule( const Producer::ScheduleCommand & TheLoad,
+                        const Theron::Address & TheProducer )
+  {
+    Send( TheLoad, TheProducer );
+  }
+
+  BenchmarkConsumer( const std::string & Name )
+  : Actor( Name ), StandardFallbackHandler( Name )
+  {
+    RegisterHandler( this, &BenchmarkConsumer::StartTime );
+  }
+};
+
+/*=============================================================================
+
+ Measurements
+
+=============================================================================*/
+//
+// The scheduling benchmark runs the scenario for each repetition with a new
+// producer and new consumers. For each requested number of concurrent loads
+// the latencies in milliseconds and the objective evaluations are reported as
+// the mean, the minimum and the maximum over the repetitions.
+
+pt::ptree ScheduleBenchmark( const std::vector< unsigned int > & LoadCounts,
+                             unsigned int Repetitions,
+                             std::mt19937_64::result_type Seed )
+{
+  std::mt19937_64 Generator( Seed );
+  const Time      Start = 1546300800; // 1 January 2019
+
+  const std::filesystem::path PredictionFile(
+    std::filesystem::temp_directory_path() / "BenchmarkPrediction.dat" );
+
+  WritePrediction( PredictionFile, Start, SolarPower( Generator, 3.0 ) );
+
+  Now.Fix( Start );
+  Random::Generator.Seed( Seed );
+
+  const unsigned int MaxLoads =
+    *std::max_element( LoadCounts.begin(), LoadCounts.end() );
+
+  std::map< unsigned int, std::vector< BenchmarkProducer::Record > > Results;
+  unsigned long TotalEvaluations = 0, Reschedules = 0;
+
+  for ( unsigned int Repetition = 0; Repetition < Repetitions; Repetition++ )
+  {
+    BenchmarkProducer TheProducer( "Benchmark" + std::to_string( Repetition ),
+                                   PredictionFile.string() );
+    std::vector< std::unique_ptr< BenchmarkConsumer > > Consumers;
+
+    TheProducer.WaitForPrediction();
+
+    for ( unsigned int Load = 1; Load <= MaxLoads; Load++ )
+    {
+      Consumers.emplace_back( std::make_unique< BenchmarkConsumer >(
+        "BenchmarkConsumer" + std::to_string( Repetition ) + "_" +
+        std::to_string( Load ) ) );
+
+      Consumers.back()->Schedule( RandomLoad( Generator, Start ),
+                                  TheProducer.GetAddress() );
+
+      BenchmarkProducer::Record Measurement = TheProducer.WaitForLoad( Load );
+
+      if ( Load > 1 )
+      {
+        TotalEvaluations += Measurement.Evaluations;
+        Reschedules++;
+      }
+
+      if ( std::find( LoadCounts.begin(), LoadCounts.end(), Load )
+           != LoadCounts.end() )
+        Results[ Load ].push_back( Measurement );
+    }
+  }
+
+  std::filesystem::remove( PredictionFile );
+
+  // The statistics are then written to the property tree with one element
+  // for each number of concurrent loads.
+
+  pt::ptree Latencies;
+
+  for ( auto & Result : Results )
+  {
+    pt::ptree Entry;
+    double Sum = 0.0, Min = 0.0, Max = 0.0, Evaluations = 0.0;
+
+    for ( const BenchmarkProducer::Record & Measurement : Result.second )
+    {
+      double Milliseconds = std::chrono::duration< double, std::milli >(
+                            Measurement.Latency ).count();
+
+      Min  = ( Sum == 0.0 ? Milliseconds : std::min( Min, Milliseconds ) );
+      Max  = std::max( Max, Milliseconds );
+      Sum += Milliseconds;
+      Evaluations += Measurement.Evaluations;
+    }
+
+    Entry.put( "loads",          Result.first );
+    Entry.put( "mean_ms",        Sum / Result.second.size() );
+    Entry.put( "min_ms",         Min );
+    Entry.put( "max_ms",         Max );
+    Entry.put( "evaluations",    Evaluations / Result.second.size() );
+
+    Latencies.push_back( std::make_pair( "", Entry ) );
+  }
+
+  pt::ptree Schedule;
+
+  Schedule.add_child( "new_load_latency", Latencies );
+  Schedule.put( "evaluations_per_reschedule",
+                Reschedules > 0 ?
+                static_cast< double >( TotalEvaluations ) / Reschedules : 0.0 );
+  Schedule.put( "reschedules", Reschedules );
+
+  return Schedule;
+}
+
+// The interpolation benchmark evaluates each interpolation type for random
+// arguments one by one, and for the same arguments sorted in one batch.
+
+pt::ptree InterpolationBenchmark( unsigned long NumberOfEvaluations,
+                                  std::mt19937_64::result_type Seed )
+{
+  using Clock = std::chrono::steady_clock;
+
+  const std::vector< std::pair< std::string, Interpolation::Type > > Types = {
+    { "Linear",              Interpolation::Type::Linear              },
+    { "Polynomial",          Interpolation::Type::Polynomial          },
+    { "CubicSpline",         Interpolation::Type::CubicSpline         },
+    { "PeriodicCubicSpline", Interpolation::Type::PeriodicCubicSpline },
+    { "AkimaSpline",         Interpolation::Type::AkimaSpline         },
+    { "PeriodicAkimaSpline", Interpolation::Type::PeriodicAkimaSpline },
+    { "SteffenMethod",       Interpolation::Type::SteffenMethod       }
+  };
+
+  std::mt19937_64       Generator( Seed );
+  std::vector< double > Power( SolarPower( Generator, 3.0 ) ), Times;
+
+  for ( std::size_t i = 0; i < Power.size(); i++ )
+    Times.push_back( static_cast< double >( i * SampleInterval ) );
+
+  std::uniform_real_distribution< double > Argument( 0.0, DayLength );
+  std::vector< double > Arguments( NumberOfEvaluations ),
+                        Values( NumberOfEvaluations );
+
+  for ( double & x : Arguments )
+    x = Argument( Generator );
+
+  std::vector< double > SortedArguments( Arguments );
+  std::sort( SortedArguments.begin(), SortedArguments.end() );
+
+  pt::ptree Results;
+
+  for ( const auto & TheType : Types )
+  {
+    Interpolation Function( Times.begin(), Times.end(),
+                            Power.begin(), Power.end(), TheType.second );
+
+    // The sum of the values is reported to ensure that the evaluations are
+    // not optimised away by the compiler.
+
+    double Sum = 0.0;
+
+    Clock::time_point Start = Clock::now();
+
+    for ( double x : Arguments )
+      Sum += Function( x );
+
+    std::chrono::duration< double > Single = Clock::now() - Start;
+
+    Start = Clock::now();
+    Function.Evaluate( SortedArguments.data(), Values.data(),
+                       SortedArguments.size() );
+    std::chrono::duration< double > Batch = Clock::now() - Start;
+
+    pt::ptree Entry;
+
+    Entry.put( "type",                    TheType.first );
+    Entry.put( "evaluations",             NumberOfEvaluations );
+    Entry.put( "single_per_second",       NumberOfEvaluations / Single.count() );
+    Entry.put( "batch_per_second",        NumberOfEvaluations / Batch.count() );
+    Entry.put( "checksum",                Sum );
+
+    Results.push_back( std::make_pair( "", Entry ) );
+  }
+
+  return Results;
+}
+
+}  // End name space CoSSMic
+
+/*=============================================================================
+
+ Main
+
+=============================================================================*/
+
+int main( int argc, char **argv )
+{
+  cmd::options_description Description("Allowed options");
+  cmd::variables_map Values;
+
+  Description.add_options()
+    ( "help,h",  "Produce this help message" )
+    ( "Loads,l", cmd::value< std::vector< unsigned int > >()->multitoken()
+                 ->default_value( std::vector< unsigned int >{ 1, 5, 20, 50 },
+                                  "1 5 20 50" ),
+                 "Numbers of concurrent loads to measure" )
+    ( "Repetitions,R", cmd::value< unsigned int >()->default_value(5),
+                 "Repetitions of the scheduling scenario" )
+    ( "Interpolations,i", cmd::value< unsigned long >()->default_value(1000000),
+                 "Evaluations per interpolation type" )
+    ( "Seed,r", cmd::value< std::mt19937_64::result_type >()->default_value(1),
+                 "Seed for the scenarios" )
+    ( "Output,o", cmd::value< std::string >(),
+                 "File for the JSON results" );
+
+  try
+  {
+    cmd::store( cmd::parse_command_line( argc, argv, Description ), Values );
+
+    if ( Values.count("help") > 0 )
+    {
+      std::cout << Description << std::endl;
+      return EXIT_SUCCESS;
+    }
+
+    cmd::notify( Values );
+  }
+  catch ( std::exception & Error )
+  {
+    std::cout << Error.what() << std::endl << Description << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector< unsigned int > LoadCounts(
+    Values["Loads"].as< std::vector< unsigned int > >() );
+
+  if ( LoadCounts.empty() ||
+       ( *std::min_element( LoadCounts.begin(), LoadCounts.end() ) == 0 ) ||
+       ( Values["Repetitions"].as< unsigned int >() == 0 ) )
+  {
+    std::cout << "The numbers of loads and repetitions must be positive"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  #ifdef CoSSMic_DEBUG
+    Theron::ConsolePrintServer PrintServer( &std::cerr, "ConsolePrintServer" );
+  #endif
+
+  const std::mt19937_64::result_type Seed =
+    Values["Seed"].as< std::mt19937_64::result_type >();
+
+  pt::ptree Results;
+
+  Results.put( "seed", Seed );
+  Results.add_child( "schedule", CoSSMic::ScheduleBenchmark( LoadCounts,
+    Values["Repetitions"].as< unsigned int >(), Seed ) );
+  Results.add_child( "interpolation", CoSSMic::InterpolationBenchmark(
+    Values["Interpolations"].as< unsigned long >(), Seed ) );
+
+  if ( Values.count("Output") > 0 )
+    pt::write_json( Values["Output"].as< std::string >(), Results );
+  else
+    pt::write_json( std::cout, Results );
+
+  return EXIT_SUCCESS;
+}
@@ -17,6 +17,16 @@ be read from the same directory where the simulator executes.
 The events received by the Task Manager will be logged to a TaskManager.log 
 file for subsequent verification.
 
+Studies of the scheduler need many replications of the same neighbourhood with
+different random streams. The actors are known by global names within a 
+process, so the replications are run as concurrent child processes, each with
+its own actors, event queue and seed for the random generator. The load 
+profiles and predictions are parsed once by the parent process before the 
+children are started, and the children share these read-only. Each child 
+logs its events to TaskManager-<replication>.log and reports the energy 
+consumed and the energy taken from the grid back to the parent, which merges 
+the results with running statistics. 
+
 The CSV Parser used here is the Fast C++ CSV Parser by Ben Strasser available
 at [1] and licensed under the BSD license.
 
@@ -32,18 +42,29 @@ License: LGPL 3.0
 #include <memory>												// Smart, shared pointers
 #include <fstream>											// The Task Manager's log file
 #include <map>													// To remember load duration and energy
+#include <set>													// Task managers waiting for acknowledgement
 #include <sstream>						      		// For error reporting
 #include <stdexcept>										// For standard exceptions
 #include <chrono>									  		// For a real time wait management
 #include <thread>												// To pause only the current thread
+#include <vector>												// Replication processes and files
+#include <cstdint>											// Random generator seeds
+#include <iomanip>											// Formatting the replication report
+#include <unistd.h>											// Forking replication processes
+#include <sys/wait.h>										// Waiting for replication processes
+#include <optional>											// Assigned start times
+#include <filesystem>										// Copying checkpointed probabilities
 // Utilities
 #include "csv.h"												// The CSV file parser
-#include "RunningStatistics.hpp"	  		// To compute running statistics
+#include "MergeableStatistics.hpp"	  	// To compute replication statistics
+#include "RunningStatistics.hpp"	  		// Bounds on the acknowledgement delay
+#include "RandomGenerator.hpp"					// Seeding the replications
 // Actor framework headers
 #include "Actor.hpp"									  // The Theron++ actor framework
 #include "EventHandler.hpp"							// The event manager
 #include "ConsolePrint.hpp"				  		// Printing messages from actors
 #include "StandardFallbackHandler.hpp"	// Catch unhandled messages
+#include "TimerWheel.hpp"								// Delayed acknowledgements
 // CoSSMic headers
 #include "TimeInterval.hpp"							// The concept of time
 #include "Clock.hpp"										// The concept of moving time
@@ -54,13 +75,10 @@ License: LGPL 3.0
 #include "NetworkInterface.hpp"		  		// The communication endpoint
 #include "ShapleyReward.hpp"						// The reward calculator
 #include "Grid.hpp"											// The global grid producer
+#include "CSVtoTimeSeries.hpp"					// Parsing time series files
 
 namespace CoSSMic
 {
-// There is already an implementation in the CoSSMic of a function parsing a 
-// time series CSV file and converting it to a time-value map.
-	
-extern std::map< Time, double > CSVtoTimeSeries( std::string FileName );
 
 /*=============================================================================
 
@@ -84,232 +102,238 @@ extern std::map< Time, double > CSVtoTimeSeries( std::string FileName );
 // be re-shuffled. It is also not possible to implement this as a simple time 
 // out since the speed of the re-scheduling depends on the speed of the 
 // computer executing the re-scheduling and the number of producers that will 
-// be involved with the re-scheduling. The only thing that can be assumed 
-// however is that the assigned start time messages will come as a stream of 
-// messages, as fast as they can be computed. Hence, when there are no more 
-// messages left in the inbound queue for the Task Manager, a certain wait 
-// can be implemented and if no message has arrived during this wait, it 
-// is probably safe to move to the next action event in the event queue.
+// be involved with the re-scheduling. However, the re-shuffling is over when 
+// the actor system has no more messages to handle, and the actor framework 
+// detects this quiescence by counting the messages in flight and the pending 
+// time outs of all local actors.
 //
-// This strategy is implemented by a dedicated class to deal with all time
-// computations. Its operation is as follows (exemplified for the load 
-// scheduling):
+// The operation is as follows (exemplified for the load scheduling):
 //
 //		1. The Task Manager gets the Assigned Start Time message from a
 //       consumer.
 //		2. The Task Managers message handler immediately sends a message 
 // 	     to the Delayed Event Acknowledgement actor.
-//	  3. This message triggers that the Delayed Event Acknowledgement actor 
-//			 computes the time to wait with the acknowledgement, and
-//	  4. Sets up a thread to wait for the acknowledgement time to be due.
-//    5. When the time-out expires, it will send an acknowledgement back to 
+//	  3. This message makes the Delayed Event Acknowledgement actor ask the 
+//       actor framework to be notified when the actor system is quiescent.
+//    4. When the notification arrives, it will send an acknowledgement back to 
 //       the Task Mangaer, which will then acknowledge the event to the 
 //			 event queue, which will dispatch the next event that will move the 
 //			 simulator's clock to the time of the next event.
 //
-// If the message in (2) arrives when there is an active thread waiting for 
-// the time out, this thread will be cancelled and a new time out thread 
-// started. 
+// If the message in (2) arrives when there is a pending notification, the
+// acknowledgement will be sent with the pending notification since that will 
+// only arrive after all messages caused by the latest request.
 //
-// NOT YET IMPLEMENTED:
-// The time to wait computed in (3) is done via a sample Chebychev bounds, see
-// the implementation in the running statistics class. 
+// The quiescence only covers the local actors, and when the consumers or the 
+// producers are remote the local actor system may be idle while a start time 
+// assignment is still travelling over the network. A confidence level can 
+// therefore be given, and then the acknowledgement is further delayed by a 
+// wall clock time after the quiescence notification. The inter-arrival times
+// of the requests within a burst of start time assignments are recorded, and
+// the wait is the sample Chebychev bound on the inter-arrival time for the 
+// given confidence, see the implementation in the running statistics class.
+// A new request arriving during the wait cancels the wait and a new 
+// notification is requested. Until two inter-arrival times have been seen 
+// the default delay is used. Since the bound follows the speed of the 
+// computer and the network, it will typically shrink to milliseconds.
 
 class DelayedEventAcknowledgement : public Theron::Actor
 {
 public:
 	
-	// Delay times are given as durations as measured by the system clock, which
-	// means that general durations should be converted to system clock durations
-	// with the right period
-	
-	template< typename Representation, class Period >
-	static std::chrono::system_clock::duration DelayTime( 
-						const std::chrono::duration< Representation, Period > & GivenDelay )
-	{
-		return std::chrono::duration_cast< std::chrono::system_clock::duration >
-					 ( GivenDelay );
-	}
-	
-	// There is a standard function setting the default delay if no delay time 
-	// is given.
+	// The acknowledgement is requested by an empty message
 	
-	static std::chrono::system_clock::duration DelayTime( void )
+	class AcknowledgeWhenQuiescent
 	{
-		return std::chrono::system_clock::duration();
-	}
+	public:
+		
+		AcknowledgeWhenQuiescent( void ) = default;
+		AcknowledgeWhenQuiescent( const AcknowledgeWhenQuiescent & Other ) = default;
+	};
 	
-	// There is a default delay defined to avoid using changing the delay in 
-	// several places. Since the standard seconds are defined as a class, this 
-	// must be defined as a function since a class cannot be initiated as a 
-	// constant expression or in-line
+	// The wait before enough inter-arrival times have been recorded is a 
+	// constant that must be defined as a function since the standard durations
+	// are classes.
 	
-	constexpr static std::chrono::seconds DefaultDelay( void )
+	constexpr static std::chrono::milliseconds DefaultDelay( void )
 	{
-		return std::chrono::seconds( 10 );
+		return std::chrono::milliseconds( 1000 );
 	}
 	
-	// The real time delays are use the system clock and is bound by its
-	// resolution. It may neither be high resolution nor stable, but it is 
-	// consistent with the operating system's clock and therefore suitable when 
-	// the OS is responsible for waking up the thread at the time out.
+private:
 	
-	using TimePoint = std::chrono::system_clock::time_point;
+	// The task managers waiting for the acknowledgement are remembered, and 
+	// the notification is requested when the first task manager is waiting.
+	//
+	// A small complication is the fact that the event queue will use the sender's
+	// address to ensure that the right event is removed - this is important if 
+	// there are several actors sending events to the event queue, and events 
+	// from several actors have the same event time. Then only one of the events
+	// from the actor sending the acknowledgement will be removed. This implies
+	// that the acknowledgement is sent to the task manager owning the event, 
+	// and it is the task manager that acknowledges the event.
 	
-  // The time to wake up is also recorded to decide if it is longer than the 
-	// current wake up time.
-
-private:
+	std::set< Theron::Address > WaitingTaskManagers;
+	bool 												NotificationPending;
 	
-  TimePoint WakeUpTime;
+	// The statistics of the inter-arrival times are kept in seconds together 
+	// with the probability that the next request will arrive later than the 
+	// wait. A zero probability means that there is no wait after the 
+	// quiescence notification.
 	
-	// There is also a mutex and a condition variable to ensure that the waiting 
-	// thread is woken up by one of two events: Either the wait times out and the 
-	// acknowledgement should be sent, or another start time message is received
-	// and the wait is cancelled and replaced with another time out.
+	GSL::ChebychevBound							 InterArrivalTimes;
+	double 													 ExceedProbability;
+	std::chrono::steady_clock::time_point LastRequest;
 	
-	std::mutex 		    		  TimeOutGuard;
-  std::condition_variable TimeOutEvent;
+	// The wait is a time out on the timer wheel, and the time out message 
+	// carries the number of requests seen when the wait was started so that 
+	// a time out that could not be cancelled will be ignored if there has 
+	// been a new request.
 	
-	// The actual wait happens in a separate thread so that the actor system 
-	// can continue to execute messages as before.
+	class WaitExpired
+	{
+	public:
+		
+		const std::uint64_t Requests;
+		
+		WaitExpired( std::uint64_t RequestCount )
+		: Requests( RequestCount )
+		{}
+		
+		WaitExpired( const WaitExpired & Other ) = default;
+	};
 	
-	std::thread TimeOutThread;
+	std::uint64_t 							 RequestCount;
+	Theron::TimerWheel::TimerID Wait;
 	
-	// This thread executes a waiting function that will set up a lock on the 
-	// mutex and wait for the a time out event on the condition variable. If 
-	// the time out happens it will acknowledge the pending event to the the 
-	// event queue. 
-	// 
-	// A small complication is the fact that the event queue will use the sender's
-	// address to ensure that the right event is removed - this is important if 
-	// there are several actors sending events to the event queue, and events 
-	// from several actors have the same event time. Then only one of the events
-	// from the actor sending the acknowledgement will be removed. This implies
-	// that the delayed acknowledgement must personalise as the actor owning 
-	// the event and setting up the delayed acknowledgement.
+	// Acknowledging is to send the event completed message to all waiting 
+	// task managers.
 	
-	void Wait( const Theron::Address TheTaskManager )
+	void Acknowledge( void )
 	{
-		std::unique_lock< std::mutex > WaitLock( TimeOutGuard );
+		for ( const Theron::Address & TheTaskManager : WaitingTaskManagers )
+			Send( Theron::EventData::EventCompleted(), TheTaskManager );
 		
-	  if ( TimeOutEvent.wait_until( WaitLock, WakeUpTime ) 
-																								    == std::cv_status::timeout )
-		 Send( Theron::EventData::EventCompleted(), TheTaskManager );
+		WaitingTaskManagers.clear();
 	}
 	
-	// There is a simple function to terminate the time out thread by signalling 
-	// the condition variable if the thread is running.
-	
-  void TerminateWait( void )
-  {
-    if ( TimeOutThread.joinable() )
-    { 
-			// The notification requires a lock (undocumented) and a standard 
-			// guard variable is used. It is encapsulated in a separate code block
-			// to ensure that it is released before we start waiting for the 
-			// thread to terminate. This because the condition variable will lock
-			// the global mutex before terminating the wait so that the thread 
-			// function knows it has locked access to data when it wakes up.
+	void RequestAcknowledgement( const AcknowledgeWhenQuiescent & TheRequest, 
+															 const Theron::Address TheTaskManager )
+	{
+		auto RequestTime = std::chrono::steady_clock::now();
+		
+		// The time since the previous request is only recorded if this request 
+		// is part of a burst, i.e. there is already a task manager waiting. A 
+		// pending wait is cancelled since the burst is not over, and the time
+		// out would otherwise hold the actor system from being quiescent.
+		
+		if ( !WaitingTaskManagers.empty() )
+		{
+			InterArrivalTimes << std::chrono::duration< double >( 
+													 RequestTime - LastRequest ).count();
 			
+			if ( Wait != Theron::TimerWheel::NullTimer )
 			{
-			  std::lock_guard< std::mutex > Guard( TimeOutGuard );
-			  TimeOutEvent.notify_one();
-			}
-			TimeOutThread.join();
-    }
-  }
-    
-	// The handler for the assigned start time message fundamentally records how 
-	// long it has been since the last start time provided that this new message 
-	// arrives as a burst of start times. Based on all inter-arrival times seen, 
-	// it computes an expected wait time for the next assignment event. If no new 
-	// start time  message has been received within this time window, the event 
-	// creating the start time message will be acknowledged. Otherwise, the wait 
-	// will be cancelled and a new epoch defined for as an upper limit for the 
-	// wait on the next assignment.
-		
-  void AssignmentDelay( const std::chrono::system_clock::duration & GivenDelay, 
-											  const Theron::Address TheTaskManager )
-	{		
-		// The fundamental operation is to compute a time to wait for the burst of
-		// assigned start time events to cease, and this is a duration variable of
-		// the system clock. 
-		
-		std::chrono::system_clock::duration TimeToWait( GivenDelay );
-
-		// The time of invocation is taken as the absolute time of this assignment
-		
-		TimePoint AssignmentTime = std::chrono::system_clock::now();
-		
-		// Time intervals must be recorded only if there is a burst of assignments
-		// coming. The time between two assignments should not be counted because 
-		// it is only interesting to know how long it is necessary to wait for the 
-		// next assignment before sending the event acknowledgement. As the whole 
-		// point is to wait with the acknowledgement long enough to allow for the 
-		// next assignment, the Time Out thread should be active if this assignment
-		// takes place within a burst, and terminated (or not started) if this is 
-		// the first assignment of a new burst. 
-		
-		if ( TimeOutThread.joinable() )
-		{			
-			// If this leads to a wake up time which is larger than the current 
-			// wake up time, the the waiting thread should be cancelled and 
-			// a thread started for this new wake up time.
-				
-			if ( AssignmentTime + TimeToWait > WakeUpTime )
-			{
-				TerminateWait();
-				WakeUpTime = AssignmentTime + TimeToWait;
-				
-			  TimeOutThread = std::thread( &DelayedEventAcknowledgement::Wait,
-																	   this, TheTaskManager );			
+				Theron::TimerWheel::Service().Cancel( Wait );
+				Wait = Theron::TimerWheel::NullTimer;
 			}
 		}
-		else
+		
+		LastRequest = RequestTime;
+		RequestCount++;
+		
+		if ( !NotificationPending )
 		{
-			// In this case there is no running thread so the wake up time can be 
-			// set and the thread to wait for this time started.
-			
-			WakeUpTime = AssignmentTime + TimeToWait;
-			TimeOutThread = std::thread( &DelayedEventAcknowledgement::Wait,
-		  													   this, TheTaskManager );			
+			NotificationPending = true;
+			Theron::Actor::NotifyWhenQuiescent( GetAddress() );
 		}
 		
+		WaitingTaskManagers.insert( TheTaskManager );
+		
 	  #ifdef CoSSMic_DEBUG
 		  Theron::ConsolePrint DebugMessage;
 		  
-			DebugMessage << Now() << " Assignment time " 
-									 << std::chrono::system_clock::to_time_t( AssignmentTime )
-									 << " Time to wait " 
-									 << std::chrono::duration_cast< std::chrono::seconds >( TimeToWait ).count()
-									 << " current wake up time " 
-									 << std::chrono::system_clock::to_time_t( WakeUpTime ) 
-									 << std::endl;
+			DebugMessage << Now() << " Acknowledgement requested with " 
+									 << Theron::Actor::NumPendingActivities()
+									 << " pending activities" << std::endl;
 		#endif
 	}
 	
-	// The constructor takes framework Then it takes the address of the event 
-	// handler actor receiving the acknowledgements and the name assigned to this 
-	// actor. By default it assumes an automatically assigned actor name.
+	// When the notification arrives, there are no more messages to handle, and 
+	// the waiting task managers can acknowledge their events unless there 
+	// should be a wait for remote assignments.
 	
-public:
+	void SystemQuiescent( const Theron::Actor::Quiescent & TheNotification, 
+												const Theron::Address TheFramework )
+	{
+		NotificationPending = false;
+		
+		if ( WaitingTaskManagers.empty() ) return;
+		
+		if ( ExceedProbability > 0.0 )
+		{
+			std::chrono::duration< double > TimeToWait( DefaultDelay() );
+			
+			if ( InterArrivalTimes.N() > 1 )
+				TimeToWait = std::chrono::duration< double >( 
+										 InterArrivalTimes.Bound( ExceedProbability ) );
+			
+			Wait = Theron::TimerWheel::Service().ScheduleMessage( 
+						 std::chrono::duration_cast< Theron::TimerWheel::Duration >( 
+										 TimeToWait ), 
+						 WaitExpired( RequestCount ), GetAddress(), GetAddress() );
+		}
+		else
+			Acknowledge();
+	}
 	
-	DelayedEventAcknowledgement( const std::string & name = std::string()	)
-	: Theron::Actor( name.empty() ? nullptr : name.data() ),
-	  WakeUpTime(), TimeOutGuard(), TimeOutEvent(), TimeOutThread()
+	// The wait has expired without new requests if the request count is 
+	// still the same as when the wait was started.
+	
+	void EndWait( const WaitExpired & TheTimeOut, const Theron::Address Self )
 	{
-		RegisterHandler( this, &DelayedEventAcknowledgement::AssignmentDelay );
+		if ( TheTimeOut.Requests == RequestCount )
+		{
+			Wait = Theron::TimerWheel::NullTimer;
+			Acknowledge();
+		}
 	}
 	
-	// There should not be a need to wait for the thread to terminate since 
-	// that would imply that the associated acknowledgement might not have 
-	// been sent. However it will make a good point to place a  break point...
+	// The constructor takes the name assigned to this actor. By default it 
+	// assumes an automatically assigned actor name. The confidence is the 
+	// probability that no further assignment will arrive after the 
+	// acknowledgement, and the default zero confidence means that the 
+	// acknowledgement is sent as soon as the local actors are quiescent.
 	
-	~DelayedEventAcknowledgement( void )
+public:
+	
+	DelayedEventAcknowledgement( const std::string & name = std::string(), 
+															 double Confidence = 0.0 )
+	: Theron::Actor( name.empty() ? nullptr : name.data() ),
+	  WaitingTaskManagers(), NotificationPending( false ), InterArrivalTimes(),
+	  ExceedProbability( 0.0 ), LastRequest(), RequestCount( 0 ), 
+	  Wait( Theron::TimerWheel::NullTimer )
 	{
-		TerminateWait();
+		if ( ( Confidence < 0.0 ) || ( 1.0 <= Confidence ) )
+		{
+			std::ostringstream ErrorMessage;
+			
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "The acknowledgement confidence " << Confidence 
+									 << " must be in [0.0, 1.0)";
+			
+			throw std::out_of_range( ErrorMessage.str() );
+		}
+		else if ( Confidence > 0.0 )
+			ExceedProbability = 1.0 - Confidence;
+		
+		RegisterHandler( this, &DelayedEventAcknowledgement::RequestAcknowledgement );
+		RegisterHandler( this, &DelayedEventAcknowledgement::SystemQuiescent );
+		RegisterHandler( this, &DelayedEventAcknowledgement::EndWait );
 	}
+	
+	~DelayedEventAcknowledgement( void )
+	{ }
 };
 
 /*=============================================================================
@@ -349,6 +373,22 @@ public:
 private:
 	
 	std::ofstream LogFile;
+	
+	// The energy of the completed loads is accumulated together with the part 
+	// of this energy that has been provided by the grid, so that the outcome of
+	// the simulation can be reported.
+	
+	double ConsumedEnergy, GridEnergy;
+	
+public:
+	
+	inline double GetConsumedEnergy( void ) const
+	{ return ConsumedEnergy; }
+	
+	inline double GetGridEnergy( void ) const
+	{ return GridEnergy; }
+	
+private:
 
   // ---------------------------------------------------------------------------
   // Acknowledgement
@@ -553,72 +593,48 @@ private:
 		std::string 					    ThePVProducer;
 		PVProducer::NewPrediction TheMessage;
 		
-		// The acknowledgement object for the update prediction will set an 
-		// initial delay when constructed, and remember the time for the time 
-		// out. Since updating the prediction could result in a burst of assigned
-		// start times, it will add an offset to the end of the block time. When 
-		// the time out happens, it will check against the system clock and if 
-		// this is later than the release time for the next event, it will return
-		// true, otherwise, it will wait for the lag time between the current 
-		// clock time and the release time.
+		// The acknowledgement object for the update prediction will request the 
+		// delayed acknowledgement when constructed. Since updating the prediction 
+		// could result in a burst of assigned start times, the acknowledgement 
+		// will only arrive when all these assignments have been made and the 
+		// actor system is quiescent.
 		
 		class AcknowledgePredictionUpdate : public AcknowledgeEvent
 		{
 		private:
 			
-			DelayedEventAcknowledgement::TimePoint ReleaseTime;
 			TaskManager * const TheTaskManager;
 			
 		public:
 			
 			// When an ID is checked it will be because one of the loads has been 
-			// assigned a new start time, and the wait should just be extended to 
-			// ensure that there is time to receive potentially other assignments 
-			// that might arrive.
+			// assigned a new start time, and this is covered by the pending 
+			// acknowledgement.
 			
 			virtual bool CheckID( const IDType & ID )
 			{
-				ReleaseTime = std::chrono::system_clock::now() + 
-											DelayedEventAcknowledgement::DefaultDelay();
-											
 				return false;
 			}
 			
-			// The time out function will just acknowledge the event if the time is 
-			// after the release time, otherwise set up a new delay for the time 
-			// remaining to the release time.
+			// The time out function will just acknowledge the event since the 
+			// actor system has completed the re-scheduling.
 			
 			virtual bool TimeOut( void )
 			{
-				if ( std::chrono::system_clock::now() >= ReleaseTime  )
-				{
-				  TheTaskManager->Send( Theron::EventData::EventCompleted(), 
-																TheTaskManager->EventQueue );
-					return true;
-				}
-				else
-				{
-					auto AdditionalWait = DelayedEventAcknowledgement::DelayTime( 
-														    ReleaseTime - std::chrono::system_clock::now());
-					
-					TheTaskManager->Send( AdditionalWait, 
-																TheTaskManager->DelayedAcknowledgement );
-					return false;
-				}
+			  TheTaskManager->Send( Theron::EventData::EventCompleted(), 
+															TheTaskManager->EventQueue );
+				return true;
 			}
 			
-			// The constructor stores the task manager and initialises the first 
-			// release time. 
+			// The constructor stores the task manager and requests the 
+			// acknowledgement.
 			
 			AcknowledgePredictionUpdate( TaskManager * TheManager )
 			: AcknowledgeEvent(), TheTaskManager( TheManager )
 			{
-				ReleaseTime = std::chrono::system_clock::now() + 
-											DelayedEventAcknowledgement::DefaultDelay();
-											
-				TheTaskManager->Send( DelayedEventAcknowledgement::DelayTime( 
-															DelayedEventAcknowledgement::DefaultDelay() ), 
-															TheTaskManager->DelayedAcknowledgement );
+				TheTaskManager->Send( 
+					DelayedEventAcknowledgement::AcknowledgeWhenQuiescent(), 
+					TheTaskManager->DelayedAcknowledgement );
 			}
 			
 			// The destructor does nothing in this case.
@@ -745,15 +761,15 @@ private:
 				return true;
 			}
 	
-			// The constructor stores the task manager pointer and sets up the delay
-			// for the proper actions to be taken by the Actor Manager.
+			// The constructor stores the task manager pointer and requests the 
+			// acknowledgement when the Actor Manager has taken the proper actions.
 			
 			AcknowledgeCreateProducer( TaskManager * TheManager )
 			: AcknowledgeEvent(), TheTaskManager( TheManager )
 			{
-				TheTaskManager->Send( DelayedEventAcknowledgement::DelayTime( 
-															DelayedEventAcknowledgement::DefaultDelay() ), 
-															TheTaskManager->DelayedAcknowledgement );
+				TheTaskManager->Send( 
+					DelayedEventAcknowledgement::AcknowledgeWhenQuiescent(), 
+					TheTaskManager->DelayedAcknowledgement );
 			}
 	
 			virtual ~AcknowledgeCreateProducer( void )
@@ -840,11 +856,11 @@ private:
 		// before the load has been assigned a start time. It is even possible that
 		// this will lead to many loads needing to change their start times, and 
 		// the delayed acknowledgement is used. This delayed acknowledgement will 
-		// be set up only when the start time is assigned for this load. Other start 
-		// times may be assigned before this one, and others may follow. the ones 
-		// following the assignment of a start time for this load will just extend
-		// the delay of the acknowledgement. This object is created and returned 
-		// by the event's acknowledgement function.
+		// be requested only when the start time is assigned for this load. Other 
+		// start times may be assigned before this one, and others may follow, and 
+		// the ones following the assignment of a start time for this load will be 
+		// made before the actor system is quiescent. This object is created and 
+		// returned by the event's acknowledgement function.
 
 		class WaitForAssignment : public AcknowledgeEvent
 		{
@@ -855,13 +871,6 @@ private:
 			
 			const IDType LoadID;
 			
-			// It needs a time for the earliest release of the acknowledgement, and 
-			// this will increase with the number of loads that are assigned start
-			// times so that the release time is always the default delay after the 
-			// the last assignment.
-			
-			DelayedEventAcknowledgement::TimePoint ReleaseTime;
-			
 			// The task manager pointer must also be remembered since this class is 
 			// not derived from the Event class;
 			
@@ -870,49 +879,34 @@ private:
 		public:
 			
 			// The Check ID function is called when a start time is assigned and 
-			// it will ignore assignments before the ID just created, and after 
-			// that it will only extend the release time. It will always return 
-			// false because the acknowledgement will happen only when the time out 
-			// occurs.
+			// it will ignore assignments other than for the ID just created. It will 
+			// always return false because the acknowledgement will happen only when 
+			// the actor system is quiescent.
 			
 			virtual bool CheckID( const IDType & ID )
 			{
 				if ( ID == LoadID )
-					TheTaskManager->Send( DelayedEventAcknowledgement::DelayTime( 
-														    DelayedEventAcknowledgement::DefaultDelay() ), 
-														    TheTaskManager->DelayedAcknowledgement);
-
-				ReleaseTime = std::chrono::system_clock::now() + 
-											DelayedEventAcknowledgement::DefaultDelay();
+					TheTaskManager->Send( 
+						DelayedEventAcknowledgement::AcknowledgeWhenQuiescent(), 
+						TheTaskManager->DelayedAcknowledgement );
 
 				return false;
 			}
 			
-			// When the time out is signalled, then a new time out is set up if time
-			// is not the release time, otherwise the event is acknowledged. 
+			// When the time out is signalled, the event is acknowledged. 
 			
 			virtual bool TimeOut( void )
 			{
-				if ( std::chrono::system_clock::now() >= ReleaseTime )
-				{
-					TheTaskManager->Send( Theron::EventData::EventCompleted(), 
-																TheTaskManager->EventQueue );
-					return true;
-				}
-				else
-				{
-					TheTaskManager->Send( DelayedEventAcknowledgement::DelayTime( 
-																ReleaseTime - std::chrono::system_clock::now()), 
-																TheTaskManager->DelayedAcknowledgement );
-					return false;
-				}
+				TheTaskManager->Send( Theron::EventData::EventCompleted(), 
+															TheTaskManager->EventQueue );
+				return true;
 			}
 			
 			// The constructor takes the ID and the task manager pointer and stores
 			// these for reference by the Acknowledge function.
 			
 			WaitForAssignment( const IDType & TheLoadID, TaskManager * TheManager  )
-			: LoadID( TheLoadID ), ReleaseTime(), TheTaskManager( TheManager )
+			: LoadID( TheLoadID ), TheTaskManager( TheManager )
 			{	}
 			
 			// Currently the virtual destructor does nothing
@@ -1162,7 +1156,12 @@ private:
 	// manager should know the duration of the load, and the energy it has 
 	// consumed. In the real life, the consumed energy is measured, but in the 
 	// simulated world it is just taken to be equal to the energy amount suggested
-	// by the load profile. The information is captured in a small class
+	// by the load profile. The information is captured in a small class. 
+	//
+	// The time the load was submitted, its allowed start interval, its profile,
+	// and the assigned start time are also kept so that a load that has not 
+	// started can be submitted again when the simulation is restored from a 
+	// checkpoint.
 	
 	class LoadInformation
 	{
@@ -1171,9 +1170,14 @@ private:
 		Time   				 								Duration;
 		double 				 							  ConsumedEnergy;
 		std::shared_ptr< DeleteLoad > DeleteEvent;
-		
-		LoadInformation( Time Delta, double TheEnergy )
-		: DeleteEvent()
+		Time 													SubmitTime, EarliestStartTime, LatestStartTime;
+		std::string 									LoadProfile;
+		std::optional< Time > 				StartTime;
+		
+		LoadInformation( Time Delta, double TheEnergy, Time Submitted, 
+										 Time EST, Time LST, const std::string & Profile )
+		: DeleteEvent(), SubmitTime( Submitted ), EarliestStartTime( EST ),
+		  LatestStartTime( LST ), LoadProfile( Profile ), StartTime()
 		{
 			Duration 			 = Delta;
 			ConsumedEnergy = TheEnergy;
@@ -1183,16 +1187,26 @@ private:
 		// move constructors.
 		
 		LoadInformation( const LoadInformation & AnotherInformation )
-		: Duration(       AnotherInformation.Duration ),
-		  ConsumedEnergy( AnotherInformation.ConsumedEnergy ),
-		  DeleteEvent(    AnotherInformation.DeleteEvent )
+		: Duration(       	 AnotherInformation.Duration ),
+		  ConsumedEnergy( 	 AnotherInformation.ConsumedEnergy ),
+		  DeleteEvent(    	 AnotherInformation.DeleteEvent ),
+		  SubmitTime( 			 AnotherInformation.SubmitTime ),
+		  EarliestStartTime( AnotherInformation.EarliestStartTime ),
+		  LatestStartTime( 	 AnotherInformation.LatestStartTime ),
+		  LoadProfile( 			 AnotherInformation.LoadProfile ),
+		  StartTime( 				 AnotherInformation.StartTime )
 		{	}
 		
 
   	LoadInformation( const LoadInformation && AnotherInformation )
-		: Duration(       AnotherInformation.Duration ),
-		  ConsumedEnergy( AnotherInformation.ConsumedEnergy ),
-		  DeleteEvent(    AnotherInformation.DeleteEvent )
+		: Duration(       	 AnotherInformation.Duration ),
+		  ConsumedEnergy( 	 AnotherInformation.ConsumedEnergy ),
+		  DeleteEvent(    	 AnotherInformation.DeleteEvent ),
+		  SubmitTime( 			 AnotherInformation.SubmitTime ),
+		  EarliestStartTime( AnotherInformation.EarliestStartTime ),
+		  LatestStartTime( 	 AnotherInformation.LatestStartTime ),
+		  LoadProfile( 			 AnotherInformation.LoadProfile ),
+		  StartTime( 				 AnotherInformation.StartTime )
 		{	}
 
 	};
@@ -1250,6 +1264,8 @@ private:
 			this, AST.GetLoadID(), TheLoad->second.ConsumedEnergy, AST.GetProducerID()
 		);
 		
+		TheLoad->second.StartTime = AST.GetStartTime();
+		
 		// Writing the event to the log file
 		
 		LogFile << Now() << " AST = " << AST.GetStartTime()
@@ -1317,6 +1333,8 @@ private:
 		else
 			Send( Theron::EventData::EventCompleted(), EventQueue );
 		
+		TheLoad->second.StartTime.reset();
+		
 		LogFile << Now() <<  " Cancel start time for load " 
 						<< Cancellation.GetLoadID() << std::endl;
 	}
@@ -1324,6 +1342,10 @@ private:
 	// Standard events dispatched from the event manager will come as an event 
 	// reference message, and this event will simply be executed and then the 
 	// acknowledgement set up according to the behaviour for this event type.
+	// If the event files are streamed, the events up to the end of the window
+	// starting at the current time are read before the event is executed so 
+	// that they are in the event queue before the event is acknowledged. A 
+	// checkpoint is written before the event is executed if it is due.
 	
 	void HandleEvent( const EventReference & TheEvent, 
 										const Theron::Address TheEventDispatcher )
@@ -1335,6 +1357,14 @@ private:
 								   << TheEvent->GetEventType() << std::endl;
 		#endif
 
+		if ( CheckpointDue() )
+			SaveCheckpoint();
+		
+		LastEventTime = Now();
+		
+		if ( EventWindow > 0 )
+			ReadEventsAhead( Now() + EventWindow );
+		
 		TheEvent->ExecuteEvent();
 		PendingAcknowledgement = TheEvent->Acknowledgement();
 	}
@@ -1371,7 +1401,12 @@ private:
 			  DebugMessage << "Removing " << TheLoad->first << " by request from "
 								     << Sender.AsString() << std::endl;
 		  #endif
-										 
+			
+			ConsumedEnergy += TheMessage.GetEnergy();
+			
+			if ( TheMessage.GetProducer() == Grid::ID() )
+				GridEnergy += TheMessage.GetEnergy();
+			
 			ActiveLoads.erase( TheLoad );
 	  }
 		else
@@ -1405,9 +1440,11 @@ private:
 		
 		// If the last load was deleted, the simulation should terminate and 
 		// the actor manager is asked to close. After this no more start times 
-		// will be assigned and the log file can be closed.
+		// will be assigned and the log file can be closed. However, if the 
+		// consumer events are streamed, there may be loads still not read from 
+		// the event file, and one more is read to see if the file is exhausted.
 		
-		if ( ActiveLoads.empty() )
+		if ( ActiveLoads.empty() && !( LoadEvents && ReadLoadEvent() ) )
 		{
 			Send( CoSSMic::ActorManager::ShutdownMessage(), ActorManager );
 			LogFile.close();
@@ -1440,6 +1477,60 @@ private:
 		#endif
 	}
 		
+  // ---------------------------------------------------------------------------
+  // Event files
+  // ---------------------------------------------------------------------------
+  //
+  // The producer and consumer events are read from two event files. Originally
+  // both files were read completely when the task manager was constructed, and
+  // all the events were enqueued with the event manager before the simulation 
+  // started. For scenarios covering months of simulated time with many 
+  // households this means that the event queue holds all future events, and 
+  // that all load profiles must be parsed before the first event is 
+  // dispatched. Therefore the files can be read as streams: The events are 
+  // read ahead of the simulated clock in a window of a given number of seconds,
+  // and the next chunk of events is read every time an event is dispatched. 
+  // This requires that the event files are sorted on the event time, which 
+  // is verified when the events are read.
+  //
+  // The correctness of the streaming relies on the event manager dispatching 
+  // the events in time order: When the event at time t is dispatched, the 
+  // files are read until the last event read has a time stamp beyond t plus 
+  // the window. Hence, all events with a time stamp before this have been 
+  // enqueued before the dispatched event is acknowledged, and the event 
+  // manager will never miss an event that should have been dispatched before 
+  // the events already in its queue. A window of zero seconds means that the 
+  // files are read completely when the task manager starts, as before.
+	
+private:
+	
+	using ProducerEventReader = 
+		io::CSVReader<3, io::trim_chars<'\t'>, io::no_quote_escape<';'> >;
+	using LoadEventReader = 
+		io::CSVReader<5, io::trim_chars<'\t'>, io::no_quote_escape<';'> >;
+	
+	std::unique_ptr< ProducerEventReader > ProducerEvents;
+	std::unique_ptr< LoadEventReader >     LoadEvents;
+	
+	// The time stamp of the last event read from each of the files is kept to 
+	// know when the files have been read sufficiently far ahead, and to check 
+	// that the events are sorted in time.
+	
+	Time LastProducerEvent, LastLoadEvent;
+	
+	// The width of the read ahead window in seconds is constant for the 
+	// simulation.
+	
+	const Time EventWindow;
+	
+	// Given that the initial event for a producer is to create it, while 
+	// subsequent events will be to update the prediction file, it is necessary
+	// to remember the producers created. The associated prediction file name 
+	// is also stored since it will be used to find the latest time of any 
+	// prediction (to be used for setting the simulation stop time).
+	
+	std::map< IDType, std::string >	TheProducers;
+	
   // ---------------------------------------------------------------------------
   // Utilities 
   // ---------------------------------------------------------------------------
@@ -1454,113 +1545,346 @@ private:
   // prediction update file for each producer will be opened and checked for the 
   // time of the last time stamp, and then the maximum value of these last times
   // will be used as the simulation stop time.
+	//
+	// The function reads one line of the producer event file and submits the 
+	// corresponding event. It returns false and closes the file when there are 
+	// no more events to read.
   
-private:
-	
-	void CreateProducerEvents( const std::string & EventFileName  )
+	bool ReadProducerEvent( void )
 	{
-		// Given that the initial event for a producer is to create it, while 
-		// subsequent events will be to update the prediction file, it is necessary
-		// to remember the producers created. The associated prediction file name 
-		// is also stored since it will be used to find the latest time of any 
-		// prediction (to be used for setting the simulation stop time).
-		
-	  std::map< IDType, std::string >	TheProducers;
-		
-		// The producer event file has three columns, and they are separated by 
-		// a semicolon
-  
-	  io::CSVReader<3, io::trim_chars<'\t'>, io::no_quote_escape<';'> > 
-	      CSVParser( EventFileName );
-				
-		CSVParser.set_header("Time", "ID", "PredictionFileName");
-		
 		// Variables to be filled by the parser
 		
 		Time 					TimeStamp;
 		std::string 	IDText, PredictionFileName;
 		
-		// Then the event file can be parsed. The ID has to be parsed as a string
-		// and then converted to a real ID since the parser does not support 
-		// direct parsing of user defined types
+		if ( !ProducerEvents->read_row( TimeStamp, IDText, PredictionFileName ) )
+		{
+			ProducerEvents.reset();
+			return false;
+		}
 		
-		while ( CSVParser.read_row( TimeStamp, IDText, PredictionFileName ) )
+		CheckEventOrder( TimeStamp, LastProducerEvent, "producer" );
+		
+		// Events before the time of a restored checkpoint have already been 
+		// taken into account by the checkpoint.
+		
+		if ( TimeStamp < RestoredTime ) return true;
+		
+		// The ID has to be parsed as a string and then converted to a real ID 
+		// since the parser does not support direct parsing of user defined types
+		
+	  IDType ProducerID( IDText );
+		auto KnownProducer = TheProducers.find( ProducerID );
+		
+		if ( KnownProducer == TheProducers.end() )
+	  {
+			// The producer is not known and it should be stored and the create 
+			// producer event must be submitted.
+			
+			TheProducers.emplace( ProducerID, PredictionFileName );
+			
+			EventReference TheEvent( 
+				new CreateProducer( this, 
+														ActorManager::AddProducer::Type::PhotoVoltaic, 
+													  ProducerID, PredictionFileName ) );
+			
+			Send( EventMessage( TimeStamp, TheEvent), EventQueue );
+		} 
+		else
 		{
-		  IDType ProducerID( IDText );
-			auto KnownProducer = TheProducers.find( ProducerID );
+			// The producer has already been created and the file name of the last
+			// submitted prediction must be updated, and an update event must be 
+			// created and submitted.
 			
-			if ( KnownProducer == TheProducers.end() )
-		  {
-				// The producer is not known and it should be stored and the create 
-				// producer event must be submitted.
-				
-				TheProducers.emplace( ProducerID, PredictionFileName );
-				
-				EventReference TheEvent( 
-					new CreateProducer( this, 
-															ActorManager::AddProducer::Type::PhotoVoltaic, 
-														  ProducerID, PredictionFileName ) );
-				
-				Send( EventMessage( TimeStamp, TheEvent), EventQueue );
-			} 
-			else
-			{
-				// The producer has already been created and the file name of the last
-				// submitted prediction must be updated, and an update event must be 
-				// created and submitted.
-				
-				KnownProducer->second = PredictionFileName;
-				
-				EventReference TheEvent( 
-					new UpdatePrediction( this, ProducerID, PredictionFileName )  );
-				
-				Send( EventMessage( TimeStamp, TheEvent ), EventQueue );
-			}
-		}		
+			KnownProducer->second = PredictionFileName;
+			
+			EventReference TheEvent( 
+				new UpdatePrediction( this, ProducerID, PredictionFileName )  );
+			
+			Send( EventMessage( TimeStamp, TheEvent ), EventQueue );
+		}
+		
+		return true;
 	}
 	
-	// The consumer events will simply submit all the load creation events, and 
+	// The consumer events will simply submit the load creation events, and 
 	// then register the consumers in the active loads map. However, in order to
 	// extract the total energy consumption of the load and its duration, the 
 	// associated load profile file must be opened and the last values stored. 
+	// The columns are the time of the event; the earliest start time for the 
+	// load; the latest start time for the load; the ID of the device; and 
+	// the load profile. 
 	
-	void CreateLoadEvents( const std::string & EventFileName )
+	bool ReadLoadEvent( void )
 	{
-		io::CSVReader<5, io::trim_chars<'\t'>, io::no_quote_escape<';'> > 
-	      CSVParser( EventFileName );
-				
-		// The columns are the time of the event; the earliest start time for the 
-		// load; the latest start time for the load; the ID of the device; and 
-		// the load profile. 
-		
-		CSVParser.set_header( "Time", "EST", "LST", "ID", "LoadProfile" );
-		
-		// The variables to store the fields per line
-		
 		Time 			 	 TimeStamp, EarliestStartTime, LatestStartTime;
 		std::string  IDText, LoadProfileFileName;
 		
-		while ( CSVParser.read_row( TimeStamp, EarliestStartTime, LatestStartTime,
+		if ( !LoadEvents->read_row( TimeStamp, EarliestStartTime, LatestStartTime,
 																IDText, LoadProfileFileName	) )
 		{
-			IDType ConsumerID( IDText );
+			LoadEvents.reset();
+			return false;
+		}
 		
-			EventReference TheEvent( new SubmitLoad( this, 
-				 EarliestStartTime, LatestStartTime, ConsumerID, LoadProfileFileName ) );
-			
-			Send( EventMessage( TimeStamp, TheEvent ), EventQueue );
+		CheckEventOrder( TimeStamp, LastLoadEvent, "consumer" );
+		
+		if ( TimeStamp < RestoredTime ) return true;
+		
+		IDType ConsumerID( IDText );
+	
+		EventReference TheEvent( new SubmitLoad( this, 
+			 EarliestStartTime, LatestStartTime, ConsumerID, LoadProfileFileName ) );
+		
+		Send( EventMessage( TimeStamp, TheEvent ), EventQueue );
+		
+		// In order to register this as an active load it is necessary to parse 
+		// the load profile in order to find the duration of the load 
+		// corresponding to the last time stamp in the profile file since all 
+		// load profiles should be time relative and start at time zero.
+		
+		TimeSeries LoadProfile;
+		
+		CSVtoTimeSeries( LoadProfileFileName, LoadProfile );
+		
+		ActiveLoads.emplace( ConsumerID, LoadInformation( 
+			LoadProfile.LastTime(), LoadProfile.LastValue(), TimeStamp, 
+			EarliestStartTime, LatestStartTime, LoadProfileFileName )	); 
+		
+		return true;
+	}
+	
+	// The event order is only important when the files are streamed, and an 
+	// unsorted file will then throw an invalid argument exception since events 
+	// could otherwise be submitted after the simulated clock has passed their 
+	// time stamp. The time of the last event read is updated in any case.
+	
+	void CheckEventOrder( Time TimeStamp, Time & LastEvent, 
+												const std::string & FileType )
+	{
+		if ( EventWindow > 0 && TimeStamp < LastEvent )
+	  {
+	    std::ostringstream ErrorMessage;
+	    
+	    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+							     << "Task Manager: The " << FileType << " event at time " 
+									 << TimeStamp << " is before the previous event at time "
+									 << LastEvent << " and streamed event files must be "
+									 << "sorted on time";
+			 
+	    throw std::invalid_argument( ErrorMessage.str() );
+	  }
+		
+		LastEvent = TimeStamp;
+	}
+	
+	// Reading ahead simply reads events from both files until the last event 
+	// read from a file is beyond the horizon, or the file is exhausted.
+	
+	void ReadEventsAhead( Time Horizon )
+	{
+		while ( ProducerEvents && LastProducerEvent <= Horizon && 
+					  ReadProducerEvent() );
+		
+		while ( LoadEvents && LastLoadEvent <= Horizon && ReadLoadEvent() );
+	}
+	
+	// The event files are opened by the constructor, and the first event of 
+	// each file is read to establish the start of the simulation. Then either 
+	// the first window or the whole files are read.
+	
+	void OpenEventFiles( const std::string & ProducerEventsFileName, 
+											 const std::string & ConsumerEventsFileName )
+	{
+		if ( !RestoreDirectory.empty() )
+			RestoreCheckpoint();
+		
+		ProducerEvents = std::make_unique< ProducerEventReader >( 
+										 ProducerEventsFileName );
+		ProducerEvents->set_header("Time", "ID", "PredictionFileName");
+		
+		LoadEvents = std::make_unique< LoadEventReader >( ConsumerEventsFileName );
+		LoadEvents->set_header( "Time", "EST", "LST", "ID", "LoadProfile" );
+		
+		if ( EventWindow > 0 )
+		{
+			bool MoreProducers = ReadProducerEvent(),
+					 MoreLoads     = ReadLoadEvent();
 			
-			// In order to register this as an active load it is necessary to parse 
-			// the load profile in order to find the duration of the load 
-			// corresponding to the last time stamp in the profile file since all 
-			// load profiles should be time relative and start at time zero.
+			Time FirstEvent;
 			
-			auto LoadProfile = CSVtoTimeSeries( LoadProfileFileName );
+			if ( MoreProducers && MoreLoads )
+				FirstEvent = std::min( LastProducerEvent, LastLoadEvent );
+			else if ( MoreProducers )
+				FirstEvent = LastProducerEvent;
+			else 
+				FirstEvent = LastLoadEvent;
 			
-			ActiveLoads.emplace( ConsumerID, LoadInformation( 
-									LoadProfile.rbegin()->first, LoadProfile.rbegin()->second )	); 
+			ReadEventsAhead( std::max( FirstEvent, RestoredTime ) + EventWindow );
+		}
+		else
+		{
+			while ( ReadProducerEvent() );
+			while ( ReadLoadEvent() );
+		}
+	}
+	
+  // ---------------------------------------------------------------------------
+  // Checkpoint and restore
+  // ---------------------------------------------------------------------------
+  //
+	// Replaying a simulation from its start to investigate the behaviour at a 
+	// later time can be slow, and the task manager can therefore write a 
+	// checkpoint of the household's state to a directory at a given simulated 
+	// time, see the checkpoint header. A later simulation can be restored from
+	// this checkpoint, and many simulations may be started from the same 
+	// checkpoint to explore alternative futures from the same state.
+	//
+	// The checkpoint is taken when the first event at or after the requested 
+	// time is dispatched and before it is executed. The previous event has then 
+	// been acknowledged, which means that the actor system is at rest, all 
+	// events with an earlier time stamp have been executed, and none of the 
+	// events at the time of the dispatched event. A load that has started 
+	// consumes energy from a producer at a time in the past, and this cannot be 
+	// re-established by asking the producers for energy again since they will 
+	// only assign start times in the future. The checkpoint is therefore 
+	// postponed to the first event at a later time when no load is running.
+	// 
+	// The learned probabilities, the predictions and the reward state are 
+	// written by the actors when they receive the checkpoint forwarded by the 
+	// Actor Manager, and the task manager writes the time of the checkpoint, 
+	// the producers, and the loads that have been submitted but not started to
+	// a simulation state file. The producers' prediction files will be the 
+	// checkpointed predictions. The probabilities persisted by consumers no 
+	// longer alive are copied to the checkpoint before the checkpoint message 
+	// is sent so that the probabilities of the living consumers will replace 
+	// them.
+	
+private:
+	
+	Time 				CheckpointTime, LastEventTime;
+	std::string CheckpointDirectory;
+	
+	bool CheckpointDue( void )
+	{
+		Time CurrentTime = Now();
+		
+		return !CheckpointDirectory.empty() && ( CurrentTime >= CheckpointTime ) &&
+					 ( CurrentTime > LastEventTime ) && 
+					 std::none_of( ActiveLoads.begin(), ActiveLoads.end(), 
+					 [&]( const LoadMap::value_type & TheLoad )->bool{
+						 return TheLoad.second.StartTime && 
+										*TheLoad.second.StartTime < CurrentTime; });
+	}
+	
+	void SaveCheckpoint( void )
+	{
+		CoSSMic::Checkpoint TheCheckpoint( CheckpointDirectory );
+		Time 							  CurrentTime = Now();
+		
+		std::ofstream SimulationState( TheCheckpoint.File( "Simulation.dta" ) );
+		
+		SimulationState << "Time " << CurrentTime << std::endl;
+		
+		for ( auto & TheProducer : TheProducers )
+			SimulationState << "Producer " << TheProducer.first << " " 
+											<< TheCheckpoint.GetDirectory() << "/Predictions/" 
+											<< PVProducer::PVProducerNameBase << TheProducer.first 
+											<< ".csv" << std::endl;
 			
-		}		
+		for ( auto & TheLoad : ActiveLoads )
+			if ( TheLoad.second.SubmitTime < CurrentTime )
+				SimulationState << "Load " << TheLoad.first << " " 
+												<< TheLoad.second.EarliestStartTime << " "
+												<< TheLoad.second.LatestStartTime << " "
+												<< TheLoad.second.LoadProfile << std::endl;
+		
+		SimulationState.close();
+		
+		if ( std::filesystem::is_directory( "Probabilities" ) )
+			std::filesystem::copy( "Probabilities", 
+														 TheCheckpoint.SubDirectory( "Probabilities" ), 
+														 std::filesystem::copy_options::overwrite_existing );
+		
+		Send( TheCheckpoint, ActorManager );
+		
+		LogFile << CurrentTime << " Checkpoint written to " << CheckpointDirectory 
+						<< std::endl;
+		
+		CheckpointDirectory.clear();
+	}
+	
+	// Restoring from a checkpoint reads the simulation state file and submits 
+	// events at the time of the checkpoint to create the producers with the 
+	// checkpointed predictions and to submit again the loads that had not 
+	// started. Their allowed start intervals are the original intervals. The 
+	// events in the event files before the time of the checkpoint are then 
+	// skipped when the files are read. It is the responsibility of the 
+	// application to restore the learned probabilities of the consumers and 
+	// the state of the reward calculator before the simulation starts.
+	
+	Time 				RestoredTime;
+	std::string RestoreDirectory;
+	
+	void RestoreCheckpoint( void )
+	{
+		std::ifstream SimulationState( RestoreDirectory + "/Simulation.dta" );
+		std::string   Record;
+		
+		if ( !( SimulationState >> Record >> RestoredTime ) || Record != "Time" )
+	  {
+	    std::ostringstream ErrorMessage;
+	    
+	    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+							     << "Task Manager: No simulation state in the checkpoint " 
+									 << RestoreDirectory;
+			 
+	    throw std::invalid_argument( ErrorMessage.str() );
+	  }
+		
+		while ( SimulationState >> Record )
+			if ( Record == "Producer" )
+			{
+				std::string IDText, PredictionFileName;
+				
+				SimulationState >> IDText >> PredictionFileName;
+				
+				IDType ProducerID( IDText );
+				
+				TheProducers.emplace( ProducerID, PredictionFileName );
+				
+				EventReference TheEvent( 
+					new CreateProducer( this, 
+															ActorManager::AddProducer::Type::PhotoVoltaic, 
+														  ProducerID, PredictionFileName ) );
+				
+				Send( EventMessage( RestoredTime, TheEvent), EventQueue );
+			}
+			else if ( Record == "Load" )
+			{
+				std::string IDText, LoadProfileFileName;
+				Time 				EarliestStartTime, LatestStartTime;
+				
+				SimulationState >> IDText >> EarliestStartTime >> LatestStartTime 
+												>> LoadProfileFileName;
+				
+				IDType ConsumerID( IDText );
+				
+				EventReference TheEvent( new SubmitLoad( this, 
+					 EarliestStartTime, LatestStartTime, ConsumerID, 
+					 LoadProfileFileName ) );
+				
+				Send( EventMessage( RestoredTime, TheEvent ), EventQueue );
+				
+				TimeSeries LoadProfile;
+				
+				CSVtoTimeSeries( LoadProfileFileName, LoadProfile );
+				
+				ActiveLoads.emplace( ConsumerID, LoadInformation( 
+					LoadProfile.LastTime(), LoadProfile.LastValue(), 
+					RestoredTime, EarliestStartTime, LatestStartTime, 
+					LoadProfileFileName )	); 
+			}
 	}
 	
 	// ---------------------------------------------------------------------------
@@ -1576,13 +1900,25 @@ public:
 							 const Theron::Address & EventQueueAddress,
 							 const Theron::Address & DelayedAckAddress,
 						   const std::string & ProducerEventsFileName,
-						   const std::string & ConsumerEventsFileName 						)
+						   const std::string & ConsumerEventsFileName,
+							 const std::string & LogFileName = "TaskManager.log",
+							 Time ReadAheadWindow = 0,
+							 const std::string & RestoreFrom = std::string(),
+							 Time CheckpointAt = 0, 
+							 const std::string & CheckpointTo = std::string() )
 	: Actor( "taskmanager"),
 	  StandardFallbackHandler( "taskmanager"),
 	  EventQueue( EventQueueAddress ), 
 	  DelayedAcknowledgement( DelayedAckAddress ),
 	  ActorManager( ActorManagerAddress ), 
-	  LogFile()
+	  LogFile(), ConsumedEnergy( 0.0 ), GridEnergy( 0.0 ),
+	  ProducerEvents(), LoadEvents(), LastProducerEvent( 0 ), LastLoadEvent( 0 ),
+	  EventWindow( ReadAheadWindow ), TheProducers(),
+	  CheckpointTime( CheckpointAt ), 
+	  LastEventTime( std::numeric_limits< Time >::min() ),
+	  CheckpointDirectory( CheckpointTo ), 
+	  RestoredTime( std::numeric_limits< Time >::min() ),
+	  RestoreDirectory( RestoreFrom )
 	{
 		RegisterHandler( this, &TaskManager::AssignedStartTime );
 		RegisterHandler( this, &TaskManager::ClearStartTime 	 );
@@ -1591,9 +1927,7 @@ public:
 		RegisterHandler( this, &TaskManager::HandleEvent 			 );
 		RegisterHandler( this, &TaskManager::Termination			 );
 		
-		if ( !ProducerEventsFileName.empty() )
-			CreateProducerEvents( ProducerEventsFileName );
-		else
+		if ( ProducerEventsFileName.empty() )
 	  {
 	    std::ostringstream ErrorMessage;
 	    
@@ -1603,9 +1937,7 @@ public:
 	    throw std::invalid_argument( ErrorMessage.str() );
 	  }
 		
-		if ( !ConsumerEventsFileName.empty() )
-			CreateLoadEvents( ConsumerEventsFileName );
-		else
+		if ( ConsumerEventsFileName.empty() )
 	  {
 	    std::ostringstream ErrorMessage;
 	    
@@ -1615,7 +1947,8 @@ public:
 	    throw std::invalid_argument( ErrorMessage.str() );
 	  }
 		
-		LogFile.open( "TaskManager.log" );
+		OpenEventFiles( ProducerEventsFileName, ConsumerEventsFileName );
+		LogFile.open( LogFileName );
 	}
 	
 	//  The destructor does nothing in this version
@@ -1652,6 +1985,13 @@ private:
     Simulation,			// Use simulator's clock not the system clock
     Password,   		// The password to the XMPP server(s)
     ProducerEvents, // Name of the producer event file
+    Replications,		// Number of independent replications
+    Parallel,				// Number of replications running concurrently
+    Seed,						// Seed of the random generator for the first replication
+    EventWindow,		// Seconds of events to read ahead of the clock
+    Checkpoint,			// Time and directory of a checkpoint to write
+    Restore,				// Directory of a checkpoint to restore
+    Confidence,			// Confidence for the acknowledgement wait
     Help        		// Prints the help text
   };
   
@@ -1689,6 +2029,32 @@ private:
   // The initial remote endpoint is stored by its Jabber ID.
 	      
   Theron::XMPP::JabberID InitialRemoteEndpoint;
+  
+  // The number of replications, the number of replications to run at the 
+  // same time, and the seed of the first replication. The seeds of the other 
+  // replications follow consecutively. If no seed is given, the random 
+  // generator is seeded by the system clock.
+  
+  unsigned int 			 NumberOfReplications, ParallelReplications;
+  std::uint_fast64_t BaseSeed;
+  bool 							 SeedGiven;
+  
+  // The event files are read completely before the simulation starts unless 
+  // a read ahead window is given, in which case the events are read in 
+  // chunks of this many seconds ahead of the simulated clock.
+  
+  CoSSMic::Time 		 ReadAheadWindow;
+  
+  // A checkpoint can be written at a given simulated time to a directory, 
+  // and the simulation can be restored from the checkpoint in a directory.
+  
+  CoSSMic::Time 		 CheckpointTime;
+  std::string 			 CheckpointDirectory, RestoreDirectory;
+  
+  // The acknowledgement of events can wait for remote assignments with a 
+  // given confidence
+  
+  double 						 AcknowledgementConfidence;
 	      
   // There is a simple function to print the help text as above
 	      
@@ -1720,6 +2086,31 @@ private:
 				      << "// Default \"secret\" login for the XMPP servers" 
 				      << std::endl;
     std::cout << std::setw(25) << std::left;
+    std::cout << "--replications <number>"
+				      << "// Default 1 simulation run" << std::endl;
+    std::cout << std::setw(25) << std::left;
+    std::cout << "--parallel <number>"
+				      << "// Default one replication per hardware thread" 
+				      << std::endl;
+    std::cout << std::setw(25) << std::left;
+    std::cout << "--seed <number>"
+				      << "// Default seeded by the system clock" << std::endl;
+    std::cout << std::setw(25) << std::left;
+    std::cout << "--eventwindow <seconds>"
+				      << "// Default 0 reads all events at start" << std::endl;
+    std::cout << std::setw(25) << std::left;
+    std::cout << "--checkpoint <time> <dir>"
+				      << "// Write the state at this time to the directory" 
+				      << std::endl;
+    std::cout << std::setw(25) << std::left;
+    std::cout << "--restore <dir>"
+				      << "// Resume from the checkpoint in the directory" 
+				      << std::endl;
+    std::cout << std::setw(25) << std::left;
+    std::cout << "--confidence <level>"
+				      << "// Default 0 acknowledges when the actors are idle" 
+				      << std::endl;
+    std::cout << std::setw(25) << std::left;
     std::cout << "--help"
 				      << "// Prints this text" << std::endl;
     std::cout << "Since the system is completely peer-to-peer it is necessary "
@@ -1736,7 +2127,12 @@ public:
   // call the default constructor on each of the value strings. 
   
   CommandLineParser( int argc, char **argv )
-  : GridLocation( GridType::None ), LocalGridID()
+  : GridLocation( GridType::None ), LocalGridID(),
+    NumberOfReplications( 1 ), 
+    ParallelReplications( std::max( 1U, std::thread::hardware_concurrency() ) ),
+    BaseSeed( 0 ), SeedGiven( false ), ReadAheadWindow( 0 ),
+    CheckpointTime( 0 ), CheckpointDirectory(), RestoreDirectory(),
+    AcknowledgementConfidence( 0.0 )
   {
     // The command line option strings are stored in a upper case keywords for 
     // unique reference
@@ -1751,6 +2147,13 @@ public:
 			{ "--SIMULATOR",			Options::Simulation   		},
 			{ "--PASSWORD",				Options::Password     		},
 			{ "--PRODUCEREVENTS", Options::ProducerEvents   },
+			{ "--REPLICATIONS",		Options::Replications			},
+			{ "--PARALLEL",				Options::Parallel					},
+			{ "--SEED",						Options::Seed							},
+			{ "--EVENTWINDOW",		Options::EventWindow			},
+			{ "--CHECKPOINT",			Options::Checkpoint				},
+			{ "--RESTORE",				Options::Restore					},
+			{ "--CONFIDENCE",			Options::Confidence				},
 			{ "--HELP",						Options::Help	      			}
     };
     
@@ -1872,6 +2275,33 @@ public:
 				case Options::ProducerEvents:
 					ProducerEventsFileName = ArgumentCheck( TheOption, ++i );
 					break;
+				case Options::Replications:
+					NumberOfReplications = 
+						std::max( 1UL, std::stoul( ArgumentCheck( TheOption, ++i ) ) );
+					break;
+				case Options::Parallel:
+					ParallelReplications = 
+						std::max( 1UL, std::stoul( ArgumentCheck( TheOption, ++i ) ) );
+					break;
+				case Options::Seed:
+					BaseSeed  = std::stoull( ArgumentCheck( TheOption, ++i ) );
+					SeedGiven = true;
+					break;
+				case Options::EventWindow:
+					ReadAheadWindow = 
+						std::max( 0LL, std::stoll( ArgumentCheck( TheOption, ++i ) ) );
+					break;
+				case Options::Checkpoint:
+					CheckpointTime 			= std::stoll( ArgumentCheck( TheOption, ++i ) );
+					CheckpointDirectory = ArgumentCheck( TheOption, ++i );
+					break;
+				case Options::Restore:
+					RestoreDirectory = ArgumentCheck( TheOption, ++i );
+					break;
+				case Options::Confidence:
+					AcknowledgementConfidence = 
+						std::stod( ArgumentCheck( TheOption, ++i ) );
+					break;
 				default:
 				  PrintHelp();
 				  exit(0);
@@ -1930,24 +2360,81 @@ public:
 	{
 		return ProducerEventsFileName;
 	}
+	
+	inline unsigned int GetReplications( void )
+	{
+		return NumberOfReplications;
+	}
+	
+	inline unsigned int GetParallelReplications( void )
+	{
+		return ParallelReplications;
+	}
+	
+	inline bool HasSeed( void )
+	{
+		return SeedGiven;
+	}
+	
+	inline std::uint_fast64_t GetSeed( void )
+	{
+		return BaseSeed;
+	}
+	
+	inline CoSSMic::Time GetEventWindow( void )
+	{
+		return ReadAheadWindow;
+	}
+	
+	inline bool HasCheckpoint( void )
+	{
+		return !CheckpointDirectory.empty();
+	}
+	
+	inline CoSSMic::Time GetCheckpointTime( void )
+	{
+		return CheckpointTime;
+	}
+	
+	inline std::string GetCheckpointDirectory( void )
+	{
+		return CheckpointDirectory;
+	}
+	
+	inline std::string GetRestoreDirectory( void )
+	{
+		return RestoreDirectory;
+	}
+	
+	inline double GetConfidence( void )
+	{
+		return AcknowledgementConfidence;
+	}
 };
 
-}  // End name space CoSSMic
-
 /*=============================================================================
 
- Main
+ Simulation runs
 
 =============================================================================*/
 //
-// The Main entry point sets up the various actors of the scheduler plus the 
-// task manager before the simulation starts.
+// A simulation run sets up the various actors of the scheduler plus the task 
+// manager, and returns the outcome of the run when all loads have been 
+// completed. The network endpoint and the log file are named by the caller 
+// so that concurrent replications will not collide.
 
-int main(int argc, char **argv) 
+class ReplicationResult
 {
-	// In general there could be command line options given
+public:
 	
-	CoSSMic::CommandLineParser Options( argc, argv );
+	double ConsumedEnergy, GridEnergy, Seconds;
+};
+
+ReplicationResult RunSimulation( CommandLineParser & Options, 
+																 const std::string & EndpointName, 
+																 const std::string & LogFileName )
+{
+	auto Start = std::chrono::steady_clock::now();
 	
   // Starting the network endpoint class based on the CoSSMic network interface
 	// Note: The household should not have the same name as an actor! The first 
@@ -1955,7 +2442,7 @@ int main(int argc, char **argv)
 	// 
   
 	Theron::NetworkEndPoint< CoSSMic::NetworkInterface > 
-		Household( "Household" , Options.GetDomain(), 
+		Household( EndpointName, Options.GetDomain(), 
 												     Options.GetPassword(), 
 												     Options.GetPeerEndpoint()  );
   
@@ -1970,31 +2457,34 @@ int main(int argc, char **argv)
 	// manager, and to send back the events so that the task manager can take 
 	// proper actions.
 		
-	Theron::DiscreteEventManager< CoSSMic::Time, 
-																CoSSMic::TaskManager::EventReference > 
+	Theron::DiscreteEventManager< Time, TaskManager::EventReference > 
 																TheEventManager( "EventManager");
 					
 	// The last part of the event management framework is to ensure that the 
-	// CoSSMic clock reflects the event clock
+	// CoSSMic clock reflects the event clock. The event manager pushes the 
+	// event time to the clock, and reading the clock does not involve the 
+	// event manager.
 					
-	CoSSMic::Now.SetClockFunction( 
-				   [&](void)->CoSSMic::Time{ 
-										  return TheEventManager.Now< CoSSMic::Time >(); } );
+	Now.FollowEvents( TheEventManager );
 	
   // There is a class to provide delayed acknowledgements to the event manager
 
-  CoSSMic::DelayedEventAcknowledgement 
-	  AcknowledgementActor( "DelayedAcknowledgementActor" );
+  DelayedEventAcknowledgement AcknowledgementActor( 
+																		  "DelayedAcknowledgementActor", 
+																		  Options.GetConfidence() );
 	
   // The reward calculator is started so that we can pass its address to the 
   // actor manager.
     
-  CoSSMic::ShapleyValueReward TheRewardCalculator( Options.GetDomain() );
+  ShapleyValueReward TheRewardCalculator( Options.GetDomain() );
+  
+  if ( !Options.GetRestoreDirectory().empty() )
+		TheRewardCalculator.RestoreCheckpoint( Options.GetRestoreDirectory() );
 
-		// The Grid actor provides the last resort for the consumers to find energy,
+	// The Grid actor provides the last resort for the consumers to find energy,
   // and is defined by its default producer ID
 
-	CoSSMic::Grid GridActor;
+	Grid GridActor;
 	
   // Then add the actor manager - note that the name actor manager is 
   // hard coded for this component, and that actual values are given for 
@@ -2004,18 +2494,22 @@ int main(int argc, char **argv)
   constexpr double       SolutionTolerance = 1;
   constexpr unsigned int MaxIterations     = 100;
   
-  CoSSMic::ActorManager TheActorManager( TheRewardCalculator.GetAddress(), 
-																				 SolutionTolerance, MaxIterations );
+  ActorManager TheActorManager( TheRewardCalculator.GetAddress(), 
+																SolutionTolerance, MaxIterations );
 
 	// The task manager is given the address of the actor manager and the 
 	// event manager, and the names of the two event files for the producer 
 	// events and the consumer events.
 	
-	CoSSMic::TaskManager TheTaskManager( TheActorManager.GetAddress(),
-																			 TheEventManager.GetAddress(),
-																			 AcknowledgementActor.GetAddress(),
-																			 Options.GetProducerEvents(),
-																	     Options.GetConsumerEvents() 	);
+	TaskManager TheTaskManager( TheActorManager.GetAddress(),
+															TheEventManager.GetAddress(),
+															AcknowledgementActor.GetAddress(),
+															Options.GetProducerEvents(),
+															Options.GetConsumerEvents(),
+															LogFileName, Options.GetEventWindow(),
+															Options.GetRestoreDirectory(),
+															Options.GetCheckpointTime(),
+															Options.GetCheckpointDirectory() );
 	
 	// The event stream is started by sending an empty acknowledgement to the 
 	// event queue
@@ -2029,6 +2523,263 @@ int main(int argc, char **argv)
 	Household.TerminationWatch( 
 			TheTaskManager, GridActor, TheActorManager, TheRewardCalculator, 
 			AcknowledgementActor, TheEventManager, PrintServer )->Wait();
+	
+	return ReplicationResult{ TheTaskManager.GetConsumedEnergy(), 
+														TheTaskManager.GetGridEnergy(),
+														std::chrono::duration< double >( 
+														  std::chrono::steady_clock::now() - Start ).count() };
+}
+
+// The probabilities of a checkpoint replace the persisted probabilities of 
+// the consumers with the same names. 
+
+void RestoreProbabilities( const std::string & Directory )
+{
+	const std::filesystem::path Probabilities( Directory + "/Probabilities" );
+	
+	if ( std::filesystem::is_directory( Probabilities ) )
+	{
+		std::filesystem::create_directory( "Probabilities" );
+		std::filesystem::copy( Probabilities, "Probabilities", 
+													 std::filesystem::copy_options::overwrite_existing );
+	}
+}
+
+// The load profiles and the predictions are preloaded by reading the file 
+// names from the two event files in the same way as the Task Manager reads 
+// them. The event files are small, and they are read again by each Task 
+// Manager.
+
+void PreloadScenario( CommandLineParser & Options )
+{
+	{
+		io::CSVReader<3, io::trim_chars<'\t'>, io::no_quote_escape<';'> > 
+	      CSVParser( Options.GetProducerEvents() );
+		
+		CSVParser.set_header("Time", "ID", "PredictionFileName");
+		
+		Time 				TimeStamp;
+		std::string IDText, PredictionFileName;
+		
+		while ( CSVParser.read_row( TimeStamp, IDText, PredictionFileName ) )
+			PreloadTimeSeries( PredictionFileName );
+	}
+	
+	io::CSVReader<5, io::trim_chars<'\t'>, io::no_quote_escape<';'> > 
+      CSVParser( Options.GetConsumerEvents() );
+	
+	CSVParser.set_header( "Time", "EST", "LST", "ID", "LoadProfile" );
+	
+	Time 			  TimeStamp, EarliestStartTime, LatestStartTime;
+	std::string IDText, LoadProfileFileName;
+	
+	while ( CSVParser.read_row( TimeStamp, EarliestStartTime, LatestStartTime,
+															IDText, LoadProfileFileName	) )
+		PreloadTimeSeries( LoadProfileFileName );
+}
+
+// The replications are run as child processes forked by the parent after the 
+// scenario has been preloaded, so the children share the parsed time series 
+// copy-on-write. The parent does not start any actors since the threads of 
+// the actors would not be duplicated in the children. At most the given 
+// number of replications are running at the same time, and a new replication 
+// is started when one finishes. Each child writes its result as one line to 
+// a pipe that is read by the parent when the child has terminated; the line
+// is shorter than the pipe buffer so the child will not block on writing.
+//
+// The function returns the number of replications that failed.
+
+unsigned int RunReplications( CommandLineParser & Options )
+{
+	PreloadScenario( Options );
+	
+	const unsigned int Replications = Options.GetReplications(),
+										 Parallel 		= Options.GetParallelReplications();
+	const std::uint_fast64_t FirstSeed = Options.HasSeed() ? Options.GetSeed() :
+		static_cast< std::uint_fast64_t >( 
+			std::chrono::system_clock::now().time_since_epoch().count() );
+	
+	MergeableStatistics TotalEnergy, FromGrid, SelfConsumption, RunTime;
+	std::map< pid_t, int > Running;
+	unsigned int 					 Started = 0, Failed = 0;
+	
+	while ( ( Started < Replications ) || !Running.empty() )
+	{
+		if ( ( Started < Replications ) && ( Running.size() < Parallel ) )
+		{
+			int Pipe[2];
+			
+			if ( pipe( Pipe ) != 0 )
+			{
+				std::ostringstream ErrorMessage;
+				
+				ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+										 << "Could not create the pipe for replication " 
+										 << Started;
+				
+				throw std::runtime_error( ErrorMessage.str() );
+			}
+			
+			pid_t Child = fork();
+			
+			if ( Child == 0 )
+			{
+				close( Pipe[0] );
+				
+				int ExitStatus = EXIT_FAILURE;
+				
+				try
+				{
+					Random::Generator.Seed( FirstSeed + Started );
+					
+					ReplicationResult Result = RunSimulation( Options, 
+						"Household" + std::to_string( Started ),
+						"TaskManager-" + std::to_string( Started ) + ".log" );
+					
+					std::ostringstream Report;
+					
+					Report << std::setprecision( 17 ) << Result.ConsumedEnergy << " " 
+								 << Result.GridEnergy << " " << Result.Seconds << std::endl;
+					
+					std::string Line( Report.str() );
+					
+					if ( write( Pipe[1], Line.data(), Line.size() ) 
+							 == static_cast< ssize_t >( Line.size() ) )
+						ExitStatus = EXIT_SUCCESS;
+				}
+				catch ( std::exception & Error )
+				{
+					std::cerr << "Replication " << Started << ": " << Error.what() 
+										<< std::endl;
+				}
+				
+				close( Pipe[1] );
+				_exit( ExitStatus );
+			}
+			else if ( Child < 0 )
+			{
+				std::ostringstream ErrorMessage;
+				
+				ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+										 << "Could not start replication " << Started;
+				
+				throw std::runtime_error( ErrorMessage.str() );
+			}
+			
+			close( Pipe[1] );
+			Running.emplace( Child, Pipe[0] );
+			Started++;
+		}
+		else
+		{
+			// A replication has to terminate before more can be started, and its 
+			// result is read and merged if it terminated normally.
+			
+			int 	Status;
+			pid_t Child = waitpid( -1, &Status, 0 );
+			auto  TheReplication = Running.find( Child );
+			
+			if ( TheReplication == Running.end() ) continue;
+			
+			char 				Buffer[256];
+			ssize_t 		Length = read( TheReplication->second, Buffer, 
+																 sizeof( Buffer ) - 1 );
+			double 			Consumed, Grid, Seconds;
+			
+			close( TheReplication->second );
+			Running.erase( TheReplication );
+			
+			if ( WIFEXITED( Status ) && ( WEXITSTATUS( Status ) == EXIT_SUCCESS ) &&
+					 ( Length > 0 ) )
+			{
+				std::istringstream Report( std::string( Buffer, Length ) );
+				
+				Report >> Consumed >> Grid >> Seconds;
+				
+				TotalEnergy << Consumed;
+				FromGrid    << Grid;
+				RunTime     << Seconds;
+				
+				if ( Consumed > 0.0 )
+					SelfConsumption << 1.0 - Grid / Consumed;
+			}
+			else
+				Failed++;
+		}
+	}
+	
+	// The merged statistics are reported with the standard deviation of the 
+	// mean to indicate the confidence in the estimated means, and the median
+	// from the quantile sketch of the mergeable statistics.
+	
+	auto Print = []( const std::string & Label, 
+									 const MergeableStatistics & Values ){
+		std::cout << std::setw(20) << std::left << Label;
+		
+		if ( Values.N() > 0 )
+			std::cout << " mean " << Values.Mean() 
+								<< " sd " << Values.StandardDeviation()
+								<< " sd(mean) " << Values.StandardDeviationOfMean()
+								<< " median " << Values.Median()
+								<< " min " << Values.Min() << " max " << Values.Max();
+		
+		std::cout << std::endl;
+	};
+	
+	std::cout << Replications - Failed << " of " << Replications 
+						<< " replications completed from seed " << FirstSeed << std::endl;
+	
+	Print( "Consumed energy", TotalEnergy );
+	Print( "Grid energy", FromGrid );
+	Print( "Self consumption", SelfConsumption );
+	Print( "Run time [s]", RunTime );
+	
+	return Failed;
+}
+
+}  // End name space CoSSMic
+
+/*=============================================================================
+
+ Main
+
+=============================================================================*/
+//
+// The Main entry point sets up the various actors of the scheduler plus the 
+// task manager before the simulation starts.
+
+int main(int argc, char **argv) 
+{
+	// In general there could be command line options given
+	
+	CoSSMic::CommandLineParser Options( argc, argv );
+	
+	// Several replications are run by child processes, and the parent only 
+	// merges their results.
+	
+	if ( Options.HasCheckpoint() && ( Options.GetReplications() > 1 ) )
+	{
+		std::cout << "A checkpoint can only be written by a single replication" 
+							<< std::endl;
+		return EXIT_FAILURE;
+	}
+	
+	// The consumers read their learned probabilities from the probabilities 
+	// directory when they start, and the probabilities of a checkpoint are 
+	// therefore copied there before the simulation starts. This is done once 
+	// for all replications starting from the same checkpoint.
+	
+	if ( !Options.GetRestoreDirectory().empty() )
+		CoSSMic::RestoreProbabilities( Options.GetRestoreDirectory() );
+	
+	if ( Options.GetReplications() > 1 )
+		return CoSSMic::RunReplications( Options ) == 0 ? EXIT_SUCCESS 
+																										 : EXIT_FAILURE;
+	
+	if ( Options.HasSeed() )
+		Random::Generator.Seed( Options.GetSeed() );
+	
+	CoSSMic::RunSimulation( Options, "Household", "TaskManager.log" );
 
 	std::cout << "Normal termination" << std::endl;
 			
@@ -58,6 +58,15 @@
   --globalgrid		         // Start the global grid actor on this node
   --password <string>      // Default "secret" used to log onto the XMPP servers
   --simulation <URL>       // Set URL for simulator's time counter
+  --horizon <days>         // Forget unused state older than this, default 0
+												   // which keeps all state
+  --journal <file>         // Record the messages from remote actors in the
+												   // message journal file for later replay
+  --metrics <port>         // Serve Prometheus metrics over HTTP on the port
+  --memory <file>          // Account the memory by subsystem and actor class 
+												   // and write the report to the file at the end
+  --balance <file>         // Record the energy balance of the households per
+												   // quarter of an hour in the file
   --help		               // Prints this information and exits
    
   Author: Geir Horn, University of Oslo, 2016-2017
@@ -70,6 +79,8 @@
 #include <stdexcept>		      					// To indicate errors in a standard way
 #include <iostream>		      						// For printing help texts
 #include <iomanip>		      						// For formatting the help text
+#include <memory>		      							// The metrics server
+#include <fstream>		      						// The memory report
 
 #include <boost/algorithm/string.hpp> 	// To convert to upper case
 
@@ -85,6 +96,9 @@
 #include "Grid.hpp"		      						// The CoSSMic Grid provider
 #include "Clock.hpp"		      					// CoSSMic Simulated or system clock
 #include "ShapleyReward.hpp"	      		// The reward calculator
+#include "RollingHorizon.hpp"	      		// Forgetting old state
+#include "MetricsExporter.hpp"	      	// Serving metrics over HTTP
+#include "MemoryAccounting.hpp"	      	// Memory by subsystem
 
 // -----------------------------------------------------------------------------
 // Command line option parser
@@ -105,6 +119,11 @@ private:
     GlobalGrid,		// Start a global grid agent
     Simulation,		// Use simulator's clock not the system clock
     Password,   	// The password to the XMPP server(s)
+    Horizon,      // The rolling horizon in days
+    Journal,      // The file recording the inbound messages
+    Metrics,      // The port serving the metrics
+    Memory,       // The file of the memory report
+    Balance,      // The file of the energy balance
     Help        	// Prints the help text
   };
   
@@ -113,7 +132,10 @@ private:
   std::string EndpointHouse,
 			        EndpointDomain,
 							EndpointName,
-			        XMPPPassword;
+			        XMPPPassword,
+			        JournalFile,
+			        MemoryFile,
+			        BalanceFile;
 	      
   // The grid has two possible instantiations. Either as a local actor or 
   // as a global agent running on this node. The type is globally accessible,
@@ -137,6 +159,10 @@ private:
   // The ID of the local grid is stored if the local grid option was chosen
 
   CoSSMic::IDType LocalGridID;
+  
+  // The port for the metrics is zero if no metrics should be served
+  
+  unsigned short MetricsPort;
 	      
   // The initial remote endpoint is stored by its Jabber ID.
 	      
@@ -169,6 +195,21 @@ private:
     std::cout << "--simulator <URL>" << "// Set URL for simulator's time counter"
 				      << std::endl;
     std::cout << std::setw(25) << std::left;
+    std::cout << "--horizon <days>" << "// Forget unused state older than this"
+				      << std::endl;
+    std::cout << std::setw(25) << std::left;
+    std::cout << "--journal <file>" << "// Record the remote messages for replay"
+				      << std::endl;
+    std::cout << std::setw(25) << std::left;
+    std::cout << "--metrics <port>" << "// Serve the metrics over HTTP"
+				      << std::endl;
+    std::cout << std::setw(25) << std::left;
+    std::cout << "--memory <file>" << "// Account the memory and report it"
+				      << std::endl;
+    std::cout << std::setw(25) << std::left;
+    std::cout << "--balance <file>" << "// Record the energy balance"
+				      << std::endl;
+    std::cout << std::setw(25) << std::left;
     std::cout << "--password <string>"
 				      << "// Default \"secret\" login for the XMPP servers" 
 				      << std::endl;
@@ -189,7 +230,7 @@ public:
   // call the default constructor on each of the value strings. 
   
   CommandLineParser( int argc, char **argv )
-  : GridLocation( GridType::None ), LocalGridID()
+  : GridLocation( GridType::None ), LocalGridID(), MetricsPort( 0 )
   {
     // The command line option strings are stored in a upper case keywords for 
     // unique reference
@@ -202,6 +243,11 @@ public:
 			{ "--GLOBALGRID",			Options::GlobalGrid   		},
 			{ "--SIMULATOR",			Options::Simulation   		},
 			{ "--PASSWORD",				Options::Password     		},
+			{ "--HORIZON",				Options::Horizon      		},
+			{ "--JOURNAL",				Options::Journal      		},
+			{ "--METRICS",				Options::Metrics      		},
+			{ "--MEMORY",					Options::Memory      			},
+			{ "--BALANCE",				Options::Balance      		},
 			{ "--HELP",						Options::Help	      			}
     };
     
@@ -317,6 +363,37 @@ public:
 				case Options::Password:
 				  XMPPPassword = ArgumentCheck( TheOption, ++i );
 				  break;
+				case Options::Horizon:
+				  CoSSMic::RollingHorizon::Set( static_cast< CoSSMic::Time >( 
+				    std::stod( ArgumentCheck( TheOption, ++i ) ) * 86400 ) );
+				  break;
+				case Options::Journal:
+				  JournalFile = ArgumentCheck( TheOption, ++i );
+				  break;
+				case Options::Metrics:
+				{
+				  int Port = std::stoi( ArgumentCheck( TheOption, ++i ) );
+				  
+				  if ( ( Port <= 0 ) || ( Port > 65535 ) )
+				  {
+				    std::ostringstream ErrorMessage;
+				    
+				    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+										     << "The metrics port must be in the range 1 to 65535 "
+										     << "and not " << Port;
+						 
+				    throw std::invalid_argument( ErrorMessage.str() );
+				  }
+				  
+				  MetricsPort = static_cast< unsigned short >( Port );
+				}
+				  break;
+				case Options::Memory:
+				  MemoryFile = ArgumentCheck( TheOption, ++i );
+				  break;
+				case Options::Balance:
+				  BalanceFile = ArgumentCheck( TheOption, ++i );
+				  break;
 				default:
 				  PrintHelp();
 				  exit(0);
@@ -356,6 +433,32 @@ public:
       return XMPPPassword;
   }
   
+  // The journal file is empty if no journal should be recorded
+
+  inline std::string GetJournal( void )
+  {
+    return JournalFile;
+  }
+
+  inline unsigned short GetMetricsPort( void )
+  {
+    return MetricsPort;
+  }
+  
+  // The memory report file is empty if the memory should not be accounted
+  
+  inline std::string GetMemoryReport( void )
+  {
+    return MemoryFile;
+  }
+  
+  // The energy balance file is empty if the balance should not be recorded
+  
+  inline std::string GetBalanceFile( void )
+  {
+    return BalanceFile;
+  }
+  
   inline GridType GetGridType( void )
   {
     return GridLocation;
@@ -377,12 +480,73 @@ int main(int argc, char **argv)
   
   CommandLineParser Options( argc, argv );
   
+  // The memory accounting must be enabled before the accounted objects are
+  // created. The accounts are also served with the metrics if a port is 
+  // given.
+  
+  if ( !Options.GetMemoryReport().empty() )
+    Theron::MemoryAccounting::Enable();
+  
   // Then using these definitions to start the network interface, including 
   // the Theron execution framework.
   
   Theron::NetworkEndPoint< CoSSMic::NetworkInterface > 
   Household( Options.GetName(), Options.GetDomain(),  Options.GetPassword(), 
 			       Options.GetPeerEndpoint() );
+
+  // The messages from the remote actors are recorded from the start if a
+  // journal file is given.
+
+  if ( !Options.GetJournal().empty() )
+    Household.Pointer< Theron::PresentationLayer >(
+      Theron::Network::Layer::Presentation )->StartJournal( Options.GetJournal() );
+
+  // The metrics are served over HTTP if a port is given. The actor metrics 
+  // are then collected, and the traffic of the presentation layer is 
+  // exported as the traffic of the XMPP transport. The collector holds the 
+  // presentation layer and must be removed before the network endpoint 
+  // closes.
+  
+  std::unique_ptr< Theron::MetricsExporter > MetricsServer;
+  Theron::MetricsExporter::CollectorID 			 TrafficCollector = 0;
+  
+  if ( Options.GetMetricsPort() > 0 )
+  {
+    Theron::Actor::EnableMetrics();
+    
+    TrafficCollector = Theron::MetricsExporter::AddCollector( 
+      [ Traffic = Household.Pointer< Theron::PresentationLayer >( 
+								  Theron::Network::Layer::Presentation ) ]( std::ostream & Output ){
+	      auto Counters = Traffic->GetTrafficStatistics();
+	      
+	      Theron::MetricsExporter::WriteFamily( Output, 
+	        "theron_network_messages_total", "counter", 
+	        "Messages exchanged with remote actors" );
+	      Theron::MetricsExporter::WriteSample( Output, 
+	        "theron_network_messages_total", 
+	        { { "transport", "XMPP" }, { "direction", "in" } }, 
+	        static_cast< double >( Counters.MessagesIn ) );
+	      Theron::MetricsExporter::WriteSample( Output, 
+	        "theron_network_messages_total", 
+	        { { "transport", "XMPP" }, { "direction", "out" } }, 
+	        static_cast< double >( Counters.MessagesOut ) );
+	      
+	      Theron::MetricsExporter::WriteFamily( Output, 
+	        "theron_network_bytes_total", "counter", 
+	        "Payload bytes exchanged with remote actors" );
+	      Theron::MetricsExporter::WriteSample( Output, 
+	        "theron_network_bytes_total", 
+	        { { "transport", "XMPP" }, { "direction", "in" } }, 
+	        static_cast< double >( Counters.BytesIn ) );
+	      Theron::MetricsExporter::WriteSample( Output, 
+	        "theron_network_bytes_total", 
+	        { { "transport", "XMPP" }, { "direction", "out" } }, 
+	        static_cast< double >( Counters.BytesOut ) );
+      });
+    
+    MetricsServer = std::make_unique< Theron::MetricsExporter >( 
+										  Options.GetMetricsPort() );
+  }
   
   // Before starting any of the CoSSMic actors, the console print actor is 
   // started if debug messages is produced.
@@ -395,6 +559,10 @@ int main(int argc, char **argv)
   // actor manager.
     
   CoSSMic::ShapleyValueReward TheRewardCalculator( Options.GetDomain() );
+  
+  if ( !Options.GetBalanceFile().empty() )
+    TheRewardCalculator.RecordEnergyBalance( 
+      CoSSMic::EnergyBalance::DefaultWidth, Options.GetBalanceFile() );
     
   // Then add the actor manager - note that the name actor manager is 
   // hard coded for this component, and that actual values are given for 
@@ -444,5 +612,15 @@ int main(int argc, char **argv)
 	Household.TerminationWatch( *GridActor, TheActorManager, TheRewardCalculator, 
 															PrintServer )->Wait();
   
+  MetricsServer.reset();
+  Theron::MetricsExporter::RemoveCollector( TrafficCollector );
+  
+  if ( !Options.GetMemoryReport().empty() )
+  {
+    std::ofstream MemoryReport( Options.GetMemoryReport() );
+    
+    Theron::MemoryAccounting::WriteJSON( MemoryReport );
+  }
+  
   return EXIT_SUCCESS;
 }
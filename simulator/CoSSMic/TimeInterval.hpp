@@ -62,7 +62,7 @@ namespace CoSSMic
 // explicit output function for time intervals, and forcing the boundaries to 
 // be converted to strings before being streamed it works. 
 
-std::ostream & operator << ( std::ostream & OutStream, 
+inline std::ostream & operator << ( std::ostream & OutStream, 
 												     const CoSSMic::TimeInterval & T )
 {	  
   OutStream << "[" << std::to_string( T.lower() ) << "," 
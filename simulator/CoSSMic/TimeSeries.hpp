@@ -0,0 +1,223 @@
+/*==============================================================================
+Time Series
+
+The load profiles and the production predictions are time series of time
+stamps and cumulative energy values. They were originally returned from the
+CSV parser as maps from time to energy, which ensures that the time stamps
+are sorted and unique, but every sample is then a node on the heap. All users
+of the time series either walk through the samples in order or copy them into
+vectors, and series with tens of thousands of one minute samples are better
+stored as two contiguous arrays: one for the time stamps and one for the
+values.
+
+The time series records when samples are appended whether the time stamps are
+still strictly increasing. If they are not, the series can be normalised by
+sorting the samples on the time stamps and removing duplicated time stamps,
+keeping the first sample appended for a time stamp as the map would do.
+
+The arrays are polymorphic vectors, and a series can be given the memory
+resource to allocate from, typically a memory account so that the memory of
+the series read by a subsystem is reported, see Theron::MemoryAccounting. A
+copy of a series allocates from the default resource unless it is given
+another resource, and an assigned series keeps its resource.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef COSSMIC_TIME_SERIES
+#define COSSMIC_TIME_SERIES
+
+#include <vector>                 // The contiguous arrays
+#include <memory_resource>        // Polymorphic allocation of the arrays
+#include <map>                    // Conversion to and from maps
+#include <numeric>                // To create the sort permutation
+#include <algorithm>              // For sorting the samples
+#include <stddef.h>               // For size_t
+
+#include "TimeInterval.hpp"       // To have CoSSMic time
+
+namespace CoSSMic
+{
+
+class TimeSeries
+{
+private:
+
+  std::pmr::vector< Time >   TimeStamps;
+  std::pmr::vector< double > Samples;
+  bool                       InOrder;
+
+public:
+
+  // ---------------------------------------------------------------------------
+  // Access
+  // ---------------------------------------------------------------------------
+  //
+  // The arrays are available for reading so that they can be given directly
+  // to the users of the data.
+
+  inline const std::pmr::vector< Time > & Times( void ) const
+  { return TimeStamps; }
+
+  inline const std::pmr::vector< double > & Values( void ) const
+  { return Samples; }
+
+  inline size_t size( void ) const
+  { return TimeStamps.size(); }
+
+  inline bool empty( void ) const
+  { return TimeStamps.empty(); }
+
+  inline Time TimeStamp( size_t Index ) const
+  { return TimeStamps[ Index ]; }
+
+  inline double Value( size_t Index ) const
+  { return Samples[ Index ]; }
+
+  // The last sample is frequently needed since it gives the duration and the
+  // total energy of a load profile. These will throw if the series is empty.
+
+  inline Time LastTime( void ) const
+  { return TimeStamps.at( TimeStamps.size() - 1 ); }
+
+  inline double LastValue( void ) const
+  { return Samples.at( Samples.size() - 1 ); }
+
+  // ---------------------------------------------------------------------------
+  // Building the series
+  // ---------------------------------------------------------------------------
+  //
+  // Samples are appended at the end, and the order check is just a comparison
+  // with the previous time stamp.
+
+  inline void Reserve( size_t Capacity )
+  {
+    TimeStamps.reserve( Capacity );
+    Samples.reserve( Capacity );
+  }
+
+  inline void Append( Time TheTime, double TheValue )
+  {
+    if ( !TimeStamps.empty() && ( TheTime <= TimeStamps.back() ) )
+      InOrder = false;
+
+    TimeStamps.push_back( TheTime );
+    Samples.push_back( TheValue );
+  }
+
+  // A series can be appended to another, which is sorted only if both are 
+  // sorted and the first time stamp of the appended series is after the 
+  // last time stamp of this series.
+
+  void Append( const TimeSeries & Other )
+  {
+    if ( !Other.empty() )
+    {
+      if ( !Other.InOrder ||
+           ( !TimeStamps.empty() && 
+             ( Other.TimeStamps.front() <= TimeStamps.back() ) ) )
+        InOrder = false;
+
+      TimeStamps.insert( TimeStamps.end(), Other.TimeStamps.begin(), 
+                         Other.TimeStamps.end() );
+      Samples.insert( Samples.end(), Other.Samples.begin(), 
+                      Other.Samples.end() );
+    }
+  }
+
+  inline void Clear( void )
+  {
+    TimeStamps.clear();
+    Samples.clear();
+    InOrder = true;
+  }
+
+  // The series is sorted if the time stamps are strictly increasing, i.e.
+  // there are no duplicated time stamps.
+
+  inline bool Sorted( void ) const
+  { return InOrder; }
+
+  // Normalising the series sorts the samples with a stable sort so that the
+  // first sample of a duplicated time stamp is kept.
+
+  void Normalise( void )
+  {
+    if ( InOrder ) return;
+
+    std::vector< size_t > Order( TimeStamps.size() );
+    std::iota( Order.begin(), Order.end(), 0 );
+    std::stable_sort( Order.begin(), Order.end(),
+      [this]( size_t a, size_t b ){ return TimeStamps[a] < TimeStamps[b]; } );
+
+    std::pmr::vector< Time >   SortedTimes( TimeStamps.get_allocator() );
+    std::pmr::vector< double > SortedSamples( Samples.get_allocator() );
+
+    SortedTimes.reserve( Order.size() );
+    SortedSamples.reserve( Order.size() );
+
+    for ( size_t Index : Order )
+      if ( SortedTimes.empty() || ( SortedTimes.back() < TimeStamps[ Index ] ) )
+      {
+        SortedTimes.push_back( TimeStamps[ Index ] );
+        SortedSamples.push_back( Samples[ Index ] );
+      }
+
+    TimeStamps.swap( SortedTimes );
+    Samples.swap( SortedSamples );
+    InOrder = true;
+  }
+
+  // Code still using the maps can convert the series
+
+  std::map< Time, double > ToMap( void ) const
+  {
+    std::map< Time, double > TheMap;
+
+    for ( size_t i = 0; i < TimeStamps.size(); i++ )
+      TheMap.emplace_hint( TheMap.end(), TimeStamps[i], Samples[i] );
+
+    return TheMap;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Constructors
+  // ---------------------------------------------------------------------------
+  //
+  // The series can be constructed empty or from a map, which is sorted, 
+  // optionally with the memory resource of the arrays.
+
+  TimeSeries( std::pmr::memory_resource * Memory 
+                = std::pmr::get_default_resource() )
+  : TimeStamps( Memory ), Samples( Memory ), InOrder( true )
+  {}
+
+  TimeSeries( const std::map< Time, double > & TheMap, 
+              std::pmr::memory_resource * Memory 
+                = std::pmr::get_default_resource() )
+  : TimeSeries( Memory )
+  {
+    Reserve( TheMap.size() );
+
+    for ( const auto & Sample : TheMap )
+    {
+      TimeStamps.push_back( Sample.first );
+      Samples.push_back( Sample.second );
+    }
+  }
+
+  TimeSeries( const TimeSeries & Other ) = default;
+  TimeSeries( TimeSeries && Other ) = default;
+
+  TimeSeries( const TimeSeries & Other, std::pmr::memory_resource * Memory )
+  : TimeStamps( Other.TimeStamps, Memory ), Samples( Other.Samples, Memory ),
+    InOrder( Other.InOrder )
+  {}
+
+  TimeSeries & operator= ( const TimeSeries & Other ) = default;
+  TimeSeries & operator= ( TimeSeries && Other ) = default;
+};
+
+}      // name space CoSSMic
+#endif // COSSMIC_TIME_SERIES
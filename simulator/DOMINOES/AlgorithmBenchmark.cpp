@@ -0,0 +1,964 @@
+/*==============================================================================
+Algorithm Benchmark
+
+The solver uses the BOBYQA algorithm by default because it was found to work
+well on the first scenarios, but the Optimization framework wraps all the
+global and local NLopt algorithms, and the choice should be based on how they
+all perform on problems of the sizes seen in practice. The benchmark times
+every wrapped algorithm on a suite of standard bound constrained test
+functions at a range of dimensions, and on real scheduling problems captured
+by the simulator.
+
+The test functions are the sphere, the Rosenbrock function, the Rastrigin
+function, the Ackley function and the Griewank function over their usual
+domains [1]. They all have the global minimum zero, and they are given with
+their analytic gradients so that also the gradient based algorithms can be
+timed. A captured scheduling problem is written by the simulator with the
+option --Capture, and its objective function is replayed with the incremental
+consumption and the grid cost exactly as the searches of the solver evaluate
+it, including the analytic gradient of the grid energy. The grid energy is
+interpolated as by the simulator, by Steffen's method unless linear
+interpolation is requested.
+
+The target of a problem is the reference value plus the given gap times the
+larger of one and the magnitude of the reference value. The reference value is
+the known minimum of a test function, and the best value found by any of the
+algorithms for a captured problem. An algorithm is stopped when it reaches
+the target of a test function, but since the target of a captured problem is
+only known when all the algorithms have been run, the algorithms run until
+they stop by themselves or by the limits on the evaluations and the time.
+
+All algorithms start from the same random initial values drawn uniformly over
+the domain of the problem, and the random generator of NLopt is seeded before
+each run so that the stochastic algorithms are repeatable. Each run is traced,
+and one CSV line is written for each run with the problem, the dimension, the
+algorithm, the number of evaluations and the time used by the run, the number
+of evaluations and the time used to reach the target, which are left empty if
+the target was not reached, the best value found, and the status returned by
+the algorithm. An algorithm that fails with an exception is reported with the
+status "Error" and the exception is written to the standard error stream.
+When all the runs are done, the algorithm reaching the target of each problem
+in the shortest time is written to the standard log stream.
+
+The following options are supported:
+
+-f [ --Functions <name...> ]   = Test functions. Default: all
+-n [ --Dimensions <n...> ]     = Test function dimensions. Default: 10 50 100 500
+-p [ --Problems <file...> ]    = Captured scheduling problems. Default: none
+-a [ --Algorithms <name...> ]  = Algorithms to time. Default: all
+-e [ --Evaluations <n> ]       = Maximal evaluations per run. Default: 100000
+-t [ --TimeLimit <seconds> ]   = Maximal time per run. Default: 60
+-G [ --Gap <fraction> ]        = Gap to the reference value. Default: 0.001
+-g [ --GridEnergy <method> ]   = Linear or Steffen interpolation. Default: Steffen
+-o [ --Output <file> ]         = File for the results. Default: standard output
+-r [ --Seed <n> ]              = Seed for the initial values. Default: 1
+
+The principal axis algorithm is not timed since its optimizer does not set
+bounds on the variables. The other algorithms are named by their identifiers
+in the Algorithms header, like Local::Approximation::Rescaling for BOBYQA, and
+the multi-level single linkage and the augmented Lagrangian algorithms are
+named with their subsidiary algorithm in brackets. Note that some algorithms, like the original DIRECT
+and the controlled random search, have limits on the number of variables,
+and they will fail for the largest problems.
+
+References:
+
+[1] M. Jamil and X.-S. Yang, "A literature survey of benchmark functions for
+    global optimisation problems," Int. J. of Mathematical Modelling and
+    Numerical Optimisation, Vol. 4, No. 2, pp. 150-194, 2013
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <string>                            // Standard strings
+#include <vector>                            // Standard vectors
+#include <map>                               // Best algorithm per problem
+#include <memory>                            // Problem instances
+#include <functional>                        // Problem factories and runs
+#include <optional>                          // Targets
+#include <sstream>                           // Formatted errors
+#include <stdexcept>                         // Standard exceptions
+#include <iostream>                          // Writing the results
+#include <fstream>                           // Results and captured problems
+#include <random>                            // Initial values
+#include <chrono>                            // Time limits
+#include <cmath>                             // Test functions
+#include <algorithm>                         // Searching the names
+#include <cstdlib>                           // Exit status
+
+#include <boost/program_options.hpp>         // Command line parsing
+#include <boost/numeric/interval.hpp>        // Variable domains
+#include <boost/numeric/conversion/cast.hpp> // Casting numeric types
+#include <nlopt.h>                           // Seeding the algorithms
+
+// The optimization algorithms
+
+#include "Objective.hpp"                     // Objective and gradient
+#include "NonLinear/Algorithms.hpp"          // The algorithms
+#include "NonLinear/Optimizer.hpp"           // The solver interface
+#include "NonLinear/ConvergenceTrace.hpp"    // Time to target
+#include "NonLinear/DIRECT.hpp"              // Global algorithms
+#include "NonLinear/ControlledRandomSearch.hpp"
+#include "NonLinear/MultiLevelSingleLinkage.hpp"
+#include "NonLinear/StoGo.hpp"
+#include "NonLinear/Evolutionary.hpp"
+#include "NonLinear/Penalty.hpp"
+#include "NonLinear/LocalApproximation.hpp"  // Local algorithms
+#include "NonLinear/Simplex.hpp"
+#include "NonLinear/QuasiNewton.hpp"
+
+// Dominoes headers
+
+#include "ProblemCapture.hpp"                // Captured scheduling problems
+#include "IncrementalConsumption.hpp"        // Replaying the objective
+#include "GridCost.hpp"
+#include "Interpolation.hpp"                 // Grid energy interpolation
+
+namespace cmd = boost::program_options;
+namespace NL  = Optimization::NonLinear;
+
+namespace Dominoes
+{
+/*==============================================================================
+
+ Problems
+
+==============================================================================*/
+//
+// A benchmark problem has an objective function, its gradient and the bounds
+// of the variables. The objective function may have state, and a new instance
+// of the problem is therefore created for each run.
+
+class BenchmarkProblem
+{
+public:
+
+  using Interval = boost::numeric::interval< Optimization::VariableType >;
+
+  virtual double Value( Optimization::VariableSpan X ) = 0;
+  virtual void   Gradient( Optimization::VariableSpan X,
+                           Optimization::GradientSpan G ) = 0;
+  virtual std::vector< Interval > Bounds( void ) const = 0;
+
+  virtual ~BenchmarkProblem( void )
+  {}
+};
+
+using ProblemFactory =
+      std::function< std::unique_ptr< BenchmarkProblem >( void ) >;
+
+// -----------------------------------------------------------------------------
+// Test functions
+// -----------------------------------------------------------------------------
+//
+// The test functions have the same domain for all variables
+
+class TestFunction : public BenchmarkProblem
+{
+private:
+
+  const Optimization::Dimension Size;
+  const double                  Lower, Upper;
+
+public:
+
+  virtual std::vector< Interval > Bounds( void ) const override
+  { return std::vector< Interval >( Size, Interval( Lower, Upper ) ); }
+
+  TestFunction( Optimization::Dimension Dimension,
+                double LowerBound, double UpperBound )
+  : Size( Dimension ), Lower( LowerBound ), Upper( UpperBound )
+  {}
+};
+
+// The sphere is the sum of the squared variables
+
+class Sphere : public TestFunction
+{
+public:
+
+  virtual double Value( Optimization::VariableSpan X ) override
+  {
+    double Sum = 0.0;
+
+    for ( double x : X ) Sum += x * x;
+
+    return Sum;
+  }
+
+  virtual void Gradient( Optimization::VariableSpan X,
+                         Optimization::GradientSpan G ) override
+  {
+    for ( Optimization::Dimension i = 0; i < X.size(); i++ )
+      G[i] = 2.0 * X[i];
+  }
+
+  Sphere( Optimization::Dimension Dimension )
+  : TestFunction( Dimension, -5.12, 5.12 )
+  {}
+};
+
+// The Rosenbrock function has its minimum at the end of a long curved valley
+
+class Rosenbrock : public TestFunction
+{
+public:
+
+  virtual double Value( Optimization::VariableSpan X ) override
+  {
+    double Sum = 0.0;
+
+    for ( Optimization::Dimension i = 0; i + 1 < X.size(); i++ )
+    {
+      const double Valley = X[i+1] - X[i] * X[i], Distance = 1.0 - X[i];
+
+      Sum += 100.0 * Valley * Valley + Distance * Distance;
+    }
+
+    return Sum;
+  }
+
+  virtual void Gradient( Optimization::VariableSpan X,
+                         Optimization::GradientSpan G ) override
+  {
+    for ( Optimization::Dimension i = 0; i < X.size(); i++ )
+    {
+      G[i] = 0.0;
+
+      if ( i + 1 < X.size() )
+        G[i] += -400.0 * X[i] * ( X[i+1] - X[i] * X[i] ) - 2.0 * ( 1.0 - X[i] );
+
+      if ( i > 0 )
+        G[i] += 200.0 * ( X[i] - X[i-1] * X[i-1] );
+    }
+  }
+
+  Rosenbrock( Optimization::Dimension Dimension )
+  : TestFunction( Dimension, -5.0, 10.0 )
+  {}
+};
+
+// The Rastrigin function has a regular grid of local minima
+
+class Rastrigin : public TestFunction
+{
+public:
+
+  virtual double Value( Optimization::VariableSpan X ) override
+  {
+    double Sum = 10.0 * X.size();
+
+    for ( double x : X )
+      Sum += x * x - 10.0 * std::cos( 2.0 * M_PI * x );
+
+    return Sum;
+  }
+
+  virtual void Gradient( Optimization::VariableSpan X,
+                         Optimization::GradientSpan G ) override
+  {
+    for ( Optimization::Dimension i = 0; i < X.size(); i++ )
+      G[i] = 2.0 * X[i] + 20.0 * M_PI * std::sin( 2.0 * M_PI * X[i] );
+  }
+
+  Rastrigin( Optimization::Dimension Dimension )
+  : TestFunction( Dimension, -5.12, 5.12 )
+  {}
+};
+
+// The Ackley function is nearly flat away from the minimum at the origin
+
+class Ackley : public TestFunction
+{
+public:
+
+  virtual double Value( Optimization::VariableSpan X ) override
+  {
+    double Squares = 0.0, Cosines = 0.0;
+
+    for ( double x : X )
+    {
+      Squares += x * x;
+      Cosines += std::cos( 2.0 * M_PI * x );
+    }
+
+    return -20.0 * std::exp( -0.2 * std::sqrt( Squares / X.size() ) )
+           - std::exp( Cosines / X.size() ) + 20.0 + M_E;
+  }
+
+  virtual void Gradient( Optimization::VariableSpan X,
+                         Optimization::GradientSpan G ) override
+  {
+    double Squares = 0.0, Cosines = 0.0;
+
+    for ( double x : X )
+    {
+      Squares += x * x;
+      Cosines += std::cos( 2.0 * M_PI * x );
+    }
+
+    const double Radius      = std::sqrt( Squares / X.size() ),
+                 RadialTerm  = ( Radius > 0.0 )
+                               ? 4.0 * std::exp( -0.2 * Radius ) /
+                                 ( X.size() * Radius ) : 0.0,
+                 CosineTerm  = 2.0 * M_PI * std::exp( Cosines / X.size() ) /
+                               X.size();
+
+    for ( Optimization::Dimension i = 0; i < X.size(); i++ )
+      G[i] = RadialTerm * X[i] + CosineTerm * std::sin( 2.0 * M_PI * X[i] );
+  }
+
+  Ackley( Optimization::Dimension Dimension )
+  : TestFunction( Dimension, -32.768, 32.768 )
+  {}
+};
+
+// The Griewank function couples the variables through a product of cosines.
+// The gradient of the product is computed from the products of the factors
+// before and after each variable to avoid dividing by a zero factor.
+
+class Griewank : public TestFunction
+{
+public:
+
+  virtual double Value( Optimization::VariableSpan X ) override
+  {
+    double Sum = 0.0, Product = 1.0;
+
+    for ( Optimization::Dimension i = 0; i < X.size(); i++ )
+    {
+      Sum     += X[i] * X[i] / 4000.0;
+      Product *= std::cos( X[i] / std::sqrt( i + 1.0 ) );
+    }
+
+    return 1.0 + Sum - Product;
+  }
+
+  virtual void Gradient( Optimization::VariableSpan X,
+                         Optimization::GradientSpan G ) override
+  {
+    double Before = 1.0;
+
+    for ( Optimization::Dimension i = 0; i < X.size(); i++ )
+    {
+      G[i]    = Before;
+      Before *= std::cos( X[i] / std::sqrt( i + 1.0 ) );
+    }
+
+    double After = 1.0;
+
+    for ( Optimization::Dimension i = X.size(); i-- > 0; )
+    {
+      const double Scale = std::sqrt( i + 1.0 );
+
+      G[i]   = X[i] / 2000.0 + G[i] * After * std::sin( X[i] / Scale ) / Scale;
+      After *= std::cos( X[i] / Scale );
+    }
+  }
+
+  Griewank( Optimization::Dimension Dimension )
+  : TestFunction( Dimension, -600.0, 600.0 )
+  {}
+};
+
+// The test functions are created by name
+
+const std::vector< std::string > TestFunctions =
+      { "Sphere", "Rosenbrock", "Rastrigin", "Ackley", "Griewank" };
+
+ProblemFactory NewTestFunction( const std::string & Name,
+                                Optimization::Dimension Dimension )
+{
+  if ( Name == "Sphere" )
+    return [=](void){ return std::make_unique< Sphere >( Dimension ); };
+  else if ( Name == "Rosenbrock" )
+    return [=](void){ return std::make_unique< Rosenbrock >( Dimension ); };
+  else if ( Name == "Rastrigin" )
+    return [=](void){ return std::make_unique< Rastrigin >( Dimension ); };
+  else if ( Name == "Ackley" )
+    return [=](void){ return std::make_unique< Ackley >( Dimension ); };
+  else if ( Name == "Griewank" )
+    return [=](void){ return std::make_unique< Griewank >( Dimension ); };
+  else
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "There is no test function called " << Name;
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Captured scheduling problem
+// -----------------------------------------------------------------------------
+//
+// The scheduling problem evaluates the grid energy of the start times with
+// its own incremental consumption and grid cost on the captured data, and
+// the gradient is computed as by the gradient search of the solver.
+
+class SchedulingProblem : public BenchmarkProblem
+{
+private:
+
+  const ProblemCapture & Capture;
+
+  IncrementalConsumption Consumption;
+  GridCost               Cost;
+
+public:
+
+  virtual double Value( Optimization::VariableSpan X ) override
+  { return Cost( Consumption.Update( X ) ); }
+
+  virtual void Gradient( Optimization::VariableSpan X,
+                         Optimization::GradientSpan G ) override
+  {
+    const std::vector< double > &
+    Weights( Cost.DeficitWeights( Consumption.Update( X ) ) );
+
+    for ( ConsumptionBlock::Index Consumer = 0; Consumer < X.size(); Consumer++ )
+      G[ Consumer ] = Capture.GetProfiles().StartTimeDerivative( Consumer,
+        boost::numeric_cast< CoSSMic::Time >( X[ Consumer ] ),
+        Weights.data() );
+  }
+
+  virtual std::vector< Interval > Bounds( void ) const override
+  { return Capture.GetBounds(); }
+
+  SchedulingProblem( const ProblemCapture & CapturedProblem,
+                     Interpolation::Type GridInterpolation )
+  : Capture( CapturedProblem ),
+    Consumption( CapturedProblem.GetProfiles(),
+                 CapturedProblem.GetProductionSamples()->size() ),
+    Cost( CapturedProblem.GetProductionSamples(),
+          CapturedProblem.GetIntervalProduction(), GridInterpolation )
+  {}
+};
+
+/*==============================================================================
+
+ Algorithm runs
+
+==============================================================================*/
+//
+// The run settings are common to all the runs of a problem
+
+class RunSettings
+{
+public:
+
+  Optimization::Variables      InitialValues;
+  std::optional< double >      Target;
+  int                          MaxEvaluations;
+  std::chrono::seconds         TimeLimit;
+  unsigned long                Seed;
+};
+
+// The outcome of a run is the number of evaluations and the time used, the
+// best value and the status, and the trace of the evaluations from which the
+// time to target is found.
+
+class RunOutcome
+{
+public:
+
+  std::size_t                                  Evaluations;
+  double                                       Seconds;
+  double                                       BestValue;
+  std::string                                  Status;
+  std::vector< NL::ConvergenceTrace::TracePoint > Trace;
+};
+
+// An algorithm run is an optimizer for the algorithm with the objective
+// function and the bounds of the problem. The gradient functions are defined
+// for all algorithms, and they override the gradient functions of the
+// optimizers of the gradient based algorithms. For the derivative free
+// algorithms they are simply never called.
+
+template< NL::Algorithm::ID PrimaryAlgorithm, NL::Algorithm::ID SecondaryAlgorithm >
+class AlgorithmRun : public NL::Optimizer< PrimaryAlgorithm, SecondaryAlgorithm >
+{
+private:
+
+  BenchmarkProblem &                          Problem;
+  const std::vector< BenchmarkProblem::Interval > Domain;
+
+protected:
+
+  virtual Optimization::VariableType
+  ObjectiveFunction( const Optimization::Variables & VariableValues ) override
+  { return Problem.Value( Optimization::VariableSpan( VariableValues ) ); }
+
+  virtual Optimization::VariableType
+  ObjectiveFunction( Optimization::VariableSpan VariableValues ) override
+  { return Problem.Value( VariableValues ); }
+
+  virtual Optimization::GradientVector
+  GradientFunction( const Optimization::Variables & VariableValues )
+  {
+    Optimization::GradientVector Gradient( VariableValues.size() );
+
+    Problem.Gradient( Optimization::VariableSpan( VariableValues ),
+                      Optimization::GradientSpan( Gradient ) );
+
+    return Gradient;
+  }
+
+  virtual void
+  GradientFunction( Optimization::VariableSpan VariableValues,
+                    Optimization::GradientSpan GradientValues )
+  { Problem.Gradient( VariableValues, GradientValues ); }
+
+  virtual std::vector< BenchmarkProblem::Interval >
+  BoundConstraints( void ) override
+  { return Domain; }
+
+public:
+
+  // The run creates the solver, sets the stopping criteria and traces the
+  // evaluations of the search. The NLopt random generator is seeded for
+  // every run.
+
+  RunOutcome Run( const RunSettings & Settings )
+  {
+    this->CreateSolver( Settings.InitialValues.size(),
+                        Optimization::Objective::Goal::Minimize );
+
+    this->MaxNumberOfEvaluations( Settings.MaxEvaluations );
+    this->MaxTime( Settings.TimeLimit );
+
+    if ( Settings.Target )
+      this->StopValue( *Settings.Target );
+
+    this->TraceEvaluations();
+    nlopt_srand( Settings.Seed );
+
+    auto Solution = this->FindSolution( Settings.InitialValues );
+
+    const NL::ConvergenceTrace * Trace = this->GetTrace();
+    NL::ConvergenceTrace::Summary Totals( Trace->GetSummary() );
+
+    return RunOutcome{ Totals.Evaluations, Totals.SearchTime,
+                       std::min( Solution.ObjectiveValue, Totals.MinValue ),
+                       StatusName( Solution.Status ), Trace->GetTrace() };
+  }
+
+  // The status of the run is written by name
+
+  static std::string StatusName( nlopt_result Status )
+  {
+    switch ( Status )
+    {
+      case NLOPT_SUCCESS:          return "Success";
+      case NLOPT_STOPVAL_REACHED:  return "StopValue";
+      case NLOPT_FTOL_REACHED:     return "ObjectiveTolerance";
+      case NLOPT_XTOL_REACHED:     return "VariableTolerance";
+      case NLOPT_MAXEVAL_REACHED:  return "MaxEvaluations";
+      case NLOPT_MAXTIME_REACHED:  return "MaxTime";
+      case NLOPT_FORCED_STOP:      return "ForcedStop";
+      case NLOPT_ROUNDOFF_LIMITED: return "RoundoffLimited";
+      case NLOPT_OUT_OF_MEMORY:    return "OutOfMemory";
+      case NLOPT_INVALID_ARGS:     return "InvalidArguments";
+      default:                     return "Failure";
+    }
+  }
+
+  template< class... OptimizerArguments >
+  AlgorithmRun( BenchmarkProblem & TheProblem,
+                OptimizerArguments... Arguments )
+  : NL::Optimizer< PrimaryAlgorithm, SecondaryAlgorithm >( Arguments... ),
+    Problem( TheProblem ), Domain( TheProblem.Bounds() )
+  {}
+
+  virtual ~AlgorithmRun( void )
+  {}
+};
+
+// The suite of algorithms holds the named runs of all the algorithms. The
+// constraint tolerance given to the algorithms supporting constraints is not
+// used since the problems have only bounds, and the subsidiary algorithms are
+// given a small tolerance so that the local searches terminate. The principal
+// axis algorithm is not included since its optimizer is unconstrained and
+// does not set the bounds of the problems.
+
+class AlgorithmSuite
+{
+private:
+
+  using Entry = std::function< RunOutcome( BenchmarkProblem &,
+                                           const RunSettings & ) >;
+
+  std::vector< std::pair< std::string, Entry > > Algorithms;
+
+  template< NL::Algorithm::ID PrimaryAlgorithm,
+            NL::Algorithm::ID SecondaryAlgorithm = NL::Algorithm::ID::NoAlgorithm,
+            class... OptimizerArguments >
+  void Add( const std::string & Name, OptimizerArguments... Arguments )
+  {
+    Algorithms.emplace_back( Name,
+      [=]( BenchmarkProblem & Problem, const RunSettings & Settings )
+      {
+        AlgorithmRun< PrimaryAlgorithm, SecondaryAlgorithm >
+        TheRun( Problem, Arguments... );
+
+        return TheRun.Run( Settings );
+      });
+  }
+
+public:
+
+  inline const std::vector< std::pair< std::string, Entry > > &
+  Entries( void ) const
+  { return Algorithms; }
+
+  AlgorithmSuite( void )
+  : Algorithms()
+  {
+    using Global = NL::Algorithm::Global;
+    using Local  = NL::Algorithm::Local;
+
+    const double       Tolerance      = 1e-8;
+    const unsigned int StartingPoints = 0;
+
+    Add< Global::DIRECT::Standard >( "Global::DIRECT::Standard" );
+    Add< Global::DIRECT::Unscaled >( "Global::DIRECT::Unscaled" );
+    Add< Global::DIRECT::Original >( "Global::DIRECT::Original", Tolerance );
+    Add< Global::DIRECT::Local::Standard >( "Global::DIRECT::Local::Standard" );
+    Add< Global::DIRECT::Local::Randomized >(
+         "Global::DIRECT::Local::Randomized" );
+    Add< Global::DIRECT::Local::Original >(
+         "Global::DIRECT::Local::Original", Tolerance );
+    Add< Global::DIRECT::Local::Unscaled::Standard >(
+         "Global::DIRECT::Local::Unscaled::Standard" );
+    Add< Global::DIRECT::Local::Unscaled::Randomized >(
+         "Global::DIRECT::Local::Unscaled::Randomized" );
+    Add< Global::ControlledRandomSearch >( "Global::ControlledRandomSearch" );
+    Add< Global::MultiLevelSingleLinkage::NonDerivative,
+         Local::Approximation::Rescaling >(
+         "Global::MultiLevelSingleLinkage::NonDerivative"
+         "[Local::Approximation::Rescaling]",
+         StartingPoints, Tolerance, Tolerance );
+    Add< Global::MultiLevelSingleLinkage::Derivative,
+         Local::QuasiNewton::LowMemeory >(
+         "Global::MultiLevelSingleLinkage::Derivative"
+         "[Local::QuasiNewton::LowMemeory]",
+         StartingPoints, Tolerance, Tolerance );
+    Add< Global::MultiLevelSingleLinkage::LowDiscrepancySequence::NonDerivative,
+         Local::Approximation::Rescaling >(
+         "Global::MultiLevelSingleLinkage::LowDiscrepancySequence::NonDerivative"
+         "[Local::Approximation::Rescaling]",
+         StartingPoints, Tolerance, Tolerance );
+    Add< Global::MultiLevelSingleLinkage::LowDiscrepancySequence::Derivative,
+         Local::QuasiNewton::LowMemeory >(
+         "Global::MultiLevelSingleLinkage::LowDiscrepancySequence::Derivative"
+         "[Local::QuasiNewton::LowMemeory]",
+         StartingPoints, Tolerance, Tolerance );
+    Add< Global::StoGo::Standard >( "Global::StoGo::Standard" );
+    Add< Global::StoGo::Randomized >( "Global::StoGo::Randomized" );
+    Add< Global::Evolutionary >( "Global::Evolutionary" );
+    Add< Global::Penalty::AllConstraints, Global::DIRECT::Standard >(
+         "Global::Penalty::AllConstraints[Global::DIRECT::Standard]",
+         Tolerance, Tolerance );
+    Add< Global::Penalty::EqualityConstraints, Global::DIRECT::Original >(
+         "Global::Penalty::EqualityConstraints[Global::DIRECT::Original]",
+         Tolerance, Tolerance );
+
+    Add< Local::Approximation::Linear >( "Local::Approximation::Linear",
+                                         Tolerance );
+    Add< Local::Approximation::Quadratic >( "Local::Approximation::Quadratic" );
+    Add< Local::Approximation::Rescaling >( "Local::Approximation::Rescaling" );
+    Add< Local::Evolutionary >( "Local::Evolutionary", Tolerance );
+    Add< Local::Simplex::NelderMead >( "Local::Simplex::NelderMead" );
+    Add< Local::Simplex::Subspace >( "Local::Simplex::Subspace" );
+    Add< Local::QuasiNewton::LowMemeory >( "Local::QuasiNewton::LowMemeory" );
+    Add< Local::QuasiNewton::QuadraticProgramming >(
+         "Local::QuasiNewton::QuadraticProgramming", Tolerance );
+    Add< Local::QuasiNewton::VariableMetric::RankOne >(
+         "Local::QuasiNewton::VariableMetric::RankOne" );
+    Add< Local::QuasiNewton::VariableMetric::RankTwo >(
+         "Local::QuasiNewton::VariableMetric::RankTwo" );
+    Add< Local::QuasiNewton::Truncated::Plain >(
+         "Local::QuasiNewton::Truncated::Plain" );
+    Add< Local::QuasiNewton::Truncated::Restart >(
+         "Local::QuasiNewton::Truncated::Restart" );
+    Add< Local::QuasiNewton::Truncated::Precondition >(
+         "Local::QuasiNewton::Truncated::Precondition" );
+    Add< Local::QuasiNewton::Truncated::PreconditionRestart >(
+         "Local::QuasiNewton::Truncated::PreconditionRestart" );
+    Add< Local::Penalty::AllConstraints, Local::QuasiNewton::LowMemeory >(
+         "Local::Penalty::AllConstraints[Local::QuasiNewton::LowMemeory]",
+         Tolerance, Tolerance );
+    Add< Local::Penalty::EqualityConstraints, Local::Approximation::Linear >(
+         "Local::Penalty::EqualityConstraints[Local::Approximation::Linear]",
+         Tolerance, Tolerance );
+    Add< Local::Penalty::ConvexSeparable >( "Local::Penalty::ConvexSeparable",
+                                            Tolerance );
+    Add< Local::Penalty::MovingAsymptotes >( "Local::Penalty::MovingAsymptotes",
+                                             Tolerance );
+  }
+};
+
+/*==============================================================================
+
+ Benchmark
+
+==============================================================================*/
+//
+// The benchmark runs the selected algorithms on one problem from the same
+// initial values, and writes the outcome of each run when the target is known.
+
+class Benchmark
+{
+private:
+
+  const AlgorithmSuite &           Suite;
+  const std::vector< std::string > Selected;
+  const int                        MaxEvaluations;
+  const std::chrono::seconds       TimeLimit;
+  const double                     Gap;
+  std::mt19937_64                  Generator;
+  const unsigned long              Seed;
+  std::ostream &                   Output;
+
+  // The fastest algorithm to the target of each problem and dimension is
+  // remembered for the summary.
+
+  std::map< std::string, std::pair< std::string, double > > Fastest;
+
+  // The target is the reference value plus the gap
+
+  inline double Target( double Reference ) const
+  { return Reference + Gap * std::max( 1.0, std::abs( Reference ) ); }
+
+public:
+
+  void Run( const std::string & ProblemName, const ProblemFactory & NewProblem,
+            std::optional< double > Reference )
+  {
+    std::vector< BenchmarkProblem::Interval > Domain( NewProblem()->Bounds() );
+    RunSettings Settings;
+
+    for ( const BenchmarkProblem::Interval & Range : Domain )
+      Settings.InitialValues.push_back( std::uniform_real_distribution<>(
+        Range.lower(), Range.upper() )( Generator ) );
+
+    if ( Reference )
+      Settings.Target = Target( *Reference );
+
+    Settings.MaxEvaluations = MaxEvaluations;
+    Settings.TimeLimit      = TimeLimit;
+    Settings.Seed           = Seed;
+
+    std::vector< std::pair< std::string, RunOutcome > > Outcomes;
+
+    for ( const auto & [ Name, TheRun ] : Suite.Entries() )
+      if ( Selected.empty() ||
+           std::find( Selected.begin(), Selected.end(), Name ) != Selected.end() )
+      {
+        auto Problem = NewProblem();
+
+        try
+        {
+          Outcomes.emplace_back( Name, TheRun( *Problem, Settings ) );
+        }
+        catch ( std::exception & Error )
+        {
+          std::cerr << ProblemName << " " << Name << ": " << Error.what()
+                    << std::endl;
+
+          Outcomes.emplace_back( Name, RunOutcome{ 0, 0.0, HUGE_VAL, "Error",
+                                 {} } );
+        }
+      }
+
+    // The target of a captured problem is given by the best value found by
+    // any of the algorithms.
+
+    const std::string Instance( ProblemName + " " +
+                                std::to_string( Domain.size() ) );
+    double ProblemTarget;
+
+    if ( Settings.Target )
+      ProblemTarget = *Settings.Target;
+    else
+    {
+      double Best = HUGE_VAL;
+
+      for ( const auto & Outcome : Outcomes )
+        Best = std::min( Best, Outcome.second.BestValue );
+
+      ProblemTarget = Target( Best );
+    }
+
+    for ( const auto & [ Name, Outcome ] : Outcomes )
+    {
+      Output << ProblemName << "," << Domain.size() << "," << Name << ","
+             << Outcome.Evaluations << "," << Outcome.Seconds << ",";
+
+      auto Reached = std::find_if( Outcome.Trace.begin(), Outcome.Trace.end(),
+        [&]( const NL::ConvergenceTrace::TracePoint & Point ){
+          return Point.Value <= ProblemTarget; });
+
+      if ( Reached != Outcome.Trace.end() )
+      {
+        const double Seconds = Reached->Nanoseconds * 1e-9;
+
+        Output << Reached->Evaluation << "," << Seconds;
+
+        auto Winner = Fastest.find( Instance );
+
+        if ( ( Winner == Fastest.end() ) || ( Seconds < Winner->second.second ) )
+          Fastest[ Instance ] = std::make_pair( Name, Seconds );
+      }
+      else
+        Output << ",";
+
+      Output << "," << Outcome.BestValue << "," << Outcome.Status << std::endl;
+    }
+  }
+
+  // The summary is written to the log
+
+  void Summary( std::ostream & Log ) const
+  {
+    for ( const auto & [ Instance, Winner ] : Fastest )
+      Log << Instance << ": " << Winner.first << " reached the target in "
+          << Winner.second << " seconds" << std::endl;
+  }
+
+  Benchmark( const AlgorithmSuite & Algorithms,
+             const std::vector< std::string > & AlgorithmNames,
+             int EvaluationLimit, std::chrono::seconds RunTimeLimit,
+             double TargetGap, unsigned long GeneratorSeed,
+             std::ostream & Results )
+  : Suite( Algorithms ), Selected( AlgorithmNames ),
+    MaxEvaluations( EvaluationLimit ), TimeLimit( RunTimeLimit ),
+    Gap( TargetGap ), Generator( GeneratorSeed ), Seed( GeneratorSeed ),
+    Output( Results ), Fastest()
+  {
+    Output << "problem,dimension,algorithm,evaluations,seconds,"
+           << "evaluations_to_target,seconds_to_target,best_value,status"
+           << std::endl;
+  }
+};
+
+}      // End name space Dominoes
+
+/*==============================================================================
+
+ Main
+
+==============================================================================*/
+
+int main( int argc, char ** argv )
+{
+  cmd::options_description Description("Allowed options");
+  cmd::variables_map       Values;
+
+  Description.add_options()
+    ( "help,h", "Produce this help message" )
+    ( "Functions,f", cmd::value< std::vector< std::string > >()->multitoken(),
+      "Test functions to minimise" )
+    ( "Dimensions,n",
+      cmd::value< std::vector< Optimization::Dimension > >()->multitoken(),
+      "Dimensions of the test functions" )
+    ( "Problems,p", cmd::value< std::vector< std::string > >()->multitoken(),
+      "Captured scheduling problems" )
+    ( "Algorithms,a", cmd::value< std::vector< std::string > >()->multitoken(),
+      "Algorithms to time" )
+    ( "Evaluations,e", cmd::value< int >()->default_value( 100000 ),
+      "Maximal number of evaluations per run" )
+    ( "TimeLimit,t", cmd::value< std::chrono::seconds::rep >()->default_value(60),
+      "Maximal time in seconds per run" )
+    ( "Gap,G", cmd::value< double >()->default_value( 1e-3 ),
+      "Gap to the reference value defining the target" )
+    ( "GridEnergy,g", cmd::value< std::string >()->default_value("Steffen"),
+      "Grid energy interpolation: Linear or Steffen" )
+    ( "Output,o", cmd::value< std::string >(),
+      "File for the results" )
+    ( "Seed,r", cmd::value< unsigned long >()->default_value(1),
+      "Seed for the initial values and the algorithms" );
+
+  cmd::store( cmd::parse_command_line( argc, argv, Description ), Values );
+
+  if ( Values.count("help") > 0 )
+  {
+    std::cout << Description << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  cmd::notify( Values );
+
+  std::vector< std::string > Functions( Dominoes::TestFunctions ),
+                             Problems, Algorithms;
+  std::vector< Optimization::Dimension > Dimensions = { 10, 50, 100, 500 };
+
+  if ( Values.count("Functions") > 0 )
+    Functions = Values["Functions"].as< std::vector< std::string > >();
+
+  if ( Values.count("Dimensions") > 0 )
+    Dimensions = Values["Dimensions"].as< std::vector< Optimization::Dimension > >();
+
+  if ( Values.count("Problems") > 0 )
+    Problems = Values["Problems"].as< std::vector< std::string > >();
+
+  if ( Values.count("Algorithms") > 0 )
+    Algorithms = Values["Algorithms"].as< std::vector< std::string > >();
+
+  Interpolation::Type GridInterpolation;
+
+  if ( Values["GridEnergy"].as< std::string >() == "Linear" )
+    GridInterpolation = Interpolation::Type::Linear;
+  else if ( Values["GridEnergy"].as< std::string >() == "Steffen" )
+    GridInterpolation = Interpolation::Type::SteffenMethod;
+  else
+  {
+    std::cout << "The grid energy interpolation must be Linear or Steffen"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::ofstream ResultFile;
+
+  if ( Values.count("Output") > 0 )
+    ResultFile.open( Values["Output"].as< std::string >() );
+
+  Dominoes::AlgorithmSuite Suite;
+  Dominoes::Benchmark      TheBenchmark( Suite, Algorithms,
+    Values["Evaluations"].as< int >(),
+    std::chrono::seconds( Values["TimeLimit"].as< std::chrono::seconds::rep >() ),
+    Values["Gap"].as< double >(), Values["Seed"].as< unsigned long >(),
+    ResultFile.is_open() ? static_cast< std::ostream & >( ResultFile )
+                         : std::cout );
+
+  try
+  {
+    for ( const std::string & Function : Functions )
+      for ( Optimization::Dimension Dimension : Dimensions )
+        TheBenchmark.Run( Function,
+                          Dominoes::NewTestFunction( Function, Dimension ), 0.0 );
+
+    for ( const std::string & ProblemFile : Problems )
+    {
+      std::ifstream Input( ProblemFile );
+      Dominoes::ProblemCapture Capture( Input );
+
+      TheBenchmark.Run( ProblemFile, [&](void){
+        return std::make_unique< Dominoes::SchedulingProblem >( Capture,
+                                                    GridInterpolation ); },
+        std::nullopt );
+    }
+  }
+  catch ( std::exception & Error )
+  {
+    std::cerr << Error.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  TheBenchmark.Summary( std::clog );
+
+  return EXIT_SUCCESS;
+}
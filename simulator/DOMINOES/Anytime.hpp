@@ -0,0 +1,99 @@
+/*==============================================================================
+Anytime
+
+A search may be given a wall-clock deadline after which it must return the
+best start times found so far even if the search has not converged. The
+anytime record keeps the deadline and the best variable values evaluated so
+far together with their objective value. The objective function of a search
+records each evaluation, and it can then check if the deadline has expired
+and if so force the search to stop.
+
+The record has no synchronisation and it must only be used by the thread
+running the search.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_ANYTIME
+#define DOMINOES_ANYTIME
+
+#include <chrono>                            // Deadlines
+#include <limits>                            // Largest objective value
+
+#include "Variables.hpp"                     // Optimization variables
+
+namespace Dominoes {
+
+class Anytime
+{
+public:
+
+  using Clock = std::chrono::steady_clock;
+
+private:
+
+  // The deadline is only valid if it has been set
+
+  Clock::time_point Deadline;
+  bool              HasDeadline;
+
+  // The best variable values and the corresponding objective value
+
+  Optimization::Variables BestValues;
+  double                  BestObjective;
+
+public:
+
+  // The deadline can be set and cleared, and there is a test to see if it
+  // has expired.
+
+  inline void SetDeadline( Clock::time_point TheDeadline )
+  {
+    Deadline    = TheDeadline;
+    HasDeadline = true;
+  }
+
+  inline void ClearDeadline( void )
+  { HasDeadline = false; }
+
+  inline bool Expired( void ) const
+  { return HasDeadline && ( Clock::now() >= Deadline ); }
+
+  // An evaluation of the objective function is recorded if it is better than
+  // the best value so far. A new search should reset the best value.
+
+  inline void Record( Optimization::VariableSpan Values, double Objective )
+  {
+    if ( Objective < BestObjective )
+    {
+      BestValues.assign( Values.begin(), Values.end() );
+      BestObjective = Objective;
+    }
+  }
+
+  inline void Reset( void )
+  {
+    BestValues.clear();
+    BestObjective = std::numeric_limits< double >::max();
+  }
+
+  // The best values can be read. The variable values will be empty if no
+  // evaluation has been recorded.
+
+  inline const Optimization::Variables & BestVariables( void ) const
+  { return BestValues; }
+
+  inline double BestValue( void ) const
+  { return BestObjective; }
+
+  // The constructor initialises an empty record without a deadline
+
+  Anytime( void )
+  : Deadline(), HasDeadline( false ), BestValues(),
+    BestObjective( std::numeric_limits< double >::max() )
+  {}
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_ANYTIME
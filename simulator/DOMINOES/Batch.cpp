@@ -0,0 +1,173 @@
+/*==============================================================================
+Batch
+
+This implements the reading of the batch manifest and the worker pool solving
+the scenarios.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <sstream>                           // For nicely formatted errors
+#include <stdexcept>                         // Standard exceptions
+#include <iostream>                          // Reporting errors
+#include <thread>                            // The workers
+#include <atomic>                            // Scenario counter
+#include <mutex>                             // Serialising the error output
+#include <algorithm>                         // Min and max
+#include <fstream>                           // Writing cached results
+
+#include "csv.h"                             // The CSV parser
+#include "Batch.hpp"                         // The class definition
+
+// A scenario is solved by a solver named by the scenario number to ensure
+// that the consumer actors of concurrent scenarios have unique names.
+
+void Dominoes::Batch::Solve( std::size_t ScenarioIndex )
+{
+  const auto Started = Anytime::Clock::now();
+  const Scenario & TheScenario( Scenarios[ ScenarioIndex ] );
+
+  // The solver is created by a function that is called directly unless the
+  // result cache is enabled, in which case it is only called if the scenario
+  // is not cached, and then it starts from the start times of a nearby
+  // scenario if there is one.
+
+  auto SolveScenario = [&](
+       const std::optional< std::vector< CoSSMic::Time > > & NearbyStart ){
+    Solver ScenarioSolver( TheScenario.ProductionFile, TheScenario.ConsumersFile,
+                           EvaluationEngine, KernelStep,
+                           "Scenario" + std::to_string( ScenarioIndex ) );
+
+    ScenarioSolver.MultiStart( NumberOfStarts, NumberOfThreads, SearchBudget );
+    ScenarioSolver.GridEnergyInterpolation( GridInterpolation );
+    ScenarioSolver.Decomposition( Decompose );
+    ScenarioSolver.WarmStart( GreedyStart );
+    ScenarioSolver.RacingPortfolio( Racing );
+    ScenarioSolver.GradientBased( Gradient );
+    ScenarioSolver.MultiResolution( Resolutions );
+    ScenarioSolver.Screening( ScreeningFactor );
+    ScenarioSolver.Instrument( Metrics );
+
+    if ( NearbyStart )
+      ScenarioSolver.StartFrom( *NearbyStart );
+
+    if ( Deadline > std::chrono::milliseconds::zero() )
+      ScenarioSolver.SolutionDeadline( Started + Deadline );
+
+    std::ostringstream Result;
+
+    ScenarioSolver.AssignStartTimes( Result, SolarDay );
+
+    if ( Metrics )
+    {
+      std::ofstream Report( Instrumentation::ReportFile(
+                            TheScenario.ResultFile ) );
+
+      ScenarioSolver.WriteMetrics( Report );
+    }
+
+    return Result.str();
+  };
+
+  if ( Cache.IsEnabled() )
+    std::ofstream( TheScenario.ResultFile ) << Cache.Solve(
+      ResultCache::ScenarioKey( TheScenario.ProductionFile,
+                                TheScenario.ConsumersFile, KernelStep,
+                                GridInterpolation, SolarDay ),
+      SolveScenario ).first;
+  else
+    std::ofstream( TheScenario.ResultFile ) << SolveScenario( std::nullopt );
+}
+
+// Running the batch starts the workers that take the next scenario until
+// there are no more scenarios. Errors are reported with the manifest line of
+// the failing scenario.
+
+std::size_t Dominoes::Batch::Run( void )
+{
+  std::atomic< std::size_t > NextScenario( 0 ), Failures( 0 );
+  std::mutex                 ErrorOutput;
+
+  auto Worker = [&](void){
+    for ( std::size_t Index = NextScenario++; Index < Scenarios.size();
+          Index = NextScenario++ )
+      try
+      {
+        Solve( Index );
+      }
+      catch ( std::exception & Error )
+      {
+        std::lock_guard< std::mutex > Lock( ErrorOutput );
+
+        std::cerr << "Scenario " << Index + 1 << " with production "
+                  << Scenarios[ Index ].ProductionFile << " and consumers "
+                  << Scenarios[ Index ].ConsumersFile << " failed: "
+                  << Error.what() << std::endl;
+
+        Failures++;
+      }
+  };
+
+  unsigned int Workers = NumberOfWorkers;
+
+  if ( Workers == 0 )
+    Workers = std::max( 1U, std::thread::hardware_concurrency() );
+
+  Workers = static_cast< unsigned int >(
+            std::min< std::size_t >( Workers, std::max< std::size_t >( 1,
+                                              Scenarios.size() ) ) );
+
+  std::vector< std::thread > Pool;
+
+  for ( unsigned int i = 0; i < Workers; i++ )
+    Pool.emplace_back( Worker );
+
+  for ( std::thread & TheWorker : Pool )
+    TheWorker.join();
+
+  return Failures;
+}
+
+// The constructor parses the manifest and stores the scenarios
+
+Dominoes::Batch::Batch( const std::filesystem::path & Manifest,
+                        CommandLineOptions & Options )
+: Scenarios(),
+  EvaluationEngine( Options.EvaluationEngine() ),
+  KernelStep( Options.ProfileStep() ),
+  NumberOfStarts( Options.NumberOfStarts() ),
+  NumberOfThreads( Options.NumberOfThreads() ),
+  NumberOfWorkers( Options.NumberOfWorkers() ),
+  ScreeningFactor( Options.Screening() ),
+  SearchBudget( Options.SearchBudget() ),
+  Deadline( Options.SolutionDeadline() ),
+  Decompose( Options.Decomposition() ), GreedyStart( Options.WarmStart() ),
+  Racing( Options.RacingPortfolio() ), Gradient( Options.GradientBased() ),
+  Metrics( Options.MetricsReport() ),
+  Resolutions( Options.MultiResolution() ),
+  GridInterpolation( Options.GridEnergyInterpolation() ),
+  SolarDay( Options.DayDuration() ),
+  Cache( Options.CacheEntries(), Options.CacheDirectory() )
+{
+  if ( !std::filesystem::exists( Manifest ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The batch manifest " << Manifest << " does not exist";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  io::CSVReader<3, io::trim_chars<' ','\t'>, io::no_quote_escape<';'> >
+  CSVParser( Manifest.string() );
+
+  CSVParser.set_header( "Production", "Consumers", "Result" );
+
+  std::string ProductionFile, ConsumersFile, ResultFile;
+
+  while ( CSVParser.read_row( ProductionFile, ConsumersFile, ResultFile ) )
+    Scenarios.push_back( Scenario{ ProductionFile, ConsumersFile,
+                                   ResultFile } );
+}
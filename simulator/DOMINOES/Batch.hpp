@@ -0,0 +1,113 @@
+/*==============================================================================
+Batch
+
+Parameter sweeps consist of many scenarios, each being a production file and
+a consumer events file, and solving them by starting the simulator once for
+each scenario means that the process start-up, the creation of the actors and
+the reading of the consumer profiles is repeated for every scenario.
+
+The batch mode reads a manifest where each line defines one scenario by
+three file names separated by semicolons:
+
+<production CSV>;<consumer events CSV>;<assigned start times CSV>
+
+The scenarios are solved in the same process by a pool of worker threads. Each
+worker takes the next scenario from the manifest, solves it, and writes the
+assigned start times to the result file of the scenario as soon as the
+solution is found before taking the next scenario. The consumer profiles are
+shared across all scenarios through the profile cache, so a profile is only
+parsed once for the whole batch. All file names are relative to the working
+directory unless they are absolute paths.
+
+If the result cache is enabled on the command line, a scenario identical to
+one already solved, in this batch or earlier if the cache directory is used,
+is not solved again but its result file is written from the cache. The
+workers share the cache.
+
+A scenario that fails does not stop the batch. The error is reported on the
+standard error stream, and the number of failed scenarios is returned when all
+scenarios have been tried.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_BATCH
+#define DOMINOES_BATCH
+
+#include <string>                            // Standard strings
+#include <vector>                            // Standard vectors
+#include <filesystem>                        // File names
+#include <chrono>                            // Time budget
+
+#include "TimeInterval.hpp"                  // CoSSMic Time
+#include "Interpolation.hpp"                 // Grid energy interpolation
+#include "Solver.hpp"                        // The Dominoes solver
+#include "CommandOptions.hpp"                // The solver parameters
+#include "ResultCache.hpp"                   // Results of solved scenarios
+
+namespace Dominoes {
+
+class Batch
+{
+private:
+
+  // The scenarios are read from the manifest by the constructor
+
+  class Scenario
+  {
+  public:
+
+    std::filesystem::path ProductionFile, ConsumersFile, ResultFile;
+  };
+
+  std::vector< Scenario > Scenarios;
+
+  // The parameters for the solvers are taken from the command line options,
+  // and so is the number of workers and the solar day. The deadline is counted
+  // from the start of each scenario.
+
+  const Solver::Evaluation        EvaluationEngine;
+  const CoSSMic::Time             KernelStep;
+  const unsigned int              NumberOfStarts, NumberOfThreads,
+                                  NumberOfWorkers, ScreeningFactor;
+  const std::chrono::seconds      SearchBudget;
+  const std::chrono::milliseconds Deadline;
+  const bool                      Decompose, GreedyStart, Racing, Gradient,
+                                  Metrics;
+  const std::vector< CoSSMic::Time > Resolutions;
+  const Interpolation::Type       GridInterpolation;
+  const CoSSMic::TimeInterval     SolarDay;
+
+  // The results of the scenarios are cached if this is enabled
+
+  ResultCache Cache;
+
+  // Solving one scenario creates the solver for the scenario with a name
+  // unique for the scenario in this batch.
+
+  void Solve( std::size_t ScenarioIndex );
+
+public:
+
+  // The number of scenarios is available
+
+  inline std::size_t size( void ) const
+  { return Scenarios.size(); }
+
+  // Running the batch returns the number of scenarios that failed
+
+  std::size_t Run( void );
+
+  // The constructor reads the manifest file and takes the parameters for the
+  // solvers from the command line options. An invalid argument exception is
+  // thrown if the manifest file does not exist.
+
+  Batch( const std::filesystem::path & Manifest, CommandLineOptions & Options );
+
+  Batch( void ) = delete;
+  Batch( const Batch & Other ) = delete;
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_BATCH
@@ -0,0 +1,208 @@
+/*==============================================================================
+Batch Evaluation
+
+This implements the evaluation of the groups of candidates and the threads
+sharing the groups.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <algorithm>                         // Filling buffers
+#include <thread>                            // The evaluation threads
+#include <atomic>                            // The next group
+#include <exception>                         // Passing thread exceptions
+#include <sstream>                           // For nicely formatted errors
+#include <stdexcept>                         // Standard exceptions
+
+#include "BatchEvaluation.hpp"               // The class definition
+
+// The buffers of a thread hold the matrices for one group and a grid cost
+// object for the interpolated integral.
+
+Dominoes::BatchEvaluation::Buffers::Buffers( const BatchEvaluation & Evaluation )
+: Consumption( Evaluation.ProductionSamples->size() * Lanes, 0.0 ),
+  Energy( Evaluation.ProductionSamples->size() * Lanes, 0.0 ),
+  Lane( Evaluation.ProductionSamples->size(), 0.0 ),
+  Cost( Evaluation.ProductionSamples, Evaluation.IntervalProduction,
+        Evaluation.GridInterpolation )
+{}
+
+// The consumption of the lanes of the group is added to the cleared matrix,
+// and unused lanes of the last group are left with zero consumption. The
+// grid energy is then computed for all lanes, and the integral is either the
+// sum of the trapezoids for all lanes together, or the interpolated integral
+// of each lane. The first and the last interval of the linear integral are
+// computed as by the grid cost.
+
+void Dominoes::BatchEvaluation::EvaluateGroup(
+     const Optimization::Population & Candidates, std::size_t First,
+     Buffers & ThreadBuffers, std::vector< double > & Values ) const
+{
+  const std::size_t Samples = ProductionSamples->size(),
+                    Used    = std::min( Lanes, Candidates.size() - First );
+
+  std::fill( ThreadBuffers.Consumption.begin(),
+             ThreadBuffers.Consumption.end(), 0.0 );
+
+  for ( std::size_t Lane = 0; Lane < Used; Lane++ )
+    Profiles.AddConsumption( Candidates[ First + Lane ],
+                             ThreadBuffers.Consumption.data(), Lanes, Lane );
+
+  if ( GridInterpolation != Interpolation::Type::Linear )
+  {
+    for ( std::size_t Lane = 0; Lane < Used; Lane++ )
+    {
+      for ( std::size_t i = 0; i < Samples; i++ )
+        ThreadBuffers.Lane[i] = ThreadBuffers.Consumption[ i * Lanes + Lane ];
+
+      Values[ First + Lane ] = ThreadBuffers.Cost( ThreadBuffers.Lane );
+    }
+
+    return;
+  }
+
+  const double * Production  = IntervalProduction.data();
+  const double * Consumption = ThreadBuffers.Consumption.data();
+  double *       Energy      = ThreadBuffers.Energy.data();
+
+  for ( std::size_t i = 0; i < Samples; i++ )
+    for ( std::size_t Lane = 0; Lane < Lanes; Lane++ )
+    {
+      const double Consumed = Consumption[ i * Lanes + Lane ];
+
+      Energy[ i * Lanes + Lane ] = ( Production[i] >= Consumed ) ?
+                                   0.0 : Consumed - Production[i];
+    }
+
+  const std::size_t Intervals = SampleInterval.size();
+  const double *    Length    = SampleInterval.data();
+  double            Area[ Lanes ] = { 0.0 };
+
+  for ( std::size_t i = 0; i < Intervals; i++ )
+    if ( Length[i] != 0.0 )
+    {
+      const double * Left  = Energy + i * Lanes,
+                   * Right = Energy + ( i + 1 ) * Lanes;
+
+      if ( ( i == 0 ) || ( i == Intervals - 1 ) )
+        for ( std::size_t Lane = 0; Lane < Lanes; Lane++ )
+        {
+          const double Slope = ( Right[ Lane ] - Left[ Lane ] ) / Length[i];
+
+          Area[ Lane ] += Length[i] *
+                          ( Left[ Lane ] + 0.5 * Slope * ( Length[i] + 0.0 ) );
+        }
+      else
+        for ( std::size_t Lane = 0; Lane < Lanes; Lane++ )
+          Area[ Lane ] += 0.5 * Length[i] * ( Left[ Lane ] + Right[ Lane ] );
+    }
+
+  for ( std::size_t Lane = 0; Lane < Used; Lane++ )
+    Values[ First + Lane ] = Area[ Lane ];
+}
+
+// The groups are taken by the threads from a shared counter. A single group
+// is evaluated by the calling thread, and an exception from any thread is
+// passed on after all threads have completed.
+
+std::vector< double > Dominoes::BatchEvaluation::operator() (
+                      const Optimization::Population & Candidates ) const
+{
+  for ( const Optimization::Variables & Candidate : Candidates )
+    if ( Candidate.size() != Profiles.size() )
+    {
+      std::ostringstream ErrorMessage;
+
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "A candidate has " << Candidate.size()
+                   << " start times for " << Profiles.size() << " consumers";
+
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+
+  std::vector< double > Values( Candidates.size(), 0.0 );
+
+  const std::size_t Groups = ( Candidates.size() + Lanes - 1 ) / Lanes;
+
+  unsigned int Threads = NumberOfThreads;
+
+  if ( Threads == 0 )
+    Threads = std::max( 1U, std::thread::hardware_concurrency() );
+
+  Threads = static_cast< unsigned int >(
+            std::min< std::size_t >( Threads, Groups ) );
+
+  if ( Threads <= 1 )
+  {
+    Buffers ThreadBuffers( *this );
+
+    for ( std::size_t Group = 0; Group < Groups; Group++ )
+      EvaluateGroup( Candidates, Group * Lanes, ThreadBuffers, Values );
+
+    return Values;
+  }
+
+  std::atomic< std::size_t >        NextGroup(0);
+  std::vector< std::exception_ptr > Errors( Threads );
+
+  auto Worker = [&]( unsigned int Thread ){
+    try
+    {
+      Buffers ThreadBuffers( *this );
+
+      for ( std::size_t Group = NextGroup++; Group < Groups;
+            Group = NextGroup++ )
+        EvaluateGroup( Candidates, Group * Lanes, ThreadBuffers, Values );
+    }
+    catch (...)
+    {
+      Errors[ Thread ] = std::current_exception();
+    }
+  };
+
+  std::vector< std::thread > Workers;
+
+  for ( unsigned int Thread = 0; Thread < Threads; Thread++ )
+    Workers.emplace_back( Worker, Thread );
+
+  for ( std::thread & TheWorker : Workers )
+    TheWorker.join();
+
+  for ( std::exception_ptr & Error : Errors )
+    if ( Error ) std::rethrow_exception( Error );
+
+  return Values;
+}
+
+// The constructor checks that there are enough samples for the integral of
+// the grid energy and computes the lengths of the sample intervals.
+
+Dominoes::BatchEvaluation::BatchEvaluation(
+  const ConsumptionBlock & ConsumerProfiles, const SampleTime & ProductionTimes,
+  const std::vector< double > & Production,
+  Interpolation::Type InterpolationType, unsigned int Threads )
+: Profiles( ConsumerProfiles ), ProductionSamples( ProductionTimes ),
+  IntervalProduction( Production ), GridInterpolation( InterpolationType ),
+  NumberOfThreads( Threads ), SampleInterval()
+{
+  const std::size_t Samples = ProductionSamples->size();
+
+  if ( ( Samples != IntervalProduction.size() ) || ( Samples < 2 ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The batch evaluation needs at least two samples and "
+                 << "there are " << Samples << " sample times and "
+                 << IntervalProduction.size() << " production values";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  SampleInterval.resize( Samples - 1 );
+
+  for ( std::size_t i = 0; i < Samples - 1; i++ )
+    SampleInterval[i] = static_cast< double >( (*ProductionSamples)[i+1] ) -
+                        static_cast< double >( (*ProductionSamples)[i]   );
+}
@@ -0,0 +1,115 @@
+/*==============================================================================
+Batch Evaluation
+
+The objective function is normally evaluated for one vector of start times at
+a time as requested by the optimisation algorithm. When many candidate start
+time vectors are known at the same time, for instance when screening random
+initial start times for the searches, the candidates can be evaluated together
+in a way that uses the processor better.
+
+The candidates are processed in groups of a fixed number of lanes. The total
+consumption of a group is kept in a sample major matrix where the consumption
+of all the lanes at one production sample are adjacent, so the computation of
+the grid energy and its linear integral for all candidates of the group is a
+loop over the samples with a short inner loop over the lanes, which the
+compiler can vectorise since the production of the sample is the same for all
+lanes. The groups are shared among a number of threads, and each thread has
+its own buffers.
+
+The linear integral is computed by the same arithmetic operations in the same
+order as the grid cost object, so the values are identical to the values
+obtained by evaluating each candidate alone. If the grid energy is
+interpolated by Steffen's method, each lane is integrated by a grid cost
+object since the GSL interpolation cannot be vectorised, but the consumption
+is still computed for the group and the groups are still evaluated in
+parallel.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_BATCH_EVALUATION
+#define DOMINOES_BATCH_EVALUATION
+
+#include <vector>                            // Standard vectors
+#include <cstddef>                           // Lane counts
+
+#include "Variables.hpp"                     // Optimization variables
+
+#include "Interpolation.hpp"                 // Grid energy interpolation
+
+#include "Typedefs.hpp"                      // Dominoes types
+#include "ConsumptionBlock.hpp"              // The consumption kernels
+#include "GridCost.hpp"                      // Interpolated grid energy
+
+namespace Dominoes {
+
+class BatchEvaluation
+{
+public:
+
+  // The number of candidates evaluated together by one thread
+
+  static constexpr std::size_t Lanes = 8;
+
+private:
+
+  // The shared and read-only data of the problem
+
+  const ConsumptionBlock &      Profiles;
+  const SampleTime              ProductionSamples;
+  const std::vector< double > & IntervalProduction;
+  const Interpolation::Type     GridInterpolation;
+  const unsigned int            NumberOfThreads;
+
+  // The lengths of the sample intervals for the linear integral are computed
+  // by the constructor.
+
+  std::vector< double > SampleInterval;
+
+  // The buffers of one thread
+
+  class Buffers
+  {
+  public:
+
+    std::vector< double > Consumption, Energy, Lane;
+    GridCost              Cost;
+
+    Buffers( const BatchEvaluation & Evaluation );
+  };
+
+  // A group of at most the number of lanes candidates starting from the
+  // given candidate is evaluated and the values are stored in the values of
+  // the candidates.
+
+  void EvaluateGroup( const Optimization::Population & Candidates,
+                      std::size_t First, Buffers & ThreadBuffers,
+                      std::vector< double > & Values ) const;
+
+public:
+
+  // The objective values are returned in the order of the candidates. An
+  // invalid argument exception is thrown if a candidate does not have one
+  // start time for each consumer.
+
+  std::vector< double >
+  operator() ( const Optimization::Population & Candidates ) const;
+
+  // The constructor takes the consumption block, the production sample times
+  // and the production in each sample interval, which must be owned by the
+  // caller and not change while the batch evaluation exists. The number of
+  // threads is the number of hardware threads if it is zero.
+
+  BatchEvaluation( const ConsumptionBlock & ConsumerProfiles,
+                   const SampleTime & ProductionTimes,
+                   const std::vector< double > & Production,
+                   Interpolation::Type InterpolationType,
+                   unsigned int Threads = 0 );
+
+  BatchEvaluation( void ) = delete;
+  BatchEvaluation( const BatchEvaluation & Other ) = delete;
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_BATCH_EVALUATION
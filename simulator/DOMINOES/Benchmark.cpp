@@ -0,0 +1,502 @@
+/*==============================================================================
+Benchmark
+
+The benchmark measures how the solver scales with the number of consumers. For
+each requested number of consumers it generates a synthetic scenario from the
+same data used by the web service: The production is one of the measured PV
+profiles of the given category in the pv_categories directory scaled by the
+installed capacity per consumer, and each consumer is a randomly selected
+profile of a randomly selected washing machine or dishwasher cluster in the
+wm_clusters and dw_clusters directories. The earliest start time of a consumer
+is drawn uniformly over the day time, and its start window is drawn uniformly
+up to the given maximal width.
+
+The scenario files are written to a scratch directory in exactly the formats
+produced by the web service, and the solver is then created and asked to
+assign the start times. For each scenario one line is written to the standard
+output with the number of consumers, the time used to construct the solver,
+the time used to assign the start times, the number of evaluations of the
+objective function and the evaluations per second of the assignment, the peak
+resident set size of the process so far, and the total grid energy of the
+solution. Since the peak resident set size never decreases, the sizes should
+be given in increasing order.
+
+The following options are supported in addition to the solver options of the
+simulator (evaluation engine, kernel step, starts, threads, budget, deadline,
+decomposition, and grid energy interpolation) that have the same meaning as
+for the simulator:
+
+-n [ --Consumers <n...> ]    = Scenario sizes. Default: 10 100 1000 10000
+-d [ --Data <directory> ]    = The data directory. Default: ../../data
+-o [ --Scratch <directory> ] = Scenario files. Default: system temp directory
+-P [ --PV <category> ]       = PV category file. Default: summer_sunny
+-C [ --Capacity <kW> ]       = Installed PV capacity per consumer. Default: 0.5
+-W [ --Window <hours> ]      = Maximal start window. Default: 4
+-r [ --Seed <n> ]            = Seed for the scenario generator. Default: 1
+
+Note that the BOBYQA algorithm uses memory quadratic in the number of
+variables, and the largest scenarios will normally require the decomposition
+into independent subproblems or the in-process evaluation to be practical. The
+actor evaluation creates one thread per consumer.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <string>                            // Standard strings
+#include <vector>                            // Standard vectors
+#include <sstream>                           // Formatted errors and results
+#include <stdexcept>                         // Standard exceptions
+#include <iostream>                          // Writing the results
+#include <iomanip>                           // Formatting the results
+#include <fstream>                           // Writing the scenario files
+#include <filesystem>                        // Scratch directory
+#include <random>                            // Scenario generator
+#include <chrono>                            // Wall clock timing
+#include <algorithm>                         // Min and max
+#include <cstdlib>                           // Exit status
+
+#include <sys/resource.h>                    // Peak resident set size
+
+#include <boost/program_options.hpp>         // Command line parsing
+#include <boost/property_tree/ptree.hpp>     // JSON data files
+#include <boost/property_tree/json_parser.hpp>
+
+#include "TimeInterval.hpp"                  // CoSSMic time
+#include "Interpolation.hpp"                 // Grid energy interpolation
+#include "Solver.hpp"                        // The Dominoes solver
+
+namespace cmd = boost::program_options;
+namespace pt  = boost::property_tree;
+
+namespace Dominoes
+{
+/*==============================================================================
+
+ Scenario generator
+
+==============================================================================*/
+//
+// The generator reads the data files when it is constructed, and generates
+// scenarios of a given size in a given directory.
+
+class ScenarioGenerator
+{
+private:
+
+  // The production profile is the relative production per sample of the PV
+  // data starting at the given time
+
+  CoSSMic::Time         ProductionStart, SamplePeriod;
+  std::vector< double > ProductionProfile;
+
+  // The consumption profiles are cumulative energies per sample of the given
+  // period in seconds
+
+  struct ConsumptionProfile
+  {
+    CoSSMic::Time         SamplePeriod;
+    std::vector< double > Energy;
+  };
+
+  std::vector< ConsumptionProfile > Profiles;
+
+  // The scenario parameters and the random generator
+
+  const double        CapacityPerConsumer;
+  const CoSSMic::Time MaximalWindow;
+  std::mt19937_64     Generator;
+
+  // Reading a JSON file throws an invalid argument exception if the file
+  // could not be read.
+
+  static pt::ptree ReadJSON( const std::filesystem::path & FileName );
+
+  // Reading all the cluster files of a directory except the program mapping
+
+  void ReadClusters( const std::filesystem::path & Directory );
+
+  // The solar day of the last generated scenario is the time from the first
+  // to the last sample with production
+
+  CoSSMic::TimeInterval SolarDay;
+
+public:
+
+  inline CoSSMic::TimeInterval GetSolarDay( void ) const
+  { return SolarDay; }
+
+  // Generating a scenario writes the producer file, the consumer event file
+  // and the consumer files to the given directory.
+
+  void Generate( unsigned int NumberOfConsumers,
+                 const std::filesystem::path & Directory );
+
+  ScenarioGenerator( const std::filesystem::path & DataDirectory,
+                     const std::string & PVCategory, double Capacity,
+                     CoSSMic::Time Window, std::mt19937_64::result_type Seed );
+};
+
+// Reading the JSON file is done by the Boost property tree parser.
+
+pt::ptree ScenarioGenerator::ReadJSON( const std::filesystem::path & FileName )
+{
+  pt::ptree Content;
+
+  try
+  {
+    pt::read_json( FileName.string(), Content );
+  }
+  catch ( pt::json_parser_error & Error )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "Could not read the data file " << FileName << ": "
+                 << Error.what();
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  return Content;
+}
+
+// A cluster file has the sample period in minutes and an array of profiles
+// where each profile is an array of cumulative energy values. The files are
+// read in sorted order so that a given seed gives the same scenarios.
+
+void ScenarioGenerator::ReadClusters( const std::filesystem::path & Directory )
+{
+  std::vector< std::filesystem::path > ClusterFiles;
+
+  for ( const auto & Entry : std::filesystem::directory_iterator( Directory ) )
+    if ( ( Entry.path().extension() == ".json" ) &&
+         ( Entry.path().filename() != "programMapping.json" ) )
+      ClusterFiles.push_back( Entry.path() );
+
+  std::sort( ClusterFiles.begin(), ClusterFiles.end() );
+
+  for ( const std::filesystem::path & ClusterFile : ClusterFiles )
+  {
+    pt::ptree Cluster( ReadJSON( ClusterFile ) );
+    CoSSMic::Time Period = 60 * Cluster.get< CoSSMic::Time >( "minuteRes" );
+
+    for ( const auto & Profile : Cluster.get_child( "data" ) )
+    {
+      ConsumptionProfile TheProfile{ Period, {} };
+
+      for ( const auto & Value : Profile.second )
+        TheProfile.Energy.push_back( Value.second.get_value< double >() );
+
+      if ( TheProfile.Energy.size() > 1 )
+        Profiles.push_back( TheProfile );
+    }
+  }
+}
+
+// Generating the scenario first writes the cumulative production, and then
+// the consumers with their start windows inside the day.
+
+void ScenarioGenerator::Generate( unsigned int NumberOfConsumers,
+                                  const std::filesystem::path & Directory )
+{
+  std::filesystem::create_directories( Directory );
+
+  // The production is scaled by the total installed capacity, and the energy
+  // of one sample is the relative production times the capacity times the
+  // sample period in hours.
+
+  const double SampleEnergy = CapacityPerConsumer * NumberOfConsumers *
+                              static_cast< double >( SamplePeriod ) / 3600.0;
+
+  std::ofstream Production( Directory / "producer.csv" );
+  double        CumulativeEnergy = 0.0;
+  CoSSMic::Time FirstProduction  = ProductionStart,
+                LastProduction   = ProductionStart;
+
+  for ( std::size_t i = 0; i < ProductionProfile.size(); i++ )
+  {
+    CoSSMic::Time SampleTime = ProductionStart +
+                               static_cast< CoSSMic::Time >( i ) * SamplePeriod;
+
+    if ( ProductionProfile[i] > 0.0 )
+    {
+      if ( CumulativeEnergy == 0.0 ) FirstProduction = SampleTime;
+      LastProduction = SampleTime;
+    }
+
+    CumulativeEnergy += ProductionProfile[i] * SampleEnergy;
+    Production << SampleTime << " " << CumulativeEnergy << "\n";
+  }
+
+  SolarDay.assign( FirstProduction, LastProduction );
+
+  // The consumers start during the day from six in the morning to six in the
+  // evening, and they must complete before the end of the production series.
+
+  const CoSSMic::Time DayEnd = ProductionStart + SamplePeriod *
+                       static_cast< CoSSMic::Time >( ProductionProfile.size() );
+
+  std::uniform_int_distribution< std::size_t >
+    SelectProfile( 0, Profiles.size() - 1 );
+  std::uniform_int_distribution< CoSSMic::Time >
+    EarliestStart( ProductionStart + 6 * 3600, ProductionStart + 18 * 3600 ),
+    Window( 0, MaximalWindow );
+
+  std::ofstream Events( Directory / "consumers.csv" );
+
+  for ( unsigned int Consumer = 0; Consumer < NumberOfConsumers; Consumer++ )
+  {
+    const ConsumptionProfile & Profile( Profiles[ SelectProfile( Generator ) ] );
+    const CoSSMic::Time Duration = Profile.SamplePeriod *
+                       static_cast< CoSSMic::Time >( Profile.Energy.size() - 1 );
+
+    CoSSMic::Time Earliest = std::min( EarliestStart( Generator ),
+                                       DayEnd - Duration ),
+                  Latest   = std::min( Earliest + Window( Generator ),
+                                       DayEnd - Duration );
+
+    std::filesystem::path ProfileFile( Directory /
+                          ( "consumer_" + std::to_string( Consumer ) + ".csv" ) );
+    std::ofstream         Load( ProfileFile );
+
+    for ( std::size_t i = 0; i < Profile.Energy.size(); i++ )
+      Load << static_cast< CoSSMic::Time >( i ) * Profile.SamplePeriod << " "
+           << Profile.Energy[i] << "\n";
+
+    Events << "C" << Consumer << ";" << Earliest << ";" << Latest << ";"
+           << std::filesystem::absolute( ProfileFile ).string() << "\n";
+  }
+}
+
+// The constructor reads the first PV profile of the category and all the
+// consumption profiles.
+
+ScenarioGenerator::ScenarioGenerator(
+  const std::filesystem::path & DataDirectory, const std::string & PVCategory,
+  double Capacity, CoSSMic::Time Window, std::mt19937_64::result_type Seed )
+: ProductionStart(0), SamplePeriod(0), ProductionProfile(), Profiles(),
+  CapacityPerConsumer( Capacity ), MaximalWindow( Window ),
+  Generator( Seed ), SolarDay()
+{
+  pt::ptree PV( ReadJSON( DataDirectory / "pv_categories" /
+                          ( PVCategory + ".json" ) ) );
+  const pt::ptree & Measurement( PV.get_child( "data" ).front().second );
+
+  ProductionStart = Measurement.get< CoSSMic::Time >( "unixStartUTC" );
+  SamplePeriod    = 60 * Measurement.get< CoSSMic::Time >( "minuteRes" );
+
+  for ( const auto & Value : Measurement.get_child( "profile" ) )
+    ProductionProfile.push_back( Value.second.get_value< double >() );
+
+  ReadClusters( DataDirectory / "wm_clusters" );
+  ReadClusters( DataDirectory / "dw_clusters" );
+
+  if ( ProductionProfile.empty() || Profiles.empty() )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "No production or consumption profiles found in "
+                 << DataDirectory;
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+}
+
+}      // End name space Dominoes
+
+/*==============================================================================
+
+ Main
+
+==============================================================================*/
+//
+// The peak resident set size is reported by the kernel in kilobytes on Linux
+
+static double PeakMemory( void )
+{
+  rusage Usage;
+
+  getrusage( RUSAGE_SELF, &Usage );
+
+  return static_cast< double >( Usage.ru_maxrss ) / 1024.0;
+}
+
+int main( int argc, char **argv )
+{
+  using Clock = std::chrono::steady_clock;
+
+  cmd::options_description Description("Allowed options");
+  cmd::variables_map Values;
+
+  Description.add_options()
+    ( "help,h",  "Produce this help message" )
+    ( "Consumers,n", cmd::value< std::vector< unsigned int > >()->multitoken()
+                     ->default_value( std::vector< unsigned int >{
+                                      10, 100, 1000, 10000 }, "10 100 1000 10000" ),
+                 "Numbers of consumers of the scenarios" )
+    ( "Data,d", cmd::value< std::string >()->default_value("../../data"),
+                 "Directory with the PV and the cluster data" )
+    ( "Scratch,o", cmd::value< std::string >(),
+                 "Directory for the scenario files" )
+    ( "PV,P", cmd::value< std::string >()->default_value("summer_sunny"),
+                 "PV category" )
+    ( "Capacity,C", cmd::value< double >()->default_value(0.5),
+                 "Installed PV capacity in kW per consumer" )
+    ( "Window,W", cmd::value< double >()->default_value(4.0),
+                 "Maximal start window in hours" )
+    ( "Seed,r", cmd::value< std::mt19937_64::result_type >()->default_value(1),
+                 "Seed for the scenario generator" )
+    ( "Evaluation,e", cmd::value< std::string >()->default_value("InProcess"),
+                 "Evaluation engine: Actors or InProcess" )
+    ( "KernelStep,k", cmd::value< CoSSMic::Time >()->default_value(1),
+                 "Step in seconds of the consumption profile tables" )
+    ( "Starts,m", cmd::value< unsigned int >()->default_value(1),
+                 "Number of independent searches" )
+    ( "Threads,t", cmd::value< unsigned int >()->default_value(0),
+                 "Number of threads for the searches" )
+    ( "Budget,b", cmd::value< std::chrono::seconds::rep >()->default_value(0),
+                 "Wall-clock budget in seconds for the searches" )
+    ( "Deadline,T", cmd::value< std::chrono::milliseconds::rep >()
+                    ->default_value(0),
+                 "Wall-clock deadline in milliseconds for the start times" )
+    ( "Decompose,x", "Solve independent consumers as separate problems" )
+    ( "WarmStart,G", "Start the search from a greedy placement" )
+    ( "Race,A", "Race a portfolio of algorithms for the start times" )
+    ( "Gradient,L", "Search with the gradient of the grid energy" )
+    ( "Screening,S", cmd::value< unsigned int >()->default_value(1),
+                 "Random candidates evaluated for each start" )
+    ( "GridEnergy,g", cmd::value< std::string >()->default_value("Steffen"),
+                 "Grid energy interpolation: Linear or Steffen" );
+
+  try
+  {
+    cmd::store( cmd::parse_command_line( argc, argv, Description ), Values );
+
+    if ( Values.count("help") > 0 )
+    {
+      std::cout << Description << std::endl;
+      return EXIT_SUCCESS;
+    }
+
+    cmd::notify( Values );
+  }
+  catch ( std::exception & Error )
+  {
+    std::cout << Error.what() << std::endl << Description << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // The solver parameters
+
+  Dominoes::Solver::Evaluation Engine;
+
+  if ( Values["Evaluation"].as< std::string >() == "Actors" )
+    Engine = Dominoes::Solver::Evaluation::Actors;
+  else if ( Values["Evaluation"].as< std::string >() == "InProcess" )
+    Engine = Dominoes::Solver::Evaluation::InProcess;
+  else
+  {
+    std::cout << "The evaluation engine must be Actors or InProcess"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Interpolation::Type GridInterpolation;
+
+  if ( Values["GridEnergy"].as< std::string >() == "Linear" )
+    GridInterpolation = Interpolation::Type::Linear;
+  else if ( Values["GridEnergy"].as< std::string >() == "Steffen" )
+    GridInterpolation = Interpolation::Type::SteffenMethod;
+  else
+  {
+    std::cout << "The grid energy interpolation must be Linear or Steffen"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::chrono::milliseconds Deadline(
+        Values["Deadline"].as< std::chrono::milliseconds::rep >() );
+
+  std::filesystem::path Scratch( Values.count("Scratch") > 0
+    ? std::filesystem::path( Values["Scratch"].as< std::string >() )
+    : std::filesystem::temp_directory_path() / "DominoesBenchmark" );
+
+  Dominoes::ScenarioGenerator Scenarios(
+    Values["Data"].as< std::string >(), Values["PV"].as< std::string >(),
+    Values["Capacity"].as< double >(),
+    static_cast< CoSSMic::Time >( 3600.0 * Values["Window"].as< double >() ),
+    Values["Seed"].as< std::mt19937_64::result_type >() );
+
+  // The scenarios are then solved one by one.
+
+  std::cout << std::setw(10) << "Consumers"   << std::setw(14) << "Setup [s]"
+            << std::setw(14) << "Solve [s]"   << std::setw(14) << "Evaluations"
+            << std::setw(14) << "Eval/s"      << std::setw(14) << "Peak [MB]"
+            << std::setw(16) << "Grid energy" << std::endl;
+
+  for ( unsigned int NumberOfConsumers :
+        Values["Consumers"].as< std::vector< unsigned int > >() )
+  {
+    const std::filesystem::path Directory( Scratch /
+                                std::to_string( NumberOfConsumers ) );
+
+    Scenarios.Generate( NumberOfConsumers, Directory );
+
+    Clock::time_point SetupStart = Clock::now();
+
+    Dominoes::Solver Solver( Directory / "producer.csv",
+                             Directory / "consumers.csv", Engine,
+                             Values["KernelStep"].as< CoSSMic::Time >(),
+                             "Benchmark" + std::to_string( NumberOfConsumers ) );
+
+    Solver.MultiStart( Values["Starts"].as< unsigned int >(),
+                       Values["Threads"].as< unsigned int >(),
+                       std::chrono::seconds(
+                       Values["Budget"].as< std::chrono::seconds::rep >() ) );
+    Solver.GridEnergyInterpolation( GridInterpolation );
+    Solver.Decomposition( Values.count("Decompose") > 0 );
+    Solver.WarmStart( Values.count("WarmStart") > 0 );
+    Solver.RacingPortfolio( Values.count("Race") > 0 );
+    Solver.GradientBased( Values.count("Gradient") > 0 );
+    Solver.Screening( Values["Screening"].as< unsigned int >() );
+
+    if ( Deadline > std::chrono::milliseconds::zero() )
+      Solver.SolutionDeadline( Deadline );
+
+    Clock::time_point SolveStart = Clock::now();
+    std::size_t SetupEvaluations = Solver.NumberOfEvaluations();
+    std::ostringstream Result;
+
+    Solver.AssignStartTimes( Result, Scenarios.GetSolarDay() );
+
+    Clock::time_point SolveEnd = Clock::now();
+
+    // The grid energy is the last token of the first line of the result
+
+    std::istringstream FirstLine( Result.str().substr( 0,
+                                  Result.str().find('\n') ) );
+    std::string Token, GridEnergy;
+
+    while ( FirstLine >> Token ) GridEnergy = Token;
+
+    const double SetupTime = std::chrono::duration< double >(
+                                     SolveStart - SetupStart ).count(),
+                 SolveTime = std::chrono::duration< double >(
+                                     SolveEnd - SolveStart ).count();
+    const std::size_t Evaluations = Solver.NumberOfEvaluations()
+                                    - SetupEvaluations;
+
+    std::cout << std::setw(10) << NumberOfConsumers
+              << std::setw(14) << std::fixed << std::setprecision(3) << SetupTime
+              << std::setw(14) << SolveTime
+              << std::setw(14) << Evaluations
+              << std::setw(14) << std::setprecision(1)
+              << ( SolveTime > 0.0 ? Evaluations / SolveTime : 0.0 )
+              << std::setw(14) << PeakMemory()
+              << std::setw(16) << GridEnergy << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -21,7 +21,19 @@ namespace cmd = boost::program_options;
 Dominoes::CommandLineOptions::CommandLineOptions( int argc, char **argv )
 : WorkingDirectory( std::filesystem::current_path() ),
   ProducerProfile(),  ConsumerProfiles(),  Results("AST.csv"),
-  Day()
+  Day(), Engine( Solver::Evaluation::Actors ), KernelStep(1),
+  RunDaemon( false ), SocketName(), MaximalQueue(0), BatchManifest(),
+  Workers(0),
+  Starts(1), Threads(0), Budget( std::chrono::seconds::zero() ),
+  Deadline( std::chrono::milliseconds::zero() ), Decompose( false ),
+  GreedyStart( false ), Racing( false ), UseGradient( false ),
+  CoarseResolutions(),
+  ScreeningFactor(1), MemoQuantum(),
+  TraceLocation(), CaptureLocation(),
+  CachedResults(0),
+  CacheLocation(),
+  Metrics( false ), HTTPPort(0), PooledActors( false ), PoolWorkers(0),
+  GridInterpolation( Interpolation::Type::SteffenMethod ), PackLocation()
 {
 	// The options class must have an object describing the options and the
 	// help messages generated
@@ -45,7 +57,56 @@ Dominoes::CommandLineOptions::CommandLineOptions( int argc, char **argv )
     ( "AssignedTimes,a", cmd::value< std::string>(),
                  "Result file name" )
     ( "SunDay,s",  cmd::value< std::vector< CoSSMic::Time > >()->multitoken(),
-                 "Sun day" );
+                 "Sun day" )
+    ( "Evaluation,e", cmd::value< std::string >(),
+                 "Evaluation engine: Actors or InProcess" )
+    ( "KernelStep,k", cmd::value< CoSSMic::Time >(),
+                 "Step in seconds of the consumption profile tables" )
+    ( "Starts,m", cmd::value< unsigned int >(),
+                 "Number of independent searches" )
+    ( "Threads,t", cmd::value< unsigned int >(),
+                 "Number of threads for the searches" )
+    ( "Budget,b", cmd::value< std::chrono::seconds::rep >(),
+                 "Wall-clock budget in seconds for the searches" )
+    ( "Deadline,T", cmd::value< std::chrono::milliseconds::rep >(),
+                 "Wall-clock deadline in milliseconds for the start times" )
+    ( "Decompose,x", "Solve independent consumers as separate problems" )
+    ( "WarmStart,G", "Start the search from a greedy placement" )
+    ( "Race,A", "Race a portfolio of algorithms for the start times" )
+    ( "Gradient,L", "Search with the gradient of the grid energy" )
+    ( "MultiResolution,r",
+                 cmd::value< std::vector< CoSSMic::Time > >()->multitoken(),
+                 "Production resolutions in seconds solved before the samples" )
+    ( "Screening,S", cmd::value< unsigned int >(),
+                 "Random candidates evaluated for each start" )
+    ( "Memoise,Q", cmd::value< double >()->implicit_value(1.0),
+                 "Memoise evaluations with this quantum in seconds" )
+    ( "Trace,y", cmd::value< std::string >(),
+                 "File for the convergence trace of the single search" )
+    ( "Capture,z", cmd::value< std::string >(),
+                 "File for the captured problem of the scenario" )
+    ( "CacheEntries,C", cmd::value< std::size_t >(),
+                 "Number of scenario results cached in memory" )
+    ( "CacheDirectory,R", cmd::value< std::string >(),
+                 "Directory for the cached scenario results" )
+    ( "Metrics,M", "Write the timings and counters as JSON" )
+    ( "HTTPMetrics,H", cmd::value< unsigned short >(),
+                 "Serve the daemon metrics over HTTP on this port" )
+    ( "ActorPool,P", cmd::value< unsigned int >()->implicit_value(0),
+                 "Execute the actors on a pool of worker threads" )
+    ( "GridEnergy,g", cmd::value< std::string >(),
+                 "Grid energy interpolation: Linear or Steffen" )
+    ( "ProfilePack,K", cmd::value< std::string >(),
+                 "Pack of appliance profiles referenced by the consumers" )
+    ( "Batch,B", cmd::value< std::string >(),
+                 "Manifest of scenarios to solve" )
+    ( "Workers,w", cmd::value< unsigned int >(),
+                 "Number of scenarios solved in parallel" )
+    ( "Daemon,D", "Serve scenario requests until QUIT" )
+    ( "Socket,u", cmd::value< std::string >(),
+                 "Unix socket for the daemon requests" )
+    ( "QueueDepth,q", cmd::value< std::size_t >(),
+                 "Daemon requests that may wait for a worker" );
 
 	// Parsing the command line and throwing an exception if the required
 	// options are not given
@@ -83,11 +144,40 @@ Dominoes::CommandLineOptions::CommandLineOptions( int argc, char **argv )
 		}
   }
 
-  // The files for the producer and the consumer profiles must be given so
-  // they are readily stored
+  // The evaluation engine is optional, and if it is given it must be one of
+  // the two known engines.
 
-  ProducerProfile  = Values["ProductionFile"].as< std::string >();
-  ConsumerProfiles = Values["Consumers"].as< std::string >();
+  if ( Values.count("Evaluation") > 0 )
+  {
+    std::string EngineName( Values["Evaluation"].as< std::string >() );
+
+    if ( EngineName == "InProcess" )
+      Engine = Solver::Evaluation::InProcess;
+    else if ( EngineName == "Actors" )
+      Engine = Solver::Evaluation::Actors;
+    else
+    {
+      std::cout << "The evaluation engine must be either Actors or InProcess "
+                << "and not " << EngineName << std::endl;
+
+      exit( EXIT_FAILURE );
+    }
+  }
+
+  // The kernel step is optional, but it must be a positive number of seconds
+
+  if ( Values.count("KernelStep") > 0 )
+  {
+    KernelStep = Values["KernelStep"].as< CoSSMic::Time >();
+
+    if ( KernelStep <= 0 )
+    {
+      std::cout << "The kernel step must be at least one second and not "
+                << KernelStep << std::endl;
+
+      exit( EXIT_FAILURE );
+    }
+  }
 
   // The result file is optional and stored if given
 
@@ -111,6 +201,196 @@ Dominoes::CommandLineOptions::CommandLineOptions( int argc, char **argv )
     }
   }
 
+  // The grid energy interpolation is optional, and only the two methods
+  // are accepted
+
+  if ( Values.count("GridEnergy") > 0 )
+  {
+    std::string MethodName( Values["GridEnergy"].as< std::string >() );
+
+    if ( MethodName == "Linear" )
+      GridInterpolation = Interpolation::Type::Linear;
+    else if ( MethodName == "Steffen" )
+      GridInterpolation = Interpolation::Type::SteffenMethod;
+    else
+    {
+      std::cout << "The grid energy interpolation must be either Linear or "
+                << "Steffen and not " << MethodName << std::endl;
+
+      exit( EXIT_FAILURE );
+    }
+  }
+
+  // The multi-start parameters are optional. There must be at least one
+  // start and the budget cannot be negative.
+
+  if ( Values.count("Starts") > 0 )
+  {
+    Starts = Values["Starts"].as< unsigned int >();
+
+    if ( Starts == 0 )
+    {
+      std::cout << "The number of starts must be at least one" << std::endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+
+  if ( Values.count("Threads") > 0 )
+    Threads = Values["Threads"].as< unsigned int >();
+
+  if ( Values.count("Decompose") > 0 )
+    Decompose = true;
+
+  if ( Values.count("WarmStart") > 0 )
+    GreedyStart = true;
+
+  if ( Values.count("Race") > 0 )
+    Racing = true;
+
+  if ( Values.count("Gradient") > 0 )
+    UseGradient = true;
+
+  if ( Values.count("MultiResolution") > 0 )
+  {
+    CoarseResolutions =
+      Values["MultiResolution"].as< std::vector< CoSSMic::Time > >();
+
+    if ( std::any_of( CoarseResolutions.begin(), CoarseResolutions.end(),
+                      []( CoSSMic::Time Resolution ){ return Resolution <= 0; } ) )
+    {
+      std::cout << "The resolutions must be positive numbers of seconds"
+                << std::endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+
+  if ( Values.count("Screening") > 0 )
+  {
+    ScreeningFactor = Values["Screening"].as< unsigned int >();
+
+    if ( ScreeningFactor == 0 )
+    {
+      std::cout << "At least one candidate must be screened per start"
+                << std::endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+
+  if ( Values.count("Memoise") > 0 )
+  {
+    MemoQuantum = Values["Memoise"].as< double >();
+
+    if ( *MemoQuantum < 0 )
+    {
+      std::cout << "The memoisation quantum cannot be negative" << std::endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+
+  if ( Values.count("ProfilePack") > 0 )
+  {
+    PackLocation = Values["ProfilePack"].as< std::string >();
+
+    if ( !std::filesystem::exists( ProfilePackFile() ) )
+    {
+      std::cout << "The profile pack " << ProfilePackFile()
+                << " does not exist!" << std::endl;
+
+      exit( EXIT_FAILURE );
+    }
+  }
+
+  if ( Values.count("Trace") > 0 )
+    TraceLocation = Values["Trace"].as< std::string >();
+
+  if ( Values.count("Capture") > 0 )
+    CaptureLocation = Values["Capture"].as< std::string >();
+
+  if ( Values.count("CacheEntries") > 0 )
+    CachedResults = Values["CacheEntries"].as< std::size_t >();
+
+  if ( Values.count("CacheDirectory") > 0 )
+    CacheLocation = Values["CacheDirectory"].as< std::string >();
+
+  if ( Values.count("Metrics") > 0 )
+    Metrics = true;
+
+  if ( Values.count("HTTPMetrics") > 0 )
+    HTTPPort = Values["HTTPMetrics"].as< unsigned short >();
+
+  if ( Values.count("ActorPool") > 0 )
+  {
+    PooledActors = true;
+    PoolWorkers  = Values["ActorPool"].as< unsigned int >();
+  }
+
+  if ( Values.count("Budget") > 0 )
+  {
+    Budget = std::chrono::seconds(
+             Values["Budget"].as< std::chrono::seconds::rep >() );
+
+    if ( Budget < std::chrono::seconds::zero() )
+    {
+      std::cout << "The time budget cannot be negative" << std::endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+
+  if ( Values.count("Deadline") > 0 )
+  {
+    Deadline = std::chrono::milliseconds(
+               Values["Deadline"].as< std::chrono::milliseconds::rep >() );
+
+    if ( Deadline < std::chrono::milliseconds::zero() )
+    {
+      std::cout << "The deadline cannot be negative" << std::endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+
+  // In batch mode, the scenario files are given in the manifest file, which
+  // must exist.
+
+  if ( Values.count("Workers") > 0 )
+    Workers = Values["Workers"].as< unsigned int >();
+
+  if ( Values.count("Batch") > 0 )
+  {
+    BatchManifest = Values["Batch"].as< std::string >();
+
+    if ( !std::filesystem::exists( ManifestFile() ) )
+    {
+      std::cout << "The batch manifest " << ManifestFile()
+                << " does not exist!" << std::endl;
+
+      exit( EXIT_FAILURE );
+    }
+
+    return;
+  }
+
+  // In daemon mode the scenario files are given with each request, and there
+  // is nothing more to parse from the command line.
+
+  if ( Values.count("Daemon") > 0 )
+  {
+    RunDaemon = true;
+
+    if ( Values.count("Socket") > 0 )
+      SocketName = Values["Socket"].as< std::string >();
+
+    if ( Values.count("QueueDepth") > 0 )
+      MaximalQueue = Values["QueueDepth"].as< std::size_t >();
+
+    return;
+  }
+
+  // The files for the producer and the consumer profiles must be given so
+  // they are readily stored
+
+  ProducerProfile  = Values["ProductionFile"].as< std::string >();
+  ConsumerProfiles = Values["Consumers"].as< std::string >();
+
   // Verifying that the files exist or terminate with errors if not
 
   std::filesystem::path FileToCheck = ProductionFile();
@@ -14,6 +14,135 @@ Optional parameters:
 -d [ --Directory ]              = Working directory. Default: current directory
 -a [ --AssignedTimes <name> ]   = Result file name. Default: AST.csv
 -s [ --SunDay <sunrise> <sunset> ] = to set the duration of the day
+-e [ --Evaluation <engine> ]    = Actors or InProcess. Default: Actors
+-k [ --KernelStep <seconds> ]   = Step of the profile tables. Default: 1
+-D [ --Daemon ]                 = Serve scenario requests instead
+-u [ --Socket <path> ]          = Daemon socket. Default: standard input
+-q [ --QueueDepth <n> ]         = Daemon jobs waiting. Default: no limit
+-B [ --Batch <manifest> ]       = Solve all scenarios in the manifest file
+-w [ --Workers <n> ]            = Scenarios solved in parallel. Default: all cores
+-m [ --Starts <K> ]             = Number of searches. Default: 1
+-t [ --Threads <n> ]            = Threads for the searches. Default: all cores
+-b [ --Budget <seconds> ]       = Time budget for all searches. Default: none
+-T [ --Deadline <milliseconds> ] = Deadline for the start times. Default: none
+-x [ --Decompose ]              = Solve independent consumers separately
+-G [ --WarmStart ]              = Greedy placement as initial start times
+-A [ --Race ]                   = Race BOBYQA, DIRECT and CRS for the start times
+-L [ --Gradient ]               = Variable metric searches with the gradient
+-r [ --MultiResolution <seconds> ] = Coarse production grids solved first
+-S [ --Screening <n> ]          = Random candidates per start. Default: 1
+-Q [ --Memoise <seconds> ]      = Memoise evaluations of the single search
+-y [ --Trace <file> ]           = Convergence trace of the single search
+-z [ --Capture <file> ]         = Write the problem for the algorithm benchmark
+-C [ --CacheEntries <n> ]       = Results kept in memory. Default: none
+-R [ --CacheDirectory <path> ]  = Directory for cached results. Default: none
+-M [ --Metrics ]                = Write timings and counters as JSON
+-H [ --HTTPMetrics <port> ]     = Serve daemon metrics over HTTP. Default: none
+-P [ --ActorPool <n> ]          = Workers executing the actors. Default: none
+-g [ --GridEnergy <method> ]    = Linear or Steffen interpolation. Default: Steffen
+-K [ --ProfilePack <file> ]     = Pack of appliance profiles. Default: none
+
+The kernel step is the resolution in seconds used to tabulate the consumption
+profiles. The default of one second reproduces the interpolated profiles
+exactly, whereas setting it to the sampling period of the production gives
+smaller tables on the production grid with linear blending between them.
+
+If more than one start is given, the given number of independent searches
+are run from different random initial start times on the given number of
+threads, and the best solution found is kept. The time budget stops starting
+new searches and limits the running ones once it has been used.
+
+The random initial start times can be screened by drawing the given number
+of candidates for each start and evaluating all of them together. The
+searches then start from the best candidates.
+
+The evaluations of the single search can be memoised so that start times that
+are equal when truncated to the given number of seconds, one by default, are
+only evaluated once. The objective truncates the start times to whole seconds,
+so the quantum should be a whole number of seconds. The hits and misses are
+reported with the metrics.
+
+The evaluations of the single search can also be traced to see how the grid
+energy decreases with the evaluations and with time, and how much of the time
+is used by the algorithm as opposed to the evaluations. The trace is written
+as JSON if the file name ends with .json, and as CSV otherwise.
+
+The problem of the scenario can be captured to a file before it is solved,
+and the algorithm benchmark can then replay its objective function to compare
+the optimisation algorithms on the real scheduling problem. The format is
+described in the Problem Capture header.
+
+The deadline is a wall-clock limit in milliseconds counted from the start of
+the program, or from the receipt of a request in daemon mode, or from the
+start of each scenario in batch mode. When it passes, the searches are stopped
+and the best start times found so far are written with the total grid energy
+flagged as partial.
+
+With decomposition, the consumers are partitioned into components whose time
+coverages do not share production samples, and the components are solved as
+independent subproblems concurrently on the threads of the searches.
+
+With the gradient, the searches use the analytic derivative of the grid
+energy with respect to the start times and the shifted limited memory
+variable metric algorithm instead of BOBYQA, which needs far fewer
+evaluations when there are many consumers. The searches are then run as for
+the multi-start even if there is only one start.
+
+With the multi-resolution solution, each search is first run on the
+production aggregated to the coarsest of the given resolutions in seconds,
+for instance 1800 900, and then refined on each finer grid and finally on the
+production samples from the start times found on the previous grid. Most
+evaluations are then done where they are cheapest. The searches are run as
+for the multi-start even if there is only one start.
+
+With the race, BOBYQA from the first initial start times, DIRECT and the
+controlled random search run concurrently on the same problem instead of the
+searches. The race ends when the first algorithm converges or the budget or
+the deadline has passed, and the best start times seen by any algorithm are
+kept.
+
+With metrics, the time used by each phase of the solver, the number of
+evaluations of the objective function with their mean and 99th percentile
+latency, and the number of messages sent are written as JSON to a file next
+to the assigned start time file with the extension ".metrics.json".
+
+In daemon mode the metrics can also be served for Prometheus over HTTP on the
+given port: the solver evaluations and the solution times of the requests,
+the statistics of the job queue, the mailboxes of the actors, and the
+resident memory of the daemon.
+
+By default every actor, including every consumer, has its own thread. With
+the actor pool the actors are instead executed by the given number of worker
+threads, or by one worker per core if the number is zero, which avoids
+creating a thread per consumer for large scenarios.
+
+The grid energy is the part of the consumption not covered by the production
+at each sample time, and the objective is its integral. It is by default
+interpolated by Steffen's method, but with linear interpolation the integral
+is a simple sum of trapezoids computed without any memory allocation.
+
+The profile pack is built from the appliance clusters and the PV categories
+of the web service by the packData.js tool. It is mapped once when the
+simulator starts, and a consumer can then give its consumption profile as a
+reference to a profile in the pack instead of as a CSV file, as described in
+the Profile Pack header. The pack file is relative to the working directory.
+
+The result cache returns the stored start times of an identical scenario
+without solving it, and uses the start times of a scenario differing only in
+the start windows as the initial start times of the search. The results are
+kept in memory for the given number of scenarios, which is mostly useful in
+the daemon and batch modes, and in the cache directory if it is given, which
+is shared by all simulator processes using it. The directory is relative to
+the working directory. The Result Cache header describes the keys.
+
+In daemon mode the production file and the consumers file are not given on the
+command line, but with each scenario request as documented in the Daemon
+header. The requests are read from the standard input unless a Unix domain
+socket is given. The requests are solved by the given number of workers, and
+if the queue depth is given, requests arriving when this number of requests
+are already waiting are rejected as busy. In batch mode the scenarios are read from the manifest as
+documented in the Batch header, and the production file, the consumers file
+and the result file options are not used.
 
 Each line in the consumer CSV file has the following formate
 <Consumer ID>, <Earliest Start time>, <Latest start time>, <Energy CSV>
@@ -30,7 +159,12 @@ License: LGPL 3.0
 #define DOMINOES_OPTIONS
 
 #include <filesystem>               // Portable filesystem
+#include <chrono>                   // Time budget
+#include <cstddef>                  // Cache entries
+#include <optional>                 // Memoisation quantum
 #include "TimeInterval.hpp"         // CoSSMic Time
+#include "Interpolation.hpp"        // Grid energy interpolation
+#include "Solver.hpp"               // The evaluation engines
 
 namespace Dominoes {
 
@@ -47,6 +181,94 @@ private:
 
   CoSSMic::TimeInterval Day;
 
+  // The engine used to evaluate the objective function
+
+  Solver::Evaluation Engine;
+
+  // The step in seconds for the tabulation of the consumption profiles
+
+  CoSSMic::Time KernelStep;
+
+  // The daemon mode flag and the optional socket for the daemon
+
+  bool                  RunDaemon;
+  std::filesystem::path SocketName;
+  std::size_t           MaximalQueue;
+
+  // The batch manifest file and the number of parallel batch or daemon
+  // workers
+
+  std::filesystem::path BatchManifest;
+  unsigned int          Workers;
+
+  // The multi-start parameters
+
+  unsigned int          Starts, Threads;
+  std::chrono::seconds  Budget;
+
+  // The deadline for the assignment of start times
+
+  std::chrono::milliseconds Deadline;
+
+  // The decomposition into independent subproblems
+
+  bool                  Decompose;
+
+  // The greedy warm start of the search
+
+  bool                  GreedyStart;
+
+  // The racing portfolio of algorithms
+
+  bool                  Racing;
+
+  // The gradient based searches
+
+  bool                  UseGradient;
+
+  // The resolutions of the multi-resolution solution
+
+  std::vector< CoSSMic::Time > CoarseResolutions;
+
+  // The number of random candidates screened for each start
+
+  unsigned int          ScreeningFactor;
+
+  // The quantum for memoising the objective values of the single search
+
+  std::optional< double > MemoQuantum;
+
+  // The file for the convergence trace of the single search
+
+  std::filesystem::path TraceLocation;
+
+  // The file for the captured problem
+
+  std::filesystem::path CaptureLocation;
+
+  // The result cache parameters
+
+  std::size_t           CachedResults;
+  std::filesystem::path CacheLocation;
+
+  // The instrumentation report
+
+  bool                  Metrics;
+  unsigned short        HTTPPort;
+
+  // The thread pool executing the actors, if it is used
+
+  bool                  PooledActors;
+  unsigned int          PoolWorkers;
+
+  // The interpolation of the grid energy
+
+  Interpolation::Type   GridInterpolation;
+
+  // The pack of appliance profiles
+
+  std::filesystem::path PackLocation;
+
 public:
 
   // The production file and the consumers file can be obtained by
@@ -70,6 +292,150 @@ public:
   inline CoSSMic::TimeInterval DayDuration( void )
   { return Day; }
 
+  // The evaluation engine is by default to use the consumer actors
+
+  inline Solver::Evaluation EvaluationEngine( void )
+  { return Engine; }
+
+  // The profile tabulation step is by default one second
+
+  inline CoSSMic::Time ProfileStep( void )
+  { return KernelStep; }
+
+  // The daemon mode is only used if explicitly requested, and the socket
+  // name is empty if the standard input should be used.
+
+  inline bool DaemonMode( void )
+  { return RunDaemon; }
+
+  inline std::filesystem::path DaemonSocket( void )
+  { return SocketName; }
+
+  // The number of requests that may wait for a daemon worker, where zero
+  // means no limit.
+
+  inline std::size_t QueueDepth( void )
+  { return MaximalQueue; }
+
+  // The batch mode is used if a manifest is given, and the number of workers
+  // is by default zero meaning the number of hardware threads.
+
+  inline bool BatchMode( void )
+  { return !BatchManifest.empty(); }
+
+  inline std::filesystem::path ManifestFile( void )
+  { return WorkingDirectory / BatchManifest; }
+
+  inline unsigned int NumberOfWorkers( void )
+  { return Workers; }
+
+  // The multi-start parameters are by default one start on all available
+  // hardware threads without any time limit (zero budget).
+
+  inline unsigned int NumberOfStarts( void )
+  { return Starts; }
+
+  inline unsigned int NumberOfThreads( void )
+  { return Threads; }
+
+  inline std::chrono::seconds SearchBudget( void )
+  { return Budget; }
+
+  // The deadline is by default zero meaning that there is no deadline
+
+  inline std::chrono::milliseconds SolutionDeadline( void )
+  { return Deadline; }
+
+  // The decomposition is only used if explicitly requested
+
+  inline bool Decomposition( void )
+  { return Decompose; }
+
+  // The greedy warm start is only used if explicitly requested
+
+  inline bool WarmStart( void )
+  { return GreedyStart; }
+
+  // The racing portfolio is only used if explicitly requested
+
+  inline bool RacingPortfolio( void )
+  { return Racing; }
+
+  // The gradient based searches are only used if explicitly requested
+
+  inline bool GradientBased( void )
+  { return UseGradient; }
+
+  // The multi-resolution solution is only used if resolutions are given
+
+  inline const std::vector< CoSSMic::Time > & MultiResolution( void )
+  { return CoarseResolutions; }
+
+  // The random initial start times are by default not screened
+
+  inline unsigned int Screening( void )
+  { return ScreeningFactor; }
+
+  // The objective values are by default not memoised
+
+  inline std::optional< double > Memoisation( void )
+  { return MemoQuantum; }
+
+  // The evaluations are by default not traced, and the trace file is returned
+  // relative to the working directory if it is given.
+
+  inline std::filesystem::path TraceFile( void )
+  { return TraceLocation.empty() ? TraceLocation
+                                 : WorkingDirectory / TraceLocation; }
+
+  // The problem is by default not captured, and the capture file is returned
+  // relative to the working directory if it is given.
+
+  inline std::filesystem::path CaptureFile( void )
+  { return CaptureLocation.empty() ? CaptureLocation
+                                   : WorkingDirectory / CaptureLocation; }
+
+  // The result cache is by default not used, and the directory is returned
+  // as an absolute path if it is given.
+
+  inline std::size_t CacheEntries( void )
+  { return CachedResults; }
+
+  inline std::filesystem::path CacheDirectory( void )
+  { return CacheLocation.empty() ? CacheLocation
+                                 : WorkingDirectory / CacheLocation; }
+
+  // The instrumentation report is only written if requested
+
+  inline bool MetricsReport( void )
+  { return Metrics; }
+
+  // The port serving the metrics over HTTP is zero if they are not served
+
+  inline unsigned short MetricsPort( void )
+  { return HTTPPort; }
+
+  // The actors have dedicated threads unless the pool is requested, and the
+  // number of pool workers is zero for one worker per core.
+
+  inline bool ActorPool( void )
+  { return PooledActors; }
+
+  inline unsigned int ActorPoolWorkers( void )
+  { return PoolWorkers; }
+
+  // The grid energy interpolation is by default Steffen's method
+
+  inline Interpolation::Type GridEnergyInterpolation( void )
+  { return GridInterpolation; }
+
+  // The profile pack is by default not used, and the pack file is returned
+  // relative to the working directory if it is given.
+
+  inline std::filesystem::path ProfilePackFile( void )
+  { return PackLocation.empty() ? PackLocation
+                                : WorkingDirectory / PackLocation; }
+
   // The constructor must have the argument count and the argument vector
   // and it will do all the command line parsing.
 
@@ -11,7 +11,7 @@ License: LGPL 3.0
 #include <filesystem>                         // Paths to files
 #include "TimeInterval.hpp"                   // The time concept
 #include "Consumer.hpp"                       // Class definition
-#include "CSVtoTimeSeries.hpp"                // To read CSV files
+#include "ProfileCache.hpp"                   // Shared profiles
 
 /*==============================================================================
 
@@ -19,17 +19,24 @@ License: LGPL 3.0
 
 ==============================================================================*/
 //
-// The first message handler takes the file name, parses the CSV file and
-// produces the interpolation.
+// The first message handler takes the file name and obtains the kernel of
+// the tabulated profile from the profile cache, which will parse the CSV file
+// and interpolate it unless an identical profile has already been loaded.
 
 void Dominoes::Consumer::ReadLoad( const std::filesystem::path & FileName,
                                    const Theron::Address Sender )
 {
-  std::map< CoSSMic::Time, double >
-  LoadProfile( CoSSMic::CSVtoTimeSeries( FileName ) );
+  Kernel              = ProfileCache::Kernel( FileName, KernelStep );
+  ConsumptionDuration = Kernel->GetDuration();
+}
+
+// The in-memory profile is handled in the same way
 
-  ConsumptionDuration = LoadProfile.rbegin()->first;
-  Energy              = std::make_unique< Interpolation >( LoadProfile );
+void Dominoes::Consumer::SetLoad( const LoadProfile & Profile,
+                                  const Theron::Address Sender )
+{
+  Kernel              = ProfileCache::Kernel( Profile, KernelStep );
+  ConsumptionDuration = Kernel->GetDuration();
 }
 
 // The second message handler is more complex as it returns a vector the energy
@@ -45,7 +52,9 @@ void Dominoes::Consumer::ReadLoad( const std::filesystem::path & FileName,
 // of the previous time stamp is subtracted from this. The delta energy is then
 // stored in the vector, and the current cumulative energy is remembered for
 // the next time step. The scan of the production sample times stops as soon
-// as the time stamp is larger than the end of the consumption profile.
+// as the time stamp is larger than the end of the consumption profile. The
+// cumulative energy is read from the kernel rather than interpolated for each
+// time stamp.
 
 void Dominoes::Consumer::Consumption( const CoSSMic::Time & AssignedStartTime,
                                       const Theron::Address Solver )
@@ -60,15 +69,14 @@ void Dominoes::Consumer::Consumption( const CoSSMic::Time & AssignedStartTime,
 			++CurrentConsumption;
 		else if ( TimeStamp <= ConsumptionEnd )
 		{
-			double CumulativeEnergy  = Energy->operator()(
-             boost::numeric_cast<double>( TimeStamp - AssignedStartTime ) );
+			double CumulativeEnergy  = (*Kernel)( TimeStamp - AssignedStartTime );
 			*CurrentConsumption  = CumulativeEnergy - PastCumulativeEnergy;
       PastCumulativeEnergy = CumulativeEnergy;
 			++CurrentConsumption;
 		}
 		else break;
 
-	Send( dE, Solver );
+	Send( std::move( dE ), Solver );
 }
 
 // The message handler to compute the time coverage of the consumer is trivial
@@ -88,20 +96,50 @@ void Dominoes::Consumer::ComputeCoverage(
 
 ==============================================================================*/
 //
-// The Constructor stores the start interval and the production sample time
-// pointer, and sends a message to start the parsing of the consumption file.
+// The common constructor stores the start interval and the production sample
+// time pointer, and registers the message handlers. There is one consumer for
+// each load and they are idle most of the time, and they can therefore be
+// executed by the actor pool by setting the execution mode of the class.
 
 Dominoes::Consumer::Consumer( const std::string & ID,
      CoSSMic::Time EarliestStart, CoSSMic::Time LatestStart,
-     const std::filesystem::path & FileName,
-		 const Dominoes::SampleTime SampleProductionTimes )
-: Theron::Actor( ID ), StartInterval( EarliestStart, LatestStart ),
-  Energy(), ConsumptionDuration(0),
-  TimeOrigin( EarliestStart ), ProductionSamples( SampleProductionTimes )
+		 const Dominoes::SampleTime SampleProductionTimes,
+     CoSSMic::Time ProfileStep, const std::string & ActorPrefix )
+: Theron::Actor( ActorPrefix + ID, ClassExecutionMode< Consumer >() ),
+  ConsumerID( ID ), StartInterval( EarliestStart, LatestStart ),
+  ConsumptionDuration(0),
+  TimeOrigin( EarliestStart ), ProductionSamples( SampleProductionTimes ),
+  KernelStep( ProfileStep ), Kernel()
 {
   RegisterHandler( this, &Consumer::ReadLoad        );
+  RegisterHandler( this, &Consumer::SetLoad         );
   RegisterHandler( this, &Consumer::Consumption     );
   RegisterHandler( this, &Consumer::ComputeCoverage );
+}
+
+// The file constructor sends a message to start the parsing of the
+// consumption file,
 
+Dominoes::Consumer::Consumer( const std::string & ID,
+     CoSSMic::Time EarliestStart, CoSSMic::Time LatestStart,
+     const std::filesystem::path & FileName,
+		 const Dominoes::SampleTime SampleProductionTimes,
+     CoSSMic::Time ProfileStep, const std::string & ActorPrefix )
+: Consumer( ID, EarliestStart, LatestStart, SampleProductionTimes,
+            ProfileStep, ActorPrefix )
+{
   Send( FileName, GetAddress() );
 }
+
+// and the profile constructor sends the profile to be tabulated.
+
+Dominoes::Consumer::Consumer( const std::string & ID,
+     CoSSMic::Time EarliestStart, CoSSMic::Time LatestStart,
+     const LoadProfile & Profile,
+		 const Dominoes::SampleTime SampleProductionTimes,
+     CoSSMic::Time ProfileStep, const std::string & ActorPrefix )
+: Consumer( ID, EarliestStart, LatestStart, SampleProductionTimes,
+            ProfileStep, ActorPrefix )
+{
+  Send( Profile, GetAddress() );
+}
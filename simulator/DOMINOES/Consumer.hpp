@@ -46,6 +46,7 @@ License: LGPL 3.0
 #include <vector>                            // Standard vectors
 #include <memory>                            // Smart pointers
 #include <filesystem>                        // Filenames
+#include <map>                               // In-memory profiles
 
 // Other headers
 #include <boost/numeric/conversion/cast.hpp> // Casting numeric types
@@ -56,6 +57,7 @@ License: LGPL 3.0
 #include "Interpolation.hpp"                 // To interpolate the time series
 
 // Dominoes
+#include "ConsumptionKernel.hpp"             // Tabulated profile
 #include "Typedefs.hpp"
 
 namespace Dominoes {
@@ -68,19 +70,40 @@ private:
   // the duration of the consumption. The duration is stored as it is only
   // available after the profile data has been read from the file, and it is
   // used to calculate the consumed energy. It is not necessary to store the
-  // name of the consumer as this is given by the actor name.
+  // name of the consumer as this is given by the actor name, unless several
+  // solvers run in the same process in which case the actor name is prefixed
+  // by the scenario name and the ID of the consumer must be stored.
 
+  const std::string                ConsumerID;
   CoSSMic::TimeInterval            StartInterval;
-	std::unique_ptr< Interpolation > Energy;
   CoSSMic::Time                    ConsumptionDuration, TimeOrigin;
 	const SampleTime                 ProductionSamples;
 
+  // The energy profile is the interpolated profile tabulated by a kernel, and
+  // the consumption at the production sample times is then computed from
+  // this kernel. The step of the table is given to the constructor. The
+  // kernel is shared with all other consumers having the same profile.
+
+  const CoSSMic::Time                        KernelStep;
+  std::shared_ptr< const ConsumptionKernel > Kernel;
+
 	// The message handler to parse the sample profile file is private as it
 	// should never be called directly. The message is a simple string containing
 	// the file name to be parsed.
 
 	void ReadLoad( const std::filesystem::path & FileName, const Address Sender );
 
+  // The profile can also be given in memory as the cumulative energy at
+  // relative times, and then it is sent to the consumer as a map.
+
+public:
+
+  using LoadProfile = std::map< CoSSMic::Time, double >;
+
+private:
+
+  void SetLoad( const LoadProfile & Profile, const Address Sender );
+
 	// The message handler for the assigned start time simply takes a time and
 	// returns the consumption profile for the time points of the sampled
 	// production
@@ -102,7 +125,7 @@ public:
   // The ID of the consumer can be obtained by a similar access function
 
   inline std::string GetName( void ) const
-  { return GetAddress().AsString(); }
+  { return ConsumerID; }
 
   // The real start time is given as the relative start time plus the time
   // origin (the earliest start time)
@@ -114,6 +137,19 @@ public:
   { return TimeOrigin
            + boost::numeric_cast< CoSSMic::Time >( RelativeTimeStamp ); }
 
+  // The duration of the consumption is known once the profile has been read.
+
+  inline CoSSMic::Time GetDuration( void ) const
+  { return ConsumptionDuration; }
+
+  // The kernel tabulating the cumulative energy of the profile can be used by
+  // evaluation engines that compute the consumption directly without sending
+  // messages to the consumer. It is only available after the profile has been
+  // read.
+
+  inline std::shared_ptr< const ConsumptionKernel > GetKernel( void ) const
+  { return Kernel; }
+
   // ---------------------------------------------------------------------------
   // Time axis
   // ---------------------------------------------------------------------------
@@ -153,13 +189,40 @@ private:
   // ---------------------------------------------------------------------------
   //
 	// The constructor takes the earliest and latest start times, the file name
-	// of the consumption and a pointer to the production time samples.
+	// of the consumption and a pointer to the production time samples. The
+	// step in seconds of the tabulated profile kernel is optional, and the
+	// default is to tabulate every second which gives the exact values of the
+	// interpolated profile. Actor names must be unique, and if consumers with
+	// the same ID are created for different scenarios, a prefix unique for
+	// each scenario must be given for the actor name.
 
 public:
 
 	Consumer( const std::string & ID, CoSSMic::Time EarliestStart,
             CoSSMic::Time LatestStart, const std::filesystem::path & FileName,
-					  const SampleTime SampleProductionTimes );
+					  const SampleTime SampleProductionTimes,
+            CoSSMic::Time ProfileStep = 1,
+            const std::string & ActorPrefix = std::string() );
+
+  // The consumer can equally be constructed from an in-memory profile, which
+  // is needed when the solver is embedded and there are no profile files.
+
+	Consumer( const std::string & ID, CoSSMic::Time EarliestStart,
+            CoSSMic::Time LatestStart, const LoadProfile & Profile,
+					  const SampleTime SampleProductionTimes,
+            CoSSMic::Time ProfileStep = 1,
+            const std::string & ActorPrefix = std::string() );
+
+private:
+
+  // Both constructors delegate the initialisation of the actor and the
+  // registration of the message handlers to a common constructor.
+
+	Consumer( const std::string & ID, CoSSMic::Time EarliestStart,
+            CoSSMic::Time LatestStart, const SampleTime SampleProductionTimes,
+            CoSSMic::Time ProfileStep, const std::string & ActorPrefix );
+
+public:
 
 	// The default constructor is not allowed, and it makes no sense to copy
 	// a consumer.
@@ -0,0 +1,315 @@
+/*==============================================================================
+Consumption Block
+
+This is the implementation of the consumption block evaluation engine.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <algorithm>                         // Searching the time axis
+#include <sstream>                           // For nicely formatted errors
+#include <stdexcept>                         // Standard exceptions
+#include <limits>                            // Precision of written values
+
+#include <boost/numeric/conversion/cast.hpp> // Casting numeric types
+
+#include "ConsumptionBlock.hpp"              // The class definition
+
+/*==============================================================================
+
+ Consumption
+
+==============================================================================*/
+//
+// The consumption of each consumer is computed with exactly the same logic as
+// the consumption handler of the consumer actor: The production samples before
+// the assigned start time have no consumption, and for the samples inside the
+// consumption duration the increment of the cumulative energy since the
+// previous sample is added to the total consumption. The scan over the
+// production samples covered by a consumer is shared with the computation of
+// the consumption of a single consumer.
+
+void Dominoes::ConsumptionBlock::AddConsumption(
+     const Optimization::Variables & StartTimes,
+     std::vector< double > & TotalConsumption ) const
+{
+  if ( ( StartTimes.size() != Duration.size() ) ||
+       ( TotalConsumption.size() != ProductionSamples->size() ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The consumption block has " << Duration.size()
+                 << " consumers and " << ProductionSamples->size()
+                 << " production samples, but " << StartTimes.size()
+                 << " start times and a consumption vector of size "
+                 << TotalConsumption.size() << " were given";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  for ( Index Consumer = 0; Consumer < Duration.size(); Consumer++ )
+    ForEachSample( Consumer,
+      boost::numeric_cast< CoSSMic::Time >( StartTimes[ Consumer ] ),
+      [&]( Index Sample, double Energy ){
+        TotalConsumption[ Sample ] += Energy; });
+}
+
+// Adding the consumption to a lane of the matrix is the same except that the
+// elements of the lane are separated by the number of lanes.
+
+void Dominoes::ConsumptionBlock::AddConsumption(
+     const Optimization::Variables & StartTimes, double * TotalConsumption,
+     Index Lanes, Index Lane ) const
+{
+  if ( ( StartTimes.size() != Duration.size() ) || ( Lane >= Lanes ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The consumption block has " << Duration.size()
+                 << " consumers, but " << StartTimes.size()
+                 << " start times were given for lane " << Lane << " of "
+                 << Lanes << " lanes";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  double * LaneConsumption = TotalConsumption + Lane;
+
+  for ( Index Consumer = 0; Consumer < Duration.size(); Consumer++ )
+    ForEachSample( Consumer,
+      boost::numeric_cast< CoSSMic::Time >( StartTimes[ Consumer ] ),
+      [&]( Index Sample, double Energy ){
+        LaneConsumption[ Sample * Lanes ] += Energy; });
+}
+
+// The consumption of a single consumer is stored as the energy consumed in
+// each of the consecutive production samples starting from the first sample
+// covered by the consumption.
+
+Dominoes::ConsumptionBlock::Index
+Dominoes::ConsumptionBlock::ConsumerConsumption( Index Consumer,
+  CoSSMic::Time StartTime, std::vector< double > & Consumption ) const
+{
+  Index FirstSample = 0;
+
+  Consumption.clear();
+
+  ForEachSample( Consumer, StartTime,
+    [&]( Index Sample, double Energy ){
+      if ( Consumption.empty() ) FirstSample = Sample;
+      Consumption.push_back( Energy ); });
+
+  return FirstSample;
+}
+
+// The derivative is computed by the same scan as the consumption, but with
+// the power of the consumer at the sample times in place of the cumulative
+// energy. The power before the first sample covered is zero since the
+// consumption of the first sample is counted from the start time.
+
+double Dominoes::ConsumptionBlock::StartTimeDerivative( Index Consumer,
+  CoSSMic::Time StartTime, const double * SampleWeight ) const
+{
+  const auto FirstSample = ProductionSamples->begin(),
+             LastSample  = ProductionSamples->end();
+  const CoSSMic::Time EndTime = StartTime + Duration[ Consumer ],
+                      Step    = KernelStep[ Consumer ];
+  const double * Profile = CumulativeEnergy.data() + ProfileStart[ Consumer ];
+  double PastPower = 0.0, Derivative = 0.0;
+
+  auto  TimeStamp = std::lower_bound( FirstSample, LastSample, StartTime );
+  Index Sample    = std::distance( FirstSample, TimeStamp );
+
+  for ( ; ( TimeStamp != LastSample ) && ( *TimeStamp <= EndTime );
+        ++TimeStamp, ++Sample )
+  {
+    const double * Entry = Profile + ( *TimeStamp - StartTime ) / Step;
+    const double   Power = ( *(Entry + 1) - *Entry ) /
+                           static_cast< double >( Step );
+
+    Derivative += SampleWeight[ Sample ] * ( PastPower - Power );
+    PastPower   = Power;
+  }
+
+  return Derivative;
+}
+
+/*==============================================================================
+
+ Constructor
+
+==============================================================================*/
+//
+// The constructor simply reads the kernel of each consumer and appends its
+// table to the energy table after recording where it starts and its step.
+
+Dominoes::ConsumptionBlock::ConsumptionBlock(
+  const std::list< Consumer > & Consumers, const SampleTime & ProductionTimes )
+: CumulativeEnergy(), ProfileStart(), KernelStep(), Duration(),
+  ProductionSamples( ProductionTimes )
+{
+  ProfileStart.reserve( Consumers.size() );
+  KernelStep.reserve( Consumers.size() );
+  Duration.reserve( Consumers.size() );
+
+  for ( const Consumer & TheConsumer : Consumers )
+  {
+    const auto Kernel = TheConsumer.GetKernel();
+    const std::vector< double > & Profile( Kernel->Values() );
+
+    ProfileStart.push_back( CumulativeEnergy.size() );
+    KernelStep.push_back( Kernel->GetStep() );
+    Duration.push_back( Kernel->GetDuration() );
+
+    CumulativeEnergy.insert( CumulativeEnergy.end(),
+                             Profile.begin(), Profile.end() );
+  }
+}
+
+// The constructor for a subset copies the table of each selected consumer
+// from the other block.
+
+Dominoes::ConsumptionBlock::ConsumptionBlock( const ConsumptionBlock & Other,
+                                              const std::vector< Index > & Subset )
+: CumulativeEnergy(), ProfileStart(), KernelStep(), Duration(),
+  ProductionSamples( Other.ProductionSamples )
+{
+  ProfileStart.reserve( Subset.size() );
+  KernelStep.reserve( Subset.size() );
+  Duration.reserve( Subset.size() );
+
+  for ( Index Consumer : Subset )
+  {
+    if ( Consumer >= Other.size() )
+    {
+      std::ostringstream ErrorMessage;
+
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "Consumer " << Consumer << " is not one of the "
+                   << Other.size() << " consumers of the block";
+
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+
+    const Index End = ( Consumer + 1 < Other.size() )
+                      ? Other.ProfileStart[ Consumer + 1 ]
+                      : Other.CumulativeEnergy.size();
+
+    ProfileStart.push_back( CumulativeEnergy.size() );
+    KernelStep.push_back( Other.KernelStep[ Consumer ] );
+    Duration.push_back( Other.Duration[ Consumer ] );
+
+    CumulativeEnergy.insert( CumulativeEnergy.end(),
+      Other.CumulativeEnergy.begin() + Other.ProfileStart[ Consumer ],
+      Other.CumulativeEnergy.begin() + End );
+  }
+}
+
+// The constructor for another time axis copies the tables as they are
+
+Dominoes::ConsumptionBlock::ConsumptionBlock( const ConsumptionBlock & Other,
+                                              const SampleTime & ProductionTimes )
+: CumulativeEnergy( Other.CumulativeEnergy ),
+  ProfileStart( Other.ProfileStart ), KernelStep( Other.KernelStep ),
+  Duration( Other.Duration ), ProductionSamples( ProductionTimes )
+{}
+
+/*==============================================================================
+
+ Capture
+
+==============================================================================*/
+//
+// The values are written with the precision needed to read back the same
+// double values.
+
+void Dominoes::ConsumptionBlock::Write( std::ostream & Output ) const
+{
+  const auto Precision =
+             Output.precision( std::numeric_limits< double >::max_digits10 );
+
+  Output << Duration.size() << "\n";
+
+  for ( Index Consumer = 0; Consumer < Duration.size(); Consumer++ )
+  {
+    const Index End = ( Consumer + 1 < Duration.size() )
+                      ? ProfileStart[ Consumer + 1 ]
+                      : CumulativeEnergy.size();
+
+    Output << KernelStep[ Consumer ] << " " << Duration[ Consumer ] << " "
+           << End - ProfileStart[ Consumer ];
+
+    for ( Index Entry = ProfileStart[ Consumer ]; Entry < End; Entry++ )
+      Output << " " << CumulativeEnergy[ Entry ];
+
+    Output << "\n";
+  }
+
+  Output.precision( Precision );
+}
+
+// Reading the block checks that the step is positive and that the table of
+// each consumer covers its duration, since the consumption is looked up in
+// the table without further checks.
+
+Dominoes::ConsumptionBlock::ConsumptionBlock( std::istream & Input,
+                                              const SampleTime & ProductionTimes )
+: CumulativeEnergy(), ProfileStart(), KernelStep(), Duration(),
+  ProductionSamples( ProductionTimes )
+{
+  Index Consumers = 0;
+
+  Input >> Consumers;
+
+  ProfileStart.reserve( Consumers );
+  KernelStep.reserve( Consumers );
+  Duration.reserve( Consumers );
+
+  for ( Index Consumer = 0; Input && ( Consumer < Consumers ); Consumer++ )
+  {
+    CoSSMic::Time Step = 0, ConsumptionDuration = 0;
+    Index         Length = 0;
+
+    Input >> Step >> ConsumptionDuration >> Length;
+
+    if ( !Input || ( Step <= 0 ) || ( ConsumptionDuration < 0 ) ||
+         ( Length < static_cast< Index >( ConsumptionDuration / Step ) + 2 ) )
+    {
+      std::ostringstream ErrorMessage;
+
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "Consumer " << Consumer << " of the captured block has "
+                   << "step " << Step << ", duration " << ConsumptionDuration
+                   << " and a table of " << Length << " values";
+
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+
+    ProfileStart.push_back( CumulativeEnergy.size() );
+    KernelStep.push_back( Step );
+    Duration.push_back( ConsumptionDuration );
+
+    for ( Index Entry = 0; Entry < Length; Entry++ )
+    {
+      double Value = 0.0;
+
+      Input >> Value;
+      CumulativeEnergy.push_back( Value );
+    }
+  }
+
+  if ( !Input || ( Duration.size() != Consumers ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The captured block should have " << Consumers
+                 << " consumers, but only " << Duration.size()
+                 << " could be read";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+}
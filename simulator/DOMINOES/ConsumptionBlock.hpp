@@ -0,0 +1,211 @@
+/*==============================================================================
+Consumption Block
+
+The standard way to evaluate the objective function is to send the assigned
+start time to each consumer actor and wait for all of them to return their
+energy consumption at the production sample times. This is the right approach
+if the consumers are distributed, but for a set of consumers running in the
+same process each evaluation of the objective function then costs one message
+to and one message from every consumer, and one heap allocated vector per
+consumer for the returned consumption.
+
+The consumption block is an alternative evaluation engine that keeps the
+consumption profiles of all consumers in one structure of arrays owned by the
+solver. All start times and production sample times are whole POSIX seconds,
+and so is the time relative to the assigned start time of a consumer for which
+the consumer's interpolated profile is evaluated. The consumption kernel of a
+consumer tabulates its cumulative energy once over its consumption duration,
+and the consumption at a production sample time becomes a table lookup, or a
+linear blend of two table values, giving the same values as the consumer
+actor would have returned. The kernel tables of all consumers are copied
+contiguously into one vector, and the offset of the first element, the table
+step and the duration are stored in separate vectors indexed by the consumer
+number, i.e. the same index as the consumer's start time in the variable
+vector of the optimisation problem.
+
+The total consumption is then computed by one tight loop over the consumers
+in the order of the variables, and the block has no mutable state so it can be
+used concurrently by several threads as long as they provide their own total
+consumption vectors.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_CONSUMPTION_BLOCK
+#define DOMINOES_CONSUMPTION_BLOCK
+
+#include <vector>                            // Standard vectors
+#include <list>                              // The list of consumers
+#include <algorithm>                         // Searching the time axis
+#include <iterator>                          // Iterator distance
+#include <istream>                           // Reading a captured block
+#include <ostream>                           // Writing a captured block
+
+#include "Variables.hpp"                     // Optimization variables
+#include "TimeInterval.hpp"                  // The CoSSMic time
+#include "Typedefs.hpp"                      // Dominoes types
+#include "Consumer.hpp"                      // The consumer actors
+
+namespace Dominoes {
+
+class ConsumptionBlock
+{
+private:
+
+  // The index type is used for the consumers and for the elements of the
+  // energy table that stores the profiles of all consumers.
+
+public:
+
+  using Index = std::vector< double >::size_type;
+
+private:
+
+  // The kernel tables of the cumulative energy of all consumers, and for
+  // each consumer the index of its first element, the step of its table and
+  // its duration.
+
+  std::vector< double >        CumulativeEnergy;
+  std::vector< Index >         ProfileStart;
+  std::vector< CoSSMic::Time > KernelStep, Duration;
+
+  // The block also keeps the pointer to the production sample times. These
+  // must not change after the block has been constructed, i.e. the time axis
+  // must have been extended to cover all the consumers before the block is
+  // constructed.
+
+  const SampleTime ProductionSamples;
+
+  // The consumption of one consumer for a given start time is computed by
+  // scanning the production samples covered by the consumption and calling
+  // the given function with the index of the sample and the energy consumed
+  // since the previous sample. The first production sample not before the
+  // start time is found by binary search on the time axis since the
+  // production times are sorted, and the scan stops at the end of the
+  // consumption.
+
+  template< class SampleFunction >
+  inline void ForEachSample( Index Consumer, CoSSMic::Time StartTime,
+                             SampleFunction && Apply ) const
+  {
+    const auto FirstSample = ProductionSamples->begin(),
+               LastSample  = ProductionSamples->end();
+    const CoSSMic::Time EndTime = StartTime + Duration[ Consumer ],
+                        Step    = KernelStep[ Consumer ];
+    const double * Profile = CumulativeEnergy.data() + ProfileStart[ Consumer ];
+    double PastCumulativeEnergy = 0.0;
+
+    auto  TimeStamp = std::lower_bound( FirstSample, LastSample, StartTime );
+    Index Sample    = std::distance( FirstSample, TimeStamp );
+
+    for ( ; ( TimeStamp != LastSample ) && ( *TimeStamp <= EndTime );
+          ++TimeStamp, ++Sample )
+    {
+      const CoSSMic::Time RelativeTime = *TimeStamp - StartTime,
+                          Remainder    = RelativeTime % Step;
+      const double *      Entry        = Profile + RelativeTime / Step;
+      double Energy = *Entry;
+
+      if ( Remainder != 0 )
+        Energy += static_cast< double >( Remainder ) /
+                  static_cast< double >( Step ) * ( *(Entry + 1) - *Entry );
+
+      Apply( Sample, Energy - PastCumulativeEnergy );
+      PastCumulativeEnergy = Energy;
+    }
+  }
+
+public:
+
+  // The number of consumers in the block can be obtained for consistency
+  // checks.
+
+  inline Index size( void ) const
+  { return Duration.size(); }
+
+  // The main function adds the consumption of all consumers at the sample
+  // times of the production to the given total consumption vector. The start
+  // times must be given in the same order as the consumers were given to the
+  // constructor. The total consumption vector must have the same size as the
+  // production sample times and it is not reset before the consumptions are
+  // added.
+
+  void AddConsumption( const Optimization::Variables & StartTimes,
+                       std::vector< double > & TotalConsumption ) const;
+
+  // The consumption can also be added to one lane of a sample major matrix
+  // holding the total consumption of several candidate start time vectors,
+  // where the element of a sample is at Sample * Lanes + Lane. The matrix
+  // must have room for all the production samples.
+
+  void AddConsumption( const Optimization::Variables & StartTimes,
+                       double * TotalConsumption,
+                       Index Lanes, Index Lane ) const;
+
+  // The consumption of a single consumer can also be computed for a given
+  // start time. The consumption vector will be filled with the energy used
+  // in each production sample covered by the consumption, and the function
+  // returns the index of the first production sample covered. The vector will
+  // be empty if the consumption does not cover any production sample.
+
+  Index ConsumerConsumption( Index Consumer, CoSSMic::Time StartTime,
+                             std::vector< double > & Consumption ) const;
+
+  // The gradient based algorithms need the derivative of a weighted sum of
+  // the consumption in the production samples with respect to the start time
+  // of one consumer. The energy consumed in a sample is the difference of the
+  // cumulative energy at the sample time and at the previous sample time,
+  // both relative to the start time, and its derivative is therefore the
+  // difference of the power of the consumer at the previous sample time and
+  // at the sample time. The power is the slope of the kernel table segment
+  // starting at the relative time, i.e. the derivative from the right of the
+  // linear blend used for the consumption. The sample weights must be given
+  // for all production samples.
+
+  double StartTimeDerivative( Index Consumer, CoSSMic::Time StartTime,
+                              const double * SampleWeight ) const;
+
+  // The constructor takes the list of consumers and the production sample
+  // times. The consumers must have loaded their profiles before the block
+  // is constructed. The default constructor is not allowed, but a block can
+  // be copied as it contains only read-only data.
+
+  ConsumptionBlock( const std::list< Consumer > & Consumers,
+                    const SampleTime & ProductionTimes );
+
+  // A block can also be created for a subset of the consumers of another
+  // block, and the consumers of the new block are numbered in the order they
+  // appear in the given subset. An invalid argument exception is thrown if a
+  // consumer index is not in the given block.
+
+  ConsumptionBlock( const ConsumptionBlock & Other,
+                    const std::vector< Index > & Subset );
+
+  // The tables of a block do not depend on the production sample times, and
+  // a copy of another block can therefore evaluate the consumption on a
+  // different time axis, for instance a coarser grid of the production. The
+  // given time axis must cover the consumers as for the other block.
+
+  ConsumptionBlock( const ConsumptionBlock & Other,
+                    const SampleTime & ProductionTimes );
+
+  // The block can be written to a stream and read back so that the objective
+  // function of a scenario can be replayed without the consumers, as done by
+  // the algorithm benchmark. The production sample times are not written
+  // with the block, and the block must be read with the same sample times as
+  // it was written with. The block is written as the number of consumers
+  // followed by the step, the duration, the length of the table and the
+  // table values of each consumer. An invalid argument exception is thrown
+  // if the stream does not contain a valid block.
+
+  void Write( std::ostream & Output ) const;
+
+  ConsumptionBlock( std::istream & Input, const SampleTime & ProductionTimes );
+
+  ConsumptionBlock( void ) = delete;
+  ConsumptionBlock( const ConsumptionBlock & Other ) = default;
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_CONSUMPTION_BLOCK
@@ -0,0 +1,60 @@
+/*==============================================================================
+Consumption Kernel
+
+This is the implementation of the tabulation of the consumption profile.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <sstream>                           // For nicely formatted errors
+#include <stdexcept>                         // Standard exceptions
+
+#include <boost/numeric/conversion/cast.hpp> // Casting numeric types
+
+#include "ConsumptionKernel.hpp"             // The class definition
+
+// The constructor evaluates the interpolation at every full step inside the
+// consumption duration. If the duration is not a multiple of the step, the
+// last element is extrapolated from the energy at the last full step through
+// the energy at the end of the consumption so that the blend between these
+// two table values equals the linear interpolation between the last full step
+// and the end of the consumption.
+
+Dominoes::ConsumptionKernel::ConsumptionKernel( const Interpolation & Energy,
+  CoSSMic::Time ConsumptionDuration, CoSSMic::Time TableStep )
+: Table(), Step( TableStep ), Duration( ConsumptionDuration )
+{
+  if ( Step <= 0 )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The step of the consumption kernel must be at least "
+                 << "one second, and " << Step << " was given";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  const auto FullSteps = boost::numeric_cast< std::size_t >( Duration / Step );
+
+  Table.reserve( FullSteps + 2 );
+
+  for ( std::size_t i = 0; i <= FullSteps; i++ )
+    Table.push_back( Energy( boost::numeric_cast< double >(
+                     static_cast< CoSSMic::Time >( i ) * Step ) ) );
+
+  const CoSSMic::Time Remainder = Duration % Step;
+
+  if ( Remainder == 0 )
+    Table.push_back( Table.back() );
+  else
+  {
+    double LastStepEnergy = Table.back(),
+           FinalEnergy    = Energy( boost::numeric_cast< double >( Duration ) );
+
+    Table.push_back( LastStepEnergy + ( FinalEnergy - LastStepEnergy ) *
+                     static_cast< double >( Step ) /
+                     static_cast< double >( Remainder ) );
+  }
+}
@@ -0,0 +1,98 @@
+/*==============================================================================
+Consumption Kernel
+
+A consumer provides its energy consumption at the production sample times by
+evaluating the interpolated cumulative energy profile at the time elapsed since
+its assigned start time. The production sample times do not change during the
+optimisation, and since all times are whole seconds, the relative times at
+which the profile will ever be evaluated are whole seconds in the interval
+from zero to the duration of the consumption.
+
+The kernel is therefore a table of the cumulative energy computed once by the
+interpolation at a fixed step in seconds over the consumption duration. The
+energy at a relative time is then one table lookup if the relative time is a
+multiple of the step, or one linear blend between the two neighbouring table
+values otherwise. With the default step of one second the kernel returns
+exactly the values of the interpolation. A larger step, typically the
+sampling period of the production, makes the table correspondingly smaller at
+the expense of replacing the interpolation between the table values with a
+linear blend.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_CONSUMPTION_KERNEL
+#define DOMINOES_CONSUMPTION_KERNEL
+
+#include <vector>                            // Standard vectors
+
+#include "TimeInterval.hpp"                  // The CoSSMic time
+#include "Interpolation.hpp"                 // The interpolated profile
+
+namespace Dominoes {
+
+class ConsumptionKernel
+{
+private:
+
+  // The table of cumulative energies at every step from the start of the
+  // consumption. The table has one element more than needed to reach the
+  // duration, so that the blend for the relative times after the last full
+  // step will give the linear interpolation towards the energy at the end of
+  // the consumption.
+
+  std::vector< double > Table;
+
+  // The step of the table and the duration of the consumption in seconds
+
+  const CoSSMic::Time Step, Duration;
+
+public:
+
+  // The cumulative energy at a given relative time can be read from the
+  // table. Note that there is no check that the time is inside the
+  // consumption duration as this is on the hot path of the objective
+  // function, and it is the responsibility of the caller to ensure that the
+  // relative time is in the interval [0, Duration].
+
+  inline double operator() ( CoSSMic::Time RelativeTime ) const
+  {
+    const auto          Index     = RelativeTime / Step;
+    const CoSSMic::Time Remainder = RelativeTime % Step;
+
+    if ( Remainder == 0 )
+      return Table[ Index ];
+    else
+    {
+      double Fraction = static_cast< double >( Remainder ) /
+                        static_cast< double >( Step );
+
+      return Table[ Index ] + Fraction * ( Table[ Index + 1 ] - Table[ Index ] );
+    }
+  }
+
+  // Access functions for the table, the step, and the duration
+
+  inline const std::vector< double > & Values( void ) const
+  { return Table; }
+
+  inline CoSSMic::Time GetStep( void ) const
+  { return Step; }
+
+  inline CoSSMic::Time GetDuration( void ) const
+  { return Duration; }
+
+  // The constructor tabulates the given interpolated profile over the given
+  // duration. It will throw an invalid argument exception if the step is not
+  // a positive number of seconds.
+
+  ConsumptionKernel( const Interpolation & Energy,
+                     CoSSMic::Time ConsumptionDuration,
+                     CoSSMic::Time TableStep = 1 );
+
+  ConsumptionKernel( void ) = delete;
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_CONSUMPTION_KERNEL
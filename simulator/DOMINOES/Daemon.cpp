@@ -0,0 +1,831 @@
+/*==============================================================================
+Daemon
+
+This implements the daemon serving scenario requests. The Unix domain socket
+is handled by the POSIX socket interface, and a small stream buffer is used to
+read and write the socket as a standard stream so that the same code serves
+both the standard input and the socket connections.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <string>                            // Standard strings
+#include <sstream>                           // For nicely formatted errors
+#include <stdexcept>                         // Standard exceptions
+#include <iostream>                          // Standard input and output
+#include <fstream>                           // Writing result files
+#include <streambuf>                         // Socket stream buffer
+#include <algorithm>                         // Replacing characters
+#include <array>                             // Buffers
+#include <cstring>                           // Error messages
+#include <cerrno>                            // Error numbers
+#include <atomic>                            // Watching the connection
+#include <thread>                            // Watching the connection
+#include <list>                              // Connection threads
+
+#include <sys/socket.h>                      // POSIX sockets
+#include <sys/un.h>                          // Unix domain sockets
+#include <poll.h>                            // Closed connections
+#include <unistd.h>                          // Reading and closing sockets
+
+#include "Daemon.hpp"                        // The class definition
+
+/*==============================================================================
+
+ Socket stream buffer
+
+==============================================================================*/
+//
+// The stream buffer reads the socket into a fixed size input buffer when the
+// stream needs more characters, and collects the output in a fixed size
+// buffer that is written to the socket when it is full or when the stream is
+// flushed. It does not own the socket.
+
+namespace Dominoes
+{
+class SocketBuffer : public std::streambuf
+{
+private:
+
+  const int Socket;
+  std::array< char, 4096 > InputBuffer, OutputBuffer;
+
+  // Writing the buffered output makes sure that partial writes are
+  // completed. It returns false if the socket failed, and a closed socket
+  // should not raise the pipe signal terminating the daemon.
+
+  bool WriteOutput( void )
+  {
+    const char * Data = pbase();
+
+    while ( Data < pptr() )
+    {
+      ssize_t Written = ::send( Socket, Data, pptr() - Data, MSG_NOSIGNAL );
+
+      if ( Written < 0 )
+      {
+        if ( errno == EINTR ) continue;
+        return false;
+      }
+
+      Data += Written;
+    }
+
+    setp( OutputBuffer.data(), OutputBuffer.data() + OutputBuffer.size() );
+    return true;
+  }
+
+protected:
+
+  virtual int_type underflow( void ) override
+  {
+    ssize_t Received;
+
+    do
+      Received = ::read( Socket, InputBuffer.data(), InputBuffer.size() );
+    while ( ( Received < 0 ) && ( errno == EINTR ) );
+
+    if ( Received <= 0 )
+      return traits_type::eof();
+
+    setg( InputBuffer.data(), InputBuffer.data(),
+          InputBuffer.data() + Received );
+
+    return traits_type::to_int_type( *gptr() );
+  }
+
+  virtual int_type overflow( int_type Character ) override
+  {
+    if ( !WriteOutput() )
+      return traits_type::eof();
+
+    if ( !traits_type::eq_int_type( Character, traits_type::eof() ) )
+    {
+      *pptr() = traits_type::to_char_type( Character );
+      pbump(1);
+    }
+
+    return traits_type::not_eof( Character );
+  }
+
+  virtual int sync( void ) override
+  { return WriteOutput() ? 0 : -1; }
+
+public:
+
+  SocketBuffer( int TheSocket )
+  : std::streambuf(), Socket( TheSocket ), InputBuffer(), OutputBuffer()
+  {
+    setg( InputBuffer.data(), InputBuffer.data(), InputBuffer.data() );
+    setp( OutputBuffer.data(), OutputBuffer.data() + OutputBuffer.size() );
+  }
+
+  virtual ~SocketBuffer( void )
+  { sync(); }
+};
+}
+
+/*==============================================================================
+
+ Scenarios and solvers
+
+==============================================================================*/
+//
+// The scenario constructor records the modification times of the files. If
+// a file does not exist the solver constructor will fail later, but here the
+// modification time is just left at its default value.
+
+Dominoes::Daemon::Scenario::Scenario( const std::filesystem::path & Production,
+                                      const std::filesystem::path & Consumers )
+: ProductionFile( std::filesystem::absolute( Production ) ),
+  ConsumersFile(  std::filesystem::absolute( Consumers  ) ),
+  ProductionTime(), ConsumersTime()
+{
+  std::error_code Ignored;
+
+  ProductionTime = std::filesystem::last_write_time( ProductionFile, Ignored );
+  ConsumersTime  = std::filesystem::last_write_time( ConsumersFile,  Ignored );
+}
+
+// The solver of the worker is kept if it exists for the requested scenario,
+// otherwise a new solver is created. The current solver is deleted first to
+// close its consumer actors before the consumers of the new scenario are
+// created, and the actors are named by the worker so that the actors of the
+// solvers of different workers have different names. The current scenario is
+// only updated when the new solver has been successfully constructed.
+
+Dominoes::Solver &
+Dominoes::Daemon::GetSolver( unsigned int Worker, const Scenario & Requested )
+{
+  WarmSolver & Warm( Solvers.at( Worker ) );
+
+  if ( !Warm.ScenarioSolver || !( Warm.CurrentScenario == Requested ) )
+  {
+    Warm.ScenarioSolver.reset();
+
+    Warm.ScenarioSolver = std::make_unique< Solver >( Requested.ProductionFile,
+      Requested.ConsumersFile, EvaluationEngine, KernelStep,
+      "Worker" + std::to_string( Worker ) );
+
+    Solver & TheSolver( *Warm.ScenarioSolver );
+
+    TheSolver.MultiStart( NumberOfStarts, NumberOfThreads, SearchBudget );
+    TheSolver.GridEnergyInterpolation( GridInterpolation );
+    TheSolver.Decomposition( Decompose );
+    TheSolver.WarmStart( GreedyStart );
+    TheSolver.RacingPortfolio( Racing );
+    TheSolver.GradientBased( Gradient );
+    TheSolver.MultiResolution( Resolutions );
+    TheSolver.Screening( ScreeningFactor );
+    TheSolver.Instrument( Metrics );
+
+    Warm.CurrentScenario = Requested;
+  }
+
+  return *Warm.ScenarioSolver;
+}
+
+/*==============================================================================
+
+ Solving requests
+
+==============================================================================*/
+//
+// Reading a request parses the lines of the frame until the END keyword is
+// found. The deadline is counted from the time the request was received. An
+// invalid line does not stop the reading since the remaining lines of the
+// frame would then be taken as new requests, each giving an error reply.
+// Only the first error is kept, and it is thrown when the frame has been
+// read so that the client receives exactly one reply for the frame.
+
+Dominoes::Daemon::Request
+Dominoes::Daemon::ReadRequest( std::istream & Requests )
+{
+  const auto Received = Anytime::Clock::now();
+
+  Request     TheRequest{ {}, {}, {}, CoSSMic::TimeInterval(), 0,
+                          std::nullopt };
+  bool        Complete = false;
+  std::string Line, FirstError;
+
+  if ( Deadline > std::chrono::milliseconds::zero() )
+    TheRequest.Due = Received + Deadline;
+
+  while ( !Complete && std::getline( Requests, Line ) )
+  {
+    std::istringstream Fields( Line );
+    std::string        Keyword;
+
+    Fields >> Keyword;
+
+    if ( Keyword.empty() )
+      continue;
+    else if ( Keyword == "END" )
+      Complete = true;
+    else if ( Keyword == "ProductionFile" )
+      Fields >> TheRequest.ProductionFile;
+    else if ( Keyword == "Consumers" )
+      Fields >> TheRequest.ConsumersFile;
+    else if ( Keyword == "AssignedTimes" )
+      Fields >> TheRequest.ResultFile;
+    else if ( Keyword == "SunDay" )
+    {
+      CoSSMic::Time Sunrise, Sunset;
+
+      if ( Fields >> Sunrise >> Sunset )
+        TheRequest.SolarDay.assign( std::min( Sunrise, Sunset ),
+                                    std::max( Sunrise, Sunset ) );
+      else
+      {
+        std::ostringstream ErrorMessage;
+
+        ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                     << "The SunDay requires the time of sunrise and the "
+                     << "time of sunset";
+
+        if ( FirstError.empty() ) FirstError = ErrorMessage.str();
+      }
+    }
+    else if ( Keyword == "Priority" )
+    {
+      if ( !( Fields >> TheRequest.Priority ) )
+      {
+        std::ostringstream ErrorMessage;
+
+        ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                     << "The Priority must be an integer";
+
+        if ( FirstError.empty() ) FirstError = ErrorMessage.str();
+      }
+    }
+    else if ( Keyword == "Deadline" )
+    {
+      long long Milliseconds;
+
+      if ( ( Fields >> Milliseconds ) && ( Milliseconds > 0 ) )
+        TheRequest.Due = Received + std::chrono::milliseconds( Milliseconds );
+      else
+      {
+        std::ostringstream ErrorMessage;
+
+        ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                     << "The Deadline must be a positive number of "
+                     << "milliseconds";
+
+        if ( FirstError.empty() ) FirstError = ErrorMessage.str();
+      }
+    }
+    else
+    {
+      std::ostringstream ErrorMessage;
+
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "Unknown request keyword " << Keyword;
+
+      if ( FirstError.empty() ) FirstError = ErrorMessage.str();
+    }
+  }
+
+  if ( !FirstError.empty() )
+    throw std::invalid_argument( FirstError );
+
+  if ( !Complete || TheRequest.ProductionFile.empty() ||
+       TheRequest.ConsumersFile.empty() )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "A request must give both the production file and "
+                 << "the consumers file and be terminated by END";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  // The production and the consumer files are checked before the request is
+  // queued since a missing file would otherwise be reported by the CSV
+  // parser in a less readable way when the request is solved.
+
+  for ( const std::filesystem::path & FileToCheck :
+        { TheRequest.ProductionFile, TheRequest.ConsumersFile } )
+    if ( !std::filesystem::exists( FileToCheck ) )
+    {
+      std::ostringstream ErrorMessage;
+
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "The file " << FileToCheck << " does not exist";
+
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+
+  return TheRequest;
+}
+
+// The scenario is solved by a function that is called directly unless the
+// result cache is enabled. The explicit start times are always set since
+// the solver may have been used for a previous request.
+
+std::string Dominoes::Daemon::Solve( const Request & TheRequest,
+                                     unsigned int Worker,
+                                     const NL::CancellationToken & Token,
+                                     const JobQueue::Deadline & Due )
+{
+  auto SolveScenario = [&](
+       const std::optional< std::vector< CoSSMic::Time > > & NearbyStart ){
+    std::ostringstream Result;
+
+    Solver & TheSolver( GetSolver( Worker,
+      Scenario( TheRequest.ProductionFile, TheRequest.ConsumersFile ) ) );
+
+    if ( Due )
+      TheSolver.SolutionDeadline( *Due );
+    else
+      TheSolver.ClearDeadline();
+
+    TheSolver.StartFrom( NearbyStart ? *NearbyStart
+                                     : std::vector< CoSSMic::Time >() );
+    TheSolver.CancelWith( Token );
+
+    const std::size_t EvaluationsBefore = TheSolver.NumberOfEvaluations();
+    const auto        Started           = Anytime::Clock::now();
+
+    TheSolver.AssignStartTimes( Result, TheRequest.SolarDay );
+
+    SolverEvaluations->Add( TheSolver.NumberOfEvaluations() - EvaluationsBefore );
+    SolutionTime->Observe( std::chrono::duration< double >(
+                           Anytime::Clock::now() - Started ).count() );
+
+    if ( Metrics && !TheRequest.ResultFile.empty() )
+    {
+      std::ofstream Report( Instrumentation::ReportFile( TheRequest.ResultFile ) );
+
+      TheSolver.WriteMetrics( Report );
+    }
+
+    return Result.str();
+  };
+
+  const std::string ResultLines( Cache.IsEnabled()
+    ? Cache.Solve( ResultCache::ScenarioKey( TheRequest.ProductionFile,
+                   TheRequest.ConsumersFile, KernelStep, GridInterpolation,
+                   TheRequest.SolarDay ), SolveScenario ).first
+    : SolveScenario( std::nullopt ) );
+
+  if ( !TheRequest.ResultFile.empty() )
+    std::ofstream( TheRequest.ResultFile ) << ResultLines;
+
+  return ResultLines;
+}
+
+// Submitting a request to the queue binds the request to the solve function
+
+Dominoes::JobQueue::JobID
+Dominoes::Daemon::Submit( const Request & TheRequest,
+                          const NL::CancellationToken & Token )
+{
+  return Jobs.Submit( [this, TheRequest]( unsigned int Worker,
+                        const NL::CancellationToken & JobToken,
+                        const JobQueue::Deadline & Due ){
+                        return Solve( TheRequest, Worker, JobToken, Due ); },
+                      TheRequest.Priority, TheRequest.Due, Token );
+}
+
+/*==============================================================================
+
+ Serving requests
+
+==============================================================================*/
+//
+// A completed job is replied with the result lines preceded by their count,
+// and a job that did not complete is replied as an error with the message
+// forced onto a single line to keep the framing.
+
+void Dominoes::Daemon::Reply( std::ostream & Replies, JobQueue::JobID Number,
+                              const JobQueue::Outcome & Result )
+{
+  switch ( Result.Status )
+  {
+    case JobQueue::State::Completed:
+      Replies << "RESULT "
+              << std::count( Result.Result.begin(), Result.Result.end(), '\n' )
+              << '\n' << Result.Result << std::flush;
+      break;
+    case JobQueue::State::Queued:
+    case JobQueue::State::Running:
+      Replies << "PENDING " << Number << ' '
+              << JobQueue::StateName( Result.Status ) << std::endl;
+      break;
+    default:
+      {
+        std::string Message( Result.Result );
+
+        std::replace( Message.begin(), Message.end(), '\n', ' ' );
+        Replies << "ERROR " << Message << std::endl;
+      }
+      break;
+  }
+}
+
+// Serving the requests reads the first line of each frame. A rejected job is
+// replied as busy, and any other error is returned as an error reply.
+
+bool Dominoes::Daemon::Serve( std::istream & Requests, std::ostream & Replies,
+                              const NL::CancellationToken & ClientGone )
+{
+  std::string Line;
+
+  // The job number of the single line requests is read by a small helper
+  // throwing if it is missing.
+
+  auto JobNumber = []( std::istringstream & Fields ){
+    JobQueue::JobID Number;
+
+    if ( !( Fields >> Number ) )
+    {
+      std::ostringstream ErrorMessage;
+
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "The request must give the job number";
+
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+
+    return Number;
+  };
+
+  while ( std::getline( Requests, Line ) )
+  {
+    std::istringstream Fields( Line );
+    std::string        Keyword;
+
+    Fields >> Keyword;
+
+    if ( Keyword.empty() )
+      continue;
+    else if ( Keyword == "QUIT" )
+      return true;
+
+    try
+    {
+      if ( Keyword == "SOLVE" )
+      {
+        JobQueue::JobID Number = Submit( ReadRequest( Requests ), ClientGone );
+
+        Reply( Replies, Number, Jobs.Wait( Number ) );
+      }
+      else if ( Keyword == "SUBMIT" )
+        Replies << "JOB "
+                << Submit( ReadRequest( Requests ), NL::CancellationToken() )
+                << std::endl;
+      else if ( Keyword == "WAIT" )
+      {
+        JobQueue::JobID Number = JobNumber( Fields );
+
+        Reply( Replies, Number, Jobs.Wait( Number ) );
+      }
+      else if ( Keyword == "POLL" )
+      {
+        JobQueue::JobID Number = JobNumber( Fields );
+
+        Reply( Replies, Number, Jobs.Poll( Number ) );
+      }
+      else if ( Keyword == "CANCEL" )
+      {
+        JobQueue::JobID Number = JobNumber( Fields );
+
+        if ( Jobs.Cancel( Number ) )
+          Replies << "CANCELLED " << Number << std::endl;
+        else
+        {
+          std::ostringstream ErrorMessage;
+
+          ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                       << "The job " << Number << " is not queued or running";
+
+          throw std::invalid_argument( ErrorMessage.str() );
+        }
+      }
+      else if ( Keyword == "STATUS" )
+      {
+        const JobQueue::Statistics Status( Jobs.Metrics() );
+
+        Replies << "STATUS Workers "   << Status.Workers
+                << " Queued "          << Status.Queued
+                << " Running "         << Status.Running
+                << " Unfetched "       << Status.Unfetched
+                << " MaximalQueued "   << Status.MaximalQueued
+                << " Completed "       << Status.Completed
+                << " Failed "          << Status.Failed
+                << " Cancelled "       << Status.Cancelled
+                << " Expired "         << Status.Expired
+                << " Rejected "        << Status.Rejected
+                << " MeanWait "        << Status.MeanWait.count()
+                << " MeanService "     << Status.MeanService.count()
+                << std::endl;
+      }
+      else
+      {
+        std::ostringstream ErrorMessage;
+
+        ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                     << "A request must start with SOLVE, SUBMIT, WAIT, POLL, "
+                     << "CANCEL or STATUS and not " << Keyword;
+
+        throw std::invalid_argument( ErrorMessage.str() );
+      }
+    }
+    catch ( JobQueue::Rejected & Busy )
+    {
+      std::string Message( Busy.what() );
+
+      std::replace( Message.begin(), Message.end(), '\n', ' ' );
+      Replies << "BUSY " << Message << std::endl;
+    }
+    catch ( std::exception & Error )
+    {
+      std::string Message( Error.what() );
+
+      std::replace( Message.begin(), Message.end(), '\n', ' ' );
+      Replies << "ERROR " << Message << std::endl;
+    }
+  }
+
+  return false;
+}
+
+/*==============================================================================
+
+ Metrics
+
+==============================================================================*/
+//
+// The statistics of the job queue are written as gauges for the jobs in each
+// state and counters for the finished jobs by their outcome.
+
+void Dominoes::Daemon::WriteQueueMetrics( std::ostream & Output )
+{
+  using Theron::MetricsExporter;
+
+  const JobQueue::Statistics Status( Jobs.Metrics() );
+
+  MetricsExporter::WriteFamily( Output, "dominoes_workers", "gauge",
+                                "Workers solving the requests" );
+  MetricsExporter::WriteSample( Output, "dominoes_workers", {},
+                                Status.Workers );
+
+  MetricsExporter::WriteFamily( Output, "dominoes_jobs", "gauge",
+                                "Jobs in the queue by their state" );
+
+  for ( const auto & [ State, Number ] :
+        { std::make_pair( "queued",    Status.Queued    ),
+          std::make_pair( "running",   Status.Running   ),
+          std::make_pair( "unfetched", Status.Unfetched ) } )
+    MetricsExporter::WriteSample( Output, "dominoes_jobs",
+                                  { { "state", State } }, Number );
+
+  MetricsExporter::WriteFamily( Output, "dominoes_jobs_maximal_queued",
+                                "gauge", "Largest number of queued jobs" );
+  MetricsExporter::WriteSample( Output, "dominoes_jobs_maximal_queued", {},
+                                Status.MaximalQueued );
+
+  MetricsExporter::WriteFamily( Output, "dominoes_jobs_total", "counter",
+                                "Jobs finished or rejected by their outcome" );
+
+  for ( const auto & [ Outcome, Number ] :
+        { std::make_pair( "completed", Status.Completed ),
+          std::make_pair( "failed",    Status.Failed    ),
+          std::make_pair( "cancelled", Status.Cancelled ),
+          std::make_pair( "expired",   Status.Expired   ),
+          std::make_pair( "rejected",  Status.Rejected  ) } )
+    MetricsExporter::WriteSample( Output, "dominoes_jobs_total",
+                                  { { "outcome", Outcome } }, Number );
+
+  MetricsExporter::WriteFamily( Output, "dominoes_job_mean_wait_seconds",
+                                "gauge", "Mean time a job waits in the queue" );
+  MetricsExporter::WriteSample( Output, "dominoes_job_mean_wait_seconds", {},
+                                Status.MeanWait.count() * 1e-3 );
+
+  MetricsExporter::WriteFamily( Output, "dominoes_job_mean_service_seconds",
+                                "gauge", "Mean time a worker serves a job" );
+  MetricsExporter::WriteSample( Output, "dominoes_job_mean_service_seconds",
+                                {}, Status.MeanService.count() * 1e-3 );
+}
+
+/*==============================================================================
+
+ Running
+
+==============================================================================*/
+//
+// Serving the standard input is trivial as there is no way to tell if the
+// client is gone.
+
+void Dominoes::Daemon::Run( void )
+{
+  Serve( std::cin, std::cout, NL::CancellationToken() );
+}
+
+// Serving the socket requires that the socket is created and bound to the
+// given path. Any old socket file is removed first. Then connections are
+// accepted and each connection is served by its own thread until a QUIT
+// request has been received on one of them. A connection is watched by a
+// thread while it is served, and the SOLVE requests of the connection are
+// cancelled if the client closes the connection. Only a hang-up counts as
+// closed since a client may shut down its side for writing after sending the
+// request and still wait for the reply.
+//
+// The thread of the connection receiving the QUIT shuts down the listening
+// socket so that the accept returns. The jobs are then cancelled so that no
+// connection thread waits for a result, and the remaining connections are
+// shut down so that their threads stop reading. The sockets of the
+// connections are only closed when their threads have been joined so that a
+// socket number is not reused while a thread may still use it.
+
+void Dominoes::Daemon::Run( const std::filesystem::path & SocketName )
+{
+  sockaddr_un Address{};
+
+  Address.sun_family = AF_UNIX;
+
+  if ( SocketName.native().size() >= sizeof( Address.sun_path ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The socket name " << SocketName << " is too long";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  SocketName.native().copy( Address.sun_path, sizeof( Address.sun_path ) - 1 );
+
+  std::filesystem::remove( SocketName );
+
+  int Listener = ::socket( AF_UNIX, SOCK_STREAM, 0 );
+
+  if ( ( Listener < 0 ) ||
+       ( ::bind( Listener, reinterpret_cast< sockaddr * >( &Address ),
+                 sizeof( Address ) ) < 0 ) ||
+       ( ::listen( Listener, SOMAXCONN ) < 0 ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "Could not listen on the socket " << SocketName
+                 << ": " << std::strerror( errno );
+
+    if ( Listener >= 0 ) ::close( Listener );
+
+    throw std::runtime_error( ErrorMessage.str() );
+  }
+
+  class Connection
+  {
+  public:
+
+    const int           Socket;
+    std::atomic< bool > Served;
+    std::thread         Server;
+
+    Connection( int TheSocket )
+    : Socket( TheSocket ), Served( false ), Server()
+    {}
+  };
+
+  std::list< Connection > Connections;
+  std::atomic< bool >     Terminate( false );
+
+  auto ServeConnection = [&]( Connection & Client ){
+    NL::CancellationToken ClientGone;
+    std::atomic< bool >   Done( false );
+
+    std::thread Watcher( [&](void){
+      pollfd Peer{ Client.Socket, 0, 0 };
+
+      while ( !Done )
+        if ( ( ::poll( &Peer, 1, 100 ) > 0 ) &&
+             ( Peer.revents & ( POLLHUP | POLLERR ) ) )
+        {
+          ClientGone.Cancel();
+          break;
+        }
+    });
+
+    {
+      SocketBuffer Buffer( Client.Socket );
+      std::istream Requests( &Buffer );
+      std::ostream Replies( &Buffer );
+
+      if ( Serve( Requests, Replies, ClientGone ) )
+      {
+        Terminate = true;
+        ::shutdown( Listener, SHUT_RDWR );
+      }
+    }
+
+    Done = true;
+    Watcher.join();
+
+    Client.Served = true;
+  };
+
+  while ( !Terminate )
+  {
+    int Socket = ::accept( Listener, nullptr, nullptr );
+
+    if ( Socket < 0 )
+    {
+      if ( ( errno == EINTR ) && !Terminate ) continue;
+      else break;
+    }
+
+    for ( auto Client = Connections.begin(); Client != Connections.end(); )
+      if ( Client->Served )
+      {
+        Client->Server.join();
+        ::close( Client->Socket );
+        Client = Connections.erase( Client );
+      }
+      else
+        ++Client;
+
+    if ( Terminate )
+    {
+      ::close( Socket );
+      break;
+    }
+
+    Connection & NewClient( Connections.emplace_back( Socket ) );
+
+    NewClient.Server = std::thread( ServeConnection, std::ref( NewClient ) );
+  }
+
+  Jobs.Close();
+
+  for ( Connection & Client : Connections )
+    ::shutdown( Client.Socket, SHUT_RDWR );
+
+  for ( Connection & Client : Connections )
+  {
+    Client.Server.join();
+    ::close( Client.Socket );
+  }
+
+  ::close( Listener );
+  std::filesystem::remove( SocketName );
+}
+
+/*==============================================================================
+
+ Constructor
+
+==============================================================================*/
+//
+// There is one warm solver for each worker, and the number of workers of the
+// job queue is therefore taken from the number of warm solvers.
+
+Dominoes::Daemon::Daemon( CommandLineOptions & Options )
+: EvaluationEngine( Options.EvaluationEngine() ),
+  KernelStep( Options.ProfileStep() ),
+  NumberOfStarts( Options.NumberOfStarts() ),
+  NumberOfThreads( Options.NumberOfThreads() ),
+  ScreeningFactor( Options.Screening() ),
+  SearchBudget( Options.SearchBudget() ),
+  GridInterpolation( Options.GridEnergyInterpolation() ),
+  Deadline( Options.SolutionDeadline() ),
+  Decompose( Options.Decomposition() ), GreedyStart( Options.WarmStart() ),
+  Racing( Options.RacingPortfolio() ), Gradient( Options.GradientBased() ),
+  Metrics( Options.MetricsReport() ),
+  Resolutions( Options.MultiResolution() ),
+  Solvers( Options.NumberOfWorkers() > 0 ? Options.NumberOfWorkers()
+           : std::max( 1U, std::thread::hardware_concurrency() ) ),
+  Cache( Options.CacheEntries(), Options.CacheDirectory() ),
+  Jobs( static_cast< unsigned int >( Solvers.size() ), Options.QueueDepth() ),
+  SolverEvaluations( Theron::MetricsExporter::NewCounter(
+    "dominoes_solver_evaluations_total",
+    "Objective function evaluations used to solve the requests" ) ),
+  SolutionTime( Theron::MetricsExporter::NewHistogram(
+    "dominoes_solution_seconds", "Time taken by a worker to solve a request" ) ),
+  QueueCollector( 0 ), Exporter()
+{
+  if ( Options.MetricsPort() > 0 )
+  {
+    Theron::Actor::EnableMetrics();
+
+    QueueCollector = Theron::MetricsExporter::AddCollector(
+      [this]( std::ostream & Output ){ WriteQueueMetrics( Output ); } );
+
+    Exporter = std::make_unique< Theron::MetricsExporter >(
+                 Options.MetricsPort() );
+  }
+}
+
+// The collector must be removed while the job queue still exists
+
+Dominoes::Daemon::~Daemon( void )
+{
+  Exporter.reset();
+
+  if ( QueueCollector != 0 )
+    Theron::MetricsExporter::RemoveCollector( QueueCollector );
+}
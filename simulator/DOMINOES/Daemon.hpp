@@ -0,0 +1,291 @@
+/*==============================================================================
+Daemon
+
+Running the simulator once for every scenario means that each scenario pays
+for starting the process, creating the actors, one thread per consumer, and
+reading all the CSV files. For small scenarios this start-up cost dominates the
+time used by the optimisation. The daemon is therefore a long running server
+mode of the simulator that reads scenarios as framed requests from the standard
+input, or from the connections to a Unix domain socket, and returns the
+assigned start times as framed replies on the same channel.
+
+A request is a sequence of text lines, where the first line is the keyword
+SOLVE and the last line is the keyword END. In between there are lines with a
+keyword followed by its value(s) separated by spaces:
+
+SOLVE
+ProductionFile <CSV>             = CSV time series for the production
+Consumers <CSV>                  = CSV file defining the consumers
+SunDay <sunrise> <sunset>        = Optional duration of the solar day
+AssignedTimes <name>             = Optional file to also store the result
+Priority <integer>               = Optional priority, default 0
+Deadline <milliseconds>          = Optional deadline for this request
+END
+
+The file names are relative to the working directory of the daemon unless they
+are given as absolute paths. The reply to a successful request is a line with
+the keyword RESULT followed by the number of lines that follows, and then the
+lines exactly as they would have been written to the assigned start time file:
+
+RESULT <N>
+Total grid energy <value>
+<Consumer ID string> <Assigned start time in POSIX seconds>
+...
+
+The deadline is counted from the receipt of the request, and if it is not
+given in the request the deadline given on the command line is used. The
+total grid energy line reads "Total grid energy (partial) <value>" if the
+deadline stopped the search before it converged.
+
+The requests are solved by a pool of workers taking the requests from a job
+queue as described in the Job Queue header. The number of workers is given on
+the command line, and it defaults to one worker per core. The requests of
+higher priority are solved first, and then the requests with the earliest
+deadline. A SOLVE request waits for its result, but a request can also be
+submitted to the queue by a frame starting with the keyword SUBMIT instead of
+SOLVE. The reply is then sent immediately as a single line with the number of
+the job:
+
+JOB <job number>
+
+The result of a submitted job is fetched by one of the following single line
+requests, and the result is forgotten once it has been returned:
+
+WAIT <job number>                = Reply with the result when it is ready
+POLL <job number>                = Reply with the result or "PENDING <job
+                                   number> Queued|Running" if it is not ready
+CANCEL <job number>              = Reply "CANCELLED <job number>" if the job
+                                   was queued or running
+
+The line STATUS gives a single line reply with the statistics of the queue:
+
+STATUS Workers <n> Queued <n> Running <n> Unfetched <n> MaximalQueued <n>
+       Completed <n> Failed <n> Cancelled <n> Expired <n> Rejected <n>
+       MeanWait <ms> MeanService <ms>
+
+If the queue depth is limited on the command line, and the queue is full, a
+SOLVE or SUBMIT request is rejected at once with a single line reply with the
+keyword BUSY followed by an explanation, and the client should try again
+later. A job whose deadline passes while it is still queued is not started.
+
+If the instrumentation is enabled on the command line and the request gives
+the file for the assigned times, the instrumentation report of the solver is
+written next to this file with the extension ".metrics.json".
+
+If a metrics port is given on the command line, the daemon serves its
+metrics for Prometheus over HTTP on that port as described in the Metrics
+Exporter header of Theron++: the evaluations used by the solvers, a histogram
+of the time taken to solve the requests, the state of the job queue with the
+jobs counted by their outcome, the mailbox depths and message rates of the
+actors, and the resident memory of the daemon.
+
+If the request could not be served, the reply is a single line with the
+keyword ERROR followed by the error message. A malformed frame is read up to
+its END line before it is rejected, and it receives one ERROR reply for the
+first error found. A line with the keyword QUIT terminates the daemon, and an
+empty line between frames is ignored.
+
+Each worker keeps the solver of the last scenario it solved alive together
+with its consumer actors, their threads and their loaded profiles. If the
+next request taken by the worker is for the same production and consumer
+files, and the files have not been modified since the solver was created, the
+warm solver is used for a new optimisation. Otherwise the old solver is closed
+and a new one is created.
+
+If the result cache is enabled on the command line, a request for a scenario
+already solved is answered from the cache without using a solver, and the
+solver for a new scenario starts from the start times of a nearby scenario if
+one has been solved. No instrumentation report is written for a cached result.
+The cache is shared by the workers.
+
+The connections to the socket are served concurrently, each by its own
+thread, so a client waiting for a result does not hold back the other
+clients. A client connected to the socket may give up and close the
+connection before its SOLVE request has been solved. The connection is
+therefore watched while it is served, and if it is closed the job is
+cancelled so that the worker is ready for the next job without finishing a
+solution nobody will read. Submitted jobs are not cancelled when the
+connection closes since their results can be fetched over another connection.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_DAEMON
+#define DOMINOES_DAEMON
+
+#include <filesystem>                        // File names
+#include <istream>                           // Reading requests
+#include <ostream>                           // Writing replies
+#include <memory>                            // Smart pointers
+#include <chrono>                            // Time budget
+#include <vector>                            // Worker solvers
+
+#include "TimeInterval.hpp"                  // CoSSMic Time
+#include "Solver.hpp"                        // The Dominoes solver
+#include "CommandOptions.hpp"                // The solver parameters
+#include "ResultCache.hpp"                   // Results of solved scenarios
+#include "JobQueue.hpp"                      // Solving requests concurrently
+#include "NonLinear/Cancellation.hpp"        // Closed connections
+#include "Utility/MetricsExporter.hpp"       // Serving metrics over HTTP
+
+namespace Dominoes {
+
+class Daemon
+{
+private:
+
+  // The evaluation engine, the kernel step, the multi-start parameters and
+  // the grid energy interpolation, the decomposition, the multi-resolution
+  // and the instrumentation are given on the command line and used for all
+  // solvers created by the daemon. The deadline is counted from the receipt
+  // of each request unless the request gives its own deadline, and zero
+  // means no deadline.
+
+  const Solver::Evaluation        EvaluationEngine;
+  const CoSSMic::Time             KernelStep;
+  const unsigned int              NumberOfStarts, NumberOfThreads,
+                                  ScreeningFactor;
+  const std::chrono::seconds      SearchBudget;
+  const Interpolation::Type       GridInterpolation;
+  const std::chrono::milliseconds Deadline;
+  const bool                      Decompose, GreedyStart, Racing, Gradient,
+                                  Metrics;
+  const std::vector< CoSSMic::Time > Resolutions;
+
+  // The scenario is identified by the two files and the time they were last
+  // written. Two scenarios are the same only if all these are equal.
+
+  class Scenario
+  {
+  public:
+
+    std::filesystem::path           ProductionFile, ConsumersFile;
+    std::filesystem::file_time_type ProductionTime, ConsumersTime;
+
+    inline bool operator== ( const Scenario & Other ) const
+    {
+      return ( ProductionFile == Other.ProductionFile ) &&
+             ( ConsumersFile  == Other.ConsumersFile  ) &&
+             ( ProductionTime == Other.ProductionTime ) &&
+             ( ConsumersTime  == Other.ConsumersTime  );
+    }
+
+    Scenario( const std::filesystem::path & Production,
+              const std::filesystem::path & Consumers );
+    Scenario( void ) = default;
+    Scenario( const Scenario & Other ) = default;
+    Scenario & operator= ( const Scenario & Other ) = default;
+  };
+
+  // A request read from a SOLVE or SUBMIT frame
+
+  class Request
+  {
+  public:
+
+    std::filesystem::path      ProductionFile, ConsumersFile, ResultFile;
+    CoSSMic::TimeInterval      SolarDay;
+    int                        Priority;
+    JobQueue::Deadline         Due;
+  };
+
+  // Each worker keeps the solver for the last scenario it solved together
+  // with the identification of the scenario. The solvers are only used by
+  // their workers and need no protection.
+
+  class WarmSolver
+  {
+  public:
+
+    Scenario                  CurrentScenario;
+    std::unique_ptr< Solver > ScenarioSolver;
+  };
+
+  std::vector< WarmSolver > Solvers;
+
+  // The results of the scenarios solved are cached if this is enabled, and
+  // the cache is shared by the workers.
+
+  ResultCache Cache;
+
+  // The job queue with the workers. It is declared after the solvers so
+  // that the workers have terminated before the solvers are destroyed.
+
+  JobQueue Jobs;
+
+  // The exported metrics are updated by the workers, and the statistics of
+  // the job queue are written by a collector when the metrics are served.
+  // The exporter is declared after the job queue, and the collector is
+  // removed by the destructor before the queue is destroyed.
+
+  std::shared_ptr< Theron::MetricsExporter::Counter >   SolverEvaluations;
+  std::shared_ptr< Theron::MetricsExporter::Histogram > SolutionTime;
+  Theron::MetricsExporter::CollectorID                  QueueCollector;
+  std::unique_ptr< Theron::MetricsExporter >            Exporter;
+
+  void WriteQueueMetrics( std::ostream & Output );
+
+  // There is a function to return the solver of a worker for a given
+  // scenario, creating it if it is different from the worker's current
+  // scenario.
+
+  Solver & GetSolver( unsigned int Worker, const Scenario & Requested );
+
+  // Reading a request parses the lines of the frame after the SOLVE or the
+  // SUBMIT keyword. It throws an invalid argument exception if the request
+  // is malformed or the files do not exist, but only after the whole frame
+  // has been read so that no job is submitted for a part of the frame.
+
+  Request ReadRequest( std::istream & Requests );
+
+  // Solving a request is the work of its job, and it returns the result
+  // lines.
+
+  std::string Solve( const Request & TheRequest, unsigned int Worker,
+                     const NL::CancellationToken & Token,
+                     const JobQueue::Deadline & Due );
+
+  // Submitting a request returns the job number, and the token is cancelled
+  // if the client is no longer interested in the result.
+
+  JobQueue::JobID Submit( const Request & TheRequest,
+                          const NL::CancellationToken & Token );
+
+  // The outcome of a job is written as a reply
+
+  static void Reply( std::ostream & Replies, JobQueue::JobID Number,
+                     const JobQueue::Outcome & Result );
+
+  // The requests are read from a stream until the stream is exhausted or
+  // the QUIT keyword is received. The token is cancelled when the client of
+  // the stream is gone. The function returns true if the daemon should
+  // terminate.
+
+  bool Serve( std::istream & Requests, std::ostream & Replies,
+              const NL::CancellationToken & ClientGone );
+
+public:
+
+  // The daemon can either serve the standard input and output, or it can
+  // listen for connections on a Unix domain socket whose path is given. In
+  // the latter case each connection is served by its own thread, and the
+  // socket file is removed when the daemon terminates. A runtime error
+  // exception is thrown if the socket could not be created.
+
+  void Run( void );
+  void Run( const std::filesystem::path & SocketName );
+
+  // The constructor takes the parameters for the solvers, the number of
+  // workers and the queue depth from the command line options.
+
+  Daemon( CommandLineOptions & Options );
+
+  Daemon( void ) = delete;
+  Daemon( const Daemon & Other ) = delete;
+
+  ~Daemon( void );
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_DAEMON
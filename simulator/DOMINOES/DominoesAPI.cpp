@@ -0,0 +1,219 @@
+/*==============================================================================
+Dominoes API
+
+This implements the C interface by converting the arrays to the in-memory
+problem of the solver, and by converting the exceptions of the solver to
+status codes and error messages since exceptions cannot pass the C interface.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <string>                            // Standard strings
+#include <vector>                            // The in-memory problem
+#include <chrono>                            // Budget and deadline
+#include <atomic>                            // Unique scenario names
+#include <algorithm>                         // Copying the start times
+#include <cstring>                           // Copying the error message
+#include <sstream>                           // For nicely formatted errors
+#include <stdexcept>                         // Standard exceptions
+
+#include "Solver.hpp"                        // The solver
+#include "DominoesAPI.h"                     // The C interface
+
+namespace Dominoes {
+
+// The actor names of the consumers must be unique, and since several calls
+// may run concurrently, each call has its own scenario name made unique by
+// a counter.
+
+static std::atomic< unsigned long > CallCounter(0);
+
+// The error message is copied to the caller's buffer if it is given
+
+static void ReportError( const char * Message, char * ErrorMessage,
+                         std::size_t ErrorLength )
+{
+  if ( ( ErrorMessage != nullptr ) && ( ErrorLength > 0 ) )
+  {
+    std::strncpy( ErrorMessage, Message, ErrorLength - 1 );
+    ErrorMessage[ ErrorLength - 1 ] = '\0';
+  }
+}
+
+// The arguments are checked before they are converted to the in-memory
+// problem, and the pointers that must be given cannot be null.
+
+static void CheckArguments( const DominoesTime * ProductionTimes,
+                            const double * ProductionEnergy,
+                            std::size_t ProductionLength,
+                            const DominoesConsumer * Consumers,
+                            std::size_t NumberOfConsumers,
+                            const DominoesTime * StartTimes )
+{
+  std::ostringstream ErrorMessage;
+
+  if ( ( ProductionTimes == nullptr ) || ( ProductionEnergy == nullptr ) ||
+       ( ProductionLength == 0 ) )
+    ErrorMessage << "The production series must be given";
+  else if ( ( Consumers == nullptr ) || ( NumberOfConsumers == 0 ) )
+    ErrorMessage << "There must be at least one consumer";
+  else if ( StartTimes == nullptr )
+    ErrorMessage << "The start time buffer must be given";
+  else
+    for ( std::size_t i = 0; i < NumberOfConsumers; i++ )
+      if ( ( Consumers[i].ID == nullptr ) ||
+           ( Consumers[i].ProfileTimes == nullptr ) ||
+           ( Consumers[i].ProfileEnergy == nullptr ) ||
+           ( Consumers[i].ProfileLength == 0 ) )
+      {
+        ErrorMessage << "Consumer " << i << " must have an ID and a profile";
+        break;
+      }
+      else if ( Consumers[i].EarliestStart > Consumers[i].LatestStart )
+      {
+        ErrorMessage << "Consumer " << Consumers[i].ID << " has the earliest "
+                     << "start time " << Consumers[i].EarliestStart
+                     << " after the latest start time "
+                     << Consumers[i].LatestStart;
+        break;
+      }
+
+  if ( !ErrorMessage.str().empty() )
+  {
+    std::ostringstream Error;
+
+    Error << __FILE__ << " at line " << __LINE__ << ": " << ErrorMessage.str();
+
+    throw std::invalid_argument( Error.str() );
+  }
+}
+
+}      // End name space Dominoes
+
+/*==============================================================================
+
+ C interface
+
+==============================================================================*/
+//
+// The default options are those of the simulator without options
+
+void DominoesDefaultOptions( DominoesOptions * Options )
+{
+  if ( Options == nullptr ) return;
+
+  Options->InProcessEvaluation  = 0;
+  Options->KernelStep           = 1;
+  Options->Starts               = 1;
+  Options->Threads              = 0;
+  Options->BudgetSeconds        = 0;
+  Options->DeadlineMilliseconds = 0;
+  Options->Decompose            = 0;
+  Options->WarmStart            = 0;
+  Options->LinearGridEnergy     = 0;
+  Options->Sunrise              = 0;
+  Options->Sunset               = 0;
+}
+
+// The solver function constructs the in-memory problem and the solver, and
+// then sets up the solver as the simulator does from the command line
+// options. The deadline is counted from the start of the call.
+
+int DominoesSolve( const DominoesTime * ProductionTimes,
+                   const double * ProductionEnergy, size_t ProductionLength,
+                   const DominoesConsumer * Consumers, size_t NumberOfConsumers,
+                   const DominoesOptions * Options,
+                   DominoesTime * StartTimes, double * GridEnergy,
+                   char * ErrorMessage, size_t ErrorLength )
+{
+  const auto Started = Dominoes::Anytime::Clock::now();
+
+  try
+  {
+    DominoesOptions Settings;
+
+    if ( Options == nullptr )
+      DominoesDefaultOptions( &Settings );
+    else
+      Settings = *Options;
+
+    Dominoes::CheckArguments( ProductionTimes, ProductionEnergy,
+                              ProductionLength, Consumers, NumberOfConsumers,
+                              StartTimes );
+
+    std::vector< Dominoes::Solver::ConsumerEvent > Events;
+
+    Events.reserve( NumberOfConsumers );
+
+    for ( std::size_t i = 0; i < NumberOfConsumers; i++ )
+    {
+      Dominoes::Consumer::LoadProfile Profile;
+
+      for ( std::size_t Point = 0; Point < Consumers[i].ProfileLength; Point++ )
+        Profile.emplace( Consumers[i].ProfileTimes[ Point ],
+                         Consumers[i].ProfileEnergy[ Point ] );
+
+      Events.push_back( Dominoes::Solver::ConsumerEvent{ Consumers[i].ID,
+                        Consumers[i].EarliestStart, Consumers[i].LatestStart,
+                        std::move( Profile ) } );
+    }
+
+    Dominoes::Solver TheSolver(
+      std::vector< CoSSMic::Time >( ProductionTimes,
+                                    ProductionTimes + ProductionLength ),
+      std::vector< double >( ProductionEnergy,
+                             ProductionEnergy + ProductionLength ),
+      Events,
+      Settings.InProcessEvaluation ? Dominoes::Solver::Evaluation::InProcess
+                                   : Dominoes::Solver::Evaluation::Actors,
+      Settings.KernelStep,
+      "DominoesAPI" + std::to_string( ++Dominoes::CallCounter ) );
+
+    TheSolver.MultiStart( Settings.Starts, Settings.Threads,
+                          std::chrono::seconds( Settings.BudgetSeconds ) );
+    TheSolver.GridEnergyInterpolation( Settings.LinearGridEnergy
+                                       ? Interpolation::Type::Linear
+                                       : Interpolation::Type::SteffenMethod );
+    TheSolver.Decomposition( Settings.Decompose != 0 );
+    TheSolver.WarmStart( Settings.WarmStart != 0 );
+
+    if ( Settings.DeadlineMilliseconds > 0 )
+      TheSolver.SolutionDeadline( Started +
+                std::chrono::milliseconds( Settings.DeadlineMilliseconds ) );
+
+    CoSSMic::TimeInterval SolarDay;
+
+    if ( Settings.Sunrise != Settings.Sunset )
+      SolarDay.assign( std::min( Settings.Sunrise, Settings.Sunset ),
+                       std::max( Settings.Sunrise, Settings.Sunset ) );
+
+    Dominoes::Solver::Assignment Solution(
+                                 TheSolver.OptimalAssignment( SolarDay ) );
+
+    std::copy( Solution.StartTimes.begin(), Solution.StartTimes.end(),
+               StartTimes );
+
+    if ( GridEnergy != nullptr )
+      *GridEnergy = Solution.GridEnergy;
+
+    Dominoes::ReportError( "", ErrorMessage, ErrorLength );
+
+    return Solution.Partial ? DOMINOES_PARTIAL : DOMINOES_SOLVED;
+  }
+  catch ( const std::invalid_argument & Error )
+  {
+    Dominoes::ReportError( Error.what(), ErrorMessage, ErrorLength );
+    return DOMINOES_INVALID_ARGUMENT;
+  }
+  catch ( const std::exception & Error )
+  {
+    Dominoes::ReportError( Error.what(), ErrorMessage, ErrorLength );
+    return DOMINOES_FAILURE;
+  }
+  catch (...)
+  {
+    Dominoes::ReportError( "Unknown error", ErrorMessage, ErrorLength );
+    return DOMINOES_FAILURE;
+  }
+}
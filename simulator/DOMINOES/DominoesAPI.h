@@ -0,0 +1,132 @@
+/*==============================================================================
+Dominoes API
+
+The solver can be embedded in other applications through this C interface,
+which is compiled into the shared library libdominoes. The standard simulator
+reads the production and the consumer events from CSV files and writes the
+assigned start times to a result file, and an application using the simulator
+must therefore write the files, start the simulator and read the result file
+back. The library function instead takes the production series and the
+consumer profiles as arrays in memory, and writes the assigned start times to
+a buffer provided by the caller, so that there is no file system involved.
+The interface is a plain C interface since the stable C binary interface can
+be used from any language, for instance a Node add-on or a C++ service
+compiled with a different compiler.
+
+The production is given as at least two sample times in POSIX seconds in
+increasing order and the produced energy at each sample time, with the same
+meaning as the two columns of the production file. Each consumer is given as
+its ID, the earliest and latest start time in POSIX seconds, and the
+consumption profile as the cumulative energy at relative times starting from
+zero, with the same meaning as the two columns of a consumption profile file.
+All the arrays are read only during the call and are not retained by the
+library.
+
+The start times are written to the caller's buffer which must have room for
+one start time per consumer, and the start times are in the order of the
+consumers given. The total grid energy of the assignment is also returned.
+
+The function can be called concurrently from several threads, and each call
+creates and destroys its own solver. The consumption kernels of identical
+profiles are shared across the calls by the process wide profile cache.
+
+The options are given as a structure that should be initialised with the
+default values before setting the options needed. The default is a single
+search using the actor evaluation of the objective function, no time budget
+or deadline, and Steffen's interpolation of the grid energy, exactly as for
+the simulator without options.
+
+The function returns one of the following status codes:
+
+DOMINOES_SOLVED           The start times of a converged search are returned
+DOMINOES_PARTIAL          The deadline stopped the search and the best start
+                          times found so far are returned
+DOMINOES_INVALID_ARGUMENT An argument was invalid, and the error message
+                          explains why
+DOMINOES_FAILURE          The solver failed, and the error message explains
+                          why
+
+If the error message buffer is given, it will be filled with a null
+terminated error message truncated to the buffer length, or an empty string
+if the problem was solved.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_API
+#define DOMINOES_API
+
+#include <stddef.h>                          /* Array sizes */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Times are given as POSIX seconds */
+
+typedef long long DominoesTime;
+
+/* The status codes returned by the solver */
+
+enum DominoesStatus
+{
+  DOMINOES_SOLVED           =  0,
+  DOMINOES_PARTIAL          =  1,
+  DOMINOES_INVALID_ARGUMENT = -1,
+  DOMINOES_FAILURE          = -2
+};
+
+/* A consumer is defined by its ID, the start interval and the profile */
+
+typedef struct
+{
+  const char *         ID;
+  DominoesTime         EarliestStart;
+  DominoesTime         LatestStart;
+  const DominoesTime * ProfileTimes;
+  const double *       ProfileEnergy;
+  size_t               ProfileLength;
+} DominoesConsumer;
+
+/* The options correspond to the command line options of the simulator. The
+   sunrise and sunset define the solar day unless they are equal. The number
+   of threads is the number of hardware threads if zero, and the budget and
+   the deadline are not used if they are zero. The flags are enabled if they
+   are non-zero. */
+
+typedef struct
+{
+  int          InProcessEvaluation;
+  DominoesTime KernelStep;
+  unsigned int Starts;
+  unsigned int Threads;
+  long long    BudgetSeconds;
+  long long    DeadlineMilliseconds;
+  int          Decompose;
+  int          WarmStart;
+  int          LinearGridEnergy;
+  DominoesTime Sunrise;
+  DominoesTime Sunset;
+} DominoesOptions;
+
+/* The options are initialised to the default values */
+
+void DominoesDefaultOptions( DominoesOptions * Options );
+
+/* The solver function. The options may be NULL for the default options, and
+   the grid energy and the error message buffer may be NULL if they are not
+   needed. */
+
+int DominoesSolve( const DominoesTime * ProductionTimes,
+                   const double * ProductionEnergy, size_t ProductionLength,
+                   const DominoesConsumer * Consumers, size_t NumberOfConsumers,
+                   const DominoesOptions * Options,
+                   DominoesTime * StartTimes, double * GridEnergy,
+                   char * ErrorMessage, size_t ErrorLength );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DOMINOES_API */
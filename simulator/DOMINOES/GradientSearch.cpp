@@ -0,0 +1,125 @@
+/*==============================================================================
+Gradient Search
+
+This implements the objective function, the gradient and the solve function
+of the gradient based searches.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <boost/numeric/conversion/cast.hpp> // Casting numeric types
+
+#include "GradientSearch.hpp"                // The class definition
+
+// The objective function is identical to the one of the search
+
+Optimization::VariableType Dominoes::GradientSearch::ObjectiveFunction(
+  Optimization::VariableSpan VariableValues )
+{
+  double Value;
+
+  if ( Metrics != nullptr )
+  {
+    Instrumentation::Clock::time_point Start = Instrumentation::Clock::now();
+
+    Value = Cost( Consumption.Update( VariableValues ) );
+    Metrics->RecordEvaluation( Instrumentation::Clock::now() - Start );
+  }
+  else
+    Value = Cost( Consumption.Update( VariableValues ) );
+
+  EvaluationCount++;
+
+  Progress.Record( VariableValues, Value );
+
+  if ( Progress.Expired() )
+    ForceStop();
+
+  return Value;
+}
+
+// The gradient updates the total consumption for the start times, and the
+// objective function called next for the same start times will therefore
+// find that no start time has changed. The derivative for each consumer is
+// then the sum over the samples it covers of the change of its consumption
+// weighted by the sample weights of the grid cost.
+
+void Dominoes::GradientSearch::GradientFunction(
+  Optimization::VariableSpan VariableValues,
+  Optimization::GradientSpan GradientValues )
+{
+  const std::vector< double > &
+  Weights( Cost.DeficitWeights( Consumption.Update( VariableValues ) ) );
+
+  for ( ConsumptionBlock::Index Consumer = 0;
+        Consumer < VariableValues.size(); Consumer++ )
+    GradientValues[ Consumer ] = Profiles.StartTimeDerivative( Consumer,
+      boost::numeric_cast< CoSSMic::Time >( VariableValues[ Consumer ] ),
+      Weights.data() );
+}
+
+Optimization::GradientVector Dominoes::GradientSearch::GradientFunction(
+  const Optimization::Variables & VariableValues )
+{
+  Optimization::GradientVector Gradient( VariableValues.size() );
+
+  GradientFunction( Optimization::VariableSpan( VariableValues ),
+                    Optimization::GradientSpan( Gradient ) );
+
+  return Gradient;
+}
+
+// The solver is created explicitly for the first start so that the search
+// can be stopped from the objective function, and the recorded best values
+// are returned if the search was forced to stop.
+
+Dominoes::GradientSearch::OptimalSolution
+Dominoes::GradientSearch::Solve( const Optimization::Variables & InitialValues )
+{
+  if ( GetDimension() != InitialValues.size() )
+    CreateSolver( InitialValues.size(), Optimization::Objective::Goal::Minimize );
+
+  Progress.Reset();
+
+  auto Solution = FindSolution( InitialValues );
+
+  if ( ( Solution.Status == NLOPT_FORCED_STOP ) &&
+       !Progress.BestVariables().empty() )
+    return OptimalSolution( Progress.BestVariables(), Progress.BestValue(),
+                            NLOPT_FORCED_STOP );
+  else
+    return Solution;
+}
+
+// Solving with a deadline sets the deadline for this start only
+
+Dominoes::GradientSearch::OptimalSolution
+Dominoes::GradientSearch::Solve( const Optimization::Variables & InitialValues,
+                                 Anytime::Clock::time_point Deadline )
+{
+  Progress.SetDeadline( Deadline );
+
+  auto Solution = Solve( InitialValues );
+
+  Progress.ClearDeadline();
+
+  return Solution;
+}
+
+// The constructor initialises the buffers
+
+Dominoes::GradientSearch::GradientSearch(
+  const ConsumptionBlock & ConsumerProfiles,
+  const std::vector< Interval > & StartIntervals,
+  const SampleTime & ProductionTimes,
+  const std::vector< double > & IntervalProduction,
+  Interpolation::Type GridInterpolation,
+  Instrumentation * SolverMetrics )
+: Optimization::ObjectiveGradient(),
+  NL::Optimizer< NL::Algorithm::Local::QuasiNewton::VariableMetric::RankTwo >(),
+  Profiles( ConsumerProfiles ), Bounds( StartIntervals ),
+  Consumption( ConsumerProfiles, ProductionTimes->size() ),
+  Cost( ProductionTimes, IntervalProduction, GridInterpolation ),
+  Progress(), EvaluationCount(0), Metrics( SolverMetrics )
+{}
@@ -0,0 +1,147 @@
+/*==============================================================================
+Gradient Search
+
+The derivative free BOBYQA algorithm used by the search builds a quadratic
+model of the objective function from the evaluated start times, and it needs
+a number of evaluations growing with the number of consumers before the model
+is useful. The objective function is however the integral of the part of the
+total consumption not covered by the production, and its derivative with
+respect to the start time of one consumer is available from the power of the
+consumer at the production sample times and the samples where the
+consumption exceeds the production. A gradient based quasi-Newton algorithm
+can therefore be used, and it needs far fewer evaluations for problems with
+many consumers.
+
+The gradient search is otherwise identical to the search: It has its own
+incremental consumption state and grid cost functor over the shared
+consumption block, and it can be given a deadline. The gradient is computed
+from the same total consumption as the objective value, and the algorithm
+always asks for the gradient and the objective value of the same start times
+so the objective value is then found from the consumption already updated.
+
+The objective function is piecewise smooth since the set of production
+samples covered by a consumer changes with its start time, and the
+derivative is taken for the fixed set of samples covered by the current
+start time. The start times are whole seconds, and the gradient is taken as
+if the start time were continuous.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_GRADIENT_SEARCH
+#define DOMINOES_GRADIENT_SEARCH
+
+#include <vector>                            // Standard vectors
+#include <cstddef>                           // Evaluation counter
+
+// The optimization algorithm
+#include "NonLinear/Algorithms.hpp"          // The algorithms
+#include "NonLinear/Optimizer.hpp"           // The solver
+#include "NonLinear/QuasiNewton.hpp"         // The variable metric interface
+
+// CoSSMic headers
+#include "Interpolation.hpp"                 // Grid energy interpolation
+
+// Dominoes headers
+#include "Typedefs.hpp"                      // Dominoes types
+#include "ConsumptionBlock.hpp"              // In-process evaluation
+#include "GridCost.hpp"                      // Objective value
+#include "IncrementalConsumption.hpp"        // Changed start times only
+#include "Anytime.hpp"                       // Deadline and best so far
+#include "Instrumentation.hpp"               // Evaluation latencies
+
+namespace Dominoes {
+
+namespace NL = Optimization::NonLinear;
+
+class GradientSearch
+: public NL::Optimizer< NL::Algorithm::Local::QuasiNewton::VariableMetric::RankTwo >
+{
+private:
+
+  // The shared and read-only data of the problem
+
+  const ConsumptionBlock &      Profiles;
+  const std::vector< Interval > Bounds;
+
+  // The search specific state for the total consumption and the grid cost
+
+  IncrementalConsumption Consumption;
+  GridCost               Cost;
+  Anytime                Progress;
+
+  // The number of evaluations of the objective function by this search
+
+  std::size_t            EvaluationCount;
+
+  // The latency of each evaluation is recorded if the instrumentation is
+  // given.
+
+  Instrumentation *      Metrics;
+
+protected:
+
+  // The objective function computes the total consumption of all consumers
+  // for the given start times, and it returns the grid cost. The evaluation
+  // is recorded, and the search is stopped if the deadline has passed.
+
+  virtual Optimization::VariableType
+	ObjectiveFunction( const Optimization::Variables & VariableValues ) override
+  { return ObjectiveFunction( Optimization::VariableSpan( VariableValues ) ); }
+
+  virtual Optimization::VariableType
+	ObjectiveFunction( Optimization::VariableSpan VariableValues ) override;
+
+  // The gradient is the derivative of the grid cost with respect to the
+  // start time of each consumer, computed from the weights of the samples
+  // with a deficit of production.
+
+  virtual Optimization::GradientVector
+  GradientFunction( const Optimization::Variables & VariableValues ) override;
+
+  virtual void
+  GradientFunction( Optimization::VariableSpan VariableValues,
+                    Optimization::GradientSpan GradientValues ) override;
+
+  // The bounds are the start time intervals of the consumers as given to the
+  // constructor.
+
+  virtual std::vector< Interval > BoundConstraints( void ) override
+  { return Bounds; }
+
+public:
+
+  // The search is started from the given initial start times. If a deadline
+  // is given, the search will stop once it has passed and return the best
+  // start times evaluated with the forced stop status.
+
+  OptimalSolution Solve( const Optimization::Variables & InitialValues );
+  OptimalSolution Solve( const Optimization::Variables & InitialValues,
+                         Anytime::Clock::time_point Deadline );
+
+  // The number of evaluations of the objective function over all starts
+
+  inline std::size_t Evaluations( void ) const
+  { return EvaluationCount; }
+
+  // The constructor takes the same arguments as the constructor of the
+  // search, and they must be owned by the solver while the search runs.
+
+  GradientSearch( const ConsumptionBlock & ConsumerProfiles,
+                  const std::vector< Interval > & StartIntervals,
+                  const SampleTime & ProductionTimes,
+                  const std::vector< double > & IntervalProduction,
+                  Interpolation::Type GridInterpolation
+                    = Interpolation::Type::SteffenMethod,
+                  Instrumentation * SolverMetrics = nullptr );
+
+  GradientSearch( void ) = delete;
+  GradientSearch( const GradientSearch & Other ) = delete;
+
+  virtual ~GradientSearch( void )
+  {}
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_GRADIENT_SEARCH
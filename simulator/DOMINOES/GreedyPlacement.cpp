@@ -0,0 +1,144 @@
+/*==============================================================================
+Greedy Placement
+
+This implements the constructive placement of the consumers onto the residual
+production.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <algorithm>                         // Sorting and searching
+#include <numeric>                           // Summing the energy
+#include <limits>                            // Largest grid energy
+#include <cmath>                             // Rounding the bounds
+#include <sstream>                           // For nicely formatted errors
+#include <stdexcept>                         // Standard exceptions
+
+#include "GreedyPlacement.hpp"               // The class definition
+
+// The candidates are the production sample times strictly inside the start
+// interval, thinned if necessary, and the two end points of the interval. The
+// end points are rounded inwards to whole seconds.
+
+std::vector< CoSSMic::Time >
+Dominoes::GreedyPlacement::Candidates( const Interval & StartInterval ) const
+{
+  const CoSSMic::Time Earliest = static_cast< CoSSMic::Time >(
+                                 std::ceil( StartInterval.lower() ) ),
+                      Latest   = std::max( Earliest,
+                                 static_cast< CoSSMic::Time >(
+                                 std::floor( StartInterval.upper() ) ) );
+
+  auto First = std::upper_bound( ProductionSamples->begin(),
+                                 ProductionSamples->end(), Earliest ),
+       Last  = std::lower_bound( First, ProductionSamples->end(), Latest );
+
+  const std::size_t InsideSamples = std::distance( First, Last ),
+                    Stride = std::max< std::size_t >( 1,
+                             ( InsideSamples + MaximalCandidates - 1 ) /
+                             std::max< std::size_t >( 1, MaximalCandidates ) );
+
+  std::vector< CoSSMic::Time > TheCandidates( 1, Earliest );
+
+  for ( std::size_t i = 0; i < InsideSamples; i += Stride )
+    TheCandidates.push_back( *( First + i ) );
+
+  if ( Latest > Earliest )
+    TheCandidates.push_back( Latest );
+
+  return TheCandidates;
+}
+
+// The placement first computes the total energy of each consumer to find the
+// order of placement. Then for each consumer all candidates are evaluated and
+// the best is kept. Ties are broken in favour of the earliest candidate. The
+// residual production is finally reduced by the consumption for the chosen
+// start time.
+
+Optimization::Variables Dominoes::GreedyPlacement::StartTimes( void ) const
+{
+  using Index = ConsumptionBlock::Index;
+
+  const Index Consumers = Profiles.size();
+
+  std::vector< double > Residual( IntervalProduction ), Consumption,
+                        TotalEnergy( Consumers, 0.0 );
+
+  for ( Index Consumer = 0; Consumer < Consumers; Consumer++ )
+  {
+    Profiles.ConsumerConsumption( Consumer, static_cast< CoSSMic::Time >(
+                                  std::ceil( Bounds[ Consumer ].lower() ) ),
+                                  Consumption );
+
+    TotalEnergy[ Consumer ] = std::accumulate( Consumption.begin(),
+                                               Consumption.end(), 0.0 );
+  }
+
+  std::vector< Index > Order( Consumers );
+
+  std::iota( Order.begin(), Order.end(), 0 );
+  std::stable_sort( Order.begin(), Order.end(), [&]( Index A, Index B ){
+    return TotalEnergy[A] > TotalEnergy[B]; });
+
+  Optimization::Variables Result( Consumers );
+
+  for ( Index Consumer : Order )
+  {
+    CoSSMic::Time BestStart  = 0;
+    double        BestEnergy = std::numeric_limits< double >::max();
+
+    for ( CoSSMic::Time Start : Candidates( Bounds[ Consumer ] ) )
+    {
+      Index  FirstSample = Profiles.ConsumerConsumption( Consumer, Start,
+                                                         Consumption );
+      double GridEnergy  = 0.0;
+
+      for ( Index i = 0; i < Consumption.size(); i++ )
+        GridEnergy += std::max( 0.0, Consumption[i] -
+                                std::max( 0.0, Residual[ FirstSample + i ] ) );
+
+      if ( GridEnergy < BestEnergy )
+      {
+        BestStart  = Start;
+        BestEnergy = GridEnergy;
+      }
+    }
+
+    Index FirstSample = Profiles.ConsumerConsumption( Consumer, BestStart,
+                                                      Consumption );
+
+    for ( Index i = 0; i < Consumption.size(); i++ )
+      Residual[ FirstSample + i ] -= Consumption[i];
+
+    Result[ Consumer ] = static_cast< Optimization::VariableType >( BestStart );
+  }
+
+  return Result;
+}
+
+// The constructor checks that the data are consistent
+
+Dominoes::GreedyPlacement::GreedyPlacement(
+  const ConsumptionBlock & ConsumerProfiles,
+  const std::vector< Interval > & StartIntervals,
+  const SampleTime & ProductionTimes, const std::vector< double > & Production,
+  std::size_t CandidateLimit )
+: Profiles( ConsumerProfiles ), Bounds( StartIntervals ),
+  ProductionSamples( ProductionTimes ), IntervalProduction( Production ),
+  MaximalCandidates( CandidateLimit )
+{
+  if ( ( Bounds.size() != Profiles.size() ) ||
+       ( IntervalProduction.size() != ProductionSamples->size() ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The greedy placement has " << Profiles.size()
+                 << " consumers and " << Bounds.size() << " start intervals, "
+                 << "and " << ProductionSamples->size() << " sample times and "
+                 << IntervalProduction.size() << " production values";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+}
@@ -0,0 +1,91 @@
+/*==============================================================================
+Greedy Placement
+
+The initial start times for the search are by default drawn at random over
+the start interval of each consumer, possibly confined to the solar day. The
+BOBYQA algorithm may then need many evaluations of the objective function to
+move away from a poor initial point. The greedy placement is a constructive
+alternative giving a better initial point: The consumers are placed one by one
+in the order of decreasing total energy onto the residual production, i.e. the
+production in each sample interval not already used by the consumers placed
+before. Each consumer is given the start time that increases the grid energy
+the least given the residual production.
+
+The consumption of a consumer for a candidate start time is computed from its
+consumption kernel in the consumption block, and the increase of the grid
+energy is computed per production sample interval as the part of the
+consumption not covered by the positive residual production. This is the
+discrete sum of the grid energy, and not the interpolated integral used by the
+objective function, but it is only used to rank the candidate start times.
+
+The candidate start times of a consumer are the earliest and the latest start
+times, and the production sample times in between since the consumption over
+the production samples only changes its pattern when the start time passes a
+sample time. If there are more candidates than a given maximum, the sample
+times are thinned evenly.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_GREEDY_PLACEMENT
+#define DOMINOES_GREEDY_PLACEMENT
+
+#include <vector>                            // Standard vectors
+#include <cstddef>                           // Candidate counts
+#include <boost/numeric/interval.hpp>        // Start intervals
+
+#include "Variables.hpp"                     // Optimization variables
+
+#include "Typedefs.hpp"                      // Dominoes types
+#include "ConsumptionBlock.hpp"              // The consumption kernels
+
+namespace Dominoes {
+
+class GreedyPlacement
+{
+public:
+
+  // The start intervals are given as the bounds of the optimisation variables
+
+  using Interval = boost::numeric::interval< Optimization::VariableType >;
+
+private:
+
+  // The shared and read-only data of the problem as for a search
+
+  const ConsumptionBlock &        Profiles;
+  const std::vector< Interval > & Bounds;
+  const SampleTime                ProductionSamples;
+  const std::vector< double > &   IntervalProduction;
+
+  // The maximal number of candidate start times tested for one consumer
+
+  const std::size_t MaximalCandidates;
+
+  // The candidate start times for one consumer
+
+  std::vector< CoSSMic::Time > Candidates( const Interval & StartInterval ) const;
+
+public:
+
+  // The start times are computed in the order of the consumers of the block
+
+  Optimization::Variables StartTimes( void ) const;
+
+  // The constructor takes the consumption block, the start intervals of the
+  // consumers in the same order as the consumers of the block, the production
+  // sample times, and the production in each sample interval. These must be
+  // owned by the caller.
+
+  GreedyPlacement( const ConsumptionBlock & ConsumerProfiles,
+                   const std::vector< Interval > & StartIntervals,
+                   const SampleTime & ProductionTimes,
+                   const std::vector< double > & Production,
+                   std::size_t CandidateLimit = 256 );
+
+  GreedyPlacement( void ) = delete;
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_GREEDY_PLACEMENT
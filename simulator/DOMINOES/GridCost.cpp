@@ -0,0 +1,168 @@
+/*==============================================================================
+Grid Cost
+
+This implements the computation of the energy that must be bought from the
+grid.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <algorithm>                         // Transforming vectors
+#include <sstream>                           // For nicely formatted errors
+#include <stdexcept>                         // Standard exceptions
+
+#include "GridCost.hpp"                      // The class definition
+
+// The integral of an interpolation of the grid energy is computed by the GSL
+// over the full domain of the production sample times.
+
+double Dominoes::GridCost::InterpolatedIntegral( void )
+{
+  Interpolation
+  EnergyValue( ProductionSamples->begin(), ProductionSamples->end(),
+               GridEnergy.begin(), GridEnergy.end(), GridInterpolation );
+
+  return Integral( EnergyValue,
+                   EnergyValue.DomainLower(), EnergyValue.DomainUpper() );
+}
+
+// The linear integral is the sum of the trapezoids between two sample times.
+// The GSL computes the area of the first and the last interval as parts of an
+// interval, i.e. as the length of the interval times the value at the middle
+// of the interval computed from the slope, whereas the area of the intervals
+// in between is half the length times the sum of the two end values. The same
+// expressions are used here in the same order to give identical results. Note
+// that the interval from the lower limit to the first sample time, and from
+// the last sample time to the upper limit, are zero for the full domain, and
+// they are therefore left out of the expressions.
+
+double Dominoes::GridCost::LinearIntegral( void )
+{
+  const std::size_t Intervals = SampleInterval.size();
+  const double *    Energy    = GridEnergy.data();
+  const double *    Length    = SampleInterval.data();
+  double            Area      = 0.0;
+
+  for ( std::size_t i = 0; i < Intervals; i++ )
+    if ( Length[i] != 0.0 )
+    {
+      if ( ( i == 0 ) || ( i == Intervals - 1 ) )
+      {
+        const double Slope = ( Energy[i+1] - Energy[i] ) / Length[i];
+
+        Area += Length[i] * ( Energy[i] + 0.5 * Slope * ( Length[i] + 0.0 ) );
+      }
+      else
+        Area += 0.5 * Length[i] * ( Energy[i] + Energy[i+1] );
+    }
+
+  return Area;
+}
+
+// The net energy that must be taken from the grid is now equal to the
+// sum of the differences between the production and the consumption in each
+// interval. This is first computed for the sample times by a loop without
+// dependencies between the elements, and then integrated to find the total
+// energy that is needed by the building.
+
+double Dominoes::GridCost::operator() (
+  const std::vector< double > & TotalConsumption )
+{
+  const std::size_t Samples = TotalConsumption.size();
+
+  if ( ( Samples != IntervalProduction.size() ) || ( Samples < 2 ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The grid cost needs at least two samples and the "
+                 << "total consumption has " << Samples << " samples "
+                 << "whereas there are " << IntervalProduction.size()
+                 << " production samples";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  GridEnergy.resize( Samples );
+
+  const double * Production  = IntervalProduction.data();
+  const double * Consumption = TotalConsumption.data();
+  double *       Energy      = GridEnergy.data();
+
+  for ( std::size_t i = 0; i < Samples; i++ )
+    Energy[i] = ( Production[i] >= Consumption[i] ) ?
+                0.0 : Consumption[i] - Production[i];
+
+  if ( GridInterpolation != Interpolation::Type::Linear )
+    return InterpolatedIntegral();
+
+  UpdateSampleIntervals( Samples );
+
+  return LinearIntegral();
+}
+
+// The lengths of the sample intervals are computed the first time and
+// whenever the time axis has changed.
+
+void Dominoes::GridCost::UpdateSampleIntervals( std::size_t Samples )
+{
+  if ( SampleInterval.size() != Samples - 1 )
+  {
+    SampleInterval.resize( Samples - 1 );
+
+    for ( std::size_t i = 0; i < Samples - 1; i++ )
+      SampleInterval[i] = static_cast< double >( (*ProductionSamples)[i+1] ) -
+                          static_cast< double >( (*ProductionSamples)[i]   );
+  }
+}
+
+// The weight of a sample with a deficit is the sum of the half lengths of
+// the intervals before and after the sample, where the first sample has no
+// interval before and the last sample no interval after.
+
+const std::vector< double > & Dominoes::GridCost::DeficitWeights(
+  const std::vector< double > & TotalConsumption )
+{
+  const std::size_t Samples = TotalConsumption.size();
+
+  if ( ( Samples != IntervalProduction.size() ) || ( Samples < 2 ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The grid cost gradient needs at least two samples and "
+                 << "the total consumption has " << Samples << " samples "
+                 << "whereas there are " << IntervalProduction.size()
+                 << " production samples";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  UpdateSampleIntervals( Samples );
+  SampleWeight.resize( Samples );
+
+  const double * Production  = IntervalProduction.data();
+  const double * Consumption = TotalConsumption.data();
+  const double * Length      = SampleInterval.data();
+  double *       Weight      = SampleWeight.data();
+
+  for ( std::size_t i = 0; i < Samples; i++ )
+    if ( Production[i] >= Consumption[i] )
+      Weight[i] = 0.0;
+    else
+      Weight[i] = 0.5 * ( ( i > 0 ? Length[i-1] : 0.0 ) +
+                          ( i < Samples - 1 ? Length[i] : 0.0 ) );
+
+  return SampleWeight;
+}
+
+// The constructor only stores the references
+
+Dominoes::GridCost::GridCost( const SampleTime & ProductionTimes,
+                              const std::vector< double > & Production,
+                              Interpolation::Type InterpolationType )
+: ProductionSamples( ProductionTimes ), IntervalProduction( Production ),
+  GridInterpolation( InterpolationType ), GridEnergy(), SampleInterval(),
+  SampleWeight()
+{}
@@ -0,0 +1,119 @@
+/*==============================================================================
+Grid Cost
+
+The value of the objective function is the energy the building must buy from
+the grid. Given the energy produced in each interval between two production
+sample times and the total consumption of all consumers in the same intervals,
+the grid energy is the part of the consumption not covered by the production
+in each interval, and the objective value is the integral of the interpolated
+grid energy over the production sample times.
+
+The grid cost is a small functor computing this value. It keeps a reference to
+the interval production owned by the solver and a pointer to the production
+sample times, but it has its own buffers. Several grid cost objects can
+therefore be used concurrently as long as each thread has its own object and
+the production is not changed while the objective is evaluated.
+
+The grid energy is by default interpolated with Steffen's method as for all
+other CoSSMic interpolations, and the integral is computed by the GSL for an
+interpolation constructed for each evaluation. If the grid energy is linearly
+interpolated, the integral is just a sum of trapezoids and it is computed
+directly over the pre-allocated buffers without constructing the
+interpolation. The trapezoids are computed by exactly the same arithmetic
+operations in the same order as the GSL linear interpolation's integral
+so that the result is identical to the one obtained with a linear
+interpolation object.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_GRID_COST
+#define DOMINOES_GRID_COST
+
+#include <vector>                            // Standard vectors
+
+#include "Interpolation.hpp"                 // Interpolation types
+#include "Typedefs.hpp"                      // Dominoes types
+
+namespace Dominoes {
+
+class GridCost
+{
+private:
+
+  const SampleTime              ProductionSamples;
+  const std::vector< double > & IntervalProduction;
+
+  // The interpolation type used for the grid energy
+
+  Interpolation::Type GridInterpolation;
+
+  // The grid energy at the sample times is stored in a buffer that is
+  // re-used for each evaluation. The linear integration also needs the
+  // sample times as real numbers, and the length of each sample interval.
+  // These are computed from the production sample times when the number
+  // of sample times changes since the time axis can be extended after
+  // the grid cost has been constructed.
+
+  std::vector< double > GridEnergy, SampleInterval;
+
+  // The weights of the samples for the gradient are kept in a buffer of
+  // their own.
+
+  std::vector< double > SampleWeight;
+
+  // The sample intervals are computed by a common function
+
+  void UpdateSampleIntervals( std::size_t Samples );
+
+  // The two ways to compute the integral of the grid energy
+
+  double LinearIntegral( void );
+  double InterpolatedIntegral( void );
+
+public:
+
+  // The interpolation type can be changed. Note that it is not safe to do
+  // this while the grid cost is used by another thread.
+
+  inline void SetInterpolation( Interpolation::Type InterpolationType )
+  { GridInterpolation = InterpolationType; }
+
+  // The cost is computed for a given total consumption vector that must be of
+  // the same size as the production.
+
+  double operator() ( const std::vector< double > & TotalConsumption );
+
+  // The gradient of the cost with respect to the consumption in each sample
+  // is the weight of the sample in the sum of the trapezoids if the
+  // consumption exceeds the production, and zero otherwise since a small
+  // change of the consumption then does not change the grid energy. The
+  // weight of a sample is half the length of the sample intervals on each
+  // side of the sample time. The derivative of the integral of Steffen's
+  // interpolation is approximated by the same weights as the interpolation
+  // preserves the monotonicity of the grid energy, and the integrals differ
+  // only in how the curvature is distributed over the sample intervals.
+
+  const std::vector< double > &
+  DeficitWeights( const std::vector< double > & TotalConsumption );
+
+  // The constructor takes the production sample times and the interval
+  // production. Both must be owned by the caller for the lifetime of the
+  // grid cost object. The interpolation type is optional, and a copy will
+  // have the same interpolation type as the original.
+
+  GridCost( const SampleTime & ProductionTimes,
+            const std::vector< double > & Production,
+            Interpolation::Type InterpolationType
+              = Interpolation::Type::SteffenMethod );
+
+  GridCost( void ) = delete;
+  GridCost( const GridCost & Other )
+  : GridCost( Other.ProductionSamples, Other.IntervalProduction,
+              Other.GridInterpolation )
+  {}
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_GRID_COST
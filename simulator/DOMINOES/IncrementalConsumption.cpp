@@ -0,0 +1,129 @@
+/*==============================================================================
+Incremental Consumption
+
+This implements the incremental update of the total consumption.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <sstream>                           // For nicely formatted errors
+#include <stdexcept>                         // Standard exceptions
+
+#include <boost/numeric/conversion/cast.hpp> // Casting numeric types
+
+#include "IncrementalConsumption.hpp"        // The class definition
+
+// Subtracting and adding the contribution of a consumer is just a loop over
+// the production samples covered by the consumer.
+
+void Dominoes::IncrementalConsumption::Subtract( Index Consumer )
+{
+  const std::vector< double > & Consumption = Contribution[ Consumer ];
+  double * Total = TotalConsumption.data() + FirstSample[ Consumer ];
+
+  for ( Index Sample = 0; Sample < Consumption.size(); Sample++ )
+    Total[ Sample ] -= Consumption[ Sample ];
+}
+
+void Dominoes::IncrementalConsumption::Add( Index Consumer )
+{
+  const std::vector< double > & Consumption = Contribution[ Consumer ];
+  double * Total = TotalConsumption.data() + FirstSample[ Consumer ];
+
+  for ( Index Sample = 0; Sample < Consumption.size(); Sample++ )
+    Total[ Sample ] += Consumption[ Sample ];
+}
+
+// The full computation recomputes the contribution of every consumer from
+// the stored start times and adds them in order to a zero total consumption.
+
+void Dominoes::IncrementalConsumption::Rebuild( void )
+{
+  TotalConsumption.assign( TotalConsumption.size(), 0.0 );
+
+  for ( Index Consumer = 0; Consumer < StartTimes.size(); Consumer++ )
+  {
+    FirstSample[ Consumer ] = Profiles.ConsumerConsumption( Consumer,
+                              StartTimes[ Consumer ], Contribution[ Consumer ] );
+    Add( Consumer );
+  }
+
+  IncrementalUpdates = 0;
+}
+
+// The update first finds the consumers whose start time has changed. If there
+// is no previous state, or the full computation is due, the total consumption
+// is rebuilt. Otherwise only the changed consumers are updated.
+
+const std::vector< double > &
+Dominoes::IncrementalConsumption::Update(
+  Optimization::VariableSpan AssignedStartTimes )
+{
+  if ( AssignedStartTimes.size() != Profiles.size() )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "There are " << Profiles.size() << " consumers but "
+                 << AssignedStartTimes.size() << " start times were given";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  if ( StartTimes.size() != AssignedStartTimes.size() )
+  {
+    StartTimes.resize( AssignedStartTimes.size() );
+
+    for ( Index Consumer = 0; Consumer < StartTimes.size(); Consumer++ )
+      StartTimes[ Consumer ] = boost::numeric_cast< CoSSMic::Time >(
+                                        AssignedStartTimes[ Consumer ] );
+
+    Rebuild();
+    return TotalConsumption;
+  }
+
+  Changed.clear();
+
+  for ( Index Consumer = 0; Consumer < StartTimes.size(); Consumer++ )
+  {
+    CoSSMic::Time StartTime = boost::numeric_cast< CoSSMic::Time >(
+                                       AssignedStartTimes[ Consumer ] );
+
+    if ( StartTime != StartTimes[ Consumer ] )
+    {
+      StartTimes[ Consumer ] = StartTime;
+      Changed.push_back( Consumer );
+    }
+  }
+
+  if ( ( 2 * Changed.size() > StartTimes.size() ) ||
+       ( IncrementalUpdates >= MaxIncrementalUpdates ) )
+    Rebuild();
+  else if ( !Changed.empty() )
+  {
+    for ( Index Consumer : Changed )
+    {
+      Subtract( Consumer );
+      FirstSample[ Consumer ] = Profiles.ConsumerConsumption( Consumer,
+                                StartTimes[ Consumer ], Contribution[ Consumer ] );
+      Add( Consumer );
+    }
+
+    IncrementalUpdates++;
+  }
+
+  return TotalConsumption;
+}
+
+// The constructor allocates the state for all consumers
+
+Dominoes::IncrementalConsumption::IncrementalConsumption(
+  const ConsumptionBlock & ConsumerProfiles, Index NumberOfSamples,
+  unsigned int FullUpdateInterval )
+: Profiles( ConsumerProfiles ), StartTimes(),
+  FirstSample( ConsumerProfiles.size(), 0 ),
+  Contribution( ConsumerProfiles.size() ),
+  TotalConsumption( NumberOfSamples, 0.0 ), Changed(),
+  IncrementalUpdates(0), MaxIncrementalUpdates( FullUpdateInterval )
+{}
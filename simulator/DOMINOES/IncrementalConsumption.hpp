@@ -0,0 +1,114 @@
+/*==============================================================================
+Incremental Consumption
+
+The local optimisation algorithms often change only one or a few of the start
+times between two evaluations of the objective function. Recomputing the total
+consumption from all consumers for every evaluation then costs time
+proportional to the number of consumers even if only one start time has
+changed.
+
+The incremental consumption remembers the start times of the last evaluation
+and the consumption of each consumer at the production samples it covers. For
+the next evaluation, only the consumers whose start time has changed are
+considered: Their old consumption is subtracted from the total consumption,
+and their consumption for the new start time is computed and added. The start
+times are compared as whole POSIX seconds since this is the resolution used by
+the consumption, and a change of a start time by less than one second does not
+change the consumption.
+
+Subtracting and adding the same values in floating point arithmetic will
+accumulate rounding errors over many evaluations. The total consumption is
+therefore computed from scratch for the first evaluation, if more than half
+of the start times have changed, and after a given number of incremental
+updates. A full computation adds the consumers in order and gives exactly the
+same total consumption as the consumption block.
+
+The incremental consumption has its own state and should only be used by one
+thread, but several objects can share the same consumption block.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_INCREMENTAL_CONSUMPTION
+#define DOMINOES_INCREMENTAL_CONSUMPTION
+
+#include <vector>                            // Standard vectors
+
+#include "Variables.hpp"                     // Optimization variables
+#include "TimeInterval.hpp"                  // The CoSSMic time
+#include "ConsumptionBlock.hpp"              // The consumer profiles
+
+namespace Dominoes {
+
+class IncrementalConsumption
+{
+private:
+
+  using Index = ConsumptionBlock::Index;
+
+  // The profiles of the consumers
+
+  const ConsumptionBlock & Profiles;
+
+  // The state of the last evaluation: The start time of each consumer, the
+  // index of the first production sample covered, and the consumption
+  // of the consumer in each covered sample.
+
+  std::vector< CoSSMic::Time >         StartTimes;
+  std::vector< Index >                 FirstSample;
+  std::vector< std::vector< double > > Contribution;
+
+  // The total consumption of all consumers
+
+  std::vector< double > TotalConsumption;
+
+  // The consumers whose start times changed for the current update are stored
+  // in a buffer that is re-used for every update.
+
+  std::vector< Index > Changed;
+
+  // The number of incremental updates since the last full computation, and
+  // the limit for the number of incremental updates.
+
+  unsigned int       IncrementalUpdates;
+  const unsigned int MaxIncrementalUpdates;
+
+  // There are utility functions to subtract or add the contribution of one
+  // consumer to the total consumption, and to compute all contributions.
+
+  void Subtract( Index Consumer );
+  void Add( Index Consumer );
+  void Rebuild( void );
+
+public:
+
+  // The main function updates the total consumption for the given start
+  // times and returns the total consumption. The start times must have the
+  // same order as the consumers of the consumption block. An invalid argument
+  // exception is thrown if the number of start times is wrong. The start 
+  // times are given as a span so that the array of the optimiser can be used
+  // directly.
+
+  const std::vector< double > &
+  Update( Optimization::VariableSpan AssignedStartTimes );
+
+  // The state can be cleared to force a full computation at the next update.
+
+  inline void Invalidate( void )
+  { StartTimes.clear(); }
+
+  // The constructor takes the consumption block, the number of production
+  // samples and optionally the number of incremental updates allowed between
+  // two full computations of the total consumption.
+
+  IncrementalConsumption( const ConsumptionBlock & ConsumerProfiles,
+                          Index NumberOfSamples,
+                          unsigned int FullUpdateInterval = 100 );
+
+  IncrementalConsumption( void ) = delete;
+  IncrementalConsumption( const IncrementalConsumption & Other ) = delete;
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_INCREMENTAL_CONSUMPTION
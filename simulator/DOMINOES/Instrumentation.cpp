@@ -0,0 +1,109 @@
+/*==============================================================================
+Instrumentation
+
+This implements the accumulation of the phase durations and the JSON report.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <algorithm>                         // Finding phases and percentiles
+#include <numeric>                           // Summing latencies
+#include <cmath>                             // Rounding the percentile rank
+#include <iomanip>                           // Number precision
+
+#include "Actor.hpp"                         // Message pool counters
+#include "MemoryAccounting.hpp"              // Memory by subsystem
+#include "Instrumentation.hpp"               // The class definition
+
+// A phase is added to the end of the phase list the first time it is
+// recorded, and otherwise the duration is added to its accumulated duration.
+
+void Dominoes::Instrumentation::AddPhase( const std::string & Phase,
+                                          Clock::duration Duration )
+{
+  const double Seconds = std::chrono::duration< double >( Duration ).count();
+
+  std::lock_guard< std::mutex > Guard( Lock );
+
+  auto Existing = std::find_if( Phases.begin(), Phases.end(),
+                  [&]( const std::pair< std::string, double > & Recorded ){
+                    return Recorded.first == Phase; });
+
+  if ( Existing == Phases.end() )
+    Phases.emplace_back( Phase, Seconds );
+  else
+    Existing->second += Seconds;
+}
+
+// The report computes the mean and the 99th percentile of the latencies
+// using the nearest rank method on a copy of the latencies. The phase names
+// are written as they are since they are given by the code and contain no
+// characters that must be escaped, and so are the message type names of the
+// pools since they are the names given by the run-time type information.
+
+void Dominoes::Instrumentation::WriteJSON( std::ostream & Report ) const
+{
+  std::lock_guard< std::mutex > Guard( Lock );
+
+  double Mean = 0.0, Percentile99 = 0.0;
+
+  if ( !Latencies.empty() )
+  {
+    std::vector< double > Sorted( Latencies );
+
+    Mean = std::accumulate( Sorted.begin(), Sorted.end(), 0.0 ) / Sorted.size();
+
+    auto Rank = static_cast< std::vector< double >::size_type >(
+                std::ceil( 0.99 * Sorted.size() ) ) - 1;
+
+    std::nth_element( Sorted.begin(), Sorted.begin() + Rank, Sorted.end() );
+    Percentile99 = Sorted[ Rank ];
+  }
+
+  const auto Precision = Report.precision( 9 );
+
+  Report << "{\n  \"phases\": {";
+
+  for ( auto Phase = Phases.begin(); Phase != Phases.end(); ++Phase )
+    Report << ( Phase == Phases.begin() ? "\n" : ",\n" )
+           << "    \"" << Phase->first << "\": " << Phase->second;
+
+  Report << "\n  },\n"
+         << "  \"evaluations\": " << Latencies.size() << ",\n"
+         << "  \"evaluation_latency\": { \"mean\": " << Mean
+         << ", \"p99\": " << Percentile99 << " },\n"
+         << "  \"messages_sent\": " << MessagesSent << ",\n"
+         << "  \"memoised_evaluations\": { \"hits\": " << MemoHits
+         << ", \"misses\": " << MemoMisses << " },\n"
+         << "  \"message_pools\": [";
+
+  const auto Pools = Theron::Actor::MessagePoolStatistics();
+
+  for ( auto Pool = Pools.begin(); Pool != Pools.end(); ++Pool )
+    Report << ( Pool == Pools.begin() ? "\n" : ",\n" )
+           << "    { \"type\": \"" << Pool->MessageType << "\", "
+           << "\"allocations\": " << Pool->Allocations << ", "
+           << "\"recycled\": " << Pool->Recycled << " }";
+
+  Report << "\n  ]";
+
+  if ( Theron::MemoryAccounting::Enabled() )
+  {
+    const auto Accounts = Theron::MemoryAccounting::Snapshot();
+
+    Report << ",\n  \"memory\": [";
+
+    for ( auto Account = Accounts.begin(); Account != Accounts.end(); ++Account )
+      Report << ( Account == Accounts.begin() ? "\n" : ",\n" )
+             << "    { \"account\": \"" << Account->Name << "\", "
+             << "\"bytes\": " << Account->Bytes << ", "
+             << "\"peak_bytes\": " << Account->PeakBytes << " }";
+
+    Report << "\n  ]";
+  }
+
+  Report << "\n}" << std::endl;
+
+  Report.precision( Precision );
+}
@@ -0,0 +1,168 @@
+/*==============================================================================
+Instrumentation
+
+When the assignment of start times is slow it is necessary to know where the
+time is used: Reading the production series, creating the consumers, the
+round trip to the consumers for their time coverages, the optimisation, or
+writing the results. The instrumentation keeps the wall-clock time used by
+named phases measured by scope timers based on the steady clock, and counters
+for the number of messages sent to the consumers and the number of
+evaluations of the objective function with the time used by each evaluation.
+
+The phase timers and the message counter are always kept since they cost only
+a few clock readings per phase. The latency of the objective function
+evaluations is recorded only if the instrumentation is enabled since it costs
+two clock readings and storing one value per evaluation. The instrumentation
+is shared by the solver and the searches of a multi-start, and it is therefore
+protected by a lock.
+
+The report is written as one JSON object:
+
+{
+  "phases": { "<name>": <seconds>, ... },
+  "evaluations": <count>,
+  "evaluation_latency": { "mean": <seconds>, "p99": <seconds> },
+  "messages_sent": <count>,
+  "memoised_evaluations": { "hits": <count>, "misses": <count> },
+  "message_pools": [
+    { "type": "<message type>", "allocations": <count>, "recycled": <count> },
+    ...
+  ],
+  "memory": [
+    { "account": "<name>", "bytes": <count>, "peak_bytes": <count> },
+    ...
+  ]
+}
+
+where the phases are given in the order they were first recorded, and a
+phase recorded several times reports the sum of its durations. The values
+cover the lifetime of the solver, except the counters of the message pools
+of the actor framework that cover the lifetime of the process. The ratio of
+recycled messages to allocations is the hit rate of the pool of a message
+type. The memory accounts are only reported if the memory accounting is
+enabled, see Theron::MemoryAccounting, and they also cover the lifetime of
+the process, although the peak is usually reached while solving.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_INSTRUMENTATION
+#define DOMINOES_INSTRUMENTATION
+
+#include <string>                            // Phase names
+#include <vector>                            // Phases and latencies
+#include <utility>                           // Pairs
+#include <chrono>                            // Steady clock
+#include <mutex>                             // Shared by threads
+#include <ostream>                           // Writing the report
+#include <filesystem>                        // The report file
+#include <cstddef>                           // Counters
+
+namespace Dominoes {
+
+class Instrumentation
+{
+public:
+
+  using Clock = std::chrono::steady_clock;
+
+private:
+
+  bool Enabled;
+
+  // The accumulated durations of the phases in seconds, the latencies of the
+  // evaluations in seconds, and the number of messages sent.
+
+  std::vector< std::pair< std::string, double > > Phases;
+  std::vector< double >                           Latencies;
+  std::size_t                                     MessagesSent;
+
+  // The hits and misses of the memoised objective values are set by the 
+  // solver since the cache keeps the counts.
+
+  std::size_t MemoHits, MemoMisses;
+
+  mutable std::mutex Lock;
+
+public:
+
+  // The scope timer records the time from its construction to its
+  // destruction as the duration of the given phase.
+
+  class ScopeTimer
+  {
+  private:
+
+    Instrumentation &       Owner;
+    const std::string       Phase;
+    const Clock::time_point Start;
+
+  public:
+
+    ScopeTimer( Instrumentation & TheOwner, const std::string & PhaseName )
+    : Owner( TheOwner ), Phase( PhaseName ), Start( Clock::now() )
+    {}
+
+    ~ScopeTimer( void )
+    { Owner.AddPhase( Phase, Clock::now() - Start ); }
+
+    ScopeTimer( void ) = delete;
+    ScopeTimer( const ScopeTimer & Other ) = delete;
+  };
+
+  // The recording functions are thread safe
+
+  void AddPhase( const std::string & Phase, Clock::duration Duration );
+
+  inline void CountMessages( std::size_t Messages )
+  {
+    std::lock_guard< std::mutex > Guard( Lock );
+    MessagesSent += Messages;
+  }
+
+  inline void RecordMemoisation( std::size_t Hits, std::size_t Misses )
+  {
+    std::lock_guard< std::mutex > Guard( Lock );
+    MemoHits   = Hits;
+    MemoMisses = Misses;
+  }
+
+  inline void RecordEvaluation( Clock::duration Latency )
+  {
+    std::lock_guard< std::mutex > Guard( Lock );
+    Latencies.push_back( std::chrono::duration< double >( Latency ).count() );
+  }
+
+  // The evaluation latencies are only recorded if the instrumentation is
+  // enabled, and the caller should test this before reading the clock.
+
+  inline bool IsEnabled( void ) const
+  { return Enabled; }
+
+  inline void Enable( bool On )
+  { Enabled = On; }
+
+  // The report is written to the given stream as a JSON object. The report
+  // file to be stored alongside a result file has the same name as the result
+  // file with the extension replaced by ".metrics.json".
+
+  void WriteJSON( std::ostream & Report ) const;
+
+  static inline std::filesystem::path
+  ReportFile( const std::filesystem::path & ResultFile )
+  {
+    std::filesystem::path TheReport( ResultFile );
+    return TheReport.replace_extension( ".metrics.json" );
+  }
+
+  Instrumentation( void )
+  : Enabled( false ), Phases(), Latencies(), MessagesSent(0), 
+    MemoHits(0), MemoMisses(0), Lock()
+  {}
+
+  Instrumentation( const Instrumentation & Other ) = delete;
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_INSTRUMENTATION
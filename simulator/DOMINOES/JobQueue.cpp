@@ -0,0 +1,390 @@
+/*==============================================================================
+Job Queue
+
+This implements the job queue of the daemon. All the state of the queue is
+protected by one lock, which is only held while the jobs are taken or
+finished, and never while the work of a job is done.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <sstream>                           // For nicely formatted errors
+#include <algorithm>                         // Maximum
+#include <exception>                         // Standard exceptions
+
+#include "JobQueue.hpp"                      // The class definition
+
+/*==============================================================================
+
+ States and order
+
+==============================================================================*/
+
+std::string Dominoes::JobQueue::StateName( State TheState )
+{
+  switch ( TheState )
+  {
+    case State::Queued:    return "Queued";
+    case State::Running:   return "Running";
+    case State::Completed: return "Completed";
+    case State::Failed:    return "Failed";
+    case State::Cancelled: return "Cancelled";
+    case State::Expired:   return "Expired";
+  }
+
+  return "Unknown";
+}
+
+// Jobs of higher priority come first, then the jobs with the earliest
+// deadline where jobs without a deadline have the latest possible deadline,
+// and finally the jobs in the order they were submitted.
+
+bool Dominoes::JobQueue::Order::operator< ( const Order & Other ) const
+{
+  if ( Priority != Other.Priority )
+    return Priority > Other.Priority;
+  else if ( Due != Other.Due )
+    return Due < Other.Due;
+  else
+    return Number < Other.Number;
+}
+
+/*==============================================================================
+
+ Workers
+
+==============================================================================*/
+//
+// Finishing a job records the final outcome and wakes up the clients waiting
+// for results. A finished job is remembered so that the oldest results can
+// be forgotten if they are not fetched. The number of the job finished may
+// already be forgotten when the list of finished jobs is trimmed, and then
+// erasing it has no effect.
+
+void Dominoes::JobQueue::Finish( Job & TheJob, State Final, std::string Result )
+{
+  TheJob.Current = Outcome{ Final, std::move( Result ) };
+  TheJob.Task    = Work();
+
+  switch ( Final )
+  {
+    case State::Completed: CompletedJobs++; break;
+    case State::Failed:    FailedJobs++;    break;
+    case State::Cancelled: CancelledJobs++; break;
+    case State::Expired:   ExpiredJobs++;   break;
+    default: break;
+  }
+
+  Finished.push_back( TheJob.Number );
+
+  while ( Finished.size() > MaximalFinished )
+  {
+    Jobs.erase( Finished.front() );
+    Finished.pop_front();
+  }
+
+  JobFinished.notify_all();
+}
+
+// A worker takes the first job of the queue, and expires it if its deadline
+// has already passed. Otherwise the work is done without holding the lock,
+// and the outcome is recorded when the work returns. A job whose token has
+// been cancelled while it was running is reported as cancelled even if the
+// work returned a result, since the result is likely to be incomplete.
+// The job is looked up again after the work is done since other jobs may
+// have been submitted or forgotten in the mean time.
+
+void Dominoes::JobQueue::Worker( unsigned int WorkerNumber )
+{
+  std::unique_lock< std::mutex > Guard( Lock );
+
+  while ( true )
+  {
+    JobAvailable.wait( Guard, [this](void){
+      return Closing || !Queue.empty(); });
+
+    if ( Closing )
+      return;
+
+    const JobID Number = Queue.begin()->Number;
+
+    Queue.erase( Queue.begin() );
+
+    Job & Next( Jobs.at( Number ) );
+    const auto Now = Anytime::Clock::now();
+
+    if ( Next.Due && ( *Next.Due <= Now ) )
+    {
+      Finish( Next, State::Expired,
+              "The deadline passed before the job was started" );
+      continue;
+    }
+
+    Next.Current.Status = State::Running;
+    Next.Started        = Now;
+    TotalWait          += Now - Next.Submitted;
+    StartedJobs++;
+    RunningJobs++;
+
+    Work                  Task( std::move( Next.Task ) );
+    NL::CancellationToken Token( Next.Token );
+    Deadline              Due( Next.Due );
+    State                 Final = State::Completed;
+    std::string           Result;
+
+    Guard.unlock();
+
+    try
+    {
+      Result = Task( WorkerNumber, Token, Due );
+    }
+    catch ( std::exception & Error )
+    {
+      Final  = State::Failed;
+      Result = Error.what();
+    }
+    catch (...)
+    {
+      Final  = State::Failed;
+      Result = "The job failed with an unknown exception";
+    }
+
+    if ( Token.IsCancelled() && ( Final == State::Completed ) )
+    {
+      Final  = State::Cancelled;
+      Result = "The job was cancelled";
+    }
+
+    Guard.lock();
+
+    RunningJobs--;
+    ServedJobs++;
+
+    auto Served = Jobs.find( Number );
+
+    if ( Served != Jobs.end() )
+    {
+      TotalService += Anytime::Clock::now() - Served->second.Started;
+      Finish( Served->second, Final, std::move( Result ) );
+    }
+  }
+}
+
+/*==============================================================================
+
+ Clients
+
+==============================================================================*/
+//
+// Submitting a job checks that the queue accepts it, before the job is
+// stored and a worker is woken up.
+
+Dominoes::JobQueue::JobID
+Dominoes::JobQueue::Submit( Work Task, int Priority, Deadline Due,
+                            NL::CancellationToken Token )
+{
+  std::lock_guard< std::mutex > Guard( Lock );
+
+  if ( Closing ||
+       ( ( MaximalQueueDepth > 0 ) && ( Queue.size() >= MaximalQueueDepth ) ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    RejectedJobs++;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": ";
+
+    if ( Closing )
+      ErrorMessage << "The job queue is closed";
+    else
+      ErrorMessage << "The job queue is full with " << Queue.size()
+                   << " queued jobs";
+
+    throw Rejected( ErrorMessage.str() );
+  }
+
+  const JobID Number = NextJob++;
+  const auto  Now    = Anytime::Clock::now();
+
+  Jobs.emplace( Number, Job{ std::move( Task ), Priority, Due, Token, Number,
+                             Outcome{ State::Queued, std::string() },
+                             Now, Now } );
+
+  Queue.insert( Order{ Priority,
+                       Due ? *Due : Anytime::Clock::time_point::max(),
+                       Number } );
+
+  MaximalQueued = std::max( MaximalQueued, Queue.size() );
+
+  JobAvailable.notify_one();
+
+  return Number;
+}
+
+// Waiting for a job waits until the job is either finished or forgotten. In
+// the latter case another client has fetched the result first, and the job
+// is unknown as if it never existed.
+
+Dominoes::JobQueue::Outcome Dominoes::JobQueue::Wait( JobID Number )
+{
+  std::unique_lock< std::mutex > Guard( Lock );
+
+  JobFinished.wait( Guard, [&](void){
+    auto TheJob = Jobs.find( Number );
+    return ( TheJob == Jobs.end() ) || TheJob->second.Current.IsFinal();
+  });
+
+  auto TheJob = Jobs.find( Number );
+
+  if ( TheJob == Jobs.end() )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "There is no job " << Number;
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  Outcome Result( std::move( TheJob->second.Current ) );
+
+  Jobs.erase( TheJob );
+
+  return Result;
+}
+
+// Polling returns the current outcome, and forgets the job if it is final.
+
+Dominoes::JobQueue::Outcome Dominoes::JobQueue::Poll( JobID Number )
+{
+  std::lock_guard< std::mutex > Guard( Lock );
+
+  auto TheJob = Jobs.find( Number );
+
+  if ( TheJob == Jobs.end() )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "There is no job " << Number;
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  if ( !TheJob->second.Current.IsFinal() )
+    return TheJob->second.Current;
+
+  Outcome Result( std::move( TheJob->second.Current ) );
+
+  Jobs.erase( TheJob );
+
+  return Result;
+}
+
+// A queued job is removed from the queue and finished directly, whereas a
+// running job is finished by its worker when the work returns.
+
+bool Dominoes::JobQueue::Cancel( JobID Number )
+{
+  std::lock_guard< std::mutex > Guard( Lock );
+
+  auto TheJob = Jobs.find( Number );
+
+  if ( ( TheJob == Jobs.end() ) || TheJob->second.Current.IsFinal() )
+    return false;
+
+  Job & Cancelled( TheJob->second );
+
+  Cancelled.Token.Cancel();
+
+  if ( Cancelled.Current.Status == State::Queued )
+  {
+    Queue.erase( Order{ Cancelled.Priority,
+                 Cancelled.Due ? *Cancelled.Due
+                               : Anytime::Clock::time_point::max(),
+                 Number } );
+
+    Finish( Cancelled, State::Cancelled, "The job was cancelled" );
+  }
+
+  return true;
+}
+
+// The statistics are taken under the lock so that they are consistent
+
+Dominoes::JobQueue::Statistics Dominoes::JobQueue::Metrics( void ) const
+{
+  using std::chrono::duration_cast;
+  using std::chrono::milliseconds;
+
+  std::lock_guard< std::mutex > Guard( Lock );
+
+  return Statistics{
+    static_cast< unsigned int >( Workers.size() ),
+    Queue.size(), RunningJobs, Jobs.size() - Queue.size() - RunningJobs,
+    MaximalQueued, CompletedJobs, FailedJobs, CancelledJobs, ExpiredJobs,
+    RejectedJobs,
+    StartedJobs > 0 ? duration_cast< milliseconds >( TotalWait / StartedJobs )
+                    : milliseconds::zero(),
+    ServedJobs > 0  ? duration_cast< milliseconds >( TotalService / ServedJobs )
+                    : milliseconds::zero() };
+}
+
+/*==============================================================================
+
+ Constructor and destructor
+
+==============================================================================*/
+//
+// Closing finishes all the queued jobs as cancelled and cancels the running
+// jobs before the workers are told to terminate. The workers finish the
+// running jobs before they terminate.
+
+void Dominoes::JobQueue::Close( void )
+{
+  {
+    std::lock_guard< std::mutex > Guard( Lock );
+
+    if ( Closing )
+      return;
+
+    for ( const Order & Queued : Queue )
+      Finish( Jobs.at( Queued.Number ), State::Cancelled,
+              "The job queue was closed" );
+
+    Queue.clear();
+
+    for ( auto & [ Number, TheJob ] : Jobs )
+      if ( TheJob.Current.Status == State::Running )
+        TheJob.Token.Cancel();
+
+    Closing = true;
+  }
+
+  JobAvailable.notify_all();
+
+  for ( std::thread & TheWorker : Workers )
+    TheWorker.join();
+}
+
+Dominoes::JobQueue::JobQueue( unsigned int NumberOfWorkers,
+                              std::size_t QueueDepth )
+: Jobs(), Queue(), Finished(), MaximalQueueDepth( QueueDepth ),
+  NextJob(1), RunningJobs(0), MaximalQueued(0), CompletedJobs(0),
+  FailedJobs(0), CancelledJobs(0), ExpiredJobs(0), RejectedJobs(0),
+  StartedJobs(0), ServedJobs(0), TotalWait( Anytime::Clock::duration::zero() ),
+  TotalService( Anytime::Clock::duration::zero() ),
+  Lock(), JobAvailable(), JobFinished(), Closing( false ), Workers()
+{
+  if ( NumberOfWorkers == 0 )
+    NumberOfWorkers = std::max( 1U, std::thread::hardware_concurrency() );
+
+  for ( unsigned int i = 0; i < NumberOfWorkers; i++ )
+    Workers.emplace_back( &JobQueue::Worker, this, i );
+}
+
+Dominoes::JobQueue::~JobQueue( void )
+{
+  Close();
+}
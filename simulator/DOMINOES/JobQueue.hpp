@@ -0,0 +1,243 @@
+/*==============================================================================
+Job Queue
+
+The daemon used to serve one scenario at the time, so a long running scenario
+held back all other requests even on a machine with many cores. The job queue
+decouples the receipt of a request from its solution: a job is submitted to
+the queue and identified by a number, and a bounded pool of worker threads
+takes the jobs from the queue and solves them. The result of a job is kept
+until it is fetched by its job number, so the client can submit many jobs and
+collect the results later, possibly over another connection.
+
+Each job has a priority and an optional deadline. The workers always take the
+queued job with the highest priority, and among jobs of equal priority the one
+with the earliest deadline, and jobs without a deadline in the order they
+were submitted. A job whose deadline passes while it is still queued is
+expired without being started since its result would not be useful. The
+deadline of a running job is given to the work function, which is expected to
+stop and return the best result found when it has passed.
+
+Admission control keeps the latency predictable under load: if the given
+number of jobs are already waiting in the queue, a new job is rejected
+immediately with a Rejected exception, and the client can retry later or send
+the job elsewhere. A queue depth of zero means that the queue is unbounded.
+The results of finished jobs are kept until they are fetched, but only the
+most recent finished jobs are kept if they are not fetched, so that clients
+that never collect their results cannot exhaust the memory.
+
+A job can be cancelled. A queued job is then removed from the queue, and the
+cancellation token of a running job is cancelled so that the work function
+can stop early. The queue counts the jobs in each state, the rejected jobs and
+the largest number of queued jobs seen, and measures the average time the
+jobs wait in the queue and the average time they take to be served.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_JOB_QUEUE
+#define DOMINOES_JOB_QUEUE
+
+#include <string>                            // Results and error messages
+#include <vector>                            // The workers
+#include <set>                               // The queue order
+#include <deque>                             // Finished jobs
+#include <unordered_map>                     // The jobs by number
+#include <functional>                        // The work functions
+#include <optional>                          // Optional deadlines
+#include <thread>                            // The workers
+#include <mutex>                             // Protecting the queue
+#include <condition_variable>                // Waiting for jobs and results
+#include <stdexcept>                         // Rejected jobs
+#include <chrono>                            // Waiting and service times
+#include <cstdint>                           // Job numbers
+#include <cstddef>                           // Queue sizes
+
+#include "Anytime.hpp"                       // The deadline clock
+#include "NonLinear/Cancellation.hpp"        // Cancelling running jobs
+
+namespace Dominoes {
+
+namespace NL = Optimization::NonLinear;
+
+class JobQueue
+{
+public:
+
+  using JobID    = std::uint64_t;
+  using Deadline = std::optional< Anytime::Clock::time_point >;
+
+  // The work of a job is given the number of the worker executing it, which
+  // allows the work to use data kept by each worker, the cancellation token
+  // of the job, and the deadline of the job. It returns the result as a
+  // string, and it should throw a standard exception if it fails.
+
+  using Work = std::function< std::string( unsigned int Worker,
+                                           const NL::CancellationToken & Token,
+                                           const Deadline & JobDeadline ) >;
+
+  // A job that is not admitted to the queue throws a Rejected exception so
+  // that the client can distinguish a busy queue from a failed job.
+
+  class Rejected : public std::runtime_error
+  {
+  public:
+
+    Rejected( const std::string & Message )
+    : std::runtime_error( Message )
+    {}
+  };
+
+  // The states of a job. The last four are final, and the result of a job in
+  // a final state is either the string returned by the work function or the
+  // reason why the job did not complete.
+
+  enum class State
+  {
+    Queued,
+    Running,
+    Completed,
+    Failed,
+    Cancelled,
+    Expired
+  };
+
+  static std::string StateName( State TheState );
+
+  class Outcome
+  {
+  public:
+
+    State       Status;
+    std::string Result;
+
+    inline bool IsFinal( void ) const
+    { return ( Status != State::Queued ) && ( Status != State::Running ); }
+  };
+
+  // The statistics of the queue
+
+  class Statistics
+  {
+  public:
+
+    unsigned int              Workers;
+    std::size_t               Queued, Running, Unfetched, MaximalQueued,
+                              Completed, Failed, Cancelled, Expired, Rejected;
+    std::chrono::milliseconds MeanWait, MeanService;
+  };
+
+private:
+
+  // A job has its work, its scheduling parameters, and its current state
+  // with the time it was submitted and the time it was started.
+
+  class Job
+  {
+  public:
+
+    Work                       Task;
+    int                        Priority;
+    Deadline                   Due;
+    NL::CancellationToken      Token;
+    JobID                      Number;
+    Outcome                    Current;
+    Anytime::Clock::time_point Submitted, Started;
+  };
+
+  // The queue is ordered by priority, deadline and job number, and the set
+  // allows queued jobs to be removed when they are cancelled.
+
+  class Order
+  {
+  public:
+
+    int                        Priority;
+    Anytime::Clock::time_point Due;
+    JobID                      Number;
+
+    bool operator< ( const Order & Other ) const;
+  };
+
+  std::unordered_map< JobID, Job > Jobs;
+  std::set< Order >                Queue;
+  std::deque< JobID >              Finished;
+
+  // The limits of the queue
+
+  const std::size_t MaximalQueueDepth;
+  static constexpr std::size_t MaximalFinished = 4096;
+
+  // The counters and the accumulated times for the statistics
+
+  JobID                      NextJob;
+  std::size_t                RunningJobs, MaximalQueued, CompletedJobs,
+                             FailedJobs, CancelledJobs, ExpiredJobs,
+                             RejectedJobs, StartedJobs, ServedJobs;
+  Anytime::Clock::duration   TotalWait, TotalService;
+
+  // Synchronisation. The workers wait for jobs to become available, and the
+  // clients wait for jobs to finish.
+
+  mutable std::mutex      Lock;
+  std::condition_variable JobAvailable, JobFinished;
+  bool                    Closing;
+
+  std::vector< std::thread > Workers;
+
+  // Finishing a job sets its final state, updates the counters, and
+  // removes the oldest finished jobs if too many results are kept. It must
+  // be called with the lock held.
+
+  void Finish( Job & TheJob, State Final, std::string Result );
+
+  // The workers run the following loop until the queue is closed
+
+  void Worker( unsigned int WorkerNumber );
+
+public:
+
+  // Submitting a job returns its number. It throws a Rejected exception if
+  // the queue is full or closed.
+
+  JobID Submit( Work Task, int Priority = 0, Deadline Due = std::nullopt,
+                NL::CancellationToken Token = NL::CancellationToken() );
+
+  // The outcome of a job is returned by Wait when the job has finished, and
+  // by Poll immediately. The job is forgotten when its final outcome has
+  // been returned. An invalid argument exception is thrown if the job is
+  // unknown, for instance because it has already been fetched.
+
+  Outcome Wait( JobID Number );
+  Outcome Poll( JobID Number );
+
+  // Cancelling a job returns false if the job has already finished.
+
+  bool Cancel( JobID Number );
+
+  // The current statistics
+
+  Statistics Metrics( void ) const;
+
+  inline unsigned int size( void ) const
+  { return static_cast< unsigned int >( Workers.size() ); }
+
+  // Closing the queue cancels the queued and the running jobs and waits for
+  // the workers to terminate. It is called by the destructor.
+
+  void Close( void );
+
+  // The constructor starts the given number of workers, or one worker per
+  // core if the number is zero, and takes the maximal number of queued jobs
+  // where zero means no limit.
+
+  JobQueue( unsigned int NumberOfWorkers, std::size_t QueueDepth = 0 );
+
+  JobQueue( void ) = delete;
+  JobQueue( const JobQueue & Other ) = delete;
+
+  ~JobQueue( void );
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_JOB_QUEUE
@@ -0,0 +1,98 @@
+/*==============================================================================
+Partition
+
+This implements the partition of the consumers into independent components.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <algorithm>                         // Searching and sorting
+#include <iterator>                          // Iterator distance
+#include <numeric>                           // Filling the order
+
+#include "Partition.hpp"                     // The class definition
+
+Dominoes::Partition::Partition( const std::list< Consumer > & Consumers,
+                                const SampleTime & ProductionTimes,
+                                Interpolation::Type GridInterpolation )
+: Components()
+{
+  if ( Consumers.empty() ) return;
+
+  // The range of production samples covered by each consumer is found by
+  // binary search on the time axis. A consumer covering no samples is given
+  // the range of the sample after its coverage, which is conservative as it
+  // can only merge components that are independent.
+
+  const auto FirstTime = ProductionTimes->begin(),
+             LastTime  = ProductionTimes->end();
+
+  std::vector< Index > FirstSample, LastSample;
+
+  for ( const Consumer & TheConsumer : Consumers )
+  {
+    const CoSSMic::TimeInterval StartInterval( TheConsumer.GetStartInterval() );
+
+    Index First = std::distance( FirstTime,
+                  std::lower_bound( FirstTime, LastTime, StartInterval.lower() ) ),
+          Last  = std::distance( FirstTime,
+                  std::upper_bound( FirstTime, LastTime,
+                  StartInterval.upper() + TheConsumer.GetDuration() ) );
+
+    FirstSample.push_back( First );
+    LastSample.push_back( ( Last > First ) ? Last - 1 : First );
+  }
+
+  // The minimal number of samples from the last sample of one component to
+  // the first sample of the next component for the two to be independent.
+
+  const Index Separation =
+        ( GridInterpolation == Interpolation::Type::Linear ) ? 1 : 4;
+
+  // The consumers are visited in the order of their first sample, and the
+  // last sample covered by the current component is kept.
+
+  std::vector< Index > Order( Consumers.size() );
+
+  std::iota( Order.begin(), Order.end(), 0 );
+  std::stable_sort( Order.begin(), Order.end(), [&]( Index A, Index B ){
+    return FirstSample[A] < FirstSample[B]; });
+
+  Index ComponentEnd = LastSample[ Order.front() ];
+
+  Components.emplace_back( 1, Order.front() );
+
+  for ( auto Consumer = std::next( Order.begin() ); Consumer != Order.end();
+        ++Consumer )
+    if ( FirstSample[ *Consumer ] < ComponentEnd + Separation )
+    {
+      Components.back().push_back( *Consumer );
+      ComponentEnd = std::max( ComponentEnd, LastSample[ *Consumer ] );
+    }
+    else
+    {
+      Components.emplace_back( 1, *Consumer );
+      ComponentEnd = LastSample[ *Consumer ];
+    }
+
+  // Components with a single consumer are merged with the previous component
+  // or the next component if there is no previous component.
+
+  std::vector< Component > Merged;
+
+  for ( Component & TheComponent : Components )
+    if ( !Merged.empty() &&
+         ( ( TheComponent.size() < 2 ) || ( Merged.back().size() < 2 ) ) )
+      Merged.back().insert( Merged.back().end(), TheComponent.begin(),
+                            TheComponent.end() );
+    else
+      Merged.push_back( std::move( TheComponent ) );
+
+  // The consumers of each component are kept in the order of the variables
+
+  for ( Component & TheComponent : Merged )
+    std::sort( TheComponent.begin(), TheComponent.end() );
+
+  Components = std::move( Merged );
+}
@@ -0,0 +1,89 @@
+/*==============================================================================
+Partition
+
+A consumer can only contribute to the total consumption at the production
+samples inside its time coverage from the earliest start time to the latest
+start time plus the duration of the consumption. If the coverages of two sets
+of consumers share no production samples, the total consumption at every
+sample comes from at most one of the sets, and the grid deficit is the sum of
+the deficits of the sets computed separately. The integral of the linearly
+interpolated deficit is then additive over the sets, and the start times of
+each set can be optimised independently of the other sets as a problem of
+smaller dimension.
+
+The integral of the deficit interpolated by Steffen's method over one sample
+interval depends on the deficit at the two samples of the interval and at the
+sample before and after the interval. Two sets are therefore only independent
+under this interpolation if at least three production samples are between
+the last sample covered by the first set and the first sample covered by the
+second set.
+
+The partition sorts the consumers by the first production sample they cover
+and collects them into connected components: A consumer is added to the
+current component if it is not independent of the component, and otherwise it
+starts a new component. The BOBYQA algorithm needs at least two variables, and
+a component with a single consumer is therefore merged with the previous
+component, or with the next if it is the first component. Merging independent
+consumers does not change the optimal solution.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_PARTITION
+#define DOMINOES_PARTITION
+
+#include <vector>                            // Standard vectors
+#include <list>                              // The list of consumers
+
+#include "Interpolation.hpp"                 // Grid energy interpolation
+
+#include "Typedefs.hpp"                      // Dominoes types
+#include "Consumer.hpp"                      // The consumer actors
+#include "ConsumptionBlock.hpp"              // Consumer indices
+
+namespace Dominoes {
+
+class Partition
+{
+public:
+
+  // Each component is given by the indices of its consumers in the order of
+  // the variables, i.e. the order of the list of consumers.
+
+  using Index     = ConsumptionBlock::Index;
+  using Component = std::vector< Index >;
+
+private:
+
+  std::vector< Component > Components;
+
+public:
+
+  // Access to the components follows the standard containers
+
+  inline std::vector< Component >::size_type size( void ) const
+  { return Components.size(); }
+
+  inline const Component & operator[] ( std::vector< Component >::size_type i ) const
+  { return Components[i]; }
+
+  inline std::vector< Component >::const_iterator begin( void ) const
+  { return Components.cbegin(); }
+
+  inline std::vector< Component >::const_iterator end( void ) const
+  { return Components.cend(); }
+
+  // The constructor takes the consumers, the production sample times, and
+  // the interpolation used for the grid energy. The time axis must have been
+  // extended to cover all the consumers.
+
+  Partition( const std::list< Consumer > & Consumers,
+             const SampleTime & ProductionTimes,
+             Interpolation::Type GridInterpolation );
+
+  Partition( void ) = delete;
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_PARTITION
@@ -0,0 +1,139 @@
+/*==============================================================================
+Problem Capture
+
+This implements the writing and reading of a captured problem.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <string>                            // The header line
+#include <sstream>                           // For nicely formatted errors
+#include <stdexcept>                         // Standard exceptions
+#include <limits>                            // Precision of written values
+#include <algorithm>                         // Checking the time axis
+
+#include "ProblemCapture.hpp"                // The class definition
+
+// The header identifies the format and its version
+
+namespace
+{
+  const std::string CaptureHeader( "DOMINOES-PROBLEM 1" );
+}
+
+// Writing the problem writes the values with the precision needed to read
+// back the same double values.
+
+void Dominoes::ProblemCapture::Write( std::ostream & Output,
+     const std::vector< CoSSMic::Time > & ProductionTimes,
+     const std::vector< double > & Production,
+     const std::vector< Interval > & StartIntervals,
+     const ConsumptionBlock & ConsumerProfiles )
+{
+  if ( ( Production.size() != ProductionTimes.size() ) ||
+       ( StartIntervals.size() != ConsumerProfiles.size() ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "A problem with " << ProductionTimes.size()
+                 << " sample times and " << StartIntervals.size()
+                 << " start intervals cannot have " << Production.size()
+                 << " production values and " << ConsumerProfiles.size()
+                 << " consumers";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  const auto Precision =
+             Output.precision( std::numeric_limits< double >::max_digits10 );
+
+  Output << CaptureHeader << "\n" << ProductionTimes.size() << "\n";
+
+  for ( CoSSMic::Time TimeStamp : ProductionTimes )
+    Output << TimeStamp << " ";
+
+  Output << "\n";
+
+  for ( double Energy : Production )
+    Output << Energy << " ";
+
+  Output << "\n" << StartIntervals.size() << "\n";
+
+  for ( const Interval & StartInterval : StartIntervals )
+    Output << StartInterval.lower() << " " << StartInterval.upper() << "\n";
+
+  Output.precision( Precision );
+
+  ConsumerProfiles.Write( Output );
+}
+
+// Reading the problem checks the header and that the sample times are
+// increasing before the block is read.
+
+Dominoes::ProblemCapture::ProblemCapture( std::istream & Input )
+: ProductionSamples( std::make_shared< std::vector< CoSSMic::Time > >() ),
+  IntervalProduction(), Bounds(), Profiles()
+{
+  std::string Header;
+  std::size_t Samples = 0, Consumers = 0;
+
+  std::getline( Input, Header );
+  Input >> Samples;
+
+  if ( !Input || ( Header != CaptureHeader ) || ( Samples == 0 ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The stream does not start a captured problem";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  ProductionSamples->resize( Samples );
+  IntervalProduction.resize( Samples );
+
+  for ( CoSSMic::Time & TimeStamp : *ProductionSamples )
+    Input >> TimeStamp;
+
+  for ( double & Energy : IntervalProduction )
+    Input >> Energy;
+
+  Input >> Consumers;
+
+  for ( std::size_t Consumer = 0; Input && ( Consumer < Consumers ); Consumer++ )
+  {
+    Optimization::VariableType Lower, Upper;
+
+    Input >> Lower >> Upper;
+    Bounds.emplace_back( Lower, Upper );
+  }
+
+  if ( !Input || !std::is_sorted( ProductionSamples->begin(),
+                                  ProductionSamples->end() ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The production and the start intervals of the captured "
+                 << "problem could not be read";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  Profiles = std::make_unique< ConsumptionBlock >( Input, ProductionSamples );
+
+  if ( Profiles->size() != Bounds.size() )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The captured problem has " << Bounds.size()
+                 << " start intervals but " << Profiles->size()
+                 << " consumers";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+}
@@ -0,0 +1,95 @@
+/*==============================================================================
+Problem Capture
+
+The choice of the optimisation algorithm and its parameters should be based on
+how the algorithms perform on the real scheduling problem, and not only on
+standard test functions. The problem of a scenario is however only available
+inside the solver after the consumer actors have loaded and tabulated their
+profiles, and running the consumers for every benchmark run would measure the
+actor system more than the algorithms.
+
+The in-process objective function is completely defined by the production
+sample times, the production in each sample interval, the start time interval
+of each consumer, and the consumption block with the tabulated profiles of
+the consumers. The problem capture writes these to a stream, and reads them
+back to replay the objective function with the incremental consumption and
+the grid cost exactly as the searches of the solver evaluate it.
+
+The capture is a text file starting with the line "DOMINOES-PROBLEM 1"
+followed by the number of production samples and the sample times, the
+production of each sample interval, the number of consumers and the lower and
+upper bounds of the start time of each consumer, and finally the consumption
+block as written by the block. An invalid argument exception is thrown if the
+stream does not contain a valid capture.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_PROBLEM_CAPTURE
+#define DOMINOES_PROBLEM_CAPTURE
+
+#include <vector>                            // Standard vectors
+#include <memory>                            // The consumption block
+#include <istream>                           // Reading a capture
+#include <ostream>                           // Writing a capture
+
+#include <boost/numeric/interval.hpp>        // Start time intervals
+
+#include "Variables.hpp"                     // Optimization variables
+#include "TimeInterval.hpp"                  // The CoSSMic time
+#include "Typedefs.hpp"                      // Dominoes types
+#include "ConsumptionBlock.hpp"              // The consumption profiles
+
+namespace Dominoes {
+
+class ProblemCapture
+{
+public:
+
+  using Interval = boost::numeric::interval< Optimization::VariableType >;
+
+private:
+
+  // The problem data is owned by the capture since the grid cost and the
+  // incremental consumption refer to it.
+
+  SampleTime                          ProductionSamples;
+  std::vector< double >               IntervalProduction;
+  std::vector< Interval >             Bounds;
+  std::unique_ptr< ConsumptionBlock > Profiles;
+
+public:
+
+  // The problem is written from the data of the solver
+
+  static void Write( std::ostream & Output,
+                     const std::vector< CoSSMic::Time > & ProductionTimes,
+                     const std::vector< double > & Production,
+                     const std::vector< Interval > & StartIntervals,
+                     const ConsumptionBlock & ConsumerProfiles );
+
+  // The data of a captured problem can be read by interface functions
+
+  inline const SampleTime & GetProductionSamples( void ) const
+  { return ProductionSamples; }
+
+  inline const std::vector< double > & GetIntervalProduction( void ) const
+  { return IntervalProduction; }
+
+  inline const std::vector< Interval > & GetBounds( void ) const
+  { return Bounds; }
+
+  inline const ConsumptionBlock & GetProfiles( void ) const
+  { return *Profiles; }
+
+  // The constructor reads the captured problem from the stream
+
+  ProblemCapture( std::istream & Input );
+
+  ProblemCapture( void ) = delete;
+  ProblemCapture( const ProblemCapture & Other ) = delete;
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_PROBLEM_CAPTURE
@@ -0,0 +1,371 @@
+/*==============================================================================
+Profile Cache
+
+This implements the look-up and the creation of the cached consumption
+kernels.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <map>                               // The parsed profile
+#include <fstream>                           // Reading the profile file
+#include <sstream>                           // For nicely formatted errors
+#include <stdexcept>                         // Standard exceptions
+#include <utility>                           // Moving the profile
+#include <algorithm>                         // Filling digest blocks
+
+#include "CSVtoTimeSeries.hpp"               // To read CSV files
+#include "Interpolation.hpp"                 // Interpolating the profile
+#include "ProfileCache.hpp"                  // The class definition
+
+// The static members
+
+std::unordered_map< Dominoes::ProfileCache::ContentKey,
+                    Dominoes::ProfileCache::KernelFuture,
+                    Dominoes::ProfileCache::ContentHash >
+Dominoes::ProfileCache::ByContent;
+
+std::unordered_map< std::string, Dominoes::ProfileCache::FileRecord >
+Dominoes::ProfileCache::ByFile;
+
+std::mutex Dominoes::ProfileCache::CacheLock;
+
+// -----------------------------------------------------------------------------
+// Content digest
+// -----------------------------------------------------------------------------
+//
+// The digest is the 128 bit MurmurHash3 of Austin Appleby with zero seed,
+// computed over blocks of 16 bytes. The words of a block are assembled from
+// the bytes in little endian order so that the digest does not depend on the
+// byte order of the machine.
+
+namespace
+{
+  constexpr std::uint64_t C1 = 0x87c37b91114253d5ULL,
+                          C2 = 0x4cf5ad432745937fULL;
+
+  inline std::uint64_t RotateLeft( std::uint64_t Word, int Bits )
+  { return ( Word << Bits ) | ( Word >> ( 64 - Bits ) ); }
+
+  inline std::uint64_t Word( const unsigned char * Bytes )
+  {
+    std::uint64_t Result = 0;
+
+    for ( int i = 7; i >= 0; i-- )
+      Result = ( Result << 8 ) | Bytes[i];
+
+    return Result;
+  }
+
+  inline std::uint64_t FinalMix( std::uint64_t Word )
+  {
+    Word ^= Word >> 33;
+    Word *= 0xff51afd7ed558ccdULL;
+    Word ^= Word >> 33;
+    Word *= 0xc4ceb9fe1a85ec53ULL;
+    Word ^= Word >> 33;
+
+    return Word;
+  }
+}
+
+void Dominoes::ProfileCache::ContentDigest::Mix( const unsigned char * Block )
+{
+  std::uint64_t K1 = Word( Block ), K2 = Word( Block + 8 );
+
+  K1 *= C1; K1 = RotateLeft( K1, 31 ); K1 *= C2; State[0] ^= K1;
+
+  State[0] = RotateLeft( State[0], 27 ) + State[1];
+  State[0] = State[0] * 5 + 0x52dce729;
+
+  K2 *= C2; K2 = RotateLeft( K2, 33 ); K2 *= C1; State[1] ^= K2;
+
+  State[1] = RotateLeft( State[1], 31 ) + State[0];
+  State[1] = State[1] * 5 + 0x38495ab5;
+}
+
+// Adding bytes first completes a pending block, then mixes the complete
+// blocks directly from the given bytes, and keeps the remaining bytes pending.
+
+void Dominoes::ProfileCache::ContentDigest::Add( const void * Bytes,
+                                                 std::size_t Count )
+{
+  const unsigned char * Byte = static_cast< const unsigned char * >( Bytes );
+
+  Length += Count;
+
+  if ( PendingBytes > 0 )
+  {
+    std::size_t Fill = std::min( Count, sizeof( Pending ) - PendingBytes );
+
+    std::copy_n( Byte, Fill, Pending + PendingBytes );
+    PendingBytes += Fill;
+    Byte         += Fill;
+    Count        -= Fill;
+
+    if ( PendingBytes < sizeof( Pending ) ) return;
+
+    Mix( Pending );
+    PendingBytes = 0;
+  }
+
+  for ( ; Count >= sizeof( Pending ); Byte += sizeof( Pending ),
+                                      Count -= sizeof( Pending ) )
+    Mix( Byte );
+
+  std::copy_n( Byte, Count, Pending );
+  PendingBytes = Count;
+}
+
+// The value mixes the pending bytes as a zero padded block, and then the
+// length of the content, without changing the digest so that more bytes could
+// still be added.
+
+Dominoes::ProfileCache::DigestValue
+Dominoes::ProfileCache::ContentDigest::Value( void ) const
+{
+  std::uint64_t H1 = State[0], H2 = State[1];
+
+  if ( PendingBytes > 0 )
+  {
+    unsigned char Tail[16] = {};
+
+    std::copy_n( Pending, PendingBytes, Tail );
+
+    std::uint64_t K1 = Word( Tail ), K2 = Word( Tail + 8 );
+
+    K2 *= C2; K2 = RotateLeft( K2, 33 ); K2 *= C1; H2 ^= K2;
+    K1 *= C1; K1 = RotateLeft( K1, 31 ); K1 *= C2; H1 ^= K1;
+  }
+
+  H1 ^= Length;
+  H2 ^= Length;
+
+  H1 += H2;
+  H2 += H1;
+
+  H1 = FinalMix( H1 );
+  H2 = FinalMix( H2 );
+
+  H1 += H2;
+  H2 += H1;
+
+  return DigestValue{ H1, H2 };
+}
+
+// -----------------------------------------------------------------------------
+// Kernels
+// -----------------------------------------------------------------------------
+
+// Creating the kernel parses the profile file, interpolates the cumulative
+// energy and tabulates it as this was done by each consumer before the cache
+// was introduced.
+
+Dominoes::ProfileCache::KernelPointer
+Dominoes::ProfileCache::CreateKernel( const std::filesystem::path & FileName,
+                                      CoSSMic::Time Step )
+{
+  std::map< CoSSMic::Time, double >
+  LoadProfile( CoSSMic::CSVtoTimeSeries( FileName ) );
+
+  if ( LoadProfile.empty() )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The load profile " << FileName << " is empty";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  return CreateKernel( std::move( LoadProfile ), Step );
+}
+
+Dominoes::ProfileCache::KernelPointer
+Dominoes::ProfileCache::CreateKernel(
+                        std::map< CoSSMic::Time, double > LoadProfile,
+                        CoSSMic::Time Step )
+{
+  Interpolation Energy( LoadProfile );
+
+  return std::make_shared< const ConsumptionKernel >( Energy,
+                           LoadProfile.rbegin()->first, Step );
+}
+
+// The look-up first checks if the file has already been read and is unchanged,
+// and if not the file is read in blocks to compute the digest of its content,
+// which is used to find the kernel. If
+// it is not in the cache, this thread becomes responsible for computing the
+// kernel. If this fails, the entries are removed again so that a later request
+// can retry the file, and the exception is passed on to all waiting threads.
+
+Dominoes::ProfileCache::KernelPointer
+Dominoes::ProfileCache::Kernel( const std::filesystem::path & FileName,
+                                CoSSMic::Time Step )
+{
+  if ( !std::filesystem::exists( FileName ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The load profile " << FileName << " does not exist";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  const std::string FileKey( std::filesystem::canonical( FileName ).string()
+                             + '\n' + std::to_string( Step ) );
+  const auto           WriteTime = std::filesystem::last_write_time( FileName );
+  const std::uintmax_t Size      = std::filesystem::file_size( FileName );
+
+  std::unique_lock< std::mutex > Lock( CacheLock );
+
+  auto Record = ByFile.find( FileKey );
+
+  if ( ( Record != ByFile.end() ) &&
+       ( Record->second.WriteTime == WriteTime ) &&
+       ( Record->second.Size == Size ) )
+  {
+    KernelFuture TheKernel( Record->second.Kernel );
+
+    Lock.unlock();
+    return TheKernel.get();
+  }
+
+  Lock.unlock();
+
+  std::ifstream ProfileFile( FileName, std::ios::binary );
+  ContentDigest Digest;
+  char          Block[ 4096 ];
+
+  while ( ProfileFile.read( Block, sizeof( Block ) ) ||
+          ( ProfileFile.gcount() > 0 ) )
+    Digest.Add( Block, static_cast< std::size_t >( ProfileFile.gcount() ) );
+
+  ContentKey Key{ Digest.Value(), Step };
+
+  std::promise< KernelPointer > NewKernel;
+  KernelFuture                  TheKernel;
+  bool                          Creator = false;
+
+  Lock.lock();
+
+  auto Entry = ByContent.find( Key );
+
+  if ( Entry != ByContent.end() )
+    TheKernel = Entry->second;
+  else
+  {
+    TheKernel = NewKernel.get_future().share();
+    ByContent.emplace( Key, TheKernel );
+    Creator = true;
+  }
+
+  ByFile[ FileKey ] = FileRecord{ WriteTime, Size, TheKernel };
+
+  Lock.unlock();
+
+  if ( Creator )
+    try
+    {
+      NewKernel.set_value( CreateKernel( FileName, Step ) );
+    }
+    catch (...)
+    {
+      Lock.lock();
+      ByContent.erase( Key );
+      ByFile.erase( FileKey );
+      Lock.unlock();
+
+      NewKernel.set_exception( std::current_exception() );
+    }
+
+  return TheKernel.get();
+}
+
+// The key of an in-memory profile is the digest of the null character followed
+// by the raw bytes of the time and energy of each point. The look-up is then
+// the same as for the content of a file, except that there is no file to
+// record.
+
+Dominoes::ProfileCache::KernelPointer
+Dominoes::ProfileCache::Kernel(
+                        const std::map< CoSSMic::Time, double > & LoadProfile,
+                        CoSSMic::Time Step )
+{
+  if ( LoadProfile.empty() )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The in-memory load profile is empty";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  ContentDigest Digest;
+  const char    Null = '\0';
+
+  Digest.Add( &Null, 1 );
+
+  for ( const auto & Point : LoadProfile )
+  {
+    Digest.Add( &Point.first,  sizeof( CoSSMic::Time ) );
+    Digest.Add( &Point.second, sizeof( double ) );
+  }
+
+  ContentKey Key{ Digest.Value(), Step };
+
+  std::promise< KernelPointer > NewKernel;
+  KernelFuture                  TheKernel;
+  bool                          Creator = false;
+
+  std::unique_lock< std::mutex > Lock( CacheLock );
+
+  auto Entry = ByContent.find( Key );
+
+  if ( Entry != ByContent.end() )
+    TheKernel = Entry->second;
+  else
+  {
+    TheKernel = NewKernel.get_future().share();
+    ByContent.emplace( Key, TheKernel );
+    Creator = true;
+  }
+
+  Lock.unlock();
+
+  if ( Creator )
+    try
+    {
+      NewKernel.set_value( CreateKernel( LoadProfile, Step ) );
+    }
+    catch (...)
+    {
+      Lock.lock();
+      ByContent.erase( Key );
+      Lock.unlock();
+
+      NewKernel.set_exception( std::current_exception() );
+    }
+
+  return TheKernel.get();
+}
+
+// Clearing the cache and reading its size are trivial
+
+void Dominoes::ProfileCache::Clear( void )
+{
+  std::lock_guard< std::mutex > Lock( CacheLock );
+
+  ByContent.clear();
+  ByFile.clear();
+}
+
+std::size_t Dominoes::ProfileCache::size( void )
+{
+  std::lock_guard< std::mutex > Lock( CacheLock );
+
+  return ByContent.size();
+}
@@ -0,0 +1,187 @@
+/*==============================================================================
+Profile Cache
+
+Many consumers share the same load profile, either because the same profile
+file is given for several consumers, or because different files have the same
+content since the appliances are mapped to a small number of profile clusters.
+Each consumer would otherwise parse its profile, interpolate it and tabulate
+the interpolation into its own consumption kernel.
+
+The profile cache is a process wide, read-only store of consumption kernels
+keyed on a 128 bit digest of the content of the profile file and the step of
+the kernel. A
+profile is therefore parsed, interpolated and tabulated only once, and all
+consumers with identical profiles share the same kernel through a shared
+pointer to a constant kernel. In order to avoid reading a file that has
+already been seen, the cache also records the canonical path of each file
+read together with its size and modification time, and if these have not
+changed, the kernel is returned without reading the file. The file is read
+in blocks to compute the digest, and its text is not kept by the cache.
+
+The digest is the 128 bit MurmurHash3, and two different profiles are taken
+to be equal if their digests are equal. The probability of this happening
+for n different profiles is about n^2 / 2^129, which is negligible for any
+number of profiles a simulation can hold. MurmurHash3 is not a cryptographic
+hash, but the profiles are given by the user of the solver and not by an
+adversary.
+
+A profile may also be given in memory as the cumulative energy at relative
+times, for instance when the solver is embedded in another application. Such
+profiles are keyed on the digest of their binary content, which starts with
+a null character and can therefore never equal the content of a CSV file, so
+an in-memory profile shares the kernel only with other in-memory profiles.
+
+The cache is used concurrently by the consumer actors when they load their
+profiles. If several consumers ask for the same profile at the same time, only
+the first will tabulate the kernel and the others will wait for it. The
+kernels are kept in the cache until it is explicitly cleared, but a kernel
+will remain valid for the consumers holding it also after the cache has been
+cleared.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_PROFILE_CACHE
+#define DOMINOES_PROFILE_CACHE
+
+#include <string>                            // Standard strings
+#include <memory>                            // Smart pointers
+#include <future>                            // Waiting for a kernel
+#include <mutex>                             // Protecting the cache
+#include <unordered_map>                     // The cache storage
+#include <filesystem>                        // File names
+#include <cstdint>                           // File sizes and digests
+#include <cstddef>                           // Byte counts
+#include <array>                             // Digest values
+#include <map>                               // In-memory profiles
+
+#include "TimeInterval.hpp"                  // The CoSSMic time
+#include "ConsumptionKernel.hpp"             // The cached kernels
+
+namespace Dominoes {
+
+class ProfileCache
+{
+public:
+
+  using KernelPointer = std::shared_ptr< const ConsumptionKernel >;
+
+private:
+
+  // The kernel of a profile may not yet have been computed when it is
+  // requested by another consumer, and the cache therefore stores shared
+  // futures that can be waited for by all consumers.
+
+  using KernelFuture = std::shared_future< KernelPointer >;
+
+  // The digest of the content is computed incrementally as the content is
+  // read in blocks. The bytes that do not fill a complete block of 16 bytes
+  // are kept until the next bytes are added or the digest is finished.
+
+  using DigestValue = std::array< std::uint64_t, 2 >;
+
+  class ContentDigest
+  {
+  private:
+
+    DigestValue   State;
+    unsigned char Pending[16];
+    std::size_t   PendingBytes, Length;
+
+    void Mix( const unsigned char * Block );
+
+  public:
+
+    void        Add( const void * Bytes, std::size_t Count );
+    DigestValue Value( void ) const;
+
+    ContentDigest( void )
+    : State{ 0, 0 }, Pending{}, PendingBytes( 0 ), Length( 0 )
+    {}
+  };
+
+  // The kernels are stored by the digest of the content of the profile and
+  // the step of the kernel. The digest is already a uniformly distributed
+  // hash value, and its first word is used for the hash table.
+
+  class ContentKey
+  {
+  public:
+
+    DigestValue   Digest;
+    CoSSMic::Time Step;
+
+    inline bool operator== ( const ContentKey & Other ) const
+    { return ( Step == Other.Step ) && ( Digest == Other.Digest ); }
+  };
+
+  class ContentHash
+  {
+  public:
+
+    inline std::size_t operator() ( const ContentKey & Key ) const
+    {
+      return static_cast< std::size_t >( Key.Digest[0] )
+             ^ std::hash< CoSSMic::Time >()( Key.Step );
+    }
+  };
+
+  static std::unordered_map< ContentKey, KernelFuture, ContentHash >
+  ByContent;
+
+  // The files already read are recorded by their canonical path and the
+  // kernel step, and the record holds the size and the modification time
+  // of the file when it was read.
+
+  class FileRecord
+  {
+  public:
+
+    std::filesystem::file_time_type WriteTime;
+    std::uintmax_t                  Size;
+    KernelFuture                    Kernel;
+  };
+
+  static std::unordered_map< std::string, FileRecord > ByFile;
+
+  // Both maps are protected by a common lock
+
+  static std::mutex CacheLock;
+
+  // There is a helper function to read a profile file and to create the
+  // kernel. It is called without holding the lock.
+
+  static KernelPointer CreateKernel( const std::filesystem::path & FileName,
+                                     CoSSMic::Time Step );
+
+  static KernelPointer CreateKernel(
+                       std::map< CoSSMic::Time, double > LoadProfile,
+                       CoSSMic::Time Step );
+
+public:
+
+  // The main function returns the kernel for a given profile file and step.
+  // It will throw an invalid argument exception if the file does not exist,
+  // and any exception thrown when parsing the profile will be passed on to
+  // all consumers waiting for the same kernel.
+
+  static KernelPointer Kernel( const std::filesystem::path & FileName,
+                               CoSSMic::Time Step );
+
+  // The kernel for an in-memory profile is found in the same way, and an
+  // invalid argument exception is thrown if the profile is empty.
+
+  static KernelPointer Kernel(
+                       const std::map< CoSSMic::Time, double > & LoadProfile,
+                       CoSSMic::Time Step );
+
+  // The cache can be cleared and the number of different kernels can be
+  // obtained.
+
+  static void Clear( void );
+  static std::size_t size( void );
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_PROFILE_CACHE
@@ -0,0 +1,398 @@
+/*==============================================================================
+Profile Pack
+
+This implements the mapping and validation of the profile pack and the
+look-up of profiles, clusters and programs.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <sstream>                           // For nicely formatted errors
+#include <stdexcept>                         // Standard exceptions
+#include <cstring>                           // Comparing the magic
+#include <cerrno>                            // Errors from the mapping
+#include <charconv>                          // Profile indices
+#include <algorithm>                         // Standard min
+
+#include <sys/mman.h>                        // Memory mapping
+#include <sys/stat.h>                        // File size
+#include <fcntl.h>                           // Opening the file
+#include <unistd.h>                          // Closing the file
+
+#include "ProfilePack.hpp"                   // The class definition
+
+// The static members
+
+std::shared_ptr< const Dominoes::ProfilePack >
+Dominoes::ProfilePack::ProcessPack;
+
+std::mutex Dominoes::ProfilePack::ProcessPackLock;
+
+/*==============================================================================
+
+ Profiles
+
+==============================================================================*/
+//
+// The load profile places the values at multiples of the resolution from
+// time zero, which is the format of the consumer files.
+
+std::map< CoSSMic::Time, double >
+Dominoes::ProfilePack::Profile::LoadProfile( void ) const
+{
+  std::map< CoSSMic::Time, double > TheProfile;
+
+  for ( std::size_t i = 0; i < Count; i++ )
+    TheProfile.emplace_hint( TheProfile.end(),
+                             static_cast< CoSSMic::Time >( i ) * Resolution,
+                             Values[i] );
+
+  return TheProfile;
+}
+
+/*==============================================================================
+
+ Look-up
+
+==============================================================================*/
+//
+// The members of a set are copied from the member table
+
+std::vector< std::uint32_t >
+Dominoes::ProfilePack::Members( const SetRecord & Set ) const
+{
+  return std::vector< std::uint32_t >( MemberTable + Set.FirstMember,
+                                       MemberTable + Set.FirstMember
+                                                   + Set.Members );
+}
+
+// A profile is returned as a view of its record
+
+Dominoes::ProfilePack::Profile
+Dominoes::ProfilePack::operator[] ( ProfileID Index ) const
+{
+  if ( Index >= TheHeader->Profiles )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The profile index " << Index << " is not less than the "
+                 << TheHeader->Profiles << " profiles of the pack";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  const ProfileRecord & Record( ProfileTable[ Index ] );
+
+  return Profile{ Name( Record.Name, Record.NameLength ),
+                  static_cast< Kind >( Record.Type ),
+                  static_cast< CoSSMic::Time >( Record.Start ),
+                  static_cast< CoSSMic::Time >( Record.Resolution ),
+                  ValueTable + Record.FirstValue,
+                  static_cast< std::size_t >( Record.Values ) };
+}
+
+Dominoes::ProfilePack::Profile
+Dominoes::ProfilePack::operator[] ( std::string_view ProfileName ) const
+{
+  auto Entry = ProfileNames.find( ProfileName );
+
+  if ( Entry == ProfileNames.end() )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "There is no profile named \"" << ProfileName
+                 << "\" in the pack";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  return operator[]( Entry->second );
+}
+
+// The clusters and the programs are found by name in the same way
+
+std::vector< Dominoes::ProfilePack::ProfileID >
+Dominoes::ProfilePack::Cluster( std::string_view ClusterName ) const
+{
+  auto Entry = ClusterNames.find( ClusterName );
+
+  if ( Entry == ClusterNames.end() )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "There is no cluster named \"" << ClusterName
+                 << "\" in the pack";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  return Members( ClusterTable[ Entry->second ] );
+}
+
+std::vector< std::string_view >
+Dominoes::ProfilePack::Program( std::string_view ProgramName ) const
+{
+  auto Entry = ProgramNames.find( ProgramName );
+
+  if ( Entry == ProgramNames.end() )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "There is no program named \"" << ProgramName
+                 << "\" in the pack";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  std::vector< std::string_view > Clusters;
+
+  for ( std::uint32_t Index : Members( ProgramTable[ Entry->second ] ) )
+    Clusters.push_back( Name( ClusterTable[ Index ].Name,
+                              ClusterTable[ Index ].NameLength ) );
+
+  return Clusters;
+}
+
+/*==============================================================================
+
+ Process wide pack
+
+==============================================================================*/
+//
+// Loading a pack replaces the process pack, but solvers already holding the
+// previous pack keep it until they are done.
+
+void Dominoes::ProfilePack::Load( const std::filesystem::path & FileName )
+{
+  auto NewPack = std::make_shared< const ProfilePack >( FileName );
+
+  std::lock_guard< std::mutex > Lock( ProcessPackLock );
+  ProcessPack = NewPack;
+}
+
+std::shared_ptr< const Dominoes::ProfilePack >
+Dominoes::ProfilePack::Loaded( void )
+{
+  std::lock_guard< std::mutex > Lock( ProcessPackLock );
+  return ProcessPack;
+}
+
+// A reference is resolved as an index if it is a number and otherwise by
+// the profile name.
+
+std::map< CoSSMic::Time, double >
+Dominoes::ProfilePack::Resolve( const std::string & Reference )
+{
+  std::shared_ptr< const ProfilePack > ThePack( Loaded() );
+
+  if ( !ThePack )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The profile " << Reference << " refers to the profile "
+                 << "pack, but no pack has been loaded";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  std::string_view ProfileName( Reference );
+  ProfileName.remove_prefix( std::min( ReferencePrefix.size(),
+                                       ProfileName.size() ) );
+
+  ProfileID Index;
+  auto [ Stop, Error ] = std::from_chars( ProfileName.data(),
+                           ProfileName.data() + ProfileName.size(), Index );
+
+  if ( !ProfileName.empty() && ( Error == std::errc() ) &&
+       ( Stop == ProfileName.data() + ProfileName.size() ) )
+    return (*ThePack)[ Index ].LoadProfile();
+  else
+    return (*ThePack)[ ProfileName ].LoadProfile();
+}
+
+/*==============================================================================
+
+ Mapping
+
+==============================================================================*/
+//
+// The validation checks that every table lies inside the file and is aligned,
+// and that every name, value range and set member refers to an existing
+// element, so that the look-ups need no further checks.
+
+void Dominoes::ProfilePack::Validate( const std::filesystem::path & FileName )
+{
+  auto Malformed = [&]( const std::string & Reason ){
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The profile pack " << FileName << " is malformed: "
+                 << Reason;
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  };
+
+  auto TableFits = [&]( std::uint64_t Offset, std::uint64_t Elements,
+                        std::uint64_t ElementSize, std::uint64_t Alignment ){
+    return ( Offset % Alignment == 0 ) && ( Offset <= Size ) &&
+           ( Elements <= ( Size - Offset ) / ElementSize );
+  };
+
+  if ( ( Size < sizeof( Header ) ) ||
+       ( std::memcmp( Data, "DOMPACK", 8 ) != 0 ) )
+    Malformed( "it is not a profile pack" );
+
+  TheHeader = reinterpret_cast< const Header * >( Data );
+
+  if ( TheHeader->ByteOrder != 0x01020304 )
+    Malformed( "it has a different byte order than this computer" );
+
+  if ( TheHeader->Version != 1 )
+    Malformed( "version " + std::to_string( TheHeader->Version )
+               + " is not supported" );
+
+  if ( !TableFits( TheHeader->ProfileTable, TheHeader->Profiles,
+                   sizeof( ProfileRecord ), alignof( ProfileRecord ) ) ||
+       !TableFits( TheHeader->ClusterTable, TheHeader->Clusters,
+                   sizeof( SetRecord ), alignof( SetRecord ) ) ||
+       !TableFits( TheHeader->ProgramTable, TheHeader->Programs,
+                   sizeof( SetRecord ), alignof( SetRecord ) ) ||
+       !TableFits( TheHeader->MemberTable, TheHeader->Members,
+                   sizeof( std::uint32_t ), alignof( std::uint32_t ) ) ||
+       !TableFits( TheHeader->StringTable, 0, 1, 1 ) ||
+       !TableFits( TheHeader->ValueTable, 0, sizeof( double ),
+                   alignof( double ) ) )
+    Malformed( "a table is outside the file" );
+
+  ProfileTable = reinterpret_cast< const ProfileRecord * >(
+                 Data + TheHeader->ProfileTable );
+  ClusterTable = reinterpret_cast< const SetRecord * >(
+                 Data + TheHeader->ClusterTable );
+  ProgramTable = reinterpret_cast< const SetRecord * >(
+                 Data + TheHeader->ProgramTable );
+  MemberTable  = reinterpret_cast< const std::uint32_t * >(
+                 Data + TheHeader->MemberTable );
+  StringTable  = Data + TheHeader->StringTable;
+  ValueTable   = reinterpret_cast< const double * >(
+                 Data + TheHeader->ValueTable );
+
+  const std::uint64_t Strings = Size - TheHeader->StringTable,
+                      Values  = ( Size - TheHeader->ValueTable )
+                                / sizeof( double );
+
+  auto NameFits = [&]( std::uint64_t Offset, std::uint32_t Length ){
+    return ( Offset <= Strings ) && ( Length <= Strings - Offset );
+  };
+
+  for ( ProfileID Index = 0; Index < TheHeader->Profiles; Index++ )
+  {
+    const ProfileRecord & Record( ProfileTable[ Index ] );
+
+    if ( !NameFits( Record.Name, Record.NameLength ) ||
+         ( Record.FirstValue > Values ) ||
+         ( Record.Values > Values - Record.FirstValue ) ||
+         ( Record.Type > static_cast< std::uint32_t >( Kind::PhotoVoltaic ) ) ||
+         ( Record.Resolution <= 0 ) )
+      Malformed( "the record of profile " + std::to_string( Index )
+                 + " is invalid" );
+
+    ProfileNames.emplace( Name( Record.Name, Record.NameLength ), Index );
+  }
+
+  auto ValidateSets = [&]( const SetRecord * Table, std::uint32_t Sets,
+                           std::uint32_t MemberLimit,
+                           std::unordered_map< std::string_view,
+                                               std::uint32_t > & Names ){
+    for ( std::uint32_t Index = 0; Index < Sets; Index++ )
+    {
+      const SetRecord & Set( Table[ Index ] );
+
+      if ( !NameFits( Set.Name, Set.NameLength ) ||
+           ( Set.FirstMember > TheHeader->Members ) ||
+           ( Set.Members > TheHeader->Members - Set.FirstMember ) )
+        Malformed( "the record of set " + std::to_string( Index )
+                   + " is invalid" );
+
+      for ( std::uint32_t Member : Members( Set ) )
+        if ( Member >= MemberLimit )
+          Malformed( "a member of set " + std::to_string( Index )
+                     + " does not exist" );
+
+      Names.emplace( Name( Set.Name, Set.NameLength ), Index );
+    }
+  };
+
+  ValidateSets( ClusterTable, TheHeader->Clusters, TheHeader->Profiles,
+                ClusterNames );
+  ValidateSets( ProgramTable, TheHeader->Programs, TheHeader->Clusters,
+                ProgramNames );
+}
+
+// The file is mapped read only and the mapping remains valid after the file
+// has been closed.
+
+Dominoes::ProfilePack::ProfilePack( const std::filesystem::path & FileName )
+: Data( nullptr ), Size(0), TheHeader( nullptr ), ProfileTable( nullptr ),
+  ClusterTable( nullptr ), ProgramTable( nullptr ), MemberTable( nullptr ),
+  StringTable( nullptr ), ValueTable( nullptr ),
+  ProfileNames(), ClusterNames(), ProgramNames()
+{
+  int FileDescriptor = ::open( FileName.c_str(), O_RDONLY );
+  struct stat Status;
+
+  if ( ( FileDescriptor == -1 ) || ( ::fstat( FileDescriptor, &Status ) != 0 ) )
+  {
+    int Error = errno;
+
+    if ( FileDescriptor != -1 ) ::close( FileDescriptor );
+
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The profile pack " << FileName << " could not be opened: "
+                 << std::strerror( Error );
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  Size = static_cast< std::size_t >( Status.st_size );
+
+  void * Mapping = Size > 0 ? ::mmap( nullptr, Size, PROT_READ, MAP_PRIVATE,
+                                      FileDescriptor, 0 )
+                            : MAP_FAILED;
+
+  ::close( FileDescriptor );
+
+  if ( Mapping == MAP_FAILED )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The profile pack " << FileName << " could not be mapped";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  Data = static_cast< const char * >( Mapping );
+
+  try
+  {
+    Validate( FileName );
+  }
+  catch (...)
+  {
+    ::munmap( const_cast< char * >( Data ), Size );
+    throw;
+  }
+}
+
+Dominoes::ProfilePack::~ProfilePack( void )
+{
+  ::munmap( const_cast< char * >( Data ), Size );
+}
@@ -0,0 +1,225 @@
+/*==============================================================================
+Profile Pack
+
+The web service selects an appliance profile for each consumer from the JSON
+cluster files, writes it to a temporary CSV file, and the solver then parses
+the CSV file back. The profile pack avoids this round trip: all the cluster
+profiles, the program mappings and the PV category curves are compiled once
+by the packData.js tool into a single binary file, which the simulator maps
+into memory at start up. A consumer can then refer to a profile of the pack
+instead of to a file by giving the consumption file of its consumer event as
+
+pack:<profile name>   or   pack:<profile index>
+
+The profiles are named by their cluster and their index in the cluster, for
+instance "wm/WM cluster 1 (158-185 min, 0.5-0.82 kWh)/3" for the fourth
+profile of the first washing machine cluster, and "pv/summer_sunny/0" for the
+first curve of the sunny summer PV category. The clusters are named without
+the index, and the programs are named by the appliance code and the program
+name of the mapping files, for instance "wm/40" or "dw/normal".
+
+The pack is little endian with all offsets in bytes from the start of the
+file, and all tables are aligned to the largest field of their elements:
+
+Header (80 bytes)
+  char[8]  "DOMPACK\0"
+  uint32   Byte order mark 0x01020304
+  uint32   Version, currently 1
+  uint32   Number of profiles, clusters, programs and set members
+  uint64   Offsets of the profile, cluster, program, member, string and
+           value tables
+Profile record (48 bytes)
+  uint64   Name offset in the string table
+  uint32   Name length
+  uint32   Kind: 0 = washing machine, 1 = dish washer, 2 = PV
+  int64    Start time, Unix seconds for the PV curves and zero otherwise
+  int64    Resolution in seconds between the values
+  uint64   First value in the value table
+  uint64   Number of values
+Set record for the clusters and programs (24 bytes)
+  uint64   Name offset in the string table
+  uint32   Name length
+  uint32   Kind
+  uint32   First member in the member table
+  uint32   Number of members
+Member table
+  uint32   Profile indices for the clusters and cluster indices for the
+           programs
+String table
+  UTF-8 names without terminators
+Value table
+  double   Cumulative energy in kWh for the appliances and power in kW for
+           the PV curves
+
+The pack is validated when it is mapped, and an invalid argument exception is
+thrown if it is malformed or has the wrong byte order. The pack is immutable,
+and the process wide pack can be used concurrently by the consumer actors.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_PROFILE_PACK
+#define DOMINOES_PROFILE_PACK
+
+#include <string>                            // Standard strings
+#include <string_view>                       // Names in the pack
+#include <vector>                            // Cluster members
+#include <map>                               // Load profiles
+#include <memory>                            // The process wide pack
+#include <mutex>                             // Protecting the process pack
+#include <unordered_map>                     // Name look-up
+#include <filesystem>                        // File names
+#include <cstdint>                           // Fixed size integers
+#include <cstddef>                           // Standard sizes
+
+#include "TimeInterval.hpp"                  // The CoSSMic time
+
+namespace Dominoes {
+
+class ProfilePack
+{
+public:
+
+  using ProfileID = std::uint32_t;
+
+  enum class Kind : std::uint32_t
+  {
+    WashingMachine = 0,
+    DishWasher     = 1,
+    PhotoVoltaic   = 2
+  };
+
+  // A profile is a view of its record and values in the mapped pack, and it
+  // stays valid as long as the pack is kept. The load profile of an
+  // appliance is its cumulative energy at times relative to its start, as
+  // the web service writes it to the consumer files.
+
+  class Profile
+  {
+  public:
+
+    std::string_view Name;
+    Kind             Type;
+    CoSSMic::Time    Start, Resolution;
+    const double *   Values;
+    std::size_t      Count;
+
+    std::map< CoSSMic::Time, double > LoadProfile( void ) const;
+  };
+
+private:
+
+  // The records are read in place from the mapped file, and their sizes are
+  // checked against the layout written by the pack tool.
+
+  struct Header
+  {
+    char          Magic[8];
+    std::uint32_t ByteOrder, Version;
+    std::uint32_t Profiles, Clusters, Programs, Members;
+    std::uint64_t ProfileTable, ClusterTable, ProgramTable, MemberTable,
+                  StringTable, ValueTable;
+  };
+
+  struct ProfileRecord
+  {
+    std::uint64_t Name;
+    std::uint32_t NameLength, Type;
+    std::int64_t  Start, Resolution;
+    std::uint64_t FirstValue, Values;
+  };
+
+  struct SetRecord
+  {
+    std::uint64_t Name;
+    std::uint32_t NameLength, Type, FirstMember, Members;
+  };
+
+  static_assert( sizeof( Header )        == 80, "Profile pack header size" );
+  static_assert( sizeof( ProfileRecord ) == 48, "Profile record size" );
+  static_assert( sizeof( SetRecord )     == 24, "Profile set record size" );
+
+  // The mapping of the file
+
+  const char *  Data;
+  std::size_t   Size;
+
+  // Pointers to the tables in the mapping
+
+  const Header *        TheHeader;
+  const ProfileRecord * ProfileTable;
+  const SetRecord *     ClusterTable, * ProgramTable;
+  const std::uint32_t * MemberTable;
+  const char *          StringTable;
+  const double *        ValueTable;
+
+  // The names are indexed when the pack is mapped so that a profile can be
+  // found by name in constant time.
+
+  std::unordered_map< std::string_view, ProfileID > ProfileNames;
+  std::unordered_map< std::string_view, std::uint32_t > ClusterNames,
+                                                        ProgramNames;
+
+  // Utility functions to check the pack and to look up names
+
+  void Validate( const std::filesystem::path & FileName );
+
+  inline std::string_view Name( std::uint64_t Offset,
+                                std::uint32_t Length ) const
+  { return std::string_view( StringTable + Offset, Length ); }
+
+  std::vector< std::uint32_t > Members( const SetRecord & Set ) const;
+
+  // The process wide pack is set when the simulator starts and is shared by
+  // the solvers of all scenarios.
+
+  static std::shared_ptr< const ProfilePack > ProcessPack;
+  static std::mutex                           ProcessPackLock;
+
+public:
+
+  // The number of profiles, and access to a profile by its index or by its
+  // name, which throw an invalid argument exception if the profile does not
+  // exist.
+
+  inline std::size_t size( void ) const
+  { return TheHeader->Profiles; }
+
+  Profile operator[] ( ProfileID Index ) const;
+  Profile operator[] ( std::string_view ProfileName ) const;
+
+  // The profiles of a cluster or a PV category, and the clusters of a
+  // program. These also throw if the name is unknown.
+
+  std::vector< ProfileID >        Cluster( std::string_view ClusterName ) const;
+  std::vector< std::string_view > Program( std::string_view ProgramName ) const;
+
+  // References to profiles of the pack are consumption file names with the
+  // pack prefix, and the load profile of the referenced profile is taken
+  // from the process wide pack, which must have been loaded before. The
+  // load profile is returned as a copy since the process pack may be
+  // replaced by another thread once the lock has been released.
+
+  static constexpr std::string_view ReferencePrefix = "pack:";
+
+  static bool IsReference( const std::string & FileName )
+  { return FileName.compare( 0, ReferencePrefix.size(), ReferencePrefix ) == 0; }
+
+  static void Load( const std::filesystem::path & FileName );
+  static std::shared_ptr< const ProfilePack > Loaded( void );
+  static std::map< CoSSMic::Time, double >
+  Resolve( const std::string & Reference );
+
+  // The constructor maps the file and validates it, and the destructor
+  // removes the mapping.
+
+  ProfilePack( const std::filesystem::path & FileName );
+  ProfilePack( const ProfilePack & Other ) = delete;
+  ProfilePack & operator= ( const ProfilePack & Other ) = delete;
+
+  ~ProfilePack( void );
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_PROFILE_PACK
@@ -0,0 +1,367 @@
+/*==============================================================================
+Result Cache
+
+This implements the canonical hashing of the scenarios and the storage of the
+results in memory and in the cache directory.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <map>                               // Parsed time series
+#include <sstream>                           // For nicely formatted errors
+#include <stdexcept>                         // Standard exceptions
+#include <fstream>                           // Cache files
+#include <iomanip>                           // Hexadecimal keys
+#include <iterator>                          // Reading cache files
+#include <atomic>                            // Temporary file names
+#include <cstdint>                           // The hash value
+
+#include <boost/numeric/interval.hpp>        // Testing the solar day
+#include <unistd.h>                          // Process ID
+
+#include "csv.h"                             // The CSV parser
+#include "CSVtoTimeSeries.hpp"               // To read CSV files
+#include "ResultCache.hpp"                   // The class definition
+#include "ProfilePack.hpp"                   // Profiles referenced in the pack
+
+/*==============================================================================
+
+ Scenario keys
+
+==============================================================================*/
+//
+// The canonical content is built from the binary representation of the
+// parsed values, and the hash is the 64 bit Fowler-Noll-Vo (FNV-1a) hash of
+// this content.
+
+namespace Dominoes
+{
+
+template< typename ValueType >
+static void AppendValue( std::string & Content, const ValueType & Value )
+{
+  Content.append( reinterpret_cast< const char * >( &Value ),
+                  sizeof( ValueType ) );
+}
+
+static void AppendSeries( std::string & Content,
+                          const std::map< CoSSMic::Time, double > & Series )
+{
+  AppendValue( Content, Series.size() );
+
+  for ( const auto & Point : Series )
+  {
+    AppendValue( Content, Point.first );
+    AppendValue( Content, Point.second );
+  }
+}
+
+static std::string Hash( const std::string & Content )
+{
+  std::uint64_t Value = 14695981039346656037ULL;
+
+  for ( unsigned char Character : Content )
+  {
+    Value ^= Character;
+    Value *= 1099511628211ULL;
+  }
+
+  std::ostringstream HashString;
+
+  HashString << std::hex << std::setw(16) << std::setfill('0') << Value;
+
+  return HashString.str();
+}
+
+}      // End name space Dominoes
+
+// The consumer events file is parsed in the same way as by the solver, and
+// the content of the nearby key is the same as the exact content without the
+// start windows.
+
+Dominoes::ResultCache::Key
+Dominoes::ResultCache::ScenarioKey(
+  const std::filesystem::path & ProductionFile,
+  const std::filesystem::path & ConsumersFile, CoSSMic::Time KernelStep,
+  Interpolation::Type GridInterpolation, const CoSSMic::TimeInterval & SolarDay )
+{
+  for ( const std::filesystem::path & FileToCheck :
+        { ProductionFile, ConsumersFile } )
+    if ( !std::filesystem::exists( FileToCheck ) )
+    {
+      std::ostringstream ErrorMessage;
+
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "The file " << FileToCheck << " does not exist";
+
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+
+  std::string Content;
+
+  AppendValue( Content, KernelStep );
+  AppendValue( Content, static_cast< int >( GridInterpolation ) );
+
+  if ( boost::numeric::empty( SolarDay ) )
+    AppendValue( Content, false );
+  else
+  {
+    AppendValue( Content, true );
+    AppendValue( Content, SolarDay.lower() );
+    AppendValue( Content, SolarDay.upper() );
+  }
+
+  AppendSeries( Content, CoSSMic::CSVtoTimeSeries( ProductionFile ) );
+
+  std::string Exact( Content ), Nearby( Content );
+
+  io::CSVReader<4, io::trim_chars<'\t'>, io::no_quote_escape<';'> >
+  CSVParser( ConsumersFile.string() );
+
+  CSVParser.set_header("ID","EST","LST","ConsumptionFile");
+
+  CoSSMic::Time EarliestStartTime, LatestStartTime;
+  std::string   DeviceID, ConsumptionProfile;
+
+  while ( CSVParser.read_row( DeviceID, EarliestStartTime, LatestStartTime,
+                              ConsumptionProfile ) )
+  {
+    std::string Consumer;
+
+    AppendValue( Consumer, DeviceID.size() );
+    Consumer.append( DeviceID );
+    if ( ProfilePack::IsReference( ConsumptionProfile ) )
+      AppendSeries( Consumer, ProfilePack::Resolve( ConsumptionProfile ) );
+    else
+      AppendSeries( Consumer, CoSSMic::CSVtoTimeSeries( ConsumptionProfile ) );
+
+    Nearby.append( Consumer );
+
+    AppendValue( Consumer, EarliestStartTime );
+    AppendValue( Consumer, LatestStartTime );
+
+    Exact.append( Consumer );
+  }
+
+  return Key{ Hash( Exact ), Hash( Nearby ) };
+}
+
+// The start times are read from the result lines
+
+std::vector< CoSSMic::Time >
+Dominoes::ResultCache::StartTimes( const std::string & Result )
+{
+  std::istringstream           Lines( Result );
+  std::string                  Line;
+  std::vector< CoSSMic::Time > TheStartTimes;
+
+  std::getline( Lines, Line );
+
+  while ( std::getline( Lines, Line ) )
+  {
+    auto Last = Line.find_last_not_of( " \t\r" );
+
+    if ( Last == std::string::npos ) continue;
+
+    auto First = Line.find_last_of( " \t", Last );
+
+    TheStartTimes.push_back( std::stoll( Line.substr(
+      First == std::string::npos ? 0 : First + 1,
+      First == std::string::npos ? Last + 1 : Last - First ) ) );
+  }
+
+  return TheStartTimes;
+}
+
+/*==============================================================================
+
+ Storage
+
+==============================================================================*/
+//
+// A result is remembered as the most recent result, and the least recently
+// used results are removed if there are more than allowed. If no results are
+// kept in memory, only the files are used.
+
+void Dominoes::ResultCache::Remember( const Key & ScenarioKey,
+                                      const std::string & Result )
+{
+  if ( MaximalEntries == 0 ) return;
+
+  auto Existing = Results.find( ScenarioKey.Exact );
+
+  if ( Existing != Results.end() )
+  {
+    Existing->second->Result = Result;
+    Recency.splice( Recency.begin(), Recency, Existing->second );
+  }
+  else
+  {
+    Recency.push_front( Entry{ ScenarioKey.Exact, ScenarioKey.Nearby, Result } );
+    Results.emplace( ScenarioKey.Exact, Recency.begin() );
+  }
+
+  NearbyResults[ ScenarioKey.Nearby ] = ScenarioKey.Exact;
+
+  while ( Recency.size() > MaximalEntries )
+  {
+    const Entry & Oldest( Recency.back() );
+    auto          Nearby = NearbyResults.find( Oldest.Nearby );
+
+    if ( ( Nearby != NearbyResults.end() ) && ( Nearby->second == Oldest.Exact ) )
+      NearbyResults.erase( Nearby );
+
+    Results.erase( Oldest.Exact );
+    Recency.pop_back();
+  }
+}
+
+// The files are read as they are, and written through a temporary file
+// whose name is unique for the process and the call.
+
+std::optional< std::string >
+Dominoes::ResultCache::ReadFile( const std::string & Name ) const
+{
+  if ( Directory.empty() ) return std::nullopt;
+
+  std::ifstream CacheFile( Directory / Name, std::ios::binary );
+
+  if ( !CacheFile ) return std::nullopt;
+
+  return std::string( std::istreambuf_iterator< char >( CacheFile ),
+                      std::istreambuf_iterator< char >() );
+}
+
+void Dominoes::ResultCache::WriteFile( const std::string & Name,
+                                       const std::string & Result ) const
+{
+  static std::atomic< unsigned long > FileCounter(0);
+
+  const std::filesystem::path
+  Temporary( Directory / ( Name + ".tmp" + std::to_string( ::getpid() ) + "."
+                           + std::to_string( FileCounter++ ) ) );
+
+  {
+    std::ofstream CacheFile( Temporary, std::ios::binary );
+    CacheFile << Result;
+  }
+
+  std::error_code Ignored;
+
+  std::filesystem::rename( Temporary, Directory / Name, Ignored );
+
+  if ( Ignored )
+    std::filesystem::remove( Temporary, Ignored );
+}
+
+// Finding a result first looks in memory, and if it is found in the cache
+// directory it is remembered in memory for the next time.
+
+std::optional< std::string >
+Dominoes::ResultCache::Find( const Key & ScenarioKey )
+{
+  {
+    std::lock_guard< std::mutex > Guard( Lock );
+
+    auto Existing = Results.find( ScenarioKey.Exact );
+
+    if ( Existing != Results.end() )
+    {
+      Recency.splice( Recency.begin(), Recency, Existing->second );
+      return Existing->second->Result;
+    }
+  }
+
+  auto Stored = ReadFile( ScenarioKey.Exact + ".ast" );
+
+  if ( Stored )
+  {
+    std::lock_guard< std::mutex > Guard( Lock );
+    Remember( ScenarioKey, *Stored );
+  }
+
+  return Stored;
+}
+
+// The nearby start times are taken from the last result for the nearby key
+
+std::optional< std::vector< CoSSMic::Time > >
+Dominoes::ResultCache::NearbyStartTimes( const Key & ScenarioKey )
+{
+  std::optional< std::string > Nearby;
+
+  {
+    std::lock_guard< std::mutex > Guard( Lock );
+
+    auto Exact = NearbyResults.find( ScenarioKey.Nearby );
+
+    if ( Exact != NearbyResults.end() )
+      Nearby = Results.at( Exact->second )->Result;
+  }
+
+  if ( !Nearby )
+    Nearby = ReadFile( ScenarioKey.Nearby + ".near" );
+
+  if ( Nearby )
+    return StartTimes( *Nearby );
+  else
+    return std::nullopt;
+}
+
+// Storing a result ignores partial results
+
+void Dominoes::ResultCache::Store( const Key & ScenarioKey,
+                                   const std::string & Result )
+{
+  if ( Result.substr( 0, Result.find('\n') ).find("(partial)")
+       != std::string::npos )
+    return;
+
+  {
+    std::lock_guard< std::mutex > Guard( Lock );
+    Remember( ScenarioKey, Result );
+  }
+
+  if ( !Directory.empty() )
+  {
+    WriteFile( ScenarioKey.Exact  + ".ast",  Result );
+    WriteFile( ScenarioKey.Nearby + ".near", Result );
+  }
+}
+
+// The front end solution is trivial when the cache is disabled
+
+std::pair< std::string, bool >
+Dominoes::ResultCache::Solve( const Key & ScenarioKey,
+                              const SolverFunction & Solver )
+{
+  if ( !IsEnabled() )
+    return { Solver( std::nullopt ), false };
+
+  auto Cached = Find( ScenarioKey );
+
+  if ( Cached )
+    return { *Cached, true };
+
+  std::string Result( Solver( NearbyStartTimes( ScenarioKey ) ) );
+
+  Store( ScenarioKey, Result );
+
+  return { Result, false };
+}
+
+/*==============================================================================
+
+ Constructor
+
+==============================================================================*/
+
+Dominoes::ResultCache::ResultCache( std::size_t Entries,
+                                    const std::filesystem::path & CacheDirectory )
+: MaximalEntries( Entries ), Directory( CacheDirectory ),
+  Recency(), Results(), NearbyResults(), Lock()
+{
+  if ( !Directory.empty() )
+    std::filesystem::create_directories( Directory );
+}
@@ -0,0 +1,168 @@
+/*==============================================================================
+Result Cache
+
+Many users of the simulator submit identical scenarios: The same weather
+category gives the same production series, the appliances are mapped to a
+small number of profile clusters, and the start windows are often the
+defaults. Every request would still be solved from scratch even though the
+start times have already been found for an identical scenario. The result
+cache stores the assigned start times by the content of the scenario so that
+an identical scenario is answered without running the solver.
+
+The key of a scenario is a hash of its canonical content: The production
+series and the consumer events with their consumption profiles as parsed
+values in the order of the consumer events file, together with the kernel
+step, the grid energy interpolation and the solar day since these define the
+problem solved. The file names are not part of the key since the front end
+writes the same content to new files for every request. The other options of
+the solver, like the number of starts or the decomposition, only change how
+the problem is solved, and a cached result is returned regardless of these.
+
+A scenario that differs only in the start windows of the consumers is said to
+be nearby, and it has the same nearby key which is the hash of the same
+content except the earliest and latest start times. The start times of the
+last result stored for a nearby scenario can be used as the initial start
+times of the search, since the consumers are likely to be placed in the same
+periods of high production.
+
+The results are kept in memory for a given number of scenarios and the least
+recently used result is removed when the cache is full. If a cache directory
+is given, the results are also stored as files named by the key, so that they
+are shared by all simulator processes using the same directory and they
+survive the process. The file <exact key>.ast holds the result exactly as
+written to the assigned start time file, and the file <nearby key>.near holds
+the last result stored for the nearby key. Results of searches stopped by the
+deadline are partial, and they are not stored.
+
+The cache is safe to use from the workers of a batch, and the files are
+written to a temporary file that is renamed so that a concurrent process
+never reads a partially written file.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_RESULT_CACHE
+#define DOMINOES_RESULT_CACHE
+
+#include <string>                            // Standard strings
+#include <vector>                            // Start times
+#include <list>                              // Recency order
+#include <unordered_map>                     // The cache storage
+#include <optional>                          // Results that may be missing
+#include <functional>                        // Solving on a miss
+#include <filesystem>                        // Cache files
+#include <mutex>                             // Shared by workers
+#include <cstddef>                           // Entry counts
+
+#include "TimeInterval.hpp"                  // CoSSMic Time
+#include "Interpolation.hpp"                 // Grid energy interpolation
+
+namespace Dominoes {
+
+class ResultCache
+{
+public:
+
+  // The key of a scenario has the hash of the full content and the hash of
+  // the content without the start windows, both as hexadecimal strings.
+
+  class Key
+  {
+  public:
+
+    std::string Exact, Nearby;
+  };
+
+  // The key is computed from the scenario files and the parameters of the
+  // problem. It will throw an invalid argument exception if a file does not
+  // exist.
+
+  static Key ScenarioKey( const std::filesystem::path & ProductionFile,
+                          const std::filesystem::path & ConsumersFile,
+                          CoSSMic::Time KernelStep,
+                          Interpolation::Type GridInterpolation,
+                          const CoSSMic::TimeInterval & SolarDay );
+
+  // The start times of a result are the last token of each line after the
+  // total grid energy line.
+
+  static std::vector< CoSSMic::Time > StartTimes( const std::string & Result );
+
+private:
+
+  // The results in memory are kept in the order of use with the most
+  // recently used first, and the map gives the position of a result by its
+  // exact key. The nearby map gives the exact key of the last result stored
+  // for a nearby key.
+
+  class Entry
+  {
+  public:
+
+    std::string Exact, Nearby, Result;
+  };
+
+  const std::size_t                  MaximalEntries;
+  const std::filesystem::path        Directory;
+  std::list< Entry >                 Recency;
+  std::unordered_map< std::string, std::list< Entry >::iterator > Results;
+  std::unordered_map< std::string, std::string >                  NearbyResults;
+
+  mutable std::mutex Lock;
+
+  // Results are added to the memory and removed if the cache is full by a
+  // helper function that must be called with the lock held.
+
+  void Remember( const Key & ScenarioKey, const std::string & Result );
+
+  // The cache files are read and written by helper functions
+
+  std::optional< std::string > ReadFile( const std::string & Name ) const;
+  void WriteFile( const std::string & Name, const std::string & Result ) const;
+
+public:
+
+  // The cache is used if it may hold results in memory or in files
+
+  inline bool IsEnabled( void ) const
+  { return ( MaximalEntries > 0 ) || !Directory.empty(); }
+
+  // The result for a scenario is looked up in memory first, and then in the
+  // cache directory.
+
+  std::optional< std::string > Find( const Key & ScenarioKey );
+
+  // The start times of the result for a nearby scenario
+
+  std::optional< std::vector< CoSSMic::Time > >
+  NearbyStartTimes( const Key & ScenarioKey );
+
+  // A result is stored unless it is partial
+
+  void Store( const Key & ScenarioKey, const std::string & Result );
+
+  // The front ends return the cached result if it exists, or call the given
+  // solver function with the start times of a nearby scenario, if any, to
+  // produce the result. The result is stored before it is returned, and the
+  // second element is true if the result was found in the cache.
+
+  using SolverFunction = std::function< std::string(
+                         const std::optional< std::vector< CoSSMic::Time > > & ) >;
+
+  std::pair< std::string, bool > Solve( const Key & ScenarioKey,
+                                        const SolverFunction & Solver );
+
+  // The constructor takes the maximal number of results kept in memory and
+  // the cache directory which is not used if it is empty. The directory is
+  // created if it does not exist.
+
+  ResultCache( std::size_t Entries,
+               const std::filesystem::path & CacheDirectory );
+
+  ResultCache( void ) = delete;
+  ResultCache( const ResultCache & Other ) = delete;
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_RESULT_CACHE
@@ -0,0 +1,92 @@
+/*==============================================================================
+Search
+
+This implements the objective function and the solve function of the
+independent searches of a multi-start optimisation.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include "Search.hpp"                        // The class definition
+
+// The objective function is identical to the in-process evaluation of the
+// solver, but it uses the state owned by the search.
+
+Optimization::VariableType Dominoes::Search::ObjectiveFunction(
+  Optimization::VariableSpan VariableValues )
+{
+  double Value;
+
+  if ( Metrics != nullptr )
+  {
+    Instrumentation::Clock::time_point Start = Instrumentation::Clock::now();
+
+    Value = Cost( Consumption.Update( VariableValues ) );
+    Metrics->RecordEvaluation( Instrumentation::Clock::now() - Start );
+  }
+  else
+    Value = Cost( Consumption.Update( VariableValues ) );
+
+  EvaluationCount++;
+
+  Progress.Record( VariableValues, Value );
+
+  if ( Progress.Expired() )
+    ForceStop();
+
+  return Value;
+}
+
+// The solver is created explicitly for the first start so that the search
+// can be stopped from the objective function. If the search was forced to
+// stop, the values returned by the algorithm may not be the best values
+// evaluated, and the recorded best values are returned instead.
+
+Dominoes::Search::OptimalSolution
+Dominoes::Search::Solve( const Optimization::Variables & InitialValues )
+{
+  if ( GetDimension() != InitialValues.size() )
+    CreateSolver( InitialValues.size(), Optimization::Objective::Goal::Minimize );
+
+  Progress.Reset();
+
+  auto Solution = FindSolution( InitialValues );
+
+  if ( ( Solution.Status == NLOPT_FORCED_STOP ) &&
+       !Progress.BestVariables().empty() )
+    return OptimalSolution( Progress.BestVariables(), Progress.BestValue(),
+                            NLOPT_FORCED_STOP );
+  else
+    return Solution;
+}
+
+// Solving with a deadline sets the deadline for this start only
+
+Dominoes::Search::OptimalSolution
+Dominoes::Search::Solve( const Optimization::Variables & InitialValues,
+                         Anytime::Clock::time_point Deadline )
+{
+  Progress.SetDeadline( Deadline );
+
+  auto Solution = Solve( InitialValues );
+
+  Progress.ClearDeadline();
+
+  return Solution;
+}
+
+// The constructor initialises the buffers
+
+Dominoes::Search::Search( const ConsumptionBlock & ConsumerProfiles,
+                          const std::vector< Interval > & StartIntervals,
+                          const SampleTime & ProductionTimes,
+                          const std::vector< double > & IntervalProduction,
+                          Interpolation::Type GridInterpolation,
+                          Instrumentation * SolverMetrics )
+: NL::Optimizer< NL::Algorithm::Local::Approximation::Rescaling >(),
+  Bounds( StartIntervals ),
+  Consumption( ConsumerProfiles, ProductionTimes->size() ),
+  Cost( ProductionTimes, IntervalProduction, GridInterpolation ),
+  Progress(), EvaluationCount(0), Metrics( SolverMetrics )
+{}
@@ -0,0 +1,134 @@
+/*==============================================================================
+Search
+
+The solver is itself the optimiser, and its objective function uses the energy
+objective receiver shared with the consumer actors. It can therefore only run
+one search at the time. A multi-start optimisation runs several independent
+searches from different initial start times concurrently, and each search is
+then an optimiser of its own evaluating the objective function in-process
+from the consumption block shared by all searches. Each search has its own
+incremental consumption state and its own grid cost functor, so that no data
+is written by more than one thread.
+
+A search can be used for several starts one after the other, and each start
+can be given a deadline. The objective function records every evaluation and
+forces the underlying BOBYQA algorithm to stop once the deadline has passed,
+and the best start times evaluated so far are then returned with the forced
+stop status.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef DOMINOES_SEARCH
+#define DOMINOES_SEARCH
+
+#include <vector>                            // Standard vectors
+#include <cstddef>                           // Evaluation counter
+
+// The optimization algorithm
+#include "NonLinear/Algorithms.hpp"          // The algorithms
+#include "NonLinear/Optimizer.hpp"           // The solver
+#include "NonLinear/LocalApproximation.hpp"  // The BOBYAQA interface
+
+// CoSSMic headers
+#include "Interpolation.hpp"                 // Grid energy interpolation
+
+// Dominoes headers
+#include "Typedefs.hpp"                      // Dominoes types
+#include "ConsumptionBlock.hpp"              // In-process evaluation
+#include "GridCost.hpp"                      // Objective value
+#include "IncrementalConsumption.hpp"        // Changed start times only
+#include "Anytime.hpp"                       // Deadline and best so far
+#include "Instrumentation.hpp"               // Evaluation latencies
+
+namespace Dominoes {
+
+namespace NL = Optimization::NonLinear;
+
+class Search
+: public NL::Optimizer< NL::Algorithm::Local::Approximation::Rescaling >
+{
+private:
+
+  // The shared and read-only data of the problem
+
+  const std::vector< Interval > Bounds;
+
+  // The search specific state for the total consumption and the grid cost
+
+  IncrementalConsumption Consumption;
+  GridCost               Cost;
+  Anytime                Progress;
+
+  // The number of evaluations of the objective function by this search
+
+  std::size_t            EvaluationCount;
+
+  // The latency of each evaluation is recorded if the instrumentation is
+  // given.
+
+  Instrumentation *      Metrics;
+
+protected:
+
+  // The objective function computes the total consumption of all consumers
+  // for the given start times, and it returns the grid cost. The evaluation
+  // is recorded, and the search is stopped if the deadline has passed.
+
+  virtual Optimization::VariableType
+	ObjectiveFunction( const Optimization::Variables & VariableValues ) override
+  { return ObjectiveFunction( Optimization::VariableSpan( VariableValues ) ); }
+
+  // The evaluation is done on the span of the values given by the optimiser 
+  // to avoid copying the start times for every evaluation.
+
+  virtual Optimization::VariableType
+	ObjectiveFunction( Optimization::VariableSpan VariableValues ) override;
+
+  // The bounds are the start time intervals of the consumers as given to the
+  // constructor.
+
+  virtual std::vector< Interval > BoundConstraints( void ) override
+  { return Bounds; }
+
+public:
+
+  // The search is started from the given initial start times. If a deadline
+  // is given, the search will stop once it has passed and return the best
+  // start times evaluated with the forced stop status.
+
+  OptimalSolution Solve( const Optimization::Variables & InitialValues );
+  OptimalSolution Solve( const Optimization::Variables & InitialValues,
+                         Anytime::Clock::time_point Deadline );
+
+  // The number of evaluations of the objective function over all starts
+
+  inline std::size_t Evaluations( void ) const
+  { return EvaluationCount; }
+
+  // The constructor takes the consumption block, the start intervals of the
+  // consumers in the same order as the consumers of the block, the production
+  // sample times and the production in each sample interval. All of these
+  // must be owned by the solver and not change while the search is running.
+  // The interpolation of the grid energy used should be the same as for the
+  // solver, and the instrumentation of the solver can be given to record
+  // the evaluation latencies.
+
+  Search( const ConsumptionBlock & ConsumerProfiles,
+          const std::vector< Interval > & StartIntervals,
+          const SampleTime & ProductionTimes,
+          const std::vector< double > & IntervalProduction,
+          Interpolation::Type GridInterpolation
+            = Interpolation::Type::SteffenMethod,
+          Instrumentation * SolverMetrics = nullptr );
+
+  Search( void ) = delete;
+  Search( const Search & Other ) = delete;
+
+  virtual ~Search( void )
+  {}
+};
+
+}      // End name space Dominoes
+#endif // DOMINOES_SEARCH
@@ -14,6 +14,15 @@ License: LGPL 3.0
 #include <fstream>                           // Reading and writing files
 #include <iterator>                          // Iterator next
 #include <cstdlib>                           // Integer division
+#include <thread>                            // Multi-start threads
+#include <atomic>                            // Multi-start counter
+#include <exception>                         // Passing thread exceptions
+#include <limits>                            // Largest objective value
+#include <optional>                          // Multi-start stop time
+#include <mutex>                             // Best subproblem solutions
+#include <numeric>                           // Numbering the consumers
+#include <functional>                        // Comparing sample times
+#include <memory>                            // Racing evaluator state
 
 #include <boost/numeric/conversion/cast.hpp> // Casting numeric types
 #include "csv.h"                             // The CSV parser
@@ -23,6 +32,15 @@ License: LGPL 3.0
 #include "Consumer.hpp"                      // The Consumer class
 #include "Solver.hpp"                        // The solver class
 #include "Interpolation.hpp"                 // Interpolating object
+#include "Search.hpp"                        // Independent searches
+#include "GradientSearch.hpp"                // Searches with the gradient
+#include "Partition.hpp"                     // Independent consumers
+#include "GreedyPlacement.hpp"               // Warm start
+#include "BatchEvaluation.hpp"               // Screening candidates
+#include "ProblemCapture.hpp"                // Replaying the problem
+#include "ProfilePack.hpp"                   // Profiles referenced in the pack
+#include "NonLinear/DIRECT.hpp"              // Racing global search
+#include "NonLinear/ControlledRandomSearch.hpp" // Racing random search
 
 /*==============================================================================
 
@@ -65,27 +83,24 @@ void Dominoes::Solver::EnergyObjective::SetProductionValues(
 	}
 }
 
-// The reset function simply copies the pre-computed negative production values
-// to the net energy vector so that it is ready to accumulate the consumption
-// values as they arrive.
+// The reset function sizes the total consumption vector to the time axis so
+// that the size of the consumption values can be checked as they arrive.
 
 void Dominoes::Solver::EnergyObjective::Reset( void )
 {
   TotalConsumption.assign( ProductionSamples->size(), 0.0 );
 }
 
-// The handler receives the consumption for a single consumer and adds these
-// to the total consumption vector.
+// The handler receives the consumption for a single consumer and stores it
+// in the slot of the consumer. The slot has the right size after the first
+// evaluation, and the assignment then copies the values without allocating.
 
 void Dominoes::Solver::EnergyObjective::SingleConsumption(
   const std::vector< double > & ConsumptionValues,
   const Theron::Address TheConsumer )
 {
   if ( ConsumptionValues.size() == TotalConsumption.size() )
-    std::transform( ConsumptionValues.begin(), ConsumptionValues.end(),
-                    TotalConsumption.begin(), TotalConsumption.begin(),
-                    []( double Consumption, double OldTotal )->double{
-                        return OldTotal + Consumption; });
+    Consumptions[ TheConsumer ] = ConsumptionValues;
   else
   {
     std::ostringstream ErrorMessage;
@@ -101,38 +116,30 @@ void Dominoes::Solver::EnergyObjective::SingleConsumption(
 }
 
 
-// The net energy that must be taken from the grid is now equal to the
-// sum of the differences between the production and the consumption in each
-// interval. This is first computed for the sample times and then interpolated
-// and integrated to find the total energy that is needed by the building.
+// The net energy that must be taken from the grid is computed by the grid
+// cost functor for the total consumption.
 
 double Dominoes::Solver::EnergyObjective::Value( void )
 {
-	std::vector< double > GridEnergy( TotalConsumption.size(), 0 );
-
-	std::transform( IntervalProduction.begin(), IntervalProduction.end(),
-									TotalConsumption.begin(), GridEnergy.begin(),
-									[](double Production, double Consumption)->double{
-										if ( Production >= Consumption )
-											return 0.0;
-										else
-											return Consumption - Production;
-									} );
+  TotalConsumption.assign( ProductionSamples->size(), 0.0 );
 
-  Interpolation
-  EnergyValue( ProductionSamples->begin(), ProductionSamples->end(),
-               GridEnergy.begin(), GridEnergy.end() );
+  for ( const std::vector< double > & Consumption : Consumptions )
+    std::transform( Consumption.begin(), Consumption.end(),
+                    TotalConsumption.begin(), TotalConsumption.begin(),
+                    []( double ConsumerValue, double OldTotal )->double{
+                        return OldTotal + ConsumerValue; });
 
-  return Integral( EnergyValue,
-                   EnergyValue.DomainLower(), EnergyValue.DomainUpper() );
+  return Cost( TotalConsumption );
 }
 
 // The function to request the time coverage of a consumer is trivial as it
-// is only sending a request message to the given consumer.
+// is only sending a request message to the given consumer after making sure
+// that the consumer has a reply slot for its consumption.
 
 void Dominoes::Solver::EnergyObjective::RequestConsumptionCoverage(
 	   const Dominoes::Consumer & TheConsumer )
 {
+	Consumptions.AddSender( TheConsumer.GetAddress() );
 	Send( Consumer::TimeCoverageRequest(), TheConsumer.GetAddress() );
 }
 
@@ -264,7 +271,8 @@ Dominoes::Solver::EnergyObjective::EnergyObjective(
   const SampleTime & ProductionTimes )
 : Theron::Receiver(),
   IntervalProduction(), TotalConsumption(),
-  ProductionSamples( ProductionTimes )
+  ProductionSamples( ProductionTimes ),
+  Cost( ProductionTimes, IntervalProduction )
 {
   RegisterHandler( this, &EnergyObjective::SingleConsumption );
 	RegisterHandler( this, &EnergyObjective::ExtendTimeAxis    );
@@ -281,29 +289,82 @@ Solver
 // values. It should be noted that as there in general can be more threads
 // than there are cores in a multi-actor system, many messages can be handled
 // by the energy objective before control is returned to the solver thread.
-// The Theoron Wait function is also specified to wait for a given number of
-// messages, but it could return earlier, and it could even return with no
-// message processed. Thus, the return value must be verified.
+// The solver gathers all the replies in one wait, and it is only woken when
+// the last consumer has replied.
+//
+// If the in-process evaluation is used, the consumption block computes the
+// consumption of all the consumers in this thread and no messages are sent.
 
-Optimization::VariableType Dominoes::Solver::ObjectiveFunction(
+Optimization::VariableType Dominoes::Solver::EvaluateObjective(
   const Optimization::Variables & VariableValues )
 {
-  auto TheConsumer   = Consumers.begin();
-  auto ConsumersToGo = Consumers.size();
+  Evaluations++;
+
+  if ( EvaluationMode == Evaluation::InProcess )
+    return EnergyCost.Value( ConsumptionUpdate->Update( VariableValues ) );
 
   EnergyCost.Reset();
+  Metrics.CountMessages( Consumers.size() );
+
+  auto TheConsumer = Consumers.begin();
 
   for ( const Optimization::VariableType & AssignedStartTime : VariableValues )
     Theron::Actor::Send(
         boost::numeric_cast< CoSSMic::Time >( AssignedStartTime ),
         EnergyCost.GetAddress(), (TheConsumer++)->GetAddress() );
 
-  while ( ConsumersToGo )
-    ConsumersToGo -= EnergyCost.Wait( ConsumersToGo );
+  EnergyCost.Gather( Consumers.size() );
 
   return EnergyCost.Value();
 }
 
+// The objective function records the evaluation and forces the search to
+// stop if the deadline has passed. The value is still returned to the search.
+
+Optimization::VariableType Dominoes::Solver::ObjectiveFunction(
+  const Optimization::Variables & VariableValues )
+{
+  Optimization::VariableType Value;
+
+  if ( Metrics.IsEnabled() )
+  {
+    Instrumentation::Clock::time_point Start = Instrumentation::Clock::now();
+
+    Value = EvaluateObjective( VariableValues );
+    Metrics.RecordEvaluation( Instrumentation::Clock::now() - Start );
+  }
+  else
+    Value = EvaluateObjective( VariableValues );
+
+  Progress.Record( VariableValues, Value );
+
+  if ( Progress.Expired() )
+    ForceStop();
+
+  return Value;
+}
+
+// The batch evaluation is created for each batch since the time axis and the
+// interpolation are then final. The candidates are counted as evaluations but
+// they are not recorded as the best so far since they are not evaluated by
+// the search.
+
+std::vector< Optimization::VariableType > Dominoes::Solver::ObjectiveValues(
+  const Optimization::Population & Candidates )
+{
+  if ( !Profiles )
+    Profiles = std::make_unique< ConsumptionBlock >( Consumers,
+                                                     ProductionSamples );
+
+  BatchEvaluation Evaluate( *Profiles, ProductionSamples,
+                            EnergyCost.GetIntervalProduction(),
+                            GridInterpolation, NumberOfThreads );
+
+  Evaluations += Candidates.size();
+
+  return Evaluate( Candidates );
+}
+
 // Setting the bound constraints is simply scanning the consumer vector and
 // and store the start time intervals.
 
@@ -318,12 +379,10 @@ Dominoes::Solver::BoundConstraints( void )
   return Bounds;
 }
 
-// The actual optimisation will take place in a dedicated function that will
-// end by writing out the assigned start times to the file whose name is given
-// as argument to the function.
+// The initial start times are drawn at random for each consumer.
 
-void Dominoes::Solver::AssignStartTimes( const std::filesystem::path & ASTFile,
-																				 const CoSSMic::TimeInterval & SolarDay )
+Optimization::Variables
+Dominoes::Solver::InitialStartTimes( const CoSSMic::TimeInterval & SolarDay )
 {
    Optimization::Variables InitialValues;
 
@@ -358,31 +417,721 @@ void Dominoes::Solver::AssignStartTimes( const std::filesystem::path & ASTFile,
 										   CoSSMic::TimeInterval( EarliestStart,  LatestStart ) ) );
 		 }
 
-   // Then solving the optimal start time problem
+   return InitialValues;
+}
 
-   auto Solution = FindSolution( InitialValues );
+// The greedy start times are computed from the consumption block, which is
+// created if the solver uses the actor evaluation.
 
-   // Then open the assigned start time file and output the total grid energy
-   // value
+Optimization::Variables Dominoes::Solver::GreedyStartTimes( void )
+{
+  if ( !Profiles )
+    Profiles = std::make_unique< ConsumptionBlock >( Consumers,
+                                                     ProductionSamples );
 
-   std::ofstream Result( ASTFile );
+  const std::vector< Interval > Bounds( BoundConstraints() );
 
-   Result << "Total grid energy " << Solution.ObjectiveValue << std::endl;
+  return GreedyPlacement( *Profiles, Bounds, ProductionSamples,
+                          EnergyCost.GetIntervalProduction() ).StartTimes();
+}
+
+// The captured problem is also written from the consumption block, which is
+// created if it does not already exist.
 
-   // Store the solution to the given file before closing.
+void Dominoes::Solver::CaptureProblem( std::ostream & Output )
+{
+  if ( !Profiles )
+    Profiles = std::make_unique< ConsumptionBlock >( Consumers,
+                                                     ProductionSamples );
+
+  ProblemCapture::Write( Output, *ProductionSamples,
+                         EnergyCost.GetIntervalProduction(),
+                         BoundConstraints(), *Profiles );
+}
+
+// The explicit start times are stored as variables and they are confined to
+// the bounds when they are used.
+
+void Dominoes::Solver::StartFrom( const std::vector< CoSSMic::Time > & StartTimes )
+{
+  if ( !StartTimes.empty() && ( StartTimes.size() != Consumers.size() ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "There are " << StartTimes.size() << " initial start "
+                 << "times for " << Consumers.size() << " consumers";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  GivenStart.assign( StartTimes.begin(), StartTimes.end() );
+}
+
+Optimization::Variables
+Dominoes::Solver::FirstStartTimes( const CoSSMic::TimeInterval & SolarDay )
+{
+  if ( !GivenStart.empty() )
+  {
+    const std::vector< Interval > Bounds( BoundConstraints() );
+    Optimization::Variables       StartTimes( GivenStart );
+
+    for ( std::size_t i = 0; i < StartTimes.size(); i++ )
+      StartTimes[i] = std::min( std::max( StartTimes[i], Bounds[i].lower() ),
+                                Bounds[i].upper() );
+
+    return StartTimes;
+  }
+  else if ( GreedyStart )
+    return GreedyStartTimes();
+  else
+    return InitialStartTimes( SolarDay );
+}
+
+// The population starts with the explicit or greedy start times, and the
+// remaining starts are drawn at random. If they should be screened, all the
+// candidates are drawn and evaluated together, and the best candidates are
+// used for the starts in the order of increasing objective value.
+
+Optimization::Population
+Dominoes::Solver::InitialPopulation( const CoSSMic::TimeInterval & SolarDay,
+                                     unsigned int Starts )
+{
+  Optimization::Population InitialValues;
+
+  if ( !GivenStart.empty() || GreedyStart )
+    InitialValues.push_back( FirstStartTimes( SolarDay ) );
+
+  const std::size_t RandomStarts = Starts - std::min< std::size_t >( Starts,
+                                   InitialValues.size() );
+
+  if ( ScreeningFactor <= 1 )
+  {
+    for ( std::size_t Start = 0; Start < RandomStarts; Start++ )
+      InitialValues.push_back( InitialStartTimes( SolarDay ) );
+
+    return InitialValues;
+  }
+
+  Optimization::Population Candidates;
+
+  for ( std::size_t i = 0; i < RandomStarts * ScreeningFactor; i++ )
+    Candidates.push_back( InitialStartTimes( SolarDay ) );
+
+  const std::vector< Optimization::VariableType >
+  Values( ObjectiveValues( Candidates ) );
+
+  std::vector< std::size_t > Order( Candidates.size() );
+
+  std::iota( Order.begin(), Order.end(), 0 );
+  std::partial_sort( Order.begin(), Order.begin() + RandomStarts, Order.end(),
+                     [&]( std::size_t A, std::size_t B ){
+                       return Values[A] < Values[B]; });
+
+  for ( std::size_t Start = 0; Start < RandomStarts; Start++ )
+    InitialValues.push_back( std::move( Candidates[ Order[ Start ] ] ) );
+
+  return InitialValues;
+}
+
+// The screening factor is checked and stored
+
+void Dominoes::Solver::Screening( unsigned int CandidatesPerStart )
+{
+  if ( CandidatesPerStart == 0 )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "At least one candidate must be drawn per start";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  ScreeningFactor = CandidatesPerStart;
+}
+
+/*==============================================================================
+
+ Multi-start
+
+==============================================================================*/
+//
+// Setting the multi-start parameters only checks that there will be at least
+// one start.
+
+void Dominoes::Solver::MultiStart( unsigned int Starts, unsigned int Threads,
+                                   std::chrono::seconds Budget )
+{
+  if ( Starts == 0 )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The number of starts must be at least one";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+  NumberOfStarts  = Starts;
+  NumberOfThreads = Threads;
+  SearchBudget    = Budget;
+}
+
+// Setting the grid interpolation stores it for the searches and passes it
+// on to the energy objective
+
+void Dominoes::Solver::GridEnergyInterpolation(
+  Interpolation::Type InterpolationType )
+{
+  GridInterpolation = InterpolationType;
+  EnergyCost.SetGridInterpolation( InterpolationType );
+}
+
+// The resolutions are kept from the coarsest to the finest
+
+void Dominoes::Solver::MultiResolution(
+  const std::vector< CoSSMic::Time > & Seconds )
+{
+  for ( CoSSMic::Time Resolution : Seconds )
+    if ( Resolution <= 0 )
+    {
+      std::ostringstream ErrorMessage;
+
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "The resolution " << Resolution << " seconds of the "
+                   << "multi-resolution solution must be positive";
+
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+
+  Resolutions = Seconds;
+
+  std::sort( Resolutions.begin(), Resolutions.end(),
+             std::greater< CoSSMic::Time >() );
+
+  Resolutions.erase( std::unique( Resolutions.begin(), Resolutions.end() ),
+                     Resolutions.end() );
+}
+
+// The concurrent solution first draws all the initial start times in the
+// calling thread since the random generator is not shared between threads.
+// The consumption block is created if the solver uses the actor evaluation
+// since the consumers have already loaded their profiles. A subproblem is then
+// defined for each component with its consumers, a consumption block for the
+// consumers of the component, and their bounds. Without decomposition there
+// is only one subproblem, and it uses the consumption block of the solver.
+//
+// The tasks are all the starts for all the subproblems. Each worker thread
+// takes the next task until there are no more tasks or the budget or the
+// deadline has passed, and it creates a search for the subproblem of the task,
+// or a gradient search if the gradient is enabled. With the multi-resolution
+// solution the coarse levels are aggregated once from the production, and
+// each subproblem gets a copy of its consumption block for the time axis of
+// each level. A level that would not remove any production samples, or
+// would keep fewer than two, is skipped. The search of a task is then
+// preceded by a search on each coarse level, and the values found at the
+// last level are refined on the production samples.
+// The best solution of each subproblem is protected by a lock since it can be
+// updated by all threads. An exception thrown by a search is passed on to the
+// caller when all threads have terminated.
+//
+// Each search is stopped at the earlier of the end of the budget and the
+// deadline. A search stopped by the budget is reported as having reached the
+// time limit, whereas the solution is reported with the forced stop status if
+// the deadline stopped a search or prevented a start.
+
+Dominoes::Solver::OptimalSolution
+Dominoes::Solver::ConcurrentSolution( const CoSSMic::TimeInterval & SolarDay )
+{
+  using Clock = Anytime::Clock;
+  using Index = ConsumptionBlock::Index;
+
+  std::vector< Optimization::Variables >
+  InitialValues( InitialPopulation( SolarDay, NumberOfStarts ) );
+
+  if ( !Profiles )
+    Profiles = std::make_unique< ConsumptionBlock >( Consumers,
+                                                     ProductionSamples );
+
+  const std::vector< Interval > Bounds( BoundConstraints() );
+
+  // The coarse levels of the multi-resolution solution
+
+  struct Level
+  {
+    CoSSMic::Time         Resolution;
+    SampleTime            Samples;
+    std::vector< double > Production;
+  };
+
+  std::vector< Level > Levels;
+
+  const std::vector< double > & Production( EnergyCost.GetIntervalProduction() );
+
+  for ( CoSSMic::Time Resolution : Resolutions )
+  {
+    Level  TheLevel{ Resolution,
+                     std::make_shared< std::vector< CoSSMic::Time > >(),
+                     std::vector< double >() };
+    double Accumulated = 0.0;
+
+    for ( Index Sample = 0; Sample < ProductionSamples->size(); Sample++ )
+    {
+      const CoSSMic::Time TimeStamp = (*ProductionSamples)[ Sample ];
+
+      Accumulated += Production[ Sample ];
+
+      if ( TheLevel.Samples->empty() ||
+           ( TimeStamp - TheLevel.Samples->back() >= Resolution ) ||
+           ( Sample + 1 == ProductionSamples->size() ) )
+      {
+        TheLevel.Samples->push_back( TimeStamp );
+        TheLevel.Production.push_back( Accumulated );
+        Accumulated = 0.0;
+      }
+    }
+
+    if ( ( TheLevel.Samples->size() >= 2 ) &&
+         ( TheLevel.Samples->size() < ProductionSamples->size() ) &&
+         ( Levels.empty() ||
+           ( Levels.back().Samples->size() < TheLevel.Samples->size() ) ) )
+      Levels.push_back( std::move( TheLevel ) );
+  }
+
+  // The subproblems are defined with the best solution found for each
+
+  struct Subproblem
+  {
+    std::vector< Index >                    Consumers;
+    std::unique_ptr< ConsumptionBlock >     OwnBlock;
+    const ConsumptionBlock *                Block;
+    std::vector< Interval >                 Bounds;
+    std::vector< Optimization::Variables >  InitialValues;
+    std::vector< std::unique_ptr< ConsumptionBlock > > CoarseBlocks;
+    Optimization::Variables                 BestValues;
+    double                                  BestObjective;
+    nlopt_result                            BestStatus;
+  };
+
+  std::vector< Subproblem > Subproblems;
+
+  auto AddSubproblem = [&]( const std::vector< Index > & Component ){
+    Subproblem & TheProblem( Subproblems.emplace_back() );
+
+    TheProblem.Consumers     = Component;
+    TheProblem.BestObjective = std::numeric_limits< double >::max();
+    TheProblem.BestStatus    = NLOPT_FAILURE;
+
+    if ( Component.size() == Bounds.size() )
+      TheProblem.Block = Profiles.get();
+    else
+    {
+      TheProblem.OwnBlock = std::make_unique< ConsumptionBlock >( *Profiles,
+                                                                  Component );
+      TheProblem.Block    = TheProblem.OwnBlock.get();
+    }
+
+    for ( const Level & TheLevel : Levels )
+      TheProblem.CoarseBlocks.push_back(
+        std::make_unique< ConsumptionBlock >( *TheProblem.Block,
+                                              TheLevel.Samples ) );
+
+    for ( Index Consumer : Component )
+      TheProblem.Bounds.push_back( Bounds[ Consumer ] );
+
+    for ( const Optimization::Variables & Values : InitialValues )
+    {
+      Optimization::Variables & ComponentValues(
+                                TheProblem.InitialValues.emplace_back() );
+
+      for ( Index Consumer : Component )
+        ComponentValues.push_back( Values[ Consumer ] );
+    }
+  };
+
+  if ( Decompose )
+    for ( const Partition::Component & Component :
+          Partition( Consumers, ProductionSamples, GridInterpolation ) )
+      AddSubproblem( Component );
+  else
+  {
+    std::vector< Index > AllConsumers( Bounds.size() );
+
+    std::iota( AllConsumers.begin(), AllConsumers.end(), 0 );
+    AddSubproblem( AllConsumers );
+  }
+
+  // The stop time is the earlier of the deadline and the end of the budget
+
+  std::optional< Clock::time_point > StopTime( Deadline );
+
+  if ( SearchBudget > std::chrono::seconds::zero() )
+  {
+    Clock::time_point BudgetEnd = Clock::now() + SearchBudget;
+
+    if ( !StopTime || ( BudgetEnd < *StopTime ) )
+      StopTime = BudgetEnd;
+  }
+
+  // A cancelled solution is treated as if the deadline has passed so that 
+  // no new searches are started and the best start times so far are 
+  // returned as partial.
+
+  auto DeadlinePassed = [this](void){
+    return ( Deadline && ( Clock::now() >= *Deadline ) ) ||
+           ( Cancellation && Cancellation->IsCancelled() ); };
+
+  const unsigned int Tasks = NumberOfStarts *
+                             static_cast< unsigned int >( Subproblems.size() );
+
+  unsigned int Threads = NumberOfThreads;
+
+  if ( Threads == 0 )
+    Threads = std::max( 1U, std::thread::hardware_concurrency() );
+
+  Threads = std::min( Threads, Tasks );
+
+  std::vector< std::exception_ptr > Errors( Threads );
+  std::atomic< unsigned int >       NextTask( 0 );
+  std::atomic< bool >               Interrupted( false );
+  std::mutex                        BestLock;
+
+  auto Worker = [&]( unsigned int Thread ){
+    try
+    {
+      for ( unsigned int Task = NextTask++; Task < Tasks; Task = NextTask++ )
+      {
+        if ( ( StopTime && ( Clock::now() >= *StopTime ) ) || 
+             DeadlinePassed() )
+        {
+          if ( DeadlinePassed() ) Interrupted = true;
+          break;
+        }
+
+        Subproblem & TheProblem( Subproblems[ Task % Subproblems.size() ] );
+        Optimization::Variables Initial(
+                          TheProblem.InitialValues[ Task / Subproblems.size() ] );
+        std::optional< CoSSMic::Time > Step;
+
+        auto RunSearch = [&]( auto & TheSearch ){
+          if ( Cancellation )
+            TheSearch.CancelWith( *Cancellation );
+
+          if ( Step )
+            TheSearch.InitialStep( std::vector< double >( Initial.size(),
+                                   static_cast< double >( *Step ) ) );
+
+          auto Result = StopTime ? TheSearch.Solve( Initial, *StopTime )
+                                 : TheSearch.Solve( Initial );
+
+          Evaluations += TheSearch.Evaluations();
+          return Result;
+        };
+
+        // The coarse levels are searched in turn, and a level stopped by the
+        // budget or the deadline still passes on the best values found as
+        // the final search will then stop at its first evaluation.
+
+        for ( std::size_t L = 0; L < Levels.size(); L++ )
+        {
+          Search CoarseSearch( *TheProblem.CoarseBlocks[L], TheProblem.Bounds,
+                               Levels[L].Samples, Levels[L].Production,
+                               GridInterpolation,
+                               Metrics.IsEnabled() ? &Metrics : nullptr );
+
+          Initial = RunSearch( CoarseSearch ).VariableValues;
+          Step    = Levels[L].Resolution;
+        }
+
+        auto Solution = [&](void){
+          if ( Gradient )
+          {
+            GradientSearch TheSearch( *TheProblem.Block, TheProblem.Bounds,
+                          ProductionSamples, EnergyCost.GetIntervalProduction(),
+                          GridInterpolation,
+                          Metrics.IsEnabled() ? &Metrics : nullptr );
+
+            return RunSearch( TheSearch );
+          }
+          else
+          {
+            Search TheSearch( *TheProblem.Block, TheProblem.Bounds,
+                          ProductionSamples, EnergyCost.GetIntervalProduction(),
+                          GridInterpolation,
+                          Metrics.IsEnabled() ? &Metrics : nullptr );
+
+            return RunSearch( TheSearch );
+          }
+        }();
+
+        nlopt_result Status = Solution.Status;
+
+        if ( Status == NLOPT_FORCED_STOP )
+        {
+          if ( DeadlinePassed() ) Interrupted = true;
+          else Status = NLOPT_MAXTIME_REACHED;
+        }
+
+        std::lock_guard< std::mutex > Lock( BestLock );
+
+        if ( Solution.ObjectiveValue < TheProblem.BestObjective )
+        {
+          TheProblem.BestValues    = Solution.VariableValues;
+          TheProblem.BestObjective = Solution.ObjectiveValue;
+          TheProblem.BestStatus    = Status;
+        }
+      }
+    }
+    catch (...)
+    {
+      Errors[ Thread ] = std::current_exception();
+    }
+  };
+
+  std::vector< std::thread > Workers;
+
+  for ( unsigned int Thread = 0; Thread < Threads; Thread++ )
+    Workers.emplace_back( Worker, Thread );
+
+  for ( std::thread & TheWorker : Workers )
+    TheWorker.join();
+
+  for ( std::exception_ptr & Error : Errors )
+    if ( Error ) std::rethrow_exception( Error );
+
+  // The best start times of the subproblems are merged into the first initial
+  // start times, so that a subproblem for which no search completed keeps its
+  // initial start times. The status is the one of the forced stop if the
+  // deadline interrupted the searches, the time limit if any subproblem was
+  // stopped by the budget or did not complete a search, and otherwise the
+  // status of the first subproblem.
+
+  Optimization::Variables StartTimes( InitialValues.front() );
+  nlopt_result            Status = Subproblems.front().BestStatus;
+
+  for ( const Subproblem & TheProblem : Subproblems )
+  {
+    if ( TheProblem.BestValues.empty() ||
+         ( TheProblem.BestStatus == NLOPT_MAXTIME_REACHED ) )
+      Status = NLOPT_MAXTIME_REACHED;
+    else
+      for ( std::size_t i = 0; i < TheProblem.Consumers.size(); i++ )
+        StartTimes[ TheProblem.Consumers[i] ] = TheProblem.BestValues[i];
+  }
+
+  if ( Interrupted ) Status = NLOPT_FORCED_STOP;
+
+  // The objective value of a single subproblem is already known unless no
+  // search completed, and otherwise the merged start times are evaluated.
+
+  if ( ( Subproblems.size() == 1 ) && !Subproblems.front().BestValues.empty() )
+    return OptimalSolution( StartTimes, Subproblems.front().BestObjective,
+                            Status );
+  else
+    return OptimalSolution( StartTimes, EvaluateObjective( StartTimes ),
+                            Status );
+}
+
+/*==============================================================================
+
+ Single search
+
+==============================================================================*/
+//
+// The single search is run by the solver itself. If it was stopped by the
+// deadline, the start times returned by the algorithm are not necessarily the
+// best evaluated, and the recorded best start times are returned instead.
+
+Dominoes::Solver::OptimalSolution
+Dominoes::Solver::SingleSolution( const CoSSMic::TimeInterval & SolarDay )
+{
+  Progress.Reset();
+
+  if ( Deadline )
+    Progress.SetDeadline( *Deadline );
+  else
+    Progress.ClearDeadline();
+
+  auto Solution = FindSolution( InitialPopulation( SolarDay, 1 ).front() );
+
+  Progress.ClearDeadline();
+
+  if ( auto Memoised = MemoisationStatistics() )
+    Metrics.RecordMemoisation( Memoised->Hits, Memoised->Misses );
+
+  if ( ( Solution.Status == NLOPT_FORCED_STOP ) &&
+       !Progress.BestVariables().empty() )
+    return OptimalSolution( Progress.BestVariables(), Progress.BestValue(),
+                            NLOPT_FORCED_STOP );
+  else
+    return Solution;
+}
+
+/*==============================================================================
+
+ Racing portfolio
+
+==============================================================================*/
+//
+// The consumption block is created if the solver uses the actor evaluation,
+// as for the concurrent solution. Each algorithm of the portfolio gets an
+// evaluator owning its incremental consumption and its grid cost functor, and
+// they are held by shared pointers since the evaluator must be copyable. The
+// race is stopped at the earlier of the end of the search budget and the
+// deadline. The solution is reported with the forced stop status if the
+// deadline stopped the race, and with the time limit status if the budget
+// stopped it before any algorithm converged.
+
+Dominoes::Solver::OptimalSolution
+Dominoes::Solver::PortfolioSolution( const CoSSMic::TimeInterval & SolarDay )
+{
+  using Clock = Anytime::Clock;
+
+  if ( !Profiles )
+    Profiles = std::make_unique< ConsumptionBlock >( Consumers,
+                                                     ProductionSamples );
+
+  NL::Portfolio Algorithms;
+
+  Algorithms.Add< NL::Algorithm::Local::Approximation::Rescaling >();
+  Algorithms.Add< NL::Algorithm::Global::DIRECT::Standard >();
+  Algorithms.Add< NL::Algorithm::Global::ControlledRandomSearch >();
+
+  std::optional< Clock::time_point > StopTime( Deadline );
+
+  if ( SearchBudget > std::chrono::seconds::zero() )
+  {
+    Clock::time_point BudgetEnd = Clock::now() + SearchBudget;
+
+    if ( !StopTime || ( BudgetEnd < *StopTime ) )
+      StopTime = BudgetEnd;
+  }
+
+  Optimization::Variables InitialValues(
+                          InitialPopulation( SolarDay, 1 ).front() );
+
+  auto Outcome = Algorithms.Solve( InitialValues, BoundConstraints(),
+    [this](void)->NL::Portfolio::Evaluator
+    {
+      auto Consumption = std::make_shared< IncrementalConsumption >(
+                         *Profiles, ProductionSamples->size() );
+      auto Cost        = std::make_shared< GridCost >( ProductionSamples,
+                         EnergyCost.GetIntervalProduction(), GridInterpolation );
+
+      return [Consumption, Cost]( const Optimization::Variables & Values )
+      { return (*Cost)( Consumption->Update( Values ) ); };
+    }, StopTime );
+
+  Evaluations += Outcome.Evaluations;
+
+  nlopt_result Status = Outcome.Status;
+
+  if ( Status == NLOPT_FORCED_STOP )
+  {
+    if ( !( Deadline && ( Clock::now() >= *Deadline ) ) )
+      Status = NLOPT_MAXTIME_REACHED;
+  }
+
+  // If the race was stopped before the first evaluation, the initial start
+  // times are returned as the partial solution.
+
+  if ( Outcome.VariableValues.empty() )
+    return OptimalSolution( InitialValues, EvaluateObjective( InitialValues ),
+                            Status );
+  else
+    return OptimalSolution( Outcome.VariableValues, Outcome.ObjectiveValue,
+                            Status );
+}
+
+/*==============================================================================
+
+ Assigning start times
+
+==============================================================================*/
+//
+// The actual optimisation will take place in a dedicated function that
+// returns the assigned start times in the order of the consumers. A single
+// search is run directly by the solver, unless the racing portfolio, the
+// multi-start, the decomposition, the gradient or the multi-resolution
+// solution has been requested.
+
+Dominoes::Solver::Assignment
+Dominoes::Solver::OptimalAssignment( const CoSSMic::TimeInterval & SolarDay )
+{
+  auto Solution = [&](void){
+    Instrumentation::ScopeTimer Timer( Metrics, "Optimisation" );
+
+    if ( Racing )
+      return PortfolioSolution( SolarDay );
+    else
+      return ( ( NumberOfStarts > 1 ) || Decompose || Gradient ||
+               !Resolutions.empty() )
+             ? ConcurrentSolution( SolarDay ) : SingleSolution( SolarDay );
+  }();
+
+  Assignment Result;
+
+  Result.GridEnergy = Solution.ObjectiveValue;
+  Result.Partial    = ( Solution.Status == NLOPT_FORCED_STOP );
+
+  Result.StartTimes.reserve( Solution.VariableValues.size() );
+
+  for ( auto StartTime : Solution.VariableValues )
+    Result.StartTimes.push_back( static_cast< CoSSMic::Time >( StartTime ) );
+
+  return Result;
+}
+
+// The result stream is written from the assignment
+
+void Dominoes::Solver::AssignStartTimes( std::ostream & Result,
+																				 const CoSSMic::TimeInterval & SolarDay )
+{
+   Assignment Solution( OptimalAssignment( SolarDay ) );
+
+   Instrumentation::ScopeTimer Timer( Metrics, "WriteResult" );
+
+   // Then output the total grid energy value, flagged as partial if the
+   // search was stopped by the deadline.
+
+   Result << "Total grid energy ";
+
+   if ( Solution.Partial )
+     Result << "(partial) ";
+
+   Result << Solution.GridEnergy << std::endl;
+
+   // Store the solution to the given stream.
 
    auto Consumer  = Consumers.begin();
-   auto StartTime = Solution.VariableValues.begin();
+   auto StartTime = Solution.StartTimes.begin();
 
    while( Consumer != Consumers.end() )
    {
-     Result << Consumer->GetName() << " "
-            << static_cast< CoSSMic::Time >(*StartTime)
-            << std::endl;
+     Result << Consumer->GetName() << " " << *StartTime << std::endl;
      ++Consumer; ++StartTime;
    }
+}
+
+// Assigning the start times to a file simply opens the file and writes the
+// solution to it before closing.
+
+void Dominoes::Solver::AssignStartTimes( const std::filesystem::path & ASTFile,
+																				 const CoSSMic::TimeInterval & SolarDay )
+{
+  std::ofstream Result( ASTFile );
+
+  AssignStartTimes( Result, SolarDay );
+
+  Result.close();
 
-   Result.close();
+  if ( Metrics.IsEnabled() )
+  {
+    std::ofstream Report( Instrumentation::ReportFile( ASTFile ) );
+
+    Metrics.WriteJSON( Report );
+  }
 }
 
 /*==============================================================================
@@ -395,25 +1144,92 @@ Constructor & Destructor
 // consumers.
 
 Dominoes::Solver::Solver( const std::filesystem::path ProducerFile,
-                          const std::filesystem::path ConsumerEvents )
+                          const std::filesystem::path ConsumerEvents,
+                          Evaluation Engine, CoSSMic::Time KernelStep,
+                          const std::string & ScenarioName )
 : NL::Optimizer< NL::Algorithm::Local::Approximation::Rescaling >(),
   Consumers(), ProductionSamples( new std::vector< CoSSMic::Time >() ),
-  EnergyCost( ProductionSamples )
+  Metrics(), EvaluationMode( Engine ), Profiles(), ConsumptionUpdate(),
+  EnergyCost( ProductionSamples ), Evaluations(0),
+  NumberOfStarts(1), NumberOfThreads(0), SearchBudget( std::chrono::seconds::zero() ),
+  GridInterpolation( Interpolation::Type::SteffenMethod ), GreedyStart( false ),
+  GivenStart(), ScreeningFactor(1), Decompose( false ), Gradient( false ),
+  Resolutions(), Deadline(), Progress(), Racing( false )
 {
   // The producer time series can be imported using the standard CSV parsing
-  // function. However, this will return a map, and the solver has two vectors
-  // of data.
+  // function. The flat time series has the two vectors of data needed by the
+  // solver.
+
+  {
+    Instrumentation::ScopeTimer Timer( Metrics, "ReadProduction" );
+
+    CoSSMic::TimeSeries Production;
+
+    CoSSMic::CSVtoTimeSeries( ProducerFile, Production );
+
+    ProductionSamples->assign( Production.Times().begin(),
+                               Production.Times().end() );
+    EnergyCost.SetProductionValues( std::vector< double >( 
+      Production.Values().begin(), Production.Values().end() ) );
+  }
 
-  std::vector< double > ProducedEnergy;
+  ReadConsumerEvents( ConsumerEvents, KernelStep, ScenarioName );
+  CompleteProblem();
+}
+
+// The production can also be given as a time series computed in memory, for
+// instance by the solar production model, and the consumers are created from
+// the consumer events file as above.
+
+Dominoes::Solver::Solver( const CoSSMic::TimeSeries & Production,
+                          const std::filesystem::path ConsumerEvents,
+                          Evaluation Engine, CoSSMic::Time KernelStep,
+                          const std::string & ScenarioName )
+: NL::Optimizer< NL::Algorithm::Local::Approximation::Rescaling >(),
+  Consumers(), ProductionSamples( new std::vector< CoSSMic::Time >() ),
+  Metrics(), EvaluationMode( Engine ), Profiles(), ConsumptionUpdate(),
+  EnergyCost( ProductionSamples ), Evaluations(0),
+  NumberOfStarts(1), NumberOfThreads(0), SearchBudget( std::chrono::seconds::zero() ),
+  GridInterpolation( Interpolation::Type::SteffenMethod ), GreedyStart( false ),
+  GivenStart(), ScreeningFactor(1), Decompose( false ), Gradient( false ),
+  Resolutions(), Deadline(), Progress(), Racing( false )
+{
+  const auto & ProductionTimes = Production.Times();
+
+  if ( ( ProductionTimes.size() < 2 ) ||
+       ( std::adjacent_find( ProductionTimes.begin(), ProductionTimes.end(),
+         std::greater_equal< CoSSMic::Time >() ) != ProductionTimes.end() ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The production has " << ProductionTimes.size()
+                 << " samples, and there must be at least two samples "
+                 << "and the sample times must be increasing";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
 
-  for ( const auto & ProductionPoint : CoSSMic::CSVtoTimeSeries(ProducerFile) )
   {
-    ProductionSamples->push_back( ProductionPoint.first );
-    ProducedEnergy.push_back( ProductionPoint.second );
+    Instrumentation::ScopeTimer Timer( Metrics, "ReadProduction" );
+
+    ProductionSamples->assign( ProductionTimes.begin(), ProductionTimes.end() );
+    EnergyCost.SetProductionValues( std::vector< double >( 
+      Production.Values().begin(), Production.Values().end() ) );
   }
 
-  EnergyCost.SetProductionValues( ProducedEnergy );
+  ReadConsumerEvents( ConsumerEvents, KernelStep, ScenarioName );
+  CompleteProblem();
+}
+
+// The consumer events file is read in the same way for both constructors
+// taking the file.
 
+void Dominoes::Solver::ReadConsumerEvents(
+                          const std::filesystem::path & ConsumerEvents,
+                          CoSSMic::Time KernelStep,
+                          const std::string & ScenarioName )
+{
   // In CoSSMic it was assumed that the consumption devices would become
   // available one by one over time. This means that devices that has already
   // been started should not be re-scheduled. This complicated the whole
@@ -434,31 +1250,125 @@ Dominoes::Solver::Solver( const std::filesystem::path ProducerFile,
   CoSSMic::Time EarliestStartTime, LatestStartTime;
   std::string   DeviceID, ConsumptionProfile;
 
+  // The actor names of the consumers are prefixed by the scenario name if
+  // it is given.
+
+  const std::string ActorPrefix( ScenarioName.empty() ? ScenarioName
+                                                      : ScenarioName + ":" );
+
   // The consumer events file is read line by line and the values obtained
   // used to create a new consumer actor. The consumer actor's constructor
 	// will send a message to the consumer actor to load the consumption profile
-	// file.
+	// file. A consumption profile referring to the profile pack is taken from
+	// the pack and given to the consumer directly.
+
+  {
+    Instrumentation::ScopeTimer Timer( Metrics, "CreateConsumers" );
+
+    while ( CSVParser.read_row( DeviceID, EarliestStartTime, LatestStartTime,
+                                ConsumptionProfile ) )
+      if ( ProfilePack::IsReference( ConsumptionProfile ) )
+        Consumers.emplace_back( DeviceID, EarliestStartTime, LatestStartTime,
+                                ProfilePack::Resolve( ConsumptionProfile ),
+                                ProductionSamples, KernelStep, ActorPrefix );
+      else
+        Consumers.emplace_back( DeviceID, EarliestStartTime, LatestStartTime,
+                                ConsumptionProfile, ProductionSamples,
+                                KernelStep, ActorPrefix );
+  }
+}
 
-  while ( CSVParser.read_row( DeviceID, EarliestStartTime, LatestStartTime,
-                              ConsumptionProfile ) )
-    Consumers.emplace_back( DeviceID, EarliestStartTime, LatestStartTime,
-                            ConsumptionProfile, ProductionSamples );
+// The time coverage of the consumers and the in-process evaluation data are
+// established in the same way for both constructors.
 
-	// Then the time coverage of each consumer is requested to ensure that
+void Dominoes::Solver::CompleteProblem( void )
+{
+	// The time coverage of each consumer is requested to ensure that
 	// the time axis covers all possible consumption intervals. The interaction
 	// with the consumers is done by the Energy Cost object.
 
-	for ( const Consumer & TheConsumer : Consumers )
-		EnergyCost.RequestConsumptionCoverage( TheConsumer );
+  {
+    Instrumentation::ScopeTimer Timer( Metrics, "TimeCoverage" );
+
+    for ( const Consumer & TheConsumer : Consumers )
+      EnergyCost.RequestConsumptionCoverage( TheConsumer );
+
+    Metrics.CountMessages( Consumers.size() );
+
+    // Finally it is just to wait until all consumers have loaded their
+    // consumption profiles and reported back their time coverage. Only then
+    // the problem is properly set up.
+
+    EnergyCost.Gather( Consumers.size() );
+  }
+
+  // The time axis is now final, and the consumption block can be created if
+  // the objective function should be evaluated in-process.
+
+  if ( EvaluationMode == Evaluation::InProcess )
+  {
+    Instrumentation::ScopeTimer Timer( Metrics, "ConsumptionBlock" );
+
+    Profiles = std::make_unique< ConsumptionBlock >( Consumers,
+                                                     ProductionSamples );
+    ConsumptionUpdate = std::make_unique< IncrementalConsumption >( *Profiles,
+                                                     ProductionSamples->size() );
+  }
+}
+
+// The in-memory constructor checks the production series before storing it,
+// and creates the consumers directly from the given events.
+
+Dominoes::Solver::Solver( const std::vector< CoSSMic::Time > & ProductionTimes,
+                          const std::vector< double > & ProducedEnergy,
+                          const std::vector< ConsumerEvent > & ConsumerEvents,
+                          Evaluation Engine, CoSSMic::Time KernelStep,
+                          const std::string & ScenarioName )
+: NL::Optimizer< NL::Algorithm::Local::Approximation::Rescaling >(),
+  Consumers(), ProductionSamples( new std::vector< CoSSMic::Time >() ),
+  Metrics(), EvaluationMode( Engine ), Profiles(), ConsumptionUpdate(),
+  EnergyCost( ProductionSamples ), Evaluations(0),
+  NumberOfStarts(1), NumberOfThreads(0), SearchBudget( std::chrono::seconds::zero() ),
+  GridInterpolation( Interpolation::Type::SteffenMethod ), GreedyStart( false ),
+  GivenStart(), ScreeningFactor(1), Decompose( false ), Gradient( false ),
+  Resolutions(), Deadline(), Progress(), Racing( false )
+{
+  if ( ( ProductionTimes.size() < 2 ) ||
+       ( ProductionTimes.size() != ProducedEnergy.size() ) ||
+       ( std::adjacent_find( ProductionTimes.begin(), ProductionTimes.end(),
+         std::greater_equal< CoSSMic::Time >() ) != ProductionTimes.end() ) )
+  {
+    std::ostringstream ErrorMessage;
+
+    ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                 << "The production has " << ProductionTimes.size()
+                 << " sample times and " << ProducedEnergy.size()
+                 << " energy values, and there must be at least two samples "
+                 << "and the sample times must be increasing";
+
+    throw std::invalid_argument( ErrorMessage.str() );
+  }
 
-	// Finally it is just to wait until all consumers have loaded their
-	// consumption profiles and reported back their time coverage. Only then
-	// the problem is properly set up.
+  {
+    Instrumentation::ScopeTimer Timer( Metrics, "ReadProduction" );
+
+    ProductionSamples->assign( ProductionTimes.begin(), ProductionTimes.end() );
+    EnergyCost.SetProductionValues( ProducedEnergy );
+  }
 
-	auto ConsumersToGo = Consumers.size();
+  const std::string ActorPrefix( ScenarioName.empty() ? ScenarioName
+                                                      : ScenarioName + ":" );
+
+  {
+    Instrumentation::ScopeTimer Timer( Metrics, "CreateConsumers" );
+
+    for ( const ConsumerEvent & Event : ConsumerEvents )
+      Consumers.emplace_back( Event.ID, Event.EarliestStart,
+                              Event.LatestStart, Event.Profile,
+                              ProductionSamples, KernelStep, ActorPrefix );
+  }
 
-	while ( ConsumersToGo )
-    ConsumersToGo -= EnergyCost.Wait( ConsumersToGo );
+  CompleteProblem();
 }
 
 // The destructor simply removes the consumers.
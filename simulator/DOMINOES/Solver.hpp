@@ -24,7 +24,15 @@ License: LGPL 3.0
 
 // Standard headers
 #include <list>                              // Storing consumers
+#include <vector>                            // In-memory problems
+#include <string>                            // Scenario names
 #include <filesystem>                        // File names
+#include <ostream>                           // Writing the results
+#include <chrono>                            // Multi-start time budget
+#include <memory>                            // Smart pointers
+#include <optional>                          // Optional deadline
+#include <atomic>                            // Evaluation counter
+#include <cstddef>                           // Evaluation counter
 
 // Actor framework
 #include "Actor.hpp"                         // The Theron++ actor framework
@@ -33,13 +41,21 @@ License: LGPL 3.0
 #include "NonLinear/Algorithms.hpp"          // The algorithms
 #include "NonLinear/Optimizer.hpp"           // The solver
 #include "NonLinear/LocalApproximation.hpp"  // The BOBYAQA interface
+#include "NonLinear/Portfolio.hpp"           // Racing algorithms
 
 // The CoSSMic Time concept
 #include "TimeInterval.hpp"                  // Time
+#include "Interpolation.hpp"                 // Grid energy interpolation
+#include "TimeSeries.hpp"                    // Production given in memory
 
 // The Dominoes consumer class
 #include "Typedefs.hpp"                      // Dominoes types
 #include "Consumer.hpp"                      // Definition of consumers
+#include "ConsumptionBlock.hpp"              // In-process evaluation
+#include "GridCost.hpp"                      // Objective value
+#include "IncrementalConsumption.hpp"        // Changed start times only
+#include "Anytime.hpp"                       // Deadline and best so far
+#include "Instrumentation.hpp"               // Phase timers and counters
 
 namespace NL = Optimization::NonLinear;
 
@@ -63,14 +79,59 @@ private:
 
   SampleTime ProductionSamples;
 
+  // The instrumentation records the time used by the phases of the set up and
+  // the solution, and the evaluations of the objective function and the
+  // messages sent to the consumers. It is declared before the other members
+  // since the constructor records its phases.
+
+  Instrumentation Metrics;
+
+  // ---------------------------------------------------------------------------
+  // Evaluation engine
+  // ---------------------------------------------------------------------------
+  //
+  // The objective function can be evaluated in two ways: Either by sending
+  // the assigned start times to the consumer actors and collect their
+  // consumption, which is necessary if the consumers could be distributed;
+  // or by computing the consumption of all consumers in the solver's own
+  // thread from a consumption block holding the profiles of all consumers.
+  // The latter avoids all message traffic for each evaluation of the
+  // objective function.
+
+public:
+
+  enum class Evaluation
+  {
+    Actors,
+    InProcess
+  };
+
+private:
+
+  const Evaluation EvaluationMode;
+
+  // The consumption block is only created if the in-process evaluation is
+  // used, and only after the consumers have loaded their profiles and the
+  // time axis has been extended to cover all consumers.
+
+  std::unique_ptr< ConsumptionBlock > Profiles;
+
+  // The in-process evaluation only recomputes the consumption of the
+  // consumers whose start times have changed since the previous evaluation
+  // of the objective function.
+
+  std::unique_ptr< IncrementalConsumption > ConsumptionUpdate;
+
   // ---------------------------------------------------------------------------
   // Consumption Receiver
   // ---------------------------------------------------------------------------
   //
   // The solver uses a Receiver object to ensure that the objective function
   // waits for the energy consumption from all the consumers. When a profile
-  // comes back from a consumer, it will add it to the global consumption
-  // profile.
+  // comes back from a consumer, it is stored in the reply slot of the
+  // consumer, and the profiles are added to the total consumption in the
+  // order of the consumers when all of them have arrived. The total
+  // consumption is then the same whatever the order of the replies.
   //
   // The class stores a shared pointer to the production sample times as
   // that represents the abscissa for the net energy of the building.  Since
@@ -89,6 +150,15 @@ private:
     std::vector< double > IntervalProduction, TotalConsumption;
     const SampleTime      ProductionSamples;
 
+    // The consumption of each consumer is kept in its reply slot
+
+    Theron::ReplySlots< std::vector< double > > Consumptions;
+
+    // The grid energy for a total consumption is computed by the grid cost
+    // functor referring the above production data.
+
+    GridCost Cost;
+
 		// The index type is defined for the above vectors
 
 		using Index = std::vector< double >::size_type;
@@ -111,7 +181,7 @@ private:
 
 		// The time coverage is requested from the consumers by a small helper
 		// function invoked on each consumer once they have been created in the
-		// solver's constructor.
+		// solver's constructor. It also gives the consumer its reply slot.
 
 		void RequestConsumptionCoverage( const Consumer & TheConsumer );
 
@@ -123,10 +193,29 @@ private:
     void SetProductionValues( const std::vector< double > & Values );
 
     // The value of the objective function can then be directly provided by
-    // interpolating and integrating the grid energy vector.
+    // adding the consumptions and interpolating and integrating the grid
+    // energy vector.
 
     double Value( void );
 
+    // The value can also be computed for a total consumption computed
+    // elsewhere.
+
+    inline double Value( const std::vector< double > & Consumption )
+    { return Cost( Consumption ); }
+
+    // The production in each sample interval is needed by the parallel
+    // searches, which must have their own copy of the grid cost functor.
+
+    inline const std::vector< double > & GetIntervalProduction( void ) const
+    { return IntervalProduction; }
+
+    // The interpolation used for the grid energy can be changed, and it is
+    // just passed on to the grid cost functor.
+
+    inline void SetGridInterpolation( Interpolation::Type InterpolationType )
+    { Cost.SetInterpolation( InterpolationType ); }
+
     // The reset function is used to set all elements in the total consumption
     // vector to zero.
 
@@ -148,16 +237,298 @@ private:
   // The objective function will reset the energy cost and then send the
   // assigned start times to the consumers and wait for all of them to report
   // back their consumption at the production sample times, and then return
-  // the final energy cost when all consumers are done.
+  // the final energy cost when all consumers are done. The evaluation itself
+  // is done by a helper function, and the objective function records the
+  // evaluation as the best so far and stops the search if the deadline has
+  // passed.
+
+  Optimization::VariableType
+  EvaluateObjective( const Optimization::Variables & VariableValues );
+
+  // The evaluations of the objective function are counted, including the
+  // evaluations done by the searches of the multi-start. The counter is
+  // atomic since the searches add their evaluations from their threads.
+
+  std::atomic< std::size_t > Evaluations;
 
   virtual Optimization::VariableType
 	ObjectiveFunction( const Optimization::Variables & VariableValues ) override;
 
+  // Many candidate start time vectors can be evaluated together by the batch
+  // evaluation working directly on the consumption block, which is created
+  // if the actor evaluation is used. The evaluation uses the threads of the
+  // multi-start.
+
+  virtual std::vector< Optimization::VariableType >
+  ObjectiveValues( const Optimization::Population & Candidates ) override;
+
   // There is a function to return a vector of bound constraints based on the
   // earliest and latest allowed start time.
 
   virtual std::vector< Interval > BoundConstraints( void ) override;
 
+  // ---------------------------------------------------------------------------
+  // Multi-start
+  // ---------------------------------------------------------------------------
+  //
+  // The quality of the solution found by a single search depends on the
+  // initial start times, which are drawn at random. A multi-start optimisation
+  // runs a given number of independent searches from different initial start
+  // times concurrently on a given number of threads and keeps the best
+  // solution found. Each thread has its own search object, and all searches
+  // evaluate the objective function in-process from the consumption block.
+  // The optional time budget bounds the wall-clock time used by all the
+  // searches: No new search will be started after the budget has been used,
+  // and a running search is given the remaining budget as its time limit.
+  // A zero budget means no time limit.
+
+  unsigned int         NumberOfStarts, NumberOfThreads;
+  std::chrono::seconds SearchBudget;
+
+  // The searches must use the same interpolation of the grid energy as the
+  // energy objective
+
+  Interpolation::Type  GridInterpolation;
+
+  // The initial start times for one search are drawn by a helper function
+  // since they are needed both for single and multiple starts.
+
+  Optimization::Variables InitialStartTimes( const CoSSMic::TimeInterval & SolarDay );
+
+  // The initial start times can alternatively be constructed by placing the
+  // consumers greedily onto the residual production. If this warm start is
+  // enabled it is used as the initial point of a single search and the first
+  // start of a multi-start, and the other starts are still drawn at random.
+
+  bool GreedyStart;
+
+  Optimization::Variables GreedyStartTimes( void );
+
+  // The initial start times can also be given explicitly, for instance
+  // from the solution of a similar scenario. They are then used in place of
+  // the greedy or random start times for the first search after being
+  // confined to the start intervals of the consumers. The initial start
+  // times of the first search are provided by a function applying this
+  // precedence.
+
+  Optimization::Variables GivenStart;
+
+  Optimization::Variables FirstStartTimes( const CoSSMic::TimeInterval & SolarDay );
+
+  // The random initial start times can be screened: For each start a given
+  // number of random candidates are drawn and evaluated together, and the
+  // starts use the best candidates. The initial start times for a given
+  // number of starts are provided by a function that puts the explicit or
+  // greedy start times first, if any, followed by the random or screened
+  // start times.
+
+  unsigned int ScreeningFactor;
+
+  Optimization::Population InitialPopulation( const CoSSMic::TimeInterval & SolarDay,
+                                              unsigned int Starts );
+
+  // ---------------------------------------------------------------------------
+  // Decomposition
+  // ---------------------------------------------------------------------------
+  //
+  // Consumers whose time coverages share no production samples are
+  // independent, and the problem can then be decomposed into smaller problems
+  // for the components of the partition of the consumers. The subproblems are
+  // solved concurrently as the searches of the multi-start, and each start
+  // is a search for one component from its part of the initial start times.
+  // The best start times for each component are merged, and the objective
+  // value of the merged start times is evaluated by the solver's evaluation
+  // engine. Decomposition is used only if it has been enabled.
+
+  bool Decompose;
+
+  // The searches for all components and starts are run by a function
+  // returning the best solution. Without decomposition there is only one
+  // component containing all consumers.
+
+  OptimalSolution ConcurrentSolution( const CoSSMic::TimeInterval & SolarDay );
+
+  // The searches can use the analytic gradient of the grid energy with a
+  // variable metric algorithm instead of BOBYQA. The gradient is only
+  // available for the in-process evaluation of the searches, and the
+  // concurrent solution is therefore used also for a single start when the
+  // gradient is enabled.
+
+  bool Gradient;
+
+  // ---------------------------------------------------------------------------
+  // Multi-resolution
+  // ---------------------------------------------------------------------------
+  //
+  // Most evaluations of a search are spent far from the solution where the
+  // full resolution of the production, often one minute, is not needed. With
+  // the multi-resolution solution each search is first run on the production
+  // aggregated to the coarsest of the given resolutions in seconds, and then
+  // refined on each finer resolution and finally on the production samples,
+  // each level starting from the solution of the previous level with an
+  // initial step of the resolution of the previous level. The coarse grids
+  // keep the first production sample and every sample at least the
+  // resolution after the previous sample kept, and the last sample, and the
+  // production of a coarse interval is the sum of the production of the
+  // sample intervals it covers. The levels are searched by BOBYQA, and only
+  // the final level uses the gradient if it is enabled. The concurrent
+  // solution is used also for a single start when the multi-resolution is
+  // enabled, and it is disabled if there are no resolutions.
+
+  std::vector< CoSSMic::Time > Resolutions;
+
+  // ---------------------------------------------------------------------------
+  // Deadline
+  // ---------------------------------------------------------------------------
+  //
+  // The assignment of start times can be bounded by a wall-clock deadline.
+  // When the deadline passes, the running searches are forced to stop and no
+  // new searches are started, and the best start times evaluated so far are
+  // returned as a partial solution. The time limit of NLopt is given in whole
+  // seconds and it is only checked by the algorithm between iterations, so the
+  // deadline is instead tested by the objective function after each
+  // evaluation. The anytime record keeps the best start times evaluated by the
+  // single search run by the solver.
+
+  std::optional< Anytime::Clock::time_point > Deadline;
+  Anytime                                     Progress;
+
+  // The single search is run by a function that returns the best values
+  // evaluated if the search was stopped by the deadline. Repeated evaluations 
+  // of start times that are equal when truncated to whole seconds can be
+  // memoised for this search by the memoisation of the optimizer, and the 
+  // hits and misses of the memoisation are then reported by the metrics.
+
+  OptimalSolution SingleSolution( const CoSSMic::TimeInterval & SolarDay );
+
+  // ---------------------------------------------------------------------------
+  // Racing portfolio
+  // ---------------------------------------------------------------------------
+  //
+  // For difficult scenarios with many overlapping consumers on a partly
+  // cloudy production no single algorithm consistently finds the best start
+  // times first. The racing portfolio runs BOBYQA from the first initial
+  // start times concurrently with the global DIRECT and controlled random
+  // search algorithms, each in its own thread with its own incremental
+  // consumption state and grid cost functor on the shared consumption block.
+  // The race ends when the first algorithm converges, or when the search
+  // budget or the deadline has passed, and the best start times evaluated by
+  // any algorithm are returned. The race is disabled by default.
+
+  bool Racing;
+
+  OptimalSolution PortfolioSolution( const CoSSMic::TimeInterval & SolarDay );
+
+  // Both constructors end by waiting for the consumers to report their time
+  // coverage and by creating the in-process evaluation data, and this is
+  // done by a common function.
+
+  void CompleteProblem( void );
+
+  // The constructors taking the consumer events file create the consumers
+  // from its lines by a common function.
+
+  void ReadConsumerEvents( const std::filesystem::path & ConsumerEvents,
+                           CoSSMic::Time KernelStep,
+                           const std::string & ScenarioName );
+
+public:
+
+  // The multi-start is enabled by setting the number of starts larger than
+  // one. If the number of threads is zero the number of hardware threads will
+  // be used. An invalid argument exception is thrown if the number of starts
+  // is zero.
+
+  void MultiStart( unsigned int Starts, unsigned int Threads = 0,
+                   std::chrono::seconds Budget = std::chrono::seconds::zero() );
+
+  // The grid energy is by default interpolated by Steffen's method. If it is
+  // set to be linearly interpolated, the objective value is computed directly
+  // as the sum of the trapezoids without allocating memory.
+
+  void GridEnergyInterpolation( Interpolation::Type InterpolationType );
+
+  // The decomposition into independent subproblems is enabled or disabled
+  // by a flag. It is disabled by default.
+
+  inline void Decomposition( bool Enabled )
+  { Decompose = Enabled; }
+
+  // The greedy warm start is enabled or disabled by a flag. It is disabled by
+  // default.
+
+  inline void WarmStart( bool Enabled )
+  { GreedyStart = Enabled; }
+
+  // The racing portfolio is enabled or disabled by a flag, and when enabled
+  // it takes precedence over the multi-start and the decomposition.
+
+  inline void RacingPortfolio( bool Enabled )
+  { Racing = Enabled; }
+
+  // The gradient based searches are enabled or disabled by a flag. They are
+  // disabled by default.
+
+  inline void GradientBased( bool Enabled )
+  { Gradient = Enabled; }
+
+  // The resolutions of the multi-resolution solution can be given in any
+  // order, and an empty list disables it as by default. An invalid argument
+  // exception is thrown if a resolution is not positive.
+
+  void MultiResolution( const std::vector< CoSSMic::Time > & Seconds );
+
+  // The explicit initial start times are given in the order of the consumers
+  // and apply to all following assignments of start times. An empty vector
+  // removes them, and an invalid argument exception is thrown if there is
+  // not one start time for each consumer.
+
+  void StartFrom( const std::vector< CoSSMic::Time > & StartTimes );
+
+  // The number of random candidates screened per start is one by default,
+  // meaning no screening, and an invalid argument exception is thrown if it
+  // is zero.
+
+  void Screening( unsigned int CandidatesPerStart );
+
+  // The deadline is set as a time point, or relative to the time the deadline
+  // is set. It applies to all following assignments of start times until it
+  // is cleared or set again.
+
+  inline void SolutionDeadline( Anytime::Clock::time_point TheDeadline )
+  { Deadline = TheDeadline; }
+
+  inline void SolutionDeadline( std::chrono::milliseconds TimeToDeadline )
+  { Deadline = Anytime::Clock::now() + TimeToDeadline; }
+
+  inline void ClearDeadline( void )
+  { Deadline.reset(); }
+
+  // The number of objective function evaluations since the solver was
+  // created can be read, for instance for benchmarking.
+
+  inline std::size_t NumberOfEvaluations( void ) const
+  { return Evaluations.load(); }
+
+  // The recording of the evaluation latencies can be enabled, and the report
+  // of the instrumentation can be written as JSON. When the instrumentation
+  // is enabled, the report is also written to the metrics file alongside the
+  // assigned start time file.
+
+  inline void Instrument( bool Enabled )
+  { Metrics.Enable( Enabled ); }
+
+  inline void WriteMetrics( std::ostream & Report ) const
+  { Metrics.WriteJSON( Report ); }
+
+  // The problem can be captured to a stream so that its objective function
+  // can be replayed by the algorithm benchmark without the consumers. The
+  // format is described in the Problem Capture header.
+
+  void CaptureProblem( std::ostream & Output );
+
+private:
+
   // ---------------------------------------------------------------------------
   // Optimizing
   // ---------------------------------------------------------------------------
@@ -182,9 +553,41 @@ private:
 	// the allowed start time interval. If no solar day is specified, a random
 	// value over the start time interval will be used as initial guess for the
 	// consumer's start time
+	//
+	// The results can also be written to a given output stream, in which case
+	// the total grid energy is on the first line followed by one line for each
+	// consumer exactly as in the assigned start time file. The function can be
+	// called repeatedly for the same set of consumers, and each call will start
+	// the optimisation from a new initial value.
+	//
+	// If the optimisation was stopped by the deadline, the first line reads
+	// "Total grid energy (partial) <value>" to flag that the start times are
+	// the best found so far and not a converged solution. The value is still
+	// the last token on the line.
+
+	//
+	// The start times can also be returned in memory, in the order the
+	// consumers were given to the constructor, together with the total grid
+	// energy and a flag telling if the solution is partial. The streamed and
+	// the file results are written from this assignment.
 
 public:
 
+  class Assignment
+  {
+  public:
+
+    std::vector< CoSSMic::Time > StartTimes;
+    double                       GridEnergy;
+    bool                         Partial;
+  };
+
+  Assignment OptimalAssignment(
+         const CoSSMic::TimeInterval & SolarDay = CoSSMic::TimeInterval() );
+
+  void AssignStartTimes( std::ostream & Result,
+			 const CoSSMic::TimeInterval & SolarDay = CoSSMic::TimeInterval() );
+
   void AssignStartTimes( const std::filesystem::path & ASTFile,
 			 const CoSSMic::TimeInterval & SolarDay = CoSSMic::TimeInterval() );
 
@@ -197,12 +600,58 @@ private:
   // The constructor takes the name of the CVS file giving the produced energy
   // over the full day, and the name of the CSV file containing all the consumer
   // events. It first initialises the production time series vectors, and then
-  // creates all the consumers.
+  // creates all the consumers. The evaluation engine to use for the objective
+  // function can optionally be given, and so can the step in seconds used by
+  // the consumers to tabulate their consumption profiles. If several solvers
+  // exist at the same time, each must be given a unique scenario name used to
+  // make the actor names of the consumers unique.
 
 public:
 
   Solver( const std::filesystem::path ProducerFile,
-          const std::filesystem::path ConsumerEvents );
+          const std::filesystem::path ConsumerEvents,
+          Evaluation Engine = Evaluation::Actors,
+          CoSSMic::Time KernelStep = 1,
+          const std::string & ScenarioName = std::string() );
+
+  // The production can also be given as a time series with the cumulative
+  // energy, typically generated by the CoSSMic solar production model, so
+  // that it does not have to be written to a file and parsed back. An
+  // invalid argument exception is thrown if the series has less than two
+  // samples or the times are not increasing.
+
+  Solver( const CoSSMic::TimeSeries & Production,
+          const std::filesystem::path ConsumerEvents,
+          Evaluation Engine = Evaluation::Actors,
+          CoSSMic::Time KernelStep = 1,
+          const std::string & ScenarioName = std::string() );
+
+  // The problem can also be given in memory when the solver is embedded in
+  // another application. The production is then given as two vectors of the
+  // same length with the sample times in increasing order and the produced
+  // energy as it would have been read from the production file, and each
+  // consumer event has the content of one line of the consumer events file
+  // except that the consumption profile is given as the cumulative energy
+  // at relative times. An invalid argument exception is thrown if the
+  // production vectors have less than two samples, have different lengths
+  // or the times are not increasing.
+
+  class ConsumerEvent
+  {
+  public:
+
+    std::string           ID;
+    CoSSMic::Time         EarliestStart, LatestStart;
+    Consumer::LoadProfile Profile;
+  };
+
+  Solver( const std::vector< CoSSMic::Time > & ProductionTimes,
+          const std::vector< double > & ProducedEnergy,
+          const std::vector< ConsumerEvent > & ConsumerEvents,
+          Evaluation Engine = Evaluation::Actors,
+          CoSSMic::Time KernelStep = 1,
+          const std::string & ScenarioName = std::string() );
+
   Solver( void ) = delete;
   Solver( const Solver & Other ) = delete;
 
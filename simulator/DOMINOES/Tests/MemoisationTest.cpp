@@ -0,0 +1,185 @@
+/*==============================================================================
+Memoisation test
+
+The single search of the solver can memoise the objective values of start
+times that are equal when truncated to whole seconds, since the objective
+converts the start times to whole seconds by truncation. This test checks
+that memoisation is effective for BOBYQA, which is the algorithm of the
+single search, and that the cells of the evaluation cache line up with the
+truncation of the objective:
+
+1. A start time of 10.7 seconds is evaluated as 10 seconds by the objective,
+   and the cached value must be found for 10.2 seconds but not for 11.2
+   seconds, which is evaluated as 11 seconds.
+2. A BOBYQA search over start times with an objective that truncates the
+   start times must find some of its points in the cache, only the points
+   not found may be evaluated, and the value of the solution must be the
+   value of the objective for the start times of the solution.
+
+The test writes one line for each case and returns a non-zero exit status if
+any of the cases fails.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <string>                            // Case names
+#include <vector>                            // Start times
+#include <iostream>                          // Reporting the cases
+
+#include <boost/numeric/conversion/cast.hpp> // Converting the start times
+
+#include "Variables.hpp"                     // Optimization variables
+#include "NonLinear/EvaluationCache.hpp"     // The cache under test
+#include "NonLinear/Optimizer.hpp"           // The NLopt optimizers
+#include "NonLinear/LocalApproximation.hpp"  // BOBYQA
+
+#include "TimeInterval.hpp"                  // Time
+
+namespace NL = Optimization::NonLinear;
+
+// -----------------------------------------------------------------------------
+// Start time placement
+// -----------------------------------------------------------------------------
+//
+// The objective is the squared distance of the start times from their target
+// times after the start times have been converted to time as done by the
+// solver. The evaluations are counted so that they can be compared with the
+// misses of the cache.
+
+class StartTimePlacement
+: public NL::Optimizer< NL::Algorithm::Local::Approximation::Rescaling >
+{
+private:
+
+  const std::vector< CoSSMic::Time > Targets;
+
+public:
+
+  std::size_t Evaluations;
+
+  // The value of a set of start times is computed in the same way as the
+  // solver converts start times to time
+
+  double Value( const Optimization::Variables & StartTimes ) const
+  {
+    double Distance = 0.0;
+
+    for ( std::size_t i = 0; i < StartTimes.size(); i++ )
+    {
+      double Difference = static_cast< double >(
+        boost::numeric_cast< CoSSMic::Time >( StartTimes[i] ) - Targets[i] );
+
+      Distance += Difference * Difference;
+    }
+
+    return Distance;
+  }
+
+protected:
+
+  virtual Optimization::VariableType
+  ObjectiveFunction( const Optimization::Variables & StartTimes ) override
+  {
+    Evaluations++;
+    return Value( StartTimes );
+  }
+
+  virtual std::vector< Interval > BoundConstraints( void ) override
+  {
+    return std::vector< Interval >( Targets.size(), Interval( 0.0, 3600.0 ) );
+  }
+
+public:
+
+  StartTimePlacement( const std::vector< CoSSMic::Time > & TargetTimes )
+  : Objective(), Bound(), Optimizer(), Targets( TargetTimes ),
+    Evaluations(0)
+  {}
+
+  // The search is run with memoisation for whole seconds and a limit on the
+  // number of evaluations.
+
+  OptimalSolution Search( const Optimization::Variables & InitialStartTimes,
+                          int MaxEvaluations )
+  {
+    CreateSolver( InitialStartTimes.size(),
+                  Optimization::Objective::Goal::Minimize );
+    MaxNumberOfEvaluations( MaxEvaluations );
+    Memoise( 1.0 );
+
+    return FindSolution( InitialStartTimes );
+  }
+};
+
+// -----------------------------------------------------------------------------
+// Test cases
+// -----------------------------------------------------------------------------
+
+bool CacheCells( void )
+{
+  NL::EvaluationCache Cache( 1.0, 16 );
+  Optimization::Variables Evaluated{ 10.7 }, SameSecond{ 10.2 },
+                          NextSecond{ 11.2 };
+
+  Cache.Store( Optimization::VariableSpan( Evaluated ), 1.0 );
+
+  bool Found  = Cache.Find( Optimization::VariableSpan( SameSecond ) )
+                .has_value(),
+       Missed = !Cache.Find( Optimization::VariableSpan( NextSecond ) )
+                 .has_value();
+
+  if ( Found && Missed )
+  {
+    std::cout << "PASSED Cache cells: 10.2 s shares the cell of 10.7 s and "
+              << "11.2 s does not" << std::endl;
+    return true;
+  }
+
+  std::cout << "FAILED Cache cells: 10.2 s was "
+            << ( Found ? "found" : "not found" ) << " and 11.2 s was "
+            << ( Missed ? "not found" : "found" ) << std::endl;
+  return false;
+}
+
+bool MemoisedSearch( void )
+{
+  StartTimePlacement Placement( { 900, 1800, 2700 } );
+
+  auto Solution = Placement.Search( { 1200.0, 1200.0, 1200.0 }, 500 );
+  auto Memoised = Placement.MemoisationStatistics();
+
+  // The initial start times are evaluated directly by the optimizer before
+  // the search starts, and the other evaluations are the cache misses.
+
+  if ( !Memoised || ( Memoised->Hits == 0 ) ||
+       ( Placement.Evaluations != Memoised->Misses + 1 ) ||
+       ( Solution.ObjectiveValue != Placement.Value( Solution.VariableValues ) ) )
+  {
+    std::cout << "FAILED BOBYQA memoisation: ";
+
+    if ( Memoised )
+      std::cout << Memoised->Hits << " hits and " << Memoised->Misses
+                << " misses for " << Placement.Evaluations
+                << " evaluations and a solution value of "
+                << Solution.ObjectiveValue << std::endl;
+    else
+      std::cout << "The memoisation was not enabled" << std::endl;
+
+    return false;
+  }
+
+  std::cout << "PASSED BOBYQA memoisation: " << Memoised->Hits << " hits and "
+            << Memoised->Misses << " misses" << std::endl;
+  return true;
+}
+
+int main( int argc, char **argv )
+{
+  bool Passed = true;
+
+  Passed &= CacheCells();
+  Passed &= MemoisedSearch();
+
+  return Passed ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+/*==============================================================================
+Production samples test
+
+The energy objective interpolates the production between its samples, and it
+needs at least two samples to extend the time axis over the consumer start
+windows. This test checks that the solver constructors taking the production
+in memory reject a production with a single sample with an invalid argument
+exception before any consumer is created. The solver constructed from a file
+is not tested since its production is validated by the CSV parser.
+
+The test writes one line for each case and returns a non-zero exit status if
+any of the cases fails.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#include <string>                            // Case names
+#include <vector>                            // Production samples
+#include <functional>                        // The solver constructions
+#include <stdexcept>                         // Standard exceptions
+#include <iostream>                          // Reporting the cases
+
+#include "TimeSeries.hpp"                    // Production series
+#include "Solver.hpp"                        // The DOMINOES solver
+
+// A case constructs the solver and passes if this throws an invalid argument
+// exception.
+
+bool Rejected( const std::string & Case,
+               const std::function< void( void ) > & Construction )
+{
+  try
+  {
+    Construction();
+  }
+  catch ( std::invalid_argument & Error )
+  {
+    std::cout << "PASSED " << Case << ": " << Error.what() << std::endl;
+    return true;
+  }
+  catch ( std::exception & Error )
+  {
+    std::cout << "FAILED " << Case << ": Unexpected exception "
+              << Error.what() << std::endl;
+    return false;
+  }
+
+  std::cout << "FAILED " << Case << ": The production was accepted"
+            << std::endl;
+  return false;
+}
+
+int main( int argc, char **argv )
+{
+  bool Passed = true;
+
+  // The production series has one sample, and the consumer events file is
+  // never read since the production is rejected first.
+
+  CoSSMic::TimeSeries OneSample;
+
+  OneSample.Append( 1546300800, 0.0 );
+
+  Passed &= Rejected( "Time series with one sample", [&](){
+    Dominoes::Solver TheSolver( OneSample, "/dev/null" );
+  });
+
+  Passed &= Rejected( "In-memory production with one sample", [&](){
+    Dominoes::Solver TheSolver( std::vector< CoSSMic::Time >{ 1546300800 },
+                                std::vector< double >{ 0.0 },
+                                std::vector< Dominoes::Solver::ConsumerEvent >() );
+  });
+
+  Passed &= Rejected( "Empty time series", [&](){
+    Dominoes::Solver TheSolver( CoSSMic::TimeSeries(), "/dev/null" );
+  });
+
+  return Passed ? 0 : 1;
+}
@@ -34,6 +34,12 @@ summary can be obtained from using 'Simulator --help'. An example could be
 Simulator --ProductionFile PV.csv --Consumers ConsumerEvents.csv
           --Directory ./Data --AssignedTimes Results.csv
 
+Alternatively, the simulator can be started as a daemon with 'Simulator
+--Daemon --Directory ./Data' and it will then read scenario requests from the
+standard input as described in the Daemon header. Many scenarios can also be
+solved in one process by 'Simulator --Batch Manifest.csv --Directory ./Data'
+where the manifest is described in the Batch header.
+
 where the production file gives the cumulative production in absolute time:
 <POSIX seconds>, <cummulative energy produced>
 and the consumer event file has lines of the following format:
@@ -58,8 +64,16 @@ License: LGPL 3.0
 
 #include "CommandOptions.hpp"    // The command line options
 #include "Solver.hpp"            // The Solver (keeps the Consumers)
+#include "Daemon.hpp"            // Serving scenario requests
+#include "Batch.hpp"             // Solving many scenarios
+#include "ResultCache.hpp"       // Results of identical scenarios
+#include "ProfilePack.hpp"       // Appliance profiles referenced by name
+
+#include "MemoryAccounting.hpp"  // Memory by subsystem
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 
 int main( int argc, char **argv )
 {
@@ -67,13 +81,137 @@ int main( int argc, char **argv )
 
   Dominoes::CommandLineOptions Options( argc, argv );
 
-  // Starting the solver that starts the consumers
+  // The memory is accounted by subsystem when the metrics are reported, and
+  // the accounting must be enabled before the accounted objects are created.
+
+  if ( Options.MetricsReport() || ( Options.MetricsPort() > 0 ) )
+    Theron::MemoryAccounting::Enable();
+
+  // The execution mode of the actors must be set before the first actor is
+  // created.
+
+  if ( Options.ActorPool() )
+    Theron::Actor::SetExecutionMode( Theron::Actor::ExecutionMode::ThreadPool,
+                                     Options.ActorPoolWorkers() );
+
+  // The profile pack is mapped once and shared by the scenarios of all the
+  // modes.
+
+  if ( !Options.ProfilePackFile().empty() )
+    Dominoes::ProfilePack::Load( Options.ProfilePackFile() );
+
+  // The deadline is counted from the start of the program so that it also
+  // covers the time used to create the consumers and load their profiles.
+
+  const auto Deadline = Dominoes::Anytime::Clock::now()
+                        + Options.SolutionDeadline();
+
+  // In batch mode all the scenarios of the manifest are solved, and the
+  // simulator fails if one of the scenarios failed.
+
+  if ( Options.BatchMode() )
+  {
+    Dominoes::Batch Scenarios( Options.ManifestFile(), Options );
+
+    if ( Scenarios.Run() == 0 )
+      return EXIT_SUCCESS;
+    else
+      return EXIT_FAILURE;
+  }
+
+  // In daemon mode the scenarios are served until the daemon is asked to
+  // quit.
+
+  if ( Options.DaemonMode() )
+  {
+    Dominoes::Daemon Server( Options );
+
+    if ( Options.DaemonSocket().empty() )
+      Server.Run();
+    else
+      Server.Run( Options.DaemonSocket() );
+
+    return EXIT_SUCCESS;
+  }
+
+  // The solver is started by a function that starts the consumers and finds
+  // the solution. It is called directly unless the result cache is used in
+  // which case it is only called if the scenario has not been solved before,
+  // possibly starting from the start times of a nearby scenario.
+
+  auto SolveScenario = [&](
+       const std::optional< std::vector< CoSSMic::Time > > & NearbyStart ){
+    Dominoes::Solver Solver( Options.ProductionFile(), Options.ConsumersFile(),
+                             Options.EvaluationEngine(), Options.ProfileStep() );
+
+    Solver.MultiStart( Options.NumberOfStarts(), Options.NumberOfThreads(),
+                       Options.SearchBudget() );
+    Solver.GridEnergyInterpolation( Options.GridEnergyInterpolation() );
+    Solver.Decomposition( Options.Decomposition() );
+    Solver.WarmStart( Options.WarmStart() );
+    Solver.RacingPortfolio( Options.RacingPortfolio() );
+    Solver.GradientBased( Options.GradientBased() );
+    Solver.MultiResolution( Options.MultiResolution() );
+    Solver.Screening( Options.Screening() );
+
+    if ( Options.Memoisation() )
+      Solver.Memoise( *Options.Memoisation(), Solver.DefaultMemoCapacity,
+                      Theron::MemoryAccounting::Resource( "Optimizer" ) );
+    if ( !Options.TraceFile().empty() )
+      Solver.TraceEvaluations();
+    Solver.Instrument( Options.MetricsReport() );
+
+    if ( NearbyStart )
+      Solver.StartFrom( *NearbyStart );
+
+    if ( Options.SolutionDeadline() > std::chrono::milliseconds::zero() )
+      Solver.SolutionDeadline( Deadline );
+
+    if ( !Options.CaptureFile().empty() )
+    {
+      std::ofstream Capture( Options.CaptureFile() );
+
+      Solver.CaptureProblem( Capture );
+    }
+
+    std::ostringstream Result;
+
+    Solver.AssignStartTimes( Result, Options.DayDuration() );
+
+    if ( Options.MetricsReport() )
+    {
+      std::ofstream Report( Dominoes::Instrumentation::ReportFile(
+                            Options.ResultFile() ) );
+
+      Solver.WriteMetrics( Report );
+    }
+
+    if ( auto Trace = Solver.GetTrace() )
+    {
+      std::ofstream TraceReport( Options.TraceFile() );
+
+      if ( Options.TraceFile().extension() == ".json" )
+        Trace->WriteJSON( TraceReport );
+      else
+        Trace->WriteCSV( TraceReport );
+    }
 
-  Dominoes::Solver Solver( Options.ProductionFile(), Options.ConsumersFile() );
+    return Result.str();
+  };
 
   // Finding a solution
 
-  Solver.AssignStartTimes( Options.ResultFile(), Options.DayDuration() );
+  Dominoes::ResultCache Cache( Options.CacheEntries(),
+                               Options.CacheDirectory() );
+
+  if ( Cache.IsEnabled() )
+    std::ofstream( Options.ResultFile() ) << Cache.Solve(
+      Dominoes::ResultCache::ScenarioKey( Options.ProductionFile(),
+        Options.ConsumersFile(), Options.ProfileStep(),
+        Options.GridEnergyInterpolation(), Options.DayDuration() ),
+      SolveScenario ).first;
+  else
+    std::ofstream( Options.ResultFile() ) << SolveScenario( std::nullopt );
 
   // There is always a happy ending
 
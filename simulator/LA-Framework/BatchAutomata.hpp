@@ -0,0 +1,694 @@
+/*=============================================================================
+  Batch Automata
+
+  The automata of the framework are objects with their own probability vector,
+  estimators and environment, and the learning happens through the virtual
+  select action and feedback functions. This is flexible, but a simulation
+  with thousands of agents each owning a small automaton will spend most of its
+  time chasing pointers between small objects on the heap.
+
+  The batch automata keeps all automata of the same learning algorithm in a
+  structure of arrays: The action probabilities of all automata are rows of
+  one contiguous matrix, and the same goes for the estimator values of the
+  pursuit automata. An agent holds only the index of its automaton in the
+  batch. The rows are padded to a multiple of the cache line so that each row
+  starts at an aligned position, and the updates are loops over the row
+  written without branches so that the compiler can vectorise them, see the
+  BatteryBank of the CoSSMic simulator for the same technique.
+
+  The learning algorithm is given as a policy class defining the parameters of
+  the algorithm and a static update function taking a pointer to the row of
+  probabilities to update. Four policies are provided corresponding to the
+  automata in the LinearLA, PursuitAutomata and EstimatorAutomata headers:
+
+  LinearRI: The linear reward-inaction automaton. The response is assumed to
+    be normalised to [0,1] as for the S-model, and a P-model reward is unity
+    and a penalty is zero. With the learning constant lambda, where a value
+    close to unity means slow learning as in the rest of the framework, the
+    update is the S-model update of Viswanathan and Narendra:
+      p(i) = (1 - (1-lambda) b) p(i) + (1-lambda) b [i = a]
+    for the response b and the chosen action a.
+
+  LinearRP: The linear reward-penalty automaton, where the update is a convex
+    combination b T_RI(p) + (1-b) T_IP(p) of the reward and penalty updates.
+    This is exactly the P-model L_RP for the responses zero and unity.
+
+  Both linear policies use the fixed linear update schemes of the LinearLA
+  header on the row of the automaton.
+
+  ContinuousPursuitRP: The pursuit automaton using the maximum likelihood
+    reward estimates kept as batch estimates, see below. All probabilities
+    are discounted by (1-lambda) and lambda is added to the probability of
+    the action with the largest reward estimate.
+
+  GTSE: The generalised Thathachar-Sastry estimator automaton with the
+    identity distance function and equal weights, which are the defaults of
+    the GTSE automaton. It uses the maximum likelihood reward estimates of
+    all actions in the row of estimates of the automaton. The probability of
+    an action with a larger estimate than the chosen action is increased in
+    proportion to the difference of the estimates, and the probability of an
+    action with a smaller estimate is decreased in the same way. The chosen
+    action takes the difference so that the row stays normalised.
+
+  Author: Geir Horn, University of Oslo, 2019
+  Contact: Geir.Horn [at] mn.uio.no
+  License: LGPL3.0
+=============================================================================*/
+
+#ifndef LA_BATCH_AUTOMATA
+#define LA_BATCH_AUTOMATA
+
+#include <vector>							// The probability matrix
+#include <algorithm>					// Max element and fill
+#include <random>							// Uniform distribution
+#include <sstream>						// Error messages
+#include <stdexcept>					// Standard exceptions
+#include <stddef.h>						// For size_t
+
+#include "LearningEnvironment.hpp"	// Action indices
+#include "LinearLA.hpp"							// Fixed linear updates
+#include "RandomGenerator.hpp"			// Random numbers
+
+namespace LA
+{
+/*==============================================================================
+
+ Policies
+
+==============================================================================*/
+//
+// The policies are classes with a parameter structure, a flag telling if the
+// reward estimates should be maintained, and the update function taking the
+// row of action probabilities, the number of actions, the chosen action, the
+// response, the row of reward estimates and the action with the best reward
+// estimate. The estimates are only given to the policies using them, and the
+// row pointer is otherwise null.
+
+namespace BatchPolicy
+{
+
+class LinearRI
+{
+public:
+
+	static constexpr bool UsesEstimates = false;
+
+	class Parameters
+	{
+	public:
+
+		double RewardConstant;
+	};
+
+	// The penalty constant is not used by the reward-inaction scheme
+
+	static inline void Update( double * Probabilities, size_t Actions,
+														 ActionIndex Chosen, double Response,
+														 const double *, ActionIndex,
+														 const Parameters & Constants )
+	{
+		LinearUpdate< Model::S, LinearScheme::RewardInaction >::Apply(
+			Probabilities, Actions, Chosen, Response,
+			Constants.RewardConstant, Constants.RewardConstant );
+	}
+};
+
+class LinearRP
+{
+public:
+
+	static constexpr bool UsesEstimates = false;
+
+	class Parameters
+	{
+	public:
+
+		double RewardConstant, PenaltyConstant;
+	};
+
+	static inline void Update( double * Probabilities, size_t Actions,
+														 ActionIndex Chosen, double Response,
+														 const double *, ActionIndex,
+														 const Parameters & Constants )
+	{
+		LinearUpdate< Model::S, LinearScheme::RewardPenalty >::Apply(
+			Probabilities, Actions, Chosen, Response,
+			Constants.RewardConstant, Constants.PenaltyConstant );
+	}
+};
+
+class ContinuousPursuitRP
+{
+public:
+
+	static constexpr bool UsesEstimates = true;
+
+	class Parameters
+	{
+	public:
+
+		double LearningConstant;
+	};
+
+	static inline void Update( double * Probabilities, size_t Actions,
+														 ActionIndex, double, const double *,
+														 ActionIndex BestAction,
+														 const Parameters & Constants )
+	{
+		const double Scale = 1.0 - Constants.LearningConstant;
+
+		#pragma omp simd
+		for ( size_t i = 0; i < Actions; i++ )
+			Probabilities[i] *= Scale;
+
+		Probabilities[ BestAction ] += Constants.LearningConstant;
+	}
+};
+
+// The GTSE update is written without branches by using the indicator of the
+// actions with a larger estimate than the chosen action as a weight. The
+// number of these actions is counted first since their weights are equal
+// and sum to unity. The update of the chosen action is zero in the loop since
+// its estimate difference is zero, and it is given the sum of the updates of
+// the other actions afterwards.
+
+class GTSE
+{
+public:
+
+	static constexpr bool UsesEstimates = true;
+
+	class Parameters
+	{
+	public:
+
+		double LearningConstant;
+	};
+
+	static inline void Update( double * Probabilities, size_t Actions,
+														 ActionIndex Chosen, double,
+														 const double * Estimates, ActionIndex,
+														 const Parameters & Constants )
+	{
+		const double ChosenEstimate 	 = Estimates[ Chosen ],
+								 ChosenProbability = Probabilities[ Chosen ];
+
+		double Larger = 0.0;
+
+		#pragma omp simd reduction(+:Larger)
+		for ( size_t i = 0; i < Actions; i++ )
+			Larger += ( Estimates[i] > ChosenEstimate ) ? 1.0 : 0.0;
+
+		const double Share = ( Larger > 0.0 ) ? ChosenProbability / Larger : 0.0;
+		double Moved = 0.0;
+
+		#pragma omp simd reduction(+:Moved)
+		for ( size_t i = 0; i < Actions; i++ )
+		{
+			const double Indicator = ( Estimates[i] > ChosenEstimate ) ? 1.0 : 0.0,
+									 Update 	 = Constants.LearningConstant *
+															 ( ChosenEstimate - Estimates[i] ) *
+															 ( Indicator * Share * ( 1.0 - Probabilities[i] )
+															   + ( 1.0 - Indicator ) * Probabilities[i] );
+
+			Probabilities[i] -= Update;
+			Moved 					 += Update;
+		}
+
+		Probabilities[ Chosen ] += Moved;
+	}
+};
+
+}	// Name space Batch Policy
+
+/*==============================================================================
+
+ Batch estimators
+
+==============================================================================*/
+//
+// The reward estimators of the estimator and pursuit automata keep one
+// estimate per action, and the best estimated action is found by scanning all
+// estimates after each update. The batch estimators keep the estimates of all
+// automata as rows of one matrix, together with the number of times each
+// action has been tried and the sum of its rewards, and the best action of
+// each automaton is maintained as the estimates are updated. A scan of the
+// row is only needed when the estimate of the best action decreases.
+//
+// The maximum likelihood estimator is the sum of the rewards divided by the
+// number of trials. It is computed from the sum and not as a running mean
+// since the rounding of the running mean may break ties between estimates
+// that are equal for the MLE of the RewardEstimators header, and the GTSE
+// update depends on these ties. The other estimators update the estimate
+// towards the received reward r with a gain g
+//
+//   E(a) = E(a) + g * ( r - E(a) )
+//
+// where the exponentially weighted moving average has a constant gain equal
+// to the oblivion factor, and the Huber oblivion reduces the gain for large
+// errors. These correspond to the EWMA with the constant and Huber oblivion
+// factors in the RewardEstimators header.
+
+namespace BatchEstimator
+{
+
+class MLE
+{
+public:
+
+	class Parameters
+	{ };
+
+	static inline double Estimate( double, double, double Trials,
+																 double RewardSum, const Parameters & )
+	{ return RewardSum / Trials; }
+};
+
+class EWMA
+{
+public:
+
+	class Parameters
+	{
+	public:
+
+		double OblivionFactor;
+	};
+
+	static inline double Estimate( double OldEstimate, double Reward, double,
+																 double, const Parameters & Constants )
+	{ return OldEstimate + Constants.OblivionFactor * ( Reward - OldEstimate ); }
+};
+
+class HuberEWMA
+{
+public:
+
+	class Parameters
+	{
+	public:
+
+		double OblivionFactor, MaxError;
+	};
+
+	static inline double Estimate( double OldEstimate, double Reward, double,
+																 double, const Parameters & Constants )
+	{
+		const double Error = Reward - OldEstimate,
+								 Limit = ( 1.0 - Constants.OblivionFactor ) *
+												 Constants.MaxError;
+
+		if ( Error < -Constants.MaxError )
+			return OldEstimate + Error + Limit;
+		else if ( Error > Constants.MaxError )
+			return OldEstimate + Error - Limit;
+		else
+			return OldEstimate + Constants.OblivionFactor * Error;
+	}
+};
+
+}	// Name space Batch Estimator
+
+template< class Estimator >
+class BatchEstimates
+{
+public:
+
+	using Parameters 		 = typename Estimator::Parameters;
+	using AutomatonIndex = size_t;
+
+private:
+
+	size_t 		 NumberOfActions, Stride;
+	Parameters Constants;
+
+	std::vector< double > 		 Estimates, Trials, RewardSums;
+	std::vector< ActionIndex > BestActions;
+
+	// The best action is the first action with the largest estimate, and the
+	// first action is taken if all estimates are zero or negative. This is the
+	// same as the best estimated action of the reward estimators.
+
+	void FindBestAction( AutomatonIndex Automaton )
+	{
+		const double * Estimate = Estimates.data() + Automaton * Stride;
+		ActionIndex BestAction = 0;
+
+		for ( ActionIndex i = 1; i < NumberOfActions; i++ )
+			if ( Estimate[i] > Estimate[ BestAction ] ) BestAction = i;
+
+		BestActions[ Automaton ] = BestAction;
+	}
+
+	// After an update of one action, the best action changes to this action if
+	// its estimate is larger than the best estimate, or equal to it for a
+	// lower action index. If the estimate of the best action decreased, another
+	// action may now be the best and the row must be scanned.
+
+	inline void TrackBestAction( AutomatonIndex Automaton, ActionIndex Action,
+															 double OldEstimate )
+	{
+		const double * Estimate = Estimates.data() + Automaton * Stride;
+		ActionIndex & BestAction = BestActions[ Automaton ];
+
+		if ( Action == BestAction )
+		{
+			if ( Estimate[ Action ] < OldEstimate ) FindBestAction( Automaton );
+		}
+		else if ( ( Estimate[ Action ] > Estimate[ BestAction ] ) ||
+							( ( Estimate[ Action ] == Estimate[ BestAction ] ) &&
+								( Action < BestAction ) ) )
+			BestAction = Action;
+	}
+
+public:
+
+	// Rows are added with zero estimates and no trials
+
+	AutomatonIndex Add( void )
+	{
+		Estimates.resize( Estimates.size() + Stride, 0.0 );
+		Trials.resize( Estimates.size(), 0.0 );
+		RewardSums.resize( Estimates.size(), 0.0 );
+		BestActions.push_back( 0 );
+
+		return BestActions.size() - 1;
+	}
+
+	inline size_t Size( void ) const
+	{ return BestActions.size(); }
+
+	inline double RewardEstimate( AutomatonIndex Automaton,
+																ActionIndex Action ) const
+	{ return Estimates[ Automaton * Stride + Action ]; }
+
+	inline ActionIndex BestEstimatedAction( AutomatonIndex Automaton ) const
+	{ return BestActions[ Automaton ]; }
+
+	inline const double * Row( AutomatonIndex Automaton ) const
+	{ return Estimates.data() + Automaton * Stride; }
+
+	// Updating the estimate of one automaton
+
+	inline void Update( AutomatonIndex Automaton, ActionIndex Action,
+											double Reward )
+	{
+		const size_t Index = Automaton * Stride + Action;
+		const double OldEstimate = Estimates[ Index ];
+
+		Trials[ Index ] 		+= 1.0;
+		RewardSums[ Index ] += Reward;
+		Estimates[ Index ] 	 = Estimator::Estimate( OldEstimate, Reward,
+							 Trials[ Index ], RewardSums[ Index ], Constants );
+
+		TrackBestAction( Automaton, Action, OldEstimate );
+	}
+
+	// When all automata receive feedback at the same time, for instance when
+	// the rewards of an epoch are distributed, the actions and rewards are
+	// given as vectors with one element for each automaton. The estimates are
+	// first updated in one loop without branches, remembering the old
+	// estimates, and then the best actions are maintained.
+
+	void UpdateAll( const std::vector< ActionIndex > & Actions,
+									const std::vector< double > & Rewards )
+	{
+		if ( ( Actions.size() != Size() ) || ( Rewards.size() != Size() ) )
+		{
+			std::ostringstream ErrorMessage;
+
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "Updating " << Size() << " estimators needs as many "
+									 << "actions (" << Actions.size() << ") and rewards ("
+									 << Rewards.size() << ")";
+
+			throw std::invalid_argument( ErrorMessage.str() );
+		}
+
+		OldEstimates.resize( Size() );
+
+		const size_t N = Size();
+		double * Estimate = Estimates.data(),
+					 * Trial 	  = Trials.data(),
+					 * Sum 		  = RewardSums.data(),
+					 * Old 		  = OldEstimates.data();
+		const ActionIndex * Action = Actions.data();
+		const double 			* Reward = Rewards.data();
+
+		#pragma omp simd
+		for ( size_t k = 0; k < N; k++ )
+		{
+			const size_t Index = k * Stride + Action[k];
+
+			Old[k] 					 = Estimate[ Index ];
+			Trial[ Index ] 	+= 1.0;
+			Sum[ Index ] 		+= Reward[k];
+			Estimate[ Index ] = Estimator::Estimate( Old[k], Reward[k], Trial[ Index ],
+																							 Sum[ Index ], Constants );
+		}
+
+		for ( size_t k = 0; k < N; k++ )
+			TrackBestAction( k, Action[k], Old[k] );
+	}
+
+private:
+
+	// The old estimates are kept for the batch update to avoid allocating
+	// memory for every update.
+
+	std::vector< double > OldEstimates;
+
+public:
+
+	// The constructor takes the number of actions and the row stride, which
+	// is the number of actions if the estimates are used alone.
+
+	BatchEstimates( size_t ActionsPerAutomaton, const Parameters & TheConstants,
+									size_t RowStride = 0 )
+	: NumberOfActions( ActionsPerAutomaton ),
+	  Stride( std::max( RowStride, ActionsPerAutomaton ) ),
+	  Constants( TheConstants ),
+	  Estimates(), Trials(), RewardSums(), BestActions(), OldEstimates()
+	{ }
+
+	BatchEstimates( void ) = delete;
+};
+
+/*==============================================================================
+
+ Batch automata
+
+==============================================================================*/
+//
+// All automata in a batch have the same number of actions and the same
+// parameters.
+
+template< class Policy >
+class BatchAutomata
+{
+public:
+
+	using Parameters 		= typename Policy::Parameters;
+	using AutomatonIndex = size_t;
+
+	// The feedback for many automata is given as a vector of responses, each
+	// identifying the automaton, the action it selected and the normalised
+	// response for this action.
+
+	class Response
+	{
+	public:
+
+		AutomatonIndex Automaton;
+		ActionIndex		 ChosenAction;
+		double 				 Feedback;
+	};
+
+private:
+
+	// The rows are padded to a multiple of eight doubles, which is the length
+	// of a cache line on most processors.
+
+	static constexpr size_t Padding = 8;
+
+	const size_t 		 NumberOfActions, Stride;
+	const Parameters Constants;
+
+	// The probability matrix has one row per automaton, and the estimator
+	// automata keep the maximum likelihood reward estimates of each action
+	// with rows of the same layout.
+
+	std::vector< double > 						 Probabilities;
+	BatchEstimates< BatchEstimator::MLE > Estimates;
+
+	// Utility functions to access the rows
+
+	inline double * Row( AutomatonIndex Automaton )
+	{ return Probabilities.data() + Automaton * Stride; }
+
+	inline const double * Row( AutomatonIndex Automaton ) const
+	{ return Probabilities.data() + Automaton * Stride; }
+
+	inline void CheckIndex( AutomatonIndex Automaton, ActionIndex Action ) const
+	{
+		if ( ( Automaton >= Size() ) || ( Action >= NumberOfActions ) )
+		{
+			std::ostringstream ErrorMessage;
+
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "Automaton " << Automaton << " of " << Size()
+									 << " or action " << Action << " of " << NumberOfActions
+									 << " is not in the batch";
+
+			throw std::out_of_range( ErrorMessage.str() );
+		}
+	}
+
+public:
+
+	// ---------------------------------------------------------------------------
+	// Automata
+	// ---------------------------------------------------------------------------
+	//
+	// A new automaton is added with uniform action probabilities, and its index
+	// in the batch is returned.
+
+	AutomatonIndex Add( void )
+	{
+		Probabilities.resize( Probabilities.size() + Stride, 0.0 );
+		std::fill_n( Row( Size() - 1 ), NumberOfActions,
+								 1.0 / static_cast< double >( NumberOfActions ) );
+
+		if constexpr ( Policy::UsesEstimates )
+			Estimates.Add();
+
+		return Size() - 1;
+	}
+
+	inline size_t Size( void ) const
+	{ return Probabilities.size() / Stride; }
+
+	inline size_t Actions( void ) const
+	{ return NumberOfActions; }
+
+	inline double ActionProbability( AutomatonIndex Automaton,
+																	 ActionIndex Action ) const
+	{
+		CheckIndex( Automaton, Action );
+		return Row( Automaton )[ Action ];
+	}
+
+	// ---------------------------------------------------------------------------
+	// Learning
+	// ---------------------------------------------------------------------------
+	//
+	// An action is selected by comparing a uniform random number with the
+	// cumulative probabilities of the row. The last action is returned if the
+	// rounding errors make the row sum slightly less than the random number.
+
+	ActionIndex SelectAction( AutomatonIndex Automaton ) const
+	{
+		CheckIndex( Automaton, 0 );
+
+		std::uniform_real_distribution< double > Uniform( 0.0, 1.0 );
+		const double * Probability = Row( Automaton );
+		double U = Random::Generator( Uniform );
+
+		for ( ActionIndex i = 0; i < NumberOfActions - 1; i++ )
+			if ( U < Probability[i] ) return i;
+			else U -= Probability[i];
+
+		return NumberOfActions - 1;
+	}
+
+	// Selecting actions for all automata in the batch fills the given vector
+	// with one action per automaton.
+
+	void SelectActions( std::vector< ActionIndex > & SelectedActions ) const
+	{
+		SelectedActions.resize( Size() );
+
+		for ( AutomatonIndex Automaton = 0; Automaton < Size(); Automaton++ )
+			SelectedActions[ Automaton ] = SelectAction( Automaton );
+	}
+
+	// The feedback to one automaton updates the estimates if the policy uses
+	// them, and then the action probabilities of that row.
+
+	void Feedback( AutomatonIndex Automaton, ActionIndex ChosenAction,
+								 double Response )
+	{
+		CheckIndex( Automaton, ChosenAction );
+
+		const double * RewardEstimates = nullptr;
+		ActionIndex 	 BestAction 		 = 0;
+
+		if constexpr ( Policy::UsesEstimates )
+		{
+			Estimates.Update( Automaton, ChosenAction, Response );
+			RewardEstimates = Estimates.Row( Automaton );
+			BestAction 			= Estimates.BestEstimatedAction( Automaton );
+		}
+
+		Policy::Update( Row( Automaton ), NumberOfActions, ChosenAction, Response,
+										RewardEstimates, BestAction, Constants );
+	}
+
+	// The reward estimate of an action is zero if the policy does not use the
+	// estimates.
+
+	inline double RewardEstimate( AutomatonIndex Automaton,
+																ActionIndex Action ) const
+	{
+		CheckIndex( Automaton, Action );
+
+		if constexpr ( Policy::UsesEstimates )
+			return Estimates.RewardEstimate( Automaton, Action );
+		else
+			return 0.0;
+	}
+
+	// The feedback to many automata is just the feedback to each of them, and
+	// the rows of the automata are updated in the order of the responses.
+
+	void Feedback( const std::vector< Response > & Responses )
+	{
+		for ( const Response & TheResponse : Responses )
+			Feedback( TheResponse.Automaton, TheResponse.ChosenAction,
+								TheResponse.Feedback );
+	}
+
+	// ---------------------------------------------------------------------------
+	// Constructor
+	// ---------------------------------------------------------------------------
+	//
+	// The constructor takes the number of actions of all automata, the
+	// parameters of the policy, and the number of automata to reserve space
+	// for. There must be at least two actions for the automata to learn.
+
+	BatchAutomata( size_t ActionsPerAutomaton, const Parameters & TheConstants,
+								 size_t ExpectedAutomata = 0 )
+	: NumberOfActions( ActionsPerAutomaton ),
+	  Stride( ( ActionsPerAutomaton + Padding - 1 ) / Padding * Padding ),
+	  Constants( TheConstants ),
+	  Probabilities(), Estimates( ActionsPerAutomaton, {}, Stride )
+	{
+		if ( NumberOfActions < 2 )
+		{
+			std::ostringstream ErrorMessage;
+
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "Batch automata needs at least two actions, and "
+									 << NumberOfActions << " were given";
+
+			throw std::invalid_argument( ErrorMessage.str() );
+		}
+
+		Probabilities.reserve( ExpectedAutomata * Stride );
+	}
+
+	BatchAutomata( void ) = delete;
+};
+
+}      // Name space LA
+#endif // LA_BATCH_AUTOMATA
@@ -22,6 +22,9 @@
 // Author: Geir Horn, 2011-2014
 // Lisence: LGPL 3.0
 // Geir Horn, 2017: Deprecated by the Random::Index function
+// Geir Horn, 2019: Repeated draws from the same weights should use the 
+//                  Random::AliasTable, or the Random::CumulativeTable if 
+//                  the weights are updated between the draws
 //
 // ****************************************************************************
 
@@ -150,6 +150,104 @@ public:
 	{ }
 };
 
+/*****************************************************************************
+ Action probabilities
+
+ The variable structure automata select actions according to a vector of 
+ action probabilities. Building the discrete distribution for each selected 
+ action is linear in the number of actions, and an automaton with many actions
+ will select many actions between changes of the probabilities, for instance
+ when it is penalised or when the feedback is delayed. The actions are 
+ therefore drawn from an alias table [Random::AliasTable] giving an action in
+ constant time, and the table needs only to be rebuilt when the probabilities
+ have changed. 
+ 
+ The probability vector is a standard vector of doubles that remembers if it
+ has been given out for modification. The learning algorithms of the derived
+ classes change the probabilities element by element through the index 
+ operator or by iterators, and all the non-constant accessors will therefore
+ mark the vector as changed. Reading the probabilities through a constant 
+ reference leaves the vector unchanged.
+ 
+*******************************************************************************/
+
+class ActionProbabilityVector : public std::vector< double >
+{
+private:
+	
+	using BaseVector = std::vector< double >;
+	
+	bool Modified = true;
+	
+public:
+	
+	inline bool Changed( void ) const
+	{ return Modified; }
+	
+	inline void ResetChanged( void )
+	{ Modified = false; }
+	
+	// The non-constant accessors are redefined to set the flag and then 
+	// forward to the standard vector. 
+	
+	inline double & operator[] ( BaseVector::size_type Index )
+	{ 
+		Modified = true;
+		return BaseVector::operator[]( Index );
+	}
+	
+	inline const double & operator[] ( BaseVector::size_type Index ) const
+	{ return BaseVector::operator[]( Index ); }
+	
+	inline double & at( BaseVector::size_type Index )
+	{
+		Modified = true;
+		return BaseVector::at( Index );
+	}
+	
+	inline const double & at( BaseVector::size_type Index ) const
+	{ return BaseVector::at( Index ); }
+	
+	inline BaseVector::iterator begin( void )
+	{
+		Modified = true;
+		return BaseVector::begin();
+	}
+	
+	inline BaseVector::const_iterator begin( void ) const
+	{ return BaseVector::begin(); }
+	
+	inline BaseVector::iterator end( void )
+	{
+		Modified = true;
+		return BaseVector::end();
+	}
+	
+	inline BaseVector::const_iterator end( void ) const
+	{ return BaseVector::end(); }
+	
+	inline double * data( void )
+	{
+		Modified = true;
+		return BaseVector::data();
+	}
+	
+	inline const double * data( void ) const
+	{ return BaseVector::data(); }
+	
+	template< class... Arguments >
+	inline void assign( Arguments && ...Values )
+	{
+		Modified = true;
+		BaseVector::assign( std::forward< Arguments >( Values )... );
+	}
+	
+	// The constructors are those of the standard vector, and a newly 
+	// constructed vector is always changed.
+	
+	using BaseVector::BaseVector;
+};
+
 /*****************************************************************************
  The Variable Structure Stochastic Automaton (VSSA)
  
@@ -183,7 +281,13 @@ protected:
   // unity). This is impractical when a learning algorithm may need to iterate
   // over the probabilities and changing them one after the other.
   
-  std::vector < double > ActionProbabilities;
+  ActionProbabilityVector ActionProbabilities;
+	
+	// The alias table used to draw the actions is rebuilt from the action 
+	// probabilities when they have been changed since the previous action 
+	// selection.
+	
+	Random::AliasTable ActionSampler;
 	
 	// The action generating function of the Learning Automata is reused here
 	
@@ -218,14 +322,23 @@ public:
   // necessary to overload this function for derived classes.
   //  
   // The price paid for the having the action probabilities as a plain 
-  // vector of doubles is that it must be converted to a probability mass 
-  // before the random index method can be used. This because the selection 
-  // is made according to the empirical density function, and it is mandatory 
-  // that this is a proper probability mass.
+  // vector of doubles is that they may not be properly normalised after an 
+  // update. The alias table is therefore built from the probabilities divided
+  // by their sum, which is the empirical density function. The table is only
+  // rebuilt if the probabilities have been changed, and the probabilities are
+  // read through a constant reference so that they stay unchanged.
 
   virtual typename Environment::Action SelectAction (void) override
   {
-    return Action( Random::Index( EmpiricalPDF( ActionProbabilities ) ) );
+		if ( ActionProbabilities.Changed() )
+		{
+			const ActionProbabilityVector & Probabilities( ActionProbabilities );
+			
+			ActionSampler.Rebuild( Probabilities.begin(), Probabilities.end() );
+			ActionProbabilities.ResetChanged();
+		}
+		
+    return Action( ActionSampler() );
 	} 
 
   // There is a function to initialise the probabilities with a probability 
@@ -236,9 +349,9 @@ public:
   // The size of the probability mass must match the number of actions, since 
   // the number of actions must correspond with the the environment.
 
-  template< typename RealType, class Allocator >
+  template< typename RealType >
   void InitialiseProbabilities( 
-       const ProbabilityMass< RealType, Allocator > & NewProbabilities )
+       const ProbabilityMass< RealType > & NewProbabilities )
   {
 		if ( NewProbabilities.size() == NumberOfActions )
 	    ActionProbabilities.assign( NewProbabilities.cbegin(), 
@@ -275,9 +388,9 @@ public:
   
   std::pair< ActionIndex, double > BestAction (void)
   {
-		auto MaxElement = std::max_element( ActionProbabilities.begin(), 
-																				ActionProbabilities.end() );
-    return { std::distance( ActionProbabilities.begin(), MaxElement ), 
+		auto MaxElement = std::max_element( ActionProbabilities.cbegin(), 
+																				ActionProbabilities.cend() );
+    return { std::distance( ActionProbabilities.cbegin(), MaxElement ), 
 						 *MaxElement };
   };
   
@@ -296,17 +409,19 @@ public:
   VSSA ( const Environment & TheEnvironment )
   : LearningAutomata< Environment >( TheEnvironment ),
     ActionProbabilities( NumberOfActions, 
-												 1.0/static_cast<double>( NumberOfActions )  )
+												 1.0/static_cast<double>( NumberOfActions )  ),
+    ActionSampler()
   {  };
   
   // There is also a constructor that takes an initial probability vector and 
   // uses this to initialise the action probabilities
 
-  template< typename RealType, class Allocator >
+  template< typename RealType >
   VSSA( const Environment & TheEnvironment,
-		    const ProbabilityMass<RealType, Allocator> & GivenProbabilities )
+		    const ProbabilityMass<RealType> & GivenProbabilities )
   : LearningAutomata< Environment >( TheEnvironment ),
-    ActionProbabilities(GivenProbabilities.cbegin(), GivenProbabilities.cend())
+    ActionProbabilities(GivenProbabilities.cbegin(), GivenProbabilities.cend()),
+    ActionSampler()
   { }
   
   // There is no standard constructor because it does not make sense to 
@@ -508,6 +508,12 @@ private:
 	
 	std::vector< ProbabilityMass< double > > SelectionPDF;
 	
+	// The selection probabilities do not change, and an alias table is built 
+	// for each action when the environment is constructed so that the response
+	// index can be drawn in constant time.
+	
+	std::vector< Random::AliasTable > ResponseSampler;
+	
 	// There is an evaluation function that takes an action and returns the 
 	// response class for that action. It uses the chosen action to look up 
 	// the right selection probabilities, and then generates a random index 
@@ -519,7 +525,7 @@ public:
 	virtual Response Evaluate( const Action & ChosenAction ) override
 	{
 		ActionIndex 
-		ResponseIndex = Random::Index( SelectionPDF.at( ChosenAction ) );
+		ResponseIndex = ResponseSampler.at( ChosenAction )();
 		
 		return Response( ChosenAction, ResponseValue.at( ResponseIndex ) );
 	}
@@ -544,9 +550,13 @@ public:
 			const std::vector< ProbabilityMass< double > > & RewardProbabilities )
 	: LearningEnvironmentBase< QResponseType >( RewardProbabilities.size() ),
 	  ResponseValue( ResponseSet ), SelectionPDF( RewardProbabilities ),
-	  ResponseSetSize( ResponseSet.size() )
+	  ResponseSampler(), ResponseSetSize( ResponseSet.size() )
 	{	
 		for ( const auto & ResponseDistribution : RewardProbabilities )
+		{
+			ResponseSampler.emplace_back( ResponseDistribution.cbegin(), 
+																		ResponseDistribution.cend() );
+			
 			if( ResponseDistribution.size() != ResponseSetSize )
 		  {
 				std::ostringstream ErrorMessage;
@@ -558,6 +568,7 @@ public:
 										 
 			  throw std::invalid_argument( ErrorMessage.str() );
 			}
+		}
 			
 		EnvironmentBase::EnvironmentType = Model::Q;
 	}
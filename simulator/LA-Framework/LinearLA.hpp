@@ -15,6 +15,7 @@
  
  Revision: Geir Horn 2016 - introduced the LA name space
            Geir Horn 2017 - Environment response types introduced
+           Geir Horn 2019 - Fixed linear update schemes
  =============================================================================*/
 
 #ifndef LINEAR_AUTOMATA
@@ -24,6 +25,7 @@
 #include <algorithm>                  // Standard algorithms
 #include <stdexcept>                  // For standard error messages
 #include <type_traits>                // Supporting meta programming
+#include <sstream>                    // For error messages
 
 #include "LearningEnvironment.hpp"    // The Environment definitions
 #include "LearningAutomata.hpp"       // The basic automata definitions
@@ -354,7 +356,7 @@ public:
     if (  Response.Feedback == PModelResponse::Penalty )
     {
       double pIncrease    = ( 1.0-PenaltyConstant ) /
-			    static_cast<double>( NumberOfActions()-1 );
+			    static_cast<double>( NumberOfActions-1 );
       
       for ( double & Probability : ActionProbabilities )
           Probability = PenaltyConstant * Probability + pIncrease;
@@ -465,6 +467,171 @@ public:
 	{ }
 };
 
+/*==============================================================================
+
+ Fixed linear update schemes
+
+==============================================================================*/
+//
+// The linear automata above select the update by the feedback received at 
+// run time and through the virtual feedback functions, and the learning 
+// constants are variables. When the environment model, the learning scheme, 
+// and possibly the number of actions are known when the application is 
+// compiled, the update can be written as one loop without branches over the
+// probability vector. The reward, penalty, and their combination in the 
+// reward-penalty scheme are all of the form
+//
+//   p(i) = Scale * p(i) + Offset + Correction [i = a]
+//
+// where a is the chosen action. With the normalised response b, which is 
+// unity for a P-model reward and zero for a P-model penalty, the L_RI part is 
+// weighted by b and the L_IP part by (1-b). For the S-model this is the 
+// combination of Viswanathan and Narendra [1] discussed for the S-model L_RI
+// above, using the learning constants with unity as slow learning as in the 
+// rest of this file. The correction of the chosen action keeps the vector 
+// normalised so there is no need to sum the probabilities.
+//
+// If the number of actions is given as a template parameter the loop bound is
+// a constant and the compiler may unroll the loop completely. The default 
+// value zero means that the number of actions is taken at run time.
+
+enum class LinearScheme
+{
+	RewardInaction,
+	InactionPenalty,
+	RewardPenalty
+};
+
+template< Model EnvironmentModel, LinearScheme Scheme, ActionIndex Actions = 0 >
+class LinearUpdate
+{
+public:
+	
+	static_assert( ( EnvironmentModel == Model::P ) || 
+								 ( EnvironmentModel == Model::S ), 
+								 "Fixed linear updates are defined for the P and S models" );
+	
+	// The response is converted to a real value in [0,1]
+	
+	template< typename ResponseType >
+	static constexpr double Normalised( const ResponseType & Feedback )
+	{
+		if constexpr ( EnvironmentModel == Model::P )
+			return ( Feedback == PModelResponse::Reward ) ? 1.0 : 0.0;
+		else
+			return static_cast< double >( Feedback );
+	}
+	
+	// The update takes a pointer to the probabilities, and the number of actions
+	// which is ignored if the number of actions is a template parameter. The 
+	// constants not used by the scheme are ignored.
+	
+	static inline void Apply( double * Probabilities, ActionIndex Size,
+														ActionIndex ChosenAction, double Response, 
+														double RewardConstant, double PenaltyConstant )
+	{
+		const ActionIndex N = ( Actions > 0 ) ? Actions : Size;
+		
+		double Reward  = 0.0, 
+					 Penalty = 0.0;
+		
+		if constexpr ( Scheme != LinearScheme::InactionPenalty )
+			Reward = Response;
+		
+		if constexpr ( Scheme != LinearScheme::RewardInaction )
+			Penalty = 1.0 - Response;
+		
+		const double Spread = ( 1.0 - PenaltyConstant ) / 
+													static_cast< double >( N - 1 ),
+								 Scale  = 1.0 - Reward  * ( 1.0 - RewardConstant ) 
+															- Penalty * ( 1.0 - PenaltyConstant ),
+								 Offset = Penalty * Spread;
+		
+		#pragma omp simd
+		for ( ActionIndex i = 0; i < N; i++ )
+			Probabilities[i] = Scale * Probabilities[i] + Offset;
+		
+		Probabilities[ ChosenAction ] += Reward * ( 1.0 - RewardConstant ) - Offset;
+	}
+};
+
+// The fixed linear automaton uses this update with the learning constants 
+// given to the constructor. The class is final so that the compiler may call 
+// the feedback function directly when the type of the automaton is known.
+// The penalty constant is not used by the reward-inaction scheme and the 
+// reward constant is not used by the inaction-penalty scheme, but they must 
+// still be legal learning constants.
+
+template< class StochasticEnvironment, LinearScheme Scheme, 
+					ActionIndex Actions = 0 >
+class FixedLinearLA final
+: virtual public LearningAutomata< StochasticEnvironment >,
+  virtual public VSSA< StochasticEnvironment >
+{
+public:
+	
+	using Environment = StochasticEnvironment;
+	using LearningAutomata< Environment >::NumberOfActions;
+	
+	// The model is found from the environment's base class
+	
+	static constexpr Model EnvironmentModel = 
+		std::is_base_of< LearningEnvironment< Model::P >, Environment >::value 
+		? Model::P : Model::S;
+	
+	static_assert( ( EnvironmentModel == Model::P ) || 
+								 std::is_base_of< LearningEnvironment< Model::S, 
+								   typename Environment::ResponseType >, Environment >::value,
+								 "Fixed linear automata require a P-model or S-model environment" );
+	
+	using Update = LinearUpdate< EnvironmentModel, Scheme, Actions >;
+	
+private:
+	
+	using VSSA_Base = VSSA< Environment >;
+	using VSSA_Base::ActionProbabilities;
+	
+	const double RewardConstant, PenaltyConstant;
+	
+public:
+	
+	virtual 
+	void Feedback ( const typename Environment::Response & Response ) override
+	{
+		Update::Apply( ActionProbabilities.data(), NumberOfActions, 
+									 Response.ChosenAction, 
+									 Update::Normalised( Response.Feedback ),
+									 RewardConstant, PenaltyConstant );
+	}
+	
+	FixedLinearLA( const Environment & TheEnvironment, 
+								 double TheRewardConstant, double ThePenaltyConstant = 0.5 )
+	: LearningAutomata< Environment >( TheEnvironment ),
+	  VSSA_Base( TheEnvironment ),
+	  RewardConstant( TheRewardConstant ), PenaltyConstant( ThePenaltyConstant )
+	{
+		if ( !( ( 0.0 < RewardConstant  ) && ( RewardConstant  < 1.0 ) &&
+					  ( 0.0 < PenaltyConstant ) && ( PenaltyConstant < 1.0 ) &&
+					  ( ( Actions == 0 ) || ( Actions == NumberOfActions ) ) ) )
+		{
+			std::ostringstream ErrorMessage;
+			
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "Fixed linear automaton with reward constant " 
+									 << RewardConstant << " and penalty constant " 
+									 << PenaltyConstant << " for " << NumberOfActions 
+									 << " actions (expected " << Actions << ")";
+									 
+			throw std::invalid_argument( ErrorMessage.str() );
+		}
+	}
+	
+	FixedLinearLA( void ) = delete;
+	
+	virtual ~FixedLinearLA( void )
+	{ }
+};
+
 /*==============================================================================
 
  Discrete Linear Reward Inaction automata (P-model)
@@ -549,16 +716,20 @@ public:
   {
     if ( Response.Feedback == PModelResponse::Reward )
     {
-      for ( double & Probability : ActionProbabilities )
-          Probability = std::max( Probability - StepSize, 0.0 );
+      // The sum of the reduced probabilities is computed in the same loop,
+      // and the selected action probability is then set to the remaining 
+      // probability mass after removing its own reduced value from the sum.
+      
+      double Sum = 0.0;
       
-      // The selected action probability is reset to zero so that it is 
-      // possible to sum over the other changed probabilities
+      for ( double & Probability : ActionProbabilities )
+      {
+        Probability = std::max( Probability - StepSize, 0.0 );
+        Sum += Probability;
+      }
       
-      ActionProbabilities[ Response.ChosenAction ] = 0.0;
       ActionProbabilities[ Response.ChosenAction ] = 
-		      1.0 - std::accumulate( ActionProbabilities.begin(), 
-																 ActionProbabilities.end(), 0.0 );
+        1.0 - ( Sum - ActionProbabilities[ Response.ChosenAction ] );
     }
   };
   
@@ -306,6 +306,16 @@ public:
 // made when the second probability is given. In the block assignment, all 
 // assigned probabilities do keep their assigned values in the final probability
 // mass.
+//
+// Normalising the mass after each single assignment makes an update of k 
+// elements of a mass of n elements cost O(k n), which is noticeable for the 
+// large action sets of the learning automata. The stored elements are 
+// therefore weights whose total is tracked as elements are assigned, and 
+// the probability of an element is its weight divided by the total. Assigning
+// a single element changes only the weight of this element and the total, 
+// and the weights are normalised when the elements are read through the 
+// iterators or when an operation needs the whole vector. The elements read 
+// through the public interface are therefore always proper probabilities.
 
 template< typename RealType = double >
 class ProbabilityMass : private std::vector< Probability< RealType >  >
@@ -364,7 +374,31 @@ private:
       std::transform( begin(), end(), begin(), 
 		      [=](Probability<RealType> & aProbability)->RealType{ 
 			  return aProbability / Sum;} );
+		
+		Total = 1.0;
   }
+  
+  // The total of the stored weights is unity when the weights are normalised,
+  // and it is updated when single elements are assigned.
+  
+  RealType Total = 1.0;
+  
+  // The weights are normalised before they are read as probabilities. This 
+  // may happen for a mass accessed through a constant reference, and the 
+  // constant is therefore cast away. This is safe because all constructors 
+  // leave the mass normalised, and only the non-constant assignments can 
+  // make the weights differ from the probabilities.
+  
+  inline void Materialise( void ) const
+  {
+		if ( Total != 1.0 )
+			const_cast< ProbabilityMass< RealType > * >( this )->Normalise();
+	}
+	
+	// The probability of an element is its weight relative to the total
+	
+	inline RealType Value( size_type i ) const
+	{ return ProbabilityVector::at(i) / Total; }
     
 public:
   
@@ -374,9 +408,27 @@ public:
   using ProbabilityVector::at;  
   using ProbabilityVector::size;
   using ProbabilityVector::empty;
-  using ProbabilityVector::cbegin;
-  using ProbabilityVector::cend;
-  using ProbabilityVector::clear;
+  
+  // The iterators give direct access to the stored elements, and the weights
+  // must therefore be normalised first.
+  
+  inline typename ProbabilityVector::const_iterator cbegin( void ) const
+  {
+		Materialise();
+		return ProbabilityVector::cbegin();
+	}
+	
+  inline typename ProbabilityVector::const_iterator cend( void ) const
+  {
+		Materialise();
+		return ProbabilityVector::cend();
+	}
+	
+	inline void clear( void )
+	{
+		ProbabilityVector::clear();
+		Total = 1.0;
+	}
   
   // The resize function supports only a specific number of elements, and there
   // are two alternatives: If the number of element is less than the current 
@@ -391,12 +443,14 @@ public:
   
   void resize( size_type n )
   {
+		Materialise();
     ProbabilityVector::resize( n, 1.0 / static_cast<RealType>(n) );
     Normalise();
   }
   
   void resize( size_type n, Probability<RealType> & InitialValue )
   {
+		Materialise();
     ProbabilityVector::resize( n, InitialValue );
     Normalise();
   }
@@ -415,6 +469,7 @@ public:
   void assign( size_type n )
   {
     ProbabilityVector::assign( n, 1.0 / static_cast<RealType>(n) );
+    Total = 1.0;
   }
   
   // If the assignment is made from a list of probabilities, it must also be
@@ -424,7 +479,7 @@ public:
   template< typename OtherReal >
   void assign( std::initializer_list< OtherReal > InitialValues )
   {
-    ProbabilityVector::assign( InitialValues );
+    ProbabilityVector::assign( InitialValues.begin(), InitialValues.end() );
     Normalise();
   }
   
@@ -477,7 +532,7 @@ private:
     // index.
     
     AssignSingle( size_type i, ProbabilityMass< RealType > * ProbMass )
-    : Probability< RealType >( ProbMass->ProbabilityVector::at(i) ),
+    : Probability< RealType >( ProbMass->Value(i) ),
       This( ProbMass )
     { Index = i;  }
     
@@ -503,14 +558,44 @@ private:
     // also the past value must be unity otherwise the vector would not have 
     // been a probability mass. Hence, if the attempted assignment is for 
     // a value not unity, an invalid argument exception will be thrown.
+    //
+    // Multiplying all the untouched elements by the same factor is the same 
+    // as leaving their weights and changing the total. If the weights of the 
+    // untouched elements sum to R, the new weight W of the assigned element 
+    // must satisfy W/(R+W) = V, giving W = V R/(1-V) and the new total 
+    // R/(1-V). This is constant time, but it is only possible if the new 
+    // weight is a legal probability value and the total does not vanish. 
+    // Otherwise the weights are normalised and the untouched elements scaled
+    // as described above. Reading an element through the non-constant 
+    // access functions without assigning it leaves the mass unchanged.
     
     ~AssignSingle( void )
     {
       if ( This->size() > 1 )
       {
-       Probability<RealType> PastValue = This->ProbabilityVector::at( Index );
+       Probability<RealType> PastValue = This->Value( Index );
        RealType Weight 		      = 1.0 - GetValue();
        
+       if ( GetValue() == PastValue.GetValue() ) 
+         return;
+       
+       if ( ( PastValue < 1.0 ) && ( GetValue() < 1.0 ) )
+       {
+         RealType Remaining = This->Total - This->ProbabilityVector::at( Index ),
+                  NewWeight = GetValue() * Remaining / Weight,
+                  NewTotal  = Remaining / Weight;
+         
+         if ( ( NewWeight <= 1.0 ) && 
+              ( NewTotal >= 10 * std::numeric_limits<double>::epsilon() ) )
+         {
+           This->ProbabilityVector::at( Index ) = NewWeight;
+           This->Total = NewTotal;
+           return;
+         }
+       }
+       
+       This->Materialise();
+       
        if ( PastValue == 1.0 )
        {
          Weight /= static_cast< RealType >( This->size() - 1 );
@@ -533,6 +618,8 @@ private:
              });	
        }
        
+       This->Total = 1.0;
+       
        // Finally, the assigned value is stored in the vector.
           
        This->ProbabilityVector::at( Index ) = GetValue();
@@ -563,7 +650,7 @@ public:
   { return AssignSingle( i, this );  }
   
   inline RealType at( size_type i ) const
-  { return ProbabilityVector::at(i); }
+  { return Value(i); }
 
   // The [] operator is identical and included for completeness.
   
@@ -571,7 +658,7 @@ public:
   { return AssignSingle( i, this ); }
   
   inline RealType operator[] ( size_type i ) const
-  { return ProbabilityVector::at(i); }
+  { return Value(i); }
 
   // In the case that many probabilities should be assigned, one cannot use 
   // repeatedly the single probability assignment since the second probability
@@ -609,6 +696,8 @@ public:
     
     RealType GivenMass     = 0.0,
              MassUnchanged = 0.0;
+    
+    Materialise();
 	     
     for ( size_type Index = 0; Index < size(); Index++ )
       if ( GivenProbabilities[ Index ] )
@@ -681,6 +770,7 @@ public:
     const ProbabilityMass< OtherReal > & Other )
   {
     ProbabilityVector::operator= ( Other );
+    Total = Other.Total;
     
     return *this;
   }
@@ -690,6 +780,7 @@ public:
     const ProbabilityMass< OtherReal > && Other )
   {
     ProbabilityVector::operator= ( Other );
+    Total = Other.Total;
     
     return *this;
   }
@@ -735,7 +826,7 @@ public:
     }
     
     for ( size_type Index :  SubsetIndices )
-		 Sum += at( Index );
+		 Sum += Value( Index );
 		 
 	 return Sum;
   }
@@ -762,7 +853,7 @@ public:
 	 }
 	 
 	 for ( size_type Index :  SubsetIndices )
-       SubsetMass.push_back( at( Index ) );
+       SubsetMass.push_back( Value( Index ) );
        
     return SubsetMass;
   }
@@ -800,12 +891,12 @@ public:
   
   template< typename OtherReal >
   ProbabilityMass( ProbabilityMass< OtherReal > & Other )
-	: ProbabilityVector( Other )
+	: ProbabilityVector( Other ), Total( Other.Total )
 	{ }
   
   template< typename OtherReal >
   ProbabilityMass( ProbabilityMass< OtherReal > && Other )
-	: ProbabilityVector( Other )
+	: ProbabilityVector( Other ), Total( Other.Total )
 	{ }
   
   // There is a constructor taking a number of elements in the vector and 
@@ -821,7 +912,7 @@ public:
   // must be normalised after the assignment.
   
   ProbabilityMass( std::initializer_list< RealType > InitialValues )
-  : ProbabilityVector( InitialValues )
+  : ProbabilityVector( InitialValues.begin(), InitialValues.end() )
   { Normalise(); }
   
   // The default constructor leaves the probability mass empty
@@ -44,7 +44,7 @@ namespace LA
 ******************************************************************************/
 
 template < class StochasticEnvironment, class EstimatorType 
-												= MLE< typename StochasticEnvironment::ResponseType > >
+												= MLE< StochasticEnvironment > >
 class ContinuousPursuitRP 
 : virtual public LearningAutomata< StochasticEnvironment >,
   virtual public VSSA< StochasticEnvironment >,
@@ -124,7 +124,7 @@ public:
 *******************************************************************************/
 
 template < class StochasticEnvironment, class EstimatorType 
-												= MLE< typename StochasticEnvironment::ResponseType > >
+												= MLE< StochasticEnvironment > >
 class ContinuousPursuitRI
 : virtual public LearningAutomata< StochasticEnvironment >,
   virtual public VSSA< StochasticEnvironment >,
@@ -199,7 +199,7 @@ public:
 ******************************************************************************/
 
 template < class StochasticEnvironment, class EstimatorType 
-												= MLE< typename StochasticEnvironment::ResponseType > >
+												= MLE< StochasticEnvironment > >
 class DiscretePursuitRP 
 : virtual public LearningAutomata< StochasticEnvironment >,
   virtual public VSSA< StochasticEnvironment >,
@@ -285,7 +285,7 @@ public:
 ******************************************************************************/
 
 template < class StochasticEnvironment, class EstimatorType 
-												= MLE< typename StochasticEnvironment::ResponseType > >
+												= MLE< StochasticEnvironment > >
 class DiscretePursuitRI
 : virtual public LearningAutomata< StochasticEnvironment >,
   virtual public VSSA< StochasticEnvironment >,
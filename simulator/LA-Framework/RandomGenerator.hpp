@@ -16,17 +16,28 @@
   Marsenne Twister [1], and the let all random numbers of an application use 
   one single instance of this generator. 
    
-  Note that the random number generator is defined as a global class and it 
-  is therefore not thread safe without the necessary mutex encapsulation which
-  is work to be done. The reason for using a global generator is that the 
-  quality of a long sequence of random numbers is normally better than the 
-  quality of many short sequences (even with different seeds). 
+  The reason for using a global generator is that the quality of a long 
+  sequence of random numbers is normally better than the quality of many short
+  sequences (even with different seeds). However, the global generator had to 
+  be protected by a mutex, and all the threads drawing random numbers were 
+  serialised on this lock. The generator is therefore now a counter based 
+  generator, Philox 4x32-10 [2], which computes the random numbers by 
+  encrypting a counter with a key. The key is the seed, and the counter is 
+  split in a stream number and the position in the stream. Each thread draws 
+  from its own stream without locking, and the streams are guaranteed not to 
+  overlap since they are different parts of the counter space of the same 
+  key. The streams pass the BigCrush test battery [2] also when they are 
+  interleaved, so they are as good as one long sequence. 
 
   References:
   
   [1] M. Matsumoto and T. Nishimura (1998): "Mersenne twister: a 
 		  623-dimensionally equidistributed uniform pseudo-random number generator" 
 		  ACM Transactions on Modeling and Computer Simulation. 8 (1): 3–30. 
+  [2] John K. Salmon, Mark A. Moraes, Ron O. Dror, and David E. Shaw (2011):
+      "Parallel random numbers: As easy as 1, 2, 3", Proceedings of the 
+      International Conference for High Performance Computing, Networking, 
+      Storage and Analysis (SC11), Article 16, pp. 1-12
   
   First version: Geir Horn, SINTEF, 2011
   Revised: Geir Horn, University of Oslo, 2013 (C++11 features)
@@ -36,8 +47,9 @@
  					 Geir Horn, University of Oslo, 2017, Major revision:
 							- Changed the encapsulation of the engine
 						  - Better integration with the standard distributions
+					 Geir Horn, University of Oslo, 2019 (lock free thread streams)
 
-  Author and Copyright: Geir Horn, 2011-2017
+  Author and Copyright: Geir Horn, 2011-2019
   License: LGPLv3
 =============================================================================*/
 
@@ -58,7 +70,12 @@
 #include <algorithm>   				// Correct maximum and minimum definitions
 #include <numeric>					  // To sum vectors
 #include <random>							// The standard random generators
-#include <mutex>							// To protect the random generator engine
+#include <cstdint>							// Seed values
+#include <array>							// The counter and key of the engine
+#include <atomic>							// The seed and the stream numbers
+#include <optional>						// Fixed stream numbers
+#include <limits>							// The range of the engine
+#include <chrono>							// Time based default seed
 #include <type_traits>				// Essential for meta-programming
 #include <sstream>					  // For advanced error reporting
 #include <stdexcept>				  // Standard exceptions
@@ -77,47 +94,231 @@ namespace Random
 
 =============================================================================*/
 //
-// Following the above discussion it is mandatory to have only one generator 
-// engine for for all random variates. Ideally this could be encapsulated as 
-// a static element of the random variate, but the variate class has to be 
-// conditioned on the type of distribution it is drawn from, and therefore 
-// it will be a template. A local variable in a template class is bound to
-// the template argument, and for this reason the generator cannot be embedded 
-// in the random variate class.
+// The Philox engine is a standard uniform random bit generator so that it can 
+// be used with the standard distributions, and it can also be used directly 
+// if an algorithm needs its own reproducible stream. The 128 bit counter is 
+// the block number in the lower 64 bits and the stream number in the upper 
+// 64 bits, and the key is the 64 bit seed. Each block of the counter is 
+// encrypted by ten rounds of multiplications and key additions, and gives 
+// two 64 bit random numbers. 
+
+class Philox
+{
+public:
+	
+	using result_type = std::uint64_t;
+	
+	static constexpr result_type min( void )
+	{ return std::numeric_limits< result_type >::min(); }
+	
+	static constexpr result_type max( void )
+	{ return std::numeric_limits< result_type >::max(); }
+	
+private:
+	
+	std::array< std::uint32_t, 2 > Key;
+	std::uint64_t 								 StreamNumber, Block;
+	std::array< std::uint32_t, 4 > Output;
+	unsigned int 									 Used;
+	
+	// The multipliers and the key increments (the golden ratio and the square
+	// root of three) are the ones given by Salmon et al. [2].
+	
+	static constexpr std::uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57, 
+																 W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+	
+public:
+	
+	// The bijection encrypts a counter with a key, and it is public so that 
+	// the implementation can be tested against the known answers.
+	
+	static std::array< std::uint32_t, 4 > 
+	Bijection( std::array< std::uint32_t, 4 > Counter, 
+						 std::array< std::uint32_t, 2 > TheKey )
+	{
+		for ( unsigned int Round = 0; Round < 10; Round++ )
+		{
+			if ( Round > 0 )
+			{
+				TheKey[0] += W0;
+				TheKey[1] += W1;
+			}
+			
+			std::uint64_t Product0 = static_cast< std::uint64_t >( M0 ) * Counter[0],
+										Product1 = static_cast< std::uint64_t >( M1 ) * Counter[2];
+			
+			Counter = { static_cast< std::uint32_t >( Product1 >> 32 ) 
+									^ Counter[1] ^ TheKey[0],
+									static_cast< std::uint32_t >( Product1 ),
+									static_cast< std::uint32_t >( Product0 >> 32 ) 
+									^ Counter[3] ^ TheKey[1],
+									static_cast< std::uint32_t >( Product0 ) };
+		}
+		
+		return Counter;
+	}
+	
+	// A number is taken from the current block, and the next block is 
+	// computed when both numbers of the block have been used.
+	
+	inline result_type operator() ( void )
+	{
+		if ( Used == 2 )
+		{
+			Output = Bijection( { static_cast< std::uint32_t >( Block ), 
+														static_cast< std::uint32_t >( Block >> 32 ),
+														static_cast< std::uint32_t >( StreamNumber ),
+														static_cast< std::uint32_t >( StreamNumber >> 32 ) }, 
+													Key );
+			Block++;
+			Used = 0;
+		}
+		
+		result_type Value = ( static_cast< result_type >( Output[ 2*Used + 1 ] ) 
+												  << 32 ) | Output[ 2*Used ];
+		Used++;
+		
+		return Value;
+	}
+	
+	// Seeding the engine sets the key and the stream and starts from the 
+	// beginning of the stream. Skipping numbers only changes the counter.
+	
+	inline void seed( std::uint64_t Seed, std::uint64_t Stream = 0 )
+	{
+		Key 				 = { static_cast< std::uint32_t >( Seed ), 
+									   static_cast< std::uint32_t >( Seed >> 32 ) };
+		StreamNumber = Stream;
+		Block 			 = 0;
+		Used 				 = 2;
+	}
+	
+	inline void discard( unsigned long long Skip )
+	{
+		if ( Used < 2 && Skip > 0 )
+		{
+			Used++;
+			Skip--;
+		}
+		
+		Block += Skip / 2;
+		
+		if ( Skip % 2 == 1 )
+		{
+			operator()();
+			operator()();
+			Used = 1;
+		}
+	}
+	
+	inline std::uint64_t Stream( void ) const
+	{ return StreamNumber; }
+	
+	Philox( std::uint64_t Seed = 0, std::uint64_t Stream = 0 )
+	: Key(), StreamNumber( 0 ), Block( 0 ), Output(), Used( 2 )
+	{
+		seed( Seed, Stream );
+	}
+};
+
+// Following the above discussion there is only one generator engine for all 
+// random variates. Ideally this could be encapsulated as a static element of 
+// the random variate, but the variate class has to be conditioned on the type
+// of distribution it is drawn from, and therefore it will be a template. A 
+// local variable in a template class is bound to the template argument, and 
+// for this reason the generator cannot be embedded in the random variate 
+// class.
 //
-// There is only one generator on each endpoint. Fundamentally, the random 
-// generator only protects the access to the generator engine and ensures that 
-// it is properly seeded with the high resolution system clock. 
+// There is only one generator on each endpoint, holding the seed, and each 
+// thread has its own Philox engine for its stream. The engine of a thread is 
+// seeded the first time the thread draws a number after the generator has 
+// been seeded, and the threads are given consecutive stream numbers in the 
+// order they draw their first number. A single threaded application will 
+// therefore always use stream zero and get the same numbers for the same 
+// seed. When many threads draw numbers, the order of their first draw is not
+// deterministic, and a thread can fix its stream number so that it will get 
+// the same numbers for every run. The thread must then ensure that no other 
+// thread uses the same stream number. Setting the stream restarts the stream 
+// from its beginning, and a task executed by any thread of a pool can be made
+// reproducible by setting a stream for the task when the task starts.
 
 extern
 class GeneratorEngine 
 {
 private:
 	
-	// The standard instantiation of the Mersenne Twister is used for the 
-	// generation
+	// The seed is changed together with an epoch count so that the threads 
+	// can detect that they must seed their engine again.
 	
-	#if __x86_64__ || __ppc64__ || _WIN64
-    std::mt19937_64 MersenneTwister;
-  #else
-    std::mt19937 MersenneTwister;
-  #endif
-
-	// Access to this is protected by a mutex
+	std::atomic< std::uint64_t > MasterSeed, Epoch, NextStream;
+	
+	class ThreadStream
+	{
+	public:
+		
+		Philox 												 Engine;
+		std::uint64_t 								 Epoch;
+		std::optional< std::uint64_t > FixedStream;
+	};
+	
+	static ThreadStream & LocalStream( void )
+	{
+		static thread_local ThreadStream TheStream{ Philox(), 0, std::nullopt };
 		
-	std::mutex Access;
+		return TheStream;
+	}
+	
+	inline Philox & Engine( void )
+	{
+		ThreadStream & Local = LocalStream();
+		std::uint64_t  CurrentEpoch = Epoch.load( std::memory_order_acquire );
+		
+		if ( Local.Epoch != CurrentEpoch )
+		{
+			Local.Engine.seed( MasterSeed.load( std::memory_order_relaxed ), 
+				Local.FixedStream ? Local.FixedStream.value() 
+				: NextStream.fetch_add( 1, std::memory_order_relaxed ) );
+			
+			Local.Epoch = CurrentEpoch;
+		}
+		
+		return Local.Engine;
+	}
 
 public:
 		
-	// The constructor initialises the Mersenne Twister with the value of 
-	// the current time of the system clock.
+	// The constructor initialises the seed with the value of the current time
+	// of the system clock.
 	
 	GeneratorEngine( void )
-	: MersenneTwister( 
-						std::chrono::system_clock::now().time_since_epoch().count() ),
-		Access()
+	: MasterSeed( std::chrono::system_clock::now().time_since_epoch().count() ),
+		Epoch( 1 ), NextStream( 0 )
 	{ }
 	
+	// Independent replications of a stochastic simulation need reproducible 
+	// and different random streams, and the engine can therefore be given an 
+	// explicit seed replacing the time based seed. All threads will start 
+	// on the beginning of their stream for the new seed, and the numbering of
+	// the streams not fixed starts from zero again.
+	
+	inline void Seed( std::uint_fast64_t Value )
+	{
+		MasterSeed.store( Value, std::memory_order_relaxed );
+		NextStream.store( 0, std::memory_order_relaxed );
+		Epoch.fetch_add( 1, std::memory_order_release );
+	}
+	
+	// The stream of the calling thread can be fixed, and the stream will be 
+	// restarted from its beginning. 
+	
+	inline void Stream( std::uint64_t StreamNumber )
+	{
+		ThreadStream & Local = LocalStream();
+		
+		Local.FixedStream = StreamNumber;
+		Local.Epoch 			= 0;
+	}
+	
 	// There are many different distributions that may be used with the engine 
 	// to generate a given number. In order to simplify the syntax, a template 
 	// operator is defined taking the distribution as argument and returning 
@@ -127,9 +328,7 @@ public:
 	typename Distribution::result_type
 	operator() ( Distribution & DensityFunction )
 	{
-		std::lock_guard< std::mutex > Lock( Access );
-		
-		return DensityFunction( MersenneTwister );
+		return DensityFunction( Engine() );
 	}
 	
 } Generator;
@@ -253,10 +452,8 @@ private:
 public:
 	
 	// The generation of the beta distributed number will be done in the 
-	// standard operator taking the generator engine as input. It should be 
-	// noted that the access to the generator is locked when this operator is 
-	// called, and so it is most efficient to generate both gamma variates at the 
-	// same time.
+	// standard operator taking the generator engine as input, and both gamma
+	// variates are generated from the engine of the calling thread.
 	
 	template< class Engine >
 	result_type operator() ( Engine & TheGenerator )
@@ -301,26 +498,326 @@ using Beta = Variate< beta_distribution<> >;
 // takes a probability mass as argument and returns a random index based on 
 // this mass.
 //
-// Since the probability mass is a template on the real value type and the 
-// allocator type used for the vector, also the index function is formally a 
-// template on the same parameters, but these should be automatically deduced 
-// by the compiler from the given probability mass.
+// Since the probability mass is a template on the real value type, also the 
+// index function is formally a template, but the type should be deduced by 
+// the compiler from the given probability mass.
+//
+// The index is drawn from an alias table, see below, which is kept per thread
+// and rebuilt for each call so that there is no memory allocation once the 
+// table has grown to the size of the largest probability mass used by the 
+// thread. The rebuild is still linear in the size of the mass, and when many 
+// indices are drawn from the same probabilities one should build an alias 
+// table once and draw from it directly.
+
+class AliasTable;
+
+template< class RealType >
+auto Index( const ProbabilityMass< RealType > & PDF )
+-> typename ProbabilityMass< RealType >::IndexType;
+
+// The index function builds the discrete distribution for every index drawn,
+// which is linear in the number of elements and allocates memory. When many 
+// indices are drawn from the same probabilities, Walker's alias method [3] 
+// gives each index in constant time: The probabilities are scaled so that 
+// their average is unity, and each of the n columns holds the scaled 
+// probability of its own element and an alias element taking the rest of 
+// the column. An index is drawn by selecting a column uniformly and then 
+// either the column's element or its alias. The table is built by Vose's 
+// algorithm [4] in linear time, and the vectors of the table are reused 
+// when the table is rebuilt for new probabilities of the same size so that 
+// there is no memory allocation. The probabilities need not be normalised, 
+// but they cannot be negative and at least one must be positive.
+//
+// [3] Alastair J. Walker (1977): "An efficient method for generating discrete
+//     random variables with general distributions", ACM Transactions on 
+//     Mathematical Software, Vol. 3, No. 3, pp. 253-256
+// [4] Michael D. Vose (1991): "A linear algorithm for generating random 
+//     numbers with a given distribution", IEEE Transactions on Software 
+//     Engineering, Vol. 17, No. 9, pp. 972-975
+
+class AliasTable
+{
+private:
+	
+	std::vector< double > 			Threshold;
+	std::vector< std::size_t >  Alias, Small, Large;
+	
+public:
+	
+	template< class Iterator >
+	void Rebuild( Iterator First, Iterator Last )
+	{
+		const std::size_t n = std::distance( First, Last );
+		double Total = 0.0;
+		
+		for ( Iterator Element = First; Element != Last; ++Element )
+			if ( *Element >= 0.0 )
+				Total += *Element;
+			else
+			{
+				std::ostringstream ErrorMessage;
+				
+				ErrorMessage << __FILE__ << " at line " << __LINE__ << " : "
+										 << "Random::AliasTable negative probability " 
+										 << static_cast< double >( *Element );
+				
+				throw std::invalid_argument( ErrorMessage.str() );
+			}
+		
+		if ( !( Total > 0.0 ) )
+		{
+			std::ostringstream ErrorMessage;
+			
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << " : "
+									 << "Random::AliasTable needs a positive probability";
+			
+			throw std::invalid_argument( ErrorMessage.str() );
+		}
+		
+		Threshold.resize( n );
+		Alias.resize( n );
+		Small.clear();
+		Large.clear();
+		
+		std::size_t Index = 0;
+		
+		for ( Iterator Element = First; Element != Last; ++Element, ++Index )
+		{
+			Threshold[ Index ] = *Element * n / Total;
+			Alias[ Index ] 		 = Index;
+			
+			if ( Threshold[ Index ] < 1.0 )
+				Small.push_back( Index );
+			else
+				Large.push_back( Index );
+		}
+		
+		// Each small column is filled by the mass of a large element, which may 
+		// then become small itself.
+		
+		while ( !Small.empty() && !Large.empty() )
+		{
+			std::size_t Column = Small.back(), 
+									Donor  = Large.back();
+			
+			Small.pop_back();
+			
+			Alias[ Column ] 		= Donor;
+			Threshold[ Donor ] -= 1.0 - Threshold[ Column ];
+			
+			if ( Threshold[ Donor ] < 1.0 )
+			{
+				Large.pop_back();
+				Small.push_back( Donor );
+			}
+		}
+		
+		// The columns left are full up to the rounding errors
+		
+		for ( std::size_t Column : Large ) Threshold[ Column ] = 1.0;
+		for ( std::size_t Column : Small ) Threshold[ Column ] = 1.0;
+	}
+	
+	inline std::size_t size( void ) const
+	{ return Threshold.size(); }
+	
+	// Drawing an index uses one uniform number where the integral part is the 
+	// column and the fractional part decides between the column's element and
+	// its alias.
+	
+	inline std::size_t operator() ( void ) const
+	{
+		std::uniform_real_distribution< double > 
+			Uniform( 0.0, static_cast< double >( Threshold.size() ) );
+		
+		double 			U 		 = Generator( Uniform );
+		std::size_t Column = std::min( static_cast< std::size_t >( U ), 
+																	 Threshold.size() - 1 );
+		
+		if ( U - Column < Threshold[ Column ] )
+			return Column;
+		else
+			return Alias[ Column ];
+	}
+	
+	AliasTable( void )
+	: Threshold(), Alias(), Small(), Large()
+	{ }
+	
+	template< class Iterator >
+	AliasTable( Iterator First, Iterator Last )
+	: AliasTable()
+	{
+		Rebuild( First, Last );
+	}
+};
+
+// The index function can then be defined using a table per thread
 
 template< class RealType >
 auto Index( const ProbabilityMass< RealType > & PDF )
 -> typename ProbabilityMass< RealType >::IndexType
 {
-  // The algorithm uses the standard discrete distribution to generate the 
-	// index of the probability mass in the set {0,..,n-1}
+	static thread_local AliasTable ElementIndex;
 	
-	Variate< 
-		std::discrete_distribution< 
-			typename ProbabilityMass< RealType >::IndexType > >
-					ElementIndex( PDF.cbegin(), PDF.cend() );
-  
-  return ElementIndex();
+	ElementIndex.Rebuild( PDF.cbegin(), PDF.cend() );
+	
+	return ElementIndex();
 }
 
+// The alias table must be rebuilt if a single weight changes. When the weights
+// change one at the time between the draws, it is better to keep the 
+// cumulative weights in a binary indexed tree [5] where both a weight update 
+// and the drawing of an index are logarithmic in the number of weights. Each
+// node of the tree holds the sum of the weights of a range of indices whose 
+// length is the lowest set bit of the node index, and an index is drawn by 
+// descending the tree with a uniform number in [0,Total). The weights need not
+// be normalised, but they must be non-negative and at least one must be 
+// positive for an index to be drawn. 
+//
+// [5] Peter M. Fenwick (1994): "A new data structure for cumulative frequency
+//     tables", Software: Practice and Experience, Vol. 24, No. 3, 
+//     pp. 327-336
+
+class CumulativeTable
+{
+private:
+	
+	std::vector< double > Weights, Tree;
+	std::size_t 					TopBit;
+	
+	// The tree is stored with one based indices where the node k covers the 
+	// indices (k - LowBit(k), k].
+	
+	static inline std::size_t LowBit( std::size_t k )
+	{ return k & ( ~k + 1 ); }
+	
+	inline void CheckWeight( double Weight ) const
+	{
+		if ( !( Weight >= 0.0 ) )
+		{
+			std::ostringstream ErrorMessage;
+			
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << " : "
+									 << "Random::CumulativeTable negative weight " << Weight;
+			
+			throw std::invalid_argument( ErrorMessage.str() );
+		}
+	}
+	
+public:
+	
+	// The tree is built in linear time by adding each node to its parent
+	
+	template< class Iterator >
+	void Rebuild( Iterator First, Iterator Last )
+	{
+		Weights.assign( First, Last );
+		Tree.assign( Weights.size() + 1, 0.0 );
+		
+		for ( std::size_t k = 1; k <= Weights.size(); k++ )
+		{
+			CheckWeight( Weights[ k - 1 ] );
+			
+			Tree[k] += Weights[ k - 1 ];
+			
+			std::size_t Parent = k + LowBit( k );
+			
+			if ( Parent <= Weights.size() ) Tree[ Parent ] += Tree[k];
+		}
+		
+		TopBit = 1;
+		
+		while ( ( TopBit << 1 ) <= Weights.size() ) TopBit <<= 1;
+	}
+	
+	// Updating a weight adds the change to all nodes covering the index
+	
+	inline void Update( std::size_t Index, double NewWeight )
+	{
+		CheckWeight( NewWeight );
+		
+		const double Change = NewWeight - Weights.at( Index );
+		
+		Weights[ Index ] = NewWeight;
+		
+		for ( std::size_t k = Index + 1; k <= Weights.size(); k += LowBit( k ) )
+			Tree[k] += Change;
+	}
+	
+	inline double Weight( std::size_t Index ) const
+	{ return Weights.at( Index ); }
+	
+	inline std::size_t size( void ) const
+	{ return Weights.size(); }
+	
+	// The total weight is the prefix sum of all the weights
+	
+	double Total( void ) const
+	{
+		double Sum = 0.0;
+		
+		for ( std::size_t k = Weights.size(); k > 0; k -= LowBit( k ) )
+			Sum += Tree[k];
+		
+		return Sum;
+	}
+	
+	// Drawing an index finds the first index whose cumulative weight exceeds 
+	// the uniform number. Indices with zero weight are never returned, and the 
+	// rounding errors in the accumulated sums are handled by never going past
+	// the last index with a positive weight.
+	
+	std::size_t operator() ( void ) const
+	{
+		const double Sum = Total();
+		
+		if ( !( Sum > 0.0 ) )
+		{
+			std::ostringstream ErrorMessage;
+			
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << " : "
+									 << "Random::CumulativeTable needs a positive weight";
+			
+			throw std::invalid_argument( ErrorMessage.str() );
+		}
+		
+		std::uniform_real_distribution< double > Uniform( 0.0, Sum );
+		
+		double 			Remaining = Generator( Uniform );
+		std::size_t Position  = 0;
+		
+		for ( std::size_t Step = TopBit; Step > 0; Step >>= 1 )
+			if ( ( Position + Step <= Weights.size() ) && 
+					 ( Tree[ Position + Step ] <= Remaining ) )
+			{
+				Position  += Step;
+				Remaining -= Tree[ Position ];
+			}
+		
+		// The position is now the number of indices whose cumulative weight 
+		// does not exceed the number drawn, which is also the index drawn.
+		
+		while ( ( Position >= Weights.size() ) || !( Weights[ Position ] > 0.0 ) )
+			if ( Position >= Weights.size() ) Position = Weights.size() - 1;
+			else if ( Position > 0 ) 				 Position--;
+			else break;
+		
+		return Position;
+	}
+	
+	CumulativeTable( void )
+	: Weights(), Tree( 1, 0.0 ), TopBit( 0 )
+	{ }
+	
+	template< class Iterator >
+	CumulativeTable( Iterator First, Iterator Last )
+	: CumulativeTable()
+	{
+		Rebuild( First, Last );
+	}
+};
+
 /*=============================================================================
 
  Functional forms
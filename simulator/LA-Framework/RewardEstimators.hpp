@@ -137,9 +137,11 @@ private:
   
   std::vector < unsigned long int > TriedCount;
   
-  // There is also a vector to accumulate the rewards given for each action
+  // There is also a vector to accumulate the rewards given for each action.
+  // The rewards are accumulated as real values since the P-model responses 
+  // cannot be added.
   
-  std::vector < typename Environment::ResponseType > AccumulatedReward;
+  std::vector < double > AccumulatedReward;
   
 public:
   
@@ -150,8 +152,7 @@ public:
   MLE ( const StochasticEnvironment & TheEnvironment )
   : RewardEstimator< Environment, double >( TheEnvironment ),
     TriedCount( NumberOfActions, 0 ),
-    AccumulatedReward( NumberOfActions, 
-								       static_cast< typename Environment::ResponseType >(0) )
+    AccumulatedReward( NumberOfActions, 0.0 )
     {};
 		
 	// The default constructor is not to be used
@@ -165,7 +166,8 @@ public:
   void Update ( const typename Environment::Response & Response ) override
   {
     TriedCount.at( Response.ChosenAction )++;
-    AccumulatedReward.at( Response.ChosenAction ) += Response.Feedback;
+    AccumulatedReward.at( Response.ChosenAction ) += 
+											static_cast< double >( Response.Feedback );
   };
   
   // The estimator is simply the ratio of the count and the total reward
@@ -177,7 +179,7 @@ public:
   virtual double RewardEstimate( ActionIndex TheAction ) override
   {
     if ( TriedCount.at( TheAction ) > 0 )
-    	return static_cast< double >( AccumulatedReward.at( TheAction ) ) /
+    	return AccumulatedReward.at( TheAction ) /
 						 static_cast< double >( TriedCount.at( TheAction ) );
     else
       	return 0.0;
@@ -258,7 +260,8 @@ public:
   virtual 
   void Update ( const typename Environment::Response & Response ) override
   {
-    AccumulatedReward.at( Response.ChosenAction ) += Response.Feedback;
+    AccumulatedReward.at( Response.ChosenAction ) += 
+											static_cast< double >( Response.Feedback );
     TotalReward += Response.Feedback;
   };
  
@@ -0,0 +1,231 @@
+/*=============================================================================
+  Batch Automata
+
+  The batch automata keep the action probabilities and the reward estimates
+  of many automata as rows of matrices, and they must learn exactly as the
+  automata of the framework using the same algorithm. This test runs a few
+  automata of each algorithm of the framework in a P-model environment, and
+  gives every response also to the automaton in the same row of a batch of
+  the corresponding policy. The action probabilities of the batch rows must
+  stay equal to the probabilities of the framework automata, up to rounding,
+  after every update:
+
+    LRI   = Linear reward-inaction and the LinearRI policy
+    LRP   = Linear reward-penalty and the LinearRP policy
+    CPRP  = Continuous pursuit reward-penalty and the ContinuousPursuitRP
+            policy
+    GTSE  = Generalised Thathachar-Sastry estimator and the GTSE policy
+
+  The estimator bookkeeping is also tested: The batch estimates of the
+  pursuit and estimator policies must equal the maximum likelihood estimates
+  computed from the responses given, and the updates of all automata in one
+  call must give the same estimates and best actions as the updates of one
+  automaton at the time.
+
+  The test writes one line for each case and returns a non-zero exit status
+  if any of the cases fails. It is built with 'make BatchAutomata' and takes
+  no options.
+
+  Author: Geir Horn, University of Oslo, 2019
+  Contact: Geir.Horn [at] mn.uio.no
+  License: LGPL3.0
+=============================================================================*/
+
+#include <string>                            // Case names
+#include <vector>                            // The automata of a case
+#include <memory>                            // Owning the automata
+#include <functional>                        // Creating the automata
+#include <cmath>                             // Absolute differences
+#include <iostream>                          // Reporting the cases
+#include <cstdlib>                           // Exit status
+
+#include "LearningEnvironment.hpp"           // The P-model environment
+#include "LinearLA.hpp"                      // Linear automata
+#include "PursuitAutomata.hpp"               // Pursuit automata
+#include "EstimatorAutomata.hpp"             // GTSE automata
+#include "BatchAutomata.hpp"                 // The batch automata
+#include "RandomGenerator.hpp"               // Seeding the responses
+
+using Environment = LA::LearningEnvironment< LA::Model::P >;
+
+// The test parameters are the same for all cases. The reward probabilities
+// give distinct estimates after a few updates so that the best estimated
+// action is rarely decided by a tie.
+
+constexpr std::size_t NumberOfAutomata = 3,
+                      Iterations       = 2000;
+constexpr double      Tolerance        = 1e-9;
+
+const std::vector< Probability< double > > RewardProbabilities
+  = { 0.2, 0.55, 0.8, 0.35 };
+
+/*=============================================================================
+
+ Learning the same responses
+
+=============================================================================*/
+//
+// The framework automata select the actions and the environment evaluates
+// them. The response is given to the framework automaton and to the batch
+// row of the same index, and the largest difference of the action
+// probabilities is recorded. The framework automaton probabilities are
+// normalised when they are read, but the rows of the batch are normalised
+// by the updates and they can be compared directly.
+
+template< class Policy, class Automaton >
+bool SameLearning( const std::string & Case,
+                   const typename Policy::Parameters & Constants,
+                   const std::function< Automaton * ( const Environment & ) >
+                     & Create )
+{
+  Environment TheEnvironment( RewardProbabilities );
+  LA::BatchAutomata< Policy > Batch( RewardProbabilities.size(), Constants,
+                                     NumberOfAutomata );
+  std::vector< std::unique_ptr< Automaton > > Automata;
+
+  for ( std::size_t k = 0; k < NumberOfAutomata; k++ )
+  {
+    Automata.emplace_back( Create( TheEnvironment ) );
+    Batch.Add();
+  }
+
+  double LargestDifference = 0.0;
+
+  for ( std::size_t Iteration = 0; Iteration < Iterations; Iteration++ )
+    for ( std::size_t k = 0; k < NumberOfAutomata; k++ )
+    {
+      auto Response = TheEnvironment.Evaluate( Automata[k]->SelectAction() );
+
+      Automata[k]->Feedback( Response );
+      Batch.Feedback( k, Response.ChosenAction,
+        ( Response.Feedback == LA::PModelResponse::Reward ) ? 1.0 : 0.0 );
+
+      auto Probabilities = Automata[k]->GetProbabilities();
+
+      for ( LA::ActionIndex i = 0; i < Batch.Actions(); i++ )
+        LargestDifference = std::max( LargestDifference,
+          std::abs( Probabilities[i] - Batch.ActionProbability( k, i ) ) );
+    }
+
+  if ( LargestDifference < Tolerance )
+  {
+    std::cout << "PASSED " << Case << ": Largest probability difference "
+              << LargestDifference << std::endl;
+    return true;
+  }
+
+  std::cout << "FAILED " << Case << ": Largest probability difference "
+            << LargestDifference << std::endl;
+  return false;
+}
+
+/*=============================================================================
+
+ Estimator bookkeeping
+
+=============================================================================*/
+//
+// Two sets of batch estimates get the same random actions and rewards, one
+// automaton at the time and all automata in one call. The estimates must
+// equal the averages of the rewards given, and the two sets must have the
+// same estimates and best actions.
+
+bool SameEstimates( void )
+{
+  using Estimates = LA::BatchEstimates< LA::BatchEstimator::MLE >;
+
+  const LA::ActionIndex Actions = RewardProbabilities.size();
+
+  Estimates OneByOne( Actions, {} ), AllAtOnce( Actions, {} );
+  std::vector< double > RewardSum( NumberOfAutomata * Actions, 0.0 ),
+                        Trials( NumberOfAutomata * Actions, 0.0 );
+
+  for ( std::size_t k = 0; k < NumberOfAutomata; k++ )
+  {
+    OneByOne.Add();
+    AllAtOnce.Add();
+  }
+
+  std::uniform_int_distribution< LA::ActionIndex > Action( 0, Actions - 1 );
+  std::uniform_real_distribution< double >         Reward( 0.0, 1.0 );
+  std::vector< LA::ActionIndex >                   Chosen( NumberOfAutomata );
+  std::vector< double >                            Rewards( NumberOfAutomata );
+
+  bool Equal = true;
+
+  for ( std::size_t Iteration = 0; Iteration < Iterations; Iteration++ )
+  {
+    for ( std::size_t k = 0; k < NumberOfAutomata; k++ )
+    {
+      Chosen[k]  = Random::Generator( Action );
+      Rewards[k] = Random::Generator( Reward );
+
+      OneByOne.Update( k, Chosen[k], Rewards[k] );
+      RewardSum[ k * Actions + Chosen[k] ] += Rewards[k];
+      Trials[ k * Actions + Chosen[k] ]    += 1.0;
+    }
+
+    AllAtOnce.UpdateAll( Chosen, Rewards );
+
+    for ( std::size_t k = 0; k < NumberOfAutomata; k++ )
+    {
+      Equal &= ( OneByOne.BestEstimatedAction( k ) ==
+                 AllAtOnce.BestEstimatedAction( k ) );
+
+      for ( LA::ActionIndex i = 0; i < Actions; i++ )
+      {
+        const std::size_t Index = k * Actions + i;
+        const double Mean = ( Trials[ Index ] > 0.0 ) ?
+                            RewardSum[ Index ] / Trials[ Index ] : 0.0;
+
+        Equal &= ( OneByOne.RewardEstimate( k, i ) ==
+                   AllAtOnce.RewardEstimate( k, i ) ) &&
+                 ( std::abs( OneByOne.RewardEstimate( k, i ) - Mean )
+                   < Tolerance );
+      }
+    }
+  }
+
+  std::cout << ( Equal ? "PASSED" : "FAILED" )
+            << " MLE batch estimates: The estimates and best actions of "
+            << "single and batch updates" << ( Equal ? " " : " do not " )
+            << "equal the reward averages" << std::endl;
+
+  return Equal;
+}
+
+/*=============================================================================
+
+ Main
+
+=============================================================================*/
+
+int main( int argc, char **argv )
+{
+  Random::Generator.Seed( 1 );
+
+  bool Passed = true;
+
+  Passed &= SameLearning< LA::BatchPolicy::LinearRI,
+                          LA::LinearRI< Environment, LA::Model::P > >(
+    "LRI", { 0.95 }, []( const Environment & E ){
+      return new LA::LinearRI< Environment, LA::Model::P >( E, 0.95 ); } );
+
+  Passed &= SameLearning< LA::BatchPolicy::LinearRP,
+                          LA::LinearRP< Environment, LA::Model::P > >(
+    "LRP", { 0.95, 0.99 }, []( const Environment & E ){
+      return new LA::LinearRP< Environment, LA::Model::P >( E, 0.95, 0.99 ); } );
+
+  Passed &= SameLearning< LA::BatchPolicy::ContinuousPursuitRP,
+                          LA::ContinuousPursuitRP< Environment > >(
+    "CPRP", { 0.05 }, []( const Environment & E ){
+      return new LA::ContinuousPursuitRP< Environment >( E, 0.05 ); } );
+
+  Passed &= SameLearning< LA::BatchPolicy::GTSE, LA::GTSE< Environment > >(
+    "GTSE", { 0.1 }, []( const Environment & E ){
+      return new LA::GTSE< Environment >( E, 0.1 ); } );
+
+  Passed &= SameEstimates();
+
+  return Passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,463 @@
+/*=============================================================================
+  Convergence
+
+  The converge automata wrappers detect when an automaton has converged, but
+  there is no way to compare how fast the different automata converge for the
+  same problem. This experiment runs a large number of independent automata,
+  each with its own P-model environment, until the largest action probability
+  exceeds a threshold or a maximum number of iterations has been reached. It
+  reports for each algorithm the distribution of the number of iterations to
+  convergence, the fraction of runs converging to the best action, and the
+  number of updates per second.
+
+  The environment has one best action with a given reward probability, and
+  the other actions have reward probabilities evenly spaced from a second
+  best probability down to a lowest probability. The difference between the
+  best and the second best probability decides how hard the problem is. The
+  best action is placed at a different position for each run so that the
+  order of the actions does not favour any algorithm.
+
+  The runs are executed by a pool of threads. Each run sets its own stream of
+  the random generator, and the same run uses the same stream for all
+  algorithms. The results are therefore reproducible for a given seed and
+  independent of the number of threads, and the algorithms are compared on
+  the same random numbers.
+
+  The algorithms are given with their learning parameters, and a learning
+  constant close to unity means slow learning as for the rest of the
+  framework. The pursuit automaton is the exception where the learning
+  constant is the step towards the best estimated action, and a small value
+  means slow learning. The algorithms are:
+
+    LRI       = Linear reward-inaction
+    LRP       = Linear reward-penalty
+    FixedLRP  = Linear reward-penalty with the fixed update scheme
+    DLRI      = Discrete linear reward-inaction
+    CPRP      = Continuous pursuit reward-penalty
+    DPRP      = Discrete pursuit reward-penalty
+
+  The results are written as a JSON document to the standard output or to a
+  given file. The following options are supported:
+
+  -a [ --Algorithms <name...> ] = The algorithms to run. Default: all
+  -n [ --Actions <n> ]          = Number of actions. Default: 10
+  -b [ --Best <p> ]             = Reward probability of the best action. 0.8
+  -s [ --Second <p> ]           = Reward probability of the second best. 0.7
+  -w [ --Lowest <p> ]           = Lowest reward probability. Default: 0.2
+  -R [ --Runs <n> ]             = Number of runs per algorithm. Default: 1000
+  -c [ --Threshold <p> ]        = Convergence threshold. Default: 0.99
+  -m [ --MaxIterations <n> ]    = Maximum iterations per run. Default: 100000
+  -L [ --Reward <lambda> ]      = Reward learning constant. Default: 0.99
+  -P [ --Penalty <lambda> ]     = Penalty learning constant. Default: 0.99999
+  -u [ --Pursuit <lambda> ]     = Pursuit learning constant. Default: 0.01
+  -d [ --Resolution <n> ]       = Discrete resolution. Default: 100
+  -t [ --Threads <n> ]          = Threads. Default: hardware concurrency
+  -r [ --Seed <n> ]             = Seed for the random generator. Default: 1
+  -o [ --Output <file> ]        = The JSON result file. Default: standard output
+
+  Author: Geir Horn, University of Oslo, 2019
+  Contact: Geir.Horn [at] mn.uio.no
+  License: LGPL3.0
+=============================================================================*/
+
+#include <string>                            // Standard strings
+#include <vector>                            // Standard vectors
+#include <map>                               // The algorithm registry
+#include <functional>                        // Run functions
+#include <iostream>                          // Writing the results
+#include <chrono>                            // Wall clock timing
+#include <algorithm>                         // Sorting the iterations
+#include <numeric>                           // Summing the iterations
+#include <thread>                            // The thread pool
+#include <atomic>                            // The next run to execute
+#include <mutex>                             // Recording failed runs
+#include <exception>                         // Passing errors from threads
+#include <memory>                            // Smart pointers
+#include <cstdlib>                           // Exit status
+
+#include <boost/program_options.hpp>         // Command line parsing
+#include <boost/property_tree/ptree.hpp>     // JSON results
+#include <boost/property_tree/json_parser.hpp>
+
+#include "RandomGenerator.hpp"               // Streams per run
+#include "ProbabilityMass.hpp"               // Reward probabilities
+#include "LearningEnvironment.hpp"           // The P-model environment
+#include "LinearLA.hpp"                      // Linear automata
+#include "PursuitAutomata.hpp"               // Pursuit automata
+
+namespace cmd = boost::program_options;
+namespace pt  = boost::property_tree;
+
+using Environment = LA::LearningEnvironment< LA::Model::P >;
+
+/*=============================================================================
+
+ Experiment
+
+=============================================================================*/
+//
+// The parameters of the experiment are collected in one structure that is
+// shared by all runs.
+
+class Experiment
+{
+public:
+
+  LA::ActionIndex Actions;
+  double          Best, Second, Lowest, Threshold;
+  unsigned long   MaxIterations;
+  double          Reward, Penalty, Pursuit;
+  unsigned long   Resolution;
+
+  // The reward probabilities of a run have the best action at a position
+  // given by the run number.
+
+  std::vector< Probability< double > > RewardProbabilities(
+                                                  unsigned long Run ) const
+  {
+    std::vector< Probability< double > > Probabilities;
+    LA::ActionIndex BestAction = Run % Actions;
+
+    for ( LA::ActionIndex Action = 0, Other = 0; Action < Actions; Action++ )
+      if ( Action == BestAction )
+        Probabilities.emplace_back( Best );
+      else
+      {
+        double Fraction = ( Actions > 2 ) ?
+                          static_cast< double >( Other++ ) / ( Actions - 2 )
+                          : 0.0;
+
+        Probabilities.emplace_back( Second - Fraction * ( Second - Lowest ) );
+      }
+
+    return Probabilities;
+  }
+};
+
+// The result of one run is the number of iterations, if it converged, if it
+// converged to the best action, and the time used.
+
+class RunResult
+{
+public:
+
+  unsigned long Iterations;
+  bool          Converged, Correct;
+  double        Seconds;
+};
+
+using RunFunction = std::function< RunResult( const Experiment &,
+                                              unsigned long ) >;
+
+// A run creates the environment and the automaton and iterates until the
+// automaton has converged. The automaton type is a template parameter, and
+// the function to construct it from the environment and the experiment is
+// given as argument.
+
+template< class Automaton >
+RunFunction MakeRun(
+  std::function< Automaton * ( const Environment &, const Experiment & ) >
+  Create )
+{
+  return [=]( const Experiment & Parameters, unsigned long Run )->RunResult
+  {
+    Random::Generator.Stream( Run );
+
+    Environment TheEnvironment( Parameters.RewardProbabilities( Run ) );
+    std::unique_ptr< Automaton >
+      TheAutomaton( Create( TheEnvironment, Parameters ) );
+
+    RunResult Result{ 0, false, false, 0.0 };
+    auto Start = std::chrono::steady_clock::now();
+
+    while ( ( Result.Iterations < Parameters.MaxIterations ) &&
+            !Result.Converged )
+    {
+      auto Action = TheAutomaton->SelectAction();
+
+      TheAutomaton->Feedback( TheEnvironment.Evaluate( Action ) );
+      Result.Iterations++;
+
+      Result.Converged =
+        TheAutomaton->BestAction().second >= Parameters.Threshold;
+    }
+
+    Result.Seconds = std::chrono::duration< double >(
+                     std::chrono::steady_clock::now() - Start ).count();
+    Result.Correct = Result.Converged &&
+      ( TheAutomaton->BestAction().first == Run % Parameters.Actions );
+
+    return Result;
+  };
+}
+
+// The registry maps the algorithm names to their run functions
+
+std::map< std::string, RunFunction > Algorithms( void )
+{
+  using namespace LA;
+
+  std::map< std::string, RunFunction > Registry;
+
+  Registry.emplace( "LRI", MakeRun< LinearRI< Environment, Model::P > >(
+    []( const Environment & E, const Experiment & P ){
+      return new LinearRI< Environment, Model::P >( E, P.Reward ); } ) );
+
+  Registry.emplace( "LRP", MakeRun< LinearRP< Environment, Model::P > >(
+    []( const Environment & E, const Experiment & P ){
+      return new LinearRP< Environment, Model::P >( E, P.Reward, P.Penalty );
+    } ) );
+
+  Registry.emplace( "FixedLRP",
+    MakeRun< FixedLinearLA< Environment, LinearScheme::RewardPenalty > >(
+    []( const Environment & E, const Experiment & P ){
+      return new FixedLinearLA< Environment, LinearScheme::RewardPenalty >(
+                 E, P.Reward, P.Penalty ); } ) );
+
+  Registry.emplace( "DLRI", MakeRun< DiscreteLRI< Environment, Model::P > >(
+    []( const Environment & E, const Experiment & P ){
+      return new DiscreteLRI< Environment, Model::P >( E, P.Resolution ); } ) );
+
+  Registry.emplace( "CPRP", MakeRun< ContinuousPursuitRP< Environment > >(
+    []( const Environment & E, const Experiment & P ){
+      return new ContinuousPursuitRP< Environment >( E, P.Pursuit ); } ) );
+
+  Registry.emplace( "DPRP", MakeRun< DiscretePursuitRP< Environment > >(
+    []( const Environment & E, const Experiment & P ){
+      return new DiscretePursuitRP< Environment >( E, P.Resolution ); } ) );
+
+  return Registry;
+}
+
+// The runs of one algorithm are distributed over the threads by letting each
+// thread take the next run number until all runs are done. The results are
+// stored by run number so that they do not depend on the threads. If a run
+// throws, the remaining runs are skipped and the first error is thrown when
+// all threads have finished.
+
+pt::ptree RunAlgorithm( const RunFunction & Run, const Experiment & Parameters,
+                        unsigned long Runs, unsigned int Threads )
+{
+  std::vector< RunResult >     Results( Runs );
+  std::atomic< unsigned long > NextRun( 0 );
+  std::vector< std::thread >   Pool;
+  std::exception_ptr           Failure;
+  std::mutex                   FailureLock;
+
+  auto Start = std::chrono::steady_clock::now();
+
+  for ( unsigned int Thread = 0; Thread < Threads; Thread++ )
+    Pool.emplace_back( [&](){
+      try
+      {
+        for ( unsigned long TheRun = NextRun++; TheRun < Runs;
+              TheRun = NextRun++ )
+          Results[ TheRun ] = Run( Parameters, TheRun );
+      }
+      catch ( ... )
+      {
+        std::lock_guard< std::mutex > Lock( FailureLock );
+
+        if ( !Failure ) Failure = std::current_exception();
+        NextRun = Runs;
+      }
+    });
+
+  for ( std::thread & Worker : Pool )
+    Worker.join();
+
+  if ( Failure )
+    std::rethrow_exception( Failure );
+
+  double WallClock = std::chrono::duration< double >(
+                     std::chrono::steady_clock::now() - Start ).count();
+
+  // The statistics of the iterations are taken over the converged runs,
+  // and the update rate over all runs.
+
+  std::vector< unsigned long > Iterations;
+  unsigned long TotalIterations = 0, Correct = 0;
+  double        RunSeconds      = 0.0;
+
+  for ( const RunResult & Result : Results )
+  {
+    TotalIterations += Result.Iterations;
+    RunSeconds      += Result.Seconds;
+
+    if ( Result.Converged ) Iterations.push_back( Result.Iterations );
+    if ( Result.Correct   ) Correct++;
+  }
+
+  std::sort( Iterations.begin(), Iterations.end() );
+
+  auto Quantile = [&]( double q )->unsigned long {
+    return Iterations.empty() ? 0 :
+           Iterations[ static_cast< std::size_t >( q * ( Iterations.size()-1 ) ) ];
+  };
+
+  pt::ptree Entry, Distribution;
+
+  Distribution.put( "min",    Quantile( 0.0 ) );
+  Distribution.put( "p10",    Quantile( 0.1 ) );
+  Distribution.put( "median", Quantile( 0.5 ) );
+  Distribution.put( "p90",    Quantile( 0.9 ) );
+  Distribution.put( "max",    Quantile( 1.0 ) );
+  Distribution.put( "mean",   Iterations.empty() ? 0.0 :
+    std::accumulate( Iterations.begin(), Iterations.end(), 0.0 )
+    / Iterations.size() );
+
+  Entry.put( "runs",                 Runs );
+  Entry.put( "converged",            Iterations.size() );
+  Entry.put( "accuracy",             static_cast< double >( Correct ) / Runs );
+  Entry.add_child( "iterations",     Distribution );
+  Entry.put( "updates_per_second",
+             RunSeconds > 0.0 ? TotalIterations / RunSeconds : 0.0 );
+  Entry.put( "total_updates_per_second",
+             WallClock > 0.0 ? TotalIterations / WallClock : 0.0 );
+  Entry.put( "wall_clock_seconds",   WallClock );
+
+  return Entry;
+}
+
+/*=============================================================================
+
+ Main
+
+=============================================================================*/
+
+int main( int argc, char **argv )
+{
+  std::map< std::string, RunFunction > Registry( Algorithms() );
+  std::vector< std::string >           AllAlgorithms;
+
+  for ( const auto & Algorithm : Registry )
+    AllAlgorithms.push_back( Algorithm.first );
+
+  cmd::options_description Description("Allowed options");
+  cmd::variables_map Values;
+
+  Description.add_options()
+    ( "help,h",  "Produce this help message" )
+    ( "Algorithms,a", cmd::value< std::vector< std::string > >()->multitoken()
+                 ->default_value( AllAlgorithms, "all" ),
+                 "The algorithms to compare" )
+    ( "Actions,n", cmd::value< LA::ActionIndex >()->default_value(10),
+                 "Number of actions" )
+    ( "Best,b", cmd::value< double >()->default_value(0.8),
+                 "Reward probability of the best action" )
+    ( "Second,s", cmd::value< double >()->default_value(0.7),
+                 "Reward probability of the second best action" )
+    ( "Lowest,w", cmd::value< double >()->default_value(0.2),
+                 "Lowest reward probability" )
+    ( "Runs,R", cmd::value< unsigned long >()->default_value(1000),
+                 "Runs per algorithm" )
+    ( "Threshold,c", cmd::value< double >()->default_value(0.99),
+                 "Convergence threshold for the largest probability" )
+    ( "MaxIterations,m", cmd::value< unsigned long >()->default_value(100000),
+                 "Maximum iterations per run" )
+    ( "Reward,L", cmd::value< double >()->default_value(0.99),
+                 "Reward learning constant" )
+    ( "Penalty,P", cmd::value< double >()->default_value(0.99999),
+                 "Penalty learning constant" )
+    ( "Pursuit,u", cmd::value< double >()->default_value(0.01),
+                 "Pursuit learning constant" )
+    ( "Resolution,d", cmd::value< unsigned long >()->default_value(100),
+                 "Resolution of the discrete automata" )
+    ( "Threads,t", cmd::value< unsigned int >()->default_value(
+                 std::max( 1u, std::thread::hardware_concurrency() ) ),
+                 "Number of threads" )
+    ( "Seed,r", cmd::value< std::uint64_t >()->default_value(1),
+                 "Seed for the random generator" )
+    ( "Output,o", cmd::value< std::string >(),
+                 "File for the JSON results" );
+
+  try
+  {
+    cmd::store( cmd::parse_command_line( argc, argv, Description ), Values );
+
+    if ( Values.count("help") > 0 )
+    {
+      std::cout << Description << std::endl;
+      return EXIT_SUCCESS;
+    }
+
+    cmd::notify( Values );
+  }
+  catch ( std::exception & Error )
+  {
+    std::cout << Error.what() << std::endl << Description << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Experiment Parameters{
+    Values["Actions"].as< LA::ActionIndex >(),
+    Values["Best"].as< double >(), Values["Second"].as< double >(),
+    Values["Lowest"].as< double >(), Values["Threshold"].as< double >(),
+    Values["MaxIterations"].as< unsigned long >(),
+    Values["Reward"].as< double >(), Values["Penalty"].as< double >(),
+    Values["Pursuit"].as< double >(),
+    Values["Resolution"].as< unsigned long >() };
+
+  const unsigned long Runs    = Values["Runs"].as< unsigned long >();
+  const unsigned int  Threads = Values["Threads"].as< unsigned int >();
+  const std::uint64_t Seed    = Values["Seed"].as< std::uint64_t >();
+
+  if ( ( Parameters.Actions < 2 ) || ( Runs == 0 ) || ( Threads == 0 ) ||
+       !( ( 0.0 <= Parameters.Lowest ) &&
+          ( Parameters.Lowest <= Parameters.Second ) &&
+          ( Parameters.Second < Parameters.Best ) &&
+          ( Parameters.Best <= 1.0 ) ) )
+  {
+    std::cout << "There must be at least two actions, one run and one thread, "
+              << "and the reward probabilities must satisfy "
+              << "0 <= Lowest <= Second < Best <= 1" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Random::Generator.Seed( Seed );
+
+  pt::ptree Results, Setup, Comparison;
+
+  Setup.put( "actions",        Parameters.Actions );
+  Setup.put( "best",           Parameters.Best );
+  Setup.put( "second",         Parameters.Second );
+  Setup.put( "lowest",         Parameters.Lowest );
+  Setup.put( "threshold",      Parameters.Threshold );
+  Setup.put( "max_iterations", Parameters.MaxIterations );
+  Setup.put( "runs",           Runs );
+  Setup.put( "threads",        Threads );
+  Setup.put( "seed",           Seed );
+
+  for ( const std::string & Name :
+        Values["Algorithms"].as< std::vector< std::string > >() )
+  {
+    auto Algorithm = Registry.find( Name );
+
+    if ( Algorithm == Registry.end() )
+    {
+      std::cout << "Unknown algorithm " << Name << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    try
+    {
+      Comparison.add_child( Name,
+        RunAlgorithm( Algorithm->second, Parameters, Runs, Threads ) );
+    }
+    catch ( std::exception & Error )
+    {
+      std::cout << Name << ": " << Error.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  Results.add_child( "experiment", Setup );
+  Results.add_child( "algorithms", Comparison );
+
+  if ( Values.count("Output") > 0 )
+    pt::write_json( Values["Output"].as< std::string >(), Results );
+  else
+    pt::write_json( std::cout, Results );
+
+  return EXIT_SUCCESS;
+}
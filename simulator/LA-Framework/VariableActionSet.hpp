@@ -183,6 +183,26 @@ private:
   // arrived for the choice.
   
   double SelectedMass;
+  
+  // Actions can be withdrawn from and returned to the action set without 
+  // re-creating the automaton (see below). A withdrawn action keeps its index,
+  // but its probability is kept at zero until it is activated again.
+  
+  std::vector< bool > ActiveActions;
+  
+  // The withdrawn actions are kept in a free list so that a free action can 
+  // be found for a new element of the action set in constant time. The 
+  // position of each withdrawn action in this list is also recorded so that 
+  // a given action can be taken out of the free list in constant time by 
+  // moving the last free action into its place. Active actions have the 
+  // position of the end of the list, which is never a valid position.
+  
+  std::vector< ActionIndex > FreeActions, FreePosition;
+	
+  // The number of active actions is also maintained to avoid counting them 
+  // when an action is activated or withdrawn.
+  
+  ActionIndex ActiveCount;
 	
   // ---------------------------------------------------------------------------
   // Subset automaton
@@ -334,8 +354,7 @@ public:
 	
   virtual typename Environment::Action SelectAction( void ) override
   {
-    return 
-    Action( Random::Index( EmpiricalPDF( ActionProbabilities ) ) );
+    return VSSA_Base::SelectAction();
   }
   
 	// The function selecting an action takes a set of action indices,  selects
@@ -462,11 +481,15 @@ public:
   // automation was initialised. 
   // 
   // The update using the subset automaton will only happen if the selected 
-  // mass is larger than zero. 
+  // mass is larger than zero. Feedback arriving when there is no pending 
+  // selection, i.e. when the selection was dropped because the action set 
+  // changed, is silently ignored as there is nothing left to reward.
   
   virtual 
   void Feedback ( const typename Environment::Response & Response ) override
   {
+    if ( !SubsetAutomaton ) return;
+    
     // The response contains the full action set index, and the corresponding 
     // subset index must be identified. 
 
@@ -496,6 +519,22 @@ public:
 	    for ( ActionIndex index = 0; index < SubsetProbabilities.size(); index++ )
 	      ActionProbabilities[ SubsetIndexMap[ index ] ] = 
 	          SelectedMass * SubsetProbabilities.at( index );
+	    
+	    // The subset update may have given some probability to an action that 
+	    // has been withdrawn if the full action set was used for the update, 
+	    // and this mass is moved back to the active actions.
+	    
+	    double WithdrawnMass = 0.0;
+	    
+	    for ( ActionIndex index = 0; index < NumberOfActions; index++ )
+	      if ( !ActiveActions[ index ] )
+	      {
+	        WithdrawnMass += ActionProbabilities[ index ];
+	        ActionProbabilities[ index ] = 0.0;
+	      }
+	    
+	    if ( WithdrawnMass > 0.0 )
+	      Rescale( 1.0 / ( 1.0 - WithdrawnMass ) );
 		}
 		else
 		{
@@ -514,6 +553,227 @@ public:
 		}    
   }
   
+  // ---------------------------------------------------------------------------
+  // Changing the action set
+  // ---------------------------------------------------------------------------
+  // The number of actions is fixed by the environment when the automaton is 
+  // constructed. A changing action set can still be supported without creating
+  // a new automaton and copying the probabilities over, by allocating more 
+  // actions than needed and keep the unused ones withdrawn with zero 
+  // probability. Following Thathachar and Harita [1], the probabilities of the
+  // remaining actions are scaled up when an action is withdrawn, and scaled 
+  // down when an action is activated so that the relative order of the 
+  // probabilities of the other actions is preserved. 
+  //
+  // The first utility function scales the probabilities of the active actions 
+  // with the given factor.
+  
+private:
+  
+  void Rescale( double Factor )
+  {
+    for ( ActionIndex index = 0; index < NumberOfActions; index++ )
+      if ( ActiveActions[ index ] )
+        ActionProbabilities[ index ] *= Factor;
+  }
+  
+  // The free list is maintained by two helpers. Removing an action from the 
+  // free list moves the last free action into the position of the removed 
+  // action.
+  
+  void PushFree( ActionIndex TheAction )
+  {
+    FreePosition[ TheAction ] = FreeActions.size();
+    FreeActions.push_back( TheAction );
+  }
+  
+  void PopFree( ActionIndex TheAction )
+  {
+    ActionIndex Position = FreePosition[ TheAction ],
+                Moved    = FreeActions.back();
+    
+    FreeActions[ Position ] = Moved;
+    FreePosition[ Moved ]   = Position;
+    FreeActions.pop_back();
+    FreePosition[ TheAction ] = NumberOfActions;
+  }
+  
+  // Any pending selection from a subset must be updated when the probabilities
+  // change so that the feedback will write back probabilities consistent with
+  // the changed action set. The subset automaton is therefore re-initialised 
+  // with the current probabilities of the subset. If the subset has no mass 
+  // left, there is nothing to learn from a feedback and the selection is 
+  // dropped.
+  
+  void RefreshSelection( void )
+  {
+    if ( SubsetAutomaton )
+    {
+      std::vector< double > SelectedProbabilities;
+      SelectedMass = 0.0;
+      
+      for ( ActionIndex index : SubsetIndexMap )
+      {
+        SelectedProbabilities.push_back( ActionProbabilities[ index ] );
+        SelectedMass += ActionProbabilities[ index ];
+      }
+      
+      if ( SelectedMass < 10 * std::numeric_limits< double >::epsilon() )
+      {
+        SubsetAutomaton.reset();
+        SubsetIndexMap.clear();
+        SelectedMass = 0.0;
+      }
+      else
+        SubsetAutomaton->InitialiseProbabilities( 
+                         ProbabilityMass< double >( SelectedProbabilities ) );
+    }
+  }
+  
+  // A small helper throws if the given index is outside of the action set
+  
+  void ValidateIndex( ActionIndex TheAction ) const
+  {
+    if ( TheAction >= NumberOfActions )
+    {
+      std::ostringstream ErrorMessage;
+      
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "Action index " << TheAction << " is outside of the "
+                   << "action set of " << NumberOfActions << " actions";
+                   
+      throw std::out_of_range( ErrorMessage.str() );
+    }
+  }
+  
+public:
+  
+  // Activating an action assigns the given probability to the action, and 
+  // scales the probabilities of the other active actions to cover the 
+  // remaining probability mass. If there are no other active actions, the 
+  // activated action will get all the probability mass. 
+  
+  void ActivateAction( ActionIndex TheAction, double InitialProbability )
+  {
+    ValidateIndex( TheAction );
+    
+    if ( ActiveActions[ TheAction ] )
+    {
+      std::ostringstream ErrorMessage;
+      
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "Action " << TheAction << " is already active";
+                   
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+    
+    if ( !( InitialProbability > 0.0 && InitialProbability < 1.0 ) )
+    {
+      std::ostringstream ErrorMessage;
+      
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "The initial probability " << InitialProbability 
+                   << " of action " << TheAction << " must be in (0,1)";
+                   
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+    
+    // The active actions have unit probability mass unless there are no 
+    // active actions, and their probabilities are therefore just scaled with 
+    // the remaining mass.
+    
+    if ( ActiveCount == 0 )
+      InitialProbability = 1.0;
+    else
+      Rescale( 1.0 - InitialProbability );
+    
+    ActionProbabilities[ TheAction ] = InitialProbability;
+    ActiveActions[ TheAction ]       = true;
+    ActiveCount++;
+    PopFree( TheAction );
+    
+    RefreshSelection();
+  }
+  
+  // A new element of the action set can also be given any free action, and 
+  // the index of the activated action is returned. This index will remain 
+  // the index of the element until the action is withdrawn. A length error 
+  // is thrown if all actions are active, and then the automaton must be 
+  // re-created with more actions.
+  
+  ActionIndex AddAction( double InitialProbability )
+  {
+    if ( FreeActions.empty() )
+    {
+      std::ostringstream ErrorMessage;
+      
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "All " << NumberOfActions << " actions are active";
+                   
+      throw std::length_error( ErrorMessage.str() );
+    }
+    
+    ActionIndex TheAction = FreeActions.back();
+    
+    ActivateAction( TheAction, InitialProbability );
+    
+    return TheAction;
+  }
+  
+  // Withdrawing an action sets its probability to zero and distributes its 
+  // probability mass proportionally over the remaining active actions. Should
+  // the remaining actions have no probability mass, they will be given equal
+  // probabilities. Withdrawing an action already withdrawn has no effect.
+  
+  void WithdrawAction( ActionIndex TheAction )
+  {
+    ValidateIndex( TheAction );
+    
+    if ( ActiveActions[ TheAction ] )
+    {
+      // The remaining mass is known since the active actions have unit 
+      // probability mass, and the other probabilities can be scaled up 
+      // directly.
+      
+      double RemainingMass = 1.0 - ActionProbabilities[ TheAction ];
+      
+      ActionProbabilities[ TheAction ] = 0.0;
+      ActiveActions[ TheAction ]       = false;
+      ActiveCount--;
+      PushFree( TheAction );
+      
+      if ( RemainingMass > 10 * std::numeric_limits< double >::epsilon() )
+        Rescale( 1.0 / RemainingMass );
+      else if ( ActiveCount > 0 )
+        for ( ActionIndex index = 0; index < NumberOfActions; index++ )
+          if ( ActiveActions[ index ] )
+            ActionProbabilities[ index ] = 1.0 / ActiveCount;
+      
+      RefreshSelection();
+    }
+  }
+  
+  // It is also possible to test if an action is active and to read the 
+  // probability of a single action without copying the probability vector.
+  
+  inline bool IsActive( ActionIndex TheAction ) const
+  { 
+    ValidateIndex( TheAction );
+    return ActiveActions[ TheAction ]; 
+  }
+  
+  inline double ActionProbability( ActionIndex TheAction ) const
+  {
+    ValidateIndex( TheAction );
+    return ActionProbabilities[ TheAction ];
+  }
+  
+  inline ActionIndex ActiveActionCount( void ) const
+  { return ActiveCount; }
+  
+  inline ActionIndex FreeActionCount( void ) const
+  { return FreeActions.size(); }
+  
   // ---------------------------------------------------------------------------
   // Constructor and destructor
   // ---------------------------------------------------------------------------
@@ -542,8 +802,10 @@ public:
 										 SubSetLAArgumentTypes... SubSetLAArgumentValues )
   : LearningAutomata< Environment >( TheEnvironment ),
     VSSA_Base( TheEnvironment ),
-    SubsetIndexMap(), SelectedMass( 0 ),
-    SubsetAutomaton() 
+    SubsetIndexMap(), SelectedMass( 0 ), 
+    ActiveActions( NumberOfActions, true ), FreeActions(), 
+    FreePosition( NumberOfActions, NumberOfActions ), 
+    ActiveCount( NumberOfActions ), SubsetAutomaton() 
 	{
 		SubsetAutomataGenerator = std::make_shared< 
 		  AutomataGenerator< SubSetLAArgumentTypes... > >
@@ -64,6 +64,13 @@ using Constraint =
 
 using ConstraintValues = std::vector< VariableType >;
 
+// The solver asks for the values of all constraints at once and provides the
+// array to store them in. This is given to the constraint functions as a span
+// so that problems with many constraints, like one for every time slot, can
+// write the values directly without allocating a vector per evaluation.
+
+using ConstraintSpan = Span< VariableType >;
+
 // The basic constraints class maintains a vector of constraints. There is a 
 // function to add individual constraints and virtual functions to compute the 
 // constraints and the gradient of the constraints. 
@@ -170,6 +177,28 @@ protected:
 		}
 	}
 
+	// The values computed as a vector are copied to the span of the solver by
+	// a utility function that throws a logic error if the number of values 
+	// differs from the size of the span.
+
+	static void CopyValues( const ConstraintValues & Values, 
+													ConstraintSpan Destination )
+	{
+		if ( Values.size() == Destination.size() )
+			std::copy( Values.begin(), Values.end(), Destination.begin() );
+		else
+		{
+			std::ostringstream ErrorMessage;
+			
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+			             << Destination.size() << " constraint values were "
+									 << "expected, but " << Values.size() 
+									 << " values were computed.";
+									 
+		  throw std::logic_error( ErrorMessage.str() );
+		}
+	}
+
 	// The constructor simply initialises the function vector.
 
 public:
@@ -244,6 +273,7 @@ protected:
 	
 	using Constraints::Value;
 	using Constraints::NumberOfConstraints;
+	using Constraints::CopyValues;
 	
 	// The function to add the constraint function also requires the gradient 
 	// function when this class is used, and it returns a reference containing 
@@ -329,6 +359,33 @@ protected:
 		
 		return Gradients;
 	}
+
+	// The solver provides the memory for the gradient matrix, which is stored 
+	// in the same column order as Armadillo uses, and the matrix given to the 
+	// constraint functions is a fixed size matrix using this memory. A gradient
+	// matrix computed separately is copied into it after checking that it has 
+	// one row per variable and one column per constraint.
+
+	static void CopyGradients( const GradientMatrix & Gradients, 
+														 GradientMatrix & Destination )
+	{
+		if ( ( Gradients.n_rows == Destination.n_rows ) &&
+				 ( Gradients.n_cols == Destination.n_cols ) )
+			Destination = Gradients;
+		else
+		{
+			std::ostringstream ErrorMessage;
+			
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+			             << "A constraint gradient matrix of size "
+									 << Destination.n_rows << " times " << Destination.n_cols
+									 << " was expected, but a matrix of "
+									 << Gradients.n_rows << " times "
+									 << Gradients.n_cols << " values was computed";
+									 
+		  throw std::logic_error( ErrorMessage.str() );
+		}
+	}
 	
 	// The constructor simply initialises the gradient function vector
 	
@@ -388,6 +445,20 @@ protected:
 	virtual ConstraintValues 
 	InEqConstraintValue( const Variables & VariableValues )
 	{ return Value( VariableValues ); }
+
+	// The solver evaluates all the constraints in one call writing the values 
+	// into its own array, and by default the values of the vector version are
+	// copied. A problem with many constraints should override this version 
+	// to compute the values directly into the given span. The variable values
+	// are then the same as for the preceding evaluation of the objective 
+	// function, and intermediate results of that evaluation can be reused.
+	
+	virtual void 
+	InEqConstraintValue( VariableSpan VariableValues, ConstraintSpan Values )
+	{ 
+		CopyValues( InEqConstraintValue( 
+			Variables( VariableValues.begin(), VariableValues.end() ) ), Values );
+	}
 			
 public:
 	
@@ -435,6 +506,13 @@ protected:
 	ConstraintValues InEqConstraintValue( const Variables & VariableValues )
 	{ return Value( VariableValues ); }
 
+	virtual void 
+	InEqConstraintValue( VariableSpan VariableValues, ConstraintSpan Values )
+	{ 
+		CopyValues( InEqConstraintValue( 
+			Variables( VariableValues.begin(), VariableValues.end() ) ), Values );
+	}
+
 	// For the gradient, there are two options. One for the individual gradients
 	// and this can be well handled by the generic function but it is aliased 
 	// to make it explicit that it is an inequality constraint being computed,
@@ -447,6 +525,17 @@ protected:
 	virtual GradientMatrix 
 	InEqConstraintGradient( const Variables & VariableValues )
 	{ return GradientConstraints::Gradient( VariableValues ); }
+
+	// The matrix can also be filled directly in the memory of the solver, and 
+	// the default copies the matrix computed by the above function.
+
+	virtual void 
+	InEqConstraintGradient( VariableSpan VariableValues, 
+													GradientMatrix & Gradients )
+	{
+		CopyGradients( InEqConstraintGradient( 
+		  Variables( VariableValues.begin(), VariableValues.end() ) ), Gradients );
+	}
 	
 public:
 	
@@ -502,6 +591,13 @@ protected:
 	virtual ConstraintValues 
 	EqConstraintValue( const Variables & VariableValues )
 	{ return Value( VariableValues ); }
+
+	virtual void 
+	EqConstraintValue( VariableSpan VariableValues, ConstraintSpan Values )
+	{ 
+		CopyValues( EqConstraintValue( 
+			Variables( VariableValues.begin(), VariableValues.end() ) ), Values );
+	}
 	
 public:
 	
@@ -548,6 +644,13 @@ protected:
 	virtual ConstraintValues 
 	EqConstraintValue( const Variables & VariableValues )
 	{ return Value( VariableValues ); }
+
+	virtual void 
+	EqConstraintValue( VariableSpan VariableValues, ConstraintSpan Values )
+	{ 
+		CopyValues( EqConstraintValue( 
+			Variables( VariableValues.begin(), VariableValues.end() ) ), Values );
+	}
 	
 	// The gradient version are again similar to the inequality functions 
 	// where the gradient matrix function can be re-defined.
@@ -559,6 +662,14 @@ protected:
 	virtual GradientMatrix 
 	EqConstraintGradient( const Variables & VariableValues )
 	{ return Gradient( VariableValues ); }
+
+	virtual void 
+	EqConstraintGradient( VariableSpan VariableValues, 
+												GradientMatrix & Gradients )
+	{
+		CopyGradients( EqConstraintGradient( 
+		  Variables( VariableValues.begin(), VariableValues.end() ) ), Gradients );
+	}
 		
 public:
 	
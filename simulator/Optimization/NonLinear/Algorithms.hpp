@@ -193,6 +193,13 @@ public:
 		  case NLOPT_LN_NELDERMEAD:
 			case NLOPT_LN_SBPLX:
 		  case NLOPT_LD_SLSQP:
+			case NLOPT_LD_LBFGS:
+			case NLOPT_LD_VAR1:
+			case NLOPT_LD_VAR2:
+			case NLOPT_LD_TNEWTON:
+			case NLOPT_LD_TNEWTON_RESTART:
+			case NLOPT_LD_TNEWTON_PRECOND:
+			case NLOPT_LD_TNEWTON_PRECOND_RESTART:
 				Result = true;
 			  break;
 		  default:
@@ -409,6 +416,7 @@ public:
 		  case NLOPT_AUGLAG:
 			case NLOPT_AUGLAG_EQ:
 		    Result = true;
+		    break;
 	    default:
 			  Result = false;
 		};
@@ -482,7 +490,7 @@ public:
 	  // variants implemented: One aiming to minimize the use of memory to store
     // the approximations to the Hessian matrix, a variable metric algorithm,
 		// and several algorithms using a truncated version of Newton's algorithm.
-	  // All of these are for unconstrained problems.
+	  // All of these support only bound constraints.
 	  //
 	  // Finally, there is a quadratic programming method supporting both
 	  // inequality and equality constraints. This uses a dense matrix approach
@@ -562,6 +570,7 @@ public:
 		  case NLOPT_AUGLAG:
 			case NLOPT_AUGLAG_EQ:
 		    Result = true;
+		    break;
 	    default:
 			  Result = !IsGlobal( TheAlogorithm );
 		};
@@ -23,8 +23,15 @@ License: LGPL 3.0
 namespace Optimization::NonLinear
 {
 
+class OptimizerInterface;
+
 class Bound
 {
+	// The optimizer interface refreshes the bounds when it reuses a solver for
+	// a new problem of the same dimension.
+	
+	friend class OptimizerInterface;
+	
 protected:
 	
 	using Interval = boost::numeric::interval< VariableType >;
@@ -0,0 +1,63 @@
+/*==============================================================================
+Cancellation
+
+A search may run for a long time, and the result may become useless before
+the search has finished, for instance if the problem has changed or if the
+one requesting the solution is no longer interested. NLopt allows the search
+to be stopped from the objective function, but the objective function runs on
+the thread of the search and the decision to stop is taken by another thread.
+
+The cancellation token is a shared flag that can be set by any thread holding
+a copy of the token. The optimizer given the token tests the flag before each
+evaluation of the objective function, and if the token has been cancelled the
+search is forced to stop without evaluating the objective function again. The
+search then returns the best point evaluated so far with the forced stop
+status. The token can be reset so that it can be used for the next search,
+and copies of the token share the same flag.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef OPTIMIZATION_NON_LINEAR_CANCELLATION
+#define OPTIMIZATION_NON_LINEAR_CANCELLATION
+
+#include <atomic>                            // The shared flag
+#include <memory>                            // Sharing the flag
+
+namespace Optimization::NonLinear
+{
+
+class CancellationToken
+{
+private:
+
+  std::shared_ptr< std::atomic< bool > > Flag;
+
+public:
+
+  // Cancelling is done by the thread that decides that the search is no
+  // longer needed, and the flag is tested by the thread of the search.
+
+  inline void Cancel( void ) const
+  { Flag->store( true, std::memory_order_release ); }
+
+  inline bool IsCancelled( void ) const
+  { return Flag->load( std::memory_order_acquire ); }
+
+  inline void Reset( void ) const
+  { Flag->store( false, std::memory_order_release ); }
+
+  // The constructor creates a new flag that is not cancelled, and the copies
+  // share the flag of the token copied.
+
+  CancellationToken( void )
+  : Flag( std::make_shared< std::atomic< bool > >( false ) )
+  {}
+
+  CancellationToken( const CancellationToken & Other ) = default;
+  CancellationToken & operator= ( const CancellationToken & Other ) = default;
+};
+
+}      // Name space Optimization non-linear
+#endif // OPTIMIZATION_NON_LINEAR_CANCELLATION
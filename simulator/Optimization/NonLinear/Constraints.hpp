@@ -90,10 +90,11 @@ protected:
 	virtual Dimension NumberOfConstraints( void ) = 0;
 
 	// All constraint classes must be able to compute the constraints based on
-	// the variable values.
+	// the variable values. The values are written directly into the array of
+	// the solver given as a span.
 
-	virtual ConstraintValues
-	ComputeConstraints( const Variables & VariableValues ) = 0;
+	virtual void
+	ComputeConstraints( VariableSpan VariableValues, ConstraintSpan Values ) = 0;
 
 	// However, not all classes must be able to compute the gradients of the
 	// constraints, and this is therefore defined as a second function that
@@ -109,10 +110,13 @@ protected:
 	// stores the matrix in column order, and NLopt expects the value
 	// as one long vector with m blocks of n values. In other words, when
 	// reading out the matrix for NLopt column by column will be the most
-	// efficient for both packages.
+	// efficient for both packages. The memory layout is in fact identical, and
+	// the gradient matrix given is a fixed size matrix using the memory of the
+	// solver.
 
-	virtual GradientMatrix
-	ComputeGradients( const Variables & VariableValues ) = 0;
+	virtual void
+	ComputeGradients( VariableSpan VariableValues, 
+										GradientMatrix & Gradients ) = 0;
 
 	// --------------------------------------------------------------------------
 	// Mapper function
@@ -139,62 +143,25 @@ private:
 		VectorConstraintsIndirectionMapper * This =
 				 reinterpret_cast< VectorConstraintsIndirectionMapper * >( Parameters );
 
-		// Compute the values of the constraints
-
-		std::vector< double > VariableValues( Size );
-
-		for ( Dimension i = 0; i < Size; i++ )
-			VariableValues[i] = AssignedValues[i];
-
-		std::vector< double > Values = This->ComputeConstraints ( VariableValues	);
-
-		if ( Values.size() == ConstraintSize )
-			for ( Dimension i = 0; i < ConstraintSize; i++ )
-				ConstraintValues[i] = Values[i];
-		else
-		{
-			std::ostringstream ErrorMessage;
+		// The constraints are computed for all constraints in one call on the 
+		// arrays of NLopt, so that nothing is copied or allocated unless the 
+		// problem only defines the vector versions of the constraint functions.
 
-			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
-			             << ConstraintSize << " constraint values were expected, "
-									 << "but only " << Values.size() << " values were computed.";
+		VariableSpan VariableValues( AssignedValues, Size );
 
-		  throw std::logic_error( ErrorMessage.str() );
-		}
+		This->ComputeConstraints( VariableValues, 
+															ConstraintSpan( ConstraintValues, ConstraintSize ) );
 
 		// The constraint gradient values are then computed if the gradient pointer
 		// is given. For the derived classes supporting constraint gradients this
 		// will work as expected, otherwise a standard logical error will be thrown.
+		// The matrix uses the gradient array of NLopt as its fixed memory.
 
 		if ( Gradient != nullptr )
 		{
-			GradientMatrix GradientValues = This->ComputeGradients( VariableValues );
-
-			if ( ( GradientValues.n_cols == ConstraintSize ) &&
-				   ( GradientValues.n_rows == Size ) )
-		    for ( Dimension ConstraintIndex = 0;
-						  ConstraintIndex < ConstraintSize; ConstraintIndex++ )
-			  {
-					Dimension ConstraintOffset = ConstraintIndex * Size;
-
-					for ( Dimension VariableIndex = 0; VariableIndex < Size;
-							  VariableIndex++ )
-						Gradient[ ConstraintOffset + VariableIndex ]
-							= GradientValues( VariableIndex, ConstraintIndex );
-				}
-			else
-			{
-				std::ostringstream ErrorMessage;
+			GradientMatrix Gradients( Gradient, Size, ConstraintSize, false, true );
 
-				ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
-				             << "A constraint gradient matrix of size "
-										 << Size << " times " << ConstraintSize
-										 << "was expected, but a matrix of "
-										 << GradientValues.n_rows << " time "
-										 << GradientValues.n_cols << " values was computed";
-
-			  throw std::logic_error( ErrorMessage.str() );
-			}
+			This->ComputeGradients( VariableValues, Gradients );
 		}
 	}
 
@@ -372,16 +339,17 @@ private:
 	// mapper simply calls this function, and it should not be further
 	// overloaded.
 
-	virtual	ConstraintValues
-	ComputeConstraints( const Variables & VariableValues ) final
-  {	return InEqConstraintValue( VariableValues );	}
+	virtual	void
+	ComputeConstraints( VariableSpan VariableValues, ConstraintSpan Values ) final
+  {	InEqConstraintValue( VariableValues, Values );	}
 
 	// If the compute gradient function is called, then it is a sign that the
 	// wrong constraint class is used and an error should be thrown indicating
 	// that there is no support for gradients for the basic Inequality class.
 
-	virtual GradientMatrix
-	ComputeGradients( const Variables & VariableValues ) final
+	virtual void
+	ComputeGradients( VariableSpan VariableValues, 
+										GradientMatrix & Gradients ) final
 	{
 		std::ostringstream ErrorMessage;
 
@@ -426,16 +394,17 @@ private:
 	virtual Dimension NumberOfConstraints( void ) final
 	{ return NumberOfInEqConstraints(); }
 
-	virtual	ConstraintValues
-	ComputeConstraints( const Variables & VariableValues ) final
-  {	return InEqConstraintValue( VariableValues );	}
+	virtual	void
+	ComputeConstraints( VariableSpan VariableValues, ConstraintSpan Values ) final
+  {	InEqConstraintValue( VariableValues, Values );	}
 
   // The gradient computation function is in this case simply delegating
 	// the computation to the general function
 
-	virtual GradientMatrix
-	ComputeGradients( const Variables & VariableValues ) final
-	{	return InEqConstraintGradient( VariableValues );	}
+	virtual void
+	ComputeGradients( VariableSpan VariableValues, 
+										GradientMatrix & Gradients ) final
+	{	InEqConstraintGradient( VariableValues, Gradients );	}
 
 	// The function to set the constraints for the solver is again made accessible
 	// for derived classes
@@ -480,16 +449,17 @@ private:
 	// The function computing the constraints inherited from the indirection
 	// mapper simply calls the function defined for the equality constraints
 
-	virtual ConstraintValues
-	ComputeConstraints( const Variables & VariableValues ) final
-  { return EqConstraintValue( VariableValues );	}
+	virtual void
+	ComputeConstraints( VariableSpan VariableValues, ConstraintSpan Values ) final
+  { EqConstraintValue( VariableValues, Values );	}
 
 	// If the compute gradient function is called, then it is a sign that the
 	// wrong constraint class is used and an error should be thrown indicating
 	// that there is no support for gradients for the basic Inequality class.
 
-	virtual GradientMatrix
-	ComputeGradients( const Variables & VariableValues ) final
+	virtual void
+	ComputeGradients( VariableSpan VariableValues, 
+										GradientMatrix & Gradients ) final
 	{
 		std::ostringstream ErrorMessage;
 
@@ -535,17 +505,18 @@ private:
 
 	// The values are readily computed by the value function
 
-	virtual ConstraintValues
-	ComputeConstraints( const Variables & VariableValues ) final
-  { return EqConstraintValue( VariableValues );	}
+	virtual void
+	ComputeConstraints( VariableSpan VariableValues, ConstraintSpan Values ) final
+  { EqConstraintValue( VariableValues, Values );	}
 
   // The gradient function should be defined by one of the earlier classes or
   // the basic equality gradient function should be overloaded if direct
   // definitions of the gradient matrix is possible.
 
-  virtual GradientMatrix
-	ComputeGradients( const Variables & VariableValues ) final
-	{ return EqConstraintGradient( VariableValues ); }
+  virtual void
+	ComputeGradients( VariableSpan VariableValues, 
+										GradientMatrix & Gradients ) final
+	{ EqConstraintGradient( VariableValues, Gradients ); }
 
 protected:
 
@@ -0,0 +1,218 @@
+/*==============================================================================
+Convergence trace
+
+The optimizer returns only the final solution, and in order to tune the stop
+criteria of an algorithm, like the maximal number of evaluations or the
+tolerances, against a target latency it is necessary to know how the objective
+value decreased with the number of evaluations, and how much of the time was
+used by the objective function as opposed to the algorithm itself.
+
+The trace records for every evaluation of the objective function the time
+used by the evaluation, and for every n-th evaluation a trace point with the
+index of the evaluation, the time elapsed since the start of the search in
+nanoseconds, and the objective value. With n equal to one, which is the
+default, the full trace is recorded. The time used by the algorithm, the
+overhead, is the time of the search minus the time used by the objective
+function.
+
+The summary gives the number of evaluations, the time of the search, the time
+used by the objective function and the overhead, all in seconds, the
+percentiles of the evaluation latencies, and the smallest and largest
+objective values, one of which is the best depending on the direction. The
+trace can be exported as JSON with the summary and the trace points
+
+{
+  "summary": { "evaluations": <count>, "search_time": <seconds>,
+               "objective_time": <seconds>, "overhead": <seconds>,
+               "latency": { "p50": <seconds>, "p90": <seconds>,
+                            "p99": <seconds>, "max": <seconds> },
+               "min_value": <value>, "max_value": <value> },
+  "trace": [ [ <evaluation>, <nanoseconds>, <value> ], ... ]
+}
+
+or as CSV with one line per trace point after a header line.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef OPTIMIZATION_NON_LINEAR_CONVERGENCE_TRACE
+#define OPTIMIZATION_NON_LINEAR_CONVERGENCE_TRACE
+
+#include <vector>                            // Trace points and latencies
+#include <chrono>                            // Steady clock
+#include <cstddef>                           // Counters
+#include <cstdint>                           // Nanoseconds
+#include <algorithm>                         // Percentiles
+#include <numeric>                           // Sum of the latencies
+#include <limits>                            // The extreme values
+#include <cmath>                             // Percentile ranks
+#include <ostream>                           // Exporting the trace
+#include <sstream>                           // For error reporting
+#include <stdexcept>                         // For standard exceptions
+
+#include "../Variables.hpp"                  // Basic definitions
+
+namespace Optimization::NonLinear
+{
+
+class ConvergenceTrace
+{
+public:
+
+  using Clock = std::chrono::steady_clock;
+
+  struct TracePoint
+  {
+    std::size_t   Evaluation;
+    std::int64_t  Nanoseconds;
+    VariableType  Value;
+  };
+
+  struct Summary
+  {
+    std::size_t  Evaluations;
+    double       SearchTime, ObjectiveTime, Overhead;
+    double       P50, P90, P99, Max;
+    VariableType MinValue, MaxValue;
+  };
+
+private:
+
+  const std::size_t SamplingInterval;
+
+  std::vector< TracePoint > Points;
+  std::vector< double >     Latencies;
+  VariableType              MinValue, MaxValue;
+
+  Clock::time_point SearchStart;
+  Clock::duration   SearchTime;
+
+  // The percentile is the value at the rank ceil(p*n) of the sorted values
+
+  static double Percentile( const std::vector< double > & Sorted, double p )
+  {
+    if ( Sorted.empty() ) return 0.0;
+
+    std::size_t Rank = static_cast< std::size_t >(
+                       std::ceil( p * Sorted.size() ) );
+
+    return Sorted[ Rank > 0 ? Rank - 1 : 0 ];
+  }
+
+public:
+
+  // The search is started and stopped by the optimizer. Starting a search
+  // clears the trace of the previous search.
+
+  inline void Start( void )
+  {
+    Points.clear();
+    Latencies.clear();
+    MinValue    = std::numeric_limits< VariableType >::max();
+    MaxValue    = std::numeric_limits< VariableType >::lowest();
+    SearchTime  = Clock::duration::zero();
+    SearchStart = Clock::now();
+  }
+
+  inline void Stop( void )
+  { SearchTime = Clock::now() - SearchStart; }
+
+  // An evaluation is recorded with the time it started and the time it used
+
+  void Record( Clock::time_point EvaluationStart, Clock::duration Latency,
+               VariableType Value )
+  {
+    Latencies.push_back( std::chrono::duration< double >( Latency ).count() );
+    MinValue = std::min( MinValue, Value );
+    MaxValue = std::max( MaxValue, Value );
+
+    if ( ( Latencies.size() - 1 ) % SamplingInterval == 0 )
+      Points.push_back( TracePoint{ Latencies.size(),
+        std::chrono::duration_cast< std::chrono::nanoseconds >(
+          EvaluationStart + Latency - SearchStart ).count(), Value } );
+  }
+
+  inline const std::vector< TracePoint > & GetTrace( void ) const
+  { return Points; }
+
+  Summary GetSummary( void ) const
+  {
+    std::vector< double > Sorted( Latencies );
+    std::sort( Sorted.begin(), Sorted.end() );
+
+    double Search    = std::chrono::duration< double >( SearchTime ).count(),
+           Objective = std::accumulate( Sorted.begin(), Sorted.end(), 0.0 );
+
+    return Summary{ Sorted.size(), Search, Objective,
+                    std::max( Search - Objective, 0.0 ),
+                    Percentile( Sorted, 0.5 ), Percentile( Sorted, 0.9 ),
+                    Percentile( Sorted, 0.99 ),
+                    Sorted.empty() ? 0.0 : Sorted.back(), MinValue, MaxValue };
+  }
+
+  // Exporting the trace
+
+  void WriteJSON( std::ostream & Output ) const
+  {
+    Summary Totals( GetSummary() );
+
+    const auto Precision = Output.precision( 12 );
+
+    Output << "{\n  \"summary\": { "
+           << "\"evaluations\": " << Totals.Evaluations
+           << ", \"search_time\": " << Totals.SearchTime
+           << ", \"objective_time\": " << Totals.ObjectiveTime
+           << ", \"overhead\": " << Totals.Overhead << ",\n"
+           << "    \"latency\": { \"p50\": " << Totals.P50
+           << ", \"p90\": " << Totals.P90 << ", \"p99\": " << Totals.P99
+           << ", \"max\": " << Totals.Max << " },\n"
+           << "    \"min_value\": " << Totals.MinValue
+           << ", \"max_value\": " << Totals.MaxValue << " },\n"
+           << "  \"trace\": [";
+
+    for ( auto Point = Points.begin(); Point != Points.end(); ++Point )
+      Output << ( Point == Points.begin() ? "\n" : ",\n" )
+             << "    [ " << Point->Evaluation << ", " << Point->Nanoseconds
+             << ", " << Point->Value << " ]";
+
+    Output << "\n  ]\n}" << std::endl;
+
+    Output.precision( Precision );
+  }
+
+  void WriteCSV( std::ostream & Output ) const
+  {
+    const auto Precision = Output.precision( 12 );
+
+    Output << "evaluation,nanoseconds,value\n";
+
+    for ( const TracePoint & Point : Points )
+      Output << Point.Evaluation << "," << Point.Nanoseconds << ","
+             << Point.Value << "\n";
+
+    Output.precision( Precision );
+  }
+
+  // The constructor takes the sampling interval, which must be positive
+
+  ConvergenceTrace( std::size_t EveryNth = 1 )
+  : SamplingInterval( EveryNth ), Points(), Latencies(),
+    MinValue( std::numeric_limits< VariableType >::max() ),
+    MaxValue( std::numeric_limits< VariableType >::lowest() ),
+    SearchStart( Clock::now() ), SearchTime( Clock::duration::zero() )
+  {
+    if ( EveryNth == 0 )
+    {
+      std::ostringstream ErrorMessage;
+
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "The sampling interval of the trace must be positive";
+
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+  }
+};
+
+}      // Name space Optimization non-linear
+#endif // OPTIMIZATION_NON_LINEAR_CONVERGENCE_TRACE
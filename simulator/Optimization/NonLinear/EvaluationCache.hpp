@@ -0,0 +1,205 @@
+/*==============================================================================
+Evaluation cache
+
+The derivative free local algorithms, like BOBYQA, COBYLA and the simplex
+methods, often evaluate the objective function again for points they have
+already evaluated, for instance when a step is clipped to a bound, or for
+points that differ so little that the objective function cannot distinguish
+them. The latter is the case when the objective function rounds its
+variables, like start times rounded to whole seconds. If the evaluation of the
+objective function is expensive, it is worth remembering the values of the
+points evaluated.
+
+The cache maps the variable values quantised to a given quantum to the
+objective value of the first point evaluated in the cell of the quantised
+values. A point in the same cell is then given this value without evaluating
+the objective function. The cell of a value is the largest multiple of the
+quantum not larger than the value, i.e. the value is truncated to the
+quantum. The cells must line up with how the objective function rounds its
+variables, otherwise two points in the same cell may be evaluated as
+different points by the objective function. The quantum must therefore be a
+whole multiple of the resolution of the objective function, and for an
+objective function that truncates its variables, like start times converted
+to whole seconds, it should be the same as the resolution. If the quantum is
+zero, only identical points are found in the cache.
+
+The cache is bounded, and when it is full the oldest point is forgotten to
+make room for the new point. The numbers of points found (hits) and not found
+(misses) in the cache are counted so that the saving can be assessed.
+
+The cache is the largest workspace of a memoised optimizer, and its keys and
+values are allocated from a given memory resource so that the application can
+account for the memory used by the cache.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef OPTIMIZATION_NON_LINEAR_EVALUATION_CACHE
+#define OPTIMIZATION_NON_LINEAR_EVALUATION_CACHE
+
+#include <vector>                            // Quantised keys
+#include <unordered_map>                     // The cached values
+#include <memory_resource>                   // Allocating the workspace
+#include <optional>                          // Values that may be cached
+#include <cmath>                             // Truncating to the quantum
+#include <cstdint>                           // Integer keys
+#include <cstring>                           // Bits of exact keys
+#include <cstddef>                           // Sizes and counters
+#include <sstream>                           // For error reporting
+#include <stdexcept>                         // For standard exceptions
+
+#include "../Variables.hpp"                  // Basic definitions
+
+namespace Optimization::NonLinear
+{
+
+class EvaluationCache
+{
+public:
+
+  // The statistics are returned as a small structure
+
+  struct Statistics
+  {
+    std::size_t Hits, Misses;
+  };
+
+private:
+
+  using Key = std::pmr::vector< std::int64_t >;
+
+  // The hash of the key combines the hashes of the elements as done by the
+  // Boost hash combine function.
+
+  struct KeyHash
+  {
+    std::size_t operator() ( const Key & TheKey ) const
+    {
+      std::size_t Seed = TheKey.size();
+
+      for ( std::int64_t Element : TheKey )
+        Seed ^= std::hash< std::int64_t >()( Element ) + 0x9e3779b9
+                + ( Seed << 6 ) + ( Seed >> 2 );
+
+      return Seed;
+    }
+  };
+
+  const VariableType Quantum;
+  const std::size_t  Capacity;
+
+  std::pmr::unordered_map< Key, VariableType, KeyHash > Values;
+
+  // The keys are also kept in the order they were inserted in a circular
+  // buffer so that the oldest key can be found when the cache is full.
+
+  std::pmr::vector< Key > Order;
+  std::size_t             Oldest;
+
+  Statistics Counters;
+
+  // The quantised key of a point is the index of its cell, or the bits of
+  // the values if the quantum is zero. The index is found by truncation
+  // towards minus infinity so that a cell covers the values from its
+  // multiple of the quantum up to the next multiple.
+
+  Key Quantise( VariableSpan VariableValues ) const
+  {
+    Key TheKey( VariableValues.size(), Order.get_allocator() );
+
+    for ( Dimension i = 0; i < VariableValues.size(); i++ )
+      if ( Quantum > 0 )
+        TheKey[i] = static_cast< std::int64_t >(
+                    std::floor( VariableValues[i] / Quantum ) );
+      else
+        std::memcpy( &TheKey[i], &VariableValues[i], sizeof( std::int64_t ) );
+
+    return TheKey;
+  }
+
+public:
+
+  // Looking up a point returns the cached value if there is one, and counts
+  // the hit or the miss.
+
+  std::optional< VariableType > Find( VariableSpan VariableValues )
+  {
+    auto Cached = Values.find( Quantise( VariableValues ) );
+
+    if ( Cached != Values.end() )
+    {
+      Counters.Hits++;
+      return Cached->second;
+    }
+    else
+    {
+      Counters.Misses++;
+      return std::optional< VariableType >();
+    }
+  }
+
+  // Storing a value replaces the oldest value if the cache is full
+
+  void Store( VariableSpan VariableValues, VariableType ObjectiveValue )
+  {
+    Key TheKey( Quantise( VariableValues ) );
+
+    if ( Values.find( TheKey ) != Values.end() ) return;
+
+    if ( Order.size() < Capacity )
+      Order.push_back( TheKey );
+    else
+    {
+      Values.erase( Order[ Oldest ] );
+      Order[ Oldest ] = TheKey;
+      Oldest = ( Oldest + 1 ) % Capacity;
+    }
+
+    Values.emplace( std::move( TheKey ), ObjectiveValue );
+  }
+
+  // The cached values must be forgotten if the objective function changes,
+  // but the counters are kept.
+
+  void Clear( void )
+  {
+    Values.clear();
+    Order.clear();
+    Oldest = 0;
+  }
+
+  inline Statistics GetStatistics( void ) const
+  { return Counters; }
+
+  // The constructor takes the quantum, the capacity, and optionally the
+  // memory resource of the cache. It throws if the quantum is negative or if
+  // the capacity is zero.
+
+  EvaluationCache( VariableType TheQuantum, std::size_t TheCapacity,
+                   std::pmr::memory_resource * Workspace
+                     = std::pmr::get_default_resource() )
+  : Quantum( TheQuantum ), Capacity( TheCapacity ), Values( Workspace ), 
+    Order( Workspace ), Oldest(0), Counters{ 0, 0 }
+  {
+    if ( !( TheQuantum >= 0 ) || ( TheCapacity == 0 ) )
+    {
+      std::ostringstream ErrorMessage;
+
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "The evaluation cache needs a non-negative quantum "
+                   << "and a positive capacity. Given quantum " << TheQuantum
+                   << " and capacity " << TheCapacity;
+
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+
+    Values.reserve( TheCapacity );
+    Order.reserve( TheCapacity );
+  }
+
+  EvaluationCache( void ) = delete;
+};
+
+}      // Name space Optimization non-linear
+#endif // OPTIMIZATION_NON_LINEAR_EVALUATION_CACHE
@@ -29,10 +29,17 @@ License: LGPL 3.0
 #include <sstream>                            // For error reporting
 #include <stdexcept>                          // For standard exceptions
 #include <type_traits>                        // For meta programming
+#include <memory>                             // For the evaluation cache
+#include <optional>                           // For the cancellation token
+#include <cmath>                              // For the huge value
+#include <algorithm>                          // Comparing variable values
 
 #include "../Variables.hpp"                   // Basic definitions
 #include "../Objective.hpp"                   // Objective function
 #include "NonLinear/Algorithms.hpp"           // Non-linear definitions
+#include "NonLinear/EvaluationCache.hpp"      // Memoised objective values
+#include "NonLinear/ConvergenceTrace.hpp"     // Evaluation trace
+#include "NonLinear/Cancellation.hpp"         // Cancelling a search
 
 #include <nlopt.h>                            // The C-style interface
 
@@ -59,8 +66,8 @@ protected:
 	// called, it is an indication that the derived problem definition has
 	// not been correctly done.
 
-	virtual GradientVector
-	ComputeGradient( const Variables & VariableValues )
+	virtual void
+	ComputeGradient( VariableSpan VariableValues, GradientSpan GradientValues )
 	{
 		std::ostringstream ErrorMessage;
 
@@ -72,10 +79,78 @@ protected:
 	  throw std::logic_error( ErrorMessage.str() );
 	}
 
-	// The mapper function takes a vector of variable values and evaluates the
+	// The objective values can optionally be memoised by an evaluation cache.
+	// The cache is only used when the gradient is not requested since the
+	// gradient is not cached. It is created by the optimizer if memoisation 
+	// is enabled.
+
+	std::unique_ptr< EvaluationCache > Memo;
+
+	// The evaluations can also be traced if the optimizer has enabled tracing
+
+	std::unique_ptr< ConvergenceTrace > Trace;
+
+	// A search can be cancelled from another thread by a cancellation token 
+	// that is tested before each evaluation. The search is stopped by the 
+	// optimizer through the following function, and the objective is not 
+	// evaluated for the point given by the algorithm. Instead the worst 
+	// possible value for the direction of the search is returned so that this
+	// point is not taken as the best point. The best point evaluated so far is
+	// therefore recorded when the search can be cancelled.
+
+	std::optional< CancellationToken > Cancellation;
+
+	virtual void CancelSearch( void )
+	{ }
+
+	Goal      SearchDirection;
+	Variables BestVariables;
+	double    BestValue;
+
+	inline bool Better( double Value ) const
+	{
+		return ( SearchDirection == Goal::Minimize ) ? ( Value < BestValue )
+																								 : ( Value > BestValue );
+	}
+
+	inline void RecordBest( VariableSpan VariableValues, double Value )
+	{
+		if ( BestVariables.empty() || Better( Value ) )
+		{
+			BestVariables.assign( VariableValues.begin(), VariableValues.end() );
+			BestValue = Value;
+		}
+	}
+
+	// The objective value is computed by a helper function that uses the 
+	// cache if it exists and the gradient is not needed.
+
+	inline double MemoisedObjective( VariableSpan VariableValues, 
+																	 bool GradientNeeded )
+	{
+		if ( Memo && !GradientNeeded )
+		{
+			auto Cached = Memo->Find( VariableValues );
+
+			if ( Cached )
+				return *Cached;
+
+			double Value = ObjectiveFunction( VariableValues );
+
+			Memo->Store( VariableValues, Value );
+			return Value;
+		}
+
+		return ObjectiveFunction( VariableValues );
+	}
+
+	// The mapper function takes the array of variable values and evaluates the
 	// objective function for these. It is assumed that the Parameters is only
 	// a pointer to this objective class, and a static cast to this has to be
-	// used since only static casts are supported from void pointers.
+	// used since only static casts are supported from void pointers. The 
+	// arrays of NLopt are given to the objective and gradient functions as 
+	// spans so that nothing is allocated or copied unless the problem only 
+	// defines the vector versions of these functions.
 
 	static double IndirectionMapper(
 		unsigned int Size,       const double * ArgumentValues,
@@ -86,27 +161,83 @@ protected:
 		ObjectiveInterface *
 		This = reinterpret_cast< ObjectiveInterface * >( Parameters );
 
-		// Setting the variable values based on the given arguments.
+		VariableSpan VariableValues( ArgumentValues, Size );
+
+		// A cancelled search is stopped without evaluating the objective, and 
+		// otherwise the best value is recorded if the search can be cancelled.
+
+		if ( This->Cancellation )
+		{
+			if ( This->Cancellation->IsCancelled() )
+			{
+				This->CancelSearch();
+				return ( This->SearchDirection == Goal::Minimize ) ? HUGE_VAL 
+																													 : -HUGE_VAL;
+			}
+
+			double Value = This->EvaluatePoint( VariableValues, GradientValues );
+
+			This->RecordBest( VariableValues, Value );
+			return Value;
+		}
 
-		Variables VariableValues( Size );
+		return This->EvaluatePoint( VariableValues, GradientValues );
+	}
 
-		for ( Dimension i = 0; i < Size; i++ )
-			VariableValues[i] = ArgumentValues[i];
+	// The solver evaluates the constraints for the same variable values as 
+	// the objective function, normally right after the objective function. A 
+	// problem whose constraints share intermediate results with the objective 
+	// function, like the consumption in each time slot, can keep these results
+	// from the objective function and reuse them in the constraint functions 
+	// if the constraints are evaluated for the variable values of the last 
+	// evaluation of the objective function. These values are therefore kept, 
+	// and the test is available to the derived problem.
 
-		// Compute the gradient values if the gradient pointer is not null
+	Variables LastVariables;
 
-		if ( GradientValues != nullptr )
+	inline bool IsLastEvaluated( VariableSpan VariableValues ) const
+	{
+		return ( VariableValues.size() == LastVariables.size() ) &&
+					 std::equal( VariableValues.begin(), VariableValues.end(), 
+											 LastVariables.begin() );
+	}
+
+	// The evaluation of a point computes the gradient if it is needed and the 
+	// objective value, which may be found in the cache of evaluated points if 
+	// the gradient is not needed. The time of the evaluation, including the 
+	// gradient, is recorded if the evaluations are traced. The values are 
+	// recorded as the last evaluated after the evaluation so that they match
+	// the state of the objective function.
+
+	inline double EvaluatePoint( VariableSpan VariableValues, 
+															 double * GradientValues )
+	{
+		const auto Size = VariableValues.size();
+		double Value;
+
+		if ( Trace )
 		{
-			GradientVector
-			Gradient( This->ComputeGradient( VariableValues ) );
+			auto Start = ConvergenceTrace::Clock::now();
+
+			if ( GradientValues != nullptr )
+				ComputeGradient( VariableValues, 
+												 GradientSpan( GradientValues, Size ) );
+
+			Value = MemoisedObjective( VariableValues, GradientValues != nullptr );
 
-			for ( Dimension i = 0; i < Size; i++ )
-				GradientValues[i] = Gradient[i];
+			Trace->Record( Start, ConvergenceTrace::Clock::now() - Start, Value );
 		}
+		else
+		{
+			if ( GradientValues != nullptr )
+				ComputeGradient( VariableValues, 
+												 GradientSpan( GradientValues, Size ) );
 
-		// Compute and return the objective function value
+			Value = MemoisedObjective( VariableValues, GradientValues != nullptr );
+		}
 
-		return This->ObjectiveFunction( VariableValues );
+		LastVariables.assign( VariableValues.begin(), VariableValues.end() );
+		return Value;
 	}
 
 	// There are functions to set the objective function for a solver, both
@@ -115,6 +246,8 @@ protected:
 	inline void SetObjective( SolverPointer Solver,
 														Goal Direction = Goal::Minimize )
 	{
+		SearchDirection = Direction;
+
 		switch( Direction )
 		{
 			case Goal::Minimize:
@@ -128,6 +261,12 @@ protected:
 
 public:
 
+	ObjectiveInterface( void )
+	: Optimization::Objective(), Memo(), Trace(), Cancellation(),
+	  SearchDirection( Goal::Minimize ), BestVariables(), BestValue( 0.0 ),
+	  LastVariables()
+	{}
+
 	virtual ~ObjectiveInterface( void )
 	{}
 };
@@ -140,7 +279,7 @@ template< Algorithm::ID OptimizerAlgorithm >
 class Objective< OptimizerAlgorithm,
   std::enable_if_t< !Algorithm::RequiresGradient( OptimizerAlgorithm ) > >
 : virtual public Optimization::Objective,
-  public ObjectiveInterface
+  virtual public ObjectiveInterface
 {
 protected:
 
@@ -177,10 +316,11 @@ protected:
 	// The compute gradient function should not be overloaded by any other class
 	// and it is therefore declared final.
 
-	virtual GradientVector
-	ComputeGradient( const Variables & VariableValues ) final
+	virtual void
+	ComputeGradient( VariableSpan VariableValues, 
+									 GradientSpan GradientValues ) final
 	{
-		return GradientFunction( VariableValues );
+		GradientFunction( VariableValues, GradientValues );
 	}
 
 	Objective( void )
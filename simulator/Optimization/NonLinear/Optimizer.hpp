@@ -13,12 +13,15 @@ License: LGPL 3.0
 #define OPTIMIZATION_NON_LINEAR_OPTIMIZER
 
 #include <cerrno>                            // System error codes
+#include <cmath>                             // Absolute step sizes
+#include <algorithm>                         // Smallest step sizes
 #include <chrono>                            // Search time limit in seconds
 #include <map>                               // To ignore some errors
 #include <optional>                          // For values that may not be set
 #include <string>                            // Strings
 #include <system_error>                      // Error categories
 #include <vector>                            // For variables and values
+#include <memory_resource>                   // Allocating the memoisation cache
 
 #include <boost/numeric/conversion/cast.hpp> // Casting numeric types
 #include <nlopt.h>                           // The C-style interface
@@ -26,6 +29,8 @@ License: LGPL 3.0
 #include "../Variables.hpp"                  // Basic definitions
 #include "NonLinear/Algorithms.hpp"          // Definition of the algorithms
 #include "NonLinear/Objective.hpp"           // Objective function
+#include "NonLinear/Bounds.hpp"              // Refreshing reused solvers
+#include "Utility/ProfilerAnnotations.hpp"   // Optional profiler zones
 
 namespace Optimization::NonLinear
 {
@@ -70,6 +75,40 @@ private:
 
   SolverPointer Solver;
 
+  // The direction of the objective is remembered so that a solver is only
+  // reused for a problem with the same direction as the one it was created 
+  // for.
+
+  Objective::Goal SolverDirection;
+
+  // ---------------------------------------------------------------------------
+  // Warm start
+  // ---------------------------------------------------------------------------
+  //
+  // The local algorithms start from a trust region or a simplex whose size is
+  // given by the initial step of each variable. NLopt sets the initial step 
+  // heuristically from the bounds, and when a sequence of similar problems is 
+  // solved this may be much larger than the distance the solution moves from
+  // one problem to the next. With the warm start, the initial step of a 
+  // search is the absolute change of each variable in the previous search of 
+  // the same dimension. It is limited from below by a fraction of the default
+  // step since a variable that did not move in the previous search may need 
+  // to move in the next one, and from above by the default step since the 
+  // bounds may have changed. The steps are forgotten when a new solver is 
+  // created.
+
+  bool WarmStarting;
+  std::vector< double > PreviousStep;
+
+  static constexpr double MinimumStepFraction = 0.01;
+
+  // A search refining the solution of a related problem, for instance one
+  // solved on a coarser grid, can also be given the initial steps of its
+  // next search explicitly. They are limited by the default steps in the
+  // same way and used only once.
+
+  std::vector< double > NextStep;
+
 protected:
 
   // Derived classes should define the algorithms they support in case it is
@@ -123,6 +162,9 @@ protected:
     if( Solver != nullptr )
       DeleteSolver();
 
+    SolverDirection = Direction;
+    PreviousStep.clear();
+
     if ( GetAlgorithm() < Algorithm::ID::MaxNumber )
       Solver = nlopt_create( static_cast< nlopt_algorithm >( GetAlgorithm() ),
                              NumberOfVariables );
@@ -150,6 +192,30 @@ protected:
     }
   }
 
+  // Creating the solver is costly for a sequence of problems of the same
+  // dimension since the objective function, the bounds, the constraints, the
+  // tolerances and the limits must all be registered again. A solver can 
+  // therefore be prepared for a new problem by reusing the existing solver if 
+  // it has the right dimension and direction, in which case only the bounds 
+  // are refreshed since they typically change with the problem. The 
+  // tolerances and limits set on the existing solver are kept. Otherwise a 
+  // new solver is created.
+
+  inline SolverPointer PrepareSolver( Dimension NumberOfVariables,
+                       Objective::Goal Direction = Objective::Goal::Minimize )
+  {
+    if ( ( Solver != nullptr ) && ( GetDimension() == NumberOfVariables ) &&
+         ( SolverDirection == Direction ) )
+    {
+      if ( Bound * Bounded = dynamic_cast< Bound * >( this ) )
+        Bounded->SetBounds( Solver );
+
+      return Solver;
+    }
+    else
+      return CreateSolver( NumberOfVariables, Direction );
+  }
+
   // ---------------------------------------------------------------------------
   // Error handling
   // ---------------------------------------------------------------------------
@@ -715,6 +781,25 @@ protected:
     return Timeout;
   }
 
+  // The search can also be stopped from the objective function, for instance
+  // if an external deadline has passed. The solver will then return the
+  // forced stop status when the current evaluation of the objective function
+  // returns. It is not an error to call this if there is no solver.
+
+  inline void ForceStop( void )
+  {
+    if ( Solver != nullptr )
+    {
+      nlopt_result Result = nlopt_force_stop( Solver );
+      CheckStatus( Result, "Forcing the search to stop" );
+    }
+  }
+
+  // A cancelled search is stopped in the same way
+
+  virtual void CancelSearch( void ) override
+  { ForceStop(); }
+
   // ---------------------------------------------------------------------------
   // Finding a solution
   // ---------------------------------------------------------------------------
@@ -751,27 +836,122 @@ protected:
   virtual
   OptimalSolution FindSolution( const Variables & InitialVariableValues )
   {
+    THERON_PROFILE_ZONE_DETAIL( "Optimizer::FindSolution", 
+                                GetAlgorithmName() );
+
     // Create the solver if it has not already been done. Note that it uses the
     // default choice of minimization. If the objective should be maximized,
     // the solver should separately be created by a call to the create solver
     // before this function is invoked.
 
-    if ( !Solver )
+    if ( GetDimension() != InitialVariableValues.size() )
       CreateSolver( InitialVariableValues.size() );
 
+    // Values memoised by a previous search may no longer be valid
+
+    if ( Memo )
+      Memo->Clear();
+
     // The search for the optimal values starts from the initial variables
 
     Variables OptimalValues( InitialVariableValues );
     double ObjectiveValue = ObjectiveFunction( InitialVariableValues );
 
+    // If the search can be cancelled, the initial values are the best values 
+    // so far, and if it has already been cancelled there is no need to start 
+    // the solver.
+
+    if ( Cancellation )
+    {
+      BestVariables = InitialVariableValues;
+      BestValue     = ObjectiveValue;
+
+      if ( Cancellation->IsCancelled() )
+        return OptimalSolution( BestVariables, BestValue, NLOPT_FORCED_STOP );
+    }
+
     // The solver is invoked to change these values for the optimal
     // solution
 
+    // With the warm start the step set for the previous search is first 
+    // removed so that NLopt gives the default step for the current bounds, 
+    // and the steps of the previous search are then limited by the default 
+    // step.
+
+    if ( WarmStarting && ( PreviousStep.size() == OptimalValues.size() ) )
+    {
+      std::vector< double > Step( OptimalValues.size() );
+
+      CheckStatus( nlopt_set_initial_step( Solver, nullptr ),
+                   "Resetting the initial step" );
+      CheckStatus( nlopt_get_initial_step( Solver, OptimalValues.data(), 
+                                           Step.data() ),
+                   "Getting the default initial step" );
+
+      for ( Dimension i = 0; i < Step.size(); i++ )
+        Step[i] = std::clamp( PreviousStep[i], MinimumStepFraction * Step[i],
+                              Step[i] );
+
+      CheckStatus( nlopt_set_initial_step( Solver, Step.data() ),
+                   "Setting the warm start initial step" );
+    }
+
+    // The explicit steps for this search take precedence over the warm 
+    // start steps.
+
+    if ( NextStep.size() == OptimalValues.size() )
+    {
+      std::vector< double > Step( OptimalValues.size() );
+
+      CheckStatus( nlopt_set_initial_step( Solver, nullptr ),
+                   "Resetting the initial step" );
+      CheckStatus( nlopt_get_initial_step( Solver, OptimalValues.data(), 
+                                           Step.data() ),
+                   "Getting the default initial step" );
+
+      for ( Dimension i = 0; i < Step.size(); i++ )
+        Step[i] = std::clamp( NextStep[i], MinimumStepFraction * Step[i],
+                              Step[i] );
+
+      CheckStatus( nlopt_set_initial_step( Solver, Step.data() ),
+                   "Setting the explicit initial step" );
+    }
+
+    if ( Trace )
+      Trace->Start();
+
     nlopt_result Result = nlopt_optimize( Solver, OptimalValues.data(),
                                           &ObjectiveValue );
 
+    if ( Trace )
+      Trace->Stop();
+
+    if ( !NextStep.empty() )
+    {
+      NextStep.clear();
+
+      if ( !WarmStarting )
+        CheckStatus( nlopt_set_initial_step( Solver, nullptr ),
+                     "Resetting the initial step" );
+    }
+
+    if ( WarmStarting )
+    {
+      PreviousStep.resize( OptimalValues.size() );
+
+      for ( Dimension i = 0; i < OptimalValues.size(); i++ )
+        PreviousStep[i] = std::abs( OptimalValues[i] 
+                                    - InitialVariableValues[i] );
+    }
+
     // The result can then be returned as an optimal solution leaving the
-    // decision about the obtained result to the caller.
+    // decision about the obtained result to the caller. If the search was 
+    // cancelled, the best values evaluated are returned since the values 
+    // returned by the algorithm may be the last point given to the objective.
+
+    if ( ( Result == NLOPT_FORCED_STOP ) && Cancellation && 
+         Cancellation->IsCancelled() )
+      return OptimalSolution( BestVariables, BestValue, Result );
 
     return OptimalSolution( OptimalValues, ObjectiveValue, Result );
   }
@@ -792,7 +972,8 @@ protected:
                    { NLOPT_XTOL_REACHED, NLOPT_XTOL_REACHED },
                    { NLOPT_MAXEVAL_REACHED, NLOPT_MAXEVAL_REACHED },
                    { NLOPT_MAXTIME_REACHED, NLOPT_MAXTIME_REACHED } }),
-    Solver( nullptr )
+    Solver( nullptr ), SolverDirection( Objective::Goal::Minimize ),
+    WarmStarting( false ), PreviousStep(), NextStep()
   {}
 
   // The destructor allows the correct destruction of all the polymorphic
@@ -800,6 +981,100 @@ protected:
 
 public:
 
+  // ---------------------------------------------------------------------------
+  // Memoisation
+  // ---------------------------------------------------------------------------
+  //
+  // The values of the objective function can be memoised for points whose
+  // variable values are equal when quantised to the given quantum. This is
+  // useful for the derivative free algorithms if the objective function is
+  // expensive and it does not distinguish points closer than the quantum.
+  // Memoisation is disabled by default, and a quantum of zero memoises only
+  // identical points. The statistics are empty if memoisation is disabled.
+  // The cache is allocated from the given memory resource, which could be an
+  // account of the memory used by the optimizer.
+
+  static constexpr std::size_t DefaultMemoCapacity = 4096;
+
+  inline void Memoise( VariableType Quantum, 
+                       std::size_t Capacity = DefaultMemoCapacity,
+                       std::pmr::memory_resource * Workspace 
+                         = std::pmr::get_default_resource() )
+  { Memo = std::make_unique< EvaluationCache >( Quantum, Capacity, Workspace ); }
+
+  inline void StopMemoising( void )
+  { Memo.reset(); }
+
+  inline std::optional< EvaluationCache::Statistics > 
+  MemoisationStatistics( void ) const
+  {
+    if ( Memo )
+      return Memo->GetStatistics();
+    else
+      return std::optional< EvaluationCache::Statistics >();
+  }
+
+  // The warm start is disabled by default, and it is only useful for the 
+  // local algorithms that take an initial step. Disabling the warm start 
+  // forgets the steps, and NLopt will again use its default steps.
+
+  inline void WarmStartSteps( bool Enable = true )
+  {
+    WarmStarting = Enable;
+
+    if ( !Enable )
+    {
+      PreviousStep.clear();
+
+      if ( Solver != nullptr )
+        CheckStatus( nlopt_set_initial_step( Solver, nullptr ),
+                     "Resetting the initial step" );
+    }
+  }
+
+  // The initial steps of the next search are given for all variables, and 
+  // they are ignored if the next search has a different dimension.
+
+  inline void InitialStep( const std::vector< double > & Steps )
+  { NextStep = Steps; }
+
+  // ---------------------------------------------------------------------------
+  // Cancellation
+  // ---------------------------------------------------------------------------
+  //
+  // A search can be cancelled from another thread through a cancellation 
+  // token given to the optimizer. The search will then stop before the next
+  // evaluation of the objective function and return the best values so far
+  // with the forced stop status. The token is not reset by the optimizer, 
+  // and the one cancelling the search should reset it before it is used for
+  // the next search.
+
+  inline void CancelWith( const CancellationToken & Token )
+  { Cancellation = Token; }
+
+  inline void StopCancelling( void )
+  { Cancellation.reset(); }
+
+  // ---------------------------------------------------------------------------
+  // Tracing
+  // ---------------------------------------------------------------------------
+  //
+  // The evaluations of the objective function by the algorithm can be traced
+  // to see how the objective value evolves with the number of evaluations and
+  // with time, and how the time is shared between the objective function and
+  // the algorithm. Every n-th evaluation is stored as a trace point, and the 
+  // trace is reset by every search. Tracing is disabled by default, and the 
+  // trace pointer is null if tracing is not enabled.
+
+  inline void TraceEvaluations( std::size_t EveryNth = 1 )
+  { Trace = std::make_unique< ConvergenceTrace >( EveryNth ); }
+
+  inline void StopTracing( void )
+  { Trace.reset(); }
+
+  inline const ConvergenceTrace * GetTrace( void ) const
+  { return Trace.get(); }
+
   virtual ~OptimizerInterface( void )
   {
     DeleteSolver();
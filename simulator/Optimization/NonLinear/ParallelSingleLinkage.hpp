@@ -0,0 +1,545 @@
+/*==============================================================================
+Parallel Single Linkage
+
+The Multi-Level Single-Linkage algorithm [1] samples random points in the
+variable domain and starts a local search from the sampled points that are not
+close to a better sampled point or to a local optimum already found. The local
+searches are independent of each other, but NLopt runs them one after the
+other in the thread calling the optimizer, and an expensive objective function
+will then make the global search take a long time even if there are many cores
+available.
+
+This driver therefore implements the sampling and the clustering of the
+multi-level single linkage algorithm itself, and dispatches the local searches
+from the starting points selected in a round concurrently over a number of
+worker threads. Each worker has its own instance of the objective function
+created by a factory, as for the portfolio of algorithms, so that the
+evaluators need not be thread safe as long as they do not share mutable state.
+The sampled points of a round are also evaluated concurrently by the workers.
+
+A sampled point x of value f(x) is used as starting point if it has not been
+used before, if there is no sampled point y with f(y) < f(x) within the
+critical distance r of x, and if there is no local optimum found within the
+critical distance of x. The critical distance after k rounds of N samples is
+computed in the variable domain scaled to the unit cube as [1]
+
+  r = ( Gamma(1 + n/2) * sigma * log(kN) / (kN) )^(1/n) / sqrt(pi)
+
+where n is the number of variables and sigma = 2 as in NLopt. The critical
+distance shrinks as more points are sampled, and the number of local searches
+started in each round therefore decreases as the search proceeds. The search
+stops when the total number of evaluations reaches the given limit, or when
+the optional deadline has passed, and the local searches running are then
+forced to stop at their next evaluation of the objective function.
+
+StoGo also runs many local searches, but they are started from the boxes of its
+branch and bound partitioning inside NLopt, and they cannot be dispatched from
+the outside. The driver can be used instead of both algorithms when the
+objective is expensive, and the local algorithm must not require the gradient
+since the evaluators return only the objective value. The local algorithm must
+support bounds on the variables. Only minimisation is supported.
+
+References:
+
+[1] A. H. G. Rinnooy Kan and G. T. Timmer, "Stochastic global optimization
+    methods, part II: Multi level methods," Mathematical Programming, vol. 39,
+    pp. 57-78, 1987
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef OPTIMIZATION_NON_LINEAR_PARALLEL_SINGLE_LINKAGE
+#define OPTIMIZATION_NON_LINEAR_PARALLEL_SINGLE_LINKAGE
+
+#include <algorithm>                          // Sorting the starting points
+#include <atomic>                             // Shared evaluation budget
+#include <chrono>                             // Deadline
+#include <cmath>                              // Critical distance
+#include <cstddef>                            // Evaluation counters
+#include <exception>                          // Passing errors from threads
+#include <functional>                         // Evaluators
+#include <limits>                             // Largest objective value
+#include <memory>                             // Local search objects
+#include <optional>                           // Deadline
+#include <random>                             // Sampling the domain
+#include <sstream>                            // For error reporting
+#include <stdexcept>                          // For standard exceptions
+#include <thread>                             // Worker threads
+#include <utility>                            // Local solutions
+#include <vector>                             // Variables and samples
+
+#include <boost/numeric/interval.hpp>         // Variable domains
+#include <nlopt.h>                            // The C-style interface
+
+#include "../Variables.hpp"                   // Basic definitions
+#include "NonLinear/Algorithms.hpp"           // Definition of the algorithms
+#include "NonLinear/Optimizer.hpp"            // Optimizer interface
+
+namespace Optimization::NonLinear
+{
+
+template< Algorithm::ID LocalAlgorithm >
+class ParallelSingleLinkage
+{
+  static_assert( !Algorithm::RequiresGradient( LocalAlgorithm ),
+    "The local algorithm of the parallel single linkage cannot use gradients");
+
+public:
+
+  using Clock            = std::chrono::steady_clock;
+  using Interval         = boost::numeric::interval< VariableType >;
+  using Evaluator        = std::function< VariableType( const Variables & ) >;
+  using EvaluatorFactory = std::function< Evaluator( void ) >;
+
+  // ---------------------------------------------------------------------------
+  // Budget
+  // ---------------------------------------------------------------------------
+  //
+  // The evaluations made by all the workers are counted against the common
+  // limit, and the budget is exhausted when the limit is reached or when the
+  // deadline has passed.
+
+private:
+
+  class Budget
+  {
+  private:
+
+    const std::size_t                        Limit;
+    const std::optional< Clock::time_point > Deadline;
+    std::atomic< std::size_t >               Evaluations;
+
+  public:
+
+    inline void Count( void )
+    { Evaluations.fetch_add( 1, std::memory_order_relaxed ); }
+
+    inline std::size_t Used( void ) const
+    { return Evaluations.load( std::memory_order_relaxed ); }
+
+    inline bool Expired( void ) const
+    { return Deadline && ( Clock::now() >= *Deadline ); }
+
+    inline bool Exhausted( void ) const
+    { return ( Used() >= Limit ) || Expired(); }
+
+    Budget( std::size_t EvaluationLimit,
+            const std::optional< Clock::time_point > & TheDeadline )
+    : Limit( EvaluationLimit ), Deadline( TheDeadline ), Evaluations(0)
+    {}
+  };
+
+  // ---------------------------------------------------------------------------
+  // Local search
+  // ---------------------------------------------------------------------------
+  //
+  // A local search is an optimizer for the local algorithm whose objective
+  // function evaluates the evaluator of the worker running the search, counts
+  // the evaluation, and forces the algorithm to stop if the budget has been
+  // exhausted. Each worker reuses its local search object, and the solver is
+  // therefore created only for the first search of the worker.
+
+  class LocalSearch : public Optimizer< LocalAlgorithm >
+  {
+  private:
+
+    Budget &                        TheBudget;
+    const Evaluator &               Objective;
+    const std::vector< Interval > & Bounds;
+
+  protected:
+
+    virtual VariableType
+    ObjectiveFunction( const Variables & VariableValues ) override
+    {
+      VariableType Value = Objective( VariableValues );
+
+      TheBudget.Count();
+
+      if ( TheBudget.Exhausted() )
+        this->ForceStop();
+
+      return Value;
+    }
+
+    virtual std::vector< Interval > BoundConstraints( void ) override
+    { return Bounds; }
+
+  public:
+
+    OptimizerInterface::OptimalSolution
+    Run( const Variables & InitialValues, double ObjectiveTolerance,
+         double VariableTolerance, int MaxEvaluations )
+    {
+      if ( this->GetDimension() != InitialValues.size() )
+      {
+        this->CreateSolver( InitialValues.size(),
+                            Optimization::Objective::Goal::Minimize );
+
+        if ( ObjectiveTolerance > 0.0 )
+          this->RelativeObjectiveValueTolerance( ObjectiveTolerance );
+
+        if ( VariableTolerance > 0.0 )
+          this->RelativeVariableValueTolerance( VariableTolerance );
+
+        if ( MaxEvaluations > 0 )
+          this->MaxNumberOfEvaluations( MaxEvaluations );
+      }
+
+      return this->FindSolution( InitialValues );
+    }
+
+    template< class... OptimizerArguments >
+    LocalSearch( Budget & TheSharedBudget, const Evaluator & TheObjective,
+                 const std::vector< Interval > & VariableBounds,
+                 OptimizerArguments... Arguments )
+    : Optimizer< LocalAlgorithm >( Arguments... ),
+      TheBudget( TheSharedBudget ), Objective( TheObjective ),
+      Bounds( VariableBounds )
+    {}
+
+    virtual ~LocalSearch( void )
+    {}
+  };
+
+  // The local searches are created by a function storing the arguments of the
+  // optimizer constructor given to the constructor of the driver.
+
+  using LocalSearchFactory = std::function< std::unique_ptr< LocalSearch >(
+    Budget &, const Evaluator &, const std::vector< Interval > & ) >;
+
+  LocalSearchFactory NewLocalSearch;
+
+  // ---------------------------------------------------------------------------
+  // Samples
+  // ---------------------------------------------------------------------------
+  //
+  // The sampled points are remembered with their coordinates scaled to the
+  // unit cube so that the distances are comparable over all variables, and
+  // a flag telling if a local search has been started from the point. The
+  // local optima found are kept in the same scaled coordinates.
+
+  struct Sample
+  {
+    Variables    Values, Scaled;
+    VariableType Value;
+    bool         Started;
+  };
+
+  static Variables Scale( const Variables & Values,
+                          const std::vector< Interval > & Bounds )
+  {
+    Variables Scaled( Values.size() );
+
+    for ( Dimension i = 0; i < Values.size(); i++ )
+      Scaled[i] = ( boost::numeric::width( Bounds[i] ) > 0 )
+                  ? ( Values[i] - Bounds[i].lower() )
+                    / boost::numeric::width( Bounds[i] )
+                  : 0.0;
+
+    return Scaled;
+  }
+
+  static double SquaredDistance( const Variables & x, const Variables & y )
+  {
+    double Sum = 0.0;
+
+    for ( Dimension i = 0; i < x.size(); i++ )
+      Sum += ( x[i] - y[i] ) * ( x[i] - y[i] );
+
+    return Sum;
+  }
+
+  // The critical distance depends on the total number of samples
+
+  static double CriticalDistance( Dimension NumberOfVariables,
+                                  std::size_t NumberOfSamples )
+  {
+    const double n     = static_cast< double >( NumberOfVariables ),
+                 kN    = static_cast< double >( NumberOfSamples ),
+                 Sigma = 2.0;
+
+    return std::pow( std::tgamma( 1.0 + n / 2.0 ) * Sigma * std::log( kN ) / kN,
+                     1.0 / n ) / std::sqrt( M_PI );
+  }
+
+  // ---------------------------------------------------------------------------
+  // Workers
+  // ---------------------------------------------------------------------------
+  //
+  // A round of work is a number of tasks taken by the workers in the order of
+  // their indices. The workers are started for each round and joined when all
+  // the tasks have been taken, and an exception thrown by a task is passed
+  // on to the caller when all the workers have terminated.
+
+  template< class Task >
+  static void Dispatch( std::size_t NumberOfTasks, unsigned int Threads,
+                        const Task & DoTask )
+  {
+    Threads = static_cast< unsigned int >(
+              std::min< std::size_t >( Threads, NumberOfTasks ) );
+
+    std::atomic< std::size_t >        NextTask(0);
+    std::vector< std::exception_ptr > Errors( Threads );
+    std::vector< std::thread >        Workers;
+
+    for ( unsigned int Worker = 0; Worker < Threads; Worker++ )
+      Workers.emplace_back( [&,Worker](void){
+        try
+        {
+          for ( std::size_t TheTask = NextTask++; TheTask < NumberOfTasks;
+                TheTask = NextTask++ )
+            DoTask( Worker, TheTask );
+        }
+        catch (...)
+        {
+          Errors[ Worker ] = std::current_exception();
+        }
+      });
+
+    for ( std::thread & TheWorker : Workers )
+      TheWorker.join();
+
+    for ( std::exception_ptr & Error : Errors )
+      if ( Error ) std::rethrow_exception( Error );
+  }
+
+  // ---------------------------------------------------------------------------
+  // Parameters
+  // ---------------------------------------------------------------------------
+
+  const std::size_t  SamplesPerRound;
+  const unsigned int NumberOfThreads;
+  const double       LocalObjectiveTolerance,
+                     LocalVariableTolerance;
+  const int          LocalEvaluationLimit;
+  std::mt19937_64    Random;
+
+public:
+
+  // The outcome of the search is the best solution found, the status, and
+  // counters for the effort spent. The status is the maximum evaluations
+  // status if the evaluation limit stopped the search, and the forced stop
+  // status if the deadline stopped it.
+
+  class Outcome
+  {
+  public:
+
+    Variables    VariableValues;
+    VariableType ObjectiveValue;
+    nlopt_result Status;
+    std::size_t  Evaluations, Rounds, LocalSearches;
+  };
+
+  // The solve function samples the domain given by the bounds in rounds, and
+  // runs the local searches of each round concurrently with one evaluator per
+  // worker thread until the evaluation limit is reached or the deadline has
+  // passed.
+
+  Outcome Solve( const std::vector< Interval > & Bounds,
+                 const EvaluatorFactory & NewEvaluator,
+                 std::size_t EvaluationLimit,
+                 const std::optional< Clock::time_point > & Deadline
+                   = std::optional< Clock::time_point >() )
+  {
+    if ( Bounds.empty() || ( EvaluationLimit == 0 ) )
+    {
+      std::ostringstream ErrorMessage;
+
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "The parallel single linkage needs at least one "
+                   << "variable and a positive evaluation limit";
+
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+
+    const Dimension NumberOfVariables = Bounds.size();
+
+    Budget TheBudget( EvaluationLimit, Deadline );
+
+    // The evaluators and the local searches of the workers are created in
+    // the calling thread since the factory may not be thread safe.
+
+    std::vector< Evaluator >                      Evaluators;
+    std::vector< std::unique_ptr< LocalSearch > > Searches;
+
+    for ( unsigned int Worker = 0; Worker < NumberOfThreads; Worker++ )
+      Evaluators.push_back( NewEvaluator() );
+
+    for ( unsigned int Worker = 0; Worker < NumberOfThreads; Worker++ )
+      Searches.push_back( NewLocalSearch( TheBudget, Evaluators[ Worker ],
+                                          Bounds ) );
+
+    std::vector< Sample >    Samples;
+    std::vector< Variables > Optima;
+
+    Outcome Result;
+
+    Result.ObjectiveValue = std::numeric_limits< VariableType >::max();
+    Result.Rounds         = 0;
+    Result.LocalSearches  = 0;
+
+    while ( !TheBudget.Exhausted() )
+    {
+      Result.Rounds++;
+
+      // The new samples are drawn uniformly in the domain and evaluated
+      // concurrently.
+
+      const std::size_t FirstNew = Samples.size();
+
+      for ( std::size_t i = 0; i < SamplesPerRound; i++ )
+      {
+        Sample NewSample;
+
+        NewSample.Values.resize( NumberOfVariables );
+
+        for ( Dimension j = 0; j < NumberOfVariables; j++ )
+          NewSample.Values[j] = std::uniform_real_distribution< VariableType >(
+                                Bounds[j].lower(), Bounds[j].upper() )( Random );
+
+        NewSample.Scaled    = Scale( NewSample.Values, Bounds );
+        NewSample.Value     = std::numeric_limits< VariableType >::max();
+        NewSample.Started   = false;
+
+        Samples.push_back( std::move( NewSample ) );
+      }
+
+      Dispatch( SamplesPerRound, NumberOfThreads,
+        [&]( unsigned int Worker, std::size_t Task ){
+          if ( TheBudget.Exhausted() ) return;
+
+          Sample & TheSample = Samples[ FirstNew + Task ];
+
+          TheSample.Value = Evaluators[ Worker ]( TheSample.Values );
+          TheBudget.Count();
+        });
+
+      for ( std::size_t i = FirstNew; i < Samples.size(); i++ )
+        if ( Samples[i].Value < Result.ObjectiveValue )
+        {
+          Result.VariableValues = Samples[i].Values;
+          Result.ObjectiveValue = Samples[i].Value;
+        }
+
+      if ( TheBudget.Exhausted() ) break;
+
+      // The starting points are the samples not yet used that have no better
+      // sample and no local optimum within the critical distance. They are
+      // sorted so that the best points are searched first.
+
+      const double Radius  = CriticalDistance( NumberOfVariables,
+                                               Samples.size() ),
+                   Radius2 = Radius * Radius;
+
+      std::vector< std::size_t > Starts;
+
+      for ( std::size_t i = 0; i < Samples.size(); i++ )
+        if ( !Samples[i].Started )
+        {
+          bool Selected = std::none_of( Samples.begin(), Samples.end(),
+            [&]( const Sample & Other ){
+              return ( Other.Value < Samples[i].Value ) &&
+                     ( SquaredDistance( Other.Scaled, Samples[i].Scaled )
+                       < Radius2 ); }) &&
+            std::none_of( Optima.begin(), Optima.end(),
+            [&]( const Variables & Optimum ){
+              return SquaredDistance( Optimum, Samples[i].Scaled ) < Radius2;
+            });
+
+          if ( Selected )
+          {
+            Samples[i].Started = true;
+            Starts.push_back( i );
+          }
+        }
+
+      std::sort( Starts.begin(), Starts.end(),
+        [&]( std::size_t a, std::size_t b ){
+          return Samples[a].Value < Samples[b].Value; });
+
+      // The local searches are run concurrently, and the solutions are
+      // stored by the index of the starting point so that they can be
+      // recorded in the calling thread when all the searches have finished.
+
+      std::vector< std::optional< std::pair< Variables, VariableType > > >
+        Solutions( Starts.size() );
+
+      Dispatch( Starts.size(), NumberOfThreads,
+        [&]( unsigned int Worker, std::size_t Task ){
+          if ( TheBudget.Exhausted() ) return;
+
+          auto Solution = Searches[ Worker ]->Run(
+                          Samples[ Starts[ Task ] ].Values,
+                          LocalObjectiveTolerance, LocalVariableTolerance,
+                          LocalEvaluationLimit );
+
+          Solutions[ Task ] = std::make_pair( Solution.VariableValues,
+                                              Solution.ObjectiveValue );
+        });
+
+      for ( auto & Solution : Solutions )
+        if ( Solution )
+        {
+          Result.LocalSearches++;
+          Optima.push_back( Scale( Solution->first, Bounds ) );
+
+          if ( Solution->second < Result.ObjectiveValue )
+          {
+            Result.VariableValues = Solution->first;
+            Result.ObjectiveValue = Solution->second;
+          }
+        }
+    }
+
+    Result.Evaluations = TheBudget.Used();
+    Result.Status      = TheBudget.Expired() ? NLOPT_FORCED_STOP
+                                             : NLOPT_MAXEVAL_REACHED;
+
+    return Result;
+  }
+
+  // The constructor takes the number of samples drawn in each round, the
+  // number of worker threads, where zero means one per hardware thread, the
+  // relative tolerances and the evaluation limit of each local search, which
+  // are not set if they are zero, the seed of the random sampling, and the
+  // arguments for the constructor of the local optimizer.
+
+  template< class... OptimizerArguments >
+  ParallelSingleLinkage( std::size_t Samples, unsigned int Threads = 0,
+                         double ObjectiveTolerance = 0.0,
+                         double VariableTolerance = 0.0,
+                         int MaxLocalEvaluations = 0,
+                         std::mt19937_64::result_type Seed = 1,
+                         OptimizerArguments... Arguments )
+  : NewLocalSearch(
+      [=]( Budget & TheBudget, const Evaluator & TheObjective,
+           const std::vector< Interval > & Bounds )
+      { return std::make_unique< LocalSearch >( TheBudget, TheObjective,
+                                                Bounds, Arguments... ); }),
+    SamplesPerRound( Samples ),
+    NumberOfThreads( Threads > 0 ? Threads
+                     : std::max( 1U, std::thread::hardware_concurrency() ) ),
+    LocalObjectiveTolerance( ObjectiveTolerance ),
+    LocalVariableTolerance( VariableTolerance ),
+    LocalEvaluationLimit( MaxLocalEvaluations ), Random( Seed )
+  {
+    if ( Samples == 0 )
+    {
+      std::ostringstream ErrorMessage;
+
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "The parallel single linkage must sample at least one "
+                   << "point in each round";
+
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+  }
+
+  ParallelSingleLinkage( void ) = delete;
+};
+
+}      // End name space Optimization non-linear
+#endif // OPTIMIZATION_NON_LINEAR_PARALLEL_SINGLE_LINKAGE
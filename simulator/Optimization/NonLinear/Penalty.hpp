@@ -90,7 +90,7 @@ private:
 
   using InEq       = NonLinear::InEqConstraints< PrimaryAlgorithm >;
 	using Eq         = NonLinear::EqConstraints< PrimaryAlgorithm >;
-	using MultiLevel = MultiLevel< PrimaryAlgorithm, SubsidiaryAlgorithm >;
+	using MultiLevelBase = MultiLevel< PrimaryAlgorithm, SubsidiaryAlgorithm >;
 
 protected:
 
@@ -101,13 +101,15 @@ protected:
 								              Optimization::Objective::Goal Direction) override
 	{
 		SolverPointer TheSolver =
-	                MultiLevel::CreateSolver( NumberOfVariables, Direction );
+	                MultiLevelBase::CreateSolver( NumberOfVariables, Direction );
 
     if ( InEq::NumberOfInEqConstraints() > 0 )
-      SetInEqConstraints( TheSolver, MultiLevel::GetVariableTolerance() );
+      InEq::SetInEqConstraints( TheSolver,
+                                MultiLevelBase::GetVariableTolerance() );
 
     if ( Eq::NumberOfEqConstraints() > 0 )
-      SetEqConstraints( TheSolver, MultiLevel::GetVariableTolerance() );
+      Eq::SetEqConstraints( TheSolver,
+                            MultiLevelBase::GetVariableTolerance() );
 
     return TheSolver;
 	}
@@ -117,7 +119,7 @@ protected:
 
 	LagrangianSolver( double ObjectiveTolerance = 0.0,
                     double VariableTolerance  = 0.0 )
-	: InEq(),  Eq(),	MultiLevel( ObjectiveTolerance, VariableTolerance )
+	: InEq(),  Eq(),	MultiLevelBase( ObjectiveTolerance, VariableTolerance )
 	{}
 
 public:
@@ -0,0 +1,358 @@
+/*==============================================================================
+Portfolio
+
+No single algorithm is the best for all problems, and for a given problem it
+is often not known in advance which algorithm will converge first. A portfolio
+runs a few algorithms concurrently on the same problem as a race. Each
+algorithm runs in its own thread on its own instance of the objective function,
+and all evaluations are recorded in a best-so-far solution shared by all the
+racing algorithms. The first algorithm to terminate by its own stopping
+criteria wins the race, and the other algorithms are then forced to stop at
+their next evaluation of the objective function. The race can also be given a
+deadline after which all algorithms are forced to stop. The result of the race
+is the best solution evaluated by any of the algorithms.
+
+The objective function is given as a factory producing one evaluator for each
+algorithm so that the evaluators need not be thread safe as long as they do
+not share mutable state. The algorithms are added to the portfolio with the
+arguments of their optimizer constructors, and they must all support bounds on
+the variables. Note that some NLopt algorithms use a random generator that is
+only thread safe if NLopt has been compiled with thread local storage.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef OPTIMIZATION_NON_LINEAR_PORTFOLIO
+#define OPTIMIZATION_NON_LINEAR_PORTFOLIO
+
+#include <atomic>                             // Race termination
+#include <chrono>                             // Deadline
+#include <cstddef>                            // Evaluation counters
+#include <exception>                          // Passing errors from threads
+#include <functional>                         // Evaluators and entries
+#include <limits>                             // Largest objective value
+#include <mutex>                              // Shared best solution
+#include <optional>                           // Deadline and winner
+#include <sstream>                            // For error reporting
+#include <stdexcept>                          // For standard exceptions
+#include <thread>                             // Racing algorithms
+#include <vector>                             // Variables and entries
+
+#include <boost/numeric/interval.hpp>         // Variable domains
+#include <nlopt.h>                            // The C-style interface
+
+#include "../Variables.hpp"                   // Basic definitions
+#include "NonLinear/Algorithms.hpp"           // Definition of the algorithms
+#include "NonLinear/Optimizer.hpp"            // Optimizer interface
+
+namespace Optimization::NonLinear
+{
+
+class Portfolio
+{
+public:
+
+  using Clock            = std::chrono::steady_clock;
+  using Interval         = boost::numeric::interval< VariableType >;
+  using Evaluator        = std::function< VariableType( const Variables & ) >;
+  using EvaluatorFactory = std::function< Evaluator( void ) >;
+
+  // ---------------------------------------------------------------------------
+  // Race
+  // ---------------------------------------------------------------------------
+  //
+  // The race holds the shared best solution protected by a lock, and the
+  // flag telling the algorithms to stop. The winner is the first algorithm
+  // terminating by itself.
+
+private:
+
+  class Race
+  {
+  private:
+
+    std::mutex                         Lock;
+    Variables                          BestValues;
+    VariableType                       BestObjective;
+    std::atomic< bool >                Finished;
+    std::optional< Clock::time_point > Deadline;
+    std::optional< Algorithm::ID >     Winner;
+    nlopt_result                       WinnerStatus;
+
+  public:
+
+    inline void Record( const Variables & Values, VariableType Objective )
+    {
+      std::lock_guard< std::mutex > Guard( Lock );
+
+      if ( Objective < BestObjective )
+      {
+        BestValues    = Values;
+        BestObjective = Objective;
+      }
+    }
+
+    inline bool Stop( void ) const
+    {
+      return Finished.load( std::memory_order_acquire ) ||
+             ( Deadline && ( Clock::now() >= *Deadline ) );
+    }
+
+    inline void Finish( Algorithm::ID TheAlgorithm, nlopt_result Status )
+    {
+      std::lock_guard< std::mutex > Guard( Lock );
+
+      if ( !Winner )
+      {
+        Winner       = TheAlgorithm;
+        WinnerStatus = Status;
+      }
+
+      Finished.store( true, std::memory_order_release );
+    }
+
+    // The result is only read when all the algorithms have terminated, and
+    // there is no need to lock the access.
+
+    inline const Variables & BestVariables( void ) const
+    { return BestValues; }
+
+    inline VariableType BestValue( void ) const
+    { return BestObjective; }
+
+    inline std::optional< Algorithm::ID > WinningAlgorithm( void ) const
+    { return Winner; }
+
+    inline nlopt_result WinningStatus( void ) const
+    { return WinnerStatus; }
+
+    Race( const std::optional< Clock::time_point > & TheDeadline )
+    : Lock(), BestValues(),
+      BestObjective( std::numeric_limits< VariableType >::max() ),
+      Finished( false ), Deadline( TheDeadline ), Winner(),
+      WinnerStatus( NLOPT_FORCED_STOP )
+    {}
+  };
+
+  // ---------------------------------------------------------------------------
+  // Racer
+  // ---------------------------------------------------------------------------
+  //
+  // A racer is an optimizer for a given algorithm whose objective function
+  // evaluates the evaluator given to the racer, records the evaluation in the
+  // race, and forces the algorithm to stop if the race has been finished by
+  // another racer or the deadline has passed.
+
+  template< Algorithm::ID PrimaryAlgorithm, Algorithm::ID SecondaryAlgorithm >
+  class Racer : public Optimizer< PrimaryAlgorithm, SecondaryAlgorithm >
+  {
+  private:
+
+    Race &                  TheRace;
+    Evaluator               Objective;
+    std::vector< Interval > Bounds;
+    std::size_t             EvaluationCount;
+
+  protected:
+
+    virtual VariableType
+    ObjectiveFunction( const Variables & VariableValues ) override
+    {
+      VariableType Value = Objective( VariableValues );
+
+      EvaluationCount++;
+      TheRace.Record( VariableValues, Value );
+
+      if ( TheRace.Stop() )
+        this->ForceStop();
+
+      return Value;
+    }
+
+    virtual std::vector< Interval > BoundConstraints( void ) override
+    { return Bounds; }
+
+  public:
+
+    // The racer creates the solver, sets the stopping criteria if they are
+    // given, and then runs the algorithm from the initial values.
+
+    OptimizerInterface::OptimalSolution
+    Run( const Variables & InitialValues, double Tolerance, int MaxEvaluations )
+    {
+      this->CreateSolver( InitialValues.size(),
+                          Optimization::Objective::Goal::Minimize );
+
+      if ( Tolerance > 0.0 )
+        this->AbsoluteObjectiveValueTolerance( Tolerance );
+
+      if ( MaxEvaluations > 0 )
+        this->MaxNumberOfEvaluations( MaxEvaluations );
+
+      return this->FindSolution( InitialValues );
+    }
+
+    inline std::size_t Evaluations( void ) const
+    { return EvaluationCount; }
+
+    template< class... OptimizerArguments >
+    Racer( Race & TheSharedRace, const Evaluator & TheObjective,
+           const std::vector< Interval > & VariableBounds,
+           OptimizerArguments... Arguments )
+    : Optimizer< PrimaryAlgorithm, SecondaryAlgorithm >( Arguments... ),
+      TheRace( TheSharedRace ), Objective( TheObjective ),
+      Bounds( VariableBounds ), EvaluationCount(0)
+    {}
+
+    virtual ~Racer( void )
+    {}
+  };
+
+  // ---------------------------------------------------------------------------
+  // Entries
+  // ---------------------------------------------------------------------------
+  //
+  // Each algorithm of the portfolio is stored as a function creating and
+  // running a racer for the algorithm in the calling thread, and returning the
+  // number of evaluations it made.
+
+  using Entry = std::function< std::size_t( Race &, const Evaluator &,
+                                            const std::vector< Interval > &,
+                                            const Variables & ) >;
+
+  std::vector< Entry > Entries;
+
+  // The stopping criteria of the algorithms are common for all the algorithms,
+  // and they are not set if they are zero. Note that the global algorithms
+  // will not stop by the tolerance on the objective value, and they will only
+  // terminate on the evaluation limit, or when another algorithm wins the
+  // race or the deadline passes.
+
+  double ObjectiveTolerance;
+  int    EvaluationLimit;
+
+public:
+
+  // An algorithm is added with the arguments for the constructor of its
+  // optimizer.
+
+  template< Algorithm::ID PrimaryAlgorithm,
+            Algorithm::ID SecondaryAlgorithm = Algorithm::ID::NoAlgorithm,
+            class... OptimizerArguments >
+  void Add( OptimizerArguments... Arguments )
+  {
+    Entries.emplace_back(
+      [=]( Race & TheRace, const Evaluator & TheObjective,
+           const std::vector< Interval > & Bounds,
+           const Variables & InitialValues )->std::size_t
+      {
+        Racer< PrimaryAlgorithm, SecondaryAlgorithm >
+        TheRacer( TheRace, TheObjective, Bounds, Arguments... );
+
+        auto Solution = TheRacer.Run( InitialValues, ObjectiveTolerance,
+                                      EvaluationLimit );
+
+        if ( Solution.Status != NLOPT_FORCED_STOP )
+          TheRace.Finish( PrimaryAlgorithm, Solution.Status );
+
+        return TheRacer.Evaluations();
+      });
+  }
+
+  inline std::size_t Size( void ) const
+  { return Entries.size(); }
+
+  // The outcome of a race is the best solution found, the algorithm that won
+  // the race if any, and the total number of evaluations made by all the
+  // algorithms. The status is the status of the winning algorithm, or the
+  // forced stop status if the deadline stopped the race.
+
+  class Outcome
+  {
+  public:
+
+    Variables                      VariableValues;
+    VariableType                   ObjectiveValue;
+    nlopt_result                   Status;
+    std::optional< Algorithm::ID > Winner;
+    std::size_t                    Evaluations;
+  };
+
+  // The solve function runs all the algorithms from the same initial values
+  // with the given bounds, each in its own thread and with its own evaluator.
+  // An exception thrown by an algorithm is passed on to the caller when all
+  // the threads have terminated.
+
+  Outcome Solve( const Variables & InitialValues,
+                 const std::vector< Interval > & Bounds,
+                 const EvaluatorFactory & NewEvaluator,
+                 const std::optional< Clock::time_point > & Deadline
+                   = std::optional< Clock::time_point >() )
+  {
+    if ( Entries.empty() )
+    {
+      std::ostringstream ErrorMessage;
+
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "A portfolio must have at least one algorithm";
+
+      throw std::logic_error( ErrorMessage.str() );
+    }
+
+    Race                              TheRace( Deadline );
+    std::vector< Evaluator >          Evaluators;
+    std::vector< std::size_t >        Evaluations( Entries.size(), 0 );
+    std::vector< std::exception_ptr > Errors( Entries.size() );
+    std::vector< std::thread >        Racers;
+
+    // The evaluators are created in the calling thread since the factory
+    // may not be thread safe.
+
+    for ( std::size_t i = 0; i < Entries.size(); i++ )
+      Evaluators.push_back( NewEvaluator() );
+
+    for ( std::size_t i = 0; i < Entries.size(); i++ )
+      Racers.emplace_back( [&,i](void){
+        try
+        {
+          Evaluations[i] = Entries[i]( TheRace, Evaluators[i], Bounds,
+                                       InitialValues );
+        }
+        catch (...)
+        {
+          Errors[i] = std::current_exception();
+          TheRace.Finish( Algorithm::ID::NoAlgorithm, NLOPT_FAILURE );
+        }
+      });
+
+    for ( std::thread & TheRacer : Racers )
+      TheRacer.join();
+
+    for ( std::exception_ptr & Error : Errors )
+      if ( Error ) std::rethrow_exception( Error );
+
+    Outcome Result;
+
+    Result.VariableValues = TheRace.BestVariables();
+    Result.ObjectiveValue = TheRace.BestValue();
+    Result.Status         = TheRace.WinningStatus();
+    Result.Winner         = TheRace.WinningAlgorithm();
+    Result.Evaluations    = 0;
+
+    for ( std::size_t Count : Evaluations )
+      Result.Evaluations += Count;
+
+    return Result;
+  }
+
+  // The constructor takes the common stopping criteria
+
+  Portfolio( double Tolerance = 0.0, int MaxEvaluations = 0 )
+  : Entries(), ObjectiveTolerance( Tolerance ),
+    EvaluationLimit( MaxEvaluations )
+  {}
+};
+
+}      // End name space Optimization non-linear
+#endif // OPTIMIZATION_NON_LINEAR_PORTFOLIO
@@ -0,0 +1,263 @@
+/*==============================================================================
+Quasi-Newton
+
+The quasi-Newton methods approximate the Hessian matrix of the objective
+function from the successive gradients, and use the approximation to solve
+the Newton equation for the search direction. They therefore need far fewer
+evaluations of the objective function than the derivative free algorithms
+for smooth problems with many variables, but the gradient must be provided.
+
+The low storage BFGS algorithm [1,2] keeps only a limited number of the past
+gradients, whereas the shifted limited memory variable metric algorithms [3]
+use a rank one or a rank two update of the approximation. The truncated
+Newton algorithms [4] solve the Newton equation approximately by a
+preconditioned conjugate gradient method, optionally with restarts of the
+steepest descent. These algorithms are all defined for bound constrained
+problems in NLopt, and they are initialised in the same way. The sequential
+quadratic programming algorithm [5] supports in addition general inequality
+and equality constraints, which must also have gradients.
+
+References:
+
+[1] J. Nocedal, "Updating quasi-Newton matrices with limited storage," Math.
+    Comput. Vol. 35, pp. 773-782, 1980
+[2] D. C. Liu and J. Nocedal, "On the limited memory BFGS method for large
+    scale optimization," Math. Programming Vol. 45, pp. 503-528, 1989
+[3] J. Vlcek and L. Luksan, "Shifted limited-memory variable metric methods
+    for large-scale unconstrained minimization," J. Computational Appl. Math.
+    Vol. 186, pp. 365-390, 2006
+[4] R. S. Dembo and T. Steihaug, "Truncated Newton algorithms for large-scale
+    optimization," Math. Programming Vol. 26, pp. 190-212, 1983
+[5] Dieter Kraft, "Algorithm 733: TOMP–Fortran modules for optimal control
+    calculations," ACM Transactions on Mathematical Software, Vol. 20, No. 3,
+    pp. 262-281, 1994
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef OPTIMIZATION_NON_LINEAR_QUASI_NEWTON
+#define OPTIMIZATION_NON_LINEAR_QUASI_NEWTON
+
+#include "../Variables.hpp"                   // Basic definitions
+
+#include "NonLinear/Algorithms.hpp"           // Definition of the algorithms
+#include "NonLinear/Objective.hpp"            // Objective function
+#include "NonLinear/Optimizer.hpp"            // Optimizer interface
+#include "NonLinear/Bounds.hpp"               // Variable domain bounds
+#include "NonLinear/Constraints.hpp"          // Constraint functions
+
+namespace Optimization::NonLinear
+{
+/*==============================================================================
+
+ Low storage BFGS
+
+==============================================================================*/
+//
+// The objective class will be the one with the gradient since the algorithm
+// requires the gradient, and the problem must therefore define the gradient
+// function in addition to the objective function and the bounds.
+
+template<>
+class Optimizer< Algorithm::Local::QuasiNewton::LowMemeory >
+: virtual public NonLinear::Objective< Algorithm::Local::QuasiNewton::LowMemeory >,
+  virtual public NonLinear::Bound,
+	public NonLinear::OptimizerInterface
+{
+protected:
+
+  // Define the algorithm used by the solver of this optimizer
+
+  virtual Algorithm::ID GetAlgorithm( void ) override
+	{ return Algorithm::Local::QuasiNewton::LowMemeory; }
+
+  // The function to create the solver will also initialise the bounds
+  // for the problem
+
+	SolverPointer CreateSolver( Dimension NumberOfVariables,
+														  Objective::Goal Direction) final
+	{
+		SolverPointer TheSolver =
+									OptimizerInterface::CreateSolver( NumberOfVariables,
+																										Direction);
+
+	  Objective::SetObjective( TheSolver, Direction );
+		SetBounds( TheSolver );
+
+    return TheSolver;
+	}
+
+  // The constructor is protected to ensure that it only will be called by
+	// derived classes defining the objective function, the gradient and the
+	// bound function. Its main purpose is to initialise the base classes. Note
+	// that the virtual base classes must be initialised before the interface
+	// class.
+
+	Optimizer( void )
+	: ObjectiveGradient(),
+	  Objective< Algorithm::Local::QuasiNewton::LowMemeory >(), Bound(),
+	  OptimizerInterface()
+	{}
+
+public:
+
+  virtual ~Optimizer( void )
+  {}
+};
+
+/*==============================================================================
+
+ Variable metric
+
+==============================================================================*/
+//
+// The variable metric algorithms initialise the solver exactly as the low
+// storage BFGS algorithm, and the create solver function is inherited.
+
+template<>
+class Optimizer< Algorithm::Local::QuasiNewton::VariableMetric::RankOne >
+: public Optimizer< Algorithm::Local::QuasiNewton::LowMemeory >
+{
+protected:
+
+  virtual Algorithm::ID GetAlgorithm( void ) override
+	{ return Algorithm::Local::QuasiNewton::VariableMetric::RankOne; }
+
+	Optimizer( void )
+	: ObjectiveGradient(),
+	  Optimizer< Algorithm::Local::QuasiNewton::LowMemeory >()
+	{}
+
+public:
+
+  virtual ~Optimizer( void )
+  {}
+};
+
+template<>
+class Optimizer< Algorithm::Local::QuasiNewton::VariableMetric::RankTwo >
+: public Optimizer< Algorithm::Local::QuasiNewton::LowMemeory >
+{
+protected:
+
+  virtual Algorithm::ID GetAlgorithm( void ) override
+	{ return Algorithm::Local::QuasiNewton::VariableMetric::RankTwo; }
+
+	Optimizer( void )
+	: ObjectiveGradient(),
+	  Optimizer< Algorithm::Local::QuasiNewton::LowMemeory >()
+	{}
+
+public:
+
+  virtual ~Optimizer( void )
+  {}
+};
+
+/*==============================================================================
+
+ Truncated Newton
+
+==============================================================================*/
+//
+// The four variants of the truncated Newton algorithm differ only in the
+// algorithm identifier, and they are therefore defined by one template
+// that is enabled for these identifiers only.
+
+template< Algorithm::ID TruncatedAlgorithm >
+class Optimizer< TruncatedAlgorithm, Algorithm::ID::NoAlgorithm,
+  std::enable_if_t<
+    ( TruncatedAlgorithm == Algorithm::Local::QuasiNewton::Truncated::Plain ) ||
+    ( TruncatedAlgorithm == Algorithm::Local::QuasiNewton::Truncated::Restart ) ||
+    ( TruncatedAlgorithm ==
+      Algorithm::Local::QuasiNewton::Truncated::Precondition ) ||
+    ( TruncatedAlgorithm ==
+      Algorithm::Local::QuasiNewton::Truncated::PreconditionRestart ) > >
+: public Optimizer< Algorithm::Local::QuasiNewton::LowMemeory >
+{
+protected:
+
+  virtual Algorithm::ID GetAlgorithm( void ) override
+	{ return TruncatedAlgorithm; }
+
+	Optimizer( void )
+	: ObjectiveGradient(),
+	  Optimizer< Algorithm::Local::QuasiNewton::LowMemeory >()
+	{}
+
+public:
+
+  virtual ~Optimizer( void )
+  {}
+};
+
+/*==============================================================================
+
+ Sequential quadratic programming
+
+==============================================================================*/
+//
+// The quadratic programming algorithm supports both inequality and equality
+// constraints in addition to the bounds. The constraints are optional and
+// only set if they have been defined, and they will share the same
+// tolerance as for the COBYLA algorithm.
+
+template<>
+class Optimizer< Algorithm::Local::QuasiNewton::QuadraticProgramming >
+: virtual public
+  NonLinear::Objective< Algorithm::Local::QuasiNewton::QuadraticProgramming >,
+  virtual public NonLinear::Bound,
+  virtual public
+  NonLinear::InEqConstraints<
+    Algorithm::Local::QuasiNewton::QuadraticProgramming >,
+  virtual public
+  NonLinear::EqConstraints<
+    Algorithm::Local::QuasiNewton::QuadraticProgramming >,
+	public NonLinear::OptimizerInterface
+{
+private:
+
+  double Tolerance;
+
+protected:
+
+  virtual Algorithm::ID GetAlgorithm( void ) override
+	{ return Algorithm::Local::QuasiNewton::QuadraticProgramming; }
+
+	SolverPointer CreateSolver( Dimension NumberOfVariables,
+														  Objective::Goal Direction) final
+	{
+		SolverPointer TheSolver =
+									OptimizerInterface::CreateSolver( NumberOfVariables,
+																										Direction);
+
+	  Objective::SetObjective( TheSolver, Direction );
+		SetBounds( TheSolver );
+
+    if ( NumberOfInEqConstraints() > 0 )
+      InEqConstraints::SetInEqConstraints( TheSolver, Tolerance );
+
+    if ( NumberOfEqConstraints() > 0 )
+      EqConstraints::SetEqConstraints( TheSolver, Tolerance );
+
+    return TheSolver;
+	}
+
+	Optimizer( double ConstraintTolerance )
+	: ObjectiveGradient(),
+	  Objective< Algorithm::Local::QuasiNewton::QuadraticProgramming >(),
+	  Bound(), InEqConstraints(), EqConstraints(), OptimizerInterface(),
+	  Tolerance( ConstraintTolerance )
+	{}
+
+  Optimizer( void ) = delete;
+
+public:
+
+  virtual ~Optimizer( void )
+  {}
+};
+
+}      // End name space Non Linear Optimization
+#endif // OPTIMIZATION_NON_LINEAR_QUASI_NEWTON
@@ -0,0 +1,504 @@
+/*==============================================================================
+Surrogate
+
+When the objective function is expensive to evaluate, for instance because
+each evaluation involves exchanging messages with the consumer proxies and the
+predictor, the number of evaluations matters more than the arithmetic done by
+the algorithm between the evaluations. The surrogate search therefore keeps a
+model of the objective function interpolating all the points evaluated so far,
+and only evaluates the true objective function for candidate points that the
+model predicts to improve the current best point.
+
+The model is a cubic radial basis function interpolant with a linear
+polynomial tail [1],
+
+  m(x) = sum_j lambda_j |x - y_j|^3 + c^T x + c_0
+
+fitted to the points y_j nearest to the current centre. The coefficients are
+found by solving the usual saddle point system of the interpolation conditions
+and the orthogonality of lambda to the linear polynomials. The system is
+singular unless the points span the variable space, and then the model cannot
+be used.
+
+The search is safeguarded by a trust region in the variable domain scaled to
+the unit cube [2]. In each iteration the model is minimised inside the trust
+region around the centre with one of the derivative free local algorithms,
+for instance the quadratic approximation wrapped in LocalApproximation.hpp,
+evaluating only the model. The candidate found is screened: If the reduction
+predicted by the model is too small, the candidate is not evaluated, and the
+trust region is either shrunk, or, if the model does not have enough points in
+the trust region to be trusted, a point improving the geometry of the model is
+evaluated instead. A promising candidate is evaluated, and the trust region is
+enlarged if the actual reduction agrees well with the predicted reduction and
+the step reached the border of the trust region, or shrunk if the agreement is
+poor. The centre moves to the candidate if it improved the objective value.
+
+The search terminates when the trust region becomes smaller than the minimum
+radius, or when the limit on the number of evaluations of the objective
+function has been reached. Only minimisation is supported, the model
+algorithm must be derivative free and support bounds, and note that the
+quadratic approximations of NLopt require at least two variables.
+
+References:
+
+[1] Rommel G. Regis and Christine A. Shoemaker, "A stochastic radial basis
+    function method for the global optimization of expensive functions,"
+    INFORMS Journal on Computing, Vol. 19, No. 4, pp. 497-509, 2007
+[2] Stefan M. Wild, Rommel G. Regis and Christine A. Shoemaker, "ORBIT:
+    Optimization by radial basis function interpolation in trust-regions,"
+    SIAM J. Sci. Comput., Vol. 30, No. 6, pp. 3197-3219, 2008
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+==============================================================================*/
+
+#ifndef OPTIMIZATION_NON_LINEAR_SURROGATE
+#define OPTIMIZATION_NON_LINEAR_SURROGATE
+
+#include <algorithm>                          // Nearest points
+#include <cmath>                              // Distances
+#include <cstddef>                            // Counters
+#include <functional>                         // The evaluator
+#include <numeric>                            // Point indices
+#include <sstream>                            // For error reporting
+#include <stdexcept>                          // For standard exceptions
+#include <vector>                             // Variables and points
+
+#include <armadillo>                          // Matrix library
+#include <boost/numeric/interval.hpp>         // Variable domains
+#include <nlopt.h>                            // The C-style interface
+
+#include "../Variables.hpp"                   // Basic definitions
+#include "NonLinear/Algorithms.hpp"           // Definition of the algorithms
+#include "NonLinear/Optimizer.hpp"            // Optimizer interface
+
+namespace Optimization::NonLinear
+{
+
+template< Algorithm::ID ModelAlgorithm =
+          Algorithm::Local::Approximation::Rescaling >
+class Surrogate
+{
+  static_assert( !Algorithm::RequiresGradient( ModelAlgorithm ),
+    "The algorithm minimising the surrogate model cannot use gradients" );
+
+public:
+
+  using Interval  = boost::numeric::interval< VariableType >;
+  using Evaluator = std::function< VariableType( const Variables & ) >;
+
+  // ---------------------------------------------------------------------------
+  // Radial basis model
+  // ---------------------------------------------------------------------------
+  //
+  // The model is fitted to a set of points and values, and the fit fails if
+  // the interpolation system is singular.
+
+private:
+
+  class RadialBasisModel
+  {
+  private:
+
+    std::vector< Variables > Centres;
+    std::vector< Dimension > Tail;
+    arma::vec                Coefficients;
+
+    static double Distance( const Variables & x, const Variables & y )
+    {
+      double Sum = 0.0;
+
+      for ( Dimension i = 0; i < x.size(); i++ )
+        Sum += ( x[i] - y[i] ) * ( x[i] - y[i] );
+
+      return std::sqrt( Sum );
+    }
+
+  public:
+
+    // The linear tail only has terms for the variables that vary over the
+    // points since the system is otherwise singular, for instance for the
+    // variables fixed by their bounds.
+
+    bool Fit( const std::vector< Variables > & Points,
+              const std::vector< VariableType > & Values )
+    {
+      Tail.clear();
+
+      for ( Dimension k = 0; k < Points.front().size(); k++ )
+        if ( std::any_of( Points.begin(), Points.end(),
+             [&]( const Variables & Point ){
+               return Point[k] != Points.front()[k]; }) )
+          Tail.push_back( k );
+
+      const std::size_t m    = Points.size(),
+                        n    = Tail.size(),
+                        Size = m + n + 1;
+
+      arma::mat System( Size, Size, arma::fill::zeros );
+      arma::vec RightHandSide( Size, arma::fill::zeros );
+
+      for ( std::size_t i = 0; i < m; i++ )
+      {
+        for ( std::size_t j = 0; j < m; j++ )
+          System( i, j ) = std::pow( Distance( Points[i], Points[j] ), 3 );
+
+        for ( std::size_t k = 0; k < n; k++ )
+        {
+          System( i, m + k ) = Points[i][ Tail[k] ];
+          System( m + k, i ) = Points[i][ Tail[k] ];
+        }
+
+        System( i, m + n ) = 1.0;
+        System( m + n, i ) = 1.0;
+
+        RightHandSide( i ) = Values[i];
+      }
+
+      Centres = Points;
+
+      return arma::solve( Coefficients, System, RightHandSide,
+                          arma::solve_opts::no_approx );
+    }
+
+    VariableType operator() ( const Variables & x ) const
+    {
+      const std::size_t m = Centres.size(),
+                        n = Tail.size();
+
+      VariableType Value = Coefficients( m + n );
+
+      for ( std::size_t j = 0; j < m; j++ )
+        Value += Coefficients( j ) * std::pow( Distance( x, Centres[j] ), 3 );
+
+      for ( std::size_t k = 0; k < n; k++ )
+        Value += Coefficients( m + k ) * x[ Tail[k] ];
+
+      return Value;
+    }
+  };
+
+  // ---------------------------------------------------------------------------
+  // Model search
+  // ---------------------------------------------------------------------------
+  //
+  // The model is minimised by an optimizer for the model algorithm whose
+  // objective function is the model, and whose bounds are the trust region.
+  // The solver is created for every search since the bounds change.
+
+  class ModelSearch : public Optimizer< ModelAlgorithm >
+  {
+  private:
+
+    const RadialBasisModel *  Model;
+    std::vector< Interval >   Region;
+
+  protected:
+
+    virtual VariableType
+    ObjectiveFunction( const Variables & VariableValues ) override
+    { return (*Model)( VariableValues ); }
+
+    virtual std::vector< Interval > BoundConstraints( void ) override
+    { return Region; }
+
+  public:
+
+    OptimizerInterface::OptimalSolution
+    Run( const RadialBasisModel & TheModel, const Variables & Centre,
+         const std::vector< Interval > & TrustRegion )
+    {
+      Model  = &TheModel;
+      Region = TrustRegion;
+
+      this->CreateSolver( Centre.size(),
+                          Optimization::Objective::Goal::Minimize );
+      this->RelativeVariableValueTolerance( 1e-6 );
+      this->MaxNumberOfEvaluations( 200 * ( Centre.size() + 1 ) );
+
+      return this->FindSolution( Centre );
+    }
+
+    template< class... OptimizerArguments >
+    ModelSearch( OptimizerArguments... Arguments )
+    : Optimizer< ModelAlgorithm >( Arguments... ), Model( nullptr ), Region()
+    {}
+
+    virtual ~ModelSearch( void )
+    {}
+  };
+
+  // ---------------------------------------------------------------------------
+  // Parameters
+  // ---------------------------------------------------------------------------
+  //
+  // The radii are given in the scaled domain where each variable has unit
+  // width, and the screening threshold is the smallest predicted reduction
+  // relative to the magnitude of the objective value of the centre.
+
+  static constexpr double MaximumRadius = 0.5;
+
+  const double      InitialRadius, MinimumRadius, ScreeningThreshold;
+  const std::size_t ModelPoints;
+
+  ModelSearch Minimiser;
+
+public:
+
+  // The outcome of the search is the best solution found, the status, the
+  // number of evaluations of the true objective function, and the number of
+  // candidates rejected by the model without being evaluated. The status is
+  // the variable tolerance status if the trust region became smaller than
+  // the minimum radius, and the maximum evaluations status otherwise.
+
+  class Outcome
+  {
+  public:
+
+    Variables    VariableValues;
+    VariableType ObjectiveValue;
+    nlopt_result Status;
+    std::size_t  Evaluations, Screened;
+  };
+
+  // The solve function searches from the initial values within the given
+  // bounds using at most the given number of evaluations of the objective
+  // function.
+
+  Outcome Solve( const Variables & InitialValues,
+                 const std::vector< Interval > & Bounds,
+                 const Evaluator & Objective, std::size_t EvaluationLimit )
+  {
+    if ( InitialValues.empty() || ( InitialValues.size() != Bounds.size() ) ||
+         ( EvaluationLimit == 0 ) )
+    {
+      std::ostringstream ErrorMessage;
+
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "The surrogate search needs bounds for each of the "
+                   << InitialValues.size() << " variables and a positive "
+                   << "evaluation limit";
+
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+
+    const Dimension n = InitialValues.size();
+
+    // The points are stored in scaled coordinates, and unscaled only for the
+    // evaluation of the objective function.
+
+    auto Unscale = [&]( const Variables & Scaled ){
+      Variables Values( n );
+
+      for ( Dimension i = 0; i < n; i++ )
+        Values[i] = Bounds[i].lower()
+                    + Scaled[i] * boost::numeric::width( Bounds[i] );
+
+      return Values;
+    };
+
+    std::vector< Variables >    Points;
+    std::vector< VariableType > Values;
+    std::size_t                 Centre = 0;
+
+    Outcome Result;
+
+    Result.Screened = 0;
+
+    auto Evaluate = [&]( const Variables & Scaled ){
+      Points.push_back( Scaled );
+      Values.push_back( Objective( Unscale( Scaled ) ) );
+
+      if ( Values.back() < Values[ Centre ] )
+        Centre = Points.size() - 1;
+    };
+
+    // The initial centre is the initial values clamped to the bounds
+
+    Variables Start( n );
+
+    for ( Dimension i = 0; i < n; i++ )
+      Start[i] = ( boost::numeric::width( Bounds[i] ) > 0 )
+                 ? std::clamp( ( InitialValues[i] - Bounds[i].lower() )
+                               / boost::numeric::width( Bounds[i] ), 0.0, 1.0 )
+                 : 0.0;
+
+    Evaluate( Start );
+
+    double Radius = InitialRadius;
+
+    // A geometry step evaluates a point at the border of the trust region
+    // along one of the coordinate axes, cycling over the variables that are
+    // not fixed by their bounds, towards the side with more room.
+
+    std::vector< Dimension > Free;
+
+    for ( Dimension i = 0; i < n; i++ )
+      if ( boost::numeric::width( Bounds[i] ) > 0 )
+        Free.push_back( i );
+
+    std::size_t NextAxis = 0;
+
+    auto GeometryStep = [&](void){
+      Variables Point( Points[ Centre ] );
+      Dimension Axis = Free[ NextAxis++ % Free.size() ];
+
+      Point[ Axis ] += ( Point[ Axis ] + Radius <= 1.0 ) ? Radius : -Radius;
+      Point[ Axis ]  = std::clamp( Point[ Axis ], 0.0, 1.0 );
+
+      Evaluate( Point );
+    };
+
+    auto InfinityDistance = [&]( const Variables & x, const Variables & y ){
+      double Largest = 0.0;
+
+      for ( Dimension i = 0; i < n; i++ )
+        Largest = std::max( Largest, std::abs( x[i] - y[i] ) );
+
+      return Largest;
+    };
+
+    // The model is trusted in the region if it has at least as many points
+    // inside the region as needed for the linear tail.
+
+    auto ModelValid = [&](void){
+      return static_cast< std::size_t >(
+             std::count_if( Points.begin(), Points.end(),
+             [&]( const Variables & Point ){
+               return InfinityDistance( Point, Points[ Centre ] ) <= Radius; }))
+             > Free.size();
+    };
+
+    // The initial model is built from the centre and one step along each
+    // free variable. If all variables are fixed, there is nothing to search.
+
+    for ( std::size_t i = 0;
+          ( i < Free.size() ) && ( Points.size() < EvaluationLimit ); i++ )
+      GeometryStep();
+
+    RadialBasisModel Model;
+    nlopt_result     Status = NLOPT_MAXEVAL_REACHED;
+
+    while ( !Free.empty() && ( Points.size() < EvaluationLimit ) )
+    {
+      if ( Radius < MinimumRadius )
+      {
+        Status = NLOPT_XTOL_REACHED;
+        break;
+      }
+
+      // The model is fitted to the points nearest to the centre
+
+      std::vector< std::size_t > Nearest( Points.size() );
+      std::iota( Nearest.begin(), Nearest.end(), 0 );
+
+      const std::size_t Size = std::min( Points.size(),
+                        ModelPoints > 0 ? ModelPoints : 2 * n + 1 );
+
+      std::partial_sort( Nearest.begin(), Nearest.begin() + Size,
+                         Nearest.end(), [&]( std::size_t a, std::size_t b ){
+          return InfinityDistance( Points[a], Points[ Centre ] ) <
+                 InfinityDistance( Points[b], Points[ Centre ] ); });
+
+      std::vector< Variables >    ModelCentres;
+      std::vector< VariableType > ModelValues;
+
+      for ( std::size_t i = 0; i < Size; i++ )
+      {
+        ModelCentres.push_back( Points[ Nearest[i] ] );
+        ModelValues.push_back( Values[ Nearest[i] ] );
+      }
+
+      if ( !Model.Fit( ModelCentres, ModelValues ) )
+      {
+        GeometryStep();
+        continue;
+      }
+
+      // The model is minimised in the trust region around the centre
+
+      std::vector< Interval > TrustRegion;
+
+      for ( Dimension i = 0; i < n; i++ )
+        TrustRegion.emplace_back(
+          std::max( 0.0, Points[ Centre ][i] - Radius ),
+          std::min( 1.0, Points[ Centre ][i] + Radius ) );
+
+      auto Candidate = Minimiser.Run( Model, Points[ Centre ], TrustRegion );
+
+      const VariableType CentreValue = Values[ Centre ],
+                         Predicted   = CentreValue - Candidate.ObjectiveValue;
+      const double       Step        = InfinityDistance(
+                                       Candidate.VariableValues,
+                                       Points[ Centre ] );
+
+      bool Known = std::any_of( Points.begin(), Points.end(),
+        [&]( const Variables & Point ){
+          return InfinityDistance( Point, Candidate.VariableValues )
+                 < MinimumRadius; });
+
+      // An unpromising candidate is not evaluated
+
+      if ( Known || !( Predicted > ScreeningThreshold *
+                       std::max( 1.0, std::abs( CentreValue ) ) ) )
+      {
+        Result.Screened++;
+
+        if ( ModelValid() ) Radius /= 2.0;
+        else                GeometryStep();
+
+        continue;
+      }
+
+      Evaluate( Candidate.VariableValues );
+
+      const double Agreement = ( CentreValue - Values.back() ) / Predicted;
+
+      if ( ( Agreement >= 0.75 ) && ( Step >= 0.9 * Radius ) )
+        Radius = std::min( 2.0 * Radius, MaximumRadius );
+      else if ( Agreement < 0.25 )
+      {
+        if ( ModelValid() ) Radius /= 2.0;
+        else if ( Points.size() < EvaluationLimit ) GeometryStep();
+      }
+    }
+
+    Result.VariableValues = Unscale( Points[ Centre ] );
+    Result.ObjectiveValue = Values[ Centre ];
+    Result.Status         = Status;
+    Result.Evaluations    = Points.size();
+
+    return Result;
+  }
+
+  // The constructor takes the initial and minimum radii of the trust region
+  // in the scaled domain, the screening threshold, the number of points used
+  // for the model, where zero means 2n+1 for n variables, and the arguments
+  // for the constructor of the optimizer for the model algorithm.
+
+  template< class... OptimizerArguments >
+  Surrogate( double InitialRegion = 0.1, double MinimumRegion = 1e-6,
+             double Threshold = 1e-9, std::size_t NumberOfModelPoints = 0,
+             OptimizerArguments... Arguments )
+  : InitialRadius( InitialRegion ), MinimumRadius( MinimumRegion ),
+    ScreeningThreshold( Threshold ), ModelPoints( NumberOfModelPoints ),
+    Minimiser( Arguments... )
+  {
+    if ( !( MinimumRegion > 0.0 ) || !( InitialRegion >= MinimumRegion ) ||
+         !( InitialRegion <= MaximumRadius ) || ( Threshold < 0.0 ) )
+    {
+      std::ostringstream ErrorMessage;
+
+      ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+                   << "The surrogate trust region radii must satisfy 0 < "
+                   << MinimumRegion << " <= " << InitialRegion << " <= "
+                   << MaximumRadius << " and the screening threshold must "
+                   << "be non-negative";
+
+      throw std::invalid_argument( ErrorMessage.str() );
+    }
+  }
+};
+
+}      // End name space Optimization non-linear
+#endif // OPTIMIZATION_NON_LINEAR_SURROGATE
@@ -5,11 +5,27 @@ The abstract objective class defines the real function to optimize taking a
 vector of real values as argument values and returning a real number for the
 objective function at that point.
 
+A problem may also evaluate the objective function for a whole population of
+candidate points in one call, which allows an implementation to share work
+between the candidates, to vectorise over the candidates, or to evaluate them
+in parallel. The default is to evaluate the candidates one by one. Note that
+the NLopt algorithms, including the population based ones, request one point
+at a time from the objective function, so the batched evaluation is for the
+callers generating their own populations, for instance when screening
+candidate initial points.
+
 The abstract gradient class defines a gradient function that is required by
 some of the optimization algorithms. It takes a vector of real values and
 returns a vector of real values of the same size as the argument vector
 representing the gradient at the evaluation point.
 
+Both functions also have a version taking a span of the variable values, and
+the gradient function a span of the gradient values to write. The numerical
+algorithms call these directly on their own arrays, and a problem that cares 
+about the cost of copying the variable values can override the span versions.
+By default they copy the values and call the vector versions, so existing
+problems only need to define the vector versions.
+
 Author and Copyright: Geir Horn, 2018
 License: LGPL 3.0
 ==============================================================================*/
@@ -18,6 +34,7 @@ License: LGPL 3.0
 #define OPTIMMIZATION_OBJECTIVE
 
 #include <vector>
+#include <algorithm>
 #include "Variables.hpp"
 
 namespace Optimization
@@ -47,6 +64,31 @@ protected:
 	virtual VariableType
 	ObjectiveFunction( const Variables & VariableValues ) = 0;
 
+	virtual VariableType
+	ObjectiveFunction( VariableSpan VariableValues )
+	{
+		return ObjectiveFunction( 
+					 Variables( VariableValues.begin(), VariableValues.end() ) );
+	}
+
+	// The batched evaluation returns the objective values of the candidates in
+	// the order of the candidates. It has a different name since a derived
+	// class defining only the objective function for one point would otherwise
+	// hide it.
+
+	virtual std::vector< VariableType >
+	ObjectiveValues( const Population & Candidates )
+	{
+		std::vector< VariableType > Values;
+
+		Values.reserve( Candidates.size() );
+
+		for ( const Variables & Candidate : Candidates )
+			Values.push_back( ObjectiveFunction( Candidate ) );
+
+		return Values;
+	}
+
 	// The constructor is protected to prevent direct construction of this
 	// class although it does not do anything.
 
@@ -75,6 +117,15 @@ protected:
 	virtual GradientVector
 	GradientFunction( const Variables & VariableValues ) = 0;
 
+	virtual void
+	GradientFunction( VariableSpan VariableValues, GradientSpan GradientValues )
+	{
+		GradientVector Gradient( GradientFunction( 
+			Variables( VariableValues.begin(), VariableValues.end() ) ) );
+
+		std::copy( Gradient.begin(), Gradient.end(), GradientValues.begin() );
+	}
+
 	ObjectiveGradient( void )
 	: Objective()
 	{}
@@ -15,6 +15,14 @@ As long as the variable type is a plain type and no class it is not possible
 to define safe conversions for it, and the built in conversions should be 
 used (for now). 
 
+The optimization algorithms in C pass the variable values as a pointer to an
+array of doubles, and copying these into a vector for every evaluation of the
+objective function may be a significant part of the cost for objective 
+functions that are cheap to evaluate. The variable span is a view of such an
+array that can be given to the objective function without copying. It is 
+the standard span if the compiler supports C++20, and otherwise a minimal 
+class offering the parts of the standard span interface needed here.
+
 Author and Copyright: Geir Horn, 2018
 License: LGPL 3.0
 ==============================================================================*/
@@ -23,6 +31,12 @@ License: LGPL 3.0
 #define OPTIMIZATION_VARIABLES
 
 #include <vector>
+#include <cstddef>
+#include <type_traits>
+
+#if __cplusplus > 201703L && __has_include( <span> )
+  #include <span>
+#endif
 
 namespace Optimization
 {
@@ -31,5 +45,77 @@ using Variables      = std::vector< VariableType >;
 using GradientVector = std::vector< VariableType >;
 using Dimension      = typename Variables::size_type;
 
+// Population based algorithms work on many candidate points at the same time,
+// and a population is a set of variable vectors of the same dimension.
+
+using Population     = std::vector< Variables >;
+
+// The span is a pointer and a size of a contiguous array. It can be 
+// constructed implicitly from a vector, or any other container with data 
+// and size functions, so functions taking a span can be called with the 
+// variable vectors.
+
+#if __cplusplus > 201703L && __has_include( <span> )
+
+template< class ElementType >
+using Span = std::span< ElementType >;
+
+#else
+
+template< class ElementType >
+class Span
+{
+private:
+
+  ElementType * Elements;
+  std::size_t   Length;
+
+public:
+
+  using element_type = ElementType;
+  using value_type   = std::remove_cv_t< ElementType >;
+  using size_type    = std::size_t;
+  using iterator     = ElementType *;
+
+  constexpr Span( ElementType * Data, std::size_t Size ) noexcept
+  : Elements( Data ), Length( Size )
+  {}
+
+  template< class Container,
+            class = std::enable_if_t< std::is_convertible_v< 
+              decltype( std::declval< Container & >().data() ), 
+              ElementType * > > >
+  constexpr Span( Container && TheContainer ) noexcept
+  : Elements( TheContainer.data() ), Length( TheContainer.size() )
+  {}
+
+  constexpr Span( void ) noexcept
+  : Elements( nullptr ), Length( 0 )
+  {}
+
+  constexpr ElementType * data( void ) const noexcept
+  { return Elements; }
+
+  constexpr std::size_t size( void ) const noexcept
+  { return Length; }
+
+  constexpr bool empty( void ) const noexcept
+  { return Length == 0; }
+
+  constexpr ElementType & operator[] ( std::size_t Index ) const
+  { return Elements[ Index ]; }
+
+  constexpr iterator begin( void ) const noexcept
+  { return Elements; }
+
+  constexpr iterator end( void ) const noexcept
+  { return Elements + Length; }
+};
+
+#endif
+
+using VariableSpan = Span< const VariableType >;
+using GradientSpan = Span< VariableType >;
+
 }      // End name space Optimization
 #endif // OPTIMIZATION_VARIABLES
@@ -7,9 +7,13 @@ License: LGPL 3.0
 
 #include <chrono>									             // To support time out mutexes
 #include <functional>							             // Run-time functions
+#include <fstream>								             // Dumping the metrics
+#include <cstdio>									             // Replacing the dump file
+#include <cmath>									             // Metric percentiles
 
 #include "Actor.hpp"							             // The Actor definition
 #include "Communication/PresentationLayer.hpp" // The Presentation Layer
+#include "Utility/ProfilerAnnotations.hpp"   // Optional profiler zones
 
 // In the case that this is compiled with a GNU compiler the actor's postman
 // thread will be named with the actor's name.
@@ -18,6 +22,16 @@ License: LGPL 3.0
 	#include <pthread.h>
 #endif
 
+// On Linux the threads waiting for messages are parked on a futex
+
+#ifdef __linux__
+	#include <sched.h>
+	#include <climits>
+	#include <unistd.h>
+	#include <sys/syscall.h>
+	#include <linux/futex.h>
+#endif
+
 /*=============================================================================
 
  Actor identification
@@ -30,15 +44,13 @@ License: LGPL 3.0
 std::atomic< Theron::Actor::Identification::IDType >
 				Theron::Actor::Identification::TotalActorsCreated(0);
 
-std::unordered_map< std::string, Theron::Actor::Identification * >
+Theron::Actor::Identification::Registry< std::string >
 				Theron::Actor::Identification::ActorsByName;
 
-std::unordered_map< Theron::Actor::Identification::IDType,
-										Theron::Actor::Identification * >
+Theron::Actor::Identification::Registry<
+										Theron::Actor::Identification::IDType >
 				Theron::Actor::Identification::ActorsByID;
 
-std::recursive_mutex Theron::Actor::Identification::InformationAccess;
-
 Theron::Actor::Address
 Theron::Actor::Identification::ThePresentationLayerServer;
 
@@ -80,12 +92,6 @@ void Theron::Actor::Identification::SetPresentationLayerServer(
 Theron::Actor::Address Theron::Actor::Identification::Create(
 								 const std::string & ActorName, Theron::Actor * const TheActor )
 {
-	// In order to ensure that the Identification object of an existing actor is
-	// not destructed in parallel with the creation of a reference to the same
-	// object, access to the maps must be locked.
-
-	std::lock_guard< std::recursive_mutex > Lock( InformationAccess );
-
 	// The found Identification object is stored. There is a very subtle learning
 	// point: This could have been a raw pointer, but that would leave the
 	// shared pointer of the base class of the identification void. The shared
@@ -100,23 +106,46 @@ Theron::Actor::Address Theron::Actor::Identification::Create(
 	// The lookup is considered first: If the name is not given, then a new ID
 	// with automatically assigned name must be created, otherwise a check is
 	// made to find an actor with the given name. If no actor is found, then a
-	// new Identification is again constructed. Note that the constructor of the
-	// Identification object takes care of inserting the Identification object
-	// in the two lookup maps.
+	// new Identification is again constructed.
+	//
+	// In order to ensure that two Identification objects are not created for
+	// the same name in parallel, the shard of the name is exclusively locked
+	// while finding or inserting the Identification. An Identification found
+	// in the registry may be in the process of being destructed if its last
+	// address has already been released, and then it is replaced by the new
+	// Identification. The ID is unique and it is registered afterwards under
+	// the lock of its own shard so that the two locks are never held together.
+
+	bool NewIdentification = false;
 
 	if ( ActorName.empty() )
-    TheActorID = std::shared_ptr< Identification >( new Identification() );
+  {
+		TheActorID = std::shared_ptr< Identification >( new Identification() );
+		ActorsByName.Insert( TheActorID->Name, TheActorID.get() );
+		NewIdentification = true;
+	}
 	else
   {
-		auto ExistingActor = ActorsByName.find( ActorName );
+		auto & TheShard( ActorsByName.ShardFor( ActorName ) );
+		std::unique_lock< std::shared_mutex > Lock( TheShard.Guard );
 
-		if ( ExistingActor == ActorsByName.end() )
+		auto ExistingActor = TheShard.Actors.find( ActorName );
+
+		if ( ExistingActor != TheShard.Actors.end() )
+			TheActorID = ExistingActor->second->weak_from_this().lock();
+
+		if ( !TheActorID )
+		{
 			TheActorID = std::shared_ptr< Identification >(
 																							new Identification( ActorName ) );
-		else
-			TheActorID = ExistingActor->second->GetSmartPointer();
+			TheShard.Actors[ ActorName ] = TheActorID.get();
+			NewIdentification = true;
+		}
 	}
 
+	if ( NewIdentification )
+		ActorsByID.Insert( TheActorID->NumericalID, TheActorID.get() );
+
 	// An actor is allowed to steal the Actor Pointer if this actor pointer is
 	// either unassigned or set to the Presentation Layer actor indicating that
 	// this Identification could be for a remote object which is now confirmed
@@ -126,13 +155,21 @@ Theron::Actor::Address Theron::Actor::Identification::Create(
 	// for a named actor that is already set to another actor that is not the
 	// Presentation Layer actor, there is a serious logical error in the
 	// application and an exception will be thrown.
+	//
+	// Other threads may create addresses for the same name concurrently, and
+	// the actor pointer is therefore changed by compare and exchange so that
+	// two actors cannot both take it.
+
+	Actor * const Server  = PresentationLayerActor();
+	Actor * 			Current = TheActorID->ActorPointer.load();
 
 	if ( TheActor != nullptr )
   {
-		if ((TheActorID->ActorPointer == nullptr) ||
-				(TheActorID->ActorPointer == ThePresentationLayerServer->ActorPointer) )
-			TheActorID->ActorPointer = TheActor;
-		else if( TheActor != TheActorID->ActorPointer )
+		while ( ( ( Current == nullptr ) || ( Current == Server ) ) &&
+						!TheActorID->ActorPointer.compare_exchange_weak( Current, TheActor ) );
+
+		if ( ( Current != nullptr ) && ( Current != Server ) &&
+				 ( Current != TheActor ) )
 		{
 			std::ostringstream ErrorMessage;
 
@@ -140,13 +177,13 @@ Theron::Actor::Address Theron::Actor::Identification::Create(
 									 << "Attempt to Create an Identification with name "
 									 << ActorName << " and address " << TheActor
 									 << " but this named Identification already points "
-									 << " to the actor at " << TheActorID->ActorPointer;
+									 << " to the actor at " << Current;
 
 		  throw std::logic_error( ErrorMessage.str() );
 		}
 	}
-	else if ( ThePresentationLayerServer->ActorPointer != nullptr )
-		TheActorID->ActorPointer = ThePresentationLayerServer->ActorPointer;
+	else if ( ( Server != nullptr ) && ( Current == nullptr ) )
+		TheActorID->ActorPointer.compare_exchange_strong( Current, Server );
 
 	// At this point the Identification pointer is correctly set, and the
 	// address constructed from its shared pointer can be returned.
@@ -160,11 +197,9 @@ Theron::Actor::Address Theron::Actor::Identification::Create(
 Theron::Actor * Theron::Actor::Identification::GetActor(
 																	 const Theron::Actor::Address & ActorAddress )
 {
-	std::lock_guard< std::recursive_mutex > Lock( InformationAccess );
-
 	if ( ActorAddress )
   {
-		Actor * TheActor = ActorAddress->ActorPointer;
+		Actor * TheActor = ActorAddress->ActorPointer.load();
 		if ( TheActor != nullptr )
 			return TheActor;
 		else
@@ -189,37 +224,33 @@ Theron::Actor * Theron::Actor::Identification::GetActor(
 
 }
 
-// The first lookup function by name simply acquires the lock and then
-// constructs the address based on the outcome of this lookup. Note that this
-// may result in an invalid address if the given actor name is not found.
+// The first lookup function by name simply constructs the address based on
+// the outcome of the lookup in the shard of the name. Note that this may
+// result in an invalid address if the given actor name is not found.
 
 Theron::Actor::Address Theron::Actor::Identification::Lookup(
 																								 const std::string & ActorName )
 {
-	std::lock_guard< std::recursive_mutex > Lock( InformationAccess );
-
-	auto TheActor = ActorsByName.find( ActorName );
+	auto TheActor = ActorsByName.Find( ActorName );
 
-	if ( TheActor == ActorsByName.end() )
-		return Address();
+	if ( TheActor )
+		return Address( TheActor );
 	else
-		return TheActor->second->GetSmartPointer();
+		return Address();
 }
 
 // The second lookup function is almost identical except that it uses the ID
-// map to find the actor.
+// registry to find the actor.
 
 Theron::Actor::Address Theron::Actor::Identification::Lookup(
 																														const IDType TheID )
 {
-	std::lock_guard< std::recursive_mutex > Lock( InformationAccess );
+	auto TheActor = ActorsByID.Find( TheID );
 
-	auto TheActor = ActorsByID.find( TheID );
-
-	if ( TheActor == ActorsByID.end() )
-		return Address();
+	if ( TheActor )
+		return Address( TheActor );
 	else
-		return TheActor->second->GetSmartPointer();
+		return Address();
 }
 
 // Clearing the actor is just setting the actor pointer to the null pointer
@@ -237,13 +268,20 @@ Theron::Actor::Address Theron::Actor::Identification::Lookup(
 void Theron::Actor::Identification::ClearActor(
 																	const Theron::Actor::Address & ActorAddress )
 {
-	std::lock_guard< std::recursive_mutex > Lock( InformationAccess );
-
 	if ( ActorAddress == ThePresentationLayerServer )
   {
-		for ( auto & TheID : ActorsByID )
-			if ( TheID.second->ActorPointer == ActorAddress->ActorPointer )
-				TheID.second->ActorPointer = nullptr;
+		Actor * const Server = ActorAddress->ActorPointer.load();
+
+		for ( auto & TheShard : ActorsByID.AllShards() )
+		{
+			std::shared_lock< std::shared_mutex > Lock( TheShard.Guard );
+
+			for ( auto & TheID : TheShard.Actors )
+			{
+				Actor * Current = Server;
+				TheID.second->ActorPointer.compare_exchange_strong( Current, nullptr );
+			}
+		}
 
 		ThePresentationLayerServer = Address::Null();
 	}
@@ -264,41 +302,53 @@ void Theron::Actor::Identification::ClearActor(
 
 bool Theron::Actor::Identification::AllowRouting( void )
 {
-	return ( ActorPointer != nullptr ) ||
-				 ( ( ThePresentationLayerServer != Address::Null() ) &&
-				   ( ThePresentationLayerServer->ActorPointer != nullptr ) ) ;
+	return ( ActorPointer != nullptr ) || ( PresentationLayerActor() != nullptr );
+}
+
+// The test for a local actor must exclude the Identifications pointing to the
+// Presentation Layer server as the representative of a possibly remote actor.
+
+bool Theron::Actor::Identification::HasActor( void )
+{
+	Actor * TheActor = ActorPointer.load();
+
+	return ( TheActor != nullptr ) &&
+				 ( ( TheActor != PresentationLayerActor() ) ||
+					 ( ThePresentationLayerServer.get() == this ) );
+}
+
+// The actor of the Presentation Layer is obtained in the same way
+
+Theron::Actor * Theron::Actor::Identification::PresentationLayerActor( void )
+{
+	if ( ThePresentationLayerServer != Address::Null() )
+		return ThePresentationLayerServer->ActorPointer.load();
+	else
+		return nullptr;
 }
 
 // -----------------------------------------------------------------------------
 // Constructor and Destructor
 // -----------------------------------------------------------------------------
 //
-// Then this newly created Identification object is inserted into the
-// relevant maps. The access to the maps must be locked to ensure to prevent
-// the situation where an Identification is created and destroyed at the same
-// time
+// The constructor only initialises the Identification, and the generator
+// function inserts the newly created Identification object into the relevant
+// registries.
 
 Theron::Actor::Identification::Identification( const std::string & ActorName )
 : enable_shared_from_this(),
   NumericalID( GetNewID() ),  Name( ActorName.empty() ?
 		  "Actor" + std::to_string( NumericalID ) : ActorName ),
   ActorPointer( nullptr )
-{
-	std::lock_guard< std::recursive_mutex > Lock( InformationAccess );
+{}
 
-	ActorsByName.emplace( Name,        this );
-	ActorsByID.emplace  ( NumericalID, this );
-}
-
-// The destructor simply reverses this registration after locking the access
-// to the registries.
+// The destructor simply reverses this registration, leaving the entry of a
+// replacing Identification for the same name.
 
 Theron::Actor::Identification::~Identification( void )
 {
-  std::lock_guard< std::recursive_mutex > Lock( InformationAccess )	;
-
-	ActorsByName.erase( Name 			  );
-	ActorsByID.erase  ( NumericalID );
+	ActorsByName.Remove( Name, 			  this );
+	ActorsByID.Remove  ( NumericalID, this );
 }
 
 
@@ -308,45 +358,280 @@ Theron::Actor::Identification::~Identification( void )
 
 =============================================================================*/
 
-// The mailbox stores a message by simply enqueue it after locking the mutex
-// to ensure that only one thread will enqueue a message at the time. After
-// adding the message to the queue it will signal the new message condition.
+// -----------------------------------------------------------------------------
+// Events
+// -----------------------------------------------------------------------------
+//
+// On Linux the parking is a futex wait on the sequence counter, which returns
+// immediately if the counter is no longer the value seen by the waiting
+// thread. The atomic counter must then have the same representation as the
+// integer used by the futex. Elsewhere the parking is a condition variable
+// waiting for the counter to change.
+
+#ifdef __linux__
+
+static_assert( sizeof( std::atomic< std::uint32_t > ) == sizeof( std::uint32_t )
+							 && std::atomic< std::uint32_t >::is_always_lock_free,
+							 "The futex requires a plain 32 bit atomic counter" );
+
+void Theron::Actor::MessageQueue::Event::Park( std::uint32_t SeenSequence )
+{
+	syscall( SYS_futex, reinterpret_cast< std::uint32_t * >( &Sequence ),
+					 FUTEX_WAIT_PRIVATE, SeenSequence, nullptr, nullptr, 0 );
+}
+
+void Theron::Actor::MessageQueue::Event::Park( std::uint32_t SeenSequence,
+																					 std::chrono::nanoseconds Timeout )
+{
+	timespec Relative{
+		static_cast< time_t >( Timeout.count() / 1000000000 ),
+		static_cast< long >( Timeout.count() % 1000000000 ) };
+
+	syscall( SYS_futex, reinterpret_cast< std::uint32_t * >( &Sequence ),
+					 FUTEX_WAIT_PRIVATE, SeenSequence, &Relative, nullptr, 0 );
+}
+
+void Theron::Actor::MessageQueue::Event::WakeAll( void )
+{
+	syscall( SYS_futex, reinterpret_cast< std::uint32_t * >( &Sequence ),
+					 FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0 );
+}
+
+#else
+
+void Theron::Actor::MessageQueue::Event::Park( std::uint32_t SeenSequence )
+{
+	std::unique_lock< std::mutex > Lock( ParkingGuard );
+
+	Parking.wait( Lock, [&](void)->bool{ return Sequence != SeenSequence; } );
+}
+
+void Theron::Actor::MessageQueue::Event::Park( std::uint32_t SeenSequence,
+																					 std::chrono::nanoseconds Timeout )
+{
+	std::unique_lock< std::mutex > Lock( ParkingGuard );
+
+	Parking.wait_for( Lock, Timeout,
+										[&](void)->bool{ return Sequence != SeenSequence; } );
+}
+
+void Theron::Actor::MessageQueue::Event::WakeAll( void )
+{
+	std::lock_guard< std::mutex > Lock( ParkingGuard );
+	Parking.notify_all();
+}
+
+#endif
+
+// Awaiting a condition records the sequence and registers the thread as a
+// waiter before testing the condition again. A thread signalling the event
+// after changing the condition will either see the waiter and wake it, or the
+// waiter will see the changed condition. Spurious wake ups just lead to a new
+// test of the condition.
+
+void Theron::Actor::MessageQueue::Event::Await(
+																 const std::function< bool( void ) > & Condition )
+{
+	while ( !Condition() )
+	{
+		std::uint32_t SeenSequence = Sequence.load();
+
+		Waiters++;
+
+		if ( !Condition() )
+			Park( SeenSequence );
+
+		Waiters--;
+	}
+}
+
+// The timed wait parks for the remaining time only, and it gives up when the
+// time out has passed.
+
+bool Theron::Actor::MessageQueue::Event::Await(
+																 const std::function< bool( void ) > & Condition,
+																 std::chrono::nanoseconds Timeout )
+{
+	const auto Deadline = std::chrono::steady_clock::now() + Timeout;
+
+	while ( !Condition() )
+	{
+		auto Remaining = Deadline - std::chrono::steady_clock::now();
+
+		if ( Remaining <= std::chrono::nanoseconds::zero() )
+			return false;
+
+		std::uint32_t SeenSequence = Sequence.load();
+
+		Waiters++;
+
+		if ( !Condition() )
+			Park( SeenSequence,
+						std::chrono::duration_cast< std::chrono::nanoseconds >( Remaining ) );
+
+		Waiters--;
+	}
+
+	return true;
+}
+
+void Theron::Actor::MessageQueue::Event::Signal( void )
+{
+	Sequence++;
+
+	if ( Waiters > 0 )
+		WakeAll();
+}
+
+Theron::Actor::MessageQueue::Event::Event( void )
+: Sequence(0), Waiters(0)
+{ }
+
+// -----------------------------------------------------------------------------
+// Queue operations
+// -----------------------------------------------------------------------------
+//
+// Linking a message sets its link to the null pointer before it becomes the
+// new tail, and then links the previous tail to the message. The exchange
+// ensures that the message is visible to the consumer when it follows the
+// link of the previous tail.
+
+void Theron::Actor::MessageQueue::Link( GenericMessage * TheMessage )
+{
+	TheMessage->NextMessage.store( nullptr, std::memory_order_relaxed );
+
+	GenericMessage * Previous = Tail.exchange( TheMessage,
+																						 std::memory_order_acq_rel );
+
+	Previous->NextMessage.store( TheMessage, std::memory_order_release );
+}
+
+// The mailbox stores a message by letting it refer to itself so that it stays
+// alive while it is in the queue, and then links it at the tail of the queue.
+// The count is incremented before the message is linked so that the queue is
+// never seen as empty while it has a message, and the consumer will wait for
+// the link if it sees the count before the message. Finally, the new message
+// event is signalled. The message is also counted as a pending activity of
+// the actor system until it is deleted from the queue.
 
 void Theron::Actor::MessageQueue::StoreMessage(
 													  const std::shared_ptr<GenericMessage> & TheMessage )
 {
-	std::unique_lock< std::mutex > QueueLock( QueueGuard );
-	push( TheMessage );
-	NewMessage.notify_all();
+	TheMessage->QueueReference = TheMessage;
+
+	PendingActivities++;
+	Count++;
+	Link( TheMessage.get() );
+
+	NewMessage.Signal();
+}
+
+// The first message is the head unless the head is the stub. Then the first
+// message is the one linked after the stub, and the consumer waits for the
+// producer to set the link if it is not yet set.
+
+Theron::Actor::GenericMessage * Theron::Actor::MessageQueue::FirstMessage( void )
+{
+	while ( Head == &Stub )
+	{
+		GenericMessage * Next = Stub.NextMessage.load( std::memory_order_acquire );
+
+		if ( Next == nullptr )
+			std::this_thread::yield();
+		else
+			Head = Next;
+	}
+
+	return Head;
+}
+
+const std::shared_ptr< Theron::Actor::GenericMessage > &
+Theron::Actor::MessageQueue::front( void )
+{
+	return FirstMessage()->QueueReference;
 }
 
 // When an actor sends a message to another actor, it will call the
 // enqueue message function on the receiving agent with a pointer to a copy of
 // the message to ensure that it does exists also when the message is handed
 // by the receiving actor. The enqueue function will simply ask the mailbox to
-// store the message.
-//
-// The enqueue function will first append the message to the message queue, and
-// if no postman in running, it will start the thread to dispatch the message
-// to the right handler.
+// store the message. A pooled actor is then submitted to the pool if this
+// message is its only pending message since it is otherwise already queued or
+// executing with a worker, and an actor with a dedicated thread starts its
+// Postman if it is not active. If the mailbox is full, the overflow policy decides
+// if the message is stored after waiting for space, or if it is refused.
 
 bool Theron::Actor::EnqueueMessage(
 													const	std::shared_ptr< GenericMessage > & TheMessage )
 {
+	if ( Mailbox.IsFull() )
+		switch ( OverflowPolicy.load() )
+		{
+			case MailboxOverflow::Block:
+				if ( !IsExecutingThread() )
+					Mailbox.WaitForSpace();
+				break;
+			case MailboxOverflow::Reject:
+				RefusedMessages++;
+				return false;
+			case MailboxOverflow::Discard:
+				RefusedMessages++;
+				return true;
+		}
+
 	Mailbox.StoreMessage( TheMessage );
+
+	if ( Execution == ExecutionMode::ThreadPool )
+	{
+		if ( PendingMessages.fetch_add( 1 ) == 0 )
+			ThePool->Submit( this );
+	}
+	else if ( !PostmanActive.load() )
+		StartPostman();
+
 	return true;
 }
 
 // A message is deleted from the dispatching function after it has been given
-// to all message handlers for this message type. It indicates the end of the
-// processing for this message so it can safely be popped from the queue and
-// other threads waiting for this event can be notified.
+// to all message handlers for this message type. The head moves to the next
+// message, and if the first message is the tail, the stub is linked after it
+// so that the tail does not refer to the deleted message. If a producer is
+// linking a message at the same time, the consumer waits for the link. The
+// message releases its reference to itself when it is no longer in the queue,
+// and the message done event is signalled when the queue becomes empty. If
+// the queue is bounded, the space available event is signalled when the
+// queue is below its capacity.
 
 void Theron::Actor::MessageQueue::DeleteFirstMessage( void )
 {
-	std::unique_lock< std::mutex > QueueLock( QueueGuard );
-	pop();
-	MessageDone.notify_all();
+	GenericMessage * First = FirstMessage(),
+								 * Next  = First->NextMessage.load( std::memory_order_acquire );
+
+	if ( Next == nullptr )
+	{
+		if ( Tail.load() == First )
+			Link( &Stub );
+
+		while ( ( Next = First->NextMessage.load( std::memory_order_acquire ) )
+						== nullptr )
+			std::this_thread::yield();
+	}
+
+	Head = Next;
+
+	std::shared_ptr< GenericMessage > Handled( std::move( First->QueueReference ) );
+
+	size_type Remaining = Count.fetch_sub( 1 ) - 1,
+						Limit  	  = Capacity.load( std::memory_order_relaxed );
+
+	if ( Remaining == 0 )
+		MessageDone.Signal();
+
+	if ( ( Limit > 0 ) && ( Remaining < Limit ) )
+		SpaceAvailable.Signal();
+
+	if ( PendingActivities.fetch_sub( 1 ) == 1 )
+		QuiescenceReached();
 }
 
 // The method to check if the queue is empty will wait for a message if that
@@ -357,32 +642,30 @@ void Theron::Actor::MessageQueue::DeleteFirstMessage( void )
 bool Theron::Actor::MessageQueue::HasMessage(
 																Theron::Actor::MessageQueue::QueueEmpty Action )
 {
-	std::unique_lock< std::mutex > QueueLock( QueueGuard );
-	if ( empty() )
-  {
-		if ( Action == QueueEmpty::Wait )
-		{
-			NewMessage.wait( QueueLock, [&](void)->bool{ return size() > 0; } );
-			return true;
-		}
-		else
-			return false;
-	}
-	else
-		return true;
+	if ( ( Count.load() == 0 ) && ( Action == QueueEmpty::Wait ) )
+		NewMessage.Await( [&](void)->bool{ return Count.load() > 0; } );
+
+	return Count.load() > 0;
+}
+
+// The timed version is used by the Postman to detect that it has been idle
+
+bool Theron::Actor::MessageQueue::AwaitMessage( std::chrono::nanoseconds Timeout )
+{
+	return NewMessage.Await( [&](void)->bool{ return Count.load() > 0; }, Timeout );
 }
 
 // Waiting for the next message to arrive is a forced version of the check for
 // message function since it will block until the message has arrived. This is
 // therefore also safe to be used from message handlers via the corresponding
-// function on the actor's interface.
+// function on the actor's interface. The last message is the tail, which is
+// not deleted while the consumer waits, unless it is the stub.
 
 void Theron::Actor::MessageQueue::WaitForNextMessage(
 																const Theron::Actor::Address & SenderToWaitFor )
 {
-	// The lock is taken and the current queue size is remembered
+	// The current queue size is remembered
 
-	std::unique_lock< std::mutex > QueueLock( QueueGuard );
 	auto IngressQueueSize = size();
 
 	// The condition depends on what the given address is. If it is Null then
@@ -391,278 +674,1428 @@ void Theron::Actor::MessageQueue::WaitForNextMessage(
 	// is from the specified sender.
 
 	if ( SenderToWaitFor == Address::Null() )
-		NewMessage.wait( QueueLock,
-										 [&](void)->bool{ return size() > IngressQueueSize; } );
+		NewMessage.Await( [&](void)->bool{ return size() > IngressQueueSize; } );
 	else
-		NewMessage.wait( QueueLock,
-										 [&](void)->bool{ return back()->From == SenderToWaitFor;});
+		NewMessage.Await( [&](void)->bool{
+			GenericMessage * Last = Tail.load( std::memory_order_acquire );
+			return ( Last != &Stub ) && ( Last->From == SenderToWaitFor ); });
 }
 
 // Waiting for the the queue to drain is potentially the only wait that could
 // have multiple threads waiting for the signal since the condition for
 // termination is unique: The queue should be empty! If another message has
-// arrived before a thread manages to start up and process the notification,
-// then it is still right to block again waiting for the next signal.
+// arrived before a thread manages to start up and process the event, then it
+// is still right to wait again for the next signal.
 
 void Theron::Actor::MessageQueue::WaitUntilEmpty( void )
 {
-	std::unique_lock< std::mutex > QueueLock( QueueGuard );
+	MessageDone.Await( [&](void)->bool{ return Count.load() == 0; } );
+}
 
-	// Since the condition is tested before the wait triggers, it is safe to call
-	// the wait directly even if the queue should already be empty.
+// Waiting for space is similar, and it also returns if the capacity is
+// removed while waiting.
 
-  MessageDone.wait( QueueLock, [&](void)->bool{ return empty(); } );
+void Theron::Actor::MessageQueue::WaitForSpace( void )
+{
+	SpaceAvailable.Await( [&](void)->bool{
+		size_type Limit = Capacity.load();
+		return ( Limit == 0 ) || ( Count.load() < Limit );
+	});
 }
 
-/*=============================================================================
+// The constructor makes the stub the only element of the queue. There are no
+// producers when the queue is destroyed, and the remaining messages, like the
+// empty message used to stop the Postman, can simply be deleted.
 
- Execution control
+Theron::Actor::MessageQueue::MessageQueue( void )
+: NewMessage(), MessageDone(), SpaceAvailable(), Stub(), Head( &Stub ),
+  Tail( &Stub ), Count(0), Capacity(0)
+{ }
 
-=============================================================================*/
+Theron::Actor::MessageQueue::~MessageQueue( void )
+{
+	while ( Count.load() > 0 )
+		DeleteFirstMessage();
+}
 
-// The dispatcher function first obtains a copy of the message at the front of
-// the message queue, and then tries to deliver this to each handler in turn
-// Handlers successfully managing this message will be moved forward in the
-// list of handlers according to the transposition rule suggested by Ronald
-// Rivest (1976): "On self-organizing sequential search heuristics",
-// Communications of the ACM, Vol. 19, No. 2, pp. 63-67
-//
-// If no message handler is available to serve the message the message will
-// be delivered to the default message handler. If no default message handler
-// exists, then the message will be handled according to the error policy set.
+// -----------------------------------------------------------------------------
+// Message pools
+// -----------------------------------------------------------------------------
 //
-// The handler is supposed to run in the actor's thread and it will block if
-// there is no message available.
+// The pools register their counters the first time they allocate a message,
+// and the registry is only locked for the registration and for reading the
+// statistics. The statistics sum the counters of the pools of each message
+// type in the order the types were first used. The pools of a message type
+// have different block sizes, and the bytes are therefore summed per pool.
+// The counters are read one by one while messages are sent, and a pool may
+// momentarily seem to have released more blocks than it has allocated.
+
+namespace Theron
+{
+	static std::mutex PoolRegistryGuard;
+}
 
-void Theron::Actor::DispatchMessages( void )
+std::vector< Theron::Actor::PoolRegistration > &
+Theron::Actor::PoolRegistry( void )
 {
-	// Messages are continuously dispatched as long as there are more messages
-	// and the actor is running. Note that the order of these tests is important
-	// when the actor terminates because the destructor will first wait for the
-	// queue to drain, and then set the running flag to false before submitting
-	// an empty message that will stop the wait on a message, but cause the while
-	// loop to terminate because the actor is no longer running and thereby avoid
-	// processing the empty message.
+	static std::vector< PoolRegistration > TheRegistry;
+	return TheRegistry;
+}
 
-	while ( Mailbox.HasMessage( MessageQueue::QueueEmpty::Wait ) && ActorRunning )
-  {
-	  // There is an iterator to the current handler, and a flag indicating that
-		// the message has been served by at least one handler.
+void Theron::Actor::RegisterMessagePool( const PoolRegistration & ThePool )
+{
+	std::lock_guard< std::mutex > Lock( PoolRegistryGuard );
+	PoolRegistry().push_back( ThePool );
+}
 
-		auto CurrentHandler = MessageHandlers.begin();
-		bool MessageServed  = false;
+std::vector< Theron::Actor::MessagePoolCounters >
+Theron::Actor::MessagePoolStatistics( void )
+{
+	std::lock_guard< std::mutex > Lock( PoolRegistryGuard );
+	std::vector< MessagePoolCounters > Statistics;
 
-		// It is an overhead to call Mailbox front for each handler as the first
-		// message in the queue can be cached
+	for ( const PoolRegistration & ThePool : PoolRegistry() )
+	{
+		auto TypeCounters = std::find_if( Statistics.begin(), Statistics.end(),
+			[&]( const MessagePoolCounters & Counters ){
+				return Counters.MessageType == ThePool.MessageType; });
 
-		auto TheMessage = Mailbox.front();
+		if ( TypeCounters == Statistics.end() )
+			TypeCounters = Statistics.insert( Statistics.end(),
+										 MessagePoolCounters{ ThePool.MessageType, 0, 0, 0, 0 } );
 
-		// ...and then loop over all handlers to allow them to manage the message
-		// if they are able to.
+		std::size_t Allocated = ThePool.Allocations->load(),
+								Released  = ThePool.Released->load(),
+								Blocks 		= ThePool.HeapBlocks->load();
 
-		while ( CurrentHandler != MessageHandlers.end() )
-		{
-			// There is a minor problem related to the handler call since invoking the
-			// message handler may create or destroy handlers. A mutex cannot help
-			// since the handler is executing in this thread, and since it runs on
-			// the same stack all operations implicitly made by the handler
-			// on the handler list will have terminated when control is returned to
-			// this method. Insertions are not problematic since they will appear at
-			// the end of the list, and will just be included in the continued
-			// iterations here. Deletions are similarly not problematic unless the
-			// handler de-register itself.
-			//
-			// In this case it does not help having an iterator to the next element
-			// as there is also no guarantee that that also that pointer will not be
-			// deleted. The only safe way is to ensure that the handler object for
-			// the current handler is not deleted. A copy of the current handler is
-			// therefore made, and its status is set to executing.
+		TypeCounters->Allocations += Allocated;
+		TypeCounters->Recycled    += ThePool.Recycled->load();
 
-			auto ExecutingHandler = CurrentHandler;
-			(*ExecutingHandler)->SetStatus( GenericHandler::State::Executing );
+		if ( Allocated > Released )
+			TypeCounters->LiveBytes += ( Allocated - Released ) * ThePool.BlockSize;
 
-			// Then the handler can process the message, and if this results in the
-			// handler de-registering this handler, it will return with the deleted
-			// state.
+		if ( static_cast< std::ptrdiff_t >( Blocks ) > 0 )
+			TypeCounters->HeapBytes += Blocks * ThePool.BlockSize;
+	}
 
-			if( (*CurrentHandler)->ProcessMessage( TheMessage ) )
-		  {
-				MessageServed = true;
+	return Statistics;
+}
 
-				// One learn over time which messages that are most frequently used,
-				// and move the forwarding functions for these messages forward in
-				// the handler structure. There are several known strategies known
-				// from the literature. The most famous one is to move the created
-				// message to the front of the list. However, this runs the risk that
-				// if the list is in an organised state, a simple access to one of
-				// the infrequently sent messages will will destroy the organisation
-				// and it will take many messages before the list is again organised.
-
-				// Alternatively, the received message can be moved k elements forward
-				// in the list. A compromise between these two is to move the element
-				// to position k+1 if it it is in the end part of the list (move
-				// almost to front), and the transpose the element with the element
-				// in front if it is in the 2..k positions of the list. This
-				// heuristic is known as the POS(k) rule. Two different strategies
-				// are suggested in Oommen et al. (1990): "Deterministic optimal and
-				// expedient move-to-rear list organizing strategies", Theoretical
-				// Computer Science, Vol. 74, No. 2, pp. 183-197. Their first and
-				// optimal strategy implies keeping a counter for each element, and
-				// then move the accessed element to the rear of the list once it has
-				// been accessed T times. Their expedient strategy implies moving the
-				// element to the rear of the list when it has been accessed T
-				// consecutive times. The implementation cost of the first rule would
-				// be similar to keeping a map sorted on the number of times each
-				// message has arrived - and this map will obviously be exact. Waiting
-				// for T consecutive accesses for an element may again be too slow.
-
-				// The transposition rule suggested by Ronald Rivest (1976): "On
-				// self-organizing sequential search heuristics", Communications of
-				// the ACM, Vol. 19, No. 2, pp. 63-67 is much more efficient. Here a
-				// successfully constructed message will be swapped with the element
-				// immediately in front unless the element is already at the start of
-				// the list. It is necessary to use a separate swap iterator to ensure
-				// that the current handler iterator points to the next handler not
-				// affected by the swap operation.
-
-				auto SuccessfulHandler = CurrentHandler++;
-
-				if( SuccessfulHandler != MessageHandlers.begin() )
-					std::iter_swap( SuccessfulHandler, std::prev( SuccessfulHandler ) );
-			}
-			else
-				++CurrentHandler; // necessary because of the transposition rule
+// -----------------------------------------------------------------------------
+// Message metrics
+// -----------------------------------------------------------------------------
+//
+// The recorder of an actor keeps the counters of each message type, and the
+// map of message types is only locked when a type is added by the executing
+// thread or when the counters are read by another thread. The executing
+// thread can find the counters of a type without the lock since it is the
+// only thread changing the map.
 
-			// The Current Handler is now safely set to a handler that is valid for
-			// the next execution, and the handler just executed can be deleted, or
-			// its state can be switched back to normal.
+class Theron::Actor::MetricsRecorder
+{
+public:
 
-			if ( (*ExecutingHandler)->GetStatus() == GenericHandler::State::Deleted )
-				MessageHandlers.erase( ExecutingHandler );
-			else
-				(*ExecutingHandler)->SetStatus( GenericHandler::State::Normal );
-		}
+	using Clock = std::chrono::steady_clock;
 
-		// If the message is not served at this point, it should be delivered to
-		// the fall back handler. If that handler does not exist it should either
-		// be ignored or an error message will be thrown.
+	class TypeCounters
+	{
+	public:
 
-		if ( ! MessageServed )
-		{
-			if ( DefaultHandler )
-				DefaultHandler->ProcessMessage( TheMessage );
-			else if ( MessageErrorPolicy == MessageError::Throw )
-		  {
-				std::ostringstream ErrorMessage;
-				auto RawMessagePointer = *(Mailbox.front());
-
-				ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
-										 << "No message handler for the message "
-										 << typeid( RawMessagePointer ).name()
-										 << " from " << RawMessagePointer.From.AsString()
-										 << " to " << RawMessagePointer.To.AsString()
-										 << " and no default message handler!";
-
-			  throw std::logic_error( ErrorMessage.str() );
-			}
-		}
+		std::atomic< std::uint64_t > Messages, Nanoseconds;
+		std::array< std::atomic< std::uint64_t >,
+								HandlerMetrics::Buckets > Histogram;
 
-		// The message is fully handled, and it can be popped from the queue and
-		// thereby prepare the queue for processing the next message.
+		TypeCounters( void )
+		: Messages(0), Nanoseconds(0)
+		{ for ( auto & Counter : Histogram ) Counter = 0; }
+	};
 
-		Mailbox.DeleteFirstMessage();
+	const std::string 				 ActorName;
+	std::atomic< std::size_t > QueuedMessages, MaximalQueue;
+	std::atomic< bool >				 Closed;
+	std::atomic< Clock::rep >	 FirstMessage;
 
-		// The callback that a new message has arrived and is processed is given
-		// in case derived classes need this information.
+	std::mutex TypesGuard;
+	std::unordered_map< std::type_index,
+											std::unique_ptr< TypeCounters > > Types;
 
-		MessageProcessed();
+	// Recording a message updates the counters of its type, and the time of the
+	// first message is set by the first message recorded after a reset.
 
-		// Finally, the thread yields before processing the next message to allow
-		// other threads and actors to progress in parallel.
+	void Record( const std::type_index & MessageType, std::size_t Queued,
+							 Clock::time_point Start, Clock::time_point End );
 
-		std::this_thread::yield();
+	ActorMetrics Snapshot( void );
+	void Reset( void );
 
-	}     // While Actor is running
-}				// Dispatch function
+	MetricsRecorder( const std::string & Name )
+	: ActorName( Name ), QueuedMessages(0), MaximalQueue(0), Closed( false ),
+	  FirstMessage(0), TypesGuard(), Types()
+	{ }
+};
 
+void Theron::Actor::MetricsRecorder::Record(
+	const std::type_index & MessageType, std::size_t Queued,
+	Clock::time_point Start, Clock::time_point End )
+{
+	auto TheType = Types.find( MessageType );
 
-// When the Postman has processed a message it will notify the actor about this
-// event by calling the virtual message processed function, which will in turn
-// notify other threads that may wait for the condition variable.
+	if ( TheType == Types.end() )
+	{
+		std::lock_guard< std::mutex > Lock( TypesGuard );
+		TheType = Types.emplace( MessageType,
+														 std::make_unique< TypeCounters >() ).first;
+	}
 
-void Theron::Actor::MessageProcessed( void )
-{ }
+	TypeCounters & Counters( *TheType->second );
+	std::uint64_t  Duration = static_cast< std::uint64_t >(
+		std::chrono::duration_cast< std::chrono::nanoseconds >( End - Start ).count() );
 
-// The function to wait for the mailbox to drain is identical to the previous,
-// except that it uses a different predicate function to the wait to avoid the
-// additional overhead of repeatedly calling the wait for one message and
-// acquire the lock (although it will happen implicitly in the wait condition)
+	Counters.Messages.fetch_add( 1, std::memory_order_relaxed );
+	Counters.Nanoseconds.fetch_add( Duration, std::memory_order_relaxed );
+	Counters.Histogram[ HandlerMetrics::Bucket( Duration ) ].fetch_add( 1,
+																									std::memory_order_relaxed );
 
-void Theron::Actor::DrainMailbox( void )
+	QueuedMessages.store( Queued, std::memory_order_relaxed );
+
+	if ( Queued > MaximalQueue.load( std::memory_order_relaxed ) )
+		MaximalQueue.store( Queued, std::memory_order_relaxed );
+
+	Clock::rep NoMessage = 0;
+	FirstMessage.compare_exchange_strong( NoMessage,
+																				Start.time_since_epoch().count() );
+}
+
+Theron::Actor::ActorMetrics Theron::Actor::MetricsRecorder::Snapshot( void )
 {
-	if ( std::this_thread::get_id() != Postman.get_id() )
-		Mailbox.WaitUntilEmpty();
-	else
+	ActorMetrics Result;
+	Clock::rep 	 First = FirstMessage.load();
+
+	Result.ActorName 			 = ActorName;
+	Result.QueuedMessages  = Closed ? 0 : QueuedMessages.load();
+	Result.MaximalQueue  	 = MaximalQueue.load();
+	Result.ObservedSeconds = ( First == 0 ) ? 0.0 :
+		std::chrono::duration< double >( Clock::now().time_since_epoch() -
+																		 Clock::duration( First ) ).count();
+
+	std::lock_guard< std::mutex > Lock( TypesGuard );
+
+	for ( auto & TheType : Types )
 	{
-		std::ostringstream ErrorMessage;
+		HandlerMetrics Handler;
 
-		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
-								 << "Actor " << ActorID.AsString()
-								 << "Cannot wait for message DRAIN within the same actor!";
+		Handler.MessageType 	 = TheType.first.name();
+		Handler.Messages 			 = TheType.second->Messages.load();
+		Handler.HandlerSeconds = TheType.second->Nanoseconds.load() * 1e-9;
 
-		throw std::logic_error( ErrorMessage.str() );
+		for ( std::size_t i = 0; i < HandlerMetrics::Buckets; i++ )
+			Handler.Histogram[i] = TheType.second->Histogram[i].load();
+
+		Result.MessageTypes.push_back( Handler );
 	}
+
+	return Result;
 }
 
-// The identification's function to wait for global termination will start
-// from the beginning of the registry of Identifications and wait for the first
-// actor to drain its queue. It will not move to the second actor before the
-// first actor has drained. Whenever an actor is found with messages, the
-// wait will re-start from the beginning of the actor registry because the
-// the actor that had messages could send messages to other actors, and hence
-// it is necessary to wait for them too.
+void Theron::Actor::MetricsRecorder::Reset( void )
+{
+	std::lock_guard< std::mutex > Lock( TypesGuard );
+
+	for ( auto & TheType : Types )
+	{
+		TheType.second->Messages 		= 0;
+		TheType.second->Nanoseconds = 0;
+
+		for ( auto & Counter : TheType.second->Histogram )
+			Counter = 0;
+	}
+
+	MaximalQueue = QueuedMessages.load();
+	FirstMessage = 0;
+}
+
+// The buckets of the histogram are the first four nanoseconds, and then four
+// buckets for each power of two given by the two bits following the leading
+// bit. Times beyond the last octave are counted in the last bucket.
+
+std::size_t Theron::Actor::HandlerMetrics::Bucket( std::uint64_t Nanoseconds )
+{
+	if ( Nanoseconds < BucketsPerOctave )
+		return static_cast< std::size_t >( Nanoseconds );
+
+	std::size_t Octave = 63 - __builtin_clzll( Nanoseconds ),
+							TheBucket = ( Octave - 1 ) * BucketsPerOctave +
+													( ( Nanoseconds >> ( Octave - 2 ) ) & 3 );
+
+	return std::min( TheBucket, Buckets - 1 );
+}
+
+double Theron::Actor::HandlerMetrics::BucketSeconds( std::size_t TheBucket )
+{
+	if ( TheBucket < BucketsPerOctave )
+		return ( TheBucket + 1 ) * 1e-9;
+
+	std::size_t Octave = TheBucket / BucketsPerOctave + 1,
+							Step   = std::size_t(1) << ( Octave - 2 );
+
+	return static_cast< double >( ( BucketsPerOctave + TheBucket % BucketsPerOctave )
+																* Step + Step ) * 1e-9;
+}
+
+double Theron::Actor::HandlerMetrics::Percentile( double Fraction ) const
+{
+	if ( Messages == 0 ) return 0.0;
+
+	std::uint64_t Target = static_cast< std::uint64_t >(
+												 std::ceil( Fraction * Messages ) ),
+								Seen   = 0;
+
+	for ( std::size_t i = 0; i < Buckets; i++ )
+	{
+		Seen += Histogram[i];
+
+		if ( ( Seen >= Target ) && ( Seen > 0 ) )
+			return BucketSeconds( i );
+	}
+
+	return BucketSeconds( Buckets - 1 );
+}
+
+double Theron::Actor::ActorMetrics::MessageRate( void ) const
+{
+	std::uint64_t Handled = 0;
+
+	for ( const HandlerMetrics & Handler : MessageTypes )
+		Handled += Handler.Messages;
+
+	return ( ObservedSeconds > 0.0 ) ? Handled / ObservedSeconds : 0.0;
+}
+
+// The recorders of all actors are kept in a registry, which is only locked
+// when an actor creates its recorder and when the metrics are read or reset.
+// The periodic dump is done by a thread that is stopped when a new dump is
+// started or when the program terminates.
+
+std::atomic< bool > Theron::Actor::CollectMetrics( false );
+
+namespace Theron
+{
+	static std::mutex MetricsGuard;
+
+	class MetricsDumper
+	{
+	private:
+
+		std::mutex 							StopGuard;
+		std::condition_variable Stopping;
+		bool 										Stop;
+		std::thread 						Writer;
+
+	public:
+
+		MetricsDumper( const std::string & FileName,
+									 std::chrono::milliseconds Interval )
+		: StopGuard(), Stopping(), Stop( false ), Writer()
+		{
+			Writer = std::thread( [this, FileName, Interval](){
+				std::unique_lock< std::mutex > Lock( StopGuard );
+
+				while ( !Stopping.wait_for( Lock, Interval, [this]{ return Stop; } ) )
+				{
+					std::string Temporary( FileName + ".tmp" );
+
+					{
+						std::ofstream Output( Temporary );
+						Actor::WriteMetrics( Output );
+					}
+
+					std::rename( Temporary.c_str(), FileName.c_str() );
+				}
+			});
+		}
+
+		~MetricsDumper( void )
+		{
+			{
+				std::lock_guard< std::mutex > Lock( StopGuard );
+				Stop = true;
+			}
+
+			Stopping.notify_all();
+			Writer.join();
+		}
+	};
+
+	static std::unique_ptr< MetricsDumper > TheMetricsDumper;
+}
+
+std::list< std::shared_ptr< Theron::Actor::MetricsRecorder > > &
+Theron::Actor::MetricsRegistry( void )
+{
+	static std::list< std::shared_ptr< MetricsRecorder > > TheRegistry;
+	return TheRegistry;
+}
+
+void Theron::Actor::EnableMetrics( bool Collect )
+{
+	CollectMetrics.store( Collect );
+}
+
+std::vector< Theron::Actor::ActorMetrics >
+Theron::Actor::MetricsSnapshot( void )
+{
+	std::lock_guard< std::mutex > Lock( MetricsGuard );
+	std::vector< ActorMetrics > Snapshot;
+
+	for ( auto & Recorder : MetricsRegistry() )
+		Snapshot.push_back( Recorder->Snapshot() );
+
+	return Snapshot;
+}
+
+// Resetting the metrics forgets the actors that have been closed
+
+void Theron::Actor::ResetMetrics( void )
+{
+	std::lock_guard< std::mutex > Lock( MetricsGuard );
+
+	MetricsRegistry().remove_if(
+		[]( const std::shared_ptr< MetricsRecorder > & Recorder ){
+			return Recorder->Closed.load(); });
+
+	for ( auto & Recorder : MetricsRegistry() )
+		Recorder->Reset();
+}
+
+// The metrics are written as one JSON object with an array of actors, and
+// the handler times are given in microseconds. The names are escaped since
+// actor names are chosen by the application.
+
+void Theron::Actor::WriteMetrics( std::ostream & Output )
+{
+	auto Quoted = []( const std::string & Text ){
+		std::string Result( "\"" );
+
+		for ( char Character : Text )
+		{
+			if ( ( Character == '"' ) || ( Character == '\\' ) )
+				Result.push_back( '\\' );
+
+			Result.push_back( Character );
+		}
+
+		return Result + "\"";
+	};
+
+	Output << "{\"actors\": [";
+
+	bool FirstActor = true;
+
+	for ( const ActorMetrics & TheActor : MetricsSnapshot() )
+	{
+		Output << ( FirstActor ? "" : "," )
+					 << "\n  {\"name\": " << Quoted( TheActor.ActorName )
+					 << ", \"queued\": " << TheActor.QueuedMessages
+					 << ", \"maximal_queue\": " << TheActor.MaximalQueue
+					 << ", \"seconds\": " << TheActor.ObservedSeconds
+					 << ", \"rate\": " << TheActor.MessageRate()
+					 << ", \"messages\": [";
+
+		bool FirstType = true;
+
+		for ( const HandlerMetrics & Handler : TheActor.MessageTypes )
+		{
+			Output << ( FirstType ? "" : "," )
+						 << "\n    {\"type\": " << Quoted( Handler.MessageType )
+						 << ", \"count\": " << Handler.Messages
+						 << ", \"mean_us\": "
+						 << ( Handler.Messages > 0 ?
+									1e6 * Handler.HandlerSeconds / Handler.Messages : 0.0 )
+						 << ", \"p50_us\": " << 1e6 * Handler.Percentile( 0.50 )
+						 << ", \"p90_us\": " << 1e6 * Handler.Percentile( 0.90 )
+						 << ", \"p99_us\": " << 1e6 * Handler.Percentile( 0.99 )
+						 << ", \"max_us\": " << 1e6 * Handler.Percentile( 1.00 ) << "}";
+
+			FirstType = false;
+		}
+
+		Output << "]}";
+		FirstActor = false;
+	}
+
+	Output << "\n]}\n";
+}
+
+void Theron::Actor::DumpMetrics( const std::string & FileName,
+																 std::chrono::milliseconds Interval )
+{
+	TheMetricsDumper.reset();
+
+	if ( Interval.count() > 0 )
+		TheMetricsDumper = std::make_unique< MetricsDumper >( FileName, Interval );
+}
+
+// -----------------------------------------------------------------------------
+// Message tracing
+// -----------------------------------------------------------------------------
+//
+// A trace buffer is written by its thread and read when the trace is written,
+// and it is therefore protected by a mutex, which is uncontended while the
+// actors run. The buffer belongs to the trace generation it was last written
+// in, and a thread clears its buffer when it records the first event of a new
+// trace. Hence, starting a trace never touches the buffers of other threads,
+// and only the buffers of the current trace are written.
+
+class Theron::Actor::TraceBuffer
+{
+public:
+
+	class Event
+	{
+	public:
+
+		bool 				 	Handling;
+		std::uint64_t TraceID;
+		std::int64_t  Start, Duration;
+		std::string 	From, To;
+		const char *  MessageType;
+	};
+
+	std::mutex 					 Guard;
+	std::vector< Event > Events;
+	std::size_t 				 Recorded, Generation;
+	const std::size_t 	 Thread;
+	std::string 				 ThreadName;
+
+	TraceBuffer( std::size_t Ordinal )
+	: Guard(), Events(), Recorded(0), Generation(0), Thread( Ordinal ),
+	  ThreadName()
+	{ }
+};
+
+std::atomic< bool > Theron::Actor::TraceMessages( false );
+
+namespace Theron
+{
+	static std::mutex 									 TraceGuard;
+	static std::atomic< std::size_t >		 TraceGeneration(0), TraceCapacity(0);
+	static std::atomic< std::uint64_t >  TraceCounter(0);
+	static std::atomic< std::chrono::steady_clock::rep > TraceEpoch(0);
+}
+
+thread_local std::shared_ptr< Theron::Actor::TraceBuffer >
+						 Theron::Actor::ThreadTrace;
+
+std::list< std::shared_ptr< Theron::Actor::TraceBuffer > > &
+Theron::Actor::TraceRegistry( void )
+{
+	static std::list< std::shared_ptr< TraceBuffer > > TheRegistry;
+	return TheRegistry;
+}
+
+void Theron::Actor::StartTracing( std::size_t EventsPerThread )
+{
+	std::lock_guard< std::mutex > Lock( TraceGuard );
+
+	TraceCapacity = std::max< std::size_t >( EventsPerThread, 1 );
+	TraceEpoch 		= std::chrono::steady_clock::now().time_since_epoch().count();
+	TraceGeneration++;
+	TraceMessages = true;
+}
+
+void Theron::Actor::StopTracing( void )
+{
+	TraceMessages = false;
+}
+
+// A sent message is given the next trace identifier before it is recorded
+
+void Theron::Actor::TraceSend( GenericMessage & TheMessage )
+{
+	auto Now = std::chrono::steady_clock::now();
+
+	TheMessage.TraceID = ++TraceCounter;
+	RecordTraceEvent( TheMessage, false, Now, Now );
+}
+
+void Theron::Actor::TraceHandling( const GenericMessage & TheMessage,
+	std::chrono::steady_clock::time_point Start,
+	std::chrono::steady_clock::time_point End )
+{
+	RecordTraceEvent( TheMessage, true, Start, End );
+}
+
+// The trace is written with the times in microseconds as expected by the
+// trace viewers. The sends are instant events with flows starting from them,
+// the handlings are complete events with the flows ending in them, and the
+// threads are named by the actor they handled first, or as pool workers.
+
+void Theron::Actor::WriteTrace( std::ostream & Output )
+{
+	auto Quoted = []( const std::string & Text ){
+		std::string Result( "\"" );
+
+		for ( char Character : Text )
+		{
+			if ( ( Character == '"' ) || ( Character == '\\' ) )
+				Result.push_back( '\\' );
+
+			Result.push_back( Character );
+		}
+
+		return Result + "\"";
+	};
+
+	std::lock_guard< std::mutex > Lock( TraceGuard );
+	std::size_t Generation = TraceGeneration.load();
+	bool 				FirstEvent = true;
+
+	Output << "{\"traceEvents\": [";
+
+	auto Separator = [&]( void )->const char *{
+		const char * Text = FirstEvent ? "\n" : ",\n";
+		FirstEvent = false;
+		return Text;
+	};
+
+	for ( auto & Buffer : TraceRegistry() )
+	{
+		std::lock_guard< std::mutex > BufferLock( Buffer->Guard );
+
+		if ( ( Buffer->Generation != Generation ) || Buffer->Events.empty() )
+			continue;
+
+		Output << Separator()
+					 << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, "
+					 << "\"tid\": " << Buffer->Thread << ", \"args\": {\"name\": "
+					 << Quoted( Buffer->ThreadName.empty() ?
+											"Thread " + std::to_string( Buffer->Thread ) :
+											Buffer->ThreadName ) << "}}";
+
+		for ( const TraceBuffer::Event & TheEvent : Buffer->Events )
+		{
+			std::string Common = ", \"name\": "
+				+ Quoted( TheEvent.MessageType ) + ", \"pid\": 1, \"tid\": "
+				+ std::to_string( Buffer->Thread ) + ", \"ts\": "
+				+ std::to_string( TheEvent.Start / 1e3 );
+
+			std::string Arguments = ", \"args\": {\"from\": "
+				+ Quoted( TheEvent.From ) + ", \"to\": " + Quoted( TheEvent.To ) + "}";
+
+			if ( TheEvent.Handling )
+			{
+				Output << Separator() << "{\"ph\": \"X\", \"cat\": \"handle\""
+							 << Common << ", \"dur\": " << TheEvent.Duration / 1e3
+							 << Arguments << "}";
+
+				if ( TheEvent.TraceID > 0 )
+					Output << Separator() << "{\"ph\": \"f\", \"bp\": \"e\", "
+								 << "\"cat\": \"message\", \"id\": " << TheEvent.TraceID
+								 << Common << "}";
+			}
+			else
+				Output << Separator() << "{\"ph\": \"i\", \"s\": \"t\", "
+							 << "\"cat\": \"send\"" << Common << Arguments << "}"
+							 << Separator() << "{\"ph\": \"s\", \"cat\": \"message\", "
+							 << "\"id\": " << TheEvent.TraceID << Common << "}";
+		}
+	}
+
+	Output << "\n], \"displayTimeUnit\": \"ms\"}\n";
+}
+
+/*=============================================================================
+
+ Placement
+
+=============================================================================*/
+
+// The topology has the processors of each NUMA node that the process may use,
+// indexed by the number of the node, and nodes without usable processors are
+// left empty. The affinity groups are resolved to nodes, and the groups
+// without a core or node are given the nodes in turn. All of this is shared
+// by the actors and protected by a mutex.
+
+namespace Theron
+{
+	class ProcessorTopology
+	{
+	public:
+
+		std::vector< std::vector< unsigned int > > 					Nodes;
+		bool 																				 				Restricted;
+		std::size_t 																				NextGroupNode;
+		std::unordered_map< std::string, Actor::Placement > Groups;
+	};
+
+	static std::mutex PlacementGuard;
+
+	// The system lists the nodes and the processors as ranges separated by
+	// commas, for instance "0-3,8-11".
+
+	static std::vector< unsigned int > ParseRanges( const std::string & List )
+	{
+		std::vector< unsigned int > Numbers;
+		std::istringstream 					Ranges( List );
+		std::string 								Range;
+
+		while ( std::getline( Ranges, Range, ',' ) )
+		{
+			if ( Range.find_first_of( "0123456789" ) == std::string::npos )
+				continue;
+
+			std::size_t  Dash  = Range.find( '-' );
+			unsigned int First = std::stoul( Range.substr( 0, Dash ) ),
+									 Last  = ( Dash == std::string::npos ) ? First
+													 : std::stoul( Range.substr( Dash + 1 ) );
+
+			for ( unsigned int Number = First; Number <= Last; Number++ )
+				Numbers.push_back( Number );
+		}
+
+		return Numbers;
+	}
+
+	// The topology is read from the system the first time it is used. If the
+	// nodes cannot be read, all the processors the process may use are taken to
+	// be on node zero.
+
+	static ProcessorTopology DiscoverTopology( void )
+	{
+		ProcessorTopology TheTopology{ {}, false, 0, {} };
+
+		#ifdef __linux__
+			cpu_set_t Allowed;
+			CPU_ZERO( &Allowed );
+
+			bool Known = ( sched_getaffinity( 0, sizeof( Allowed ), &Allowed ) == 0 );
+
+			std::ifstream OnlineNodes( "/sys/devices/system/node/online" );
+			std::string   NodeList;
+
+			if ( std::getline( OnlineNodes, NodeList ) )
+				for ( unsigned int Node : ParseRanges( NodeList ) )
+				{
+					std::ifstream CPUFile( "/sys/devices/system/node/node"
+																 + std::to_string( Node ) + "/cpulist" );
+					std::string CPUList;
+
+					if ( !std::getline( CPUFile, CPUList ) )
+						continue;
+
+					if ( TheTopology.Nodes.size() <= Node )
+						TheTopology.Nodes.resize( Node + 1 );
+
+					for ( unsigned int CPU : ParseRanges( CPUList ) )
+						if ( !Known || ( ( CPU < CPU_SETSIZE ) && CPU_ISSET( CPU, &Allowed ) ) )
+							TheTopology.Nodes[ Node ].push_back( CPU );
+				}
+
+			if ( Known && std::all_of( TheTopology.Nodes.begin(),
+																 TheTopology.Nodes.end(),
+																 [](const auto & CPUs){ return CPUs.empty(); }) )
+			{
+				TheTopology.Nodes.assign( 1, std::vector< unsigned int >() );
+
+				for ( unsigned int CPU = 0; CPU < CPU_SETSIZE; CPU++ )
+					if ( CPU_ISSET( CPU, &Allowed ) )
+						TheTopology.Nodes.front().push_back( CPU );
+			}
+		#endif
+
+		if ( TheTopology.Nodes.empty() )
+		{
+			TheTopology.Nodes.assign( 1, std::vector< unsigned int >() );
+
+			for ( unsigned int CPU = 0;
+						CPU < std::max( 1U, std::thread::hardware_concurrency() ); CPU++ )
+				TheTopology.Nodes.front().push_back( CPU );
+		}
+
+		return TheTopology;
+	}
+
+	static ProcessorTopology & Topology( void )
+	{
+		static ProcessorTopology TheTopology( DiscoverTopology() );
+		return TheTopology;
+	}
+
+	// The processors of a resolved placement is the core if it is given,
+	// otherwise the processors of the node. An actor without a placement is
+	// only pinned if the processors have been restricted, and then to all the
+	// remaining processors. An empty set means that the thread is not pinned.
+
+	static std::vector< unsigned int >
+	PlacementCPUs( const Actor::Placement & Resolved )
+	{
+		std::lock_guard< std::mutex > Lock( PlacementGuard );
+		ProcessorTopology & TheTopology( Topology() );
+
+		if ( Resolved.Core )
+			return { *Resolved.Core };
+		else if ( Resolved.NumaNode )
+			return TheTopology.Nodes[ *Resolved.NumaNode ];
+		else if ( TheTopology.Restricted )
+		{
+			std::vector< unsigned int > CPUs;
+
+			for ( const auto & NodeCPUs : TheTopology.Nodes )
+				CPUs.insert( CPUs.end(), NodeCPUs.begin(), NodeCPUs.end() );
+
+			return CPUs;
+		}
+		else
+			return {};
+	}
+
+	// Pinning uses the GNU extension as for the naming of the threads, and it
+	// has no effect if the extension is not available. A failure to pin is not
+	// an error since the thread will still execute, only not where preferred.
+
+	static void PinThread( std::thread::native_handle_type Thread,
+												 const std::vector< unsigned int > & CPUs )
+	{
+		#if defined( __linux__ ) && defined( _GNU_SOURCE )
+			if ( CPUs.empty() )
+				return;
+
+			cpu_set_t CPUSet;
+			CPU_ZERO( &CPUSet );
+
+			for ( unsigned int CPU : CPUs )
+				if ( CPU < CPU_SETSIZE )
+					CPU_SET( CPU, &CPUSet );
+
+			pthread_setaffinity_np( Thread, sizeof( CPUSet ), &CPUSet );
+		#endif
+	}
+}
+
+// Resolving a placement validates the core and the node, and sets the node
+// of the core so that a pooled actor pinned to a core is queued on its node.
+// The first actor of a group records the node of the group, which is its own
+// node or the next node in turn, and the later actors of the group take the
+// node of the group unless they have their own core or node.
+
+Theron::Actor::Placement
+Theron::Actor::ResolvePlacement( const Placement & Hint )
+{
+	std::lock_guard< std::mutex > Lock( PlacementGuard );
+	ProcessorTopology & TheTopology( Topology() );
+	Placement Resolved( Hint );
+
+	if ( Hint.Core )
+	{
+		auto Node = std::find_if( TheTopology.Nodes.begin(), TheTopology.Nodes.end(),
+			[&](const auto & CPUs){
+				return std::find( CPUs.begin(), CPUs.end(), *Hint.Core ) != CPUs.end();
+			});
+
+		if ( ( Node == TheTopology.Nodes.end() ) ||
+				 ( Hint.NumaNode && ( *Hint.NumaNode !=
+				 		static_cast< unsigned int >( Node - TheTopology.Nodes.begin() ) ) ) )
+		{
+			std::ostringstream ErrorMessage;
+
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "The core " << *Hint.Core << " is not available";
+
+			if ( Hint.NumaNode )
+				ErrorMessage << " on NUMA node " << *Hint.NumaNode;
+
+			throw std::invalid_argument( ErrorMessage.str() );
+		}
+
+		Resolved.NumaNode = Node - TheTopology.Nodes.begin();
+	}
+	else if ( Hint.NumaNode && ( ( *Hint.NumaNode >= TheTopology.Nodes.size() ) ||
+															 TheTopology.Nodes[ *Hint.NumaNode ].empty() ) )
+	{
+		std::ostringstream ErrorMessage;
+
+		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "The NUMA node " << *Hint.NumaNode << " has no available "
+								 << "processors";
+
+		throw std::invalid_argument( ErrorMessage.str() );
+	}
+
+	if ( !Hint.Group.empty() )
+	{
+		auto TheGroup = TheTopology.Groups.find( Hint.Group );
+
+		if ( TheGroup == TheTopology.Groups.end() )
+		{
+			if ( !Resolved.NumaNode )
+			{
+				std::size_t Node = TheTopology.NextGroupNode;
+
+				while ( TheTopology.Nodes[ Node % TheTopology.Nodes.size() ].empty() )
+					Node++;
+
+				Resolved.NumaNode = Node % TheTopology.Nodes.size();
+				TheTopology.NextGroupNode = Node + 1;
+			}
+
+			TheTopology.Groups.emplace( Hint.Group,
+				Placement{ std::nullopt, Resolved.NumaNode, Hint.Group } );
+		}
+		else if ( !Hint.Core && !Hint.NumaNode )
+			Resolved = TheGroup->second;
+	}
+
+	return Resolved;
+}
+
+// Restricting the processors is done on a copy of the topology so that the
+// topology is unchanged if no processors remain.
+
+void Theron::Actor::RestrictPlacement( std::uint32_t NodeMask,
+																			 std::uint32_t ProcessorMask )
+{
+	std::lock_guard< std::mutex > Lock( PlacementGuard );
+	ProcessorTopology Restricted( Topology() );
+
+	for ( std::size_t Node = 0; Node < Restricted.Nodes.size(); Node++ )
+	{
+		std::vector< unsigned int > Selected;
+
+		if ( ( Node < 32 ) && ( NodeMask & ( 1U << Node ) ) )
+			for ( std::size_t CPU = 0;
+						( CPU < Restricted.Nodes[ Node ].size() ) && ( CPU < 32 ); CPU++ )
+				if ( ProcessorMask & ( 1U << CPU ) )
+					Selected.push_back( Restricted.Nodes[ Node ][ CPU ] );
+
+		Restricted.Nodes[ Node ] = Selected;
+	}
+
+	if ( std::all_of( Restricted.Nodes.begin(), Restricted.Nodes.end(),
+										[](const auto & CPUs){ return CPUs.empty(); }) )
+	{
+		std::ostringstream ErrorMessage;
+
+		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "The node mask " << std::hex << NodeMask
+								 << " and the processor mask " << ProcessorMask
+								 << " leave no processors available";
+
+		throw std::invalid_argument( ErrorMessage.str() );
+	}
+
+	Restricted.Restricted = true;
+	Topology() = std::move( Restricted );
+}
+
+// Setting the placement resolves it before the actor is changed, so that an
+// invalid hint leaves the actor as it was. A running Postman is moved to the
+// processors of the new placement.
+
+void Theron::Actor::SetPlacement( const Placement & Hint )
+{
+	Placement Resolved( ResolvePlacement( Hint ) );
+
+	std::lock_guard< std::mutex > Lock( PostmanGuard );
+
+	PlacementHint 		= Hint;
+	ResolvedPlacement = Resolved;
+	PreferredNode 		= Resolved.NumaNode ? static_cast< int >( *Resolved.NumaNode )
+																				: -1;
+
+	if ( Postman.joinable() )
+		PinPostman();
+}
+
+Theron::Actor::Placement Theron::Actor::GetPlacement( void ) const
+{
+	std::lock_guard< std::mutex > Lock( PostmanGuard );
+	return PlacementHint;
+}
+
+// Pinning the Postman must be done with the Postman guard held
+
+void Theron::Actor::PinPostman( void )
+{
+	PinThread( Postman.native_handle(), PlacementCPUs( ResolvedPlacement ) );
+}
+
+/*=============================================================================
+
+ Thread pool
+
+=============================================================================*/
+
+// The pool and the execution mode for new actors are shared by all actors.
+// The creation of the pool is protected by a mutex since actors may select
+// the execution mode from different threads.
+
+std::unique_ptr< Theron::Actor::Scheduler > Theron::Actor::ThePool;
+
+std::atomic< Theron::Actor::ExecutionMode >
+				Theron::Actor::DefaultExecutionMode( ExecutionMode::DedicatedThread );
+
+// The Postmen never go idle unless an idle time is set
+
+std::atomic< std::chrono::milliseconds::rep > Theron::Actor::PostmanIdleTime(0);
+std::atomic< std::size_t > 										Theron::Actor::RunningPostmen(0);
+
+namespace Theron
+{
+	static std::mutex PoolCreation;
+
+	// The workers record the index of their queue and the actor they are
+	// currently executing. The queue index is used to queue actors made ready
+	// by a worker with the same worker, and the current actor is used to detect
+	// an actor trying to wait for its own mailbox to drain.
+
+	static thread_local std::size_t WorkerQueue  = 0;
+	static thread_local bool        IsWorker     = false;
+	static thread_local Actor *			CurrentActor = nullptr;
+}
+
+// The trace events are recorded here since the name of a worker thread is
+// given by the pool. The buffer of a thread is registered when it is created,
+// and it is cleared when it is first used in a new trace.
+
+void Theron::Actor::RecordTraceEvent( const GenericMessage & TheMessage,
+	bool Handling, std::chrono::steady_clock::time_point Start,
+	std::chrono::steady_clock::time_point End )
+{
+	if ( !ThreadTrace )
+	{
+		std::lock_guard< std::mutex > Lock( TraceGuard );
+
+		ThreadTrace = std::make_shared< TraceBuffer >( TraceRegistry().size() + 1 );
+		TraceRegistry().push_back( ThreadTrace );
+	}
+
+	std::chrono::steady_clock::time_point
+	Epoch( std::chrono::steady_clock::duration( TraceEpoch.load() ) );
+
+	TraceBuffer::Event TheEvent{ Handling, TheMessage.TraceID,
+		std::chrono::duration_cast< std::chrono::nanoseconds >(
+			Start - Epoch ).count(),
+		std::chrono::duration_cast< std::chrono::nanoseconds >(
+			End - Start ).count(),
+		TheMessage.From.AsString(), TheMessage.To.AsString(),
+		TheMessage.GetMessageType().name() };
+
+	TraceBuffer & Buffer( *ThreadTrace );
+	std::lock_guard< std::mutex > Lock( Buffer.Guard );
+	std::size_t Generation = TraceGeneration.load();
+
+	if ( Buffer.Generation != Generation )
+	{
+		Buffer.Events.clear();
+		Buffer.Recorded   = 0;
+		Buffer.Generation = Generation;
+		Buffer.ThreadName.clear();
+	}
+
+	if ( Buffer.ThreadName.empty() && Handling )
+		Buffer.ThreadName = IsWorker ? "Worker " + std::to_string( WorkerQueue )
+																 : TheEvent.To;
+
+	std::size_t Capacity = TraceCapacity.load();
+
+	if ( Buffer.Events.size() < Capacity )
+		Buffer.Events.push_back( std::move( TheEvent ) );
+	else
+		Buffer.Events[ Buffer.Recorded % Capacity ] = std::move( TheEvent );
+
+	Buffer.Recorded++;
+}
+
+// Selecting the pool mode starts the pool if it is not already running.
+
+void Theron::Actor::StartPool( unsigned int NumberOfWorkers )
+{
+	std::lock_guard< std::mutex > Lock( PoolCreation );
+
+	if ( !ThePool )
+	{
+		if ( NumberOfWorkers == 0 )
+			NumberOfWorkers = std::max( 1U, std::thread::hardware_concurrency() );
+
+		ThePool = std::make_unique< Scheduler >( NumberOfWorkers );
+	}
+}
+
+void Theron::Actor::SetExecutionMode( ExecutionMode Mode,
+																			unsigned int NumberOfWorkers )
+{
+	if ( Mode == ExecutionMode::ThreadPool )
+		StartPool( NumberOfWorkers );
+
+	DefaultExecutionMode = Mode;
+}
+
+// The class modes are set before the instances of the classes are created,
+// and they are read by the constructors of the instances.
+
+std::unordered_map< std::type_index, Theron::Actor::ExecutionMode >
+	Theron::Actor::ClassModes;
+std::shared_mutex Theron::Actor::ClassModeGuard;
+
+void Theron::Actor::SetClassExecutionMode( std::type_index ActorClass,
+																					 ExecutionMode Mode )
+{
+	if ( Mode == ExecutionMode::ThreadPool )
+		StartPool( 0 );
+
+	std::unique_lock< std::shared_mutex > Lock( ClassModeGuard );
+	ClassModes.insert_or_assign( ActorClass, Mode );
+}
+
+Theron::Actor::ExecutionMode
+Theron::Actor::ClassExecutionMode( std::type_index ActorClass )
+{
+	std::shared_lock< std::shared_mutex > Lock( ClassModeGuard );
+	auto ClassMode = ClassModes.find( ActorClass );
+
+	if ( ClassMode == ClassModes.end() )
+		return DefaultExecutionMode.load();
+	else
+		return ClassMode->second;
+}
+
+// Taking an actor first tries the worker's own queue from the front, and then
+// the other queues from the back, first on the worker's own node, starting
+// with the next worker so that not all idle workers try to steal from the
+// same queue.
+
+Theron::Actor * Theron::Actor::Scheduler::TakeActor( std::size_t OwnQueue )
+{
+	for ( std::size_t QueueIndex : StealOrder[ OwnQueue ] )
+	{
+		WorkQueue & Candidate( *Queues[ QueueIndex ] );
+		std::lock_guard< std::mutex > Lock( Candidate.QueueGuard );
+
+		if ( !Candidate.ReadyActors.empty() )
+		{
+			Actor * ReadyActor;
+
+			if ( QueueIndex == OwnQueue )
+			{
+				ReadyActor = Candidate.ReadyActors.front();
+				Candidate.ReadyActors.pop_front();
+			}
+			else
+			{
+				ReadyActor = Candidate.ReadyActors.back();
+				Candidate.ReadyActors.pop_back();
+			}
+
+			ReadyCount--;
+			return ReadyActor;
+		}
+	}
+
+	return nullptr;
+}
+
+// The worker executes ready actors, and parks when there are none. The
+// parked count is incremented before the ready count is tested under the
+// parking lock, and the submitting thread increments the ready count before
+// testing the parked count. Hence, either the worker sees the new actor or
+// the submitting thread sees the parked worker and notifies it.
+
+void Theron::Actor::Scheduler::Worker( std::size_t OwnQueue )
+{
+	WorkerQueue = OwnQueue;
+	IsWorker    = true;
+
+	THERON_PROFILE_THREAD( "Worker" + std::to_string( OwnQueue ) );
+
+	while ( PoolRunning )
+	{
+		Actor * ReadyActor = TakeActor( OwnQueue );
+
+		if ( ReadyActor != nullptr )
+			ReadyActor->ProcessPendingMessages();
+		else
+		{
+			std::unique_lock< std::mutex > Lock( ParkingGuard );
+
+			ParkedWorkers++;
+			WorkAvailable.wait( Lock, [&](void)->bool{
+				return ( ReadyCount > 0 ) || !PoolRunning; });
+			ParkedWorkers--;
+		}
+	}
+}
+
+// Submitting an actor places it in the queue of the submitting worker, or in
+// the next queue in turn if the actor is submitted by another thread. An
+// actor with a preferred node is only queued with the submitting worker if
+// the worker is on that node, and otherwise in the next queue of the node.
+
+void Theron::Actor::Scheduler::Submit( Actor * ReadyActor )
+{
+	int 				Node = ReadyActor->PreferredNode.load( std::memory_order_relaxed );
+	std::size_t QueueIndex;
+
+	if ( ( Node < 0 ) || ( static_cast< std::size_t >( Node ) >= NodeQueues.size() )
+			 || NodeQueues[ Node ].empty() )
+		QueueIndex = IsWorker ? WorkerQueue : NextQueue++ % Queues.size();
+	else if ( IsWorker && ( QueueNode[ WorkerQueue ] == Node ) )
+		QueueIndex = WorkerQueue;
+	else
+		QueueIndex = NodeQueues[ Node ][ NextQueue++ % NodeQueues[ Node ].size() ];
+
+	{
+		std::lock_guard< std::mutex > Lock( Queues[ QueueIndex ]->QueueGuard );
+		Queues[ QueueIndex ]->ReadyActors.push_back( ReadyActor );
+	}
+
+	ReadyCount++;
+
+	if ( ParkedWorkers > 0 )
+	{
+		std::lock_guard< std::mutex > Lock( ParkingGuard );
+		WorkAvailable.notify_one();
+	}
+}
+
+// Withdrawing an actor searches all the queues since the actor may have been
+// queued by any thread. This is only done when a pooled actor with pending
+// messages is destroyed by a worker.
+
+bool Theron::Actor::Scheduler::Withdraw( Actor * QueuedActor )
+{
+	for ( auto & Queue : Queues )
+	{
+		std::lock_guard< std::mutex > Lock( Queue->QueueGuard );
+		auto Queued = std::find( Queue->ReadyActors.begin(),
+														 Queue->ReadyActors.end(), QueuedActor );
+
+		if ( Queued != Queue->ReadyActors.end() )
+		{
+			Queue->ReadyActors.erase( Queued );
+			ReadyCount--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// The constructor creates the queues before the workers are started since
+// the workers may steal from all queues. The workers are given the nodes with
+// available processors in turn, and each worker is pinned to the processors
+// of its node.
+
+Theron::Actor::Scheduler::Scheduler( unsigned int NumberOfWorkers )
+: Queues(), Workers(), StealOrder(), NodeQueues(), QueueNode(),
+  ReadyCount(0), ParkedWorkers(0), NextQueue(0),
+  PoolRunning( true ), ParkingGuard(), WorkAvailable()
+{
+	std::vector< std::vector< unsigned int > > Nodes;
+	std::vector< int > 												 AvailableNodes;
+
+	{
+		std::lock_guard< std::mutex > Lock( PlacementGuard );
+		Nodes = Topology().Nodes;
+	}
+
+	for ( std::size_t Node = 0; Node < Nodes.size(); Node++ )
+		if ( !Nodes[ Node ].empty() )
+			AvailableNodes.push_back( Node );
+
+	NodeQueues.resize( Nodes.size() );
+
+	for ( unsigned int i = 0; i < NumberOfWorkers; i++ )
+	{
+		Queues.push_back( std::make_unique< WorkQueue >() );
+		QueueNode.push_back( AvailableNodes[ i % AvailableNodes.size() ] );
+		NodeQueues[ QueueNode.back() ].push_back( i );
+	}
+
+	for ( unsigned int i = 0; i < NumberOfWorkers; i++ )
+	{
+		StealOrder.emplace_back();
+
+		for ( bool SameNode : { true, false } )
+			for ( unsigned int Offset = 0; Offset < NumberOfWorkers; Offset++ )
+			{
+				std::size_t Candidate = ( i + Offset ) % NumberOfWorkers;
+
+				if ( ( QueueNode[ Candidate ] == QueueNode[ i ] ) == SameNode )
+					StealOrder.back().push_back( Candidate );
+			}
+	}
+
+	for ( unsigned int i = 0; i < NumberOfWorkers; i++ )
+	{
+		Workers.emplace_back( &Scheduler::Worker, this, i );
+		PinThread( Workers.back().native_handle(), Nodes[ QueueNode[ i ] ] );
+	}
+}
+
+// The destructor stops the workers when they have finished the actor they
+// are executing. All pooled actors should be destroyed before the pool.
+
+Theron::Actor::Scheduler::~Scheduler( void )
+{
+	{
+		std::lock_guard< std::mutex > Lock( ParkingGuard );
+		PoolRunning = false;
+		WorkAvailable.notify_all();
+	}
+
+	for ( std::thread & PoolWorker : Workers )
+		if ( PoolWorker.joinable() )
+			PoolWorker.join();
+}
+
+// A pooled actor handles at most a batch of messages each time it is executed
+// by a worker. The pending count is decremented after each message, and if
+// it reaches zero the worker no longer owns the actor and must not touch it
+// since it may be destroyed. If there are still pending messages after the
+// batch, the actor is queued again. Messages arriving after the actor was
+// closed are removed without being handled.
+
+void Theron::Actor::ProcessPendingMessages( void )
+{
+	CurrentActor = this;
+
+	for ( std::size_t Handled = 0; Handled < MessageBatch; Handled++ )
+	{
+		if ( ActorRunning )
+			HandleFirstMessage();
+		else
+			Mailbox.DeleteFirstMessage();
+
+		if ( PendingMessages.fetch_sub( 1 ) == 1 )
+		{
+			CurrentActor = nullptr;
+			return;
+		}
+	}
+
+	CurrentActor = nullptr;
+	ThePool->Submit( this );
+}
+
+// A worker that withdraws the actor owns it and handles all its pending
+// messages, including the ones arriving meanwhile. The actor executed by the
+// worker before the destructor was called is restored afterwards. Other
+// threads, and workers finding the actor executed by another worker, yield
+// until the other worker has released the actor.
+
+void Theron::Actor::DrainPendingMessages( void )
+{
+	while ( PendingMessages > 0 )
+		if ( IsWorker && ThePool->Withdraw( this ) )
+		{
+			Actor * DestroyingActor = CurrentActor;
+
+			CurrentActor = this;
+
+			do
+			{
+				if ( ActorRunning )
+					HandleFirstMessage();
+				else
+					Mailbox.DeleteFirstMessage();
+			}
+			while ( PendingMessages.fetch_sub( 1 ) > 1 );
+
+			CurrentActor = DestroyingActor;
+		}
+		else
+			std::this_thread::yield();
+}
+
+/*=============================================================================
+
+ Execution control
+
+=============================================================================*/
+
+// The dispatcher function first obtains a copy of the message at the front of
+// the message queue, and then delivers this to each handler registered for
+// the type of the message.
+//
+// If no message handler is available to serve the message the message will
+// be delivered to the default message handler. If no default message handler
+// exists, then the message will be handled according to the error policy set.
+//
+// The handler is supposed to run in the actor's thread and it will block if
+// there is no message available.
 
-void Theron::Actor::Identification::WaitForGlobalTermination( void )
+void Theron::Actor::DispatchMessages( void )
 {
-	auto ActorReference = ActorsByID.begin();
+	// Messages are continuously dispatched as long as there are more messages
+	// and the actor is running. Note that the order of these tests is important
+	// when the actor terminates because the destructor will first wait for the
+	// queue to drain, and then set the running flag to false before submitting
+	// an empty message that will stop the wait on a message, but cause the while
+	// loop to terminate because the actor is no longer running and thereby avoid
+	// processing the empty message.
 
-	while ( ActorReference != ActorsByID.end() )
-  {
-		Actor * TheActor = ActorReference->second->ActorPointer;
+	//
+	// If an idle time is set and no message arrives within this time, the
+	// Postman hands over to the next sender as described in the header: It
+	// clears the active flag and terminates unless a message arrived in the
+	// mean time and no sender has already started a new Postman.
+
+	PostmanThread = std::this_thread::get_id();
+	RunningPostmen++;
 
-		if ( ( TheActor != nullptr ) && ( TheActor->GetNumQueuedMessages() > 0 ) )
+	THERON_PROFILE_THREAD( ActorID.AsString() );
+
+	while ( true )
+	{
+		std::chrono::milliseconds IdleTime( PostmanIdleTime.load() );
+
+		if ( IdleTime == std::chrono::milliseconds::zero() )
+			Mailbox.HasMessage( MessageQueue::QueueEmpty::Wait );
+		else if ( !Mailbox.AwaitMessage( IdleTime ) )
 		{
-			TheActor->DrainMailbox();
-			ActorReference = ActorsByID.begin();
+			bool Inactive = false;
+
+			PostmanActive = false;
+
+			if ( ( Mailbox.size() > 0 ) &&
+					 PostmanActive.compare_exchange_strong( Inactive, true ) )
+				continue;
+			else
+				break;
 		}
-		else
-			++ActorReference;
-	}
-}
 
-/*=============================================================================
+		if ( !ActorRunning )
+			break;
 
- Constructor and destructor
+		HandleFirstMessage();
 
-=============================================================================*/
+		// Finally, the thread yields before processing the next message to allow
+		// other threads and actors to progress in parallel.
 
-// The constructor sets stores the name and starts the postman thread.
+		std::this_thread::yield();
+	}
 
-Theron::Actor::Actor( const std::string & ActorName )
-: ActorID( Identification::Create( ActorName, this ) ),
-  Mailbox(), MessageHandlers(), DefaultHandler(), Postman()
-{
-	// The flag indicating if the actor is running is set to true, and currently
-	// there is no message available.
+	std::thread::id ThisThread( std::this_thread::get_id() );
 
-	ActorRunning = true;
+	PostmanThread.compare_exchange_strong( ThisThread, std::thread::id() );
+	RunningPostmen--;
+}
 
-	// The default error handling policy is to throw on unhanded messages
+// Starting the Postman is done by the sender that first finds the Postman
+// inactive, and the thread of an idle Postman is joined first. A closing
+// actor does not start a new Postman.
 
-	MessageErrorPolicy = MessageError::Throw;
+void Theron::Actor::StartPostman( void )
+{
+	std::lock_guard< std::mutex > Lock( PostmanGuard );
+	bool Inactive = false;
+
+	if ( !ActorRunning ||
+			 !PostmanActive.compare_exchange_strong( Inactive, true ) )
+		return;
 
-	// Then the thread can be started. It will wait until it is signalled from
-	// the Enqueue message function.
+	if ( Postman.joinable() )
+		Postman.join();
 
 	Postman = std::thread( &Actor::DispatchMessages, this );
 
@@ -687,6 +2120,406 @@ Theron::Actor::Actor( const std::string & ActorName )
 			pthread_setname_np( Postman.native_handle(), ThreadName.str().data() );
 		}
 	#endif
+
+	PinPostman();
+}
+
+// The idle time applies to all Postmen from their next wait for a message
+
+void Theron::Actor::SetPostmanIdleTime( std::chrono::milliseconds IdleTime )
+{
+	PostmanIdleTime = std::max( IdleTime, std::chrono::milliseconds::zero() ).count();
+}
+
+// Handling the first message means delivering it to every handler registered
+// for the type of the message, or to the default handler if there is no such
+// handler.
+
+void Theron::Actor::HandleFirstMessage( void )
+{
+	// It is an overhead to call Mailbox front for each handler as the first
+	// message in the queue can be cached, and there is a flag indicating that
+	// the message has been served by at least one handler.
+
+	auto TheMessage 	 = Mailbox.front();
+	bool MessageServed = false;
+
+	// The handling is a profiler zone labelled with the actor and the type of
+	// the message if the profiler annotations are compiled in.
+
+	THERON_PROFILE_ZONE_DETAIL( "Theron::Actor::Handler", ActorID.AsString() +
+		" " + TheMessage->GetMessageType().name() );
+
+	ExecutingHandlers++;
+
+	// If metrics are collected, the start time of the handling is recorded,
+	// and the recorder is created for the first message measured.
+
+	const bool Measure = MetricsEnabled(),
+						 Trace 	 = TracingEnabled();
+	MetricsRecorder::Clock::time_point Start;
+
+	if ( Measure && !Metrics )
+	{
+		Metrics = std::make_shared< MetricsRecorder >( ActorID.AsString() );
+
+		std::lock_guard< std::mutex > Lock( MetricsGuard );
+		MetricsRegistry().push_back( Metrics );
+	}
+
+	if ( Measure || Trace )
+		Start = MetricsRecorder::Clock::now();
+
+	// The handlers for the message type are found by the type of the message,
+	// and the list is kept by reference since it will not be removed or moved
+	// even if the handlers register handlers for other message types.
+
+	auto TypeHandlers = MessageHandlers.find( TheMessage->GetMessageType() );
+
+	if ( TypeHandlers != MessageHandlers.end() )
+	{
+		HandlerList & Handlers( TypeHandlers->second );
+		auto CurrentHandler = Handlers.begin();
+
+		while ( CurrentHandler != Handlers.end() )
+		{
+			// There is a minor problem related to the handler call since invoking
+			// the message handler may create or destroy handlers. A mutex cannot help
+			// since the handler is executing in this thread, and since it runs on
+			// the same stack all operations implicitly made by the handler
+			// on the handler list will have terminated when control is returned to
+			// this method. Insertions are not problematic since they will appear at
+			// the end of the list, and will just be included in the continued
+			// iterations here. Deletions are similarly not problematic unless the
+			// handler de-register itself.
+			//
+			// In this case it does not help having an iterator to the next element
+			// as there is also no guarantee that that also that pointer will not be
+			// deleted. The only safe way is to ensure that the handler object for
+			// the current handler is not deleted. A copy of the current handler is
+			// therefore made, and its status is set to executing.
+
+			auto ExecutingHandler = CurrentHandler;
+			(*ExecutingHandler)->SetStatus( GenericHandler::State::Executing );
+
+			// Then the handler can process the message, and if this results in the
+			// handler de-registering this handler, it will return with the deleted
+			// state. The last handler of the message type may take the message.
+
+			(*ExecutingHandler)->AllowMessageTaking(
+												std::next( CurrentHandler ) == Handlers.end() );
+
+			if( (*ExecutingHandler)->ProcessMessage( TheMessage ) )
+				MessageServed = true;
+
+			// The Current Handler is then moved to the handler for the next
+			// execution, and the handler just executed can be deleted, or its state
+			// can be switched back to normal.
+
+			++CurrentHandler;
+
+			if ( (*ExecutingHandler)->GetStatus() == GenericHandler::State::Deleted )
+				Handlers.erase( ExecutingHandler );
+			else
+				(*ExecutingHandler)->SetStatus( GenericHandler::State::Normal );
+		}
+	}
+
+	// If the message is not served at this point, it should be delivered to
+	// the fall back handler. If that handler does not exist it should either
+	// be ignored or an error message will be thrown.
+
+	if ( ! MessageServed )
+	{
+		if ( DefaultHandler )
+			DefaultHandler->ProcessMessage( TheMessage );
+		else if ( MessageErrorPolicy == MessageError::Throw )
+	  {
+			std::ostringstream ErrorMessage;
+
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "No message handler for the message "
+									 << TheMessage->GetMessageType().name()
+									 << " from " << TheMessage->From.AsString()
+									 << " to " << TheMessage->To.AsString()
+									 << " and no default message handler!";
+
+		  throw std::logic_error( ErrorMessage.str() );
+		}
+	}
+
+	// The time of the handling is recorded with the mailbox depth seen by
+	// this message, and the handling is traced.
+
+	if ( Measure || Trace )
+	{
+		auto End = MetricsRecorder::Clock::now();
+
+		if ( Measure )
+			Metrics->Record( TheMessage->GetMessageType(), Mailbox.size(), Start,
+											 End );
+
+		if ( Trace )
+			TraceHandling( *TheMessage, Start, End );
+	}
+
+	// The message is fully handled, and it can be popped from the queue and
+	// thereby prepare the queue for processing the next message.
+
+	ExecutingHandlers--;
+	Mailbox.DeleteFirstMessage();
+
+	// The callback that a new message has arrived and is processed is given
+	// in case derived classes need this information.
+
+	MessageProcessed();
+}
+
+
+// When the Postman has processed a message it will notify the actor about this
+// event by calling the virtual message processed function, which will in turn
+// notify other threads that may wait for the condition variable.
+
+void Theron::Actor::MessageProcessed( void )
+{ }
+
+// The function to wait for the mailbox to drain is identical to the previous,
+// except that it uses a different predicate function to the wait to avoid the
+// additional overhead of repeatedly calling the wait for one message and
+// acquire the lock (although it will happen implicitly in the wait condition)
+
+void Theron::Actor::DrainMailbox( void )
+{
+	if ( !IsExecutingThread() )
+		Mailbox.WaitUntilEmpty();
+	else
+	{
+		std::ostringstream ErrorMessage;
+
+		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "Actor " << ActorID.AsString()
+								 << "Cannot wait for message DRAIN within the same actor!";
+
+		throw std::logic_error( ErrorMessage.str() );
+	}
+}
+
+// The actor is executed by the calling thread if it is the Postman, or if it
+// is the pool worker currently executing the actor.
+
+bool Theron::Actor::IsExecutingThread( void ) const
+{
+	if ( Execution == ExecutionMode::DedicatedThread )
+		return std::this_thread::get_id() == PostmanThread.load();
+	else
+		return CurrentActor == this;
+}
+
+// The capacity of the mailbox is set together with the overflow policy, and
+// the policy is stored first so that it is defined when the capacity is seen.
+
+void Theron::Actor::SetMailboxCapacity( MessageCount Capacity,
+																				MailboxOverflow Policy )
+{
+	OverflowPolicy.store( Policy );
+	Mailbox.SetCapacity( Capacity );
+}
+
+// The identification's function to wait for global termination will start
+// from the beginning of the registry of Identifications and wait for the first
+// actor to drain its queue. It will not move to the second actor before the
+// first actor has drained. Whenever an actor is found with messages, the
+// wait will re-start from the beginning of the actor registry because the
+// the actor that had messages could send messages to other actors, and hence
+// it is necessary to wait for them too. The shard lock is released before
+// waiting so that the actors can be created and destroyed while draining.
+
+void Theron::Actor::Identification::WaitForGlobalTermination( void )
+{
+	Address ActorWithMessages;
+
+	do
+	{
+		ActorWithMessages = Address::Null();
+
+		for ( auto & TheShard : ActorsByID.AllShards() )
+		{
+			std::shared_lock< std::shared_mutex > Lock( TheShard.Guard );
+
+			for ( auto & TheID : TheShard.Actors )
+			{
+				Actor * TheActor = TheID.second->ActorPointer.load();
+
+				if ( ( TheActor != nullptr ) &&
+						 ( TheActor->GetNumQueuedMessages() > 0 ) )
+				{
+					auto Reference = TheID.second->weak_from_this().lock();
+
+					if ( Reference )
+					{
+						ActorWithMessages = Address( Reference );
+						break;
+					}
+				}
+			}
+
+			if ( ActorWithMessages ) break;
+		}
+
+		if ( ActorWithMessages )
+		{
+			Actor * TheActor = ActorWithMessages->ActorPointer.load();
+
+			if ( TheActor != nullptr )
+				TheActor->DrainMailbox();
+		}
+	}
+	while ( ActorWithMessages );
+}
+
+// Renaming creates the Identification for the new name pointing to this
+// actor before the old Identification is cleared, so that a name already
+// used by another actor will throw before this actor loses its address.
+
+void Theron::Actor::Rename( const std::string & NewName )
+{
+	Address NewID( Identification::Create( NewName, this ) );
+
+	if ( NewID != ActorID )
+	{
+		Identification::ClearActor( ActorID );
+		ActorID = NewID;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// Quiescence detection
+// -----------------------------------------------------------------------------
+//
+// The actors waiting for the quiescence are kept in a list protected by a
+// mutex, and the same mutex is used by the threads waiting for quiescence.
+// The list is only accessed when a notification is requested or when the
+// count of pending activities drops to zero, and the count itself is updated
+// without the lock.
+
+std::atomic< std::uint64_t > Theron::Actor::PendingActivities( 0 ),
+														 Theron::Actor::ExecutingHandlers( 0 );
+
+namespace Theron
+{
+	static std::mutex 							 QuiescenceGuard;
+	static std::condition_variable QuiescenceSignal;
+
+	static std::vector< Address > & QuiescenceSubscribers( void )
+	{
+		static std::vector< Address > TheSubscribers;
+		return TheSubscribers;
+	}
+}
+
+// The count is tested while holding the lock, and if it has dropped to zero
+// after a notification was requested, the requesting actor is notified
+// directly since there may be no further activity to trigger the notification.
+
+void Theron::Actor::NotifyWhenQuiescent( const Address & TheActor )
+{
+	std::unique_lock< std::mutex > Lock( QuiescenceGuard );
+
+	if ( PendingActivities.load() > 0 )
+		QuiescenceSubscribers().push_back( TheActor );
+	else
+	{
+		Lock.unlock();
+		Send( Quiescent(), Address::Null(), TheActor );
+	}
+}
+
+// A thread waiting for the quiescence must not be the thread executing an
+// actor since the message being handled would then never complete.
+
+void Theron::Actor::WaitForQuiescence( void )
+{
+	std::unique_lock< std::mutex > Lock( QuiescenceGuard );
+
+	QuiescenceSignal.wait( Lock,
+		[](void)->bool{ return PendingActivities.load() == 0; } );
+}
+
+void Theron::Actor::BeginActivity( void )
+{
+	PendingActivities++;
+}
+
+void Theron::Actor::EndActivity( void )
+{
+	if ( PendingActivities.fetch_sub( 1 ) == 1 )
+		QuiescenceReached();
+}
+
+// Another activity may have started after the count dropped to zero and before
+// the lock was acquired, and then the notification is left for the next time
+// the count drops to zero. The notifications are sent after releasing the
+// lock, and the notification messages will be new activities.
+
+void Theron::Actor::QuiescenceReached( void )
+{
+	std::vector< Address > Subscribers;
+
+	{
+		std::lock_guard< std::mutex > Lock( QuiescenceGuard );
+
+		if ( PendingActivities.load() > 0 )
+			return;
+
+		Subscribers.swap( QuiescenceSubscribers() );
+		QuiescenceSignal.notify_all();
+	}
+
+	for ( const Address & TheActor : Subscribers )
+		Send( Quiescent(), Address::Null(), TheActor );
+}
+
+/*=============================================================================
+
+ Constructor and destructor
+
+=============================================================================*/
+
+// The constructor stores the name. The Postman is started by the first
+// message, and a pooled actor is submitted to the pool by its first message.
+
+Theron::Actor::Actor( const std::string & ActorName, const Placement & Hint )
+: Actor( ActorName, DefaultExecutionMode.load(), Hint )
+{}
+
+Theron::Actor::Actor( const std::string & ActorName, ExecutionMode Mode,
+											const Placement & Hint )
+: ActorID( Identification::Create( ActorName, this ) ),
+  Mailbox(), OverflowPolicy( MailboxOverflow::Block ), RefusedMessages(0),
+  MessageHandlers(), DefaultHandler(), Postman(), PostmanGuard(),
+  PostmanActive( false ), PostmanThread(),
+  Execution( Mode ), PendingMessages(0),
+  PlacementHint(), ResolvedPlacement(), PreferredNode( -1 )
+{
+	// The flag indicating if the actor is running is set to true, and currently
+	// there is no message available.
+
+	ActorRunning = true;
+
+	// The default error handling policy is to throw on unhanded messages
+
+	MessageErrorPolicy = MessageError::Throw;
+
+	// A pooled actor may be constructed before the pool has been started if the
+	// pool mode is given explicitly.
+
+	if ( Execution == ExecutionMode::ThreadPool )
+		StartPool( 0 );
+
+	// The placement is set last since it may throw if the hint is invalid
+
+	if ( !Hint.empty() )
+		SetPlacement( Hint );
 }
 
 // The destructor wait for the mailbox to be drained and then set the flag
@@ -697,9 +2530,13 @@ Theron::Actor::~Actor()
 {
 	// First the postmaster is told to close. This is done by first waiting for
 	// it to drain the current message queue so that already received messages
-	// can be properly processed.
+	// can be properly processed. A pooled actor has no Postman, and its pending
+	// messages may have to be handled by the destroying worker.
 
-	Mailbox.WaitUntilEmpty();
+	if ( Execution == ExecutionMode::ThreadPool )
+		DrainPendingMessages();
+	else
+		Mailbox.WaitUntilEmpty();
 
 	// Then the flag is set to ensure that the Postman will stop and not process
 	// any messages arriving after this.
@@ -711,9 +2548,29 @@ Theron::Actor::~Actor()
 
 	Identification::ClearActor( ActorID );
 
+	// The metrics of the actor are kept, but they are marked as closed.
+
+	if ( Metrics )
+		Metrics->Closed = true;
+
+	// A pooled actor may still be owned by a worker that has deleted the last
+	// message but not yet released the actor, or that removes messages arriving
+	// after the actor was closed. The actor can only be destroyed when there are
+	// no pending messages.
+
+	if ( Execution == ExecutionMode::ThreadPool )
+	{
+		DrainPendingMessages();
+		return;
+	}
+
 	// To force a stop, an empty message is queued in the case the Postman has
 	// gone into a wait for the next message. This should wake it up and make it
-	// check the actor running flag.
+	// check the actor running flag. The message is stored directly in the
+	// mailbox so that it does not start a Postman if there is none, and the
+	// lock ensures that no sender is starting a Postman at the same time.
+
+	std::lock_guard< std::mutex > Lock( PostmanGuard );
 
 	Mailbox.StoreMessage( std::make_shared< GenericMessage >() );
 
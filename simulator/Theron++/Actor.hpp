@@ -23,6 +23,17 @@ measure, and if the execution environment cannot cope with this policy a
 thread pool and a scheduling policy can be implemented, although it currently
 contradicts the second design principle.
 
+Large actor systems, like neighbourhood simulations with thousands of loads,
+may hit the limits on the number of threads, or lose much time in context
+switches between threads that only process a few messages each. Actors can
+therefore optionally be executed by a fixed pool of worker threads sized to
+the number of cores. An actor with messages is then queued with one of the
+workers, and a worker without actors steals actors from the other workers.
+An actor is never queued or executed by more than one worker at the time, so
+the message handlers of an actor are still executed sequentially. The
+execution mode is chosen when the actor is constructed, and actors with
+dedicated threads and pooled actors can be mixed.
+
 Author and Copyright: Geir Horn, 2017-2018
 License: LGPL 3.0
 =============================================================================*/
@@ -34,6 +45,8 @@ License: LGPL 3.0
 #include <memory>							// Smart pointers
 #include <queue>							// For the queue of messages
 #include <mutex>						  // To protect the queue
+#include <shared_mutex>				// To protect the actor registries
+#include <array>							// The registry shards
 #include <utility>						// Pairs
 #include <unordered_map>			// To map actor names to actors
 #include <functional>					// For defining handler functions
@@ -41,10 +54,19 @@ License: LGPL 3.0
 #include <algorithm>					// Various container related utilities
 #include <thread>						  // To execute actors
 #include <condition_variable> // To synchronise threads
+#include <deque>							// Actors ready for a worker
+#include <vector>							// The workers of the pool
 #include <atomic>							// Thread protected variables
+#include <cstdint>						// Event counters
+#include <chrono>							// Handler execution times
+#include <ostream>						// Writing the metrics
 #include <stdexcept>				  // To throw standard exceptions
 #include <sstream>						// To provide nice exception messages
 #include <type_traits>				// For meta-programming
+#include <typeinfo>						// Names of the message pools
+#include <typeindex>					// Handlers by message type
+#include <new>								// Allocating pooled messages
+#include <optional>						// Placement hints
 
 #include "Communication/SerialMessage.hpp"  // Messages that can be serialised
 
@@ -229,31 +251,108 @@ private:
 	// pointer will be set to point to this local actor. When the local actor is
 	// deleted, this pointer is set to Null as all addresses referencing this
 	// Identification object must be removed before a new Identification object
-	// can be created for a remote actor of the same name.
+	// can be created for a remote actor of the same name. The pointer is atomic
+	// since it is read without any lock by the actors sending messages.
 
-	Actor * ActorPointer;
+	std::atomic< Actor * > ActorPointer;
 
 	// It will also keep track of the known actors, both by name and by ID.
 	// All actors must have an identification, locally or remotely. It may be
 	// necessary to look up actors based on their name, and the best way
 	// to do this is using an unordered map since a lookup should be O(1).
-	// These maps are protected since it is the responsibility of the derived
-	// identity classes to ensure that the name and ID is correctly stored.
+	//
+	// The registries are shared among all actors, and actors can be created by
+	// other actors in the message handlers or otherwise, so they are used from
+	// different threads. A single lock would serialise all lookups with the
+	// creation and destruction of every actor, and each registry is therefore
+	// split into shards by the hash of the key. Each shard has a reader-writer
+	// lock so that lookups never block each other, and inserting or removing
+	// an Identification only blocks the lookups of the keys in the same shard
+	// while its map is changed.
+	//
+	// The shards store plain pointers, and an Identification whose last
+	// address has been released stays in its shard until the destructor has
+	// removed it. A lookup will therefore only return an address if the shared
+	// pointer to the Identification can still be obtained, and the destructor
+	// only removes the entries still referring to the destructed object since
+	// a new Identification may have been registered for the same name.
+
+	template< class KeyType >
+	class Registry
+	{
+	public:
 
-	static std::unordered_map< std::string, Identification * > ActorsByName;
+		static constexpr std::size_t NumberOfShards = 64;
 
-	// In the same way there is a lookup map to find the pointer based on the
-	// actor's ID. This could have been a vector, but it would have been ever
-	// growing. Having a map allows the storage of only active actors.
+		class Shard
+		{
+		public:
+
+			std::shared_mutex 															Guard;
+			std::unordered_map< KeyType, Identification * > Actors;
+		};
+
+	private:
+
+		std::array< Shard, NumberOfShards > Shards;
+
+	public:
+
+		inline Shard & ShardFor( const KeyType & Key )
+		{ return Shards[ std::hash< KeyType >()( Key ) % NumberOfShards ]; }
+
+		inline std::array< Shard, NumberOfShards > & AllShards( void )
+		{ return Shards; }
+
+		// The address of a living Identification is returned if there is one
+		// for the key, and the shared pointer must be obtained under the lock
+		// since the destructor needs the exclusive lock to remove the entry.
+
+		std::shared_ptr< Identification > Find( const KeyType & Key )
+		{
+			Shard & TheShard( ShardFor( Key ) );
+			std::shared_lock< std::shared_mutex > Lock( TheShard.Guard );
+
+			auto Existing = TheShard.Actors.find( Key );
+
+			if ( Existing == TheShard.Actors.end() )
+				return std::shared_ptr< Identification >();
+			else
+				return Existing->second->weak_from_this().lock();
+		}
+
+		// Inserting an Identification replaces the entry of an Identification
+		// being destroyed, and the removal leaves an entry that is for another
+		// Identification.
+
+		void Insert( const KeyType & Key, Identification * TheID )
+		{
+			Shard & TheShard( ShardFor( Key ) );
+			std::unique_lock< std::shared_mutex > Lock( TheShard.Guard );
+
+			TheShard.Actors[ Key ] = TheID;
+		}
+
+		void Remove( const KeyType & Key, const Identification * TheID )
+		{
+			Shard & TheShard( ShardFor( Key ) );
+			std::unique_lock< std::shared_mutex > Lock( TheShard.Guard );
+
+			auto Existing = TheShard.Actors.find( Key );
+
+			if ( ( Existing != TheShard.Actors.end() ) &&
+					 ( Existing->second == TheID ) )
+				TheShard.Actors.erase( Existing );
+		}
+	};
 
-	static std::unordered_map< IDType, Identification * > ActorsByID;
+	static Registry< std::string > ActorsByName;
 
-	// Since these three elements are shared among all actors, and actors can
-	// be created by other actors in the message handlers or otherwise, the
-	// elements can be operated upon from different threads. It is therefore
-	// necessary to ensure sequential access by locking a mutex.
+	// In the same way there is a lookup registry to find the pointer based on
+	// the actor's ID. This could have been a vector, but it would have been ever
+	// growing. Having a map allows the storage of only active actors.
 
-	static std::recursive_mutex InformationAccess;
+	static Registry< IDType > ActorsByID;
 
   // An address is stored for the presentation layer so that messages for
 	// remote actors can be routed to the presentation layer for serialisation
@@ -265,8 +364,9 @@ private:
 	// unique ID to the Identification object. The reason for keeping it private
 	// is to ensure that the generator function is used when creating an
 	// identification object. If the name string is not given a default name
-	// "ActorNN" will be assigned where the NN is the number of the actor. It
-	// eventually register the identification object in the two lookups.
+	// "ActorNN" will be assigned where the NN is the number of the actor. The
+	// generator function registers the identification object in the two
+	// lookups.
 
 	Identification( const std::string & ActorName = std::string() );
 
@@ -278,6 +378,11 @@ private:
 	inline std::shared_ptr< Identification > GetSmartPointer( void )
 	{	return shared_from_this();	}
 
+	// The actor of the Presentation Layer is returned by a small helper that
+	// gives a null pointer if there is no Presentation Layer server.
+
+	static Actor * PresentationLayerActor( void );
+
 public:
 
 	// Identification objects must be created by a supporting generator function
@@ -312,12 +417,14 @@ public:
 
 	static void ClearActor( const Address & ActorAddress );
 
-	// There is a simple test to see if the actor pointer is defined. Note that
-	// the actor pointer is only defined for actors on the local endpoint so this
-	// is implicitly a test that the actor is not remote.
+	// There is a simple test to see if the actor pointer is defined for an
+	// actor on the local endpoint. An Identification created by name for an
+	// actor that does not exist will point to the Presentation Layer server
+	// since the actor may be remote, and this is not taken as having an actor
+	// unless it is the Identification of the Presentation Layer server itself.
+	// It is not in-line for the same reason as the routing test below.
 
-	inline bool HasActor( void )
-	{	return ActorPointer != nullptr;	}
+	bool HasActor( void );
 
 	// A message can be routed to an actor identified by this Identification
 	// object only if it is a local actor, i.e. the actor pointer is set, OR
@@ -344,8 +451,8 @@ public:
 	Identification & operator = ( const Identification & OtherID ) = delete;
 
 	// The destructor removes the named actor and the ID from the registries,
-	// and since it implies a structural change of the maps, the lock must be
-	// acquired. It is automatically released when the destructor terminates.
+	// and since it implies a structural change of the maps, the locks of the
+	// shards must be acquired.
 
 	~Identification( void );
 };
@@ -558,6 +665,18 @@ inline Address GetAddress( void ) const
 	return ActorID;
 }
 
+// An actor can be given a new name, for instance when an actor is recycled to
+// serve a different role. It will then get a new address, and the old address
+// will no longer route messages to this actor. The new name must not be the
+// name of another local actor, and a logic error is thrown if it is. Other
+// actors read the address without a lock, and the actor should therefore only
+// be renamed when it is idle and no other actor is using its address.
+
+protected:
+virtual void Rename( const std::string & NewName );
+
+public:
+
 // There is a function to check if an address corresponds to a local actor.
 // The best would be to call the function on the address, but this is an
 // indirect way of doing the same. It is static since it can be called
@@ -612,21 +731,46 @@ inline static void SetPresentationLayerServer(
 // to local actors, although it can be useful for debugging purposes. The To
 // address is sent with the message for remote communication so that the
 // remote endpoint can deliver the message to the right actor.
+//
+// The message queue is intrusive: The message itself is the element of the
+// queue holding the link to the next message and a reference to itself that
+// keeps the message alive while it is queued. These fields are only used by
+// the message queue, which must therefore be a friend of the message. Since
+// the queue links the message, a message can only be stored in one queue,
+// which is ensured by the send function creating a new message for each
+// receiver.
+
+private:
+
+class MessageQueue;
 
 protected:
 
 class GenericMessage
 {
+private:
+
+	std::atomic< GenericMessage * > 	NextMessage;
+	std::shared_ptr< GenericMessage > QueueReference;
+
+	friend class MessageQueue;
+
 public:
 
 	const Address From, To;
 
+	// When messages are traced, the message is given a unique identifier when
+	// it is sent so that the handling can be linked to the sending.
+
+	std::uint64_t TraceID;
+
 	inline GenericMessage( const Address & Sender, const Address & Receiver )
-	: From( Sender ), To( Receiver )
+	: NextMessage( nullptr ), QueueReference(), From( Sender ), To( Receiver ),
+	  TraceID(0)
 	{ }
 
 	inline GenericMessage( void )
-	: From(), To()
+	: NextMessage( nullptr ), QueueReference(), From(), To(), TraceID(0)
 	{ }
 
 	// The copy constructor simply relay the construction to the standard
@@ -645,6 +789,15 @@ public:
 		return nullptr;
 	}
 
+	// The handlers of an actor are indexed by the type of the message they
+	// handle, and the message must therefore return the type of its content.
+	// A generic message has no content and no handlers can handle it.
+
+	virtual std::type_index GetMessageType( void ) const
+	{
+		return std::type_index( typeid( void ) );
+	}
+
 	// It is important to make this class polymorphic by having at least one
 	// virtual method, and it must in order to ensure proper destruction of the
 	// derived messages.
@@ -658,53 +811,116 @@ public:
 // -----------------------------------------------------------------------------
 //
 // Each actor has a queue of messages and add new messages to the end and
-// consume from the front of the queue. It can therefore be implemented as a
-// standard queue. Other Actors will place messages for this actor into this
-// queue, and this actor will consume messages from this queue. Hence, this
-// queue will be the a memory resource shared and accessed by several threads
-// and it therefore needs proper mutex protection. The access to the standard
-// queue is consequently encapsulated in a message queue class. It is a private
-// class as no derived actor should need to directly invoke any of the provided
-// methods.
+// consume from the front of the queue. Other Actors will place messages for
+// this actor into this queue, and this actor will consume messages from this
+// queue. Hence, there are many producers and only one consumer, the Postman
+// or the pool worker executing the actor.
+//
+// Protecting the queue with a mutex makes every send take the lock of the
+// receiver, and when one actor fans out messages to many actors, or many
+// actors send to one actor, the lock is contended. The queue is therefore a
+// lock-free multiple producer, single consumer queue of the kind described by
+// Dmitry Vyukov: A producer atomically exchanges the tail pointer with its
+// message and then links the previous tail to the message. The consumer owns
+// the head and follows the links. There is a short window where the tail has
+// been exchanged but the previous message is not yet linked, and the consumer
+// will then yield until the link is set by the producer. A stub message owned
+// by the queue is linked in when the last message is removed so that the tail
+// never refers to a deleted message.
+//
+// The number of messages is counted separately. It is incremented when a
+// message is stored and decremented when the consumer deletes the first
+// message, so it includes the message being handled in the same way as the
+// size of the standard queue used previously.
+//
+// Threads only park when there is nothing to do: The Postman when the queue
+// is empty, a handler waiting for the next message, and other threads waiting
+// for the queue to drain. The parking is done on an event counter, which is a
+// futex on Linux and a condition variable elsewhere, and the producers only
+// make a system call to wake the parked threads if there are any.
+//
+// The queue can optionally be bounded by a capacity. The queue itself will
+// always store a message, but it tells if it is full, and a sender may wait
+// for space. The space available event is only signalled by the consumer if
+// the queue has a capacity so that unbounded queues have no extra cost.
+//
+// It is a private class as no derived actor should need to directly invoke
+// any of the provided methods.
 
 private:
 
-class MessageQueue : protected std::queue< std::shared_ptr< GenericMessage > >
+class MessageQueue
 {
+public:
+
+	// The size type is defined in the same way as for the standard containers
+
+	using size_type = std::size_t;
+
 private:
 
-	// The messages queue has a mutex to serialise access to the queue, and it
-	// supports the notification of two events: One for the arrival of a new
-	// message and one for the completed message handling. One for ingress
-	// messages and one for egress.
-
-	std::mutex 						  QueueGuard;
-	std::condition_variable NewMessage, MessageDone;
-
-	// An interesting aspect with waiting for these events is that the condition
-	// triggering the event may have changed when the thread waiting for the event
-	// is started. For instance, if one is waiting for a new message on an empty
-	// queue, this message could already be processed by the time the thread
-	// waiting for this signal gets an opportunity to run. Checking the size of
-	// the queue would then again yield an empty queue, and there should be no
-	// reason to terminate the wait. This condition would not happen if the
-	// following requirements are fulfilled by the thread implementation:
-	//
-	// 	1) A notifying all waiting threads will immediately make them ready to
-  //     run and they will all try to lock the mutex.
-	//  2) Access to the mutex is given in order of request. In other words,
-	//     all the threads woken by the notification will have locked the mutex
-	//     before the lock would again be acquired from this thread to add or
-	//     delete messages.
-	//
-	// It has not been possible to find any documentation for this behaviour,
-	// although it is reasonable.
+	// The event counter is incremented whenever the event happens. A thread
+	// waiting for a condition related to the event records the counter before
+	// testing the condition, and parks only if the counter is still the same
+	// when it tries to park. The waiting threads are counted so that the
+	// thread signalling the event knows if it must wake them.
+
+	class Event
+	{
+	private:
+
+		std::atomic< std::uint32_t > Sequence, Waiters;
+
+		#ifndef __linux__
+			std::mutex 						  ParkingGuard;
+			std::condition_variable Parking;
+		#endif
+
+		void Park( std::uint32_t SeenSequence );
+		void Park( std::uint32_t SeenSequence, std::chrono::nanoseconds Timeout );
+		void WakeAll( void );
+
+	public:
+
+		// The timed wait returns false if the condition is still false when the
+		// time out has passed.
+
+		void Await( const std::function< bool( void ) > & Condition );
+		bool Await( const std::function< bool( void ) > & Condition,
+								std::chrono::nanoseconds Timeout );
+		void Signal( void );
+
+		Event( void );
+	};
+
+	Event NewMessage, MessageDone, SpaceAvailable;
+
+	// The head is only used by the consumer, and the tail is shared by the
+	// producers. The stub is the message in the queue when it is empty.
+
+	GenericMessage 									Stub;
+	GenericMessage * 								Head;
+	std::atomic< GenericMessage * > Tail;
+	std::atomic< size_type > 				Count;
+
+	// The capacity is zero for an unbounded queue
+
+	std::atomic< size_type > 				Capacity;
+
+	// Linking a message at the tail is the same for the messages and the stub
+
+	void Link( GenericMessage * TheMessage );
+
+	// The consumer finds the first message after skipping the stub, if it is
+	// at the head. It must only be called when there are messages.
+
+	GenericMessage * FirstMessage( void );
 
 public:
 
 	// The fundamental operations is to store a message and to delete the first
 	// message of the queue. The two operations will signal the corresponding
-	// condition variable.
+	// event.
 
 	void StoreMessage( const std::shared_ptr< GenericMessage > & TheMessage );
 	void DeleteFirstMessage( void );
@@ -712,23 +928,40 @@ public:
 	// The owning actor will need to access the first message in the queue, and
 	// since messages in the queue can only be deleted by the owning actor when
 	// the message has been handled, it is a safe operation to read the first
-	// element and the standard 'front' function for the queue is directly used
+	// element.
+
+	const std::shared_ptr< GenericMessage > & front( void );
 
-	using std::queue< std::shared_ptr< GenericMessage > >::front;
+	// Reading the current size of the queue should be allowed
 
-	// The size type of the queue is also allowed for external access to ensure
-	// that other types are using the correct type
+	inline size_type size( void ) const
+	{ return Count.load(); }
 
-	using std::queue< std::shared_ptr< GenericMessage > >::size_type;
+	// The capacity can be set and read, and the queue is full if it has a
+	// capacity and holds at least this number of messages. Changing the
+	// capacity signals the space available event since more messages may be
+	// allowed.
 
-	// Reading the current size of the queue should be allowed
+	inline void SetCapacity( size_type MaximalSize )
+	{ Capacity.store( MaximalSize ); SpaceAvailable.Signal(); }
 
-	using std::queue< std::shared_ptr< GenericMessage > >::size;
+	inline size_type GetCapacity( void ) const
+	{ return Capacity.load( std::memory_order_relaxed ); }
 
-	// There is a function to check if the queue is empty, and to ensure the
-	// correctness of the test, it must prevent new messages from arriving while
-	// the test is performed. It can also be that one would like to wait for the
-	// next message if the queue is empty. It therefore supports two alternatives
+	inline bool IsFull( void ) const
+	{
+		size_type Limit = Capacity.load( std::memory_order_relaxed );
+		return ( Limit > 0 ) && ( Count.load() >= Limit );
+	}
+
+	// A sender can wait until the queue is no longer full. This blocks the
+	// sending thread until the consumer has removed enough messages.
+
+	void WaitForSpace( void );
+
+	// There is a function to check if the queue is empty, and it can also be
+	// that one would like to wait for the next message if the queue is empty.
+	// It therefore supports two alternatives
 
 	enum class QueueEmpty
 	{
@@ -738,14 +971,20 @@ public:
 
 	bool HasMessage( QueueEmpty Action = QueueEmpty::Return );
 
+	// The Postman may also wait for a message for a limited time only, and the
+	// function returns false if there is still no message after this time.
+
+	bool AwaitMessage( std::chrono::nanoseconds Timeout );
+
 	// It could also be that one would like to wait for the next message to
 	// arrive. This function will therefore block the calling thread until the
-	// next message arrives and the new message condition is signalled. It
+	// next message arrives and the new message event is signalled. It
 	// optionally takes an address of a sender to wait for and if this is given
 	// it will continue to wait until a message from that sender is received.
 	// It is up to the application to ensure that this will not block forever in
 	// that case; or in the case there will never be another message for this
-	// actor.
+	// actor. It must only be called by the consumer, i.e. from a message
+	// handler of the actor.
 
 	void WaitForNextMessage( const Address & SenderToWaitFor = Address::Null() );
 
@@ -756,16 +995,12 @@ public:
 
 	void WaitUntilEmpty( void );
 
-	// The constructor is simply a place holder for initialising the queue and
-	// the locks
-
-	MessageQueue( void )
-	: std::queue< std::shared_ptr< GenericMessage > >(),
-	  QueueGuard(), NewMessage(), MessageDone()
-	{ }
+	// The constructor initialises the queue with the stub as the only element,
+	// and the destructor deletes the messages still in the queue in order to
+	// release their references to themselves.
 
-	// The destructor does nothing special and the default destructor is good
-	// enough.
+	MessageQueue( void );
+	~MessageQueue( void );
 
 } Mailbox;
 
@@ -817,6 +1052,13 @@ public:
 			return nullptr;
 	}
 
+	// The type of the message is the type of the content
+
+	virtual std::type_index GetMessageType( void ) const
+	{
+		return std::type_index( typeid( MessageType ) );
+	}
+
 	// The virtual destructor is just a place holder
 
 	virtual ~Message( void )
@@ -864,225 +1106,841 @@ inline MessageCount GetNumQueuedMessages( void ) const
 { return Mailbox.size(); }
 
 // -----------------------------------------------------------------------------
-// Sending messages
+// Bounded mailboxes
 // -----------------------------------------------------------------------------
 //
-// The main send function allocates a new message of the provided type and
-// enqueues this with the receiving actor. This is the version of the send
-// function found in the Framework in Theron.
-
-public:
+// The mailbox is unbounded by default, and an actor receiving messages faster
+// than it can handle them will then consume memory without limit and delay
+// every later message. A capacity can therefore be set for the mailbox of an
+// actor together with the policy to use when a message is sent to an actor
+// whose mailbox is full:
+//
+// Block:   The sender waits until the actor has handled enough messages. This
+//          gives backpressure to the sending actor, but note that two actors
+//          blocking on each other's full mailbox will deadlock, and in the
+//          thread pool mode the blocked sender occupies a worker. A message
+//          an actor sends to itself is never blocked since the actor could
+//          then never make space.
+// Reject:  The message is not queued and the send function returns false.
+// Discard: The message is not queued, but the send function returns true as
+//          if the message was delivered, so senders that ignore the outcome
+//          are not affected. Messages are shed by dropping the newest.
+//
+// The rejected and discarded messages are counted. The capacity is a soft
+// limit: Several senders testing the capacity at the same time may all store
+// their message, so the mailbox may exceed the capacity by the number of
+// concurrent senders. A capacity of zero makes the mailbox unbounded again.
+// The current depth of the mailbox is given by the number of queued messages.
 
-template< class MessageType >
-static bool Send( const MessageType & TheMessage,
-								  const Address & TheSender,
-									const Address & TheReceiver )
+enum class MailboxOverflow
 {
-	static_assert( std::is_copy_constructible< MessageType >::value,
-								"The message to send must be copy constructible"	);
+	Block,
+	Reject,
+	Discard
+};
 
-	Actor * ReceivingActor;
+void SetMailboxCapacity( MessageCount Capacity,
+												 MailboxOverflow Policy = MailboxOverflow::Block );
 
-  if ( TheReceiver )
-      ReceivingActor = Identification::GetActor( TheReceiver );
-  else
-  {
-    std::ostringstream ErrorMessage;
+inline MessageCount GetMailboxCapacity( void ) const
+{ return Mailbox.GetCapacity(); }
 
-		ErrorMessage << __FILE__ << " at line " << __LINE__ << ":"
-		             << "Send message: The address of the receiving actor must "
-								 << "be a legal address";
+inline MessageCount GetNumRefusedMessages( void ) const
+{ return RefusedMessages.load(); }
 
-	  throw std::invalid_argument( ErrorMessage.str() );
-  }
+private:
 
-	auto MessageCopy = std::make_shared< MessageType >( TheMessage );
+std::atomic< MailboxOverflow > OverflowPolicy;
+std::atomic< MessageCount >		 RefusedMessages;
 
-	return
-	ReceivingActor->EnqueueMessage( std::make_shared< Message< MessageType> >(
-																	MessageCopy, TheSender, TheReceiver	));
-}
+// The test whether the calling thread is the thread executing this actor is
+// needed both to avoid blocking an actor sending to itself and to prevent an
+// actor from waiting for its own mailbox to drain.
 
-// Theron's actor has a simplified version of the send function basically just
-// inserting its own address for the sender's address.
+bool IsExecutingThread( void ) const;
 
-protected:
+// -----------------------------------------------------------------------------
+// Message metrics
+// -----------------------------------------------------------------------------
+//
+// Finding the actors that limit a large actor system requires the depth of
+// their mailboxes, the rate of messages they handle, and the time spent in
+// their message handlers. The actor can therefore record metrics for the
+// messages it handles. The collection is switched on for all actors, and
+// when it is off the only cost is testing a flag for each message handled.
+//
+// The metrics of an actor are created when it handles its first message with
+// the collection switched on, and they are kept per message type: The number
+// of messages handled, the total time spent in the handlers, and a histogram
+// of the handler times. The histogram is log-linear in the same way as the
+// High Dynamic Range (HDR) histograms: The times in nanoseconds are grouped
+// by their power of two, and each power of two is split into four buckets,
+// so that the relative error of a percentile is at most 25% over the full
+// range from nanoseconds to minutes with a fixed number of counters. The
+// maximal mailbox depth is the largest number of queued messages seen when a
+// message was handled.
+//
+// The counters are only written by the thread executing the actor, and reading
+// them from other threads gives a consistent view of each counter but not
+// necessarily of all counters at the same time. The metrics of actors that
+// have been closed are kept until the metrics are reset, so that a report at
+// the end of a run includes all actors.
 
-template< class MessageType >
-inline bool Send( const MessageType & TheMessage,
-									const Address & TheReceiver     ) const
+public:
+
+class HandlerMetrics
 {
-	return Send( TheMessage, GetAddress(), TheReceiver );
-}
+public:
 
-/*=============================================================================
+	static constexpr std::size_t Octaves = 40, BucketsPerOctave = 4,
+															 Buckets = Octaves * BucketsPerOctave;
 
- Handlers
+	std::string 												MessageType;
+	std::uint64_t 											Messages;
+	double 															HandlerSeconds;
+	std::array< std::uint64_t, Buckets > Histogram;
 
-=============================================================================*/
+	// The bucket of a handler time and the upper limit of the times counted by
+	// a bucket are given by static functions.
 
-// The Generic Message class is only supposed to be a polymorphic place holder
-// for the type specific messages constructed by the send function. It provides
-// an interface for a generic message handler, and will call this if its pointer
-// can be cast into the type specific handler class (see below).
+	static std::size_t Bucket( std::uint64_t Nanoseconds );
+	static double 		 BucketSeconds( std::size_t TheBucket );
 
-private:
+	// The percentile is the upper limit of the bucket holding the given fraction
+	// of the handled messages, and it is zero if no messages were handled.
 
-class GenericHandler
+	double Percentile( double Fraction ) const;
+};
+
+class ActorMetrics
 {
 public:
 
-	enum class State
-	{
-		Normal,
-		Executing,
-		Deleted
-	};
+	std::string 									ActorName;
+	std::size_t 									QueuedMessages, MaximalQueue;
+	double 												ObservedSeconds;
+	std::vector< HandlerMetrics > MessageTypes;
 
-protected:
+	// The rate is the number of messages handled per second since the first
+	// message was measured.
 
-	State CurrentStatus;
+	double MessageRate( void ) const;
+};
 
-public:
+// The collection is switched on and off for all actors, and the metrics of
+// all actors can be read, reset, and written in JSON format to a stream or
+// periodically to a file. The periodic dump is stopped by giving a zero
+// interval, and the file is replaced by each dump so that it can be read at
+// any time.
 
-	// A function to get the handler state.
+static void EnableMetrics( bool Collect = true );
 
-	inline State GetStatus( void )
-	{	return CurrentStatus;	}
+inline static bool MetricsEnabled( void )
+{ return CollectMetrics.load( std::memory_order_relaxed ); }
 
-	// And another one to set the status that is only used from the de-registration
-	// function if this this handler should be deleted.
+static std::vector< ActorMetrics > MetricsSnapshot( void );
+static void ResetMetrics( void );
+static void WriteMetrics( std::ostream & Output );
+static void DumpMetrics( const std::string & FileName,
+												 std::chrono::milliseconds Interval );
 
-	inline void SetStatus( const State NewState )
-	{ CurrentStatus = NewState; }
+private:
 
-	// There is a function to execute the handler on a given message
+static std::atomic< bool > CollectMetrics;
 
-	virtual bool ProcessMessage(
-													std::shared_ptr< GenericMessage > & TheMessage ) = 0;
+// The recorder is defined in the implementation file, and it is shared with
+// the registry of the recorders of all actors.
 
-	// The constructor simply sets the status to normal
+class MetricsRecorder;
 
-	GenericHandler( void )
-	{ CurrentStatus = State::Normal; }
+std::shared_ptr< MetricsRecorder > Metrics;
 
-	virtual ~GenericHandler( void )
-	{ }
-};
+static std::list< std::shared_ptr< MetricsRecorder > > & MetricsRegistry( void );
 
-// The actual type specific handler is a template on the message type handled
-// by the function. It remembers the handler function and tries to convert the
-// message to the right type. If this is possible, it will invoke the handler
-// function.
+// -----------------------------------------------------------------------------
+// Message tracing
+// -----------------------------------------------------------------------------
+//
+// The metrics tell which actors are busy, but finding why a chain of messages
+// across many actors takes a long time requires the order and timing of the
+// individual messages. The actors can therefore trace the messages: Each send
+// and each handling is recorded with its time, the sender, the receiver and
+// the message type. The sent message carries an identifier so that its
+// handling can be linked to the send, and the causal chain can be followed
+// from the handler that sent a message to the handler receiving it.
+//
+// The events are recorded in a ring buffer of the thread sending or handling
+// the message, so the threads do not contend for a shared buffer, and each
+// buffer keeps the last events recorded by its thread. The buffers outlive
+// their threads so that the events of closed actors can be written. The trace
+// is written in the Chrome trace event JSON format, which can be opened with
+// the Chrome trace viewer or the Perfetto user interface: Each handling is a
+// slice on the thread handling it, and each message is a flow from the send
+// to the handling.
+//
+// Tracing is switched off by default, and it then costs a flag test for each
+// message sent and handled. Starting the tracing again discards the events
+// of the previous trace.
 
-template< class ActorType, class MessageType >
-class Handler : public GenericHandler
-{
 public:
 
-	// The handler must store the function to process the message. This has the
-	// same signature as the actual handler, and it is specified to call the
-	// function on the actor having this handler.
-
-	void (ActorType::*HandlerFunction)( const MessageType &, const Address );
-
-	// The pointer to the actor having this handler function is also stored
-	// since it is the easiest way to make sure it is the right actor type.
+static void StartTracing( std::size_t EventsPerThread = 65536 );
+static void StopTracing( void );
 
-	ActorType * const TheActor;
+inline static bool TracingEnabled( void )
+{ return TraceMessages.load( std::memory_order_relaxed ); }
 
-	virtual bool ProcessMessage( std::shared_ptr< GenericMessage > & TheMessage )
-	{
-		std::shared_ptr< Message< MessageType > > TypedMessage =
-							std::dynamic_pointer_cast< Message< MessageType > >( TheMessage );
+static void WriteTrace( std::ostream & Output );
 
-		if ( TypedMessage )
-		{
-			// The message could be converted to this message type, and the handler
-			// can be invoked through the handler pointer on the stored actor
+private:
 
-			(TheActor->*HandlerFunction)( *(TypedMessage->TheMessage),
-																	    TypedMessage->From );
-			return true;
-		}
-		else
-			return false;
-	}
+static std::atomic< bool > TraceMessages;
 
-	// The constructor stores the handler function.
+// The recording of the events is done by static functions when the message
+// is sent and after it has been handled.
 
-	Handler( ActorType * HandlingActor,
-     void (ActorType::*GivenHandler)( const MessageType &, const Address ))
-	: GenericHandler(), HandlerFunction( GivenHandler ), TheActor( HandlingActor )
-	{ }
+static void TraceSend( GenericMessage & TheMessage );
+static void TraceHandling( const GenericMessage & TheMessage,
+													 std::chrono::steady_clock::time_point Start,
+													 std::chrono::steady_clock::time_point End );
 
-	// There is a copy constructor to allow this to be used with standard
-	// containers
+// The buffers are defined in the implementation file, and the buffers of
+// all threads are kept in a registry.
 
-	Handler( const Handler<ActorType, MessageType> & OtherHandler )
-	: GenericHandler(), HandlerFunction( OtherHandler.HandlerFunction ),
-	  TheActor( OtherHandler.TheActor )
-	{ }
+class TraceBuffer;
 
-	virtual ~Handler( void )
-	{ }
-};
+static std::list< std::shared_ptr< TraceBuffer > > & TraceRegistry( void );
+static thread_local std::shared_ptr< TraceBuffer > 	 ThreadTrace;
 
-// The list of handlers registered for this actor is kept in a simple list, and
-// The transposition rule suggested by Ronald Rivest (1976): "On self-organizing
-// sequential search heuristics", Communications of the ACM, Vol. 19, No. 2,
-// pp. 63-67 is used to promote message handlers that receive the more messages.
-// Here a successful message handler will be swapped with the element
-// immediately in front unless the element is the handler at the start of the
-// list, and new handlers are added to the end of this list.
-// The default handler treats the message as a generic handler.
-//
-// It should be remarked that there is no mutex to protect this list since
-// it is use to execute the message handlers, and typically additional handlers
-// or deletions of handlers will take place from within the one executing
-// handler, which is running in the same thread as the Dispatch Messages
-// function
+// Both events are recorded in the buffer of the calling thread by a common
+// function, and the thread is named by the receiver of the first message it
+// handles.
 
-std::list< std::shared_ptr< GenericHandler > > MessageHandlers;
+static void RecordTraceEvent( const GenericMessage & TheMessage,
+															bool Handling,
+															std::chrono::steady_clock::time_point Start,
+															std::chrono::steady_clock::time_point End );
 
 // -----------------------------------------------------------------------------
-// Normal handler registration
+// Message allocation
 // -----------------------------------------------------------------------------
 //
-// Registration of handlers is a matter of adding the function call to the
-// list of handlers for the given actor. Essentially the actor pointer is
-// not necessary because the handler should be registered for this actor.
-// However, it seems necessary in order to ensure that the pointer to the
-// handler function is a pointer to a function on the actor it will actually
-// be called for. Note also that the same handler can be registered multiple
-// times, and many handlers can be registered for the same message.
+// Sending a message allocates a copy of the message and the message envelope
+// carrying the addresses, and both are freed when the receiver has handled
+// the message, typically by another thread. Small messages sent at a high
+// rate, like start time proposals, then cost two allocations and two frees
+// each. The message objects are therefore allocated from pools with one pool
+// for the message copies and one for the envelopes of each message type.
+//
+// A pool is a free list per thread so that no lock is needed for most of the
+// allocations. A freed block is kept in the free list of the thread freeing
+// it, which is normally the thread of the receiving actor, whereas the block
+// is needed by the sending thread. The threads therefore exchange blocks in
+// batches through a shared free list: A thread whose free list is full moves
+// a batch to the shared list, and a thread with an empty free list takes a
+// batch from the shared list. The lock of the shared list is then taken once
+// per batch. The shared list is also bounded, and further blocks are returned
+// to the heap.
+//
+// The allocator is given to std::allocate_shared, which rebinds it to the
+// type of the shared pointer's control block holding the object, so the
+// pools are kept per allocated type, and they are named by the message type
+// for the counters. The counters give the number of allocations and the
+// number of allocations served from a free list, so that the hit rate of the
+// pools can be monitored. The pools also count the blocks returned and the
+// blocks taken from the heap, so that the memory of the messages that are
+// queued or being handled, and the memory held by the pools including the
+// free blocks, can be reported in bytes for each message type.
 
-protected:
+public:
 
-template< class ActorType, class MessageType >
-inline bool RegisterHandler( ActorType  * const TheActor,
-							 void ( ActorType::* TheHandler)(	const MessageType & TheMessage,
-																								const Address From ) )
+class MessagePoolCounters
 {
-	TheActor->MessageHandlers.push_back(
-	std::make_shared< Handler< ActorType, MessageType > >(TheActor, TheHandler) );
+public:
 
-	return true;
-}
+	std::string MessageType;
+	std::size_t Allocations, Recycled, LiveBytes, HeapBytes;
+};
 
-// -----------------------------------------------------------------------------
-// Normal handler de-registration
-// -----------------------------------------------------------------------------
-//
-// Since there are no checks that a function is only registered as a hander
-// only once, the full list of handlers must be processed and all handlers
-// whose pair of handling actor and handler function match the registered
-// handler.
+static std::vector< MessagePoolCounters > MessagePoolStatistics( void );
 
-template< class ActorType, class MessageType >
-inline bool DeregisterHandler( ActorType  * const HandlingActor,
-							    void (ActorType::* TheHandler)(const MessageType & TheMessage,
-																								 const Address From ) )
+private:
+
+// The counters of the pools are registered by the pools when they are first
+// used, and there may be several pools for one message type.
+
+class PoolRegistration
+{
+public:
+
+	std::string 											 MessageType;
+	std::size_t 											 BlockSize;
+	const std::atomic< std::size_t > * Allocations, * Recycled, * Released,
+																	 * HeapBlocks;
+};
+
+static std::vector< PoolRegistration > & PoolRegistry( void );
+static void RegisterMessagePool( const PoolRegistration & ThePool );
+
+protected:
+
+template< class ValueType, class PoolName >
+class PoolAllocator
+{
+private:
+
+	// The blocks are exchanged in batches, and a thread keeps at most two
+	// batches in its free list.
+
+	static constexpr std::size_t BatchSize            = 64,
+	                             MaximalFreeBlocks    = 2 * BatchSize,
+	                             MaximalSharedBatches = 64;
+
+	// The shared free list is never destroyed since blocks may be freed during
+	// the destruction of static objects. Its blocks are reclaimed at exit.
+
+	class SharedList
+	{
+	public:
+
+		std::mutex 														Guard;
+		std::vector< std::vector< void * > > 	Batches;
+	};
+
+	static SharedList & SharedFreeList( void )
+	{
+		static SharedList * TheList = new SharedList();
+		return *TheList;
+	}
+
+	// The free list of the thread gives its blocks to the shared list when the
+	// thread terminates. The flag indicating that the free list has been
+	// destroyed is trivially destructible, so it can be tested by blocks freed
+	// by the thread after its free list has been destroyed.
+
+	class FreeList
+	{
+	public:
+
+		std::vector< void * > Blocks;
+
+		FreeList( void )
+		: Blocks()
+		{ Blocks.reserve( MaximalFreeBlocks ); }
+
+		~FreeList( void )
+		{
+			if ( !Blocks.empty() )
+				GiveBatch( std::move( Blocks ) );
+
+			Closed() = true;
+		}
+
+		static bool & Closed( void )
+		{
+			static thread_local bool ListClosed = false;
+			return ListClosed;
+		}
+	};
+
+	static FreeList & ThreadFreeList( void )
+	{
+		static thread_local FreeList TheList;
+		return TheList;
+	}
+
+	// Batches are given to the shared list unless it is full, in which case
+	// the blocks are returned to the heap, and a batch is taken from the shared
+	// list if there is one.
+
+	static void GiveBatch( std::vector< void * > && Batch )
+	{
+		SharedList & Shared( SharedFreeList() );
+
+		{
+			std::lock_guard< std::mutex > Lock( Shared.Guard );
+
+			if ( Shared.Batches.size() < MaximalSharedBatches )
+			{
+				Shared.Batches.push_back( std::move( Batch ) );
+				return;
+			}
+		}
+
+		HeapBlocks.fetch_sub( Batch.size(), std::memory_order_relaxed );
+
+		for ( void * Block : Batch )
+			::operator delete( Block );
+	}
+
+	static bool TakeBatch( std::vector< void * > & Blocks )
+	{
+		SharedList & Shared( SharedFreeList() );
+		std::lock_guard< std::mutex > Lock( Shared.Guard );
+
+		if ( Shared.Batches.empty() )
+			return false;
+
+		Blocks.insert( Blocks.end(), Shared.Batches.back().begin(),
+													 Shared.Batches.back().end() );
+		Shared.Batches.pop_back();
+
+		return true;
+	}
+
+	inline static std::atomic< std::size_t > Allocations{0}, Recycled{0},
+																					 Released{0}, HeapBlocks{0};
+
+public:
+
+	using value_type = ValueType;
+
+	// The allocator is rebound to other types by the standard allocator traits
+	// since the pool name is the second template argument.
+
+	template< class OtherType >
+	struct rebind
+	{ using other = PoolAllocator< OtherType, PoolName >; };
+
+	// Only single objects are allocated from the pool, and the blocks are
+	// allocated with the default alignment of the operator new.
+
+	ValueType * allocate( std::size_t Count )
+	{
+		static_assert( alignof( ValueType ) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+									 "Pooled messages cannot be over-aligned" );
+
+		static const bool Registered = ( RegisterMessagePool(
+			PoolRegistration{ typeid( PoolName ).name(), sizeof( ValueType ),
+												&Allocations, &Recycled, &Released, &HeapBlocks } ),
+			true );
+
+		(void) Registered;
+
+		if ( Count != 1 )
+			return static_cast< ValueType * >(
+						 ::operator new( Count * sizeof( ValueType ) ) );
+
+		Allocations.fetch_add( 1, std::memory_order_relaxed );
+
+		if ( !FreeList::Closed() )
+		{
+			std::vector< void * > & Blocks( ThreadFreeList().Blocks );
+
+			if ( !Blocks.empty() || TakeBatch( Blocks ) )
+			{
+				void * Block = Blocks.back();
+
+				Blocks.pop_back();
+				Recycled.fetch_add( 1, std::memory_order_relaxed );
+
+				return static_cast< ValueType * >( Block );
+			}
+		}
+
+		HeapBlocks.fetch_add( 1, std::memory_order_relaxed );
+
+		return static_cast< ValueType * >( ::operator new( sizeof( ValueType ) ) );
+	}
+
+	void deallocate( ValueType * Block, std::size_t Count )
+	{
+		if ( Count == 1 )
+			Released.fetch_add( 1, std::memory_order_relaxed );
+
+		if ( ( Count == 1 ) && !FreeList::Closed() )
+		{
+			std::vector< void * > & Blocks( ThreadFreeList().Blocks );
+
+			if ( Blocks.size() == MaximalFreeBlocks )
+			{
+				std::vector< void * > Batch( Blocks.end() - BatchSize, Blocks.end() );
+
+				Blocks.resize( MaximalFreeBlocks - BatchSize );
+				GiveBatch( std::move( Batch ) );
+			}
+
+			Blocks.push_back( Block );
+		}
+		else
+		{
+			if ( Count == 1 )
+				HeapBlocks.fetch_sub( 1, std::memory_order_relaxed );
+
+			::operator delete( Block );
+		}
+	}
+
+	// The allocators are stateless and they are all equal.
+
+	PoolAllocator( void ) = default;
+
+	template< class OtherType >
+	PoolAllocator( const PoolAllocator< OtherType, PoolName > & Other )
+	{ }
+
+	template< class OtherType >
+	inline bool operator == ( const PoolAllocator< OtherType, PoolName > & Other )
+	const
+	{ return true; }
+
+	template< class OtherType >
+	inline bool operator != ( const PoolAllocator< OtherType, PoolName > & Other )
+	const
+	{ return false; }
+};
+
+// -----------------------------------------------------------------------------
+// Sending messages
+// -----------------------------------------------------------------------------
+//
+// The main send function allocates a new message of the provided type and
+// enqueues this with the receiving actor. This is the version of the send
+// function found in the Framework in Theron. The message copy and the
+// envelope are allocated from the pools of the message type.
+//
+// The payload is constructed by a helper function that forwards the message
+// given to the send function, so that a message given as a temporary or
+// explicitly moved by the sender is moved into the envelope instead of being
+// copied. The message type must still be copy constructible since the
+// handlers normally receive the message by constant reference and a handler
+// taking the message by value may have to copy it (see below).
+
+private:
+
+template< class MessageType, class GivenMessage >
+static bool PostMessage( GivenMessage && TheMessage,
+												 const Address & TheSender,
+												 const Address & TheReceiver )
+{
+	static_assert( std::is_copy_constructible< MessageType >::value,
+								"The message to send must be copy constructible"	);
+
+	Actor * ReceivingActor;
+
+  if ( TheReceiver )
+      ReceivingActor = Identification::GetActor( TheReceiver );
+  else
+  {
+    std::ostringstream ErrorMessage;
+
+		ErrorMessage << __FILE__ << " at line " << __LINE__ << ":"
+		             << "Send message: The address of the receiving actor must "
+								 << "be a legal address";
+
+	  throw std::invalid_argument( ErrorMessage.str() );
+  }
+
+	auto MessageCopy = std::allocate_shared< MessageType >(
+										 PoolAllocator< MessageType, MessageType >(),
+										 std::forward< GivenMessage >( TheMessage ) );
+
+	auto Envelope = std::allocate_shared< Message< MessageType > >(
+		PoolAllocator< Message< MessageType >, MessageType >(),
+		std::move( MessageCopy ), TheSender, TheReceiver	);
+
+	if ( TracingEnabled() )
+		TraceSend( *Envelope );
+
+	return ReceivingActor->EnqueueMessage( std::move( Envelope ) );
+}
+
+// The send function for a message that is an lvalue copies the message, and
+// the overload for an rvalue moves it. The rvalue overload is only enabled
+// when the template argument is not deduced as a reference since it would
+// otherwise be chosen for non-constant lvalues and steal from the sender.
+
+public:
+
+template< class MessageType >
+static bool Send( const MessageType & TheMessage,
+								  const Address & TheSender,
+									const Address & TheReceiver )
+{
+	return PostMessage< MessageType >( TheMessage, TheSender, TheReceiver );
+}
+
+template< class MessageType,
+				  typename = std::enable_if_t< !std::is_reference_v< MessageType > > >
+static bool Send( MessageType && TheMessage,
+								  const Address & TheSender,
+									const Address & TheReceiver )
+{
+	return PostMessage< std::remove_cv_t< MessageType > >(
+				 std::move( TheMessage ), TheSender, TheReceiver );
+}
+
+// Theron's actor has a simplified version of the send function basically just
+// inserting its own address for the sender's address.
+
+protected:
+
+template< class MessageType >
+inline bool Send( const MessageType & TheMessage,
+									const Address & TheReceiver     ) const
+{
+	return Send( TheMessage, GetAddress(), TheReceiver );
+}
+
+template< class MessageType,
+				  typename = std::enable_if_t< !std::is_reference_v< MessageType > > >
+inline bool Send( MessageType && TheMessage,
+									const Address & TheReceiver     ) const
+{
+	return Send( std::move( TheMessage ), GetAddress(), TheReceiver );
+}
+
+/*=============================================================================
+
+ Handlers
+
+=============================================================================*/
+
+// The Generic Message class is only supposed to be a polymorphic place holder
+// for the type specific messages constructed by the send function. It provides
+// an interface for a generic message handler, and will call this if its pointer
+// can be cast into the type specific handler class (see below).
+
+private:
+
+class GenericHandler
+{
+public:
+
+	enum class State
+	{
+		Normal,
+		Executing,
+		Deleted
+	};
+
+protected:
+
+	State CurrentStatus;
+
+	// A handler taking the message by value may move the payload out of the
+	// message if no other handler will see the message after it. This is
+	// allowed by the message dispatcher for the last handler of the message
+	// type.
+
+	bool TakeMessage;
+
+public:
+
+	// A function to get the handler state.
+
+	inline State GetStatus( void )
+	{	return CurrentStatus;	}
+
+	// And another one to set the status that is only used from the de-registration
+	// function if this this handler should be deleted.
+
+	inline void SetStatus( const State NewState )
+	{ CurrentStatus = NewState; }
+
+	// The dispatcher tells the handler if it may take the message before it is
+	// asked to process the message
+
+	inline void AllowMessageTaking( const bool Allowed )
+	{ TakeMessage = Allowed; }
+
+	// There is a function to execute the handler on a given message
+
+	virtual bool ProcessMessage(
+													std::shared_ptr< GenericMessage > & TheMessage ) = 0;
+
+	// The constructor simply sets the status to normal
+
+	GenericHandler( void )
+	{ CurrentStatus = State::Normal; TakeMessage = false; }
+
+	virtual ~GenericHandler( void )
+	{ }
+};
+
+// The actual type specific handler is a template on the message type handled
+// by the function. It remembers the handler function and converts the message
+// to the right type before invoking the handler function. The handler is only
+// given messages of its type since the handlers are indexed by the message
+// type, and the conversion is therefore a static conversion.
+
+template< class ActorType, class MessageType >
+class Handler : public GenericHandler
+{
+public:
+
+	// The handler must store the function to process the message. This has the
+	// same signature as the actual handler, and it is specified to call the
+	// function on the actor having this handler.
+
+	void (ActorType::*HandlerFunction)( const MessageType &, const Address );
+
+	// The pointer to the actor having this handler function is also stored
+	// since it is the easiest way to make sure it is the right actor type.
+
+	ActorType * const TheActor;
+
+	virtual bool ProcessMessage( std::shared_ptr< GenericMessage > & TheMessage )
+	{
+		Message< MessageType > * TypedMessage =
+							static_cast< Message< MessageType > * >( TheMessage.get() );
+
+		(TheActor->*HandlerFunction)( *(TypedMessage->TheMessage),
+																  TypedMessage->From );
+		return true;
+	}
+
+	// The constructor stores the handler function.
+
+	Handler( ActorType * HandlingActor,
+     void (ActorType::*GivenHandler)( const MessageType &, const Address ))
+	: GenericHandler(), HandlerFunction( GivenHandler ), TheActor( HandlingActor )
+	{ }
+
+	// There is a copy constructor to allow this to be used with standard
+	// containers
+
+	Handler( const Handler<ActorType, MessageType> & OtherHandler )
+	: GenericHandler(), HandlerFunction( OtherHandler.HandlerFunction ),
+	  TheActor( OtherHandler.TheActor )
+	{ }
+
+	virtual ~Handler( void )
+	{ }
+};
+
+// A handler can also take the message by value, and it can then keep the
+// content of the message, for instance a large vector, without copying it.
+// The payload is moved into the argument of the handler function if this is
+// the last handler for the message type and no one else refers to the
+// payload, otherwise the argument is a copy of the payload so that the other
+// handlers will see the original message. Note that a handler registered by
+// a handler of the same message type while it executes is added after the
+// executing handler, and it will see the moved payload if the executing
+// handler took it.
+
+template< class ActorType, class MessageType >
+class MessageTakingHandler : public GenericHandler
+{
+public:
+
+	void (ActorType::*HandlerFunction)( MessageType, const Address );
+
+	ActorType * const TheActor;
+
+	virtual bool ProcessMessage( std::shared_ptr< GenericMessage > & TheMessage )
+	{
+		Message< MessageType > * TypedMessage =
+							static_cast< Message< MessageType > * >( TheMessage.get() );
+
+		if ( TakeMessage && ( TypedMessage->TheMessage.use_count() == 1 ) )
+			(TheActor->*HandlerFunction)( std::move( *(TypedMessage->TheMessage) ),
+																		TypedMessage->From );
+		else
+			(TheActor->*HandlerFunction)( *(TypedMessage->TheMessage),
+																		TypedMessage->From );
+		return true;
+	}
+
+	MessageTakingHandler( ActorType * HandlingActor,
+		void (ActorType::*GivenHandler)( MessageType, const Address ))
+	: GenericHandler(), HandlerFunction( GivenHandler ), TheActor( HandlingActor )
+	{ }
+
+	MessageTakingHandler(
+		const MessageTakingHandler< ActorType, MessageType > & OtherHandler )
+	: GenericHandler(), HandlerFunction( OtherHandler.HandlerFunction ),
+	  TheActor( OtherHandler.TheActor )
+	{ }
+
+	virtual ~MessageTakingHandler( void )
+	{ }
+};
+
+// The handlers registered for this actor are kept in lists indexed by the type
+// of the message they handle, so finding the handlers of a message is a hash
+// lookup of its type regardless of how many handlers the actor has. Several
+// handlers can be registered for the same message type, and they are called
+// in the order of registration. The default handler treats the message as a
+// generic handler.
+//
+// The lists are never removed from the index, even when their last handler is
+// de-registered, since a handler may de-register itself or other handlers of
+// the same type while the dispatcher iterates the list. The elements of an
+// unordered map keep their addresses when the map grows, so a handler may
+// also register handlers for other message types while it is executing.
+//
+// It should be remarked that there is no mutex to protect the handlers since
+// they are used to execute the message handlers, and typically additional
+// handlers or deletions of handlers will take place from within the one
+// executing handler, which is running in the same thread as the Dispatch
+// Messages function
+
+using HandlerList = std::list< std::shared_ptr< GenericHandler > >;
+
+std::unordered_map< std::type_index, HandlerList > MessageHandlers;
+
+// -----------------------------------------------------------------------------
+// Normal handler registration
+// -----------------------------------------------------------------------------
+//
+// Registration of handlers is a matter of adding the function call to the
+// list of handlers for the message type of the given actor. Essentially the actor pointer is
+// not necessary because the handler should be registered for this actor.
+// However, it seems necessary in order to ensure that the pointer to the
+// handler function is a pointer to a function on the actor it will actually
+// be called for. Note also that the same handler can be registered multiple
+// times, and many handlers can be registered for the same message.
+
+protected:
+
+template< class ActorType, class MessageType >
+inline bool RegisterHandler( ActorType  * const TheActor,
+							 void ( ActorType::* TheHandler)(	const MessageType & TheMessage,
+																								const Address From ) )
+{
+	TheActor->MessageHandlers[ std::type_index( typeid( MessageType ) ) ].push_back(
+	std::make_shared< Handler< ActorType, MessageType > >(TheActor, TheHandler) );
+
+	return true;
+}
+
+// A handler taking the message by value is registered in the same way. The
+// message type is not allowed to be a reference since the handler function
+// taking the message by constant reference would otherwise also match this
+// registration.
+
+template< class ActorType, class MessageType,
+				  typename = std::enable_if_t< !std::is_reference_v< MessageType > > >
+inline bool RegisterHandler( ActorType  * const TheActor,
+							 void ( ActorType::* TheHandler)(	MessageType TheMessage,
+																								const Address From ) )
+{
+	TheActor->MessageHandlers[ std::type_index( typeid( MessageType ) ) ].push_back(
+	std::make_shared< MessageTakingHandler< ActorType, MessageType > >(
+																									TheActor, TheHandler ) );
+
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// Normal handler de-registration
+// -----------------------------------------------------------------------------
+//
+// Since there are no checks that a function is only registered as a hander
+// only once, the full list of handlers for the message type must be processed
+// and all handlers whose pair of handling actor and handler function match the
+// registered handler. The removal is done by a helper function that is
+// templated on the class of the handler so that it can be used for both the
+// handlers taking the message by reference and the handlers taking it by
+// value.
+
+private:
+
+template< class HandlerType, class ActorType, class MessageType,
+					class FunctionType >
+inline bool RemoveHandler( ActorType * const HandlingActor,
+													 FunctionType TheHandler )
 {
 	// To compare the actor and the handler function pointer, it is necessary to
 	// know that that the handler is of the right type, and RTTI is used for
@@ -1097,8 +1955,8 @@ inline bool DeregisterHandler( ActorType  * const HandlingActor,
 
 	auto ToBeRemoved = [=]( const std::shared_ptr< GenericHandler > & AnyHandler )
 	->bool{
-		std::shared_ptr< Handler< ActorType, MessageType > > TypedHandler =
-		 std::dynamic_pointer_cast< Handler< ActorType, MessageType > >(AnyHandler);
+		std::shared_ptr< HandlerType > TypedHandler =
+		 std::dynamic_pointer_cast< HandlerType >(AnyHandler);
 
 		if (  TypedHandler &&
 			  ( TypedHandler->TheActor == HandlingActor ) &&
@@ -1121,20 +1979,49 @@ inline bool DeregisterHandler( ActorType  * const HandlingActor,
 	// the size of the handler list must be checked before and after the
 	// removal.
 
-	auto InitialHandlerCount = HandlingActor->MessageHandlers.size();
+	auto TypeHandlers = HandlingActor->MessageHandlers.find(
+											std::type_index( typeid( MessageType ) ) );
+
+	if ( TypeHandlers == HandlingActor->MessageHandlers.end() )
+		return false;
+
+	auto InitialHandlerCount = TypeHandlers->second.size();
 
 	// With the comparator it is easy to remove the handlers of this type
 
-	HandlingActor->MessageHandlers.remove_if( ToBeRemoved );
+	TypeHandlers->second.remove_if( ToBeRemoved );
 
 	// Then a meaningful feedback can be given
 
-	if ( InitialHandlerCount == HandlingActor->MessageHandlers.size() )
+	if ( InitialHandlerCount == TypeHandlers->second.size() )
 		return false;
 	else
 		return true;
 }
 
+// The de-registration functions then only select the handler class
+
+protected:
+
+template< class ActorType, class MessageType >
+inline bool DeregisterHandler( ActorType  * const HandlingActor,
+							    void (ActorType::* TheHandler)(const MessageType & TheMessage,
+																								 const Address From ) )
+{
+	return RemoveHandler< Handler< ActorType, MessageType >, ActorType,
+												MessageType >( HandlingActor, TheHandler );
+}
+
+template< class ActorType, class MessageType,
+				  typename = std::enable_if_t< !std::is_reference_v< MessageType > > >
+inline bool DeregisterHandler( ActorType  * const HandlingActor,
+							    void (ActorType::* TheHandler)( MessageType TheMessage,
+																								  const Address From ) )
+{
+	return RemoveHandler< MessageTakingHandler< ActorType, MessageType >,
+												ActorType, MessageType >( HandlingActor, TheHandler );
+}
+
 // -----------------------------------------------------------------------------
 // Checking registration
 // -----------------------------------------------------------------------------
@@ -1143,10 +2030,12 @@ inline bool DeregisterHandler( ActorType  * const HandlingActor,
 // be used to test if a particular handler is already registered, and it is
 // almost an exact copy of the previous method.
 
-template< class ActorType, class MessageType >
-inline bool IsHandlerRegistered ( ActorType  * const HandlingActor,
-							    void (ActorType::* TheHandler)(const MessageType & TheMessage,
-																								 const Address From ) )
+private:
+
+template< class HandlerType, class ActorType, class MessageType,
+					class FunctionType >
+inline bool FindHandler( ActorType * const HandlingActor,
+												 FunctionType TheHandler )
 {
 	// To compare the actor and the handler function pointer, it is necessary to
 	// know that that the handler is of the right type, and RTTI is used for
@@ -1156,8 +2045,8 @@ inline bool IsHandlerRegistered ( ActorType  * const HandlingActor,
 
 	auto IsHandler = [=]( const std::shared_ptr< GenericHandler > & AnyHandler )
 	->bool{
-		std::shared_ptr< Handler< ActorType, MessageType > > TypedHandler =
-		 std::dynamic_pointer_cast< Handler< ActorType, MessageType > >(AnyHandler);
+		std::shared_ptr< HandlerType > TypedHandler =
+		 std::dynamic_pointer_cast< HandlerType >(AnyHandler);
 
 		if (  TypedHandler &&
 			  ( TypedHandler->TheActor == HandlingActor ) &&
@@ -1168,11 +2057,36 @@ inline bool IsHandlerRegistered ( ActorType  * const HandlingActor,
 	};
 
 	// Then the standard search algorithm can be used to find an occurrence of
-	// the given actor and handler function.
+	// the given actor and handler function among the handlers of the message
+	// type.
+
+	auto TypeHandlers = HandlingActor->MessageHandlers.find(
+											std::type_index( typeid( MessageType ) ) );
+
+	return ( TypeHandlers != HandlingActor->MessageHandlers.end() ) &&
+	std::any_of( TypeHandlers->second.begin(), TypeHandlers->second.end(),
+							 IsHandler );
+}
 
-	return
-	std::any_of( HandlingActor->MessageHandlers.begin(),
-							 HandlingActor->MessageHandlers.end(), IsHandler );
+protected:
+
+template< class ActorType, class MessageType >
+inline bool IsHandlerRegistered ( ActorType  * const HandlingActor,
+							    void (ActorType::* TheHandler)(const MessageType & TheMessage,
+																								 const Address From ) )
+{
+	return FindHandler< Handler< ActorType, MessageType >, ActorType,
+											MessageType >( HandlingActor, TheHandler );
+}
+
+template< class ActorType, class MessageType,
+				  typename = std::enable_if_t< !std::is_reference_v< MessageType > > >
+inline bool IsHandlerRegistered ( ActorType  * const HandlingActor,
+							    void (ActorType::* TheHandler)( MessageType TheMessage,
+																								  const Address From ) )
+{
+	return FindHandler< MessageTakingHandler< ActorType, MessageType >,
+											ActorType, MessageType >( HandlingActor, TheHandler );
 }
 
 // -----------------------------------------------------------------------------
@@ -1305,9 +2219,46 @@ volatile bool ActorRunning;
 // -----------------------------------------------------------------------------
 //
 // Execution of the handlers for queued messages will take place in a dedicated
-// thread that will be started at construction time.
+// thread, the Postman. Many actors never receive a message, or receive only a
+// few messages early in their life, and a thread for each of them would only
+// hold stack memory. The Postman is therefore started by the first message
+// stored in the mailbox rather than by the constructor. If an idle time is
+// set, the Postman also terminates when it has waited this long for the next
+// message, and it is started again by the next message. The threads and their
+// stacks then follow the actors that are active rather than all the actors.
+//
+// The flag telling if the Postman is active is the hand-over between the
+// Postman and the senders. A Postman going idle clears the flag and then
+// checks the mailbox again, whereas a sender stores its message and then
+// checks the flag. Hence, either the Postman sees the message and continues,
+// or the sender sees the cleared flag and starts a new Postman. The start is
+// serialised by a lock so that only one sender starts the new Postman, and it
+// joins the idle Postman before the thread object is reused. The identity of
+// the current Postman thread is kept separately since the thread object may
+// be replaced while other threads ask if they execute the actor.
+
+std::thread 									 Postman;
+mutable std::mutex 						 PostmanGuard;
+std::atomic< bool > 					 PostmanActive;
+std::atomic< std::thread::id > PostmanThread;
+
+void StartPostman( void );
+
+// The idle time is shared by all actors, and zero means that the Postman
+// never terminates before the actor is closed. The number of running Postmen
+// is counted to show the threads used by the actors.
+
+static std::atomic< std::chrono::milliseconds::rep > PostmanIdleTime;
+static std::atomic< std::size_t > 									 RunningPostmen;
+
+public:
+
+static void SetPostmanIdleTime( std::chrono::milliseconds IdleTime );
+
+inline static std::size_t ActivePostmen( void )
+{ return RunningPostmen.load(); }
 
-std::thread Postman;
+private:
 
 // This thread will execute the following function that will take out the
 // first message from the queue and call the handler for this message. If
@@ -1317,6 +2268,263 @@ std::thread Postman;
 
 void DispatchMessages( void );
 
+// The handling of one message, the first in the queue, is the same for the
+// dedicated thread and for the workers of the thread pool, and it is done by
+// a separate function called from the dispatcher and from the pool workers.
+// The message is deleted from the queue when it has been handled.
+
+void HandleFirstMessage( void );
+
+// -----------------------------------------------------------------------------
+// Thread pool execution
+// -----------------------------------------------------------------------------
+//
+// As an alternative to the dedicated Postman thread, the actor can be executed
+// by a pool of worker threads shared by all actors using this execution mode.
+// The mode must be chosen before the actor is constructed, and it applies to
+// all actors constructed after the mode has been set. The number of workers
+// is given when the pool is started by the first selection of the pool mode,
+// and it defaults to the number of hardware threads. Later selections of the
+// pool mode will use the running pool.
+//
+// A message handler of a pooled actor that blocks, for instance by waiting for
+// its next message, for a Receiver, or for another actor to drain its mailbox,
+// will block the worker executing it. The application must therefore ensure
+// that not all workers can be blocked at the same time, or use dedicated
+// threads for the actors whose handlers block.
+//
+// The exception is the destruction of a pooled actor by the handler of
+// another pooled actor, which is typical for actors owning other actors. The
+// destructor must wait for the pending messages of the destroyed actor to be
+// handled, and if the destroyed actor is queued with the blocked worker, or if
+// all other workers are busy, this would deadlock. A worker destroying a
+// pooled actor therefore takes the actor out of the queues and handles its
+// pending messages itself, and only waits if the actor is currently executed
+// by another worker.
+
+public:
+
+enum class ExecutionMode
+{
+	DedicatedThread,
+	ThreadPool
+};
+
+static void SetExecutionMode( ExecutionMode Mode,
+															unsigned int NumberOfWorkers = 0 );
+
+// Many classes have thousands of mostly idle instances that should rather be
+// executed by the pool, whereas the other actors of the application should
+// keep their own threads. The execution mode can therefore be set for a class
+// of actors, and it applies to the instances of the class constructed after
+// the mode has been set, provided that the class constructs its actor base
+// with the execution mode of the class. Setting the pool mode for a class
+// starts the pool if it is not running, but it does not change the mode of
+// other actors.
+
+template< class ActorType >
+static void SetExecutionMode( ExecutionMode Mode )
+{ SetClassExecutionMode( std::type_index( typeid( ActorType ) ), Mode ); }
+
+protected:
+
+template< class ActorType >
+static ExecutionMode ClassExecutionMode( void )
+{ return ClassExecutionMode( std::type_index( typeid( ActorType ) ) ); }
+
+private:
+
+// The modes of the classes are kept in a map protected by a mutex, and a
+// class without a mode of its own uses the mode for new actors.
+
+static std::unordered_map< std::type_index, ExecutionMode > ClassModes;
+static std::shared_mutex 																		ClassModeGuard;
+
+static void SetClassExecutionMode( std::type_index ActorClass,
+																	 ExecutionMode Mode );
+static ExecutionMode ClassExecutionMode( std::type_index ActorClass );
+
+// The pool is started by the first actor or class selecting the pool mode
+
+static void StartPool( unsigned int NumberOfWorkers );
+
+// The pool is a private class of the actor since only the actor should use
+// it. Each worker has its own queue of actors ready to execute, and a worker
+// takes actors from the front of its own queue. A worker with an empty queue
+// steals from the back of the queues of the other workers, and parks on a
+// condition variable only if all queues are empty. Actors made ready by a
+// worker, typically by a message sent from a handler, are queued with that
+// worker, whereas actors made ready by other threads are distributed over
+// the workers in turn.
+
+class Scheduler
+{
+private:
+
+	class WorkQueue
+	{
+	public:
+
+		std::mutex 			    QueueGuard;
+		std::deque< Actor * > ReadyActors;
+	};
+
+	std::vector< std::unique_ptr< WorkQueue > > Queues;
+	std::vector< std::thread > 									Workers;
+
+	// The queues are partitioned over the NUMA nodes. Each queue has the order
+	// in which its worker looks for actors, starting with its own queue and the
+	// other queues of the same node, and each node has the list of its queues.
+
+	std::vector< std::vector< std::size_t > > StealOrder, NodeQueues;
+	std::vector< int > 												QueueNode;
+
+	// The number of queued actors is counted so that the workers can park when
+	// there are no actors to execute, and the parking workers are counted so
+	// that the submitting thread only needs to notify if there are parked
+	// workers.
+
+	std::atomic< std::size_t > ReadyCount, ParkedWorkers, NextQueue;
+	std::atomic< bool > 			 PoolRunning;
+	std::mutex 								 ParkingGuard;
+	std::condition_variable 	 WorkAvailable;
+
+	// A worker first looks in its own queue and then tries to steal from the
+	// other queues. It returns a null pointer if there was no actor.
+
+	Actor * TakeActor( std::size_t OwnQueue );
+
+	// The worker function executes actors until the pool is closed.
+
+	void Worker( std::size_t OwnQueue );
+
+public:
+
+	// Actors that have received a message when they had no pending messages
+	// are submitted to the pool.
+
+	void Submit( Actor * ReadyActor );
+
+	// An actor being destroyed by a worker can be taken out of the queues so
+	// that the worker can handle its pending messages. The function returns
+	// false if the actor was not queued, typically because it is executed by
+	// another worker.
+
+	bool Withdraw( Actor * QueuedActor );
+
+	// The number of workers is fixed by the constructor, and the destructor
+	// stops and joins the workers.
+
+	Scheduler( unsigned int NumberOfWorkers );
+	~Scheduler( void );
+};
+
+// The pool is shared by all pooled actors, and it is created when the pool
+// mode is first selected. The mode used for new actors is stored together
+// with the pool.
+
+static std::unique_ptr< Scheduler > ThePool;
+static std::atomic< ExecutionMode > DefaultExecutionMode;
+
+// The mode of the actor is fixed at construction. A pooled actor counts its
+// pending messages, and it is submitted to the pool when the count is
+// incremented from zero. The worker executing the actor decrements the count
+// for each message handled, and it owns the actor until the count returns
+// to zero. Hence, there is never more than one worker executing the actor.
+
+const ExecutionMode Execution;
+std::atomic< std::size_t > PendingMessages;
+
+// A worker handles a limited number of messages before the actor is queued
+// again so that actors with many messages do not delay the other actors.
+
+static constexpr std::size_t MessageBatch = 16;
+
+void ProcessPendingMessages( void );
+
+// The destructor of a pooled actor handles or waits for the pending messages
+// as described above. Messages arriving after the actor was closed are only
+// removed.
+
+void DrainPendingMessages( void );
+
+// -----------------------------------------------------------------------------
+// Placement
+// -----------------------------------------------------------------------------
+//
+// The threads executing the actors are by default left to the operating
+// system, which may place actors that exchange many messages, or share data,
+// on different processor sockets so that the cache lines are moved between
+// the sockets for every message. An actor may therefore be given a placement
+// hint with a processor core to pin its Postman to, or a NUMA node whose
+// processors it should run on, and an affinity group. The actors of a group
+// are placed together: the first actor of a group decides the placement of
+// the group, either by its own core or node, or by being given the next NUMA
+// node in turn if it has no hint, and the later actors of the group without a
+// core or node of their own follow the group. An explicit core or node always
+// takes precedence over the group.
+//
+// A pooled actor cannot be pinned since the workers are shared, and the hint
+// is then used to select the worker. The workers of the pool are partitioned
+// over the NUMA nodes and pinned to the processors of their node, and a
+// pooled actor with a node is queued with a worker on its node. The workers
+// steal first from the workers on their own node before stealing from other
+// nodes.
+//
+// The nodes and their processors are read from the system on Linux, and
+// restricted to the processors the process is allowed to use. Placement has
+// no effect on other systems where the whole machine is seen as one node.
+
+public:
+
+class Placement
+{
+public:
+
+	std::optional< unsigned int > Core, NumaNode;
+	std::string 									Group;
+
+	inline bool empty( void ) const
+	{ return !Core && !NumaNode && Group.empty(); }
+};
+
+// The placement can be set when the actor is constructed or later, for
+// instance to co-locate an actor with the actor that created it. A running
+// Postman is moved immediately, and the workers use the new placement the
+// next time the actor is queued. An invalid argument exception is thrown if
+// the core or the node is not available to the process.
+
+void SetPlacement( const Placement & Hint );
+Placement GetPlacement( void ) const;
+
+// The processors available to the actors can be restricted by a mask of the
+// NUMA nodes to use and a mask of the processors to use within each node,
+// where bit n of the processor mask selects the n-th processor of the node.
+// The actors without a placement are then also pinned to the remaining
+// processors. The restriction should be set before the pool is started and
+// before the actors are constructed, as it is not applied to running threads.
+
+static void RestrictPlacement( std::uint32_t NodeMask,
+															 std::uint32_t ProcessorMask );
+
+private:
+
+// The hint is kept as given, and it is resolved against the group and the
+// topology when it is set. The node of the resolved placement is kept
+// separately for the pool since the actor may be queued by any thread. A
+// negative node means that the actor has no preferred node. The placements
+// are protected by the Postman guard.
+
+Placement 				 PlacementHint, ResolvedPlacement;
+std::atomic< int > PreferredNode;
+
+static Placement ResolvePlacement( const Placement & Hint );
+
+// The Postman is pinned to the processors of the resolved placement when it
+// is started.
+
+void PinPostman( void );
+
 // There is a potential issue if a message given to an actor that has no
 // registered handler for the type of message. There are then two options:
 // the dispatch function can throw an exception indicating the type of the
@@ -1404,6 +2612,107 @@ inline static void WaitForGlobalTermination( void )
 	Identification::WaitForGlobalTermination();
 }
 
+// -----------------------------------------------------------------------------
+// Quiescence detection
+// -----------------------------------------------------------------------------
+//
+// Waiting for global termination requires that all actors are known and that
+// the waiting thread is not an actor. A simulation driven by a discrete event
+// queue needs to know when the actor system has finished all the work caused
+// by the current event so that the clock can move to the next event. Waiting
+// for a fixed time after the last message of interest is both slow and
+// unsafe, and the actors therefore count all pending activities: A message
+// is counted when it is stored in a mailbox and until it has been handled,
+// or removed by a closed actor. Since a handler sending a message is itself
+// handling a counted message, the count cannot drop to zero while there are
+// messages caused by the handled message, and the actor system is quiescent
+// when the count is zero.
+//
+// Activities that will later send messages without being a message, like a
+// pending time out of the timer wheel or a thread waiting for network input
+// to forward, can be counted by holding an Activity object for as long as the
+// activity is pending. The number of handlers being executed is also counted
+// for monitoring, although it is always covered by the messages in flight.
+//
+// An actor asks to be notified once when the system is quiescent, and it will
+// then receive a Quiescent message. The notification is typically requested
+// by a handler, which implies that it will come when all messages following
+// this handler have been handled. If the system is already quiescent when the
+// notification is requested, it is sent immediately. Other threads can block
+// until the system is quiescent.
+//
+// Note that the counts only cover the local actors. A message sent to a
+// remote actor is handled when it is handed to the network layer, and a
+// distributed application must acknowledge the remote handling by its own
+// protocol, for instance by holding an Activity until the acknowledgement
+// arrives.
+
+public:
+
+class Quiescent
+{
+public:
+
+	Quiescent( void ) = default;
+	Quiescent( const Quiescent & Other ) = default;
+};
+
+static void NotifyWhenQuiescent( const Address & TheActor );
+static void WaitForQuiescence( void );
+
+inline static bool IsQuiescent( void )
+{ return PendingActivities.load() == 0; }
+
+inline static std::uint64_t NumPendingActivities( void )
+{ return PendingActivities.load(); }
+
+inline static std::uint64_t NumExecutingHandlers( void )
+{ return ExecutingHandlers.load(); }
+
+// The activity object counts the activity from its construction until it is
+// released or destroyed.
+
+static void BeginActivity( void );
+static void EndActivity( void );
+
+class Activity
+{
+private:
+
+	bool Pending;
+
+public:
+
+	inline void Release( void )
+	{
+		if ( Pending )
+		{
+			Pending = false;
+			EndActivity();
+		}
+	}
+
+	Activity( void )
+	: Pending( true )
+	{ BeginActivity(); }
+
+	Activity( const Activity & Other ) = delete;
+
+	~Activity( void )
+	{ Release(); }
+};
+
+private:
+
+static std::atomic< std::uint64_t > PendingActivities, ExecutingHandlers;
+
+// When the count of pending activities drops to zero, the actors waiting for
+// the quiescence are notified if the count is still zero.
+
+static void QuiescenceReached( void );
+
+public:
+
 // Waiting for a message to be processed is provided via the virtual call back
 // function Message Processed, and the Receiver class below provides a way for
 // another thread to wait for an actor to receive and process one or more
@@ -1425,9 +2734,15 @@ inline static void WaitForGlobalTermination( void )
 
 // The actor allows the a user defined name to be given, and if it is omitted
 // it will be assigned by default as "ActorNN" where NN is the numerical ID of
-// the actor.
+// the actor. An optional placement hint decides where the actor executes. The
+// execution mode is by default the mode for new actors, and a class with its
+// own execution mode should pass the mode of the class.
 
-Actor( const std::string & ActorName = std::string() );
+Actor( const std::string & ActorName = std::string(),
+			 const Placement & Hint = Placement() );
+
+Actor( const std::string & ActorName, ExecutionMode Mode,
+			 const Placement & Hint = Placement() );
 
 // The destructor needs to consider the situation where the actor is destroyed
 // while there is an active wait for more messages. It must also wait until
@@ -1576,7 +2891,17 @@ public:
 	{ return 0; }
 
 	inline void ResetCounters( void )
-	{ }
+	{ Actor::ResetMetrics(); }
+
+	// The message metrics of the actors are available through the framework,
+	// which can also dump them periodically to a file.
+
+	inline std::vector< ActorMetrics > GetMetrics( void ) const
+	{ return Actor::MetricsSnapshot(); }
+
+	inline void DumpMetrics( const std::string & FileName,
+													 std::chrono::milliseconds Interval )
+	{ Actor::DumpMetrics( FileName, Interval ); }
 
 	// The Theron Framework has a method to set the fall back handler with respect
 	// to an actor. However, this is no different from the actors default hander,
@@ -1608,10 +2933,15 @@ public:
 		Actor::GlobalFramework = this;
 	}
 
+	// The node and processor masks of the parameters restrict the processors
+	// used by the actors, see the actor's placement. The other parameters have
+	// no effect.
+
 	Framework( const Parameters & params )
 	: Actor( "Framework" )
 	{
 		Actor::GlobalFramework = this;
+		Actor::RestrictPlacement( params.mNodeMask, params.mProcessorMask );
 	}
 
 	Framework( EndPoint & endPoint, const char *const name = 0,
@@ -1658,20 +2988,27 @@ private:
 
 	std::condition_variable OneMessageArrived;
 
+	// A thread gathering replies is only woken when all the replies it waits
+	// for have arrived, and the number of unconsumed messages needed to wake
+	// the waiting thread is therefore kept. It is one for the normal wait.
 
+	MessageCount WakeUpCount;
 
 protected:
 
 	// The main hook for the receiver functionality in extending the functionality
 	// of the actor is the new message function. This will add to the count of
-	// unconsumed messages and notify the wait handler.
+	// unconsumed messages and notify the wait handler if enough messages have
+	// arrived.
 
 	virtual void MessageProcessed( void )
 	{
 		std::lock_guard< std::mutex > Lock( CounterGuard );
 
 		Unconsumed++;
-		OneMessageArrived.notify_one();
+
+		if ( Unconsumed >= WakeUpCount )
+			OneMessageArrived.notify_one();
 	}
 
 public:
@@ -1736,16 +3073,141 @@ public:
 		return Consume( MessageLimit );
 	}
 
+	// A scatter and gather protocol sends a request to many actors and waits
+	// for all the replies. Waiting for the replies with the Theron wait above
+	// wakes the waiting thread for every reply, which is costly when the
+	// requests go to hundreds of actors. The gather function instead waits
+	// until the given number of replies have arrived, or until the deadline
+	// if one is given, and the waiting thread is only woken when the last
+	// reply has arrived. It consumes and returns the number of replies
+	// received, which is less than the number asked for only if the deadline
+	// passed. The replies should be stored by the handlers, for instance in
+	// reply slots indexed by the sender, see below.
+
+	inline MessageCount Gather( MessageCount Replies )
+	{
+		std::unique_lock< std::mutex > Lock( CounterGuard );
+
+		WakeUpCount = std::max( Replies, MessageCount(1) );
+		OneMessageArrived.wait( Lock, [&](void)->bool{
+			return Unconsumed >= Replies; });
+		WakeUpCount = 1;
+
+		Unconsumed -= Replies;
+		return Replies;
+	}
+
+	inline MessageCount Gather( MessageCount Replies,
+															std::chrono::steady_clock::time_point Deadline )
+	{
+		std::unique_lock< std::mutex > Lock( CounterGuard );
+
+		WakeUpCount = std::max( Replies, MessageCount(1) );
+		OneMessageArrived.wait_until( Lock, Deadline, [&](void)->bool{
+			return Unconsumed >= Replies; });
+		WakeUpCount = 1;
+
+		MessageCount Served = std::min( static_cast< MessageCount >( Unconsumed ),
+																		Replies );
+
+		Unconsumed -= Served;
+		return Served;
+	}
+
 	// The receiver has two constructors, one without argument that will give
 	// the receiver a default ActorNN name, and one for which a name can be
 	// given, but also an endpoint reference is needed.
 
 	Receiver( void )
-	: Actor(), Unconsumed(0), CounterGuard(), OneMessageArrived()
+	: Actor(), Unconsumed(0), CounterGuard(), OneMessageArrived(),
+	  WakeUpCount(1)
 	{ }
 
 	Receiver( EndPoint & endPoint, const char *const name = 0 )
-	: Actor( name ), Unconsumed(0), CounterGuard(), OneMessageArrived()
+	: Actor( name ), Unconsumed(0), CounterGuard(), OneMessageArrived(),
+	  WakeUpCount(1)
+	{ }
+};
+
+// -----------------------------------------------------------------------------
+// Reply slots
+// -----------------------------------------------------------------------------
+//
+// The replies gathered by a receiver are typically combined when all of them
+// have arrived. The reply slots keep one reply for each of the expected
+// senders in a vector allocated once, and the handler stores a reply in the
+// slot of its sender. The replies can then be combined in the order of the
+// senders rather than in the order the replies happened to arrive, which
+// makes the combination reproducible, and a slot that already has the size
+// of the reply is reused without allocating memory.
+//
+// The slots are written by the handlers of the receiver and read by the
+// thread that gathered the replies. The gather function synchronises the two
+// threads through the lock of the receiver's counter, and the slots need no
+// lock of their own provided that they are only read after the gather.
+
+template< class ReplyType >
+class ReplySlots
+{
+private:
+
+	using SenderID = decltype( std::declval< const Address & >().AsInteger() );
+
+	std::unordered_map< SenderID, std::size_t > Senders;
+	std::vector< ReplyType > 										Replies;
+
+public:
+
+	// Senders are added in the order of their slots, and adding a sender that
+	// already has a slot returns the existing slot.
+
+	std::size_t AddSender( const Address & Sender )
+	{
+		auto Slot = Senders.emplace( Sender.AsInteger(), Replies.size() );
+
+		if ( Slot.second )
+			Replies.emplace_back();
+
+		return Slot.first->second;
+	}
+
+	// The slot of a sender is found by its numerical identifier, and it is a
+	// logic error to receive a reply from an actor that has no slot.
+
+	ReplyType & operator[] ( const Address & Sender )
+	{
+		auto Slot = Senders.find( Sender.AsInteger() );
+
+		if ( Slot == Senders.end() )
+		{
+			std::ostringstream ErrorMessage;
+
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "No reply slot for the sender " << Sender.AsString();
+
+			throw std::logic_error( ErrorMessage.str() );
+		}
+
+		return Replies[ Slot->second ];
+	}
+
+	inline std::size_t size( void ) const
+	{ return Replies.size(); }
+
+	inline typename std::vector< ReplyType >::const_iterator begin( void ) const
+	{ return Replies.cbegin(); }
+
+	inline typename std::vector< ReplyType >::const_iterator end( void ) const
+	{ return Replies.cend(); }
+
+	inline void clear( void )
+	{
+		Senders.clear();
+		Replies.clear();
+	}
+
+	ReplySlots( void )
+	: Senders(), Replies()
 	{ }
 };
 
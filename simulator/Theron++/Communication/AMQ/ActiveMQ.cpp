@@ -8,6 +8,8 @@ License: LGPL 3.0
 ==============================================================================*/
 
 #include <vector>
+#include <variant>
+#include <type_traits>
 
 #include "ActiveMQ.hpp"
 
@@ -33,13 +35,41 @@ Theron::Address Theron::ActiveMQ::Message::ActorAddress (
 
 // The properties of the message can be transferred to the CMS message before 
 // it is transmitted. To avoid double storage of the strings identifying the 
-// sender actor and the receiving actor, they are treated separately.
+// sender actor and the receiving actor, they are treated separately. The 
+// value of each property is visited to call the CMS set function matching 
+// the type of the value.
 
 void 
 Theron::ActiveMQ::Message::StoreProperties( cms::Message * TheMessage ) const
 {
-	for ( auto & TheProperty : Properties )
-		TheProperty.second->StoreProperty( TheProperty.first, TheMessage );
+	auto Store = [TheMessage]( const Property & TheProperty ){
+		std::visit( [&]( const auto & TheValue ){
+			using ValueType = std::decay_t< decltype( TheValue ) >;
+			
+			if constexpr ( std::is_same_v< ValueType, bool > )
+				TheMessage->setBooleanProperty( TheProperty.Label, TheValue );
+			else if constexpr ( std::is_same_v< ValueType, unsigned char > )
+				TheMessage->setByteProperty( TheProperty.Label, TheValue );
+			else if constexpr ( std::is_same_v< ValueType, short int > )
+				TheMessage->setShortProperty( TheProperty.Label, TheValue );
+			else if constexpr ( std::is_same_v< ValueType, int > )
+				TheMessage->setIntProperty( TheProperty.Label, TheValue );
+			else if constexpr ( std::is_same_v< ValueType, long long int > )
+				TheMessage->setLongProperty( TheProperty.Label, TheValue );
+			else if constexpr ( std::is_same_v< ValueType, float > )
+				TheMessage->setFloatProperty( TheProperty.Label, TheValue );
+			else if constexpr ( std::is_same_v< ValueType, double > )
+				TheMessage->setDoubleProperty( TheProperty.Label, TheValue );
+			else
+				TheMessage->setStringProperty( TheProperty.Label, TheValue );
+		}, TheProperty.Value );
+	};
+	
+	for ( std::size_t Slot = 0; Slot < UsedSlots; Slot++ )
+		Store( Slots[ Slot ] );
+	
+	for ( const Property & TheProperty : Overflow )
+		Store( TheProperty );
 }
 
 // Getting properties from a CMS message is basically testing repeatedly for 
@@ -229,6 +259,12 @@ void Theron::ActiveMQ::NetworkLayer::OutboundMessage(
 	
 	TheMessage.StoreProperties( Outbound );
 	
+	// The batch of messages should be committed if this message ends a 
+	// transaction or if there are no more messages waiting to be sent.
+	
+	bool Commit = ( TheMessage.SessionType == Message::Session::TransactionEnd )
+								|| ( GetNumQueuedMessages() <= 1 );
+	
 	// If there is a destination object for this topic or queue it is readily 
 	// reused to send the message. If not the message will be sent from a 
 	// temporary destination. 
@@ -236,7 +272,7 @@ void Theron::ActiveMQ::NetworkLayer::OutboundMessage(
 	auto Destination = Destinations.find( TopicOrQueue );
 		
 	if ( Destination != Destinations.end() )
-		Producer->send( Destination->second.get(), Outbound );
+		Transmit( Destination->second.get(), Outbound, Commit );
 	else
   {
 		cms::Destination * TemporaryDestination;
@@ -251,7 +287,7 @@ void Theron::ActiveMQ::NetworkLayer::OutboundMessage(
 				break;
 		}
 		
-		Producer->send( TemporaryDestination, Outbound );
+		Transmit( TemporaryDestination, Outbound, Commit );
 		delete TemporaryDestination;
 	}
 	
@@ -260,6 +296,31 @@ void Theron::ActiveMQ::NetworkLayer::OutboundMessage(
 	delete Outbound;
 }
 
+// All messages are sent through the transmit function that ensures that only
+// one thread at the time uses the producer. If the producer session is 
+// transacted, the messages sent are committed when the batch is full or if 
+// the caller requests the commit.
+
+void Theron::ActiveMQ::NetworkLayer::Transmit(
+	const cms::Destination * TheDestination, cms::Message * TheMessage, 
+	bool Commit )
+{
+	std::lock_guard< std::mutex > Lock( ProducerLock );
+	
+	Producer->send( TheDestination, TheMessage );
+	
+	if ( CommitBatch > 0 )
+	{
+		UncommittedMessages++;
+		
+		if ( Commit || ( UncommittedMessages >= CommitBatch ) )
+		{
+			ProducerSession->commit();
+			UncommittedMessages = 0;
+		}
+	}
+}
+
 // The command handler receives requests from remote endpoints. The current 
 // set of commands is only the actor discovery, where a discovery request is 
 // sent to the discovery topic, and where the endpoint hosting that actor will 
@@ -295,7 +356,7 @@ void Theron::ActiveMQ::NetworkLayer::CommandHandler(
 					 Response->setStringProperty( "GlobalAddress", 
 					     GlobalAddress( ActorName, GetAddress().AsString() ).AsString() );
 					 
-					 Producer->send( Destinations[ DiscoveryTopic ].get(), Response );
+					 Transmit( Destinations[ DiscoveryTopic ].get(), Response );
 					 
 					 delete Response;
 				 }
@@ -307,6 +368,7 @@ void Theron::ActiveMQ::NetworkLayer::CommandHandler(
 				  GlobalAddress( TheTextMessage->getStringProperty( "GlobalAddress" ) ), 
 					Address( TheTextMessage->getStringProperty( "ActorName" ) ) );
 				 
+				 StoreResolution( ForTheRecord );
 				 Send( ForTheRecord, 
 							 Theron::Network::GetAddress( Theron::Network::Layer::Session ) );
 			 }
@@ -316,6 +378,7 @@ void Theron::ActiveMQ::NetworkLayer::CommandHandler(
 				 RemoveActor TheMessage( 
 				 GlobalAddress( TheTextMessage->getStringProperty("GlobalAddress") ) );
 				 
+				 ForgetResolution( TheMessage.GlobalAddress );
 				 Send( TheMessage, 
 							 Theron::Network::GetAddress( Theron::Network::Layer::Session ) );
 			}
@@ -355,7 +418,7 @@ void Theron::ActiveMQ::NetworkLayer::ResolveAddress(
 		GlobalAddress( TheRequest.NewActor.AsString(), 
 									 GetAddress().AsString() ).AsString() );
 	
-	Producer->send( Destinations[ DiscoveryTopic ].get(), TheMessage );
+	Transmit( Destinations[ DiscoveryTopic ].get(), TheMessage );
 	
 	delete TheMessage;
 }
@@ -374,7 +437,7 @@ void Theron::ActiveMQ::NetworkLayer::ActorRemoval(
 	TheMessage->setStringProperty( "GlobalAddress", 
 															TheCommand.GlobalAddress.AsString() );
 	
-	Producer->send( Destinations[ DiscoveryTopic ].get(), TheMessage );
+	Transmit( Destinations[ DiscoveryTopic ].get(), TheMessage );
 	
 	delete TheMessage;
 }
@@ -431,12 +494,15 @@ void Theron::ActiveMQ::NetworkLayer::RemoveSubscription(
 
 Theron::ActiveMQ::NetworkLayer::NetworkLayer( 
 	const std::string & EndpointName, const std::string & AMQServerIP, 
-	const std::string & Port)
+	const std::string & Port, unsigned int InFlightWindow, 
+	unsigned int CommitBatchSize )
 : Actor( EndpointName ), StandardFallbackHandler( EndpointName ),
   Theron::NetworkLayer< TextMessage >( EndpointName ),
   AMQConnection( nullptr ), AMQSession( nullptr ),
   Destinations(), 
   ProducerResource( nullptr ), Producer( nullptr ), 
+  ProducerSession( nullptr ), CommitBatch( CommitBatchSize ), 
+  UncommittedMessages( 0 ), ProducerLock(),
   Subscriptions()
 {
 	// Starting the AMQ interface and creating the connection using a temporary 
@@ -449,6 +515,16 @@ Theron::ActiveMQ::NetworkLayer::NetworkLayer(
 														
 	AMQFactory->setBrokerURI( "tcp://" + AMQServerIP + ":" + Port );
 	
+	// Asynchronous sending is enabled if there is an in-flight window, and 
+	// the producer will then block when the window is full and resume when 
+	// the broker has acknowledged the messages.
+	
+	if ( InFlightWindow > 0 )
+	{
+		AMQFactory->setUseAsyncSend( true );
+		AMQFactory->setProducerWindowSize( InFlightWindow );
+	}
+	
 	AMQConnection = dynamic_cast< activemq::core::ActiveMQConnection *>( 
 																AMQFactory->createConnection()  );
 	
@@ -478,13 +554,21 @@ Theron::ActiveMQ::NetworkLayer::NetworkLayer(
 											[this]( const cms::Message * TheMessage )->void{ 
 												 InboundMessage( TheMessage ); } ) ); 
 	
-	// Then create the producer resource and use it to initialise the actual 
-	// producer. Persistent message delivery is configured since there is no way 
-	// to detect lost messages unless the application puts in place a higher 
-	// level protocol. The producer resource is created for the discovery topic 
-	// although it will be used by the producer for other destinations later.
+	// Then create the producer session, which is transacted if messages should
+	// be committed in batches, the producer resource, and use it to initialise 
+	// the actual producer. Persistent message delivery is configured since 
+	// there is no way to detect lost messages unless the application puts in 
+	// place a higher level protocol. The producer resource is created for the 
+	// discovery topic although it will be used by the producer for other 
+	// destinations later.
+	
+	ProducerSession = dynamic_cast< activemq::core::ActiveMQSession * >(
+		AMQConnection->createSession( CommitBatch > 0 ? 
+			cms::Session::SESSION_TRANSACTED : cms::Session::AUTO_ACKNOWLEDGE ) );
 	
-	ProducerResource = AMQSession->createProducer( 
+	ProducerSession->start();
+	
+	ProducerResource = ProducerSession->createProducer( 
 																				Destinations[ DiscoveryTopic ].get() );
 	
 	Producer = new activemq::cmsutil::CachedProducer( ProducerResource );
@@ -500,12 +584,20 @@ Theron::ActiveMQ::NetworkLayer::NetworkLayer(
 
 Theron::ActiveMQ::NetworkLayer::~NetworkLayer()
 {
+	// Messages sent since the last commit are committed before the producer 
+	// session is stopped.
+	
+	if ( ( CommitBatch > 0 ) && ( UncommittedMessages > 0 ) )
+		ProducerSession->commit();
+	
+	ProducerSession->stop();
 	AMQSession->stop();
 	AMQConnection->stop();
 	AMQConnection->close();
 	activemq::library::ActiveMQCPP::shutdownLibrary();
 	delete Producer;
 	delete ProducerResource;
+	delete ProducerSession;
 	delete AMQSession;
 	delete AMQConnection;
 }
@@ -111,7 +111,9 @@ License: LGPL 3.0
 
 #include <memory>        // For smart pointers
 #include <string>        // For standard strings
-#include <map>           // For storing properties
+#include <array>         // For the pre-allocated property slots
+#include <vector>        // For overflow properties
+#include <variant>       // For storing property values
 #include <unordered_map> // For O(1) lookups
 #include <set>           // For storing subscribing actors
 #include <typeinfo>      // For knowing property types
@@ -119,6 +121,7 @@ License: LGPL 3.0
 #include <sstream>       // For nice error messages
 #include <stdexcept>     // For standard exceptions
 #include <functional>    // Dynamic functions
+#include <mutex>         // For serialising the producer
 
 // Headers for the Active Message Queue interface and the C++ Messaging System
 // (CMS) [2]. Unfortunately, the C++ library for AMQ is written to be similar 
@@ -382,118 +385,117 @@ class Message
 	// problem, but since the actual storage in the CMS message will take place 
 	// later, the properties must be cached.
 	// 
-	// The used method is to store the properties as a generic value class 
-	// pointer in a map based on the property label, and call a virtual function
-	// on the property value to store the value.
+	// The properties were originally stored as generic value class pointers in 
+	// a map, which meant that every property of every message implied one heap 
+	// allocation for the value object, one for its shared pointer control block
+	// and one for the map node. However, the set of property types supported 
+	// by the CMS is closed, and the value can therefore be held in a variant 
+	// over these types. A message normally carries only a handful of properties
+	// and they are stored in a small array of slots that is allocated as a part 
+	// of the message. Only if a message has more properties than there are slots
+	// will the remaining properties be stored in an overflow vector. A property 
+	// of a type not supported by the CMS will fail at compile time as it cannot 
+	// be stored in the variant.
 	
 private:
 
-  class PropertyValue
-  {
-	private:
-		
-		// The base class simply stores the type of the value in a way that it 
-		// can be used to look up the type later.
-		
-		const std::type_index TypeID;
-		
+	using PropertyValue = std::variant< bool, unsigned char, short int, int, 
+																			long long int, float, double, 
+																			std::string >;
+	
+	class Property
+	{
 	public:
 		
-		virtual 
-		void StoreProperty( const std::string & Label, 
-											  cms::Message * TheMessage ) = 0;
-		
-		inline std::type_index GetType( void )
-		{ return TypeID; }
-		
-		// The type ID is stored by the constructor
-		
-		PropertyValue( const std::type_index & ValueType )
-		: TypeID( ValueType )
-		{}
-		
-		// Which means that there cannot be a default constructor.
-		
-		PropertyValue( void ) = delete;
-		
-		// Since the class has virtual method it needs a virtual destructor
-		
-		virtual ~PropertyValue( void )
-		{ }
+		std::string   Label;
+		PropertyValue Value;
 	};
 	
-	// Then there is a template class for a given value type to be specialised 
-	// below the class together with the functions to set and get the property 
-	// values.
+	static constexpr std::size_t PropertySlots = 4;
 	
-	template< class ValueType >
-	class Value : public PropertyValue
+	std::array< Property, PropertySlots > Slots;
+	std::size_t                           UsedSlots;
+	std::vector< Property >               Overflow;
+	
+	// Looking up a property is a linear search over the used slots and then the 
+	// overflow properties. This is faster than hashing the label for the few 
+	// properties that a message has, and a null pointer is returned if there is 
+	// no property with the given label.
+	
+	inline const Property * FindProperty( const std::string & Label ) const
 	{
-	public:
-		
-		const ValueType TheValue;
-		
-		// Since different functions has to be called for the different types, an 
-		// implicit interface function must be specialised for each type. These 
-		// specialisations cannot be done within the class, and it is done at the 
-		// end of this header for readability reasons.
-		
-	  virtual 
-	  void StoreProperty( const std::string & Label, 
-		 								    cms::Message * TheMessage );
-
-		// The constructor only needs the value since the type ID can be taken 
-		// from the template parameter
-		
-		Value( const ValueType & GivenValue )
-		: PropertyValue( typeid( ValueType ) ),
-		  TheValue( GivenValue )
-		{ }
-		
-		// The default constructor has no meaning for this class
-		
-		Value( void ) = delete;
-		
-		// The specific value type class also needs a virtual destructor
-		
-		virtual ~Value( void )
-		{ }
-	};
+		for ( std::size_t Slot = 0; Slot < UsedSlots; Slot++ )
+			if ( Slots[ Slot ].Label == Label )
+				return &Slots[ Slot ];
+			
+		for ( const Property & Stored : Overflow )
+			if ( Stored.Label == Label )
+				return &Stored;
+			
+		return nullptr;
+	}
 	
-	// The property values are then stored as shared pointers in a map where the 
-	// label is the key.
+	// The access functions below require that the property exists, and there 
+	// is a version of the look up that throws a standard out of range exception
+	// if the label does not correspond to a property.
 	
-	std::map< std::string, std::shared_ptr< PropertyValue > > Properties;
+	inline const Property & LookupProperty( const std::string & Label ) const
+	{
+		const Property * TheProperty = FindProperty( Label );
+		
+		if ( TheProperty == nullptr )
+		{
+			std::ostringstream ErrorMessage;
+			
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "Message property " << Label << " does not exist";
+									 
+		  throw std::out_of_range( ErrorMessage.str() );
+		}
+		
+		return *TheProperty;
+	}
 	
 	// With these definitions it is possible to define the public interface to 
 	// set and get property values, the type and to check if the property label 
 	// has been defined in order to verify the message end-to-end protocol. The 
-	// function to set the property simply adds it to the map.
+	// function to set the property takes the next free slot, or adds it to the 
+	// overflow properties if all slots are used. Consistent with the previous 
+	// map based storage, an existing property will not be overwritten.
 	
 public:
 	
 	template< class ValueType >
 	void SetProperty( const std::string & Label, const ValueType & GivenValue )
 	{
-		Properties.emplace( Label, 
-												std::make_shared< Value< ValueType > >( GivenValue ) );
+		if ( FindProperty( Label ) == nullptr )
+		{
+			if ( UsedSlots < PropertySlots )
+			{
+				Slots[ UsedSlots ].Label = Label;
+				Slots[ UsedSlots ].Value.template emplace< ValueType >( GivenValue );
+				UsedSlots++;
+			}
+			else
+				Overflow.push_back( Property{ Label, 
+					PropertyValue( std::in_place_type< ValueType >, GivenValue ) } );
+		}
 	}
 	
-	// Retrieving the value of a property by its label implies to first cast 
-	// dynamically the base class pointer to the given value class and then 
-	// return the desired value. If the label does not correspond to a property,
-	// there will be an exception raised from the standard map, and if the 
-	// pointer could not be converted to the right value class type a standard 
-	// logic error exception will be thrown.
+	// Retrieving the value of a property by its label implies to look up the 
+	// property and then return the value if it holds the requested type. If 
+	// the label does not correspond to a property, there will be an out of 
+	// range exception raised, and if the value is not of the given type a 
+	// standard logic error exception will be thrown.
 	
 	template< class ValueType >
 	ValueType GetProperty( const std::string & Label ) const
 	{
-		std::shared_ptr< Value< ValueType > > TheProperty
-		= std::dynamic_pointer_cast< Value< ValueType > >( Properties.at( Label ) );
+		const ValueType * TheValue 
+			= std::get_if< ValueType >( &LookupProperty( Label ).Value );
 		
-		if ( TheProperty )
-			return TheProperty->TheValue;
+		if ( TheValue != nullptr )
+			return *TheValue;
 		else
 		{
 			std::ostringstream ErrorMessage;
@@ -507,29 +509,34 @@ public:
 	}
 	
 	// There is also a generic way to get the type index of a property based on 
-	// its label. Note that the at lookup function will throw if the label is 
+	// its label. Note that the lookup function will throw if the label is 
 	// not a legal property label. The properties defines the message protocol
 	// between the sender and the receiver and therefore they should be known,
 	// and if in doubt the label should be checked.
 	
 	inline std::type_index GetPropertyType( const std::string & Label ) const
 	{
-		return Properties.at( Label )->GetType();
+		return std::visit( []( const auto & TheValue ){ 
+			return std::type_index( typeid( TheValue ) ); 
+		}, LookupProperty( Label ).Value );
 	}
 		
-	// The function to check if a property exist simply searches the map for 
-	// the given label
+	// The function to check if a property exist simply searches for the 
+	// given label
 	
 	inline bool PropertyExists( const std::string & Label ) const
 	{
-		return Properties.find( Label ) != Properties.end();
+		return FindProperty( Label ) != nullptr;
 	}
 	
-	// There is a function to clear all the properties
+	// There is a function to clear all the properties. The slots are just 
+	// marked as free so that the storage allocated for their labels can be 
+	// reused by subsequent properties.
 	
 	inline void ClearProperties( void )
 	{
-		Properties.clear();
+		UsedSlots = 0;
+		Overflow.clear();
 	}
 		
   // ---------------------------------------------------------------------------
@@ -707,12 +714,12 @@ protected:
 	
 	inline Message( const GlobalAddress & SendingActor, 
 									const GlobalAddress & ReceivingActor,
-								  const Theron::SerialMessage::Payload & ThePayload,
+								  const Theron::SerialMessage::SharedPayload & ThePayload,
 								  const Type        MessageClass = Type::Unknown,
 									const Destination Mode         = Destination::Topic, 
 								  const Session     Transmission = Session::AutoAcknowledge )
 	: LinkMessage< GlobalAddress >( SendingActor, ReceivingActor, ThePayload ),
-	  Properties(), DestinationMode( Mode ), SessionType( Transmission ), 
+	  Slots(), UsedSlots( 0 ), Overflow(), DestinationMode( Mode ), SessionType( Transmission ), 
 	  MessageType( MessageClass )
 	{
 		SetProperty( "AMQDestination", ReceivingActor.Endpoint() );
@@ -725,8 +732,9 @@ public:
 	
 	inline Message( const Message & Other )
 	: LinkMessage< GlobalAddress >( Other.GetSender(), Other.GetRecipient(), 
-																  Other.GetPayload() ),
-	  Properties( Other.Properties.begin(), Other.Properties.end() ),
+																  Other.GetSharedPayload() ),
+	  Slots( Other.Slots ), UsedSlots( Other.UsedSlots ), 
+	  Overflow( Other.Overflow ),
 	  DestinationMode( Other.DestinationMode ), SessionType( Other.SessionType ),
 	  MessageType( Other.MessageType )
 	{}
@@ -769,7 +777,7 @@ public:
 	
 	inline TextMessage( const GlobalAddress & SendingActor, 
 										  const GlobalAddress & ReceivingActor,
-										  const Theron::SerialMessage::Payload & ThePayload,
+										  const Theron::SerialMessage::SharedPayload & ThePayload,
 										  const Destination Mode         = Destination::Topic, 
 										  const Session     Transmission = Session::AutoAcknowledge)
 	: Message( SendingActor, ReceivingActor, ThePayload, Type::TextMessage, 
@@ -779,7 +787,7 @@ public:
 	// It can be copied...
 	
  	inline TextMessage( const TextMessage & Other )
-	: TextMessage( Other.GetSender(), Other.GetRecipient(), Other.GetPayload(),
+	: TextMessage( Other.GetSender(), Other.GetRecipient(), Other.GetSharedPayload(),
 								 Other.DestinationMode, Other.SessionType )
 	{}
 	
@@ -958,6 +966,36 @@ private:
 	cms::MessageProducer *              ProducerResource;
 	activemq::cmsutil::CachedProducer * Producer;
 	
+	// Sending persistent messages synchronously implies that the network layer
+	// waits for the broker to acknowledge every message, and the throughput is
+	// then bounded by the round trip time to the broker. The producer can 
+	// therefore optionally be configured to send asynchronously with a window 
+	// bounding the number of bytes in flight, after which sending blocks until 
+	// the broker has acknowledged enough messages. 
+	//
+	// The producer also has its own session, which is transacted if a commit 
+	// batch size is given. Messages are then committed to the broker when the 
+	// batch is full, when the message ends a transaction, or when there are no 
+	// more outbound messages queued for this actor, so that a message is never
+	// left uncommitted waiting for a message that may never come. The count of
+	// messages sent since the last commit is kept together with the batch size.
+	
+	activemq::core::ActiveMQSession * ProducerSession;
+	const unsigned int                CommitBatch;
+	unsigned int                      UncommittedMessages;
+	
+	// Command messages are produced by the handler for the discovery topic, 
+	// which is called on the thread of the CMS library, concurrently with the 
+	// outbound messages sent by this actor. All messages are therefore sent 
+	// by a transmit function serialising access to the producer and the 
+	// producer session, and which commits the batch if this is requested or 
+	// if the batch is full. 
+	
+	std::mutex ProducerLock;
+	
+	void Transmit( const cms::Destination * TheDestination, 
+								 cms::Message * TheMessage, bool Commit = true );
+	
 	// Listening to events from arriving messages is different since the message 
 	// events will arrive asynchronously and the handling will be done by a 
 	// dedicated class that can provide a dedicated function for handling the 
@@ -1115,13 +1153,20 @@ private:
 	// The constructor takes the global identifier of this network endpoint as 
 	// its name and the IP of the server to connect to and optionally the port 
 	// used to reach the AMQ message broker. If no port is given, the standard 
-	// 61616. 
+	// 61616. The in-flight window is the number of bytes that can be sent 
+	// asynchronously before the broker has acknowledged them, and messages are
+	// sent synchronously if it is zero. The commit batch is the maximal number 
+	// of messages sent in one transaction of the producer session, and the 
+	// session is not transacted if it is zero. The defaults correspond to the 
+	// synchronous, message by message, sending of the original implementation.
 	
 public:
 	
 	NetworkLayer( const std::string & EndpointName, 
 								const std::string & AMQServerIP, 
-							  const std::string & Port = "61616" );
+							  const std::string & Port = "61616", 
+								unsigned int InFlightWindow = 0, 
+								unsigned int CommitBatchSize = 0 );
 
 	// The default constructor is deleted
 	
@@ -1139,83 +1184,5 @@ public:
 ==============================================================================*/
 
 
-/*==============================================================================
-
- Message: specialisation of functions storing the properties
-
-==============================================================================*/
-//
-// Boolean specialisation
-
-template<>
-void Message::Value< bool >::StoreProperty( 
-	const std::string & Label, cms::Message * TheMessage )
-{
-	TheMessage->setBooleanProperty( Label, TheValue );
-}
-
-// Byte specialisation
-
-template<>
-void Message::Value< unsigned char >::StoreProperty( 
-	const std::string & Label, cms::Message * TheMessage )
-{
-	TheMessage->setByteProperty( Label, TheValue );
-}
-
-// Double specialisation
-
-template<>
-void Message::Value< double >::StoreProperty( 
-	const std::string & Label, cms::Message * TheMessage )
-{
-	TheMessage->setDoubleProperty( Label, TheValue );
-}
-
-// Float specialisation
-
-template<>
-void Message::Value< float >::StoreProperty( 
-	const std::string & Label, cms::Message * TheMessage )
-{
-	TheMessage->setFloatProperty( Label, TheValue );
-}
-
-// Integer specialisation
-
-template<>
-void Message::Value< int >::StoreProperty( 
-	const std::string & Label, cms::Message * TheMessage )
-{
-	TheMessage->setIntProperty( Label, TheValue );
-}
-
-// Long specialisation
-
-template<>
-void Message::Value< long long int >::StoreProperty( 
-	const std::string & Label, cms::Message * TheMessage )
-{
-	TheMessage->setLongProperty( Label, TheValue );
-}
-
-// Short specialisation
-
-template<>
-void Message::Value< short int >::StoreProperty( 
-	const std::string & Label, cms::Message * TheMessage )
-{
-	TheMessage->setShortProperty( Label, TheValue );
-}
-
-// String specialisation
-
-template<>
-void Message::Value< std::string >::StoreProperty( 
-	const std::string & Label, cms::Message * TheMessage )
-{
-	TheMessage->setStringProperty( Label, TheValue );
-}
-
 }      // End of name space Active MQ
 #endif // THERON_ACTIVE_MESSAGE_QUEUE
@@ -0,0 +1,349 @@
+/*=============================================================================
+  Binary Payload
+
+  The serialised messages are normally human readable text strings, which is
+  necessary when the messages are exchanged with agents that are not actors,
+  for instance a task manager connected over XMPP. However, formatting and
+  parsing numbers, in particular real numbers, as text is costly, and text
+  coding of a double may also lose precision. When both peers are actors on
+  Theron++ endpoints the messages can be more compactly encoded in a binary
+  format.
+
+  The binary payload is still stored in a serial message payload string, but
+  it starts with a zero byte that can never be the first character of a text
+  message. Then follows the format version and a tag identifying the message
+  type, like the command word of the text messages. The fields of the message
+  are then written one after the other in little-endian byte order with the
+  size of their type, and strings are prefixed with their length. The format
+  is therefore independent of the byte order of the endpoints, but it assumes
+  that the peers use the same size for the standard types, which is the case
+  for all current platforms.
+
+  The writer is used as an output stream:
+
+  	BinaryWriter Message( "SCHEDULE" );
+  	Message << EarliestStart << LatestStart << Duration << Energy;
+  	return Message.str();
+
+  and the reader as an input stream where the message is accepted if the tag
+  is right and all fields could be read:
+
+  	BinaryReader Message( Payload, "SCHEDULE" );
+  	Message >> EarliestStart >> LatestStart >> Duration >> Energy;
+  	return static_cast< bool >( Message );
+
+  The version is increased if the encoding changes, and a message type may
+  add fields at the end and test the version of the reader before reading
+  them.
+
+  Author and Copyright: Geir Horn, 2019
+  License: LGPL 3.0
+=============================================================================*/
+
+#ifndef THERON_BINARY_PAYLOAD
+#define THERON_BINARY_PAYLOAD
+
+#include <string>										// Payloads and strings
+#include <cstdint>									// Fixed size integers
+#include <cstring>									// Copying floating point bits
+#include <type_traits>							// Testing field types
+
+#include "SerialMessage.hpp"				// The payload type
+
+namespace Theron
+{
+
+// ---------------------------------------------------------------------------
+// Format constants
+// ---------------------------------------------------------------------------
+
+namespace BinaryFormat
+{
+	constexpr char 				 Marker  = '\0';
+	constexpr unsigned char Version = 1;
+}
+
+/*=============================================================================
+
+ Writer
+
+=============================================================================*/
+
+class BinaryWriter
+{
+private:
+
+	SerialMessage::Payload Buffer;
+
+	// Unsigned values are written byte by byte starting with the least
+	// significant byte, and all other types are converted to unsigned values.
+
+	template< class UnsignedType >
+	inline void WriteBytes( UnsignedType Value )
+	{
+		for ( std::size_t Byte = 0; Byte < sizeof( UnsignedType ); Byte++ )
+		{
+			Buffer.push_back( static_cast< char >( Value & 0xFF ) );
+			Value >>= 8;
+		}
+	}
+
+public:
+
+	// Boolean values are written as a single byte and enumerations as their
+	// underlying type.
+
+	inline BinaryWriter & operator << ( bool Value )
+	{
+		Buffer.push_back( Value ? 1 : 0 );
+		return *this;
+	}
+
+	template< class FieldType,
+						std::enable_if_t< std::is_integral< FieldType >::value,
+															int > = 0 >
+	inline BinaryWriter & operator << ( FieldType Value )
+	{
+		WriteBytes( static_cast< std::make_unsigned_t< FieldType > >( Value ) );
+		return *this;
+	}
+
+	template< class FieldType,
+						std::enable_if_t< std::is_enum< FieldType >::value, int > = 0 >
+	inline BinaryWriter & operator << ( FieldType Value )
+	{
+		return operator << (
+					 static_cast< std::underlying_type_t< FieldType > >( Value ) );
+	}
+
+	// Floating point values are written as the bits of their IEEE 754
+	// representation.
+
+	inline BinaryWriter & operator << ( double Value )
+	{
+		static_assert( sizeof( double ) == sizeof( std::uint64_t ),
+									 "The binary payload requires 64 bit doubles" );
+
+		std::uint64_t Bits;
+
+		std::memcpy( &Bits, &Value, sizeof( Bits ) );
+		WriteBytes( Bits );
+		return *this;
+	}
+
+	inline BinaryWriter & operator << ( float Value )
+	{
+		std::uint32_t Bits;
+
+		std::memcpy( &Bits, &Value, sizeof( Bits ) );
+		WriteBytes( Bits );
+		return *this;
+	}
+
+	// Strings are written with a 32 bit length followed by the characters
+
+	inline BinaryWriter & operator << ( const std::string & Value )
+	{
+		WriteBytes( static_cast< std::uint32_t >( Value.size() ) );
+		Buffer.append( Value );
+		return *this;
+	}
+
+	inline BinaryWriter & operator << ( const char * Value )
+	{
+		return operator << ( std::string( Value ) );
+	}
+
+	// The payload is returned as for an output string stream
+
+	inline SerialMessage::Payload str( void ) const
+	{
+		return Buffer;
+	}
+
+	// The constructor writes the marker, the version and the tag of the message
+
+	BinaryWriter( const std::string & Tag )
+	: Buffer()
+	{
+		Buffer.reserve( 32 + Tag.size() );
+		Buffer.push_back( BinaryFormat::Marker );
+		Buffer.push_back( static_cast< char >( BinaryFormat::Version ) );
+		operator << ( Tag );
+	}
+};
+
+/*=============================================================================
+
+ Reader
+
+=============================================================================*/
+//
+// The reader fails if the payload is not binary, if the version is newer than
+// the version known, if the tag is different from the expected tag, or if
+// there are not enough bytes left for a field. A failed reader does not change
+// the fields it is asked to read.
+
+class BinaryReader
+{
+private:
+
+	const SerialMessage::Payload & Buffer;
+	std::size_t 									 Position;
+	unsigned char 								 PayloadVersion;
+	bool 													 Failed;
+
+	template< class UnsignedType >
+	inline bool ReadBytes( UnsignedType & Value )
+	{
+		if ( Failed || ( Buffer.size() - Position < sizeof( UnsignedType ) ) )
+		{
+			Failed = true;
+			return false;
+		}
+
+		Value = 0;
+
+		for ( std::size_t Byte = 0; Byte < sizeof( UnsignedType ); Byte++ )
+			Value |= static_cast< UnsignedType >(
+							 static_cast< unsigned char >( Buffer[ Position + Byte ] ) )
+							 << ( 8 * Byte );
+
+		Position += sizeof( UnsignedType );
+		return true;
+	}
+
+public:
+
+	inline BinaryReader & operator >> ( bool & Value )
+	{
+		std::uint8_t Byte;
+
+		if ( ReadBytes( Byte ) ) Value = ( Byte != 0 );
+		return *this;
+	}
+
+	template< class FieldType,
+						std::enable_if_t< std::is_integral< FieldType >::value,
+															int > = 0 >
+	inline BinaryReader & operator >> ( FieldType & Value )
+	{
+		std::make_unsigned_t< FieldType > Bits;
+
+		if ( ReadBytes( Bits ) ) Value = static_cast< FieldType >( Bits );
+		return *this;
+	}
+
+	template< class FieldType,
+						std::enable_if_t< std::is_enum< FieldType >::value, int > = 0 >
+	inline BinaryReader & operator >> ( FieldType & Value )
+	{
+		std::underlying_type_t< FieldType > Underlying;
+
+		if ( operator >> ( Underlying ) )
+			Value = static_cast< FieldType >( Underlying );
+
+		return *this;
+	}
+
+	inline BinaryReader & operator >> ( double & Value )
+	{
+		std::uint64_t Bits;
+
+		if ( ReadBytes( Bits ) ) std::memcpy( &Value, &Bits, sizeof( Value ) );
+		return *this;
+	}
+
+	inline BinaryReader & operator >> ( float & Value )
+	{
+		std::uint32_t Bits;
+
+		if ( ReadBytes( Bits ) ) std::memcpy( &Value, &Bits, sizeof( Value ) );
+		return *this;
+	}
+
+	inline BinaryReader & operator >> ( std::string & Value )
+	{
+		std::uint32_t Length;
+
+		if ( ReadBytes( Length ) )
+		{
+			if ( Buffer.size() - Position < Length )
+				Failed = true;
+			else
+			{
+				Value.assign( Buffer, Position, Length );
+				Position += Length;
+			}
+		}
+
+		return *this;
+	}
+
+	// The status of the reader is tested as for input streams, and there is
+	// also a test to see if all the payload has been read.
+
+	explicit inline operator bool ( void ) const
+	{ return !Failed; }
+
+	inline bool AtEnd( void ) const
+	{ return Position == Buffer.size(); }
+
+	// The version of the payload can be used to read fields added in later
+	// versions of a message.
+
+	inline unsigned char Version( void ) const
+	{ return PayloadVersion; }
+
+	// The constructor reads the header and checks the tag. Note that the reader
+	// keeps a reference to the payload, which must therefore exist for as long
+	// as the reader is used.
+
+	BinaryReader( const SerialMessage::Payload & Payload,
+								const std::string & ExpectedTag )
+	: Buffer( Payload ), Position( 2 ), PayloadVersion( 0 ), Failed( true )
+	{
+		if ( SerialMessage::IsBinary( Payload ) && ( Payload.size() >= 2 ) )
+		{
+			PayloadVersion = static_cast< unsigned char >( Payload[1] );
+
+			if ( PayloadVersion <= BinaryFormat::Version )
+			{
+				std::string Tag;
+
+				Failed = false;
+				operator >> ( Tag );
+
+				if ( Tag != ExpectedTag ) Failed = true;
+			}
+		}
+	}
+
+	BinaryReader( const BinaryReader & Other ) = delete;
+
+	// The tag of a binary payload can be read without knowing the message
+	// type, and an empty tag is returned if the payload is not binary or if
+	// its header cannot be read.
+
+	static std::string Tag( const SerialMessage::Payload & Payload )
+	{
+		std::uint32_t Length = 0;
+
+		if ( !SerialMessage::IsBinary( Payload ) || ( Payload.size() < 6 ) ||
+				 ( static_cast< unsigned char >( Payload[1] ) > BinaryFormat::Version ) )
+			return std::string();
+
+		for ( std::size_t Byte = 0; Byte < sizeof( Length ); Byte++ )
+			Length |= static_cast< std::uint32_t >(
+								static_cast< unsigned char >( Payload[ 2 + Byte ] ) )
+								<< ( 8 * Byte );
+
+		if ( Payload.size() - 6 < Length )
+			return std::string();
+		else
+			return Payload.substr( 6, Length );
+	}
+};
+
+}					// name space Theron
+#endif  	// THERON_BINARY_PAYLOAD
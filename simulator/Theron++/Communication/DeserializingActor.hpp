@@ -82,6 +82,17 @@ this will therefore be unique to each instance of an actor supporting
 serialisation. Hopefully, the number of messages supported by an actor is 
 not very large, and not too much memory will be wasted by this approach.
 
+Trying the message types one by one means that a payload for the last 
+message type tried pays for failed de-serialisations of all the other types.
+However, every payload starts with a tag identifying its message type: The 
+binary payloads have the tag written by the binary writer, and the text 
+payloads start with the command word of the message. When a payload has been
+de-serialised, its tag is remembered for the message type in a hash table, 
+and the next payload with the same tag is given directly to that message 
+type. The trial de-serialisation is then only needed for the first payload 
+with a given tag, and for payloads without a recognisable tag, for instance 
+from peers that do not start their text messages with a command word.
+
 Author and Copyright: Geir Horn, 2017
 License: LGPL 3.0
 =============================================================================*/
@@ -89,7 +100,13 @@ License: LGPL 3.0
 #ifndef THERON_DESERIALIZING_ACTOR
 #define THERON_DESERIALIZING_ACTOR
 
+#include <string>									// Payload tags
+#include <unordered_map>						// Message types by tag
+#include <optional>									// Tagged message type
+#include <cctype>										// Command word characters
+
 #include "Actor.hpp"							// The Theron++ Actor Framework
+#include "BinaryPayload.hpp"			// Tags of binary payloads
 #include "NetworkEndPoint.hpp"		// Network communication
 #include "SessionLayer.hpp"				// External-internal address mapping
 
@@ -124,6 +141,37 @@ private:
 	// registered, the counters are kept in a parallel map.
 
 	std::map< std::type_index, unsigned int > HandlerCount;
+
+	// The message types are also found by the tags of the payloads they have
+	// de-serialised. The tag of a binary payload is the tag of its header, and 
+	// the tag of a text payload is its first word provided that it is a 
+	// command word of letters, digits and underscores. An empty tag means that
+	// the payload has no tag.
+
+	std::unordered_map< std::string, std::type_index > TaggedTypes;
+
+	static std::string PayloadTag( const SerialMessage::Payload & Payload )
+	{
+		if ( SerialMessage::IsBinary( Payload ) )
+			return BinaryReader::Tag( Payload );
+
+		std::size_t Start = Payload.find_first_not_of( " \t\r\n" );
+
+		if ( Start == std::string::npos ) return std::string();
+
+		std::size_t End = Start;
+
+		while ( ( End < Payload.size() ) && 
+						( std::isalnum( static_cast< unsigned char >( Payload[ End ] ) ) ||
+							( Payload[ End ] == '_' ) ) )
+			End++;
+
+		if ( ( End == Start ) || ( ( End < Payload.size() ) && 
+				 !std::isspace( static_cast< unsigned char >( Payload[ End ] ) ) ) )
+			return std::string();
+		else
+			return Payload.substr( Start, End - Start );
+	}
 	
 	// Messages are registered with a message specific creator function that 
 	// will forward the message to the right message handler provided that 
@@ -155,7 +203,7 @@ private:
 					
 					SerialMessage * NewMessage( &BinaryMessage );
 					
-					if ( NewMessage->Deserialize( Payload ) )
+					if ( NewMessage->Decode( Payload ) )
 					{
 						Send( BinaryMessage, Sender, GetAddress() );
 						return true;
@@ -174,10 +222,12 @@ private:
 			HandlerCount[ typeid( MessageType ) ]++;			
 	}
 	
-	// Processing an incoming serial payload is then simply trying to construct 
-	// the messages until one message type is successfully constructed. If no
-	// messages are registered or if the end of the message type map is reached
-	// with no successful construction, a runtime error is thrown.
+	// Processing an incoming serial payload first tries the message type known
+	// for the tag of the payload, if any, and then the other message types 
+	// until one message type is successfully constructed. The message type 
+	// constructed is remembered for the tag. If no messages are registered or 
+	// if the end of the message type map is reached with no successful 
+	// construction, a runtime error is thrown.
 	
   void SerialialMessageHandler (
 		   const Theron::SerialMessage::Payload & Payload, 
@@ -196,12 +246,35 @@ private:
 		}
 		else
 		{
+			std::string 										 Tag( PayloadTag( Payload ) );
+			std::optional< std::type_index > TaggedType;
+			
+			if ( !Tag.empty() )
+			{
+				auto Known = TaggedTypes.find( Tag );
+				
+				if ( Known != TaggedTypes.end() )
+				{
+					TaggedType = Known->second;
+					
+					auto Creator = MessageTypes.find( *TaggedType );
+					
+					if ( ( Creator != MessageTypes.end() ) && 
+							 Creator->second( Payload, Sender ) )
+						return;
+				}
+			}
+			
 			auto MessageCandidate = MessageTypes.begin();
 			
 			while ( ( MessageCandidate != MessageTypes.end() ) &&
-							( MessageCandidate->second( Payload, Sender ) != true )	)
+							( ( TaggedType && ( MessageCandidate->first == *TaggedType ) ) ||
+							  ( MessageCandidate->second( Payload, Sender ) != true ) ) )
 				++MessageCandidate;
 			
+			if ( !Tag.empty() && ( MessageCandidate != MessageTypes.end() ) )
+				TaggedTypes.insert_or_assign( Tag, MessageCandidate->first );
+			
 			// If the payload did not correspond to any of the available messages,
 			// an exception will be thrown as this situation should not occur. 
 			
@@ -260,7 +333,15 @@ protected:
 		
 		if ( ReturnValue )
 			if ( --( HandlerCount[ typeid ( MessageType ) ] ) == 0 )
-				 MessageTypes.erase( typeid( MessageType ) );
+			{
+				MessageTypes.erase( typeid( MessageType ) );
+				
+				for ( auto Tagged = TaggedTypes.begin(); Tagged != TaggedTypes.end(); )
+					if ( Tagged->second == typeid( MessageType ) )
+						Tagged = TaggedTypes.erase( Tagged );
+					else
+						++Tagged;
+			}
 			
 		return ReturnValue;
 	}
@@ -309,6 +390,25 @@ protected:
 			return false;
 	}
 	
+	// An actor with an external presence that is renamed must also change its 
+	// registration with the session layer. The old name is de-registered while
+	// the actor still has the old address as the sender, and the new name is 
+	// registered afterwards.
+	
+	virtual void Rename( const std::string & NewName ) override
+	{
+		if ( NewName == GetAddress().AsString() ) return;
+		
+		Address SessionLayerAddress( 
+						Network::GetAddress( Network::Layer::Session ) );
+		
+		if ( SessionLayerAddress )
+			Send( SessionLayerMessages::RemoveActorCommand(), SessionLayerAddress );
+		
+		Actor::Rename( NewName );
+		RegisterWithSessionLayer();
+	}
+	
   // The constructor is defined in the code file because it will register the 
   // actor with the session layer to create an external presence for this actor.
   // The philosophy is that in order to be able to participate in network 
@@ -0,0 +1,211 @@
+/*=============================================================================
+  In-process network
+
+  When a distributed actor system is simulated, for instance the households of
+  a CoSSMic neighbourhood, all the actors are hosted by the same process and
+  there is no need to send the messages over a real network. Messages between
+  actors whose addresses are known to be local are already delivered directly
+  by the actor framework, but actors that address each other by name before
+  the other actor has been created, or that are written to communicate with
+  remote actors, will still have their messages forwarded to the presentation
+  layer, the session layer and the network layer server. With a real network
+  technology the payload is then written to a socket and read back by the
+  same process.
+
+  The in-process network implements the network layer of the transparent
+  communication stack without any transport. The external address of an actor
+  is the actor name qualified with the domain of the endpoint, like
+  "actor@domain", and the network layer resolves any actor to this address.
+  An outbound message is handed back to the session layer as an inbound
+  message with the same sender and receiver and the same shared payload, so
+  the payload is never copied and no bytes are written anywhere. The session
+  layer's address mapping, its message cache for unresolved actors, and the
+  presentation layer's serialisation format negotiation work as for the other
+  network technologies, and an application can therefore be moved between the
+  in-process network and a real network without changes to the actors.
+
+  The network endpoint is created as for the other technologies:
+
+  	Theron::NetworkEndPoint< Theron::InProcess::Network >
+  		Household( "Household", "Simulation" );
+
+  Note that there can be only one network endpoint in a process since the
+  layer servers are static members of the network class. Co-located endpoints
+  can therefore not be distinguished, and all actors of the process share the
+  same domain.
+
+  Author and Copyright: Geir Horn, 2019
+  License: LGPL 3.0
+=============================================================================*/
+
+#ifndef THERON_IN_PROCESS_NETWORK
+#define THERON_IN_PROCESS_NETWORK
+
+#include <string>										// External addresses
+
+#include "Actor.hpp"								// The Theron++ actor framework
+#include "StandardFallbackHandler.hpp"
+#include "NetworkEndPoint.hpp"			// The network definition
+#include "LinkMessage.hpp"					// The link message format
+#include "NetworkLayer.hpp"					// The network layer server
+#include "SessionLayer.hpp"					// The session layer server
+#include "PresentationLayer.hpp"		// The presentation layer server
+
+namespace Theron::InProcess
+{
+
+/*=============================================================================
+
+ In-process message
+
+=============================================================================*/
+//
+// The external addresses are strings of the form "actor@domain", and the
+// actor address is the part before the separator. An address without a
+// separator is taken to be the actor name.
+
+class InProcessMessage : public LinkMessage< std::string >
+{
+public:
+
+	static constexpr char Separator = '@';
+
+	virtual Address ActorAddress( const std::string & ExternalActor ) const override
+	{
+		return Address( ExternalActor.substr( 0,
+																					ExternalActor.find( Separator ) ) );
+	}
+
+	InProcessMessage( const std::string & From, const std::string & To,
+					 const SerialMessage::SharedPayload & ThePayload )
+	: LinkMessage< std::string >( From, To, ThePayload )
+	{}
+
+	InProcessMessage( const InProcessMessage & Other ) = default;
+
+	virtual ~InProcessMessage( void )
+	{}
+};
+
+/*=============================================================================
+
+ Network layer
+
+=============================================================================*/
+//
+// The network layer resolves actors to their qualified names, and returns
+// all outbound messages to the session layer. An actor can only be resolved
+// when it exists in this process, and a request for an actor that has not
+// yet been created is therefore not answered. The session layer will then
+// cache the messages for the actor as it does while waiting for a remote
+// endpoint to respond, and the actor's registration with the session layer
+// when it is created produces a new resolution request whose response will
+// release the cached messages. Removed actors have no state to clean since
+// the external address can always be computed from the actor name.
+
+class NetworkLayer
+: virtual public Actor,
+  virtual public StandardFallbackHandler,
+  public Theron::NetworkLayer< InProcessMessage >
+{
+private:
+
+	const std::string Domain;
+
+protected:
+
+	virtual void ResolveAddress( const ResolutionRequest & TheRequest,
+														   const Address TheSessionLayer ) override
+  {
+		if ( TheRequest.NewActor.IsLocalActor() )
+			Send( ResolutionResponse(
+						TheRequest.NewActor.AsString() + InProcessMessage::Separator + Domain,
+						TheRequest.NewActor ), TheSessionLayer );
+	}
+
+  virtual void ActorRemoval( const RemoveActor & TheCommand,
+														 const Address TheSessionLayer ) override
+  { }
+
+	// The message is forwarded as it is. The message object holds a shared
+	// pointer to the payload, and only this pointer is copied.
+
+  virtual void OutboundMessage( const InProcessMessage & TheMessage,
+																const Address TheSessionLayer ) override
+	{
+		Send( TheMessage, TheSessionLayer );
+	}
+
+public:
+
+	NetworkLayer( const std::string & TheDomain,
+								const std::string & ServerName = "NetworkLayerServer" )
+	: Actor( ServerName ),
+	  StandardFallbackHandler( Actor::GetAddress().AsString() ),
+	  Theron::NetworkLayer< InProcessMessage >( Actor::GetAddress().AsString() ),
+	  Domain( TheDomain )
+	{ }
+
+	NetworkLayer( void ) = delete;
+
+	virtual ~NetworkLayer( void )
+	{ }
+};
+
+/*=============================================================================
+
+ Network
+
+=============================================================================*/
+//
+// The network class creates the standard session layer and presentation layer
+// for the in-process messages, and the network layer for the domain of the
+// endpoint. The preferred serialisation format can be given to the
+// presentation layer, and binary payloads will be used for all messages an
+// actor sends after the first when both ends, i.e. this process, support it.
+// There is nothing to close on shut down.
+
+class Network
+: virtual public Actor,
+  public Theron::Network
+{
+private:
+
+	const SerialMessage::Format PreferredFormat;
+
+protected:
+
+	virtual void CreateNetworkLayer( void ) override
+	{
+		CreateServer< Layer::Network, InProcess::NetworkLayer >( Domain );
+	}
+
+	virtual void CreateSessionLayer( void ) override
+	{
+	  CreateServer< Layer::Session, SessionLayer< InProcessMessage > >();
+	}
+
+	virtual void CreatePresentationLayer( void ) override
+	{
+		CreateServer< Layer::Presentation, PresentationLayer >(
+									"PresentationLayer", PreferredFormat );
+	}
+
+	virtual void StartShutDown( const Network::ShutDownMessage & TheMessage,
+													    const Address Sender ) override
+	{ }
+
+	Network( const std::string & Name, const std::string & Location,
+					 SerialMessage::Format Preferred = SerialMessage::Format::Text )
+	: Actor( Name ), Theron::Network( Name, Location ),
+	  PreferredFormat( Preferred )
+	{	}
+
+public:
+
+	virtual ~Network( void )
+	{ }
+};
+
+}					// name space Theron::InProcess
+#endif 		// THERON_IN_PROCESS_NETWORK
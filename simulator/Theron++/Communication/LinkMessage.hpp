@@ -44,7 +44,7 @@ protected:
 	// for derived messages. 
 	
 	const ExternalAddress        SenderAddress, ReceiverAddress;
-	const SerialMessage::Payload Payload;
+	const SerialMessage::SharedPayload Payload;
 	
 public:
   
@@ -52,7 +52,13 @@ public:
 
   // One should be able to obtain the payload string of the message.
   
-  inline SerialMessage::Payload GetPayload( void ) const
+  inline const SerialMessage::Payload & GetPayload( void ) const
+  { return Payload; }
+
+  // The shared payload is used to pass the payload on to other messages 
+  // without copying it.
+
+  inline const SerialMessage::SharedPayload & GetSharedPayload( void ) const
   { return Payload; }
   
   // There are similar functions to obtain or set the sender and the receiver of 
@@ -80,7 +86,7 @@ public:
 	// and the payload and initialises the various fields accordingly.
 	
 	LinkMessage( const ExternalAddress & From, const ExternalAddress & To, 
-							 const SerialMessage::Payload ThePayload )
+							 const SerialMessage::SharedPayload & ThePayload )
 	: SenderAddress( From ), ReceiverAddress( To ), Payload( ThePayload )
 	{ }
 	
@@ -0,0 +1,235 @@
+/*=============================================================================
+Message Batching
+
+A link server sending bursts of many small messages to the same peer pays the
+per message cost of the network library for every message. The messages can
+instead be coalesced into batches that are sent as one network message. The
+batching must not delay a message more than a given maximal delay, and it
+should not delay the last message of a burst at all if there is nothing else
+to wait for.
+
+The message batching is a virtual actor base class keeping the messages
+pending per peer. A batch is sent when its payload reaches the size limit,
+when its oldest message has waited for the maximal delay, or when there are
+no other messages in the queue of the actor. The batching is therefore
+adaptive since a message will not be delayed if there are no other messages
+waiting to be handled, and a batch with only one message can be sent as a
+normal message by the derived link. Batching is disabled when the size limit
+is zero, which is the default.
+
+The queue of the actor may hold other messages than those to be batched, like
+address resolutions, when the last message of a burst is added to its batch.
+No later message may then trigger the sending of the batch, and the maximal
+delay is therefore enforced by a time out on the timer wheel service that is
+started when a batch gets its first message. The batch is sent at the first
+tick of the wheel after the delay, so the delay is bounded up to the tick of
+the wheel.
+
+The derived link implements the function sending a batch to a peer, and it
+should send the pending batches when it closes, since the batches cannot be
+sent by the destructor of this base class after the link has been destroyed.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+=============================================================================*/
+
+#ifndef THERON_MESSAGE_BATCHING
+#define THERON_MESSAGE_BATCHING
+
+#include <string>												// Actor names
+#include <vector>												// Messages pending in a batch
+#include <map>													// Batches per peer
+#include <chrono>												// Batching delay
+
+#include "Actor.hpp"										// The Theron++ actor framework
+#include "TimerWheel.hpp"								// Enforcing the delay
+
+namespace Theron
+{
+
+template< class PeerType, class MessageType >
+class MessageBatching : virtual public Actor
+{
+private:
+
+	class PendingBatch
+	{
+	public:
+
+		std::vector< MessageType > 						 Messages;
+		std::size_t 													 Bytes;
+		std::chrono::steady_clock::time_point Oldest;
+
+		PendingBatch( void )
+		: Messages(), Bytes(0), Oldest()
+		{}
+	};
+
+	std::map< PeerType, PendingBatch > PendingBatches;
+	std::size_t 											 BatchSize;
+	std::chrono::microseconds 				 BatchDelay;
+	TimerWheel::TimerID 							 BatchTimer;
+
+	// The time out is set to expire when the oldest pending batch has waited
+	// for the maximal delay. A time out already running is left as it is since
+	// it cannot be later than the one needed for the oldest batch, and if it
+	// expires before that batch is due, the time out handler will start it
+	// again. The time out is cancelled when there are no pending batches.
+
+	class BatchTimeOut
+	{};
+
+	void StartBatchTimer( void )
+	{
+		bool 																	Pending = false;
+		std::chrono::steady_clock::time_point Oldest;
+
+		for ( auto & Batch : PendingBatches )
+			if ( !Batch.second.Messages.empty() &&
+					 ( !Pending || ( Batch.second.Oldest < Oldest ) ) )
+			{
+				Oldest  = Batch.second.Oldest;
+				Pending = true;
+			}
+
+		if ( !Pending )
+		{
+			if ( BatchTimer != TimerWheel::NullTimer )
+			{
+				TimerWheel::Service().Cancel( BatchTimer );
+				BatchTimer = TimerWheel::NullTimer;
+			}
+		}
+		else if ( BatchTimer == TimerWheel::NullTimer )
+			BatchTimer = TimerWheel::Service().ScheduleMessage(
+				std::chrono::duration_cast< TimerWheel::Duration >(
+					Oldest + BatchDelay - std::chrono::steady_clock::now() ),
+				BatchTimeOut(), GetAddress(), GetAddress() );
+	}
+
+	// The time out sends the expired batches and starts the time out for the
+	// remaining batches.
+
+	void FlushOnTimeOut( const BatchTimeOut & TheTimeOut,
+											 const Address TheTimer )
+	{
+		BatchTimer = TimerWheel::NullTimer;
+
+		FlushExpiredBatches();
+		StartBatchTimer();
+	}
+
+protected:
+
+	// The derived link sends the messages of a batch to the peer. The batch
+	// has at least one message.
+
+	virtual void SendBatch( const PeerType & Peer,
+													const std::vector< MessageType > & Messages ) = 0;
+
+	inline bool BatchingEnabled( void ) const
+	{ return BatchSize > 0; }
+
+	// A message is added to the batch of its peer with the size of its payload,
+	// and the batch is sent if it has reached the size limit. Batches that have
+	// waited longer than the maximal delay are then sent, and if this is the
+	// last message in the queue of the actor all batches are sent since there
+	// is nothing more to wait for.
+
+	void QueueMessage( const PeerType & Peer, const MessageType & TheMessage,
+										 std::size_t Bytes )
+	{
+		PendingBatch & Batch( PendingBatches[ Peer ] );
+
+		if ( Batch.Messages.empty() )
+			Batch.Oldest = std::chrono::steady_clock::now();
+
+		Batch.Messages.push_back( TheMessage );
+		Batch.Bytes += Bytes;
+
+		if ( Batch.Bytes >= BatchSize )
+			FlushBatch( Peer );
+
+		if ( GetNumQueuedMessages() <= 1 )
+			FlushAllBatches();
+		else
+			FlushExpiredBatches();
+
+		StartBatchTimer();
+	}
+
+	// The pending batch of one peer can be sent, for instance to preserve the
+	// order of the messages if another message is sent directly to the peer,
+	// and there are functions to send the batches that have waited too long,
+	// or all the pending batches.
+
+	void FlushBatch( const PeerType & Peer )
+	{
+		auto Pending = PendingBatches.find( Peer );
+
+		if ( ( Pending == PendingBatches.end() ) ||
+				 Pending->second.Messages.empty() )
+			return;
+
+		SendBatch( Peer, Pending->second.Messages );
+
+		Pending->second.Messages.clear();
+		Pending->second.Bytes = 0;
+	}
+
+	void FlushExpiredBatches( void )
+	{
+		auto Deadline = std::chrono::steady_clock::now() - BatchDelay;
+
+		for ( auto & Pending : PendingBatches )
+			if ( !Pending.second.Messages.empty() &&
+					 ( Pending.second.Oldest <= Deadline ) )
+				FlushBatch( Pending.first );
+	}
+
+	void FlushAllBatches( void )
+	{
+		for ( auto & Pending : PendingBatches )
+			FlushBatch( Pending.first );
+	}
+
+public:
+
+	// The batching is controlled by setting the maximal payload size of a batch
+	// in bytes and the maximal delay of a message. Changing the parameters
+	// sends the pending batches so that no message is held back by a limit
+	// that no longer applies, and setting the size to zero disables batching.
+
+	void SetBatching( std::size_t MaxBytes,
+									  std::chrono::microseconds MaxDelay
+										  = std::chrono::microseconds( 500 ) )
+	{
+		FlushAllBatches();
+		StartBatchTimer();
+
+		BatchSize  = MaxBytes;
+		BatchDelay = MaxDelay;
+	}
+
+	// The constructor registers the handler for the time out, and the
+	// destructor cancels the time out so that it does not send a message to
+	// the closed actor.
+
+	MessageBatching( const std::string & ActorName = std::string() )
+	: Actor( ActorName ), PendingBatches(), BatchSize(0),
+	  BatchDelay( std::chrono::microseconds( 500 ) ),
+	  BatchTimer( TimerWheel::NullTimer )
+	{
+		RegisterHandler( this, &MessageBatching::FlushOnTimeOut );
+	}
+
+	MessageBatching( const MessageBatching & Other ) = delete;
+
+	virtual ~MessageBatching( void )
+	{
+		TimerWheel::Service().Cancel( BatchTimer );
+	}
+};
+
+}      // End name space Theron
+#endif // THERON_MESSAGE_BATCHING
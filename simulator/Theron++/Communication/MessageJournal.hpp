@@ -0,0 +1,423 @@
+/*=============================================================================
+  Message Journal
+
+  The performance of a distributed system depends on the timing of the
+  messages arriving from the remote endpoints, and a problem seen in a
+  deployment can rarely be reproduced since the same messages will not arrive
+  in the same order at the same times again. The journal records the messages
+  received by the Presentation Layer from remote actors, i.e. the serialised
+  payload, the sender, the receiver and the time of arrival, so that the
+  workload of an endpoint can later be replayed in a single process where it
+  can be profiled.
+
+  The journal is a binary file consisting of frames. Each frame has a 32 bit
+  little-endian length followed by a binary payload as written by the binary
+  writer. The first frame is the header with the wall clock time the journal
+  was started. The actor names are long and repeated for every message, and
+  each name is therefore written only once in a definition frame assigning a
+  number to the name, and the messages refer to the sender and receiver by
+  their numbers. A message frame holds the time in nanoseconds since the start
+  of the journal, the numbers of the sender and the receiver, and the payload.
+  The frames are collected in a buffer that is written to the file when it is
+  full and when the journal is closed, so that recording only costs a copy of
+  the payload for each inbound message.
+
+  The replay reads the journal and sends each payload to the receiver as if
+  it came from the recorded sender, at the recorded time relative to the
+  start of the replay divided by a speed-up factor. A speed-up of two replays
+  the messages twice as fast as they arrived, and a speed-up of zero sends
+  them as fast as possible. The receivers must be created by the replaying
+  process with the same names as in the recorded run, and messages to actors
+  that do not exist when the message is due are counted as undelivered. The
+  local actors will respond to the recorded senders, and these responses go
+  to the Presentation Layer if the replaying process has a network endpoint,
+  otherwise they will fail in the sending actor. A single process replay
+  should therefore create actors for the remote senders whose responses
+  matter, or ignore the responses.
+
+  Note that only the messages received from remote actors are recorded. The
+  messages exchanged between the actors of the endpoint are consequences of
+  these and will be produced again by the replay.
+
+  Author and Copyright: Geir Horn, 2019
+  License: LGPL 3.0
+=============================================================================*/
+
+#ifndef THERON_MESSAGE_JOURNAL
+#define THERON_MESSAGE_JOURNAL
+
+#include <string>										// Names and payloads
+#include <vector>										// The names of the replay
+#include <unordered_map>						// The numbers of the recorded names
+#include <fstream>									// The journal file
+#include <sstream>									// For nicely formatted errors
+#include <stdexcept>								// Standard exceptions
+#include <mutex>										// Serialising the recording
+#include <chrono>										// Time stamps and pacing
+#include <thread>										// Sleeping until the next message
+#include <cstdint>									// Fixed size integers
+
+#include "Actor.hpp"								// Sending the replayed messages
+#include "SerialMessage.hpp"				// The payload type
+#include "BinaryPayload.hpp"				// The frame format
+
+namespace Theron
+{
+
+class MessageJournal
+{
+	// ---------------------------------------------------------------------------
+	// Frame format
+	// ---------------------------------------------------------------------------
+	//
+	// The tags identify the three types of frames, and the version of the
+	// journal is stored in the header so that the format can be extended.
+
+	static constexpr const char * HeaderTag 		= "THERON_JOURNAL";
+	static constexpr const char * NameTag 			= "A";
+	static constexpr const char * MessageTag 		= "M";
+	static constexpr std::uint8_t JournalVersion = 1;
+
+	using NameNumber = std::uint32_t;
+
+	/*===========================================================================
+
+	 Writer
+
+	===========================================================================*/
+
+public:
+
+	class Writer
+	{
+	private:
+
+		std::ofstream 												 File;
+		std::string 													 Buffer;
+		std::unordered_map< std::string, NameNumber > Names;
+		std::chrono::steady_clock::time_point 		 Start;
+		std::mutex 														 Lock;
+
+		static constexpr std::size_t BufferSize = 1 << 16;
+
+		// A frame is appended to the buffer with its length, and the buffer is
+		// written to the file if it is full.
+
+		void AppendFrame( const SerialMessage::Payload & Frame )
+		{
+			std::uint32_t Length = static_cast< std::uint32_t >( Frame.size() );
+
+			for ( int Byte = 0; Byte < 4; Byte++ )
+			{
+				Buffer.push_back( static_cast< char >( Length & 0xFF ) );
+				Length >>= 8;
+			}
+
+			Buffer.append( Frame );
+
+			if ( Buffer.size() >= BufferSize )
+				Flush();
+		}
+
+		void Flush( void )
+		{
+			File.write( Buffer.data(), Buffer.size() );
+			Buffer.clear();
+		}
+
+		// The number of a name is looked up, and a new name is defined before it
+		// is used.
+
+		NameNumber Number( const std::string & Name )
+		{
+			auto Known = Names.find( Name );
+
+			if ( Known != Names.end() )
+				return Known->second;
+
+			NameNumber NewNumber = static_cast< NameNumber >( Names.size() );
+			BinaryWriter Definition( NameTag );
+
+			Definition << NewNumber << Name;
+			AppendFrame( Definition.str() );
+			Names.emplace( Name, NewNumber );
+
+			return NewNumber;
+		}
+
+	public:
+
+		// Recording a message can be done from any thread
+
+		void Write( const Actor::Address & Sender,
+							  const Actor::Address & Receiver,
+							  const SerialMessage::Payload & Payload )
+		{
+			std::uint64_t Offset = std::chrono::duration_cast<
+				std::chrono::nanoseconds >(
+					std::chrono::steady_clock::now() - Start ).count();
+
+			std::lock_guard< std::mutex > Guard( Lock );
+
+			NameNumber From = Number( Sender.AsString() ),
+								 To   = Number( Receiver.AsString() );
+
+			BinaryWriter Record( MessageTag );
+
+			Record << Offset << From << To << Payload;
+			AppendFrame( Record.str() );
+		}
+
+		// The constructor opens the file and writes the header. An invalid
+		// argument exception is thrown if the file cannot be opened.
+
+		Writer( const std::string & FileName )
+		: File( FileName, std::ios::binary | std::ios::trunc ), Buffer(),
+		  Names(), Start( std::chrono::steady_clock::now() ), Lock()
+		{
+			if ( !File )
+			{
+				std::ostringstream ErrorMessage;
+
+				ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+										 << "The message journal " << FileName
+										 << " could not be opened for writing";
+
+				throw std::invalid_argument( ErrorMessage.str() );
+			}
+
+			Buffer.reserve( 2 * BufferSize );
+
+			BinaryWriter Header( HeaderTag );
+
+			Header << JournalVersion
+						 << static_cast< std::int64_t >( std::chrono::duration_cast<
+										std::chrono::nanoseconds >(
+										std::chrono::system_clock::now().time_since_epoch()
+									).count() );
+
+			AppendFrame( Header.str() );
+		}
+
+		Writer( void ) = delete;
+		Writer( const Writer & Other ) = delete;
+
+		~Writer( void )
+		{
+			std::lock_guard< std::mutex > Guard( Lock );
+			Flush();
+		}
+	};
+
+	/*===========================================================================
+
+	 Reader
+
+	===========================================================================*/
+	//
+	// The reader returns the recorded messages one by one with the names of
+	// the sender and the receiver. The definitions of the names are consumed
+	// by the reader. A logic error exception is thrown if the journal is
+	// malformed, whereas a journal that ends in the middle of a frame, as it
+	// will if the recording process was killed, is taken to end at the last
+	// complete frame.
+
+	class Record
+	{
+	public:
+
+		std::chrono::nanoseconds Offset;
+		std::string 						 Sender, Receiver;
+		SerialMessage::Payload 	 Payload;
+	};
+
+	class Reader
+	{
+	private:
+
+		std::ifstream 													File;
+		std::vector< std::string > 							Names;
+		std::chrono::system_clock::time_point 	Started;
+
+		// A frame is read into the given payload, and false is returned at the
+		// end of the file.
+
+		bool ReadFrame( SerialMessage::Payload & Frame )
+		{
+			unsigned char Bytes[4];
+
+			if ( !File.read( reinterpret_cast< char * >( Bytes ), 4 ) )
+				return false;
+
+			std::uint32_t Length = Bytes[0] | ( Bytes[1] << 8 ) |
+									( Bytes[2] << 16 ) | ( std::uint32_t( Bytes[3] ) << 24 );
+
+			Frame.resize( Length );
+
+			return static_cast< bool >( File.read( Frame.data(), Length ) );
+		}
+
+		[[noreturn]] void Malformed( const std::string & Reason )
+		{
+			std::ostringstream ErrorMessage;
+
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "Malformed message journal: " << Reason;
+
+			throw std::logic_error( ErrorMessage.str() );
+		}
+
+	public:
+
+		// The wall clock time the recording was started
+
+		inline std::chrono::system_clock::time_point StartTime( void ) const
+		{ return Started; }
+
+		bool Next( Record & TheRecord )
+		{
+			SerialMessage::Payload Frame;
+
+			while ( ReadFrame( Frame ) )
+				if ( BinaryReader::Tag( Frame ) == NameTag )
+				{
+					BinaryReader Definition( Frame, NameTag );
+					NameNumber 	 Number = 0;
+					std::string  Name;
+
+					Definition >> Number >> Name;
+
+					if ( !Definition || ( Number != Names.size() ) )
+						Malformed( "Invalid name definition" );
+
+					Names.push_back( Name );
+				}
+				else
+				{
+					BinaryReader  Message( Frame, MessageTag );
+					std::uint64_t Offset = 0;
+					NameNumber 		From = 0, To = 0;
+
+					Message >> Offset >> From >> To >> TheRecord.Payload;
+
+					if ( !Message || ( From >= Names.size() ) ||
+							 ( To >= Names.size() ) )
+						Malformed( "Invalid message record" );
+
+					TheRecord.Offset 	 = std::chrono::nanoseconds( Offset );
+					TheRecord.Sender 	 = Names[ From ];
+					TheRecord.Receiver = Names[ To ];
+
+					return true;
+				}
+
+			return false;
+		}
+
+		// The constructor opens the journal and reads the header. An invalid
+		// argument exception is thrown if the file cannot be opened, and a logic
+		// error if it is not a journal of a known version.
+
+		Reader( const std::string & FileName )
+		: File( FileName, std::ios::binary ), Names(), Started()
+		{
+			if ( !File )
+			{
+				std::ostringstream ErrorMessage;
+
+				ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+										 << "The message journal " << FileName
+										 << " could not be opened for reading";
+
+				throw std::invalid_argument( ErrorMessage.str() );
+			}
+
+			SerialMessage::Payload Frame;
+
+			if ( !ReadFrame( Frame ) )
+				Malformed( FileName + " has no header" );
+
+			BinaryReader  Header( Frame, HeaderTag );
+			std::uint8_t 	Version = 0;
+			std::int64_t 	StartTime = 0;
+
+			Header >> Version >> StartTime;
+
+			if ( !Header || ( Version > JournalVersion ) )
+				Malformed( FileName + " is not a message journal of a known version" );
+
+			Started = std::chrono::system_clock::time_point(
+				std::chrono::duration_cast< std::chrono::system_clock::duration >(
+					std::chrono::nanoseconds( StartTime ) ) );
+		}
+
+		Reader( void ) = delete;
+		Reader( const Reader & Other ) = delete;
+	};
+
+	/*===========================================================================
+
+	 Replay
+
+	===========================================================================*/
+	//
+	// The replay sends the recorded payloads from the calling thread, and it
+	// returns when all messages have been sent, which is not the same as when
+	// they have been handled by the receivers. Messages whose receiver does
+	// not exist, or cannot take a serialised payload, are counted as
+	// undelivered.
+
+	class ReplayStatistics
+	{
+	public:
+
+		std::size_t Delivered, Undelivered;
+	};
+
+	static ReplayStatistics Replay( const std::string & FileName,
+																  double Speedup = 1.0 )
+	{
+		if ( Speedup < 0.0 )
+		{
+			std::ostringstream ErrorMessage;
+
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "The replay speed-up cannot be negative and "
+									 << Speedup << " is";
+
+			throw std::invalid_argument( ErrorMessage.str() );
+		}
+
+		Reader 					 Journal( FileName );
+		Record 					 Message;
+		ReplayStatistics Result{ 0, 0 };
+		auto 						 Start = std::chrono::steady_clock::now();
+
+		while ( Journal.Next( Message ) )
+		{
+			if ( Speedup > 0.0 )
+				std::this_thread::sleep_until( Start +
+					std::chrono::duration_cast< std::chrono::steady_clock::duration >(
+						std::chrono::duration< double, std::nano >(
+							Message.Offset.count() / Speedup ) ) );
+
+			try
+			{
+				if ( Actor::Send( Message.Payload, Actor::Address( Message.Sender ),
+													Actor::Address( Message.Receiver ) ) )
+					Result.Delivered++;
+				else
+					Result.Undelivered++;
+			}
+			catch ( std::invalid_argument & Error )
+			{
+				Result.Undelivered++;
+			}
+		}
+
+		return Result;
+	}
+};
+
+} 			// End of name space Theron
+#endif 	// THERON_MESSAGE_JOURNAL
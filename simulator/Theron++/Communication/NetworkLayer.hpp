@@ -34,6 +34,13 @@
 #include <type_traits>
 #include <stdexcept>
 #include <ostream>
+#include <vector>
+#include <unordered_map>
+#include <optional>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
 
 #include "Actor.hpp"
 #include "StandardFallbackHandler.hpp"
@@ -123,14 +130,205 @@ public:
 		ResolutionResponse( void ) = delete;
 	};
 	
+	// Many actors can be resolved by one request, and each of them will be 
+	// answered by a resolution response as if they were requested one by one.
+	
+	class BatchResolutionRequest
+	{
+	public:
+		
+		const std::vector< Address > Actors;
+		
+		BatchResolutionRequest( const std::vector< Address > & TheActors )
+		: Actors( TheActors )
+		{ }
+		
+		BatchResolutionRequest( const BatchResolutionRequest & Other )
+		: Actors( Other.Actors )
+		{ }
+		
+		BatchResolutionRequest( void ) = delete;
+	};
+	
 	// The handler for the resolution request cannot be implemented because it 
 	// depends on the technology used for the link, but it should take a 
 	// resolution request and return a resolution response to the session layer.
+	// A technology able to look up several actors in one network message can 
+	// override the batch resolution, which by default resolves the actors one 
+	// by one. Note that the requests reaching these functions are the ones not
+	// answered by the resolution cache below.
 	
 protected:
 	
 	virtual void ResolveAddress( const ResolutionRequest & TheRequest, 
 														   const Address TheSessionLayer ) = 0;
+	
+	virtual void ResolveAddresses( const std::vector< Address > & TheActors, 
+																 const Address TheSessionLayer )
+	{
+		for ( const Address & TheActor : TheActors )
+			ResolveAddress( ResolutionRequest( TheActor ), TheSessionLayer );
+	}
+	
+	// ---------------------------------------------------------------------------
+	// Resolution cache
+	// ---------------------------------------------------------------------------
+	//
+	// Actors come and go, and a new actor will often be addressed on a remote 
+	// endpoint that has already resolved other actors. The results of the 
+	// resolution of remote actors are therefore cached by actor name for a 
+	// time to live, so that a repeated request is answered directly without 
+	// involving the network. A request for a remote actor that is passed on to 
+	// the technology is recorded as unresolved, and repeated requests for the 
+	// same actor from the same requester are not passed on again before the 
+	// shorter time to live of such negative results has passed. A remote actor
+	// will probably not respond faster to the second request than to the 
+	// first. A request from another requester must still be passed on since 
+	// the response is only returned to the requester. Requests for local 
+	// actors are never cached since they can be resolved without the network.
+	//
+	// The technology must store the external address of a remote actor when it
+	// is resolved, and forget it when the technology learns that the remote 
+	// actor has been removed. The removal of local actors is handled by the 
+	// base class when the session layer asks for the actor to be removed. These
+	// are the same events causing the session layer to notify subscribers that
+	// a peer has been removed. A time to live of zero disables the 
+	// corresponding cache. The technology will typically learn about remote 
+	// actors on the thread of its network library, and the cache is therefore 
+	// protected by a lock.
+
+public:
+	
+	void SetResolutionCache( std::chrono::milliseconds ResolvedTimeToLive, 
+													 std::chrono::milliseconds UnresolvedTimeToLive )
+	{
+		PositiveTimeToLive = ResolvedTimeToLive;
+		NegativeTimeToLive = UnresolvedTimeToLive;
+	}
+	
+private:
+	
+	class CachedResolution
+	{
+	public:
+		
+		std::optional< typename ExternalMessage::AddressType > GlobalAddress;
+		std::chrono::steady_clock::time_point 								 Expiry;
+		std::vector< Address > 																 Requesters;
+	};
+	
+	std::unordered_map< std::string, CachedResolution > ResolutionCache;
+	std::mutex 																					CacheGuard;
+	std::atomic< std::chrono::milliseconds > PositiveTimeToLive, 
+																					 NegativeTimeToLive;
+	
+protected:
+	
+	void StoreResolution( const ResolutionResponse & TheResponse )
+	{
+		std::chrono::milliseconds TimeToLive( PositiveTimeToLive.load() );
+		
+		std::lock_guard< std::mutex > Lock( CacheGuard );
+		
+		if ( TimeToLive.count() > 0 )
+			ResolutionCache.insert_or_assign( TheResponse.TheActor.AsString(), 
+				CachedResolution{ TheResponse.GlobalAddress, 
+													std::chrono::steady_clock::now() + TimeToLive, {} } );
+	}
+	
+	void ForgetResolution( const Address & TheActor )
+	{
+		std::lock_guard< std::mutex > Lock( CacheGuard );
+		ResolutionCache.erase( TheActor.AsString() );
+	}
+	
+	void ForgetResolution( 
+			 const typename ExternalMessage::AddressType & GlobalAddress )
+	{
+		std::lock_guard< std::mutex > Lock( CacheGuard );
+		auto Entry = ResolutionCache.begin();
+		
+		while ( Entry != ResolutionCache.end() )
+			if ( Entry->second.GlobalAddress && 
+					 ( *Entry->second.GlobalAddress == GlobalAddress ) )
+				Entry = ResolutionCache.erase( Entry );
+			else
+				++Entry;
+	}
+	
+private:
+	
+	// The cache is checked for each requested actor, and the function returns 
+	// true if the request has been served from the cache, either by sending 
+	// the cached address or by ignoring a request that is already unresolved. 
+	// An actor that must be resolved by the technology is recorded as 
+	// unresolved.
+	
+	bool CachedRequest( const Address & TheActor, const Address Requester )
+	{
+		if ( TheActor.IsLocalActor() )
+			return false;
+		
+		auto Now   = std::chrono::steady_clock::now();
+		std::unique_lock< std::mutex > Lock( CacheGuard );
+		auto Entry = ResolutionCache.find( TheActor.AsString() );
+		
+		if ( Entry != ResolutionCache.end() )
+		{
+			if ( Now >= Entry->second.Expiry )
+				ResolutionCache.erase( Entry );
+			else if ( Entry->second.GlobalAddress )
+			{
+				ResolutionResponse Response( *Entry->second.GlobalAddress, TheActor );
+				
+				Lock.unlock();
+				Send( Response, Requester );
+				return true;
+			}
+			else
+			{
+				auto & Requesters( Entry->second.Requesters );
+				
+				if ( std::find( Requesters.begin(), Requesters.end(), Requester ) 
+						 != Requesters.end() )
+					return true;
+				
+				Requesters.push_back( Requester );
+				return false;
+			}
+		}
+		
+		std::chrono::milliseconds TimeToLive( NegativeTimeToLive.load() );
+		
+		if ( TimeToLive.count() > 0 )
+			ResolutionCache.emplace( TheActor.AsString(), 
+				CachedResolution{ std::nullopt, Now + TimeToLive, { Requester } } );
+		
+		return false;
+	}
+	
+	// The handlers for the requests first consult the cache, and pass on the 
+	// actors that are not found to the technology.
+	
+	void CheckResolution( const ResolutionRequest & TheRequest, 
+												const Address Requester )
+	{
+		if ( !CachedRequest( TheRequest.NewActor, Requester ) )
+			ResolveAddress( TheRequest, Requester );
+	}
+	
+	void CheckResolutions( const BatchResolutionRequest & TheRequest, 
+												 const Address Requester )
+	{
+		std::vector< Address > Unresolved;
+		
+		for ( const Address & TheActor : TheRequest.Actors )
+			if ( !CachedRequest( TheActor, Requester ) )
+				Unresolved.push_back( TheActor );
+		
+		if ( !Unresolved.empty() )
+			ResolveAddresses( Unresolved, Requester );
+	}
 															 
   // There is also a mechanism to remove a local actor that is previously 
   // registered. The external address should in this case be known, and 
@@ -159,6 +357,17 @@ protected:
 	virtual void ActorRemoval( const RemoveActor & TheCommand, 
 														 const Address TheSessionLayer ) = 0;
 	
+private:
+	
+	void RemoveResolution( const RemoveActor & TheCommand, 
+												 const Address TheSessionLayer )
+	{
+		ForgetResolution( TheCommand.GlobalAddress );
+		ActorRemoval( TheCommand, TheSessionLayer );
+	}
+	
+protected:
+	
 	// ---------------------------------------------------------------------------
 	// Input and output messages
 	// ---------------------------------------------------------------------------
@@ -184,13 +393,18 @@ protected:
 public:
   
 	// The constructor initialises the base classes and registers the the 
-	// outbound message handler.
+	// outbound message handler. By default resolved actors are cached for 
+	// five minutes, and unresolved actors for one second.
 	
 	NetworkLayer( std::string ServerName = "NetworkLayerServer" )
-	: Actor( ServerName ), StandardFallbackHandler( ServerName )
+	: Actor( ServerName ), StandardFallbackHandler( ServerName ),
+	  ResolutionCache(), CacheGuard(),
+	  PositiveTimeToLive( std::chrono::minutes( 5 ) ),
+	  NegativeTimeToLive( std::chrono::seconds( 1 ) )
 	{
-		RegisterHandler( this, &NetworkLayer< ExternalMessage >::ResolveAddress  );
-		RegisterHandler( this, &NetworkLayer< ExternalMessage >::ActorRemoval    );
+		RegisterHandler( this, &NetworkLayer< ExternalMessage >::CheckResolution  );
+		RegisterHandler( this, &NetworkLayer< ExternalMessage >::CheckResolutions );
+		RegisterHandler( this, &NetworkLayer< ExternalMessage >::RemoveResolution );
 		RegisterHandler( this, &NetworkLayer< ExternalMessage >::OutboundMessage );
 	}
 	
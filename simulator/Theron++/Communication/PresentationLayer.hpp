@@ -53,6 +53,27 @@
   the message, convert it to the right binary format, and resend the message to
   B's handler for the given message binary message type.
 
+  Messages can be serialised as text or in a binary format, and the format is
+  negotiated per peer actor. Text is always understood, and it is used until
+  the peer is known to understand the binary format. If the Presentation Layer
+  prefers the binary format it will offer this to a remote actor the first
+  time a message is sent to it, and if the remote Presentation Layer also
+  prefers the binary format it will accept the offer. A peer sending binary
+  messages is also taken to accept the binary format. Agents that are not
+  Theron++ actors will only see the offer, which is a short binary payload,
+  and the binary format should therefore only be preferred when all peers are
+  Theron++ actors.
+
+  Large payloads can also be compressed before they are sent to a remote
+  actor. Compression is disabled by default, and it is enabled by giving a
+  size threshold and optionally a dictionary of strings likely to occur in the
+  payloads. It is negotiated per peer in the same way as the binary format,
+  and peers must use the same dictionary. The compression uses zlib, and an
+  endpoint must therefore be linked with the zlib library (-lz).
+
+  The messages received from remote actors can be recorded in a message
+  journal so that the workload of the endpoint can be replayed later.
+
   REVISION: This file is NOT compatible with standard Theron - the new actor
             implementation of Theron++ MUST be used.
 
@@ -74,11 +95,22 @@
 #include <typeinfo>
 #include <typeindex>
 #include <stdexcept>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+
+#include <zlib.h>
 
 #include "Actor.hpp"
 #include "Utility/StandardFallbackHandler.hpp"
 #include "NetworkEndPoint.hpp"
 #include "SerialMessage.hpp"
+#include "BinaryPayload.hpp"
+#include "MessageJournal.hpp"
 
 // The Presentation Layer is defined to be a part of the Theron name space
 
@@ -113,12 +145,12 @@ private:
   private:
 
     Address From, To;
-    SerialMessage::Payload Message;
+    SerialMessage::SharedPayload Message;
 
   public:
 
     RemoteMessage( const Address & TheSender, const Address & TheReceiver,
-								   const SerialMessage::Payload & ThePayload )
+								   const SerialMessage::SharedPayload & ThePayload )
     : From( TheSender ), To( TheReceiver ), Message( ThePayload )
     {};
 
@@ -134,7 +166,12 @@ private:
       return To;
     }
 
-    inline SerialMessage::Payload GetPayload( void ) const
+    inline const SerialMessage::Payload & GetPayload( void ) const
+    {
+      return Message;
+    }
+
+    inline const SerialMessage::SharedPayload & GetSharedPayload( void ) const
     {
       return Message;
     }
@@ -148,6 +185,525 @@ private:
 	template< class ExternalMessage >
 	friend class SessionLayer;
 
+  // --------------------------------------------------------------------------
+  // Format negotiation
+  // --------------------------------------------------------------------------
+	//
+	// The format used for each remote actor is remembered, and peers that are
+	// not in the map are sent text messages. The messages are enqueued by the
+	// threads of the sending actors, and the map must therefore be protected
+	// by a lock.
+
+	const SerialMessage::Format PreferredFormat;
+
+	std::map< Address, SerialMessage::Format > PeerFormats;
+	std::mutex 																 FormatGuard;
+
+	// The offer and the acceptance of the binary format are binary payloads
+	// with a dedicated tag, and a flag telling if it is the acceptance.
+
+	static constexpr const char * FormatTag = "THERON_FORMAT";
+
+	static inline SerialMessage::Payload FormatOffer( bool Accept )
+	{
+		BinaryWriter Offer( FormatTag );
+
+		Offer << Accept;
+		return Offer.str();
+	}
+
+	// The format for a remote actor is looked up, and if the binary format is
+	// preferred and the peer is new, the binary format is offered from the
+	// local sender. The peer is recorded as a text peer until the offer is
+	// accepted so that the offer is only made once.
+
+	SerialMessage::Format OutboundFormat( const Address & TheSender,
+																				const Address & TheReceiver )
+	{
+		{
+			std::lock_guard< std::mutex > Lock( FormatGuard );
+
+			auto Peer = PeerFormats.find( TheReceiver );
+
+			if ( Peer != PeerFormats.end() )
+				return Peer->second;
+			else if ( PreferredFormat == SerialMessage::Format::Text )
+				return SerialMessage::Format::Text;
+
+			PeerFormats.emplace( TheReceiver, SerialMessage::Format::Text );
+		}
+
+		Send( RemoteMessage( TheSender, TheReceiver, FormatOffer( false ) ),
+					Network::GetAddress( Network::Layer::Session ) );
+
+		return SerialMessage::Format::Text;
+	}
+
+	// An inbound payload is checked for being an offer or an acceptance, and
+	// the function returns true if it was, in which case the payload should not
+	// be forwarded to the local actor. An offer is accepted if the binary format
+	// is preferred, and then the remote actor is also recorded as a binary peer.
+	// A remote actor sending a binary message will also be recorded as a binary
+	// peer if the binary format is preferred.
+
+	bool InboundFormat( const RemoteMessage & TheMessage )
+	{
+		const SerialMessage::Payload & ThePayload( TheMessage.GetPayload() );
+
+		if ( !SerialMessage::IsBinary( ThePayload ) ) return false;
+
+		BinaryReader Offer( ThePayload, FormatTag );
+		bool 				 Accept = false;
+
+		Offer >> Accept;
+
+		if ( PreferredFormat == SerialMessage::Format::Binary )
+		{
+			std::lock_guard< std::mutex > Lock( FormatGuard );
+
+			PeerFormats[ TheMessage.GetSender() ] = SerialMessage::Format::Binary;
+		}
+
+		if ( !Offer ) return false;
+
+		if ( !Accept && ( PreferredFormat == SerialMessage::Format::Binary ) )
+			Send( RemoteMessage( TheMessage.GetReceiver(), TheMessage.GetSender(),
+													 FormatOffer( true ) ),
+						Network::GetAddress( Network::Layer::Session ) );
+
+		return true;
+	}
+
+  // --------------------------------------------------------------------------
+  // Payload compression
+  // --------------------------------------------------------------------------
+	//
+	// Serialised time series, like predictions and load profiles, are long and
+	// repetitive, and on slow links it pays to compress them. A compressed
+	// payload is a binary payload with a dedicated tag, the length of the
+	// original payload, and the deflated original payload, which may itself be
+	// a text or a binary payload. Short payloads compress poorly unless the
+	// compressor is primed with a dictionary of the strings that commonly occur
+	// in the payloads, and a dictionary can therefore be given. The settings
+	// are replaced as a whole, and a sending thread keeps a shared pointer to
+	// the settings it uses so that the lock is not held while compressing.
+
+public:
+
+	class CompressionSettings
+	{
+	public:
+
+		const std::size_t 	Threshold;
+		const int 					Level;
+		const std::string 	Dictionary;
+		const std::uint32_t DictionaryID;
+
+		CompressionSettings( std::size_t MinimalSize, int CompressionLevel,
+												 const std::string & TheDictionary )
+		: Threshold( MinimalSize ), Level( CompressionLevel ),
+		  Dictionary( TheDictionary ),
+		  DictionaryID( adler32( adler32( 0, Z_NULL, 0 ),
+							reinterpret_cast< const Bytef * >( TheDictionary.data() ),
+							TheDictionary.size() ) )
+		{}
+	};
+
+private:
+
+	std::shared_ptr< const CompressionSettings > Compression;
+
+	// Compression is offered to a peer the first time a payload above the
+	// threshold is sent to it, and the payloads are sent uncompressed until
+	// the peer has accepted. The offer carries the identifier of the dictionary
+	// and it is only accepted by a peer having compression enabled with the
+	// same dictionary. A peer sending a compressed payload is also taken to
+	// accept compression. The map tells if the peer has accepted the offer,
+	// and it is protected by the same lock as the peer formats.
+
+	std::map< Address, bool > PeerCompression;
+
+	static constexpr const char * CompressionTag 			= "THERON_DEFLATE";
+	static constexpr const char * CompressionOfferTag = "THERON_COMPRESSION";
+
+	static inline SerialMessage::Payload
+	CompressionOffer( bool Accept, std::uint32_t DictionaryID )
+	{
+		BinaryWriter Offer( CompressionOfferTag );
+
+		Offer << Accept << DictionaryID;
+		return Offer.str();
+	}
+
+	static inline bool IsCompressed( const SerialMessage::Payload & ThePayload )
+	{
+		return static_cast< bool >( BinaryReader( ThePayload, CompressionTag ) );
+	}
+
+	// The counters for the compression can be read by other threads. The bytes
+	// saved is the difference between the size of the original payloads and
+	// the size of the compressed payloads sent, and the time is the time spent
+	// by the sending and receiving threads compressing and decompressing.
+
+	std::atomic< std::size_t > CompressedPayloads, DecompressedPayloads,
+														 BytesSaved;
+	std::atomic< std::chrono::nanoseconds::rep > CompressionTime,
+																							 DecompressionTime;
+
+	// Compressing a payload first writes the header and then deflates the
+	// payload into the remaining part of the buffer. The original payload is
+	// returned if it could not be compressed to less than its own size.
+
+	SerialMessage::Payload Compress( SerialMessage::Payload && ThePayload,
+																	 const CompressionSettings & Settings )
+	{
+		auto Start = std::chrono::steady_clock::now();
+
+		BinaryWriter Header( CompressionTag );
+		Header << static_cast< std::uint32_t >( ThePayload.size() );
+
+		SerialMessage::Payload Compressed( Header.str() );
+		std::size_t 					 HeaderSize = Compressed.size();
+
+		z_stream Deflater;
+		std::memset( &Deflater, 0, sizeof( Deflater ) );
+
+		bool Success = ( deflateInit( &Deflater, Settings.Level ) == Z_OK );
+
+		if ( Success )
+		{
+			if ( !Settings.Dictionary.empty() )
+				deflateSetDictionary( &Deflater,
+					reinterpret_cast< const Bytef * >( Settings.Dictionary.data() ),
+					Settings.Dictionary.size() );
+
+			Compressed.resize( HeaderSize
+												 + deflateBound( &Deflater, ThePayload.size() ) );
+
+			Deflater.next_in   = reinterpret_cast< Bytef * >( ThePayload.data() );
+			Deflater.avail_in  = ThePayload.size();
+			Deflater.next_out  = reinterpret_cast< Bytef * >(
+													 Compressed.data() + HeaderSize );
+			Deflater.avail_out = Compressed.size() - HeaderSize;
+
+			Success = ( deflate( &Deflater, Z_FINISH ) == Z_STREAM_END ) &&
+								( HeaderSize + Deflater.total_out < ThePayload.size() );
+
+			deflateEnd( &Deflater );
+		}
+
+		CompressionTime += std::chrono::duration_cast< std::chrono::nanoseconds >(
+											 std::chrono::steady_clock::now() - Start ).count();
+
+		if ( Success )
+		{
+			Compressed.resize( HeaderSize + Deflater.total_out );
+
+			CompressedPayloads++;
+			BytesSaved += ThePayload.size() - Compressed.size();
+
+			return Compressed;
+		}
+		else
+			return std::move( ThePayload );
+	}
+
+	// The outbound payload is compressed if compression is enabled, if the
+	// payload is larger than the threshold, and if the peer has accepted
+	// compression. Payloads that cannot be described by the zlib stream
+	// counters are sent uncompressed.
+
+	SerialMessage::Payload OutboundCompression( const Address & TheSender,
+																							const Address & TheReceiver,
+																							SerialMessage::Payload && ThePayload )
+	{
+		std::shared_ptr< const CompressionSettings > Settings;
+
+		{
+			std::lock_guard< std::mutex > Lock( FormatGuard );
+
+			if ( !Compression || ( ThePayload.size() < Compression->Threshold ) ||
+					 ( ThePayload.size() > std::numeric_limits< uInt >::max() ) )
+				return std::move( ThePayload );
+
+			Settings = Compression;
+
+			auto Peer = PeerCompression.find( TheReceiver );
+
+			if ( Peer == PeerCompression.end() )
+				PeerCompression.emplace( TheReceiver, false );
+			else if ( Peer->second )
+				return Compress( std::move( ThePayload ), *Settings );
+			else
+				return std::move( ThePayload );
+		}
+
+		Send( RemoteMessage( TheSender, TheReceiver,
+												 CompressionOffer( false, Settings->DictionaryID ) ),
+					Network::GetAddress( Network::Layer::Session ) );
+
+		return std::move( ThePayload );
+	}
+
+	// An inbound compression offer or acceptance is handled as for the format,
+	// and the function returns true if the payload was an offer that should
+	// not be forwarded to the local actor.
+
+	bool InboundCompression( const RemoteMessage & TheMessage )
+	{
+		const SerialMessage::Payload & ThePayload( TheMessage.GetPayload() );
+
+		if ( !SerialMessage::IsBinary( ThePayload ) ) return false;
+
+		if ( IsCompressed( ThePayload ) )
+		{
+			std::lock_guard< std::mutex > Lock( FormatGuard );
+
+			if ( Compression )
+				PeerCompression[ TheMessage.GetSender() ] = true;
+
+			return false;
+		}
+
+		BinaryReader  Offer( ThePayload, CompressionOfferTag );
+		bool 				  Accept 			 = false;
+		std::uint32_t DictionaryID = 0;
+
+		Offer >> Accept >> DictionaryID;
+
+		if ( !Offer ) return false;
+
+		bool Agreed = false;
+
+		{
+			std::lock_guard< std::mutex > Lock( FormatGuard );
+
+			if ( Compression && ( Compression->DictionaryID == DictionaryID ) )
+			{
+				PeerCompression[ TheMessage.GetSender() ] = true;
+				Agreed = true;
+			}
+		}
+
+		if ( Agreed && !Accept )
+			Send( RemoteMessage( TheMessage.GetReceiver(), TheMessage.GetSender(),
+													 CompressionOffer( true, DictionaryID ) ),
+						Network::GetAddress( Network::Layer::Session ) );
+
+		return true;
+	}
+
+	// A compressed inbound payload is inflated to its original length, and
+	// other payloads are returned unchanged. The dictionary is requested by
+	// the inflater if the payload was compressed with a dictionary, and an
+	// invalid argument exception is thrown if the payload cannot be inflated.
+
+	SerialMessage::SharedPayload Decompress( const RemoteMessage & TheMessage )
+	{
+		const SerialMessage::Payload & ThePayload( TheMessage.GetPayload() );
+
+		BinaryReader  Header( ThePayload, CompressionTag );
+		std::uint32_t OriginalSize = 0;
+
+		Header >> OriginalSize;
+
+		if ( !Header ) return TheMessage.GetSharedPayload();
+
+		auto Start = std::chrono::steady_clock::now();
+
+		std::shared_ptr< const CompressionSettings > Settings;
+
+		{
+			std::lock_guard< std::mutex > Lock( FormatGuard );
+			Settings = Compression;
+		}
+
+		std::size_t HeaderSize = 2 + sizeof( std::uint32_t )
+														 + std::strlen( CompressionTag )
+														 + sizeof( std::uint32_t );
+
+		SerialMessage::Payload Original( OriginalSize, '\0' );
+
+		z_stream Inflater;
+		std::memset( &Inflater, 0, sizeof( Inflater ) );
+
+		bool Success = ( inflateInit( &Inflater ) == Z_OK );
+
+		if ( Success )
+		{
+			Inflater.next_in   = reinterpret_cast< Bytef * >(
+													 const_cast< char * >( ThePayload.data() + HeaderSize ) );
+			Inflater.avail_in  = ThePayload.size() - HeaderSize;
+			Inflater.next_out  = reinterpret_cast< Bytef * >( Original.data() );
+			Inflater.avail_out = Original.size();
+
+			int Status = inflate( &Inflater, Z_FINISH );
+
+			if ( ( Status == Z_NEED_DICT ) && Settings &&
+					 !Settings->Dictionary.empty() )
+			{
+				inflateSetDictionary( &Inflater,
+					reinterpret_cast< const Bytef * >( Settings->Dictionary.data() ),
+					Settings->Dictionary.size() );
+
+				Status = inflate( &Inflater, Z_FINISH );
+			}
+
+			Success = ( Status == Z_STREAM_END ) &&
+								( Inflater.total_out == OriginalSize );
+
+			inflateEnd( &Inflater );
+		}
+
+		DecompressionTime += std::chrono::duration_cast< std::chrono::nanoseconds >(
+												 std::chrono::steady_clock::now() - Start ).count();
+
+		if ( !Success )
+		{
+			std::ostringstream ErrorMessage;
+
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "Compressed payload from "
+									 << TheMessage.GetSender().AsString() << " to "
+									 << TheMessage.GetReceiver().AsString()
+									 << " could not be decompressed";
+
+			throw std::invalid_argument( ErrorMessage.str() );
+		}
+
+		DecompressedPayloads++;
+
+		return SerialMessage::SharedPayload( std::move( Original ) );
+	}
+
+	// Compression is enabled by giving the threshold, and optionally the
+	// dictionary and the zlib compression level. A threshold of zero disables
+	// compression. Changing the settings forgets the peers that have accepted
+	// compression since they may not have the new dictionary.
+
+public:
+
+	void SetCompression( std::size_t Threshold,
+											 const std::string & Dictionary = std::string(),
+											 int Level = Z_DEFAULT_COMPRESSION )
+	{
+		std::lock_guard< std::mutex > Lock( FormatGuard );
+
+		if ( Threshold > 0 )
+			Compression = std::make_shared< const CompressionSettings >(
+										Threshold, Level, Dictionary );
+		else
+			Compression.reset();
+
+		PeerCompression.clear();
+	}
+
+	class CompressionStatistics
+	{
+	public:
+
+		std::size_t 						 Compressed, Decompressed, BytesSaved;
+		std::chrono::nanoseconds CompressionTime, DecompressionTime;
+	};
+
+	CompressionStatistics GetCompressionStatistics( void ) const
+	{
+		return CompressionStatistics{ CompressedPayloads.load(),
+			DecompressedPayloads.load(), BytesSaved.load(),
+			std::chrono::nanoseconds( CompressionTime.load() ),
+			std::chrono::nanoseconds( DecompressionTime.load() ) };
+	}
+
+  // --------------------------------------------------------------------------
+  // Message journal
+  // --------------------------------------------------------------------------
+	//
+	// The inbound messages from remote actors can be recorded in a journal
+	// for later replay, see the message journal header. The journal is
+	// replaced as a whole, and the inbound path keeps a shared pointer to the
+	// journal it writes to so that it can be stopped while a message is being
+	// recorded. A flag avoids taking the lock when no journal is recorded.
+
+private:
+
+	std::shared_ptr< MessageJournal::Writer > Journal;
+	std::atomic< bool > 											Journaling;
+
+	void RecordInbound( const RemoteMessage & TheMessage )
+	{
+		std::shared_ptr< MessageJournal::Writer > TheJournal;
+
+		{
+			std::lock_guard< std::mutex > Lock( FormatGuard );
+			TheJournal = Journal;
+		}
+
+		if ( TheJournal )
+			TheJournal->Write( TheMessage.GetSender(), TheMessage.GetReceiver(),
+												 TheMessage.GetPayload() );
+	}
+
+	// Starting a journal closes any journal already recorded, and it throws
+	// an invalid argument exception if the file cannot be opened. The journal
+	// is written to the file when it is stopped.
+
+public:
+
+	void StartJournal( const std::string & FileName )
+	{
+		auto NewJournal = std::make_shared< MessageJournal::Writer >( FileName );
+
+		std::lock_guard< std::mutex > Lock( FormatGuard );
+
+		Journal = NewJournal;
+		Journaling.store( true, std::memory_order_release );
+	}
+
+	void StopJournal( void )
+	{
+		std::shared_ptr< MessageJournal::Writer > OldJournal;
+
+		{
+			std::lock_guard< std::mutex > Lock( FormatGuard );
+
+			Journaling.store( false, std::memory_order_release );
+			OldJournal.swap( Journal );
+		}
+	}
+
+  // --------------------------------------------------------------------------
+  // Traffic counters
+  // --------------------------------------------------------------------------
+	//
+	// The messages and the payload bytes exchanged with remote actors are
+	// counted as they are sent to and received from the session layer, i.e.
+	// after compression, so that the traffic of the endpoint can be monitored.
+	// The counters are updated by the threads enqueuing the messages and can
+	// be read by any thread.
+
+private:
+
+	std::atomic< std::uint64_t > InboundMessages, InboundBytes,
+															 OutboundMessages, OutboundBytes;
+
+public:
+
+	class TrafficStatistics
+	{
+	public:
+
+		std::uint64_t MessagesIn, BytesIn, MessagesOut, BytesOut;
+	};
+
+	TrafficStatistics GetTrafficStatistics( void ) const
+	{
+		return TrafficStatistics{
+			InboundMessages.load( std::memory_order_relaxed ),
+			InboundBytes.load( std::memory_order_relaxed ),
+			OutboundMessages.load( std::memory_order_relaxed ),
+			OutboundBytes.load( std::memory_order_relaxed ) };
+	}
+
   // --------------------------------------------------------------------------
   // Serialisation and de-serialisation
   // --------------------------------------------------------------------------
@@ -198,10 +754,32 @@ protected:
 		  // to the local destination actor as if it was sent from the remote
 		  // sender.
 
+		  // A compressed payload is first decompressed, and the payload that is
+		  // forwarded is the original payload.
+
 		  if ( InboundMessage )
-				Send( InboundMessage->TheMessage->GetPayload(),
-							InboundMessage->TheMessage->GetSender(),
-							InboundMessage->TheMessage->GetReceiver() );
+			{
+				const RemoteMessage & Received( *( InboundMessage->TheMessage ) );
+
+				InboundMessages.fetch_add( 1, std::memory_order_relaxed );
+				InboundBytes.fetch_add( Received.GetPayload().size(),
+																std::memory_order_relaxed );
+
+				if ( !InboundCompression( Received ) )
+				{
+					RemoteMessage Original( Received.GetSender(), Received.GetReceiver(),
+																	Decompress( Received ) );
+
+					if ( !InboundFormat( Original ) )
+					{
+						if ( Journaling.load( std::memory_order_acquire ) )
+							RecordInbound( Original );
+
+						Send( Original.GetPayload(), Original.GetSender(),
+									Original.GetReceiver() );
+					}
+				}
+			}
 			else
 			{
 				std::ostringstream ErrorMessage;
@@ -218,7 +796,8 @@ protected:
 		else
 		{
 			// The outbound message should in this case support serialisation, and
-			// the payload is created first.
+			// the payload is created first in the format negotiated with the
+			// receiver, and then compressed if the receiver accepts compression.
 
 			SerialMessage * OutboundMessage( TheMessage->GetSerialMessagePointer() );
 
@@ -226,9 +805,18 @@ protected:
 		  // to the Session Layer server.
 
 			if ( OutboundMessage != nullptr )
-				Send( RemoteMessage( TheMessage->From, TheMessage->To,
-														 OutboundMessage->Serialize() ),
-							Network::GetAddress( Network::Layer::Session ) );
+			{
+				RemoteMessage Outbound( TheMessage->From, TheMessage->To,
+					OutboundCompression( TheMessage->From, TheMessage->To,
+						OutboundMessage->Encode(
+						OutboundFormat( TheMessage->From, TheMessage->To ) ) ) );
+
+				OutboundMessages.fetch_add( 1, std::memory_order_relaxed );
+				OutboundBytes.fetch_add( Outbound.GetPayload().size(),
+																 std::memory_order_relaxed );
+
+				Send( Outbound, Network::GetAddress( Network::Layer::Session ) );
+			}
 			else
 			{
 				std::ostringstream ErrorMessage;
@@ -262,11 +850,20 @@ public:
   // Address does not check that the actor exists when it is constructed on
   // a string. The check is only done when the fist message is sent to this
   // address. Hence, as long as the default names are used for the actors,
-  // this no further initialisation is needed.
+  // this no further initialisation is needed. The preferred format is text
+  // unless binary messages are explicitly requested, and compression is
+  // disabled until it is enabled with the set compression function.
 
-  PresentationLayer( const std::string ServerName = "PresentationLayer"  )
+  PresentationLayer( const std::string ServerName = "PresentationLayer",
+		SerialMessage::Format Preferred = SerialMessage::Format::Text )
   : Actor( ServerName ),
-    StandardFallbackHandler( Actor::GetAddress().AsString() )
+    StandardFallbackHandler( Actor::GetAddress().AsString() ),
+    PreferredFormat( Preferred ), PeerFormats(), FormatGuard(),
+    Compression(), PeerCompression(), CompressedPayloads( 0 ),
+    DecompressedPayloads( 0 ), BytesSaved( 0 ), CompressionTime( 0 ),
+    DecompressionTime( 0 ), Journal(), Journaling( false ),
+    InboundMessages( 0 ), InboundBytes( 0 ), OutboundMessages( 0 ),
+    OutboundBytes( 0 )
   {
 		Actor::SetPresentationLayerServer( this );
   }
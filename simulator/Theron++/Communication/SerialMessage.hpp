@@ -35,6 +35,19 @@
 	incomprehensible reason. The only way is to declare the serial message as a 
 	separate top-level object, which is done here.
   
+  The serialised message is normally a readable text string, but a message 
+  can also support a compact binary encoding defined in BinaryPayload.hpp. 
+  The Presentation Layer chooses the format to use with each peer, and the 
+  payload is decoded according to its format when it is received. A message 
+  that does not provide a binary codec is always sent as text.
+  
+  A payload is passed from the Presentation Layer through the Session Layer to 
+  the Network Layer, and each layer wraps it in its own message, which is 
+  again copied when it is sent to the next layer. The layers therefore hold the
+  payload as a shared payload, which is a reference counted immutable buffer 
+  so that the serialised string is not copied on its way between the 
+  serialisation and the socket.
+  
   REFERENCES:
   
   [1] http://www.ocoudert.com/blog/2011/07/09/a-practical-guide-to-c-serialization/
@@ -55,6 +68,10 @@
 #ifndef THERON_SERIAL_MESSAGE
 #define THERON_SERIAL_MESSAGE
 
+#include <string>
+#include <memory>
+#include <type_traits>
+
 namespace Theron
 {
 
@@ -69,6 +86,59 @@ public:
 	// The payload is defined as a simple string
 	
 	using Payload = std::string;
+	
+	// The shared payload is constructed by moving or copying a payload into a 
+	// reference counted buffer, and copying the shared payload only copies the 
+	// reference. The payload can not be changed after it has been constructed, 
+	// and it can be read where a constant payload reference is expected.
+	
+	class SharedPayload
+	{
+	private:
+		
+		std::shared_ptr< const Payload > Buffer;
+		
+		static inline const std::shared_ptr< const Payload > & EmptyPayload( void )
+		{
+			static const std::shared_ptr< const Payload > 
+									 Empty( std::make_shared< const Payload >() );
+			
+			return Empty;
+		}
+		
+	public:
+		
+		inline const Payload & Get( void ) const
+		{ return *Buffer; }
+		
+		inline operator const Payload & ( void ) const
+		{ return *Buffer; }
+		
+		inline std::size_t size( void ) const
+		{ return Buffer->size(); }
+		
+		inline bool empty( void ) const
+		{ return Buffer->empty(); }
+		
+		SharedPayload( Payload && TheMessage )
+		: Buffer( std::make_shared< const Payload >( std::move( TheMessage ) ) )
+		{}
+		
+		SharedPayload( const Payload & TheMessage )
+		: Buffer( std::make_shared< const Payload >( TheMessage ) )
+		{}
+		
+		SharedPayload( const char * TheMessage )
+		: Buffer( std::make_shared< const Payload >( TheMessage ) )
+		{}
+		
+		SharedPayload( void )
+		: Buffer( EmptyPayload() )
+		{}
+		
+		SharedPayload( const SharedPayload & Other ) = default;
+		SharedPayload & operator = ( const SharedPayload & Other ) = default;
+	};
   
   // Then we can define the functions to deal with serialisation. This is 
 	// public so that everyone can check the serialised version of a message,
@@ -76,10 +146,59 @@ public:
 	
 	virtual Payload Serialize( void ) const = 0;
 	
+	// The payload can be encoded as text or in the binary format. A binary 
+	// payload always starts with a zero byte, which can be used to detect the 
+	// format of a received payload.
+	
+	enum class Format : unsigned char
+	{
+		Text,
+		Binary
+	};
+	
+	static inline bool IsBinary( const Payload & ThePayload )
+	{ return !ThePayload.empty() && ( ThePayload.front() == '\0' ); }
+	
+	// Encoding a message in a given format falls back to the text format if 
+	// the message does not support the binary format.
+	
+	inline Payload Encode( Format TheFormat ) const
+	{
+		if ( TheFormat == Format::Binary )
+		{
+			Payload BinaryPayload( BinarySerialize() );
+			
+			if ( !BinaryPayload.empty() ) 
+				return BinaryPayload;
+		}
+		
+		return Serialize();
+	}
+	
 protected:
 	
   virtual bool Deserialize( const Payload & TheMessage ) = 0; 
 	
+	// Messages supporting the binary format must override the binary codec
+	// functions. The default binary serialisation returns an empty payload to 
+	// indicate that the message must be sent as text.
+	
+	virtual Payload BinarySerialize( void ) const
+	{ return Payload(); }
+	
+	virtual bool BinaryDeserialize( const Payload & TheMessage )
+	{ return false; }
+	
+	// Decoding a received payload uses the codec for the format of the payload
+	
+	inline bool Decode( const Payload & TheMessage )
+	{
+		if ( IsBinary( TheMessage ) )
+			return BinaryDeserialize( TheMessage );
+		else
+			return Deserialize( TheMessage );
+	}
+	
 	// These functions should be callable from the presentation layer and from
 	// actors that needs to de-serialise incoming messages.
 	
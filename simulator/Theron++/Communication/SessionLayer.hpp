@@ -62,9 +62,14 @@
 #include <string>
 #include <utility>
 #include <queue>
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <atomic>
 #include <type_traits>
 #include <stdexcept>
 #include <sstream>
+#include <cstdint>
 
 #include <boost/bimap/bimap.hpp>
 #include <boost/bimap/set_of.hpp>
@@ -142,15 +147,41 @@ protected:
 	
   // Actors may need to know their possible peer actors, and can subscribe 
   // to a notification when a new peer is discovered by sending a subscription
-  // request to the Session Layer. 
+  // request to the Session Layer. An actor creating many local actors at the 
+  // same time may subscribe them all in one request by giving their addresses.
+  // If no addresses are given, the sender of the request is subscribed.
+  //
+  // Every change of the known peers increments the membership version, and 
+  // all notifications carry the version after the change. A subscriber that 
+  // already knows the peers up to a version, for instance because it has 
+  // been subscribed before, can give this version to receive only the 
+  // changes made since then instead of all the known peers. Version zero 
+  // means that nothing is known.
 
 public: 
 	
+  using MembershipVersion = std::uint64_t;
+	
   class NewPeerSubscription
   { 
 	public:
 		
-		NewPeerSubscription( void ) = default;
+		const std::set< Address > Subscribers;
+		const MembershipVersion   KnownVersion;
+		
+		NewPeerSubscription( void )
+		: Subscribers(), KnownVersion( 0 )
+		{ }
+		
+		NewPeerSubscription( const std::set< Address > & TheSubscribers, 
+												 MembershipVersion TheVersion = 0 )
+		: Subscribers( TheSubscribers ), KnownVersion( TheVersion )
+		{ }
+		
+		NewPeerSubscription( MembershipVersion TheVersion )
+		: Subscribers(), KnownVersion( TheVersion )
+		{ }
+		
 		NewPeerSubscription( const NewPeerSubscription & Other ) = default;
 	};
 
@@ -178,17 +209,34 @@ public:
   // available in one go. For subsequent submissions it will probably contain 
   // only single peers unless a particular implementation supports adding 
   // multiple peers in one go.
+  //
+  // The reply to a subscription is complete if it holds all the known peers,
+  // and a subscriber that remembers peers from an earlier subscription should
+  // then forget the peers not in the set. Otherwise it holds the peers added 
+  // since the version given with the subscription, and it is preceded by 
+  // peer removed messages for the peers removed since that version.
   
   class NewPeerAdded : public std::set< Address >
   {
+  private:
+    
+    MembershipVersion Version;
+    bool 							Complete;
+    
   public:
     
-    NewPeerAdded( void )
-    : std::set< Address >()
+    inline MembershipVersion GetVersion( void ) const
+    { return Version; }
+    
+    inline bool IsComplete( void ) const
+    { return Complete; }
+    
+    NewPeerAdded( MembershipVersion TheVersion = 0, bool AllPeers = false )
+    : std::set< Address >(), Version( TheVersion ), Complete( AllPeers )
     { }
     
-    NewPeerAdded( const Address & ThePeer )
-    : std::set< Address >()
+    NewPeerAdded( const Address & ThePeer, MembershipVersion TheVersion = 0 )
+    : std::set< Address >(), Version( TheVersion ), Complete( false )
     { 
       insert( ThePeer ); 
     }    
@@ -202,16 +250,20 @@ public:
   {
   private:
     
-    Address RemovedPeer;
+    Address 					RemovedPeer;
+    MembershipVersion Version;
     
   public:
     
-    PeerRemoved( const Address & ThePeer )
-    : RemovedPeer( ThePeer )
+    PeerRemoved( const Address & ThePeer, MembershipVersion TheVersion = 0 )
+    : RemovedPeer( ThePeer ), Version( TheVersion )
     { }
     
     Address GetAddress( void ) const
     { return RemovedPeer; }
+    
+    inline MembershipVersion GetVersion( void ) const
+    { return Version; }
   };
 
 };
@@ -349,12 +401,139 @@ protected:
 	
 	// A consequence of this lazy approach is that it is necessary to cache 
 	// messages to unknown recipients until their external addresses have been 
-	// resolved. Since there can be many messages for one receiver, a multi-map
-	// is used 
+	// resolved. The cache must be bounded since a remote actor may never be 
+	// resolved, and a storm of resolution requests under peer churn should not 
+	// exhaust the memory of the endpoint. There are three limits: The number 
+	// of messages cached for one receiver, the total number of payload bytes 
+	// cached, and the time a message can wait for its receiver to be resolved.
+	// A message that would exceed the first two limits is dropped, i.e. the 
+	// newest message is shed as for a full actor mailbox, and messages older 
+	// than the time to live are expired. A limit of zero means that the 
+	// corresponding limit is not enforced. The limits can be changed at any 
+	// time, and will apply to the messages cached after the change.
+	
+public:
+	
+	void SetCacheLimits( std::size_t MessagesPerActor, std::size_t TotalBytes, 
+											 std::chrono::milliseconds TimeToLive )
+	{
+		CacheMessagesPerActor = MessagesPerActor;
+		CacheBytes						= TotalBytes;
+		CacheTimeToLive 			= TimeToLive;
+	}
+	
+	// The occupancy of the cache and the number of messages that have left it 
+	// can be read by other threads. The flushed messages are the ones sent when
+	// the receiver was resolved, and the dropped messages are the ones refused 
+	// by the limits or deleted because the remote receiver was removed.
+	
+	class CacheStatistics
+	{
+	public:
+		
+		std::size_t CachedMessages, CachedBytes, Flushed, Dropped, Expired;
+	};
+	
+	CacheStatistics GetCacheStatistics( void ) const
+	{
+		return CacheStatistics{ CachedMessages.load(), CachedBytes.load(), 
+														FlushedMessages.load(), DroppedMessages.load(),
+														ExpiredMessages.load() };
+	}
 	
 private:
 	
-	std::unordered_multimap< Address, ExternalMessage > MessageCache;
+	std::atomic< std::size_t > 							 CacheMessagesPerActor, CacheBytes;
+	std::atomic< std::chrono::milliseconds > CacheTimeToLive;
+	std::atomic< std::size_t > CachedMessages, CachedBytes, FlushedMessages, 
+														 DroppedMessages, ExpiredMessages;
+	
+	// The messages for one receiver are kept in a first-in-first-out queue 
+	// with the time each message was cached, and the queues are indexed by the 
+	// address of the receiver.
+	
+	class CachedMessage
+	{
+	public:
+		
+		const ExternalMessage 								Message;
+		const std::chrono::steady_clock::time_point Arrival;
+		
+		CachedMessage( const ExternalMessage & TheMessage, 
+									 std::chrono::steady_clock::time_point TheArrival )
+		: Message( TheMessage ), Arrival( TheArrival )
+		{ }
+		
+		CachedMessage( const CachedMessage & Other ) = default;
+	};
+	
+	std::unordered_map< Address, std::deque< CachedMessage > > MessageCache;
+	
+	// The expiry needs the oldest cached messages across all receivers. The 
+	// arrival order of the messages is recorded with their receivers, and an 
+	// entry whose message has already left the cache is recognised by the 
+	// receiver's queue being empty or starting with a later message.
+	
+	std::deque< std::pair< std::chrono::steady_clock::time_point, Address > > 
+	ArrivalOrder;
+	
+	// Removing the cached messages of a receiver updates the occupancy and 
+	// returns the queue of messages so that they can be forwarded if the 
+	// receiver has been resolved.
+	
+	std::deque< CachedMessage > 
+	RemoveCachedMessages( 
+		typename std::unordered_map< Address, 
+																 std::deque< CachedMessage > >::iterator Queue )
+	{
+		std::deque< CachedMessage > Messages( std::move( Queue->second ) );
+		
+		MessageCache.erase( Queue );
+		
+		for ( const CachedMessage & Cached : Messages )
+			CachedBytes -= Cached.Message.GetPayload().size();
+		
+		CachedMessages -= Messages.size();
+		
+		return Messages;
+	}
+	
+	// The expired messages are removed from the front of the arrival order 
+	// until the oldest message is within the time to live. A receiver whose 
+	// messages have all expired is removed from the cache, and a new message 
+	// for it will then result in a new resolution request.
+	
+	void ExpireCachedMessages( std::chrono::steady_clock::time_point Now )
+	{
+		std::chrono::milliseconds TimeToLive( CacheTimeToLive.load() );
+		
+		if ( TimeToLive.count() == 0 )
+		{
+			ArrivalOrder.clear();
+			return;
+		}
+		
+		while ( !ArrivalOrder.empty() && 
+						( Now - ArrivalOrder.front().first > TimeToLive ) )
+		{
+			auto Queue = MessageCache.find( ArrivalOrder.front().second );
+			
+			if ( ( Queue != MessageCache.end() ) && 
+					 ( Queue->second.front().Arrival <= ArrivalOrder.front().first ) )
+			{
+				CachedBytes -= Queue->second.front().Message.GetPayload().size();
+				CachedMessages--;
+				ExpiredMessages++;
+				
+				Queue->second.pop_front();
+				
+				if ( Queue->second.empty() )
+					MessageCache.erase( Queue );
+			}
+			
+			ArrivalOrder.pop_front();
+		}
+	}
 
   // --------------------------------------------------------------------------
   // New peer notification subscriptions
@@ -369,24 +548,112 @@ private:
   // each actor.
   
   std::set< Address > NewPeerSubscribers;
+  
+  // The changes of the known peers are recorded in a log with the version 
+  // after each change, so that a subscriber knowing the peers up to a version
+  // can be given the changes since that version. The log is bounded, and the 
+  // oldest changes are forgotten when it has more entries than twice the 
+  // number of known actors plus a constant, since a subscriber that far 
+  // behind is better served by all the known peers. The log then holds all 
+  // changes made after the logged since version.
+  
+  class MembershipChange
+  {
+  public:
+    
+    MembershipVersion Version;
+    Address 					Peer;
+    bool 							Added;
+  };
+  
+  MembershipVersion 					 CurrentVersion, LoggedSince;
+  std::deque< MembershipChange > MembershipLog;
+  
+  static constexpr std::size_t MinimalMembershipLog = 256;
+  
+  // Recording a change increments the version and trims the log. The new 
+  // version is returned for the notifications of the change.
+  
+  MembershipVersion RecordChange( const Address & ThePeer, bool Added )
+  {
+    MembershipLog.push_back( MembershipChange{ ++CurrentVersion, ThePeer, 
+																							 Added } );
+    
+    while ( MembershipLog.size() > 
+						2 * KnownActors.size() + MinimalMembershipLog )
+    {
+      LoggedSince = MembershipLog.front().Version;
+      MembershipLog.pop_front();
+    }
+    
+    return CurrentVersion;
+  }
    
   // When a peer subscribes to be notified about new peers, it will be added 
-  // to the set of subscribers, and it will receive a message containing the 
-  // peers currently known to the system. It could be that no peers are known
-  // to the system, in which an empty set of addresses will be returned.
+  // to the set of subscribers. If the subscription gives a version covered by
+  // the log, the subscribers will receive a peer removed message for each 
+  // peer whose last change since that version was a removal, and then the 
+  // peers whose last change was an addition. Otherwise, or if these changes 
+  // are more than the known peers, they will receive a complete message 
+  // containing the peers currently known to the system. It could be that no 
+  // peers are known to the system, in which an empty set of addresses will be 
+  // returned. The messages are only collected once for all the subscribers of 
+  // the request.
   
   void SubscribeToPeerDiscovery( 
     const SessionLayerMessages::NewPeerSubscription & Command, 
     const Address RequestingActor )
   {
-    NewPeerSubscribers.insert( RequestingActor );
-    NewPeerAdded ExistingPeers;
-
-    for ( auto Peer  = KnownActors.right.begin();
-				       Peer != KnownActors.right.end(); ++Peer )
-		  ExistingPeers.insert( Peer->first );
+    std::map< Address, bool > Changes;
+    
+    bool Delta = ( Command.KnownVersion > 0 ) && 
+								 ( Command.KnownVersion >= LoggedSince ) && 
+								 ( Command.KnownVersion <= CurrentVersion );
+    
+    if ( Delta )
+    {
+      auto Change = MembershipLog.rbegin();
+      
+      while ( ( Change != MembershipLog.rend() ) && 
+							( Change->Version > Command.KnownVersion ) )
+      {
+				Changes.emplace( Change->Peer, Change->Added );
+				++Change;
+			}
+			
+			Delta = Changes.size() <= KnownActors.size();
+    }
+    
+    NewPeerAdded 						 Peers( CurrentVersion, !Delta );
+    std::vector< PeerRemoved > Removals;
+    
+    if ( Delta )
+    {
+      for ( const auto & [ ThePeer, Added ] : Changes )
+				if ( Added )
+					Peers.insert( ThePeer );
+				else
+					Removals.emplace_back( ThePeer, CurrentVersion );
+    }
+    else
+			for ( auto Peer  = KnownActors.right.begin();
+								 Peer != KnownActors.right.end(); ++Peer )
+				Peers.insert( Peer->first );
 		
-    Send( ExistingPeers, RequestingActor );
+		auto Notify = [&]( const Address & Subscriber ){
+			NewPeerSubscribers.insert( Subscriber );
+			
+			for ( const PeerRemoved & Removal : Removals )
+				Send( Removal, Subscriber );
+			
+			Send( Peers, Subscriber );
+		};
+		
+		if ( Command.Subscribers.empty() )
+			Notify( RequestingActor );
+		else
+			for ( const Address & Subscriber : Command.Subscribers )
+				Notify( Subscriber );
   }
   
   void UnsubscribePeerDiscovery( 
@@ -471,34 +738,39 @@ private:
 			// If there are subscribers that should be informed about the new actor 
 			// registration, they should all be informed about this event.
 			
+			MembershipVersion Version = RecordChange( AddressRecord.TheActor, true );
+			
 			if ( ! NewPeerSubscribers.empty() )
 		  {
-				NewPeerAdded NewPeer;
-				NewPeer.insert( AddressRecord.TheActor );
+				NewPeerAdded NewPeer( AddressRecord.TheActor, Version );
 				
 				for ( auto & AnActor : NewPeerSubscribers )
 					Send( NewPeer, AnActor );				
 			}
 			
 			// Then it must be checked if there are any cached messages for this 
-			// remote receiver.
+			// remote receiver that have not yet expired.
 			
-			auto Range = MessageCache.equal_range( AddressRecord.TheActor );
+			ExpireCachedMessages( std::chrono::steady_clock::now() );
 			
-			// Then the external messages cached for this receiver will be sent 
-			// to the network layer server
+			auto Queue = MessageCache.find( AddressRecord.TheActor );
 			
-			Address TheNetworkLayer( Network::GetAddress( 
-														   Network::Layer::Network ) );
-			auto Message = Range.first;
+			// Then the external messages cached for this receiver will be sent 
+			// to the network layer server in the order they were cached.
 			
-			while ( Message != Range.second )
+			if ( Queue != MessageCache.end() )
 		  {
-				Send( ExternalMessage( Message->second.GetSender(), 
-															 AddressRecord.GlobalAddress, 
-															 Message->second.GetPayload() ), 
-							TheNetworkLayer );
-				MessageCache.erase( Message++ );
+				Address TheNetworkLayer( Network::GetAddress( 
+															   Network::Layer::Network ) );
+				
+				for ( const CachedMessage & Cached : RemoveCachedMessages( Queue ) )
+			  {
+					Send( ExternalMessage( Cached.Message.GetSender(), 
+																 AddressRecord.GlobalAddress, 
+																 Cached.Message.GetSharedPayload() ), 
+								TheNetworkLayer );
+					FlushedMessages++;
+				}
 			}
 		}
 	}
@@ -531,8 +803,10 @@ private:
 			
 			// Finally all local subscribers can be informed about this event.
  			
+			MembershipVersion Version = RecordChange( ActorAddress, false );
+			
       for ( const Address & Subscriber : NewPeerSubscribers )
-				Send( PeerRemoved( ActorAddress ), Subscriber );
+				Send( PeerRemoved( ActorAddress, Version ), Subscriber );
     }
   }
   
@@ -550,18 +824,19 @@ private:
 		{
 			// All subscribers are informed about this removal first
 			
+			MembershipVersion Version = RecordChange( AddressRecord->second, false );
+			
 			for ( const Address & Subscriber : NewPeerSubscribers )
-				Send( PeerRemoved( AddressRecord->second ), Subscriber );
+				Send( PeerRemoved( AddressRecord->second, Version ), Subscriber );
 			
 			// Any messages cached for this remote actor will simply be deleted. 
 			// hence the sending actor should be robust and aware that a message 
 			// may not arrive if the actors are volatile.
 			
-			auto Result  = MessageCache.equal_range( AddressRecord->second );
-			auto Message = Result.first;
+			auto Queue = MessageCache.find( AddressRecord->second );
 			
-			while ( Message != Result.second )
-				MessageCache.erase( Message++ );
+			if ( Queue != MessageCache.end() )
+				DroppedMessages += RemoveCachedMessages( Queue ).size();
 			
 			// Finally, the address record can be deleted.
 			
@@ -639,7 +914,7 @@ private:
 			
 			Send( PresentationLayer::RemoteMessage( RemoteActor, 
 																							ReceiverRecord->second, 
-																					    TheMessage.GetPayload()  ), 
+																					    TheMessage.GetSharedPayload()  ), 
 						Network::GetAddress( Network::Layer::Presentation ) 
 					);
 		}
@@ -685,27 +960,57 @@ private:
 		
 		if ( TheReceiver != KnownActors.right.end() )
 			Send( ExternalMessage( SenderAddress, TheReceiver->second, 
-														 TheMessage.GetPayload() ),	
+														 TheMessage.GetSharedPayload() ),	
 						Network::GetAddress( Network::Layer::Network ) );
 		else
 		{
+			// Messages that have waited too long for their receivers are first 
+			// removed so that they do not count against the limits.
+			
+			auto Now = std::chrono::steady_clock::now();
+			
+			ExpireCachedMessages( Now );
+			
 			// The external address of the receiver is currently not known, and it 
 			// should be requested from the network layer - but only if there is 
 			// not already a pending request indicated by a cached message.
 			
-			if ( MessageCache.find( TheMessage.GetReceiver() ) == MessageCache.end() )
+			auto Queue = MessageCache.find( TheMessage.GetReceiver() );
+			
+			if ( Queue == MessageCache.end() )
 				Send( typename NetworkLayer< ExternalMessage >::ResolutionRequest( 
 							  TheMessage.GetReceiver() ),
 				      Network::GetAddress( Network::Layer::Network	)	);
 			
+			// The message is dropped if it would exceed the number of messages 
+			// cached for this receiver or the total size of the cache.
+			
+			std::size_t MaxMessages = CacheMessagesPerActor.load(), 
+									MaxBytes		= CacheBytes.load(),
+									Size 				= TheMessage.GetPayload().size();
+			
+			if ( ( ( MaxMessages > 0 ) && ( Queue != MessageCache.end() ) && 
+						 ( Queue->second.size() >= MaxMessages ) ) ||
+					 ( ( MaxBytes > 0 ) && ( CachedBytes.load() + Size > MaxBytes ) ) )
+			{
+				DroppedMessages++;
+				return;
+			}
+			
 			// Then the message is cached for delayed sending once the response comes
 			// back from the network layer. In this case the receiver field is left 
 		  // uninitialised until the resolution response comes back from the 
 		  // Network Layer server.
 			
-			MessageCache.emplace( TheMessage.GetReceiver(), 
-														ExternalMessage( SenderAddress, ExternalAddress(), 
-																						 TheMessage.GetPayload() ) );
+			MessageCache[ TheMessage.GetReceiver() ].emplace_back( 
+				ExternalMessage( SenderAddress, ExternalAddress(), 
+												 TheMessage.GetSharedPayload() ), Now );
+			
+			if ( CacheTimeToLive.load().count() > 0 )
+				ArrivalOrder.emplace_back( Now, TheMessage.GetReceiver() );
+			
+			CachedMessages++;
+			CachedBytes += Size;
 		}
 	}
 
@@ -720,7 +1025,9 @@ private:
   // since a Theron Address  object initialised with a string will not check if 
   // this corresponds to a legal address before a message is being sent to this 
   // address. Hence, if the default names are used, then the explicit binding 
-  // of their addresses is not necessary.
+  // of their addresses is not necessary. By default the message cache holds 
+  // at most 1000 messages per receiver and 64 MiB of payloads in total, and 
+  // a message is kept for at most one minute.
 
 public:
     
@@ -728,7 +1035,13 @@ public:
   : Actor( ServerName ), 
     StandardFallbackHandler( ServerName ),
     SessionLayerMessages(), 
-    KnownActors(), MessageCache(),NewPeerSubscribers()
+    KnownActors(), 
+    CacheMessagesPerActor( 1000 ), CacheBytes( 64 * 1024 * 1024 ), 
+    CacheTimeToLive( std::chrono::seconds( 60 ) ), 
+    CachedMessages( 0 ), CachedBytes( 0 ), FlushedMessages( 0 ), 
+    DroppedMessages( 0 ), ExpiredMessages( 0 ),
+    MessageCache(), ArrivalOrder(), NewPeerSubscribers(),
+    CurrentVersion( 0 ), LoggedSince( 0 ), MembershipLog()
   { 
     RegisterHandler( this, &SessionLayer<ExternalMessage>::SubscribeToPeerDiscovery );
     RegisterHandler( this, &SessionLayer<ExternalMessage>::UnsubscribePeerDiscovery );
@@ -30,6 +30,11 @@
 
 #include <algorithm>
 
+// The actor names announced by multiplexed endpoints are read line by line 
+// from the message body with a string stream.
+
+#include <sstream>
+
 // Even though it is strictly unnecessary we include the boost shared pointers
 // which is probably included by Swiften because it is based on Boost shared 
 // pointers and not the standard library shared pointers. Unfortunately, 
@@ -366,10 +371,13 @@ void Link::PresenceNotification( JabberID ClientID,
     case Swift::Presence::Available :
       // The remote actor is now available and it should be registered with 
 			// the session layer as an available actor.
-      
-		  Send( ResolutionResponse( PresenceReceived->getFrom(), 
-						 						 Address( PresenceReceived->getFrom().getResource() ) ), 
-						Network::GetAddress( Network::Layer::Session ) );
+    {
+			ResolutionResponse Available( PresenceReceived->getFrom(), 
+						 				 Address( PresenceReceived->getFrom().getResource() ) );
+			
+			StoreResolution( Available );
+		  Send( Available, Network::GetAddress( Network::Layer::Session ) );
+		}
       
       // Then the new actor should also be known to the client, and if  
       // messages have been buffered waiting for this actor to become active 
@@ -382,8 +390,11 @@ void Link::PresenceNotification( JabberID ClientID,
       // from endpoint resources should be ignored.
 			
       if ( PresenceReceived->getFrom().getResource() != "endpoint" )
+		  {
+				ForgetResolution( JabberID( PresenceReceived->getFrom() ) );
 				Send( RemoveActor( PresenceReceived->getFrom() ), 
 							Network::GetAddress( Network::Layer::Session ) );
+			}
 	
 			// The local client must also remove references to the disappearing peer
 				
@@ -509,6 +520,269 @@ void Link::EndpointPresence( JabberID ClientID,
       DispatchKnownPeers( ClientID, NewEndpoint, TheRoster, Error );
     });
   }
+  
+  // A multiplexed link exchanges the actors with the remote endpoints as they
+  // become available.
+  
+  if ( Multiplexed )
+    EndpointAvailability( PresenceReceived );
+}
+
+// ---------------------------------------------------------------------------
+// Multiplexed connection
+// ---------------------------------------------------------------------------
+//
+// The actor names are sent one per line in the body of a message from the 
+// endpoint client to the remote endpoint client.
+
+void Link::AnnounceActors( const JabberID & RemoteEndpointClient, 
+													 const std::string & Subject, 
+													 const std::string & ActorNames )
+{
+  Swift::Message::ref XMPPMessage = Swift::Message::ref( new Swift::Message() );
+  
+  XMPPMessage->setType   ( Swift::Message::Chat );
+  XMPPMessage->setTo     ( RemoteEndpointClient );
+  XMPPMessage->setFrom   ( ProtocolID );
+  XMPPMessage->setSubject( Subject );
+  XMPPMessage->setBody   ( ActorNames );
+  
+  TransmitStanza( XMPPMessage );
+}
+
+// A new local actor is announced to all known remote endpoints, and it is 
+// only announced once even if its address is resolved several times.
+
+void Link::AddLocalActor( const std::string & ActorName )
+{
+  std::lock_guard< std::recursive_mutex > Lock( MultiplexGuard );
+  
+  if ( LocalActors.insert( ActorName ).second )
+    for ( auto & Remote : RemoteEndpoints )
+      AnnounceActors( Remote.second.EndpointClient, "ACTORS", ActorName );
+}
+
+// The removal of a local actor is announced in the same way.
+
+void Link::RemoveLocalActor( const std::string & ActorName )
+{
+  std::lock_guard< std::recursive_mutex > Lock( MultiplexGuard );
+  
+  if ( LocalActors.erase( ActorName ) > 0 )
+    for ( auto & Remote : RemoteEndpoints )
+      AnnounceActors( Remote.second.EndpointClient, "REMOVED", ActorName );
+}
+
+// When a remote endpoint becomes available, it is recorded and the local 
+// actors are sent to it, even if there are no local actors, so that the 
+// remote endpoint will also learn about this endpoint. When a remote endpoint
+// becomes unavailable, its actors are removed from the session layer. 
+// Presences from the endpoint client itself are ignored.
+
+void Link::EndpointAvailability( Swift::Presence::ref PresenceReceived )
+{
+  JabberID RemoteClient( PresenceReceived->getFrom() ),
+					 RemoteBareID( RemoteClient.toBare() );
+  
+  if ( RemoteBareID == ProtocolID.toBare() ) return;
+  
+  std::lock_guard< std::recursive_mutex > Lock( MultiplexGuard );
+  
+  switch ( PresenceReceived->getType() )
+  {
+    case Swift::Presence::Available :
+    {
+      RemoteEndpoints[ RemoteBareID ].EndpointClient = RemoteClient;
+      
+      std::string ActorNames;
+      
+      for ( const std::string & ActorName : LocalActors )
+				ActorNames += ActorName + "\n";
+      
+      AnnounceActors( RemoteClient, "ACTORS", ActorNames );
+    }
+    break;
+    case Swift::Presence::Unavailable :
+    {
+      auto Remote = RemoteEndpoints.find( RemoteBareID );
+      
+      if ( Remote != RemoteEndpoints.end() )
+      {
+				for ( const std::string & ActorName : Remote->second.Actors )
+				{
+					JabberID RemoteActor( RemoteBareID.getNode(), 
+															  RemoteBareID.getDomain(), ActorName );
+					
+					ForgetResolution( RemoteActor );
+					Send( RemoveActor( RemoteActor ), 
+								Network::GetAddress( Network::Layer::Session ) );
+				}
+				
+				RemoteEndpoints.erase( Remote );
+      }
+    }
+    break;
+    default:
+      break;
+  }
+}
+
+// Inbound messages to the endpoint client are first checked for being 
+// subscription requests or actor announcements, and otherwise the sending 
+// actor and the receiving actor are decoded from the subject lines before 
+// the message is forwarded to the session layer. Messages whose subject 
+// does not have the two address lines are ignored.
+
+void Link::MultiplexedInbound( Swift::Message::ref XMPPMessage )
+{
+  std::string Subject( XMPPMessage->getSubject() );
+  JabberID 		RemoteClient( XMPPMessage->getFrom() ),
+							RemoteBareID( RemoteClient.toBare() );
+  
+  if ( Subject == "SUBSCRIBE" )
+    SubscribeKnownPeers( ProtocolID, XMPPMessage );
+  else if ( ( Subject == "ACTORS" ) || ( Subject == "REMOVED" ) )
+  {
+    std::istringstream ActorNames( XMPPMessage->getBody().value_or( "" ) );
+    std::string 			 ActorName;
+    
+    std::lock_guard< std::recursive_mutex > Lock( MultiplexGuard );
+    
+    RemoteEndpoint & Remote( RemoteEndpoints[ RemoteBareID ] );
+    Remote.EndpointClient = RemoteClient;
+    
+    while ( std::getline( ActorNames, ActorName ) )
+      if ( !ActorName.empty() )
+      {
+				JabberID RemoteActor( RemoteBareID.getNode(), 
+															RemoteBareID.getDomain(), ActorName );
+				
+				if ( Subject == "ACTORS" )
+				{
+					if ( Remote.Actors.insert( ActorName ).second )
+					{
+						ResolutionResponse Available( RemoteActor, Address( ActorName ) );
+						
+						StoreResolution( Available );
+						Send( Available, Network::GetAddress( Network::Layer::Session ) );
+					}
+				}
+				else if ( Remote.Actors.erase( ActorName ) > 0 )
+				{
+					ForgetResolution( RemoteActor );
+					Send( RemoveActor( RemoteActor ), 
+								Network::GetAddress( Network::Layer::Session ) );
+				}
+      }
+  }
+  else
+  {
+    auto SenderEnd   = Subject.find( '\n' ),
+				 ReceiverEnd = ( SenderEnd == std::string::npos ? std::string::npos 
+																: Subject.find( '\n', SenderEnd + 1 ) );
+		
+    if ( ReceiverEnd != std::string::npos )
+      Send( OutsideMessage( 
+							JabberID( RemoteBareID.getNode(), RemoteBareID.getDomain(), 
+												Subject.substr( 0, SenderEnd ) ),
+							JabberID( ProtocolID.getNode(), ProtocolID.getDomain(), 
+												Subject.substr( SenderEnd + 1, 
+																				ReceiverEnd - SenderEnd - 1 ) ),
+							XMPPMessage->getBody().value_or( "" ), 
+							Subject.substr( ReceiverEnd + 1 ) ),
+						Network::GetAddress( Network::Layer::Session ) );
+  }
+}
+
+// An outbound message is sent to the endpoint client of the endpoint hosting
+// the receiving actor. The message is ignored if the remote endpoint is not 
+// known, which can only happen if it has become unavailable after the session
+// layer resolved the receiver.
+
+void Link::MultiplexedSend( const OutsideMessage & TheMessage )
+{
+  JabberID Receiver( TheMessage.GetRecipient() ), RemoteClient;
+  
+  {
+    std::lock_guard< std::recursive_mutex > Lock( MultiplexGuard );
+    
+    auto Remote = RemoteEndpoints.find( Receiver.toBare() );
+    
+    if ( Remote == RemoteEndpoints.end() ) return;
+    else RemoteClient = Remote->second.EndpointClient;
+  }
+  
+  Swift::Message::ref XMPPMessage = Swift::Message::ref( new Swift::Message() );
+  
+  XMPPMessage->setType   ( Swift::Message::Chat );
+  XMPPMessage->setTo     ( RemoteClient );
+  XMPPMessage->setFrom   ( ProtocolID );
+  XMPPMessage->setSubject( TheMessage.GetSender().getResource() + "\n" + 
+													 Receiver.getResource() + "\n" + 
+													 TheMessage.GetSubject() );
+  XMPPMessage->setBody   ( TheMessage.GetPayload() );
+  
+  TransmitStanza( XMPPMessage );
+}
+
+// The stanza is sent if the endpoint client is available, and kept until it 
+// is acknowledged if stream management is enabled for the connection. If the 
+// client is not available, the stanza is kept to be sent when the client is 
+// connected again.
+
+void Link::TransmitStanza( Swift::Message::ref XMPPMessage )
+{
+  ClientObjectPointer TheClient( Clients.at( ProtocolID ).TheClient );
+  
+  std::lock_guard< std::recursive_mutex > Lock( MultiplexGuard );
+  
+  if ( TheClient->isAvailable() )
+  {
+    TheClient->sendMessage( XMPPMessage );
+    
+    if ( TheClient->getStreamManagementEnabled() )
+      Outstanding.push_back( XMPPMessage );
+  }
+  else
+    Outstanding.push_back( XMPPMessage );
+  
+  if ( Outstanding.size() > OutstandingLimit )
+    Outstanding.pop_front();
+}
+
+// A disconnection with an error leads to a reconnection after the delay. The
+// timer must be kept until it fires, and it is therefore a member.
+
+void Link::EndpointDisconnected( void )
+{
+  ReconnectTimer = NetworkManager.getTimerFactory()->createTimer( 
+																												ReconnectDelay );
+  
+  ReconnectTimer->onTick.connect( [this](void)->void{
+    Clients.at( ProtocolID ).TheClient->connect( ClientsOptions );
+  });
+  
+  ReconnectTimer->start();
+}
+
+// When the endpoint client is connected, the outstanding messages are taken 
+// out and transmitted again. The remote endpoints have removed the actors of
+// this endpoint if they saw it as unavailable, and the presence is broadcast
+// for them to exchange the actors again. 
+
+void Link::EndpointReconnected( void )
+{
+  std::deque< Swift::Message::ref > Pending;
+  
+  {
+    std::lock_guard< std::recursive_mutex > Lock( MultiplexGuard );
+    Pending.swap( Outstanding );
+  }
+  
+  SendPresence( ProtocolID, Swift::Presence::Available );
+  
+  for ( auto & XMPPMessage : Pending )
+    TransmitStanza( XMPPMessage );
 }
 
 // ---------------------------------------------------------------------------
@@ -545,9 +819,12 @@ void Link::ResolveAddress( const ResolutionRequest & TheRequest,
 					TheSessionLayer );
 		
 		// Then the XMPP client should be created and connected if this local 
-		// actor is not already known.
+		// actor is not already known, unless the link is multiplexed and the 
+		// new actor just has to be announced to the remote endpoints.
 		
-		if ( Clients.find( ActorJID ) == Clients.end() ) 
+		if ( Multiplexed )
+			AddLocalActor( TheRequest.NewActor.AsString() );
+		else if ( Clients.find( ActorJID ) == Clients.end() ) 
 	  {
 	    auto TheClient = std::make_shared< Swift::Client >( 
 			     ActorJID, ServerPassword, &NetworkManager ); 
@@ -609,11 +886,18 @@ void Link::ResolveAddress( const ResolutionRequest & TheRequest,
 // Destroying a client is simply to take it out of the client map and 
 // delete it. Nothing happens if the client does not exist. Before removing 
 // the client record it is necessary to inform all peer that this client is 
-// unavailable.
+// unavailable. A multiplexed link announces the removal to the other 
+// endpoints instead.
 
 void Link::ActorRemoval( const RemoveActor & TheCommand, 
 												 const Address TheSessionLayer )
 {
+  if ( Multiplexed )
+  {
+		RemoveLocalActor( TheCommand.GlobalAddress.getResource() );
+		return;
+	}
+	
   auto CurrentClient = Clients.find( TheCommand.GlobalAddress );
   
   if ( CurrentClient != Clients.end() )
@@ -667,11 +951,19 @@ void Link::ClientRecord::SendMessage( const OutsideMessage & Message )
 // receiving a message for a remote actor. It will first look up the client 
 // corresponding to the sender's Jabber ID, and if then use the client's send 
 // message function. However, if the client does not exist, the message will 
-// simply be ignored.
+// simply be ignored. Messages from local actors on a multiplexed link are 
+// sent by the endpoint client, whereas the messages from the endpoint itself
+// are sent as before.
 
 void Link::OutboundMessage( const OutsideMessage & TheMessage, 
 														const Address From )
 {
+  if ( Multiplexed && !( TheMessage.GetSender() == ProtocolID ) )
+  {
+		MultiplexedSend( TheMessage );
+		return;
+	}
+	
   auto TheClientRecord = Clients.find( TheMessage.GetSender() );
   
   if ( TheClientRecord != Clients.end() )
@@ -690,14 +982,17 @@ Link::Link( const std::string & EndpointName,
 						const std::string & EndpointDomain,
 				    const std::string & TheServerPassword,
 				    const JabberID & InitialRemoteEndpoint,
-				    const std::string & ServerName )
+				    const std::string & ServerName, 
+						bool MultiplexActors )
 : Actor( ServerName ),
   StandardFallbackHandler( GetAddress().AsString() ),
   NetworkLayer< Theron::XMPP::OutsideMessage >( GetAddress().AsString() ),
   EventManager(), NetworkManager( &EventManager ),
   CommunicationLink( &Swift::SimpleEventLoop::run, std::ref(EventManager) ),
   ProtocolID( EndpointName, EndpointDomain, GetAddress().AsString() ),
-  ServerPassword( TheServerPassword )
+  ServerPassword( TheServerPassword ),
+  Multiplexed( MultiplexActors ), RemoteEndpoints(), LocalActors(),
+  Outstanding(), ReconnectTimer(), MultiplexGuard()
 {
   // Setting options for the clients. In this version we assume a secure 
   // and trusted network so we will not use TLS, and if TLS is switched off,
@@ -706,6 +1001,12 @@ Link::Link( const std::string & EndpointName,
   ClientsOptions.allowPLAINWithoutTLS = true;
   ClientsOptions.useTLS = ClientsOptions.Swift::ClientOptions::NeverUseTLS;
   
+  // Stream management acknowledgements are requested so that the messages 
+  // sent by a multiplexed endpoint client can be sent again if the connection
+  // is lost before they have been received by the server.
+  
+  ClientsOptions.useAcks = true;
+  
 	// There is no need to register the various message handlers for the interface
 	// with the session layer server since these have already been registered by 
 	// the network layer server.
@@ -757,8 +1058,38 @@ Link::Link( const std::string & EndpointName,
   
   TheClient->onMessageReceived.connect(
     [=](Swift::Message::ref XMPPMessage)->void {
-				SubscribeKnownPeers( ProtocolID, XMPPMessage );
+				if ( Multiplexed )
+					MultiplexedInbound( XMPPMessage );
+				else
+					SubscribeKnownPeers( ProtocolID, XMPPMessage );
     });
+  
+  // The multiplexed endpoint client carries the messages of all local actors,
+  // and it must therefore be reconnected if the connection is lost, and the 
+  // messages not acknowledged must be sent again when it is connected. Note 
+  // that the disconnect event has no error if the disconnect was requested.
+  
+  if ( Multiplexed )
+  {
+    TheClient->onConnected.connect( [=](void)->void { 
+					EndpointReconnected(); 
+		});
+		
+    TheClient->onDisconnected.connect( 
+			[=]( const boost::optional< Swift::ClientError > & Error )->void {
+					if ( Error ) EndpointDisconnected(); 
+		});
+		
+    TheClient->onStanzaAcked.connect( 
+			[=]( Swift::Stanza::ref Acknowledged )->void {
+					std::lock_guard< std::recursive_mutex > Lock( MultiplexGuard );
+					
+					auto Stanza = std::find( Outstanding.begin(), Outstanding.end(), 
+																	 Acknowledged );
+					
+					if ( Stanza != Outstanding.end() ) Outstanding.erase( Stanza );
+		});
+  }
 
   // All parts of the client record has now been initialised and it can be
   // stored in the internal map of connected clients. A subtle point is that 
@@ -798,7 +1129,8 @@ void Network::CreateNetworkLayer( void )
 {
 	Network::CreateServer< Network::Layer::Network, XMPP::Link >
 											 ( Actor::GetAddress().AsString(), Domain, 
-												 ServerPassword, InitialRemoteEndpoint );
+												 ServerPassword, InitialRemoteEndpoint, "XMPPLink",
+												 Multiplexed );
 }
 
 void Network::CreateSessionLayer( void )
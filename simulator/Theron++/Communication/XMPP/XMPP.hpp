@@ -54,6 +54,8 @@
 #include <functional> 										// For the hash functions
 #include <stdexcept>											// For standard exceptions
 #include <optional>												// For presence messages
+#include <deque>													// Unacknowledged stanzas
+#include <mutex>													// Multiplexing state
 
 // Generic frameworks - Theron for actors and Swiften for XMPP
 
@@ -176,7 +178,7 @@ public:
 	// the base class link message accordingly.
   
   inline OutsideMessage( const JabberID & From, const JabberID & To ,
-											   const std::string & ThePayload, 
+											   const Theron::SerialMessage::SharedPayload & ThePayload, 
 											   const std::string TheSubject = std::string()  )
   : Theron::LinkMessage< JabberID >( From, To, ThePayload ), 
     Subject( TheSubject )
@@ -188,7 +190,7 @@ public:
 	inline OutsideMessage( const Theron::LinkMessage< JabberID > & BasicMessage, 
 												 const std::string TheSubject = std::string() )
 	: OutsideMessage( BasicMessage.GetSender(), BasicMessage.GetRecipient(), 
-										BasicMessage.GetPayload(), TheSubject )
+										BasicMessage.GetSharedPayload(), TheSubject )
 	{ }
 	
   // A copy constructor is necessary to queue messages 
@@ -248,6 +250,13 @@ public:
 // connect request has ha Jabber ID of the form "me@localhost" then there must
 // be an XMPP server running at "localhost", otherwise the connection will 
 // tacitly fail and not be connected. 
+//
+// Having one client per actor means one TCP connection and one XMPP session
+// per actor, and endpoints with many actors will then have many connections 
+// and a slow start up as all the clients log in. The link can therefore 
+// optionally be multiplexed, where the endpoint client carries the messages 
+// of all the local actors, see the multiplexed connection section below. All 
+// endpoints of the actor system must use the same mode.
 
 class Link : public virtual Actor,
 						 public virtual StandardFallbackHandler,
@@ -522,6 +531,101 @@ private:
   void EndpointPresence( JabberID ClientID, 
 												 Swift::Presence::ref PresenceReceived );
 	
+  // ---------------------------------------------------------------------------
+  // MULTIPLEXED CONNECTION
+  // ---------------------------------------------------------------------------
+  //
+  // In the multiplexed mode no clients are created for the local actors, and 
+  // all messages are sent and received by the endpoint client. The actors 
+  // keep their Jabber IDs with the actor name as the resource, but an XMPP 
+  // session has only one resource and the server will stamp the messages with
+  // the Jabber ID of the endpoint client. The messages are therefore addressed 
+  // to the remote endpoint client, and the resources of the sending actor and 
+  // the receiving actor are given as the two first lines of the subject, 
+  // before the subject of the outside message.
+  //
+  // Since the actors do not have their own presence, each endpoint tells the 
+  // other endpoints about its actors with messages to their endpoint clients. 
+  // The subject "ACTORS" has the names of actors that have become available 
+  // as the lines of the body, and the subject "REMOVED" has the names of the
+  // actors that have been removed. The actors are sent to a remote endpoint 
+  // when it becomes available, and new actors are sent to all the available 
+  // endpoints. When a remote endpoint becomes unavailable, all its actors 
+  // are removed from the session layer. 
+	
+  const bool Multiplexed;
+  
+  class RemoteEndpoint
+  {
+  public:
+  	
+  	JabberID 												EndpointClient;
+  	std::unordered_set< std::string > Actors;
+  };
+  
+  // The remote endpoints are stored by their bare Jabber ID, which is also the 
+  // bare Jabber ID of their actors.
+  
+  std::unordered_map< JabberID, RemoteEndpoint > RemoteEndpoints;
+  std::unordered_set< std::string > 						 LocalActors;
+  
+  // Stream management (XEP-0198) is enabled for the endpoint client, and the 
+  // server will then acknowledge the stanzas it has received. The messages 
+  // sent are kept until they are acknowledged, and the messages sent while 
+  // the client is disconnected are kept until it is connected again. When the
+  // connection to the server is lost, the client is reconnected after a short
+  // delay, and the outstanding messages are sent again. A message may then be
+  // delivered twice if the acknowledgement was lost with the connection. The
+  // number of outstanding messages is bounded, and the oldest messages are 
+  // dropped if the server does not acknowledge the messages.
+  
+  std::deque< Swift::Message::ref > Outstanding;
+  Swift::Timer::ref 								ReconnectTimer;
+  
+  static constexpr std::size_t OutstandingLimit = 10000;
+  static constexpr int 				 ReconnectDelay 	= 1000; // ms
+  
+  // The multiplexing state is changed by the actor when actors are added or 
+  // removed and messages sent, and by the event manager thread when messages
+  // and presences are received, and it must therefore be protected.
+  
+  std::recursive_mutex MultiplexGuard;
+  
+  // The announcement of actors sends the actor names with the given subject 
+  // to the given remote endpoint client. 
+  
+  void AnnounceActors( const JabberID & RemoteEndpointClient, 
+											 const std::string & Subject, 
+											 const std::string & ActorNames );
+  
+  // Local actors are added and removed by the address resolution and the 
+  // actor removal, and the changes are announced to all remote endpoints.
+  
+  void AddLocalActor   ( const std::string & ActorName );
+  void RemoveLocalActor( const std::string & ActorName );
+  
+  // The availability of remote endpoints is captured from the presences 
+  // received by the endpoint client, and the messages received by the 
+  // endpoint client are either announcements, subscription requests, or 
+  // messages for local actors.
+  
+  void EndpointAvailability( Swift::Presence::ref PresenceReceived );
+  void MultiplexedInbound  ( Swift::Message::ref  XMPPMessage );
+  
+  // Outbound messages are encoded with the actor resources and transmitted 
+  // by the endpoint client, which keeps the messages until they are 
+  // acknowledged.
+  
+  void MultiplexedSend( const OutsideMessage & TheMessage );
+  void TransmitStanza ( Swift::Message::ref XMPPMessage );
+  
+  // When the endpoint client is disconnected because of an error a reconnect
+  // is scheduled, and when it is connected again the presence is broadcast,
+  // the local actors announced, and the outstanding messages sent. 
+  
+  void EndpointDisconnected( void );
+  void EndpointReconnected ( void );
+	
 	// ---------------------------------------------------------------------------
   // Adding and removing actors
   // ---------------------------------------------------------------------------
@@ -557,11 +661,15 @@ public:
   // ---------------------------------------------------------------------------
   // CONSTRUCTOR & DESTRUCTOR
   // ---------------------------------------------------------------------------
+  //
+  // The link is multiplexed if requested, and otherwise one client will be 
+  // created for each local actor.
   
   Link( const std::string & EndpointName, const std::string & EnpointDomain, 
 				const std::string & ServerPassword,
 				const JabberID & InitialRemoteEndpoint = JabberID(),
-				const std::string & ServerName = "XMPPLink"  );
+				const std::string & ServerName = "XMPPLink", 
+				bool MultiplexActors = false );
   
   virtual ~Link();
     
@@ -608,6 +716,7 @@ protected:
 	
   const std::string ServerPassword;
   const JabberID    InitialRemoteEndpoint;
+  const bool 				Multiplexed;
 	
 	// The virtual functions to create the actors are implemented in the source
 	// file for the XMPP link
@@ -619,14 +728,17 @@ protected:
   // The constructor is only invoking the end point constructor and forward  
   // the Initialiser object to the base class. Note that the initialiser must
   // be set by the Network End Point's Set Initialiser function when this 
-  // constructor is called.
+  // constructor is called. The link will carry all local actors on one 
+  // connection if the multiplexed flag is set.
 	
   Network( const std::string & Name, const std::string & Location, 
 					 const std::string & Password,
-					 const JabberID & AnotherPeer = JabberID() )
+					 const JabberID & AnotherPeer = JabberID(), 
+					 bool MultiplexActors = false )
   : Actor( Name ),
     Theron::Network( Name, Location ),
-    ServerPassword( Password ), InitialRemoteEndpoint( AnotherPeer )
+    ServerPassword( Password ), InitialRemoteEndpoint( AnotherPeer ), 
+    Multiplexed( MultiplexActors )
   { }
   
   // The virtual destructor is currently not doing anything
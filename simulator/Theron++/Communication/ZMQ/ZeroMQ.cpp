@@ -15,6 +15,7 @@ License: LGPL 3.0
 #include <cstdio>												// For sscanf
 #include <stdexcept>										// Standard exceptions
 #include <sstream>											// For error reporting
+#include <cstdint>											// Batch message counts
 
 #include <sys/types.h>									// Types used for IP address lookup
 #include <ifaddrs.h>                    // The getifaddrs function
@@ -340,7 +341,8 @@ const std::map< std::string, Theron::ZeroMQ::OutsideMessage::Type > TypeMap
 		{ "Remove",    Theron::ZeroMQ::OutsideMessage::Type::Remove    },
 		{ "Roster",    Theron::ZeroMQ::OutsideMessage::Type::Roster    },
 		{ "Message",   Theron::ZeroMQ::OutsideMessage::Type::Message   },
-		{ "Data",      Theron::ZeroMQ::OutsideMessage::Type::Data      } };
+		{ "Data",      Theron::ZeroMQ::OutsideMessage::Type::Data      },
+		{ "Batch",     Theron::ZeroMQ::OutsideMessage::Type::Batch     } };
 		
 using TypeRecord = 
 			std::pair< std::string, Theron::ZeroMQ::OutsideMessage::Type >;
@@ -401,13 +403,18 @@ Theron::ZeroMQ::OutsideMessage::OutsideMessage(zmqpp::message & ReceivedMessage)
 // Converting the outside message to a set of ZMQ frames is slightly easier 
 // since all fields does exist in this case. 
 
+void Theron::ZeroMQ::OutsideMessage::Append( 
+		 zmqpp::message & NetworkMessage ) const
+{
+	NetworkMessage << Type2String() << SenderAddress << ReceiverAddress 
+								 << Payload.Get();
+}
+
 void Theron::ZeroMQ::OutsideMessage::Send( zmqpp::socket & NetworkSocket ) const
 {
 	zmqpp::message NetworkMessage;
 	
-	NetworkMessage << Type2String() << SenderAddress << ReceiverAddress 
-								 << Payload;
-	
+	Append( NetworkMessage );
 	NetworkSocket.send( NetworkMessage );
 }
 
@@ -521,6 +528,7 @@ void Theron::ZeroMQ::Link::FoundLocalActor(
 													 TheResponse.ActorRequested, 
 													 TheResponse.RequestingEndpoint );
 	
+	FlushBatch( TheResponse.RequestingEndpoint.GetIP() );
 	TheReply.Send( Outbound.at( TheResponse.RequestingEndpoint.GetIP() ) );
 }
 
@@ -542,7 +550,11 @@ void Theron::ZeroMQ::Link::OutboundMessage( const OutsideMessage & TheMessage,
 	switch ( TheMessage.GetType() )
 	{
 		case OutsideMessage::Type::Message : 
-			TheMessage.Send( Outbound.at( TheMessage.GetRecipient().GetIP() ) );
+			if ( !BatchingEnabled() )
+				TheMessage.Send( Outbound.at( TheMessage.GetRecipient().GetIP() ) );
+			else
+				QueueMessage( TheMessage.GetRecipient().GetIP(), TheMessage, 
+											TheMessage.GetPayload().size() );
 			break;
 		default:
 		{
@@ -584,20 +596,41 @@ void Theron::ZeroMQ::Link::InboundMessageHandler( void )
 	Inbound.receive( ReceivedMessage );
 	ReceivedMessage >> DevNull;
 	
-	OutsideMessage TheMessage( ReceivedMessage );
+	// A batch is recognised by its first frame, and the number of messages is 
+	// read before the messages are constructed from the following frames.
 	
+	if ( ReceivedMessage.get( 1 ) == "Batch" )
+  {
+		std::uint32_t NumberOfMessages = 0;
+		
+		ReceivedMessage >> DevNull >> NumberOfMessages;
+		
+		for ( std::uint32_t Count = 0; Count < NumberOfMessages; Count++ )
+			HandleInboundMessage( OutsideMessage( ReceivedMessage ) );
+	}
+	else
+		HandleInboundMessage( OutsideMessage( ReceivedMessage ) );
+}
+
+// A single message is dispatched according to its type
+
+void Theron::ZeroMQ::Link::HandleInboundMessage( 
+		 const OutsideMessage & TheMessage )
+{
 	switch ( TheMessage.GetType() )
   {
 		case OutsideMessage::Type::Address :
 			// An request for address resolution has been completed with the endpoint
 			// hosting the actor responding with the actor's address that is indicated
-			// as the sender of the message. It will be sent to the session layer 
-			// as a resolution response message.
-			
-			Send( ResolutionResponse( TheMessage.GetSender(), 
-																TheMessage.GetSender().GetActorAddress() ), 
-																TheMessage.GetRecipient().GetActorAddress() ); 
-			
+			// as the sender of the message. It will be cached and sent to the 
+			// session layer as a resolution response message.
+		  {
+				ResolutionResponse Resolved( TheMessage.GetSender(), 
+																		 TheMessage.GetSender().GetActorAddress() );
+				
+				StoreResolution( Resolved );
+				Send( Resolved, TheMessage.GetRecipient().GetActorAddress() ); 
+			}
 			break;
 		case OutsideMessage::Type::Message :
 			// A normal message is just forwarded to the session server so that the 
@@ -691,6 +724,7 @@ void Theron::ZeroMQ::Link::SubscribedMessageHander( void )
 			
 			break;
 		case OutsideMessage::Type::Remove :
+			ForgetResolution( TheMessage.GetSender() );
 			Send( RemoveActor( TheMessage.GetSender() ), 
 						Network::GetAddress( Network::Layer::Session ) );
 			break;
@@ -703,6 +737,34 @@ void Theron::ZeroMQ::Link::SubscribedMessageHander( void )
 	}
 }
 
+/*=============================================================================
+
+ Batching
+
+=============================================================================*/
+//
+// Sending a batch with one message is just sending that message, and larger 
+// batches are sent as one multipart message.
+
+void Theron::ZeroMQ::Link::SendBatch( const IPAddress & Peer, 
+																			const std::vector< OutsideMessage > & Messages )
+{
+	if ( Messages.size() == 1 )
+		Messages.front().Send( Outbound.at( Peer ) );
+	else
+  {
+		zmqpp::message NetworkMessage;
+		
+		NetworkMessage << std::string( "Batch" ) 
+									 << static_cast< std::uint32_t >( Messages.size() );
+		
+		for ( const OutsideMessage & TheMessage : Messages )
+			TheMessage.Append( NetworkMessage );
+		
+		Outbound.at( Peer ).send( NetworkMessage );
+	}
+}
+
 /*=============================================================================
 
  Link Constructor
@@ -730,6 +792,7 @@ Theron::ZeroMQ::Link::Link( const IPAddress & InitialRemoteEndpoint,
 														const std::string & ServerName )
 : Actor( ServerName ), StandardFallbackHandler( GetAddress().AsString() ),
   NetworkLayer< OutsideMessage >( GetAddress().AsString() ),
+  MessageBatching< IPAddress, OutsideMessage >( GetAddress().AsString() ),
   Publish   ( ZMQContext, zmqpp::socket_type::publish   ),
   Subscribe ( ZMQContext, zmqpp::socket_type::subscribe ),
   Inbound   ( ZMQContext, zmqpp::socket_type::router    ),
@@ -803,16 +866,148 @@ Theron::ZeroMQ::Link::Link( const IPAddress & InitialRemoteEndpoint,
 	RegisterHandler( this, &Link::FoundLocalActor );
 }
 
+// The pending batches are sent when the link closes since the sockets are 
+// gone when the batching base class is destroyed. The messages already 
+// queued, including a batch time out, are handled first so that the batches 
+// are not sent concurrently by a handler.
+
+Theron::ZeroMQ::Link::~Link( void )
+{
+	DrainMailbox();
+	FlushAllBatches();
+}
+
 /*==============================================================================
 
  Publishing
 
 ==============================================================================*/
 //
+// -----------------------------------------------------------------------------
+// Topic index
+// -----------------------------------------------------------------------------
+//
+// A known topic is found by its pointer. Otherwise the path of the topic 
+// string is created in the trie, and the end node records the topic and its 
+// publisher.
+
+bool Theron::ZeroMQ::PublishingLink::TopicIndex::Insert(
+		 const Topic & TheTopic, const Address & ThePublisher )
+{
+	if ( Known.find( TheTopic.get() ) != Known.end() )
+		return false;
+	
+	Node * Current = &Root;
+	
+	for ( char Character : *TheTopic )
+  {
+		auto & Child = Current->Children[ Character ];
+		
+		if ( !Child )
+			Child = std::make_unique< Node >();
+		
+		Current = Child.get();
+	}
+	
+	// A different publisher object may have interned the same topic string, for
+	// instance if the actor has been re-created, and the previous topic pointer 
+	// must then be forgotten as the node now belongs to the new publisher.
+	
+	if ( Current->TheTopic )
+		Known.erase( Current->TheTopic.get() );
+	
+	Current->TheTopic  = TheTopic;
+	Current->Publisher = ThePublisher;
+	Known.emplace( TheTopic.get(), Current );
+	
+	return true;
+}
+
+// Matching a subscription follows the prefix string down the trie, and if all
+// characters of the prefix are found, all topics below the reached node are 
+// visited.
+
+void Theron::ZeroMQ::PublishingLink::TopicIndex::Match( 
+	const std::string & Prefix, 
+	const std::function< void( const Topic &, const Address & ) > & Action ) const
+{
+	const Node * Current = &Root;
+	
+	for ( char Character : Prefix )
+  {
+		auto Child = Current->Children.find( Character );
+		
+		if ( Child == Current->Children.end() )
+			return;
+		
+		Current = Child->second.get();
+	}
+	
+	Visit( *Current, Action );
+}
+
+void Theron::ZeroMQ::PublishingLink::TopicIndex::Visit( const Node & Current, 
+	const std::function< void( const Topic &, const Address & ) > & Action ) const
+{
+	if ( Current.TheTopic )
+		Action( Current.TheTopic, Current.Publisher );
+	
+	for ( const auto & Child : Current.Children )
+		Visit( *Child.second, Action );
+}
+
+// Removing a topic clears its end node and then prunes the branches that do 
+// no longer lead to any topic on the way back up from the recursion.
+
+bool Theron::ZeroMQ::PublishingLink::TopicIndex::Erase( Node & Current, 
+		 const std::string & TheTopic, std::size_t Position )
+{
+	if ( Position == TheTopic.size() )
+  {
+		Current.TheTopic.reset();
+		Current.Publisher = Address();
+	}
+	else
+  {
+		auto Child = Current.Children.find( TheTopic[ Position ] );
+		
+		if ( ( Child != Current.Children.end() ) && 
+				 Erase( *Child->second, TheTopic, Position + 1 ) )
+			Current.Children.erase( Child );
+	}
+	
+	return !Current.TheTopic && Current.Children.empty();
+}
+
+// The topics of a publisher are first collected from the known topics, and 
+// then removed one by one. The topic pointers are kept alive by the collected
+// shared pointers until the topics are removed from the trie.
+
+void Theron::ZeroMQ::PublishingLink::TopicIndex::Remove( 
+		 const Address & ThePublisher )
+{
+	std::vector< Topic > PublishedTopics;
+	
+	for ( const auto & TopicRecord : Known )
+		if ( TopicRecord.second->Publisher == ThePublisher )
+			PublishedTopics.push_back( TopicRecord.second->TheTopic );
+	
+	for ( const Topic & TheTopic : PublishedTopics )
+  {
+		Known.erase( TheTopic.get() );
+		Erase( Root, *TheTopic, 0 );
+	}
+}
+
+// -----------------------------------------------------------------------------
+// Subscription events
+// -----------------------------------------------------------------------------
+//
 // When a subscriber wants to subscribe or unsubscribe the event handler is 
-// called. Only subscriptions are processed for now, and if the topic 
-// wanted by the subscriber is in the cache, it will be published again trusting
-// that other subscribers are able to filter out this double posting.
+// called. Only subscriptions are processed for now, and all the known topics
+// matching the subscription prefix will be published again by their actors 
+// from their last good value caches, trusting that other subscribers are 
+// able to filter out this double posting.
 
 void Theron::ZeroMQ::PublishingLink::SubscriptionEvents( void )
 {
@@ -830,25 +1025,23 @@ void Theron::ZeroMQ::PublishingLink::SubscriptionEvents( void )
 	// Parsing the event
 	
 	unsigned short int Command;
-	std::string EventString, Topic;
+	std::string EventString, Prefix;
 	
 	TheEvent >> EventString;
 	std::istringstream EventRecord( EventString );
 	
-	EventRecord >> Command >> std::ws >> Topic;
+	EventRecord >> Command >> std::ws >> Prefix;
 	
-	// Then check the cache and re-publish the last known value if this was a 
-	// subscription. If the topic is unknown, nothing will be done by this node
-	// as the subscription was probably made before any actor published on this 
-	// topic so the subscriber just have to wait.
+	// Then ask the publishers of the matching topics to re-publish their last 
+	// known values if this was a subscription. If no topic matches, nothing 
+	// will be done by this node as the subscription was probably made before 
+	// any actor published on this topic so the subscriber just have to wait.
 	
 	if ( Command == static_cast< unsigned short int>( EventType::Subscribe ) )
-  {
-		auto ThePublisher = Publishers.find( Topic );
-		
-		if ( ThePublisher != Publishers.end() )
-			Send( SendLastGoodValue( Topic ), ThePublisher->second );
-	}
+		Publishers.Match( Prefix, 
+			[this]( const Topic & TheTopic, const Address & ThePublisher )->void{ 
+				Send( SendLastGoodValue( TheTopic ), ThePublisher ); 
+			});
 }
 
 // -----------------------------------------------------------------------------
@@ -862,7 +1055,7 @@ void Theron::ZeroMQ::PublishingLink::SubscriptionEvents( void )
 void Theron::ZeroMQ::Publisher::NewSubscription(
 	const PublishingLink::SendLastGoodValue & Broadcast, const Address TheLink)
 {
-	auto ValueRecord = LastGoodValue.find( Broadcast.Topic );
+	auto ValueRecord = LastGoodValue.find( *Broadcast.Topic );
 	
 	if ( ValueRecord != LastGoodValue.end() )
 		Send( PublishingLink::PublishableMessage( Broadcast.Topic, 
@@ -879,31 +1072,22 @@ void Theron::ZeroMQ::PublishingLink::DispatchMessage(
 	
 	zmqpp::message LinkMessage;
 	
-	LinkMessage << TheMessage.Topic << TheMessage.Payload;
+	LinkMessage << *TheMessage.Topic << TheMessage.Payload.Get();
 	DataPublisher.send( LinkMessage );
 	
-	// Then storing the address of the actor owning this topic. If the topic is 
-	// known already the actor address will be overwritten by itself, but this 
-	// is probably as efficient as testing for this case.
+	// Then storing the address of the actor owning this topic. A known topic 
+	// is recognised by its pointer, and it is only inserted into the topic 
+	// index the first time it is published.
 	
-	Publishers[ TheMessage.Topic ] = ThePublisher;
+	Publishers.Insert( TheMessage.Topic, ThePublisher );
 }
 
-// When a publisher closes, all its topics should be deleted. Given that the 
-// unordered map keeps the relative order of the elements when an element is 
-// deleted, the lookup on the value field, i.e. the address of the publisher as
-// the second field of an element in the map, can be done in one iteration.
+// When a publisher closes, all its topics should be deleted from the index.
 
 void Theron::ZeroMQ::PublishingLink::DeletePublisher(
 	const ClosePublisher & TheCommand, const Address ThePublisher )
 {
-	auto PublisherRecord = Publishers.begin();
-	
-	while ( PublisherRecord != Publishers.end() )
-		if( PublisherRecord->second == ThePublisher )
-			PublisherRecord = Publishers.erase( PublisherRecord );
-		else
-			++PublisherRecord;
+	Publishers.Remove( ThePublisher );
 }
 
 // -----------------------------------------------------------------------------
@@ -916,7 +1100,7 @@ Theron::ZeroMQ::PublishingLink::PublishingLink(
 	const std::string & RemoteLinkServerName, const std::string & ServerName)
 : Actor( ServerName ), StandardFallbackHandler( GetAddress().AsString() ),
   Link( InitialRemoteEndpoint, RemoteLinkServerName, GetAddress().AsString() ),
-  DataPublisher( GetContext(), zmqpp::socket_type::xpublish )
+  DataPublisher( GetContext(), zmqpp::socket_type::xpublish ), Publishers()
 {
 	DataPublisher.set( zmqpp::socket_option::xpub_verbose, true );
 	DataPublisher.bind( TCPAddress( GetNetworkAddress().GetIP(), 
@@ -933,7 +1117,7 @@ Theron::ZeroMQ::PublishingLink::PublishingLink(
 
 Theron::ZeroMQ::Publisher::Publisher(const std::string Name)
 : Actor( Name ), StandardFallbackHandler( GetAddress().AsString() ),
-  LastGoodValue()
+  LastGoodValue(), Topics()
 {
 	RegisterHandler( this, &Publisher::NewSubscription );
 }
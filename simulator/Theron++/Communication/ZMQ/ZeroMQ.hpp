@@ -121,6 +121,9 @@ License: LGPL 3.0
 #include <typeinfo>						// For published message types
 #include <typeindex>          // To store typeIDs in containers
 #include <type_traits>        // For useful meta programming
+#include <vector>             // Messages pending in a batch
+#include <chrono>             // Batching delay
+#include <functional>         // Actions on matching topics
 
 #include <zmqpp.hpp>					// ZeroMQ bindings for C++
 #include <boost/asio/ip/address.hpp> // IP address class
@@ -132,6 +135,7 @@ License: LGPL 3.0
 #include "StandardFallbackHandler.hpp" // Catching wrongly sent messages if any
 #include "SerialMessage.hpp"  // Base class for serial network messages
 #include "DeserializingActor.hpp"      // Actor receiving serial messages
+#include "MessageBatching.hpp" // Coalescing outbound messages
 
 namespace Theron::ZeroMQ
 {
@@ -407,7 +411,8 @@ public:
 		Remove,           // An actor is being removed from the system
 		Roster,						// IP addresses of the peers to subscribe to
 		Message,					// Normal message between two actors
-		Data							// Raw data
+		Data,							// Raw data
+		Batch							// Several messages in one multipart message
 	};
 	
   // ---------------------------------------------------------------------------
@@ -443,8 +448,8 @@ public:
 	
 	inline OutsideMessage( Type Category, const NetworkAddress & From, 
 												 const NetworkAddress & To, 
-												 const SerialMessage::Payload & ThePayload 
-														 = SerialMessage::Payload() )
+												 const SerialMessage::SharedPayload & ThePayload 
+														 = SerialMessage::SharedPayload() )
 	: LinkMessage< NetworkAddress >( From, To, ThePayload ), 
 	  MessageType( Category )
 	{ }
@@ -466,8 +471,8 @@ public:
 	// will be set to "Message"
 	
 	OutsideMessage( const NetworkAddress & From, const NetworkAddress & To, 
-									const SerialMessage::Payload & ThePayload 
-									    = SerialMessage::Payload() )
+									const SerialMessage::SharedPayload & ThePayload 
+									    = SerialMessage::SharedPayload() )
 	: OutsideMessage( Type::Message, From, To, ThePayload )
 	{ }
 	
@@ -496,6 +501,11 @@ public:
 	
 	void Send( zmqpp::socket & NetworkSocket ) const;
 	
+	// The frames of the message can also be appended to a multipart message 
+	// containing a batch of messages for the same peer.
+	
+	void Append( zmqpp::message & NetworkMessage ) const;
+	
 	// When sending the message over the network it is necessary to encode the 
 	// message type. This is done as a string.
 	
@@ -516,7 +526,8 @@ public:
 
 class Link : virtual public Actor,
 						 virtual public StandardFallbackHandler,
-						 public NetworkLayer< OutsideMessage >
+						 public NetworkLayer< OutsideMessage >,
+						 public MessageBatching< IPAddress, OutsideMessage >
 {
 	// The server has a ZMQ context (thread) and a publisher socket for broadcast
 	// of messages to remote subscribers like the other endpoints, a router 
@@ -582,6 +593,24 @@ private:
 	
 	void AddNewPeer( const IPAddress & PeerIP );
 	
+  // ---------------------------------------------------------------------------
+  // Batching
+  // ---------------------------------------------------------------------------
+	//
+	// Bursts of many small messages to the same peer can be coalesced into one 
+	// multipart message of type Batch holding the number of messages followed 
+	// by the frames of each message. The batches are kept by the message 
+	// batching base class, see MessageBatching.hpp, and enabled by its 
+	// SetBatching function. A batch with only one message is sent as a normal 
+	// message.
+	
+protected:
+	
+	virtual void SendBatch( const IPAddress & Peer, 
+									const std::vector< OutsideMessage > & Messages ) override;
+	
+private:
+	
 	// ---------------------------------------------------------------------------
 	// Actor address management
 	// ---------------------------------------------------------------------------
@@ -682,6 +711,11 @@ private:
 	
 	void InboundMessageHandler  ( void );
 	
+	// A received batch is split into the messages it contains, and each of 
+	// them is handled by the function handling a single inbound message.
+	
+	void HandleInboundMessage( const OutsideMessage & TheMessage );
+	
 	// The message handler for broadcast messages will handle subscription 
 	// requests by connecting to the new peer, and forward address resolution 
 	// commands to the the session layer.
@@ -740,6 +774,10 @@ public:
 			  const std::string & RemoteLinkServerName = "ZMQLink", 
 			  const std::string & ServerName = "ZMQLink" );
 	
+	// The destructor sends the pending batches.
+	
+	virtual ~Link( void );
+	
 }; // End Link layer server class
    // Note that the link extension for publishing and subscribing is defined 
    // after the session layer definition.
@@ -910,7 +948,6 @@ class PublishingLink : virtual public Actor,
 private:
 	
 	zmqpp::socket DataPublisher;
-	std::unordered_map< std::string, Address > Publishers;
 	
 	// The topic string is defined similar to a Jabber ID of the form 
 	// "actorname@endpoint/messageID" since an actor may publish several 
@@ -947,6 +984,85 @@ private:
 										 typeid( MessageType ).name() );
 	}
 	
+  // ---------------------------------------------------------------------------
+  // Topic index
+  // ---------------------------------------------------------------------------
+	//
+	// A topic is formatted only once for each message type an actor publishes, 
+	// and the publisher keeps the resulting string as a shared, immutable topic
+	// that is passed by pointer with every message it publishes. The topic 
+	// pointer is therefore the identity of the topic for as long as the 
+	// publisher exists.
+	
+	using Topic = std::shared_ptr< const std::string >;
+	
+	// The topics are indexed by a character trie where each topic string ends 
+	// in a node recording the topic and the actor publishing it. ZeroMQ 
+	// subscriptions are prefix matches, so a subscription for "actor@" should 
+	// match all message types published by that actor, and the empty 
+	// subscription matches every topic. Such a subscription is resolved by 
+	// finding the node for the prefix and visiting the topics of the sub-tree 
+	// below it, in stead of comparing the subscription with every known topic.
+	// The topics already in the index are also recorded by their pointer so 
+	// that publishing a known topic is a single hash lookup.
+	
+	class TopicIndex
+	{
+	private:
+		
+		class Node
+		{
+		public:
+			
+			std::map< char, std::unique_ptr< Node > > Children;
+			Topic 	TheTopic;
+			Address Publisher;
+			
+			Node( void )
+			: Children(), TheTopic(), Publisher()
+			{ }
+		};
+		
+		Node Root;
+		std::unordered_map< const std::string *, Node * > Known;
+		
+		// Erasing a topic removes the nodes no longer leading to any topic, and 
+		// the recursive helper returns true if the given node can be removed.
+		
+		bool Erase( Node & Current, const std::string & TheTopic, 
+								std::size_t Position );
+		
+		// Visiting the topics of a sub-tree is also recursive
+		
+		void Visit( const Node & Current, 
+		const std::function< void( const Topic &, const Address & ) > & Action ) 
+		const;
+		
+	public:
+		
+		// A topic is inserted for its publisher unless it is already known, and 
+		// the function returns true if the topic was new. 
+		
+		bool Insert( const Topic & TheTopic, const Address & ThePublisher );
+		
+		// The subscription matching calls the given action for each topic 
+		// starting with the subscribed prefix.
+		
+		void Match( const std::string & Prefix, 
+		const std::function< void( const Topic &, const Address & ) > & Action ) 
+		const;
+		
+		// All topics of a publisher can be removed when the publisher closes
+		
+		void Remove( const Address & ThePublisher );
+		
+		TopicIndex( void )
+		: Root(), Known()
+		{ }
+	};
+	
+	TopicIndex Publishers;
+	
   // ---------------------------------------------------------------------------
   // Supporting subscribers
   // ---------------------------------------------------------------------------
@@ -971,9 +1087,9 @@ private:
 	{
 	public:
 		
-		const std::string Topic;
+		const PublishingLink::Topic Topic;
 		
-		SendLastGoodValue( const std::string & GivenTopic )
+		SendLastGoodValue( const PublishingLink::Topic & GivenTopic )
 		: Topic( GivenTopic )
 		{ }
 		
@@ -989,8 +1105,8 @@ private:
 	};
 	
 	// There is a handler called when there is a subscription event on the 
-	// publisher socket, and this will send the message to the actor if there 
-	// is already a publisher for this topic. Otherwise, it will do nothing.
+	// publisher socket, and this will send the message to the actor publishing
+	// each known topic matching the subscription. Otherwise, it will do nothing.
 	
 	void SubscriptionEvents( void );
 	
@@ -1005,19 +1121,20 @@ private:
 	
 	// When an actor wants to publish a message it will implicitly send a message 
 	// to this link actor containing the topic for which the message is published
-	// and the serialised message content. The message structure is simple
+	// and the serialised message content. The message structure is simple, and 
+	// the topic is the publisher's interned topic for the message type.
 	
 	class PublishableMessage
 	{
 	public:
 		
-		const std::string Topic;
-		const SerialMessage::Payload Payload;
+		const PublishingLink::Topic Topic;
+		const SerialMessage::SharedPayload Payload;
 		
 		template< class MessageType >
 		PublishableMessage( const MessageType & TheMessage, 
-												const std::string & ActorName )
-		: Topic( SetTopic< MessageType >( ActorName ) ),
+												const PublishingLink::Topic & TheTopic )
+		: Topic( TheTopic ),
 		  Payload( TheMessage->Serialize() )
 		{ }
 		
@@ -1025,8 +1142,8 @@ private:
 		// the topic is already given, and there is a pointer to the Serial Message
 		// to be sent. In this case the constructor takes a different form.
 		
-		PublishableMessage( const std::string & TheTopic, 
-												std::shared_ptr< SerialMessage > & TheMessage )
+		PublishableMessage( const PublishingLink::Topic & TheTopic, 
+												const std::shared_ptr< SerialMessage > & TheMessage )
 		: Topic( TheTopic ), Payload( TheMessage->Serialize() )
 		{ }
 		
@@ -1106,6 +1223,26 @@ private:
 	std::unordered_map< std::string, 
 										  std::shared_ptr< SerialMessage > > LastGoodValue;
 	
+	// The topic string for a message type is formatted the first time a message
+	// of this type is published, and the interned topic is then reused for all 
+	// later messages of the same type.
+	
+	std::unordered_map< std::type_index, PublishingLink::Topic > Topics;
+	
+	template< class MessageType >
+	const PublishingLink::Topic & GetTopic( void )
+	{
+		auto TheTopic = Topics.find( typeid( MessageType ) );
+		
+		if ( TheTopic == Topics.end() )
+			TheTopic = Topics.emplace( typeid( MessageType ), 
+									 std::make_shared< const std::string >( 
+									 PublishingLink::SetTopic< MessageType >( GetAddress() ) ) 
+								 ).first;
+		
+		return TheTopic->second;
+	}
+	
 	// There is a handler for new subscriptions sent from the publishing link
 	
 	void NewSubscription( const PublishingLink::SendLastGoodValue & Broadcast, 
@@ -1132,14 +1269,14 @@ protected:
 		// then sent to the publishing link to be transmitted to the outside.
 		
 		PublishingLink::PublishableMessage BroadcastMessage( 
-																			 TheMessage, GetAddress().AsString() );
+																			 TheMessage, GetTopic< MessageType >() );
 		
 		Send( BroadcastMessage, Network::GetAddress( Network::Layer::Network ) );
 		
 		// Then the binary message can be stored as a copy in the Last Good Value 
 		// cache
 		
-		LastGoodValue[ BroadcastMessage.Topic ] = 
+		LastGoodValue[ *BroadcastMessage.Topic ] = 
 																	std::make_shared< MessageType >( TheMessage );
 	}
 	
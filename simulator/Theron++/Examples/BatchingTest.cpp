@@ -0,0 +1,224 @@
+/*=============================================================================
+  Batching test
+
+  The message batching sends a pending batch when the last message of a burst
+  has been added to it if there are no other messages in the queue of the
+  actor. However, if the queue holds a message of another type, like an
+  address resolution of a link server, no later message may cause the batch
+  to be sent, and the batch must then be sent by the time out when its oldest
+  message has waited for the maximal delay.
+
+  This programme tests both cases with a courier actor that batches text
+  messages per peer and records the batches it sends. The courier is first
+  held by a message whose handler waits until the test has queued the burst,
+  so that the content of the queue is known when the burst is handled:
+
+  1. The burst is the last thing in the queue and must be sent at once as
+     one batch.
+  2. The burst is followed by a message of another type, and the batch must
+     be sent by the time out shortly after the maximal delay.
+
+  The programme is compiled with 'make BatchingTest', and it writes one line
+  per case and returns a non-zero exit status if any of the cases fails.
+
+  Author and Copyright: Geir Horn, 2019
+  License: LGPL 3.0
+=============================================================================*/
+
+#include <string>										// Peers and messages
+#include <vector>										// Recorded batches
+#include <chrono>										// Delays
+#include <future>										// Holding the courier
+#include <mutex>										// Protecting the records
+#include <condition_variable>				// Waiting for the batches
+#include <iostream>									// Reporting the results
+#include <cstdlib>									// Exit status
+
+#include "Actor.hpp"								// The Theron++ actor framework
+#include "MessageBatching.hpp"			// The batching under test
+
+// -----------------------------------------------------------------------------
+// Courier
+// -----------------------------------------------------------------------------
+//
+// The courier batches the text of the outbound messages for their peer, and
+// it ignores the resolution messages that stand in for the other messages of
+// a link server.
+
+class Courier : virtual public Theron::Actor,
+								public Theron::MessageBatching< std::string, std::string >
+{
+public:
+
+	class Outbound
+	{
+	public:
+
+		std::string Peer, Text;
+	};
+
+	class Resolution
+	{};
+
+	class Hold
+	{
+	public:
+
+		std::shared_future< void > Released;
+	};
+
+	// The batches sent are recorded with the time they were sent
+
+	class Record
+	{
+	public:
+
+		std::string 													Peer;
+		std::size_t 													Messages;
+		std::chrono::steady_clock::time_point Sent;
+	};
+
+	std::mutex 						  Guard;
+	std::condition_variable Recorded;
+	std::vector< Record > 	Batches;
+
+protected:
+
+	virtual void SendBatch( const std::string & Peer,
+													const std::vector< std::string > & Messages ) override
+	{
+		std::lock_guard< std::mutex > Lock( Guard );
+
+		Batches.push_back( Record{ Peer, Messages.size(),
+															 std::chrono::steady_clock::now() } );
+		Recorded.notify_all();
+	}
+
+private:
+
+	void Queue( const Outbound & TheMessage, const Theron::Address From )
+	{ QueueMessage( TheMessage.Peer, TheMessage.Text, TheMessage.Text.size() ); }
+
+	void Resolve( const Resolution & TheMessage, const Theron::Address From )
+	{ }
+
+	void Wait( const Hold & TheHold, const Theron::Address From )
+	{ TheHold.Released.wait(); }
+
+public:
+
+	// The test waits for a given number of batches or until the time limit
+
+	bool WaitForBatches( std::size_t Count, std::chrono::milliseconds Limit )
+	{
+		std::unique_lock< std::mutex > Lock( Guard );
+
+		return Recorded.wait_for( Lock, Limit,
+														  [&](){ return Batches.size() >= Count; } );
+	}
+
+	Courier( void )
+	: Actor( "Courier" ),
+	  MessageBatching< std::string, std::string >( GetAddress().AsString() ),
+	  Guard(), Recorded(), Batches()
+	{
+		RegisterHandler( this, &Courier::Queue   );
+		RegisterHandler( this, &Courier::Resolve );
+		RegisterHandler( this, &Courier::Wait    );
+	}
+
+	// The courier must not be destroyed while it is handling a time out
+
+	virtual ~Courier( void )
+	{
+		DrainMailbox();
+	}
+};
+
+// -----------------------------------------------------------------------------
+// Test cases
+// -----------------------------------------------------------------------------
+//
+// The courier is held while the burst and the optional resolution message are
+// queued, and then released. The burst must arrive as one batch with all the
+// messages within the given time from the release.
+
+bool Burst( Courier & TheCourier, const std::string & Case,
+						bool ResolutionQueued, std::chrono::milliseconds Limit )
+{
+	constexpr std::size_t BurstSize = 10;
+
+	std::promise< void > Release;
+	Theron::Address 		 Self( TheCourier.GetAddress() );
+	std::size_t 				 Before;
+
+	{
+		std::lock_guard< std::mutex > Lock( TheCourier.Guard );
+		Before = TheCourier.Batches.size();
+	}
+
+	Theron::Actor::Send( Courier::Hold{ Release.get_future().share() },
+											 Self, Self );
+
+	for ( std::size_t i = 0; i < BurstSize; i++ )
+		Theron::Actor::Send( Courier::Outbound{ "Peer", std::to_string( i ) },
+												 Self, Self );
+
+	if ( ResolutionQueued )
+		Theron::Actor::Send( Courier::Resolution(), Self, Self );
+
+	auto Released = std::chrono::steady_clock::now();
+
+	Release.set_value();
+
+	if ( !TheCourier.WaitForBatches( Before + 1, std::chrono::seconds(1) ) )
+	{
+		std::cout << "FAILED " << Case << ": The batch was not sent" << std::endl;
+		return false;
+	}
+
+	std::lock_guard< std::mutex > Lock( TheCourier.Guard );
+
+	const Courier::Record & Batch( TheCourier.Batches.back() );
+	auto Delay = std::chrono::duration_cast< std::chrono::milliseconds >(
+							 Batch.Sent - Released );
+
+	if ( ( TheCourier.Batches.size() != Before + 1 ) ||
+			 ( Batch.Messages != BurstSize ) )
+	{
+		std::cout << "FAILED " << Case << ": The burst was sent in "
+							<< TheCourier.Batches.size() - Before << " batches" << std::endl;
+		return false;
+	}
+
+	if ( Delay > Limit )
+	{
+		std::cout << "FAILED " << Case << ": The batch was sent after "
+							<< Delay.count() << " ms" << std::endl;
+		return false;
+	}
+
+	std::cout << "PASSED " << Case << ": " << Batch.Messages
+						<< " messages sent after " << Delay.count() << " ms" << std::endl;
+	return true;
+}
+
+int main( int argc, char **argv )
+{
+	Courier TheCourier;
+	bool 		Passed = true;
+
+	// The maximal delay is long compared with the handling of the burst so
+	// that the idle flush is distinguished from the time out, and the size
+	// limit is never reached.
+
+	TheCourier.SetBatching( 1 << 20, std::chrono::milliseconds( 50 ) );
+
+	Passed &= Burst( TheCourier, "Burst ending with an empty queue", false,
+									 std::chrono::milliseconds( 40 ) );
+
+	Passed &= Burst( TheCourier, "Burst ending with a resolution queued", true,
+									 std::chrono::milliseconds( 500 ) );
+
+	return Passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
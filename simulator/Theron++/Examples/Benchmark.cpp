@@ -0,0 +1,764 @@
+/*=============================================================================
+  Benchmark
+
+  The purpose of this programme is to measure the performance of the Theron++
+  actor framework so that changes to the scheduling and to the mailboxes can
+  be compared against a baseline. It runs the following scenarios:
+
+  1. Ping-pong: Two actors sending a message back and forth, measuring the
+     round trip latency.
+  2. Fan-out: One producer sending the same update to many consumers, as a PV
+     producer sends its predictions to the consumer proxies, measuring the
+     latency from the send to the reception at each consumer.
+  3. Fan-in: Many sources sending reports to one collector, as the consumer
+     proxies report to the PV producer, measuring the latency at the
+     collector.
+  4. Token ring: A token passed around a ring of actors, measuring the latency
+     of each hop.
+  5. Serialisation: A message sent to a remote actor is serialised by the
+     presentation layer, looped back by a dummy network layer, and
+     de-serialised for the sending actor, measuring the round trip latency.
+
+  For each scenario the number of messages per second is reported together
+  with the percentiles of the latencies in microseconds.
+
+  The programme is compiled with 'make Benchmark' and it takes two optional
+  arguments: the number of messages for each scenario, by default 100000,
+  and the number of actors in the ring, by default 10000. The number of
+  consumers for the fan-out and the number of sources for the fan-in is 100.
+
+  Author and Copyright: Geir Horn, 2019
+  License: LGPL 3.0
+=============================================================================*/
+
+#include <string>										// Names and payloads
+#include <vector>										// Latency samples
+#include <memory>										// Smart pointers
+#include <chrono>										// Time measurements
+#include <algorithm>								// Sorting the samples
+#include <iostream>									// Reporting the results
+#include <iomanip>									// Formatting the results
+#include <sstream>									// Serialising messages
+#include <cstdlib>									// Converting arguments
+#include <cstdint>									// Time stamps
+#include <thread>										// Waiting for registration
+
+#include "Actor.hpp"								// The Actor framework
+#include "StandardFallbackHandler.hpp"	// Reporting wrongly sent messages
+#include "NetworkEndPoint.hpp"			// The network endpoint
+#include "SerialMessage.hpp"				// Serial message format
+#include "DeserializingActor.hpp"		// To de-serialise messages
+#include "LinkMessage.hpp"					// Message to be sent on the link
+#include "NetworkLayer.hpp"					// The link layer protocol server
+#include "SessionLayer.hpp"					// The session layer server
+#include "PresentationLayer.hpp"		// The presentation layer server
+
+/*=============================================================================
+
+ Measurements
+
+=============================================================================*/
+//
+// The time stamps carried by the messages are the nanoseconds of the steady
+// clock, and the latencies are recorded as the difference between the time of
+// reception and the time stamp.
+
+using TimeStamp = std::int64_t;
+
+inline TimeStamp CurrentTime( void )
+{
+	return std::chrono::duration_cast< std::chrono::nanoseconds >(
+		std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+// The report takes the number of messages, the elapsed time in seconds, and
+// the latency samples in nanoseconds, and prints the throughput and the
+// percentiles of the latencies in microseconds.
+
+void Report( const std::string & Scenario, std::size_t Messages,
+						 double Seconds, std::vector< TimeStamp > & Latencies )
+{
+	std::sort( Latencies.begin(), Latencies.end() );
+
+	auto Percentile = [&]( double Fraction )->double{
+		if ( Latencies.empty() ) return 0.0;
+
+		std::size_t Index = static_cast< std::size_t >(
+												Fraction * ( Latencies.size() - 1 ) + 0.5 );
+
+		return Latencies[ Index ] / 1000.0;
+	};
+
+	std::cout << std::left  << std::setw(14) << Scenario << std::right
+						<< std::fixed << std::setprecision(0)
+						<< std::setw(12) << Messages / Seconds << " msg/s"
+						<< std::setprecision(1)
+						<< "  p50 "   << std::setw(8) << Percentile( 0.5   )
+						<< "  p90 "   << std::setw(8) << Percentile( 0.9   )
+						<< "  p99 "   << std::setw(8) << Percentile( 0.99  )
+						<< "  p99.9 " << std::setw(8) << Percentile( 0.999 )
+						<< "  max "   << std::setw(8) << Percentile( 1.0   )
+						<< " us" << std::endl;
+}
+
+// The scenarios report their completion to a receiver in the main thread. It
+// counts the completion messages received.
+
+class Completion : public Theron::Receiver
+{
+public:
+
+	class Done
+	{};
+
+private:
+
+	std::size_t Completed;
+
+	void Finished( const Done & TheMessage, const Theron::Address Sender )
+	{ Completed++; }
+
+public:
+
+	// The wait returns when the given number of actors have completed.
+
+	void WaitFor( std::size_t Expected )
+	{
+		while ( Completed < Expected )
+			Wait();
+
+		Completed = 0;
+	}
+
+	Completion( void ) : Receiver(), Completed(0)
+	{
+		RegisterHandler( this, &Completion::Finished );
+	}
+};
+
+/*=============================================================================
+
+ Ping-pong
+
+=============================================================================*/
+//
+// The ping message carries the time stamp of the first send, and the ponger
+// returns it unchanged.
+
+class Ping
+{
+public:
+
+	TimeStamp Sent;
+
+	Ping( TimeStamp Stamp = 0 ) : Sent( Stamp )
+	{}
+};
+
+class Ponger : public virtual Theron::Actor
+{
+private:
+
+	void Return( const Ping & TheBall, const Theron::Address Pinger )
+	{
+		Send( TheBall, Pinger );
+	}
+
+public:
+
+	Ponger( void ) : Actor( "Ponger" )
+	{
+		RegisterHandler( this, &Ponger::Return );
+	}
+};
+
+class Pinger : public virtual Theron::Actor
+{
+private:
+
+	const Theron::Address TheCompletion;
+	std::size_t						Remaining;
+
+	void Returned( const Ping & TheBall, const Theron::Address ThePonger )
+	{
+		Latencies.push_back( CurrentTime() - TheBall.Sent );
+
+		if ( --Remaining > 0 )
+			Send( Ping( CurrentTime() ), ThePonger );
+		else
+			Send( Completion::Done(), TheCompletion );
+	}
+
+public:
+
+	std::vector< TimeStamp > Latencies;
+
+	void Start( std::size_t Messages, const Theron::Address & ThePonger )
+	{
+		Remaining = Messages;
+		Latencies.reserve( Messages );
+		Send( Ping( CurrentTime() ), ThePonger );
+	}
+
+	Pinger( const Theron::Address & Completed )
+	: Actor( "Pinger" ), TheCompletion( Completed ), Remaining(0), Latencies()
+	{
+		RegisterHandler( this, &Pinger::Returned );
+	}
+};
+
+void PingPong( std::size_t Messages )
+{
+	Completion Completed;
+	Ponger		 ThePonger;
+	Pinger 		 ThePinger( Completed.GetAddress() );
+
+	auto Start = std::chrono::steady_clock::now();
+
+	ThePinger.Start( Messages, ThePonger.GetAddress() );
+	Completed.WaitFor( 1 );
+
+	std::chrono::duration< double > Elapsed =	std::chrono::steady_clock::now()
+																						- Start;
+
+	Report( "Ping-pong", 2 * Messages, Elapsed.count(), ThePinger.Latencies );
+}
+
+/*=============================================================================
+
+ Fan-out and fan-in
+
+=============================================================================*/
+//
+// The producer sends a number of rounds of updates to all consumers, and each
+// consumer records the latency of the updates it receives. It reports its
+// completion when it has received all the rounds.
+
+class Update
+{
+public:
+
+	TimeStamp Sent;
+
+	Update( TimeStamp Stamp = 0 ) : Sent( Stamp )
+	{}
+};
+
+class Consumer : public virtual Theron::Actor
+{
+private:
+
+	const Theron::Address TheCompletion;
+	std::size_t						Remaining;
+
+	void Received( const Update & TheUpdate, const Theron::Address TheProducer )
+	{
+		Latencies.push_back( CurrentTime() - TheUpdate.Sent );
+
+		if ( --Remaining == 0 )
+			Send( Completion::Done(), TheCompletion );
+	}
+
+public:
+
+	std::vector< TimeStamp > Latencies;
+
+	Consumer( const Theron::Address & Completed, std::size_t Rounds )
+	: Actor(), TheCompletion( Completed ), Remaining( Rounds ), Latencies()
+	{
+		Latencies.reserve( Rounds );
+		RegisterHandler( this, &Consumer::Received );
+	}
+};
+
+class Producer : public virtual Theron::Actor
+{
+private:
+
+	class Broadcast
+	{
+	public:
+
+		std::size_t Rounds;
+	};
+
+	std::vector< Theron::Address > Consumers;
+
+	void SendUpdates( const Broadcast & Command, const Theron::Address Requester )
+	{
+		for ( std::size_t Round = 0; Round < Command.Rounds; Round++ )
+			for ( const Theron::Address & TheConsumer : Consumers )
+				Send( Update( CurrentTime() ), TheConsumer );
+	}
+
+public:
+
+	void Start( std::size_t Rounds )
+	{
+		Send( Broadcast{ Rounds }, GetAddress() );
+	}
+
+	Producer( const std::vector< Theron::Address > & TheConsumers )
+	: Actor( "Producer" ), Consumers( TheConsumers )
+	{
+		RegisterHandler( this, &Producer::SendUpdates );
+	}
+};
+
+void FanOut( std::size_t Messages, std::size_t NumberOfConsumers )
+{
+	Completion 														 Completed;
+	std::vector< std::unique_ptr< Consumer > > Consumers;
+	std::vector< Theron::Address > 				 Addresses;
+	std::size_t 													 Rounds = std::max< std::size_t >(
+																					Messages / NumberOfConsumers, 1 );
+
+	for ( std::size_t i = 0; i < NumberOfConsumers; i++ )
+	{
+		Consumers.emplace_back( new Consumer( Completed.GetAddress(), Rounds ) );
+		Addresses.push_back( Consumers.back()->GetAddress() );
+	}
+
+	Producer TheProducer( Addresses );
+
+	auto Start = std::chrono::steady_clock::now();
+
+	TheProducer.Start( Rounds );
+	Completed.WaitFor( NumberOfConsumers );
+
+	std::chrono::duration< double > Elapsed =	std::chrono::steady_clock::now()
+																						- Start;
+
+	std::vector< TimeStamp > Latencies;
+
+	for ( auto & TheConsumer : Consumers )
+		Latencies.insert( Latencies.end(), TheConsumer->Latencies.begin(),
+											TheConsumer->Latencies.end() );
+
+	Report( "Fan-out", Rounds * NumberOfConsumers, Elapsed.count(), Latencies );
+}
+
+// The sources send their reports to the collector when they are asked to
+// start, and the collector reports its completion when it has received all
+// the reports.
+
+class Collector : public virtual Theron::Actor
+{
+private:
+
+	const Theron::Address TheCompletion;
+	std::size_t						Remaining;
+
+	void Received( const Update & TheReport, const Theron::Address TheSource )
+	{
+		Latencies.push_back( CurrentTime() - TheReport.Sent );
+
+		if ( --Remaining == 0 )
+			Send( Completion::Done(), TheCompletion );
+	}
+
+public:
+
+	std::vector< TimeStamp > Latencies;
+
+	Collector( const Theron::Address & Completed, std::size_t Reports )
+	: Actor( "Collector" ), TheCompletion( Completed ), Remaining( Reports ),
+	  Latencies()
+	{
+		Latencies.reserve( Reports );
+		RegisterHandler( this, &Collector::Received );
+	}
+};
+
+class Source : public virtual Theron::Actor
+{
+private:
+
+	class Report
+	{
+	public:
+
+		std::size_t Reports;
+	};
+
+	const Theron::Address TheCollector;
+
+	void SendReports( const Report & Command, const Theron::Address Requester )
+	{
+		for ( std::size_t i = 0; i < Command.Reports; i++ )
+			Send( Update( CurrentTime() ), TheCollector );
+	}
+
+public:
+
+	void Start( std::size_t Reports )
+	{
+		Send( Report{ Reports }, GetAddress() );
+	}
+
+	Source( const Theron::Address & Collecting )
+	: Actor(), TheCollector( Collecting )
+	{
+		RegisterHandler( this, &Source::SendReports );
+	}
+};
+
+void FanIn( std::size_t Messages, std::size_t NumberOfSources )
+{
+	Completion 													 Completed;
+	std::size_t 												 Reports = std::max< std::size_t >(
+																				 Messages / NumberOfSources, 1 );
+	Collector 													 TheCollector( Completed.GetAddress(),
+																										 Reports * NumberOfSources );
+	std::vector< std::unique_ptr< Source > > Sources;
+
+	for ( std::size_t i = 0; i < NumberOfSources; i++ )
+		Sources.emplace_back( new Source( TheCollector.GetAddress() ) );
+
+	auto Start = std::chrono::steady_clock::now();
+
+	for ( auto & TheSource : Sources )
+		TheSource->Start( Reports );
+
+	Completed.WaitFor( 1 );
+
+	std::chrono::duration< double > Elapsed =	std::chrono::steady_clock::now()
+																						- Start;
+
+	Report( "Fan-in", Reports * NumberOfSources, Elapsed.count(),
+					TheCollector.Latencies );
+}
+
+/*=============================================================================
+
+ Token ring
+
+=============================================================================*/
+//
+// The token carries the number of hops made and the time stamp of the last
+// hop. Since there is only one token, each hop latency is recorded in its
+// own element of the latency vector, and the message passing ensures that the
+// elements written by different actors are visible to the main thread when
+// the completion is received.
+
+class Token
+{
+public:
+
+	std::size_t Hop;
+	TimeStamp		Sent;
+
+	Token( std::size_t Hops = 0, TimeStamp Stamp = 0 )
+	: Hop( Hops ), Sent( Stamp )
+	{}
+};
+
+class RingNode : public virtual Theron::Actor
+{
+private:
+
+	Theron::Address 					 Next;
+	const Theron::Address 		 TheCompletion;
+	std::vector< TimeStamp > & Latencies;
+
+	void Pass( const Token & TheToken, const Theron::Address Previous )
+	{
+		Latencies[ TheToken.Hop ] = CurrentTime() - TheToken.Sent;
+
+		if ( TheToken.Hop + 1 < Latencies.size() )
+			Send( Token( TheToken.Hop + 1, CurrentTime() ), Next );
+		else
+			Send( Completion::Done(), TheCompletion );
+	}
+
+public:
+
+	inline void SetNext( const Theron::Address & NextNode )
+	{ Next = NextNode; }
+
+	inline void Start( void )
+	{ Send( Token( 0, CurrentTime() ), Next ); }
+
+	RingNode( const Theron::Address & Completed,
+						std::vector< TimeStamp > & HopLatencies )
+	: Actor(), Next(), TheCompletion( Completed ), Latencies( HopLatencies )
+	{
+		RegisterHandler( this, &RingNode::Pass );
+	}
+};
+
+void TokenRing( std::size_t Messages, std::size_t RingSize )
+{
+	Completion 													 Completed;
+	std::vector< TimeStamp > 						 Latencies( Messages, 0 );
+	std::vector< std::unique_ptr< RingNode > > Ring;
+
+	for ( std::size_t i = 0; i < RingSize; i++ )
+		Ring.emplace_back( new RingNode( Completed.GetAddress(), Latencies ) );
+
+	for ( std::size_t i = 0; i < RingSize; i++ )
+		Ring[i]->SetNext( Ring[ ( i + 1 ) % RingSize ]->GetAddress() );
+
+	auto Start = std::chrono::steady_clock::now();
+
+	Ring.front()->Start();
+	Completed.WaitFor( 1 );
+
+	std::chrono::duration< double > Elapsed =	std::chrono::steady_clock::now()
+																						- Start;
+
+	Report( "Token ring", Messages, Elapsed.count(), Latencies );
+}
+
+/*=============================================================================
+
+ Serialisation
+
+=============================================================================*/
+//
+// The link message holds the external addresses as strings, and the network
+// layer returns every outbound message to the session layer as an inbound
+// message from the receiver to the sender. A message sent to a remote actor
+// will therefore come back to the sender as a serialised payload from the
+// remote actor.
+
+class LoopbackMessage : public Theron::LinkMessage< std::string >
+{
+public:
+
+	virtual Theron::Address
+	ActorAddress( const std::string & ExternalActor ) const override
+	{
+		return Theron::Address( ExternalActor );
+	}
+
+	LoopbackMessage( const std::string & From, const std::string & To,
+									 const Theron::SerialMessage::SharedPayload & ThePayload )
+	: Theron::LinkMessage< std::string >( From, To, ThePayload )
+	{}
+
+	LoopbackMessage( const LoopbackMessage & Other ) = default;
+};
+
+class LoopbackNetworkLayer
+: virtual public Theron::Actor,
+  virtual public Theron::StandardFallbackHandler,
+  public Theron::NetworkLayer< LoopbackMessage >
+{
+protected:
+
+	virtual void ResolveAddress( const ResolutionRequest & TheRequest,
+														   const Address TheSessionLayer ) override
+  {
+		Send( ResolutionResponse( TheRequest.NewActor.AsString(),
+															TheRequest.NewActor ), TheSessionLayer );
+	}
+
+  virtual void ActorRemoval( const RemoveActor & TheCommand,
+														 const Address TheSessionLayer ) override
+  { }
+
+  virtual void OutboundMessage( const LoopbackMessage & TheMessage,
+																const Address TheSessionLayer ) override
+	{
+		Send( LoopbackMessage( TheMessage.GetRecipient(), TheMessage.GetSender(),
+													 TheMessage.GetSharedPayload() ), TheSessionLayer );
+	}
+
+public:
+
+	LoopbackNetworkLayer( void )
+	: Actor( "NetworkLayerServer" ),
+	  StandardFallbackHandler( GetAddress().AsString() ),
+	  Theron::NetworkLayer< LoopbackMessage >( GetAddress().AsString() )
+	{ }
+
+	virtual ~LoopbackNetworkLayer( void )
+	{ }
+};
+
+class LoopbackNetwork
+: virtual public Theron::Actor,
+  public Theron::Network
+{
+protected:
+
+	virtual void CreateNetworkLayer( void ) override
+	{
+		CreateServer< Layer::Network, LoopbackNetworkLayer >();
+	}
+
+	virtual void CreateSessionLayer( void ) override
+	{
+	  CreateServer< Layer::Session, Theron::SessionLayer< LoopbackMessage > >();
+	}
+
+	virtual void CreatePresentationLayer( void ) override
+	{
+		CreateServer< Layer::Presentation, Theron::PresentationLayer >();
+	}
+
+	virtual void StartShutDown( const Network::ShutDownMessage & TheMessage,
+													    const Address Sender ) override
+	{ }
+
+	LoopbackNetwork( const std::string & Name, const std::string & Location )
+	: Actor( Name ), Network( Name, Location )
+	{	}
+
+public:
+
+	virtual ~LoopbackNetwork( void )
+	{ }
+};
+
+// The echo message is serialised with its sequence number and time stamp,
+// and the echo actor sends the next message to the remote actor when the
+// previous one has returned.
+
+class EchoActor : virtual public Theron::Actor,
+									virtual public Theron::DeserializingActor
+{
+public:
+
+	class Echo : public Theron::SerialMessage
+	{
+	public:
+
+		std::size_t Sequence;
+		TimeStamp		Sent;
+
+	protected:
+
+		virtual Theron::SerialMessage::Payload Serialize( void ) const override
+		{
+			std::ostringstream Message;
+
+			Message << "Echo " << Sequence << " " << Sent;
+
+			return Message.str();
+		}
+
+		virtual bool
+		Deserialize( const Theron::SerialMessage::Payload & Payload ) override
+		{
+			std::istringstream Message( Payload );
+			std::string				 Command;
+
+			Message >> Command;
+
+			if ( Command == "Echo" )
+			{
+				Message >> Sequence >> Sent;
+				return true;
+			}
+			else
+				return false;
+		}
+
+	public:
+
+		Echo( std::size_t Number = 0, TimeStamp Stamp = 0 )
+		: Theron::SerialMessage(), Sequence( Number ), Sent( Stamp )
+		{}
+
+		Echo( const Echo & Other )
+		: Echo( Other.Sequence, Other.Sent )
+		{}
+
+		virtual ~Echo( void )
+		{}
+	};
+
+private:
+
+	const Theron::Address TheCompletion, RemoteActor;
+	std::size_t 					Remaining;
+
+	void Returned( const Echo & TheEcho, const Theron::Address Remote )
+	{
+		Latencies.push_back( CurrentTime() - TheEcho.Sent );
+
+		if ( --Remaining > 0 )
+			Send( Echo( TheEcho.Sequence + 1, CurrentTime() ), RemoteActor );
+		else
+			Send( Completion::Done(), TheCompletion );
+	}
+
+public:
+
+	std::vector< TimeStamp > Latencies;
+
+	void Start( std::size_t Messages )
+	{
+		Remaining = Messages;
+		Latencies.reserve( Messages );
+		Send( Echo( 0, CurrentTime() ), RemoteActor );
+	}
+
+	EchoActor( const Theron::Address & Completed )
+	: Actor( "EchoActor" ), DeserializingActor( "EchoActor" ),
+	  TheCompletion( Completed ), RemoteActor( "RemoteActor" ), Remaining(0),
+	  Latencies()
+	{
+		RegisterHandler( this, &EchoActor::Returned );
+	}
+};
+
+void Serialisation( std::size_t Messages )
+{
+	Theron::NetworkEndPoint< LoopbackNetwork > TheEndPoint( "EndPoint",
+																													"localhost" );
+	Completion Completed;
+	EchoActor  TheEchoActor( Completed.GetAddress() );
+
+	// The echo actor registers with the session layer asynchronously, and
+	// a message sent before its external address has been resolved will have
+	// no return address and the echo will be lost. The registration is given
+	// time to complete before the measurement starts.
+
+	std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+
+	auto Start = std::chrono::steady_clock::now();
+
+	TheEchoActor.Start( Messages );
+	Completed.WaitFor( 1 );
+
+	std::chrono::duration< double > Elapsed =	std::chrono::steady_clock::now()
+																						- Start;
+
+	Report( "Serialisation", Messages, Elapsed.count(), TheEchoActor.Latencies );
+}
+
+/*=============================================================================
+
+ Main
+
+=============================================================================*/
+//
+// The scenarios are run in sequence, and the serialisation is run last since
+// the network endpoint remains until the end of the programme.
+
+int main( int argc, char **argv )
+{
+	std::size_t Messages = 100000,
+							RingSize = 10000,
+							Peers		 = 100;
+
+	if ( argc > 1 ) Messages = std::strtoul( argv[1], nullptr, 10 );
+	if ( argc > 2 ) RingSize = std::strtoul( argv[2], nullptr, 10 );
+
+	Messages = std::max< std::size_t >( Messages, 1 );
+	RingSize = std::max< std::size_t >( RingSize, 2 );
+
+	std::cout << "Theron++ benchmark with " << Messages << " messages and a ring"
+						<< " of " << RingSize << " actors" << std::endl;
+
+	PingPong ( Messages );
+	FanOut	 ( Messages, Peers );
+	FanIn		 ( Messages, Peers );
+	TokenRing( Messages, RingSize );
+	Serialisation( Messages / 10 );
+
+	return EXIT_SUCCESS;
+}
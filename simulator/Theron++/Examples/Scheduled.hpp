@@ -126,6 +126,16 @@ C(W, lambda/mu ) = 1/(1+(1-rho)*(W!/(W*rho)^W)Sum_{k=0}^{W-1} (W*rho)^k/k!)
 
 The details about the implementation is further described below.
 
+The library form of this idea is the thread pool execution mode of the actor,
+see Actor.hpp, where the pooled actors keep all the actor functionality, may
+be deserializing actors, and are executed by workers with their own queues
+that steal work from each other. A worker destroying a pooled actor handles
+the pending messages of the destroyed actor itself, which resolves the
+ownership problem above without a single queue. The execution mode can be set
+for a class of actors, so that the many idle objects of an application are
+executed by the pool while the other actors keep their own threads. This
+example is kept to illustrate the scheduling model with a central queue.
+
 The Gnu Multi Precision (GMP) library is used and one should therefore link 
 code built with scheduled objects with the necessary libraries
 
@@ -1,14 +1,19 @@
 /*=============================================================================
   Console Print
 
-  The console print class defines some static variables, and this file is 
-  basically a placeholder for these variables.
+  The console print class defines some static variables, and the ring of 
+  records and the writer thread of the print server are implemented here.
        
-  Author: Geir Horn, University of Oslo, 2016-2017
+  Author: Geir Horn, University of Oslo, 2016-2017, 2019
   Contact: Geir.Horn [at] mn.uio.no
   License: LGPL3.0
 =============================================================================*/
 
+#include <chrono>														// Record time stamps
+#include <ctime>														// Local time of day
+#include <iomanip>													// Formatting the prefix
+#include <vector>														// Batches of records
+
 #include "ConsolePrint.hpp"
 
 namespace Theron {
@@ -19,4 +24,177 @@ namespace Theron {
 
 ConsolePrintServer * ConsolePrintServer::TheServer = nullptr;
 
+// -----------------------------------------------------------------------------
+// Record ring
+// -----------------------------------------------------------------------------
+//
+// The slot at a position is free for appending when its sequence number equals
+// the position, and it holds the record when the sequence number is one more 
+// than the position. When the record is taken the sequence number is set to 
+// the position of the next round through the ring.
+
+ConsolePrintServer::RecordRing::RecordRing( void )
+: Slots( new Slot[ Capacity ] ), AppendPosition(0), TakePosition(0)
+{
+	for ( std::size_t Position = 0; Position < Capacity; Position++ )
+		Slots[ Position ].Sequence.store( Position, std::memory_order_relaxed );
+}
+
+bool ConsolePrintServer::RecordRing::Append( std::string && Record )
+{
+	std::size_t Position = AppendPosition.load( std::memory_order_relaxed );
+	
+	while ( true )
+	{
+		Slot & TheSlot( Slots[ Position % Capacity ] );
+		std::size_t Sequence = TheSlot.Sequence.load( std::memory_order_acquire );
+		
+		if ( Sequence == Position )
+		{
+			if ( AppendPosition.compare_exchange_weak( Position, Position + 1,
+																								 std::memory_order_relaxed ) )
+			{
+				TheSlot.Record = std::move( Record );
+				TheSlot.Sequence.store( Position + 1, std::memory_order_release );
+				return true;
+			}
+		}
+		else if ( Sequence < Position )
+			return false;
+		else
+			Position = AppendPosition.load( std::memory_order_relaxed );
+	}
+}
+
+bool ConsolePrintServer::RecordRing::Take( std::string & Record )
+{
+	Slot & TheSlot( Slots[ TakePosition % Capacity ] );
+	
+	if ( TheSlot.Sequence.load( std::memory_order_acquire ) != TakePosition + 1 )
+		return false;
+	
+	Record = std::move( TheSlot.Record );
+	TheSlot.Record.clear();
+	TheSlot.Sequence.store( TakePosition + Capacity, std::memory_order_release );
+	TakePosition++;
+	
+	return true;
+}
+
+bool ConsolePrintServer::RecordRing::Empty( void ) const
+{
+	return Slots[ TakePosition % Capacity ].Sequence.load( 
+				 std::memory_order_acquire ) != TakePosition + 1;
+}
+
+// -----------------------------------------------------------------------------
+// Appending records
+// -----------------------------------------------------------------------------
+//
+// The prefix is formatted by the thread writing the record with the local 
+// time of day in milliseconds and a number given to the thread the first time
+// it prints. The record is terminated by a new line if the text did not end 
+// with one since the records of different threads are interleaved.
+
+void ConsolePrintServer::Append( const std::string & Text )
+{
+	static std::atomic< unsigned int > ThreadCounter(0);
+	thread_local unsigned int ThreadNumber = ++ThreadCounter;
+	
+	std::ostringstream Record;
+	
+	if ( Prefix )
+	{
+		auto Now = std::chrono::system_clock::now();
+		std::time_t Seconds = std::chrono::system_clock::to_time_t( Now );
+		auto Milliseconds = std::chrono::duration_cast< std::chrono::milliseconds >(
+									      Now.time_since_epoch() ).count() % 1000;
+		std::tm LocalTime;
+		
+		localtime_r( &Seconds, &LocalTime );
+		
+		Record << "[" << std::put_time( &LocalTime, "%H:%M:%S" ) << "."
+					 << std::setw(3) << std::setfill('0') << Milliseconds 
+					 << " T" << ThreadNumber << "] ";
+	}
+	
+	Record << Text;
+	
+	if ( Text.empty() || ( Text.back() != '\n' ) )
+		Record << '\n';
+	
+	std::string TheRecord( Record.str() );
+	
+	while ( !Records.Append( std::move( TheRecord ) ) )
+		std::this_thread::yield();
+	
+	if ( WriterParked.load( std::memory_order_acquire ) )
+	{
+		std::lock_guard< std::mutex > Lock( WriterGuard );
+		WriterWakeUp.notify_one();
+	}
+}
+
+// -----------------------------------------------------------------------------
+// Writer thread
+// -----------------------------------------------------------------------------
+//
+// The writer takes all available records as one batch and writes them with a 
+// single flush of the output stream. When there are no records it parks on 
+// the condition variable, but with a time out so that a wake up lost between
+// the test of the ring and the parking only delays the output slightly. 
+
+void ConsolePrintServer::WriteRecords( void )
+{
+	std::vector< std::string > Batch;
+	std::string                Record;
+	
+	while ( true )
+	{
+		while ( Records.Take( Record ) )
+			Batch.push_back( std::move( Record ) );
+		
+		if ( !Batch.empty() )
+		{
+			for ( const std::string & Line : Batch )
+				*OutputStream << Line;
+			
+			OutputStream->flush();
+			Batch.clear();
+		}
+		else if ( StopWriter.load( std::memory_order_acquire ) )
+			return;
+		else
+		{
+			std::unique_lock< std::mutex > Lock( WriterGuard );
+			
+			WriterParked.store( true, std::memory_order_release );
+			
+			if ( Records.Empty() && !StopWriter.load( std::memory_order_acquire ) )
+				WriterWakeUp.wait_for( Lock, std::chrono::milliseconds(10) );
+			
+			WriterParked.store( false, std::memory_order_release );
+		}
+	}
+}
+
+// The destructor first lets the actor handle the strings sent to it, and then
+// stops the writer, which will write all remaining records before it returns.
+
+ConsolePrintServer::~ConsolePrintServer( void )
+{
+	DrainMailbox();
+		
+	{
+		std::lock_guard< std::mutex > Lock( WriterGuard );
+		StopWriter.store( true, std::memory_order_release );
+		WriterWakeUp.notify_one();
+	}
+	
+	if ( Writer.joinable() )
+		Writer.join();
+		
+	TheServer = nullptr;
+}
+
 }  // End name space Theron
@@ -16,6 +16,22 @@ with the manipulator "endl" or with a flush, each of which sends the stream
 to the print agent and clears the local buffer. Note that one of the two must
 be given for the formatted output to reach the console.
 
+Sending every line as a message to the print server actor made debug output
+slow, and the lines were printed in the order the server handled them rather
+than the order they were written. The print stream therefore appends its 
+line as a preformatted record to a lock-free ring buffer of the server, and 
+a single writer thread takes the records from the ring and writes them in 
+batches to the output stream. Each record is prefixed with the wall clock 
+time and a small number identifying the thread that wrote it, so the order
+of the output from different threads can be understood. Strings sent 
+directly to the server actor are written through the same ring.
+
+The print streams can also be given a severity level, and the levels above
+the level given by the macro THERON_CONSOLE_PRINT_LEVEL at compile time are
+replaced by a stream that ignores all output, so disabled levels cost 
+nothing beyond the evaluation of the printed arguments. All levels are 
+enabled by default.
+
 Author: Geir Horn, 2013-2016
 Lisence: LGPL 3.0
 
@@ -25,6 +41,8 @@ Revisions:
 		   Added ostream constructor argument
 		   Drain functionality moved to the destructor
 		   Stream will use the server's execution framework
+  Geir Horn, 2019: Asynchronous record ring and writer thread
+                   Record prefixes and compile time print levels
 =============================================================================*/
 
 #ifndef CONSOLE_PRINT
@@ -36,6 +54,13 @@ Revisions:
 #include <memory>														// For shared pointers
 #include <type_traits>											// For compile time checks
 #include <stdexcept>												// Standard exceptions
+#include <atomic>														// The record ring
+#include <thread>														// The writer thread
+#include <mutex>														// Parking the writer
+#include <condition_variable>								// Waking the writer
+#include <cstddef>													// Ring positions
+#include <memory>														// The ring slots
+#include <type_traits>											// Print level selection
 
 #include "Actor.hpp"												// The Theron++ framework
 #include "StandardFallbackHandler.hpp"			// Debugging and error handling
@@ -80,46 +105,74 @@ private:
   
   friend class ConsolePrint;
   
-  // Termination is handled by the destructor creating a termination receiver
-  // that will wait for the normal message handler to indicate that all 
-  // messages have been printed. However, it should be noted that this 
-  // approach is fragile if other actors are still running sending messages 
-  // to this print server. To be on the safe side, it should be the first 
-  // actor created, because then it will be the last actor destroyed.
-  
-  class Terminator : public Receiver
+  // The records are stored in a bounded ring of slots where each slot has a
+  // sequence number telling if it is free for the writer at a given position
+  // or holds the record for that position, as in Dmitry Vyukov's bounded 
+  // queue. A thread appending a record claims the next position by compare 
+  // and exchange, and the writer thread is the only one taking records. If the
+  // ring is full, the appending thread yields until the writer has made room,
+  // so no output is lost.
+
+  class RecordRing
   {
   private:
-      void DrainQueueConfirmation ( const bool & Confirmation, 
-																    const Address TheServer )
-      {};	// We simply ignore everything
+
+    class Slot
+    {
+    public:
+
+      std::atomic< std::size_t > Sequence;
+      std::string                Record;
+    };
+
+    static constexpr std::size_t Capacity = 4096;
+
+    std::unique_ptr< Slot[] > Slots;
+    std::atomic< std::size_t > AppendPosition;
+    std::size_t                TakePosition;
+
   public:
-      Terminator (void) : Receiver()
-      {
-			  RegisterHandler( this, &Terminator::DrainQueueConfirmation );
-      };
-  };
 
-  // A shared pointer is initialised to this receiver by the destructor, 
-  // and if this pointer is assigned it is an indication that the server is 
-  // terminating and 'true' should be sent to the receiver when there are no
-  // more messages in the queue.
+    bool Append( std::string && Record );
+    bool Take( std::string & Record );
+
+    // The writer can test if there are records without taking one
+    
+    bool Empty( void ) const;
+
+    RecordRing( void );
+  } Records;
+
+  // The writer thread parks when the ring is empty, and the appending threads
+  // only take the lock to wake it if it is parked.
+
+  std::atomic< bool >     WriterParked, StopWriter;
+  std::mutex              WriterGuard;
+  std::condition_variable WriterWakeUp;
+  std::thread             Writer;
+
+  void WriteRecords( void );
 
-  std::shared_ptr< Terminator > TerminationPhase;
-  
   // The actual output is sent to a stream provided to the constructor to allow
   // the stream to be set to cout or cerr or a file in one place.
   
   std::ostream * OutputStream;
 
+  // The prefix of the records can be switched off if the output must be 
+  // exactly the text printed.
+
+  std::atomic< bool > Prefix;
+
+  // Records are appended by the print streams and by the message handler for
+  // strings sent directly to the server.
+
+  void Append( const std::string & Text );
+
   // Handler function to print the content of the string
 
   void PrintString ( const std::string & message, const Address sender )
   {
-      *OutputStream << message;
-
-      if ( TerminationPhase )
-	      Send( true, TerminationPhase->GetAddress() );
+    Append( message );
   };
 	
 	// Initialiser to avoid duplicating functionality in the constructor and the 
@@ -139,6 +192,7 @@ private:
 		
     TheServer = this;
     RegisterHandler(this, &ConsolePrintServer::PrintString );		
+    Writer = std::thread( &ConsolePrintServer::WriteRecords, this );
 	}
 
 public:
@@ -154,7 +208,8 @@ public:
 								       const std::string & TheName = std::string() )
   : Actor( TheName ),
     StandardFallbackHandler( Actor::GetAddress().AsString() ),
-    OutputStream( Output )
+    Records(), WriterParked( false ), StopWriter( false ), WriterGuard(),
+    WriterWakeUp(), Writer(), OutputStream( Output ), Prefix( true )
   {
 		Initialise();
   };
@@ -164,24 +219,22 @@ public:
 								       const std::string & TheName = std::string() )
   : Actor( TheFramework, ( TheName.empty() ? nullptr : TheName.data() ) ),
     StandardFallbackHandler( Actor::GetAddress().AsString() ),
-    OutputStream( Output )
+    Records(), WriterParked( false ), StopWriter( false ), WriterGuard(),
+    WriterWakeUp(), Writer(), OutputStream( Output ), Prefix( true )
 	{ 
 		Initialise();
 	}
 
-  // If there are outstanding messages pending, the destructor must create 
-  // the terminator receiver and wait for it to receive the information 
-  // from the message handler that there are no more outstanding messages.
+  // The prefix of the records can be switched on or off
+  
+  inline void RecordPrefix( bool WithPrefix )
+  { Prefix = WithPrefix; }
 
-  virtual ~ConsolePrintServer( void )
-  {
-	  TerminationPhase = std::make_shared< Terminator >();
-    
-		while ( GetNumQueuedMessages() > 0 )
-      TerminationPhase->Wait();
-    
-    TheServer = nullptr;
-  }
+  // If there are outstanding messages pending, the destructor must wait for 
+  // them to be appended to the ring, and then the writer thread is stopped 
+  // after it has written all records.
+
+  virtual ~ConsolePrintServer( void );
 };
 
 /*****************************************************************************
@@ -191,7 +244,8 @@ Each actor that wants to do output to the console may instantiate an
 object of this stream and write to it as any normal stream. It will buffer
 all received input into the associated string and when the application calls
 either the "endl" operator, the "flush" method, or de-constructs the object,
-the content of the string will be forwarded as a message to the print server.
+the content of the string will be appended as a record to the print server's
+ring of records.
 
 Essentially, most of this is standard functionality of the ostream, so the only
 thing we need to care about is to improve the flush function and to make sure
@@ -201,23 +255,14 @@ we send the stream if its length is larger than zero.
 
 class ConsolePrint : public virtual std::ostringstream
 {
-private:
-	
-	// The address of the print server is cached to make it faster to send the 
-	// string to the server.
-	
-	Address TheConsole;
-	
 public:
 
-    // The constructor is just empty since the actual messaging is handled
+    // The constructor is just empty since the actual output is handled
     // by the flush function or the destructor below.
 
     ConsolePrint (void ) 
     : std::ostringstream()
-    { 	
-			TheConsole = ConsolePrintServer::TheServer->GetAddress();
-    };
+    {};
 
     // The flush method sends the content of the stream to the print 
     // server and resets the buffer so that the stream can be reused if 
@@ -227,7 +272,7 @@ public:
     {
 			if ( str().length() > 0 )
 			{
-			  ConsolePrintServer::TheServer->Send( std::string( str() ), TheConsole );
+			  ConsolePrintServer::TheServer->Append( str() );
 
 			  // Clear the string
 
@@ -244,9 +289,54 @@ public:
     virtual ~ConsolePrint ( void )
     {
 			if ( str().length() > 0 )
-			  ConsolePrintServer::TheServer->Send( std::string( str() ), TheConsole );
+			  ConsolePrintServer::TheServer->Append( str() );
     };
 };
 
+/*****************************************************************************
+Print levels
+
+The print streams can be selected by a severity level, and the levels above 
+the compiled level are given a stream that discards everything written to it.
+The compiled level is set by defining THERON_CONSOLE_PRINT_LEVEL to the 
+number of the highest level to print, where zero prints only errors.
+
+******************************************************************************/
+
+enum class PrintLevel
+{
+  Error       = 0,
+  Warning     = 1,
+  Information = 2,
+  Debug       = 3
+};
+
+#ifndef THERON_CONSOLE_PRINT_LEVEL
+  #define THERON_CONSOLE_PRINT_LEVEL 3
+#endif
+
+// The discarding stream accepts the same output and manipulators as the 
+// print stream and does nothing with them.
+
+class DiscardPrint
+{
+public:
+  
+  template< class ValueType >
+  inline DiscardPrint & operator << ( const ValueType & )
+  { return *this; }
+
+  inline DiscardPrint & operator << ( std::ostream & (*)( std::ostream & ) )
+  { return *this; }
+
+  inline DiscardPrint * flush( void )
+  { return this; }
+};
+
+template< PrintLevel Level >
+using LevelPrint = std::conditional_t< 
+  ( static_cast< int >( Level ) <= THERON_CONSOLE_PRINT_LEVEL ),
+  ConsolePrint, DiscardPrint >;
+
 }       // End name space Theron
 #endif  // CONSOLE_PRINT
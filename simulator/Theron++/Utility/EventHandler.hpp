@@ -12,8 +12,9 @@ Note also that the event handler ignores what action the actor does for an
 event, so in is possible to register several events for the same actor at 
 the same time - the actor will have to handle this situation.
 
-Author and Copyright: Geir Horn, 2013, 2016, 2017
+Author and Copyright: Geir Horn, 2013, 2016, 2017, 2019
 Revision 2017: Major re-factoring
+Revision 2019: Pluggable event store for the discrete event manager
 License: LGPL 3.0
 =============================================================================*/
 
@@ -27,11 +28,13 @@ License: LGPL 3.0
 #include <string>												// Text strings
 #include <memory>											  // For smart pointers
 #include <functional>										// For functions returning Now
+#include <vector>												// Observers of the Now updates
 
 #include <type_traits>									// To check a type at compile time
 
 #include "Actor.hpp"						  			// The Theron++ actor framework
 #include "StandardFallbackHandler.hpp"  // Debugging and error recovery
+#include "EventStore.hpp"								// Time sorted event stores
 
 #include <iostream>
 
@@ -152,12 +155,26 @@ protected:
 	// The above counter is intended to be used by the local event handler on 
 	// this endpoint. However, if other actors needs to be informed about the 
 	// current time, they will subscribe by sending the following class to the 
-	// event handler.
+	// event handler. A subscriber that only needs the time at a coarser 
+	// resolution than the event times, for instance whole hours, gives this 
+	// resolution in counter ticks, and it will then only be notified when the 
+	// time crosses a multiple of the resolution. A resolution of zero means 
+	// that the subscriber is notified whenever the time changes.
 	
 public:
 	
 	class SubscribeNowCounter
-	{ };
+	{ 
+	public:
+		
+		const TimeCounter Resolution;
+		
+		SubscribeNowCounter( TimeCounter TheResolution = 0 )
+		: Resolution( TheResolution )
+		{ }
+		
+		SubscribeNowCounter( const SubscribeNowCounter & Other ) = default;
+	};
 	
 	// They can cancel the subscription by sending the following class
 	
@@ -388,7 +405,9 @@ public:
 // actor to wait for the next time step, if that would be needed. 
 // 
 // It takes an address to the event manager in order to subscribe to events 
-// when it is created, and un-subscribe when it is deleted.
+// when it is created, and un-subscribe when it is deleted. It can optionally 
+// take the resolution of the time it needs, and it will then hold the time of
+// the event that last crossed a multiple of the resolution.
 
 class NowCounter : public Receiver
 {
@@ -426,12 +445,13 @@ public:
 	// The constructor register the handler with the event queue.
 
 	NowCounter ( Framework & TheHost, 
-							 const Address TheEventQueue = EventData::HandlerAddress() ) 
+							 const Address TheEventQueue = EventData::HandlerAddress(),
+							 EventData::TimeCounter Resolution = 0 ) 
 	: Receiver(), TheFramework( &TheHost ), TheEventManager( TheEventQueue )
 	{
 	    RegisterHandler( this, &NowCounter::ReceiveTime );
 	    
-			TheFramework->Send( EventData::SubscribeNowCounter(), 
+			TheFramework->Send( EventData::SubscribeNowCounter( Resolution ), 
 													GetAddress(), TheEventManager );
 	};
 
@@ -466,8 +486,9 @@ class Now : public NowCounter, public EventClock< EventRepresentation >
 public:
 	
 	Now( Framework & TheHost, 
-			 const Address TheEventQueue = EventData::HandlerAddress() )
-	: NowCounter( TheHost, TheEventQueue ),
+			 const Address TheEventQueue = EventData::HandlerAddress(),
+			 EventData::TimeCounter Resolution = 0 )
+	: NowCounter( TheHost, TheEventQueue, Resolution ),
 	  EventClock< EventRepresentation >( &CurrentTime )
 	{ }
 };
@@ -499,11 +520,10 @@ class EventHandler : public virtual Actor,
 
 private:
 	
-	// All the subscribed Now objects are kept in a simple set since the 
-  // addresses have to be unique. It is static because is is accessed by 
-	// static functions, and there is only one event handler in the system.
+	// All the subscribed Now objects are kept in a map from their unique 
+	// addresses to the resolution of the time they need. 
 	
-	std::set< Address > NowSubscribers;
+	std::map< Address, TimeCounter > NowSubscribers;
 	
 	// Now receivers will have to send a message to be added to this list of 
 	// notifications. The handler for these messages is trivial.
@@ -511,7 +531,7 @@ private:
 	void AddSubscriber( const EventData::SubscribeNowCounter & Message, 
 											const Address Subscriber )
 	{
-		NowSubscribers.insert( Subscriber );
+		NowSubscribers[ Subscriber ] = Message.Resolution;
 	}
 
 	// A similar handler removes a subscriber from the set
@@ -611,6 +631,29 @@ private:
 	
 	std::shared_ptr< TimeDistribution > ConsistentTime;
 	
+	// Objects on the same network endpoint as the event handler, like a global 
+	// clock object, may want to follow the event time without subscribing a 
+	// Now receiver and acknowledging every update. They can register a Now 
+	// observer function that will be called by the event handler with the new 
+	// event time when the time advances and before the next event is 
+	// dispatched. The observer is called from the event handler's thread and 
+	// it should just store the time. The observers must be added before the 
+	// first event is dispatched since the list is not protected against 
+	// concurrent modification.
+	
+public:
+	
+	using NowObserver = std::function< void( const EventTime & ) >;
+	
+	inline void AddNowObserver( const NowObserver & TheObserver )
+	{
+		NowObservers.push_back( TheObserver );
+	}
+	
+private:
+	
+	std::vector< NowObserver > NowObservers;
+	
 protected:
 	
 	// There is a method that updates the current time and the Now receivers. It 
@@ -625,30 +668,52 @@ protected:
 	// clock time. In such situation one should rather read the system's clock 
 	// value of Now to ensure that the real time is used and not the real time 
 	// distributed at some past event epoch.
+	//
+	// The time jumps directly from one event time to the next, however long 
+	// the idle interval between them is. When the events are sparse, the cost
+	// of advancing the time is dominated by the round trip to the subscribers,
+	// and a subscriber is therefore only notified if the time crosses a 
+	// multiple of its resolution. The observers are always called since they 
+	// only store the time.
 	
 	void UpdateNow( void )
 	{
-		TimeCounter NextTime  = ToTimeCounter( NextEventTime() );
+		EventTime   NextEvent = NextEventTime();
+		TimeCounter NextTime  = ToTimeCounter( NextEvent );
 		
 		if ( CurrentTime < NextTime )
 		{
+			TimeCounter PreviousTime = CurrentTime;
+			
 			CurrentTime = NextTime;
 			
-			if ( ! NowSubscribers.empty() )
+			for ( auto & Observer : NowObservers )
+				Observer( NextEvent );
+			
+			std::vector< Address > Notified;
+			
+			for ( const auto & [ NowReceiver, Resolution ] : NowSubscribers )
+				if ( ( Resolution <= 1 ) || 
+						 ( PreviousTime / Resolution != NextTime / Resolution ) )
+					Notified.push_back( NowReceiver );
+			
+			if ( ! Notified.empty() )
 		  {
 				// First the number of Now receivers is sent to the acknowledgement
 				// receiver so it knows how many subscribers to wait for
 				
 				Address AcknowledgementReceiver( ConsistentTime->GetAddress() );
 				
-				Send( NowSubscribers.size(), AcknowledgementReceiver );
-
-				// Send the current time stamp to all subscribers, making sure that 
-				// they will respond back to the acknowledgement receiver. In order to
-				// ensure that the whole system has a consistent time, all 
-				// acknowledgements must be received before the next event is dispatched
+				Send( static_cast< std::set< Address >::size_type >( Notified.size() ), 
+							AcknowledgementReceiver );
+
+				// Send the current time stamp to the notified subscribers, making 
+				// sure that they will respond back to the acknowledgement receiver. 
+				// In order to ensure that the whole system has a consistent time, 
+				// all acknowledgements must be received before the next event is 
+				// dispatched
 								
-				for ( Address NowReceiver : NowSubscribers )
+				for ( Address NowReceiver : Notified )
 					GetFramework().Send( NextTime, AcknowledgementReceiver, NowReceiver );
 				
 				ConsistentTime->Wait();
@@ -675,11 +740,13 @@ public:
 	// this requires that the receiver is running on the same network endpoint as
 	// this event handler. It returns a shared pointer to the receiver object to 
 	// ensure that it is properly de-allocated when it goes out of scope at some
-	// point.
+	// point. The resolution of the receiver's time can optionally be given.
 	
-  std::shared_ptr< Now< EventTime > > NowReceiverObject( void )
+  std::shared_ptr< Now< EventTime > > NowReceiverObject( 
+		TimeCounter Resolution = 0 )
 	{
-		return std::make_shared< Now< EventTime > >( GetFramework(), GetAddress() );
+		return std::make_shared< Now< EventTime > >( GetFramework(), GetAddress(),
+																								 Resolution );
 	}
 	
   // ---------------------------------------------------------------------------
@@ -750,7 +817,8 @@ public:
 	: Actor( HandlerName ),
 	  StandardFallbackHandler( GetAddress().AsString() ),
 	  EventClock< EventTime >( &CurrentTime ),
-		NowSubscribers(), ConsistentTime( new TimeDistribution() )
+		NowSubscribers(), ConsistentTime( new TimeDistribution() ),
+		NowObservers()
 	{
 		if( EventHandlerName.empty() )
 			EventHandlerName = GetAddress().AsString();
@@ -801,8 +869,14 @@ public:
 // the event and the address of the receiving actor. The last field can be 
 // omitted, which makes the event manager assumed that the event message should 
 // be sent back to the actor setting the event.
+//
+// The events are kept in an event store given as a template taking the event 
+// time and the stored event type. By default integral event times use the 
+// radix store, and other event times use the multimap store, see the event 
+// store header for the details.
 
-template< class EventTime, class EventMessage >
+template< class EventTime, class EventMessage, 
+					template< class, class > class EventStore = DefaultEventStore >
 class DiscreteEventManager : public virtual Actor,
 														 public virtual StandardFallbackHandler,
 														 public virtual EventData,
@@ -815,7 +889,7 @@ public:
   // Events 
   // ---------------------------------------------------------------------------
   //
-  // The events are held in a map structure where the sorting key is the 
+  // The events are held in an event store where the sorting key is the 
   // event time which then identifies which actor to call at that time and 
 	// the message to send to that actor. A shorthand exists allowing the 
 	// address to be omitted in which case the event is sent back to the actor
@@ -861,16 +935,11 @@ private:
 	};
 
   // Then the structure holding the events can be defined as a time sorted 
-	// map sorted on the event times. It is a multi-map since it is perfectly 
-	// possible that two events may occur at the same time.
+	// store sorted on the event times. It must allow several events at the 
+	// same time since it is perfectly possible that two events may occur at 
+	// the same time.
 
-  std::multimap< EventTime, EnqueuedEvent > EventQueue;
-	
-	// In order to iterate over these events, a shorthand for the iterator 
-	// is needed
-	
-	using EventReference 
-				= typename std::multimap< EventTime, EnqueuedEvent >::iterator;
+  EventStore< EventTime, EnqueuedEvent > EventQueue;
 
 protected:
   
@@ -878,7 +947,7 @@ protected:
 
   inline bool PendingEvents ( void )
   {
-    return !EventQueue.empty();
+    return !EventQueue.Empty();
   }
   
   // The event is enqueued by a separate function. The reason for this is 
@@ -888,8 +957,8 @@ protected:
 													const Address & TheEventReceiver, 
 													const EventMessage & TheMessage )
 	{
-	  EventQueue.emplace( TimeOfEvent, 
-												EnqueuedEvent( TheEventReceiver, TheMessage ) );			
+	  EventQueue.Insert( TimeOfEvent, 
+											 EnqueuedEvent( TheEventReceiver, TheMessage ) );			
 	}
   
   // One could think that that retuning the time of the next event would be 
@@ -903,8 +972,8 @@ protected:
   
   virtual EventTime NextEventTime ( void )
   {
-		if ( ! EventQueue.empty() )
-	    return EventQueue.begin()->first;
+		if ( ! EventQueue.Empty() )
+	    return EventQueue.FirstTime();
 		else
 			return EventClock< EventTime>::template Now< EventTime >();
   }
@@ -925,18 +994,41 @@ protected:
   // to update the time as this has already been taken care of by the Event 
   // Handler. However the Event hander will not know if the last event in the 
   // queue was handled, and therefore it is necessary to test for this, and 
-  // since the most efficient way is to have a pointer (iterator) to the first
-  // event in the queue when looking up the message and the address, the test
-  // is done based on this iterator instead of testing directly if the queue is 
-  // "empty()"
-  
+  // the first event is only read from the store if there are events.
+  //
+  // When the events at the same time are known to be independent, for 
+  // instance prediction updates for different producers, they can optionally
+  // all be dispatched at once so that they are processed concurrently. The 
+  // number of dispatched events is then remembered, and the next events will 
+  // not be dispatched until all of them have been acknowledged. Since the time 
+  // cannot advance before all events at the current time have been removed,
+  // the time will only advance when all acknowledgements have been received.
+  // Events added for the current time while the dispatched events are 
+  // processed will be dispatched together when the last one is acknowledged.
+
+private:
+	
+	const bool  ConcurrentDispatch;
+	std::size_t OutstandingEvents;
+	
+protected:
+	
   virtual void DispatchEvent ( void )
   {
-		  auto CurrentEvent = EventQueue.begin();
-		  
-			if ( CurrentEvent != EventQueue.end()  )
-				Send( CurrentEvent->second.Message, 
-							CurrentEvent->second.EventReceiver );
+		if ( ConcurrentDispatch )
+		{
+			if ( OutstandingEvents == 0 )
+				OutstandingEvents = EventQueue.ForEachFirst( 
+				[this]( const EnqueuedEvent & CurrentEvent ){
+					Send( CurrentEvent.Message, CurrentEvent.EventReceiver );
+				});
+		}
+		else if ( ! EventQueue.Empty() )
+		{
+			EnqueuedEvent & CurrentEvent( EventQueue.First() );
+			
+			Send( CurrentEvent.Message, CurrentEvent.EventReceiver );
+		}
   };
 
   // ---------------------------------------------------------------------------
@@ -1016,23 +1108,18 @@ private:
 	// out the time of the first event. This first event will always exist, 
 	// because the complete event function is supposed to remove an event, and
 	// therefore there must be at least one event in the queue. The current time
-	// is then just the first element (key) of the beginning of the queue.
+	// is then just the time of the first event in the store, and the store 
+	// removes the first event at this time for the consumer.
 	
 protected:
 	
 	virtual void CompletedEvent( Address EventConsumer,  
 															 EventCompleted::Outcome Status )
 	{
-		std::pair< EventReference, EventReference > 
-			EventRange = EventQueue.equal_range( EventQueue.begin()->first );
-			
-		for ( EventReference SearchedEvent  = EventRange.first;
-										     SearchedEvent != EventRange.second; ++SearchedEvent ) 
-			if( SearchedEvent->second.EventReceiver == EventConsumer )
-			{
-				EventQueue.erase( SearchedEvent );
-			  break;
-			}
+		if ( EventQueue.EraseFirst( [&]( const EnqueuedEvent & TheEvent ){
+					 return TheEvent.EventReceiver == EventConsumer; }) 
+				 && ( OutstandingEvents > 0 ) )
+			OutstandingEvents--;
 	}
 
   // ---------------------------------------------------------------------------
@@ -1085,7 +1172,7 @@ public:
 		std::shared_ptr< Receiver > 
 			TheObject = std::make_shared< TerminationEventReceiver >();
 			
-		EventQueue.emplace( TimeToStop, 
+		EventQueue.Insert( TimeToStop, 
 							 EnqueuedEvent( TheObject->GetAddress(), EventMessage() ) );
 		
 		return TheObject;
@@ -1095,17 +1182,21 @@ public:
   // Constructor and destructor
   // ---------------------------------------------------------------------------
   //    
-  // The constructor register the message handler for queuing events.
+  // The constructor register the message handler for queuing events. By 
+  // default the events at the same time are dispatched one by one, and the 
+  // concurrent dispatch should only be enabled if the events at the same time
+  // are independent.
 
-  DiscreteEventManager( std::string name = std::string() ) 
+  DiscreteEventManager( std::string name = std::string(), 
+												bool DispatchConcurrently = false ) 
     : Actor( name ),
       StandardFallbackHandler( GetAddress().AsString() ),
       EventData(), EventClock< EventTime >( &CurrentTime ),
       EventHandler< EventTime >( GetAddress().AsString() ),
-      EventQueue()
+      EventQueue(), ConcurrentDispatch( DispatchConcurrently ),
+      OutstandingEvents(0)
   {
-		RegisterHandler( this, 
-		&DiscreteEventManager< EventTime, EventMessage >::EnqueueEvent );
+		RegisterHandler( this, &DiscreteEventManager::EnqueueEvent );
   };
     
   // The destructor simply clears whatever unhanded events there might
@@ -1115,7 +1206,7 @@ public:
   
   virtual ~DiscreteEventManager()
   {
-    EventQueue.clear();
+    EventQueue.Clear();
   };
 };			// End Discrete Event Handler
 
@@ -0,0 +1,444 @@
+/*=============================================================================
+Event Store
+
+The discrete event manager keeps the events sorted on their time of
+occurrence, and it needs only a few operations on this store: to add an event,
+to read the time of the first event, to visit the events at the first time, to
+find and remove one of the events at the first time, and to test if there are
+more events. This file defines two stores supporting these operations, and the
+event manager takes the store to use as a template parameter.
+
+The multimap store is the original implementation where each event is a node
+of a red-black tree. It works for any event time that can be ordered, for
+instance time points of a clock.
+
+The radix store is meant for simulations where the event time is an integral
+count, like seconds, and where millions of events are inserted. The distinct
+event times are kept in a radix heap [1] where the buckets are given by the
+highest bit where the time differs from the last minimum taken from the heap.
+Adding a time or taking the minimum is then amortised constant time since a
+time can only move to lower buckets. The events for one time are stored in a
+vector in the order they were added, as by the multimap, and the hash table
+nodes holding these vectors are pooled when a time has been processed,
+preserving the capacity of the vector. A simulation progressing from time to
+time will therefore normally not allocate memory once the pool is large enough.
+
+The radix heap requires that no time is added before the last minimum. This is
+guaranteed by the event manager's policy of dropping events in the past, but
+a derived manager may allow this, for instance for wall clock events, and the
+heap is then rebuilt around the new minimum.
+
+References:
+[1] Ravindra K. Ahuja, Kurt Mehlhorn, James Orlin, and Robert E. Tarjan (1990):
+    "Faster algorithms for the shortest path problem", Journal of the ACM,
+    Vol. 37, No. 2, pp. 213-223
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+=============================================================================*/
+
+#ifndef THERON_EVENT_STORE
+#define THERON_EVENT_STORE
+
+#include <map>													// The multimap store
+#include <unordered_map>								// The events at each time
+#include <vector>												// Heap buckets and events
+#include <array>												// The radix heap buckets
+#include <limits>												// Bits of the time
+#include <algorithm>										// Minimum of a bucket
+#include <type_traits>									// Integral time types
+#include <utility>											// Moving events
+#include <cstddef>											// Sizes
+
+namespace Theron
+{
+/*=============================================================================
+
+ Multimap store
+
+=============================================================================*/
+//
+// The events are held in a multimap with the event time as the key. Events
+// with the same time are kept in the order they were added.
+
+template< class EventTime, class EventType >
+class MultimapEventStore
+{
+private:
+
+	std::multimap< EventTime, EventType > Events;
+
+public:
+
+	inline bool Empty( void ) const
+	{ return Events.empty(); }
+
+	inline std::size_t Size( void ) const
+	{ return Events.size(); }
+
+	inline void Insert( const EventTime & TimeOfEvent, EventType && TheEvent )
+	{ Events.emplace( TimeOfEvent, std::move( TheEvent ) ); }
+
+	// The time of the first event and the first event itself can only be read
+	// if the store is not empty.
+
+	inline EventTime FirstTime( void )
+	{ return Events.begin()->first; }
+
+	inline EventType & First( void )
+	{ return Events.begin()->second; }
+
+	// All events at the first time can be visited in the order they were 
+	// added, and the number of visited events is returned.
+
+	template< class Function >
+	std::size_t ForEachFirst( Function Visit )
+	{
+		if ( Events.empty() ) return 0;
+
+		auto Range = Events.equal_range( Events.begin()->first );
+		std::size_t Visited = 0;
+
+		for ( auto TheEvent = Range.first; TheEvent != Range.second; ++TheEvent )
+		{
+			Visit( TheEvent->second );
+			Visited++;
+		}
+
+		return Visited;
+	}
+
+	// The first event at the first time satisfying the predicate is removed,
+	// and the function returns true if an event was removed.
+
+	template< class Predicate >
+	bool EraseFirst( Predicate Match )
+	{
+		if ( Events.empty() ) return false;
+
+		auto Range = Events.equal_range( Events.begin()->first );
+
+		for ( auto Candidate = Range.first; Candidate != Range.second; ++Candidate )
+			if ( Match( Candidate->second ) )
+			{
+				Events.erase( Candidate );
+				return true;
+			}
+
+		return false;
+	}
+
+	inline void Clear( void )
+	{ Events.clear(); }
+
+	MultimapEventStore( void ) : Events()
+	{}
+};
+
+/*=============================================================================
+
+ Radix store
+
+=============================================================================*/
+//
+// The times are mapped to unsigned keys preserving the order, which for signed
+// times means flipping the sign bit.
+
+template< class EventTime, class EventType >
+class RadixEventStore
+{
+	static_assert( std::is_integral< EventTime >::value,
+								 "The radix event store requires an integral event time" );
+
+private:
+
+	using Key = typename std::make_unsigned< EventTime >::type;
+
+	static constexpr int KeyBits = std::numeric_limits< Key >::digits;
+
+	static inline Key ToKey( EventTime TimeOfEvent )
+	{
+		if ( std::is_signed< EventTime >::value )
+			return static_cast< Key >( TimeOfEvent ) ^ ( Key(1) << ( KeyBits - 1 ) );
+		else
+			return static_cast< Key >( TimeOfEvent );
+	}
+
+	static inline EventTime ToTime( Key TheKey )
+	{
+		if ( std::is_signed< EventTime >::value )
+			return static_cast< EventTime >( TheKey ^ ( Key(1) << ( KeyBits - 1 ) ) );
+		else
+			return static_cast< EventTime >( TheKey );
+	}
+
+  // ---------------------------------------------------------------------------
+  // Radix heap of the distinct times
+  // ---------------------------------------------------------------------------
+	//
+	// Bucket zero holds keys equal to the last minimum, and bucket b holds the
+	// keys whose highest bit different from the last minimum is bit b-1. The
+	// bit position is computed by counting the leading zeros, which is a single
+	// instruction on most processors.
+
+	std::array< std::vector< Key >, KeyBits + 1 > Buckets;
+	Key 																					LastMinimum;
+
+	static inline int BitWidth( Key Value )
+	{
+		int Width = 0;
+
+		#ifdef __GNUC__
+			if ( Value != 0 )
+				Width = std::numeric_limits< unsigned long long >::digits
+								- __builtin_clzll( static_cast< unsigned long long >( Value ) );
+		#else
+			while ( Value != 0 )
+			{
+				Value >>= 1;
+				Width++;
+			}
+		#endif
+
+		return Width;
+	}
+
+	inline std::vector< Key > & BucketFor( Key TheKey )
+	{ return Buckets[ BitWidth( TheKey ^ LastMinimum ) ]; }
+
+	// Adding a key before the last minimum requires that the last minimum is
+	// set to the new key and all keys are placed in their new buckets.
+
+	void AddKey( Key TheKey )
+	{
+		if ( Index.empty() )
+			LastMinimum = TheKey;
+		else if ( TheKey < LastMinimum )
+		{
+			std::vector< Key > AllKeys;
+
+			for ( std::vector< Key > & Bucket : Buckets )
+			{
+				AllKeys.insert( AllKeys.end(), Bucket.begin(), Bucket.end() );
+				Bucket.clear();
+			}
+
+			LastMinimum = TheKey;
+
+			for ( Key ExistingKey : AllKeys )
+				BucketFor( ExistingKey ).push_back( ExistingKey );
+		}
+
+		BucketFor( TheKey ).push_back( TheKey );
+	}
+
+	// The minimum key is found in bucket zero, and if this is empty the first
+	// non-empty bucket is redistributed around its minimum.
+
+	Key MinimumKey( void )
+	{
+		if ( Buckets[0].empty() )
+		{
+			int First = 1;
+
+			while ( Buckets[ First ].empty() ) First++;
+
+			std::vector< Key > Redistribute;
+
+			Redistribute.swap( Buckets[ First ] );
+			LastMinimum = *std::min_element( Redistribute.begin(),
+																			 Redistribute.end() );
+
+			for ( Key TheKey : Redistribute )
+				BucketFor( TheKey ).push_back( TheKey );
+
+			// The emptied vector is given back to the bucket to keep its capacity
+
+			Redistribute.clear();
+
+			if ( Buckets[ First ].empty() )
+				Buckets[ First ].swap( Redistribute );
+		}
+
+		return Buckets[0].back();
+	}
+
+  // ---------------------------------------------------------------------------
+  // Events at each time
+  // ---------------------------------------------------------------------------
+	//
+	// The events of a time are kept in a vector with the position of the first
+	// remaining event, so that removing the first event does not move the other
+	// events.
+
+	class TimeEvents
+	{
+	public:
+
+		std::vector< EventType > Events;
+		std::size_t							 Head;
+
+		TimeEvents( void ) : Events(), Head(0)
+		{}
+	};
+
+	using EventIndex = std::unordered_map< Key, TimeEvents >;
+
+	EventIndex 													 Index;
+	std::vector< typename EventIndex::node_type > FreeNodes;
+	std::size_t 												 NumberOfEvents;
+
+	// The events of the first time are cached to avoid a hash lookup for every
+	// access to the first event.
+
+	TimeEvents * FirstEvents;
+
+	TimeEvents & FirstTimeEvents( void )
+	{
+		if ( FirstEvents == nullptr )
+			FirstEvents = &( Index.find( MinimumKey() )->second );
+
+		return *FirstEvents;
+	}
+
+public:
+
+	inline bool Empty( void ) const
+	{ return NumberOfEvents == 0; }
+
+	inline std::size_t Size( void ) const
+	{ return NumberOfEvents; }
+
+	// A new time takes a pooled node if there is one. The pointer to the first
+	// events is invalidated since the new time may be earlier, and since the
+	// hash table may be rehashed.
+
+	void Insert( const EventTime & TimeOfEvent, EventType && TheEvent )
+	{
+		Key  TheKey  = ToKey( TimeOfEvent );
+		auto Located = Index.find( TheKey );
+
+		if ( Located == Index.end() )
+		{
+			AddKey( TheKey );
+			FirstEvents = nullptr;
+
+			if ( FreeNodes.empty() )
+				Located = Index.emplace( TheKey, TimeEvents() ).first;
+			else
+			{
+				typename EventIndex::node_type Node( std::move( FreeNodes.back() ) );
+
+				FreeNodes.pop_back();
+				Node.key() = TheKey;
+				Located = Index.insert( std::move( Node ) ).position;
+			}
+		}
+
+		Located->second.Events.push_back( std::move( TheEvent ) );
+		NumberOfEvents++;
+	}
+
+	// The time of the first event and the first event itself can only be read
+	// if the store is not empty.
+
+	inline EventTime FirstTime( void )
+	{ return ToTime( MinimumKey() ); }
+
+	inline EventType & First( void )
+	{
+		TimeEvents & Current( FirstTimeEvents() );
+		return Current.Events[ Current.Head ];
+	}
+
+	// All events at the first time can be visited in the order they were 
+	// added, and the number of visited events is returned.
+
+	template< class Function >
+	std::size_t ForEachFirst( Function Visit )
+	{
+		if ( NumberOfEvents == 0 ) return 0;
+
+		TimeEvents & Current( FirstTimeEvents() );
+
+		for ( std::size_t Position = Current.Head; 
+					Position < Current.Events.size(); Position++ )
+			Visit( Current.Events[ Position ] );
+
+		return Current.Events.size() - Current.Head;
+	}
+
+	// The first event at the first time satisfying the predicate is removed,
+	// and when there are no more events at that time, the time is removed from
+	// the heap and its node is returned to the pool.
+
+	template< class Predicate >
+	bool EraseFirst( Predicate Match )
+	{
+		if ( NumberOfEvents == 0 ) return false;
+
+		TimeEvents & Current( FirstTimeEvents() );
+		std::size_t  Position = Current.Head;
+
+		while ( ( Position < Current.Events.size() ) &&
+						!Match( Current.Events[ Position ] ) )
+			Position++;
+
+		if ( Position == Current.Events.size() ) return false;
+
+		if ( Position == Current.Head )
+			Current.Head++;
+		else
+			Current.Events.erase( Current.Events.begin() + Position );
+
+		NumberOfEvents--;
+
+		if ( Current.Head == Current.Events.size() )
+		{
+			Current.Events.clear();
+			Current.Head = 0;
+
+			Key TheKey = Buckets[0].back();
+
+			Buckets[0].pop_back();
+			FreeNodes.push_back( Index.extract( TheKey ) );
+			FirstEvents = nullptr;
+		}
+
+		return true;
+	}
+
+	void Clear( void )
+	{
+		for ( std::vector< Key > & Bucket : Buckets )
+			Bucket.clear();
+
+		Index.clear();
+		FreeNodes.clear();
+		NumberOfEvents = 0;
+		FirstEvents    = nullptr;
+	}
+
+	RadixEventStore( void )
+	: Buckets(), LastMinimum(0), Index(), FreeNodes(), NumberOfEvents(0),
+	  FirstEvents( nullptr )
+	{}
+};
+
+/*=============================================================================
+
+ Default store
+
+=============================================================================*/
+//
+// The radix store is used for integral event times and the multimap store for
+// all other event times.
+
+template< class EventTime, class EventType >
+using DefaultEventStore = typename std::conditional<
+	std::is_integral< EventTime >::value,
+	RadixEventStore< EventTime, EventType >,
+	MultimapEventStore< EventTime, EventType > >::type;
+
+}       // End name space Theron
+#endif  // THERON_EVENT_STORE
@@ -0,0 +1,189 @@
+/*=============================================================================
+Memory Accounting
+
+This implements the counting accounts, the registry of the accounts and the
+report. The number of threads is read from the task directory of the process
+and the default stack size from the POSIX thread attributes.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+=============================================================================*/
+
+#include <filesystem>										// Counting the threads
+#include <system_error>									// Errors of the file system
+#include <pthread.h>										// The default stack size
+
+#include "Actor.hpp"										// The message pool statistics
+#include "MemoryAccounting.hpp"
+
+namespace Theron
+{
+// -----------------------------------------------------------------------------
+// Accounts
+// -----------------------------------------------------------------------------
+//
+// The bytes are counted after the upstream allocation succeeded so that a
+// failed allocation is not counted.
+
+MemoryAccounting::Account::Account( const std::string & TheName,
+																	  std::pmr::memory_resource * TheUpstream )
+: std::pmr::memory_resource(), Upstream( TheUpstream ), Bytes(0),
+  PeakBytes(0), Allocations(0), Deallocations(0), Name( TheName )
+{ }
+
+void * MemoryAccounting::Account::do_allocate( std::size_t Size,
+																							 std::size_t Alignment )
+{
+	void * Block = Upstream->allocate( Size, Alignment );
+
+	std::size_t Current = Bytes.fetch_add( Size, std::memory_order_relaxed )
+												+ Size,
+							Peak 		= PeakBytes.load( std::memory_order_relaxed );
+
+	while ( ( Current > Peak ) &&
+					!PeakBytes.compare_exchange_weak( Peak, Current,
+																						std::memory_order_relaxed ) );
+
+	Allocations.fetch_add( 1, std::memory_order_relaxed );
+
+	return Block;
+}
+
+void MemoryAccounting::Account::do_deallocate( void * Block, std::size_t Size,
+																							 std::size_t Alignment )
+{
+	Upstream->deallocate( Block, Size, Alignment );
+
+	Bytes.fetch_sub( Size, std::memory_order_relaxed );
+	Deallocations.fetch_add( 1, std::memory_order_relaxed );
+}
+
+// -----------------------------------------------------------------------------
+// Registry
+// -----------------------------------------------------------------------------
+//
+// The map of accounts is never destroyed since containers with static storage
+// duration may return their memory after the static objects of this file
+// have been destroyed.
+
+std::atomic< bool > MemoryAccounting::Tracking( false );
+std::mutex 					MemoryAccounting::AccountGuard;
+
+std::map< std::string, MemoryAccounting::Account * > &
+MemoryAccounting::Accounts( void )
+{
+	static std::map< std::string, Account * > * TheAccounts =
+		new std::map< std::string, Account * >();
+
+	return *TheAccounts;
+}
+
+void MemoryAccounting::Enable( void )
+{
+	Tracking.store( true );
+}
+
+std::pmr::memory_resource *
+MemoryAccounting::Resource( const std::string & Name )
+{
+	if ( !Enabled() )
+		return std::pmr::new_delete_resource();
+
+	std::lock_guard< std::mutex > Lock( AccountGuard );
+
+	auto & TheAccounts( Accounts() );
+	auto 	 Existing = TheAccounts.find( Name );
+
+	if ( Existing != TheAccounts.end() )
+		return Existing->second;
+
+	return TheAccounts.emplace( Name, new Account( Name ) ).first->second;
+}
+
+// -----------------------------------------------------------------------------
+// Reporting
+// -----------------------------------------------------------------------------
+//
+// The message pools are reported per message type, and the bytes held by the
+// pools beyond the live messages are the free blocks. The counters of a pool
+// are read one at the time, so the live bytes may momentarily exceed the
+// bytes taken from the heap.
+
+std::vector< MemoryAccounting::Statistics > MemoryAccounting::Snapshot( void )
+{
+	std::vector< Statistics > Records;
+
+	{
+		std::lock_guard< std::mutex > Lock( AccountGuard );
+
+		for ( const auto & TheAccount : Accounts() )
+			Records.push_back( Statistics{ TheAccount.first,
+				TheAccount.second->CurrentBytes(), TheAccount.second->MaximalBytes(),
+				TheAccount.second->NumberOfAllocations(),
+				TheAccount.second->LiveAllocations(), false } );
+	}
+
+	std::size_t FreeBlocks = 0;
+
+	for ( const auto & Pool : Actor::MessagePoolStatistics() )
+	{
+		Records.push_back( Statistics{ "MessageQueue:" + Pool.MessageType,
+			Pool.LiveBytes, Pool.LiveBytes, Pool.Allocations, 0, false } );
+
+		if ( Pool.HeapBytes > Pool.LiveBytes )
+			FreeBlocks += Pool.HeapBytes - Pool.LiveBytes;
+	}
+
+	Records.push_back( Statistics{ "MessagePools", FreeBlocks, FreeBlocks, 0, 0,
+																 false } );
+
+	// The threads are the entries of the task directory
+
+	std::size_t 		Threads = 0;
+	std::error_code Error;
+
+	for ( std::filesystem::directory_iterator Task( "/proc/self/task", Error );
+				!Error && ( Task != std::filesystem::directory_iterator() );
+				Task.increment( Error ) )
+		Threads++;
+
+	std::size_t 	 StackSize = 0;
+	pthread_attr_t Attributes;
+
+	if ( pthread_attr_init( &Attributes ) == 0 )
+	{
+		pthread_attr_getstacksize( &Attributes, &StackSize );
+		pthread_attr_destroy( &Attributes );
+	}
+
+	Records.push_back( Statistics{ "ThreadStacks", Threads * StackSize,
+																 Threads * StackSize, Threads, Threads, true } );
+
+	return Records;
+}
+
+// The account names are given by the code and the message types are the
+// names given by the run-time type information, so none of them contains
+// characters that must be escaped.
+
+void MemoryAccounting::WriteJSON( std::ostream & Output )
+{
+	std::vector< Statistics > Records( Snapshot() );
+
+	Output << "{\n  \"enabled\": " << ( Enabled() ? "true" : "false" ) << ",\n"
+				 << "  \"accounts\": [";
+
+	for ( auto Record = Records.begin(); Record != Records.end(); ++Record )
+		Output << ( Record == Records.begin() ? "\n" : ",\n" )
+					 << "    { \"account\": \"" << Record->Name << "\", "
+					 << "\"bytes\": " << Record->Bytes << ", "
+					 << "\"peak_bytes\": " << Record->PeakBytes << ", "
+					 << "\"allocations\": " << Record->Allocations << ", "
+					 << "\"live_allocations\": " << Record->LiveAllocations << ", "
+					 << "\"estimated\": " << ( Record->Estimated ? "true" : "false" )
+					 << " }";
+
+	Output << "\n  ]\n}" << std::endl;
+}
+
+}      // End name space Theron
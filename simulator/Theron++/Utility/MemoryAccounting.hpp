@@ -0,0 +1,209 @@
+/*=============================================================================
+Memory Accounting
+
+The resident memory of a process tells how much memory it uses, but not what
+the memory is used for, and it is therefore not possible to tell if a node is
+sized for the number of interpolated profiles, the backlog of messages, or the
+number of consumer proxies it serves, nor to verify that a cache actually
+reduces the footprint. The memory accounting attributes the allocations to
+named accounts, which can be subsystems like the interpolations, the buffers
+of the CSV parser and the workspaces of the optimizers, or classes of actors
+like the consumer proxies.
+
+An account is a polymorphic memory resource [1] that forwards the allocations
+to the standard heap and counts the bytes currently allocated, the peak, and
+the number of allocations with relaxed atomic operations. It is given to the
+containers of the subsystem as the memory resource of their polymorphic
+allocators, and the containers return the memory to the account that
+allocated it. Objects of a class, like actors, are accounted by deriving the
+class from the accounted object template below, which gives the class its
+own operators new and delete allocating from the account named by the class.
+
+Accounting is optional and disabled by default. When it is disabled the
+resource returned for an account is the standard new and delete resource,
+and the only cost is the indirect call of the polymorphic allocator. It must
+be enabled before the accounted objects are created, typically first in the
+main function, and it cannot be disabled again since the accounts must
+outlive the memory they have allocated. For the same reason the accounts are
+never deleted.
+
+The snapshot of the accounts also reports the memory of the messages that
+are queued or being handled, per message type, and the free blocks held by
+the message pools, see Actor::MessagePoolStatistics, which are counted even
+if the accounting is disabled. The stacks of the threads are not allocated
+by the application and cannot be accounted. They are estimated as the number
+of threads of the process times the default stack size, which is the
+reserved address space and an upper bound for the memory used by the stacks.
+
+The snapshot can be written as JSON, and it is exported by the metrics
+exporter when the accounting is enabled.
+
+References:
+[1] https://en.cppreference.com/w/cpp/memory/memory_resource
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+=============================================================================*/
+
+#ifndef THERON_MEMORY_ACCOUNTING
+#define THERON_MEMORY_ACCOUNTING
+
+#include <string>												// Account names
+#include <vector>												// The snapshot
+#include <map>													// The accounts
+#include <memory_resource>							// Polymorphic allocators
+#include <atomic>												// Lock free counting
+#include <mutex>												// Protecting the accounts
+#include <ostream>											// Writing the report
+#include <cstddef>											// Sizes
+
+namespace Theron
+{
+
+class MemoryAccounting
+{
+public:
+
+	// ---------------------------------------------------------------------------
+	// Accounts
+	// ---------------------------------------------------------------------------
+	//
+	// The account counts the bytes and allocations as they pass to the
+	// upstream resource. The peak is raised by a compare and exchange loop,
+	// which only loops if another thread has raised it concurrently.
+
+	class Account : public std::pmr::memory_resource
+	{
+	private:
+
+		std::pmr::memory_resource * const Upstream;
+		std::atomic< std::size_t > 				Bytes, PeakBytes, Allocations,
+																			Deallocations;
+
+	protected:
+
+		virtual void * do_allocate( std::size_t Size,
+																std::size_t Alignment ) override;
+
+		virtual void do_deallocate( void * Block, std::size_t Size,
+																std::size_t Alignment ) override;
+
+		virtual bool do_is_equal( const std::pmr::memory_resource & Other )
+		const noexcept override
+		{ return this == &Other; }
+
+	public:
+
+		const std::string Name;
+
+		inline std::size_t CurrentBytes( void ) const
+		{ return Bytes.load( std::memory_order_relaxed ); }
+
+		inline std::size_t MaximalBytes( void ) const
+		{ return PeakBytes.load( std::memory_order_relaxed ); }
+
+		inline std::size_t NumberOfAllocations( void ) const
+		{ return Allocations.load( std::memory_order_relaxed ); }
+
+		inline std::size_t LiveAllocations( void ) const
+		{
+			return Allocations.load( std::memory_order_relaxed ) -
+						 Deallocations.load( std::memory_order_relaxed );
+		}
+
+		Account( const std::string & TheName,
+						 std::pmr::memory_resource * TheUpstream
+							 = std::pmr::new_delete_resource() );
+
+		Account( void ) = delete;
+		Account( const Account & Other ) = delete;
+	};
+
+	// Accounting is enabled once for the process
+
+	static void Enable( void );
+
+	static inline bool Enabled( void )
+	{ return Tracking.load( std::memory_order_relaxed ); }
+
+	// The resource of an account is created the first time the account is
+	// requested. The lookup takes a lock, and frequent users should keep the
+	// resource rather than looking it up for every container.
+
+	static std::pmr::memory_resource * Resource( const std::string & Name );
+
+	// ---------------------------------------------------------------------------
+	// Accounted objects
+	// ---------------------------------------------------------------------------
+	//
+	// A class is accounted by deriving it from this template with the class
+	// itself as the template argument, and defining the name of its account as
+	// a static string constant called AccountName. Classes derived from an
+	// accounted class are accounted with their base class. The sized delete
+	// operator is given the size of the most derived object by the virtual
+	// destructor, so the class must have a virtual destructor if it is
+	// deleted through a pointer to a base class.
+
+	template< class ObjectType >
+	class AccountedObject
+	{
+	private:
+
+		static std::pmr::memory_resource * ObjectMemory( void )
+		{
+			static std::pmr::memory_resource * TheAccount =
+				Resource( ObjectType::AccountName );
+
+			return TheAccount;
+		}
+
+	public:
+
+		static void * operator new( std::size_t Size )
+		{ return ObjectMemory()->allocate( Size ); }
+
+		static void operator delete( void * Object, std::size_t Size )
+		{ ObjectMemory()->deallocate( Object, Size ); }
+	};
+
+	// ---------------------------------------------------------------------------
+	// Reporting
+	// ---------------------------------------------------------------------------
+	//
+	// The snapshot has one record per account sorted on the account names,
+	// followed by the message queues of each message type, the free blocks of
+	// the message pools, and the estimated thread stacks. The peak is only
+	// known for the accounts, and it equals the current bytes for the others.
+	// The message queues report the number of messages sent, and the stacks
+	// report the number of threads as their allocations.
+
+	class Statistics
+	{
+	public:
+
+		std::string Name;
+		std::size_t Bytes, PeakBytes, Allocations, LiveAllocations;
+		bool 				Estimated;
+	};
+
+	static std::vector< Statistics > Snapshot( void );
+
+	// The JSON report is an object with a flag telling if the accounting is
+	// enabled and an array of the records of the snapshot.
+
+	static void WriteJSON( std::ostream & Output );
+
+private:
+
+	static std::atomic< bool > Tracking;
+	static std::mutex 				 AccountGuard;
+
+	static std::map< std::string, Account * > & Accounts( void );
+
+public:
+
+	MemoryAccounting( void ) = delete;
+};
+
+}      // End name space Theron
+#endif // THERON_MEMORY_ACCOUNTING
@@ -0,0 +1,619 @@
+/*=============================================================================
+Metrics Exporter
+
+This implements the registry of the metrics, the formatting of the metrics
+in the text exposition format, and the small HTTP server answering the
+requests for the metrics. The socket is handled by the POSIX socket interface.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+=============================================================================*/
+
+#include <sstream>											// For nicely formatted errors
+#include <stdexcept>										// Standard exceptions
+#include <fstream>											// Reading the process memory
+#include <algorithm>										// Checking names
+#include <limits>												// Infinite bucket bounds
+#include <cctype>												// Character classes
+#include <cstring>											// Error messages
+#include <cerrno>												// Error numbers
+
+#include <sys/socket.h>									// POSIX sockets
+#include <netinet/in.h>									// Internet addresses
+#include <arpa/inet.h>									// Address conversion
+#include <poll.h>												// Waiting for connections
+#include <unistd.h>											// Closing sockets and page size
+
+#include "Actor.hpp"										// The actor metrics
+#include "MemoryAccounting.hpp"					// The memory accounts
+#include "MetricsExporter.hpp"
+
+namespace Theron
+{
+// -----------------------------------------------------------------------------
+// Metrics
+// -----------------------------------------------------------------------------
+//
+// The sum of a histogram is a double, and it is added by a compare and
+// exchange loop since atomic doubles have no fetch and add before C++20.
+
+void MetricsExporter::Counter::Write( std::ostream & Output,
+	const std::string & Name, const std::string & LabelText ) const
+{
+	Output << Name << LabelText << ' ' << Get() << '\n';
+}
+
+void MetricsExporter::Gauge::Write( std::ostream & Output,
+	const std::string & Name, const std::string & LabelText ) const
+{
+	Output << Name << LabelText << ' ' << Get() << '\n';
+}
+
+MetricsExporter::Histogram::Histogram( const std::vector< double > & UpperBounds )
+: Bounds( UpperBounds ),
+  Buckets( new std::atomic< std::uint64_t >[ UpperBounds.size() + 1 ] ),
+  Observations( 0 ), Sum( 0.0 )
+{
+	if ( !std::is_sorted( Bounds.begin(), Bounds.end() ) ||
+			 std::adjacent_find( Bounds.begin(), Bounds.end() ) != Bounds.end() )
+	{
+		std::ostringstream ErrorMessage;
+
+		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "The bucket bounds of a histogram must be increasing";
+
+		throw std::invalid_argument( ErrorMessage.str() );
+	}
+
+	for ( std::size_t i = 0; i <= Bounds.size(); i++ )
+		Buckets[i].store( 0, std::memory_order_relaxed );
+}
+
+void MetricsExporter::Histogram::Observe( double Value )
+{
+	std::size_t TheBucket = std::lower_bound( Bounds.begin(), Bounds.end(),
+																						Value ) - Bounds.begin();
+
+	Buckets[ TheBucket ].fetch_add( 1, std::memory_order_relaxed );
+	Observations.fetch_add( 1, std::memory_order_relaxed );
+
+	double Current = Sum.load( std::memory_order_relaxed );
+
+	while ( !Sum.compare_exchange_weak( Current, Current + Value,
+																			std::memory_order_relaxed ) )
+	{ }
+}
+
+// The labels of the metric are given as a label text, and the bucket bound
+// must be inserted as the last label.
+
+void MetricsExporter::Histogram::Write( std::ostream & Output,
+	const std::string & Name, const std::string & LabelText ) const
+{
+	std::string Prefix( LabelText.empty() ? "{" :
+											LabelText.substr( 0, LabelText.size() - 1 ) + "," );
+	std::uint64_t Cumulative = 0;
+
+	for ( std::size_t i = 0; i < Bounds.size(); i++ )
+	{
+		Cumulative += Buckets[i].load( std::memory_order_relaxed );
+		Output << Name << "_bucket" << Prefix << "le=\"" << Bounds[i] << "\"} "
+					 << Cumulative << '\n';
+	}
+
+	Cumulative += Buckets[ Bounds.size() ].load( std::memory_order_relaxed );
+
+	Output << Name << "_bucket" << Prefix << "le=\"+Inf\"} " << Cumulative << '\n'
+				 << Name << "_sum" << LabelText << ' '
+				 << Sum.load( std::memory_order_relaxed ) << '\n'
+				 << Name << "_count" << LabelText << ' ' << Cumulative << '\n';
+}
+
+const std::vector< double > & MetricsExporter::LatencyBounds( void )
+{
+	static const std::vector< double > Bounds{ 0.001, 0.0025, 0.005, 0.01,
+		0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0 };
+
+	return Bounds;
+}
+
+// -----------------------------------------------------------------------------
+// Registry
+// -----------------------------------------------------------------------------
+//
+// A metric name must start with a letter, an underscore or a colon, and the
+// other characters can also be digits. The label names follow the same rule
+// except that colons are not allowed, and the label values are escaped.
+
+std::mutex 																	 MetricsExporter::RegistryGuard;
+std::map< std::string, MetricsExporter::Family > MetricsExporter::Families;
+std::map< MetricsExporter::CollectorID, MetricsExporter::Collector >
+																						 MetricsExporter::Collectors;
+MetricsExporter::CollectorID 								 MetricsExporter::NextCollector = 1;
+
+namespace
+{
+	bool ValidName( const std::string & Name, bool Colons )
+	{
+		if ( Name.empty() || std::isdigit( static_cast< unsigned char >( Name[0] ) ) )
+			return false;
+
+		return std::all_of( Name.begin(), Name.end(), [=]( char Character ){
+			return std::isalnum( static_cast< unsigned char >( Character ) ) ||
+						 ( Character == '_' ) || ( Colons && ( Character == ':' ) ); });
+	}
+}
+
+std::string MetricsExporter::LabelText( const Labels & TheLabels )
+{
+	if ( TheLabels.empty() )
+		return std::string();
+
+	std::string Text( "{" );
+
+	for ( const auto & [ Name, Value ] : TheLabels )
+	{
+		if ( !ValidName( Name, false ) )
+		{
+			std::ostringstream ErrorMessage;
+
+			ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+									 << "\"" << Name << "\" is not a valid label name";
+
+			throw std::invalid_argument( ErrorMessage.str() );
+		}
+
+		if ( Text.size() > 1 ) Text.push_back( ',' );
+
+		Text += Name + "=\"";
+
+		for ( char Character : Value )
+			switch ( Character )
+			{
+				case '\\': Text += "\\\\"; break;
+				case '"':  Text += "\\\""; break;
+				case '\n': Text += "\\n";  break;
+				default:   Text.push_back( Character );
+			}
+
+		Text.push_back( '"' );
+	}
+
+	return Text + "}";
+}
+
+void MetricsExporter::Register( const std::string & Name,
+	const std::string & Type, const std::string & Help,
+	const Labels & TheLabels, const std::shared_ptr< Metric > & TheMetric )
+{
+	if ( !ValidName( Name, true ) )
+	{
+		std::ostringstream ErrorMessage;
+
+		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "\"" << Name << "\" is not a valid metric name";
+
+		throw std::invalid_argument( ErrorMessage.str() );
+	}
+
+	std::string TheLabelText( LabelText( TheLabels ) );
+
+	std::lock_guard< std::mutex > Lock( RegistryGuard );
+
+	auto [ TheFamily, New ] = Families.try_emplace( Name, Family{ Type, Help,
+															{} } );
+
+	if ( !New && ( TheFamily->second.Type != Type ) )
+	{
+		std::ostringstream ErrorMessage;
+
+		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "The metric " << Name << " is a "
+								 << TheFamily->second.Type << " and not a " << Type;
+
+		throw std::invalid_argument( ErrorMessage.str() );
+	}
+
+	TheFamily->second.Members.emplace_back( TheLabelText, TheMetric );
+}
+
+std::shared_ptr< MetricsExporter::Counter > MetricsExporter::NewCounter(
+	const std::string & Name, const std::string & Help, const Labels & TheLabels )
+{
+	auto TheCounter = std::make_shared< Counter >();
+
+	Register( Name, "counter", Help, TheLabels, TheCounter );
+	return TheCounter;
+}
+
+std::shared_ptr< MetricsExporter::Gauge > MetricsExporter::NewGauge(
+	const std::string & Name, const std::string & Help, const Labels & TheLabels )
+{
+	auto TheGauge = std::make_shared< Gauge >();
+
+	Register( Name, "gauge", Help, TheLabels, TheGauge );
+	return TheGauge;
+}
+
+std::shared_ptr< MetricsExporter::Histogram > MetricsExporter::NewHistogram(
+	const std::string & Name, const std::string & Help,
+	const std::vector< double > & UpperBounds, const Labels & TheLabels )
+{
+	auto TheHistogram = std::make_shared< Histogram >( UpperBounds );
+
+	Register( Name, "histogram", Help, TheLabels, TheHistogram );
+	return TheHistogram;
+}
+
+MetricsExporter::CollectorID
+MetricsExporter::AddCollector( const Collector & TheCollector )
+{
+	std::lock_guard< std::mutex > Lock( RegistryGuard );
+
+	CollectorID TheID = NextCollector++;
+
+	Collectors.emplace( TheID, TheCollector );
+	return TheID;
+}
+
+void MetricsExporter::RemoveCollector( CollectorID TheCollector )
+{
+	std::lock_guard< std::mutex > Lock( RegistryGuard );
+	Collectors.erase( TheCollector );
+}
+
+// -----------------------------------------------------------------------------
+// Formatting
+// -----------------------------------------------------------------------------
+
+void MetricsExporter::WriteFamily( std::ostream & Output,
+	const std::string & Name, const std::string & Type, const std::string & Help )
+{
+	Output << "# HELP " << Name << ' ';
+
+	for ( char Character : Help )
+		switch ( Character )
+		{
+			case '\\': Output << "\\\\"; break;
+			case '\n': Output << "\\n";  break;
+			default:   Output << Character;
+		}
+
+	Output << "\n# TYPE " << Name << ' ' << Type << '\n';
+}
+
+void MetricsExporter::WriteSample( std::ostream & Output,
+	const std::string & Name, const Labels & TheLabels, double Value )
+{
+	Output << Name << LabelText( TheLabels ) << ' ' << Value << '\n';
+}
+
+// The resident memory is the second field of the memory statistics of the
+// process, counted in pages. It is not written if it cannot be read, as on
+// systems without the proc file system.
+
+void MetricsExporter::WriteProcessMetrics( std::ostream & Output )
+{
+	std::ifstream Statistics( "/proc/self/statm" );
+	std::uint64_t VirtualPages = 0, ResidentPages = 0;
+
+	if ( Statistics >> VirtualPages >> ResidentPages )
+	{
+		WriteFamily( Output, "process_resident_memory_bytes", "gauge",
+								 "Resident memory size in bytes" );
+		Output << "process_resident_memory_bytes "
+					 << ResidentPages * static_cast< std::uint64_t >(
+							  ::sysconf( _SC_PAGESIZE ) ) << '\n';
+	}
+}
+
+// The actor metrics are written family by family. The handler time buckets
+// ending at every second power of two nanoseconds are the buckets 4k+3 of
+// the actor's histogram, which end at 2^(k+2) nanoseconds.
+
+void MetricsExporter::WriteActorMetrics( std::ostream & Output )
+{
+	if ( !Actor::MetricsEnabled() )
+		return;
+
+	std::vector< Actor::ActorMetrics > Snapshot( Actor::MetricsSnapshot() );
+
+	auto ActorClass = []( const std::string & Name ){
+		std::string Class( Name.substr( 0, Name.find_first_of( "0123456789" ) ) );
+
+		while ( !Class.empty() &&
+						!std::isalnum( static_cast< unsigned char >( Class.back() ) ) )
+			Class.pop_back();
+
+		return Class.empty() ? Name : Class;
+	};
+
+	WriteFamily( Output, "theron_actor_mailbox_depth", "gauge",
+							 "Messages queued for the actor when it last handled one" );
+
+	for ( const auto & TheActor : Snapshot )
+		WriteSample( Output, "theron_actor_mailbox_depth",
+			{ { "actor", TheActor.ActorName },
+			  { "class", ActorClass( TheActor.ActorName ) } },
+			static_cast< double >( TheActor.QueuedMessages ) );
+
+	WriteFamily( Output, "theron_actor_mailbox_depth_max", "gauge",
+							 "Largest number of messages queued for the actor" );
+
+	for ( const auto & TheActor : Snapshot )
+		WriteSample( Output, "theron_actor_mailbox_depth_max",
+			{ { "actor", TheActor.ActorName },
+			  { "class", ActorClass( TheActor.ActorName ) } },
+			static_cast< double >( TheActor.MaximalQueue ) );
+
+	WriteFamily( Output, "theron_actor_messages_total", "counter",
+							 "Messages handled by the actor per message type" );
+
+	for ( const auto & TheActor : Snapshot )
+		for ( const auto & Handler : TheActor.MessageTypes )
+			WriteSample( Output, "theron_actor_messages_total",
+				{ { "actor", TheActor.ActorName },
+				  { "class", ActorClass( TheActor.ActorName ) },
+				  { "type", Handler.MessageType } },
+				static_cast< double >( Handler.Messages ) );
+
+	WriteFamily( Output, "theron_actor_handler_seconds", "histogram",
+							 "Time spent in the message handlers of the actor" );
+
+	constexpr std::size_t FirstOctave = 8, LastOctave = 34;
+
+	for ( const auto & TheActor : Snapshot )
+		for ( const auto & Handler : TheActor.MessageTypes )
+		{
+			std::string TheLabels( LabelText(
+				{ { "actor", TheActor.ActorName },
+				  { "class", ActorClass( TheActor.ActorName ) },
+				  { "type", Handler.MessageType } } ) );
+			std::string Prefix( TheLabels.substr( 0, TheLabels.size() - 1 ) + "," );
+			std::uint64_t Cumulative = 0;
+			std::size_t 	Counted 	 = 0;
+
+			for ( std::size_t Octave = FirstOctave; Octave <= LastOctave;
+						Octave += 2 )
+			{
+				std::size_t Last = Actor::HandlerMetrics::BucketsPerOctave * Octave + 3;
+
+				for ( ; Counted <= Last; Counted++ )
+					Cumulative += Handler.Histogram[ Counted ];
+
+				Output << "theron_actor_handler_seconds_bucket" << Prefix << "le=\""
+							 << Actor::HandlerMetrics::BucketSeconds( Last ) << "\"} "
+							 << Cumulative << '\n';
+			}
+
+			Output << "theron_actor_handler_seconds_bucket" << Prefix
+						 << "le=\"+Inf\"} " << Handler.Messages << '\n'
+						 << "theron_actor_handler_seconds_sum" << TheLabels << ' '
+						 << Handler.HandlerSeconds << '\n'
+						 << "theron_actor_handler_seconds_count" << TheLabels << ' '
+						 << Handler.Messages << '\n';
+		}
+}
+
+// The memory accounts are exported with the account name as label, and the
+// estimated thread stacks are marked as such by a label so that they can be
+// excluded from sums.
+
+void MetricsExporter::WriteMemoryMetrics( std::ostream & Output )
+{
+	if ( !MemoryAccounting::Enabled() )
+		return;
+
+	std::vector< MemoryAccounting::Statistics >
+		Snapshot( MemoryAccounting::Snapshot() );
+
+	auto AccountLabels = []( const MemoryAccounting::Statistics & Record ){
+		return Labels{ { "account", Record.Name },
+									 { "estimated", Record.Estimated ? "true" : "false" } };
+	};
+
+	WriteFamily( Output, "theron_memory_bytes", "gauge",
+							 "Bytes currently allocated by the memory account" );
+
+	for ( const auto & Record : Snapshot )
+		WriteSample( Output, "theron_memory_bytes", AccountLabels( Record ),
+								 Record.Bytes );
+
+	WriteFamily( Output, "theron_memory_peak_bytes", "gauge",
+							 "Largest number of bytes allocated by the memory account" );
+
+	for ( const auto & Record : Snapshot )
+		WriteSample( Output, "theron_memory_peak_bytes", AccountLabels( Record ),
+								 Record.PeakBytes );
+
+	WriteFamily( Output, "theron_memory_allocations_total", "counter",
+							 "Allocations made by the memory account" );
+
+	for ( const auto & Record : Snapshot )
+		WriteSample( Output, "theron_memory_allocations_total",
+								 AccountLabels( Record ), Record.Allocations );
+}
+
+// The metrics of the registry are written family by family, and the members
+// that have been deleted by the application are removed. The registry lock
+// is held while the collectors write, so a collector must not register
+// metrics.
+
+void MetricsExporter::WriteMetrics( std::ostream & Output )
+{
+	std::ostringstream Buffer;
+
+	Buffer.precision( 15 );
+
+	WriteProcessMetrics( Buffer );
+	WriteActorMetrics( Buffer );
+	WriteMemoryMetrics( Buffer );
+
+	{
+		std::lock_guard< std::mutex > Lock( RegistryGuard );
+
+		for ( auto TheFamily = Families.begin(); TheFamily != Families.end(); )
+		{
+			auto & Members( TheFamily->second.Members );
+
+			Members.remove_if( []( const auto & Member ){
+				return Member.second.expired(); });
+
+			if ( Members.empty() )
+			{
+				TheFamily = Families.erase( TheFamily );
+				continue;
+			}
+
+			WriteFamily( Buffer, TheFamily->first, TheFamily->second.Type,
+									 TheFamily->second.Help );
+
+			for ( const auto & [ TheLabels, TheMember ] : Members )
+				if ( auto TheMetric = TheMember.lock() )
+					TheMetric->Write( Buffer, TheFamily->first, TheLabels );
+
+			++TheFamily;
+		}
+
+		for ( const auto & TheCollector : Collectors )
+			TheCollector.second( Buffer );
+	}
+
+	Output << Buffer.str();
+}
+
+// -----------------------------------------------------------------------------
+// HTTP server
+// -----------------------------------------------------------------------------
+//
+// The request is read until the end of the header, and only the request line
+// is used. The metrics are returned for a GET request for the root or the
+// metrics path, and the connection is closed after the response. A client
+// that does not send its request within a couple of seconds is dropped.
+
+void MetricsExporter::Respond( int Connection )
+{
+	std::string Request;
+	char 				Buffer[ 1024 ];
+	pollfd 			Client{ Connection, POLLIN, 0 };
+
+	while ( ( Request.find( "\r\n\r\n" ) == std::string::npos ) &&
+					( Request.size() < 8192 ) && ( ::poll( &Client, 1, 2000 ) > 0 ) )
+	{
+		ssize_t Received = ::recv( Connection, Buffer, sizeof( Buffer ), 0 );
+
+		if ( Received <= 0 ) return;
+
+		Request.append( Buffer, Received );
+	}
+
+	std::istringstream RequestLine( Request );
+	std::string Method, Path, Status( "200 OK" ), Body;
+
+	RequestLine >> Method >> Path;
+
+	if ( Method != "GET" )
+	{
+		Status = "405 Method Not Allowed";
+		Body 	 = "Only GET is supported\n";
+	}
+	else if ( ( Path == "/" ) || ( Path == "/metrics" ) )
+	{
+		std::ostringstream Metrics;
+
+		WriteMetrics( Metrics );
+		Body = Metrics.str();
+	}
+	else
+	{
+		Status = "404 Not Found";
+		Body 	 = "The metrics are served at /metrics\n";
+	}
+
+	std::ostringstream Response;
+
+	Response << "HTTP/1.1 " << Status << "\r\n"
+					 << "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+					 << "Content-Length: " << Body.size() << "\r\n"
+					 << "Connection: close\r\n\r\n" << Body;
+
+	const std::string Reply( Response.str() );
+	std::size_t 			Sent = 0;
+
+	while ( Sent < Reply.size() )
+	{
+		ssize_t Written = ::send( Connection, Reply.data() + Sent,
+															Reply.size() - Sent, MSG_NOSIGNAL );
+
+		if ( Written <= 0 ) return;
+
+		Sent += Written;
+	}
+}
+
+void MetricsExporter::Serve( void )
+{
+	pollfd Waiting{ Listener, POLLIN, 0 };
+
+	while ( !Stop.load() )
+		if ( ::poll( &Waiting, 1, 200 ) > 0 )
+		{
+			int Connection = ::accept( Listener, nullptr, nullptr );
+
+			if ( Connection >= 0 )
+			{
+				Respond( Connection );
+				::close( Connection );
+			}
+		}
+}
+
+// -----------------------------------------------------------------------------
+// Constructor and destructor
+// -----------------------------------------------------------------------------
+
+MetricsExporter::MetricsExporter( unsigned short ThePort,
+																	const std::string & Interface )
+: Listener( ::socket( AF_INET, SOCK_STREAM, 0 ) ), ServerPort( ThePort ),
+  Stop( false ), Server()
+{
+	sockaddr_in Address{};
+	socklen_t 	AddressLength = sizeof( Address );
+	int 				Reuse = 1;
+
+	Address.sin_family = AF_INET;
+	Address.sin_port 	 = htons( ThePort );
+
+	if ( ( Listener < 0 ) ||
+			 ( ::inet_pton( AF_INET, Interface.c_str(), &Address.sin_addr ) != 1 ) ||
+			 ( ::setsockopt( Listener, SOL_SOCKET, SO_REUSEADDR, &Reuse,
+											 sizeof( Reuse ) ) != 0 ) ||
+			 ( ::bind( Listener, reinterpret_cast< sockaddr * >( &Address ),
+								 sizeof( Address ) ) != 0 ) ||
+			 ( ::listen( Listener, 16 ) != 0 ) ||
+			 ( ::getsockname( Listener, reinterpret_cast< sockaddr * >( &Address ),
+												&AddressLength ) != 0 ) )
+	{
+		std::ostringstream ErrorMessage;
+
+		ErrorMessage << __FILE__ << " at line " << __LINE__ << ": "
+								 << "Could not serve the metrics on " << Interface << ":"
+								 << ThePort << " (" << std::strerror( errno ) << ")";
+
+		if ( Listener >= 0 ) ::close( Listener );
+
+		throw std::runtime_error( ErrorMessage.str() );
+	}
+
+	ServerPort = ntohs( Address.sin_port );
+	Server 		 = std::thread( &MetricsExporter::Serve, this );
+}
+
+MetricsExporter::~MetricsExporter( void )
+{
+	Stop.store( true );
+	Server.join();
+	::close( Listener );
+}
+
+}      // End name space Theron
@@ -0,0 +1,272 @@
+/*=============================================================================
+Metrics Exporter
+
+The actor metrics can be written as JSON to a file, but a production system
+is normally monitored by a time series database like Prometheus [1] that
+periodically fetches the current values of the metrics from each process over
+HTTP. The metrics exporter serves the metrics of the process in the text
+exposition format of Prometheus on a given TCP port, and any HTTP GET request
+is answered with the current values of all the metrics.
+
+The application can register three kinds of metrics. A counter only
+increases, like the number of messages sent. A gauge is a value that can go
+up and down, like the length of a queue. A histogram counts observed values,
+typically latencies, in buckets with given upper bounds, and keeps the number
+and the sum of the observations. Each metric has a name, a help text, and
+optionally a set of labels with values that distinguish for instance the
+counters of different producers. Metrics with the same name form a family and
+must be of the same kind. A new metric is registered with the exporter when it
+is created, and the application keeps a shared pointer to it and updates it
+with relaxed atomic operations, so that the collection is lock free and costs
+no more than incrementing a counter. The registry only holds weak pointers,
+and a metric is no longer exported when the application has deleted it, for
+instance when the actor owning it is closed.
+
+Values that are already counted by other objects, like the statistics of a
+queue, can be exported by a collector function that is called when the
+metrics are served and writes the values with the given helper functions.
+
+The exporter always exports the resident memory of the process, and the
+actor metrics if they are collected, see Actor::EnableMetrics. The actor
+metrics are labelled with the name of the actor and its class, which is the
+actor name up to the first digit without trailing punctuation, so that the
+mailbox depths and message rates can be aggregated over all consumers or all
+producers of an endpoint. The handler time histograms are reduced to one
+bucket for every second power of two nanoseconds from about a microsecond to
+about a minute. When the memory accounting is enabled, the bytes of each
+memory account are exported, see MemoryAccounting.
+
+The server is a single thread accepting one connection at the time, which is
+sufficient for a few scrapes per minute. It binds to all interfaces unless an
+interface address is given, and a port of zero will use a free port that can
+be read from the exporter.
+
+References:
+[1] https://prometheus.io/docs/instrumenting/exposition_formats/
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+=============================================================================*/
+
+#ifndef THERON_METRICS_EXPORTER
+#define THERON_METRICS_EXPORTER
+
+#include <string>												// Names and labels
+#include <vector>												// Labels and buckets
+#include <map>													// The metric families
+#include <list>													// Collectors
+#include <memory>												// Shared metrics
+#include <atomic>												// Lock free updates
+#include <functional>										// Collector functions
+#include <ostream>											// Writing the metrics
+#include <mutex>												// Protecting the registry
+#include <thread>												// The server thread
+#include <utility>											// Label pairs
+#include <cstdint>											// Counters
+
+namespace Theron
+{
+
+class MetricsExporter
+{
+public:
+
+	using Labels = std::vector< std::pair< std::string, std::string > >;
+
+	// ---------------------------------------------------------------------------
+	// Metrics
+	// ---------------------------------------------------------------------------
+	//
+	// The metrics write their samples given the name of the family and the
+	// formatted labels of the metric.
+
+	class Metric
+	{
+	public:
+
+		virtual void Write( std::ostream & Output, const std::string & Name,
+												const std::string & LabelText ) const = 0;
+
+		virtual ~Metric( void )
+		{ }
+	};
+
+	class Counter : public Metric
+	{
+	private:
+
+		std::atomic< std::uint64_t > Value;
+
+	public:
+
+		inline void Add( std::uint64_t Increment = 1 )
+		{ Value.fetch_add( Increment, std::memory_order_relaxed ); }
+
+		inline std::uint64_t Get( void ) const
+		{ return Value.load( std::memory_order_relaxed ); }
+
+		virtual void Write( std::ostream & Output, const std::string & Name,
+												const std::string & LabelText ) const override;
+
+		Counter( void )
+		: Value( 0 )
+		{ }
+	};
+
+	class Gauge : public Metric
+	{
+	private:
+
+		std::atomic< double > Value;
+
+	public:
+
+		inline void Set( double NewValue )
+		{ Value.store( NewValue, std::memory_order_relaxed ); }
+
+		inline double Get( void ) const
+		{ return Value.load( std::memory_order_relaxed ); }
+
+		virtual void Write( std::ostream & Output, const std::string & Name,
+												const std::string & LabelText ) const override;
+
+		Gauge( void )
+		: Value( 0.0 )
+		{ }
+	};
+
+	// The histogram counts each observation in the first bucket whose upper
+	// bound is not less than the observation, and the buckets are made
+	// cumulative when they are written. The bounds must be increasing.
+
+	class Histogram : public Metric
+	{
+	private:
+
+		const std::vector< double > 										 Bounds;
+		std::unique_ptr< std::atomic< std::uint64_t >[] > Buckets;
+		std::atomic< std::uint64_t > 										 Observations;
+		std::atomic< double > 													 Sum;
+
+	public:
+
+		void Observe( double Value );
+
+		virtual void Write( std::ostream & Output, const std::string & Name,
+												const std::string & LabelText ) const override;
+
+		Histogram( const std::vector< double > & UpperBounds );
+		Histogram( void ) = delete;
+	};
+
+	// There are default bucket bounds for latencies in seconds from one
+	// millisecond to one minute.
+
+	static const std::vector< double > & LatencyBounds( void );
+
+	// ---------------------------------------------------------------------------
+	// Registry
+	// ---------------------------------------------------------------------------
+	//
+	// The factory functions register a new metric with the given name, help
+	// text and labels. They throw an invalid argument exception if the name is
+	// not a valid metric name, or if a family of that name exists with another
+	// kind of metrics.
+
+	static std::shared_ptr< Counter > NewCounter( const std::string & Name,
+		const std::string & Help, const Labels & TheLabels = Labels() );
+
+	static std::shared_ptr< Gauge > NewGauge( const std::string & Name,
+		const std::string & Help, const Labels & TheLabels = Labels() );
+
+	static std::shared_ptr< Histogram > NewHistogram( const std::string & Name,
+		const std::string & Help,
+		const std::vector< double > & UpperBounds = LatencyBounds(),
+		const Labels & TheLabels = Labels() );
+
+	// A collector is a function writing samples when the metrics are served.
+	// It is identified by a number so that it can be removed, and it must be
+	// removed before the objects it reads are destroyed.
+
+	using Collector 	= std::function< void( std::ostream & ) >;
+	using CollectorID = std::uint64_t;
+
+	static CollectorID AddCollector( const Collector & TheCollector );
+	static void 			 RemoveCollector( CollectorID TheCollector );
+
+	// The helper functions write the type and the help text of a family, and
+	// one sample of the family with the given labels.
+
+	static void WriteFamily( std::ostream & Output, const std::string & Name,
+													 const std::string & Type, const std::string & Help );
+
+	static void WriteSample( std::ostream & Output, const std::string & Name,
+													 const Labels & TheLabels, double Value );
+
+	// All metrics can be written to a stream in the exposition format, which
+	// is the body of the HTTP response.
+
+	static void WriteMetrics( std::ostream & Output );
+
+private:
+
+	class Family
+	{
+	public:
+
+		std::string Type, Help;
+		std::list< std::pair< std::string, std::weak_ptr< Metric > > > Members;
+	};
+
+	static std::mutex RegistryGuard;
+	static std::map< std::string, Family > Families;
+	static std::map< CollectorID, Collector > Collectors;
+	static CollectorID NextCollector;
+
+	static void Register( const std::string & Name, const std::string & Type,
+												const std::string & Help, const Labels & TheLabels,
+												const std::shared_ptr< Metric > & TheMetric );
+
+	static std::string LabelText( const Labels & TheLabels );
+
+	// The built in metrics of the process and the actors
+
+	static void WriteProcessMetrics( std::ostream & Output );
+	static void WriteActorMetrics( std::ostream & Output );
+	static void WriteMemoryMetrics( std::ostream & Output );
+
+	// ---------------------------------------------------------------------------
+	// HTTP server
+	// ---------------------------------------------------------------------------
+	//
+	// The server thread polls the listening socket so that it can see the
+	// stop flag set by the destructor.
+
+	int 							 Listener;
+	unsigned short 		 ServerPort;
+	std::atomic< bool > Stop;
+	std::thread 			 Server;
+
+	void Serve( void );
+	void Respond( int Connection );
+
+public:
+
+	inline unsigned short Port( void ) const
+	{ return ServerPort; }
+
+	// The constructor starts serving the metrics on the given port and
+	// interface address, and it throws a runtime error exception if the
+	// socket cannot be bound. The destructor stops the server.
+
+	MetricsExporter( unsigned short ThePort,
+									 const std::string & Interface = "0.0.0.0" );
+
+	MetricsExporter( void ) = delete;
+	MetricsExporter( const MetricsExporter & Other ) = delete;
+
+	~MetricsExporter( void );
+};
+
+}      // End name space Theron
+#endif // THERON_METRICS_EXPORTER
@@ -0,0 +1,170 @@
+/*=============================================================================
+Profiler Annotations
+
+A sampling profiler like perf, VTune or Tracy shows where the time is spent,
+but all the Postman threads execute the same dispatch function, and the
+boundaries between the handling of two messages are invisible. Knowing that
+the time is spent in a solver is of little help if it is not known which
+producer ran the solver for which message. The annotations mark zones of the
+code with a name and optionally a detail text, like the name of the actor and
+the type of the message being handled, so that the profiler can show the
+zones on the time line of each thread. The threads can also be named.
+
+The annotations are selected at compile time by defining one of the
+following macros, and the corresponding library must then be available:
+
+THERON_PROFILE_TRACY - Tracy zones [1]; the Tracy client must be compiled
+                       with TRACY_ENABLE and linked with the application.
+THERON_PROFILE_ITT   - Tasks of the Instrumentation and Tracing Technology
+                       API [2] seen by VTune; link with -littnotify.
+THERON_PROFILE_SDT   - Statically defined tracing probes [3] seen by perf
+                       as sdt_theron:zone_begin and sdt_theron:zone_end once
+                       they are added with perf probe. The probes are no-op
+                       instructions until they are enabled, and perf knows
+                       the threads by the names of the Postmen.
+
+If none of these is defined, the macros expand to nothing and the detail
+texts are not even evaluated, so the annotations have no cost.
+
+A zone extends from the macro to the end of the enclosing scope, and there
+can only be one zone in a scope. The zone name must be a string literal, and
+the detail is an expression giving a standard string.
+
+References:
+[1] https://github.com/wolfpld/tracy
+[2] https://github.com/intel/ittapi
+[3] https://sourceware.org/systemtap/wiki/UserSpaceProbeImplementation
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+=============================================================================*/
+
+#ifndef THERON_PROFILER_ANNOTATIONS
+#define THERON_PROFILER_ANNOTATIONS
+
+#if defined( THERON_PROFILE_TRACY )
+
+#include <string>												// Zone texts and thread names
+#include <tracy/Tracy.hpp>							// Tracy zones
+
+#define THERON_PROFILE_ZONE( Name ) ZoneScopedN( Name )
+
+#define THERON_PROFILE_ZONE_DETAIL( Name, Detail ) 													\
+	ZoneScopedN( Name );																									\
+	{																																			\
+		const std::string TheronZoneDetail( Detail );												\
+		ZoneText( TheronZoneDetail.data(), TheronZoneDetail.size() );				\
+	}
+
+#define THERON_PROFILE_THREAD( Name )																		\
+	tracy::SetThreadName( std::string( Name ).c_str() )
+
+#elif defined( THERON_PROFILE_ITT ) || defined( THERON_PROFILE_SDT )
+
+#include <string>												// Zone texts
+
+#if defined( THERON_PROFILE_ITT )
+	#include <ittnotify.h>								// VTune tasks
+#else
+	#include <sys/sdt.h>									// Probes for perf
+#endif
+
+namespace Theron
+{
+// The zone is an object that starts the task or fires the begin probe when
+// it is constructed and ends it when it is destroyed. The tasks of the
+// instrumentation API are identified by string handles that are created once
+// for each distinct text, and the detail is therefore made a part of the
+// task name.
+
+class ProfileZone
+{
+private:
+
+	#if defined( THERON_PROFILE_ITT )
+		static __itt_domain * Domain( void )
+		{
+			static __itt_domain * TheDomain = __itt_domain_create( "Theron" );
+			return TheDomain;
+		}
+	#else
+		const char * ZoneName;
+	#endif
+
+public:
+
+	#if defined( THERON_PROFILE_ITT )
+		ProfileZone( const char * Name )
+		{
+			__itt_task_begin( Domain(), __itt_null, __itt_null,
+												__itt_string_handle_create( Name ) );
+		}
+
+		ProfileZone( const char * Name, const std::string & Detail )
+		{
+			std::string TaskName( Name );
+
+			TaskName.append( " " ).append( Detail );
+
+			__itt_task_begin( Domain(), __itt_null, __itt_null,
+												__itt_string_handle_create( TaskName.c_str() ) );
+		}
+
+		~ProfileZone( void )
+		{
+			__itt_task_end( Domain() );
+		}
+
+		static void NameThread( const std::string & Name )
+		{
+			__itt_thread_set_name( Name.c_str() );
+		}
+	#else
+		ProfileZone( const char * Name )
+		: ZoneName( Name )
+		{
+			DTRACE_PROBE2( theron, zone_begin, ZoneName, "" );
+		}
+
+		ProfileZone( const char * Name, const std::string & Detail )
+		: ZoneName( Name )
+		{
+			DTRACE_PROBE2( theron, zone_begin, ZoneName, Detail.c_str() );
+		}
+
+		~ProfileZone( void )
+		{
+			DTRACE_PROBE1( theron, zone_end, ZoneName );
+		}
+
+		static void NameThread( const std::string & )
+		{ }
+	#endif
+
+	ProfileZone( void ) = delete;
+	ProfileZone( const ProfileZone & Other ) = delete;
+};
+
+}      // End name space Theron
+
+#define THERON_PROFILE_CONCATENATE( Prefix, Line ) Prefix##Line
+#define THERON_PROFILE_VARIABLE( Line ) 																	\
+	THERON_PROFILE_CONCATENATE( TheronProfileZone, Line )
+
+#define THERON_PROFILE_ZONE( Name ) 																		\
+	Theron::ProfileZone THERON_PROFILE_VARIABLE( __LINE__ )( Name )
+
+#define THERON_PROFILE_ZONE_DETAIL( Name, Detail ) 													\
+	Theron::ProfileZone THERON_PROFILE_VARIABLE( __LINE__ )( Name, Detail )
+
+#define THERON_PROFILE_THREAD( Name ) 																	\
+	Theron::ProfileZone::NameThread( Name )
+
+#else
+
+#define THERON_PROFILE_ZONE( Name )
+#define THERON_PROFILE_ZONE_DETAIL( Name, Detail )
+#define THERON_PROFILE_THREAD( Name )
+
+#endif
+#endif // THERON_PROFILER_ANNOTATIONS
@@ -0,0 +1,354 @@
+/*=============================================================================
+Timer Wheel
+
+This implements the hierarchical wheels of time outs and the timer thread
+executing the actions of the expired time outs.
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+=============================================================================*/
+
+#include <limits>												// Sleeping indefinitely
+#include <utility>											// Moving actions
+
+#include "TimerWheel.hpp"
+
+namespace Theron
+{
+
+// -----------------------------------------------------------------------------
+// Slot lists
+// -----------------------------------------------------------------------------
+//
+// A timer is stored in the lowest wheel whose revolution covers its deadline
+// counted from the current tick. The slot is given by the bits of the deadline
+// for that wheel, which means that the slot is cascaded to the lower wheels
+// when the current tick reaches the start of the range covered by the slot.
+// Time outs beyond the range of the last wheel are stored in the slot of the
+// last wheel that will be cascaded last, and they will be placed again when it
+// is cascaded.
+
+void TimerWheel::Link( std::uint32_t Index )
+{
+	Timer & TheTimer( Timers[ Index ] );
+	std::uint64_t Distance = TheTimer.Deadline - CurrentTick;
+
+	TheTimer.Wheel = NumWheels - 1;
+	TheTimer.Slot  = ( ( CurrentTick >> ( SlotBits * ( NumWheels - 1 ) ) ) - 1 )
+									 & SlotMask;
+
+	for ( unsigned int Wheel = 0; Wheel < NumWheels; Wheel++ )
+		if ( Distance < ( std::uint64_t(1) << ( SlotBits * ( Wheel + 1 ) ) ) )
+		{
+			TheTimer.Wheel = Wheel;
+			TheTimer.Slot  = ( TheTimer.Deadline >> ( SlotBits * Wheel ) ) & SlotMask;
+			break;
+		}
+
+	std::uint32_t & Head( Wheels[ TheTimer.Wheel ][ TheTimer.Slot ] );
+
+	TheTimer.Previous = NoTimer;
+	TheTimer.Next 		= Head;
+
+	if ( Head != NoTimer )
+		Timers[ Head ].Previous = Index;
+
+	Head = Index;
+}
+
+void TimerWheel::Unlink( std::uint32_t Index )
+{
+	Timer & TheTimer( Timers[ Index ] );
+
+	if ( TheTimer.Previous != NoTimer )
+		Timers[ TheTimer.Previous ].Next = TheTimer.Next;
+	else
+		Wheels[ TheTimer.Wheel ][ TheTimer.Slot ] = TheTimer.Next;
+
+	if ( TheTimer.Next != NoTimer )
+		Timers[ TheTimer.Next ].Previous = TheTimer.Previous;
+
+	TheTimer.Previous = NoTimer;
+	TheTimer.Next 		= NoTimer;
+}
+
+// The timers of a slot are taken out as a list and linked again according to
+// their deadlines.
+
+void TimerWheel::Cascade( unsigned int Wheel, unsigned int Slot )
+{
+	std::uint32_t Index = Wheels[ Wheel ][ Slot ];
+
+	Wheels[ Wheel ][ Slot ] = NoTimer;
+
+	while ( Index != NoTimer )
+	{
+		std::uint32_t Next = Timers[ Index ].Next;
+
+		Link( Index );
+		Index = Next;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// Advancing time
+// -----------------------------------------------------------------------------
+//
+// The higher wheels are cascaded when all the lower bits of the new tick are
+// zero, starting with the highest wheel so that its timers can be cascaded
+// further down by the lower wheels. Then all timers of the slot of the first
+// wheel have expired, and their actions are collected and the timers returned
+// to the free list with a new generation.
+
+void TimerWheel::Advance( std::vector< Action > & Expired )
+{
+	CurrentTick++;
+
+	unsigned int Cascading = 0;
+
+	while ( ( Cascading + 1 < NumWheels ) &&
+					( ( CurrentTick & ( ( std::uint64_t(1)
+							<< ( SlotBits * ( Cascading + 1 ) ) ) - 1 ) ) == 0 ) )
+		Cascading++;
+
+	for ( unsigned int Wheel = Cascading; Wheel > 0; Wheel-- )
+		Cascade( Wheel, ( CurrentTick >> ( SlotBits * Wheel ) ) & SlotMask );
+
+	std::uint32_t & Head( Wheels[0][ CurrentTick & SlotMask ] );
+
+	while ( Head != NoTimer )
+	{
+		std::uint32_t Index = Head;
+		Timer & TheTimer( Timers[ Index ] );
+
+		Unlink( Index );
+		Expired.push_back( std::move( TheTimer.TheAction ) );
+
+		TheTimer.TheAction = nullptr;
+		TheTimer.Active		 = false;
+
+		if ( ++TheTimer.Generation == 0 ) TheTimer.Generation = 1;
+
+		TheTimer.Next = FreeTimers;
+		FreeTimers 		= Index;
+		ActiveTimers--;
+	}
+}
+
+// The timer thread has nothing to do before the next tick with timers in the
+// first wheel, or the next tick where the higher wheels are cascaded.
+
+std::uint64_t TimerWheel::TicksToSleep( void ) const
+{
+	std::uint64_t Ticks = 1;
+
+	while ( Ticks < Slots )
+	{
+		std::uint64_t TheTick = CurrentTick + Ticks;
+
+		if ( ( ( TheTick & SlotMask ) == 0 ) ||
+				 ( Wheels[0][ TheTick & SlotMask ] != NoTimer ) )
+			break;
+
+		Ticks++;
+	}
+
+	return Ticks;
+}
+
+// -----------------------------------------------------------------------------
+// Timer thread
+// -----------------------------------------------------------------------------
+//
+// The thread advances the wheel to the tick of the current time and executes
+// the expired actions without holding the lock so that the actions can
+// schedule and cancel time outs. If there are no time outs, the current tick
+// is just set to the present tick. The thread then sleeps until the next tick
+// where there is something to do, and the tick it sleeps to is remembered so
+// that a time out scheduled before this tick can wake it up.
+
+void TimerWheel::RunTimers( void )
+{
+	std::vector< Action > Expired;
+	std::unique_lock< std::mutex > Lock( Guard );
+
+	while ( !Stop )
+	{
+		std::uint64_t PresentTick = ( Clock::now() - Start ) / Tick;
+
+		while ( CurrentTick < PresentTick )
+			if ( ActiveTimers == 0 )
+				CurrentTick = PresentTick;
+			else
+				Advance( Expired );
+
+		if ( !Expired.empty() )
+		{
+			Lock.unlock();
+
+			for ( Action & TheAction : Expired )
+			{
+				TheAction();
+				Actor::EndActivity();
+			}
+
+			Expired.clear();
+			Lock.lock();
+			continue;
+		}
+
+		if ( ActiveTimers == 0 )
+		{
+			WakeUpTick = std::numeric_limits< std::uint64_t >::max();
+			WakeUp.wait( Lock );
+		}
+		else
+		{
+			WakeUpTick = CurrentTick + TicksToSleep();
+			WakeUp.wait_until( Lock, Start + WakeUpTick * Tick );
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// Scheduling and cancelling
+// -----------------------------------------------------------------------------
+//
+// The deadline is the first tick after the delay, and at least the tick after
+// the current tick. The timer is taken from the free list if possible, and
+// the timer thread is woken up if the deadline is before the tick it sleeps to.
+
+TimerWheel::TimerID TimerWheel::Schedule( Duration Delay, Action TheAction )
+{
+	Duration 			FromStart = Clock::now() - Start + Delay;
+	std::uint64_t Deadline  = 0;
+
+	if ( FromStart > Duration::zero() )
+		Deadline = ( FromStart + Tick - Duration(1) ) / Tick;
+
+	Actor::BeginActivity();
+
+	std::unique_lock< std::mutex > Lock( Guard );
+	std::uint32_t Index;
+
+	if ( FreeTimers != NoTimer )
+	{
+		Index 		 = FreeTimers;
+		FreeTimers = Timers[ Index ].Next;
+	}
+	else
+	{
+		Index = static_cast< std::uint32_t >( Timers.size() );
+		Timers.emplace_back();
+	}
+
+	Timer & TheTimer( Timers[ Index ] );
+
+	TheTimer.TheAction = std::move( TheAction );
+	TheTimer.Deadline  = std::max( Deadline, CurrentTick + 1 );
+	TheTimer.Active 	 = true;
+
+	Link( Index );
+	ActiveTimers++;
+
+	TimerID TheID = ( static_cast< TimerID >( TheTimer.Generation ) << 32 ) | Index;
+
+	if ( TheTimer.Deadline < WakeUpTick )
+	{
+		WakeUpTick = TheTimer.Deadline;
+		WakeUp.notify_one();
+	}
+
+	return TheID;
+}
+
+// A timer can only be cancelled if its generation is the same as the timer
+// identifier's generation, and the action is destroyed after the lock has been
+// released since it may hold objects with non-trivial destructors.
+
+bool TimerWheel::Cancel( TimerID TheTimer )
+{
+	std::uint32_t Index 		 = static_cast< std::uint32_t >( TheTimer ),
+								Generation = static_cast< std::uint32_t >( TheTimer >> 32 );
+	Action				CancelledAction;
+
+	{
+		std::lock_guard< std::mutex > Lock( Guard );
+
+		if ( ( Index >= Timers.size() ) ||
+				 ( Timers[ Index ].Generation != Generation ) ||
+				 !Timers[ Index ].Active )
+			return false;
+
+		Timer & Cancelled( Timers[ Index ] );
+
+		Unlink( Index );
+		CancelledAction = std::move( Cancelled.TheAction );
+
+		Cancelled.TheAction = nullptr;
+		Cancelled.Active 		= false;
+
+		if ( ++Cancelled.Generation == 0 ) Cancelled.Generation = 1;
+
+		Cancelled.Next = FreeTimers;
+		FreeTimers 		 = Index;
+		ActiveTimers--;
+	}
+
+	Actor::EndActivity();
+	return true;
+}
+
+bool TimerWheel::IsPending( TimerID TheTimer )
+{
+	std::uint32_t Index 		 = static_cast< std::uint32_t >( TheTimer ),
+								Generation = static_cast< std::uint32_t >( TheTimer >> 32 );
+
+	std::lock_guard< std::mutex > Lock( Guard );
+
+	return ( Index < Timers.size() ) &&
+				 ( Timers[ Index ].Generation == Generation ) && Timers[ Index ].Active;
+}
+
+// The default service
+
+TimerWheel & TimerWheel::Service( void )
+{
+	static TimerWheel TheService;
+
+	return TheService;
+}
+
+// -----------------------------------------------------------------------------
+// Constructor and destructor
+// -----------------------------------------------------------------------------
+
+TimerWheel::TimerWheel( Duration TheTick )
+: Timers(), FreeTimers( NoTimer ), ActiveTimers(0), Wheels(),
+  Tick( TheTick > Duration::zero() ? TheTick : Duration(1) ),
+  Start( Clock::now() ), CurrentTick(0),
+  WakeUpTick( std::numeric_limits< std::uint64_t >::max() ),
+  Guard(), WakeUp(), Stop( false ), TimerThread()
+{
+	for ( auto & Wheel : Wheels )
+		Wheel.fill( NoTimer );
+
+	TimerThread = std::thread( &TimerWheel::RunTimers, this );
+}
+
+TimerWheel::~TimerWheel( void )
+{
+	{
+		std::lock_guard< std::mutex > Lock( Guard );
+
+		Stop = true;
+		WakeUp.notify_one();
+	}
+
+	TimerThread.join();
+
+	for ( ; ActiveTimers > 0; ActiveTimers-- )
+		Actor::EndActivity();
+}
+
+}       // End name space Theron
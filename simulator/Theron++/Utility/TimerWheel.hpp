@@ -0,0 +1,221 @@
+/*=============================================================================
+Timer Wheel
+
+Actors sometimes need to do something after a given delay, for instance to
+acknowledge an event if no other message has arrived in the mean time. The
+simple way of doing this is to start a thread sleeping on a condition variable
+until the delay has passed, but this creates a thread for every time out and
+the thread must be woken up and joined if the time out is cancelled.
+
+The timer wheel is a service where any actor can schedule and cancel time outs
+in constant time, and all time outs are handled by a single timer thread. The
+time is divided into ticks, one millisecond by default, and the time outs are
+kept in a hierarchy of wheels [1]. The first wheel has one slot per tick for
+the next 256 ticks, the second wheel has one slot per 256 ticks for the next
+65536 ticks, and so on for four wheels. Scheduling a time out is adding it to
+the list of its slot, and cancelling is removing it from this list. When the
+first wheel has completed a revolution, the time outs of the next slot of the
+second wheel are distributed on the first wheel, and similarly for the other
+wheels. Time outs longer than the four wheels are kept in the last slot of
+the last wheel until they are due.
+
+The action of a time out is a function executed by the timer thread, and it
+should therefore only do little work, typically sending a message. There is
+a convenience function scheduling a message to be sent from an actor to
+another actor when the time out expires. The time outs are stored in a pool
+of timer nodes, and the timer identifier contains the node's index and a
+generation count so that cancelling an expired or an already cancelled time
+out does nothing.
+
+There is a default timer wheel service that is created when it is first used.
+
+A pending time out is counted as an activity of the actor system from when it
+is scheduled until its action has been executed or it is cancelled, since the
+action will normally send a message. The actor system is therefore not seen
+as quiescent while there are pending time outs.
+
+References:
+[1] George Varghese and Tony Lauck (1987): "Hashed and hierarchical timing
+    wheels: Data structures for the efficient implementation of a timer
+    facility", in Proceedings of the 11th ACM Symposium on Operating Systems
+    Principles (SOSP '87), pp. 25-38
+
+Author and Copyright: Geir Horn, 2019
+License: LGPL 3.0
+=============================================================================*/
+
+#ifndef THERON_TIMER_WHEEL
+#define THERON_TIMER_WHEEL
+
+#include <array>												// The wheels
+#include <vector>												// The pool of timers
+#include <functional>										// Time out actions
+#include <chrono>												// Time
+#include <mutex>												// Protecting the wheels
+#include <condition_variable>						// Sleeping timer thread
+#include <thread>												// The timer thread
+#include <cstdint>											// Timer identifiers
+#include <algorithm>										// Deadlines
+
+#include "Actor.hpp"										// Sending time out messages
+
+namespace Theron
+{
+
+class TimerWheel
+{
+public:
+
+	using Clock     = std::chrono::steady_clock;
+	using Duration  = Clock::duration;
+	using TimePoint = Clock::time_point;
+	using Action    = std::function< void(void) >;
+
+	// A timer is identified by a number which is never zero, so the null
+	// timer can be used for time outs not scheduled.
+
+	using TimerID = std::uint64_t;
+
+	static constexpr TimerID NullTimer = 0;
+
+private:
+
+  // ---------------------------------------------------------------------------
+  // Timers
+  // ---------------------------------------------------------------------------
+	//
+	// A timer is kept in a doubly linked list of the slot where it is stored,
+	// and the links are indices in the pool of timers. Timers that are not
+	// used are linked in the free list.
+
+	static constexpr std::uint32_t NoTimer = UINT32_MAX;
+
+	class Timer
+	{
+	public:
+
+		Action 				TheAction;
+		std::uint64_t Deadline;
+		std::uint32_t Generation, Previous, Next;
+		std::uint8_t  Wheel, Slot;
+		bool 					Active;
+
+		Timer( void )
+		: TheAction(), Deadline(0), Generation(1), Previous( NoTimer ),
+		  Next( NoTimer ), Wheel(0), Slot(0), Active( false )
+		{}
+	};
+
+	std::vector< Timer > Timers;
+	std::uint32_t				 FreeTimers;
+	std::size_t					 ActiveTimers;
+
+	// The wheels are arrays of list heads
+
+	static constexpr unsigned int SlotBits  = 8,
+																Slots     = 1U << SlotBits,
+																SlotMask  = Slots - 1,
+																NumWheels = 4;
+
+	std::array< std::array< std::uint32_t, Slots >, NumWheels > Wheels;
+
+	// The tick defines the resolution of the time outs, and the current tick
+	// is the number of ticks since the wheel was started.
+
+	const Duration Tick;
+	const TimePoint Start;
+	std::uint64_t CurrentTick;
+
+	// Timers are inserted into the wheel according to their deadline and the
+	// current tick, and removed from their slot list.
+
+	void Link( std::uint32_t Index );
+	void Unlink( std::uint32_t Index );
+
+	// The timers of a slot of a higher wheel are moved to the lower wheels
+
+	void Cascade( unsigned int Wheel, unsigned int Slot );
+
+	// Advancing the wheel by one tick collects the actions of expired timers
+
+	void Advance( std::vector< Action > & Expired );
+
+	// The number of ticks to sleep before there can be anything to do
+
+	std::uint64_t TicksToSleep( void ) const;
+
+  // ---------------------------------------------------------------------------
+  // Timer thread
+  // ---------------------------------------------------------------------------
+	//
+	// The timer thread sleeps on the condition variable until the next tick
+	// where there is something to do, or until it is woken up because a time out
+	// is scheduled earlier.
+
+	std::uint64_t 					WakeUpTick;
+	std::mutex 							Guard;
+	std::condition_variable WakeUp;
+	bool 										Stop;
+	std::thread 						TimerThread;
+
+	void RunTimers( void );
+
+public:
+
+  // ---------------------------------------------------------------------------
+  // Scheduling and cancelling
+  // ---------------------------------------------------------------------------
+	//
+	// A time out is scheduled with a delay from now, or at a given time point.
+	// The action will be executed by the timer thread at the first tick after
+	// the delay has passed.
+
+	TimerID Schedule( Duration Delay, Action TheAction );
+
+	inline TimerID ScheduleAt( TimePoint Deadline, Action TheAction )
+	{
+		return Schedule( Deadline - Clock::now(), std::move( TheAction ) );
+	}
+
+	// A message can be sent from one actor to another when the time out occurs.
+	// The message is copied into the action.
+
+	template< class MessageType >
+	TimerID ScheduleMessage( Duration Delay, const MessageType & TheMessage,
+													 const Address & TheSender,
+													 const Address & TheReceiver )
+	{
+		return Schedule( Delay, [=](void){
+			Actor::Send( TheMessage, TheSender, TheReceiver ); });
+	}
+
+	// Cancelling returns true if the time out was pending and has been removed,
+	// and false if it has already expired or been cancelled.
+
+	bool Cancel( TimerID TheTimer );
+
+	// There is a function to test if a time out is still pending
+
+	bool IsPending( TimerID TheTimer );
+
+	// The default service is created on first use.
+
+	static TimerWheel & Service( void );
+
+  // ---------------------------------------------------------------------------
+  // Constructor and destructor
+  // ---------------------------------------------------------------------------
+	//
+	// The constructor takes the tick of the wheel and starts the timer thread,
+	// and the destructor stops the thread. Pending time outs will not be
+	// executed when the wheel is destroyed.
+
+	TimerWheel( Duration TheTick = std::chrono::milliseconds(1) );
+
+	TimerWheel( const TimerWheel & Other ) = delete;
+
+	~TimerWheel( void );
+};
+
+}       // End name space Theron
+#endif  // THERON_TIMER_WHEEL
@@ -51,8 +51,14 @@
   to this potential problem is to use normal thread signalling in terms of a 
   mutex protected condition variable that can wake up the waiting thread before 
   the time out epoch.
+  
+  The time outs are now scheduled on the shared timer wheel service, which 
+  handles all time outs with a single thread. When the time out expires, the 
+  timer wheel sends a wake up message to the event handler, which then updates
+  the clock and dispatches the event from its own message handler. A time out 
+  for a later event is simply cancelled when an earlier event is enqueued.
    
-  Author: Geir Horn, University of Oslo, 2016-2017
+  Author: Geir Horn, University of Oslo, 2016-2017, 2019
   Contact: Geir.Horn [at] mn.uio.no
   License: LGPL3.0
 =============================================================================*/
@@ -60,12 +66,6 @@
 #ifndef WALL_CLOCK_EVENT_HANDLER
 #define WALL_CLOCK_EVENT_HANDLER
 
-// The time out waits are based on waiting for a condition variable that locks 
-// on a mutex, and we will therefore need some thread headers.
-
-#include <mutex>
-#include <condition_variable>
-#include <thread>
 
 // The interface will also relate to the utilities of the time libraries of 
 // the standard library
@@ -83,6 +83,7 @@
 
 #include "Actor.hpp"
 #include "StandardFallbackHandler.hpp"
+#include "TimerWheel.hpp"
 
 // And it is derived from the Event Handler
 
@@ -119,60 +120,56 @@ private:
 	using EventManager = DiscreteEventManager< EventTime, EventMessage >;
 
   // ---------------------------------------------------------------------------
-  // Managing the wait for event thread
+  // Managing the wait for the next event
   // ---------------------------------------------------------------------------
   //	
-  // The core mechanism is a thread started to wait for the event epoch. 
-  // In order to make this thread wait, we need a time out mutex and 
-  // a condition variable that will wait for the time out.
+  // The core mechanism is a time out scheduled for the time of the next 
+  // event. The time out sends a wake up message to this event handler so that 
+  // the clock is updated and the event dispatched by the handler for this 
+  // message, and not by the timer thread. The identifier of the pending time 
+  // out is kept so that it can be cancelled.
   
-  std::mutex 		    		  TimeOutGuard;
-  std::condition_variable TimeOutEvent;
- 
-  // It maintains a separate thread for the actual wait so that Theron can 
-  // continue to work normally.
+  class WakeUp
+  {};
   
-  std::thread TheNextEvent;
+  TimerWheel::TimerID TheNextEvent;
 	
-  // This thread execute a function that locks the guard and sets up a wait
-  // on the condition variable. When the time out occurs it calls the clock 
-	// updating function, and dispatches the next event.
-  
   void Wait( void )
   {
-		 std::unique_lock< std::mutex >  WaitLock( TimeOutGuard );
-
-		 // We will only update the clock and dispatch the event if the reason for 
-		 // waking up is a time out. If the thread is being signalled for any other 
-		 // reason, it will just do nothing. 
-
-		 if ( TimeOutEvent.wait_until( WaitLock, NextEventTime() ) 
-																						    == std::cv_status::timeout )
-	   {
-			 UpdateNow();
-			 DispatchEvent();
-		 }
+		TheNextEvent = TimerWheel::Service().ScheduleAt( TimerWheel::Clock::now() +
+			std::chrono::duration_cast< TimerWheel::Duration >( 
+				NextEventTime() - std::chrono::system_clock::now() ), [this](void){
+					Actor::Send( WakeUp(), GetAddress(), GetAddress() ); });
   }
-
-  // There is a small utility function used to terminate the current wait 
-  // (if there is an active wait). It basically checks if the thread is active 
-  // (joinable) and if so it notifies the thread and waits for it to terminate.
   
-  void TerminateWait( void )
+  // The clock is only updated and the event dispatched if the wake up was 
+  // sent by the pending time out, as a cancelled time out may already have 
+  // sent its wake up message.
+  
+  void TimeOutHandler( const WakeUp & TheWakeUp, const Address TheTimer )
   {
-    if ( TheNextEvent.joinable() )
-    { 
-			// The notification requires a lock (undocumented) and a standard 
-			// guard variable is used. It is encapsulated in a separate code block
-			// to ensure that it is released before we start waiting for the 
-			// thread to terminate.
+		if ( ( TheNextEvent != TimerWheel::NullTimer ) && 
+				 !TimerWheel::Service().IsPending( TheNextEvent ) )
+		{
+			TheNextEvent = TimerWheel::NullTimer;
 			
+			if ( NextEventTime() <= std::chrono::system_clock::now() )
 			{
-			  std::lock_guard< std::mutex > Guard( TimeOutGuard );
-			  TimeOutEvent.notify_one();
+				UpdateNow();
+				DispatchEvent();
 			}
-			TheNextEvent.join();
-    }
+			else
+				Wait();
+		}
+  }
+
+  // There is a small utility function used to cancel the current wait if there
+  // is a pending time out.
+  
+  void TerminateWait( void )
+  {
+		TimerWheel::Service().Cancel( TheNextEvent );
+		TheNextEvent = TimerWheel::NullTimer;
   }
 
   // ---------------------------------------------------------------------------
@@ -208,10 +205,10 @@ private:
 			EventReceiver = RequestingActor;
 		
 		// Special care must be taken if the release time is less than the event 
-		// time of the first event in the event queue. Then the thread waiting for
-		// the currently first event must be terminated, then the new event enqueued
-		// to take the first position in the queue, and the thread must be restarted
-		// for this event time. 
+		// time of the first event in the event queue. Then the time out for the 
+		// currently first event must be cancelled, then the new event enqueued
+		// to take the first position in the queue, and the time out must be 
+		// scheduled for this event time. 
 		//
 		// If the new event is not a new first event, it is simply enqueued.
 				
@@ -219,7 +216,7 @@ private:
 		{
 			TerminateWait();
 			QueueEvent( ReleaseTime, EventReceiver, TheEvent.Message );
-			TheNextEvent = std::thread( &WallClockEvent::Wait, this );
+			Wait();
 		}
 		else
 			QueueEvent( ReleaseTime, EventReceiver, TheEvent.Message );			
@@ -247,7 +244,7 @@ private:
 			DispatchEvent();
 		}
 		else
-			TheNextEvent = std::thread( &WallClockEvent::Wait, this );
+			Wait();
 	}
   
 protected:
@@ -278,11 +275,15 @@ public:
     EventHandler( TheFramework, GetAddress().AsString() ),
     DiscreteEventManager< EventTime, EventMessage >( TheFramework, 
 																										 GetAddress().AsString() ),
-	  TimeOutGuard(), TimeOutEvent(), TheNextEvent()
-  { }
+	  TheNextEvent( TimerWheel::NullTimer )
+  { 
+		RegisterHandler( this, &WallClockEvent::TimeOutHandler );
+	}
   
   virtual ~WallClockEvent( void )
-  { }
+  { 
+		TerminateWait();
+	}
 };
 
 }       // End name space Theron